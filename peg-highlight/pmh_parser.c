@@ -89,6 +89,85 @@ struct pmh_RealElement
 typedef struct pmh_RealElement pmh_realelement;
 
 
+// Number of elements in one arena block:
+#define pmh_ARENA_BLOCK_SIZE 1024
+
+// Chunk of elements allocated at once by an arena:
+typedef struct pmh_ArenaBlock
+{
+    struct pmh_ArenaBlock *next;
+    size_t used;
+    pmh_realelement elems[pmh_ARENA_BLOCK_SIZE];
+} pmh_arenablock;
+
+// Bump-pointer allocator of the elements of one parse result:
+struct pmh_Arena
+{
+    // Most recently allocated block first:
+    pmh_arenablock *blocks;
+    
+    // Element array of the parse result:
+    pmh_realelement **head_elems;
+};
+
+pmh_arena *pmh_arena_create()
+{
+    pmh_arena *arena = (pmh_arena *)malloc(sizeof(pmh_arena));
+    arena->blocks = NULL;
+    arena->head_elems = NULL;
+    return arena;
+}
+
+static pmh_realelement *arena_alloc_element(pmh_arena *arena)
+{
+    pmh_arenablock *block = arena->blocks;
+    if (block == NULL || block->used == pmh_ARENA_BLOCK_SIZE)
+    {
+        block = (pmh_arenablock *)malloc(sizeof(pmh_arenablock));
+        block->next = arena->blocks;
+        block->used = 0;
+        arena->blocks = block;
+    }
+    return &block->elems[block->used++];
+}
+
+void pmh_arena_free(pmh_arena *arena)
+{
+    if (arena == NULL)
+        return;
+    pmh_arenablock *block = arena->blocks;
+    while (block != NULL) {
+        size_t i;
+        for (i = 0; i < block->used; i++) {
+            // Strings are still allocated one by one:
+            pmh_realelement *elem = &block->elems[i];
+            free(elem->text);
+            free(elem->label);
+            free(elem->address);
+        }
+        pmh_arenablock *tofree = block;
+        block = block->next;
+        free(tofree);
+    }
+    free(arena->head_elems);
+    free(arena);
+}
+
+size_t pmh_arena_size(pmh_arena *arena)
+{
+    size_t size = 0;
+    if (arena == NULL)
+        return size;
+    pmh_arenablock *block = arena->blocks;
+    while (block != NULL) {
+        size += sizeof(pmh_arenablock);
+        block = block->next;
+    }
+    return size;
+}
+
+
+
 
 
 // Parser state data:
@@ -124,6 +203,9 @@ typedef struct
     
     /* List of reference elements: */
     pmh_realelement *references;
+    
+    /* Arena to allocate elements from, or NULL to use malloc: */
+    pmh_arena *arena;
 } parser_data;
 
 static parser_data *mk_parser_data(char *original_input,
@@ -146,6 +228,7 @@ static parser_data *mk_parser_data(char *original_input,
     p_data->elem_head = p_data->current_elem = parsing_elems;
     p_data->references = references;
     p_data->parsing_only_references = false;
+    p_data->arena = NULL;
     if (head_elems != NULL)
         p_data->head_elems = head_elems;
     else {
@@ -379,6 +462,7 @@ static void process_raw_blocks(parser_data *p_data)
                     p_data->head_elems,
                     p_data->references
                 );
+                raw_p_data->arena = p_data->arena;
                 parse_markdown(raw_p_data);
                 free(raw_p_data);
                 
@@ -507,6 +591,13 @@ static int strcpy_preformat(char *str, char **out,
 
 void pmh_markdown_to_elements(char *text, int extensions,
                               pmh_element **out_result[])
+{
+    pmh_markdown_to_elements_in_arena(text, extensions, NULL, out_result);
+}
+
+void pmh_markdown_to_elements_in_arena(char *text, int extensions,
+                                       pmh_arena *arena,
+                                       pmh_element **out_result[])
 {
     char *text_copy = NULL;
     unsigned long *strip_positions = NULL;
@@ -532,7 +623,10 @@ void pmh_markdown_to_elements(char *text, int extensions,
         NULL,
         NULL
     );
+    p_data->arena = arena;
     pmh_realelement **result = p_data->head_elems;
+    if (arena != NULL)
+        arena->head_elems = result;
     
     if (*text_copy != '\0')
     {
@@ -715,7 +809,9 @@ static pmh_realelement *reverse(pmh_realelement *list)
 static pmh_realelement *mk_element(parser_data *p_data, pmh_element_type type,
                                    long pos, long end)
 {
-    pmh_realelement *result = (pmh_realelement *)malloc(sizeof(pmh_realelement));
+    pmh_realelement *result = (p_data->arena != NULL)
+                              ? arena_alloc_element(p_data->arena)
+                              : (pmh_realelement *)malloc(sizeof(pmh_realelement));
     memset(result, 0, sizeof(*result));
     result->type = type;
     result->pos = pos;
@@ -41,6 +41,61 @@
 void pmh_markdown_to_elements(char *text, int extensions,
                               pmh_element **out_result[]);
 
+/**
+* \brief Arena of elements
+* 
+* Allocates all the elements of one parse result in large blocks so
+* that they could be released in one shot.
+*/
+typedef struct pmh_Arena pmh_arena;
+
+/**
+* \brief Create an empty arena
+* 
+* You must pass it to pmh_arena_free() when it's not needed anymore.
+*/
+pmh_arena *pmh_arena_create();
+
+/**
+* \brief Parse Markdown text, allocating elements in an arena
+* 
+* Same as pmh_markdown_to_elements() except that all the elements are
+* allocated in \a arena. The result must NOT be passed to
+* pmh_free_elements(). It is released by pmh_arena_free().
+* 
+* \param[in]  text        The Markdown text to parse for highlighting.
+* \param[in]  extensions  The extensions to use in parsing (a bitfield
+*                         of pmh_extensions values).
+* \param[in]  arena       An empty arena from pmh_arena_create().
+* \param[out] out_result  A pmh_element array, indexed by type, containing
+*                         the results of the parsing (linked lists of elements).
+* 
+* \sa pmh_markdown_to_elements
+*/
+void pmh_markdown_to_elements_in_arena(char *text, int extensions,
+                                       pmh_arena *arena,
+                                       pmh_element **out_result[]);
+
+/**
+* \brief Free an arena
+* 
+* Frees all the elements allocated in \a arena, the result array and
+* the arena itself.
+* 
+* \param[in]  arena  The arena from pmh_arena_create().
+*/
+void pmh_arena_free(pmh_arena *arena);
+
+/**
+* \brief Get the memory held by an arena
+* 
+* \param[in]  arena  The arena from pmh_arena_create().
+* 
+* \return The number of bytes of the element blocks allocated in \a arena,
+*         not including the strings of the elements.
+*/
+size_t pmh_arena_size(pmh_arena *arena);
+
 /**
 * \brief Sort elements in list by start offset.
 * 
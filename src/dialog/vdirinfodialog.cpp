@@ -3,6 +3,7 @@
 #include "vdirectory.h"
 #include "vconfigmanager.h"
 #include "vmetawordlineedit.h"
+#include "vnotebookstatistics.h"
 #include "utils/vutils.h"
 
 extern VConfigManager *g_config;
@@ -19,7 +20,12 @@ VDirInfoDialog::VDirInfoDialog(const QString &title,
 
     connect(m_nameEdit, &VMetaWordLineEdit::textChanged, this, &VDirInfoDialog::handleInputChanged);
 
+    connect(VNotebookStatistics::inst(), &VNotebookStatistics::statisticsUpdated,
+            this, &VDirInfoDialog::updateStatistics);
+
     handleInputChanged();
+
+    updateStatistics();
 }
 
 void VDirInfoDialog::setupUI()
@@ -39,9 +45,14 @@ void VDirInfoDialog::setupUI()
     QString createdTimeStr = VUtils::displayDateTime(m_directory->getCreatedTimeUtc().toLocalTime());
     QLabel *createdTimeLabel = new QLabel(createdTimeStr);
 
+    // Statistics.
+    m_statisticsLabel = new QLabel();
+    m_statisticsLabel->setWordWrap(true);
+
     QFormLayout *topLayout = new QFormLayout();
     topLayout->addRow(tr("Folder &name:"), m_nameEdit);
     topLayout->addRow(tr("Created time:"), createdTimeLabel);
+    topLayout->addRow(tr("Statistics:"), m_statisticsLabel);
 
     m_warnLabel = new QLabel();
     m_warnLabel->setWordWrap(true);
@@ -114,3 +125,15 @@ QString VDirInfoDialog::getNameInput() const
 {
     return m_nameEdit->getEvaluatedText();
 }
+
+void VDirInfoDialog::updateStatistics()
+{
+    VNoteStatistics stats;
+    if (VNotebookStatistics::inst()->fetchStatistics(m_directory->getNotebook(),
+                                                     m_directory->fetchPath(),
+                                                     stats)) {
+        m_statisticsLabel->setText(VNotebookStatistics::toString(stats));
+    } else {
+        m_statisticsLabel->setText(tr("Computing..."));
+    }
+}
@@ -24,11 +24,14 @@ public:
 private slots:
     void handleInputChanged();
 
+    void updateStatistics();
+
 private:
     void setupUI();
 
     VMetaWordLineEdit *m_nameEdit;
     QLabel *m_warnLabel;
+    QLabel *m_statisticsLabel;
     QDialogButtonBox *m_btnBox;
 
     QString title;
@@ -7,6 +7,7 @@
 #include <QMimeData>
 #include <QApplication>
 #include <QClipboard>
+#include <QCryptographicHash>
 
 #ifndef QT_NO_PRINTER
 #include <QPrinter>
@@ -56,7 +57,9 @@ VExportDialog::VExportDialog(VNotebook *p_notebook,
                                QMarginsF(10, 16, 10, 10),
                                QPageLayout::Millimeter)),
       m_inExport(false),
-      m_askedToStop(false)
+      m_askedToStop(false),
+      m_numOfNotes(0),
+      m_numOfHandledNotes(0)
 {
     if (s_lastOutputFolder.isEmpty()) {
         s_lastOutputFolder = g_config->getExportFolderPath();
@@ -397,8 +400,32 @@ QWidget *VExportDialog::setupGeneralAdvancedSettings()
     m_subfolderCB = new QCheckBox(tr("Process subfolders"));
     m_subfolderCB->setToolTip(tr("Process subfolders recursively"));
 
+    // Incremental export.
+    m_incrementalCB = new QCheckBox(tr("Incremental"));
+    m_incrementalCB->setToolTip(tr("Skip notes unchanged since the last export to the "
+                                   "same output directory and update the others in place"));
+
+    // Extra formats.
+    m_extraHTMLCB = new QCheckBox(tr("HTML"));
+    m_extraMHTMLCB = new QCheckBox(tr("MIME HTML"));
+    m_extraPDFCB = new QCheckBox(tr("PDF"));
+
+    QHBoxLayout *extraLayout = new QHBoxLayout();
+    extraLayout->addWidget(m_extraHTMLCB);
+    extraLayout->addWidget(m_extraMHTMLCB);
+    extraLayout->addWidget(m_extraPDFCB);
+    extraLayout->addStretch();
+    extraLayout->setContentsMargins(0, 0, 0, 0);
+
+    m_extraFormatsWidget = new QWidget();
+    m_extraFormatsWidget->setToolTip(tr("Also export each note to these formats from "
+                                        "the same rendered page"));
+    m_extraFormatsWidget->setLayout(extraLayout);
+
     QFormLayout *advLayout = new QFormLayout();
     advLayout->addRow(m_subfolderCB);
+    advLayout->addRow(m_incrementalCB);
+    advLayout->addRow(tr("Also export to:"), m_extraFormatsWidget);
 
     advLayout->setContentsMargins(0, 0, 0, 0);
 
@@ -433,6 +460,12 @@ void VExportDialog::initUIFields(MarkdownConverterType p_renderer)
 
     m_subfolderCB->setChecked(s_opt.m_processSubfolders);
 
+    m_incrementalCB->setChecked(s_opt.m_incremental);
+
+    m_extraHTMLCB->setChecked(s_opt.m_extraFormats & ExportOption::ExtraHTML);
+    m_extraMHTMLCB->setChecked(s_opt.m_extraFormats & ExportOption::ExtraMHTML);
+    m_extraPDFCB->setChecked(s_opt.m_extraFormats & ExportOption::ExtraPDF);
+
     // Export format.
     m_formatCB->addItem(tr("Markdown"), (int)ExportFormat::Markdown);
     m_formatCB->addItem(tr("HTML"), (int)ExportFormat::HTML);
@@ -581,6 +614,7 @@ void VExportDialog::startExport()
                          renderStyle,
                          renderCodeBlockStyle,
                          m_subfolderCB->isChecked(),
+                         m_incrementalCB->isChecked(),
                          ExportPDFOption(&m_pageLayout,
                                          m_wkhtmltopdfCB->isChecked(),
                                          QDir::toNativeSeparators(m_wkPathEdit->text()),
@@ -607,6 +641,20 @@ void VExportDialog::startExport()
                                             m_customFolderSepEdit->text(),
                                             m_customTargetFileNameEdit->text()));
 
+    if (s_opt.m_format == ExportFormat::HTML || s_opt.m_format == ExportFormat::PDF) {
+        if (m_extraHTMLCB->isChecked()) {
+            s_opt.m_extraFormats |= ExportOption::ExtraHTML;
+        }
+
+        if (m_extraMHTMLCB->isChecked()) {
+            s_opt.m_extraFormats |= ExportOption::ExtraMHTML;
+        }
+
+        if (m_extraPDFCB->isChecked()) {
+            s_opt.m_extraFormats |= ExportOption::ExtraPDF;
+        }
+    }
+
     m_consoleEdit->clear();
     appendLogLine(tr("Export to %1.").arg(outputFolder));
 
@@ -655,6 +703,34 @@ void VExportDialog::startExport()
     int ret = 0;
     QString msg;
 
+    // All-in-one export outputs to a temporary folder first.
+    if (s_opt.m_format == ExportFormat::OnePDF
+        || (s_opt.m_format == ExportFormat::Custom && s_opt.m_customOpt.m_allInOne)) {
+        s_opt.m_incremental = false;
+    }
+
+    if (s_opt.m_incremental) {
+        m_manifest.load(outputFolder, optionHash(s_opt));
+    } else {
+        m_manifest.clear();
+    }
+
+    {
+        QList<QString> files = collectFiles();
+        m_numOfNotes = files.size();
+
+        // Render the diagrams of all the notes in parallel ahead of their pages.
+        int nr = m_exporter->prerenderDiagrams(files, s_opt);
+        if (nr > 0) {
+            appendLogLine(tr("Pre-rendering %1 diagrams.").arg(nr));
+        }
+    }
+
+    m_numOfHandledNotes = 0;
+    m_proBar->setRange(0, m_numOfNotes);
+    m_proBar->setValue(0);
+    m_exportTimer.start();
+
     if (s_opt.m_format == ExportFormat::OnePDF) {
         QList<QString> files;
         // Output HTMLs to a tmp folder.
@@ -730,6 +806,28 @@ void VExportDialog::startExport()
     }
 
 exit:
+    if (m_exporter->hasPendingPDFs()) {
+        appendLogLine(tr("Waiting for wkhtmltopdf to finish."));
+        auto func = [this](const QString &p_srcFile, const QString &p_outputFile, bool p_succeeded) {
+            if (!p_succeeded) {
+                appendLogLine(tr("Fail to export note %1.").arg(p_srcFile));
+                return;
+            }
+
+            appendLogLine(tr("Note %1 exported to %2.").arg(p_srcFile).arg(p_outputFile));
+            if (s_opt.m_incremental) {
+                m_manifest.update(p_srcFile, p_outputFile);
+            }
+        };
+
+        ret -= m_exporter->collectPendingPDFs(func, &msg);
+    }
+
+    m_exporter->clearPrefetchedNotes();
+
+    if (s_opt.m_incremental && !m_manifest.save()) {
+        appendLogLine(tr("Fail to save the manifest of incremental export."));
+    }
 
     if (m_askedToStop) {
         appendLogLine(tr("User cancelled the export. Aborted!"));
@@ -752,6 +850,7 @@ exit:
     m_inExport = false;
     m_exportBtn->setEnabled(true);
     m_proBar->hide();
+    m_proBar->setRange(0, 0);
 
     m_copyBtn->setEnabled(!m_exportedFile.isEmpty());
 }
@@ -837,35 +936,164 @@ int VExportDialog::doExport(VFile *p_file,
 {
     Q_ASSERT(p_file);
 
-    appendLogLine(tr("Exporting note %1.").arg(p_file->fetchPath()));
+    QString srcFilePath(p_file->fetchPath());
+    QString outputFile;
+    if (p_opt.m_incremental && m_manifest.isUnchanged(srcFilePath, outputFile)) {
+        appendLogLine(tr("Skip unchanged note %1.").arg(srcFilePath));
+        if (p_outputFiles) {
+            p_outputFiles->append(outputFile);
+        }
+
+        updateProgress();
+        return 1;
+    }
+
+    appendLogLine(tr("Exporting note %1.").arg(srcFilePath));
 
+    QList<QString> outputFiles;
     int ret = 0;
     switch (p_opt.m_format) {
     case ExportFormat::Markdown:
-        ret = doExportMarkdown(p_file, p_opt, p_outputFolder, p_errMsg, p_outputFiles);
+        ret = doExportMarkdown(p_file, p_opt, p_outputFolder, p_errMsg, &outputFiles);
         break;
 
     case ExportFormat::PDF:
         V_FALLTHROUGH;
     case ExportFormat::OnePDF:
-        ret = doExportPDF(p_file, p_opt, p_outputFolder, p_errMsg, p_outputFiles);
+        ret = doExportPDF(p_file, p_opt, p_outputFolder, p_errMsg, &outputFiles);
         break;
 
     case ExportFormat::HTML:
-        ret = doExportHTML(p_file, p_opt, p_outputFolder, p_errMsg, p_outputFiles);
+        ret = doExportHTML(p_file, p_opt, p_outputFolder, p_errMsg, &outputFiles);
         break;
 
     case ExportFormat::Custom:
-        ret = doExportCustom(p_file, p_opt, p_outputFolder, p_errMsg, p_outputFiles);
+        ret = doExportCustom(p_file, p_opt, p_outputFolder, p_errMsg, &outputFiles);
         break;
 
     default:
         break;
     }
 
+    if (p_outputFiles) {
+        p_outputFiles->append(outputFiles);
+    }
+
+    // PDFs converted in background are recorded once they finish.
+    if (ret
+        && p_opt.m_incremental
+        && !outputFiles.isEmpty()
+        && !m_exporter->isPDFPending(outputFiles.first())) {
+        m_manifest.update(srcFilePath, outputFiles.first());
+    }
+
+    updateProgress();
+
     return ret;
 }
 
+void VExportDialog::updateProgress()
+{
+    ++m_numOfHandledNotes;
+    if (m_numOfHandledNotes > m_numOfNotes) {
+        // Same note exported more than once, such as OnePDF.
+        return;
+    }
+
+    m_proBar->setValue(m_numOfHandledNotes);
+
+    int left = m_numOfNotes - m_numOfHandledNotes;
+    if (left > 0) {
+        qint64 secs = m_exportTimer.elapsed() * left / m_numOfHandledNotes / 1000;
+        appendLogLine(tr("%1/%2 notes handled, about %3 seconds left.")
+                        .arg(m_numOfHandledNotes)
+                        .arg(m_numOfNotes)
+                        .arg(secs));
+    }
+}
+
+QString VExportDialog::outputFileName(const QString &p_folder,
+                                     const QString &p_name,
+                                     const QString &p_srcFile) const
+{
+    if (s_opt.m_incremental) {
+        QFileInfo recorded(m_manifest.outputFile(p_srcFile));
+        if (!recorded.fileName().isEmpty()
+            && recorded.suffix() == QFileInfo(p_name).suffix()
+            && VUtils::equalPath(recorded.absolutePath(), p_folder)) {
+            return recorded.fileName();
+        }
+    }
+
+    return VUtils::getFileNameWithSequence(p_folder, p_name);
+}
+
+QString VExportDialog::outputDirName(const QString &p_folder,
+                                    const QString &p_name,
+                                    const QString &p_srcFile) const
+{
+    if (s_opt.m_incremental) {
+        if (p_srcFile.isEmpty()) {
+            return p_name;
+        }
+
+        // The recorded output is the note file within the folder.
+        QString recorded = m_manifest.outputFile(p_srcFile);
+        if (!recorded.isEmpty()) {
+            QFileInfo dir(QFileInfo(recorded).absolutePath());
+            if (VUtils::equalPath(dir.absolutePath(), p_folder)) {
+                return dir.fileName();
+            }
+        }
+    }
+
+    return VUtils::getDirNameWithSequence(p_folder, p_name);
+}
+
+QByteArray VExportDialog::optionHash(const ExportOption &p_opt)
+{
+    // Options affecting the output of each note.
+    QStringList opts;
+    opts << QString::number((int)p_opt.m_format)
+         << QString::number((int)p_opt.m_renderer)
+         << p_opt.m_renderBg
+         << p_opt.m_renderStyle
+         << p_opt.m_renderCodeBlockStyle
+         << QString::number(p_opt.m_processSubfolders)
+         << QString::number(p_opt.m_extraFormats);
+
+    const ExportHTMLOption &htmlOpt = p_opt.m_htmlOpt;
+    opts << QString::number(htmlOpt.m_embedCssStyle)
+         << QString::number(htmlOpt.m_completeHTML)
+         << QString::number(htmlOpt.m_embedImages)
+         << QString::number(htmlOpt.m_mimeHTML)
+         << QString::number(htmlOpt.m_outlinePanel);
+
+    const ExportPDFOption &pdfOpt = p_opt.m_pdfOpt;
+    opts << QString::number(pdfOpt.m_wkhtmltopdf)
+         << pdfOpt.m_wkPath
+         << QString::number(pdfOpt.m_wkEnableBackground)
+         << QString::number(pdfOpt.m_enableTableOfContents)
+         << QString::number((int)pdfOpt.m_wkPageNumber)
+         << pdfOpt.m_wkExtraArgs;
+    if (pdfOpt.m_layout) {
+        QMarginsF margins = pdfOpt.m_layout->margins(QPageLayout::Millimeter);
+        opts << pdfOpt.m_layout->pageSize().key()
+             << QString::number((int)pdfOpt.m_layout->orientation())
+             << QString("%1,%2,%3,%4").arg(margins.left())
+                                      .arg(margins.top())
+                                      .arg(margins.right())
+                                      .arg(margins.bottom());
+    }
+
+    const ExportCustomOption &customOpt = p_opt.m_customOpt;
+    opts << QString::number((int)customOpt.m_srcFormat)
+         << customOpt.m_outputSuffix
+         << customOpt.m_cmd;
+
+    return QCryptographicHash::hash(opts.join('\n').toUtf8(), QCryptographicHash::Sha1);
+}
+
 int VExportDialog::doExport(VDirectory *p_directory,
                             const ExportOption &p_opt,
                             const QString &p_outputFolder,
@@ -882,8 +1110,7 @@ int VExportDialog::doExport(VDirectory *p_directory,
 
     int ret = 0;
 
-    QString folderName = VUtils::getDirNameWithSequence(p_outputFolder,
-                                                        p_directory->getName());
+    QString folderName = outputDirName(p_outputFolder, p_directory->getName());
     QString outputPath = QDir(p_outputFolder).filePath(folderName);
     if (!VUtils::makePath(outputPath)) {
         LOGERR(tr("Fail to create directory %1.").arg(outputPath));
@@ -891,12 +1118,23 @@ int VExportDialog::doExport(VDirectory *p_directory,
     }
 
     // Export child notes.
-    for (auto const & file : p_directory->getFiles()) {
-        if (!checkUserAction()) {
-            goto exit;
-        }
+    {
+        const QVector<VNoteFile *> &files = p_directory->getFiles();
+        for (int i = 0; i < files.size(); ++i) {
+            if (!checkUserAction()) {
+                goto exit;
+            }
+
+            // Load the following notes in advance.
+            QList<VFile *> nextFiles;
+            for (int j = i + 1; j < files.size() && j <= i + g_config->getExportWebViews(); ++j) {
+                nextFiles.append(files[j]);
+            }
 
-        ret += doExport(file, p_opt, outputPath, p_errMsg, p_outputFiles);
+            m_exporter->prefetch(nextFiles, p_opt);
+
+            ret += doExport(files[i], p_opt, outputPath, p_errMsg, p_outputFiles);
+        }
     }
 
     // Export subfolders.
@@ -934,8 +1172,7 @@ int VExportDialog::doExport(VNotebook *p_notebook,
 
     int ret = 0;
 
-    QString folderName = VUtils::getDirNameWithSequence(p_outputFolder,
-                                                        p_notebook->getName());
+    QString folderName = outputDirName(p_outputFolder, p_notebook->getName());
     QString outputPath = QDir(p_outputFolder).filePath(folderName);
     if (!VUtils::makePath(outputPath)) {
         LOGERR(tr("Fail to create directory %1.").arg(outputPath));
@@ -970,13 +1207,31 @@ int VExportDialog::doExport(VCart *p_cart,
     int ret = 0;
 
     QVector<QString> files = m_cart->getFiles();
-    for (auto const & it : files) {
-        VFile *file = g_vnote->getFile(it);
+
+    // Resolve the notes in one batch. Orphan files are resolved when used
+    // since they may be freed by later ones.
+    QVector<VNoteFile *> noteFiles = g_vnote->getInternalFiles(files);
+    for (int i = 0; i < files.size(); ++i) {
+        if (!checkUserAction()) {
+            break;
+        }
+
+        VFile *file = noteFiles[i] ? noteFiles[i] : g_vnote->getFile(files[i], true);
         if (!file) {
-            LOGERR(tr("Fail to open file %1.").arg(it));
+            LOGERR(tr("Fail to open file %1.").arg(files[i]));
             continue;
         }
 
+        // Load the following notes in advance.
+        QList<VFile *> nextFiles;
+        for (int j = i + 1; j < files.size() && j <= i + g_config->getExportWebViews(); ++j) {
+            if (noteFiles[j]) {
+                nextFiles.append(noteFiles[j]);
+            }
+        }
+
+        m_exporter->prefetch(nextFiles, p_opt);
+
         ret += doExport(file, p_opt, p_outputFolder, p_errMsg, p_outputFiles);
     }
 
@@ -989,8 +1244,6 @@ int VExportDialog::doExportMarkdown(VFile *p_file,
                                     QString *p_errMsg,
                                     QList<QString> *p_outputFiles)
 {
-    Q_UNUSED(p_opt);
-
     QString srcFilePath(p_file->fetchPath());
 
     if (p_file->getDocType() != DocType::Markdown) {
@@ -999,7 +1252,7 @@ int VExportDialog::doExportMarkdown(VFile *p_file,
     }
 
     // Export it to a folder with the same name.
-    QString name = VUtils::getDirNameWithSequence(p_outputFolder, p_file->getName());
+    QString name = outputDirName(p_outputFolder, p_file->getName(), srcFilePath);
     QString outputPath = QDir(p_outputFolder).filePath(name);
     if (!VUtils::makePath(outputPath)) {
         LOGERR(tr("Fail to create directory %1.").arg(outputPath));
@@ -1008,7 +1261,9 @@ int VExportDialog::doExportMarkdown(VFile *p_file,
 
     // Copy the note file.
     QString destPath = QDir(outputPath).filePath(p_file->getName());
-    if (!VUtils::copyFile(srcFilePath, destPath, false)) {
+    bool copied = p_opt.m_incremental ? VUtils::syncFile(srcFilePath, destPath)
+                                      : VUtils::copyFile(srcFilePath, destPath, false);
+    if (!copied) {
         LOGERR(tr("Fail to copy the note file %1.").arg(srcFilePath));
         return 0;
     }
@@ -1022,7 +1277,8 @@ int VExportDialog::doExportMarkdown(VFile *p_file,
                                        outputPath,
                                        false,
                                        &nrImageCopied,
-                                       p_errMsg)) {
+                                       p_errMsg,
+                                       p_opt.m_incremental)) {
         ret = 0;
         appendLogLine(tr("Fail to copy images of note %1.").arg(srcFilePath));
     }
@@ -1038,7 +1294,9 @@ int VExportDialog::doExportMarkdown(VFile *p_file,
             QString folderPath = QDir(outputPath).filePath(relativePath);
 
             // Copy attaFolder to folderPath.
-            if (!VUtils::copyDirectory(attaFolderPath, folderPath, false)) {
+            bool attaCopied = p_opt.m_incremental ? VUtils::syncDirectory(attaFolderPath, folderPath)
+                                                  : VUtils::copyDirectory(attaFolderPath, folderPath, false);
+            if (!attaCopied) {
                 LOGERR(tr("Fail to copy attachments folder %1 to %2.")
                          .arg(attaFolderPath).arg(folderPath));
                 ret = 0;
@@ -1079,8 +1337,9 @@ int VExportDialog::doExportPDF(VFile *p_file,
 
     // Get output file.
     QString suffix = ".pdf";
-    QString name = VUtils::getFileNameWithSequence(p_outputFolder,
-                                                   QFileInfo(p_file->getName()).completeBaseName() + suffix);
+    QString name = outputFileName(p_outputFolder,
+                                  QFileInfo(p_file->getName()).completeBaseName() + suffix,
+                                  srcFilePath);
     QString outputPath = QDir(p_outputFolder).filePath(name);
 
     if (m_exporter->exportPDF(p_file, p_opt, outputPath, p_errMsg)) {
@@ -1088,7 +1347,18 @@ int VExportDialog::doExportPDF(VFile *p_file,
             p_outputFiles->append(outputPath);
         }
 
-        appendLogLine(tr("Note %1 exported to %2.").arg(srcFilePath).arg(outputPath));
+        if (m_exporter->isPDFPending(outputPath)) {
+            appendLogLine(tr("Note %1 is being converted to %2.").arg(srcFilePath).arg(outputPath));
+        } else {
+            appendLogLine(tr("Note %1 exported to %2.").arg(srcFilePath).arg(outputPath));
+        }
+
+        for (auto fmt : VExporter::extraFormats(p_opt)) {
+            appendLogLine(tr("Note %1 exported to %2.")
+                            .arg(srcFilePath)
+                            .arg(VExporter::extraOutputFile(outputPath, fmt)));
+        }
+
         return 1;
     } else {
         appendLogLine(tr("Fail to export note %1.").arg(srcFilePath));
@@ -1118,8 +1388,9 @@ int VExportDialog::doExportHTML(VFile *p_file,
 
     // Get output file.
     QString suffix = p_opt.m_htmlOpt.m_mimeHTML ? ".mht" : ".html";
-    QString name = VUtils::getFileNameWithSequence(p_outputFolder,
-                                                   QFileInfo(p_file->getName()).completeBaseName() + suffix);
+    QString name = outputFileName(p_outputFolder,
+                                  QFileInfo(p_file->getName()).completeBaseName() + suffix,
+                                  srcFilePath);
     QString outputPath = QDir(p_outputFolder).filePath(name);
 
     if (m_exporter->exportHTML(p_file, p_opt, outputPath, p_errMsg)) {
@@ -1128,6 +1399,12 @@ int VExportDialog::doExportHTML(VFile *p_file,
         }
 
         appendLogLine(tr("Note %1 exported to %2.").arg(srcFilePath).arg(outputPath));
+        for (auto fmt : VExporter::extraFormats(p_opt)) {
+            appendLogLine(tr("Note %1 exported to %2.")
+                            .arg(srcFilePath)
+                            .arg(VExporter::extraOutputFile(outputPath, fmt)));
+        }
+
         return 1;
     } else {
         appendLogLine(tr("Fail to export note %1.").arg(srcFilePath));
@@ -1157,8 +1434,9 @@ int VExportDialog::doExportCustom(VFile *p_file,
 
     // Get output file.
     QString suffix = "." + p_opt.m_customOpt.m_outputSuffix;
-    QString name = VUtils::getFileNameWithSequence(p_outputFolder,
-                                                   QFileInfo(p_file->getName()).completeBaseName() + suffix);
+    QString name = outputFileName(p_outputFolder,
+                                  QFileInfo(p_file->getName()).completeBaseName() + suffix,
+                                  srcFilePath);
     QString outputPath = QDir(p_outputFolder).filePath(name);
 
     if (m_exporter->exportCustom(p_file, p_opt, outputPath, p_errMsg)) {
@@ -1218,16 +1496,19 @@ void VExportDialog::handleCurrentFormatChanged(int p_index)
     bool htmlEnabled = false;
     bool pdfTitleNameEnabled = false;
     bool customEnabled = false;
+    bool extraFormatsEnabled = false;
 
     if (p_index >= 0) {
         switch (currentFormat()) {
         case ExportFormat::PDF:
             pdfEnabled = true;
+            extraFormatsEnabled = true;
             m_wkhtmltopdfCB->setEnabled(true);
             break;
 
         case ExportFormat::HTML:
             htmlEnabled = true;
+            extraFormatsEnabled = true;
             break;
 
         case ExportFormat::OnePDF:
@@ -1250,6 +1531,8 @@ void VExportDialog::handleCurrentFormatChanged(int p_index)
     m_htmlSettings->setVisible(htmlEnabled);
     m_customSettings->setVisible(customEnabled);
 
+    m_extraFormatsWidget->setEnabled(extraFormatsEnabled);
+
     m_wkTitleEdit->setEnabled(pdfTitleNameEnabled);
     m_wkTargetFileNameEdit->setEnabled(pdfTitleNameEnabled);
 
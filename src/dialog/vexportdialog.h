@@ -5,8 +5,10 @@
 #include <QPageLayout>
 #include <QList>
 #include <QComboBox>
+#include <QElapsedTimer>
 
 #include "vconstants.h"
+#include "vexportmanifest.h"
 
 class QLabel;
 class VLineEdit;
@@ -220,11 +222,23 @@ struct ExportCustomOption
 
 struct ExportOption
 {
+    // Outputs produced from the same rendered page of each note besides
+    // the one of @m_format.
+    enum ExtraFormat
+    {
+        NoExtraFormat = 0,
+        ExtraHTML = 0x1,
+        ExtraMHTML = 0x2,
+        ExtraPDF = 0x4
+    };
+
     ExportOption()
         : m_source(ExportSource::CurrentNote),
           m_format(ExportFormat::Markdown),
           m_renderer(MarkdownConverterType::MarkdownIt),
-          m_processSubfolders(true)
+          m_processSubfolders(true),
+          m_incremental(false),
+          m_extraFormats(ExtraFormat::NoExtraFormat)
     {
     }
 
@@ -235,6 +249,7 @@ struct ExportOption
                  const QString &p_renderStyle,
                  const QString &p_renderCodeBlockStyle,
                  bool p_processSubfolders,
+                 bool p_incremental,
                  const ExportPDFOption &p_pdfOpt,
                  const ExportHTMLOption &p_htmlOpt,
                  const ExportCustomOption &p_customOpt)
@@ -245,6 +260,8 @@ struct ExportOption
           m_renderStyle(p_renderStyle),
           m_renderCodeBlockStyle(p_renderCodeBlockStyle),
           m_processSubfolders(p_processSubfolders),
+          m_incremental(p_incremental),
+          m_extraFormats(ExtraFormat::NoExtraFormat),
           m_pdfOpt(p_pdfOpt),
           m_htmlOpt(p_htmlOpt),
           m_customOpt(p_customOpt)
@@ -264,6 +281,12 @@ struct ExportOption
     // Whether process subfolders recursively when source is CurrentFolder.
     bool m_processSubfolders;
 
+    // Skip notes unchanged since the last export to the same output folder.
+    bool m_incremental;
+
+    // ExtraFormat flags. Only for HTML and PDF.
+    int m_extraFormats;
+
     ExportPDFOption m_pdfOpt;
 
     ExportHTMLOption m_htmlOpt;
@@ -377,6 +400,24 @@ private:
     // Return false if we could not continue.
     bool checkUserAction();
 
+    // Update the progress after one note is handled.
+    void updateProgress();
+
+    // Name of @p_name in @p_folder for output of @p_srcFile.
+    // A sequence is appended if it exists, except in incremental export which
+    // reuses the output recorded for @p_srcFile.
+    QString outputFileName(const QString &p_folder,
+                           const QString &p_name,
+                           const QString &p_srcFile) const;
+
+    // Folders of notebooks and directories are reused in incremental export
+    // if @p_srcFile is empty.
+    QString outputDirName(const QString &p_folder,
+                          const QString &p_name,
+                          const QString &p_srcFile = QString()) const;
+
+    static QByteArray optionHash(const ExportOption &p_opt);
+
     void updatePageLayoutLabel();
 
     bool checkWkhtmltopdfExecutable(const QString &p_file);
@@ -460,6 +501,17 @@ private:
 
     QCheckBox *m_subfolderCB;
 
+    QCheckBox *m_incrementalCB;
+
+    // Also export to these formats from the same rendered pages.
+    QCheckBox *m_extraHTMLCB;
+
+    QCheckBox *m_extraMHTMLCB;
+
+    QCheckBox *m_extraPDFCB;
+
+    QWidget *m_extraFormatsWidget;
+
     QComboBox *m_customSrcFormatCB;
 
     VLineEdit *m_customSuffixEdit;
@@ -492,6 +544,17 @@ private:
     // Asked to stop exporting by user.
     bool m_askedToStop;
 
+    // Number of notes to export, used as the progress range.
+    int m_numOfNotes;
+
+    int m_numOfHandledNotes;
+
+    // Time elapsed since the export started, for the estimation of the remaining time.
+    QElapsedTimer m_exportTimer;
+
+    // Manifest of the output folder in incremental export.
+    VExportManifest m_manifest;
+
     // Exporter used to export PDF and HTML.
     VExporter *m_exporter;
 
@@ -297,7 +297,7 @@ void VFindReplaceDialog::replaceAll()
 
 void VFindReplaceDialog::updateState(DocType p_docType, bool p_editMode)
 {
-    if (p_editMode || p_docType == DocType::Html) {
+    if (p_editMode || p_docType == DocType::Html || p_docType == DocType::Text) {
         m_wholeWordOnlyCheck->setEnabled(true);
         m_regularExpressionCheck->setEnabled(true);
     } else if (p_docType == DocType::Markdown) {
@@ -0,0 +1,96 @@
+#include "vlatencystatsdialog.h"
+
+#include <QtWidgets>
+
+#include "vconfigmanager.h"
+#include "vlatencystats.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+VLatencyStatsDialog::VLatencyStatsDialog(QWidget *p_parent)
+    : QDialog(p_parent)
+{
+    setupUI();
+
+    refresh();
+}
+
+void VLatencyStatsDialog::setupUI()
+{
+    m_enableCB = new QCheckBox(tr("Record latency"));
+    m_enableCB->setToolTip(tr("Record latency of parse and highlight stages of each opened note"));
+    m_enableCB->setChecked(g_config->getEnableLatencyStats());
+    connect(m_enableCB, &QCheckBox::toggled,
+            this, [](bool p_checked) {
+                g_config->setEnableLatencyStats(p_checked);
+            });
+
+    m_reportEdit = new QPlainTextEdit();
+    m_reportEdit->setReadOnly(true);
+    m_reportEdit->setLineWrapMode(QPlainTextEdit::NoWrap);
+    m_reportEdit->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    m_btnBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    connect(m_btnBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QPushButton *refreshBtn = m_btnBox->addButton(tr("Refresh"), QDialogButtonBox::ActionRole);
+    connect(refreshBtn, &QPushButton::clicked,
+            this, &VLatencyStatsDialog::refresh);
+
+    QPushButton *resetBtn = m_btnBox->addButton(tr("Reset"), QDialogButtonBox::ActionRole);
+    connect(resetBtn, &QPushButton::clicked,
+            this, &VLatencyStatsDialog::resetStats);
+
+    QPushButton *dumpBtn = m_btnBox->addButton(tr("Dump"), QDialogButtonBox::ActionRole);
+    dumpBtn->setToolTip(tr("Save the stats to a file"));
+    connect(dumpBtn, &QPushButton::clicked,
+            this, &VLatencyStatsDialog::dumpStats);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout();
+    mainLayout->addWidget(m_enableCB);
+    mainLayout->addWidget(m_reportEdit);
+    mainLayout->addWidget(m_btnBox);
+
+    setLayout(mainLayout);
+    resize(600, 500);
+    setWindowTitle(tr("Editor Latency Stats"));
+}
+
+void VLatencyStatsDialog::refresh()
+{
+    m_reportEdit->setPlainText(VLatencyStats::report());
+}
+
+void VLatencyStatsDialog::resetStats()
+{
+    for (auto stats : VLatencyStats::allStats()) {
+        stats->reset();
+    }
+
+    refresh();
+}
+
+void VLatencyStatsDialog::dumpStats()
+{
+    static QString lastPath = g_config->getDocumentPathOrHomePath();
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Dump Latency Stats"),
+                                                    QDir(lastPath).filePath("vnote_latency.txt"),
+                                                    tr("Text (*.txt)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    lastPath = QFileInfo(fileName).path();
+
+    if (!VLatencyStats::dump(fileName)) {
+        VUtils::showMessage(QMessageBox::Warning,
+                            tr("Warning"),
+                            tr("Fail to dump latency stats to %1.").arg(fileName),
+                            "",
+                            QMessageBox::Ok,
+                            QMessageBox::Ok,
+                            this);
+    }
+}
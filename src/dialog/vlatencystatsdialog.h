@@ -0,0 +1,34 @@
+#ifndef VLATENCYSTATSDIALOG_H
+#define VLATENCYSTATSDIALOG_H
+
+#include <QDialog>
+
+class QPlainTextEdit;
+class QCheckBox;
+class QDialogButtonBox;
+
+// Debug panel to view and dump the latency stats of opened editors.
+class VLatencyStatsDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit VLatencyStatsDialog(QWidget *p_parent = nullptr);
+
+private slots:
+    void refresh();
+
+    void resetStats();
+
+    void dumpStats();
+
+private:
+    void setupUI();
+
+    QCheckBox *m_enableCB;
+
+    QPlainTextEdit *m_reportEdit;
+
+    QDialogButtonBox *m_btnBox;
+};
+
+#endif // VLATENCYSTATSDIALOG_H
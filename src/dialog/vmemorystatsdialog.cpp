@@ -0,0 +1,90 @@
+#include "vmemorystatsdialog.h"
+
+#include <QtWidgets>
+
+#include "vconfigmanager.h"
+#include "vmemorystats.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Time in ms to wait for the web views to report their heap.
+#define WEB_HEAP_SAMPLE_DELAY 500
+
+VMemoryStatsDialog::VMemoryStatsDialog(QWidget *p_parent)
+    : QDialog(p_parent)
+{
+    setupUI();
+
+    sampleAndRefresh();
+}
+
+void VMemoryStatsDialog::setupUI()
+{
+    QLabel *infoLabel = new QLabel(tr("Sizes are estimated from the data held by each part. "
+                                      "Memory of the web views is sampled from their JavaScript heap."));
+    infoLabel->setWordWrap(true);
+
+    m_reportEdit = new QPlainTextEdit();
+    m_reportEdit->setReadOnly(true);
+    m_reportEdit->setLineWrapMode(QPlainTextEdit::NoWrap);
+    m_reportEdit->setFont(QFontDatabase::systemFont(QFontDatabase::FixedFont));
+
+    m_btnBox = new QDialogButtonBox(QDialogButtonBox::Close);
+    connect(m_btnBox, &QDialogButtonBox::rejected, this, &QDialog::reject);
+
+    QPushButton *refreshBtn = m_btnBox->addButton(tr("Refresh"), QDialogButtonBox::ActionRole);
+    connect(refreshBtn, &QPushButton::clicked,
+            this, &VMemoryStatsDialog::sampleAndRefresh);
+
+    QPushButton *exportBtn = m_btnBox->addButton(tr("Export"), QDialogButtonBox::ActionRole);
+    exportBtn->setToolTip(tr("Save the stats to a JSON file"));
+    connect(exportBtn, &QPushButton::clicked,
+            this, &VMemoryStatsDialog::exportStats);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout();
+    mainLayout->addWidget(infoLabel);
+    mainLayout->addWidget(m_reportEdit);
+    mainLayout->addWidget(m_btnBox);
+
+    setLayout(mainLayout);
+    resize(600, 500);
+    setWindowTitle(tr("Memory Stats"));
+}
+
+void VMemoryStatsDialog::refresh()
+{
+    m_reportEdit->setPlainText(VMemoryStats::toString(VMemoryStats::collect()));
+}
+
+void VMemoryStatsDialog::sampleAndRefresh()
+{
+    refresh();
+
+    VMemoryStats::requestWebHeapSizes();
+    QTimer::singleShot(WEB_HEAP_SAMPLE_DELAY, this, SLOT(refresh()));
+}
+
+void VMemoryStatsDialog::exportStats()
+{
+    static QString lastPath = g_config->getDocumentPathOrHomePath();
+    QString fileName = QFileDialog::getSaveFileName(this,
+                                                    tr("Export Memory Stats"),
+                                                    QDir(lastPath).filePath("vnote_memory.json"),
+                                                    tr("JSON (*.json)"));
+    if (fileName.isEmpty()) {
+        return;
+    }
+
+    lastPath = QFileInfo(fileName).path();
+
+    if (!VMemoryStats::dump(fileName)) {
+        VUtils::showMessage(QMessageBox::Warning,
+                            tr("Warning"),
+                            tr("Fail to export memory stats to %1.").arg(fileName),
+                            "",
+                            QMessageBox::Ok,
+                            QMessageBox::Ok,
+                            this);
+    }
+}
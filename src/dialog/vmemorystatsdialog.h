@@ -0,0 +1,33 @@
+#ifndef VMEMORYSTATSDIALOG_H
+#define VMEMORYSTATSDIALOG_H
+
+#include <QDialog>
+
+class QPlainTextEdit;
+class QDialogButtonBox;
+
+// Debug panel to view and export the approximate memory of opened tabs and
+// global caches.
+class VMemoryStatsDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit VMemoryStatsDialog(QWidget *p_parent = nullptr);
+
+private slots:
+    void refresh();
+
+    // Sample the web views and refresh once they reply.
+    void sampleAndRefresh();
+
+    void exportStats();
+
+private:
+    void setupUI();
+
+    QPlainTextEdit *m_reportEdit;
+
+    QDialogButtonBox *m_btnBox;
+};
+
+#endif // VMEMORYSTATSDIALOG_H
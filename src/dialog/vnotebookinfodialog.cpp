@@ -4,6 +4,7 @@
 #include "utils/vutils.h"
 #include "vconfigmanager.h"
 #include "vmetawordlineedit.h"
+#include "vnotebookstatistics.h"
 
 extern VConfigManager *g_config;
 
@@ -20,7 +21,12 @@ VNotebookInfoDialog::VNotebookInfoDialog(const QString &p_title,
     connect(m_nameEdit, &VMetaWordLineEdit::textChanged,
             this, &VNotebookInfoDialog::handleInputChanged);
 
+    connect(VNotebookStatistics::inst(), &VNotebookStatistics::statisticsUpdated,
+            this, &VNotebookInfoDialog::updateStatistics);
+
     handleInputChanged();
+
+    updateStatistics();
 }
 
 void VNotebookInfoDialog::setupUI(const QString &p_title, const QString &p_info)
@@ -48,6 +54,11 @@ void VNotebookInfoDialog::setupUI(const QString &p_title, const QString &p_info)
     validator = new QRegExpValidator(QRegExp(VUtils::c_fileNameRegExp), m_imageFolderEdit);
     m_imageFolderEdit->setValidator(validator);
 
+    m_contentImagesCB = new QCheckBox(tr("Name images by content"));
+    m_contentImagesCB->setToolTip(tr("Name images by the hash of their content so identical "
+                                     "images in the same image folder are stored once"));
+    m_contentImagesCB->setChecked(m_notebook->isContentAddressedImages());
+
     // Attachment folder.
     Q_ASSERT(!m_notebook->getAttachmentFolder().isEmpty());
     m_attachmentFolderEdit = new VLineEdit(m_notebook->getAttachmentFolder());
@@ -65,13 +76,19 @@ void VNotebookInfoDialog::setupUI(const QString &p_title, const QString &p_info)
     QString createdTimeStr = VUtils::displayDateTime(const_cast<VNotebook *>(m_notebook)->getCreatedTimeUtc().toLocalTime());
     QLabel *createdTimeLabel = new QLabel(createdTimeStr);
 
+    // Statistics.
+    m_statisticsLabel = new QLabel();
+    m_statisticsLabel->setWordWrap(true);
+
     QFormLayout *topLayout = new QFormLayout();
     topLayout->addRow(tr("Notebook &name:"), m_nameEdit);
     topLayout->addRow(tr("Notebook &root folder:"), m_pathEdit);
     topLayout->addRow(tr("&Image folder:"), m_imageFolderEdit);
+    topLayout->addRow(m_contentImagesCB);
     topLayout->addRow(tr("Attachment folder:"), m_attachmentFolderEdit);
     topLayout->addRow(tr("Recycle bin folder:"), recycleBinFolderEdit);
     topLayout->addRow(tr("Created time:"), createdTimeLabel);
+    topLayout->addRow(tr("Statistics:"), m_statisticsLabel);
 
     // Warning label.
     m_warnLabel = new QLabel();
@@ -159,9 +176,23 @@ QString VNotebookInfoDialog::getImageFolder() const
     return m_imageFolderEdit->text();
 }
 
+bool VNotebookInfoDialog::getContentAddressedImages() const
+{
+    return m_contentImagesCB->isChecked();
+}
+
 void VNotebookInfoDialog::showEvent(QShowEvent *p_event)
 {
     m_nameEdit->setFocus();
     QDialog::showEvent(p_event);
 }
 
+void VNotebookInfoDialog::updateStatistics()
+{
+    VNoteStatistics stats;
+    if (VNotebookStatistics::inst()->fetchStatistics(m_notebook, m_notebook->getPath(), stats)) {
+        m_statisticsLabel->setText(VNotebookStatistics::toString(stats));
+    } else {
+        m_statisticsLabel->setText(tr("Computing..."));
+    }
+}
@@ -5,6 +5,7 @@
 #include <QVector>
 
 class QLabel;
+class QCheckBox;
 class VLineEdit;
 class VMetaWordLineEdit;
 class QDialogButtonBox;
@@ -26,10 +27,15 @@ public:
     // Empty string indicates using global config.
     QString getImageFolder() const;
 
+    // Whether to name images by content.
+    bool getContentAddressedImages() const;
+
 private slots:
     // Handle the change of the name and path input.
     void handleInputChanged();
 
+    void updateStatistics();
+
 protected:
     void showEvent(QShowEvent *p_event) Q_DECL_OVERRIDE;
 
@@ -41,8 +47,10 @@ private:
     VMetaWordLineEdit *m_nameEdit;
     VLineEdit *m_pathEdit;
     VLineEdit *m_imageFolderEdit;
+    QCheckBox *m_contentImagesCB;
     // Read-only.
     VLineEdit *m_attachmentFolderEdit;
+    QLabel *m_statisticsLabel;
     QLabel *m_warnLabel;
     QDialogButtonBox *m_btnBox;
     const QVector<VNotebook *> &m_notebooks;
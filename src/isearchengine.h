@@ -4,6 +4,7 @@
 #include <QObject>
 #include <QVector>
 #include <QList>
+#include <QStringList>
 
 #include "vsearchconfig.h"
 
@@ -29,6 +30,23 @@ public:
 
     virtual void clear() = 0;
 
+    // Whether engine accepts more items via appendSecondPhaseItems() after
+    // search() is called with VSearchResult::m_secondPhasePending set.
+    virtual bool isStreamingSupported() const
+    {
+        return false;
+    }
+
+    virtual void appendSecondPhaseItems(const QStringList &p_items)
+    {
+        Q_UNUSED(p_items);
+    }
+
+    // No more items will be appended.
+    virtual void endSecondPhaseItems()
+    {
+    }
+
 signals:
     void finished(const QSharedPointer<VSearchResult> &p_result);
 
@@ -11,11 +11,14 @@
 #include <QSslSocket>
 #include <QOpenGLContext>
 #include <QProcess>
+#include <QTimer>
 
 #include "utils/vutils.h"
 #include "vsingleinstanceguard.h"
 #include "vconfigmanager.h"
 #include "vpalette.h"
+#include "vbenchmark.h"
+#include "vbatchrunner.h"
 
 VConfigManager *g_config;
 
@@ -120,7 +123,15 @@ void VLogger(QtMsgType type, const QMessageLogContext &context, const QString &m
 int main(int argc, char *argv[])
 {
     VSingleInstanceGuard guard;
-    bool canRun = guard.tryRun();
+
+    // Batch mode runs besides other instances without the main window.
+    bool batch = VBatchRunner::isBatchMode(argc, argv);
+    bool canRun = batch || guard.tryRun();
+
+    if (batch && qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        // Run without a display.
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    }
 
     QTextCodec *codec = QTextCodec::codecForName("UTF8");
     if (codec) {
@@ -164,7 +175,28 @@ int main(int argc, char *argv[])
     // The file path passed via command line arguments.
     QStringList filePaths = VUtils::filterFilePathsToOpen(app.arguments().mid(1));
 
+    VBenchmark::Option benchmarkOpt;
+    bool benchmark = VBenchmark::parseArguments(app.arguments(), benchmarkOpt);
+    if (benchmark) {
+        filePaths.clear();
+    }
+
+    VBatchRunner::Option batchOpt;
+    if (batch) {
+        if (!VBatchRunner::parseArguments(app.arguments(), batchOpt)) {
+            qWarning() << "invalid batch arguments";
+            return -1;
+        }
+
+        filePaths.clear();
+    }
+
     if (!canRun) {
+        if (benchmark) {
+            qWarning() << "could not run benchmark with another instance of VNote running";
+            return -1;
+        }
+
         // Ask another instance to open files passed in.
         if (!filePaths.isEmpty()) {
             guard.openExternalFiles(filePaths);
@@ -175,6 +207,9 @@ int main(int argc, char *argv[])
         return 0;
     }
 
+    // Start the startup timeline.
+    VUtils::elapsedTime();
+
     VConfigManager vconfig;
     vconfig.initialize();
     g_config = &vconfig;
@@ -197,6 +232,7 @@ int main(int argc, char *argv[])
     qInstallMessageHandler(VLogger);
 
     qInfo() << "VNote started" << g_config->c_version << QDateTime::currentDateTime().toString();
+    STARTUP_TIME("configurations");
 
     QString locale = VUtils::getLocale();
     // Set default locale.
@@ -249,8 +285,21 @@ int main(int argc, char *argv[])
         app.installTranslator(&translator);
     }
 
+    STARTUP_TIME("translations");
+
     VPalette palette(g_config->getThemeFile());
     g_palette = &palette;
+    STARTUP_TIME("palette");
+
+    if (batch) {
+        VBatchRunner runner(batchOpt);
+        QObject::connect(&runner, &VBatchRunner::finished,
+                         &app, [](int p_ret) {
+                             QCoreApplication::exit(p_ret);
+                         });
+        QTimer::singleShot(0, &runner, &VBatchRunner::run);
+        return app.exec();
+    }
 
     VMainWindow w(&guard);
     QString style = palette.fetchQtStyleSheet();
@@ -258,7 +307,22 @@ int main(int argc, char *argv[])
         app.setStyleSheet(style);
     }
 
+    STARTUP_TIME("style sheet");
+
+    if (benchmark) {
+        // Run without showing the main window, which the editor suite shows
+        // itself, and exit once finished.
+        VBenchmark bench(benchmarkOpt);
+        QObject::connect(&bench, &VBenchmark::finished,
+                         &app, [](int p_ret) {
+                             QCoreApplication::exit(p_ret);
+                         });
+        QTimer::singleShot(0, &bench, &VBenchmark::run);
+        return app.exec();
+    }
+
     w.show();
+    STARTUP_TIME("show main window");
 
     g_config->setBaseBackground(w.palette().color(QPalette::Window));
 
@@ -2,6 +2,7 @@
 #define MARKDOWNHIGHLIGHTERDATA_H
 
 #include <QTextCharFormat>
+#include <QVector>
 
 #include "vconstants.h"
 
@@ -22,9 +23,9 @@ struct HLUnit
 {
     // Highlight offset @start and @length with style HighlightingStyles[styleIndex]
     // within a QTextBlock
-    unsigned long start;
-    unsigned long length;
-    unsigned int styleIndex;
+    quint32 start;
+    quint32 length;
+    quint32 styleIndex;
 
     bool operator==(const HLUnit &p_a) const
     {
@@ -39,11 +40,166 @@ struct HLUnit
     }
 };
 
+// Read-only view of consecutive HLUnits, such as the units of one block.
+class HLUnitSpan
+{
+public:
+    HLUnitSpan()
+        : m_data(NULL),
+          m_size(0)
+    {
+    }
+
+    HLUnitSpan(const HLUnit *p_data, int p_size)
+        : m_data(p_data),
+          m_size(p_size)
+    {
+    }
+
+    HLUnitSpan(const QVector<HLUnit> &p_units)
+        : m_data(p_units.constData()),
+          m_size(p_units.size())
+    {
+    }
+
+    int size() const
+    {
+        return m_size;
+    }
+
+    bool isEmpty() const
+    {
+        return m_size == 0;
+    }
+
+    const HLUnit &operator[](int p_idx) const
+    {
+        Q_ASSERT(p_idx >= 0 && p_idx < m_size);
+        return m_data[p_idx];
+    }
+
+    const HLUnit *begin() const
+    {
+        return m_data;
+    }
+
+    const HLUnit *end() const
+    {
+        return m_data + m_size;
+    }
+
+    QVector<HLUnit> toVector() const
+    {
+        QVector<HLUnit> units;
+        units.reserve(m_size);
+        for (int i = 0; i < m_size; ++i) {
+            units.append(m_data[i]);
+        }
+
+        return units;
+    }
+
+    bool operator==(const HLUnitSpan &p_other) const
+    {
+        if (m_size != p_other.m_size) {
+            return false;
+        }
+
+        for (int i = 0; i < m_size; ++i) {
+            if (!(m_data[i] == p_other.m_data[i])) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+private:
+    const HLUnit *m_data;
+
+    int m_size;
+};
+
+// Highlight units of all the blocks indexed by block number, stored in one
+// array with the offset of each block to avoid an allocation per block.
+// Built block by block via appendUnit() and endBlock().
+class HLBlockUnits
+{
+public:
+    HLBlockUnits()
+    {
+        m_offsets.append(0);
+    }
+
+    // Number of blocks.
+    int size() const
+    {
+        return m_offsets.size() - 1;
+    }
+
+    HLUnitSpan block(int p_blockNum) const
+    {
+        Q_ASSERT(p_blockNum >= 0 && p_blockNum < size());
+        int start = m_offsets[p_blockNum];
+        return HLUnitSpan(m_units.constData() + start, m_offsets[p_blockNum + 1] - start);
+    }
+
+    void clear()
+    {
+        m_units.clear();
+        m_offsets.clear();
+        m_offsets.append(0);
+    }
+
+    void reserve(int p_numOfBlocks, int p_numOfUnits)
+    {
+        m_offsets.reserve(p_numOfBlocks + 1);
+        m_units.reserve(p_numOfUnits);
+    }
+
+    // Append @p_unit to the block being built.
+    void appendUnit(const HLUnit &p_unit)
+    {
+        m_units.append(p_unit);
+    }
+
+    // Finish the block being built and start the next one.
+    void endBlock()
+    {
+        m_offsets.append(m_units.size());
+    }
+
+    void appendBlock(const HLUnitSpan &p_units)
+    {
+        for (auto const & unit : p_units) {
+            m_units.append(unit);
+        }
+
+        endBlock();
+    }
+
+    // Bytes allocated for the units and offsets.
+    qint64 approximateBytes() const
+    {
+        return (qint64)m_units.capacity() * sizeof(HLUnit)
+               + (qint64)m_offsets.capacity() * sizeof(int);
+    }
+
+private:
+    QVector<HLUnit> m_units;
+
+    // Start of the units of each block in m_units, with the end of the last
+    // block appended.
+    QVector<int> m_offsets;
+};
+
+// Highlight unit of code blocks.
+// @style is the ID in VCodeBlockStyleTable.
 struct HLUnitStyle
 {
-    unsigned long start;
-    unsigned long length;
-    QString style;
+    quint32 start;
+    quint32 length;
+    int style;
 
     bool operator==(const HLUnitStyle &p_a) const
     {
@@ -155,21 +311,21 @@ struct VTableBlock
 };
 
 
-// Highlight unit with global position and string style name.
+// Highlight unit with global position and style ID in VCodeBlockStyleTable.
 struct HLUnitPos
 {
-    HLUnitPos() : m_position(-1), m_length(-1)
+    HLUnitPos() : m_position(-1), m_length(-1), m_style(-1)
     {
     }
 
-    HLUnitPos(int p_position, int p_length, const QString &p_style)
+    HLUnitPos(int p_position, int p_length, int p_style)
         : m_position(p_position), m_length(p_length), m_style(p_style)
     {
     }
 
     int m_position;
     int m_length;
-    QString m_style;
+    int m_style;
 };
 
 // Denote the region of a certain Markdown element.
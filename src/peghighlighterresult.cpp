@@ -3,22 +3,140 @@
 #include <QTextDocument>
 #include <QTextBlock>
 
-#include "pegmarkdownhighlighter.h"
+#include <algorithm>
+
 #include "utils/vutils.h"
 
+PegDocumentBlocks::PegDocumentBlocks(const QTextDocument *p_doc)
+    : m_doc(p_doc)
+{
+}
+
+int PegDocumentBlocks::blockCount() const
+{
+    return m_doc->blockCount();
+}
+
+int PegDocumentBlocks::characterCount() const
+{
+    return m_doc->characterCount();
+}
+
+int PegDocumentBlocks::findBlock(int p_pos) const
+{
+    QTextBlock block = m_doc->findBlock(p_pos);
+    return block.isValid() ? block.blockNumber() : -1;
+}
+
+int PegDocumentBlocks::blockPosition(int p_blockNum) const
+{
+    return m_doc->findBlockByNumber(p_blockNum).position();
+}
+
+int PegDocumentBlocks::blockLength(int p_blockNum) const
+{
+    return m_doc->findBlockByNumber(p_blockNum).length();
+}
+
+QString PegDocumentBlocks::blockText(int p_blockNum) const
+{
+    return m_doc->findBlockByNumber(p_blockNum).text();
+}
+
+
+PegTextBlocks::PegTextBlocks(const QString &p_text)
+    : m_text(p_text)
+{
+    m_positions.append(0);
+
+    const QChar *data = m_text.constData();
+    for (int i = 0; i < m_text.size(); ++i) {
+        if (data[i] == QChar('\n')) {
+            m_positions.append(i + 1);
+        }
+    }
+}
+
+int PegTextBlocks::blockCount() const
+{
+    return m_positions.size();
+}
+
+int PegTextBlocks::characterCount() const
+{
+    return m_text.size() + 1;
+}
+
+int PegTextBlocks::findBlock(int p_pos) const
+{
+    if (p_pos < 0 || p_pos >= characterCount()) {
+        return -1;
+    }
+
+    auto it = std::upper_bound(m_positions.constBegin(), m_positions.constEnd(), p_pos);
+    return (it - m_positions.constBegin()) - 1;
+}
+
+int PegTextBlocks::blockPosition(int p_blockNum) const
+{
+    return m_positions[p_blockNum];
+}
+
+int PegTextBlocks::blockLength(int p_blockNum) const
+{
+    int end = p_blockNum + 1 < m_positions.size() ? m_positions[p_blockNum + 1]
+                                                  : characterCount();
+    return end - m_positions[p_blockNum];
+}
+
+QString PegTextBlocks::blockText(int p_blockNum) const
+{
+    return m_text.mid(m_positions[p_blockNum], blockLength(p_blockNum) - 1);
+}
+
+
 PegHighlighterFastResult::PegHighlighterFastResult()
     : m_timeStamp(0)
 {
 }
 
-PegHighlighterFastResult::PegHighlighterFastResult(const PegMarkdownHighlighter *p_peg,
+PegHighlighterFastResult::PegHighlighterFastResult(const PegBlocks &p_blocks,
+                                                   const QVector<HighlightingStyle> &p_styles,
                                                    const QSharedPointer<PegParseResult> &p_result)
     : m_timeStamp(p_result->m_timeStamp)
 {
-    PegHighlighterResult::parseBlocksHighlights(m_blocksHighlights, p_peg, p_result);
+    PegHighlighterResult::parseBlocksHighlights(m_blocksHighlights, p_blocks, p_styles, p_result);
 }
 
 
+qint64 PegHighlighterResult::approximateBytes() const
+{
+    qint64 bytes = sizeof(*this) + m_blocksHighlights.approximateBytes();
+
+    for (auto const & units : m_codeBlocksHighlights) {
+        bytes += (qint64)units.capacity() * sizeof(HLUnitStyle);
+    }
+
+    bytes += (qint64)m_imageRegions.capacity() * sizeof(VElementRegion);
+    bytes += (qint64)m_headerRegions.capacity() * sizeof(VElementRegion);
+
+    for (auto const & cb : m_codeBlocks) {
+        bytes += sizeof(VCodeBlock) + (qint64)(cb.m_lang.capacity() + cb.m_text.capacity()) * sizeof(QChar);
+    }
+
+    for (auto const & mb : m_mathjaxBlocks) {
+        bytes += sizeof(VMathjaxBlock) + (qint64)mb.m_text.capacity() * sizeof(QChar);
+    }
+
+    for (auto const & tb : m_tableBlocks) {
+        bytes += sizeof(VTableBlock) + (qint64)tb.m_borders.capacity() * sizeof(int);
+    }
+
+    bytes += (qint64)m_codeBlocksState.size() * (sizeof(int) + sizeof(HighlightBlockState));
+    bytes += (qint64)m_hruleBlocks.size() * sizeof(int);
+    return bytes;
+}
+
 PegHighlighterResult::PegHighlighterResult()
     : m_timeStamp(0),
       m_numOfBlocks(0),
@@ -29,7 +147,8 @@ PegHighlighterResult::PegHighlighterResult()
     m_codeBlockEndExp = QRegularExpression(VUtils::c_fencedCodeBlockEndRegExp);
 }
 
-PegHighlighterResult::PegHighlighterResult(const PegMarkdownHighlighter *p_peg,
+PegHighlighterResult::PegHighlighterResult(const PegBlocks &p_blocks,
+                                           const QVector<HighlightingStyle> &p_styles,
                                            const QSharedPointer<PegParseResult> &p_result)
     : m_timeStamp(p_result->m_timeStamp),
       m_numOfBlocks(p_result->m_numOfBlocks),
@@ -40,114 +159,167 @@ PegHighlighterResult::PegHighlighterResult(const PegMarkdownHighlighter *p_peg,
     m_codeBlockStartExp = QRegularExpression(VUtils::c_fencedCodeBlockStartRegExp);
     m_codeBlockEndExp = QRegularExpression(VUtils::c_fencedCodeBlockEndRegExp);
 
-    parseBlocksHighlights(m_blocksHighlights, p_peg, p_result);
+    parseBlocksHighlights(m_blocksHighlights, p_blocks, p_styles, p_result);
 
     // Implicit sharing.
     m_imageRegions = p_result->m_imageRegions;
     m_headerRegions = p_result->m_headerRegions;
 
-    parseFencedCodeBlocks(p_peg, p_result);
+    parseFencedCodeBlocks(p_blocks, p_result);
 
-    parseMathjaxBlocks(p_peg, p_result);
+    parseMathjaxBlocks(p_blocks, p_result);
 
-    parseHRuleBlocks(p_peg, p_result);
+    parseHRuleBlocks(p_blocks, p_result);
 
     parseTableBlocks(p_result);
 }
 
-static bool compHLUnit(const HLUnit &p_a, const HLUnit &p_b)
+PegHighlighterResult::PegHighlighterResult(const PegBlocks &p_blocks,
+                                           const QVector<HighlightingStyle> &p_styles,
+                                           const QSharedPointer<PegHighlighterResult> &p_old,
+                                           const QSharedPointer<PegParseResult> &p_result,
+                                           int p_firstBlock,
+                                           int p_lastBlock)
+    : m_timeStamp(p_result->m_timeStamp),
+      m_numOfBlocks(p_result->m_numOfBlocks),
+      m_codeBlockHighlightReceived(false),
+      m_codeBlockTimeStamp(0),
+      m_numOfCodeBlockHighlightsToRecv(0)
 {
-    if (p_a.start < p_b.start) {
-        return true;
-    } else if (p_a.start == p_b.start) {
-        return p_a.length > p_b.length;
-    } else {
-        return false;
+    m_codeBlockStartExp = QRegularExpression(VUtils::c_fencedCodeBlockStartRegExp);
+    m_codeBlockEndExp = QRegularExpression(VUtils::c_fencedCodeBlockEndRegExp);
+
+    // Only blocks within the range will be filled.
+    HLBlockUnits newHls;
+    parseBlocksHighlights(newHls, p_blocks, p_styles, p_result);
+
+    const HLBlockUnits &oldHls = p_old->m_blocksHighlights;
+    int blockDelta = m_numOfBlocks - p_old->m_numOfBlocks;
+    for (int i = 0; i < m_numOfBlocks; ++i) {
+        int oldIdx = -1;
+        if (i < p_firstBlock) {
+            oldIdx = i;
+        } else if (i > p_lastBlock) {
+            oldIdx = i - blockDelta;
+        }
+
+        if (oldIdx >= 0 && oldIdx < oldHls.size()) {
+            m_blocksHighlights.appendBlock(oldHls.block(oldIdx));
+        } else {
+            m_blocksHighlights.appendBlock(newHls.block(i));
+        }
     }
+
+    // Implicit sharing.
+    m_imageRegions = p_result->m_imageRegions;
+    m_headerRegions = p_result->m_headerRegions;
+
+    parseFencedCodeBlocks(p_blocks, p_result);
+
+    parseMathjaxBlocks(p_blocks, p_result);
+
+    parseHRuleBlocks(p_blocks, p_result);
+
+    parseTableBlocks(p_result);
 }
 
-void PegHighlighterResult::parseBlocksHighlights(QVector<QVector<HLUnit>> &p_blocksHighlights,
-                                                 const PegMarkdownHighlighter *p_peg,
-                                                 const QSharedPointer<PegParseResult> &p_result)
+// Sort by block, then by start position and length.
+static bool compBlockHLUnit(const QPair<int, HLUnit> &p_a, const QPair<int, HLUnit> &p_b)
 {
-    p_blocksHighlights.resize(p_result->m_numOfBlocks);
-    if (p_result->isEmpty()) {
-        return;
+    if (p_a.first != p_b.first) {
+        return p_a.first < p_b.first;
+    } else if (p_a.second.start != p_b.second.start) {
+        return p_a.second.start < p_b.second.start;
+    } else {
+        return p_a.second.length > p_b.second.length;
     }
+}
 
-    int offset = p_result->m_offset;
-    const QTextDocument *doc = p_peg->getDocument();
-    const QVector<HighlightingStyle> &styles = p_peg->getStyles();
-    auto pmhResult = p_result->m_pmhElements;
-    for (int i = 0; i < styles.size(); i++)
-    {
-        const HighlightingStyle &style = styles[i];
-        pmh_element *elem_cursor = pmhResult[style.type];
-        while (elem_cursor != NULL)
+void PegHighlighterResult::parseBlocksHighlights(HLBlockUnits &p_blocksHighlights,
+                                                 const PegBlocks &p_blocks,
+                                                 const QVector<HighlightingStyle> &p_styles,
+                                                 const QSharedPointer<PegParseResult> &p_result)
+{
+    p_blocksHighlights.clear();
+
+    int numOfBlocks = p_result->m_numOfBlocks;
+    QVector<QPair<int, HLUnit>> units;
+    if (!p_result->isEmpty()) {
+        int offset = p_result->m_offset;
+        auto pmhResult = p_result->m_pmhElements;
+        for (int i = 0; i < p_styles.size(); i++)
         {
-            // elem_cursor->pos and elem_cursor->end is the start
-            // and end position of the element in document.
-            if (elem_cursor->end <= elem_cursor->pos) {
+            const HighlightingStyle &style = p_styles[i];
+            pmh_element *elem_cursor = pmhResult[style.type];
+            while (elem_cursor != NULL)
+            {
+                // elem_cursor->pos and elem_cursor->end is the start
+                // and end position of the element in document.
+                if (elem_cursor->end <= elem_cursor->pos) {
+                    elem_cursor = elem_cursor->next;
+                    continue;
+                }
+
+                parseBlocksHighlightOne(units,
+                                        numOfBlocks,
+                                        p_blocks,
+                                        offset + elem_cursor->pos,
+                                        offset + elem_cursor->end,
+                                        i);
                 elem_cursor = elem_cursor->next;
-                continue;
             }
-
-            parseBlocksHighlightOne(p_blocksHighlights,
-                                    doc,
-                                    offset + elem_cursor->pos,
-                                    offset + elem_cursor->end,
-                                    i);
-            elem_cursor = elem_cursor->next;
         }
+
+        std::sort(units.begin(), units.end(), compBlockHLUnit);
     }
 
-    // Sort p_blocksHighlights.
-    for (int i = 0; i < p_blocksHighlights.size(); ++i) {
-        if (p_blocksHighlights[i].size() > 1) {
-            std::sort(p_blocksHighlights[i].begin(), p_blocksHighlights[i].end(), compHLUnit);
+    // Lay out the units block by block.
+    p_blocksHighlights.reserve(numOfBlocks, units.size());
+    int idx = 0;
+    for (int i = 0; i < numOfBlocks; ++i) {
+        for (; idx < units.size() && units[idx].first == i; ++idx) {
+            p_blocksHighlights.appendUnit(units[idx].second);
         }
+
+        p_blocksHighlights.endBlock();
     }
 }
 
-void PegHighlighterResult::parseBlocksHighlightOne(QVector<QVector<HLUnit>> &p_blocksHighlights,
-                                                   const QTextDocument *p_doc,
+void PegHighlighterResult::parseBlocksHighlightOne(QVector<QPair<int, HLUnit>> &p_units,
+                                                   int p_numOfBlocks,
+                                                   const PegBlocks &p_blocks,
                                                    unsigned long p_pos,
                                                    unsigned long p_end,
                                                    int p_styleIndex)
 {
     // When the the highlight element is at the end of document, @p_end will equals
     // to the characterCount.
-    unsigned int nrChar = (unsigned int)p_doc->characterCount();
+    unsigned int nrChar = (unsigned int)p_blocks.characterCount();
     if (p_end >= nrChar && nrChar > 0) {
         p_end = nrChar - 1;
     }
 
-    QTextBlock block = p_doc->findBlock(p_pos);
-    int startBlockNum = block.blockNumber();
-    int endBlockNum = p_doc->findBlock(p_end - 1).blockNumber();
-    if (endBlockNum >= p_blocksHighlights.size()) {
-        endBlockNum = p_blocksHighlights.size() - 1;
+    int startBlockNum = p_blocks.findBlock(p_pos);
+    if (startBlockNum == -1) {
+        return;
     }
 
-    while (block.isValid())
-    {
-        int blockNum = block.blockNumber();
-        if (blockNum > endBlockNum) {
-            break;
-        }
+    int endBlockNum = p_blocks.findBlock(p_end - 1);
+    endBlockNum = qMin(endBlockNum, qMin(p_numOfBlocks, p_blocks.blockCount()) - 1);
 
-        int blockStartPos = block.position();
+    for (int blockNum = startBlockNum; blockNum <= endBlockNum; ++blockNum) {
+        int blockStartPos = p_blocks.blockPosition(blockNum);
         HLUnit unit;
         if (blockNum == startBlockNum) {
             unit.start = p_pos - blockStartPos;
             unit.length = (startBlockNum == endBlockNum) ?
-                          (p_end - p_pos) : (block.length() - unit.start);
+                          (p_end - p_pos) : (p_blocks.blockLength(blockNum) - unit.start);
         } else if (blockNum == endBlockNum) {
             unit.start = 0;
             unit.length = p_end - blockStartPos;
         } else {
             unit.start = 0;
-            unit.length = block.length();
+            unit.length = p_blocks.blockLength(blockNum);
         }
 
         unit.styleIndex = p_styleIndex;
@@ -155,10 +327,8 @@ void PegHighlighterResult::parseBlocksHighlightOne(QVector<QVector<HLUnit>> &p_b
         Q_ASSERT(unit.length > 0);
 
         if (unit.length > 0) {
-            p_blocksHighlights[blockNum].append(unit);
+            p_units.append(qMakePair(blockNum, unit));
         }
-
-        block = block.next();
     }
 }
 
@@ -209,30 +379,27 @@ void PegHighlighterResult::parseBlocksElementRegionOne(QHash<int, QVector<VEleme
 }
 #endif
 
-void PegHighlighterResult::parseFencedCodeBlocks(const PegMarkdownHighlighter *p_peg,
+void PegHighlighterResult::parseFencedCodeBlocks(const PegBlocks &p_blocks,
                                                  const QSharedPointer<PegParseResult> &p_result)
 {
     const QMap<int, VElementRegion> &regs = p_result->m_codeBlockRegions;
 
-    const QTextDocument *doc = p_peg->getDocument();
     VCodeBlock item;
     bool inBlock = false;
     QString marker;
     for (auto it = regs.begin(); it != regs.end(); ++it) {
-        QTextBlock block = doc->findBlock(it.value().m_startPos);
-        int lastBlock = doc->findBlock(it.value().m_endPos - 1).blockNumber();
-        if (lastBlock >= p_result->m_numOfBlocks) {
-            lastBlock = p_result->m_numOfBlocks - 1;
+        int blockNumber = p_blocks.findBlock(it.value().m_startPos);
+        if (blockNumber == -1) {
+            continue;
         }
 
-        while (block.isValid()) {
-            int blockNumber = block.blockNumber();
-            if (blockNumber > lastBlock) {
-                break;
-            }
+        int lastBlock = p_blocks.findBlock(it.value().m_endPos - 1);
+        // The document may have changed.
+        lastBlock = qMin(lastBlock, qMin(p_result->m_numOfBlocks, p_blocks.blockCount()) - 1);
 
+        for (; blockNumber <= lastBlock; ++blockNumber) {
             HighlightBlockState state = HighlightBlockState::Normal;
-            QString text = block.text();
+            QString text = p_blocks.blockText(blockNumber);
             if (inBlock) {
                 item.m_text = item.m_text + "\n" + text;
                 auto match = m_codeBlockEndExp.match(text);
@@ -257,7 +424,7 @@ void PegHighlighterResult::parseFencedCodeBlocks(const PegMarkdownHighlighter *p
 
                     state = HighlightBlockState::CodeBlockStart;
                     item.m_startBlock = blockNumber;
-                    item.m_startPos = block.position();
+                    item.m_startPos = p_blocks.blockPosition(blockNumber);
                     item.m_text = text;
                     item.m_lang = match.captured(3).trimmed();
                 }
@@ -266,8 +433,6 @@ void PegHighlighterResult::parseFencedCodeBlocks(const PegMarkdownHighlighter *p
             if (state != HighlightBlockState::Normal) {
                 m_codeBlocksState.insert(blockNumber, state);
             }
-
-            block = block.next();
         }
     }
 }
@@ -341,32 +506,31 @@ static inline bool isDisplayFormulaRawEnd(const QString &p_text)
     return false;
 }
 
-void PegHighlighterResult::parseMathjaxBlocks(const PegMarkdownHighlighter *p_peg,
+void PegHighlighterResult::parseMathjaxBlocks(const PegBlocks &p_blocks,
                                               const QSharedPointer<PegParseResult> &p_result)
 {
-    const QTextDocument *doc = p_peg->getDocument();
-
     // Inline equations.
     const QVector<VElementRegion> &inlineRegs = p_result->m_inlineEquationRegions;
 
     for (auto it = inlineRegs.begin(); it != inlineRegs.end(); ++it) {
         const VElementRegion &r = *it;
-        QTextBlock block = doc->findBlock(r.m_startPos);
-        if (!block.isValid()) {
+        int blockNum = p_blocks.findBlock(r.m_startPos);
+        if (blockNum == -1) {
             continue;
         }
 
         // Inline equation MUST in one block.
-        if (r.m_endPos - block.position() > block.length()) {
+        int blockPos = p_blocks.blockPosition(blockNum);
+        if (r.m_endPos - blockPos > p_blocks.blockLength(blockNum)) {
             continue;
         }
 
         VMathjaxBlock item;
-        item.m_blockNumber = block.blockNumber();
+        item.m_blockNumber = blockNum;
         item.m_previewedAsBlock = false;
-        item.m_index = r.m_startPos - block.position();
+        item.m_index = r.m_startPos - blockPos;
         item.m_length = r.m_endPos - r.m_startPos;
-        item.m_text = block.text().mid(item.m_index, item.m_length);
+        item.m_text = p_blocks.blockText(blockNum).mid(item.m_index, item.m_length);
         m_mathjaxBlocks.append(item);
     }
 
@@ -379,21 +543,20 @@ void PegHighlighterResult::parseMathjaxBlocks(const PegMarkdownHighlighter *p_pe
     QString rawMarkerStart("\\begin{");
     for (auto it = formulaRegs.begin(); it != formulaRegs.end(); ++it) {
         const VElementRegion &r = *it;
-        QTextBlock block = doc->findBlock(r.m_startPos);
-        int lastBlock = doc->findBlock(r.m_endPos - 1).blockNumber();
-        if (lastBlock >= p_result->m_numOfBlocks) {
-            lastBlock = p_result->m_numOfBlocks - 1;
+        int blockNum = p_blocks.findBlock(r.m_startPos);
+        if (blockNum == -1) {
+            continue;
         }
 
-        while (block.isValid()) {
-            int blockNum = block.blockNumber();
-            if (blockNum > lastBlock) {
-                break;
-            }
+        int lastBlock = p_blocks.findBlock(r.m_endPos - 1);
+        // The document may have changed.
+        lastBlock = qMin(lastBlock, qMin(p_result->m_numOfBlocks, p_blocks.blockCount()) - 1);
 
-            int pib = qMax(r.m_startPos - block.position(), 0);
-            int length = qMin(r.m_endPos - block.position() - pib, block.length() - 1);
-            QString text = block.text().mid(pib, length);
+        for (; blockNum <= lastBlock; ++blockNum) {
+            int blockPos = p_blocks.blockPosition(blockNum);
+            int pib = qMax(r.m_startPos - blockPos, 0);
+            int length = qMin(r.m_endPos - blockPos - pib, p_blocks.blockLength(blockNum) - 1);
+            QString text = p_blocks.blockText(blockNum).mid(pib, length);
             if (inBlock) {
                 item.m_text = item.m_text + "\n" + text;
                 if (text.endsWith(marker)
@@ -426,34 +589,27 @@ void PegHighlighterResult::parseMathjaxBlocks(const PegMarkdownHighlighter *p_pe
                     item.m_text = text;
                 }
             }
-
-            block = block.next();
         }
     }
 }
 
-void PegHighlighterResult::parseHRuleBlocks(const PegMarkdownHighlighter *p_peg,
+void PegHighlighterResult::parseHRuleBlocks(const PegBlocks &p_blocks,
                                             const QSharedPointer<PegParseResult> &p_result)
 {
-    const QTextDocument *doc = p_peg->getDocument();
     const QVector<VElementRegion> &regs = p_result->m_hruleRegions;
 
     for (auto it = regs.begin(); it != regs.end(); ++it) {
-        QTextBlock block = doc->findBlock(it->m_startPos);
-        int lastBlock = doc->findBlock(it->m_endPos - 1).blockNumber();
-        if (lastBlock >= p_result->m_numOfBlocks) {
-            lastBlock = p_result->m_numOfBlocks - 1;
+        int blockNumber = p_blocks.findBlock(it->m_startPos);
+        if (blockNumber == -1) {
+            continue;
         }
 
-        while (block.isValid()) {
-            int blockNumber = block.blockNumber();
-            if (blockNumber > lastBlock) {
-                break;
-            }
+        int lastBlock = p_blocks.findBlock(it->m_endPos - 1);
+        // The document may have changed.
+        lastBlock = qMin(lastBlock, qMin(p_result->m_numOfBlocks, p_blocks.blockCount()) - 1);
 
+        for (; blockNumber <= lastBlock; ++blockNumber) {
             m_hruleBlocks.insert(blockNumber);
-
-            block = block.next();
         }
     }
 }
@@ -3,19 +3,92 @@
 
 #include <QSet>
 #include <QRegularExpression>
+#include <QPair>
 
 #include "vconstants.h"
 #include "pegparser.h"
 
-class PegMarkdownHighlighter;
 class QTextDocument;
 
+// Blocks of the text to highlight, split by '\n' like QTextDocument.
+class PegBlocks
+{
+public:
+    virtual ~PegBlocks()
+    {
+    }
+
+    virtual int blockCount() const = 0;
+
+    // Number of characters including the last paragraph separator.
+    virtual int characterCount() const = 0;
+
+    // Return the number of the block containing @p_pos, or -1.
+    virtual int findBlock(int p_pos) const = 0;
+
+    virtual int blockPosition(int p_blockNum) const = 0;
+
+    // Length of the block including the paragraph separator.
+    virtual int blockLength(int p_blockNum) const = 0;
+
+    virtual QString blockText(int p_blockNum) const = 0;
+};
+
+// Blocks of a document. Should be used in the GUI thread.
+class PegDocumentBlocks : public PegBlocks
+{
+public:
+    explicit PegDocumentBlocks(const QTextDocument *p_doc);
+
+    int blockCount() const Q_DECL_OVERRIDE;
+
+    int characterCount() const Q_DECL_OVERRIDE;
+
+    int findBlock(int p_pos) const Q_DECL_OVERRIDE;
+
+    int blockPosition(int p_blockNum) const Q_DECL_OVERRIDE;
+
+    int blockLength(int p_blockNum) const Q_DECL_OVERRIDE;
+
+    QString blockText(int p_blockNum) const Q_DECL_OVERRIDE;
+
+private:
+    const QTextDocument *m_doc;
+};
+
+// Blocks of a plain text snapshot of the document. Could be used in any thread.
+class PegTextBlocks : public PegBlocks
+{
+public:
+    explicit PegTextBlocks(const QString &p_text);
+
+    int blockCount() const Q_DECL_OVERRIDE;
+
+    int characterCount() const Q_DECL_OVERRIDE;
+
+    int findBlock(int p_pos) const Q_DECL_OVERRIDE;
+
+    int blockPosition(int p_blockNum) const Q_DECL_OVERRIDE;
+
+    int blockLength(int p_blockNum) const Q_DECL_OVERRIDE;
+
+    QString blockText(int p_blockNum) const Q_DECL_OVERRIDE;
+
+private:
+    QString m_text;
+
+    // Start position of each block.
+    QVector<int> m_positions;
+};
+
+
 class PegHighlighterFastResult
 {
 public:
     PegHighlighterFastResult();
 
-    PegHighlighterFastResult(const PegMarkdownHighlighter *p_peg,
+    PegHighlighterFastResult(const PegBlocks &p_blocks,
+                             const QVector<HighlightingStyle> &p_styles,
                              const QSharedPointer<PegParseResult> &p_result);
 
     bool matched(TimeStamp p_timeStamp) const
@@ -30,7 +103,7 @@ public:
 
     TimeStamp m_timeStamp;
 
-    QVector<QVector<HLUnit>> m_blocksHighlights;
+    HLBlockUnits m_blocksHighlights;
 };
 
 
@@ -39,22 +112,39 @@ class PegHighlighterResult
 public:
     PegHighlighterResult();
 
+    // Build the result of @p_result with @p_styles, which could be done in
+    // any thread with PegTextBlocks.
     // TODO: handle p_result->m_offset.
-    PegHighlighterResult(const PegMarkdownHighlighter *p_peg,
+    PegHighlighterResult(const PegBlocks &p_blocks,
+                         const QVector<HighlightingStyle> &p_styles,
                          const QSharedPointer<PegParseResult> &p_result);
 
+    // Used for incremental parse.
+    // @p_result is a partial parse result of blocks [@p_firstBlock, @p_lastBlock]
+    // which has been spliced. Highlights of other blocks are taken from @p_old.
+    PegHighlighterResult(const PegBlocks &p_blocks,
+                         const QVector<HighlightingStyle> &p_styles,
+                         const QSharedPointer<PegHighlighterResult> &p_old,
+                         const QSharedPointer<PegParseResult> &p_result,
+                         int p_firstBlock,
+                         int p_lastBlock);
+
     bool matched(TimeStamp p_timeStamp) const;
 
+    // Bytes held by the highlights and the regions.
+    qint64 approximateBytes() const;
+
     // Parse highlight elements for all the blocks from parse results.
-    static void parseBlocksHighlights(QVector<QVector<HLUnit>> &p_blocksHighlights,
-                                      const PegMarkdownHighlighter *p_peg,
+    static void parseBlocksHighlights(HLBlockUnits &p_blocksHighlights,
+                                      const PegBlocks &p_blocks,
+                                      const QVector<HighlightingStyle> &p_styles,
                                       const QSharedPointer<PegParseResult> &p_result);
 
     TimeStamp m_timeStamp;
 
     int m_numOfBlocks;
 
-    QVector<QVector<HLUnit>> m_blocksHighlights;
+    HLBlockUnits m_blocksHighlights;
 
     // Use another member to store the codeblocks highlights, because the highlight
     // sequence is blockHighlights, regular-expression-based highlihgts, and then
@@ -94,22 +184,24 @@ public:
 
 private:
     // Parse highlight elements for blocks from one parse result.
-    static void parseBlocksHighlightOne(QVector<QVector<HLUnit>> &p_blocksHighlights,
-                                        const QTextDocument *p_doc,
+    // Append the units to @p_units with their block numbers.
+    static void parseBlocksHighlightOne(QVector<QPair<int, HLUnit>> &p_units,
+                                        int p_numOfBlocks,
+                                        const PegBlocks &p_blocks,
                                         unsigned long p_pos,
                                         unsigned long p_end,
                                         int p_styleIndex);
 
     // Parse fenced code blocks from parse results.
-    void parseFencedCodeBlocks(const PegMarkdownHighlighter *p_peg,
+    void parseFencedCodeBlocks(const PegBlocks &p_blocks,
                                const QSharedPointer<PegParseResult> &p_result);
 
     // Parse mathjax blocks from parse results.
-    void parseMathjaxBlocks(const PegMarkdownHighlighter *p_peg,
+    void parseMathjaxBlocks(const PegBlocks &p_blocks,
                             const QSharedPointer<PegParseResult> &p_result);
 
     // Parse HRule blocks from parse results.
-    void parseHRuleBlocks(const PegMarkdownHighlighter *p_peg,
+    void parseHRuleBlocks(const PegBlocks &p_blocks,
                           const QSharedPointer<PegParseResult> &p_result);
 
     // Parse table blocks from parse results.
@@ -1,19 +1,46 @@
 #include "pegmarkdownhighlighter.h"
 
 #include <QTextDocument>
+#include <QTextCursor>
 #include <QTimer>
 #include <QScrollBar>
+#include <QAbstractEventDispatcher>
+
+#include <algorithm>
 
 #include "pegparser.h"
 #include "vconfigmanager.h"
 #include "utils/vutils.h"
 #include "utils/veditutils.h"
 #include "vmdeditor.h"
+#include "vlatencystats.h"
+#include "vcodeblockstyletable.h"
+#include "vnoteprefetcher.h"
 
 extern VConfigManager *g_config;
 
 #define LARGE_BLOCK_NUMBER 1000
 
+// Max number of blocks to re-parse in incremental parse.
+#define MAX_INCREMENTAL_PARSE_BLOCKS 300
+
+// Max number of continuous incremental parses before a full parse.
+#define MAX_INCREMENTAL_PARSES 20
+
+#define MAX_PENDING_CHANGES 100
+
+// Interval of full parse after incremental parse.
+#define FULL_PARSE_INTERVAL 2000
+
+// Time in ms to spend on the tail blocks in one event loop iteration.
+#define HIGHLIGHT_FRAME_BUDGET 8
+
+// Number of blocks to handle between two checks of the budget and pending input.
+#define HIGHLIGHT_CHECK_BLOCKS 16
+
+// Max number of style combinations in the merged formats table.
+#define MAX_MERGED_FORMATS 1024
+
 PegMarkdownHighlighter::PegMarkdownHighlighter(QTextDocument *p_doc, VMdEditor *p_editor)
     : QSyntaxHighlighter(p_doc),
       m_doc(p_doc),
@@ -21,14 +48,15 @@ PegMarkdownHighlighter::PegMarkdownHighlighter(QTextDocument *p_doc, VMdEditor *
       m_timeStamp(0),
       m_codeBlockTimeStamp(0),
       m_parser(NULL),
-      m_parserExts(pmh_EXT_NOTES
-                   | pmh_EXT_STRIKE
-                   | pmh_EXT_FRONTMATTER
-                   | pmh_EXT_MARK
-                   | pmh_EXT_TABLE),
+      m_parserExts(parserExtensions(false)),
       m_parseInterval(50),
       m_notifyHighlightComplete(false),
-      m_fastParseInterval(30)
+      m_notifyTailComplete(false),
+      m_parseEnabled(true),
+      m_snapshotValid(false),
+      m_fastParseInterval(30),
+      m_pendingChangesOverflow(false),
+      m_numOfIncrementalParses(0)
 {
 }
 
@@ -38,11 +66,11 @@ void PegMarkdownHighlighter::init(const QVector<HighlightingStyle> &p_styles,
                                   int p_timerInterval)
 {
     m_styles = p_styles;
+    m_mergedFormats.clear();
     m_codeBlockStyles = p_codeBlockStyles;
+    m_codeBlockFormats = VCodeBlockStyleTable::formatTable(m_codeBlockStyles);
 
-    if (p_mathjaxEnabled) {
-        m_parserExts |= (pmh_EXT_MATH | pmh_EXT_MATH_RAW);
-    }
+    m_parserExts = parserExtensions(p_mathjaxEnabled);
 
     m_parseInterval = p_timerInterval;
 
@@ -87,16 +115,30 @@ void PegMarkdownHighlighter::init(const QVector<HighlightingStyle> &p_styles,
                                m_fastParseInfo.m_charsAdded);
             });
 
+    m_fullParseTimer = new QTimer(this);
+    m_fullParseTimer->setSingleShot(true);
+    m_fullParseTimer->setInterval(FULL_PARSE_INTERVAL);
+    connect(m_fullParseTimer, &QTimer::timeout,
+            this, &PegMarkdownHighlighter::startFullParse);
+
     m_scrollRehighlightTimer = new QTimer(this);
     m_scrollRehighlightTimer->setSingleShot(true);
     m_scrollRehighlightTimer->setInterval(5);
     connect(m_scrollRehighlightTimer, &QTimer::timeout,
             this, [this]() {
-                if (m_result->m_numOfBlocks > LARGE_BLOCK_NUMBER) {
+                // Newly visible blocks take precedence over the tail.
+                if (m_result->m_numOfBlocks > LARGE_BLOCK_NUMBER
+                    || m_tailRehighlightTimer->isActive()) {
                     rehighlightSensitiveBlocks();
                 }
             });
 
+    m_tailRehighlightTimer = new QTimer(this);
+    m_tailRehighlightTimer->setSingleShot(true);
+    m_tailRehighlightTimer->setInterval(0);
+    connect(m_tailRehighlightTimer, &QTimer::timeout,
+            this, &PegMarkdownHighlighter::rehighlightTailChunk);
+
     m_rehighlightTimer = new QTimer(this);
     m_rehighlightTimer->setSingleShot(true);
     m_rehighlightTimer->setInterval(10);
@@ -116,6 +158,10 @@ void PegMarkdownHighlighter::init(const QVector<HighlightingStyle> &p_styles,
 // Do not maintain block data and state here.
 void PegMarkdownHighlighter::highlightBlock(const QString &p_text)
 {
+    if (!m_parseEnabled) {
+        return;
+    }
+
     QSharedPointer<PegHighlighterResult> result(m_result);
 
     QTextBlock block = currentBlock();
@@ -124,7 +170,7 @@ void PegMarkdownHighlighter::highlightBlock(const QString &p_text)
     bool isCodeBlock = currentBlockState() == HighlightBlockState::CodeBlock;
     bool isNewBlock = block.userData() == NULL;
     VTextBlockData *blockData = VTextBlockData::blockData(block);
-    QVector<HLUnit> *cache = &blockData->getBlockHighlightCache();
+    const QVector<HLUnit> &cache = blockData->getBlockHighlightCache();
 
     // Fast parse can not cross multiple empty lines in code block, which
     // cause the wrong parse results.
@@ -146,10 +192,9 @@ void PegMarkdownHighlighter::highlightBlock(const QString &p_text)
             cacheValid = false;
         } else if (blockData->isCacheValid() && blockData->getTimeStamp() == m_timeStamp) {
             // Use the cache to highlight.
-            highlightBlockOne(*cache);
+            highlightBlockCached(blockData, cache, p_text);
         } else {
-            cache->clear();
-            highlightBlockOne(result->m_blocksHighlights, blockNum, cache);
+            highlightBlockCached(blockData, blockHighlights(result->m_blocksHighlights, blockNum), p_text);
         }
     } else {
         // If fast result cover this block, we do not need to use the outdated one.
@@ -170,10 +215,9 @@ void PegMarkdownHighlighter::highlightBlock(const QString &p_text)
                 cacheValid = false;
             } else if (blockData->isCacheValid() && result->matched(blockData->getTimeStamp())) {
                 // Use the cache to highlight.
-                highlightBlockOne(*cache);
+                highlightBlockCached(blockData, cache, p_text);
             } else {
-                cache->clear();
-                highlightBlockOne(result->m_blocksHighlights, blockNum, cache);
+                highlightBlockCached(blockData, blockHighlights(result->m_blocksHighlights, blockNum), p_text);
             }
         }
     }
@@ -206,7 +250,7 @@ static bool containSpecialChar(const QString &p_str)
            || la == '`' || la == '$' || la == '~' || la == '*' || la == '_';
 }
 
-bool PegMarkdownHighlighter::preHighlightSingleFormatBlock(const QVector<QVector<HLUnit>> &p_highlights,
+bool PegMarkdownHighlighter::preHighlightSingleFormatBlock(const HLBlockUnits &p_highlights,
                                                            int p_blockNum,
                                                            const QString &p_text,
                                                            bool p_forced)
@@ -224,7 +268,7 @@ bool PegMarkdownHighlighter::preHighlightSingleFormatBlock(const QVector<QVector
         return false;
     }
 
-    const QVector<HLUnit> &units = p_highlights[p_blockNum];
+    HLUnitSpan units = p_highlights.block(p_blockNum);
     if (units.size() == 1) {
         const HLUnit &unit = units[0];
         if (unit.start == 0
@@ -238,18 +282,20 @@ bool PegMarkdownHighlighter::preHighlightSingleFormatBlock(const QVector<QVector
     return false;
 }
 
-bool PegMarkdownHighlighter::highlightBlockOne(const QVector<QVector<HLUnit>> &p_highlights,
+bool PegMarkdownHighlighter::highlightBlockOne(const HLBlockUnits &p_highlights,
                                                int p_blockNum,
                                                QVector<HLUnit> *p_cache)
 {
     bool highlighted = false;
     if (p_highlights.size() > p_blockNum) {
         // units are sorted by start position and length.
-        const QVector<HLUnit> &units = p_highlights[p_blockNum];
+        HLUnitSpan units = p_highlights.block(p_blockNum);
         if (!units.isEmpty()) {
             highlighted = true;
             if (p_cache) {
-                p_cache->append(units);
+                for (auto const & unit : units) {
+                    p_cache->append(unit);
+                }
             }
 
             highlightBlockOne(units);
@@ -259,35 +305,157 @@ bool PegMarkdownHighlighter::highlightBlockOne(const QVector<QVector<HLUnit>> &p
     return highlighted;
 }
 
-void PegMarkdownHighlighter::highlightBlockOne(const QVector<HLUnit> &p_units)
+void PegMarkdownHighlighter::highlightBlockOne(const HLUnitSpan &p_units)
 {
-    for (int i = 0; i < p_units.size(); ++i) {
-        const HLUnit &unit = p_units[i];
-        if (i == 0) {
-            // No need to merge format.
-            setFormat(unit.start,
-                      unit.length,
-                      m_styles[unit.styleIndex].format);
-        } else {
-            QTextCharFormat newFormat = m_styles[unit.styleIndex].format;
-            for (int j = i - 1; j >= 0; --j) {
-                if (p_units[j].start + p_units[j].length <= unit.start) {
-                    // It won't affect current unit.
-                    continue;
-                } else {
-                    // Merge the format.
-                    QTextCharFormat tmpFormat(newFormat);
-                    newFormat = m_styles[p_units[j].styleIndex].format;
-                    // tmpFormat takes precedence.
-                    newFormat.merge(tmpFormat);
-                }
+    QVector<QTextLayout::FormatRange> formats;
+    mergeFormats(p_units, formats);
+    applyFormats(formats);
+}
+
+HLUnitSpan PegMarkdownHighlighter::blockHighlights(const HLBlockUnits &p_highlights, int p_blockNum)
+{
+    return p_blockNum < p_highlights.size() ? p_highlights.block(p_blockNum) : HLUnitSpan();
+}
+
+void PegMarkdownHighlighter::highlightBlockCached(VTextBlockData *p_data,
+                                                  const HLUnitSpan &p_units,
+                                                  const QString &p_text)
+{
+    // The same units on the same text lead to the same formats, which only
+    // need to be set without merging again.
+    uint textHash = qHash(p_text);
+    if (!p_data->isBlockFormatsCacheMatched(p_units, textHash)) {
+        QVector<QTextLayout::FormatRange> formats;
+        mergeFormats(p_units, formats);
+        // Copy @p_units since it may be the cache itself.
+        p_data->setBlockFormatsCache(p_units.toVector(), textHash, formats);
+    }
+
+    applyFormats(p_data->getBlockFormatsCache());
+}
+
+void PegMarkdownHighlighter::mergeFormats(const HLUnitSpan &p_units,
+                                          QVector<QTextLayout::FormatRange> &p_formats) const
+{
+    if (p_units.size() == 1) {
+        // No need to merge format.
+        QTextLayout::FormatRange range;
+        range.start = p_units[0].start;
+        range.length = p_units[0].length;
+        range.format = m_styles[p_units[0].styleIndex].format;
+        p_formats.append(range);
+        return;
+    }
+
+    // Boundaries of the runs where the covering units change.
+    QVector<quint32> bounds;
+    bounds.reserve(p_units.size() * 2);
+    for (auto const & unit : p_units) {
+        bounds.append(unit.start);
+        bounds.append(unit.start + unit.length);
+    }
+
+    std::sort(bounds.begin(), bounds.end());
+    bounds.erase(std::unique(bounds.begin(), bounds.end()), bounds.end());
+
+    p_formats.reserve(bounds.size());
+
+    // Units covering current run in the order of @p_units, which are sorted
+    // by start position so the later ones take precedence.
+    QVector<int> active;
+    QVector<quint32> styles;
+    QVector<quint32> lastStyles;
+    int next = 0;
+    for (int i = 0; i < bounds.size() - 1; ++i) {
+        quint32 start = bounds[i];
+        quint32 end = bounds[i + 1];
+
+        for (int j = active.size() - 1; j >= 0; --j) {
+            const HLUnit &unit = p_units[active[j]];
+            if (unit.start + unit.length <= start) {
+                active.remove(j);
+            }
+        }
+
+        while (next < p_units.size() && p_units[next].start <= start) {
+            if (p_units[next].start + p_units[next].length > start) {
+                active.append(next);
             }
 
-            setFormat(unit.start, unit.length, newFormat);
+            ++next;
+        }
+
+        if (active.isEmpty()) {
+            lastStyles.clear();
+            continue;
+        }
+
+        styles.resize(0);
+        for (auto idx : active) {
+            styles.append(p_units[idx].styleIndex);
         }
+
+        if (styles == lastStyles
+            && !p_formats.isEmpty()
+            && p_formats.last().start + p_formats.last().length == (int)start) {
+            // Extend the last run.
+            p_formats.last().length += end - start;
+            continue;
+        }
+
+        QTextLayout::FormatRange range;
+        range.start = start;
+        range.length = end - start;
+        range.format = styles.size() == 1 ? m_styles[styles[0]].format
+                                          : mergedFormat(styles);
+        p_formats.append(range);
+
+        lastStyles = styles;
     }
 }
 
+const QTextCharFormat &PegMarkdownHighlighter::mergedFormat(const QVector<quint32> &p_styles) const
+{
+    auto it = m_mergedFormats.find(p_styles);
+    if (it != m_mergedFormats.end()) {
+        return it.value();
+    }
+
+    if (m_mergedFormats.size() >= MAX_MERGED_FORMATS) {
+        m_mergedFormats.clear();
+    }
+
+    QTextCharFormat format = m_styles[p_styles[0]].format;
+    for (int i = 1; i < p_styles.size(); ++i) {
+        format.merge(m_styles[p_styles[i]].format);
+    }
+
+    return m_mergedFormats.insert(p_styles, format).value();
+}
+
+void PegMarkdownHighlighter::applyFormats(const QVector<QTextLayout::FormatRange> &p_formats)
+{
+    int limit = highlightLimit();
+    for (auto const & range : p_formats) {
+        if (range.start < limit) {
+            setFormat(range.start, qMin(range.length, limit - range.start), range.format);
+        }
+    }
+}
+
+int PegMarkdownHighlighter::highlightLimit() const
+{
+    // Formats of a long line make it expensive to layout.
+    int length = currentBlock().length() - 1;
+    int longLength = g_config->getLongLineLength();
+    int maxLength = g_config->getLongLineHighlightLength();
+    if (longLength > 0 && maxLength > 0 && length >= longLength) {
+        return maxLength;
+    }
+
+    return length;
+}
+
 #define KEY_PRESS_INTERVAL 50
 
 // highlightBlock() will be called before this function.
@@ -297,12 +465,35 @@ void PegMarkdownHighlighter::handleContentsChange(int p_position, int p_charsRem
 
     int interval = m_contentChangeTime.restart();
 
-    if (p_charsRemoved == 0 && p_charsAdded == 0) {
+    if (!m_parseEnabled || (p_charsRemoved == 0 && p_charsAdded == 0)) {
         return;
     }
 
+    updateSnapshot(p_position, p_charsRemoved, p_charsAdded);
+
     ++m_timeStamp;
 
+    // Tail will be restarted by the new result.
+    m_tailRehighlightTimer->stop();
+
+    if (!m_keystrokeTimer.isValid()) {
+        m_keystrokeTimer.start();
+    }
+
+    if (!m_pendingChangesOverflow) {
+        if (m_pendingChanges.size() >= MAX_PENDING_CHANGES) {
+            m_pendingChanges.clear();
+            m_pendingChangesOverflow = true;
+        } else {
+            ContentChange change;
+            change.m_timeStamp = m_timeStamp;
+            change.m_position = p_position;
+            change.m_charsRemoved = p_charsRemoved;
+            change.m_charsAdded = p_charsAdded;
+            m_pendingChanges.append(change);
+        }
+    }
+
     m_timer->stop();
 
     if (m_timeStamp > 2) {
@@ -318,51 +509,251 @@ void PegMarkdownHighlighter::handleContentsChange(int p_position, int p_charsRem
 
 void PegMarkdownHighlighter::startParse()
 {
+    if (startIncrementalParse()) {
+        return;
+    }
+
+    startFullParse();
+}
+
+void PegMarkdownHighlighter::updateSnapshot(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    if (!m_snapshotValid) {
+        // Will be synced on next parse.
+        return;
+    }
+
+    // Changes may cover the last paragraph separator, which is not in the plain text.
+    int docLength = m_doc->characterCount() - 1;
+    int charsRemoved = qMin(p_charsRemoved, m_snapshot.size() - p_position);
+    int addedEnd = qMin(p_position + p_charsAdded, docLength);
+    if (charsRemoved < 0 || p_position > addedEnd) {
+        m_snapshotValid = false;
+        m_snapshot.clear();
+        return;
+    }
+
+    QString text;
+    if (addedEnd > p_position) {
+        QTextCursor cursor(m_doc);
+        cursor.setPosition(p_position);
+        cursor.setPosition(addedEnd, QTextCursor::KeepAnchor);
+        text = cursor.selectedText();
+
+        // Like QTextDocument::toPlainText().
+        QChar *data = text.data();
+        for (int i = 0; i < text.size(); ++i) {
+            switch (data[i].unicode()) {
+            case QChar::ParagraphSeparator:
+            case QChar::LineSeparator:
+                data[i] = QChar('\n');
+                break;
+
+            case QChar::Nbsp:
+                data[i] = QChar(' ');
+                break;
+
+            default:
+                break;
+            }
+        }
+    }
+
+    m_snapshot.replace(p_position, charsRemoved, text);
+    if (m_snapshot.size() != docLength) {
+        qWarning() << "document snapshot out of sync" << m_snapshot.size() << docLength;
+        m_snapshotValid = false;
+        m_snapshot.clear();
+    }
+}
+
+const QString &PegMarkdownHighlighter::snapshot()
+{
+    if (!m_snapshotValid) {
+        m_snapshot = m_doc->toPlainText();
+        m_snapshotValid = true;
+    }
+
+    return m_snapshot;
+}
+
+int PegMarkdownHighlighter::parserExtensions(bool p_mathjaxEnabled)
+{
+    int exts = pmh_EXT_NOTES
+               | pmh_EXT_STRIKE
+               | pmh_EXT_FRONTMATTER
+               | pmh_EXT_MARK
+               | pmh_EXT_TABLE;
+    if (p_mathjaxEnabled) {
+        exts |= (pmh_EXT_MATH | pmh_EXT_MATH_RAW);
+    }
+
+    return exts;
+}
+
+void PegMarkdownHighlighter::startFullParse()
+{
+    m_fullParseTimer->stop();
+
+    recordParseStart();
+
+    if (m_parseResult.isNull()) {
+        // The note may be parsed already while it was selected.
+        QSharedPointer<PegParseResult> res = VNotePrefetcher::inst()->takeParseResult(snapshot(),
+                                                                                      m_parserExts);
+        if (res) {
+            res->m_timeStamp = m_timeStamp;
+            res->m_highlighterResult->m_timeStamp = m_timeStamp;
+            handleParseResult(res);
+            return;
+        }
+    }
+
     QSharedPointer<PegParseConfig> config(new PegParseConfig());
     config->m_timeStamp = m_timeStamp;
-    config->m_data = m_doc->toPlainText().toUtf8();
+    config->m_text = snapshot();
     config->m_numOfBlocks = m_doc->blockCount();
     config->m_extensions = m_parserExts;
+    config->m_highlightStyles = m_styles;
 
     m_parser->parseAsync(config);
 }
 
-void PegMarkdownHighlighter::startFastParse(int p_position, int p_charsRemoved, int p_charsAdded)
+bool PegMarkdownHighlighter::startIncrementalParse()
 {
-    // Get affected block range.
+    if (m_parseResult.isNull()
+        || m_pendingChangesOverflow
+        || m_pendingChanges.isEmpty()
+        || m_numOfIncrementalParses >= MAX_INCREMENTAL_PARSES) {
+        return false;
+    }
+
+    recordParseStart();
+
+    // Get the dirty range in current document and the number of chars added
+    // since m_result.
+    int start = -1, end = -1, delta = 0;
+    for (auto const & change : m_pendingChanges) {
+        int changeEnd = change.m_position + change.m_charsRemoved;
+        if (start == -1) {
+            start = change.m_position;
+            end = change.m_position + change.m_charsAdded;
+        } else {
+            end = end > changeEnd ? end + change.m_charsAdded - change.m_charsRemoved
+                                  : change.m_position + change.m_charsAdded;
+            start = qMin(start, change.m_position);
+        }
+
+        delta += change.m_charsAdded - change.m_charsRemoved;
+    }
+
+    QTextBlock firstBlock = m_doc->findBlock(start);
+    if (!firstBlock.isValid()) {
+        return false;
+    }
+
+    QTextBlock lastBlock = m_doc->findBlock(end);
+    if (!lastBlock.isValid()) {
+        lastBlock = m_doc->lastBlock();
+    }
+
     int firstBlockNum, lastBlockNum;
-    getFastParseBlockRange(p_position, p_charsRemoved, p_charsAdded, firstBlockNum, lastBlockNum);
+    expandParseBlockRange(firstBlock,
+                          lastBlock,
+                          MAX_INCREMENTAL_PARSE_BLOCKS,
+                          firstBlockNum,
+                          lastBlockNum);
     if (firstBlockNum == -1) {
-        // We could not let m_fastResult NULL here.
-        clearFastParseResult();
-        m_fastParseInterval = 100;
-        return;
-    } else {
-        m_fastParseInterval = (lastBlockNum - firstBlockNum) < 5 ? 0 : 30;
+        return false;
     }
 
-    QString text;
+    // Unbalanced fences will change the code blocks after the range.
+    QRegularExpression fenceReg(VUtils::c_fencedCodeBlockStartRegExp);
+    int nrFences = 0;
     QTextBlock block = m_doc->findBlockByNumber(firstBlockNum);
-    int offset = block.position();
+    int startPos = block.position();
+    int endPos = startPos;
     while (block.isValid()) {
         int blockNum = block.blockNumber();
         if (blockNum > lastBlockNum) {
             break;
-        } else if (blockNum == firstBlockNum) {
-            text = block.text();
-        } else {
-            text = text + "\n" + block.text();
         }
 
+        if (fenceReg.match(block.text()).hasMatch()) {
+            ++nrFences;
+        }
+
+        endPos = block.position() + block.length();
         block = block.next();
     }
 
+    if (nrFences % 2) {
+        return false;
+    }
+
+    // Blocks in the range without the last paragraph separator.
+    QSharedPointer<PegParseConfig> config(new PegParseConfig());
+    config->m_timeStamp = m_timeStamp;
+    config->m_text = snapshot();
+    config->m_textStart = startPos;
+    config->m_textLength = endPos - 1 - startPos;
+    config->m_numOfBlocks = m_doc->blockCount();
+    config->m_offset = startPos;
+    config->m_extensions = m_parserExts;
+    if (firstBlockNum > 0) {
+        // Front matter is valid only at the beginning of the document.
+        config->m_extensions &= ~pmh_EXT_FRONTMATTER;
+    }
+
+    QSharedPointer<PegParseResult> parseRes = m_parser->parse(config);
+    recordParseResult(parseRes);
+    if (!parseRes->splice(*m_parseResult, endPos, delta)) {
+        qDebug() << "incremental parse crosses regions, fall back to full parse";
+        return false;
+    }
+
+    QSharedPointer<PegHighlighterResult> result(new PegHighlighterResult(PegDocumentBlocks(m_doc),
+                                                                         m_styles,
+                                                                         m_result,
+                                                                         parseRes,
+                                                                         firstBlockNum,
+                                                                         lastBlockNum));
+    parseRes->clearPmhElements();
+    m_parseResult = parseRes;
+
+    ++m_numOfIncrementalParses;
+    m_fullParseTimer->start();
+
+    applyResult(result);
+    return true;
+}
+
+void PegMarkdownHighlighter::startFastParse(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    // Get affected block range.
+    int firstBlockNum, lastBlockNum;
+    getFastParseBlockRange(p_position, p_charsRemoved, p_charsAdded, firstBlockNum, lastBlockNum);
+    if (firstBlockNum == -1) {
+        // We could not let m_fastResult NULL here.
+        clearFastParseResult();
+        m_fastParseInterval = 100;
+        return;
+    } else {
+        m_fastParseInterval = (lastBlockNum - firstBlockNum) < 5 ? 0 : 30;
+    }
+
+    int offset = m_doc->findBlockByNumber(firstBlockNum).position();
+    QTextBlock lastBlock = m_doc->findBlockByNumber(lastBlockNum);
+    int endPos = lastBlock.position() + lastBlock.length() - 1;
+
     m_fastParseBlocks.first = firstBlockNum;
     m_fastParseBlocks.second = lastBlockNum;
 
     QSharedPointer<PegParseConfig> config(new PegParseConfig());
     config->m_timeStamp = m_timeStamp;
-    config->m_data = text.toUtf8();
+    config->m_text = snapshot();
+    config->m_textStart = offset;
+    config->m_textLength = endPos - offset;
     config->m_numOfBlocks = m_doc->blockCount();
     config->m_offset = offset;
     config->m_extensions = m_parserExts;
@@ -374,7 +765,7 @@ void PegMarkdownHighlighter::startFastParse(int p_position, int p_charsRemoved,
 
 void PegMarkdownHighlighter::processFastParseResult(const QSharedPointer<PegParseResult> &p_result)
 {
-    m_fastResult.reset(new PegHighlighterFastResult(this, p_result));
+    m_fastResult.reset(new PegHighlighterFastResult(PegDocumentBlocks(m_doc), m_styles, p_result));
 
     // Add additional single format blocks.
     updateSingleFormatBlocks(m_fastResult->m_blocksHighlights);
@@ -478,14 +869,60 @@ exit:
 void PegMarkdownHighlighter::updateHighlight()
 {
     m_timer->stop();
+    if (!m_parseEnabled) {
+        // Nothing to parse, but the editor still waits for the completion.
+        emit visibleHighlightCompleted();
+        emit highlightCompleted();
+        return;
+    }
+
     if (m_result->matched(m_timeStamp)) {
         // No need to parse again. Already the latest.
         updateCodeBlocks(m_result);
         rehighlightBlocksLater();
         completeHighlight(m_result);
     } else {
-        startParse();
+        startFullParse();
+    }
+}
+
+void PegMarkdownHighlighter::setParseEnabled(bool p_enabled)
+{
+    if (m_parseEnabled == p_enabled) {
+        return;
     }
+
+    m_parseEnabled = p_enabled;
+    if (!m_parseEnabled) {
+        m_timer->stop();
+        m_fastParseTimer->stop();
+        m_fullParseTimer->stop();
+        m_tailRehighlightTimer->stop();
+        m_pendingChanges.clear();
+        m_parser->cancelAsync();
+
+        m_snapshotValid = false;
+        m_snapshot.clear();
+    }
+}
+
+qint64 PegMarkdownHighlighter::approximateBytes() const
+{
+    qint64 bytes = 0;
+    if (m_result) {
+        bytes += m_result->approximateBytes();
+    }
+
+    if (m_fastResult) {
+        bytes += m_fastResult->m_blocksHighlights.approximateBytes();
+    }
+
+    return bytes;
+}
+
+void PegMarkdownHighlighter::setFocused()
+{
+    m_parser->setFocused();
 }
 
 void PegMarkdownHighlighter::handleParseResult(const QSharedPointer<PegParseResult> &p_result)
@@ -494,9 +931,36 @@ void PegMarkdownHighlighter::handleParseResult(const QSharedPointer<PegParseResu
         return;
     }
 
+    recordParseResult(p_result);
+    emit fullParseFinished(p_result->m_parseTime + p_result->m_regionParseTime);
+
+    // Usually built by the worker.
+    QSharedPointer<PegHighlighterResult> result = p_result->m_highlighterResult;
+    if (result.isNull()) {
+        result.reset(new PegHighlighterResult(PegDocumentBlocks(m_doc), m_styles, p_result));
+    }
+
+    p_result->m_highlighterResult.reset();
+
+    // Keep the regions only for incremental parse.
+    p_result->clearPmhElements();
+    m_parseResult = p_result;
+
+    m_numOfIncrementalParses = 0;
+    if (p_result->m_timeStamp == m_timeStamp) {
+        m_fullParseTimer->stop();
+    }
+
+    applyResult(result);
+}
+
+void PegMarkdownHighlighter::applyResult(const QSharedPointer<PegHighlighterResult> &p_result)
+{
     clearFastParseResult();
 
-    m_result.reset(new PegHighlighterResult(this, p_result));
+    m_result = p_result;
+
+    updatePendingChanges();
 
     m_result->m_codeBlockTimeStamp = nextCodeBlockTimeStamp();
 
@@ -524,10 +988,45 @@ void PegMarkdownHighlighter::handleParseResult(const QSharedPointer<PegParseResu
     }
 }
 
-void PegMarkdownHighlighter::updateSingleFormatBlocks(const QVector<QVector<HLUnit>> &p_highlights)
+void PegMarkdownHighlighter::recordParseStart()
+{
+    if (!m_keystrokeTimer.isValid()) {
+        return;
+    }
+
+    m_editor->getLatencyStats()->record(VLatencyStats::KeystrokeToParse,
+                                        m_keystrokeTimer.nsecsElapsed() / 1000);
+    m_keystrokeTimer.invalidate();
+}
+
+void PegMarkdownHighlighter::recordParseResult(const QSharedPointer<PegParseResult> &p_result)
+{
+    VLatencyStats *stats = m_editor->getLatencyStats();
+    stats->record(VLatencyStats::Parse, p_result->m_parseTime);
+    stats->record(VLatencyStats::RegionParse, p_result->m_regionParseTime);
+}
+
+void PegMarkdownHighlighter::updatePendingChanges()
+{
+    if (m_result->matched(m_timeStamp)) {
+        m_pendingChanges.clear();
+        m_pendingChangesOverflow = false;
+        return;
+    }
+
+    int i = 0;
+    while (i < m_pendingChanges.size()
+           && m_pendingChanges[i].m_timeStamp <= m_result->m_timeStamp) {
+        ++i;
+    }
+
+    m_pendingChanges.remove(0, i);
+}
+
+void PegMarkdownHighlighter::updateSingleFormatBlocks(const HLBlockUnits &p_highlights)
 {
     for (int i = 0; i < p_highlights.size(); ++i) {
-        const QVector<HLUnit> &units = p_highlights[i];
+        HLUnitSpan units = p_highlights.block(i);
         if (units.size() == 1) {
             const HLUnit &unit = units[0];
             if (unit.start == 0 && unit.length > 0) {
@@ -696,18 +1195,22 @@ void PegMarkdownHighlighter::highlightCodeBlock(const QVector<HLUnitStyle> &p_un
 
 void PegMarkdownHighlighter::highlightCodeBlockOne(const QVector<HLUnitStyle> &p_units)
 {
-    QVector<QTextCharFormat *> formats(p_units.size(), NULL);
+    int limit = highlightLimit();
+    QVector<const QTextCharFormat *> formats(p_units.size(), NULL);
     for (int i = 0; i < p_units.size(); ++i) {
         const HLUnitStyle &unit = p_units[i];
-        auto it = m_codeBlockStyles.find(unit.style);
-        if (it == m_codeBlockStyles.end()) {
+        if ((int)unit.start >= limit
+            || unit.style < 0
+            || unit.style >= m_codeBlockFormats.size()
+            || m_codeBlockFormats[unit.style].propertyCount() == 0) {
             continue;
         }
 
-        formats[i] = &(*it);
+        const QTextCharFormat &format = m_codeBlockFormats[unit.style];
+        formats[i] = &format;
 
         QTextCharFormat newFormat = m_codeBlockFormat;
-        newFormat.merge(*it);
+        newFormat.merge(format);
         for (int j = i - 1; j >= 0; --j) {
             if (p_units[j].start + p_units[j].length <= unit.start) {
                 // It won't affect current unit.
@@ -723,7 +1226,7 @@ void PegMarkdownHighlighter::highlightCodeBlockOne(const QVector<HLUnitStyle> &p
             }
         }
 
-        setFormat(unit.start, unit.length, newFormat);
+        setFormat(unit.start, qMin((int)unit.length, limit - (int)unit.start), newFormat);
     }
 }
 
@@ -753,14 +1256,14 @@ void PegMarkdownHighlighter::completeHighlight(QSharedPointer<PegHighlighterResu
 {
     m_notifyHighlightComplete = true;
 
-    if (isMathJaxEnabled()) {
-        emit mathjaxBlocksUpdated(p_result->m_mathjaxBlocks);
+    if (m_structure.isNull() || m_structure->timeStamp() != p_result->m_timeStamp) {
+        m_structure.reset(new VDocumentStructure(*p_result,
+                                                 snapshot(),
+                                                 isMathJaxEnabled(),
+                                                 m_structure));
     }
 
-    emit tableBlocksUpdated(p_result->m_tableBlocks);
-
-    emit imageLinksUpdated(p_result->m_imageRegions);
-    emit headersUpdated(p_result->m_headerRegions);
+    emit structureUpdated(m_structure);
 }
 
 void PegMarkdownHighlighter::getFastParseBlockRange(int p_position,
@@ -780,6 +1283,19 @@ void PegMarkdownHighlighter::getFastParseBlockRange(int p_position,
         lastBlock = m_doc->lastBlock();
     }
 
+    expandParseBlockRange(firstBlock, lastBlock, maxNumOfBlocks, p_firstBlock, p_lastBlock);
+}
+
+void PegMarkdownHighlighter::expandParseBlockRange(QTextBlock p_first,
+                                                   QTextBlock p_last,
+                                                   int p_maxNumOfBlocks,
+                                                   int &p_firstBlock,
+                                                   int &p_lastBlock) const
+{
+    const int maxNumOfBlocks = p_maxNumOfBlocks;
+    QTextBlock firstBlock = p_first;
+    QTextBlock lastBlock = p_last;
+
     int num = lastBlock.blockNumber() - firstBlock.blockNumber() + 1;
     if (num > maxNumOfBlocks) {
         p_firstBlock = p_lastBlock = -1;
@@ -869,6 +1385,17 @@ godown:
     }
 }
 
+void PegMarkdownHighlighter::sensitiveBlockRange(int &p_first, int &p_last) const
+{
+    m_editor->visibleBlockRange(p_first, p_last);
+
+    // Include extra blocks.
+    const int nrUpExtra = 5;
+    const int nrDownExtra = 20;
+    p_first = qMax(0, p_first - nrUpExtra);
+    p_last = qMin(m_doc->blockCount() - 1, p_last + nrDownExtra);
+}
+
 void PegMarkdownHighlighter::rehighlightSensitiveBlocks()
 {
     QTextBlock cb = m_editor->textCursorW().block();
@@ -878,11 +1405,7 @@ void PegMarkdownHighlighter::rehighlightSensitiveBlocks()
 
     bool cursorVisible = cb.blockNumber() >= first && cb.blockNumber() <= last;
 
-    // Include extra blocks.
-    const int nrUpExtra = 5;
-    const int nrDownExtra = 20;
-    first = qMax(0, first - nrUpExtra);
-    last = qMin(m_doc->blockCount() - 1, last + nrDownExtra);
+    sensitiveBlockRange(first, last);
 
     if (rehighlightBlockRange(first, last)) {
         if (cursorVisible) {
@@ -893,23 +1416,103 @@ void PegMarkdownHighlighter::rehighlightSensitiveBlocks()
 
 void PegMarkdownHighlighter::rehighlightBlocks()
 {
-    if (m_result->m_numOfBlocks <= LARGE_BLOCK_NUMBER) {
-        rehighlightBlockRange(0, m_result->m_numOfBlocks - 1);
-    } else {
-        rehighlightSensitiveBlocks();
-    }
+    // Visible blocks first.
+    rehighlightSensitiveBlocks();
 
     if (m_notifyHighlightComplete) {
         m_notifyHighlightComplete = false;
+        m_notifyTailComplete = true;
+        emit visibleHighlightCompleted();
+    }
+
+    // Then the tail in idle-time chunks, starting right below the viewport.
+    int first, last;
+    sensitiveBlockRange(first, last);
+    m_tailRehighlightInfo.m_nextBlock = last + 1;
+    m_tailRehighlightInfo.m_remaining = m_result->m_numOfBlocks - (last - first + 1);
+    if (m_tailRehighlightInfo.m_remaining > 0) {
+        m_tailRehighlightTimer->start();
+    } else {
+        m_tailRehighlightTimer->stop();
+        finishTailRehighlight();
+    }
+}
+
+void PegMarkdownHighlighter::restyle()
+{
+    if (!m_parseEnabled) {
+        return;
+    }
+
+    // Formats merged from the old styles are obsolete.
+    m_mergedFormats.clear();
+
+    QTextBlock block = m_doc->begin();
+    while (block.isValid()) {
+        VTextBlockData *data = static_cast<VTextBlockData *>(block.userData());
+        if (data) {
+            data->setCacheValid(false);
+            data->invalidateBlockFormatsCache();
+            data->setTimeStamp(0);
+            data->setCodeBlockTimeStamp(0);
+        }
+
+        block = block.next();
+    }
+
+    rehighlightBlocks();
+}
+
+void PegMarkdownHighlighter::rehighlightTailChunk()
+{
+    int nrBlocks = m_result->m_numOfBlocks;
+    if (m_tailRehighlightInfo.m_remaining <= 0 || nrBlocks <= 0) {
+        return;
+    }
+
+    if (m_tailRehighlightInfo.m_nextBlock >= nrBlocks) {
+        // Wrap to the blocks above the viewport.
+        m_tailRehighlightInfo.m_nextBlock = 0;
+    }
+
+    int first = m_tailRehighlightInfo.m_nextBlock;
+    int last = qMin(nrBlocks - 1, first + m_tailRehighlightInfo.m_remaining - 1);
+
+    // Blocks already highlighted by scrolling will be skipped.
+    int next = last + 1;
+    rehighlightBlockRange(first, last, &next);
+
+    m_tailRehighlightInfo.m_nextBlock = next;
+    m_tailRehighlightInfo.m_remaining -= next - first;
+    if (m_tailRehighlightInfo.m_remaining > 0) {
+        m_tailRehighlightTimer->start();
+    } else {
+        finishTailRehighlight();
+    }
+}
+
+void PegMarkdownHighlighter::finishTailRehighlight()
+{
+    if (m_notifyTailComplete) {
+        m_notifyTailComplete = false;
         emit highlightCompleted();
     }
 }
 
-bool PegMarkdownHighlighter::rehighlightBlockRange(int p_first, int p_last)
+bool PegMarkdownHighlighter::inputPending()
+{
+    QAbstractEventDispatcher *dispatcher = QAbstractEventDispatcher::instance();
+    return dispatcher && dispatcher->hasPendingEvents();
+}
+
+bool PegMarkdownHighlighter::rehighlightBlockRange(int p_first, int p_last, int *p_nextBlock)
 {
+    QElapsedTimer timer;
+    timer.start();
+
     bool highlighted = false;
     const QHash<int, HighlightBlockState> &cbStates = m_result->m_codeBlocksState;
-    const QVector<QVector<HLUnit>> &hls = m_result->m_blocksHighlights;
+    const HLBlockUnits &hls = m_result->m_blocksHighlights;
     const QVector<QVector<HLUnitStyle>> &cbHls = m_result->m_codeBlocksHighlights;
 
     int nr = 0;
@@ -920,6 +1523,14 @@ bool PegMarkdownHighlighter::rehighlightBlockRange(int p_first, int p_last)
             break;
         }
 
+        if (p_nextBlock
+            && blockNum > p_first
+            && (blockNum - p_first) % HIGHLIGHT_CHECK_BLOCKS == 0
+            && (timer.elapsed() >= HIGHLIGHT_FRAME_BUDGET || inputPending())) {
+            // Let the pending input go first and resume later.
+            break;
+        }
+
         bool needHL = false;
         bool updateTS = false;
         VTextBlockData *data = VTextBlockData::blockData(block);
@@ -927,7 +1538,7 @@ bool PegMarkdownHighlighter::rehighlightBlockRange(int p_first, int p_last)
             needHL = true;
             // Try to find cache.
             if (blockNum < hls.size()) {
-                if (data->isBlockHighlightCacheMatched(hls[blockNum])) {
+                if (data->isBlockHighlightCacheMatched(hls.block(blockNum))) {
                     needHL = false;
                     updateTS = true;
                 }
@@ -966,7 +1577,17 @@ bool PegMarkdownHighlighter::rehighlightBlockRange(int p_first, int p_last)
         block = block.next();
     }
 
+    if (p_nextBlock) {
+        *p_nextBlock = block.isValid() ? block.blockNumber() : p_last + 1;
+    }
+
     qDebug() << "rehighlightBlockRange" << p_first << p_last << nr;
+
+    if (highlighted) {
+        m_editor->getLatencyStats()->record(VLatencyStats::Highlight,
+                                            timer.nsecsElapsed() / 1000);
+    }
+
     return highlighted;
 }
 
@@ -4,10 +4,12 @@
 #include <QSyntaxHighlighter>
 #include <QTextCharFormat>
 #include <QTime>
+#include <QElapsedTimer>
 
 #include "vtextblockdata.h"
 #include "markdownhighlighterdata.h"
 #include "peghighlighterresult.h"
+#include "vdocumentstructure.h"
 
 class PegParser;
 class QTimer;
@@ -47,6 +49,23 @@ public:
 
     const QVector<VCodeBlock> &getCodeBlocks() const;
 
+    // Whether parse the document at all. Disabled for large files, in which
+    // case nothing is highlighted and no regions are reported.
+    void setParseEnabled(bool p_enabled);
+
+    // Make the parses of this document go before the others.
+    void setFocused();
+
+    // Apply the changed styles to the visible blocks first and then the tail
+    // in idle time, without parsing again.
+    void restyle();
+
+    // Bytes held by the highlighter results.
+    qint64 approximateBytes() const;
+
+    // Extensions of the parser used for documents.
+    static int parserExtensions(bool p_mathjaxEnabled);
+
 public slots:
     // Parse and rehighlight immediately.
     void updateHighlight();
@@ -56,22 +75,21 @@ public slots:
     void rehighlightSensitiveBlocks();
 
 signals:
+    // Emitted once the visible blocks are highlighted by a new result.
+    void visibleHighlightCompleted();
+
+    // Emitted once all the blocks are highlighted by a new result.
     void highlightCompleted();
 
     // QVector is implicitly shared.
     void codeBlocksUpdated(TimeStamp p_timeStamp, const QVector<VCodeBlock> &p_codeBlocks);
 
-    // Emitted when image regions have been fetched from a new parsing result.
-    void imageLinksUpdated(const QVector<VElementRegion> &p_imageRegions);
-
-    // Emitted when header regions have been fetched from a new parsing result.
-    void headersUpdated(const QVector<VElementRegion> &p_headerRegions);
+    // Emitted when the highlight of a parse result completes.
+    // The same version may be emitted again on updateHighlight().
+    void structureUpdated(const QSharedPointer<const VDocumentStructure> &p_structure);
 
-    // Emitted when Mathjax blocks updated.
-    void mathjaxBlocksUpdated(const QVector<VMathjaxBlock> &p_mathjaxBlocks);
-
-    // Emitted when table blocks updated.
-    void tableBlocksUpdated(const QVector<VTableBlock> &p_tableBlocks);
+    // Emitted with the time in us of a parse of the whole document.
+    void fullParseFinished(qint64 p_usecs);
 
 protected:
     void highlightBlock(const QString &p_text) Q_DECL_OVERRIDE;
@@ -89,8 +107,43 @@ private:
         int m_charsAdded;
     } m_fastParseInfo;
 
+    // Content change since the document version of m_result.
+    struct ContentChange
+    {
+        TimeStamp m_timeStamp;
+        int m_position;
+        int m_charsRemoved;
+        int m_charsAdded;
+    };
+
+    // Try incremental parse first and fall back to full parse.
     void startParse();
 
+    void startFullParse();
+
+    // Apply a content change to m_snapshot.
+    void updateSnapshot(int p_position, int p_charsRemoved, int p_charsAdded);
+
+    // Get the plain text of the document, syncing m_snapshot if needed.
+    const QString &snapshot();
+
+    // Re-parse only the blocks affected by m_pendingChanges and splice the
+    // results into m_result.
+    // Return false if incremental parse is not applicable.
+    bool startIncrementalParse();
+
+    // Apply a new highlighter result.
+    void applyResult(const QSharedPointer<PegHighlighterResult> &p_result);
+
+    // Drop changes which have been covered by m_result.
+    void updatePendingChanges();
+
+    // Record the latency from the first unparsed content change.
+    void recordParseStart();
+
+    // Record the parse latency of @p_result.
+    void recordParseResult(const QSharedPointer<PegParseResult> &p_result);
+
     void startFastParse(int p_position, int p_charsRemoved, int p_charsAdded);
 
     void clearAllBlocksUserDataAndState(const QSharedPointer<PegHighlighterResult> &p_result);
@@ -132,27 +185,69 @@ private:
                                 int &p_firstBlock,
                                 int &p_lastBlock) const;
 
+    // Expand [@p_first, @p_last] to the boundaries of top-level blocks.
+    // Set both @p_firstBlock and @p_lastBlock to -1 if it exceeds @p_maxNumOfBlocks.
+    void expandParseBlockRange(QTextBlock p_first,
+                               QTextBlock p_last,
+                               int p_maxNumOfBlocks,
+                               int &p_firstBlock,
+                               int &p_lastBlock) const;
+
     void processFastParseResult(const QSharedPointer<PegParseResult> &p_result);
 
-    bool highlightBlockOne(const QVector<QVector<HLUnit>> &p_highlights,
+    bool highlightBlockOne(const HLBlockUnits &p_highlights,
                            int p_blockNum,
                            QVector<HLUnit> *p_cache);
 
-    void highlightBlockOne(const QVector<HLUnit> &p_units);
+    void highlightBlockOne(const HLUnitSpan &p_units);
+
+    // Highlight current block with @p_units via the formats cache of @p_data.
+    void highlightBlockCached(VTextBlockData *p_data,
+                              const HLUnitSpan &p_units,
+                              const QString &p_text);
+
+    // Resolve overlapping units into non-overlapping runs of merged formats.
+    void mergeFormats(const HLUnitSpan &p_units,
+                      QVector<QTextLayout::FormatRange> &p_formats) const;
+
+    // Get the format merged from styles @p_styles, the latter taking
+    // precedence, from @m_mergedFormats.
+    const QTextCharFormat &mergedFormat(const QVector<quint32> &p_styles) const;
+
+    void applyFormats(const QVector<QTextLayout::FormatRange> &p_formats);
+
+    // Position in current block to highlight up to.
+    int highlightLimit() const;
+
+    static HLUnitSpan blockHighlights(const HLBlockUnits &p_highlights, int p_blockNum);
 
     // To avoid line height jitter and code block mess.
-    bool preHighlightSingleFormatBlock(const QVector<QVector<HLUnit>> &p_highlights,
+    bool preHighlightSingleFormatBlock(const HLBlockUnits &p_highlights,
                                        int p_blockNum,
                                        const QString &p_text,
                                        bool p_forced);
 
-    void updateSingleFormatBlocks(const QVector<QVector<HLUnit>> &p_highlights);
+    void updateSingleFormatBlocks(const HLBlockUnits &p_highlights);
 
+    // Rehighlight visible blocks first and then the tail in idle time.
     void rehighlightBlocks();
 
+    // Rehighlight the next slice of the tail blocks within the frame budget.
+    void rehighlightTailChunk();
+
+    // Called once the tail blocks are all rehighlighted.
+    void finishTailRehighlight();
+
+    // Get the range of visible blocks with extra blocks around.
+    void sensitiveBlockRange(int &p_first, int &p_last) const;
+
     void rehighlightBlocksLater();
 
-    bool rehighlightBlockRange(int p_first, int p_last);
+    // If @p_nextBlock is given, stop once the frame budget is used up or there
+    // is pending input, and return the block to resume from in it.
+    bool rehighlightBlockRange(int p_first, int p_last, int *p_nextBlock = NULL);
+
+    static bool inputPending();
 
     TimeStamp nextCodeBlockTimeStamp();
 
@@ -181,8 +276,16 @@ private:
     TimeStamp m_codeBlockTimeStamp;
 
     QVector<HighlightingStyle> m_styles;
+
+    // Indices of styles -> format merged from them, for overlapping units.
+    // Cleared when the styles change.
+    mutable QHash<QVector<quint32>, QTextCharFormat> m_mergedFormats;
+
     QHash<QString, QTextCharFormat> m_codeBlockStyles;
 
+    // Formats of m_codeBlockStyles indexed by style ID.
+    QVector<QTextCharFormat> m_codeBlockFormats;
+
     QTextCharFormat m_codeBlockFormat;
     QTextCharFormat m_colorColumnFormat;
 
@@ -190,6 +293,13 @@ private:
 
     QSharedPointer<PegHighlighterResult> m_result;
 
+    // Structure of m_result passed to the consumers.
+    QSharedPointer<const VDocumentStructure> m_structure;
+
+    // Parse result of m_result without elements.
+    // Used to splice the result of incremental parse.
+    QSharedPointer<PegParseResult> m_parseResult;
+
     QSharedPointer<PegHighlighterFastResult> m_fastResult;
 
     // Block range of fast parse, inclusive.
@@ -212,16 +322,61 @@ private:
 
     QTimer *m_rehighlightTimer;
 
+    // Timer to rehighlight the tail blocks slice by slice.
+    QTimer *m_tailRehighlightTimer;
+
+    struct TailRehighlightInfo
+    {
+        TailRehighlightInfo()
+            : m_nextBlock(0),
+              m_remaining(0)
+        {
+        }
+
+        // Next block to rehighlight.
+        int m_nextBlock;
+
+        // Number of blocks left.
+        int m_remaining;
+    } m_tailRehighlightInfo;
+
     // Blocks have only one format set which occupies the whole block.
     QSet<int> m_singleFormatBlocks;
 
     bool m_notifyHighlightComplete;
 
+    // Emit highlightCompleted() once the tail is rehighlighted.
+    bool m_notifyTailComplete;
+
+    bool m_parseEnabled;
+
+    // Plain text of the document kept up to date by the content changes and
+    // shared with the parse configs.
+    QString m_snapshot;
+
+    // Whether m_snapshot is in sync with the document.
+    bool m_snapshotValid;
+
     // Time since last content change.
     QTime m_contentChangeTime;
 
     // Interval for fast parse timer.
     int m_fastParseInterval;
+
+    // Changes not covered by m_result yet, in the order of happening.
+    QVector<ContentChange> m_pendingChanges;
+
+    // Whether there are too many changes to track.
+    bool m_pendingChangesOverflow;
+
+    // Number of incremental parses since last full parse.
+    int m_numOfIncrementalParses;
+
+    // Timer to trigger a full parse to check consistency after incremental parses.
+    QTimer *m_fullParseTimer;
+
+    // Time since the first content change not parsed yet.
+    QElapsedTimer m_keystrokeTimer;
 };
 
 inline const QVector<VElementRegion> &PegMarkdownHighlighter::getHeaderRegions() const
@@ -1,36 +1,143 @@
 #include "pegparser.h"
 
-enum WorkerState
+#include <QThread>
+#include <QVector>
+#include <QRunnable>
+#include <QSemaphore>
+#include <QElapsedTimer>
+
+#include "peghighlighterresult.h"
+#include "pegparsescheduler.h"
+#include "vtracer.h"
+#include "vtaskexecutor.h"
+
+// Parse regions in parallel for documents with more blocks than this.
+#define PARALLEL_PARSE_BLOCK_NUMBER 1000
+
+// Parse documents in chunks of at least this number of chars in parallel.
+#define CHUNK_PARSE_MIN_SIZE (128 * 1024)
+
+// Queue the subtasks of a parse task, each releasing one resource of a
+// semaphore after run, as Interactive in the task executor.
+static void startSubtasks(const QVector<QRunnable *> &p_tasks)
+{
+    for (auto task : p_tasks) {
+        // Deleted in finishSubtasks().
+        task->setAutoDelete(false);
+        VTaskExecutor::inst()->start(task, VTaskExecutor::Interactive);
+    }
+}
+
+// Wait for the subtasks started by startSubtasks().
+// The ones not started yet are run in current thread, so parse tasks taking
+// all the Interactive slots never wait for subtasks that could not start.
+static void finishSubtasks(const QVector<QRunnable *> &p_tasks, QSemaphore &p_done)
 {
-    Idle,
-    Busy,
-    Cancelled,
-    Finished
-};
+    for (auto task : p_tasks) {
+        if (VTaskExecutor::inst()->cancel(task)) {
+            task->run();
+        }
+    }
 
-void PegParseResult::parse(QAtomicInt &p_stop, bool p_fast)
+    p_done.acquire(p_tasks.size());
+    qDeleteAll(p_tasks);
+}
+
+typedef void (PegParseResult::*RegionParseFunc)(QAtomicInt &);
+
+static void runRegionParsePass(PegParseResult *p_result,
+                               RegionParseFunc p_func,
+                               QAtomicInt &p_stop,
+                               const char *p_name)
 {
-    if (p_fast) {
-        return;
+    V_TRACE("parse", p_name);
+
+    (p_result->*p_func)(p_stop);
+}
+
+// Run one pass of PegParseResult::parse() in the task executor.
+class RegionParseTask : public QRunnable
+{
+public:
+    RegionParseTask(PegParseResult *p_result,
+                    RegionParseFunc p_func,
+                    QAtomicInt &p_stop,
+                    const char *p_name,
+                    QSemaphore &p_done)
+        : m_result(p_result),
+          m_func(p_func),
+          m_stop(p_stop),
+          m_name(p_name),
+          m_done(p_done)
+    {
     }
 
-    parseImageRegions(p_stop);
+    void run() Q_DECL_OVERRIDE
+    {
+        runRegionParsePass(m_result, m_func, m_stop, m_name);
+        m_done.release();
+    }
+
+private:
+    PegParseResult *m_result;
+
+    RegionParseFunc m_func;
 
-    parseHeaderRegions(p_stop);
+    QAtomicInt &m_stop;
 
-    parseFencedCodeBlockRegions(p_stop);
+    const char *m_name;
+
+    QSemaphore &m_done;
+};
 
-    parseInlineEquationRegions(p_stop);
+void PegParseResult::parse(QAtomicInt &p_stop, bool p_fast)
+{
+    if (p_fast) {
+        return;
+    }
 
-    parseDisplayFormulaRegions(p_stop);
+    // Each pass only reads m_pmhElements and writes its own regions.
+    const struct
+    {
+        const char *m_name;
+        RegionParseFunc m_func;
+    } passes[] = {
+        { "image", &PegParseResult::parseImageRegions },
+        { "header", &PegParseResult::parseHeaderRegions },
+        { "codeblock", &PegParseResult::parseFencedCodeBlockRegions },
+        { "inline-equation", &PegParseResult::parseInlineEquationRegions },
+        { "display-formula", &PegParseResult::parseDisplayFormulaRegions },
+        { "hrule", &PegParseResult::parseHRuleRegions },
+        { "table", &PegParseResult::parseTableRegions },
+        { "table-header", &PegParseResult::parseTableHeaderRegions },
+        { "table-border", &PegParseResult::parseTableBorderRegions }
+    };
+    const int nrPasses = sizeof(passes) / sizeof(passes[0]);
+
+    QElapsedTimer timer;
+    timer.start();
+
+    if (m_numOfBlocks < PARALLEL_PARSE_BLOCK_NUMBER || isEmpty()) {
+        for (int i = 0; i < nrPasses; ++i) {
+            runRegionParsePass(this, passes[i].m_func, p_stop, passes[i].m_name);
+        }
+    } else {
+        QSemaphore done;
+        QVector<QRunnable *> tasks;
+        for (int i = 1; i < nrPasses; ++i) {
+            tasks.append(new RegionParseTask(this, passes[i].m_func, p_stop, passes[i].m_name, done));
+        }
 
-    parseHRuleRegions(p_stop);
+        startSubtasks(tasks);
 
-    parseTableRegions(p_stop);
+        // Take the first pass in current thread.
+        runRegionParsePass(this, passes[0].m_func, p_stop, passes[0].m_name);
 
-    parseTableHeaderRegions(p_stop);
+        // Wait for all the tasks even if asked to stop since they access this result.
+        finishSubtasks(tasks, done);
+    }
 
-    parseTableBorderRegions(p_stop);
+    m_regionParseTime = timer.nsecsElapsed() / 1000;
 }
 
 void PegParseResult::parseImageRegions(QAtomicInt &p_stop)
@@ -179,126 +286,147 @@ void PegParseResult::parseRegions(QAtomicInt &p_stop,
     }
 }
 
+// Merge regions of @p_old outside [@p_start, @p_oldEnd) with @p_regs, which are
+// all within the range.
+// Keep the order so that sorted regions are still sorted.
+static bool spliceRegions(QVector<VElementRegion> &p_regs,
+                          const QVector<VElementRegion> &p_old,
+                          int p_start,
+                          int p_oldEnd,
+                          int p_delta)
+{
+    QVector<VElementRegion> before, after;
+    for (auto const & reg : p_old) {
+        if (reg.m_endPos <= p_start) {
+            before.append(reg);
+        } else if (reg.m_startPos >= p_oldEnd) {
+            after.append(VElementRegion(reg.m_startPos + p_delta, reg.m_endPos + p_delta));
+        } else if (reg.m_startPos < p_start || reg.m_endPos > p_oldEnd) {
+            return false;
+        }
+    }
 
-PegParserWorker::PegParserWorker(QObject *p_parent)
-    : QThread(p_parent),
-      m_stop(0),
-      m_state(WorkerState::Idle)
-{
+    before.append(p_regs);
+    before.append(after);
+    p_regs = before;
+    return true;
 }
 
-void PegParserWorker::prepareParse(const QSharedPointer<PegParseConfig> &p_config)
+bool PegParseResult::splice(const PegParseResult &p_old, int p_end, int p_delta)
 {
-    Q_ASSERT(m_parseConfig.isNull());
+    int start = m_offset;
+    int oldEnd = p_end - p_delta;
 
-    m_state = WorkerState::Busy;
-    m_parseConfig = p_config;
-}
+    if (!spliceRegions(m_imageRegions, p_old.m_imageRegions, start, oldEnd, p_delta)
+        || !spliceRegions(m_headerRegions, p_old.m_headerRegions, start, oldEnd, p_delta)
+        || !spliceRegions(m_inlineEquationRegions, p_old.m_inlineEquationRegions, start, oldEnd, p_delta)
+        || !spliceRegions(m_displayFormulaRegions, p_old.m_displayFormulaRegions, start, oldEnd, p_delta)
+        || !spliceRegions(m_hruleRegions, p_old.m_hruleRegions, start, oldEnd, p_delta)
+        || !spliceRegions(m_tableRegions, p_old.m_tableRegions, start, oldEnd, p_delta)
+        || !spliceRegions(m_tableHeaderRegions, p_old.m_tableHeaderRegions, start, oldEnd, p_delta)
+        || !spliceRegions(m_tableBorderRegions, p_old.m_tableBorderRegions, start, oldEnd, p_delta)) {
+        return false;
+    }
 
-void PegParserWorker::reset()
-{
-    m_parseConfig.reset();
-    m_parseResult.reset();
-    m_stop.store(0);
-    m_state = WorkerState::Idle;
-}
+    for (auto it = p_old.m_codeBlockRegions.begin(); it != p_old.m_codeBlockRegions.end(); ++it) {
+        const VElementRegion &reg = it.value();
+        if (reg.m_endPos <= start) {
+            m_codeBlockRegions.insert(it.key(), reg);
+        } else if (reg.m_startPos >= oldEnd) {
+            m_codeBlockRegions.insert(it.key() + p_delta,
+                                      VElementRegion(reg.m_startPos + p_delta, reg.m_endPos + p_delta));
+        } else if (reg.m_startPos < start || reg.m_endPos > oldEnd) {
+            return false;
+        }
+    }
 
-void PegParserWorker::stop()
-{
-    m_stop.store(1);
+    return true;
 }
 
-void PegParserWorker::run()
+QSharedPointer<PegParseResult> PegParser::parseMarkdown(const QSharedPointer<PegParseConfig> &p_config,
+                                                        QAtomicInt &p_stop)
 {
-    Q_ASSERT(m_state == WorkerState::Busy);
+    QSharedPointer<PegParseResult> result(new PegParseResult(p_config));
 
-    m_parseResult = parseMarkdown(m_parseConfig, m_stop);
+    QElapsedTimer timer;
+    timer.start();
 
-    if (isAskedToStop()) {
-        m_state = WorkerState::Cancelled;
-        return;
-    }
+    if (!parseMarkdownInChunks(p_config, result.data())) {
+        p_config->encodeText();
+        if (p_config->m_data.isEmpty()) {
+            return result;
+        }
 
-    m_state = WorkerState::Finished;
-}
+        result->m_arena = pmh_arena_create();
+        result->m_pmhElements = PegParser::parseMarkdownToElements(p_config, result->m_arena);
+    }
 
-QSharedPointer<PegParseResult> PegParserWorker::parseMarkdown(const QSharedPointer<PegParseConfig> &p_config,
-                                                              QAtomicInt &p_stop)
-{
-    QSharedPointer<PegParseResult> result(new PegParseResult(p_config));
+    result->m_parseTime = timer.nsecsElapsed() / 1000;
 
-    if (p_config->m_data.isEmpty()) {
+    if (p_stop.load() == 1) {
         return result;
     }
 
-    result->m_pmhElements = PegParser::parseMarkdownToElements(p_config);
+    result->parse(p_stop, p_config->m_fast);
 
-    if (p_stop.load() == 1) {
+    if (p_stop.load() == 1 || p_config->m_highlightStyles.isEmpty()) {
         return result;
     }
 
-    result->parse(p_stop, p_config->m_fast);
+    // Leave only the applying of formats to the GUI thread.
+    PegTextBlocks blocks(p_config->m_text);
+    result->m_highlighterResult.reset(new PegHighlighterResult(blocks,
+                                                               p_config->m_highlightStyles,
+                                                               result));
+
+    // Keep the regions only for incremental parse.
+    result->clearPmhElements();
 
     return result;
 }
 
-
-#define NUM_OF_THREADS 2
-
 PegParser::PegParser(QObject *p_parent)
     : QObject(p_parent)
 {
-    init();
 }
 
-void PegParser::init()
+PegParser::~PegParser()
 {
-    for (int i = 0; i < NUM_OF_THREADS; ++i) {
-        PegParserWorker *th = new PegParserWorker(this);
-        connect(th, &PegParserWorker::finished,
-                this, [this, th]() {
-                    handleWorkerFinished(th);
-                });
-
-        m_workers.append(th);
-    }
+    cancelAsync();
 }
 
-void PegParser::clear()
+void PegParser::parseAsync(const QSharedPointer<PegParseConfig> &p_config)
 {
-    m_pendingWork.reset();
-
-    for (auto const & th : m_workers) {
-        th->quit();
-        th->wait();
-
-        delete th;
-    }
-
-    m_workers.clear();
+    PegParseScheduler::inst()->schedule(this, p_config);
 }
 
-PegParser::~PegParser()
+void PegParser::cancelAsync()
 {
-    clear();
+    PegParseScheduler::inst()->cancel(this);
 }
 
-void PegParser::parseAsync(const QSharedPointer<PegParseConfig> &p_config)
+void PegParser::setFocused()
 {
-    m_pendingWork = p_config;
-
-    pickWorker();
+    PegParseScheduler::inst()->setFocusedParser(this);
 }
 
 QSharedPointer<PegParseResult> PegParser::parse(const QSharedPointer<PegParseConfig> &p_config)
 {
+    p_config->encodeText();
+
     QSharedPointer<PegParseResult> result(new PegParseResult(p_config));
 
     if (p_config->m_data.isEmpty()) {
         return result;
     }
 
-    result->m_pmhElements = PegParser::parseMarkdownToElements(p_config);
+    QElapsedTimer timer;
+    timer.start();
+
+    result->m_arena = pmh_arena_create();
+    result->m_pmhElements = PegParser::parseMarkdownToElements(p_config, result->m_arena);
+
+    result->m_parseTime = timer.nsecsElapsed() / 1000;
 
     QAtomicInt stop(0);
     result->parse(stop, p_config->m_fast);
@@ -306,62 +434,9 @@ QSharedPointer<PegParseResult> PegParser::parse(const QSharedPointer<PegParseCon
     return result;
 }
 
-void PegParser::handleWorkerFinished(PegParserWorker *p_worker)
-{
-    QSharedPointer<PegParseResult> result;
-    if (p_worker->state() == WorkerState::Finished) {
-        result = p_worker->parseResult();
-    }
-
-    p_worker->reset();
-
-    pickWorker();
-
-    if (!result.isNull()) {
-        emit parseResultReady(result);
-    }
-}
-
-void PegParser::pickWorker()
-{
-    if (m_pendingWork.isNull()) {
-        return;
-    }
-
-    bool allBusy = true;
-    for (auto th : m_workers) {
-        if (th->state() == WorkerState::Idle) {
-            scheduleWork(th, m_pendingWork);
-            m_pendingWork.reset();
-            return;
-        } else if (th->state() != WorkerState::Busy) {
-            allBusy = false;
-        }
-    }
-
-    if (allBusy) {
-        // Need to stop the worker with non-minimal timestamp.
-        int idx = 0;
-        TimeStamp minTS = m_workers[idx]->workTimeStamp();
-
-        if (m_workers.size() > 1) {
-            if (m_workers[1]->workTimeStamp() > minTS) {
-                idx = 1;
-            }
-        }
-
-        m_workers[idx]->stop();
-    }
-}
-
-void PegParser::scheduleWork(PegParserWorker *p_worker,
-                             const QSharedPointer<PegParseConfig> &p_config)
+void PegParser::handleParseFinished(const QSharedPointer<PegParseResult> &p_result)
 {
-    Q_ASSERT(p_worker->state() == WorkerState::Idle);
-
-    p_worker->reset();
-    p_worker->prepareParse(p_config);
-    p_worker->start();
+    emit parseResultReady(p_result);
 }
 
 QVector<VElementRegion> PegParser::parseImageRegions(const QSharedPointer<PegParseConfig> &p_config)
@@ -514,26 +589,244 @@ static QSharedPointer<char> tryFixUnicodeData(const char *p_data)
     return res;
 }
 
-pmh_element **PegParser::parseMarkdownToElements(const QSharedPointer<PegParseConfig> &p_config)
+pmh_element **PegParser::parseMarkdownToElements(const QSharedPointer<PegParseConfig> &p_config,
+                                                 pmh_arena *p_arena)
 {
+    p_config->encodeText();
     if (p_config->m_data.isEmpty()) {
         return NULL;
     }
 
+    return parseDataToElements(p_config->m_data, p_config->m_extensions, p_arena);
+}
+
+pmh_element **PegParser::parseDataToElements(QByteArray &p_data,
+                                             int p_extensions,
+                                             pmh_arena *p_arena)
+{
     pmh_element **pmhResult = NULL;
 
-    // p_config->m_data is encoding in UTF-8.
+    // p_data is encoding in UTF-8.
     // QString stores a string of 16-bit QChars. Unicode characters with code values above 65535 are stored using surrogate pairs, i.e., two consecutive QChars.
     // Hence, a QString using two QChars to save one code value if it's above 65535, with size()
     // returning 2. pmh_markdown_to_elements() will treat it at the size of 1 (expectively).
     // To make it work, we split unicode characters whose code value is above 65535 into two unicode
     // characters whose code value is below 65535.
-    char *data = p_config->m_data.data();
+    char *data = p_data.data();
     QSharedPointer<char> fixedData = tryFixUnicodeData(data);
     if (fixedData) {
         data = fixedData.data();
     }
 
-    pmh_markdown_to_elements(data, p_config->m_extensions, &pmhResult);
+    if (p_arena) {
+        pmh_markdown_to_elements_in_arena(data, p_extensions, p_arena, &pmhResult);
+    } else {
+        pmh_markdown_to_elements(data, p_extensions, &pmhResult);
+    }
+
     return pmhResult;
 }
+
+// Find the starts of the lines with this prefix after at most 3 spaces.
+static bool lineStartsWith(const QStringRef &p_line, const QString &p_prefix)
+{
+    int i = 0;
+    while (i < 3 && i < p_line.size() && p_line.at(i) == ' ') {
+        ++i;
+    }
+
+    return p_line.mid(i).startsWith(p_prefix);
+}
+
+// Find at most @p_nrChunks - 1 positions in @p_text to split it into chunks
+// of similar size which could be parsed independently.
+// A chunk starts at a non-indented line following a blank line outside
+// fenced code blocks and display formulas.
+// Return empty if @p_text contains reference definitions, which affect the
+// links of other chunks.
+static QVector<int> findChunkPoints(const QStringRef &p_text, int p_nrChunks)
+{
+    QVector<int> points;
+    int chunkSize = p_text.size() / p_nrChunks;
+    int nextPoint = chunkSize;
+
+    QChar fenceChar;
+    bool inFence = false;
+    bool inFormula = false;
+    bool prevBlank = false;
+    int pos = 0;
+    while (pos < p_text.size()) {
+        int end = p_text.indexOf('\n', pos);
+        if (end == -1) {
+            end = p_text.size();
+        }
+
+        QStringRef line = p_text.mid(pos, end - pos);
+        QStringRef trimmed = line.trimmed();
+        bool blank = trimmed.isEmpty();
+        if (inFence) {
+            if (lineStartsWith(line, QString(3, fenceChar))) {
+                inFence = false;
+            }
+        } else if (inFormula) {
+            if (trimmed.endsWith("$$")) {
+                inFormula = false;
+            }
+        } else if (!blank) {
+            if (lineStartsWith(line, "```") || lineStartsWith(line, "~~~")) {
+                inFence = true;
+                fenceChar = trimmed.at(0);
+            } else if (lineStartsWith(line, "$$")) {
+                inFormula = trimmed.size() < 4 || !trimmed.endsWith("$$");
+            } else if (lineStartsWith(line, "[") && trimmed.contains("]:")) {
+                return QVector<int>();
+            }
+
+            if (prevBlank
+                && pos >= nextPoint
+                && !line.at(0).isSpace()
+                && !line.startsWith("---")) {
+                points.append(pos);
+                if (points.size() == p_nrChunks - 1) {
+                    // Keep checking for reference definitions.
+                    nextPoint = p_text.size();
+                } else {
+                    nextPoint = pos + chunkSize;
+                }
+            }
+        }
+
+        prevBlank = blank;
+        pos = end + 1;
+    }
+
+    return points;
+}
+
+// Parse one chunk of the document.
+class ChunkParseTask : public QRunnable
+{
+public:
+    ChunkParseTask(const QStringRef &p_text,
+                   int p_extensions,
+                   pmh_arena *p_arena,
+                   pmh_element ***p_result,
+                   QSemaphore *p_done)
+        : m_text(p_text),
+          m_extensions(p_extensions),
+          m_arena(p_arena),
+          m_result(p_result),
+          m_done(p_done)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        QByteArray data = m_text.toUtf8();
+        *m_result = PegParser::parseDataToElements(data, m_extensions, m_arena);
+
+        if (m_done) {
+            m_done->release();
+        }
+    }
+
+private:
+    QStringRef m_text;
+
+    int m_extensions;
+
+    pmh_arena *m_arena;
+
+    pmh_element ***m_result;
+
+    QSemaphore *m_done;
+};
+
+bool PegParser::parseMarkdownInChunks(const QSharedPointer<PegParseConfig> &p_config,
+                                      PegParseResult *p_result)
+{
+    if (p_config->m_fast || !p_config->m_data.isEmpty()) {
+        return false;
+    }
+
+    QStringRef text = p_config->m_text.midRef(p_config->m_textStart, p_config->m_textLength);
+    int nrChunks = qMin(QThread::idealThreadCount(), text.size() / CHUNK_PARSE_MIN_SIZE);
+    if (nrChunks < 2) {
+        return false;
+    }
+
+    QVector<int> points = findChunkPoints(text, nrChunks);
+    if (points.isEmpty()) {
+        return false;
+    }
+
+    points.prepend(0);
+    points.append(text.size());
+    nrChunks = points.size() - 1;
+
+    QVector<pmh_arena *> arenas(nrChunks);
+    QVector<pmh_element **> results(nrChunks, NULL);
+    for (int i = 0; i < nrChunks; ++i) {
+        arenas[i] = pmh_arena_create();
+    }
+
+    QSemaphore done;
+    QVector<QRunnable *> tasks;
+    for (int i = 1; i < nrChunks; ++i) {
+        tasks.append(new ChunkParseTask(text.mid(points[i], points[i + 1] - points[i]),
+                                        p_config->m_extensions,
+                                        arenas[i],
+                                        &results[i],
+                                        &done));
+    }
+
+    startSubtasks(tasks);
+
+    // Take the first chunk in current thread.
+    ChunkParseTask(text.left(points[1]),
+                   p_config->m_extensions,
+                   arenas[0],
+                   &results[0],
+                   NULL).run();
+
+    finishSubtasks(tasks, done);
+
+    // Link the elements of the chunks in order with their offsets fixed.
+    pmh_element **merged = results[0];
+    pmh_element *tails[pmh_NUM_LANG_TYPES];
+    for (int t = 0; t < pmh_NUM_LANG_TYPES; ++t) {
+        tails[t] = merged[t];
+        while (tails[t] && tails[t]->next) {
+            tails[t] = tails[t]->next;
+        }
+    }
+
+    for (int i = 1; i < nrChunks; ++i) {
+        unsigned long offset = points[i];
+        for (int t = 0; t < pmh_NUM_LANG_TYPES; ++t) {
+            pmh_element *elem = results[i][t];
+            if (!elem) {
+                continue;
+            }
+
+            if (tails[t]) {
+                tails[t]->next = elem;
+            } else {
+                merged[t] = elem;
+            }
+
+            while (elem) {
+                elem->pos += offset;
+                elem->end += offset;
+                tails[t] = elem;
+                elem = elem->next;
+            }
+        }
+    }
+
+    p_result->m_arena = arenas[0];
+    p_result->m_chunkArenas = arenas.mid(1);
+    p_result->m_pmhElements = merged;
+
+    return true;
+}
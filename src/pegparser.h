@@ -4,17 +4,20 @@
 #include <QObject>
 
 #include <QSharedPointer>
-#include <QThread>
 #include <QAtomicInt>
 #include <QVector>
 
 #include "vconstants.h"
 #include "markdownhighlighterdata.h"
 
+class PegHighlighterResult;
+
 struct PegParseConfig
 {
     PegParseConfig()
         : m_timeStamp(0),
+          m_textStart(0),
+          m_textLength(-1),
           m_numOfBlocks(0),
           m_offset(0),
           m_extensions(pmh_EXT_NONE),
@@ -22,10 +25,34 @@ struct PegParseConfig
     {
     }
 
+    // Encode the range of m_text into m_data if not yet.
+    // Called in the thread of the parse to keep the GUI thread from the copy.
+    // m_text is kept to build the highlighter result.
+    void encodeText()
+    {
+        if (m_data.isEmpty() && !m_text.isEmpty()) {
+            m_data = m_text.midRef(m_textStart, m_textLength).toUtf8();
+        }
+    }
+
     TimeStamp m_timeStamp;
 
     QByteArray m_data;
 
+    // Snapshot of the document shared with the highlighter, which is used
+    // instead of m_data if m_data is empty.
+    // [m_textStart, m_textStart + m_textLength) of it will be parsed.
+    QString m_text;
+
+    int m_textStart;
+
+    // -1 to parse till the end.
+    int m_textLength;
+
+    // Styles to build the highlighter result from m_text of the whole document
+    // in the worker. Empty to leave it to the highlighter.
+    QVector<HighlightingStyle> m_highlightStyles;
+
     int m_numOfBlocks;
 
     // Offset of m_data in the document.
@@ -50,7 +77,10 @@ struct PegParseResult
         : m_timeStamp(p_config->m_timeStamp),
           m_numOfBlocks(p_config->m_numOfBlocks),
           m_offset(p_config->m_offset),
-          m_pmhElements(NULL)
+          m_pmhElements(NULL),
+          m_arena(NULL),
+          m_parseTime(0),
+          m_regionParseTime(0)
     {
     }
 
@@ -61,7 +91,18 @@ struct PegParseResult
 
     void clearPmhElements()
     {
-        if (m_pmhElements) {
+        if (m_arena) {
+            // Elements are released with the arena.
+            pmh_arena_free(m_arena);
+            m_arena = NULL;
+            m_pmhElements = NULL;
+
+            for (auto arena : m_chunkArenas) {
+                pmh_arena_free(arena);
+            }
+
+            m_chunkArenas.clear();
+        } else if (m_pmhElements) {
             pmh_free_elements(m_pmhElements);
             m_pmhElements = NULL;
         }
@@ -83,8 +124,16 @@ struct PegParseResult
     }
 
     // Parse m_pmhElements.
+    // Passes of regions are independent and run in parallel for large documents.
     void parse(QAtomicInt &p_stop, bool p_fast);
 
+    // This result is parsed from [m_offset, @p_end) of current document.
+    // Splice the regions of @p_old, which is parsed from the whole document
+    // before @p_delta chars were added within the range, into this result so
+    // that this result covers the whole document.
+    // Return false if any region of @p_old crosses the boundaries of the range.
+    bool splice(const PegParseResult &p_old, int p_end, int p_delta);
+
     TimeStamp m_timeStamp;
 
     int m_numOfBlocks;
@@ -93,6 +142,13 @@ struct PegParseResult
 
     pmh_element **m_pmhElements;
 
+    // Arena owning all the elements of m_pmhElements.
+    pmh_arena *m_arena;
+
+    // Arenas of the chunks other than the first one if parsed in chunks.
+    // Their elements are linked into m_pmhElements.
+    QVector<pmh_arena *> m_chunkArenas;
+
     // All image link regions.
     QVector<VElementRegion> m_imageRegions;
 
@@ -124,6 +180,15 @@ struct PegParseResult
     // All table border regions.
     QVector<VElementRegion> m_tableBorderRegions;
 
+    // Time in usecs of parsing Markdown to elements.
+    qint64 m_parseTime;
+
+    // Time in usecs of parse().
+    qint64 m_regionParseTime;
+
+    // Highlighter result built in the worker if requested.
+    QSharedPointer<PegHighlighterResult> m_highlighterResult;
+
 private:
     void parseImageRegions(QAtomicInt &p_stop);
 
@@ -149,64 +214,6 @@ private:
                       bool p_sort = false);
 };
 
-class PegParserWorker : public QThread
-{
-    Q_OBJECT
-public:
-    explicit PegParserWorker(QObject *p_parent = nullptr);
-
-    void prepareParse(const QSharedPointer<PegParseConfig> &p_config);
-
-    void reset();
-
-    int state() const
-    {
-        return m_state;
-    }
-
-    TimeStamp workTimeStamp() const
-    {
-        if (m_parseConfig.isNull()) {
-            return 0;
-        }
-
-        return m_parseConfig->m_timeStamp;
-    }
-
-    const QSharedPointer<PegParseConfig> &parseConfig() const
-    {
-        return m_parseConfig;
-    }
-
-    const QSharedPointer<PegParseResult> &parseResult() const
-    {
-        return m_parseResult;
-    }
-
-public slots:
-    void stop();
-
-protected:
-    void run() Q_DECL_OVERRIDE;
-
-private:
-    QSharedPointer<PegParseResult> parseMarkdown(const QSharedPointer<PegParseConfig> &p_config,
-                                                 QAtomicInt &p_stop);
-
-    bool isAskedToStop() const
-    {
-        return m_stop.load() == 1;
-    }
-
-    QAtomicInt m_stop;
-
-    int m_state;
-
-    QSharedPointer<PegParseConfig> m_parseConfig;
-
-    QSharedPointer<PegParseResult> m_parseResult;
-};
-
 class PegParser : public QObject
 {
     Q_OBJECT
@@ -217,32 +224,45 @@ public:
 
     QSharedPointer<PegParseResult> parse(const QSharedPointer<PegParseConfig> &p_config);
 
+    // Parse on the global scheduler, superseding the pending parse.
     void parseAsync(const QSharedPointer<PegParseConfig> &p_config);
 
+    // Drop the pending and running parses.
+    void cancelAsync();
+
+    // Make the parses of this parser go first.
+    void setFocused();
+
+    // Parse @p_config, checking @p_stop between passes.
+    // Called in the thread of the parse.
+    static QSharedPointer<PegParseResult> parseMarkdown(const QSharedPointer<PegParseConfig> &p_config,
+                                                        QAtomicInt &p_stop);
+
     static QVector<VElementRegion> parseImageRegions(const QSharedPointer<PegParseConfig> &p_config);
 
-    // MUST pmh_free_elements() the result.
-    static pmh_element **parseMarkdownToElements(const QSharedPointer<PegParseConfig> &p_config);
+    // MUST pmh_free_elements() the result if @p_arena is NULL.
+    // Otherwise, elements are allocated in @p_arena and released with it.
+    static pmh_element **parseMarkdownToElements(const QSharedPointer<PegParseConfig> &p_config,
+                                                 pmh_arena *p_arena = NULL);
 
 signals:
     void parseResultReady(const QSharedPointer<PegParseResult> &p_result);
 
-private slots:
-    void handleWorkerFinished(PegParserWorker *p_worker);
-
 private:
-    void init();
-
-    void clear();
-
-    void pickWorker();
+    friend class PegParseScheduler;
 
-    void scheduleWork(PegParserWorker *p_worker, const QSharedPointer<PegParseConfig> &p_config);
+    void handleParseFinished(const QSharedPointer<PegParseResult> &p_result);
 
-    // Maintain a fixed number of workers to pick work.
-    QVector<PegParserWorker *> m_workers;
+    // Parse a huge document in chunks split at top-level blank lines in
+    // parallel into @p_result.
+    // Return false if the document is not suitable to be parsed in chunks.
+    static bool parseMarkdownInChunks(const QSharedPointer<PegParseConfig> &p_config,
+                                      PegParseResult *p_result);
 
-    QSharedPointer<PegParseConfig> m_pendingWork;
+    // Parse UTF-8 @p_data in place.
+    static pmh_element **parseDataToElements(QByteArray &p_data,
+                                             int p_extensions,
+                                             pmh_arena *p_arena);
 };
 
 #endif // PEGPARSER_H
@@ -0,0 +1,189 @@
+#include "pegparsescheduler.h"
+
+#include <QDebug>
+#include <QRunnable>
+#include <QThread>
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QPointer>
+#include <QPair>
+
+#include "pegparser.h"
+#include "vconfigmanager.h"
+#include "vtaskexecutor.h"
+
+extern VConfigManager *g_config;
+
+class PegParseTask : public QRunnable
+{
+public:
+    PegParseTask(PegParseScheduler *p_scheduler,
+                 const QSharedPointer<PegParseScheduler::Job> &p_job)
+        : m_scheduler(p_scheduler),
+          m_job(p_job)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (m_job->m_stop.load() == 0) {
+            m_job->m_result = PegParser::parseMarkdown(m_job->m_config, m_job->m_stop);
+        }
+
+        m_scheduler->finishJob(m_job);
+    }
+
+private:
+    PegParseScheduler *m_scheduler;
+
+    QSharedPointer<PegParseScheduler::Job> m_job;
+};
+
+
+PegParseScheduler::PegParseScheduler(QObject *p_parent)
+    : QObject(p_parent),
+      m_maxThreads(1),
+      m_focusedParser(NULL)
+{
+    int threads = g_config->getMarkdownParseThreads();
+    if (threads <= 0) {
+        // Leave one core to the GUI thread.
+        threads = qMax(1, QThread::idealThreadCount() - 1);
+    }
+
+    m_maxThreads = qMin(threads, VTaskExecutor::inst()->quota(VTaskExecutor::Interactive));
+}
+
+PegParseScheduler::~PegParseScheduler()
+{
+    for (auto const & job : m_running) {
+        job->m_stop.store(1);
+    }
+
+    // Including the cancelled ones still running.
+    VTaskExecutor::inst()->waitForDone(VTaskExecutor::Interactive);
+}
+
+PegParseScheduler *PegParseScheduler::inst()
+{
+    static PegParseScheduler *scheduler = new PegParseScheduler(QCoreApplication::instance());
+    return scheduler;
+}
+
+void PegParseScheduler::schedule(PegParser *p_parser,
+                                 const QSharedPointer<PegParseConfig> &p_config)
+{
+    // A superseded pending parse keeps its place in the queue.
+    if (!m_pending.contains(p_parser)) {
+        m_queue.append(p_parser);
+    }
+
+    m_pending.insert(p_parser, p_config);
+
+    pickJobs();
+}
+
+void PegParseScheduler::cancel(PegParser *p_parser)
+{
+    if (m_pending.remove(p_parser) > 0) {
+        m_queue.removeOne(p_parser);
+    }
+
+    auto it = m_running.find(p_parser);
+    if (it != m_running.end()) {
+        // The worker will find it gone and drop its result.
+        it.value()->m_stop.store(1);
+        m_running.erase(it);
+    }
+
+    if (m_focusedParser == p_parser) {
+        m_focusedParser = NULL;
+    }
+
+    pickJobs();
+}
+
+void PegParseScheduler::setFocusedParser(PegParser *p_parser)
+{
+    m_focusedParser = p_parser;
+}
+
+void PegParseScheduler::pickJobs()
+{
+    while (!m_queue.isEmpty() && m_running.size() < m_maxThreads) {
+        int idx = -1;
+        if (m_focusedParser
+            && !m_running.contains(m_focusedParser)
+            && m_pending.contains(m_focusedParser)) {
+            idx = m_queue.indexOf(m_focusedParser);
+        } else {
+            for (int i = 0; i < m_queue.size(); ++i) {
+                if (!m_running.contains(m_queue[i])) {
+                    idx = i;
+                    break;
+                }
+            }
+        }
+
+        if (idx == -1) {
+            // All the pending parsers are busy.
+            break;
+        }
+
+        PegParser *parser = m_queue.takeAt(idx);
+
+        QSharedPointer<Job> job(new Job());
+        job->m_parser = parser;
+        job->m_config = m_pending.take(parser);
+        job->m_stop.store(0);
+
+        m_running.insert(parser, job);
+        VTaskExecutor::inst()->start(new PegParseTask(this, job), VTaskExecutor::Interactive);
+    }
+}
+
+void PegParseScheduler::finishJob(const QSharedPointer<Job> &p_job)
+{
+    bool needNotify = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        needNotify = m_finished.isEmpty();
+        m_finished.append(p_job);
+    }
+
+    if (needNotify) {
+        QMetaObject::invokeMethod(this, "handleJobsFinished", Qt::QueuedConnection);
+    }
+}
+
+void PegParseScheduler::handleJobsFinished()
+{
+    QVector<QSharedPointer<Job>> jobs;
+    {
+        QMutexLocker locker(&m_mutex);
+        jobs.swap(m_finished);
+    }
+
+    QVector<QPair<QPointer<PegParser>, QSharedPointer<PegParseResult>>> results;
+    for (auto const & job : jobs) {
+        auto it = m_running.find(job->m_parser);
+        if (it == m_running.end() || it.value() != job) {
+            // Cancelled.
+            continue;
+        }
+
+        m_running.erase(it);
+        if (job->m_stop.load() == 0 && !job->m_result.isNull()) {
+            results.append(qMakePair(QPointer<PegParser>(job->m_parser), job->m_result));
+        }
+    }
+
+    pickJobs();
+
+    for (auto const & res : results) {
+        // Handling of a previous result may destroy the parser.
+        if (res.first) {
+            res.first->handleParseFinished(res.second);
+        }
+    }
+}
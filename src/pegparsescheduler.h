@@ -0,0 +1,79 @@
+#ifndef PEGPARSESCHEDULER_H
+#define PEGPARSESCHEDULER_H
+
+#include <QObject>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+
+class PegParser;
+struct PegParseConfig;
+class PegParseResult;
+
+// Run the asynchronous parses of all the PegParsers as Interactive tasks of
+// VTaskExecutor.
+// At most one parse of each parser runs at a time and a later request of a
+// parser supersedes its pending one. Parses of the focused parser go first,
+// then the others in the order of their requests.
+// Should be accessed only in the GUI thread.
+class PegParseScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    ~PegParseScheduler();
+
+    static PegParseScheduler *inst();
+
+    void schedule(PegParser *p_parser, const QSharedPointer<PegParseConfig> &p_config);
+
+    // Drop the pending parse and stop the running parse of @p_parser.
+    void cancel(PegParser *p_parser);
+
+    void setFocusedParser(PegParser *p_parser);
+
+private slots:
+    void handleJobsFinished();
+
+private:
+    friend class PegParseTask;
+
+    struct Job
+    {
+        PegParser *m_parser;
+
+        QSharedPointer<PegParseConfig> m_config;
+
+        QAtomicInt m_stop;
+
+        QSharedPointer<PegParseResult> m_result;
+    };
+
+    explicit PegParseScheduler(QObject *p_parent = nullptr);
+
+    // Start pending parses until the limit is reached.
+    void pickJobs();
+
+    // Called on the worker.
+    void finishJob(const QSharedPointer<Job> &p_job);
+
+    // Max number of parses running at the same time.
+    int m_maxThreads;
+
+    PegParser *m_focusedParser;
+
+    // Parsers with a pending parse in the order of requests.
+    QVector<PegParser *> m_queue;
+
+    QHash<PegParser *, QSharedPointer<PegParseConfig>> m_pending;
+
+    QHash<PegParser *, QSharedPointer<Job>> m_running;
+
+    // Guard m_finished, which is filled by the workers.
+    QMutex m_mutex;
+
+    QVector<QSharedPointer<Job>> m_finished;
+};
+
+#endif // PEGPARSESCHEDULER_H
@@ -29,7 +29,6 @@ var updateHtml = function(html) {
     setupImageView();
 
     var codes = document.getElementsByTagName('code');
-    mermaidIdx = 0;
     flowchartIdx = 0;
     wavedromIdx = 0;
     plantUMLIdx = 0;
@@ -101,7 +100,7 @@ var updateHtml = function(html) {
             MathJax.Hub.Queue(["resetEquationNumbers",MathJax.InputJax.TeX],
                               ["Typeset", MathJax.Hub, contentDiv, postProcessMathJax]);
         } catch (err) {
-            content.setLog("err: " + err);
+            callContent('setLog', "err: " + err);
             finishOneAsyncJob();
         }
     } else {
@@ -111,10 +110,10 @@ var updateHtml = function(html) {
 
 var highlightText = function(text, id, timeStamp) {
     var html = marked(text);
-    content.highlightTextCB(html, id, timeStamp);
+    callContent('highlightTextCB', html, id, timeStamp);
 }
 
-var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+var markdownToHtml = function(text, inlineStyle) {
     var html = marked(text);
     if (inlineStyle) {
         var container = textHtmlDiv;
@@ -123,5 +122,9 @@ var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
         container.innerHTML = "";
     }
 
-    content.textToHtmlCB(identifier, id, timeStamp, html);
+    return html;
+}
+
+var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+    callContent('textToHtmlCB', identifier, id, timeStamp, markdownToHtml(text, inlineStyle));
 }
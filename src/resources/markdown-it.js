@@ -1,154 +1,102 @@
-var nameCounter = 0;
-var toc = []; // Table of Content as a list
-
-var getHeadingLevel = function(h) {
-    var level = 1;
-    switch (h) {
-    case 'h1':
-        break;
-
-    case 'h2':
-        level += 1;
-        break;
-
-    case 'h3':
-        level += 2;
-        break;
-
-    case 'h4':
-        level += 3;
-        break;
-
-    case 'h5':
-        level += 4;
-        break;
-
-    case 'h6':
-        level += 5;
-        break;
-
-    default:
-        level += 6;
-        break;
-    }
-    return level;
-}
-
-// There is a VMarkdownitOption struct passed in.
-// var VMarkdownitOption = { html, breaks, linkify, sub, sup };
-var mdit = window.markdownit({
-    html: VMarkdownitOption.html,
-    breaks: VMarkdownitOption.breaks,
-    linkify: VMarkdownitOption.linkify,
-    typographer: false,
-    langPrefix: 'lang-',
-    highlight: function(str, lang) {
-        if (lang && (!specialCodeBlock(lang) || highlightSpecialBlocks)) {
-            if (lang === 'wavedrom') {
-                lang = 'json';
-            }
+var mdHasTocSection = function(markdown) {
+    var n = markdown.search(/(\n|^)\[toc\]/i);
+    return n != -1;
+};
 
-            if (hljs.getLanguage(lang)) {
-                return hljs.highlight(lang, str, true).value;
-            } else {
-                return hljs.highlightAuto(str).value;
-            }
-        }
+// Render worker converting Markdown to HTML off the main thread.
+// There is a VRenderWorkerScripts list passed in if it is enabled.
+var renderWorker = null;
 
-        // Use external default escaping.
-        return '';
-    }
-});
-
-mdit = mdit.use(window.markdownitHeadingAnchor, {
-    anchorClass: 'vnote-anchor',
-    addHeadingID: true,
-    addHeadingAnchor: true,
-    anchorIcon: '#',
-    slugify: function(md, s) {
-        return 'toc_' + nameCounter++;
-    },
-    headingHook: function(openToken, inlineToken, anchor) {
-        toc.push({
-            level: getHeadingLevel(openToken.tag),
-            anchor: anchor,
-            title: mdit.utils.escapeHtml(inlineToken.content)
-        });
-    }
-});
-
-// Enable file: scheme.
-var validateLinkMDIT = mdit.validateLink;
-var fileSchemeRE = /^file:/;
-mdit.validateLink = function(url) {
-    var str = url.trim().toLowerCase();
-    return fileSchemeRE.test(str) ? true : validateLinkMDIT(url);
-};
+// 0 for not started, 1 for running, -1 for disabled.
+var renderWorkerState = 0;
+
+var renderWorkerSeq = 0;
 
-mdit = mdit.use(window.markdownitTaskLists);
+// The only outstanding job { msg, callback, fallback }, which is superseded
+// by a new one.
+var renderWorkerJob = null;
 
-if (VMarkdownitOption.sub) {
-    mdit = mdit.use(window.markdownitSub);
-}
+var startRenderWorker = function() {
+    renderWorkerState = -1;
+    if (typeof VRenderWorkerScripts == 'undefined'
+        || typeof Worker == 'undefined') {
+        return;
+    }
 
-if (VMarkdownitOption.sup) {
-    mdit = mdit.use(window.markdownitSup);
-}
+    var langs = ['mathjax', 'mermaid', 'flowchart', 'flow', 'puml', 'dot', 'wavedrom'];
+    var specialLangs = [];
+    for (var i = 0; i < langs.length; ++i) {
+        if (specialCodeBlock(langs[i])) {
+            specialLangs.push(langs[i]);
+        }
+    }
 
-var metaDataText = null;
-if (VMarkdownitOption.metadata) {
-    mdit = mdit.use(window.markdownitFrontMatter, function(text){
-        metaDataText = text;
-    });
-}
+    try {
+        // The page is not of the origin of qrc.
+        var blob = new Blob(["importScripts('" + VRenderWorkerFile + "');"],
+                            { type: 'application/javascript' });
+        renderWorker = new Worker(URL.createObjectURL(blob));
+    } catch (err) {
+        callContent('setLog', "failed to start render worker: " + err);
+        renderWorker = null;
+        return;
+    }
 
-if (VMarkdownitOption.emoji) {
-    mdit = mdit.use(window.markdownitEmoji);
-    mdit.renderer.rules.emoji = function(token, idx) {
-        return '<span class="emoji emoji_' + token[idx].markup + '">' + token[idx].content + '</span>';
-    };
-}
-
-mdit = mdit.use(window.markdownitFootnote);
-
-mdit = mdit.use(window["markdown-it-imsize.js"]);
-
-if (typeof texmath != 'undefined') {
-    mdit = mdit.use(texmath, { delimiters: ['dollars', 'raw'] });
-}
-
-mdit.use(window.markdownitContainer, 'alert', {
-    validate: function(params) {
-        return params.trim().match(/^alert-\S+$/);
-    },
-
-    render: function (tokens, idx) {
-        let type = tokens[idx].info.trim().match(/^(alert-\S+)$/);
-        if (tokens[idx].nesting === 1) {
-            // opening tag
-            let alertClass = type[1];
-            return '<div class="alert ' + alertClass + '" role="alert">';
-        } else {
-            // closing tag
-            return '</div>\n';
+    renderWorker.onmessage = function(e) {
+        var job = renderWorkerJob;
+        if (!job || job.msg.id != e.data.id) {
+            // Stale result.
+            return;
         }
+
+        renderWorkerJob = null;
+        job.callback(e.data);
+    };
+
+    renderWorker.onerror = function(e) {
+        callContent('setLog', "render worker error: " + e.message);
+        stopRenderWorker();
+    };
+
+    renderWorker.postMessage({ type: 'init',
+                               scripts: VRenderWorkerScripts,
+                               option: VMarkdownitOption,
+                               specialLangs: specialLangs });
+    renderWorkerState = 1;
+};
+
+// Render synchronously from now on, finishing the outstanding job.
+var stopRenderWorker = function() {
+    if (renderWorker) {
+        renderWorker.terminate();
+        renderWorker = null;
     }
-});
 
-var mdHasTocSection = function(markdown) {
-    var n = markdown.search(/(\n|^)\[toc\]/i);
-    return n != -1;
+    renderWorkerState = -1;
+
+    var job = renderWorkerJob;
+    renderWorkerJob = null;
+    if (job) {
+        job.fallback();
+    }
 };
 
-var markdownToHtml = function(markdown, needToc) {
-    toc = [];
-    nameCounter = 0;
-    var html = mdit.render(markdown);
-    if (needToc) {
-        return html.replace(/<p>\[TOC\]<\/p>/ig, '<div class="vnote-toc"></div>');
-    } else {
-        return html;
+// Post @msg to the render worker and call @callback with the result.
+// @fallback will be called to render synchronously if the worker fails.
+// Returns false if the worker is not available.
+var renderInWorker = function(msg, callback, fallback) {
+    if (renderWorkerState == 0) {
+        startRenderWorker();
+    }
+
+    if (renderWorkerState != 1) {
+        return false;
     }
+
+    msg.id = ++renderWorkerSeq;
+    renderWorkerJob = { msg: msg, callback: callback, fallback: fallback };
+    renderWorker.postMessage(msg);
+    return true;
 };
 
 var updateText = function(text) {
@@ -156,14 +104,37 @@ var updateText = function(text) {
         text = "[TOC]\n\n" + text;
     }
 
+    var needToc = mdHasTocSection(text);
+
+    var renderSync = function() {
+        sourceLineEnabled = true;
+        var html = renderMarkdownWithToc(text, needToc);
+        sourceLineEnabled = false;
+        applyText(html, needToc);
+    };
+
+    var handleResult = function(res) {
+        toc = res.toc;
+        nameCounter = toc.length;
+        metaDataText = res.metaDataText;
+        applyText(res.html, needToc);
+    };
+
+    if (!renderInWorker({ type: 'render', text: text, needToc: needToc },
+                        handleResult,
+                        renderSync)) {
+        renderSync();
+    }
+};
+
+// Apply @html of the whole text with toc and metaDataText set.
+var applyText = function(html, needToc) {
     startFreshRender();
 
     // There is at least one async job for MathJax.
     asyncJobsCount = 1;
-    metaDataText = null;
 
-    var needToc = mdHasTocSection(text);
-    var html = markdownToHtml(text, needToc);
+    removeStaleBlocks();
     contentDiv.innerHTML = html;
     handleToc(needToc);
     insertImageCaption();
@@ -196,7 +167,7 @@ var updateText = function(text) {
             MathJax.Hub.Queue(["resetEquationNumbers",MathJax.InputJax.TeX],
                               ["Typeset", MathJax.Hub, eles, postProcessMathJax]);
         } catch (err) {
-            content.setLog("err: " + err);
+            callContent('setLog', "err: " + err);
             finishOneAsyncJob();
         }
     } else {
@@ -204,14 +175,236 @@ var updateText = function(text) {
     }
 };
 
+// Top-level blocks of the text, each of which is rendered in its own div.
+// { id, text, toc, div }
+var vBlocks = [];
+
+// Whether contentDiv consists of the divs of vBlocks.
+var vBlocksRendered = false;
+
+var VBlockClass = 'vnote-block';
+
+// Divs of the removed blocks, which are kept until the new ones are rendered.
+var vStaleBlockDivs = [];
+
+var removeStaleBlocks = function() {
+    for (var i = 0; i < vStaleBlockDivs.length; ++i) {
+        var div = vStaleBlockDivs[i];
+        if (div.parentNode) {
+            div.parentNode.removeChild(div);
+        }
+    }
+
+    vStaleBlockDivs = [];
+};
+
+// Whether @text could be rendered block by block. Footnotes, TOC and metadata
+// depend on the whole text.
+var canRenderByBlocks = function(text) {
+    if (VAddTOC || mdHasTocSection(text)) {
+        return false;
+    }
+
+    if (VMarkdownitOption.metadata && /^---/.test(text)) {
+        return false;
+    }
+
+    return text.search(/\[\^/) == -1;
+};
+
+// Handle the patch from VDocument: @removed blocks from @first are replaced
+// with @blocks. Only the new blocks are rendered.
+var patchText = function(first, removed, blocks) {
+    var newBlocks = [];
+    for (var i = 0; i < blocks.length; ++i) {
+        newBlocks.push({ id: blocks[i].id, text: blocks[i].text, toc: [], div: null });
+    }
+
+    var removedBlocks = vBlocks.splice.apply(vBlocks, [first, removed].concat(newBlocks));
+
+    var text = '';
+    for (var i = 0; i < vBlocks.length; ++i) {
+        text += vBlocks[i].text;
+    }
+
+    if (!canRenderByBlocks(text)) {
+        vBlocksRendered = false;
+        updateText(text);
+        return;
+    }
+
+    var renderAll = !vBlocksRendered;
+    if (!renderAll) {
+        for (var i = 0; i < removedBlocks.length; ++i) {
+            if (removedBlocks[i].div) {
+                vStaleBlockDivs.push(removedBlocks[i].div);
+            }
+        }
+    }
+
+    // Blocks of a superseded render are not rendered yet either.
+    var toRender = [];
+    var texts = [];
+    for (var i = 0; i < vBlocks.length; ++i) {
+        if (renderAll || !vBlocks[i].div) {
+            toRender.push(vBlocks[i]);
+            texts.push(vBlocks[i].text);
+        }
+    }
+
+    var renderSync = function() {
+        // Source lines of the blocks are relative to the blocks.
+        sourceLineEnabled = true;
+        var res = renderMarkdownBlocks(text, texts);
+        sourceLineEnabled = false;
+        applyBlocks(toRender, res.html, res.toc, renderAll);
+    };
+
+    var handleResult = function(res) {
+        applyBlocks(toRender, res.html, res.toc, renderAll);
+    };
+
+    if (!renderInWorker({ type: 'renderBlocks', text: text, blocks: texts },
+                        handleResult,
+                        renderSync)) {
+        renderSync();
+    }
+};
+
+// Put the rendered @htmls and @tocs of @newBlocks in contentDiv.
+var applyBlocks = function(newBlocks, htmls, tocs, renderAll) {
+    startFreshRender();
+
+    // There is at least one async job for MathJax.
+    asyncJobsCount = 1;
+    metaDataText = null;
+
+    removeStaleBlocks();
+    if (renderAll) {
+        contentDiv.innerHTML = '';
+        vBlocksRendered = true;
+    }
+
+    for (var i = 0; i < newBlocks.length; ++i) {
+        var blk = newBlocks[i];
+        blk.div = document.createElement('div');
+        blk.div.classList.add(VBlockClass);
+        blk.div.setAttribute('data-block-id', blk.id);
+        blk.div.innerHTML = htmls[i];
+        blk.toc = tocs[i];
+    }
+
+    // Insert the new divs in order.
+    var prev = null;
+    for (var i = 0; i < vBlocks.length; ++i) {
+        var div = vBlocks[i].div;
+        if (div.parentNode != contentDiv) {
+            contentDiv.insertBefore(div, prev ? prev.nextSibling : contentDiv.firstChild);
+        }
+
+        prev = div;
+    }
+
+    // Number the headers through all the blocks and rebuild the TOC.
+    toc = [];
+    nameCounter = 0;
+    for (var i = 0; i < vBlocks.length; ++i) {
+        var blk = vBlocks[i];
+        var headers = blk.div.querySelectorAll('h1[id^="toc_"], h2[id^="toc_"], h3[id^="toc_"], '
+                                               + 'h4[id^="toc_"], h5[id^="toc_"], h6[id^="toc_"]');
+        for (var j = 0; j < blk.toc.length; ++j) {
+            var item = blk.toc[j];
+            item.anchor = 'toc_' + nameCounter++;
+            toc.push(item);
+
+            var header = headers[j];
+            if (header && header.id != item.anchor) {
+                header.id = item.anchor;
+                var anchor = header.querySelector('a.vnote-anchor');
+                if (anchor) {
+                    anchor.setAttribute('href', '#' + item.anchor);
+                }
+            }
+        }
+    }
+
+    handleToc(false);
+
+    var roots = [];
+    for (var i = 0; i < newBlocks.length; ++i) {
+        var root = newBlocks[i].div;
+        roots.push(root);
+
+        insertImageCaption(root);
+        setupImageView(root);
+        renderMermaid('lang-mermaid', root);
+        renderFlowchart(['lang-flowchart', 'lang-flow'], root);
+        renderWavedrom('lang-wavedrom', root);
+        renderPlantUML('lang-puml', root);
+        renderGraphviz('lang-dot', root);
+        addClassToCodeBlock(root);
+        renderCodeBlockLineNumber(root);
+    }
+
+    if (VEnableMathjax) {
+        var eles = [];
+        for (var i = 0; i < roots.length; ++i) {
+            var texToRender = roots[i].getElementsByClassName('tex-to-render');
+            for (var j = 0; j < texToRender.length; ++j) {
+                eles.push(texToRender[j]);
+            }
+        }
+
+        if (eles.length == 0) {
+            finishOneAsyncJob();
+            return;
+        }
+
+        try {
+            MathJax.Hub.Queue(["Typeset", MathJax.Hub, eles, [postProcessMathJax, roots]]);
+        } catch (err) {
+            callContent('setLog', "err: " + err);
+            finishOneAsyncJob();
+        }
+    } else {
+        finishOneAsyncJob();
+    }
+};
+
+// Add the source lines of the tagged blocks and their offsets in the page.
+var collectSourceLines = function(lines, offsets) {
+    var addLines = function(root, base) {
+        var eles = root.querySelectorAll('[' + VSourceLineAttr + ']');
+        for (var i = 0; i < eles.length; ++i) {
+            lines.push(base + parseInt(eles[i].getAttribute(VSourceLineAttr)));
+            offsets.push(pageOffsetOf(eles[i]));
+        }
+    };
+
+    if (vBlocksRendered) {
+        var base = 0;
+        for (var i = 0; i < vBlocks.length; ++i) {
+            addLines(vBlocks[i].div, base);
+
+            var text = vBlocks[i].text;
+            for (var j = text.indexOf('\n'); j != -1; j = text.indexOf('\n', j + 1)) {
+                ++base;
+            }
+        }
+    } else {
+        // Lines of the TOC added in updateText().
+        addLines(contentDiv, VAddTOC ? -2 : 0);
+    }
+};
+
 var highlightText = function(text, id, timeStamp) {
     highlightSpecialBlocks = true;
     var html = mdit.render(text);
     highlightSpecialBlocks = false;
-    content.highlightTextCB(html, id, timeStamp);
+    callContent('highlightTextCB', html, id, timeStamp);
 };
 
-var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+var markdownToHtml = function(text, inlineStyle) {
     var html = mdit.render(text);
     if (inlineStyle) {
         var container = textHtmlDiv;
@@ -220,7 +413,11 @@ var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
         container.innerHTML = "";
     }
 
-    content.textToHtmlCB(identifier, id, timeStamp, html);
+    return html;
+};
+
+var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+    callContent('textToHtmlCB', identifier, id, timeStamp, markdownToHtml(text, inlineStyle));
 };
 
 // Add a PRE containing metaDataText if it is not empty.
@@ -249,7 +446,7 @@ var postProcessMathJaxWhenMathjaxReady = function() {
             try {
                 node.removeChild(all[i].SourceElement());
             } catch (err) {
-                content.setLog("err: " + err);
+                callContent('setLog', "err: " + err);
             }
         }
 
@@ -282,7 +479,7 @@ var handleMathjaxReady = function() {
         MathJax.Hub.Queue(["resetEquationNumbers",MathJax.InputJax.TeX],
                           ["Typeset", MathJax.Hub, eles, postProcessMathJaxWhenMathjaxReady]);
     } catch (err) {
-        content.setLog("err: " + err);
+        callContent('setLog', "err: " + err);
         finishOneAsyncJob();
     }
 };
@@ -0,0 +1,188 @@
+// Setup of markdown-it shared by the page and the render worker.
+// Plugins are looked up from self, which is the window in the page.
+var nameCounter = 0;
+var toc = []; // Table of Content as a list
+
+var getHeadingLevel = function(h) {
+    var level = 1;
+    switch (h) {
+    case 'h1':
+        break;
+
+    case 'h2':
+        level += 1;
+        break;
+
+    case 'h3':
+        level += 2;
+        break;
+
+    case 'h4':
+        level += 3;
+        break;
+
+    case 'h5':
+        level += 4;
+        break;
+
+    case 'h6':
+        level += 5;
+        break;
+
+    default:
+        level += 6;
+        break;
+    }
+    return level;
+}
+
+// There is a VMarkdownitOption struct passed in.
+// var VMarkdownitOption = { html, breaks, linkify, sub, sup };
+var mdit = self.markdownit({
+    html: VMarkdownitOption.html,
+    breaks: VMarkdownitOption.breaks,
+    linkify: VMarkdownitOption.linkify,
+    typographer: false,
+    langPrefix: 'lang-',
+    highlight: function(str, lang) {
+        if (lang && (!specialCodeBlock(lang) || highlightSpecialBlocks)) {
+            if (lang === 'wavedrom') {
+                lang = 'json';
+            }
+
+            if (hljs.getLanguage(lang)) {
+                return hljs.highlight(lang, str, true).value;
+            } else {
+                return hljs.highlightAuto(str).value;
+            }
+        }
+
+        // Use external default escaping.
+        return '';
+    }
+});
+
+mdit = mdit.use(self.markdownitHeadingAnchor, {
+    anchorClass: 'vnote-anchor',
+    addHeadingID: true,
+    addHeadingAnchor: true,
+    anchorIcon: '#',
+    slugify: function(md, s) {
+        return 'toc_' + nameCounter++;
+    },
+    headingHook: function(openToken, inlineToken, anchor) {
+        toc.push({
+            level: getHeadingLevel(openToken.tag),
+            anchor: anchor,
+            title: mdit.utils.escapeHtml(inlineToken.content)
+        });
+    }
+});
+
+// Enable file: scheme.
+var validateLinkMDIT = mdit.validateLink;
+var fileSchemeRE = /^file:/;
+mdit.validateLink = function(url) {
+    var str = url.trim().toLowerCase();
+    return fileSchemeRE.test(str) ? true : validateLinkMDIT(url);
+};
+
+mdit = mdit.use(self.markdownitTaskLists);
+
+if (VMarkdownitOption.sub) {
+    mdit = mdit.use(self.markdownitSub);
+}
+
+if (VMarkdownitOption.sup) {
+    mdit = mdit.use(self.markdownitSup);
+}
+
+var metaDataText = null;
+if (VMarkdownitOption.metadata) {
+    mdit = mdit.use(self.markdownitFrontMatter, function(text){
+        metaDataText = text;
+    });
+}
+
+if (VMarkdownitOption.emoji) {
+    mdit = mdit.use(self.markdownitEmoji);
+    mdit.renderer.rules.emoji = function(token, idx) {
+        return '<span class="emoji emoji_' + token[idx].markup + '">' + token[idx].content + '</span>';
+    };
+}
+
+mdit = mdit.use(self.markdownitFootnote);
+
+mdit = mdit.use(self["markdown-it-imsize.js"]);
+
+if (typeof texmath != 'undefined') {
+    mdit = mdit.use(texmath, { delimiters: ['dollars', 'raw'] });
+}
+
+mdit.use(self.markdownitContainer, 'alert', {
+    validate: function(params) {
+        return params.trim().match(/^alert-\S+$/);
+    },
+
+    render: function (tokens, idx) {
+        let type = tokens[idx].info.trim().match(/^(alert-\S+)$/);
+        if (tokens[idx].nesting === 1) {
+            // opening tag
+            let alertClass = type[1];
+            return '<div class="alert ' + alertClass + '" role="alert">';
+        } else {
+            // closing tag
+            return '</div>\n';
+        }
+    }
+});
+
+// Whether to tag the top-level blocks with their source lines.
+var sourceLineEnabled = false;
+
+var VSourceLineAttr = 'data-source-line';
+
+mdit.core.ruler.push('source_line', function(state) {
+    if (!sourceLineEnabled) {
+        return;
+    }
+
+    var tokens = state.tokens;
+    for (var i = 0; i < tokens.length; ++i) {
+        var token = tokens[i];
+        if (token.map && token.level == 0 && token.nesting != -1) {
+            token.attrSet(VSourceLineAttr, String(token.map[0]));
+        }
+    }
+});
+
+
+// Render the whole @markdown with the TOC and metadata reset.
+var renderMarkdownWithToc = function(markdown, needToc) {
+    toc = [];
+    nameCounter = 0;
+    metaDataText = null;
+    var html = mdit.render(markdown);
+    if (needToc) {
+        return html.replace(/<p[^>]*>\[TOC\]<\/p>/ig, '<div class="vnote-toc"></div>');
+    } else {
+        return html;
+    }
+};
+
+// Render each of @blocks with the link references of the whole @text.
+// Returns { html, toc } of the blocks.
+var renderMarkdownBlocks = function(text, blocks) {
+    var env = {};
+    mdit.parse(text, env);
+
+    var htmls = [];
+    var tocs = [];
+    for (var i = 0; i < blocks.length; ++i) {
+        toc = [];
+        htmls.push(mdit.render(blocks[i], { references: env.references }));
+        tocs.push(toc);
+    }
+
+    return { html: htmls, toc: tocs };
+};
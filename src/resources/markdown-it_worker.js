@@ -0,0 +1,52 @@
+// Render worker of markdown-it.
+// It converts Markdown to HTML and highlights code blocks off the main thread
+// of the page, which only applies the results to the DOM.
+
+var VMarkdownitOption = null;
+
+// Languages of the special code blocks, which are rendered by the page.
+var specialLangs = [];
+
+var highlightSpecialBlocks = false;
+
+var specialCodeBlock = function(lang) {
+    return specialLangs.indexOf(lang) != -1;
+};
+
+// Messages from the page:
+// { type: 'init', scripts, option, specialLangs }
+// { type: 'render', id, text, needToc }
+// { type: 'renderBlocks', id, text, blocks }
+self.onmessage = function(e) {
+    var msg = e.data;
+    switch (msg.type) {
+    case 'init':
+        VMarkdownitOption = msg.option;
+        specialLangs = msg.specialLangs;
+        importScripts.apply(self, msg.scripts);
+        break;
+
+    case 'render':
+        sourceLineEnabled = true;
+        var html = renderMarkdownWithToc(msg.text, msg.needToc);
+        sourceLineEnabled = false;
+        self.postMessage({ id: msg.id,
+                           html: html,
+                           toc: toc,
+                           metaDataText: metaDataText });
+        break;
+
+    case 'renderBlocks':
+        // Source lines of the blocks are relative to the blocks.
+        sourceLineEnabled = true;
+        var res = renderMarkdownBlocks(msg.text, msg.blocks);
+        sourceLineEnabled = false;
+        self.postMessage({ id: msg.id,
+                           html: res.html,
+                           toc: res.toc });
+        break;
+
+    default:
+        break;
+    }
+};
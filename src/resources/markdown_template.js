@@ -158,61 +158,100 @@ var styleContent = function() {
     return styles;
 };
 
+// Convert @texts to HTML via markdownToHtml() of the renderer and return them
+// in one call.
+var textToHtmlBatch = function(identifier, timeStamp, ids, texts, inlineStyle) {
+    var htmls = [];
+    for (var i = 0; i < texts.length; ++i) {
+        htmls.push(markdownToHtml(texts[i], inlineStyle));
+    }
+
+    callContent('textToHtmlBatchCB', identifier, timeStamp, ids, htmls);
+};
+
 var htmlContent = function() {
-    content.htmlContentCB("", styleContent(), contentDiv.innerHTML);
+    callContent('htmlContentCB', "", styleContent(), contentDiv.innerHTML);
 };
 
 var mute = function(muted) {
     g_muteScroll = muted;
 };
 
-new QWebChannel(qt.webChannelTransport,
-    function(channel) {
-        content = channel.objects.content;
+// Handlers called by VDocument in batches.
+var VWebHandlers = ['scrollToAnchor', 'scrollToOffset', 'mute', 'highlightText',
+                    'htmlToText', 'textToHtml', 'textToHtmlBatch', 'htmlContent',
+                    'handlePlantUMLResult', 'handleGraphvizResult', 'setPreviewEnabled',
+                    'previewCodeBlock', 'setPreviewContent', 'performSmartLivePreview',
+                    'patchText', 'setCachedDiagrams'];
+
+var handleBatchedCalls = function(calls) {
+    for (var i = 0; i < calls.length; ++i) {
+        var name = calls[i][0];
+        var handler = window[name];
+        if (VWebHandlers.indexOf(name) == -1 || typeof handler != "function") {
+            continue;
+        }
 
-        content.requestScrollToAnchor.connect(scrollToAnchor);
+        handler.apply(null, calls[i].slice(1));
+    }
+};
 
-        content.requestMuted.connect(mute);
+// Calls to VDocument queued within this frame.
+var pendingContentCalls = [];
 
-        if (typeof highlightText == "function") {
-            content.requestHighlightText.connect(highlightText);
-            content.noticeReadyToHighlightText();
-        }
+var flushContentCalls = function() {
+    if (!content || pendingContentCalls.length == 0) {
+        return;
+    }
 
-        if (typeof htmlToText == "function") {
-            content.requestHtmlToText.connect(htmlToText);
-        }
+    var calls = pendingContentCalls;
+    pendingContentCalls = [];
+    content.handleBatchedCalls(calls);
+};
 
-        if (typeof textToHtml == "function") {
-            content.requestTextToHtml.connect(textToHtml);
-            content.noticeReadyToTextToHtml();
-        }
+// Call the slot @name of VDocument with the rest arguments. Calls within a
+// frame are sent in one message.
+var callContent = function(name) {
+    if (pendingContentCalls.length == 0) {
+        requestAnimationFrame(flushContentCalls);
 
-        if (typeof htmlContent == "function") {
-            content.requestHtmlContent.connect(htmlContent);
-        }
+        // Frames are not scheduled for a hidden page.
+        setTimeout(flushContentCalls, 16);
+    }
 
-        content.plantUMLResultReady.connect(handlePlantUMLResult);
-        content.graphvizResultReady.connect(handleGraphvizResult);
+    pendingContentCalls.push(Array.prototype.slice.call(arguments));
+};
 
-        content.requestPreviewEnabled.connect(setPreviewEnabled);
+new QWebChannel(qt.webChannelTransport,
+    function(channel) {
+        content = channel.objects.content;
 
-        content.requestPreviewCodeBlock.connect(previewCodeBlock);
+        content.callsBatched.connect(handleBatchedCalls);
 
-        content.requestSetPreviewContent.connect(setPreviewContent);
-        content.requestPerformSmartLivePreview.connect(performSmartLivePreview);
+        if (typeof highlightText == "function") {
+            callContent('noticeReadyToHighlightText');
+        }
+
+        if (typeof textToHtml == "function") {
+            callContent('noticeReadyToTextToHtml');
+        }
 
         if (typeof updateHtml == "function") {
             updateHtml(content.html);
             content.htmlChanged.connect(updateHtml);
         }
 
-        if (typeof updateText == "function") {
+        if (typeof patchText == "function") {
+            callContent('enableTextPatch');
+        } else if (typeof updateText == "function") {
             content.textChanged.connect(updateText);
-            content.updateText();
+            callContent('updateText');
         }
 
         channelInitialized = true;
+
+        // Calls before the channel is ready.
+        flushContentCalls();
     });
 
 var VHighlightedAnchorClass = 'highlighted-anchor';
@@ -262,6 +301,72 @@ var scrollToAnchor = function(anchor) {
     setTimeout("g_muteScroll = false", 100);
 };
 
+var scrollToOffset = function(offset) {
+    g_muteScroll = true;
+    currentHeaderIdx = -1;
+    window.scrollTo(0, offset);
+
+    // Disable scroll temporarily.
+    setTimeout("g_muteScroll = false", 100);
+};
+
+// Vertical offset of @ele in the page.
+var pageOffsetOf = function(ele) {
+    return Math.round(ele.getBoundingClientRect().top + window.pageYOffset);
+};
+
+var sourceLineMapTimer = null;
+
+// Send the offsets of the source lines and headers to VDocument in one message,
+// with which the scroll sync is done on the C++ side.
+// Renderers tagging the source lines define collectSourceLines(lines, offsets).
+var updateSourceLineMap = function() {
+    if (sourceLineMapTimer) {
+        clearTimeout(sourceLineMapTimer);
+        sourceLineMapTimer = null;
+    }
+
+    if (!channelInitialized) {
+        return;
+    }
+
+    var lines = [];
+    var offsets = [];
+    if (typeof collectSourceLines == "function") {
+        collectSourceLines(lines, offsets);
+    }
+
+    var anchors = [];
+    var anchorOffsets = [];
+    var headers = contentDiv.querySelectorAll("h1, h2, h3, h4, h5, h6");
+    for (var i = 0; i < headers.length; ++i) {
+        var id = headers[i].getAttribute("id");
+        if (id) {
+            anchors.push(id);
+            anchorOffsets.push(pageOffsetOf(headers[i]));
+        }
+    }
+
+    callContent('setSourceLineMap', lines, offsets, anchors, anchorOffsets);
+};
+
+// Layout may change after the render, such as loading images.
+var scheduleSourceLineMap = function() {
+    if (sourceLineMapTimer) {
+        clearTimeout(sourceLineMapTimer);
+    }
+
+    sourceLineMapTimer = setTimeout(updateSourceLineMap, 200);
+};
+
+window.addEventListener('resize', scheduleSourceLineMap);
+
+document.addEventListener('load', function(e) {
+    if (e.target.tagName == 'IMG') {
+        scheduleSourceLineMap();
+    }
+}, true);
+
 window.onwheel = function(e) {
     e = e || window.event;
     var ctrl = !!e.ctrlKey;
@@ -289,7 +394,6 @@ window.onscroll = function() {
     var eles = document.querySelectorAll("h1, h2, h3, h4, h5, h6");
 
     if (eles.length == 0) {
-        content.setHeader("");
         return;
     }
 
@@ -303,10 +407,8 @@ window.onscroll = function() {
         }
     }
 
-    var curHeader = null;
+    // The current header is tracked by VMdTab via the source line map.
     if (currentHeaderIdx != -1) {
-        curHeader = eles[currentHeaderIdx].getAttribute("id");
-
         // Update the range which can be skipped to check.
         var endOffset;
         if (currentHeaderIdx < eles.length - 1) {
@@ -318,8 +420,6 @@ window.onscroll = function() {
         skipScrollCheckRange = { start: eles[currentHeaderIdx].offsetTop - bias,
                                  end: endOffset };
     }
-
-    content.setHeader(curHeader ? curHeader : "");
 };
 
 // Used to record the repeat token of user input.
@@ -579,21 +679,79 @@ document.onkeydown = function(e) {
     if (accept) {
         e.preventDefault();
     } else {
-        content.keyPressEvent(key, ctrl, shift, meta);
+        callContent('keyPressEvent', key, ctrl, shift, meta);
+    }
+};
+
+// Rendered diagrams keyed by diagramKey(), filled by VDocument with the ones
+// cached before this page before it sends the text.
+var diagramCache = {};
+var diagramCacheCount = 0;
+
+var MAX_DIAGRAM_CACHE_COUNT = 256;
+
+var diagramKey = function(lang, text) {
+    return lang + '\n' + text;
+};
+
+var setCachedDiagrams = function(diagrams) {
+    for (var i = 0; i < diagrams.length; ++i) {
+        addCachedDiagram(diagrams[i][0], diagrams[i][1], diagrams[i][2]);
     }
 };
 
+var addCachedDiagram = function(lang, text, html) {
+    if (diagramCacheCount >= MAX_DIAGRAM_CACHE_COUNT) {
+        diagramCache = {};
+        diagramCacheCount = 0;
+    }
+
+    var key = diagramKey(lang, text);
+    if (!diagramCache.hasOwnProperty(key)) {
+        ++diagramCacheCount;
+    }
+
+    diagramCache[key] = html;
+};
+
+// Cache the rendered @html of @text in @lang here and in VDocument.
+var cacheDiagram = function(lang, text, html) {
+    addCachedDiagram(lang, text, html);
+    callContent('cacheDiagram', lang, text, html);
+};
+
+// Replace @code with its cached rendering in @lang if there is one.
+// Returns the div of the rendering, or null if not cached.
+var insertCachedDiagram = function(lang, code, className) {
+    var key = diagramKey(lang, code.textContent);
+    if (!diagramCache.hasOwnProperty(key)) {
+        return null;
+    }
+
+    var div = document.createElement('div');
+    div.classList.add(className);
+    div.innerHTML = diagramCache[key];
+
+    var preNode = code.parentNode;
+    preNode.parentNode.replaceChild(div, preNode);
+    return div;
+};
+
 var mermaidParserErr = false;
 var mermaidIdx = 0;
 
+// Prefix of the ids of Mermaid graphs. It is unique to this page and the
+// index is never reset, since cached graphs keep their ids.
+var mermaidIdPrefix = 'mermaid-diagram-' + Date.now().toString(36) + '-';
+
 if (VEnableMermaid) {
     mermaidAPI.parseError = function(err, hash) {
-        content.setLog("err: " + err);
+        callContent('setLog', "err: " + err);
         mermaidParserErr = true;
 
         // Clean the container element, or mermaidAPI won't render the graph with
         // the same id.
-        var errGraph = document.getElementById('mermaid-diagram-' + mermaidIdx);
+        var errGraph = document.getElementById(mermaidIdPrefix + mermaidIdx);
         var parentNode = errGraph.parentElement;
         parentNode.outerHTML = '';
         delete parentNode;
@@ -601,13 +759,13 @@ if (VEnableMermaid) {
 }
 
 // @className, the class name of the mermaid code block, such as 'lang-mermaid'.
-var renderMermaid = function(className) {
+// @root: only render the code blocks within @root if given.
+var renderMermaid = function(className, root) {
     if (!VEnableMermaid) {
         return;
     }
 
-    var codes = document.getElementsByTagName('code');
-    mermaidIdx = 0;
+    var codes = (root || document).getElementsByTagName('code');
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         if (code.classList.contains(className)) {
@@ -622,14 +780,19 @@ var renderMermaid = function(className) {
 // Render @code as Mermaid graph.
 // Returns true if succeeded.
 var renderMermaidOne = function(code) {
+    if (insertCachedDiagram('mermaid', code, VMermaidDivClass)) {
+        return true;
+    }
+
     // Mermaid code block.
+    var text = code.textContent;
     mermaidParserErr = false;
     mermaidIdx++;
     try {
         // Do not increment mermaidIdx here.
-        var graph = mermaidAPI.render('mermaid-diagram-' + mermaidIdx, code.textContent, function(){});
+        var graph = mermaidAPI.render(mermaidIdPrefix + mermaidIdx, text, function(){});
     } catch (err) {
-        content.setLog("err: " + err);
+        callContent('setLog', "err: " + err);
         return false;
     }
 
@@ -643,19 +806,24 @@ var renderMermaidOne = function(code) {
 
     var preNode = code.parentNode;
     preNode.parentNode.replaceChild(graphDiv, preNode);
+
+    cacheDiagram('mermaid', text, graph);
     return true;
 };
 
 var flowchartIdx = 0;
 
 // @className, the class name of the flowchart code block, such as 'lang-flowchart'.
-var renderFlowchart = function(classNames) {
+var renderFlowchart = function(classNames, root) {
     if (!VEnableFlowchart) {
         return;
     }
 
-    var codes = document.getElementsByTagName('code');
-    flowchartIdx = 0;
+    var codes = (root || document).getElementsByTagName('code');
+    if (!root) {
+        flowchartIdx = 0;
+    }
+
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         var matched = false;
@@ -678,12 +846,19 @@ var renderFlowchart = function(classNames) {
 // Render @code as Flowchart.js graph.
 // Returns true if succeeded.
 var renderFlowchartOne = function(code) {
+    var cachedDiv = insertCachedDiagram('flowchart', code, VFlowchartDivClass);
+    if (cachedDiv) {
+        setupSVGToView(cachedDiv.children[0], true);
+        return true;
+    }
+
     // Flowchart code block.
+    var text = code.textContent;
     flowchartIdx++;
     try {
-        var graph = flowchart.parse(code.textContent);
+        var graph = flowchart.parse(text);
     } catch (err) {
-        content.setLog("err: " + err);
+        callContent('setLog', "err: " + err);
         return false;
     }
 
@@ -701,9 +876,10 @@ var renderFlowchartOne = function(code) {
     // Draw on it after adding it to page.
     try {
         graph.drawSVG(graphDiv.id);
+        cacheDiagram('flowchart', text, graphDiv.innerHTML);
         setupSVGToView(graphDiv.children[0], true);
     } catch (err) {
-        content.setLog("err: " + err);
+        callContent('setLog', "err: " + err);
         preParentNode.replaceChild(preNode, graphDiv);
         delete graphDiv;
         return false;
@@ -714,13 +890,16 @@ var renderFlowchartOne = function(code) {
 
 var wavedromIdx = 0;
 
-var renderWavedrom = function(className) {
+var renderWavedrom = function(className, root) {
     if (!VEnableWavedrom) {
         return;
     }
 
-    var codes = document.getElementsByTagName('code');
-    wavedromIdx = 0;
+    var codes = (root || document).getElementsByTagName('code');
+    if (!root) {
+        wavedromIdx = 0;
+    }
+
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         if (code.classList.contains(className)) {
@@ -733,10 +912,15 @@ var renderWavedrom = function(className) {
 };
 
 var renderWavedromOne = function(code) {
+    if (insertCachedDiagram('wavedrom', code, VWavedromDivClass)) {
+        return true;
+    }
+
     // Create a script element.
+    var text = code.textContent;
     var script = document.createElement('script');
     script.setAttribute('type', 'WaveDrom');
-    script.textContent = code.textContent;
+    script.textContent = text;
     script.setAttribute('id', 'WaveDrom_JSON_' + wavedromIdx);
 
     var preNode = code.parentNode;
@@ -754,12 +938,14 @@ var renderWavedromOne = function(code) {
                                 'WaveDrom_Display_');
     } catch (err) {
         wavedromIdx++;
-        content.setLog("err: " + err);
+        callContent('setLog', "err: " + err);
         return false;
     }
 
     script.parentNode.removeChild(script);
 
+    cacheDiagram('wavedrom', text, div.innerHTML);
+
     wavedromIdx++;
     return true;
 };
@@ -768,14 +954,16 @@ var plantUMLIdx = 0;
 var plantUMLCodeClass = 'plantuml_code_';
 
 // @className, the class name of the PlantUML code block, such as 'lang-puml'.
-var renderPlantUML = function(className) {
+var renderPlantUML = function(className, root) {
     if (VPlantUMLMode == 0) {
         return;
     }
 
-    plantUMLIdx = 0;
+    if (!root) {
+        plantUMLIdx = 0;
+    }
 
-    var codes = document.getElementsByTagName('code');
+    var codes = (root || document).getElementsByTagName('code');
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         if (code.classList.contains(className)) {
@@ -809,7 +997,7 @@ var renderPlantUMLOneOnline = function(code) {
 var renderPlantUMLOneLocal = function(code) {
     ++asyncJobsCount;
     code.classList.add(plantUMLCodeClass + plantUMLIdx);
-    content.processPlantUML(plantUMLIdx, VPlantUMLFormat, code.textContent);
+    callContent('processPlantUML', plantUMLIdx, VPlantUMLFormat, code.textContent);
     plantUMLIdx++;
 };
 
@@ -817,14 +1005,16 @@ var graphvizIdx = 0;
 var graphvizCodeClass = 'graphviz_code_';
 
 // @className, the class name of the Graghviz code block, such as 'lang-dot'.
-var renderGraphviz = function(className) {
+var renderGraphviz = function(className, root) {
     if (!VEnableGraphviz) {
         return;
     }
 
-    graphvizIdx = 0;
+    if (!root) {
+        graphvizIdx = 0;
+    }
 
-    var codes = document.getElementsByTagName('code');
+    var codes = (root || document).getElementsByTagName('code');
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         if (code.classList.contains(className)) {
@@ -836,7 +1026,7 @@ var renderGraphviz = function(className) {
 var renderGraphvizOneLocal = function(code) {
     ++asyncJobsCount;
     code.classList.add(graphvizCodeClass + graphvizIdx);
-    content.processGraphviz(graphvizIdx, VGraphvizFormat, code.textContent);
+    callContent('processGraphviz', graphvizIdx, VGraphvizFormat, code.textContent);
     graphvizIdx++;
 };
 
@@ -901,12 +1091,12 @@ var getImageType = function(img) {
 };
 
 // Center the image block and insert the alt text as caption.
-var insertImageCaption = function() {
+var insertImageCaption = function(root) {
     if (!VEnableImageCaption) {
         return;
     }
 
-    var imgs = document.getElementsByTagName('img');
+    var imgs = (root || document).getElementsByTagName('img');
     for (var i = 0; i < imgs.length; ++i) {
         var img = imgs[i];
 
@@ -950,7 +1140,9 @@ var finishOneAsyncJob = function() {
 // markdown-specifi handle logics, such as Mermaid, MathJax.
 var finishLogics = function() {
     if (asyncJobsCount <= 0) {
-        content.finishLogics();
+        // Before finishLogics() to let VDocument scroll with the new map.
+        updateSourceLineMap();
+        callContent('finishLogics');
         calculateWordCount();
     }
 };
@@ -1056,15 +1248,27 @@ var tocToTree = function(p_toc, p_baseLevel) {
     return front;
 };
 
+// Flatten a perfect toc to triples of level starting from 1, anchor and title.
+var tocToItems = function(p_toc, p_baseLevel) {
+    var items = [];
+    for (var i = 0; i < p_toc.length; ++i) {
+        var item = p_toc[i];
+        items.push(item.level - p_baseLevel + 1, item.anchor, item.title);
+    }
+
+    return items;
+};
+
 var handleToc = function(needToc) {
     var baseLevel = baseLevelOfToc(toc);
-    var tocTree = tocToTree(toPerfectToc(toc, baseLevel), baseLevel);
-    content.setToc(tocTree, baseLevel);
+    var perfToc = toPerfectToc(toc, baseLevel);
+    callContent('setTocItems', tocToItems(perfToc, baseLevel));
 
     var removeToc = toc.length == 0;
 
     // Add it to html
     if (needToc) {
+        var tocTree = tocToTree(perfToc, baseLevel);
         var eles = document.getElementsByClassName('vnote-toc');
         for (var i = 0; i < eles.length; ++i) {
             if (removeToc) {
@@ -1213,16 +1417,16 @@ var jumpTitle = function(forward, relativeLevel, repeat) {
     headers[targetIdx].scrollIntoView();
     flashAnchor(headers[targetIdx]);
     currentHeaderIdx = targetIdx;
-    content.setHeader(headers[targetIdx].getAttribute("id"));
+    callContent('setHeader', headers[targetIdx].getAttribute("id"));
     setTimeout("g_muteScroll = false", 100);
 };
 
-var renderCodeBlockLineNumber = function() {
+var renderCodeBlockLineNumber = function(root) {
     if (!VEnableHighlightLineNumber) {
         return;
     }
 
-    var codes = document.getElementsByTagName('code');
+    var codes = (root || document).getElementsByTagName('code');
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         var pare = code.parentElement;
@@ -1236,7 +1440,7 @@ var renderCodeBlockLineNumber = function() {
     }
 
     // Delete the last extra row.
-    var tables = document.getElementsByTagName('table');
+    var tables = (root || document).getElementsByTagName('table');
     for (var i = 0; i < tables.length; ++i) {
         var table = tables[i];
         if (table.classList.contains("hljs-ln")) {
@@ -1246,9 +1450,9 @@ var renderCodeBlockLineNumber = function() {
     }
 };
 
-var addClassToCodeBlock = function() {
+var addClassToCodeBlock = function(root) {
     var hljsClass = 'hljs';
-    var codes = document.getElementsByTagName('code');
+    var codes = (root || document).getElementsByTagName('code');
     for (var i = 0; i < codes.length; ++i) {
         var code = codes[i];
         var pare = code.parentElement;
@@ -1343,8 +1547,17 @@ var getHtmlWithInlineStyles = function(container) {
 
 // Will be called after MathJax rendering finished.
 // Make <pre><code>math</code></pre> to <p>math</p>
-var postProcessMathJax = function() {
-    var all = MathJax.Hub.getAllJax();
+// @roots: only process the MathJax within @roots if given.
+var postProcessMathJax = function(roots) {
+    var all = [];
+    if (roots) {
+        for (var i = 0; i < roots.length; ++i) {
+            all = all.concat(MathJax.Hub.getAllJax(roots[i]));
+        }
+    } else {
+        all = MathJax.Hub.getAllJax();
+    }
+
     for (var i = 0; i < all.length; ++i) {
         var node = all[i].SourceElement().parentNode;
         if (VRemoveMathjaxScript) {
@@ -1352,7 +1565,7 @@ var postProcessMathJax = function() {
             try {
                 node.removeChild(all[i].SourceElement());
             } catch (err) {
-                content.setLog("err: " + err);
+                callContent('setLog', "err: " + err);
             }
         }
 
@@ -1413,7 +1626,7 @@ var calculateWordCount = function() {
         ++cns;
     }
 
-    content.updateWordCountInfo(wc, cns, cc);
+    callContent('updateWordCountInfo', wc, cns, cc);
 };
 
 // Whether it is a special code block, such as MathJax, Mermaid, or Flowchart.
@@ -1532,7 +1745,7 @@ var previewCodeBlock = function(id, lang, text, isLivePreview) {
     if (!isLivePreview) {
         var children = div.children;
         if (children.length > 0) {
-            content.previewCodeBlockCB(id, lang, children[0].innerHTML);
+            callContent('previewCodeBlockCB', id, lang, children[0].innerHTML);
         }
 
         div.innerHTML = '';
@@ -1720,11 +1933,11 @@ var htmlToText = function(identifier, id, timeStamp, html) {
     });
 
     var markdown = ts.turndown(html);
-    content.htmlToTextCB(identifier, id, timeStamp, markdown);
+    callContent('htmlToTextCB', identifier, id, timeStamp, markdown);
 };
 
 var printRect = function(rect) {
-    content.setLog('rect ' + rect.left + ' ' + rect.top + ' ' + rect.width + ' ' + rect.height);
+    callContent('setLog', 'rect ' + rect.left + ' ' + rect.top + ' ' + rect.width + ' ' + rect.height);
 };
 
 var performSmartLivePreview = function(lang, text, hints, isRegex) {
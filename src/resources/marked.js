@@ -80,7 +80,7 @@ var updateText = function(text) {
             MathJax.Hub.Queue(["resetEquationNumbers",MathJax.InputJax.TeX],
                               ["Typeset", MathJax.Hub, contentDiv, postProcessMathJax]);
         } catch (err) {
-            content.setLog("err: " + err);
+            callContent('setLog', "err: " + err);
             finishOneAsyncJob();
         }
     } else {
@@ -92,10 +92,10 @@ var highlightText = function(text, id, timeStamp) {
     highlightSpecialBlocks = true;
     var html = marked(text);
     highlightSpecialBlocks = false;
-    content.highlightTextCB(html, id, timeStamp);
+    callContent('highlightTextCB', html, id, timeStamp);
 }
 
-var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+var markdownToHtml = function(text, inlineStyle) {
     var html = marked(text);
     if (inlineStyle) {
         var container = textHtmlDiv;
@@ -104,5 +104,9 @@ var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
         container.innerHTML = "";
     }
 
-    content.textToHtmlCB(identifier, id, timeStamp, html);
+    return html;
+}
+
+var textToHtml = function(identifier, id, timeStamp, text, inlineStyle) {
+    callContent('textToHtmlCB', identifier, id, timeStamp, markdownToHtml(text, inlineStyle));
 }
@@ -18,6 +18,7 @@ new QWebChannel(qt.webChannelTransport,
         content = channel.objects.content;
 
         content.requestPreviewMathJax.connect(previewMathJax);
+        content.requestPreviewMathJaxBatch.connect(previewMathJaxBatch);
         content.requestPreviewDiagram.connect(previewDiagram);
 
         channelInitialized = true;
@@ -36,12 +37,10 @@ var isEmptyMathJax = function(text) {
     return text.replace(/\$/g, '').trim().length == 0;
 };
 
-var previewMathJax = function(identifier, id, timeStamp, text, isHtml) {
-    timeStamps.set(identifier, timeStamp);
-
+// Returns the <p> to typeset @text in, or null if there is nothing to typeset.
+var mathJaxElement = function(text, isHtml) {
     if (isEmptyMathJax(text)) {
-        content.mathjaxResultReady(identifier, id, timeStamp, 'png', '');
-        return;
+        return null;
     }
 
     var p = null;
@@ -60,6 +59,13 @@ var previewMathJax = function(identifier, id, timeStamp, text, isHtml) {
         p.textContent = text;
     }
 
+    return p;
+};
+
+var previewMathJax = function(identifier, id, timeStamp, text, isHtml) {
+    timeStamps.set(identifier, timeStamp);
+
+    var p = mathJaxElement(text, isHtml);
     if (!p) {
         content.mathjaxResultReady(identifier, id, timeStamp, 'png', '');
         return;
@@ -108,6 +114,86 @@ var postProcessMathJax = function(identifier, id, timeStamp, container, isBlock)
     });
 };
 
+// Typeset all @texts in one pass and return the PNG data of all of them in
+// one call, in the order of @ids. Failed ones get empty data.
+// @fontSize: font size in pixels to typeset in, or 0 to use the style's.
+var previewMathJaxBatch = function(identifier, timeStamp, ids, texts, isHtml, fontSize) {
+    timeStamps.set(identifier, timeStamp);
+
+    var results = [];
+    var items = [];
+    var batchDiv = document.createElement('div');
+    for (var i = 0; i < texts.length; ++i) {
+        results.push('');
+
+        var p = mathJaxElement(texts[i], isHtml);
+        if (!p) {
+            continue;
+        }
+
+        if (fontSize > 0) {
+            p.style.fontSize = fontSize + 'px';
+        }
+
+        batchDiv.appendChild(p);
+        items.push({ idx: i, p: p, isBlock: texts[i].indexOf('$$') !== -1 });
+    }
+
+    if (items.length == 0) {
+        content.mathjaxBatchResultReady(identifier, timeStamp, ids, 'png', results);
+        return;
+    }
+
+    contentDiv.appendChild(batchDiv);
+
+    // Number equations of each formula from 1 like one by one.
+    var cmds = [];
+    for (var i = 0; i < items.length; ++i) {
+        cmds.push(["resetEquationNumbers", MathJax.InputJax.TeX]);
+        cmds.push(["Typeset", MathJax.Hub, items[i].p]);
+    }
+
+    cmds.push([postProcessMathJaxBatch, identifier, timeStamp, ids, items, results, batchDiv]);
+
+    try {
+        MathJax.Hub.Queue.apply(MathJax.Hub, cmds);
+    } catch (err) {
+        content.setLog("err: " + err);
+        content.mathjaxBatchResultReady(identifier, timeStamp, ids, 'png', results);
+        contentDiv.removeChild(batchDiv);
+    }
+};
+
+var postProcessMathJaxBatch = function(identifier, timeStamp, ids, items, results, batchDiv) {
+    var idx = 0;
+    var next = function() {
+        // Drop the batch once a newer one comes.
+        if (timeStamps.get(identifier) != timeStamp) {
+            contentDiv.removeChild(batchDiv);
+            return;
+        }
+
+        if (idx >= items.length) {
+            content.mathjaxBatchResultReady(identifier, timeStamp, ids, 'png', results);
+            contentDiv.removeChild(batchDiv);
+            return;
+        }
+
+        var item = items[idx++];
+        var container = item.p;
+        var hei = (item.isBlock ? container.clientHeight * 1.5 : container.clientHeight * 1.6) + 5;
+        domtoimage.toPng(container, { height: hei }).then(function (dataUrl) {
+            results[item.idx] = dataUrl.substring(dataUrl.indexOf(',') + 1);
+            next();
+        }).catch(function (err) {
+            content.setLog("err: " + err);
+            next();
+        });
+    };
+
+    next();
+};
+
 var mermaidParserErr = false;
 var mermaidIdx = 0;
 
@@ -161,7 +161,79 @@ SOURCES += main.cpp\
     widgets/vcombobox.cpp \
     vtablehelper.cpp \
     vtable.cpp \
-    dialog/vinserttabledialog.cpp
+    dialog/vinserttabledialog.cpp \
+    vsearchindex.cpp \
+    vindexedsearchengine.cpp \
+    vexternalsearchengine.cpp \
+    vnoteprefetcher.cpp \
+    vdocumentgovernor.cpp \
+    vtracer.cpp \
+    vlatencystats.cpp \
+    dialog/vlatencystatsdialog.cpp \
+    vrendercache.cpp \
+    vplantumlserver.cpp \
+    vrenderscheduler.cpp \
+    vimagedecoder.cpp \
+    vblockheightindex.cpp \
+    vmarkdownconvertservice.cpp \
+    vnotebooksnapshot.cpp \
+    vdirectorynode.cpp \
+    vtaskexecutor.cpp \
+    vdirectoryprefetcher.cpp \
+    vdirectoryconfigwriter.cpp \
+    vnotebookwatcher.cpp \
+    vwebviewpool.cpp \
+    vwordindex.cpp \
+    vcompletiondictionary.cpp \
+    vwordcounter.cpp \
+    vmultipatternmatcher.cpp \
+    vregexpsearcher.cpp \
+    vcodeblocktokenizer.cpp \
+    vnativehtmlrenderer.cpp \
+    vprocessrunner.cpp \
+    vexportmanifest.cpp \
+    utils/vfilecopier.cpp \
+    vbenchmark.cpp \
+    vbatchrunner.cpp \
+    vimagededuper.cpp \
+    vnotebookchecker.cpp \
+    vcompletionmodel.cpp \
+    vtaguniverse.cpp \
+    vpreviewscheduler.cpp \
+    vtagindex.cpp \
+    vpathindex.cpp \
+    vattachmenttransfer.cpp \
+    vhttpfetcher.cpp \
+    vbackupjournal.cpp \
+    vsaveservice.cpp \
+    vfilechangechecker.cpp \
+    utils/vstylecache.cpp \
+    pegparsescheduler.cpp \
+    vcodeblockstyletable.cpp \
+    vdocumentstructure.cpp \
+    utils/vhtmlrewriter.cpp \
+    vimageencoder.cpp \
+    utils/vhtmltomarkdown.cpp \
+    vhtmltomarkdownservice.cpp \
+    vsourcelinemap.cpp \
+    vreadmodecache.cpp \
+    vmemorystats.cpp \
+    dialog/vmemorystatsdialog.cpp \
+    vdirectorycrawler.cpp \
+    vsavedsearch.cpp \
+    vmetadataquery.cpp \
+    vnotemetadatastore.cpp \
+    vrecyclebin.cpp \
+    vdirectorycopier.cpp \
+    vfilesystemmodel.cpp \
+    vnoteimporter.cpp \
+    vmdlitetab.cpp \
+    vsharedimagecache.cpp \
+    vstructureindex.cpp \
+    vdiagramcache.cpp \
+    vnotebookstatistics.cpp \
+    vtexttab.cpp \
+    vviewporthighlighter.cpp
 
 HEADERS  += vmainwindow.h \
     vdirectorytree.h \
@@ -307,12 +379,93 @@ HEADERS  += vmainwindow.h \
     widgets/vcombobox.h \
     vtablehelper.h \
     vtable.h \
-    dialog/vinserttabledialog.h
+    dialog/vinserttabledialog.h \
+    vsearchindex.h \
+    vindexedsearchengine.h \
+    vexternalsearchengine.h \
+    vnoteprefetcher.h \
+    vdocumentgovernor.h \
+    vtracer.h \
+    vlatencystats.h \
+    dialog/vlatencystatsdialog.h \
+    vrendercache.h \
+    vplantumlserver.h \
+    vrenderscheduler.h \
+    vimagedecoder.h \
+    vblockheightindex.h \
+    vmarkdownconvertservice.h \
+    vnotebooksnapshot.h \
+    vdirectorynode.h \
+    vtaskexecutor.h \
+    vdirectoryprefetcher.h \
+    vdirectoryconfigwriter.h \
+    vnotebookwatcher.h \
+    vwebviewpool.h \
+    vwordindex.h \
+    vcompletiondictionary.h \
+    vwordcounter.h \
+    vmultipatternmatcher.h \
+    vregexpsearcher.h \
+    vcodeblocktokenizer.h \
+    vnativehtmlrenderer.h \
+    vprocessrunner.h \
+    vexportmanifest.h \
+    utils/vfilecopier.h \
+    vbenchmark.h \
+    vbatchrunner.h \
+    vimagededuper.h \
+    vnotebookchecker.h \
+    vcompletionmodel.h \
+    vtaguniverse.h \
+    vpreviewscheduler.h \
+    vtagindex.h \
+    vpathindex.h \
+    vattachmenttransfer.h \
+    vhttpfetcher.h \
+    vbackupjournal.h \
+    vsaveservice.h \
+    vfilechangechecker.h \
+    utils/vstylecache.h \
+    pegparsescheduler.h \
+    vcodeblockstyletable.h \
+    vdocumentstructure.h \
+    utils/vhtmlrewriter.h \
+    vimageencoder.h \
+    utils/vhtmltomarkdown.h \
+    vhtmltomarkdownservice.h \
+    vsourcelinemap.h \
+    vreadmodecache.h \
+    vmemorystats.h \
+    dialog/vmemorystatsdialog.h \
+    vdirectorycrawler.h \
+    vsavedsearch.h \
+    vmetadataquery.h \
+    vnotemetadatastore.h \
+    vconfigkeys.h \
+    vrecyclebin.h \
+    vdirectorycopier.h \
+    vfilesystemmodel.h \
+    vnoteimporter.h \
+    vmdlitetab.h \
+    vsharedimagecache.h \
+    vstructureindex.h \
+    vdiagramcache.h \
+    vnotebookstatistics.h \
+    vtexttab.h \
+    vviewporthighlighter.h
 
 RESOURCES += \
     vnote.qrc \
     translations.qrc
 
+# Diagram scripts are built into an external resource pack loaded on demand.
+DIAGRAM_PACK = $$OUT_PWD/vnote_diagram.rcc
+diagram_pack.target = $$DIAGRAM_PACK
+diagram_pack.depends = $$PWD/vnote_diagram.qrc
+diagram_pack.commands = $$[QT_HOST_BINS]/rcc -binary $$PWD/vnote_diagram.qrc -o $$DIAGRAM_PACK
+QMAKE_EXTRA_TARGETS += diagram_pack
+PRE_TARGETDEPS += $$DIAGRAM_PACK
+
 macx {
     LIBS += -L/usr/local/lib
     INCLUDEPATH += /usr/local/include
@@ -390,9 +543,14 @@ unix:!macx {
 
     target.path = $${PREFIX}/bin
 
+    # install diagram resource pack
+    diagrampack.path = $${DATADIR}/vnote
+    diagrampack.files = $$DIAGRAM_PACK
+    diagrampack.CONFIG += no_check_exist
+
     lntarget.path = $${PREFIX}/bin
     lntarget.extra = $(SYMLINK) $(QMAKE_TARGET) $(INSTALL_ROOT)$${PREFIX}/bin/vnote
 
-    INSTALLS += target lntarget desktop icon16 icon32 icon48 icon64 icon128 icon256 iconsvg
+    INSTALLS += target lntarget diagrampack desktop icon16 icon32 icon48 icon64 icon128 icon256 iconsvg
     message("VNote will be installed in prefix $${PREFIX}")
 }
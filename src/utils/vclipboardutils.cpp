@@ -2,66 +2,40 @@
 
 #include <QDebug>
 #include <QMimeData>
+#include <QTimer>
+#include <QPointer>
 
 #include "vutils.h"
 
+#define CLIPBOARD_RETRY_INTERVAL 100
+
+#define CLIPBOARD_MAX_ATTEMPTS 100
+
 void VClipboardUtils::setImageToClipboard(QClipboard *p_clipboard,
                                           const QImage &p_image,
-                                          QClipboard::Mode p_mode)
+                                          QClipboard::Mode p_mode,
+                                          const ClipboardFunc &p_func)
 {
-#if defined(Q_OS_WIN) || defined(Q_OS_LINUX)
-    // On Windows, setImage() may fail. We will repeatedly retry until succeed.
-    // On Linux, QXcbClipboard::setMimeData: Cannot set X11 selection owner.
-    setImageLoop(p_clipboard, p_image, p_mode);
-#else
-    p_clipboard->setImage(p_image, p_mode);
-#endif
-}
-
-void VClipboardUtils::setImageLoop(QClipboard *p_clipboard,
-                                   const QImage &p_image,
-                                   QClipboard::Mode p_mode)
-{
-    for (int i = 0; i < 100; ++i) {
-        p_clipboard->setImage(p_image, p_mode);
-
-        QImage image = p_clipboard->image(p_mode);
-        if (!image.isNull()) {
-            break;
-        }
-
-        qWarning() << "fail to set image, retry" << i;
-
-        VUtils::sleepWait(100 /* ms */);
-    }
+    QMimeData *data = new QMimeData();
+    data->setImageData(p_image);
+    publish(p_clipboard, data, true, p_mode, p_func);
 }
 
 void VClipboardUtils::setImageToClipboard(QClipboard *p_clipboard,
                                           const QPixmap &p_image,
-                                          QClipboard::Mode p_mode)
+                                          QClipboard::Mode p_mode,
+                                          const ClipboardFunc &p_func)
 {
-    QImage img(p_image.toImage());
-
-#if defined(Q_OS_WIN) || defined(Q_OS_LINUX)
-    // On Windows, setImage() may fail. We will repeatedly retry until succeed.
-    // On Linux, QXcbClipboard::setMimeData: Cannot set X11 selection owner.
-    setImageLoop(p_clipboard, img, p_mode);
-#else
-    p_clipboard->setImage(img, p_mode);
-#endif
+    // Convert once here instead of on each retry.
+    setImageToClipboard(p_clipboard, p_image.toImage(), p_mode, p_func);
 }
 
 void VClipboardUtils::setMimeDataToClipboard(QClipboard *p_clipboard,
                                              QMimeData *p_mimeData,
-                                             QClipboard::Mode p_mode)
+                                             QClipboard::Mode p_mode,
+                                             const ClipboardFunc &p_func)
 {
-#if defined(Q_OS_WIN) || defined(Q_OS_LINUX)
-    // On Windows, setMimeData() may fail. We will repeatedly retry until succeed.
-    // On Linux, QXcbClipboard::setMimeData: Cannot set X11 selection owner.
-    setMimeDataLoop(p_clipboard, p_mimeData, p_mode);
-#else
-    p_clipboard->setMimeData(p_mimeData, p_mode);
-#endif
+    publish(p_clipboard, p_mimeData, false, p_mode, p_func);
 }
 
 QMimeData *VClipboardUtils::cloneMimeData(const QMimeData *p_mimeData)
@@ -159,26 +133,136 @@ static bool mimeDataEquals(const QMimeData *p_a, const QMimeData *p_b)
     return true;
 }
 
-void VClipboardUtils::setMimeDataLoop(QClipboard *p_clipboard,
-                                      QMimeData *p_mimeData,
-                                      QClipboard::Mode p_mode)
+// Publish the prepared mime data to the clipboard every
+// CLIPBOARD_RETRY_INTERVAL ms until it succeeds or CLIPBOARD_MAX_ATTEMPTS
+// attempts are made. The clipboard takes the ownership of the data set, so
+// each attempt sets a shallow copy of the prepared one.
+class VClipboardPublisher : public QObject
 {
-    for (int i = 0; i < 100; ++i) {
-        // Make a backup.
-        QMimeData *tmp = cloneMimeData(p_mimeData);
-
-        p_clipboard->setMimeData(p_mimeData, p_mode);
-        const QMimeData *out = p_clipboard->mimeData(p_mode);
-        if (mimeDataEquals(tmp, out)) {
-            delete tmp;
-            break;
+public:
+    VClipboardPublisher(QClipboard *p_clipboard,
+                        QMimeData *p_mimeData,
+                        bool p_imageOnly,
+                        QClipboard::Mode p_mode,
+                        const ClipboardFunc &p_func)
+        : QObject(p_clipboard),
+          m_clipboard(p_clipboard),
+          m_data(p_mimeData),
+          m_imageOnly(p_imageOnly),
+          m_mode(p_mode),
+          m_func(p_func),
+          m_attempts(0),
+          m_finished(false)
+    {
+        m_timer = new QTimer(this);
+        m_timer->setInterval(CLIPBOARD_RETRY_INTERVAL);
+        connect(m_timer, &QTimer::timeout,
+                this, [this]() {
+                    tryPublish();
+                });
+    }
+
+    ~VClipboardPublisher()
+    {
+        delete m_data;
+    }
+
+    // Return true if finished.
+    bool tryPublish()
+    {
+        Q_ASSERT(!m_finished);
+        ++m_attempts;
+        m_clipboard->setMimeData(VClipboardUtils::cloneMimeData(m_data), m_mode);
+
+        const QMimeData *out = m_clipboard->mimeData(m_mode);
+        bool succeeded = m_imageOnly ? out && out->hasImage()
+                                     : mimeDataEquals(m_data, out);
+        if (succeeded) {
+            finish(true);
+        } else if (m_attempts >= CLIPBOARD_MAX_ATTEMPTS) {
+            qWarning() << "fail to set clipboard after" << m_attempts << "attempts";
+            finish(false);
+        } else {
+            qDebug() << "fail to set clipboard, retry" << m_attempts;
+        }
+
+        return m_finished;
+    }
+
+    void start()
+    {
+        m_timer->start();
+    }
+
+    // Stop retrying and report the result.
+    void finish(bool p_succeeded)
+    {
+        if (m_finished) {
+            return;
         }
 
-        qDebug() << "fail to set mimeData, retry" << i;
-        p_mimeData = tmp;
+        m_finished = true;
+        m_timer->stop();
+        deleteLater();
+
+        if (m_func) {
+            m_func(p_succeeded);
+        }
+    }
+
+private:
+    QClipboard *m_clipboard;
+
+    // Prepared data to publish.
+    QMimeData *m_data;
+
+    bool m_imageOnly;
+
+    QClipboard::Mode m_mode;
 
-        VUtils::sleepWait(100 /* ms */);
+    ClipboardFunc m_func;
+
+    int m_attempts;
+
+    bool m_finished;
+
+    QTimer *m_timer;
+};
+
+void VClipboardUtils::publish(QClipboard *p_clipboard,
+                              QMimeData *p_mimeData,
+                              bool p_imageOnly,
+                              QClipboard::Mode p_mode,
+                              const ClipboardFunc &p_func)
+{
+#if defined(Q_OS_WIN) || defined(Q_OS_LINUX)
+    // On Windows, setMimeData() may fail. We will retry until succeed.
+    // On Linux, QXcbClipboard::setMimeData: Cannot set X11 selection owner.
+    static QPointer<VClipboardPublisher> pendings[QClipboard::LastMode + 1];
+
+    QPointer<VClipboardPublisher> &pending = pendings[p_mode];
+    if (pending) {
+        // Superseded by the newer data.
+        pending->finish(false);
+        pending.clear();
+    }
+
+    VClipboardPublisher *publisher = new VClipboardPublisher(p_clipboard,
+                                                             p_mimeData,
+                                                             p_imageOnly,
+                                                             p_mode,
+                                                             p_func);
+    if (!publisher->tryPublish()) {
+        pending = publisher;
+        publisher->start();
     }
+#else
+    Q_UNUSED(p_imageOnly);
+    p_clipboard->setMimeData(p_mimeData, p_mode);
+    if (p_func) {
+        p_func(true);
+    }
+#endif
 }
 
 QMimeData *linkMimeData(const QString &p_link)
@@ -201,21 +285,25 @@ QMimeData *linkMimeData(const QString &p_link)
 
 void VClipboardUtils::setLinkToClipboard(QClipboard *p_clipboard,
                                          const QString &p_link,
-                                         QClipboard::Mode p_mode)
+                                         QClipboard::Mode p_mode,
+                                         const ClipboardFunc &p_func)
 {
     VClipboardUtils::setMimeDataToClipboard(p_clipboard,
                                             linkMimeData(p_link),
-                                            p_mode);
+                                            p_mode,
+                                            p_func);
 }
 
 void VClipboardUtils::setImageAndLinkToClipboard(QClipboard *p_clipboard,
                                                  const QImage &p_image,
                                                  const QString &p_link,
-                                                 QClipboard::Mode p_mode)
+                                                 QClipboard::Mode p_mode,
+                                                 const ClipboardFunc &p_func)
 {
     QMimeData *data = linkMimeData(p_link);
     data->setImageData(p_image);
     VClipboardUtils::setMimeDataToClipboard(p_clipboard,
                                             data,
-                                            p_mode);
+                                            p_mode,
+                                            p_func);
 }
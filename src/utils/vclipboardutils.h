@@ -5,47 +5,60 @@
 #include <QPixmap>
 #include <QClipboard>
 
+#include <functional>
+
 class QMimeData;
 
+// Called once the data is published to the clipboard or given up.
+typedef std::function<void(bool p_succeeded)> ClipboardFunc;
 
+// On Windows and Linux, setting the clipboard may fail when it is held by
+// others. The data is then published again by a timer in the background
+// instead of blocking the caller. A newer publish to the same mode cancels
+// the pending one.
 class VClipboardUtils
 {
 public:
     static void setImageToClipboard(QClipboard *p_clipboard,
                                     const QImage &p_image,
-                                    QClipboard::Mode p_mode = QClipboard::Clipboard);
+                                    QClipboard::Mode p_mode = QClipboard::Clipboard,
+                                    const ClipboardFunc &p_func = nullptr);
 
     static void setImageToClipboard(QClipboard *p_clipboard,
                                     const QPixmap &p_image,
-                                    QClipboard::Mode p_mode = QClipboard::Clipboard);
+                                    QClipboard::Mode p_mode = QClipboard::Clipboard,
+                                    const ClipboardFunc &p_func = nullptr);
 
     static void setImageAndLinkToClipboard(QClipboard *p_clipboard,
                                            const QImage &p_image,
                                            const QString &p_link,
-                                           QClipboard::Mode p_mode = QClipboard::Clipboard);
+                                           QClipboard::Mode p_mode = QClipboard::Clipboard,
+                                           const ClipboardFunc &p_func = nullptr);
 
     static void setMimeDataToClipboard(QClipboard *p_clipboard,
                                        QMimeData *p_mimeData,
-                                       QClipboard::Mode p_mode = QClipboard::Clipboard);
+                                       QClipboard::Mode p_mode = QClipboard::Clipboard,
+                                       const ClipboardFunc &p_func = nullptr);
 
     static QMimeData *cloneMimeData(const QMimeData *p_mimeData);
 
     static void setLinkToClipboard(QClipboard *p_clipboard,
                                    const QString &p_link,
-                                   QClipboard::Mode p_mode = QClipboard::Clipboard);
+                                   QClipboard::Mode p_mode = QClipboard::Clipboard,
+                                   const ClipboardFunc &p_func = nullptr);
 
 private:
     VClipboardUtils()
     {
     }
 
-    static void setImageLoop(QClipboard *p_clipboard,
-                             const QImage &p_image,
-                             QClipboard::Mode p_mode);
-
-    static void setMimeDataLoop(QClipboard *p_clipboard,
-                                QMimeData *p_mimeData,
-                                QClipboard::Mode p_mode);
+    // Take the ownership of @p_mimeData.
+    // @p_imageOnly: only check whether the clipboard has an image after set.
+    static void publish(QClipboard *p_clipboard,
+                        QMimeData *p_mimeData,
+                        bool p_imageOnly,
+                        QClipboard::Mode p_mode,
+                        const ClipboardFunc &p_func);
 };
 
 #endif // VCLIPBOARDUTILS_H
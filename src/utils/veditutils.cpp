@@ -8,6 +8,7 @@
 
 #include "vutils.h"
 #include "vcodeblockhighlighthelper.h"
+#include "vstructureindex.h"
 
 void VEditUtils::removeBlock(QTextBlock &p_block, QString *p_text)
 {
@@ -141,24 +142,21 @@ bool VEditUtils::indentBlockAsBlock(QTextCursor &p_cursor, const QTextBlock &p_r
     return changed;
 }
 
-// Use another QTextCursor to remain the selection.
-void VEditUtils::indentSelectedBlocksAsBlock(const QTextCursor &p_cursor, bool p_next)
+void VEditUtils::indentSelectedBlocksAsBlock(QTextCursor &p_cursor, bool p_next)
 {
-    int nrBlocks = 1;
     int start = p_cursor.selectionStart();
     int end = p_cursor.selectionEnd();
 
     QTextDocument *doc = p_cursor.document();
     QTextBlock sBlock = doc->findBlock(start);
+    QTextBlock eBlock = sBlock;
     QTextBlock refBlock;
     if (!p_next) {
         refBlock = sBlock.previous();
     }
 
     if (start != end) {
-        QTextBlock eBlock = doc->findBlock(end);
-        nrBlocks = eBlock.blockNumber() - sBlock.blockNumber() + 1;
-
+        eBlock = doc->findBlock(end);
         if (p_next) {
             refBlock = eBlock.next();
         }
@@ -166,15 +164,15 @@ void VEditUtils::indentSelectedBlocksAsBlock(const QTextCursor &p_cursor, bool p
         refBlock = sBlock.next();
     }
 
-    QTextCursor bCursor(sBlock);
-    bCursor.beginEditBlock();
-    for (int i = 0; i < nrBlocks; ++i) {
-        indentBlockAsBlock(bCursor, refBlock);
-
-        bCursor.movePosition(QTextCursor::NextBlock);
+    if (!refBlock.isValid()) {
+        return;
     }
 
-    bCursor.endEditBlock();
+    const QString leadingSpaces = fetchIndentSpaces(refBlock);
+    transformBlocks(p_cursor, sBlock, eBlock, [&leadingSpaces](const QTextBlock &p_block) -> QString {
+        QString text = p_block.text();
+        return leadingSpaces + text.mid(fetchIndentation(text));
+    });
 }
 
 bool VEditUtils::hasSameIndent(const QTextBlock &p_blocka, const QTextBlock &p_blockb)
@@ -235,34 +233,143 @@ QString VEditUtils::selectedText(const QTextCursor &p_cursor)
 }
 
 // Use another QTextCursor to remain the selection.
-void VEditUtils::indentSelectedBlocks(const QTextCursor &p_cursor,
+// Map @p_offset in @p_oldText to @p_newText. Only the text between the
+// common prefix and suffix is changed, and an offset at the start of the
+// change moves after it like a cursor does on insertion.
+static int mapOffset(const QString &p_oldText, const QString &p_newText, int p_offset)
+{
+    const int oldSize = p_oldText.size();
+    const int newSize = p_newText.size();
+    const int minSize = qMin(oldSize, newSize);
+    int suffix = 0;
+    while (suffix < minSize && p_oldText[oldSize - 1 - suffix] == p_newText[newSize - 1 - suffix]) {
+        ++suffix;
+    }
+
+    int prefix = 0;
+    while (prefix < minSize - suffix && p_oldText[prefix] == p_newText[prefix]) {
+        ++prefix;
+    }
+
+    if (p_offset >= oldSize - suffix) {
+        return p_offset + newSize - oldSize;
+    } else if (p_offset <= prefix) {
+        return p_offset;
+    }
+
+    return newSize - suffix;
+}
+
+bool VEditUtils::transformBlocks(QTextCursor &p_cursor,
+                                 const QTextBlock &p_firstBlock,
+                                 const QTextBlock &p_lastBlock,
+                                 const std::function<QString(const QTextBlock &)> &p_func)
+{
+    Q_ASSERT(p_firstBlock.isValid() && p_lastBlock.isValid());
+    Q_ASSERT(p_firstBlock.blockNumber() <= p_lastBlock.blockNumber());
+
+    const int start = p_firstBlock.position();
+    const int end = p_lastBlock.position() + p_lastBlock.length() - 1;
+    int anchor = p_cursor.anchor();
+    int position = p_cursor.position();
+    int newAnchor = anchor;
+    int newPosition = position;
+
+    QString newText;
+    bool changed = false;
+    int delta = 0;
+    QTextBlock block = p_firstBlock;
+    while (block.isValid()) {
+        const QString text = block.text();
+        const QString blockText = p_func(block);
+        if (blockText != text) {
+            changed = true;
+        }
+
+        int bpos = block.position();
+        if (anchor >= bpos && anchor <= bpos + text.size()) {
+            newAnchor = bpos + delta + mapOffset(text, blockText, anchor - bpos);
+        }
+
+        if (position >= bpos && position <= bpos + text.size()) {
+            newPosition = bpos + delta + mapOffset(text, blockText, position - bpos);
+        }
+
+        if (block != p_firstBlock) {
+            newText += '\n';
+        }
+
+        newText += blockText;
+        delta += blockText.size() - text.size();
+
+        if (block == p_lastBlock) {
+            break;
+        }
+
+        block = block.next();
+    }
+
+    if (!changed) {
+        return false;
+    }
+
+    if (anchor > end) {
+        newAnchor = anchor + delta;
+    }
+
+    if (position > end) {
+        newPosition = position + delta;
+    }
+
+    QTextCursor cursor(p_cursor.document());
+    cursor.setPosition(start);
+    cursor.setPosition(end, QTextCursor::KeepAnchor);
+    cursor.insertText(newText);
+
+    p_cursor.setPosition(newAnchor);
+    p_cursor.setPosition(newPosition, QTextCursor::KeepAnchor);
+    return true;
+}
+
+void VEditUtils::indentSelectedBlocks(QTextCursor &p_cursor,
                                       const QString &p_indentationText,
                                       bool p_isIndent)
 {
-    int nrBlocks = 1;
     int start = p_cursor.selectionStart();
     int end = p_cursor.selectionEnd();
 
     QTextDocument *doc = p_cursor.document();
     QTextBlock sBlock = doc->findBlock(start);
+    QTextBlock eBlock = sBlock;
     if (start != end) {
-        QTextBlock eBlock = doc->findBlock(end);
-        nrBlocks = eBlock.blockNumber() - sBlock.blockNumber() + 1;
-    }
-
-    QTextCursor bCursor(sBlock);
-    bCursor.beginEditBlock();
-    for (int i = 0; i < nrBlocks; ++i) {
-        if (p_isIndent) {
-            indentBlock(bCursor, p_indentationText);
-        } else {
-            unindentBlock(bCursor, p_indentationText);
-        }
-
-        bCursor.movePosition(QTextCursor::NextBlock);
-    }
-
-    bCursor.endEditBlock();
+        eBlock = doc->findBlock(end);
+    }
+
+    transformBlocks(p_cursor,
+                    sBlock,
+                    eBlock,
+                    [&p_indentationText, p_isIndent](const QTextBlock &p_block) -> QString {
+                        QString text = p_block.text();
+                        if (text.isEmpty()) {
+                            return text;
+                        }
+
+                        if (p_isIndent) {
+                            return p_indentationText + text;
+                        }
+
+                        // Same as unindentBlock().
+                        if (text[0] == '\t') {
+                            return text.mid(1);
+                        }
+
+                        int idx = 0;
+                        while (idx < p_indentationText.size() && idx < text.size() && text[idx] == ' ') {
+                            ++idx;
+                        }
+
+                        return text.mid(idx);
+                    });
 }
 
 void VEditUtils::indentBlock(QTextCursor &p_cursor,
@@ -677,12 +784,75 @@ void VEditUtils::deleteIndentAndListMark(QTextCursor &p_cursor)
 }
 
 
+// Find backwards from @p_pos to @p_start the @p_opening which is not paired.
+// @p_pair: index of the pair in @p_index, or -1 to scan the document.
+// Returns -1 if not found.
+static int findUnpairedOpening(const QTextDocument *p_doc,
+                               QChar p_opening,
+                               QChar p_closing,
+                               int p_pos,
+                               int p_start,
+                               VStructureIndex *p_index,
+                               int p_pair)
+{
+    if (p_pair != -1) {
+        return p_index->findOpening(p_pair, p_pos, 1);
+    }
+
+    int nrPair = 1;
+    for (int i = p_pos; i >= p_start; --i) {
+        QChar ch = p_doc->characterAt(i);
+        Q_ASSERT(!ch.isNull());
+        if (ch == p_opening) {
+            if (--nrPair == 0) {
+                return i;
+            }
+        } else if (ch == p_closing) {
+            ++nrPair;
+        }
+    }
+
+    return -1;
+}
+
+// Find forwards from @p_pos to @p_end the @p_closing which is not paired.
+// @p_pair: index of the pair in @p_index, or -1 to scan the document.
+// Returns -1 if not found.
+static int findUnpairedClosing(const QTextDocument *p_doc,
+                               QChar p_opening,
+                               QChar p_closing,
+                               int p_pos,
+                               int p_end,
+                               VStructureIndex *p_index,
+                               int p_pair)
+{
+    if (p_pair != -1) {
+        return p_index->findClosing(p_pair, p_pos, 1);
+    }
+
+    int nrPair = 1;
+    for (int j = p_pos; j <= p_end; ++j) {
+        QChar ch = p_doc->characterAt(j);
+        Q_ASSERT(!ch.isNull());
+        if (ch == p_closing) {
+            if (--nrPair == 0) {
+                return j;
+            }
+        } else if (ch == p_opening) {
+            ++nrPair;
+        }
+    }
+
+    return -1;
+}
+
 bool VEditUtils::selectPairTargetAround(QTextCursor &p_cursor,
                                         QChar p_opening,
                                         QChar p_closing,
                                         bool p_inclusive,
                                         bool p_crossBlock,
-                                        int p_repeat)
+                                        int p_repeat,
+                                        VStructureIndex *p_index)
 {
     Q_ASSERT(p_repeat >= 1);
 
@@ -704,12 +874,13 @@ bool VEditUtils::selectPairTargetAround(QTextCursor &p_cursor,
 
     Q_ASSERT(!doc->characterAt(pos).isNull());
 
-    bool found = false;
+    // The index covers the whole document.
+    int pair = -1;
+    if (p_index && p_crossBlock) {
+        pair = VStructureIndex::pairIndex(p_opening, p_closing);
+    }
 
-    // The number of un-paired symbols before we meet a target.
-    // For example, when we are searching the `(`, nrPair is the number of
-    // the un-paired `)` currently.
-    int nrPair = 0;
+    bool found = false;
 
     // The absolute position of the found target.
     // vnote|(vnote|)vnote
@@ -723,25 +894,14 @@ round:
     Q_ASSERT(!ch.isNull());
     if (ch == p_closing) {
         // Try to find the opening.
-        nrPair = 1;
-        int i = opening;
-        if (opening == closing) {
-            --i;
-        }
-
-        for (; i >= start; --i) {
-            ch = doc->characterAt(i);
-            Q_ASSERT(!ch.isNull());
-            if (ch == p_opening) {
-                if (--nrPair == 0) {
-                    break;
-                }
-            } else if (ch == p_closing) {
-                ++nrPair;
-            }
-        }
-
-        if (i >= start) {
+        int i = findUnpairedOpening(doc,
+                                    p_opening,
+                                    p_closing,
+                                    opening == closing ? opening - 1 : opening,
+                                    start,
+                                    p_index,
+                                    pair);
+        if (i != -1) {
             // Found the opening. Done.
             opening = i;
             found = true;
@@ -752,25 +912,14 @@ round:
     Q_ASSERT(!ch.isNull());
     if (!found && ch == p_opening) {
         // Try to find the closing.
-        nrPair = 1;
-        int j = closing;
-        if (opening == closing) {
-            ++j;
-        }
-
-        for (; j <= end; ++j) {
-            ch = doc->characterAt(j);
-            Q_ASSERT(!ch.isNull());
-            if (ch == p_closing) {
-                if (--nrPair == 0) {
-                    break;
-                }
-            } else if (ch == p_opening) {
-                ++nrPair;
-            }
-        }
-
-        if (j <= end) {
+        int j = findUnpairedClosing(doc,
+                                    p_opening,
+                                    p_closing,
+                                    opening == closing ? closing + 1 : closing,
+                                    end,
+                                    p_index,
+                                    pair);
+        if (j != -1) {
             // Foudnd the closing. Done.
             closing = j;
             found = true;
@@ -781,39 +930,24 @@ round:
         && doc->characterAt(opening) != p_opening
         && doc->characterAt(closing) != p_closing) {
         // Need to find both the opening and closing.
-        int i = opening - 1;
-        int j = closing + 1;
-        // Pretend that we have found one.
-        nrPair = 1;
-        for (; i >= start; --i) {
-            ch = doc->characterAt(i);
-            Q_ASSERT(!ch.isNull());
-            if (ch == p_opening) {
-                if (--nrPair == 0) {
-                    break;
-                }
-            } else if (ch == p_closing) {
-                ++nrPair;
-            }
-        }
-
-        if (i >= start) {
+        int i = findUnpairedOpening(doc,
+                                    p_opening,
+                                    p_closing,
+                                    opening - 1,
+                                    start,
+                                    p_index,
+                                    pair);
+        if (i != -1) {
             opening = i;
             // Continue to find the closing.
-            nrPair = 1;
-            for (; j <= end; ++j) {
-                ch = doc->characterAt(j);
-                Q_ASSERT(!ch.isNull());
-                if (ch == p_closing) {
-                    if (--nrPair == 0) {
-                        break;
-                    }
-                } else if (ch == p_opening) {
-                    ++nrPair;
-                }
-            }
-
-            if (j <= end) {
+            int j = findUnpairedClosing(doc,
+                                        p_opening,
+                                        p_closing,
+                                        closing + 1,
+                                        end,
+                                        p_index,
+                                        pair);
+            if (j != -1) {
                 closing = j;
                 found = true;
             }
@@ -848,9 +982,14 @@ round:
 
 int VEditUtils::findNextEmptyBlock(const QTextCursor &p_cursor,
                                    bool p_forward,
-                                   int p_repeat)
+                                   int p_repeat,
+                                   VStructureIndex *p_index)
 {
     Q_ASSERT(p_repeat > 0);
+    if (p_index) {
+        return p_index->findEmptyBlock(p_cursor.block().blockNumber(), p_forward, p_repeat);
+    }
+
     int res = -1;
     QTextBlock block = p_cursor.block();
     if (p_forward) {
@@ -952,6 +1091,54 @@ void VEditUtils::insertTitleMark(QTextCursor &p_cursor,
     p_cursor.movePosition(QTextCursor::EndOfBlock);
 }
 
+void VEditUtils::insertTitleMark(QTextCursor &p_cursor,
+                                 const QTextBlock &p_firstBlock,
+                                 const QTextBlock &p_lastBlock,
+                                 int p_level)
+{
+    if (!p_firstBlock.isValid() || !p_lastBlock.isValid()) {
+        return;
+    }
+
+    Q_ASSERT(p_level >= 0 && p_level <= 6);
+
+    // Same as the one of a block.
+    QRegExp headerReg(VUtils::c_headerRegExp);
+    QRegExp prefixReg(VUtils::c_headerPrefixRegExp);
+    int lastNumber = p_lastBlock.blockNumber();
+    transformBlocks(p_cursor,
+                    p_firstBlock,
+                    p_lastBlock,
+                    [&headerReg, &prefixReg, p_level](const QTextBlock &p_block) -> QString {
+                        QString text = p_block.text();
+                        if (headerReg.exactMatch(text)) {
+                            int level = headerReg.cap(1).length();
+                            if (level == p_level) {
+                                return text;
+                            }
+
+                            int length = level;
+                            if (p_level == 0) {
+                                // Remove all the prefix.
+                                prefixReg.exactMatch(text);
+                                length = prefixReg.cap(1).length();
+                            }
+
+                            text.remove(0, length);
+                        }
+
+                        if (p_level > 0) {
+                            text = QString(p_level, '#') + " " + text.mid(fetchIndentation(text));
+                        }
+
+                        return text;
+                    });
+
+    // Go to the end of the last block.
+    QTextBlock block = p_cursor.document()->findBlockByNumber(lastNumber);
+    p_cursor.setPosition(block.position() + block.length() - 1);
+}
+
 void VEditUtils::findCurrentWord(QTextCursor p_cursor,
                                  int &p_start,
                                  int &p_end,
@@ -1146,3 +1333,25 @@ bool VEditUtils::isSpaceOrWordSeparator(QChar p_char)
 {
     return p_char.isSpace() || isWordSeparator(p_char);
 }
+
+bool VEditUtils::mapContentsChange(const QTextDocument *p_doc,
+                                   int p_oldBlockCount,
+                                   int p_position,
+                                   int p_charsAdded,
+                                   int &p_first,
+                                   int &p_oldCount,
+                                   int &p_newCount)
+{
+    // The change spans blocks [first, last] now.
+    int maxPos = p_doc->characterCount() - 1;
+    QTextBlock firstBlock = p_doc->findBlock(qBound(0, p_position, maxPos));
+    QTextBlock lastBlock = p_doc->findBlock(qBound(0, p_position + p_charsAdded, maxPos));
+    if (!firstBlock.isValid() || !lastBlock.isValid()) {
+        return false;
+    }
+
+    p_first = firstBlock.blockNumber();
+    p_newCount = lastBlock.blockNumber() - p_first + 1;
+    p_oldCount = p_newCount - (p_doc->blockCount() - p_oldBlockCount);
+    return p_oldCount >= 1 && p_first + p_oldCount <= p_oldBlockCount;
+}
@@ -3,10 +3,12 @@
 
 #include <QTextBlock>
 #include <QTextCursor>
+#include <functional>
 
 class QTextDocument;
 class QTextEdit;
 class QPlainTextEdit;
+class VStructureIndex;
 
 // Utils for text edit.
 class VEditUtils
@@ -64,18 +66,28 @@ public:
     // This function will translate it to \n.
     static QString selectedText(const QTextCursor &p_cursor);
 
-    // Indent selected blocks. If no selection, indent current block.
-    // Cursor position and selection is not changed.
+    // Replace the text of blocks [@p_firstBlock, @p_lastBlock] with the
+    // results of @p_func on each of them in one edit, so the highlighter and
+    // the layout handle one change instead of one per block.
+    // @p_cursor: its position and anchor are kept at the same text as edits
+    // of each block would do.
+    // Returns true if any block is changed.
+    static bool transformBlocks(QTextCursor &p_cursor,
+                                const QTextBlock &p_firstBlock,
+                                const QTextBlock &p_lastBlock,
+                                const std::function<QString(const QTextBlock &)> &p_func);
+
+    // Indent selected blocks in one edit. If no selection, indent current block.
+    // Cursor position and selection is kept at the same text.
     // @p_isIndent: whether it is indentation or unindentation.
-    static void indentSelectedBlocks(const QTextCursor &p_cursor,
+    static void indentSelectedBlocks(QTextCursor &p_cursor,
                                      const QString &p_indentationText,
                                      bool p_isIndent);
 
-    // Indent seleced block as next/previous block.
-    // Cursor position and selection is not changed.
-    // Return true if some changes have been made.
+    // Indent seleced block as next/previous block in one edit.
+    // Cursor position and selection is kept at the same text.
     // @p_next: indent as next block or previous block.
-    static void indentSelectedBlocksAsBlock(const QTextCursor &p_cursor, bool p_next);
+    static void indentSelectedBlocksAsBlock(QTextCursor &p_cursor, bool p_next);
 
     // Indent current block.
     // @p_skipEmpty: skip empty block.
@@ -113,12 +125,14 @@ public:
     // select the range between them.
     // Need to call setTextCursor() to make it take effect.
     // Returns true if target is found.
+    // @p_index: if given, jump across blocks via it instead of scanning.
     static bool selectPairTargetAround(QTextCursor &p_cursor,
                                        QChar p_opening,
                                        QChar p_closing,
                                        bool p_inclusive,
                                        bool p_crossBlock,
-                                       int p_repeat);
+                                       int p_repeat,
+                                       VStructureIndex *p_index = NULL);
 
     // Get the count of blocks selected.
     static int selectedBlockCount(const QTextCursor &p_cursor);
@@ -162,9 +176,11 @@ public:
 
     // Find next @p_repeat empty block.
     // Returns the position of that block if found. Otherwise, returns -1.
+    // @p_index: if given, look it up via it instead of scanning.
     static int findNextEmptyBlock(const QTextCursor &p_cursor,
                                   bool p_forward,
-                                  int p_repeat);
+                                  int p_repeat,
+                                  VStructureIndex *p_index = NULL);
 
     // Check if we need to cancel auto indent.
     // @p_autoIndentPos: the position of the cursor after auto indent.
@@ -179,6 +195,14 @@ public:
                                 const QTextBlock &p_block,
                                 int p_level);
 
+    // Insert title mark at level @p_level in front of blocks
+    // [@p_firstBlock, @p_lastBlock] in one edit.
+    // Move cursor at the end of the last block.
+    static void insertTitleMark(QTextCursor &p_cursor,
+                                const QTextBlock &p_firstBlock,
+                                const QTextBlock &p_lastBlock,
+                                int p_level);
+
     // Find the start and end of the word @p_cursor locates in (within a single block).
     // @p_start and @p_end will be the global position of the start and end of the word.
     // @p_start will equals to @p_end if @p_cursor is a space.
@@ -219,6 +243,19 @@ public:
     // Remove the fence of fenced code block.
     static QString removeCodeBlockFence(const QString &p_text);
 
+    // Map a change of QTextDocument::contentsChange() of @p_doc to its blocks
+    // for an index of per-block data, which has @p_oldBlockCount entries.
+    // Blocks [@p_first, @p_first + @p_oldCount) before the change are now
+    // [@p_first, @p_first + @p_newCount).
+    // Returns false if it could not be mapped and the index should be rebuilt.
+    static bool mapContentsChange(const QTextDocument *p_doc,
+                                  int p_oldBlockCount,
+                                  int p_position,
+                                  int p_charsAdded,
+                                  int &p_first,
+                                  int &p_oldCount,
+                                  int &p_newCount);
+
 private:
     VEditUtils() {}
 };
@@ -0,0 +1,327 @@
+#include "vfilecopier.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QCryptographicHash>
+#include <QScopedArrayPointer>
+
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#elif defined(Q_OS_MACOS) || defined(Q_OS_MAC)
+#include <unistd.h>
+#include <sys/clonefile.h>
+#endif
+
+#include "utils/vutils.h"
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Size of the chunks to copy a file with progress.
+#define COPY_CHUNK_SIZE (1024 * 1024)
+
+namespace
+{
+struct HashEntry
+{
+    qint64 m_size;
+
+    qint64 m_modifiedTime;
+
+    QByteArray m_hash;
+};
+
+QMutex s_hashMutex;
+
+// Path -> hash of the content.
+QHash<QString, HashEntry> s_hashes;
+}
+
+// Run jobs of a batch in order.
+class VFileCopyTask : public QRunnable
+{
+public:
+    VFileCopyTask(QVector<VFileCopier::Job> *p_jobs,
+                  const QVector<int> &p_indexes,
+                  bool p_hardLink)
+        : m_jobs(p_jobs),
+          m_indexes(p_indexes),
+          m_hardLink(p_hardLink)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        for (int idx : m_indexes) {
+            VFileCopier::Job &job = (*m_jobs)[idx];
+            job.m_succeeded = VFileCopier::runJob(job, m_hardLink);
+        }
+    }
+
+private:
+    // Owned by the waiter. Each task touches only its own jobs.
+    QVector<VFileCopier::Job> *m_jobs;
+
+    QVector<int> m_indexes;
+
+    bool m_hardLink;
+};
+
+bool VFileCopier::copyFiles(QVector<Job> &p_jobs)
+{
+    if (p_jobs.isEmpty()) {
+        return true;
+    }
+
+    bool hardLink = g_config->getCopyWithHardLinks();
+
+    if (p_jobs.size() == 1) {
+        p_jobs[0].m_succeeded = runJob(p_jobs[0], hardLink);
+        return p_jobs[0].m_succeeded;
+    }
+
+    QThreadPool pool;
+    int nrBatches = qMin(p_jobs.size(), qMax(1, pool.maxThreadCount()));
+
+    // Jobs to the same target go to the same batch.
+    QVector<QVector<int>> batches(nrBatches);
+    for (int i = 0; i < p_jobs.size(); ++i) {
+        QString dest = QDir::cleanPath(p_jobs[i].m_destFile);
+        batches[qHash(dest) % nrBatches].append(i);
+    }
+
+    for (auto const & batch : batches) {
+        if (!batch.isEmpty()) {
+            pool.start(new VFileCopyTask(&p_jobs, batch, hardLink));
+        }
+    }
+
+    pool.waitForDone();
+
+    bool ret = true;
+    for (auto const & job : p_jobs) {
+        if (!job.m_succeeded) {
+            ret = false;
+        }
+    }
+
+    return ret;
+}
+
+bool VFileCopier::copyFile(const QString &p_srcFile,
+                           const QString &p_destFile,
+                           bool p_isCut,
+                           bool p_sync)
+{
+    Job job(p_srcFile, p_destFile, p_isCut, p_sync);
+    return runJob(job, g_config->getCopyWithHardLinks());
+}
+
+bool VFileCopier::copyFile(const Job &p_job, const ProgressFunc &p_progress)
+{
+    return runJob(p_job, g_config->getCopyWithHardLinks(), p_progress);
+}
+
+bool VFileCopier::runJob(const Job &p_job, bool p_hardLink, const ProgressFunc &p_progress)
+{
+    QString srcPath = QDir::cleanPath(p_job.m_srcFile);
+    QString destPath = QDir::cleanPath(p_job.m_destFile);
+    if (srcPath == destPath) {
+        return true;
+    }
+
+    if (QFileInfo::exists(destPath)) {
+        if (isSameContent(srcPath, destPath)) {
+            if (p_job.m_isCut && !QFile::remove(srcPath)) {
+                qWarning() << "fail to remove file" << srcPath;
+                return false;
+            }
+
+            return true;
+        }
+
+        if (!p_job.m_sync) {
+            qWarning() << "target file already exists with different content" << destPath;
+            return false;
+        }
+
+        if (!QFile::remove(destPath)) {
+            qWarning() << "fail to remove file" << destPath;
+            return false;
+        }
+    }
+
+    if (p_job.m_isCut) {
+        return VUtils::copyFile(srcPath, destPath, true);
+    }
+
+    QString destDir = VUtils::basePathFromPath(destPath);
+    if (!QDir().mkpath(destDir)) {
+        qWarning() << "fail to create directory" << destDir;
+        return false;
+    }
+
+    if (cloneFile(srcPath, destPath)) {
+        return true;
+    }
+
+    if (p_hardLink && linkFile(srcPath, destPath)) {
+        return true;
+    }
+
+    if (p_progress) {
+        return copyFileInChunks(srcPath, destPath, p_progress);
+    }
+
+    return VUtils::copyFile(srcPath, destPath, false);
+}
+
+bool VFileCopier::copyFileInChunks(const QString &p_srcFile,
+                                   const QString &p_destFile,
+                                   const ProgressFunc &p_progress)
+{
+    QFile src(p_srcFile);
+    if (!src.open(QIODevice::ReadOnly)) {
+        qWarning() << "fail to open file" << p_srcFile;
+        return false;
+    }
+
+    QFile dest(p_destFile);
+    if (!dest.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open file" << p_destFile;
+        return false;
+    }
+
+    qint64 total = src.size();
+    qint64 copied = 0;
+    bool succ = p_progress(copied, total);
+    QScopedArrayPointer<char> buf(new char[COPY_CHUNK_SIZE]);
+    while (succ && !src.atEnd()) {
+        qint64 sz = src.read(buf.data(), COPY_CHUNK_SIZE);
+        if (sz < 0 || dest.write(buf.data(), sz) != sz) {
+            qWarning() << "fail to copy file" << p_srcFile << p_destFile;
+            succ = false;
+            break;
+        }
+
+        copied += sz;
+        succ = p_progress(copied, total);
+    }
+
+    dest.close();
+    if (!succ) {
+        dest.remove();
+        return false;
+    }
+
+    dest.setPermissions(src.permissions());
+    return true;
+}
+
+bool VFileCopier::cloneFile(const QString &p_srcFile, const QString &p_destFile)
+{
+#if defined(Q_OS_LINUX) && defined(FICLONE)
+    QByteArray src = QFile::encodeName(p_srcFile);
+    QByteArray dest = QFile::encodeName(p_destFile);
+    int srcFd = ::open(src.constData(), O_RDONLY);
+    if (srcFd == -1) {
+        return false;
+    }
+
+    int destFd = ::open(dest.constData(), O_WRONLY | O_CREAT | O_EXCL, 0644);
+    if (destFd == -1) {
+        ::close(srcFd);
+        return false;
+    }
+
+    bool succ = ::ioctl(destFd, FICLONE, srcFd) == 0;
+    ::close(destFd);
+    ::close(srcFd);
+    if (!succ) {
+        // Not supported by the file system or across file systems.
+        ::unlink(dest.constData());
+        return false;
+    }
+
+    QFile::setPermissions(p_destFile, QFile::permissions(p_srcFile));
+    return true;
+#elif defined(Q_OS_MACOS) || defined(Q_OS_MAC)
+    return ::clonefile(QFile::encodeName(p_srcFile).constData(),
+                       QFile::encodeName(p_destFile).constData(),
+                       0) == 0;
+#else
+    Q_UNUSED(p_srcFile);
+    Q_UNUSED(p_destFile);
+    return false;
+#endif
+}
+
+bool VFileCopier::linkFile(const QString &p_srcFile, const QString &p_destFile)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS) || defined(Q_OS_MAC)
+    return ::link(QFile::encodeName(p_srcFile).constData(),
+                  QFile::encodeName(p_destFile).constData()) == 0;
+#else
+    Q_UNUSED(p_srcFile);
+    Q_UNUSED(p_destFile);
+    return false;
+#endif
+}
+
+QByteArray VFileCopier::contentHash(const QString &p_file)
+{
+    QFileInfo fi(p_file);
+    QString path = fi.absoluteFilePath();
+    qint64 modifiedTime = fi.lastModified().toMSecsSinceEpoch();
+
+    {
+        QMutexLocker locker(&s_hashMutex);
+        auto it = s_hashes.constFind(path);
+        if (it != s_hashes.constEnd()
+            && it.value().m_size == fi.size()
+            && it.value().m_modifiedTime == modifiedTime) {
+            return it.value().m_hash;
+        }
+    }
+
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!hash.addData(&file)) {
+        return QByteArray();
+    }
+
+    HashEntry entry;
+    entry.m_size = fi.size();
+    entry.m_modifiedTime = modifiedTime;
+    entry.m_hash = hash.result();
+
+    QMutexLocker locker(&s_hashMutex);
+    s_hashes.insert(path, entry);
+    return entry.m_hash;
+}
+
+bool VFileCopier::isSameContent(const QString &p_file1, const QString &p_file2)
+{
+    QFileInfo fi1(p_file1), fi2(p_file2);
+    if (!fi1.exists() || !fi2.exists() || fi1.size() != fi2.size()) {
+        return false;
+    }
+
+    QByteArray hash1 = contentHash(p_file1);
+    return !hash1.isEmpty() && hash1 == contentHash(p_file2);
+}
@@ -0,0 +1,97 @@
+#ifndef VFILECOPIER_H
+#define VFILECOPIER_H
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+#include <functional>
+
+// Copy files by content: identical targets are kept as they are and new
+// targets are cloned (or hard linked if enabled) when the file system supports
+// it, falling back to a plain copy.
+// Hashes of the contents are cached and shared by all the copies.
+class VFileCopier
+{
+public:
+    struct Job
+    {
+        Job()
+            : m_isCut(false),
+              m_sync(false),
+              m_succeeded(false)
+        {
+        }
+
+        Job(const QString &p_srcFile,
+            const QString &p_destFile,
+            bool p_isCut,
+            bool p_sync)
+            : m_srcFile(p_srcFile),
+              m_destFile(p_destFile),
+              m_isCut(p_isCut),
+              m_sync(p_sync),
+              m_succeeded(false)
+        {
+        }
+
+        QString m_srcFile;
+
+        QString m_destFile;
+
+        // Move instead of copy.
+        bool m_isCut;
+
+        // Overwrite @m_destFile if it differs from @m_srcFile.
+        // Otherwise, an existing different @m_destFile fails the job.
+        bool m_sync;
+
+        // Result of the job.
+        bool m_succeeded;
+    };
+
+    // Called with the bytes copied and the total bytes of a file.
+    // Returns false to cancel the copy.
+    typedef std::function<bool(qint64 p_copied, qint64 p_total)> ProgressFunc;
+
+    // Run @p_jobs on worker threads and wait for them.
+    // Jobs to the same target are run in order by the same worker.
+    // Returns true if all of them succeeded.
+    static bool copyFiles(QVector<Job> &p_jobs);
+
+    static bool copyFile(const QString &p_srcFile,
+                         const QString &p_destFile,
+                         bool p_isCut,
+                         bool p_sync);
+
+    // Run @p_job in current thread, reporting the progress of a plain copy
+    // via @p_progress. A cancelled copy leaves no target file.
+    static bool copyFile(const Job &p_job, const ProgressFunc &p_progress);
+
+    // Whether @p_file1 and @p_file2 exist with the same content.
+    static bool isSameContent(const QString &p_file1, const QString &p_file2);
+
+private:
+    VFileCopier() {}
+
+    static bool runJob(const Job &p_job,
+                       bool p_hardLink,
+                       const ProgressFunc &p_progress = ProgressFunc());
+
+    // Copy @p_srcFile to @p_destFile in chunks.
+    static bool copyFileInChunks(const QString &p_srcFile,
+                                 const QString &p_destFile,
+                                 const ProgressFunc &p_progress);
+
+    // Clone @p_srcFile to a new @p_destFile sharing the data blocks.
+    static bool cloneFile(const QString &p_srcFile, const QString &p_destFile);
+
+    static bool linkFile(const QString &p_srcFile, const QString &p_destFile);
+
+    // SHA-1 of the content of @p_file, cached by path, size and modified time.
+    static QByteArray contentHash(const QString &p_file);
+
+    friend class VFileCopyTask;
+};
+
+#endif // VFILECOPIER_H
@@ -0,0 +1,896 @@
+#include "vhtmlrewriter.h"
+
+#include <QObject>
+#include <QDebug>
+#include <QFileInfo>
+#include <QRegExp>
+
+#include "utils/vutils.h"
+
+namespace
+{
+struct HtmlToken
+{
+    enum Type
+    {
+        Text,
+        StartTag,
+        EndTag,
+        // Comments and replaced tags output as is.
+        Raw
+    };
+
+    HtmlToken()
+        : m_type(Text)
+    {
+    }
+
+    bool isStartTag(const QString &p_name) const
+    {
+        return m_type == StartTag && m_name.compare(p_name, Qt::CaseInsensitive) == 0;
+    }
+
+    bool isEndTag(const QString &p_name) const
+    {
+        return m_type == EndTag && m_name.compare(p_name, Qt::CaseInsensitive) == 0;
+    }
+
+    bool isVoidTag() const
+    {
+        static const QStringList voidTags({"area", "base", "br", "col", "embed", "hr", "img",
+                                           "input", "link", "meta", "param", "source", "track", "wbr"});
+        return m_attrs.endsWith('/') || voidTags.contains(m_name.toLower());
+    }
+
+    // Find the value of attribute @p_name="..." in m_attrs.
+    // Returns the index of the value or -1.
+    int findAttribute(const QString &p_name, int &p_len) const
+    {
+        const QString key = p_name + "=\"";
+        int idx = 0;
+        while ((idx = m_attrs.indexOf(key, idx, Qt::CaseInsensitive)) != -1) {
+            if (idx > 0 && m_attrs[idx - 1].isSpace()) {
+                int start = idx + key.size();
+                int end = m_attrs.indexOf('"', start);
+                if (end == -1) {
+                    return -1;
+                }
+
+                p_len = end - start;
+                return start;
+            }
+
+            idx += key.size();
+        }
+
+        return -1;
+    }
+
+    // Get the non-empty style.
+    bool style(QString &p_style) const
+    {
+        int len = 0;
+        int idx = findAttribute("style", len);
+        if (idx == -1 || len == 0) {
+            return false;
+        }
+
+        p_style = m_attrs.mid(idx, len);
+        return true;
+    }
+
+    // Replace the style or add it before other attributes.
+    void setStyle(const QString &p_style)
+    {
+        int len = 0;
+        int idx = findAttribute("style", len);
+        if (idx == -1) {
+            m_attrs = QString(" style=\"%1\"").arg(p_style) + m_attrs;
+        } else {
+            m_attrs.replace(idx, len, p_style);
+        }
+    }
+
+    void removeStyle()
+    {
+        const int keySize = 7;
+        int len = 0;
+        int idx = findAttribute("style", len);
+        if (idx != -1 && len > 0) {
+            // Keep the spaces around.
+            m_attrs.remove(idx - keySize, len + keySize + 1);
+        }
+    }
+
+    void appendTo(QString &p_out) const
+    {
+        switch (m_type) {
+        case StartTag:
+            p_out += '<';
+            p_out += m_name;
+            p_out += m_attrs;
+            p_out += '>';
+            break;
+
+        case EndTag:
+            p_out += "</";
+            p_out += m_name;
+            p_out += m_attrs;
+            p_out += '>';
+            break;
+
+        default:
+            p_out += m_text;
+            break;
+        }
+    }
+
+    Type m_type;
+
+    // Text of Text and Raw tokens.
+    QString m_text;
+
+    // Tag name as is.
+    QString m_name;
+
+    // Text after the name and before '>' of tags.
+    QString m_attrs;
+};
+
+// One action on the token stream.
+class Stage
+{
+public:
+    explicit Stage(Stage *p_next)
+        : m_next(p_next)
+    {
+    }
+
+    virtual ~Stage()
+    {
+    }
+
+    // Handle @p_token and pass it on.
+    virtual void push(HtmlToken &p_token)
+    {
+        m_next->push(p_token);
+    }
+
+    // Pass on the held tokens at the end of the stream.
+    virtual void flush()
+    {
+        if (m_next) {
+            m_next->flush();
+        }
+    }
+
+protected:
+    Stage *m_next;
+};
+
+class SinkStage : public Stage
+{
+public:
+    explicit SinkStage(QString &p_out)
+        : Stage(NULL),
+          m_out(p_out)
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        p_token.appendTo(m_out);
+    }
+
+private:
+    QString &m_out;
+};
+
+// Alter the start tags except @p_skipTags and all the tags inside them.
+class TagStage : public Stage
+{
+public:
+    TagStage(Stage *p_next, const QStringList &p_skipTags)
+        : Stage(p_next),
+          m_skipTags(p_skipTags),
+          m_skipDepth(0)
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        if (p_token.m_type == HtmlToken::StartTag) {
+            if (m_skipDepth > 0) {
+                if (p_token.isStartTag(m_skipName) && !p_token.isVoidTag()) {
+                    ++m_skipDepth;
+                }
+            } else if (!m_skipTags.isEmpty() && m_skipTags.contains(p_token.m_name.toLower())) {
+                if (!p_token.isVoidTag()) {
+                    m_skipName = p_token.m_name;
+                    m_skipDepth = 1;
+                }
+            } else {
+                alterTag(p_token);
+            }
+        } else if (m_skipDepth > 0 && p_token.isEndTag(m_skipName)) {
+            --m_skipDepth;
+        }
+
+        m_next->push(p_token);
+    }
+
+protected:
+    virtual void alterTag(HtmlToken &p_token) = 0;
+
+private:
+    QStringList m_skipTags;
+
+    QString m_skipName;
+
+    int m_skipDepth;
+};
+
+class RemoveStylesStage : public TagStage
+{
+public:
+    RemoveStylesStage(Stage *p_next, const QStringList &p_skipTags, const QStringList &p_styles)
+        : TagStage(p_next, p_skipTags),
+          m_reg(QString("(\\s|^)(%1):[^:]+;").arg(p_styles.join('|')))
+    {
+    }
+
+protected:
+    void alterTag(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        QString style;
+        if (!p_token.style(style)) {
+            return;
+        }
+
+        int size = style.size();
+        style.remove(m_reg);
+        if (size != style.size()) {
+            p_token.setStyle(style);
+        }
+    }
+
+private:
+    QRegExp m_reg;
+};
+
+class RemoveAllStylesStage : public TagStage
+{
+public:
+    RemoveAllStylesStage(Stage *p_next, const QStringList &p_skipTags)
+        : TagStage(p_next, p_skipTags)
+    {
+    }
+
+protected:
+    void alterTag(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        p_token.removeStyle();
+    }
+};
+
+class TranslateColorsStage : public TagStage
+{
+public:
+    TranslateColorsStage(Stage *p_next,
+                         const QStringList &p_skipTags,
+                         const QHash<QString, QString> &p_mapping)
+        : TagStage(p_next, p_skipTags),
+          m_mapping(p_mapping),
+          // Won't mixed up with background-color.
+          m_colorReg("(\\s|^)color:([^;]+);")
+    {
+    }
+
+protected:
+    void alterTag(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        QString style;
+        if (!p_token.style(style)) {
+            return;
+        }
+
+        bool changed = false;
+        int pos = 0;
+        while (pos < style.size()) {
+            int idx = style.indexOf(m_colorReg, pos);
+            if (idx == -1) {
+                break;
+            }
+
+            QString col = m_colorReg.cap(2).trimmed().toLower();
+            auto it = m_mapping.find(col);
+            if (it == m_mapping.end()) {
+                pos = idx + m_colorReg.matchedLength();
+                continue;
+            }
+
+            // Should not add extra space before :.
+            QString newStr = QString("%1color: %2;").arg(m_colorReg.cap(1)).arg(it.value());
+            style.replace(idx, m_colorReg.matchedLength(), newStr);
+            pos = idx + newStr.size();
+            changed = true;
+        }
+
+        if (changed) {
+            p_token.setStyle(style);
+        }
+    }
+
+private:
+    const QHash<QString, QString> &m_mapping;
+
+    QRegExp m_colorReg;
+};
+
+// Replace &quot; in font-family with '.
+class QuoteInFontFamilyStage : public TagStage
+{
+public:
+    explicit QuoteInFontFamilyStage(Stage *p_next)
+        : TagStage(p_next, QStringList()),
+          m_reg("font-family:((&quot;)|[^;])+;")
+    {
+    }
+
+protected:
+    void alterTag(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        QString style;
+        if (!p_token.style(style)) {
+            return;
+        }
+
+        int idx = style.indexOf(m_reg);
+        if (idx == -1) {
+            return;
+        }
+
+        const QString quote("&quot;");
+        QString family = m_reg.cap(0);
+        if (family.indexOf(quote) == -1) {
+            return;
+        }
+
+        style.replace(idx, m_reg.matchedLength(), family.replace(quote, "'"));
+        p_token.setStyle(style);
+    }
+
+private:
+    QRegExp m_reg;
+};
+
+// Transform <mark> to <span>.
+class MarkToSpanStage : public Stage
+{
+public:
+    MarkToSpanStage(Stage *p_next, const QString &p_spanStyle)
+        : Stage(p_next),
+          m_spanStyle(p_spanStyle)
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        const QString mark("mark");
+        if (p_token.isStartTag(mark)) {
+            QString style;
+            p_token.style(style);
+            p_token.setStyle(style + m_spanStyle);
+            p_token.m_name = "span";
+        } else if (p_token.isEndTag(mark)) {
+            p_token.m_name = "span";
+        }
+
+        m_next->push(p_token);
+    }
+
+private:
+    QString m_spanStyle;
+};
+
+// Replace the background color of <pre> with that of its child <code>.
+// A <pre> is held until the next tag.
+class PreBackgroundStage : public Stage
+{
+public:
+    explicit PreBackgroundStage(Stage *p_next)
+        : Stage(p_next),
+          m_bgReg("(\\s|^)(background(-color)?:[^;]+;)")
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        if (m_held.isEmpty()) {
+            if (p_token.isStartTag("pre")) {
+                m_held.append(p_token);
+            } else {
+                m_next->push(p_token);
+            }
+
+            return;
+        }
+
+        if (p_token.m_type == HtmlToken::Text || p_token.m_type == HtmlToken::Raw) {
+            m_held.append(p_token);
+            return;
+        }
+
+        QString codeStyle;
+        if (p_token.isStartTag("code") && p_token.style(codeStyle) && codeStyle.indexOf(m_bgReg) != -1) {
+            QString bgStyle = m_bgReg.cap(2);
+
+            HtmlToken &pre = m_held[0];
+            QString style;
+            if (!pre.style(style)) {
+                pre.setStyle(bgStyle);
+            } else if (style.indexOf(m_bgReg) == -1) {
+                pre.setStyle(style + bgStyle);
+            } else {
+                pre.setStyle(style.replace(m_bgReg, " " + bgStyle));
+            }
+        }
+
+        releaseHeld();
+
+        push(p_token);
+    }
+
+    void flush() Q_DECL_OVERRIDE
+    {
+        releaseHeld();
+
+        Stage::flush();
+    }
+
+private:
+    void releaseHeld()
+    {
+        for (auto & tok : m_held) {
+            m_next->push(tok);
+        }
+
+        m_held.clear();
+    }
+
+    QRegExp m_bgReg;
+
+    QVector<HtmlToken> m_held;
+};
+
+// Replace \n with <br/> in <pre>.
+class NewLineToBRStage : public Stage
+{
+public:
+    explicit NewLineToBRStage(Stage *p_next)
+        : Stage(p_next),
+          m_preDepth(0)
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        if (p_token.isStartTag("pre")) {
+            ++m_preDepth;
+        } else if (p_token.isEndTag("pre")) {
+            m_preDepth = qMax(0, m_preDepth - 1);
+        } else if (m_preDepth > 0 && p_token.m_type == HtmlToken::Text) {
+            p_token.m_text.replace('\n', "<br/>");
+        }
+
+        m_next->push(p_token);
+    }
+
+private:
+    int m_preDepth;
+};
+
+static bool isWebUrl(const QUrl &p_url)
+{
+    return p_url.scheme() == "https" || p_url.scheme() == "http";
+}
+
+// Replace local absolute/relative <img> tag with a warning label.
+class LocalImgToLabelStage : public Stage
+{
+public:
+    explicit LocalImgToLabelStage(Stage *p_next)
+        : Stage(p_next),
+          m_label(QString("<span style=\"font-weight: bold; color: #FFFFFF; background-color: #EE0000;\">%1</span>")
+                         .arg(QObject::tr("Insert_Image_HERE")))
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        int len = 0;
+        int idx = -1;
+        if (p_token.isStartTag("img")) {
+            idx = p_token.findAttribute("src", len);
+        }
+
+        if (idx != -1 && len > 0 && !isWebUrl(QUrl(p_token.m_attrs.mid(idx, len)))) {
+            p_token.m_type = HtmlToken::Raw;
+            p_token.m_text = m_label;
+        }
+
+        m_next->push(p_token);
+    }
+
+private:
+    QString m_label;
+};
+
+// Make <img src> absolute.
+class FixImageSrcStage : public Stage
+{
+public:
+    FixImageSrcStage(Stage *p_next, const QUrl &p_baseUrl)
+        : Stage(p_next),
+          m_baseUrl(p_baseUrl)
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        int len = 0;
+        int idx = -1;
+        if (p_token.isStartTag("img")) {
+            idx = p_token.findAttribute("src", len);
+        }
+
+        if (idx != -1 && len > 0) {
+            QString urlStr = p_token.m_attrs.mid(idx, len);
+            QString fixedStr = fixedUrl(urlStr);
+            if (!fixedStr.isEmpty() && urlStr != fixedStr) {
+                qDebug() << "fix img url" << urlStr << fixedStr;
+                p_token.m_attrs.replace(idx, len, fixedStr);
+            }
+        }
+
+        m_next->push(p_token);
+    }
+
+private:
+    QString fixedUrl(const QString &p_url) const
+    {
+#if defined(Q_OS_WIN)
+        QUrl::ComponentFormattingOption strOpt = QUrl::EncodeSpaces;
+#else
+        QUrl::ComponentFormattingOption strOpt = QUrl::FullyEncoded;
+#endif
+
+        QUrl imgUrl(p_url);
+        if (imgUrl.isRelative()) {
+            return m_baseUrl.resolved(imgUrl).toString(strOpt);
+        } else if (imgUrl.isLocalFile()) {
+            return imgUrl.toString(strOpt);
+        } else if (!isWebUrl(imgUrl)) {
+            QString tmp = imgUrl.toString();
+            if (QFileInfo::exists(tmp)) {
+                return QUrl::fromLocalFile(tmp).toString(strOpt);
+            }
+        }
+
+        return QString();
+    }
+
+    QUrl m_baseUrl;
+};
+
+// Add <span> inside <code> not in <pre>.
+class SpanInsideCodeStage : public Stage
+{
+public:
+    explicit SpanInsideCodeStage(Stage *p_next)
+        : Stage(p_next),
+          m_preDepth(0),
+          m_codeDepth(0)
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        if (p_token.isStartTag("pre")) {
+            ++m_preDepth;
+        } else if (p_token.isEndTag("pre")) {
+            m_preDepth = qMax(0, m_preDepth - 1);
+        } else if (m_preDepth == 0 && p_token.isStartTag("code")) {
+            m_next->push(p_token);
+
+            HtmlToken span;
+            span.m_type = HtmlToken::StartTag;
+            span.m_name = "span";
+            span.m_attrs = p_token.m_attrs;
+            m_next->push(span);
+
+            ++m_codeDepth;
+            return;
+        } else if (m_codeDepth > 0 && p_token.isEndTag("code")) {
+            HtmlToken span;
+            span.m_type = HtmlToken::EndTag;
+            span.m_name = "span";
+            m_next->push(span);
+
+            --m_codeDepth;
+        }
+
+        m_next->push(p_token);
+    }
+
+private:
+    int m_preDepth;
+
+    int m_codeDepth;
+};
+
+static bool isHeadingTag(const HtmlToken &p_token)
+{
+    const QString &name = p_token.m_name;
+    return name.size() == 2
+           && (name[0] == 'h' || name[0] == 'H')
+           && name[1] >= '1'
+           && name[1] <= '6';
+}
+
+// Replace headings with span.
+class HeadingToSpanStage : public Stage
+{
+public:
+    explicit HeadingToSpanStage(Stage *p_next)
+        : Stage(p_next)
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        if ((p_token.m_type == HtmlToken::StartTag || p_token.m_type == HtmlToken::EndTag)
+            && isHeadingTag(p_token)) {
+            p_token.m_name = "span";
+        }
+
+        m_next->push(p_token);
+    }
+};
+
+// Fix tags as XHTML like <img> and <br>.
+class XHtmlTagsStage : public Stage
+{
+public:
+    explicit XHtmlTagsStage(Stage *p_next)
+        : Stage(p_next)
+    {
+    }
+
+    void push(HtmlToken &p_token) Q_DECL_OVERRIDE
+    {
+        if (p_token.m_type == HtmlToken::StartTag && !p_token.m_attrs.endsWith('/')) {
+            if (p_token.isStartTag("img")) {
+                p_token.m_attrs += '/';
+            } else if (p_token.m_name == "br" && p_token.m_attrs.isEmpty()) {
+                p_token.m_attrs = "/";
+            }
+        }
+
+        m_next->push(p_token);
+    }
+};
+
+// Split @p_html into tokens pushed to @p_stage.
+void tokenize(const QString &p_html, Stage *p_stage)
+{
+    HtmlToken tok;
+    auto pushText = [&tok, p_stage, &p_html](int p_start, int p_end) {
+        if (p_end > p_start) {
+            tok.m_type = HtmlToken::Text;
+            tok.m_text = p_html.mid(p_start, p_end - p_start);
+            p_stage->push(tok);
+        }
+    };
+
+    const int size = p_html.size();
+    int textStart = 0;
+    int pos = 0;
+    while (pos < size) {
+        int idx = p_html.indexOf('<', pos);
+        if (idx == -1) {
+            break;
+        }
+
+        if (p_html.midRef(idx, 4) == QLatin1String("<!--")) {
+            int end = p_html.indexOf("-->", idx + 4);
+            end = end == -1 ? size : end + 3;
+
+            pushText(textStart, idx);
+            tok.m_type = HtmlToken::Raw;
+            tok.m_text = p_html.mid(idx, end - idx);
+            p_stage->push(tok);
+
+            textStart = pos = end;
+            continue;
+        }
+
+        bool isEnd = idx + 1 < size && p_html[idx + 1] == '/';
+        int nameStart = isEnd ? idx + 2 : idx + 1;
+        int nameEnd = nameStart;
+        while (nameEnd < size) {
+            QChar ch = p_html[nameEnd];
+            if (ch == '>' || ch == '/' || ch == '<' || ch.isSpace()) {
+                break;
+            }
+
+            ++nameEnd;
+        }
+
+        int tagEnd = nameEnd > nameStart ? p_html.indexOf('>', nameEnd) : -1;
+        if (tagEnd == -1) {
+            // Not a tag.
+            pos = idx + 1;
+            continue;
+        }
+
+        pushText(textStart, idx);
+        tok.m_type = isEnd ? HtmlToken::EndTag : HtmlToken::StartTag;
+        tok.m_name = p_html.mid(nameStart, nameEnd - nameStart);
+        tok.m_attrs = p_html.mid(nameEnd, tagEnd - nameEnd);
+        tok.m_text.clear();
+        p_stage->push(tok);
+
+        textStart = pos = tagEnd + 1;
+    }
+
+    pushText(textStart, size);
+
+    p_stage->flush();
+}
+}
+
+VHtmlRewriter::VHtmlRewriter(const Config &p_config)
+    : m_config(p_config)
+{
+}
+
+void VHtmlRewriter::addAction(QChar p_act, const QStringList &p_args)
+{
+    if (!QString("sebcimxrapngdfhj").contains(p_act)) {
+        qWarning() << "skip unknown copy target action" << p_act;
+        return;
+    }
+
+    Action act;
+    act.m_act = p_act;
+    act.m_args = p_args;
+    m_actions.append(act);
+}
+
+bool VHtmlRewriter::rewrite(QString &p_html) const
+{
+    if (m_actions.isEmpty()) {
+        return false;
+    }
+
+    QString out;
+    out.reserve(p_html.size() + p_html.size() / 8);
+
+    // Build the stages from the sink backwards.
+    QVector<Stage *> stages;
+    stages.append(new SinkStage(out));
+
+    // Wrapping actions apply to the whole output in order.
+    QVector<QChar> wraps;
+    for (int i = m_actions.size() - 1; i >= 0; --i) {
+        const Action &act = m_actions[i];
+        Stage *next = stages.last();
+        Stage *stage = NULL;
+        switch (act.m_act.toLatin1()) {
+        case 's':
+            V_FALLTHROUGH;
+        case 'e':
+            wraps.prepend(act.m_act);
+            break;
+
+        case 'b':
+            stage = new RemoveStylesStage(next,
+                                          act.m_args,
+                                          QStringList({"background", "background-color"}));
+            break;
+
+        case 'c':
+            if (!m_config.m_colorMapping.isEmpty()) {
+                stage = new TranslateColorsStage(next, act.m_args, m_config.m_colorMapping);
+            }
+
+            break;
+
+        case 'i':
+            stage = new FixImageSrcStage(next, m_config.m_baseUrl);
+            break;
+
+        case 'm':
+            stage = new RemoveStylesStage(next,
+                                          act.m_args,
+                                          QStringList({"margin", "margin-left", "margin-right",
+                                                       "padding", "padding-left", "padding-right"}));
+            break;
+
+        case 'x':
+            if (!m_config.m_stylesToRemoveWhenCopied.isEmpty()) {
+                stage = new RemoveStylesStage(next, act.m_args, m_config.m_stylesToRemoveWhenCopied);
+            }
+
+            break;
+
+        case 'r':
+            stage = new RemoveAllStylesStage(next, act.m_args);
+            break;
+
+        case 'a':
+            stage = new MarkToSpanStage(next, m_config.m_styleOfSpanForMark);
+            break;
+
+        case 'p':
+            stage = new PreBackgroundStage(next);
+            break;
+
+        case 'n':
+            stage = new NewLineToBRStage(next);
+            break;
+
+        case 'g':
+            stage = new LocalImgToLabelStage(next);
+            break;
+
+        case 'd':
+            stage = new SpanInsideCodeStage(next);
+            break;
+
+        case 'f':
+            stage = new QuoteInFontFamilyStage(next);
+            break;
+
+        case 'h':
+            stage = new HeadingToSpanStage(next);
+            break;
+
+        case 'j':
+            stage = new XHtmlTagsStage(next);
+            break;
+
+        default:
+            break;
+        }
+
+        if (stage) {
+            stages.append(stage);
+        }
+    }
+
+    if (stages.size() > 1) {
+        tokenize(p_html, stages.last());
+    } else {
+        out = p_html;
+    }
+
+    qDeleteAll(stages);
+
+    // Tag stages never add <html>.
+    if (!wraps.isEmpty() && !p_html.startsWith("<html>")) {
+        if (wraps.first() == 's') {
+            out = "<html><body>" + out + "</body></html>";
+        } else {
+            out = "<html><body><!--StartFragment-->" + out + "<!--EndFragment--></body></html>";
+        }
+    }
+
+    if (out == p_html) {
+        return false;
+    }
+
+    p_html = out;
+    return true;
+}
@@ -0,0 +1,55 @@
+#ifndef VHTMLREWRITER_H
+#define VHTMLREWRITER_H
+
+#include <QUrl>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+
+// Rewrite HTML by the actions of a copy target in one pass.
+// The HTML is split into a stream of tags and texts, which goes through one
+// stage per action in the order of the actions, so a stage sees the tags as
+// altered by the previous ones. The output is built once at the end of the
+// stream.
+class VHtmlRewriter
+{
+public:
+    struct Config
+    {
+        // To resolve the relative image links.
+        QUrl m_baseUrl;
+
+        // Styles to remove by action 'x'.
+        QStringList m_stylesToRemoveWhenCopied;
+
+        // Style of <span> which is transformed from <mark>.
+        QString m_styleOfSpanForMark;
+
+        // Color mappings of action 'c'.
+        QHash<QString, QString> m_colorMapping;
+    };
+
+    explicit VHtmlRewriter(const Config &p_config);
+
+    // Append action @p_act with arguments @p_args, such as the tags to skip.
+    // Unknown actions are ignored.
+    void addAction(QChar p_act, const QStringList &p_args);
+
+    // Returns true if @p_html is modified.
+    bool rewrite(QString &p_html) const;
+
+private:
+    struct Action
+    {
+        QChar m_act;
+
+        QStringList m_args;
+    };
+
+    Config m_config;
+
+    QVector<Action> m_actions;
+};
+
+#endif // VHTMLREWRITER_H
@@ -0,0 +1,1260 @@
+#include "vhtmltomarkdown.h"
+
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+
+namespace
+{
+struct HtmlNode
+{
+    enum Type
+    {
+        Element,
+        Text
+    };
+
+    HtmlNode(Type p_type, HtmlNode *p_parent)
+        : m_type(p_type),
+          m_parent(p_parent),
+          m_hasContent(false)
+    {
+    }
+
+    bool isElement() const
+    {
+        return m_type == Element;
+    }
+
+    QString attribute(const QString &p_name) const
+    {
+        return m_attrs.value(p_name);
+    }
+
+    Type m_type;
+
+    // Lower-case tag name of elements.
+    QString m_name;
+
+    // Lower-case attribute name -> decoded value.
+    QHash<QString, QString> m_attrs;
+
+    // Decoded text of text nodes.
+    QString m_text;
+
+    HtmlNode *m_parent;
+
+    QVector<HtmlNode *> m_children;
+
+    // Whether there is non-whitespace text or a void or meaningful element
+    // within the element.
+    bool m_hasContent;
+};
+
+const QSet<QString> &blockTags()
+{
+    static const QSet<QString> tags({"address", "article", "aside", "audio", "blockquote",
+                                     "body", "canvas", "center", "dd", "dir", "div", "dl",
+                                     "dt", "fieldset", "figcaption", "figure", "footer",
+                                     "form", "frameset", "h1", "h2", "h3", "h4", "h5", "h6",
+                                     "header", "hgroup", "hr", "html", "isindex", "li",
+                                     "main", "menu", "nav", "noframes", "noscript", "ol",
+                                     "output", "p", "pre", "section", "table", "tbody",
+                                     "td", "tfoot", "th", "thead", "tr", "ul"});
+    return tags;
+}
+
+const QSet<QString> &voidTags()
+{
+    static const QSet<QString> tags({"area", "base", "br", "col", "command", "embed", "hr",
+                                     "img", "input", "keygen", "link", "meta", "param",
+                                     "source", "track", "wbr"});
+    return tags;
+}
+
+// Elements converted even if they are blank.
+const QSet<QString> &meaningfulWhenBlankTags()
+{
+    static const QSet<QString> tags({"a", "table", "thead", "tbody", "tfoot", "th", "td",
+                                     "iframe", "script", "audio", "video"});
+    return tags;
+}
+
+// Elements dropped with their contents.
+const QSet<QString> &removedTags()
+{
+    static const QSet<QString> tags({"head", "style", "script", "noscript", "template"});
+    return tags;
+}
+
+// Start tags which close an open <p>.
+const QSet<QString> &paragraphClosingTags()
+{
+    static const QSet<QString> tags({"address", "article", "aside", "blockquote", "details",
+                                     "div", "dl", "fieldset", "figcaption", "figure",
+                                     "footer", "form", "h1", "h2", "h3", "h4", "h5", "h6",
+                                     "header", "hr", "main", "menu", "nav", "ol", "p", "pre",
+                                     "section", "table", "ul"});
+    return tags;
+}
+
+bool isBlock(const HtmlNode *p_node)
+{
+    return p_node->isElement() && blockTags().contains(p_node->m_name);
+}
+
+bool isVoid(const HtmlNode *p_node)
+{
+    return p_node->isElement() && voidTags().contains(p_node->m_name);
+}
+
+QString decodeEntities(const QString &p_text)
+{
+    int idx = p_text.indexOf('&');
+    if (idx == -1) {
+        return p_text;
+    }
+
+    static const QHash<QString, QChar> entities({
+        {"amp", QChar('&')}, {"lt", QChar('<')}, {"gt", QChar('>')},
+        {"quot", QChar('"')}, {"apos", QChar('\'')}, {"nbsp", QChar(0x00a0)},
+        {"ensp", QChar(0x2002)}, {"emsp", QChar(0x2003)}, {"thinsp", QChar(0x2009)},
+        {"zwnj", QChar(0x200c)}, {"zwj", QChar(0x200d)}, {"shy", QChar(0x00ad)},
+        {"copy", QChar(0x00a9)}, {"reg", QChar(0x00ae)}, {"trade", QChar(0x2122)},
+        {"hellip", QChar(0x2026)}, {"mdash", QChar(0x2014)}, {"ndash", QChar(0x2013)},
+        {"lsquo", QChar(0x2018)}, {"rsquo", QChar(0x2019)}, {"ldquo", QChar(0x201c)},
+        {"rdquo", QChar(0x201d)}, {"laquo", QChar(0x00ab)}, {"raquo", QChar(0x00bb)},
+        {"bull", QChar(0x2022)}, {"middot", QChar(0x00b7)}, {"times", QChar(0x00d7)},
+        {"divide", QChar(0x00f7)}, {"deg", QChar(0x00b0)}, {"plusmn", QChar(0x00b1)},
+        {"para", QChar(0x00b6)}, {"sect", QChar(0x00a7)}, {"cent", QChar(0x00a2)},
+        {"pound", QChar(0x00a3)}, {"yen", QChar(0x00a5)}, {"euro", QChar(0x20ac)},
+        {"larr", QChar(0x2190)}, {"uarr", QChar(0x2191)}, {"rarr", QChar(0x2192)},
+        {"darr", QChar(0x2193)}
+    });
+
+    QString out;
+    out.reserve(p_text.size());
+    int pos = 0;
+    while (idx != -1) {
+        out += p_text.midRef(pos, idx - pos);
+        pos = idx;
+
+        int end = p_text.indexOf(';', idx + 1);
+        if (end != -1 && end - idx <= 32) {
+            QString name = p_text.mid(idx + 1, end - idx - 1);
+            if (name.startsWith('#')) {
+                bool ok = false;
+                uint code = 0;
+                if (name.size() > 1 && (name[1] == 'x' || name[1] == 'X')) {
+                    code = name.mid(2).toUInt(&ok, 16);
+                } else {
+                    code = name.mid(1).toUInt(&ok, 10);
+                }
+
+                if (ok && code > 0 && code <= 0x10ffff) {
+                    out += QString::fromUcs4(&code, 1);
+                    pos = end + 1;
+                }
+            } else {
+                auto it = entities.find(name);
+                if (it != entities.end()) {
+                    out += it.value();
+                    pos = end + 1;
+                }
+            }
+        }
+
+        if (pos == idx) {
+            // Not an entity.
+            out += '&';
+            ++pos;
+        }
+
+        idx = p_text.indexOf('&', pos);
+    }
+
+    out += p_text.midRef(pos);
+    return out;
+}
+
+// Build a tree from HTML tolerantly, closing the implied elements as
+// browsers do for the common cases.
+class HtmlDocument
+{
+public:
+    HtmlDocument()
+        : m_root(newNode(HtmlNode::Element, NULL))
+    {
+        m_root->m_name = "#root";
+        m_openElements.append(m_root);
+    }
+
+    ~HtmlDocument()
+    {
+        qDeleteAll(m_nodes);
+    }
+
+    HtmlNode *root() const
+    {
+        return m_root;
+    }
+
+    void parse(const QString &p_html)
+    {
+        const int size = p_html.size();
+        int pos = 0;
+        while (pos < size) {
+            int lt = p_html.indexOf('<', pos);
+            if (lt == -1) {
+                appendText(decodeEntities(p_html.mid(pos)));
+                break;
+            }
+
+            if (lt > pos) {
+                appendText(decodeEntities(p_html.mid(pos, lt - pos)));
+            }
+
+            pos = lt;
+            if (p_html.midRef(pos, 4) == QLatin1String("<!--")) {
+                int end = p_html.indexOf(QLatin1String("-->"), pos + 4);
+                pos = end == -1 ? size : end + 3;
+                continue;
+            }
+
+            if (pos + 1 < size && (p_html[pos + 1] == '!' || p_html[pos + 1] == '?')) {
+                // Doctype or processing instruction.
+                int end = p_html.indexOf('>', pos);
+                pos = end == -1 ? size : end + 1;
+                continue;
+            }
+
+            bool isEnd = pos + 1 < size && p_html[pos + 1] == '/';
+            int nameStart = pos + (isEnd ? 2 : 1);
+            int nameEnd = nameStart;
+            while (nameEnd < size
+                   && (p_html[nameEnd].isLetterOrNumber()
+                       || p_html[nameEnd] == '-'
+                       || p_html[nameEnd] == ':')) {
+                ++nameEnd;
+            }
+
+            if (nameEnd == nameStart || !p_html[nameStart].isLetter()) {
+                // A plain '<'.
+                appendText(QStringLiteral("<"));
+                ++pos;
+                continue;
+            }
+
+            QString name = p_html.mid(nameStart, nameEnd - nameStart).toLower();
+            QHash<QString, QString> attrs;
+            bool selfClosing = false;
+            pos = parseAttributes(p_html, nameEnd, attrs, selfClosing);
+
+            if (isEnd) {
+                endTag(name);
+                continue;
+            }
+
+            startTag(name, attrs, selfClosing);
+
+            if (name == "script" || name == "style" || name == "textarea" || name == "title") {
+                // Raw text till the end tag, which is handled in the next round.
+                int end = p_html.indexOf("</" + name, pos, Qt::CaseInsensitive);
+                if (end == -1) {
+                    end = size;
+                }
+
+                QString raw = p_html.mid(pos, end - pos);
+                if (name == "textarea" || name == "title") {
+                    raw = decodeEntities(raw);
+                }
+
+                appendText(raw);
+                pos = end;
+            }
+        }
+    }
+
+private:
+    HtmlNode *newNode(HtmlNode::Type p_type, HtmlNode *p_parent)
+    {
+        HtmlNode *node = new HtmlNode(p_type, p_parent);
+        m_nodes.append(node);
+        if (p_parent) {
+            p_parent->m_children.append(node);
+        }
+
+        return node;
+    }
+
+    HtmlNode *currentNode() const
+    {
+        return m_openElements.last();
+    }
+
+    // Parse attributes from @p_pos till '>'.
+    // Returns the position after '>'.
+    static int parseAttributes(const QString &p_html,
+                               int p_pos,
+                               QHash<QString, QString> &p_attrs,
+                               bool &p_selfClosing)
+    {
+        const int size = p_html.size();
+        while (p_pos < size) {
+            QChar ch = p_html[p_pos];
+            if (ch.isSpace()) {
+                ++p_pos;
+                continue;
+            } else if (ch == '>') {
+                return p_pos + 1;
+            } else if (ch == '/') {
+                p_selfClosing = true;
+                ++p_pos;
+                continue;
+            }
+
+            int start = p_pos;
+            while (p_pos < size) {
+                ch = p_html[p_pos];
+                if (ch.isSpace() || ch == '=' || ch == '>' || ch == '/') {
+                    break;
+                }
+
+                ++p_pos;
+            }
+
+            if (p_pos == start) {
+                // A stray '='.
+                ++p_pos;
+                continue;
+            }
+
+            QString key = p_html.mid(start, p_pos - start).toLower();
+            while (p_pos < size && p_html[p_pos].isSpace()) {
+                ++p_pos;
+            }
+
+            QString value;
+            if (p_pos < size && p_html[p_pos] == '=') {
+                ++p_pos;
+                while (p_pos < size && p_html[p_pos].isSpace()) {
+                    ++p_pos;
+                }
+
+                if (p_pos < size && (p_html[p_pos] == '"' || p_html[p_pos] == '\'')) {
+                    int end = p_html.indexOf(p_html[p_pos], p_pos + 1);
+                    if (end == -1) {
+                        end = size;
+                    }
+
+                    value = p_html.mid(p_pos + 1, end - p_pos - 1);
+                    p_pos = end + 1;
+                } else {
+                    start = p_pos;
+                    while (p_pos < size && !p_html[p_pos].isSpace() && p_html[p_pos] != '>') {
+                        ++p_pos;
+                    }
+
+                    value = p_html.mid(start, p_pos - start);
+                }
+
+                value = decodeEntities(value);
+            }
+
+            // Only a trailing '/' counts.
+            p_selfClosing = false;
+            if (!p_attrs.contains(key)) {
+                p_attrs.insert(key, value);
+            }
+        }
+
+        return size;
+    }
+
+    void appendText(const QString &p_text)
+    {
+        if (p_text.isEmpty()) {
+            return;
+        }
+
+        HtmlNode *parent = currentNode();
+        if (!parent->m_children.isEmpty() && !parent->m_children.last()->isElement()) {
+            parent->m_children.last()->m_text += p_text;
+        } else {
+            newNode(HtmlNode::Text, parent)->m_text = p_text;
+        }
+    }
+
+    // Close the nearest open element in @p_targets, unless an element in
+    // @p_boundaries is met first.
+    void closeImplied(const QSet<QString> &p_targets, const QSet<QString> &p_boundaries)
+    {
+        for (int i = m_openElements.size() - 1; i > 0; --i) {
+            const QString &name = m_openElements[i]->m_name;
+            if (p_targets.contains(name)) {
+                m_openElements.resize(i);
+                return;
+            } else if (p_boundaries.contains(name)) {
+                return;
+            }
+        }
+    }
+
+    void startTag(const QString &p_name, const QHash<QString, QString> &p_attrs, bool p_selfClosing)
+    {
+        if (p_name == "li") {
+            closeImplied({"li"}, {"ul", "ol"});
+        } else if (p_name == "dt" || p_name == "dd") {
+            closeImplied({"dt", "dd"}, {"dl"});
+        } else if (p_name == "tr") {
+            closeImplied({"tr"}, {"table", "thead", "tbody", "tfoot"});
+        } else if (p_name == "td" || p_name == "th") {
+            closeImplied({"td", "th"}, {"tr", "table"});
+        } else if (p_name == "thead" || p_name == "tbody" || p_name == "tfoot") {
+            closeImplied({"thead", "tbody", "tfoot"}, {"table"});
+        }
+
+        if (paragraphClosingTags().contains(p_name) && currentNode()->m_name == "p") {
+            m_openElements.removeLast();
+        }
+
+        HtmlNode *node = newNode(HtmlNode::Element, currentNode());
+        node->m_name = p_name;
+        node->m_attrs = p_attrs;
+
+        if (!p_selfClosing && !voidTags().contains(p_name)) {
+            m_openElements.append(node);
+        }
+    }
+
+    void endTag(const QString &p_name)
+    {
+        if (p_name == "br") {
+            // </br> is taken as <br>.
+            startTag(p_name, QHash<QString, QString>(), true);
+            return;
+        }
+
+        for (int i = m_openElements.size() - 1; i > 0; --i) {
+            if (m_openElements[i]->m_name == p_name) {
+                m_openElements.resize(i);
+                return;
+            }
+        }
+
+        // Unmatched end tags are ignored.
+    }
+
+    // All the nodes, owned by the document.
+    QVector<HtmlNode *> m_nodes;
+
+    HtmlNode *m_root;
+
+    QVector<HtmlNode *> m_openElements;
+};
+
+class MarkdownWriter
+{
+public:
+    explicit MarkdownWriter(const VHtmlToMarkdown::Config &p_config)
+        : m_config(p_config)
+    {
+    }
+
+    QString write(HtmlNode *p_root)
+    {
+        CollapseState state;
+        collapseWhitespace(p_root, state);
+        if (state.m_prevText) {
+            chopTrailingSpace(state.m_prevText);
+        }
+
+        updateHasContent(p_root);
+
+        QString out = process(p_root);
+
+        // Trim leading newlines and trailing whitespaces.
+        int start = 0;
+        while (start < out.size()
+               && (out[start] == '\n' || out[start] == '\r' || out[start] == '\t')) {
+            ++start;
+        }
+
+        int end = out.size();
+        while (end > start && out[end - 1].isSpace()) {
+            --end;
+        }
+
+        return out.mid(start, end - start);
+    }
+
+private:
+    struct CollapseState
+    {
+        CollapseState()
+            : m_prevText(NULL),
+              m_keepLeadingWs(false)
+        {
+        }
+
+        HtmlNode *m_prevText;
+
+        bool m_keepLeadingWs;
+    };
+
+    static void chopTrailingSpace(HtmlNode *p_text)
+    {
+        if (p_text->m_text.endsWith(' ')) {
+            p_text->m_text.chop(1);
+        }
+    }
+
+    static void visitElement(HtmlNode *p_node, CollapseState &p_state)
+    {
+        if (isBlock(p_node) || p_node->m_name == "br") {
+            if (p_state.m_prevText) {
+                chopTrailingSpace(p_state.m_prevText);
+            }
+
+            p_state.m_prevText = NULL;
+            p_state.m_keepLeadingWs = false;
+        } else if (isVoid(p_node)) {
+            p_state.m_prevText = NULL;
+            p_state.m_keepLeadingWs = true;
+        } else if (p_state.m_prevText) {
+            p_state.m_keepLeadingWs = false;
+        }
+    }
+
+    // Collapse the whitespaces outside <pre> as browsers render them and
+    // remove the empty text nodes, like turndown does.
+    static void collapseWhitespace(HtmlNode *p_node, CollapseState &p_state)
+    {
+        QVector<HtmlNode *> children;
+        children.reserve(p_node->m_children.size());
+        for (auto child : p_node->m_children) {
+            if (child->isElement()) {
+                if (removedTags().contains(child->m_name)) {
+                    continue;
+                }
+
+                children.append(child);
+                visitElement(child, p_state);
+                if (child->m_name != "pre" && !isVoid(child)) {
+                    collapseWhitespace(child, p_state);
+                    visitElement(child, p_state);
+                }
+
+                continue;
+            }
+
+            QString text;
+            text.reserve(child->m_text.size());
+            bool inSpace = false;
+            for (auto ch : child->m_text) {
+                if (ch == ' ' || ch == '\n' || ch == '\t' || ch == '\r') {
+                    if (!inSpace) {
+                        text += ' ';
+                        inSpace = true;
+                    }
+                } else {
+                    text += ch;
+                    inSpace = false;
+                }
+            }
+
+            if ((!p_state.m_prevText || p_state.m_prevText->m_text.endsWith(' '))
+                && !p_state.m_keepLeadingWs
+                && text.startsWith(' ')) {
+                text.remove(0, 1);
+            }
+
+            if (text.isEmpty()) {
+                continue;
+            }
+
+            child->m_text = text;
+            children.append(child);
+            p_state.m_prevText = child;
+        }
+
+        p_node->m_children = children;
+    }
+
+    static bool updateHasContent(HtmlNode *p_node)
+    {
+        if (!p_node->isElement()) {
+            for (auto ch : p_node->m_text) {
+                if (!ch.isSpace()) {
+                    return true;
+                }
+            }
+
+            return false;
+        }
+
+        bool has = false;
+        for (auto child : p_node->m_children) {
+            if (updateHasContent(child)
+                || (child->isElement()
+                    && (isVoid(child) || meaningfulWhenBlankTags().contains(child->m_name)))) {
+                has = true;
+            }
+        }
+
+        p_node->m_hasContent = has;
+        return has;
+    }
+
+    static bool isBlank(const HtmlNode *p_node)
+    {
+        return !isVoid(p_node)
+               && !meaningfulWhenBlankTags().contains(p_node->m_name)
+               && !p_node->m_hasContent;
+    }
+
+    static QString textContent(const HtmlNode *p_node)
+    {
+        if (!p_node->isElement()) {
+            return p_node->m_text;
+        }
+
+        QString text;
+        for (auto child : p_node->m_children) {
+            text += textContent(child);
+        }
+
+        return text;
+    }
+
+    // First (or last if @p_last) character of the text content, or a null QChar.
+    static QChar edgeChar(const HtmlNode *p_node, bool p_last)
+    {
+        if (!p_node->isElement()) {
+            const QString &text = p_node->m_text;
+            if (text.isEmpty()) {
+                return QChar();
+            }
+
+            return p_last ? text.at(text.size() - 1) : text.at(0);
+        }
+
+        const int cnt = p_node->m_children.size();
+        for (int i = 0; i < cnt; ++i) {
+            QChar ch = edgeChar(p_node->m_children[p_last ? cnt - 1 - i : i], p_last);
+            if (!ch.isNull()) {
+                return ch;
+            }
+        }
+
+        return QChar();
+    }
+
+    static const HtmlNode *sibling(const HtmlNode *p_node, bool p_next)
+    {
+        const HtmlNode *parent = p_node->m_parent;
+        int idx = parent->m_children.indexOf(const_cast<HtmlNode *>(p_node));
+        idx += p_next ? 1 : -1;
+        if (idx < 0 || idx >= parent->m_children.size()) {
+            return NULL;
+        }
+
+        return parent->m_children[idx];
+    }
+
+    static bool isFlankedByWhitespace(const HtmlNode *p_node, bool p_left)
+    {
+        const HtmlNode *sib = sibling(p_node, !p_left);
+        if (!sib || isBlock(sib)) {
+            return false;
+        }
+
+        return edgeChar(sib, p_left) == ' ';
+    }
+
+    // Join two parts with at most two newlines between them.
+    static void join(QString &p_output, const QString &p_replacement)
+    {
+        int trailing = 0;
+        while (trailing < p_output.size() && p_output[p_output.size() - 1 - trailing] == '\n') {
+            ++trailing;
+        }
+
+        int leading = 0;
+        while (leading < p_replacement.size() && p_replacement[leading] == '\n') {
+            ++leading;
+        }
+
+        p_output.chop(trailing);
+        p_output += QString(qMin(2, qMax(trailing, leading)), '\n');
+        p_output += p_replacement.midRef(leading);
+    }
+
+    static QString escape(const QString &p_text)
+    {
+        QString out;
+        out.reserve(p_text.size() + 8);
+        for (auto ch : p_text) {
+            switch (ch.unicode()) {
+            case '\\':
+            case '*':
+            case '`':
+            case '[':
+            case ']':
+            case '_':
+                out += '\\';
+                break;
+
+            default:
+                break;
+            }
+
+            out += ch;
+        }
+
+        // Markers at the start of a line.
+        if (out.isEmpty()) {
+            return out;
+        }
+
+        QChar first = out[0];
+        if (first == '-' || first == '>' || first == '=') {
+            out.prepend('\\');
+        } else if (out.startsWith(QLatin1String("+ ")) || out.startsWith(QLatin1String("~~~"))) {
+            out.prepend('\\');
+        } else if (first == '#') {
+            int cnt = 1;
+            while (cnt < out.size() && out[cnt] == '#') {
+                ++cnt;
+            }
+
+            if (cnt <= 6 && cnt < out.size() && out[cnt] == ' ') {
+                out.prepend('\\');
+            }
+        } else if (first.isDigit()) {
+            int cnt = 1;
+            while (cnt < out.size() && out[cnt].isDigit()) {
+                ++cnt;
+            }
+
+            if (out.midRef(cnt, 2) == QLatin1String(". ")) {
+                out.insert(cnt, '\\');
+            }
+        }
+
+        return out;
+    }
+
+    // Split @p_content into its leading spaces, core, and trailing spaces.
+    static bool splitSpaces(const QString &p_content,
+                            QString &p_leading,
+                            QString &p_core,
+                            QString &p_trailing)
+    {
+        int start = 0;
+        while (start < p_content.size() && p_content[start].isSpace()) {
+            ++start;
+        }
+
+        int end = p_content.size();
+        while (end > start && p_content[end - 1].isSpace()) {
+            --end;
+        }
+
+        p_leading = p_content.left(start);
+        p_core = p_content.mid(start, end - start);
+        p_trailing = p_content.mid(end);
+        return !p_core.isEmpty();
+    }
+
+    static QString wrapDelimiter(const QString &p_content, const QString &p_delimiter)
+    {
+        QString leading, core, trailing;
+        if (!splitSpaces(p_content, leading, core, trailing)) {
+            return p_content;
+        }
+
+        return leading + p_delimiter + core + p_delimiter + trailing;
+    }
+
+    QString process(const HtmlNode *p_parent) const
+    {
+        QString output;
+        for (auto child : p_parent->m_children) {
+            if (child->isElement()) {
+                join(output, replacementForNode(child));
+            } else {
+                join(output, escape(child->m_text));
+            }
+        }
+
+        return output;
+    }
+
+    QString replacementForNode(const HtmlNode *p_node) const
+    {
+        if (isBlank(p_node)) {
+            if (p_node->m_name == "span") {
+                return process(p_node);
+            }
+
+            return isBlock(p_node) ? QStringLiteral("\n\n") : QString();
+        }
+
+        QString leading, trailing;
+        if (!isBlock(p_node)) {
+            if (edgeChar(p_node, false).isSpace() && !isFlankedByWhitespace(p_node, true)) {
+                leading = " ";
+            }
+
+            if (edgeChar(p_node, true).isSpace() && !isFlankedByWhitespace(p_node, false)) {
+                trailing = " ";
+            }
+        }
+
+        QString content = replacement(p_node, leading.isEmpty() && trailing.isEmpty());
+        return leading + content + trailing;
+    }
+
+    // @p_keepSpaces: whether to keep the surrounding spaces of the content.
+    QString replacement(const HtmlNode *p_node, bool p_keepSpaces) const
+    {
+        const QString &name = p_node->m_name;
+
+        // Rules without the converted content.
+        if (name == "br") {
+            return QStringLiteral("  \n");
+        } else if (name == "hr") {
+            return QStringLiteral("\n\n***\n\n");
+        } else if (name == "img") {
+            return imageReplacement(p_node);
+        } else if (name == "input") {
+            if (p_node->attribute("type").toLower() == "checkbox"
+                && p_node->m_parent->m_name == "li") {
+                return p_node->m_attrs.contains("checked") ? QStringLiteral("[x] ")
+                                                           : QStringLiteral("[ ] ");
+            }
+
+            return QString();
+        } else if (name == "pre") {
+            return preReplacement(p_node);
+        } else if (name == "code") {
+            return codeReplacement(p_node);
+        } else if (name == "table") {
+            return tableReplacement(p_node);
+        } else if (name == "div") {
+            QString lang = highlightedLanguage(p_node);
+            if (!lang.isNull()) {
+                return fencedCode(textContent(p_node), lang);
+            }
+        }
+
+        QString content = process(p_node);
+        if (!p_keepSpaces) {
+            content = content.trimmed();
+        }
+
+        if (name == "p") {
+            return "\n\n" + content + "\n\n";
+        } else if (name.size() == 2 && name[0] == 'h' && name[1] >= '1' && name[1] <= '6') {
+            int level = name[1].digitValue();
+            content.replace("  \n", " ");
+            content.replace('\n', ' ');
+            return "\n\n" + QString(level, '#') + ' ' + content + "\n\n";
+        } else if (name == "blockquote") {
+            return "\n\n" + blockquote(content) + "\n\n";
+        } else if (name == "ul" || name == "ol") {
+            const HtmlNode *parent = p_node->m_parent;
+            if (parent->m_name == "li" && parent->m_children.last() == p_node) {
+                return "\n" + content;
+            }
+
+            return "\n\n" + content + "\n\n";
+        } else if (name == "li") {
+            return listItem(p_node, content);
+        } else if (name == "a") {
+            QString href = p_node->attribute("href");
+            if (href.isEmpty()) {
+                return content;
+            }
+
+            QString title = p_node->attribute("title");
+            if (!title.isEmpty()) {
+                title = " \"" + title.replace('"', "\\\"") + "\"";
+            }
+
+            return "[" + content + "](" + href + title + ")";
+        } else if (name == "em" || name == "i") {
+            return wrapDelimiter(content, "*");
+        } else if (name == "strong" || name == "b") {
+            return wrapDelimiter(content, "**");
+        } else if (name == "del" || name == "s" || name == "strike") {
+            return "~" + content + "~";
+        } else if (name == "span") {
+            QString style = p_node->attribute("style").toLower();
+            style.remove(' ');
+            if (style.contains("font-weight:bold")
+                || style.contains("font-weight:bolder")
+                || style.contains("font-weight:600")
+                || style.contains("font-weight:700")
+                || style.contains("font-weight:800")
+                || style.contains("font-weight:900")) {
+                return wrapDelimiter(content, "**");
+            } else if (style.contains("font-style:italic")) {
+                return wrapDelimiter(content, "*");
+            }
+
+            return content;
+        } else if (name == "mark") {
+            return content.isEmpty() ? QString() : "<mark>" + content + "</mark>";
+        } else if (name == "sub") {
+            if (content.isEmpty()) {
+                return QString();
+            }
+
+            return m_config.m_subEnabled ? "~" + content + "~" : "<sub>" + content + "</sub>";
+        } else if (name == "sup") {
+            if (content.isEmpty()) {
+                return QString();
+            }
+
+            return m_config.m_supEnabled ? "^" + content + "^" : "<sup>" + content + "</sup>";
+        } else if (name == "thead" || name == "tbody" || name == "tfoot") {
+            return content;
+        }
+
+        if (isBlock(p_node)) {
+            return "\n\n" + content + "\n\n";
+        }
+
+        return content;
+    }
+
+    static QString imageReplacement(const HtmlNode *p_node)
+    {
+        QString src = p_node->attribute("src");
+        if (src.isEmpty()) {
+            return QString();
+        }
+
+        QString alt = p_node->attribute("alt");
+        if (alt.contains('\r') || alt.contains('\n') || alt.contains('[') || alt.contains(']')) {
+            alt.clear();
+        }
+
+        QString title = p_node->attribute("title");
+        if (title.contains('\r') || title.contains('\n') || title.contains(')') || title.contains('"')) {
+            title.clear();
+        }
+
+        return "![" + alt + "](" + src + (title.isEmpty() ? QString() : " \"" + title + "\"") + ")";
+    }
+
+    static QString codeLanguage(const HtmlNode *p_node)
+    {
+        const QStringList classes = p_node->attribute("class").split(' ', QString::SkipEmptyParts);
+        for (auto const & cls : classes) {
+            if (cls.startsWith(QLatin1String("language-"))) {
+                return cls.mid(9);
+            } else if (cls.startsWith(QLatin1String("lang-"))) {
+                return cls.mid(5);
+            }
+        }
+
+        return QString();
+    }
+
+    // Language of the code block of GitHub, such as <div class="highlight-source-cpp"><pre>.
+    static QString highlightedLanguage(const HtmlNode *p_node)
+    {
+        if (p_node->m_children.isEmpty() || p_node->m_children.first()->m_name != "pre") {
+            return QString();
+        }
+
+        const QStringList classes = p_node->attribute("class").split(' ', QString::SkipEmptyParts);
+        for (auto const & cls : classes) {
+            for (auto const & prefix : {QStringLiteral("highlight-text-"), QStringLiteral("highlight-source-")}) {
+                if (cls.startsWith(prefix) && cls.size() > prefix.size()) {
+                    return cls.mid(prefix.size());
+                }
+            }
+        }
+
+        return QString();
+    }
+
+    static QString fencedCode(QString p_code, const QString &p_lang)
+    {
+        // Use a fence longer than any one in the code.
+        int fenceSize = 3;
+        const QStringList lines = p_code.split('\n');
+        for (auto const & line : lines) {
+            int cnt = 0;
+            while (cnt < line.size() && line[cnt] == '`') {
+                ++cnt;
+            }
+
+            if (cnt >= fenceSize) {
+                fenceSize = cnt + 1;
+            }
+        }
+
+        if (p_code.endsWith('\n')) {
+            p_code.chop(1);
+        }
+
+        QString fence(fenceSize, '`');
+        return "\n\n" + fence + p_lang + "\n" + p_code + "\n" + fence + "\n\n";
+    }
+
+    static QString preReplacement(const HtmlNode *p_node)
+    {
+        QString lang;
+        if (!p_node->m_children.isEmpty() && p_node->m_children.first()->m_name == "code") {
+            lang = codeLanguage(p_node->m_children.first());
+        }
+
+        return fencedCode(textContent(p_node), lang);
+    }
+
+    static QString codeReplacement(const HtmlNode *p_node)
+    {
+        QString code = textContent(p_node);
+        if (code.isEmpty()) {
+            return QString();
+        }
+
+        // Use a delimiter of a length different from all the runs of '`'.
+        QSet<int> runs;
+        for (int i = 0; i < code.size();) {
+            if (code[i] != '`') {
+                ++i;
+                continue;
+            }
+
+            int start = i;
+            while (i < code.size() && code[i] == '`') {
+                ++i;
+            }
+
+            runs.insert(i - start);
+        }
+
+        int delimiterSize = 1;
+        while (runs.contains(delimiterSize)) {
+            ++delimiterSize;
+        }
+
+        QString delimiter(delimiterSize, '`');
+        QString leading = code.startsWith('`') ? QStringLiteral(" ") : QString();
+        QString trailing = code.endsWith('`') ? QStringLiteral(" ") : QString();
+        return delimiter + leading + code + trailing + delimiter;
+    }
+
+    static QString blockquote(QString p_content)
+    {
+        int start = 0;
+        while (start < p_content.size() && p_content[start] == '\n') {
+            ++start;
+        }
+
+        int end = p_content.size();
+        while (end > start && p_content[end - 1] == '\n') {
+            --end;
+        }
+
+        p_content = p_content.mid(start, end - start);
+        p_content.replace('\n', "\n> ");
+        return "> " + p_content;
+    }
+
+    static QString listItem(const HtmlNode *p_node, QString p_content)
+    {
+        int start = 0;
+        while (start < p_content.size() && p_content[start] == '\n') {
+            ++start;
+        }
+
+        int end = p_content.size();
+        while (end > start && p_content[end - 1] == '\n') {
+            --end;
+        }
+
+        bool trailingNewLine = end < p_content.size();
+        p_content = p_content.mid(start, end - start);
+        p_content.replace('\n', "\n    ");
+        if (trailingNewLine) {
+            p_content += '\n';
+        }
+
+        QString prefix("-   ");
+        const HtmlNode *parent = p_node->m_parent;
+        if (parent->m_name == "ol") {
+            int index = 0;
+            for (auto child : parent->m_children) {
+                if (child == p_node) {
+                    break;
+                }
+
+                if (child->isElement()) {
+                    ++index;
+                }
+            }
+
+            bool ok = false;
+            int startNum = parent->attribute("start").toInt(&ok);
+            prefix = QString::number(ok ? startNum + index : index + 1) + ".  ";
+        }
+
+        if (sibling(p_node, true) && !p_content.endsWith('\n')) {
+            p_content += '\n';
+        }
+
+        return prefix + p_content;
+    }
+
+    static void collectRows(const HtmlNode *p_node, QVector<const HtmlNode *> &p_rows)
+    {
+        for (auto child : p_node->m_children) {
+            if (child->m_name == "tr") {
+                p_rows.append(child);
+            } else if (child->m_name == "thead"
+                       || child->m_name == "tbody"
+                       || child->m_name == "tfoot") {
+                collectRows(child, p_rows);
+            }
+        }
+    }
+
+    static bool isHeadingRow(const HtmlNode *p_row)
+    {
+        if (p_row->m_parent->m_name == "thead") {
+            return true;
+        }
+
+        bool hasCell = false;
+        for (auto child : p_row->m_children) {
+            if (child->m_name == "td") {
+                return false;
+            } else if (child->m_name == "th") {
+                hasCell = true;
+            }
+        }
+
+        return hasCell;
+    }
+
+    static QString cellAlignment(const HtmlNode *p_cell)
+    {
+        QString align = p_cell->attribute("align").toLower();
+        if (align.isEmpty()) {
+            QString style = p_cell->attribute("style").toLower();
+            style.remove(' ');
+            int idx = style.indexOf("text-align:");
+            if (idx != -1) {
+                align = style.mid(idx + 11).section(';', 0, 0);
+            }
+        }
+
+        if (align == "left") {
+            return QStringLiteral(":--");
+        } else if (align == "right") {
+            return QStringLiteral("--:");
+        } else if (align == "center") {
+            return QStringLiteral(":-:");
+        }
+
+        return QStringLiteral("---");
+    }
+
+    static QString tableRow(const QStringList &p_cells, int p_columns)
+    {
+        QString row("|");
+        for (int i = 0; i < p_columns; ++i) {
+            row += ' ';
+            row += i < p_cells.size() ? p_cells[i] : QString();
+            row += " |";
+        }
+
+        return row;
+    }
+
+    QString tableReplacement(const HtmlNode *p_node) const
+    {
+        QVector<const HtmlNode *> rows;
+        collectRows(p_node, rows);
+        if (rows.isEmpty()) {
+            return "\n\n" + process(p_node) + "\n\n";
+        }
+
+        int columns = 0;
+        QVector<QStringList> cells;
+        QStringList aligns;
+        for (auto row : rows) {
+            QStringList rowCells;
+            for (auto child : row->m_children) {
+                if (child->m_name != "td" && child->m_name != "th") {
+                    continue;
+                }
+
+                QString content = process(child);
+                content.remove('\r');
+                content.remove('\n');
+                content.replace('|', "\\|");
+                rowCells.append(content.trimmed());
+
+                if (cells.isEmpty()) {
+                    aligns.append(cellAlignment(child));
+                }
+            }
+
+            columns = qMax(columns, rowCells.size());
+            cells.append(rowCells);
+        }
+
+        while (aligns.size() < columns) {
+            aligns.append(QStringLiteral("---"));
+        }
+
+        QStringList lines;
+        int firstBodyRow = 0;
+        if (isHeadingRow(rows.first())) {
+            lines.append(tableRow(cells.first(), columns));
+            firstBodyRow = 1;
+        } else {
+            // A fake head, as VNote does on the web side.
+            QStringList head;
+            for (int i = 0; i < columns; ++i) {
+                head.append(QStringLiteral("<br>"));
+            }
+
+            lines.append(tableRow(head, columns));
+        }
+
+        lines.append(tableRow(aligns, columns));
+        for (int i = firstBodyRow; i < cells.size(); ++i) {
+            lines.append(tableRow(cells[i], columns));
+        }
+
+        return "\n\n" + lines.join('\n') + "\n\n";
+    }
+
+    VHtmlToMarkdown::Config m_config;
+};
+}
+
+
+VHtmlToMarkdown::VHtmlToMarkdown(const Config &p_config)
+    : m_config(p_config)
+{
+}
+
+QString VHtmlToMarkdown::convert(const QString &p_html) const
+{
+    HtmlDocument doc;
+    doc.parse(p_html);
+
+    MarkdownWriter writer(m_config);
+    return writer.write(doc.root());
+}
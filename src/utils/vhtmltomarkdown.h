@@ -0,0 +1,37 @@
+#ifndef VHTMLTOMARKDOWN_H
+#define VHTMLTOMARKDOWN_H
+
+#include <QString>
+
+// Convert HTML to Markdown natively, following the rules of turndown with the
+// GFM plugin and the VNote rules used by the web side:
+// ATX headings, '-' bullets, fenced code blocks, '*' and '**' emphasis,
+// pipe tables, strikethrough, task lists, <mark>, and sub/sup.
+// It is reentrant and could be used in worker threads.
+class VHtmlToMarkdown
+{
+public:
+    struct Config
+    {
+        Config()
+            : m_subEnabled(false),
+              m_supEnabled(false)
+        {
+        }
+
+        // Output ~sub~ instead of <sub>sub</sub>.
+        bool m_subEnabled;
+
+        // Output ^sup^ instead of <sup>sup</sup>.
+        bool m_supEnabled;
+    };
+
+    explicit VHtmlToMarkdown(const Config &p_config);
+
+    QString convert(const QString &p_html) const;
+
+private:
+    Config m_config;
+};
+
+#endif // VHTMLTOMARKDOWN_H
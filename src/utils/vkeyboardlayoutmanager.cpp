@@ -11,6 +11,34 @@ extern VConfigManager *g_config;
 
 VKeyboardLayoutManager *VKeyboardLayoutManager::s_inst = NULL;
 
+void VKeyboardLayoutManager::Layout::setMapping(const QHash<int, int> &p_mapping)
+{
+    m_table.clear();
+    m_highMapping.clear();
+
+    int maxKey = -1;
+    for (auto it = p_mapping.begin(); it != p_mapping.end(); ++it) {
+        int key = it.value();
+        if (key >= 0 && key < c_maxTableKey) {
+            maxKey = qMax(maxKey, key);
+        }
+    }
+
+    m_table.resize(maxKey + 1);
+    for (int i = 0; i < m_table.size(); ++i) {
+        m_table[i] = i;
+    }
+
+    for (auto it = p_mapping.begin(); it != p_mapping.end(); ++it) {
+        int key = it.value();
+        if (key >= 0 && key < c_maxTableKey) {
+            m_table[key] = it.key();
+        } else {
+            m_highMapping.insert(key, it.key());
+        }
+    }
+}
+
 VKeyboardLayoutManager *VKeyboardLayoutManager::inst()
 {
     if (!s_inst) {
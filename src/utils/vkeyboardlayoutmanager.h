@@ -4,6 +4,7 @@
 #include <QString>
 #include <QStringList>
 #include <QHash>
+#include <QVector>
 
 class VConfigManager;
 
@@ -15,23 +16,27 @@ public:
         void clear()
         {
             m_name.clear();
-            m_mapping.clear();
+            m_table.clear();
+            m_highMapping.clear();
         }
 
-        void setMapping(const QHash<int, int> &p_mapping)
-        {
-            m_mapping.clear();
-
-            for (auto it = p_mapping.begin(); it != p_mapping.end(); ++it) {
-                m_mapping.insert(it.value(), it.key());
-            }
-        }
+        void setMapping(const QHash<int, int> &p_mapping);
 
         QString m_name;
-        // Reversed mapping.
-        QHash<int, int> m_mapping;
+
+        // Reversed mapping of the keys below c_maxTableKey indexed by key,
+        // which maps the keys not in the mapping to themselves. Its size is
+        // one more than the largest mapped key.
+        QVector<int> m_table;
+
+        // Reversed mapping of the keys not in m_table.
+        QHash<int, int> m_highMapping;
     };
 
+    // Keys below it are mapped via a flat table. It covers the keys of
+    // characters in the BMP, leaving out the special keys like Qt::Key_Escape.
+    static const int c_maxTableKey = 0x10000;
+
     static void update();
 
     static const VKeyboardLayoutManager::Layout &currentLayout();
@@ -67,9 +72,13 @@ private:
 inline int VKeyboardLayoutManager::mapKey(int p_key)
 {
     const Layout &layout = inst()->m_layout;
-    if (!layout.m_name.isEmpty()) {
-        auto it = layout.m_mapping.find(p_key);
-        if (it != layout.m_mapping.end()) {
+    if (p_key >= 0 && p_key < layout.m_table.size()) {
+        return layout.m_table[p_key];
+    }
+
+    if (!layout.m_highMapping.isEmpty()) {
+        auto it = layout.m_highMapping.find(p_key);
+        if (it != layout.m_highMapping.end()) {
             return it.value();
         }
     }
@@ -49,6 +49,9 @@ static QString allMetaWordsInfo(const VMetaWord *p_metaWord)
 
 const QChar VMetaWordManager::c_delimiter = '%';
 
+// Max number of compiled texts to keep.
+#define MAX_COMPILED_TEXTS 256
+
 VMetaWordManager::VMetaWordManager(QObject *p_parent)
     : QObject(p_parent),
       m_initialized(false)
@@ -344,19 +347,11 @@ QString VMetaWordManager::evaluate(const QString &p_text,
     // Update overriden table.
     const_cast<VMetaWordManager *>(this)->m_overriddenWords = p_overriddenWords;
 
-    // Treat the text as a Compound meta word.
-    const QString tmpWord("vnote_tmp_metaword");
-    Q_ASSERT(!contains(tmpWord));
-    VMetaWord metaWord(this,
-                       MetaWordType::Compound,
-                       tmpWord,
-                       p_text,
-                       nullptr,
-                       true);
+    QSharedPointer<const VMetaWord> metaWord = compile(p_text);
 
     QString val;
-    if (metaWord.isValid()) {
-        val = metaWord.evaluate();
+    if (metaWord->isValid()) {
+        val = metaWord->evaluate();
     } else {
         val = p_text;
     }
@@ -366,6 +361,74 @@ QString VMetaWordManager::evaluate(const QString &p_text,
     return val;
 }
 
+QVector<VMetaWordManager::Replacement> VMetaWordManager::evaluateRegions(const QString &p_text) const
+{
+    QVector<Replacement> reps;
+    if (p_text.isEmpty()) {
+        return reps;
+    }
+
+    const_cast<VMetaWordManager *>(this)->init();
+
+    const_cast<VMetaWordManager *>(this)->m_dateTime = QDateTime::currentDateTime();
+
+    // The compiled texts cache may be cleared in the loop, so keep the ones of
+    // this call.
+    QHash<QString, QSharedPointer<const VMetaWord>> compiled;
+    int pos = 0;
+    while (pos <= p_text.size()) {
+        int end = p_text.indexOf('\n', pos);
+        if (end == -1) {
+            end = p_text.size();
+        }
+
+        int len = end - pos;
+        if (len > 0 && p_text.midRef(pos, len).contains(c_delimiter)) {
+            QString line = p_text.mid(pos, len);
+            QSharedPointer<const VMetaWord> metaWord = compiled.value(line);
+            if (metaWord.isNull()) {
+                metaWord = compile(line);
+                compiled.insert(line, metaWord);
+            }
+
+            if (metaWord->isValid()) {
+                QString val = metaWord->evaluate();
+                if (val != line) {
+                    reps.append(Replacement{pos, len, val});
+                }
+            }
+        }
+
+        pos = end + 1;
+    }
+
+    return reps;
+}
+
+QSharedPointer<const VMetaWord> VMetaWordManager::compile(const QString &p_text) const
+{
+    auto it = m_compiledTexts.constFind(p_text);
+    if (it != m_compiledTexts.constEnd()) {
+        return it.value();
+    }
+
+    if (m_compiledTexts.size() >= MAX_COMPILED_TEXTS) {
+        m_compiledTexts.clear();
+    }
+
+    // Treat the text as a Compound meta word.
+    const QString tmpWord("vnote_tmp_metaword");
+    Q_ASSERT(!contains(tmpWord));
+    QSharedPointer<const VMetaWord> metaWord(new VMetaWord(this,
+                                                           MetaWordType::Compound,
+                                                           tmpWord,
+                                                           p_text,
+                                                           nullptr,
+                                                           true));
+    m_compiledTexts.insert(p_text, metaWord);
+    return metaWord;
+}
+
 bool VMetaWordManager::contains(const QString &p_word) const
 {
     const_cast<VMetaWordManager *>(this)->init();
@@ -402,6 +465,9 @@ void VMetaWordManager::addMetaWord(MetaWordType p_type,
 
     if (metaWord.isValid()) {
         m_metaWords.insert(p_word, metaWord);
+
+        // Compiled texts may refer to this word.
+        m_compiledTexts.clear();
         qDebug() << QString("MetaWord %1%2%1[%3] added")
                            .arg(c_delimiter).arg(p_word).arg(p_definition);
     }
@@ -479,9 +545,10 @@ void VMetaWord::checkAndParseDefinition(bool p_allowAllSpaces)
             return;
         }
 
-        for (auto const & to : m_tokens) {
+        for (auto & to : m_tokens) {
             if (to.isMetaWord()) {
-                if (!m_manager->contains(to.m_value)) {
+                to.m_metaWord = m_manager->findMetaWord(to.m_value);
+                if (!to.m_metaWord) {
                     // Dependency not defined.
                     m_valid = false;
                     break;
@@ -656,7 +723,8 @@ QString VMetaWord::evaluateTokens(const QVector<VMetaWord::Token> &p_tokens,
 
         case TokenType::MetaWord:
         {
-            const VMetaWord *metaWord = m_manager->findMetaWord(to.m_value);
+            const VMetaWord *metaWord = to.m_metaWord ? to.m_metaWord
+                                                      : m_manager->findMetaWord(to.m_value);
             if (!metaWord) {
                 // Invalid meta word. Treat it as literal value.
                 val += VMetaWordManager::c_delimiter + to.m_value + VMetaWordManager::c_delimiter;
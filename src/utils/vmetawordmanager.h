@@ -9,6 +9,7 @@
 #include <QHash>
 #include <QDateTime>
 #include <QHash>
+#include <QSharedPointer>
 
 
 enum class MetaWordType
@@ -77,13 +78,15 @@ public:
     struct Token
     {
         Token()
-            : m_type(TokenType::Raw)
+            : m_type(TokenType::Raw),
+              m_metaWord(NULL)
         {
         }
 
         Token(VMetaWord::TokenType p_type, const QString &p_value)
             : m_type(p_type),
-              m_value(p_value)
+              m_value(p_value),
+              m_metaWord(NULL)
         {
         }
 
@@ -110,6 +113,9 @@ public:
         // For MetaWord type, m_value is the word of the meta word pointed to by
         // this token.
         QString m_value;
+
+        // For MetaWord type, the meta word resolved when parsing the definition.
+        const VMetaWord *m_metaWord;
     };
 
 private:
@@ -159,6 +165,16 @@ class VMetaWordManager : public QObject
 {
     Q_OBJECT
 public:
+    // Replacement of a region of the text.
+    struct Replacement
+    {
+        int m_offset;
+
+        int m_length;
+
+        QString m_value;
+    };
+
     explicit VMetaWordManager(QObject *p_parent = nullptr);
 
     // Expand meta words in @p_text and return the expanded text.
@@ -166,6 +182,11 @@ public:
     QString evaluate(const QString &p_text,
                      const QHash<QString, QString> &p_overriddenWords = QHash<QString, QString>()) const;
 
+    // Expand meta words in @p_text line by line at the same date time.
+    // Only lines containing c_delimiter are compiled, once for identical lines.
+    // Return the replacements of the changed lines in order of offset.
+    QVector<Replacement> evaluateRegions(const QString &p_text) const;
+
     const VMetaWord *findMetaWord(const QString &p_word) const;
 
     bool contains(const QString &p_word) const;
@@ -191,6 +212,9 @@ private:
 
     void initCustomMetaWords();
 
+    // Return the text compiled as a Compound meta word, which is cached by text.
+    QSharedPointer<const VMetaWord> compile(const QString &p_text) const;
+
     bool m_initialized;
 
     // Map using word as key.
@@ -203,6 +227,9 @@ private:
     // Overridden table containing meta words with their designated value.
     // Will be updated before each evaluation and clear after the evaluation.
     QHash<QString, QString> m_overriddenWords;
+
+    // Text -> compiled text to evaluate.
+    mutable QHash<QString, QSharedPointer<const VMetaWord>> m_compiledTexts;
 };
 
 inline const QDateTime &VMetaWordManager::getDateTime() const
@@ -0,0 +1,90 @@
+#include "vstylecache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QDataStream>
+#include <QFontDatabase>
+#include <QStringList>
+
+#include "utils/vutils.h"
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Bump it when the layout of any cached object changes.
+#define CACHE_FORMAT_VERSION 1
+
+static const quint32 c_magic = 0x56534331;
+
+VStyleCache::VStyleCache(const QString &p_name)
+    : m_name(p_name),
+      m_hash(QCryptographicHash::Sha1)
+{
+    addData(QString("%1 %2 %3").arg(CACHE_FORMAT_VERSION)
+                               .arg(QT_VERSION_STR)
+                               .arg(qVersion()));
+    addData(QFontDatabase().families().join('\n'));
+}
+
+void VStyleCache::addData(const QByteArray &p_data)
+{
+    m_hash.addData(p_data);
+
+    // Separate the inputs.
+    m_hash.addData("\0", 1);
+}
+
+void VStyleCache::addData(const QString &p_data)
+{
+    addData(p_data.toUtf8());
+}
+
+QByteArray VStyleCache::key() const
+{
+    return m_hash.result();
+}
+
+QString VStyleCache::filePath() const
+{
+    return QDir(g_config->getCacheConfigFolder()).filePath(m_name + ".cache");
+}
+
+bool VStyleCache::load(QByteArray &p_data) const
+{
+    QFile file(filePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic = 0;
+    QByteArray key;
+    in >> magic >> key;
+    if (in.status() != QDataStream::Ok || magic != c_magic || key != this->key()) {
+        return false;
+    }
+
+    in >> p_data;
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "fail to read style cache" << file.fileName();
+        return false;
+    }
+
+    return true;
+}
+
+bool VStyleCache::store(const QByteArray &p_data) const
+{
+    QString path = filePath();
+    if (!VUtils::makePath(VUtils::basePathFromPath(path))) {
+        qWarning() << "fail to create style cache folder" << VUtils::basePathFromPath(path);
+        return false;
+    }
+
+    QByteArray buf;
+    QDataStream out(&buf, QIODevice::WriteOnly);
+    out << c_magic << key() << p_data;
+
+    return VUtils::writeFileToDisk(path, buf);
+}
@@ -0,0 +1,38 @@
+#ifndef VSTYLECACHE_H
+#define VSTYLECACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QCryptographicHash>
+
+// Binary cache of parsed style objects, such as the highlighting styles and
+// the filled style sheet, to skip the text parsing on startup.
+// An entry is keyed by the hash of all its inputs added via addData(), the Qt
+// version and the available font families, since font families in the styles
+// are resolved against them. Each name keeps only the latest entry.
+class VStyleCache
+{
+public:
+    explicit VStyleCache(const QString &p_name);
+
+    void addData(const QByteArray &p_data);
+
+    void addData(const QString &p_data);
+
+    // Read the cached data into @p_data if the key matches.
+    bool load(QByteArray &p_data) const;
+
+    // Replace the cached entry with @p_data.
+    bool store(const QByteArray &p_data) const;
+
+private:
+    QString filePath() const;
+
+    QByteArray key() const;
+
+    QString m_name;
+
+    QCryptographicHash m_hash;
+};
+
+#endif // VSTYLECACHE_H
@@ -1,5 +1,6 @@
 #include "vutils.h"
 #include <QFile>
+#include <QSaveFile>
 #include <QDir>
 #include <QDebug>
 #include <QRegExp>
@@ -14,6 +15,8 @@
 #include <QKeyEvent>
 #include <QScreen>
 #include <cmath>
+#include <climits>
+#include <string.h>
 #include <QLocale>
 #include <QPushButton>
 #include <QElapsedTimer>
@@ -32,6 +35,10 @@
 #include <QSvgRenderer>
 #include <QPainter>
 #include <QTemporaryFile>
+#include <QRegularExpression>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QCryptographicHash>
 
 #include "vorphanfile.h"
 #include "vnote.h"
@@ -39,11 +46,68 @@
 #include "vpreviewpage.h"
 #include "pegparser.h"
 #include "widgets/vcombobox.h"
+#include "utils/vfilecopier.h"
+#include "vtracer.h"
 
 extern VConfigManager *g_config;
 
 QVector<QPair<QString, QString>> VUtils::s_availableLanguages;
 
+// Max number of files to cache the image links of.
+#define MAX_CACHED_IMAGE_LINK_FILES 10000
+
+// Max number of generated HTML templates to cache.
+#define MAX_CACHED_HTML_TEMPLATES 32
+
+// Files not smaller than this are mapped instead of read when read from disk.
+#define MAP_FILE_SIZE_THRESHOLD (4 * 1024 * 1024)
+
+namespace
+{
+struct ImageLinkCacheEntry
+{
+    qint64 m_size;
+
+    qint64 m_modifiedTime;
+
+    QVector<QString> m_urls;
+};
+
+QMutex s_imageLinkCacheMutex;
+
+// Path of note file -> urls of image links in it.
+QHash<QString, ImageLinkCacheEntry> s_imageLinkCache;
+
+// Options of the template -> generated HTML template.
+// Only valid for config revision s_htmlTemplateRevision.
+QHash<QString, QString> s_htmlTemplateCache;
+
+int s_htmlTemplateRevision = -1;
+
+// Return the cached template of @p_key or generate it via @p_func.
+QString cachedHtmlTemplate(const QString &p_key, const std::function<QString()> &p_func)
+{
+    int revision = g_config->getConfigRevision();
+    if (revision != s_htmlTemplateRevision) {
+        s_htmlTemplateCache.clear();
+        s_htmlTemplateRevision = revision;
+    }
+
+    auto it = s_htmlTemplateCache.constFind(p_key);
+    if (it != s_htmlTemplateCache.constEnd()) {
+        return it.value();
+    }
+
+    if (s_htmlTemplateCache.size() >= MAX_CACHED_HTML_TEMPLATES) {
+        s_htmlTemplateCache.clear();
+    }
+
+    QString templ = p_func();
+    s_htmlTemplateCache.insert(p_key, templ);
+    return templ;
+}
+}
+
 const QString VUtils::c_imageLinkRegExp = QString("\\!\\[([^\\[\\]]*)\\]"
                                                   "\\(\\s*"
                                                   "([^\\)\"'\\s]+)"
@@ -86,22 +150,73 @@ void VUtils::initAvailableLanguage()
     s_availableLanguages.append(QPair<QString, QString>("ja_JP", "Japanese"));
 }
 
+// Decode UTF-8 @p_data and drop CR like QIODevice::Text in one pass over
+// the text. Most files have no CR, which is found by a fast byte scan.
+static QString decodeFileData(const char *p_data, int p_size)
+{
+    QString text = QString::fromUtf8(p_data, p_size);
+    if (!memchr(p_data, '\r', p_size)) {
+        return text;
+    }
+
+    QChar *data = text.data();
+    int size = text.size();
+    int nr = 0;
+    for (int i = 0; i < size; ++i) {
+        if (data[i] != QLatin1Char('\r')) {
+            data[nr++] = data[i];
+        }
+    }
+
+    text.truncate(nr);
+    return text;
+}
+
 QString VUtils::readFileFromDisk(const QString &filePath)
 {
+    V_TRACE_DETAIL("io", "Read file", filePath);
+
     QFile file(filePath);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+    if (!file.open(QIODevice::ReadOnly)) {
         qWarning() << "fail to open file" << filePath << "to read";
         return QString();
     }
-    QString fileText(file.readAll());
-    file.close();
-    qDebug() << "read file content:" << filePath;
-    return fileText;
+
+    qint64 size = file.size();
+    if (size <= 0 || size >= INT_MAX) {
+        // Sequential or special files do not tell the size.
+        QByteArray data = file.readAll();
+        return decodeFileData(data.constData(), data.size());
+    }
+
+    if (size >= MAP_FILE_SIZE_THRESHOLD) {
+        // Decode from the mapped pages directly without a copy in memory.
+        uchar *data = file.map(0, size);
+        if (data) {
+            QString text = decodeFileData(reinterpret_cast<const char *>(data), (int)size);
+            file.unmap(data);
+            return text;
+        }
+    }
+
+    // One read into a buffer of the exact size.
+    QByteArray data((int)size, Qt::Uninitialized);
+    qint64 len = file.read(data.data(), size);
+    if (len < 0) {
+        qWarning() << "fail to read file" << filePath << file.errorString();
+        return QString();
+    }
+
+    return decodeFileData(data.constData(), (int)len);
 }
 
 bool VUtils::writeFileToDisk(const QString &p_filePath, const QString &p_text)
 {
-    QFile file(p_filePath);
+    V_TRACE_DETAIL("io", "Write file", p_filePath);
+
+    // Write to a temporary file and rename it over the target.
+    QSaveFile file(p_filePath);
+    file.setDirectWriteFallback(true);
     if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
         qWarning() << "fail to open file" << p_filePath << "to write";
         return false;
@@ -109,28 +224,41 @@ bool VUtils::writeFileToDisk(const QString &p_filePath, const QString &p_text)
 
     QTextStream stream(&file);
     stream << p_text;
-    file.close();
+    stream.flush();
+    if (!file.commit()) {
+        qWarning() << "fail to write file" << p_filePath;
+        return false;
+    }
+
     qDebug() << "write file content:" << p_filePath;
     return true;
 }
 
 bool VUtils::writeFileToDisk(const QString &p_filePath, const QByteArray &p_data)
 {
-    QFile file(p_filePath);
+    V_TRACE_DETAIL("io", "Write file", p_filePath);
+
+    QSaveFile file(p_filePath);
+    file.setDirectWriteFallback(true);
     if (!file.open(QIODevice::WriteOnly)) {
         qWarning() << "fail to open file" << p_filePath << "to write";
         return false;
     }
 
     file.write(p_data);
-    file.close();
+    if (!file.commit()) {
+        qWarning() << "fail to write file" << p_filePath;
+        return false;
+    }
+
     qDebug() << "write file content:" << p_filePath;
     return true;
 }
 
 bool VUtils::writeJsonToDisk(const QString &p_filePath, const QJsonObject &p_json)
 {
-    QFile file(p_filePath);
+    QSaveFile file(p_filePath);
+    file.setDirectWriteFallback(true);
     // We use Unix LF for config file.
     if (!file.open(QIODevice::WriteOnly)) {
         qWarning() << "fail to open file" << p_filePath << "to write";
@@ -138,7 +266,8 @@ bool VUtils::writeJsonToDisk(const QString &p_filePath, const QJsonObject &p_jso
     }
 
     QJsonDocument doc(p_json);
-    if (-1 == file.write(doc.toJson())) {
+    if (-1 == file.write(doc.toJson()) || !file.commit()) {
+        qWarning() << "fail to write file" << p_filePath;
         return false;
     }
 
@@ -191,6 +320,37 @@ QString VUtils::generateImageFileName(const QString &path,
     return imageName;
 }
 
+static QString imageSuffix(const QString &p_format)
+{
+    return p_format.isEmpty() ? QString() : "." + p_format.toLower();
+}
+
+QString VUtils::contentImageFileName(const QByteArray &p_data, const QString &p_format)
+{
+    QByteArray hash = QCryptographicHash::hash(p_data, QCryptographicHash::Sha1);
+    return QString::fromLatin1(hash.toHex()) + imageSuffix(p_format);
+}
+
+QString VUtils::contentImageFileName(const QImage &p_image,
+                                     const QString &p_format,
+                                     int p_quality)
+{
+    // The same pixels are encoded into the same bytes.
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    QString meta = QString("%1x%2:%3:%4:%5").arg(p_image.width())
+                                            .arg(p_image.height())
+                                            .arg((int)p_image.format())
+                                            .arg(p_format.toLower())
+                                            .arg(p_quality);
+    hash.addData(meta.toLatin1());
+    for (int y = 0; y < p_image.height(); ++y) {
+        hash.addData(reinterpret_cast<const char *>(p_image.constScanLine(y)),
+                     p_image.bytesPerLine());
+    }
+
+    return QString::fromLatin1(hash.result().toHex()) + imageSuffix(p_format);
+}
+
 QString VUtils::fileNameFromPath(const QString &p_path)
 {
     if (p_path.isEmpty()) {
@@ -215,37 +375,27 @@ QVector<ImageLink> VUtils::fetchImagesFromMarkdownFile(VFile *p_file,
     Q_ASSERT(p_file->getDocType() == DocType::Markdown);
     QVector<ImageLink> images;
 
-    bool isOpened = p_file->isOpened();
-    if (!isOpened && !p_file->open()) {
+    QVector<QString> urls;
+    if (p_file->isOpened()) {
+        // The content may differ from the one on disk.
+        urls = fetchImageLinkUrls(p_file->getContent());
+    } else if (!fetchImageLinkUrlsOfFile(p_file->fetchPath(), urls)) {
         return images;
     }
 
-    const QString &text = p_file->getContent();
-    if (text.isEmpty()) {
-        if (!isOpened) {
-            p_file->close();
-        }
-
+    if (urls.isEmpty()) {
         return images;
     }
 
     // Used to de-duplicate the links. Url as the key.
     QSet<QString> fetchedLinks;
 
-    QVector<VElementRegion> regions = fetchImageRegionsUsingParser(text);
-    QRegExp regExp(c_imageLinkRegExp);
     QString basePath = p_file->fetchBasePath();
-    for (int i = 0; i < regions.size(); ++i) {
-        const VElementRegion &reg = regions[i];
-        QString linkText = text.mid(reg.m_startPos, reg.m_endPos - reg.m_startPos);
-        bool matched = regExp.exactMatch(linkText);
-        if (!matched) {
-            // Image links with reference format will not match.
+    for (auto const & imageUrl : urls) {
+        if (fetchedLinks.contains(imageUrl)) {
             continue;
         }
 
-        QString imageUrl = regExp.capturedTexts()[2].trimmed();
-
         ImageLink link;
         link.m_url = imageUrl;
         QFileInfo info(basePath, purifyUrl(imageUrl));
@@ -271,19 +421,203 @@ QVector<ImageLink> VUtils::fetchImagesFromMarkdownFile(VFile *p_file,
         }
 
         if (link.m_type & p_type) {
-            if (!fetchedLinks.contains(link.m_url)) {
-                fetchedLinks.insert(link.m_url);
-                images.push_back(link);
-                qDebug() << "fetch one image:" << link.m_type << link.m_path << link.m_url;
+            fetchedLinks.insert(link.m_url);
+            images.push_back(link);
+            qDebug() << "fetch one image:" << link.m_type << link.m_path << link.m_url;
+        }
+    }
+
+    return images;
+}
+
+// Check if line [@p_start, @p_end) of @p_text is a code block fence.
+// Update @p_fenceChar and @p_fenceLen if it opens or closes a code block.
+static bool updateCodeBlockFence(const QString &p_text,
+                                 int p_start,
+                                 int p_end,
+                                 QChar &p_fenceChar,
+                                 int &p_fenceLen)
+{
+    int i = p_start;
+    while (i < p_end && (p_text[i] == ' ' || p_text[i] == '\t')) {
+        ++i;
+    }
+
+    if (i == p_end || (p_text[i] != '`' && p_text[i] != '~')) {
+        return false;
+    }
+
+    QChar ch = p_text[i];
+    int j = i;
+    while (j < p_end && p_text[j] == ch) {
+        ++j;
+    }
+
+    int len = j - i;
+    if (len < 3) {
+        return false;
+    }
+
+    if (p_fenceLen == 0) {
+        p_fenceChar = ch;
+        p_fenceLen = len;
+        return true;
+    }
+
+    if (ch != p_fenceChar || len < p_fenceLen) {
+        return false;
+    }
+
+    // A closing fence has nothing but spaces after it.
+    for (; j < p_end; ++j) {
+        if (!p_text[j].isSpace()) {
+            return false;
+        }
+    }
+
+    p_fenceLen = 0;
+    return true;
+}
+
+QVector<QString> VUtils::fetchImageLinkUrls(const QString &p_text)
+{
+    QVector<QString> urls;
+    if (p_text.isEmpty()) {
+        return urls;
+    }
+
+    static const QRegularExpression regExp(c_imageLinkRegExp);
+
+    const QString marker("![");
+    const int size = p_text.size();
+
+    // Next image link marker at or after the current position.
+    int nextMarker = p_text.indexOf(marker);
+    if (nextMarker == -1) {
+        return urls;
+    }
+
+    QChar fenceChar;
+    int fenceLen = 0;
+    int pos = 0;
+    while (pos < size && nextMarker != -1) {
+        int end = p_text.indexOf('\n', pos);
+        if (end == -1) {
+            end = size;
+        }
+
+        // Skip code blocks and their fences.
+        bool inCodeBlock = updateCodeBlockFence(p_text, pos, end, fenceChar, fenceLen)
+                           || fenceLen > 0;
+        if (!inCodeBlock) {
+            while (nextMarker != -1 && nextMarker < end) {
+                QRegularExpressionMatch match = regExp.match(p_text,
+                                                             nextMarker,
+                                                             QRegularExpression::NormalMatch,
+                                                             QRegularExpression::AnchoredMatchOption);
+                int from = nextMarker + marker.size();
+                if (match.hasMatch()) {
+                    urls.append(match.captured(2).trimmed());
+                    from = match.capturedEnd();
+                }
+
+                nextMarker = p_text.indexOf(marker, from);
             }
         }
+
+        pos = end + 1;
+        if (nextMarker != -1 && nextMarker < pos) {
+            // Marker within a skipped line or a link across lines.
+            nextMarker = p_text.indexOf(marker, pos);
+        }
     }
 
-    if (!isOpened) {
-        p_file->close();
+    return urls;
+}
+
+QVector<QString> VUtils::fetchLinkUrls(const QString &p_text)
+{
+    QVector<QString> urls;
+    static const QRegularExpression regExp(c_linkRegExp);
+
+    const QString marker("](");
+    const int size = p_text.size();
+
+    int nextMarker = p_text.indexOf(marker);
+    QChar fenceChar;
+    int fenceLen = 0;
+    int pos = 0;
+    while (pos < size && nextMarker != -1) {
+        int end = p_text.indexOf('\n', pos);
+        if (end == -1) {
+            end = size;
+        }
+
+        bool inCodeBlock = updateCodeBlockFence(p_text, pos, end, fenceChar, fenceLen)
+                           || fenceLen > 0;
+        if (!inCodeBlock && nextMarker < end) {
+            QRegularExpressionMatchIterator it = regExp.globalMatch(p_text, pos);
+            while (it.hasNext()) {
+                QRegularExpressionMatch match = it.next();
+                int start = match.capturedStart();
+                if (start >= end) {
+                    break;
+                }
+
+                if (match.capturedEnd() > end
+                    || (start > 0 && p_text[start - 1] == '!')) {
+                    // Across lines or an image link.
+                    continue;
+                }
+
+                urls.append(match.captured(2).trimmed());
+            }
+        }
+
+        pos = end + 1;
+        if (nextMarker < pos) {
+            nextMarker = p_text.indexOf(marker, pos);
+        }
     }
 
-    return images;
+    return urls;
+}
+
+bool VUtils::fetchImageLinkUrlsOfFile(const QString &p_filePath, QVector<QString> &p_urls)
+{
+    QFileInfo fi(p_filePath);
+    if (!fi.exists()) {
+        qWarning() << "file does not exist" << p_filePath;
+        return false;
+    }
+
+    QString path = fi.absoluteFilePath();
+    qint64 modifiedTime = fi.lastModified().toMSecsSinceEpoch();
+
+    {
+        QMutexLocker locker(&s_imageLinkCacheMutex);
+        auto it = s_imageLinkCache.constFind(path);
+        if (it != s_imageLinkCache.constEnd()
+            && it.value().m_size == fi.size()
+            && it.value().m_modifiedTime == modifiedTime) {
+            p_urls = it.value().m_urls;
+            return true;
+        }
+    }
+
+    ImageLinkCacheEntry entry;
+    entry.m_size = fi.size();
+    entry.m_modifiedTime = modifiedTime;
+    entry.m_urls = fetchImageLinkUrls(readFileFromDisk(path));
+    p_urls = entry.m_urls;
+
+    QMutexLocker locker(&s_imageLinkCacheMutex);
+    if (s_imageLinkCache.size() >= MAX_CACHED_IMAGE_LINK_FILES) {
+        s_imageLinkCache.clear();
+    }
+
+    s_imageLinkCache.insert(path, entry);
+    return true;
 }
 
 QString VUtils::linkUrlToPath(const QString &p_basePath, const QString &p_url)
@@ -449,6 +783,43 @@ bool VUtils::copyDirectory(const QString &p_srcDirPath, const QString &p_destDir
     return true;
 }
 
+bool VUtils::syncFile(const QString &p_srcFilePath, const QString &p_destFilePath)
+{
+    return VFileCopier::copyFile(p_srcFilePath, p_destFilePath, false, true);
+}
+
+bool VUtils::syncDirectory(const QString &p_srcDirPath, const QString &p_destDirPath)
+{
+    QString srcPath = QDir::cleanPath(p_srcDirPath);
+    QString destPath = QDir::cleanPath(p_destDirPath);
+    if (srcPath == destPath) {
+        return true;
+    }
+
+    QDir destDir(destPath);
+    if (!destDir.exists() && !destDir.mkpath(destPath)) {
+        qWarning() << QString("fail to create target directory %1").arg(destPath);
+        return false;
+    }
+
+    QDir srcDir(srcPath);
+    QFileInfoList nodes = srcDir.entryInfoList(QDir::Dirs | QDir::Files | QDir::Hidden
+                                               | QDir::NoSymLinks | QDir::NoDotAndDotDot);
+    for (int i = 0; i < nodes.size(); ++i) {
+        const QFileInfo &fileInfo = nodes.at(i);
+        QString name = fileInfo.fileName();
+        if (fileInfo.isDir()) {
+            if (!syncDirectory(srcDir.filePath(name), destDir.filePath(name))) {
+                return false;
+            }
+        } else if (!syncFile(srcDir.filePath(name), destDir.filePath(name))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
 int VUtils::showMessage(QMessageBox::Icon p_icon,
                         const QString &p_title,
                         const QString &p_text,
@@ -490,10 +861,12 @@ void VUtils::promptForReopen(QWidget *p_parent)
 
 QString VUtils::generateCopiedFileName(const QString &p_dirPath,
                                        const QString &p_fileName,
-                                       bool p_completeBaseName)
+                                       bool p_completeBaseName,
+                                       const QSet<QString> &p_takenNames)
 {
     QDir dir(p_dirPath);
-    if (!dir.exists() || !dir.exists(p_fileName)) {
+    if ((!dir.exists() || !dir.exists(p_fileName))
+        && !p_takenNames.contains(p_fileName)) {
         return p_fileName;
     }
 
@@ -514,7 +887,7 @@ QString VUtils::generateCopiedFileName(const QString &p_dirPath,
         if (!suffix.isEmpty()) {
             fileName = fileName + "." + suffix;
         }
-    } while (fileExists(dir, fileName, true));
+    } while (fileExists(dir, fileName, true) || p_takenNames.contains(fileName));
 
     return fileName;
 }
@@ -631,7 +1004,7 @@ void VUtils::sleepWait(int p_milliseconds)
     }
 }
 
-DocType VUtils::docTypeFromName(const QString &p_name)
+DocType VUtils::docTypeFromName(const QString &p_name, qint64 p_size)
 {
     if (p_name.isEmpty()) {
         return DocType::Unknown;
@@ -642,7 +1015,13 @@ DocType VUtils::docTypeFromName(const QString &p_name)
     QString suf = QFileInfo(p_name).suffix().toLower();
     for (auto it = suffixes.begin(); it != suffixes.end(); ++it) {
         if (it.value().contains(suf)) {
-            return DocType(it.key());
+            DocType type = DocType(it.key());
+            qint64 textSize = g_config->getPlainTextFileSize();
+            if (type == DocType::Markdown && textSize > 0 && p_size >= textSize) {
+                type = DocType::Text;
+            }
+
+            return type;
         }
     }
 
@@ -657,7 +1036,15 @@ QString VUtils::generateSimpleHtmlTemplate(const QString &p_body)
 
 QString VUtils::generateHtmlTemplate(MarkdownConverterType p_conType)
 {
-    return generateHtmlTemplate(VNote::s_markdownTemplate, p_conType);
+    return cachedHtmlTemplate(QString("default_%1").arg((int)p_conType),
+                              [p_conType]() {
+                                  return generateHtmlTemplate(VNote::s_markdownTemplate, p_conType);
+                              });
+}
+
+void VUtils::clearHtmlTemplateCache()
+{
+    s_htmlTemplateCache.clear();
 }
 
 QString VUtils::generateHtmlTemplate(MarkdownConverterType p_conType,
@@ -670,12 +1057,21 @@ QString VUtils::generateHtmlTemplate(MarkdownConverterType p_conType,
 {
     Q_ASSERT((p_isPDF && p_wkhtmltopdf) || !p_wkhtmltopdf);
 
-    QString templ = VNote::generateHtmlTemplate(g_config->getRenderBackgroundColor(p_renderBg),
-                                                g_config->getCssStyleUrl(p_renderStyle),
-                                                g_config->getCodeBlockCssStyleUrl(p_renderCodeBlockStyle),
-                                                p_isPDF);
+    QString key = QString("%1_%2_%3_%4_%5_%6_%7").arg((int)p_conType)
+                                                 .arg(p_isPDF)
+                                                 .arg(p_wkhtmltopdf)
+                                                 .arg(p_addToc)
+                                                 .arg(p_renderBg)
+                                                 .arg(p_renderStyle)
+                                                 .arg(p_renderCodeBlockStyle);
+    return cachedHtmlTemplate(key, [&]() {
+        QString templ = VNote::generateHtmlTemplate(g_config->getRenderBackgroundColor(p_renderBg),
+                                                    g_config->getCssStyleUrl(p_renderStyle),
+                                                    g_config->getCodeBlockCssStyleUrl(p_renderCodeBlockStyle),
+                                                    p_isPDF);
 
-    return generateHtmlTemplate(templ, p_conType, p_isPDF, p_wkhtmltopdf, p_addToc);
+        return generateHtmlTemplate(templ, p_conType, p_isPDF, p_wkhtmltopdf, p_addToc);
+    });
 }
 
 QString VUtils::generateHtmlTemplate(const QString &p_template,
@@ -702,33 +1098,40 @@ QString VUtils::generateHtmlTemplate(const QString &p_template,
     case MarkdownConverterType::MarkdownIt:
     {
         jsFile = "qrc" + VNote::c_markdownitJsFile;
-        extraFile = "<script src=\"qrc" + VNote::c_markdownitExtraFile + "\"></script>\n" +
-                    "<script src=\"qrc" + VNote::c_markdownitAnchorExtraFile + "\"></script>\n" +
-                    "<script src=\"qrc" + VNote::c_markdownitTaskListExtraFile + "\"></script>\n" +
-                    "<script src=\"qrc" + VNote::c_markdownitImsizeExtraFile + "\"></script>\n" +
-                    "<script src=\"qrc" + VNote::c_markdownitFootnoteExtraFile + "\"></script>\n" +
-                    "<script src=\"qrc" + VNote::c_markdownitContainerExtraFile + "\"></script>\n";
+
+        // Scripts to set up markdown-it, which are also loaded by the render worker.
+        QStringList scripts;
+        scripts << VNote::c_markdownitExtraFile
+                << VNote::c_markdownitAnchorExtraFile
+                << VNote::c_markdownitTaskListExtraFile
+                << VNote::c_markdownitImsizeExtraFile
+                << VNote::c_markdownitFootnoteExtraFile
+                << VNote::c_markdownitContainerExtraFile;
 
         if (g_config->getEnableMathjax()) {
-            extraFile += "<script src=\"qrc" + VNote::c_markdownitTexMathExtraFile + "\"></script>\n";
+            scripts << VNote::c_markdownitTexMathExtraFile;
         }
 
         const MarkdownitOption &opt = g_config->getMarkdownitOption();
 
         if (opt.m_sup) {
-            extraFile += "<script src=\"qrc" + VNote::c_markdownitSupExtraFile + "\"></script>\n";
+            scripts << VNote::c_markdownitSupExtraFile;
         }
 
         if (opt.m_sub) {
-            extraFile += "<script src=\"qrc" + VNote::c_markdownitSubExtraFile + "\"></script>\n";
+            scripts << VNote::c_markdownitSubExtraFile;
         }
 
         if (opt.m_metadata) {
-            extraFile += "<script src=\"qrc" + VNote::c_markdownitFrontMatterExtraFile + "\"></script>\n";
+            scripts << VNote::c_markdownitFrontMatterExtraFile;
         }
 
         if (opt.m_emoji) {
-            extraFile += "<script src=\"qrc" + VNote::c_markdownitEmojiExtraFile + "\"></script>\n";
+            scripts << VNote::c_markdownitEmojiExtraFile;
+        }
+
+        for (auto const & script : scripts) {
+            extraFile += "<script src=\"qrc" + script + "\"></script>\n";
         }
 
         QString optJs = QString("<script>var VMarkdownitOption = {"
@@ -749,6 +1152,27 @@ QString VUtils::generateHtmlTemplate(const QString &p_template,
                                .arg(opt.m_emoji ? QStringLiteral("true") : QStringLiteral("false"));
         extraFile += optJs;
 
+        extraFile += "<script src=\"qrc" + VNote::c_markdownitCoreJsFile + "\"></script>\n";
+
+        // wkhtmltopdf does not support Web Worker.
+        if (g_config->getEnableRenderWorker() && !p_wkhtmltopdf) {
+            scripts.prepend(VNote::c_highlightjsJsFile);
+            scripts << VNote::c_markdownitCoreJsFile;
+
+            QString workerJs = QString("<script>var VRenderWorkerFile = 'qrc%1';\n"
+                                       "var VRenderWorkerScripts = [").arg(VNote::c_markdownitWorkerJsFile);
+            for (int i = 0; i < scripts.size(); ++i) {
+                if (i > 0) {
+                    workerJs += ", ";
+                }
+
+                workerJs += "'qrc" + scripts[i] + "'";
+            }
+
+            workerJs += "];</script>\n";
+            extraFile += workerJs;
+        }
+
         mathjaxTypeSetOnLoad = false;
         break;
     }
@@ -767,13 +1191,13 @@ QString VUtils::generateHtmlTemplate(const QString &p_template,
     extraFile += "<script src=\"qrc" + VNote::c_turndownJsFile + "\"></script>\n";
     extraFile += "<script src=\"qrc" + VNote::c_turndownGfmExtraFile + "\"></script>\n";
 
-    if (g_config->getEnableMermaid()) {
+    if (g_config->getEnableMermaid() && VNote::loadDiagramResourcePack()) {
         extraFile += "<link rel=\"stylesheet\" type=\"text/css\" href=\"" + g_config->getMermaidCssStyleUrl() + "\"/>\n" +
                      "<script src=\"qrc" + VNote::c_mermaidApiJsFile + "\"></script>\n" +
                      "<script>var VEnableMermaid = true;</script>\n";
     }
 
-    if (g_config->getEnableFlowchart()) {
+    if (g_config->getEnableFlowchart() && VNote::loadDiagramResourcePack()) {
         extraFile += "<script src=\"qrc" + VNote::c_raphaelJsFile + "\"></script>\n" +
                      "<script src=\"qrc" + VNote::c_flowchartJsFile + "\"></script>\n" +
                      "<script>var VEnableFlowchart = true;</script>\n";
@@ -814,7 +1238,7 @@ QString VUtils::generateHtmlTemplate(const QString &p_template,
         }
     }
 
-    if (g_config->getEnableWavedrom()) {
+    if (g_config->getEnableWavedrom() && VNote::loadDiagramResourcePack()) {
         extraFile += "<script src=\"qrc" + VNote::c_wavedromThemeFile + "\"></script>\n" +
                      "<script src=\"qrc" + VNote::c_wavedromJsFile + "\"></script>\n" +
                      "<script>var VEnableWavedrom = true;</script>\n";
@@ -966,9 +1390,13 @@ QString VUtils::generateMathJaxPreviewTemplate()
                  "<script src=\"qrc" + VNote::c_mermaidApiJsFile + "\"></script>\n";
     */
 
+    bool hasDiagram = VNote::loadDiagramResourcePack();
+
     // Flowchart.
-    extraFile += "<script src=\"qrc" + VNote::c_raphaelJsFile + "\"></script>\n" +
-                 "<script src=\"qrc" + VNote::c_flowchartJsFile + "\"></script>\n";
+    if (hasDiagram) {
+        extraFile += "<script src=\"qrc" + VNote::c_raphaelJsFile + "\"></script>\n" +
+                     "<script src=\"qrc" + VNote::c_flowchartJsFile + "\"></script>\n";
+    }
 
     // MathJax.
     extraFile += "<script type=\"text/x-mathjax-config\">"
@@ -991,8 +1419,10 @@ QString VUtils::generateMathJaxPreviewTemplate()
                  "                    messageStyle: \"none\"});\n"
                  "</script>\n";
 
-    extraFile += "<script src=\"qrc" + VNote::c_wavedromThemeFile + "\"></script>\n" +
-                 "<script src=\"qrc" + VNote::c_wavedromJsFile + "\"></script>\n";
+    if (hasDiagram) {
+        extraFile += "<script src=\"qrc" + VNote::c_wavedromThemeFile + "\"></script>\n" +
+                     "<script src=\"qrc" + VNote::c_wavedromJsFile + "\"></script>\n";
+    }
 
     // PlantUML.
     extraFile += "<script type=\"text/javascript\" src=\"" + VNote::c_plantUMLJsFile + "\"></script>\n" +
@@ -1006,10 +1436,12 @@ QString VUtils::generateMathJaxPreviewTemplate()
 
 QString VUtils::getFileNameWithSequence(const QString &p_directory,
                                         const QString &p_baseFileName,
-                                        bool p_completeBaseName)
+                                        bool p_completeBaseName,
+                                        const QSet<QString> &p_takenNames)
 {
     QDir dir(p_directory);
-    if (!dir.exists() || !dir.exists(p_baseFileName)) {
+    if ((!dir.exists() || !dir.exists(p_baseFileName))
+        && !p_takenNames.contains(p_baseFileName)) {
         return p_baseFileName;
     }
 
@@ -1024,7 +1456,7 @@ QString VUtils::getFileNameWithSequence(const QString &p_directory,
         if (!suffix.isEmpty()) {
             fileName = fileName + "." + suffix;
         }
-    } while (fileExists(dir, fileName, true));
+    } while (fileExists(dir, fileName, true) || p_takenNames.contains(fileName));
 
     return fileName;
 }
@@ -1304,6 +1736,44 @@ bool VUtils::deleteFile(const QString &p_recycleBinFolderPath,
     return true;
 }
 
+bool VUtils::deleteFiles(const QString &p_recycleBinFolderPath,
+                         const QStringList &p_paths)
+{
+    if (p_paths.isEmpty()) {
+        return true;
+    }
+
+    QString binPath = getRecycleBinSubFolderToUse(p_recycleBinFolderPath);
+    QDir binDir(binPath);
+    if (!binDir.exists()) {
+        binDir.mkpath(binPath);
+        if (!binDir.exists()) {
+            qWarning() << "fail to create recycle bin folder" << binPath;
+            return false;
+        }
+    }
+
+    // Names taken by this batch.
+    QSet<QString> takenNames;
+    bool ret = true;
+    for (auto const & path : p_paths) {
+        QString destName = getFileNameWithSequence(binPath,
+                                                   fileNameFromPath(path),
+                                                   true,
+                                                   takenNames);
+        if (!binDir.rename(path, binDir.filePath(destName))) {
+            qWarning() << "fail to move" << path << "to" << binDir.filePath(destName);
+            ret = false;
+            continue;
+        }
+
+        takenNames.insert(destName);
+        qDebug() << "moved" << path << "to" << binPath << "as" << destName;
+    }
+
+    return ret;
+}
+
 QVector<VElementRegion> VUtils::fetchImageRegionsUsingParser(const QString &p_content)
 {
     Q_ASSERT(!p_content.isEmpty());
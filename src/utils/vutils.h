@@ -8,6 +8,7 @@
 #include <QMessageBox>
 #include <QUrl>
 #include <QDir>
+#include <QSet>
 #include <functional>
 
 #include "vconfigmanager.h"
@@ -59,6 +60,9 @@ class QTemporaryFile;
 
 #define RESET_TIME() VUtils::elapsedTime(true)
 
+// Log the time elapsed since the previous startup step.
+#define STARTUP_TIME(p_step) qInfo() << "STARTUP_TIME" << (p_step) << VUtils::elapsedTime() << "ms"
+
 enum class MessageBoxType
 {
     Normal = 0,
@@ -88,8 +92,10 @@ struct ImageLink
 class VUtils
 {
 public:
+    // Read UTF-8 text of a file with CR dropped. Big files are mapped.
     static QString readFileFromDisk(const QString &filePath);
 
+    // The write functions replace the file atomically via a temporary file.
     static bool writeFileToDisk(const QString &p_filePath, const QString &p_text);
 
     static bool writeFileToDisk(const QString &p_filePath, const QByteArray &p_data);
@@ -102,14 +108,27 @@ public:
                                          const QString &title,
                                          const QString &format = "png");
 
+    // Name of an image file of content @p_data with suffix @p_format, used by
+    // notebooks naming images by content.
+    static QString contentImageFileName(const QByteArray &p_data, const QString &p_format);
+
+    // Name of an image file of @p_image to be encoded in @p_format with
+    // @p_quality, by the hash of its pixels so it could be named before
+    // encoded.
+    static QString contentImageFileName(const QImage &p_image,
+                                        const QString &p_format,
+                                        int p_quality);
+
     // Given the file name @p_fileName and directory path @p_dirPath, generate
     // a file name based on @p_fileName which does not exist in @p_dirPath.
     // @p_completeBaseName: use complete base name or complete suffix. For example,
     // "abc.tar.gz", if @p_completeBaseName is true, the base name is "abc.tar",
     // otherwise, it is "abc".
+    // @p_takenNames: names to avoid besides the existing ones.
     static QString generateCopiedFileName(const QString &p_dirPath,
                                           const QString &p_fileName,
-                                          bool p_completeBaseName = true);
+                                          bool p_completeBaseName = true,
+                                          const QSet<QString> &p_takenNames = QSet<QString>());
 
     // Given the directory name @p_dirName and directory path @p_parentDirPath,
     // generate a directory name based on @p_dirName which does not exist in
@@ -130,10 +149,23 @@ public:
 
     // Fetch all the image links in markdown file p_file.
     // @p_type to filter the links returned.
-    // Need to open p_file and will close it if it is originally closed.
+    // Use the content of @p_file if it is opened, otherwise the cached links of
+    // the file on disk.
     static QVector<ImageLink> fetchImagesFromMarkdownFile(VFile *p_file,
                                                           ImageLink::ImageLinkType p_type = ImageLink::All);
 
+    // Scan @p_text for urls of inline image links, skipping fenced code blocks.
+    // Much cheaper than a full parse via fetchImageRegionsUsingParser().
+    static QVector<QString> fetchImageLinkUrls(const QString &p_text);
+
+    // Scan @p_text for urls of inline links other than images, skipping fenced
+    // code blocks.
+    static QVector<QString> fetchLinkUrls(const QString &p_text);
+
+    // Fetch urls of image links of file @p_filePath, cached until the file
+    // changes on disk.
+    static bool fetchImageLinkUrlsOfFile(const QString &p_filePath, QVector<QString> &p_urls);
+
     // Use PegParser to parse @p_content to get all image link regions.
     static QVector<VElementRegion> fetchImageRegionsUsingParser(const QString &p_content);
 
@@ -162,6 +194,14 @@ public:
     // Will make necessary parent directory along the destination path.
     static bool copyDirectory(const QString &p_srcDirPath, const QString &p_destDirPath, bool p_isCut);
 
+    // Copy file @p_srcFilePath to @p_destFilePath only if the destination does
+    // not exist or differs from the source.
+    static bool syncFile(const QString &p_srcFilePath, const QString &p_destFilePath);
+
+    // Sync files of @p_srcDirPath to @p_destDirPath recursively via syncFile().
+    // Files only in @p_destDirPath are kept.
+    static bool syncDirectory(const QString &p_srcDirPath, const QString &p_destDirPath);
+
     static int showMessage(QMessageBox::Icon p_icon, const QString &p_title, const QString &p_text,
                            const QString &p_infoText, QMessageBox::StandardButtons p_buttons,
                            QMessageBox::StandardButton p_defaultBtn, QWidget *p_parent,
@@ -183,11 +223,17 @@ public:
     static void sleepWait(int p_milliseconds);
 
     // Return the DocType according to suffix.
-    static DocType docTypeFromName(const QString &p_name);
+    // @p_size: size in bytes of the file if known. A Markdown file too large
+    // to be edited with Markdown features is treated as plain text.
+    static DocType docTypeFromName(const QString &p_name, qint64 p_size = -1);
 
     // Generate HTML template.
+    // The generated templates are cached until any config is changed.
     static QString generateHtmlTemplate(MarkdownConverterType p_conType);
 
+    // Called when VNote::s_markdownTemplate is updated.
+    static void clearHtmlTemplateCache();
+
     // @p_renderBg is the background name.
     // @p_wkhtmltopdf: whether this template is used for wkhtmltopdf.
     static QString generateHtmlTemplate(MarkdownConverterType p_conType,
@@ -214,9 +260,11 @@ public:
     // @p_completeBaseName: use complete base name or complete suffix. For example,
     // "abc.tar.gz", if @p_completeBaseName is true, the base name is "abc.tar",
     // otherwise, it is "abc".
+    // @p_takenNames: names to avoid though not existing yet.
     static QString getFileNameWithSequence(const QString &p_directory,
                                            const QString &p_baseFileName,
-                                           bool p_completeBaseName = true);
+                                           bool p_completeBaseName = true,
+                                           const QSet<QString> &p_takenNames = QSet<QString>());
 
     // Get an available directory name in @p_directory with base @p_baseDirName.
     // If there already exists a file named @p_baseFileName, try to add sequence
@@ -284,6 +332,12 @@ public:
     // Delete file specified by @p_path.
     static bool deleteFile(const QString &p_path);
 
+    // Move files @p_paths to the recycle bin folder @p_recycleBinFolderPath
+    // in one batch. Safe to call in a worker thread.
+    // Returns false if any of them fails.
+    static bool deleteFiles(const QString &p_recycleBinFolderPath,
+                            const QStringList &p_paths);
+
     // @p_uniformNum: if true, we use YYYY/MM/DD HH:mm:ss form, which is good for
     // sorting.
     static QString displayDateTime(const QDateTime &p_dateTime, bool p_uniformNum = false);
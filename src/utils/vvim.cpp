@@ -3420,7 +3420,8 @@ handle_target:
                                                       pairs.at(idx).second,
                                                       true,
                                                       true,
-                                                      1);
+                                                      1,
+                                                      m_editor->getStructureIndex());
 
         if (ret) {
             // Found matched pair.
@@ -3596,7 +3597,8 @@ handle_target:
 
         int position = VEditUtils::findNextEmptyBlock(p_cursor,
                                                       forward,
-                                                      p_repeat);
+                                                      p_repeat,
+                                                      m_editor->getStructureIndex());
         if (position == -1) {
             // No empty block. Move to the first/last character.
             p_cursor.movePosition(forward ? QTextCursor::End : QTextCursor::Start,
@@ -3889,7 +3891,8 @@ handlePairTarget:
                                                       closing,
                                                       around,
                                                       crossBlock,
-                                                      p_repeat);
+                                                      p_repeat,
+                                                      m_editor->getStructureIndex());
         break;
     }
 
@@ -4835,6 +4838,8 @@ void VVim::processIndentAction(QList<Token> &p_tokens, IndentType p_type)
                                                      p_type == IndentType::Indent);
                 }
 
+                moveCursorAfterIndent(cursor);
+
                 message(tr("%1 %2 %3ed 1 time").arg(repeat)
                                                .arg(repeat > 1 ? tr("lines")
                                                                : tr("line"))
@@ -4887,6 +4892,8 @@ void VVim::processIndentAction(QList<Token> &p_tokens, IndentType p_type)
                                                      p_type == IndentType::Indent);
                 }
 
+                moveCursorAfterIndent(cursor);
+
                 message(tr("%1 %2 %3ed 1 time").arg(nrBlock)
                                                .arg(nrBlock > 1 ? tr("lines")
                                                                 : tr("line"))
@@ -4928,6 +4935,7 @@ void VVim::processIndentAction(QList<Token> &p_tokens, IndentType p_type)
                                              p_type == IndentType::Indent);
         }
 
+        m_editor->setTextCursorW(cursor);
         return;
     }
 
@@ -4945,12 +4953,22 @@ void VVim::processIndentAction(QList<Token> &p_tokens, IndentType p_type)
                                          p_type == IndentType::Indent);
     }
 
+    moveCursorAfterIndent(cursor);
+
     message(tr("%1 %2 %3ed 1 time").arg(nrBlock)
                                    .arg(nrBlock > 1 ? tr("lines")
                                                     : tr("line"))
                                    .arg(op));
 }
 
+void VVim::moveCursorAfterIndent(QTextCursor &p_cursor)
+{
+    // Like Vim, go to the first non-space character of the first line.
+    p_cursor.setPosition(p_cursor.selectionStart());
+    VEditUtils::moveCursorFirstNonSpaceCharacter(p_cursor, QTextCursor::MoveAnchor);
+    m_editor->setTextCursorW(p_cursor);
+}
+
 void VVim::processToLowerAction(QList<Token> &p_tokens, bool p_toLower)
 {
     Token to = p_tokens.takeFirst();
@@ -6057,12 +6075,7 @@ bool VVim::processLeaderSequence(const Key &p_key)
             m_pendingKeys.pop_back();
         }
 
-        for (auto const &key : replaySeq) {
-            bool ret = handleKeyPressEvent(key.m_key, key.m_modifiers);
-            if (!ret) {
-                break;
-            }
-        }
+        replayKeys(replaySeq);
 
         m_replayLeaderSequence = false;
     } else {
@@ -6072,6 +6085,24 @@ bool VVim::processLeaderSequence(const Key &p_key)
     return validSequence;
 }
 
+void VVim::replayKeys(const QList<Key> &p_keys)
+{
+    // Edit blocks of the commands are joined into this one.
+    QTextCursor cursor = m_editor->textCursorW();
+    cursor.beginEditBlock();
+    m_editor->beginBatchUpdate();
+
+    for (auto const &key : p_keys) {
+        bool ret = handleKeyPressEvent(key.m_key, key.m_modifiers);
+        if (!ret) {
+            break;
+        }
+    }
+
+    m_editor->endBatchUpdate();
+    cursor.endEditBlock();
+}
+
 VVim::LocationStack::LocationStack(int p_maximum)
     : m_pointer(0), c_maximumLocations(p_maximum < 10 ? 10 : p_maximum)
 {
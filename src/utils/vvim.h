@@ -643,6 +643,9 @@ private:
     // and Action::AutoIndent action.
     void processIndentAction(QList<Token> &p_tokens, IndentType p_type);
 
+    // Move the cursor of the editor into the blocks indented by @p_cursor.
+    void moveCursorAfterIndent(QTextCursor &p_cursor);
+
     // @p_tokens is the arguments of the Action::ToLower and Action::ToUpper action.
     void processToLowerAction(QList<Token> &p_tokens, bool p_toLower);
 
@@ -812,6 +815,10 @@ private:
     // P: "+P
     bool processLeaderSequence(const Key &p_key);
 
+    // Replay @p_keys as one edit with the editor updated only at the end.
+    // Stop at the first key not handled.
+    void replayKeys(const QList<Key> &p_keys);
+
     // Jump across titles.
     // [[, ]], [], ][, [{, ]}.
     void processTitleJump(const QList<Token> &p_tokens, bool p_forward, int p_relativeLevel);
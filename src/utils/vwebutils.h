@@ -5,7 +5,12 @@
 #include <QString>
 #include <QVector>
 #include <QStringList>
-#include <QRegExp>
+#include <QList>
+#include <QSet>
+#include <QCache>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
 
 
 class VWebUtils
@@ -23,12 +28,21 @@ public:
 
     // Download or copy @p_url to @p_folder.
     // Return the target file path on success or empty string on failure.
-    QString copyResource(const QUrl &p_url, const QString &p_folder) const;
+    // @p_sync: reuse the file of the same name in @p_folder, replacing it if it
+    // differs, instead of picking a new name.
+    QString copyResource(const QUrl &p_url, const QString &p_folder, bool p_sync = false) const;
 
     // Return a dataURI of @p_url if it is an image.
     // Please use single quote to quote the URI.
+    // URIs of local files are cached until the files are modified.
+    // Thread-safe.
     QString dataURI(const QUrl &p_url, bool p_keepTitle = true) const;
 
+    // Start computing the data URIs of the local files of @p_urls on workers
+    // into the cache without waiting for them.
+    // Later dataURI() of them will wait for the running ones.
+    void prefetchDataURIs(const QList<QUrl> &p_urls, bool p_keepTitle) const;
+
 private:
     struct CopyTargetAction
     {
@@ -44,79 +58,26 @@ private:
         QVector<CopyTargetAction> m_actions;
     };
 
-    struct HtmlTag
+    struct DataURIEntry
     {
-        HtmlTag()
-            : m_start(-1), m_end(-1)
-        {
-
-        }
+        qint64 m_size;
 
-        bool isNull()
-        {
-            return m_name.isEmpty();
-        }
-
-        QString m_name;
-        QString m_style;
+        qint64 m_modifiedTime;
 
-        int m_start;
-        int m_end;
+        QString m_uri;
     };
 
     void initCopyTargets(const QStringList &p_str);
 
+    // Compute the data URI of @p_file of @p_url with suffix @p_suffix.
+    static QString computeDataURI(const QUrl &p_url,
+                                  const QString &p_file,
+                                  const QString &p_suffix,
+                                  bool p_keepTitle);
+
     // Return the index in m_copyTargets of @p_target.
     int targetIndex(const QString &p_target) const;
 
-    bool alterHtmlByTargetAction(const QUrl &p_baseUrl, QString &p_html, const CopyTargetAction &p_action);
-
-    // Remove background color style in @p_html of all tags except @p_skipTags.
-    bool removeBackgroundColor(QString &p_html, const QStringList &p_skipTags);
-
-    // Translate color styles in @p_html using mappings from VPalette.
-    bool translateColors(QString &p_html, const QStringList &p_skipTags);
-
-    // Fix <img src> in @p_html.
-    bool fixImageSrc(const QUrl &p_baseUrl, QString &p_html);
-
-    // Remove margin/padding/margin-left/right/padding-left/right.
-    bool removeMarginPadding(QString &p_html, const QStringList &p_skipTags);
-
-    bool removeStyles(QString &p_html, const QStringList &p_skipTags, const QStringList &p_styles);
-
-    // Remove styles specified in [web]/styles_to_remove_when_copied.
-    bool removeStylesToRemoveWhenCopied(QString &p_html, const QStringList &p_skipTags);
-
-    // Remove all styles.
-    bool removeAllStyles(QString &p_html, const QStringList &p_skipTags);
-
-    // Transform <mark> to <span>.
-    bool transformMarkToSpan(QString &p_html);
-
-    // Replace the background color of <pre> with that of its child <code>.
-    bool replacePreBackgroundColorWithCode(QString &p_html);
-
-    VWebUtils::HtmlTag readNextTag(const QString &p_html, int p_pos);
-
-    // Replace \n with <br> in <pre>.
-    bool replaceNewLineWithBR(QString &p_html);
-
-    // Replace local absolute/relative <img> tag with a warning label.
-    bool replaceLocalImgWithWarningLabel(QString &p_html);
-
-    // Add <span> inside <code> not in <pre>.
-    bool addSpanInsideCode(QString &p_html);
-
-    // Replace &quot; in font-family with '.
-    bool replaceQuoteInFontFamily(QString &p_html);
-
-    // Replace headings with span.
-    bool replaceHeadingWithSpan(QString &p_html);
-
-    // Fix tags as XHTML like <img> and <br>.
-    bool fixXHtmlTags(QString &p_html);
-
     QVector<CopyTarget> m_copyTargets;
 
     // Custom styles to remove when copied.
@@ -125,23 +86,19 @@ private:
     // Style of <span> which is transformed from <mark>.
     QString m_styleOfSpanForMark;
 
-    // Html start tag.
-    // Captured texts:
-    // 1. The tag name like 'code';
-    // 2. Text after tag name and before the end '>';
-    QRegExp m_tagReg;
-
-    // Html start tag with "style" defined.
-    // Captured texts:
-    // 1. The tag name like 'code';
-    // 2. Text before 'style=""';
-    // 3. Text inside 'style=""';
-    // 4. Text after 'style=""' and before '>';
-    QRegExp m_styleTagReg;
-
-    // <Img> tag.
-    // Captured texts:
-    // 1. Src string without ";
-    QRegExp m_imgTagReg;
+    // Guard the data URI cache and m_dataURIsInProgress.
+    mutable QMutex m_dataURIMutex;
+
+    // Wake the waiters of the data URIs in progress.
+    mutable QWaitCondition m_dataURICond;
+
+    // Key of title flag and file path -> data URI, costed by the length.
+    mutable QCache<QString, DataURIEntry> m_dataURICache;
+
+    // Keys of the data URIs being computed.
+    mutable QSet<QString> m_dataURIsInProgress;
+
+    // Declared last to wait for the workers before the cache is gone.
+    mutable QThreadPool m_dataURIPool;
 };
 #endif // VWEBUTILS_H
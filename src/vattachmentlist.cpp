@@ -11,6 +11,7 @@
 #include "utils/vimnavigationforwidget.h"
 #include "utils/viconutils.h"
 #include "vlineedit.h"
+#include "vattachmenttransfer.h"
 
 extern VConfigManager *g_config;
 
@@ -206,24 +207,81 @@ void VAttachmentList::addAttachment()
 void VAttachmentList::addAttachments(const QStringList &p_files)
 {
     Q_ASSERT(m_file);
-    int addedFiles = 0;
-    for (int i = 0; i < p_files.size(); ++i) {
-        if (!m_file->addAttachment(p_files[i])) {
-            VUtils::showMessage(QMessageBox::Warning,
-                                tr("Warning"),
-                                tr("Fail to add attachment %1 for note <span style=\"%2\">%3</span>.")
-                                  .arg(p_files[i])
-                                  .arg(g_config->c_dataTextStyle)
-                                  .arg(m_file->getName()),
-                                "",
-                                QMessageBox::Ok,
-                                QMessageBox::Ok,
-                                g_mainWin);
-        } else {
-            ++addedFiles;
+    QStringList failedFiles;
+    QString folderPath = m_file->fetchAttachmentFolderPath();
+    QDir dir(folderPath);
+    QSet<QString> takenNames;
+    QVector<VFileCopier::Job> jobs;
+    for (auto const & file : p_files) {
+        if (file.isEmpty() || !QFileInfo::exists(file)) {
+            failedFiles << file;
+            continue;
+        }
+
+        // For attachments, we do not use complete base name.
+        // abc.tar.gz should be abc_001.tar.gz instead of abc.tar_001.gz.
+        QString name = VUtils::getFileNameWithSequence(folderPath,
+                                                       VUtils::fileNameFromPath(file),
+                                                       false,
+                                                       takenNames);
+        takenNames.insert(name);
+        jobs.append(VFileCopier::Job(file, dir.filePath(name), false, false));
+    }
+
+    // Copy in background and keep the UI responsive.
+    VAttachmentTransfer transfer(jobs);
+    qint64 total = qMax(transfer.totalBytes(), (qint64)1);
+    QProgressDialog proDlg(tr("Adding attachments..."),
+                           tr("Abort"),
+                           0,
+                           1000,
+                           g_mainWin);
+    proDlg.setWindowModality(Qt::WindowModal);
+    proDlg.setWindowTitle(tr("Add Attachments"));
+    proDlg.setMinimumDuration(500);
+
+    QEventLoop loop;
+    connect(&transfer, &VAttachmentTransfer::progressUpdated,
+            &proDlg, [&proDlg, total](qint64 p_copied) {
+                proDlg.setValue(p_copied * 1000 / total);
+            });
+    connect(&proDlg, &QProgressDialog::canceled,
+            &transfer, &VAttachmentTransfer::stop);
+    connect(&transfer, &QThread::finished,
+            &loop, &QEventLoop::quit);
+
+    transfer.start();
+    loop.exec();
+    transfer.wait();
+
+    QVector<QString> names;
+    for (auto const & job : transfer.jobs()) {
+        if (job.m_succeeded) {
+            names.append(VUtils::fileNameFromPath(job.m_destFile));
+        } else if (!transfer.isStopped()) {
+            failedFiles << job.m_srcFile;
         }
     }
 
+    // Update the config once for all of them.
+    if (!m_file->addAttachments(names)) {
+        failedFiles << tr("Fail to update the configuration of the note.");
+    }
+
+    if (!failedFiles.isEmpty()) {
+        VUtils::showMessage(QMessageBox::Warning,
+                            tr("Warning"),
+                            tr("Fail to add attachments for note <span style=\"%1\">%2</span>.")
+                              .arg(g_config->c_dataTextStyle)
+                              .arg(m_file->getName()),
+                            failedFiles.join("\n"),
+                            QMessageBox::Ok,
+                            QMessageBox::Ok,
+                            g_mainWin);
+    }
+
+    int addedFiles = names.size();
+
     if (addedFiles > 0) {
         g_mainWin->showStatusMessage(tr("%1 %2 added as attachments")
                                      .arg(addedFiles)
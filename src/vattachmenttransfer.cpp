@@ -0,0 +1,54 @@
+#include "vattachmenttransfer.h"
+
+#include <QFileInfo>
+#include <QDebug>
+
+// Bytes copied between two progress updates.
+#define PROGRESS_STEP (4 * 1024 * 1024)
+
+VAttachmentTransfer::VAttachmentTransfer(const QVector<VFileCopier::Job> &p_jobs,
+                                         QObject *p_parent)
+    : QThread(p_parent),
+      m_stop(0),
+      m_jobs(p_jobs),
+      m_totalBytes(0)
+{
+    for (auto const & job : m_jobs) {
+        m_totalBytes += QFileInfo(job.m_srcFile).size();
+    }
+}
+
+void VAttachmentTransfer::stop()
+{
+    m_stop.store(1);
+}
+
+void VAttachmentTransfer::run()
+{
+    qint64 done = 0;
+    qint64 lastReported = 0;
+    for (auto & job : m_jobs) {
+        if (isStopped()) {
+            break;
+        }
+
+        qint64 size = QFileInfo(job.m_srcFile).size();
+        job.m_succeeded = VFileCopier::copyFile(job, [this, done, &lastReported](qint64 p_copied, qint64 p_total) {
+            Q_UNUSED(p_total);
+            if (done + p_copied - lastReported >= PROGRESS_STEP) {
+                lastReported = done + p_copied;
+                emit progressUpdated(lastReported);
+            }
+
+            return !isStopped();
+        });
+
+        if (!job.m_succeeded && !isStopped()) {
+            qWarning() << "fail to copy attachment" << job.m_srcFile << job.m_destFile;
+        }
+
+        done += size;
+        lastReported = done;
+        emit progressUpdated(done);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef VATTACHMENTTRANSFER_H
+#define VATTACHMENTTRANSFER_H
+
+#include <QThread>
+#include <QVector>
+#include <QAtomicInt>
+
+#include "utils/vfilecopier.h"
+
+// Copy files into the attachment folder of a note in background.
+// Jobs are run in order and the ones not run yet are skipped once asked to
+// stop. The copy in progress is cancelled without leaving the target file.
+class VAttachmentTransfer : public QThread
+{
+    Q_OBJECT
+public:
+    VAttachmentTransfer(const QVector<VFileCopier::Job> &p_jobs,
+                        QObject *p_parent = nullptr);
+
+    void stop();
+
+    bool isStopped() const;
+
+    // Valid after finished.
+    const QVector<VFileCopier::Job> &jobs() const;
+
+    // Total bytes of the source files.
+    qint64 totalBytes() const;
+
+signals:
+    // @p_copied: bytes copied of all the jobs.
+    void progressUpdated(qint64 p_copied);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QAtomicInt m_stop;
+
+    QVector<VFileCopier::Job> m_jobs;
+
+    qint64 m_totalBytes;
+};
+
+inline bool VAttachmentTransfer::isStopped() const
+{
+    return m_stop.load() == 1;
+}
+
+inline const QVector<VFileCopier::Job> &VAttachmentTransfer::jobs() const
+{
+    return m_jobs;
+}
+
+inline qint64 VAttachmentTransfer::totalBytes() const
+{
+    return m_totalBytes;
+}
+
+#endif // VATTACHMENTTRANSFER_H
@@ -0,0 +1,174 @@
+#include "vbackupjournal.h"
+
+#include <QDebug>
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QTextCursor>
+
+#include "vfile.h"
+
+// Deltas could grow as large as the content before a new snapshot is written.
+#define MIN_JOURNAL_SIZE (64 * 1024)
+
+VBackupJournal::VBackupJournal(VFile *p_file, QTextDocument *p_doc, QObject *p_parent)
+    : QObject(p_parent),
+      m_file(p_file),
+      m_doc(p_doc)
+{
+    reset();
+
+    connect(m_doc, &QTextDocument::contentsChange,
+            this, &VBackupJournal::handleContentsChange);
+}
+
+void VBackupJournal::reset()
+{
+    m_blockHashes = blockHashes(0, m_doc->blockCount() - 1);
+    m_length = contentLength();
+    m_backupLength = m_length;
+    m_dirty = false;
+    m_dirtyStart = 0;
+    m_dirtySuffix = 0;
+    m_needSnapshot = true;
+    m_journalSize = 0;
+}
+
+int VBackupJournal::contentLength() const
+{
+    // Exclude the last paragraph separator.
+    return m_doc->characterCount() - 1;
+}
+
+QVector<uint> VBackupJournal::blockHashes(int p_first, int p_last) const
+{
+    QVector<uint> hashes;
+    if (p_last >= p_first) {
+        hashes.reserve(p_last - p_first + 1);
+    }
+
+    for (QTextBlock block = m_doc->findBlockByNumber(p_first);
+         block.isValid() && block.blockNumber() <= p_last;
+         block = block.next()) {
+        hashes.append(qHash(block.text()));
+    }
+
+    return hashes;
+}
+
+QString VBackupJournal::textOfRange(int p_start, int p_end) const
+{
+    if (p_end <= p_start) {
+        return QString();
+    }
+
+    QTextCursor cursor(m_doc);
+    cursor.setPosition(p_start);
+    cursor.setPosition(p_end, QTextCursor::KeepAnchor);
+    QString text = cursor.selectedText();
+
+    // Same as QTextDocument::toPlainText().
+    for (auto & ch : text) {
+        switch (ch.unicode()) {
+        case 0xfdd0:
+        case 0xfdd1:
+        case QChar::ParagraphSeparator:
+        case QChar::LineSeparator:
+            ch = QLatin1Char('\n');
+            break;
+
+        case QChar::Nbsp:
+            ch = QLatin1Char(' ');
+            break;
+
+        default:
+            break;
+        }
+    }
+
+    return text;
+}
+
+void VBackupJournal::handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    int newLength = contentLength();
+    int oldLength = m_length;
+
+    // Counts may include the last paragraph separator.
+    int removed = qMin(p_charsRemoved, oldLength - p_position);
+    int added = newLength - oldLength + removed;
+    if (p_position < 0 || removed < 0 || added < 0 || p_position + added > newLength) {
+        qWarning() << "unexpected contents change" << p_position << p_charsRemoved << p_charsAdded;
+        reset();
+        return;
+    }
+
+    int firstBlock = m_doc->findBlock(p_position).blockNumber();
+    int lastBlock = m_doc->findBlock(p_position + added).blockNumber();
+    int oldLastBlock = lastBlock - (m_doc->blockCount() - m_blockHashes.size());
+    if (firstBlock < 0 || oldLastBlock + 1 < firstBlock || oldLastBlock >= m_blockHashes.size()) {
+        reset();
+        return;
+    }
+
+    QVector<uint> hashes = blockHashes(firstBlock, lastBlock);
+    if (removed == added) {
+        // Highlighting changes formats with the text untouched.
+        bool same = oldLastBlock == lastBlock;
+        for (int i = firstBlock; same && i <= lastBlock; ++i) {
+            same = m_blockHashes[i] == hashes[i - firstBlock];
+        }
+
+        if (same) {
+            return;
+        }
+    }
+
+    m_blockHashes.remove(firstBlock, oldLastBlock - firstBlock + 1);
+    for (int i = 0; i < hashes.size(); ++i) {
+        m_blockHashes.insert(firstBlock + i, hashes[i]);
+    }
+
+    int suffix = oldLength - p_position - removed;
+    if (m_dirty) {
+        m_dirtyStart = qMin(m_dirtyStart, p_position);
+        m_dirtySuffix = qMin(m_dirtySuffix, suffix);
+    } else {
+        m_dirty = true;
+        m_dirtyStart = p_position;
+        m_dirtySuffix = suffix;
+    }
+
+    m_length = newLength;
+}
+
+bool VBackupJournal::write()
+{
+    if (!m_needSnapshot && m_dirty) {
+        int removed = m_backupLength - m_dirtySuffix - m_dirtyStart;
+        QString text = textOfRange(m_dirtyStart, m_length - m_dirtySuffix);
+        if (m_journalSize + text.size() <= qMax(m_length, MIN_JOURNAL_SIZE)
+            && m_file->appendBackupDelta(m_dirtyStart, removed, text)) {
+            m_journalSize += text.size();
+            m_backupLength = m_length;
+            m_dirty = false;
+            return true;
+        }
+
+        m_needSnapshot = true;
+    }
+
+    if (!m_needSnapshot) {
+        return true;
+    }
+
+    // Compact the journal into a new snapshot.
+    if (!m_file->writeBackupFile(m_doc->toPlainText())) {
+        return false;
+    }
+
+    m_backupLength = m_length;
+    m_dirty = false;
+    m_needSnapshot = false;
+    m_journalSize = 0;
+    return true;
+}
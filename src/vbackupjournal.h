@@ -0,0 +1,69 @@
+#ifndef VBACKUPJOURNAL_H
+#define VBACKUPJOURNAL_H
+
+#include <QObject>
+#include <QVector>
+#include <QString>
+
+class QTextDocument;
+class VFile;
+
+// Keep the backup file of a note in sync with the document being edited.
+// Edits are collected from contentsChange() and appended to the backup file
+// as deltas against the last snapshot, which is rewritten once the deltas
+// grow too large.
+class VBackupJournal : public QObject
+{
+    Q_OBJECT
+public:
+    VBackupJournal(VFile *p_file, QTextDocument *p_doc, QObject *p_parent = nullptr);
+
+    // Write the edits since last write to the backup file.
+    bool write();
+
+private slots:
+    void handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+
+private:
+    // Length of the document content.
+    int contentLength() const;
+
+    // Plain text of range [@p_start, @p_end) of the document.
+    QString textOfRange(int p_start, int p_end) const;
+
+    // Hashes of text of blocks [@p_first, @p_last].
+    QVector<uint> blockHashes(int p_first, int p_last) const;
+
+    // Rebuild the state from the whole document. A snapshot is needed then.
+    void reset();
+
+    VFile *m_file;
+
+    QTextDocument *m_doc;
+
+    // Hash of the text of each block, to tell content changes from format
+    // changes, which are also signaled via contentsChange().
+    QVector<uint> m_blockHashes;
+
+    // Length of the content in the backup file.
+    int m_backupLength;
+
+    // Length of the document content.
+    int m_length;
+
+    // Whether content changed since last write.
+    bool m_dirty;
+
+    // The changed range is [m_dirtyStart, length - m_dirtySuffix) in both
+    // the backup file and the document.
+    int m_dirtyStart;
+
+    int m_dirtySuffix;
+
+    bool m_needSnapshot;
+
+    // Number of characters of the deltas since last snapshot.
+    int m_journalSize;
+};
+
+#endif // VBACKUPJOURNAL_H
@@ -0,0 +1,500 @@
+#include "vbatchrunner.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QJsonDocument>
+#include <QSharedPointer>
+#include <stdio.h>
+
+#include "vconfigmanager.h"
+#include "vnotebook.h"
+#include "vdirectory.h"
+#include "vnotefile.h"
+#include "vsearch.h"
+#include "vexporter.h"
+#include "vimagededuper.h"
+#include "vnotebookchecker.h"
+#include "vrecyclebin.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+extern VWebUtils *g_webUtils;
+
+VBatchRunner::VBatchRunner(const Option &p_opt, QObject *p_parent)
+    : QObject(p_parent),
+      m_opt(p_opt),
+      m_pageLayout(QPageSize(QPageSize::A4),
+                   QPageLayout::Portrait,
+                   QMarginsF(10, 16, 10, 10),
+                   QPageLayout::Millimeter)
+{
+    if (!g_webUtils) {
+        m_webUtils.init();
+        g_webUtils = &m_webUtils;
+    }
+}
+
+VBatchRunner::~VBatchRunner()
+{
+    if (g_webUtils == &m_webUtils) {
+        g_webUtils = NULL;
+    }
+}
+
+bool VBatchRunner::isBatchMode(int p_argc, char *p_argv[])
+{
+    for (int i = 1; i < p_argc; ++i) {
+        if (!qstrcmp(p_argv[i], "--batch")) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool VBatchRunner::parseArguments(const QStringList &p_args, Option &p_opt)
+{
+    int idx = p_args.indexOf("--batch");
+    if (idx == -1) {
+        return false;
+    }
+
+    for (int i = idx + 1; i < p_args.size(); ++i) {
+        const QString &arg = p_args[i];
+        int sep = arg.indexOf('=');
+        if (sep <= 0) {
+            qWarning() << "skip invalid batch argument" << arg;
+            continue;
+        }
+
+        QString key = arg.left(sep);
+        QString val = arg.mid(sep + 1);
+        if (key == "command") {
+            if (val == "export") {
+                p_opt.m_command = Command::Export;
+            } else if (val == "search") {
+                p_opt.m_command = Command::Search;
+            } else if (val == "dedupe_images") {
+                p_opt.m_command = Command::DedupeImages;
+            } else if (val == "check") {
+                p_opt.m_command = Command::Check;
+            } else {
+                qWarning() << "unknown batch command" << val;
+                return false;
+            }
+        } else if (key == "notebook") {
+            p_opt.m_notebooks.append(val);
+        } else if (key == "output") {
+            p_opt.m_outputFile = val;
+        } else if (key == "dir") {
+            p_opt.m_exportFolder = val;
+        } else if (key == "format") {
+            if (val == "pdf") {
+                p_opt.m_exportPDF = true;
+            } else if (val == "html") {
+                p_opt.m_exportPDF = false;
+            } else {
+                qWarning() << "unknown batch export format" << val;
+                return false;
+            }
+        } else if (key == "native") {
+            p_opt.m_native = val.toInt() != 0;
+        } else if (key == "keyword") {
+            p_opt.m_keyword = val;
+        } else if (key == "pattern") {
+            p_opt.m_pattern = val;
+        } else if (key == "case") {
+            p_opt.m_caseSensitive = val.toInt() != 0;
+        } else if (key == "regex") {
+            p_opt.m_regularExpression = val.toInt() != 0;
+        } else if (key == "whole_word") {
+            p_opt.m_wholeWordOnly = val.toInt() != 0;
+        } else if (key == "clean") {
+            p_opt.m_clean = val.toInt() != 0;
+        } else {
+            qWarning() << "skip unknown batch argument" << arg;
+        }
+    }
+
+    if (p_opt.m_command == Command::Export && p_opt.m_exportFolder.isEmpty()) {
+        qWarning() << "batch export requires dir=";
+        return false;
+    }
+
+    if (p_opt.m_command == Command::Search && p_opt.m_keyword.isEmpty()) {
+        qWarning() << "batch search requires keyword=";
+        return false;
+    }
+
+    return true;
+}
+
+void VBatchRunner::run()
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    bool succeeded = openNotebooks();
+    if (succeeded) {
+        if (m_opt.m_command == Command::Export) {
+            for (auto nb : m_notebooks) {
+                succeeded = exportNotebook(nb) && succeeded;
+            }
+        } else if (m_opt.m_command == Command::Search) {
+            succeeded = searchNotebooks();
+        } else if (m_opt.m_command == Command::Check) {
+            succeeded = checkNotebooks();
+        } else {
+            succeeded = dedupeImages();
+        }
+    }
+
+    m_counts["elapsed_ms"] = (double)timer.elapsed();
+
+    if (!writeResult(succeeded)) {
+        succeeded = false;
+    }
+
+    emit finished(succeeded ? 0 : -1);
+}
+
+static void collectDirectories(VDirectory *p_dir, QVector<VDirectory *> &p_dirs)
+{
+    p_dirs.append(p_dir);
+    for (auto subDir : p_dir->getSubDirs()) {
+        collectDirectories(subDir, p_dirs);
+    }
+}
+
+bool VBatchRunner::openNotebooks()
+{
+    if (m_opt.m_notebooks.isEmpty()) {
+        g_config->getNotebooks(m_notebooks, this);
+    } else {
+        for (auto const & path : m_opt.m_notebooks) {
+            QString absPath = QDir::cleanPath(QFileInfo(path).absoluteFilePath());
+            m_notebooks.append(new VNotebook(QFileInfo(absPath).fileName(), absPath, this));
+        }
+    }
+
+    if (m_notebooks.isEmpty()) {
+        m_errors.append(tr("No notebook to process."));
+        return false;
+    }
+
+    bool ret = true;
+    int numOfNotes = 0;
+    for (auto nb : m_notebooks) {
+        if (!nb->open()) {
+            m_errors.append(tr("Fail to open notebook %1.").arg(nb->getPath()));
+            ret = false;
+            continue;
+        }
+
+        QVector<VDirectory *> dirs;
+        dirs.append(nb->getRootDir());
+        for (int i = 0; i < dirs.size(); ++i) {
+            VDirectory *dir = dirs[i];
+            if (!dir->open()) {
+                m_errors.append(tr("Fail to open folder %1.").arg(dir->fetchPath()));
+                ret = false;
+                continue;
+            }
+
+            numOfNotes += dir->getFiles().size();
+            for (auto subDir : dir->getSubDirs()) {
+                dirs.append(subDir);
+            }
+        }
+    }
+
+    m_counts["notes"] = numOfNotes;
+    return ret;
+}
+
+bool VBatchRunner::exportNotebook(VNotebook *p_notebook)
+{
+    if (!p_notebook->isOpened()) {
+        return false;
+    }
+
+    // The native renderer only supports Hoedown.
+    MarkdownConverterType renderer = g_config->getMdConverterType();
+    if (m_opt.m_native && !m_opt.m_exportPDF) {
+        renderer = MarkdownConverterType::Hoedown;
+    }
+
+    ExportOption opt(ExportSource::CurrentNotebook,
+                     m_opt.m_exportPDF ? ExportFormat::PDF : ExportFormat::HTML,
+                     renderer,
+                     g_config->getCurRenderBackgroundColor(),
+                     g_config->getCssStyle(),
+                     g_config->getCodeBlockCssStyle(),
+                     true,
+                     false,
+                     ExportPDFOption(&m_pageLayout,
+                                     false,
+                                     QString(),
+                                     true,
+                                     false,
+                                     QString(),
+                                     QString(),
+                                     ExportPageNumber::None,
+                                     QString()),
+                     ExportHTMLOption(true, true, false, false, true),
+                     ExportCustomOption());
+
+    VExporter exporter;
+    exporter.prepareExport(opt);
+
+    QString suffix = m_opt.m_exportPDF ? ".pdf" : ".html";
+    QDir notebookDir(p_notebook->getPath());
+    QDir outputDir(QDir(m_opt.m_exportFolder).filePath(p_notebook->getName()));
+
+    QVector<VDirectory *> dirs;
+    collectDirectories(p_notebook->getRootDir(), dirs);
+
+    QList<QString> filePaths;
+    for (auto dir : dirs) {
+        for (auto file : dir->getFiles()) {
+            filePaths.append(file->fetchPath());
+        }
+    }
+
+    int numOfDiagrams = exporter.prerenderDiagrams(filePaths, opt);
+    m_counts["diagrams"] = m_counts.value("diagrams").toInt() + numOfDiagrams;
+
+    bool ret = true;
+    int numOfExported = m_counts.value("exported").toInt();
+    for (auto dir : dirs) {
+        QList<VFile *> files;
+        for (auto file : dir->getFiles()) {
+            files.append(file);
+        }
+
+        if (files.isEmpty()) {
+            continue;
+        }
+
+        // Keep the folder structure of the notebook.
+        QString outputFolder = outputDir.filePath(notebookDir.relativeFilePath(dir->fetchPath()));
+        if (!VUtils::makePath(outputFolder)) {
+            m_errors.append(tr("Fail to create folder %1.").arg(outputFolder));
+            ret = false;
+            continue;
+        }
+
+        for (int i = 0; i < files.size(); ++i) {
+            // Keep the notes ahead rendering in parallel.
+            exporter.prefetch(files.mid(i), opt);
+
+            VFile *file = files[i];
+            QString output = QDir(outputFolder).filePath(QFileInfo(file->getName()).completeBaseName()
+                                                         + suffix);
+            QString msg;
+            bool succ = m_opt.m_exportPDF ? exporter.exportPDF(file, opt, output, &msg)
+                                          : exporter.exportHTML(file, opt, output, &msg);
+            if (succ) {
+                ++numOfExported;
+                qInfo() << "exported" << file->fetchPath() << "to" << output;
+            } else {
+                m_errors.append(tr("Fail to export %1 (%2).").arg(file->fetchPath()).arg(msg));
+                ret = false;
+            }
+        }
+    }
+
+    exporter.clearPrefetchedNotes();
+
+    m_counts["exported"] = numOfExported;
+    return ret;
+}
+
+bool VBatchRunner::searchNotebooks()
+{
+    int option = VSearchConfig::NoneOption;
+    if (m_opt.m_caseSensitive) {
+        option |= VSearchConfig::CaseSensitive;
+    }
+
+    if (m_opt.m_regularExpression) {
+        option |= VSearchConfig::RegularExpression;
+    }
+
+    if (m_opt.m_wholeWordOnly) {
+        option |= VSearchConfig::WholeWordOnly;
+    }
+
+    QSharedPointer<VSearchConfig> config(new VSearchConfig(VSearchConfig::AllNotebooks,
+                                                           VSearchConfig::Content,
+                                                           VSearchConfig::Note,
+                                                           VSearchConfig::Internal,
+                                                           option,
+                                                           m_opt.m_keyword,
+                                                           m_opt.m_pattern));
+
+    VSearch search;
+    search.setConfig(config);
+
+    auto addItem = [this](const QSharedPointer<VSearchResultItem> &p_item) {
+        QJsonArray matches;
+        for (auto const & sub : p_item->m_matches) {
+            QJsonObject match;
+            match["line"] = sub.m_lineNumber;
+            match["text"] = sub.m_text;
+            matches.append(match);
+        }
+
+        QJsonObject item;
+        item["path"] = p_item->m_path;
+        item["matches"] = matches;
+        m_results.append(item);
+    };
+
+    connect(&search, &VSearch::resultItemAdded,
+            this, addItem);
+    connect(&search, &VSearch::resultItemsAdded,
+            this, [addItem](const QList<QSharedPointer<VSearchResultItem> > &p_items) {
+                for (auto const & item : p_items) {
+                    addItem(item);
+                }
+            });
+
+    QSharedPointer<VSearchResult> result = search.search(m_notebooks);
+    if (result->m_state == VSearchState::Busy) {
+        QEventLoop loop;
+        connect(&search, &VSearch::finished,
+                &loop, [&loop, &result](const QSharedPointer<VSearchResult> &p_result) {
+                    result = p_result;
+                    loop.quit();
+                });
+        loop.exec();
+    }
+
+    search.clear();
+
+    m_counts["results"] = m_results.size();
+    m_counts["searched_files"] = result->m_nrSearchedFiles;
+
+    if (result->hasError()) {
+        m_errors.append(result->m_errMsg);
+    }
+
+    return result->m_state == VSearchState::Success;
+}
+
+bool VBatchRunner::dedupeImages()
+{
+    bool ret = true;
+    VImageDeduper::Result result;
+    for (auto nb : m_notebooks) {
+        QString msg;
+        if (!VImageDeduper::dedupe(nb, result, &msg)) {
+            m_errors.append(msg);
+            ret = false;
+        }
+    }
+
+    m_counts["images_removed"] = result.m_nrImagesRemoved;
+    m_counts["bytes_freed"] = (double)result.m_bytesFreed;
+    m_counts["notes_updated"] = result.m_nrNotesUpdated;
+
+    // Let the duplicates land in the recycle bins before exit.
+    VRecycleBin::flush();
+    return ret;
+}
+
+bool VBatchRunner::checkNotebooks()
+{
+    bool ret = true;
+    int nrNotes = 0;
+    int nrRecycled = 0;
+    for (auto nb : m_notebooks) {
+        VNotebookChecker checker(nb);
+        checker.start();
+        checker.wait();
+
+        if (!checker.getErrorMessage().isEmpty()) {
+            m_errors.append(checker.getErrorMessage());
+            ret = false;
+        }
+
+        nrNotes += checker.getNoteCount();
+        for (auto const & issue : checker.getIssues()) {
+            QString type = VNotebookChecker::typeToString(issue.m_type);
+            m_counts[type] = m_counts[type].toInt() + 1;
+
+            QJsonObject item;
+            item["type"] = type;
+            item["path"] = issue.m_path;
+            if (!issue.m_target.isEmpty()) {
+                item["target"] = issue.m_target;
+            }
+
+            m_results.append(item);
+        }
+
+        if (m_opt.m_clean) {
+            nrRecycled += checker.recycleOrphans(nb);
+        }
+    }
+
+    m_counts["notes"] = nrNotes;
+    if (m_opt.m_clean) {
+        m_counts["recycled"] = nrRecycled;
+
+        // Let the orphans land in the recycle bins before exit.
+        VRecycleBin::flush();
+    }
+
+    return ret;
+}
+
+bool VBatchRunner::writeResult(bool p_succeeded)
+{
+    QJsonObject json;
+    json["version"] = g_config->c_version;
+    switch (m_opt.m_command) {
+    case Command::Export:
+        json["command"] = "export";
+        break;
+
+    case Command::Search:
+        json["command"] = "search";
+        break;
+
+    case Command::DedupeImages:
+        json["command"] = "dedupe_images";
+        break;
+
+    case Command::Check:
+        json["command"] = "check";
+        break;
+    }
+    json["succeeded"] = p_succeeded;
+    json["counts"] = m_counts;
+    json["errors"] = m_errors;
+    if (m_opt.m_command == Command::Search || m_opt.m_command == Command::Check) {
+        json["results"] = m_results;
+    }
+
+    QByteArray data = QJsonDocument(json).toJson();
+    if (m_opt.m_outputFile.isEmpty()) {
+        fwrite(data.constData(), 1, data.size(), stdout);
+        fflush(stdout);
+        return true;
+    }
+
+    QFile file(m_opt.m_outputFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open batch output file" << m_opt.m_outputFile;
+        return false;
+    }
+
+    return file.write(data) == data.size();
+}
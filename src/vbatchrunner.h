@@ -0,0 +1,134 @@
+#ifndef VBATCHRUNNER_H
+#define VBATCHRUNNER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QPageLayout>
+#include <QVector>
+
+#include "utils/vwebutils.h"
+
+class VNotebook;
+class VDirectory;
+
+// Export notebooks or search their content without the main window, so it
+// could run on a server without a display.
+// The result is output in JSON.
+// Run via "VNote --batch [key=value ...]", see parseArguments().
+class VBatchRunner : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Command
+    {
+        Export,
+        Search,
+        DedupeImages,
+        Check
+    };
+
+    struct Option
+    {
+        Option()
+            : m_command(Command::Export),
+              m_exportPDF(false),
+              m_native(true),
+              m_caseSensitive(false),
+              m_regularExpression(false),
+              m_wholeWordOnly(false),
+              m_clean(false)
+        {
+        }
+
+        Command m_command;
+
+        // Folders of the notebooks. All the configured notebooks if empty.
+        QStringList m_notebooks;
+
+        // Export.
+        // Folder to export to.
+        QString m_exportFolder;
+
+        bool m_exportPDF;
+
+        // Export HTML via the native renderer without web views where possible.
+        bool m_native;
+
+        // Search.
+        QString m_keyword;
+
+        // Wildcard of the note names to search.
+        QString m_pattern;
+
+        bool m_caseSensitive;
+
+        bool m_regularExpression;
+
+        bool m_wholeWordOnly;
+
+        // Check.
+        // Move the orphan images and attachments into the recycle bins.
+        bool m_clean;
+
+        // File to write the result to. Standard output if empty.
+        QString m_outputFile;
+    };
+
+    explicit VBatchRunner(const Option &p_opt, QObject *p_parent = nullptr);
+
+    ~VBatchRunner();
+
+    // Whether @p_args ask for a batch run.
+    static bool isBatchMode(int p_argc, char *p_argv[]);
+
+    // Parse the options from arguments after "--batch":
+    // command=export|search|dedupe_images|check, notebook= (repeatable), output=;
+    // export: dir=, format=html|pdf, native=0|1;
+    // search: keyword=, pattern=, case=0|1, regex=0|1, whole_word=0|1;
+    // check: clean=0|1.
+    // Return false if the options are not valid.
+    static bool parseArguments(const QStringList &p_args, Option &p_opt);
+
+public slots:
+    // Run the command and emit finished().
+    void run();
+
+signals:
+    // @p_ret: 0 if the command succeeded.
+    void finished(int p_ret);
+
+private:
+    // Open the notebooks and all their folders.
+    bool openNotebooks();
+
+    bool exportNotebook(VNotebook *p_notebook);
+
+    bool searchNotebooks();
+
+    bool dedupeImages();
+
+    bool checkNotebooks();
+
+    bool writeResult(bool p_succeeded);
+
+    Option m_opt;
+
+    QVector<VNotebook *> m_notebooks;
+
+    QPageLayout m_pageLayout;
+
+    // Set as g_webUtils for the exporter since no main window is built.
+    VWebUtils m_webUtils;
+
+    QJsonObject m_counts;
+
+    QJsonArray m_errors;
+
+    // Search results or issues found by check.
+    QJsonArray m_results;
+};
+
+#endif // VBATCHRUNNER_H
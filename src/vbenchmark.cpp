@@ -0,0 +1,1216 @@
+#include "vbenchmark.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QImage>
+#include <QColor>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QTemporaryDir>
+#include <QJsonDocument>
+#include <QSharedPointer>
+#include <QScopedPointer>
+#include <QDirIterator>
+#include <QKeyEvent>
+#include <QTextBlock>
+#include <QTimer>
+#include <QApplication>
+#include <functional>
+#include <algorithm>
+#include <stdio.h>
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS) || defined(Q_OS_MAC)
+#include <sys/resource.h>
+#endif
+
+#include "vconfigmanager.h"
+#include "vnotebook.h"
+#include "vdirectory.h"
+#include "vnotefile.h"
+#include "vsearch.h"
+#include "vexporter.h"
+#include "utils/vutils.h"
+#include "pegparser.h"
+#include "pegmarkdownhighlighter.h"
+#include "vmainwindow.h"
+#include "veditarea.h"
+#include "vmdtab.h"
+#include "vmdeditor.h"
+#include "vtracer.h"
+#include "utils/vvim.h"
+
+extern VConfigManager *g_config;
+
+extern VMainWindow *g_mainWin;
+
+// Keyword planted in the generated notes to search for.
+static const QString c_keyword = "vnotebenchmark";
+
+static const char *c_words[] = {
+    "note", "markdown", "vim", "editor", "preview", "export", "image", "table",
+    "search", "folder", "notebook", "outline", "snippet", "attachment", "tag",
+    "theme", "render", "block", "code", "diagram", "formula", "magic", "word",
+    "history", "cart", "session", "template", "link", "heading", "list"
+};
+
+VBenchmark::VBenchmark(const Option &p_opt, QObject *p_parent)
+    : QObject(p_parent),
+      m_opt(p_opt),
+      m_pageLayout(QPageSize(QPageSize::A4),
+                   QPageLayout::Portrait,
+                   QMarginsF(10, 16, 10, 10),
+                   QPageLayout::Millimeter),
+      m_randomState(p_opt.m_seed)
+{
+}
+
+bool VBenchmark::parseArguments(const QStringList &p_args, Option &p_opt)
+{
+    int idx = p_args.indexOf("--benchmark");
+    if (idx == -1) {
+        return false;
+    }
+
+    for (int i = idx + 1; i < p_args.size(); ++i) {
+        const QString &arg = p_args[i];
+        int sep = arg.indexOf('=');
+        if (sep <= 0) {
+            qWarning() << "skip invalid benchmark argument" << arg;
+            continue;
+        }
+
+        QString key = arg.left(sep);
+        QString val = arg.mid(sep + 1);
+        if (key == "suite") {
+            if (val == "parser") {
+                p_opt.m_suite = Suite::Parser;
+            } else if (val == "notebook") {
+                p_opt.m_suite = Suite::Notebook;
+            } else if (val == "editor") {
+                p_opt.m_suite = Suite::Editor;
+            } else {
+                qWarning() << "skip unknown benchmark suite" << val;
+            }
+        } else if (key == "folders") {
+            p_opt.m_numOfFolders = qMax(1, val.toInt());
+        } else if (key == "notes") {
+            p_opt.m_numOfNotes = qMax(1, val.toInt());
+        } else if (key == "paragraphs") {
+            p_opt.m_numOfParagraphs = qMax(0, val.toInt());
+        } else if (key == "images") {
+            p_opt.m_numOfImages = qMax(0, val.toInt());
+        } else if (key == "code_blocks") {
+            p_opt.m_numOfCodeBlocks = qMax(0, val.toInt());
+        } else if (key == "diagrams") {
+            p_opt.m_numOfDiagrams = qMax(0, val.toInt());
+        } else if (key == "html") {
+            p_opt.m_exportHTML = val.toInt() != 0;
+        } else if (key == "pdf") {
+            p_opt.m_exportPDF = val.toInt() != 0;
+        } else if (key == "seed") {
+            p_opt.m_seed = val.toUInt();
+        } else if (key == "dir") {
+            p_opt.m_folder = val;
+        } else if (key == "output") {
+            p_opt.m_outputFile = val;
+        } else if (key == "corpus") {
+            p_opt.m_corpusFolder = val;
+        } else if (key == "parser_kb") {
+            p_opt.m_parserInputSize = qMax(1, val.toInt());
+        } else if (key == "iterations") {
+            p_opt.m_iterations = qMax(1, val.toInt());
+        } else if (key == "baseline") {
+            p_opt.m_baselineFile = val;
+        } else if (key == "threshold") {
+            p_opt.m_threshold = qBound(0, val.toInt(), 100);
+        } else if (key == "editor_kb") {
+            p_opt.m_editorSizes.clear();
+            for (auto const & sz : val.split(',', QString::SkipEmptyParts)) {
+                p_opt.m_editorSizes.append(qMax(1, sz.toInt()));
+            }
+        } else if (key == "mixes") {
+            p_opt.m_editorMixes = val.split(',', QString::SkipEmptyParts);
+        } else if (key == "keystrokes") {
+            p_opt.m_numOfKeystrokes = qMax(1, val.toInt());
+        } else if (key == "key_interval") {
+            p_opt.m_keyInterval = qMax(0, val.toInt());
+        } else if (key == "trace") {
+            p_opt.m_traceFile = val;
+        } else {
+            qWarning() << "skip unknown benchmark argument" << arg;
+        }
+    }
+
+    return true;
+}
+
+// Peak resident set size in KB of the process, or -1 if not supported.
+static long peakResidentSetSize()
+{
+#if defined(Q_OS_LINUX)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss;
+    }
+#elif defined(Q_OS_MACOS) || defined(Q_OS_MAC)
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // In bytes on macOS.
+        return usage.ru_maxrss / 1024;
+    }
+#endif
+
+    return -1;
+}
+
+int VBenchmark::random(int p_bound)
+{
+    // Linear congruential generator to be the same on all platforms.
+    m_randomState = m_randomState * 1103515245U + 12345U;
+    return (int)((m_randomState >> 16) % (uint)p_bound);
+}
+
+void VBenchmark::addTiming(const QString &p_name, qint64 p_ms)
+{
+    m_timings[p_name] = (double)p_ms;
+    qInfo() << "benchmark" << p_name << p_ms << "ms";
+}
+
+void VBenchmark::run()
+{
+    bool succeeded = false;
+    switch (m_opt.m_suite) {
+    case Suite::Parser:
+        succeeded = runParserSuite();
+        break;
+
+    case Suite::Editor:
+        succeeded = runEditorSuite();
+        break;
+
+    default:
+        succeeded = runNotebookSuite();
+        break;
+    }
+
+    if (!writeResult(succeeded)) {
+        succeeded = false;
+    }
+
+    emit finished(succeeded ? 0 : -1);
+}
+
+bool VBenchmark::runNotebookSuite()
+{
+    bool succeeded = true;
+    QElapsedTimer timer;
+
+    QTemporaryDir tmpDir;
+    QString folder = m_opt.m_folder;
+    if (folder.isEmpty()) {
+        if (!tmpDir.isValid()) {
+            qWarning() << "fail to create temporary directory for benchmark";
+            return false;
+        }
+
+        folder = tmpDir.path();
+    }
+
+    QString notebookPath = QDir(folder).filePath("notebook");
+    if (QFileInfo::exists(notebookPath)) {
+        qWarning() << "benchmark notebook already exists" << notebookPath;
+        return false;
+    }
+
+    timer.start();
+    if (!generateNotebook(notebookPath)) {
+        return false;
+    }
+
+    addTiming("generate_notebook", timer.elapsed());
+
+    VNotebook notebook("benchmark", notebookPath);
+
+    int numOfNotes = 0;
+    timer.start();
+    succeeded = openNotebook(&notebook, numOfNotes) && succeeded;
+    addTiming("open_notebook", timer.elapsed());
+    m_counts["notes"] = numOfNotes;
+
+    int numOfResults = 0;
+    timer.start();
+    succeeded = searchContent(&notebook, numOfResults) && succeeded;
+    addTiming("search_content", timer.elapsed());
+    m_counts["search_results"] = numOfResults;
+
+    if (m_opt.m_exportHTML) {
+        timer.start();
+        succeeded = exportNotebook(&notebook, false, QDir(folder).filePath("export_html"))
+                    && succeeded;
+        addTiming("export_html", timer.elapsed());
+    }
+
+    if (m_opt.m_exportPDF) {
+        timer.start();
+        succeeded = exportNotebook(&notebook, true, QDir(folder).filePath("export_pdf"))
+                    && succeeded;
+        addTiming("export_pdf", timer.elapsed());
+    }
+
+    notebook.close();
+
+    return succeeded;
+}
+
+bool VBenchmark::runParserSuite()
+{
+    QVector<ParserInput> inputs = generateParserInputs();
+    bool succeeded = collectCorpus(inputs);
+
+    QElapsedTimer timer;
+    timer.start();
+    for (auto const & input : inputs) {
+        benchmarkParser(input);
+    }
+
+    addTiming("parser_suite", timer.elapsed());
+    m_counts["parser_inputs"] = inputs.size();
+
+    long peakRSS = peakResidentSetSize();
+    if (peakRSS > 0) {
+        m_counts["peak_rss_kb"] = (double)peakRSS;
+    }
+
+    if (!m_opt.m_baselineFile.isEmpty()) {
+        succeeded = checkBaseline() && succeeded;
+    }
+
+    return succeeded;
+}
+
+QVector<VBenchmark::ParserInput> VBenchmark::generateParserInputs() const
+{
+    QVector<ParserInput> inputs;
+    const int size = m_opt.m_parserInputSize * 1024;
+
+    auto repeatTill = [size](const std::function<QString(int)> &p_func) {
+        QString text;
+        for (int i = 0; text.size() < size; ++i) {
+            text += p_func(i);
+        }
+
+        return text;
+    };
+
+    // Unclosed emphasis markers nested deeply cause heavy backtracking.
+    inputs.append({ "nested_emphasis", repeatTill([](int p_idx) {
+        QString line;
+        for (int i = 0; i < 32; ++i) {
+            line += (i % 2 ? "_" : "**") + QString("word%1 ").arg(p_idx);
+        }
+
+        return line + "\n\n";
+    }) });
+
+    inputs.append({ "long_table", "| a | b | c | d | e | f |\n|---|---|---|---|---|---|\n"
+                                  + repeatTill([](int p_idx) {
+        return QString("| %1 | *em* | `code` | [link](url) | **bold** | text |\n").arg(p_idx);
+    }) });
+
+    inputs.append({ "huge_code_fence", "```cpp\n" + repeatTill([](int p_idx) {
+        return QString("    int value_%1 = compute(*ptr, _x_, **pp); // [a](b)\n").arg(p_idx);
+    }) + "```\n" });
+
+    inputs.append({ "nested_blocks", repeatTill([](int p_idx) {
+        QString line;
+        for (int i = 0; i < p_idx % 16; ++i) {
+            line += i % 2 ? "> " : "  * ";
+        }
+
+        return line + QString("item %1 with [unclosed link(\n").arg(p_idx);
+    }) });
+
+    inputs.append({ "mixed_note", repeatTill([](int p_idx) {
+        return QString("## Section %1\n\nSome *text* with `code`, a [link](http://a.com) and "
+                       "![image](a.png).\n\n* list item\n* another **item**\n\n"
+                       "```\ncode line\n```\n\n").arg(p_idx);
+    }) });
+
+    return inputs;
+}
+
+bool VBenchmark::collectCorpus(QVector<ParserInput> &p_inputs) const
+{
+    if (m_opt.m_corpusFolder.isEmpty()) {
+        return true;
+    }
+
+    QDir dir(m_opt.m_corpusFolder);
+    if (!dir.exists()) {
+        qWarning() << "benchmark corpus folder does not exist" << m_opt.m_corpusFolder;
+        return false;
+    }
+
+    bool ret = true;
+    QDirIterator it(dir.absolutePath(),
+                    QStringList() << "*.md" << "*.markdown",
+                    QDir::Files,
+                    QDirIterator::Subdirectories);
+    QStringList files;
+    while (it.hasNext()) {
+        files.append(it.next());
+    }
+
+    // Keep the order stable across runs to compare with baselines.
+    files.sort();
+    for (auto const & file : files) {
+        QFile f(file);
+        if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
+            qWarning() << "fail to read benchmark corpus file" << file;
+            ret = false;
+            continue;
+        }
+
+        p_inputs.append({ "corpus/" + dir.relativeFilePath(file), QString::fromUtf8(f.readAll()) });
+    }
+
+    return ret;
+}
+
+void VBenchmark::benchmarkParser(const ParserInput &p_input)
+{
+    // Parse from the text like the highlighter to cover the parse in chunks.
+    QSharedPointer<PegParseConfig> config(new PegParseConfig());
+    config->m_text = p_input.m_text;
+    config->m_numOfBlocks = p_input.m_text.count('\n') + 1;
+    config->m_extensions = pmh_EXT_NOTES
+                           | pmh_EXT_STRIKE
+                           | pmh_EXT_FRONTMATTER
+                           | pmh_EXT_MARK
+                           | pmh_EXT_TABLE
+                           | pmh_EXT_MATH
+                           | pmh_EXT_MATH_RAW;
+
+    const int bytes = p_input.m_text.toUtf8().size();
+
+    qint64 bestParse = -1, bestRegions = -1;
+    size_t elementsSize = 0;
+    for (int i = 0; i < m_opt.m_iterations; ++i) {
+        // The parse keeps the encoded data in the config.
+        QSharedPointer<PegParseConfig> iterConfig(new PegParseConfig(*config));
+        QAtomicInt stop(0);
+        QSharedPointer<PegParseResult> result = PegParser::parseMarkdown(iterConfig, stop);
+
+        if (bestParse == -1 || result->m_parseTime < bestParse) {
+            bestParse = result->m_parseTime;
+        }
+
+        if (bestRegions == -1 || result->m_regionParseTime < bestRegions) {
+            bestRegions = result->m_regionParseTime;
+        }
+
+        size_t sz = pmh_arena_size(result->m_arena);
+        for (auto arena : result->m_chunkArenas) {
+            sz += pmh_arena_size(arena);
+        }
+
+        elementsSize = qMax(elementsSize, sz);
+    }
+
+    qint64 total = qMax(bestParse + bestRegions, (qint64)1);
+
+    QJsonObject obj;
+    obj["bytes"] = bytes;
+    obj["parse_ms"] = bestParse / 1000.0;
+    obj["regions_ms"] = bestRegions / 1000.0;
+    // Bytes per usec is MB/s.
+    obj["mb_per_s"] = (double)bytes / total;
+    obj["elements_kb"] = (double)(elementsSize / 1024);
+    m_parserResults[p_input.m_name] = obj;
+
+    qInfo() << "benchmark parser" << p_input.m_name << bytes << "bytes"
+            << obj["mb_per_s"].toDouble() << "MB/s";
+}
+
+// All the feature mixes of the editor suite.
+static const char *c_editorMixes[] = {
+    "prose", "tables", "code", "images", "math", "mixed"
+};
+
+// Msecs to wait for the highlight of a note after opening or typing.
+#define HIGHLIGHT_TIMEOUT 10000
+
+// Number of images shared by the notes of the editor suite.
+#define NUM_OF_EDITOR_IMAGES 8
+
+struct Keystroke
+{
+    int m_key;
+
+    QString m_text;
+};
+
+// Run the event loop for @p_msecs.
+static void waitFor(int p_msecs)
+{
+    QEventLoop loop;
+    QTimer::singleShot(p_msecs, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+// Run the event loop until @p_highlighter completes a highlight or
+// @p_timeout msecs pass.
+static bool waitForHighlight(PegMarkdownHighlighter *p_highlighter, int p_timeout)
+{
+    bool completed = false;
+    QEventLoop loop;
+    QObject::connect(p_highlighter, &PegMarkdownHighlighter::highlightCompleted,
+                     &loop, [&loop, &completed]() {
+                         completed = true;
+                         loop.quit();
+                     });
+    QTimer::singleShot(p_timeout, &loop, &QEventLoop::quit);
+    loop.exec();
+    return completed;
+}
+
+// Percentiles in msecs of @p_nsecs.
+static QJsonObject percentiles(QVector<qint64> p_nsecs)
+{
+    QJsonObject obj;
+    obj["samples"] = p_nsecs.size();
+    if (p_nsecs.isEmpty()) {
+        return obj;
+    }
+
+    std::sort(p_nsecs.begin(), p_nsecs.end());
+    auto at = [&p_nsecs](double p_ratio) {
+        int idx = qBound(0, (int)(p_ratio * p_nsecs.size() + 0.5) - 1, p_nsecs.size() - 1);
+        return p_nsecs[idx] / 1000000.0;
+    };
+
+    qint64 sum = 0;
+    for (auto ns : p_nsecs) {
+        sum += ns;
+    }
+
+    obj["mean"] = sum / 1000000.0 / p_nsecs.size();
+    obj["p50"] = at(0.5);
+    obj["p90"] = at(0.9);
+    obj["p99"] = at(0.99);
+    obj["max"] = p_nsecs.last() / 1000000.0;
+    return obj;
+}
+
+bool VBenchmark::runEditorSuite()
+{
+    if (!g_mainWin) {
+        qWarning() << "editor benchmark requires the main window";
+        return false;
+    }
+
+    QTemporaryDir tmpDir;
+    QString folder = m_opt.m_folder;
+    if (folder.isEmpty()) {
+        if (!tmpDir.isValid()) {
+            qWarning() << "fail to create temporary directory for benchmark";
+            return false;
+        }
+
+        folder = tmpDir.path();
+    }
+
+    QString notesFolder = QDir(folder).filePath("editor_notes");
+    QString imageFolder = QDir(notesFolder).filePath("images");
+    if (!VUtils::makePath(imageFolder)) {
+        qWarning() << "fail to create benchmark folder" << imageFolder;
+        return false;
+    }
+
+    for (int i = 0; i < NUM_OF_EDITOR_IMAGES; ++i) {
+        QImage image(640, 320, QImage::Format_RGB32);
+        image.fill(QColor::fromRgb(random(256), random(256), random(256)));
+        image.save(QDir(imageFolder).filePath(QString("image_%1.png").arg(i)));
+    }
+
+    QStringList mixes = m_opt.m_editorMixes;
+    if (mixes.isEmpty()) {
+        for (auto mix : c_editorMixes) {
+            mixes << mix;
+        }
+    }
+
+    // Editors paint only when visible.
+    g_mainWin->show();
+
+    if (!m_opt.m_traceFile.isEmpty()) {
+        VTracer::setEnabled(true);
+    }
+
+    bool succeeded = true;
+    QElapsedTimer timer;
+    timer.start();
+    for (auto size : m_opt.m_editorSizes) {
+        for (auto const & mix : mixes) {
+            QString name = QString("%1_%2kb").arg(mix).arg(size);
+            QString filePath = QDir(notesFolder).filePath(name + ".md");
+            QString content = generateEditorNote(mix, size * 1024, imageFolder);
+            if (content.isEmpty() || !VUtils::writeFileToDisk(filePath, content)) {
+                qWarning() << "fail to generate benchmark note" << filePath;
+                succeeded = false;
+                continue;
+            }
+
+            succeeded = benchmarkEditor(name, filePath) && succeeded;
+        }
+    }
+
+    addTiming("editor_suite", timer.elapsed());
+    m_counts["editor_notes"] = m_editorResults.size();
+
+    if (!m_opt.m_traceFile.isEmpty()) {
+        VTracer::setEnabled(false);
+        if (!VTracer::dump(m_opt.m_traceFile)) {
+            qWarning() << "fail to write benchmark trace file" << m_opt.m_traceFile;
+            succeeded = false;
+        }
+    }
+
+    if (!m_opt.m_baselineFile.isEmpty()) {
+        succeeded = checkBaseline() && succeeded;
+    }
+
+    return succeeded;
+}
+
+QString VBenchmark::generateEditorNote(const QString &p_mix,
+                                       int p_size,
+                                       const QString &p_imageFolder)
+{
+    const int numOfWords = sizeof(c_words) / sizeof(c_words[0]);
+    auto sentence = [this, numOfWords](int p_words) {
+        QString str;
+        for (int i = 0; i < p_words; ++i) {
+            if (i > 0) {
+                str += " ";
+            }
+
+            switch (random(12)) {
+            case 0:
+                str += QString("*%1*").arg(c_words[random(numOfWords)]);
+                break;
+
+            case 1:
+                str += QString("`%1`").arg(c_words[random(numOfWords)]);
+                break;
+
+            case 2:
+                str += QString("[%1](https://%1.com)").arg(c_words[random(numOfWords)]);
+                break;
+
+            default:
+                str += c_words[random(numOfWords)];
+                break;
+            }
+        }
+
+        return str;
+    };
+
+    QString imageFolderName = VUtils::directoryNameFromPath(p_imageFolder);
+    auto section = [&](const QString &p_kind, int p_idx) {
+        QString text = QString("## %1 %2\n\n").arg(sentence(3)).arg(p_idx);
+        if (p_kind == "tables") {
+            text += "| ID | Name | Type | Value | Note | Link |\n";
+            text += "|---|---|---|---|---|---|\n";
+            for (int i = 0; i < 20; ++i) {
+                text += QString("| %1 | **%2** | `%3` | %4 | %5 | [link](#%6) |\n")
+                          .arg(i)
+                          .arg(c_words[random(numOfWords)])
+                          .arg(c_words[random(numOfWords)])
+                          .arg(random(10000))
+                          .arg(sentence(4))
+                          .arg(c_words[random(numOfWords)]);
+            }
+
+            text += "\n";
+        } else if (p_kind == "code") {
+            text += "```cpp\n";
+            for (int i = 0; i < 30; ++i) {
+                text += QString("    int %1_%2 = compute(%3); // %4\n")
+                          .arg(c_words[random(numOfWords)])
+                          .arg(i)
+                          .arg(random(1000))
+                          .arg(sentence(4));
+            }
+
+            text += "```\n\n";
+        } else if (p_kind == "images") {
+            for (int i = 0; i < 3; ++i) {
+                text += sentence(30) + ".\n\n";
+                text += QString("![%1](%2/image_%3.png)\n\n").arg(sentence(2))
+                                                            .arg(imageFolderName)
+                                                            .arg(random(NUM_OF_EDITOR_IMAGES));
+            }
+        } else if (p_kind == "math") {
+            for (int i = 0; i < 3; ++i) {
+                text += sentence(20) + QString(" $a_%1^2 + b^2 = c^2$ ").arg(i) + sentence(10) + ".\n\n";
+                text += QString("$$\n\\sum_{i=0}^{%1} \\frac{x_i^2}{\\sqrt{%2 + y_i}} = \\int_0^1 f(t)\\,dt\n$$\n\n")
+                          .arg(random(100))
+                          .arg(random(100));
+            }
+        } else {
+            for (int i = 0; i < 4; ++i) {
+                text += sentence(40 + random(40)) + ".\n\n";
+            }
+        }
+
+        return text;
+    };
+
+    static const QStringList mixedKinds = { "prose", "tables", "code", "images", "math" };
+
+    QString content = QString("# Editor benchmark %1\n\n").arg(p_mix);
+    for (int i = 0; content.size() < p_size; ++i) {
+        if (p_mix == "mixed") {
+            content += section(mixedKinds[i % mixedKinds.size()], i);
+        } else {
+            // Some prose between the features like real notes.
+            content += section(i % 3 == 2 ? QString("prose") : p_mix, i);
+        }
+    }
+
+    return content;
+}
+
+bool VBenchmark::benchmarkEditor(const QString &p_name, const QString &p_filePath)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QVector<VFile *> files = g_mainWin->openFiles(QStringList(p_filePath),
+                                                  true,
+                                                  OpenFileMode::Edit,
+                                                  true);
+    VMdTab *tab = files.size() == 1 ? dynamic_cast<VMdTab *>(g_mainWin->getCurrentTab()) : NULL;
+    VMdEditor *editor = tab ? tab->getEditor() : NULL;
+    if (!editor) {
+        qWarning() << "fail to open benchmark note in editor" << p_filePath;
+        return false;
+    }
+
+    PegMarkdownHighlighter *highlighter = editor->getMarkdownHighlighter();
+    bool opened = waitForHighlight(highlighter, HIGHLIGHT_TIMEOUT);
+    qint64 openMs = timer.elapsed();
+
+    if (editor->getVim()) {
+        editor->getVim()->setMode(VimMode::Insert);
+    }
+
+    // Type in a new paragraph in the middle of the note.
+    QTextDocument *doc = editor->documentW();
+    QTextCursor cursor(doc->findBlockByNumber(doc->blockCount() / 2));
+    cursor.movePosition(QTextCursor::EndOfBlock);
+    editor->setTextCursorW(cursor);
+    editor->ensureCursorVisibleW();
+    waitFor(m_opt.m_keyInterval);
+
+    // The script of keystrokes.
+    const int numOfWords = sizeof(c_words) / sizeof(c_words[0]);
+    QVector<Keystroke> keys;
+    keys.append({ Qt::Key_Return, "\r" });
+    while (keys.size() < m_opt.m_numOfKeystrokes) {
+        int dice = random(20);
+        if (dice == 0) {
+            keys.append({ Qt::Key_Return, "\r" });
+        } else if (dice == 1) {
+            keys.append({ Qt::Key_Backspace, QString() });
+        } else {
+            for (auto ch : QString(c_words[random(numOfWords)])) {
+                keys.append({ Qt::Key_A + (ch.unicode() - 'a'), QString(ch) });
+            }
+
+            keys.append({ Qt::Key_Space, " " });
+        }
+    }
+
+    keys.resize(m_opt.m_numOfKeystrokes);
+
+    // Key event to the painted result.
+    QVector<qint64> inputNs;
+    // Key event to the painted highlight, if completed before next key.
+    QVector<qint64> highlightNs;
+
+    QElapsedTimer keyTimer;
+    bool waitingHighlight = false;
+    QMetaObject::Connection conn = connect(highlighter, &PegMarkdownHighlighter::visibleHighlightCompleted,
+                                           this, [&]() {
+                                               if (!waitingHighlight) {
+                                                   return;
+                                               }
+
+                                               waitingHighlight = false;
+                                               editor->viewport()->repaint();
+                                               highlightNs.append(keyTimer.nsecsElapsed());
+                                           });
+
+    QWidget *target = editor->getEditor();
+    for (auto const & ks : keys) {
+        QKeyEvent press(QEvent::KeyPress, ks.m_key, Qt::NoModifier, ks.m_text);
+        QKeyEvent release(QEvent::KeyRelease, ks.m_key, Qt::NoModifier, ks.m_text);
+
+        waitingHighlight = false;
+        keyTimer.start();
+        QApplication::sendEvent(target, &press);
+        editor->viewport()->repaint();
+        inputNs.append(keyTimer.nsecsElapsed());
+        QApplication::sendEvent(target, &release);
+
+        waitingHighlight = true;
+        waitFor(m_opt.m_keyInterval);
+    }
+
+    waitingHighlight = false;
+    disconnect(conn);
+
+    // Time for the highlight to catch up with the last keystroke.
+    timer.start();
+    bool settled = waitForHighlight(highlighter, HIGHLIGHT_TIMEOUT);
+    qint64 settleMs = timer.elapsed();
+
+    QJsonObject obj;
+    obj["chars"] = doc->characterCount();
+    obj["blocks"] = doc->blockCount();
+    obj["open_ms"] = opened ? (double)openMs : -1.0;
+    obj["settle_ms"] = settled ? (double)settleMs : -1.0;
+    obj["input_ms"] = percentiles(inputNs);
+    obj["highlight_ms"] = percentiles(highlightNs);
+    m_editorResults[p_name] = obj;
+
+    qInfo() << "benchmark editor" << p_name
+            << "input p90" << obj["input_ms"].toObject().value("p90").toDouble() << "ms"
+            << "highlight p90" << obj["highlight_ms"].toObject().value("p90").toDouble() << "ms";
+
+    // Discard the typed text.
+    g_mainWin->getEditArea()->closeFile(files[0], true);
+    return true;
+}
+
+bool VBenchmark::checkBaseline()
+{
+    QFile file(m_opt.m_baselineFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "fail to open benchmark baseline file" << m_opt.m_baselineFile;
+        return false;
+    }
+
+    QString key = m_opt.m_suite == Suite::Editor ? "editor" : "parser";
+    QJsonObject baseline = QJsonDocument::fromJson(file.readAll()).object().value(key).toObject();
+    if (baseline.isEmpty()) {
+        qWarning() << "no" << key << "results in benchmark baseline file" << m_opt.m_baselineFile;
+        return false;
+    }
+
+    if (m_opt.m_suite == Suite::Editor) {
+        checkEditorBaseline(baseline);
+        return m_regressions.isEmpty();
+    }
+
+    double ratio = 1 - m_opt.m_threshold / 100.0;
+    for (auto it = baseline.constBegin(); it != baseline.constEnd(); ++it) {
+        if (!m_parserResults.contains(it.key())) {
+            continue;
+        }
+
+        double base = it.value().toObject().value("mb_per_s").toDouble();
+        double cur = m_parserResults.value(it.key()).toObject().value("mb_per_s").toDouble();
+        if (cur < base * ratio) {
+            qWarning() << "benchmark parser regression" << it.key() << base << "->" << cur << "MB/s";
+
+            QJsonObject reg;
+            reg["input"] = it.key();
+            reg["baseline_mb_per_s"] = base;
+            reg["mb_per_s"] = cur;
+            m_regressions.append(reg);
+        }
+    }
+
+    return m_regressions.isEmpty();
+}
+
+void VBenchmark::checkEditorBaseline(const QJsonObject &p_baseline)
+{
+    static const char *metrics[] = { "input_ms", "highlight_ms" };
+
+    double ratio = 1 + m_opt.m_threshold / 100.0;
+    for (auto it = p_baseline.constBegin(); it != p_baseline.constEnd(); ++it) {
+        if (!m_editorResults.contains(it.key())) {
+            continue;
+        }
+
+        QJsonObject baseObj = it.value().toObject();
+        QJsonObject curObj = m_editorResults.value(it.key()).toObject();
+        for (auto metric : metrics) {
+            QJsonValue baseVal = baseObj.value(metric).toObject().value("p90");
+            QJsonValue curVal = curObj.value(metric).toObject().value("p90");
+            if (baseVal.isUndefined() || curVal.isUndefined()) {
+                continue;
+            }
+
+            // Ignore the jitter of sub-millisecond latencies.
+            double base = baseVal.toDouble();
+            double cur = curVal.toDouble();
+            if (cur > base * ratio && cur - base > 1) {
+                qWarning() << "benchmark editor regression" << it.key() << metric
+                           << base << "->" << cur << "ms";
+
+                QJsonObject reg;
+                reg["note"] = it.key();
+                reg["metric"] = QString(metric);
+                reg["baseline_p90_ms"] = base;
+                reg["p90_ms"] = cur;
+                m_regressions.append(reg);
+            }
+        }
+    }
+}
+
+bool VBenchmark::generateNotebook(const QString &p_folder)
+{
+    VNotebook *nb = VNotebook::createNotebook("benchmark", p_folder, false, "", "");
+    if (!nb) {
+        qWarning() << "fail to create benchmark notebook" << p_folder;
+        return false;
+    }
+
+    QScopedPointer<VNotebook> guard(nb);
+    if (!nb->open()) {
+        qWarning() << "fail to open benchmark notebook" << p_folder;
+        return false;
+    }
+
+    VDirectory *rootDir = nb->getRootDir();
+    for (int i = 0; i < m_opt.m_numOfFolders; ++i) {
+        VDirectory *dir = rootDir->createSubDirectory(QString("folder_%1").arg(i, 4, 10, QChar('0')));
+        if (!dir) {
+            qWarning() << "fail to create benchmark folder" << i;
+            return false;
+        }
+
+        for (int j = 0; j < m_opt.m_numOfNotes; ++j) {
+            QString name = QString("note_%1.md").arg(j, 5, 10, QChar('0'));
+            VNoteFile *file = dir->createFile(name, false);
+            if (!file) {
+                qWarning() << "fail to create benchmark note" << name;
+                return false;
+            }
+
+            QString content = generateNote(i, j, file->fetchImageFolderPath());
+            if (!VUtils::writeFileToDisk(file->fetchPath(), content)) {
+                return false;
+            }
+        }
+    }
+
+    nb->close();
+    return true;
+}
+
+QString VBenchmark::generateNote(int p_folderIdx, int p_noteIdx, const QString &p_imageFolder)
+{
+    const int numOfWords = sizeof(c_words) / sizeof(c_words[0]);
+    QString content = QString("# Note %1 of folder %2\n\n").arg(p_noteIdx).arg(p_folderIdx);
+
+    auto sentence = [this, numOfWords](int p_words) {
+        QString str;
+        for (int i = 0; i < p_words; ++i) {
+            if (i > 0) {
+                str += " ";
+            }
+
+            str += c_words[random(numOfWords)];
+        }
+
+        return str;
+    };
+
+    int numOfSections = qMax(1, m_opt.m_numOfCodeBlocks + m_opt.m_numOfImages + m_opt.m_numOfDiagrams);
+    int paragraphsPerSection = qMax(1, m_opt.m_numOfParagraphs / numOfSections);
+    int numOfImages = 0, numOfCodeBlocks = 0, numOfDiagrams = 0;
+    for (int sec = 0; sec < numOfSections; ++sec) {
+        content += QString("## %1\n\n").arg(sentence(3));
+
+        for (int i = 0; i < paragraphsPerSection; ++i) {
+            QString para = sentence(40 + random(40));
+            if (random(10) == 0) {
+                para += " " + c_keyword;
+            }
+
+            content += para + ".\n\n";
+        }
+
+        if (numOfImages < m_opt.m_numOfImages) {
+            QString imageName = QString("image_%1_%2_%3.png").arg(p_folderIdx)
+                                                             .arg(p_noteIdx)
+                                                             .arg(numOfImages);
+            QImage image(320, 240, QImage::Format_RGB32);
+            image.fill(QColor::fromRgb(random(256), random(256), random(256)));
+            VUtils::makePath(p_imageFolder);
+            if (image.save(QDir(p_imageFolder).filePath(imageName))) {
+                QString folderName = VUtils::directoryNameFromPath(p_imageFolder);
+                content += QString("![%1](%2/%3)\n\n").arg(sentence(2)).arg(folderName).arg(imageName);
+            }
+
+            ++numOfImages;
+        } else if (numOfCodeBlocks < m_opt.m_numOfCodeBlocks) {
+            content += "```cpp\n";
+            for (int i = 0; i < 20; ++i) {
+                content += QString("int %1_%2 = %3; // %4\n").arg(c_words[random(numOfWords)])
+                                                             .arg(i)
+                                                             .arg(random(1000))
+                                                             .arg(sentence(5));
+            }
+
+            content += "```\n\n";
+            ++numOfCodeBlocks;
+        } else if (numOfDiagrams < m_opt.m_numOfDiagrams) {
+            content += "```mermaid\ngraph TD;\n";
+            for (int i = 0; i < 8; ++i) {
+                content += QString("    A%1-->A%2;\n").arg(i).arg(random(8));
+            }
+
+            content += "```\n\n";
+            ++numOfDiagrams;
+        }
+    }
+
+    return content;
+}
+
+static void collectDirectories(VDirectory *p_dir, QVector<VDirectory *> &p_dirs)
+{
+    p_dirs.append(p_dir);
+    for (auto subDir : p_dir->getSubDirs()) {
+        collectDirectories(subDir, p_dirs);
+    }
+}
+
+bool VBenchmark::openNotebook(VNotebook *p_notebook, int &p_numOfNotes)
+{
+    p_numOfNotes = 0;
+    if (!p_notebook->open()) {
+        qWarning() << "fail to open benchmark notebook" << p_notebook->getPath();
+        return false;
+    }
+
+    // Open all the folders like expanding them in the directory tree.
+    QVector<VDirectory *> dirs;
+    dirs.append(p_notebook->getRootDir());
+    for (int i = 0; i < dirs.size(); ++i) {
+        VDirectory *dir = dirs[i];
+        if (!dir->open()) {
+            qWarning() << "fail to open benchmark folder" << dir->fetchPath();
+            return false;
+        }
+
+        p_numOfNotes += dir->getFiles().size();
+        for (auto subDir : dir->getSubDirs()) {
+            dirs.append(subDir);
+        }
+    }
+
+    return true;
+}
+
+bool VBenchmark::searchContent(VNotebook *p_notebook, int &p_numOfResults)
+{
+    p_numOfResults = 0;
+
+    VSearch search;
+    connect(&search, &VSearch::resultItemAdded,
+            this, [&p_numOfResults]() {
+                ++p_numOfResults;
+            });
+    connect(&search, &VSearch::resultItemsAdded,
+            this, [&p_numOfResults](const QList<QSharedPointer<VSearchResultItem> > &p_items) {
+                p_numOfResults += p_items.size();
+            });
+
+    QSharedPointer<VSearchConfig> config(new VSearchConfig(VSearchConfig::CurrentNotebook,
+                                                           VSearchConfig::Content,
+                                                           VSearchConfig::Note,
+                                                           VSearchConfig::Internal,
+                                                           VSearchConfig::NoneOption,
+                                                           c_keyword,
+                                                           QString()));
+    search.setConfig(config);
+
+    QVector<VNotebook *> notebooks;
+    notebooks.append(p_notebook);
+    QSharedPointer<VSearchResult> result = search.search(notebooks);
+    if (result->m_state == VSearchState::Busy) {
+        QEventLoop loop;
+        connect(&search, &VSearch::finished,
+                &loop, [&loop, &result](const QSharedPointer<VSearchResult> &p_result) {
+                    result = p_result;
+                    loop.quit();
+                });
+        loop.exec();
+    }
+
+    search.clear();
+
+    if (result->m_state != VSearchState::Success) {
+        qWarning() << "benchmark search failed" << result->toString();
+        return false;
+    }
+
+    return true;
+}
+
+bool VBenchmark::exportNotebook(VNotebook *p_notebook, bool p_pdf, const QString &p_outputFolder)
+{
+    ExportOption opt(ExportSource::CurrentNotebook,
+                     p_pdf ? ExportFormat::PDF : ExportFormat::HTML,
+                     g_config->getMdConverterType(),
+                     g_config->getCurRenderBackgroundColor(),
+                     g_config->getCssStyle(),
+                     g_config->getCodeBlockCssStyle(),
+                     true,
+                     false,
+                     ExportPDFOption(&m_pageLayout,
+                                     false,
+                                     QString(),
+                                     true,
+                                     false,
+                                     QString(),
+                                     QString(),
+                                     ExportPageNumber::None,
+                                     QString()),
+                     ExportHTMLOption(true, true, false, false, true),
+                     ExportCustomOption());
+
+    VExporter exporter;
+    exporter.prepareExport(opt);
+
+    QVector<VDirectory *> dirs;
+    collectDirectories(p_notebook->getRootDir(), dirs);
+
+    bool ret = true;
+    int numOfExported = 0;
+    for (auto dir : dirs) {
+        QList<VFile *> files;
+        for (auto file : dir->getFiles()) {
+            files.append(file);
+        }
+
+        if (files.isEmpty()) {
+            continue;
+        }
+
+        QString outputFolder = QDir(p_outputFolder).filePath(dir->getName());
+        VUtils::makePath(outputFolder);
+
+        exporter.prefetch(files.mid(0, g_config->getExportWebViews()), opt);
+        for (int i = 0; i < files.size(); ++i) {
+            VFile *file = files[i];
+            QString output = QDir(outputFolder).filePath(QFileInfo(file->getName()).completeBaseName()
+                                                         + (p_pdf ? ".pdf" : ".html"));
+            QString msg;
+            bool succ = p_pdf ? exporter.exportPDF(file, opt, output, &msg)
+                              : exporter.exportHTML(file, opt, output, &msg);
+            if (succ) {
+                ++numOfExported;
+            } else {
+                qWarning() << "benchmark fail to export" << file->fetchPath() << msg;
+                ret = false;
+            }
+
+            int next = i + g_config->getExportWebViews();
+            if (next < files.size()) {
+                exporter.prefetch(files.mid(next, 1), opt);
+            }
+        }
+    }
+
+    exporter.clearPrefetchedNotes();
+
+    m_counts[p_pdf ? "exported_pdf" : "exported_html"] = numOfExported;
+    return ret;
+}
+
+bool VBenchmark::writeResult(bool p_succeeded)
+{
+    QJsonObject options;
+    if (m_opt.m_suite == Suite::Parser) {
+        options["suite"] = "parser";
+        options["corpus"] = m_opt.m_corpusFolder;
+        options["parser_kb"] = m_opt.m_parserInputSize;
+        options["iterations"] = m_opt.m_iterations;
+        options["baseline"] = m_opt.m_baselineFile;
+        options["threshold"] = m_opt.m_threshold;
+    } else if (m_opt.m_suite == Suite::Editor) {
+        QStringList mixes = m_opt.m_editorMixes;
+        if (mixes.isEmpty()) {
+            for (auto mix : c_editorMixes) {
+                mixes << mix;
+            }
+        }
+
+        QJsonArray sizes;
+        for (auto size : m_opt.m_editorSizes) {
+            sizes.append(size);
+        }
+
+        options["suite"] = "editor";
+        options["editor_kb"] = sizes;
+        options["mixes"] = QJsonArray::fromStringList(mixes);
+        options["keystrokes"] = m_opt.m_numOfKeystrokes;
+        options["key_interval"] = m_opt.m_keyInterval;
+        options["trace"] = m_opt.m_traceFile;
+        options["baseline"] = m_opt.m_baselineFile;
+        options["threshold"] = m_opt.m_threshold;
+        options["seed"] = (double)m_opt.m_seed;
+    } else {
+        options["suite"] = "notebook";
+        options["folders"] = m_opt.m_numOfFolders;
+        options["notes"] = m_opt.m_numOfNotes;
+        options["paragraphs"] = m_opt.m_numOfParagraphs;
+        options["images"] = m_opt.m_numOfImages;
+        options["code_blocks"] = m_opt.m_numOfCodeBlocks;
+        options["diagrams"] = m_opt.m_numOfDiagrams;
+        options["html"] = m_opt.m_exportHTML;
+        options["pdf"] = m_opt.m_exportPDF;
+        options["seed"] = (double)m_opt.m_seed;
+    }
+
+    QJsonObject json;
+    json["version"] = g_config->c_version;
+    json["succeeded"] = p_succeeded;
+    json["options"] = options;
+    json["timings_ms"] = m_timings;
+    json["counts"] = m_counts;
+    if (m_opt.m_suite == Suite::Parser) {
+        json["parser"] = m_parserResults;
+        json["regressions"] = m_regressions;
+    } else if (m_opt.m_suite == Suite::Editor) {
+        json["editor"] = m_editorResults;
+        json["regressions"] = m_regressions;
+    }
+
+    QByteArray data = QJsonDocument(json).toJson();
+    if (m_opt.m_outputFile.isEmpty()) {
+        fwrite(data.constData(), 1, data.size(), stdout);
+        fflush(stdout);
+        return true;
+    }
+
+    QFile file(m_opt.m_outputFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open benchmark output file" << m_opt.m_outputFile;
+        return false;
+    }
+
+    return file.write(data) == data.size();
+}
@@ -0,0 +1,217 @@
+#ifndef VBENCHMARK_H
+#define VBENCHMARK_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QPageLayout>
+#include <QVector>
+
+class VNotebook;
+class VDirectory;
+
+// Benchmarks output in JSON:
+// - notebook suite: generate a synthetic notebook and time notebook open,
+//   content search and exports over it;
+// - parser suite: time the PEG parse and the region passes over generated
+//   adversarial inputs and a corpus of Markdown files, optionally checking the
+//   throughput against a baseline result for regressions;
+// - editor suite: open generated notes of several sizes and feature mixes in
+//   the Markdown editor, replay a scripted typing and report the percentiles
+//   of the latency from a key event to the painted result, and to the painted
+//   highlight, optionally checking them against a baseline result.
+// Run via "VNote --benchmark [key=value ...]", see parseArguments().
+class VBenchmark : public QObject
+{
+    Q_OBJECT
+public:
+    enum class Suite
+    {
+        Notebook,
+        Parser,
+        Editor
+    };
+
+    struct Option
+    {
+        Option()
+            : m_suite(Suite::Notebook),
+              m_numOfFolders(10),
+              m_numOfNotes(20),
+              m_numOfParagraphs(20),
+              m_numOfImages(1),
+              m_numOfCodeBlocks(2),
+              m_numOfDiagrams(0),
+              m_exportHTML(true),
+              m_exportPDF(false),
+              m_seed(1),
+              m_parserInputSize(256),
+              m_iterations(3),
+              m_threshold(20),
+              m_numOfKeystrokes(200),
+              m_keyInterval(100)
+        {
+            m_editorSizes << 64 << 512;
+        }
+
+        Suite m_suite;
+
+        // Number of folders in the notebook.
+        int m_numOfFolders;
+
+        // Number of notes in each folder.
+        int m_numOfNotes;
+
+        // Per note.
+        int m_numOfParagraphs;
+        int m_numOfImages;
+        int m_numOfCodeBlocks;
+        int m_numOfDiagrams;
+
+        bool m_exportHTML;
+
+        bool m_exportPDF;
+
+        // Seed of the generated content for reproducible notebooks.
+        uint m_seed;
+
+        // Folder to hold the notebook and exports. A temporary folder if empty.
+        QString m_folder;
+
+        // File to write the result to. Standard output if empty.
+        QString m_outputFile;
+
+        // Parser suite.
+        // Folder of Markdown files to parse besides the generated inputs.
+        QString m_corpusFolder;
+
+        // Size in KB of each generated input.
+        int m_parserInputSize;
+
+        // Times to parse each input. The best one is reported.
+        int m_iterations;
+
+        // Result of a previous run to compare the throughput with.
+        QString m_baselineFile;
+
+        // Max allowed decrease in percent of the throughput of any input
+        // against the baseline, or increase of the latency percentiles in
+        // editor suite.
+        int m_threshold;
+
+        // Editor suite.
+        // Size in KB of the generated notes.
+        QVector<int> m_editorSizes;
+
+        // Feature mixes of the generated notes. All if empty.
+        QStringList m_editorMixes;
+
+        // Keystrokes to replay in each note.
+        int m_numOfKeystrokes;
+
+        // Msecs between two keystrokes, during which the event loop runs.
+        int m_keyInterval;
+
+        // File to write the trace events of the editor suite to.
+        QString m_traceFile;
+    };
+
+    explicit VBenchmark(const Option &p_opt, QObject *p_parent = nullptr);
+
+    // Whether @p_args ask for a benchmark run and parse the options from
+    // arguments after "--benchmark":
+    // suite=notebook|parser|editor, output=;
+    // notebook suite: folders=, notes=, paragraphs=, images=, code_blocks=,
+    // diagrams=, html=0|1, pdf=0|1, seed=, dir=;
+    // parser suite: corpus=, parser_kb=, iterations=, baseline=, threshold=;
+    // editor suite: editor_kb= (comma separated), mixes= (comma separated of
+    // prose|tables|code|images|math|mixed), keystrokes=, key_interval=,
+    // trace=, baseline=, threshold=.
+    static bool parseArguments(const QStringList &p_args, Option &p_opt);
+
+public slots:
+    // Run the benchmark and emit finished().
+    void run();
+
+signals:
+    // @p_ret: 0 if all the steps succeeded.
+    void finished(int p_ret);
+
+private:
+    struct ParserInput
+    {
+        QString m_name;
+
+        QString m_text;
+    };
+
+    bool runNotebookSuite();
+
+    bool runParserSuite();
+
+    bool runEditorSuite();
+
+    // Generate a note of @p_mix of about @p_size chars, linking the images in
+    // @p_imageFolder.
+    QString generateEditorNote(const QString &p_mix,
+                               int p_size,
+                               const QString &p_imageFolder);
+
+    // Replay the keystrokes in note @p_filePath and add its result to
+    // m_editorResults.
+    bool benchmarkEditor(const QString &p_name, const QString &p_filePath);
+
+    QVector<ParserInput> generateParserInputs() const;
+
+    bool collectCorpus(QVector<ParserInput> &p_inputs) const;
+
+    // Parse @p_input and add its result to m_parserResults.
+    void benchmarkParser(const ParserInput &p_input);
+
+    // Check m_parserResults or m_editorResults against the baseline and fill
+    // m_regressions.
+    bool checkBaseline();
+
+    // A note regresses if p90 of its input or highlight latency grows.
+    void checkEditorBaseline(const QJsonObject &p_baseline);
+
+    // Create a notebook at @p_folder with notes of the options.
+    bool generateNotebook(const QString &p_folder);
+
+    QString generateNote(int p_folderIdx, int p_noteIdx, const QString &p_imageFolder);
+
+    bool openNotebook(VNotebook *p_notebook, int &p_numOfNotes);
+
+    bool searchContent(VNotebook *p_notebook, int &p_numOfResults);
+
+    bool exportNotebook(VNotebook *p_notebook, bool p_pdf, const QString &p_outputFolder);
+
+    void addTiming(const QString &p_name, qint64 p_ms);
+
+    bool writeResult(bool p_succeeded);
+
+    // Random number in [0, @p_bound) of the generated content.
+    int random(int p_bound);
+
+    Option m_opt;
+
+    QJsonObject m_timings;
+
+    QJsonObject m_counts;
+
+    // Input name -> result of the parser suite.
+    QJsonObject m_parserResults;
+
+    // Note name -> result of the editor suite.
+    QJsonObject m_editorResults;
+
+    QJsonArray m_regressions;
+
+    QPageLayout m_pageLayout;
+
+    uint m_randomState;
+};
+
+#endif // VBENCHMARK_H
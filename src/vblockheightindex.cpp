@@ -0,0 +1,105 @@
+#include "vblockheightindex.h"
+
+VBlockHeightIndex::VBlockHeightIndex()
+    : m_topStep(0)
+{
+}
+
+void VBlockHeightIndex::clear()
+{
+    m_heights.clear();
+    m_tree.clear();
+    m_topStep = 0;
+}
+
+void VBlockHeightIndex::reset(const QVector<qreal> &p_heights)
+{
+    m_heights = p_heights;
+    rebuildTree();
+}
+
+void VBlockHeightIndex::rebuildTree()
+{
+    const int n = m_heights.size();
+    m_tree.fill(0, n + 1);
+    for (int i = 1; i <= n; ++i) {
+        m_tree[i] += m_heights[i - 1];
+        int parent = i + (i & -i);
+        if (parent <= n) {
+            m_tree[parent] += m_tree[i];
+        }
+    }
+
+    m_topStep = 1;
+    while (m_topStep * 2 <= n) {
+        m_topStep *= 2;
+    }
+
+    if (n == 0) {
+        m_topStep = 0;
+    }
+}
+
+void VBlockHeightIndex::setHeight(int p_index, qreal p_height)
+{
+    Q_ASSERT(p_index >= 0 && p_index < m_heights.size());
+    qreal delta = p_height - m_heights[p_index];
+    if (delta == 0) {
+        return;
+    }
+
+    m_heights[p_index] = p_height;
+    const int n = m_heights.size();
+    for (int i = p_index + 1; i <= n; i += (i & -i)) {
+        m_tree[i] += delta;
+    }
+}
+
+void VBlockHeightIndex::replace(int p_index, int p_removed, const QVector<qreal> &p_heights)
+{
+    Q_ASSERT(p_index >= 0 && p_removed >= 0 && p_index + p_removed <= m_heights.size());
+    if (p_removed == p_heights.size()) {
+        for (int i = 0; i < p_heights.size(); ++i) {
+            setHeight(p_index + i, p_heights[i]);
+        }
+
+        return;
+    }
+
+    QVector<qreal> heights;
+    heights.reserve(m_heights.size() - p_removed + p_heights.size());
+    heights += m_heights.mid(0, p_index);
+    heights += p_heights;
+    heights += m_heights.mid(p_index + p_removed);
+
+    m_heights = heights;
+    rebuildTree();
+}
+
+qreal VBlockHeightIndex::offset(int p_index) const
+{
+    Q_ASSERT(p_index >= 0 && p_index <= m_heights.size());
+    qreal sum = 0;
+    for (int i = p_index; i > 0; i -= (i & -i)) {
+        sum += m_tree[i];
+    }
+
+    return sum;
+}
+
+int VBlockHeightIndex::findIndex(qreal p_y) const
+{
+    // Find the largest count of leading heights whose sum <= @p_y.
+    const int n = m_heights.size();
+    int pos = 0;
+    qreal rem = p_y;
+    for (int step = m_topStep; step > 0; step >>= 1) {
+        int next = pos + step;
+        if (next <= n && m_tree[next] <= rem) {
+            pos = next;
+            rem -= m_tree[next];
+        }
+    }
+
+    return pos;
+}
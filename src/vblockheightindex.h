@@ -0,0 +1,65 @@
+#ifndef VBLOCKHEIGHTINDEX_H
+#define VBLOCKHEIGHTINDEX_H
+
+#include <QVector>
+
+// Heights of blocks indexed by block number, with a Fenwick tree to get the
+// offset of a block and the block at an offset in O(log n).
+class VBlockHeightIndex
+{
+public:
+    VBlockHeightIndex();
+
+    void clear();
+
+    int size() const;
+
+    // Rebuild the index with @p_heights in O(n).
+    void reset(const QVector<qreal> &p_heights);
+
+    qreal height(int p_index) const;
+
+    // Update the height of @p_index in O(log n).
+    void setHeight(int p_index, qreal p_height);
+
+    // Replace @p_removed heights from @p_index with @p_heights.
+    // O(log n) per height if the size does not change, otherwise O(n).
+    void replace(int p_index, int p_removed, const QVector<qreal> &p_heights);
+
+    // Sum of the heights of [0, @p_index).
+    qreal offset(int p_index) const;
+
+    // Sum of all the heights.
+    qreal total() const;
+
+    // Returns the index whose range [offset, offset + height) contains @p_y.
+    // Returns 0 if @p_y is negative and size() if @p_y exceeds total().
+    int findIndex(qreal p_y) const;
+
+private:
+    void rebuildTree();
+
+    QVector<qreal> m_heights;
+
+    // 1-based Fenwick tree of m_heights.
+    QVector<qreal> m_tree;
+
+    // Highest power of 2 not greater than the size.
+    int m_topStep;
+};
+
+inline int VBlockHeightIndex::size() const
+{
+    return m_heights.size();
+}
+
+inline qreal VBlockHeightIndex::height(int p_index) const
+{
+    return m_heights[p_index];
+}
+
+inline qreal VBlockHeightIndex::total() const
+{
+    return offset(m_heights.size());
+}
+#endif // VBLOCKHEIGHTINDEX_H
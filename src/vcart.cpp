@@ -14,6 +14,16 @@ extern VMainWindow *g_mainWin;
 
 extern VNote *g_vnote;
 
+// Key of @p_path in the path set, following VUtils::equalPath().
+static QString pathKey(const QString &p_path)
+{
+#if defined(Q_OS_WIN)
+    return QDir::cleanPath(p_path).toLower();
+#else
+    return QDir::cleanPath(p_path);
+#endif
+}
+
 VCart::VCart(QWidget *p_parent)
     : QWidget(p_parent),
       m_initialized(false),
@@ -44,8 +54,7 @@ void VCart::setupUI()
                                                   g_mainWin,
                                                   MessageBoxType::Danger);
                     if (ret == QMessageBox::Ok) {
-                        m_itemList->clearAll();
-                        updateNumberLabel();
+                        clearItems();
                     }
                 }
             });
@@ -132,24 +141,38 @@ void VCart::addFile(const QString &p_filePath)
     init();
 
     if (p_filePath.isEmpty()
-        || findFileInCart(p_filePath) != -1) {
+        || isFileInCart(p_filePath)) {
         return;
     }
 
     addItem(p_filePath);
+    updateNumberLabel();
 }
 
-int VCart::findFileInCart(const QString &p_file) const
+int VCart::addFiles(const QStringList &p_files)
 {
-    int cnt = m_itemList->count();
-    for (int i = 0; i < cnt; ++i) {
-        if (VUtils::equalPath(m_itemList->item(i)->data(Qt::UserRole).toString(),
-                              p_file)) {
-            return i;
+    init();
+
+    int nrAdded = 0;
+    m_itemList->setUpdatesEnabled(false);
+    for (auto const & file : p_files) {
+        if (file.isEmpty() || isFileInCart(file)) {
+            continue;
         }
+
+        addItem(file);
+        ++nrAdded;
     }
 
-    return -1;
+    m_itemList->setUpdatesEnabled(true);
+
+    updateNumberLabel();
+    return nrAdded;
+}
+
+bool VCart::isFileInCart(const QString &p_file) const
+{
+    return m_pathKeys.contains(pathKey(p_file));
 }
 
 void VCart::addItem(const QString &p_path)
@@ -159,6 +182,19 @@ void VCart::addItem(const QString &p_path)
     item->setData(Qt::UserRole, p_path);
 
     m_itemList->addItem(item);
+    m_pathKeys.insert(pathKey(p_path));
+}
+
+void VCart::removeItem(QListWidgetItem *p_item)
+{
+    m_pathKeys.remove(pathKey(getFilePath(p_item)));
+    delete p_item;
+}
+
+void VCart::clearItems()
+{
+    m_itemList->clearAll();
+    m_pathKeys.clear();
     updateNumberLabel();
 }
 
@@ -166,8 +202,10 @@ void VCart::deleteSelectedItems()
 {
     QList<QListWidgetItem *> selectedItems = m_itemList->selectedItems();
     for (auto it : selectedItems) {
-        delete it;
+        removeItem(it);
     }
+
+    updateNumberLabel();
 }
 
 void VCart::openSelectedItems() const
@@ -3,6 +3,7 @@
 
 #include <QWidget>
 #include <QVector>
+#include <QSet>
 
 #include "vnavigationmode.h"
 
@@ -19,6 +20,10 @@ public:
 
     void addFile(const QString &p_filePath);
 
+    // Add @p_files in one batch, skipping the ones already in Cart.
+    // Return the number of files added.
+    int addFiles(const QStringList &p_files);
+
     int count() const;
 
     QVector<QString> getFiles() const;
@@ -54,11 +59,14 @@ private:
 
     bool m_uiInitialized;
 
-    // Return index of item.
-    int findFileInCart(const QString &p_file) const;
+    bool isFileInCart(const QString &p_file) const;
 
     void addItem(const QString &p_path);
 
+    void removeItem(QListWidgetItem *p_item);
+
+    void clearItems();
+
     QString getFilePath(const QListWidgetItem *p_item) const;
 
     void updateNumberLabel() const;
@@ -66,6 +74,9 @@ private:
     QPushButton *m_clearBtn;
     QLabel *m_numLabel;
     VListWidget *m_itemList;
+
+    // Keys of the paths in m_itemList to check duplicates.
+    QSet<QString> m_pathKeys;
 };
 
 #endif // VCART_H
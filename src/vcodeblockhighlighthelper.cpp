@@ -2,10 +2,79 @@
 
 #include <QDebug>
 #include <QStringList>
+#include <QRunnable>
+#include <QCryptographicHash>
+#include <QThread>
 
 #include "vdocument.h"
 #include "utils/vutils.h"
 #include "pegmarkdownhighlighter.h"
+#include "vcodeblocktokenizer.h"
+#include "vcodeblockstyletable.h"
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Skip native highlight of huge code blocks.
+#define MAX_NATIVE_CODE_BLOCK_SIZE (256 * 1024)
+
+// Max number of highlight units in the cache.
+#define MAX_CACHED_UNITS 200000
+
+// Send the request of a code block again if its result does not come back
+// within this number of timestamps, such as after the web side is reloaded.
+#define MAX_REQUEST_TIMESTAMP_SPAN 10
+
+// Max number of threads to tokenize code blocks natively.
+#define MAX_NATIVE_HIGHLIGHT_THREADS 4
+
+// Tokenize code blocks one by one in the pool until cancelled.
+class CodeBlockTokenizeTask : public QRunnable
+{
+public:
+    struct Item
+    {
+        QByteArray m_key;
+
+        QString m_lang;
+
+        QString m_text;
+    };
+
+    CodeBlockTokenizeTask(VCodeBlockHighlightHelper *p_helper,
+                          const QSharedPointer<QAtomicInt> &p_cancelled,
+                          const QVector<Item> &p_items)
+        : m_helper(p_helper),
+          m_cancelled(p_cancelled),
+          m_items(p_items)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        for (auto const & item : m_items) {
+            if (m_cancelled->load()) {
+                return;
+            }
+
+            QVector<HLUnitPos> units = VCodeBlockTokenizer::tokenize(item.m_lang, item.m_text);
+
+            // The helper waits for all the tasks before destruction.
+            QMetaObject::invokeMethod(m_helper,
+                                      "handleNativeHighlightResult",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(QByteArray, item.m_key),
+                                      Q_ARG(QVector<HLUnitPos>, units));
+        }
+    }
+
+private:
+    VCodeBlockHighlightHelper *m_helper;
+
+    QSharedPointer<QAtomicInt> m_cancelled;
+
+    QVector<Item> m_items;
+};
 
 VCodeBlockHighlightHelper::VCodeBlockHighlightHelper(PegMarkdownHighlighter *p_highlighter,
                                                      VDocument *p_vdoc,
@@ -14,18 +83,42 @@ VCodeBlockHighlightHelper::VCodeBlockHighlightHelper(PegMarkdownHighlighter *p_h
       m_highlighter(p_highlighter),
       m_vdocument(p_vdoc),
       m_type(p_type),
-      m_timeStamp(0)
+      m_timeStamp(0),
+      m_cache(MAX_CACHED_UNITS),
+      m_nextRequestId(0),
+      m_cancelled(new QAtomicInt(0)),
+      m_enabled(true)
 {
+    qRegisterMetaType<QVector<HLUnitPos>>("QVector<HLUnitPos>");
+
+    m_pool.setMaxThreadCount(qBound(1,
+                                    QThread::idealThreadCount() / 2,
+                                    MAX_NATIVE_HIGHLIGHT_THREADS));
+
     connect(m_highlighter, &PegMarkdownHighlighter::codeBlocksUpdated,
             this, &VCodeBlockHighlightHelper::handleCodeBlocksUpdated);
     connect(m_vdocument, &VDocument::textHighlighted,
             this, &VCodeBlockHighlightHelper::handleTextHighlightResult);
 
     // Web side is ready for code block highlight.
+    // Drop the requests sent before the reload prior to the new update.
+    connect(m_vdocument, &VDocument::readyToHighlightText,
+            this, &VCodeBlockHighlightHelper::handleWebReady);
     connect(m_vdocument, &VDocument::readyToHighlightText,
             m_highlighter, &PegMarkdownHighlighter::updateHighlight);
 }
 
+VCodeBlockHighlightHelper::~VCodeBlockHighlightHelper()
+{
+    m_cancelled->store(1);
+
+    m_pool.clear();
+    m_pool.waitForDone();
+
+    // Results of the web side are not connected any more.
+    m_webRequests.clear();
+}
+
 QString VCodeBlockHighlightHelper::unindentCodeBlock(const QString &p_text)
 {
     if (p_text.isEmpty()) {
@@ -59,46 +152,180 @@ QString VCodeBlockHighlightHelper::unindentCodeBlock(const QString &p_text)
     return res;
 }
 
+QByteArray VCodeBlockHighlightHelper::cacheKey(const VCodeBlock &p_block)
+{
+    // The units are relative to the raw text, so the indentation counts.
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(p_block.m_lang.toUtf8());
+    hash.addData("\n", 1);
+    hash.addData(reinterpret_cast<const char *>(p_block.m_text.constData()),
+                 p_block.m_text.size() * sizeof(QChar));
+    return hash.result();
+}
+
 void VCodeBlockHighlightHelper::handleCodeBlocksUpdated(TimeStamp p_timeStamp,
                                                         const QVector<VCodeBlock> &p_codeBlocks)
 {
-    if (!m_vdocument->isReadyToHighlight()) {
-        // Immediately return empty results.
-        QVector<HLUnitPos> emptyRes;
-        for (int i = 0; i < p_codeBlocks.size(); ++i) {
-            updateHighlightResults(p_timeStamp, 0, emptyRes);
-        }
-
-        return;
-    }
-
     m_timeStamp = p_timeStamp;
     m_codeBlocks = p_codeBlocks;
+    m_waiting.clear();
+
+    // Blocks of previous updates may be gone. Those still here are sent again.
+    cancelNativeHighlight();
+    removeStaleWebRequests(p_timeStamp);
+
+    bool webReady = m_vdocument->isReadyToHighlight();
+    bool native = g_config->getEnableNativeCodeBlockHighlight();
+    QVector<CodeBlockTokenizeTask::Item> nativeItems;
     for (int i = 0; i < m_codeBlocks.size(); ++i) {
+        if (!m_enabled) {
+            // The highlighter still waits for a result of each code block.
+            updateHighlightResults(p_timeStamp, 0, QVector<HLUnitPos>());
+            continue;
+        }
+
         const VCodeBlock &block = m_codeBlocks[i];
-        auto it = m_cache.find(block.m_text);
-        if (it != m_cache.end()) {
-            // Hit cache.
+        QByteArray key = cacheKey(block);
+        const QVector<HLUnitPos> *units = m_cache.object(key);
+        if (units) {
+            // Hit cache. Just rebase it to the new position.
             qDebug() << "code block highlight hit cache" << p_timeStamp << i;
-            it.value().m_timeStamp = p_timeStamp;
-            updateHighlightResults(p_timeStamp, block.m_startPos, it.value().m_units);
-        } else {
+            updateHighlightResults(p_timeStamp, block.m_startPos, *units);
+            continue;
+        }
+
+        auto it = m_inProgress.find(key);
+        if (it != m_inProgress.end()
+            && p_timeStamp - it.value() <= MAX_REQUEST_TIMESTAMP_SPAN) {
+            m_waiting[key].append(i);
+            continue;
+        }
+
+        if (native
+            && block.m_text.size() <= MAX_NATIVE_CODE_BLOCK_SIZE
+            && VCodeBlockTokenizer::isSupported(block.m_lang)) {
+            CodeBlockTokenizeTask::Item item;
+            item.m_key = key;
+            item.m_lang = block.m_lang;
+            item.m_text = block.m_text;
+            nativeItems.append(item);
+            m_nativeKeys.insert(key);
+        } else if (webReady) {
+            int id = ++m_nextRequestId;
+            WebRequest &req = m_webRequests[id];
+            req.m_key = key;
+            req.m_text = block.m_text;
+            req.m_timeStamp = p_timeStamp;
+
             QString unindentedText = unindentCodeBlock(block.m_text);
-            m_vdocument->highlightTextAsync(unindentedText, i, p_timeStamp);
+            m_vdocument->highlightTextAsync(unindentedText, id, p_timeStamp);
+        } else {
+            // Immediately return empty results.
+            updateHighlightResults(p_timeStamp, 0, QVector<HLUnitPos>());
+            continue;
         }
+
+        m_inProgress.insert(key, p_timeStamp);
+        m_waiting[key].append(i);
+    }
+
+    // Split the items among the threads.
+    int nrTasks = qMin(m_pool.maxThreadCount(), nativeItems.size());
+    for (int i = 0; i < nrTasks; ++i) {
+        QVector<CodeBlockTokenizeTask::Item> items;
+        for (int j = i; j < nativeItems.size(); j += nrTasks) {
+            items.append(nativeItems[j]);
+        }
+
+        m_pool.start(new CodeBlockTokenizeTask(this, m_cancelled, items));
     }
 }
 
+void VCodeBlockHighlightHelper::cancelNativeHighlight()
+{
+    if (m_nativeKeys.isEmpty()) {
+        return;
+    }
+
+    // Tasks in progress return after the current code block.
+    m_cancelled->store(1);
+    m_cancelled.reset(new QAtomicInt(0));
+    m_pool.clear();
+
+    for (auto const & key : m_nativeKeys) {
+        m_inProgress.remove(key);
+    }
+
+    m_nativeKeys.clear();
+}
+
+void VCodeBlockHighlightHelper::removeStaleWebRequests(TimeStamp p_timeStamp)
+{
+    for (auto it = m_webRequests.begin(); it != m_webRequests.end();) {
+        if (p_timeStamp - it->m_timeStamp > MAX_REQUEST_TIMESTAMP_SPAN) {
+            // Unless it is sent again later.
+            auto pit = m_inProgress.find(it->m_key);
+            if (pit != m_inProgress.end() && pit.value() == it->m_timeStamp) {
+                m_inProgress.erase(pit);
+            }
+
+            it = m_webRequests.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void VCodeBlockHighlightHelper::handleWebReady()
+{
+    for (auto const & req : m_webRequests) {
+        m_inProgress.remove(req.m_key);
+    }
+
+    m_webRequests.clear();
+}
+
+void VCodeBlockHighlightHelper::handleNativeHighlightResult(const QByteArray &p_key,
+                                                            const QVector<HLUnitPos> &p_units)
+{
+    finishHighlight(p_key, p_units);
+}
+
 void VCodeBlockHighlightHelper::handleTextHighlightResult(const QString &p_html,
                                                           int p_id,
                                                           unsigned long long p_timeStamp)
 {
-    // Abandon obsolete result.
-    if (m_timeStamp != p_timeStamp) {
+    Q_UNUSED(p_timeStamp);
+
+    // Results of previous timestamps are still good for the same content.
+    auto it = m_webRequests.find(p_id);
+    if (it == m_webRequests.end()) {
         return;
     }
 
-    parseHighlightResult(p_timeStamp, p_id, p_html);
+    WebRequest req = it.value();
+    m_webRequests.erase(it);
+
+    QVector<HLUnitPos> units;
+    if (!parseHighlightResult(req.m_text, p_html, units)) {
+        qWarning() << "fail to parse highlighted result" << "id:" << p_id << p_html;
+        units.clear();
+    }
+
+    finishHighlight(req.m_key, units);
+}
+
+void VCodeBlockHighlightHelper::finishHighlight(const QByteArray &p_key,
+                                                const QVector<HLUnitPos> &p_units)
+{
+    m_inProgress.remove(p_key);
+    m_nativeKeys.remove(p_key);
+    m_cache.insert(p_key, new QVector<HLUnitPos>(p_units), p_units.size() + 1);
+
+    const QVector<int> blocks = m_waiting.take(p_key);
+    for (int idx : blocks) {
+        updateHighlightResults(m_timeStamp, m_codeBlocks[idx].m_startPos, p_units);
+    }
 }
 
 static void revertEscapedHtml(QString &p_html)
@@ -140,23 +367,17 @@ static void matchTokenRelaxed(const QString &p_text, const QString &p_tokenStr,
 }
 
 // For now, we could only handle code blocks outside the list.
-void VCodeBlockHighlightHelper::parseHighlightResult(TimeStamp p_timeStamp,
-                                                     int p_idx,
-                                                     const QString &p_html)
+bool VCodeBlockHighlightHelper::parseHighlightResult(const QString &p_text,
+                                                     const QString &p_html,
+                                                     QVector<HLUnitPos> &p_units)
 {
-    const VCodeBlock &block = m_codeBlocks.at(p_idx);
-    int startPos = block.m_startPos;
-    QString text = block.m_text;
-
-    QVector<HLUnitPos> hlUnits;
-
     bool failed = true;
 
     QXmlStreamReader xml(p_html);
 
     // Must have a fenced line at the front.
     // textIndex is the start index in the code block text to search for.
-    int textIndex = text.indexOf('\n');
+    int textIndex = p_text.indexOf('\n');
     if (textIndex == -1) {
         goto exit;
     }
@@ -182,7 +403,7 @@ void VCodeBlockHighlightHelper::parseHighlightResult(TimeStamp p_timeStamp,
                 revertEscapedHtml(tokenStr);
 
                 int start, end;
-                matchTokenRelaxed(text, tokenStr, textIndex, start, end);
+                matchTokenRelaxed(p_text, tokenStr, textIndex, start, end);
                 if (start == -1) {
                     failed = true;
                     goto exit;
@@ -192,7 +413,7 @@ void VCodeBlockHighlightHelper::parseHighlightResult(TimeStamp p_timeStamp,
                     failed = true;
                     goto exit;
                 }
-                if (!parseSpanElement(xml, text, textIndex, hlUnits)) {
+                if (!parseSpanElement(xml, p_text, textIndex, p_units)) {
                     failed = true;
                     goto exit;
                 }
@@ -211,22 +432,7 @@ void VCodeBlockHighlightHelper::parseHighlightResult(TimeStamp p_timeStamp,
     }
 
 exit:
-    // Pass result back to highlighter.
-    // Abandon obsolete result.
-    if (m_timeStamp != p_timeStamp) {
-        return;
-    }
-
-    if (xml.hasError() || failed) {
-        qWarning() << "fail to parse highlighted result"
-                   << "stamp:" << p_timeStamp << "index:" << p_idx << p_html;
-        hlUnits.clear();
-    }
-
-    // Add it to cache.
-    addToHighlightCache(text, p_timeStamp, hlUnits);
-
-    updateHighlightResults(p_timeStamp, startPos, hlUnits);
+    return !xml.hasError() && !failed;
 }
 
 void VCodeBlockHighlightHelper::updateHighlightResults(TimeStamp p_timeStamp,
@@ -247,7 +453,7 @@ bool VCodeBlockHighlightHelper::parseSpanElement(QXmlStreamReader &p_xml,
                                                  QVector<HLUnitPos> &p_units)
 {
     int unitStart = p_index;
-    QString style = p_xml.attributes().value("class").toString();
+    int style = VCodeBlockStyleTable::styleId(p_xml.attributes().value("class").toString());
 
     while (p_xml.readNext()) {
         if (p_xml.isCharacters()) {
@@ -284,24 +490,3 @@ bool VCodeBlockHighlightHelper::parseSpanElement(QXmlStreamReader &p_xml,
     }
     return false;
 }
-
-void VCodeBlockHighlightHelper::addToHighlightCache(const QString &p_text,
-                                                    TimeStamp p_timeStamp,
-                                                    const QVector<HLUnitPos> &p_units)
-{
-    const int c_maxEntries = 100;
-    const TimeStamp c_maxTimeStampSpan = 3;
-    if (m_cache.size() >= c_maxEntries) {
-        // Remove the oldest one.
-        TimeStamp ts = p_timeStamp - c_maxTimeStampSpan;
-        for (auto it = m_cache.begin(); it != m_cache.end();) {
-            if (it.value().m_timeStamp < ts) {
-                it = m_cache.erase(it);
-            } else {
-                ++it;
-            }
-        }
-    }
-
-    m_cache.insert(p_text, HLResult(p_timeStamp, p_units));
-}
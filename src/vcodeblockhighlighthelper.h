@@ -6,6 +6,11 @@
 #include <QAtomicInteger>
 #include <QXmlStreamReader>
 #include <QHash>
+#include <QSet>
+#include <QCache>
+#include <QByteArray>
+#include <QThreadPool>
+#include <QSharedPointer>
 
 #include "vconfigmanager.h"
 
@@ -19,6 +24,8 @@ public:
     VCodeBlockHighlightHelper(PegMarkdownHighlighter *p_highlighter,
                               VDocument *p_vdoc, MarkdownConverterType p_type);
 
+    ~VCodeBlockHighlightHelper();
+
     // @p_text: text of fenced code block.
     // Get the indent level of the first line (fence) and unindent the whole block
     // to make the fence at the highest indent level.
@@ -26,31 +33,41 @@ public:
     // without any context.
     static QString unindentCodeBlock(const QString &p_text);
 
+    // Code blocks get empty highlights once disabled.
+    void setEnabled(bool p_enabled);
+
 private slots:
     void handleCodeBlocksUpdated(TimeStamp p_timeStamp, const QVector<VCodeBlock> &p_codeBlocks);
 
     void handleTextHighlightResult(const QString &p_html, int p_id, unsigned long long p_timeStamp);
 
+    // Result of VCodeBlockTokenizer of code blocks with key @p_key.
+    void handleNativeHighlightResult(const QByteArray &p_key,
+                                     const QVector<HLUnitPos> &p_units);
+
+    // The web side is (re)loaded and drops all the requests sent before.
+    void handleWebReady();
+
 private:
-    struct HLResult
+    // Request of highlight sent to the web side.
+    struct WebRequest
     {
-        HLResult()
-            : m_timeStamp(0)
-        {
-        }
+        QByteArray m_key;
 
-        HLResult(TimeStamp p_timeStamp, const QVector<HLUnitPos> &p_units)
-            : m_timeStamp(p_timeStamp),
-              m_units(p_units)
-        {
-        }
+        // Raw text of the code block to match the result against.
+        QString m_text;
 
         TimeStamp m_timeStamp;
-
-        QVector<HLUnitPos> m_units;
     };
 
-    void parseHighlightResult(TimeStamp p_timeStamp, int p_idx, const QString &p_html);
+    // Key of the highlight result of @p_block, which only depends on its
+    // language and text. Results are relative to the start of the block.
+    static QByteArray cacheKey(const VCodeBlock &p_block);
+
+    // Parse the HTML from the web side into units relative to @p_text.
+    bool parseHighlightResult(const QString &p_text,
+                              const QString &p_html,
+                              QVector<HLUnitPos> &p_units);
 
     // @p_text: the raw text of the code block;
     // @p_index: the start index of the span element within @p_text;
@@ -61,9 +78,16 @@ private:
 
     void updateHighlightResults(TimeStamp p_timeStamp, int p_startPos, QVector<HLUnitPos> p_units);
 
-    void addToHighlightCache(const QString &p_text,
-                             TimeStamp p_timeStamp,
-                             const QVector<HLUnitPos> &p_units);
+    // Cache the result of @p_key and pass it to the code blocks waiting for it.
+    void finishHighlight(const QByteArray &p_key, const QVector<HLUnitPos> &p_units);
+
+    // Stop the native highlight in progress. Its code blocks will be sent
+    // again if still needed.
+    void cancelNativeHighlight();
+
+    // Drop the web requests older than MAX_REQUEST_TIMESTAMP_SPAN, whose
+    // code blocks will be sent again if still needed.
+    void removeStaleWebRequests(TimeStamp p_timeStamp);
 
     PegMarkdownHighlighter *m_highlighter;
     VDocument *m_vdocument;
@@ -73,9 +97,37 @@ private:
 
     QVector<VCodeBlock> m_codeBlocks;
 
-    // Cache for highlight result, using the code block text as key.
-    // The HLResult has relative position only.
-    QHash<QString, HLResult> m_cache;
+    // LRU cache of the highlight results by key, costing the number of units.
+    QCache<QByteArray, QVector<HLUnitPos>> m_cache;
+
+    // Key -> timestamp of the request of the highlight in progress.
+    // Code blocks with the same content wait for the same request.
+    QHash<QByteArray, TimeStamp> m_inProgress;
+
+    // Key -> indexes of the code blocks of m_timeStamp waiting for the result.
+    QHash<QByteArray, QVector<int>> m_waiting;
+
+    // Request ID -> request sent to the web side.
+    QHash<int, WebRequest> m_webRequests;
+
+    int m_nextRequestId;
+
+    // Keys of the native highlight in progress.
+    QSet<QByteArray> m_nativeKeys;
+
+    // Tokenize code blocks of supported languages natively.
+    QThreadPool m_pool;
+
+    // Cancel flag of the native highlight in progress. Replaced by a new one
+    // once cancelled.
+    QSharedPointer<QAtomicInt> m_cancelled;
+
+    bool m_enabled;
 };
 
+inline void VCodeBlockHighlightHelper::setEnabled(bool p_enabled)
+{
+    m_enabled = p_enabled;
+}
+
 #endif // VCODEBLOCKHIGHLIGHTHELPER_H
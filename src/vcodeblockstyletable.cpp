@@ -0,0 +1,48 @@
+#include "vcodeblockstyletable.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+
+namespace
+{
+QMutex s_mutex;
+
+QHash<QString, int> s_ids;
+
+QStringList s_names;
+}
+
+int VCodeBlockStyleTable::styleId(const QString &p_name)
+{
+    QMutexLocker locker(&s_mutex);
+    auto it = s_ids.constFind(p_name);
+    if (it != s_ids.constEnd()) {
+        return it.value();
+    }
+
+    int id = s_names.size();
+    s_names.append(p_name);
+    s_ids.insert(p_name, id);
+    return id;
+}
+
+QString VCodeBlockStyleTable::styleName(int p_id)
+{
+    QMutexLocker locker(&s_mutex);
+    return s_names.value(p_id);
+}
+
+QVector<QTextCharFormat> VCodeBlockStyleTable::formatTable(const QHash<QString, QTextCharFormat> &p_styles)
+{
+    QVector<QTextCharFormat> table;
+    for (auto it = p_styles.constBegin(); it != p_styles.constEnd(); ++it) {
+        int id = styleId(it.key());
+        if (id >= table.size()) {
+            table.resize(id + 1);
+        }
+
+        table[id] = it.value();
+    }
+
+    return table;
+}
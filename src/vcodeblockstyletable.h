@@ -0,0 +1,27 @@
+#ifndef VCODEBLOCKSTYLETABLE_H
+#define VCODEBLOCKSTYLETABLE_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+#include <QTextCharFormat>
+
+// Intern the style names of code block highlights, such as the class names of
+// highlight.js, into small integers shared by all the themes, so that the
+// highlight units need not carry strings.
+// Thread-safe.
+class VCodeBlockStyleTable
+{
+public:
+    // Return the ID of @p_name, adding it if not yet.
+    static int styleId(const QString &p_name);
+
+    static QString styleName(int p_id);
+
+    // Map the IDs to the formats of @p_styles.
+    // Empty format for styles not in @p_styles.
+    static QVector<QTextCharFormat> formatTable(const QHash<QString, QTextCharFormat> &p_styles);
+};
+
+#endif // VCODEBLOCKSTYLETABLE_H
@@ -0,0 +1,520 @@
+#include "vcodeblocktokenizer.h"
+
+#include <QSet>
+#include <QStringList>
+#include <QHash>
+
+#include "vcodeblockstyletable.h"
+
+namespace
+{
+struct LanguageDef
+{
+    LanguageDef()
+        : m_tripleQuotes(false),
+          m_preprocessor(false),
+          m_dollarVariables(false),
+          m_jsonKeys(false)
+    {
+    }
+
+    QSet<QString> m_keywords;
+
+    QSet<QString> m_literals;
+
+    QSet<QString> m_builtIns;
+
+    // Keywords followed by the name of a definition.
+    QSet<QString> m_titleKeywords;
+
+    QStringList m_lineComments;
+
+    QString m_blockCommentStart;
+
+    QString m_blockCommentEnd;
+
+    // Quotes of strings. Only strings quoted by ` could span lines.
+    QString m_quotes;
+
+    // Python's ''' and """.
+    bool m_tripleQuotes;
+
+    // Lines starting with #.
+    bool m_preprocessor;
+
+    // $var and ${var} of shells.
+    bool m_dollarVariables;
+
+    // Strings followed by : are keys.
+    bool m_jsonKeys;
+};
+
+QSet<QString> toSet(const char *p_words)
+{
+    return QString(p_words).split(' ', QString::SkipEmptyParts).toSet();
+}
+
+// Language name -> definition, with aliases.
+class LanguageTable
+{
+public:
+    LanguageTable()
+    {
+        LanguageDef c;
+        c.m_keywords = toSet("auto break case catch class const constexpr continue default delete "
+                             "do else enum explicit extern final for friend goto if inline "
+                             "mutable namespace new noexcept operator override private protected "
+                             "public register return sizeof static static_cast dynamic_cast "
+                             "reinterpret_cast const_cast struct switch template this throw try "
+                             "typedef typename union using virtual volatile while");
+        c.m_literals = toSet("true false nullptr NULL");
+        c.m_builtIns = toSet("bool char double float int long short signed unsigned void "
+                             "size_t std string vector map set wchar_t int8_t int16_t int32_t "
+                             "int64_t uint8_t uint16_t uint32_t uint64_t");
+        c.m_titleKeywords = toSet("class struct enum namespace union");
+        c.m_lineComments << "//";
+        c.m_blockCommentStart = "/*";
+        c.m_blockCommentEnd = "*/";
+        c.m_quotes = "\"'";
+        c.m_preprocessor = true;
+        add(c, "c cpp c++ cc cxx h hpp hxx objectivec objc");
+
+        LanguageDef java;
+        java.m_keywords = toSet("abstract assert break case catch class continue default do else "
+                                "enum extends final finally for if implements import instanceof "
+                                "interface native new package private protected public return "
+                                "static super switch synchronized this throw throws transient "
+                                "try volatile while var");
+        java.m_literals = toSet("true false null");
+        java.m_builtIns = toSet("boolean byte char double float int long short void String Object "
+                                "Integer Long List Map");
+        java.m_titleKeywords = toSet("class interface enum");
+        java.m_lineComments << "//";
+        java.m_blockCommentStart = "/*";
+        java.m_blockCommentEnd = "*/";
+        java.m_quotes = "\"'";
+        add(java, "java kotlin kt scala");
+
+        LanguageDef cs = java;
+        cs.m_keywords = toSet("abstract as base break case catch class const continue default "
+                              "delegate do else enum event explicit extern finally fixed for "
+                              "foreach goto if implicit in interface internal is lock namespace "
+                              "new operator out override params private protected public readonly "
+                              "ref return sealed sizeof static struct switch this throw try "
+                              "typeof unsafe using var virtual volatile while async await");
+        cs.m_builtIns = toSet("bool byte char decimal double float int long object sbyte short "
+                              "string uint ulong ushort void");
+        cs.m_titleKeywords = toSet("class interface enum struct namespace");
+        cs.m_preprocessor = true;
+        add(cs, "cs csharp");
+
+        LanguageDef js;
+        js.m_keywords = toSet("async await break case catch class const continue debugger default "
+                              "delete do else export extends finally for from function if import "
+                              "in instanceof let new of return static super switch this throw try "
+                              "typeof var void while with yield interface type enum implements "
+                              "private public protected readonly");
+        js.m_literals = toSet("true false null undefined NaN Infinity");
+        js.m_builtIns = toSet("console window document Math JSON Object Array String Number "
+                              "Boolean Promise Date RegExp Error Map Set require module");
+        js.m_titleKeywords = toSet("class function interface");
+        js.m_lineComments << "//";
+        js.m_blockCommentStart = "/*";
+        js.m_blockCommentEnd = "*/";
+        js.m_quotes = "\"'`";
+        add(js, "javascript js jsx typescript ts tsx");
+
+        LanguageDef go;
+        go.m_keywords = toSet("break case chan const continue default defer else fallthrough for "
+                              "func go goto if import interface map package range return select "
+                              "struct switch type var");
+        go.m_literals = toSet("true false nil iota");
+        go.m_builtIns = toSet("append cap close complex copy delete imag len make new panic print "
+                              "println real recover bool byte error float32 float64 int int8 "
+                              "int16 int32 int64 rune string uint uint8 uint16 uint32 uint64");
+        go.m_titleKeywords = toSet("func type");
+        go.m_lineComments << "//";
+        go.m_blockCommentStart = "/*";
+        go.m_blockCommentEnd = "*/";
+        go.m_quotes = "\"'`";
+        add(go, "go golang");
+
+        LanguageDef rust;
+        rust.m_keywords = toSet("as async await break const continue crate dyn else enum extern fn "
+                                "for if impl in let loop match mod move mut pub ref return self "
+                                "Self static struct super trait type unsafe use where while");
+        rust.m_literals = toSet("true false None Some Ok Err");
+        rust.m_builtIns = toSet("i8 i16 i32 i64 i128 isize u8 u16 u32 u64 u128 usize f32 f64 bool "
+                                "char str String Vec Option Result Box");
+        rust.m_titleKeywords = toSet("fn struct enum trait mod impl");
+        rust.m_lineComments << "//";
+        rust.m_blockCommentStart = "/*";
+        rust.m_blockCommentEnd = "*/";
+        rust.m_quotes = "\"";
+        add(rust, "rust rs");
+
+        LanguageDef py;
+        py.m_keywords = toSet("and as assert async await break class continue def del elif else "
+                              "except finally for from global if import in is lambda nonlocal "
+                              "not or pass raise return try while with yield");
+        py.m_literals = toSet("True False None");
+        py.m_builtIns = toSet("print len range int str float list dict set tuple open super self "
+                              "isinstance enumerate zip map filter sorted object type");
+        py.m_titleKeywords = toSet("def class");
+        py.m_lineComments << "#";
+        py.m_quotes = "\"'";
+        py.m_tripleQuotes = true;
+        add(py, "python py python3 py3");
+
+        LanguageDef sh;
+        sh.m_keywords = toSet("if then else elif fi for while until do done case esac in function "
+                              "return select local export");
+        sh.m_literals = toSet("true false");
+        sh.m_builtIns = toSet("echo cd pwd read set unset shift source exit eval exec test printf "
+                              "alias cat grep sed awk ls rm cp mv mkdir");
+        sh.m_lineComments << "#";
+        sh.m_quotes = "\"'";
+        sh.m_dollarVariables = true;
+        add(sh, "bash sh shell zsh console");
+
+        LanguageDef json;
+        json.m_literals = toSet("true false null");
+        json.m_quotes = "\"";
+        json.m_jsonKeys = true;
+        add(json, "json");
+    }
+
+    const LanguageDef *find(const QString &p_lang) const
+    {
+        auto it = m_langs.find(normalize(p_lang));
+        return it == m_langs.end() ? NULL : &it.value();
+    }
+
+private:
+    // "C++ {.numberLines}" -> "c++".
+    static QString normalize(const QString &p_lang)
+    {
+        QString lang = p_lang.trimmed().toLower();
+        int idx = 0;
+        while (idx < lang.size() && !lang[idx].isSpace() && lang[idx] != '{') {
+            ++idx;
+        }
+
+        return lang.left(idx);
+    }
+
+    void add(const LanguageDef &p_def, const char *p_names)
+    {
+        for (auto const & name : toSet(p_names)) {
+            m_langs.insert(name, p_def);
+        }
+    }
+
+    QHash<QString, LanguageDef> m_langs;
+};
+
+const LanguageTable &languageTable()
+{
+    static const LanguageTable table;
+    return table;
+}
+
+// IDs of the styles of the tokens.
+struct TokenStyles
+{
+    TokenStyles()
+        : m_comment(VCodeBlockStyleTable::styleId("hljs-comment")),
+          m_meta(VCodeBlockStyleTable::styleId("hljs-meta")),
+          m_attr(VCodeBlockStyleTable::styleId("hljs-attr")),
+          m_string(VCodeBlockStyleTable::styleId("hljs-string")),
+          m_variable(VCodeBlockStyleTable::styleId("hljs-variable")),
+          m_number(VCodeBlockStyleTable::styleId("hljs-number")),
+          m_keyword(VCodeBlockStyleTable::styleId("hljs-keyword")),
+          m_literal(VCodeBlockStyleTable::styleId("hljs-literal")),
+          m_title(VCodeBlockStyleTable::styleId("hljs-title")),
+          m_builtIn(VCodeBlockStyleTable::styleId("hljs-built_in"))
+    {
+    }
+
+    int m_comment;
+
+    int m_meta;
+
+    int m_attr;
+
+    int m_string;
+
+    int m_variable;
+
+    int m_number;
+
+    int m_keyword;
+
+    int m_literal;
+
+    int m_title;
+
+    int m_builtIn;
+};
+
+const TokenStyles &tokenStyles()
+{
+    static const TokenStyles styles;
+    return styles;
+}
+
+inline bool isWordChar(const QChar &p_ch)
+{
+    return p_ch.isLetterOrNumber() || p_ch == QLatin1Char('_');
+}
+
+class Tokenizer
+{
+public:
+    Tokenizer(const LanguageDef &p_def, const QString &p_text, int p_start, int p_end)
+        : m_def(p_def),
+          m_text(p_text),
+          m_end(p_end),
+          m_pos(p_start),
+          m_lineStart(true)
+    {
+    }
+
+    QVector<HLUnitPos> run()
+    {
+        bool title = false;
+        while (m_pos < m_end) {
+            QChar ch = m_text[m_pos];
+            if (ch == QLatin1Char('\n')) {
+                m_lineStart = true;
+                ++m_pos;
+                continue;
+            }
+
+            if (ch.isSpace()) {
+                ++m_pos;
+                continue;
+            }
+
+            bool lineStart = m_lineStart;
+            m_lineStart = false;
+
+            if (!m_def.m_blockCommentStart.isEmpty() && startsWith(m_def.m_blockCommentStart)) {
+                int end = m_text.indexOf(m_def.m_blockCommentEnd,
+                                         m_pos + m_def.m_blockCommentStart.size());
+                end = end == -1 || end >= m_end ? m_end : end + m_def.m_blockCommentEnd.size();
+                addUnit(end, tokenStyles().m_comment);
+                continue;
+            }
+
+            if (startsWithLineComment() || (m_def.m_preprocessor && lineStart && ch == '#')) {
+                addUnit(lineEnd(), ch == '#' && m_def.m_preprocessor ? tokenStyles().m_meta : tokenStyles().m_comment);
+                continue;
+            }
+
+            if (m_def.m_quotes.contains(ch)) {
+                int end = stringEnd(ch);
+                addUnit(end, isKey(end) ? tokenStyles().m_attr : tokenStyles().m_string);
+                continue;
+            }
+
+            if (m_def.m_dollarVariables && ch == '$' && m_pos + 1 < m_end) {
+                int end = variableEnd();
+                if (end > m_pos + 1) {
+                    addUnit(end, tokenStyles().m_variable);
+                    continue;
+                }
+            }
+
+            bool prevIsWord = m_pos > 0 && isWordChar(m_text[m_pos - 1]);
+            if (!prevIsWord && ch.isDigit()) {
+                addUnit(numberEnd(), tokenStyles().m_number);
+                title = false;
+                continue;
+            }
+
+            if (isWordChar(ch)) {
+                int end = m_pos;
+                while (end < m_end && isWordChar(m_text[end])) {
+                    ++end;
+                }
+
+                QString word = m_text.mid(m_pos, end - m_pos);
+                if (m_def.m_keywords.contains(word)) {
+                    addUnit(end, tokenStyles().m_keyword);
+                    title = m_def.m_titleKeywords.contains(word);
+                } else if (m_def.m_literals.contains(word)) {
+                    addUnit(end, tokenStyles().m_literal);
+                    title = false;
+                } else if (title) {
+                    addUnit(end, tokenStyles().m_title);
+                    title = false;
+                } else if (m_def.m_builtIns.contains(word)) {
+                    addUnit(end, tokenStyles().m_builtIn);
+                } else {
+                    m_pos = end;
+                }
+
+                continue;
+            }
+
+            title = false;
+            ++m_pos;
+        }
+
+        return m_units;
+    }
+
+private:
+    bool startsWith(const QString &p_str) const
+    {
+        return m_pos + p_str.size() <= m_end
+               && m_text.midRef(m_pos, p_str.size()) == p_str;
+    }
+
+    bool startsWithLineComment() const
+    {
+        for (auto const & com : m_def.m_lineComments) {
+            if (startsWith(com)) {
+                // # within a word like a#b is not a comment of shells.
+                return com != "#" || m_pos == 0 || !isWordChar(m_text[m_pos - 1]);
+            }
+        }
+
+        return false;
+    }
+
+    int lineEnd() const
+    {
+        int end = m_text.indexOf(QLatin1Char('\n'), m_pos);
+        return end == -1 || end > m_end ? m_end : end;
+    }
+
+    int stringEnd(const QChar &p_quote) const
+    {
+        if (m_def.m_tripleQuotes && startsWith(QString(3, p_quote))) {
+            int end = m_text.indexOf(QString(3, p_quote), m_pos + 3);
+            return end == -1 || end + 3 > m_end ? m_end : end + 3;
+        }
+
+        bool multiLine = p_quote == QLatin1Char('`');
+        int i = m_pos + 1;
+        while (i < m_end) {
+            QChar ch = m_text[i];
+            if (ch == QLatin1Char('\\')) {
+                i += 2;
+                continue;
+            } else if (ch == p_quote) {
+                return i + 1;
+            } else if (ch == QLatin1Char('\n') && !multiLine) {
+                return i;
+            }
+
+            ++i;
+        }
+
+        return m_end;
+    }
+
+    bool isKey(int p_end) const
+    {
+        if (!m_def.m_jsonKeys) {
+            return false;
+        }
+
+        int i = p_end;
+        while (i < m_end && m_text[i].isSpace() && m_text[i] != QLatin1Char('\n')) {
+            ++i;
+        }
+
+        return i < m_end && m_text[i] == QLatin1Char(':');
+    }
+
+    int variableEnd() const
+    {
+        int i = m_pos + 1;
+        if (m_text[i] == QLatin1Char('{')) {
+            int end = m_text.indexOf(QLatin1Char('}'), i);
+            return end == -1 || end >= lineEnd() ? m_pos : end + 1;
+        }
+
+        while (i < m_end && isWordChar(m_text[i])) {
+            ++i;
+        }
+
+        return i;
+    }
+
+    int numberEnd() const
+    {
+        int i = m_pos;
+        while (i < m_end) {
+            QChar ch = m_text[i];
+            if (isWordChar(ch) || ch == QLatin1Char('.')) {
+                ++i;
+            } else if ((ch == QLatin1Char('+') || ch == QLatin1Char('-'))
+                       && (m_text[i - 1] == QLatin1Char('e') || m_text[i - 1] == QLatin1Char('E'))
+                       && !m_text.midRef(m_pos, 2).startsWith("0x", Qt::CaseInsensitive)) {
+                ++i;
+            } else {
+                break;
+            }
+        }
+
+        return i;
+    }
+
+    void addUnit(int p_end, int p_style)
+    {
+        if (p_end > m_pos) {
+            m_units.append(HLUnitPos(m_pos, p_end - m_pos, p_style));
+        }
+
+        m_pos = qMax(p_end, m_pos + 1);
+    }
+
+    const LanguageDef &m_def;
+
+    const QString &m_text;
+
+    int m_end;
+
+    int m_pos;
+
+    bool m_lineStart;
+
+    QVector<HLUnitPos> m_units;
+};
+}
+
+bool VCodeBlockTokenizer::isSupported(const QString &p_lang)
+{
+    return languageTable().find(p_lang) != NULL;
+}
+
+QVector<HLUnitPos> VCodeBlockTokenizer::tokenize(const QString &p_lang, const QString &p_text)
+{
+    const LanguageDef *def = languageTable().find(p_lang);
+    if (!def) {
+        return QVector<HLUnitPos>();
+    }
+
+    // Skip the fences.
+    int start = p_text.indexOf(QLatin1Char('\n'));
+    if (start == -1) {
+        return QVector<HLUnitPos>();
+    }
+
+    ++start;
+    int end = p_text.size();
+    int lastLine = p_text.lastIndexOf(QLatin1Char('\n')) + 1;
+    if (lastLine >= start) {
+        QString fence = p_text.mid(lastLine).trimmed();
+        if (fence.startsWith("```") || fence.startsWith("~~~")) {
+            end = lastLine;
+        }
+    }
+
+    Tokenizer tokenizer(*def, p_text, start, end);
+    return tokenizer.run();
+}
@@ -0,0 +1,23 @@
+#ifndef VCODEBLOCKTOKENIZER_H
+#define VCODEBLOCKTOKENIZER_H
+
+#include <QString>
+#include <QVector>
+
+#include "markdownhighlighterdata.h"
+
+// Native syntax highlight of fenced code blocks of the common languages,
+// producing the same highlight.js styles without a web round-trip.
+// Thread-safe.
+class VCodeBlockTokenizer
+{
+public:
+    // Whether language @p_lang of the fence is supported.
+    static bool isSupported(const QString &p_lang);
+
+    // @p_text: text of the fenced code block including the fences.
+    // Returns units with positions relative to @p_text.
+    static QVector<HLUnitPos> tokenize(const QString &p_lang, const QString &p_text);
+};
+
+#endif // VCODEBLOCKTOKENIZER_H
@@ -0,0 +1,229 @@
+#include "vcompletiondictionary.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QJsonArray>
+#include <QJsonObject>
+
+#include <algorithm>
+
+#include "vwordindex.h"
+#include "vnotebook.h"
+#include "vnotebooksnapshot.h"
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
+#include "vtracer.h"
+
+extern VConfigManager *g_config;
+
+// Max number of candidates from other sources.
+#define MAX_CANDIDATES 1000
+
+// Skip notes larger than this in bytes when building the vocabulary.
+#define MAX_NOTE_SIZE (4 * 1024 * 1024)
+
+// Words shorter than this are not worth completing.
+#define MIN_WORD_LENGTH 3
+
+VWordDictionary::VWordDictionary()
+{
+}
+
+void VWordDictionary::build(const QStringList &p_words)
+{
+    QVector<QPair<QString, QString>> pairs;
+    pairs.reserve(p_words.size());
+    for (auto const & word : p_words) {
+        if (word.size() >= MIN_WORD_LENGTH) {
+            pairs.append(qMakePair(word.toCaseFolded(), word));
+        }
+    }
+
+    std::sort(pairs.begin(), pairs.end());
+    pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+    m_keys.clear();
+    m_words.clear();
+    m_keys.reserve(pairs.size());
+    m_words.reserve(pairs.size());
+    for (auto const & pa : pairs) {
+        m_keys.append(pa.first);
+        m_words.append(pa.second);
+    }
+}
+
+void VWordDictionary::lookup(const QString &p_prefix,
+                             Qt::CaseSensitivity p_cs,
+                             int p_limit,
+                             QSet<QString> &p_seen,
+                             QStringList &p_words) const
+{
+    QString key = p_prefix.toCaseFolded();
+    auto it = std::lower_bound(m_keys.begin(), m_keys.end(), key);
+    for (int i = it - m_keys.begin(); i < m_keys.size(); ++i) {
+        if (p_words.size() >= p_limit || !m_keys[i].startsWith(key)) {
+            break;
+        }
+
+        const QString &word = m_words[i];
+        if (p_cs == Qt::CaseSensitive && !word.startsWith(p_prefix)) {
+            continue;
+        }
+
+        if (!p_seen.contains(word)) {
+            p_seen.insert(word);
+            p_words.append(word);
+        }
+    }
+}
+
+
+// Collect the words of all the Markdown notes of a notebook.
+class NotebookVocabularyTask : public QRunnable
+{
+public:
+    NotebookVocabularyTask(VCompletionDictionary *p_dict,
+                           const QString &p_notebookPath,
+                           const QSharedPointer<VNotebookSnapshot> &p_snapshot)
+        : m_dict(p_dict),
+          m_notebookPath(p_notebookPath),
+          m_snapshot(p_snapshot)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        V_TRACE_DETAIL("completion", "Build notebook vocabulary", m_notebookPath);
+
+        QSet<QString> words;
+        QVector<QString> paths(1, m_notebookPath);
+        while (!paths.isEmpty()) {
+            QString path = paths.takeLast();
+            QJsonObject configJson = m_snapshot->readDirectoryConfig(path);
+            if (configJson.isEmpty()) {
+                continue;
+            }
+
+            QDir dir(path);
+            QJsonArray dirJson = configJson[DirConfig::c_subDirectories].toArray();
+            for (int i = 0; i < dirJson.size(); ++i) {
+                paths.append(dir.filePath(dirJson[i].toObject()[DirConfig::c_name].toString()));
+            }
+
+            QJsonArray fileJson = configJson[DirConfig::c_files].toArray();
+            for (int i = 0; i < fileJson.size(); ++i) {
+                QString name = fileJson[i].toObject()[DirConfig::c_name].toString();
+                if (VUtils::docTypeFromName(name) != DocType::Markdown) {
+                    continue;
+                }
+
+                QString filePath = dir.filePath(name);
+                if (QFileInfo(filePath).size() > MAX_NOTE_SIZE) {
+                    continue;
+                }
+
+                for (auto const & word : VWordIndex::splitWords(VUtils::readFileFromDisk(filePath))) {
+                    words.insert(word);
+                }
+            }
+        }
+
+        QSharedPointer<VWordDictionary> vocabulary(new VWordDictionary());
+        vocabulary->build(words.toList());
+
+        // The dictionary waits for all the tasks before destruction.
+        m_dict->setVocabulary(m_notebookPath, vocabulary);
+    }
+
+private:
+    VCompletionDictionary *m_dict;
+
+    QString m_notebookPath;
+
+    QSharedPointer<VNotebookSnapshot> m_snapshot;
+};
+
+
+VCompletionDictionary::VCompletionDictionary()
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+VCompletionDictionary::~VCompletionDictionary()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+VCompletionDictionary *VCompletionDictionary::inst()
+{
+    static VCompletionDictionary dict;
+    return &dict;
+}
+
+void VCompletionDictionary::registerIndex(VWordIndex *p_index)
+{
+    if (!m_indexes.contains(p_index)) {
+        m_indexes.append(p_index);
+    }
+}
+
+void VCompletionDictionary::unregisterIndex(VWordIndex *p_index)
+{
+    m_indexes.removeAll(p_index);
+}
+
+QStringList VCompletionDictionary::fetchCandidates(const VWordIndex *p_exclude,
+                                                   const VNotebook *p_notebook,
+                                                   const QString &p_prefix,
+                                                   Qt::CaseSensitivity p_cs,
+                                                   QSet<QString> &p_seen)
+{
+    QStringList words;
+    if (p_prefix.isEmpty()) {
+        return words;
+    }
+
+    if (g_config->getCompletionFromOpenedNotes()) {
+        for (auto index : m_indexes) {
+            if (index != p_exclude) {
+                index->getDictionary().lookup(p_prefix, p_cs, MAX_CANDIDATES, p_seen, words);
+            }
+        }
+    }
+
+    if (p_notebook && g_config->getCompletionFromNotebook()) {
+        auto vocabulary = fetchVocabulary(p_notebook);
+        if (vocabulary) {
+            vocabulary->lookup(p_prefix, p_cs, MAX_CANDIDATES, p_seen, words);
+        }
+    }
+
+    return words;
+}
+
+QSharedPointer<VWordDictionary> VCompletionDictionary::fetchVocabulary(const VNotebook *p_notebook)
+{
+    QString path = p_notebook->getPath();
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_vocabularies.find(path);
+    if (it != m_vocabularies.end()) {
+        return it.value();
+    }
+
+    // Mark it as being built.
+    m_vocabularies.insert(path, QSharedPointer<VWordDictionary>());
+    locker.unlock();
+
+    m_pool.start(new NotebookVocabularyTask(this, path, p_notebook->getSnapshot()));
+    return QSharedPointer<VWordDictionary>();
+}
+
+void VCompletionDictionary::setVocabulary(const QString &p_notebookPath,
+                                          const QSharedPointer<VWordDictionary> &p_vocabulary)
+{
+    QMutexLocker locker(&m_mutex);
+    m_vocabularies[p_notebookPath] = p_vocabulary;
+}
@@ -0,0 +1,96 @@
+#ifndef VCOMPLETIONDICTIONARY_H
+#define VCOMPLETIONDICTIONARY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QThreadPool>
+#include <QSharedPointer>
+
+class VWordIndex;
+class VNotebook;
+
+// Sorted unique words for prefix lookup in logarithmic time.
+// Words are sorted by their case-folded form so that both case-sensitive and
+// case-insensitive lookups are a range of the array.
+class VWordDictionary
+{
+public:
+    VWordDictionary();
+
+    void build(const QStringList &p_words);
+
+    // Append words starting with @p_prefix not in @p_seen to @p_words.
+    // Stop when @p_words has @p_limit words.
+    void lookup(const QString &p_prefix,
+                Qt::CaseSensitivity p_cs,
+                int p_limit,
+                QSet<QString> &p_seen,
+                QStringList &p_words) const;
+
+    int size() const;
+
+private:
+    // Case-folded words in ascending order.
+    QVector<QString> m_keys;
+
+    // Original words corresponding to @m_keys.
+    QVector<QString> m_words;
+};
+
+inline int VWordDictionary::size() const
+{
+    return m_words.size();
+}
+
+
+// Completion words from other sources than the document under editing:
+// - the word indexes of all the opened editors;
+// - the vocabulary of the notebook, built in the background if enabled;
+// Should be accessed only in the GUI thread except the vocabulary tasks.
+class VCompletionDictionary
+{
+public:
+    static VCompletionDictionary *inst();
+
+    ~VCompletionDictionary();
+
+    void registerIndex(VWordIndex *p_index);
+
+    void unregisterIndex(VWordIndex *p_index);
+
+    // Words starting with @p_prefix from indexes other than @p_exclude and the
+    // vocabulary of @p_notebook, which could be NULL.
+    // Words in @p_seen are skipped.
+    QStringList fetchCandidates(const VWordIndex *p_exclude,
+                                const VNotebook *p_notebook,
+                                const QString &p_prefix,
+                                Qt::CaseSensitivity p_cs,
+                                QSet<QString> &p_seen);
+
+private:
+    friend class NotebookVocabularyTask;
+
+    VCompletionDictionary();
+
+    // Return the vocabulary of @p_notebook or start building it.
+    QSharedPointer<VWordDictionary> fetchVocabulary(const VNotebook *p_notebook);
+
+    void setVocabulary(const QString &p_notebookPath,
+                       const QSharedPointer<VWordDictionary> &p_vocabulary);
+
+    QVector<VWordIndex *> m_indexes;
+
+    // Notebook path -> vocabulary. Null if it is being built.
+    QHash<QString, QSharedPointer<VWordDictionary>> m_vocabularies;
+
+    // Protect @m_vocabularies.
+    QMutex m_mutex;
+
+    QThreadPool m_pool;
+};
+
+#endif // VCOMPLETIONDICTIONARY_H
@@ -0,0 +1,132 @@
+#include "vcompletionmodel.h"
+
+#include <algorithm>
+
+static inline bool charEqual(const QChar &p_a, const QChar &p_b, Qt::CaseSensitivity p_cs)
+{
+    if (p_cs == Qt::CaseSensitive) {
+        return p_a == p_b;
+    }
+
+    return p_a == p_b || p_a.toCaseFolded() == p_b.toCaseFolded();
+}
+
+VCompletionModel::VCompletionModel(QObject *p_parent)
+    : QAbstractListModel(p_parent),
+      m_reversed(false),
+      m_cs(Qt::CaseSensitive),
+      m_filtered(false)
+{
+}
+
+void VCompletionModel::setCandidates(const QStringList &p_words, bool p_reversed)
+{
+    beginResetModel();
+    m_candidates = p_words;
+    m_reversed = p_reversed;
+    m_prefix.clear();
+    m_filtered = false;
+    m_matches.clear();
+    endResetModel();
+}
+
+void VCompletionModel::setPrefix(const QString &p_prefix, Qt::CaseSensitivity p_cs)
+{
+    // Matches of a longer prefix are among the ones of the shorter.
+    bool narrow = m_filtered
+                  && p_cs == m_cs
+                  && p_prefix.size() >= m_prefix.size()
+                  && p_prefix.startsWith(m_prefix, p_cs);
+
+    beginResetModel();
+
+    if (narrow) {
+        int cnt = 0;
+        for (int i = 0; i < m_matches.size(); ++i) {
+            int score = matchScore(m_candidates[m_matches[i].m_index], p_prefix, p_cs);
+            if (score >= 0) {
+                m_matches[cnt].m_index = m_matches[i].m_index;
+                m_matches[cnt].m_score = score;
+                ++cnt;
+            }
+        }
+
+        m_matches.resize(cnt);
+    } else {
+        m_matches.resize(0);
+        for (int i = 0; i < m_candidates.size(); ++i) {
+            int score = matchScore(m_candidates[i], p_prefix, p_cs);
+            if (score >= 0) {
+                m_matches.append(Match(i, score));
+            }
+        }
+    }
+
+    m_prefix = p_prefix;
+    m_cs = p_cs;
+    m_filtered = true;
+
+    sortMatches();
+
+    endResetModel();
+}
+
+void VCompletionModel::sortMatches()
+{
+    if (m_reversed) {
+        std::sort(m_matches.begin(), m_matches.end(), [](const Match &p_a, const Match &p_b) {
+            return p_a.m_score != p_b.m_score ? p_a.m_score > p_b.m_score : p_a.m_index < p_b.m_index;
+        });
+    } else {
+        std::sort(m_matches.begin(), m_matches.end(), [](const Match &p_a, const Match &p_b) {
+            return p_a.m_score != p_b.m_score ? p_a.m_score < p_b.m_score : p_a.m_index < p_b.m_index;
+        });
+    }
+}
+
+int VCompletionModel::rowCount(const QModelIndex &p_parent) const
+{
+    if (p_parent.isValid()) {
+        return 0;
+    }
+
+    return m_matches.size();
+}
+
+QVariant VCompletionModel::data(const QModelIndex &p_index, int p_role) const
+{
+    if (!p_index.isValid() || p_index.row() >= m_matches.size()) {
+        return QVariant();
+    }
+
+    if (p_role == Qt::DisplayRole || p_role == Qt::EditRole) {
+        return m_candidates[m_matches[p_index.row()].m_index];
+    }
+
+    return QVariant();
+}
+
+int VCompletionModel::matchScore(const QString &p_word,
+                                 const QString &p_prefix,
+                                 Qt::CaseSensitivity p_cs)
+{
+    if (p_word.startsWith(p_prefix, p_cs)) {
+        return 0;
+    }
+
+    if (p_word.size() <= p_prefix.size() || !charEqual(p_word[0], p_prefix[0], p_cs)) {
+        return -1;
+    }
+
+    int skipped = 0;
+    int j = 1;
+    for (int i = 1; i < p_word.size() && j < p_prefix.size(); ++i) {
+        if (charEqual(p_word[i], p_prefix[j], p_cs)) {
+            ++j;
+        } else {
+            ++skipped;
+        }
+    }
+
+    return j == p_prefix.size() ? skipped + 1 : -1;
+}
@@ -0,0 +1,90 @@
+#ifndef VCOMPLETIONMODEL_H
+#define VCOMPLETIONMODEL_H
+
+#include <QAbstractListModel>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// List model of the completion candidates filtered and ranked by a prefix.
+// Candidates are kept until the next completion, and a longer prefix only
+// filters the current matches in place.
+// A candidate matches if it starts with the prefix, or contains the chars of
+// the prefix in order starting with its first char. Prefix matches come first
+// in the order of the candidates, followed by the others with fewer skipped
+// chars first.
+class VCompletionModel : public QAbstractListModel
+{
+    Q_OBJECT
+public:
+    explicit VCompletionModel(QObject *p_parent = nullptr);
+
+    // @p_words: candidates in the order of preference.
+    // @p_reversed: rank the matches in reversed order, the best last.
+    void setCandidates(const QStringList &p_words, bool p_reversed);
+
+    void setPrefix(const QString &p_prefix, Qt::CaseSensitivity p_cs);
+
+    const QString &getPrefix() const;
+
+    Qt::CaseSensitivity getCaseSensitivity() const;
+
+    int rowCount(const QModelIndex &p_parent = QModelIndex()) const Q_DECL_OVERRIDE;
+
+    QVariant data(const QModelIndex &p_index, int p_role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+    // Return -1 if @p_word does not match @p_prefix, 0 if it starts with
+    // @p_prefix, or 1 plus the number of chars skipped.
+    static int matchScore(const QString &p_word,
+                          const QString &p_prefix,
+                          Qt::CaseSensitivity p_cs);
+
+private:
+    struct Match
+    {
+        Match()
+            : m_index(0),
+              m_score(0)
+        {
+        }
+
+        Match(int p_index, int p_score)
+            : m_index(p_index),
+              m_score(p_score)
+        {
+        }
+
+        // Index in @m_candidates.
+        int m_index;
+
+        int m_score;
+    };
+
+    void sortMatches();
+
+    QStringList m_candidates;
+
+    bool m_reversed;
+
+    QString m_prefix;
+
+    Qt::CaseSensitivity m_cs;
+
+    // Whether @m_matches are filtered by @m_prefix from all the candidates.
+    bool m_filtered;
+
+    // Ranked matches of @m_prefix.
+    QVector<Match> m_matches;
+};
+
+inline const QString &VCompletionModel::getPrefix() const
+{
+    return m_prefix;
+}
+
+inline Qt::CaseSensitivity VCompletionModel::getCaseSensitivity() const
+{
+    return m_cs;
+}
+
+#endif // VCOMPLETIONMODEL_H
@@ -0,0 +1,33 @@
+#ifndef VCONFIGKEYS_H
+#define VCONFIGKEYS_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+// Registry of the configurations read frequently, which are loaded once into
+// VCachedConfig and kept in sync by VConfigManager::setConfigToSettings().
+// X(member, type, section, key).
+#define VCONFIG_CACHED_KEYS(X) \
+    X(toolsDockChecked, bool, "global", "tools_dock_checked") \
+    X(searchDockChecked, bool, "global", "search_dock_checked") \
+    X(menuBarChecked, bool, "global", "menu_bar_checked") \
+    X(toolBarChecked, bool, "global", "tool_bar_checked") \
+    X(webZoomFactor, qreal, "global", "web_zoom_factor") \
+    X(enableBackupFile, bool, "global", "enable_backup_file") \
+    X(enableAutoSave, bool, "global", "enable_auto_save") \
+    X(enableWildCardInSimpleSearch, bool, "global", "enable_wildcard_in_simple_search") \
+    X(searchOptions, QStringList, "global", "search_options") \
+    X(stylesToRemoveWhenCopied, QStringList, "web", "styles_to_remove_when_copied") \
+    X(copyTargets, QStringList, "web", "copy_targets") \
+    X(styleOfSpanForMark, QString, "web", "style_of_span_for_mark")
+
+// Flat struct of the values of VCONFIG_CACHED_KEYS.
+struct VCachedConfig
+{
+#define VCONFIG_DECLARE_MEMBER(member, type, section, key) type m_##member = type();
+    VCONFIG_CACHED_KEYS(VCONFIG_DECLARE_MEMBER)
+#undef VCONFIG_DECLARE_MEMBER
+};
+
+#endif // VCONFIGKEYS_H
@@ -1,6 +1,7 @@
 #include "vconfigmanager.h"
 #include <QDir>
 #include <QFile>
+#include <QFileInfo>
 #include <QString>
 #include <QJsonArray>
 #include <QJsonObject>
@@ -11,10 +12,17 @@
 #include <QCoreApplication>
 #include <QScopedPointer>
 #include <QDateTime>
+#include <QDataStream>
+#include <QTimer>
 
 #include "utils/vutils.h"
 #include "vstyleparser.h"
 #include "vpalette.h"
+#include "vdirectoryconfigwriter.h"
+#include "utils/vstylecache.h"
+
+// Interval in msecs to write the pending configurations in batch.
+#define SETTINGS_FLUSH_INTERVAL 1000
 
 const QString VConfigManager::orgName = QString("vnote");
 
@@ -30,6 +38,8 @@ const QString VConfigManager::c_defaultConfigFile = QString("vnote.ini");
 
 const QString VConfigManager::c_sessionConfigFile = QString("session.ini");
 
+const QString VConfigManager::c_historyConfigFile = QString("history.json");
+
 const QString VConfigManager::c_snippetConfigFile = QString("snippet.json");
 
 const QString VConfigManager::c_keyboardLayoutConfigFile = QString("keyboard_layouts.ini");
@@ -46,6 +56,8 @@ const QString VConfigManager::c_snippetConfigFolder = QString("snippets");
 
 const QString VConfigManager::c_resourceConfigFolder = QString("resources");
 
+const QString VConfigManager::c_cacheConfigFolder = QString("cache");
+
 const QString VConfigManager::c_warningTextStyle = QString("color: #C9302C; font: bold");
 
 const QString VConfigManager::c_dataTextStyle = QString("font: bold");
@@ -59,10 +71,24 @@ VConfigManager::VConfigManager(QObject *p_parent)
       m_noteListViewOrder(-1),
       m_explorerCurrentIndex(-1),
       m_hasReset(false),
+      m_configRevision(0),
       userSettings(NULL),
+      m_flushTimer(NULL),
       defaultSettings(NULL),
       m_sessionSettings(NULL)
 {
+    m_flushTimer = new QTimer(this);
+    m_flushTimer->setSingleShot(true);
+    m_flushTimer->setInterval(SETTINGS_FLUSH_INTERVAL);
+    connect(m_flushTimer, &QTimer::timeout,
+            this, [this]() {
+                flushSettings();
+            });
+}
+
+VConfigManager::~VConfigManager()
+{
+    flushSettings();
 }
 
 void VConfigManager::initialize()
@@ -71,6 +97,8 @@ void VConfigManager::initialize()
 
     checkVersion();
 
+    loadCachedConfig();
+
     initThemes();
 
     initEditorStyles();
@@ -138,6 +166,89 @@ void VConfigManager::initialize()
     m_enableCodeBlockHighlight = getConfigFromSettings("global",
                                                        "enable_code_block_highlight").toBool();
 
+    m_enableNativeCodeBlockHighlight = getConfigFromSettings("global",
+                                                             "enable_native_code_block_highlight").toBool();
+
+    m_enableLatencyStats = getConfigFromSettings("global",
+                                                 "enable_latency_stats").toBool();
+
+    m_imageCacheSize = getConfigFromSettings("global", "image_cache_size").toInt();
+    if (m_imageCacheSize < 0) {
+        m_imageCacheSize = 0;
+    }
+
+    m_lazyLayoutBlockCount = getConfigFromSettings("global",
+                                                   "lazy_layout_block_count").toInt();
+    if (m_lazyLayoutBlockCount < 0) {
+        m_lazyLayoutBlockCount = 0;
+    }
+
+    m_longLineLength = getConfigFromSettings("global",
+                                             "long_line_length").toInt();
+    if (m_longLineLength < 0) {
+        m_longLineLength = 0;
+    }
+
+    m_longLineHighlightLength = getConfigFromSettings("global",
+                                                      "long_line_highlight_length").toInt();
+    if (m_longLineHighlightLength < 0) {
+        m_longLineHighlightLength = 0;
+    }
+
+    m_largeFileSize = getConfigFromSettings("global",
+                                            "large_file_size").toInt();
+    if (m_largeFileSize < 0) {
+        m_largeFileSize = 0;
+    }
+
+    m_reducedFeaturesSize = getConfigFromSettings("global",
+                                                  "reduced_features_size").toInt();
+    if (m_reducedFeaturesSize < 0) {
+        m_reducedFeaturesSize = 0;
+    }
+
+    m_liteViewFileSize = getConfigFromSettings("global",
+                                               "lite_view_file_size").toInt();
+    if (m_liteViewFileSize < 0) {
+        m_liteViewFileSize = 0;
+    }
+
+    m_plainTextFileSize = getConfigFromSettings("global",
+                                                "plain_text_file_size").toInt();
+    if (m_plainTextFileSize < 0) {
+        m_plainTextFileSize = 0;
+    }
+
+    m_markdownParseThreads = getConfigFromSettings("global",
+                                                   "markdown_parse_threads").toInt();
+
+    m_prefetchNotebookFolders = getConfigFromSettings("global",
+                                                      "prefetch_notebook_folders").toBool();
+
+    m_prefetchNoteSize = getConfigFromSettings("global",
+                                               "prefetch_note_size").toInt();
+    if (m_prefetchNoteSize < 0) {
+        m_prefetchNoteSize = 0;
+    }
+
+    m_watchNotebookFolders = getConfigFromSettings("global",
+                                                   "watch_notebook_folders").toBool();
+
+    m_webViewPoolSize = getConfigFromSettings("web",
+                                              "web_view_pool_size").toInt();
+    if (m_webViewPoolSize < 0) {
+        m_webViewPoolSize = 0;
+    }
+
+    m_exportWebViews = getConfigFromSettings("web",
+                                             "export_web_views").toInt();
+    if (m_exportWebViews < 1) {
+        m_exportWebViews = 1;
+    }
+
+    m_enableNativeHtmlExport = getConfigFromSettings("web",
+                                                     "enable_native_html_export").toBool();
+
     m_enablePreviewImages = getConfigFromSettings("global",
                                                   "enable_preview_images").toBool();
 
@@ -295,9 +406,53 @@ void VConfigManager::initialize()
 
     m_plantUMLCmd = getConfigFromSettings("web", "plantuml_cmd").toString();
 
+    m_plantUMLPipeProcesses = getConfigFromSettings("web", "plantuml_pipe_processes").toInt();
+    if (m_plantUMLPipeProcesses < 0) {
+        m_plantUMLPipeProcesses = 0;
+    }
+
     m_enableGraphviz = getConfigFromSettings("global", "enable_graphviz").toBool();
     m_graphvizDot = getConfigFromSettings("web", "graphviz_dot").toString();
 
+    m_renderCacheSize = getConfigFromSettings("web", "render_cache_size").toInt();
+    if (m_renderCacheSize < 0) {
+        m_renderCacheSize = 0;
+    }
+
+    m_tabHibernationInterval = getConfigFromSettings("global", "tab_hibernation_interval").toInt();
+    if (m_tabHibernationInterval < 0) {
+        m_tabHibernationInterval = 0;
+    }
+
+    m_recycleBinMaxAgeDays = getConfigFromSettings("global", "recycle_bin_max_age_days").toInt();
+    if (m_recycleBinMaxAgeDays < 0) {
+        m_recycleBinMaxAgeDays = 0;
+    }
+
+    m_recycleBinMaxSize = getConfigFromSettings("global", "recycle_bin_max_size").toInt();
+    if (m_recycleBinMaxSize < 0) {
+        m_recycleBinMaxSize = 0;
+    }
+
+    m_readModeCacheSize = getConfigFromSettings("web", "read_mode_cache_size").toInt();
+    if (m_readModeCacheSize < 0) {
+        m_readModeCacheSize = 0;
+    }
+
+    m_persistReadModeCache = getConfigFromSettings("web", "persist_read_mode_cache").toBool();
+
+    m_enableRenderWorker = getConfigFromSettings("web", "enable_render_worker").toBool();
+
+    m_maxRenderProcesses = getConfigFromSettings("web", "max_render_processes").toInt();
+    if (m_maxRenderProcesses < 1) {
+        m_maxRenderProcesses = 1;
+    }
+
+    m_webCacheSize = getConfigFromSettings("web", "web_cache_size").toInt();
+    if (m_webCacheSize < 0) {
+        m_webCacheSize = 0;
+    }
+
     m_historySize = getConfigFromSettings("global", "history_size").toInt();
     if (m_historySize < 0) {
         m_historySize = 0;
@@ -309,6 +464,18 @@ void VConfigManager::initialize()
     m_imageNamePrefix = getConfigFromSettings("global",
                                               "image_name_prefix").toString();
 
+    m_imageSaveFormat = getConfigFromSettings("global",
+                                              "image_save_format").toString().toLower();
+    if (m_imageSaveFormat.isEmpty()) {
+        m_imageSaveFormat = "png";
+    }
+
+    m_imageSaveQuality = getConfigFromSettings("global",
+                                               "image_save_quality").toInt();
+    if (m_imageSaveQuality > 100) {
+        m_imageSaveQuality = 100;
+    }
+
     m_panelViewState = getConfigFromSettings("global",
                                              "panel_view_state").toInt();
 
@@ -330,6 +497,9 @@ void VConfigManager::initialize()
     m_syncNoteListToCurrentTab = getConfigFromSettings("global",
                                                        "sync_note_list_to_current_tab").toBool();
 
+    m_copyWithHardLinks = getConfigFromSettings("global",
+                                                "copy_with_hard_links").toBool();
+
     initEditorConfigs();
 
     initMarkdownConfigs();
@@ -354,6 +524,12 @@ void VConfigManager::initEditorConfigs()
     m_enableSmartImInVimMode = getConfigFromSettings(section,
                                                      "enable_smart_im_in_vim_mode").toBool();
 
+    m_completionFromOpenedNotes = getConfigFromSettings(section,
+                                                        "completion_from_opened_notes").toBool();
+
+    m_completionFromNotebook = getConfigFromSettings(section,
+                                                     "completion_from_notebook").toBool();
+
     QString tmpLeader = getConfigFromSettings(section,
                                               "vim_leader_key").toString();
     if (tmpLeader.isEmpty()) {
@@ -370,6 +546,8 @@ void VConfigManager::initEditorConfigs()
 
     m_parsePasteLocalImage = getConfigFromSettings(section, "parse_paste_local_image").toBool();
 
+    m_parsePasteInWebView = getConfigFromSettings(section, "parse_paste_in_web_view").toBool();
+
     m_enableExtraBuffer = getConfigFromSettings(section, "enable_extra_buffer").toBool();
 
     m_autoScrollCursorLine = getConfigFromSettings(section, "auto_scroll_cursor_line").toInt();
@@ -460,8 +638,8 @@ void VConfigManager::readNotebookFromSettings(QSettings *p_settings,
         p_settings->setArrayIndex(i);
         QString name = p_settings->value("name").toString();
         QString path = p_settings->value("path").toString();
+        // The configuration of the notebook is read once it is used.
         VNotebook *notebook = new VNotebook(name, path, parent);
-        notebook->readConfigNotebook();
         p_notebooks.append(notebook);
     }
 
@@ -510,33 +688,91 @@ static void setConfigToSettingsBySectionKey(QSettings *p_settings,
 
 QVariant VConfigManager::getConfigFromSettings(const QString &section, const QString &key) const
 {
-    // First, look up the user-scoped config file
-    QVariant value = getConfigFromSettingsBySectionKey(userSettings, section, key);
+    QString fullKey = section + "/" + key;
+
+    // First, look up the configs not written yet.
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        auto it = m_pendingSettings.constFind(fullKey);
+        if (it != m_pendingSettings.constEnd()) {
+            return it.value();
+        }
+    }
+
+    // Second, look up the user-scoped config file
+    QVariant value = userSettings->value(fullKey);
     if (!value.isNull()) {
-        qDebug() << "user config:" << (section + "/" +  key) << value;
         return value;
     }
 
-    // Second, look up the default config file
-    return getDefaultConfig(section, key);
+    // Third, look up the default config file
+    return defaultSettings->value(fullKey);
 }
 
 void VConfigManager::setConfigToSettings(const QString &section, const QString &key, const QVariant &value)
 {
+    ++m_configRevision;
+
     if (m_hasReset) {
         return;
     }
 
-    // Set the user-scoped config file
-    setConfigToSettingsBySectionKey(userSettings, section, key, value);
-    qDebug() << "set user config:" << (section + "/" + key) << value;
+    updateCachedConfig(section, key, value);
+
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        m_pendingSettings.insert(section + "/" + key, value);
+    }
+
+    if (!m_flushTimer->isActive()) {
+        m_flushTimer->start();
+    }
+}
+
+void VConfigManager::flushSettings()
+{
+    QMutexLocker locker(&m_pendingMutex);
+    if (m_pendingSettings.isEmpty() || !userSettings) {
+        return;
+    }
+
+    qDebug() << "flush user configs" << m_pendingSettings.size();
+    for (auto it = m_pendingSettings.constBegin(); it != m_pendingSettings.constEnd(); ++it) {
+        userSettings->setValue(it.key(), it.value());
+    }
+
+    m_pendingSettings.clear();
+    userSettings->sync();
+}
+
+void VConfigManager::loadCachedConfig()
+{
+#define VCONFIG_LOAD_MEMBER(member, type, section, key) \
+    m_cachedConfig.m_##member = getConfigFromSettings(section, key).value<type>();
+
+    VCONFIG_CACHED_KEYS(VCONFIG_LOAD_MEMBER)
+
+#undef VCONFIG_LOAD_MEMBER
+}
+
+void VConfigManager::updateCachedConfig(const QString &p_section,
+                                        const QString &p_key,
+                                        const QVariant &p_value)
+{
+#define VCONFIG_UPDATE_MEMBER(member, type, section, key) \
+    if (p_key == QLatin1String(key) && p_section == QLatin1String(section)) { \
+        m_cachedConfig.m_##member = p_value.value<type>(); \
+        return; \
+    }
+
+    VCONFIG_CACHED_KEYS(VCONFIG_UPDATE_MEMBER)
+
+#undef VCONFIG_UPDATE_MEMBER
 }
 
 QVariant VConfigManager::getDefaultConfig(const QString &p_section, const QString &p_key) const
 {
-    QVariant value = getConfigFromSettingsBySectionKey(defaultSettings, p_section, p_key);
-    qDebug() << "default config:" << (p_section + "/" + p_key) << value;
-    return value;
+    return getConfigFromSettingsBySectionKey(defaultSettings, p_section, p_key);
 }
 
 QVariant VConfigManager::resetDefaultConfig(const QString &p_section, const QString &p_key)
@@ -573,6 +809,11 @@ QJsonObject VConfigManager::readDirectoryConfig(const QString &path)
 {
     QString configFile = fetchDirConfigFilePath(path);
 
+    QJsonObject pendingJson;
+    if (VDirectoryConfigWriter::read(configFile, pendingJson)) {
+        return pendingJson;
+    }
+
     QFile config(configFile);
     if (!config.open(QIODevice::ReadOnly)) {
         qWarning() << "fail to read directory configuration file:"
@@ -586,28 +827,20 @@ QJsonObject VConfigManager::readDirectoryConfig(const QString &path)
 
 bool VConfigManager::directoryConfigExist(const QString &path)
 {
-     return QFileInfo::exists(fetchDirConfigFilePath(path));
+    QString configFile = fetchDirConfigFilePath(path);
+    return VDirectoryConfigWriter::isPending(configFile) || QFileInfo::exists(configFile);
 }
 
 bool VConfigManager::writeDirectoryConfig(const QString &path, const QJsonObject &configJson)
 {
-    QString configFile = fetchDirConfigFilePath(path);
-
-    QFile config(configFile);
-    // We use Unix LF for config file.
-    if (!config.open(QIODevice::WriteOnly)) {
-        qWarning() << "fail to open directory configuration file for write:"
-                   << configFile;
-        return false;
-    }
-
-    QJsonDocument configDoc(configJson);
-    config.write(configDoc.toJson());
+    VDirectoryConfigWriter::write(fetchDirConfigFilePath(path), configJson);
     return true;
 }
 
 bool VConfigManager::deleteDirectoryConfig(const QString &path)
 {
+    VDirectoryConfigWriter::flush();
+
     QString configFile = fetchDirConfigFilePath(path);
 
     QFile config(configFile);
@@ -626,6 +859,79 @@ QString VConfigManager::getLogFilePath() const
     return QDir(getConfigFolder()).filePath("vnote.log");
 }
 
+static QDataStream &operator<<(QDataStream &p_out, const HighlightingStyle &p_style)
+{
+    p_out << (qint32)p_style.type << p_style.format;
+    return p_out;
+}
+
+static QDataStream &operator>>(QDataStream &p_in, HighlightingStyle &p_style)
+{
+    qint32 type = 0;
+    p_in >> type >> p_style.format;
+    p_style.type = (pmh_element_type)type;
+    return p_in;
+}
+
+// The parsed styles depend on the base palette and font.
+static void addMarkdownEditStyleCacheKey(VStyleCache &p_cache,
+                                         const QString &p_styleStr,
+                                         const QPalette &p_palette,
+                                         const QFont &p_font)
+{
+    QByteArray base;
+    QDataStream out(&base, QIODevice::WriteOnly);
+    out << p_palette << p_font;
+
+    p_cache.addData(p_styleStr);
+    p_cache.addData(base);
+}
+
+bool VConfigManager::loadMarkdownEditStyleCache(const QString &p_styleStr,
+                                                QMap<QString, QMap<QString, QString>> &p_styles)
+{
+    VStyleCache cache("mdhl");
+    addMarkdownEditStyleCacheKey(cache, p_styleStr, baseEditPalette, baseEditFont);
+
+    QByteArray data;
+    if (!cache.load(data)) {
+        return false;
+    }
+
+    QPalette palette;
+    QFont font;
+    QMap<QString, QMap<QString, QString>> styles;
+    QVector<HighlightingStyle> highlightingStyles;
+    QHash<QString, QTextCharFormat> codeBlockStyles;
+    QDataStream in(data);
+    in >> palette >> font >> styles >> highlightingStyles >> codeBlockStyles;
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "invalid editor style cache";
+        return false;
+    }
+
+    mdEditPalette = palette;
+    mdEditFont = font;
+    mdHighlightingStyles = highlightingStyles;
+    m_codeBlockStyles = codeBlockStyles;
+    p_styles = styles;
+    return true;
+}
+
+void VConfigManager::saveMarkdownEditStyleCache(const QString &p_styleStr,
+                                                const QMap<QString, QMap<QString, QString>> &p_styles) const
+{
+    VStyleCache cache("mdhl");
+    addMarkdownEditStyleCacheKey(cache, p_styleStr, baseEditPalette, baseEditFont);
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << mdEditPalette << mdEditFont << p_styles << mdHighlightingStyles << m_codeBlockStyles;
+    if (!cache.store(data)) {
+        qWarning() << "fail to write editor style cache";
+    }
+}
+
 void VConfigManager::updateMarkdownEditStyle()
 {
     static const QString defaultColor = "#00897B";
@@ -640,17 +946,21 @@ void VConfigManager::updateMarkdownEditStyle()
         return;
     }
 
-    mdEditPalette = baseEditPalette;
-    mdEditFont = baseEditFont;
+    QMap<QString, QMap<QString, QString>> styles;
+    if (!loadMarkdownEditStyleCache(styleStr, styles)) {
+        mdEditPalette = baseEditPalette;
+        mdEditFont = baseEditFont;
+
+        VStyleParser parser;
+        parser.parseMarkdownStyle(styleStr);
 
-    VStyleParser parser;
-    parser.parseMarkdownStyle(styleStr);
+        parser.fetchMarkdownEditorStyles(mdEditPalette, mdEditFont, styles);
 
-    QMap<QString, QMap<QString, QString>> styles;
-    parser.fetchMarkdownEditorStyles(mdEditPalette, mdEditFont, styles);
+        mdHighlightingStyles = parser.fetchMarkdownStyles(mdEditFont);
+        m_codeBlockStyles = parser.fetchCodeBlockStyles(mdEditFont);
 
-    mdHighlightingStyles = parser.fetchMarkdownStyles(mdEditFont);
-    m_codeBlockStyles = parser.fetchCodeBlockStyles(mdEditFont);
+        saveMarkdownEditStyleCache(styleStr, styles);
+    }
 
     m_editorCurrentLineBg = defaultColor;
     m_editorVimInsertBg = defaultColor;
@@ -891,6 +1201,11 @@ QString VConfigManager::getResourceConfigFolder() const
     return QDir(getConfigFolder()).filePath(c_resourceConfigFolder);
 }
 
+QString VConfigManager::getCacheConfigFolder() const
+{
+    return QDir(getConfigFolder()).filePath(c_cacheConfigFolder);
+}
+
 const QString &VConfigManager::getCommonCssUrl() const
 {
     static QString cssPath;
@@ -1275,6 +1590,18 @@ void VConfigManager::initDocSuffixes()
     html << "html";
     m_docSuffixes[(int)DocType::Html] = html;
 
+    QStringList textSuffix = getConfigFromSettings("global",
+                                                   "text_suffix").toStringList();
+    QList<QString> text;
+    for (auto const & suf : textSuffix) {
+        QString lower = suf.toLower();
+        if (!lower.isEmpty() && !mdSuffix.contains(lower) && !text.contains(lower)) {
+            text << lower;
+        }
+    }
+
+    m_docSuffixes[(int)DocType::Text] = text;
+
     qDebug() << "doc suffixes" << m_docSuffixes;
 }
 
@@ -1321,6 +1648,22 @@ void VConfigManager::getHistory(QLinkedList<VHistoryEntry> &p_history) const
 {
     p_history.clear();
 
+    QString file = QDir(getConfigFolder()).filePath(c_historyConfigFile);
+    QJsonObject json;
+    if (!VDirectoryConfigWriter::read(file, json) && QFileInfo::exists(file)) {
+        json = VUtils::readJsonFromDisk(file);
+    }
+
+    if (json.contains(HistoryConfig::c_entries)) {
+        QJsonArray entries = json[HistoryConfig::c_entries].toArray();
+        for (int i = 0; i < entries.size(); ++i) {
+            p_history.append(VHistoryEntry::fromJson(entries[i].toObject()));
+        }
+
+        return;
+    }
+
+    // History used to be kept in the session settings.
     int size = m_sessionSettings->beginReadArray("history");
     for (int i = 0; i < size; ++i) {
         m_sessionSettings->setArrayIndex(i);
@@ -1336,21 +1679,22 @@ void VConfigManager::setHistory(const QLinkedList<VHistoryEntry> &p_history)
         return;
     }
 
-    const QString section("history");
+    QJsonArray entries;
+    for (auto it = p_history.begin(); it != p_history.end(); ++it) {
+        entries.append(it->toJson());
+    }
 
-    // Clear it first
-    m_sessionSettings->beginGroup(section);
-    m_sessionSettings->remove("");
-    m_sessionSettings->endGroup();
+    QJsonObject json;
+    json[HistoryConfig::c_entries] = entries;
 
-    m_sessionSettings->beginWriteArray(section);
-    int i = 0;
-    for (auto it = p_history.begin(); it != p_history.end(); ++it, ++i) {
-        m_sessionSettings->setArrayIndex(i);
-        it->toSettings(m_sessionSettings);
-    }
+    // Coalesced and written in background.
+    VDirectoryConfigWriter::write(QDir(getConfigFolder()).filePath(c_historyConfigFile), json);
 
-    m_sessionSettings->endArray();
+    if (m_sessionSettings->contains("history/size")) {
+        m_sessionSettings->beginGroup("history");
+        m_sessionSettings->remove("");
+        m_sessionSettings->endGroup();
+    }
 }
 
 void VConfigManager::getExplorerEntries(QVector<VExplorerEntry> &p_entries) const
@@ -1646,8 +1990,15 @@ void VConfigManager::initCodeBlockCssStyles()
 
 void VConfigManager::resetConfigurations()
 {
-    // Clear userSettings.
+    // Drop the pending configs and clear userSettings.
+    {
+        QMutexLocker locker(&m_pendingMutex);
+        m_pendingSettings.clear();
+    }
+
+    m_flushTimer->stop();
     userSettings->clear();
+    loadCachedConfig();
 
     // Clear m_sessionSettings except the notebooks information.
     clearGroupOfSettings(m_sessionSettings, "last_opened_files");
@@ -9,6 +9,7 @@
 #include <QHash>
 #include <QLinkedList>
 #include <QDir>
+#include <QMutex>
 
 #include "vnotebook.h"
 #include "markdownhighlighterdata.h"
@@ -19,9 +20,11 @@
 #include "markdownitoption.h"
 #include "vhistoryentry.h"
 #include "vexplorerentry.h"
+#include "vconfigkeys.h"
 
 class QJsonObject;
 class QString;
+class QTimer;
 
 struct VColor
 {
@@ -87,12 +90,18 @@ class VConfigManager : public QObject
 public:
     explicit VConfigManager(QObject *p_parent = NULL);
 
+    ~VConfigManager();
+
     void initialize();
 
+    // Write the pending configurations to the user settings.
+    void flushSettings();
+
     // Read config from the directory config json file into a QJsonObject.
     // @path is the directory containing the config json file.
     static QJsonObject readDirectoryConfig(const QString &path);
 
+    // Queue @configJson to be written in the background.
     static bool writeDirectoryConfig(const QString &path, const QJsonObject &configJson);
 
     static bool directoryConfigExist(const QString &path);
@@ -304,6 +313,50 @@ public:
     bool getEnableCodeBlockHighlight() const;
     void setEnableCodeBlockHighlight(bool p_enabled);
 
+    bool getEnableNativeCodeBlockHighlight() const;
+
+    bool getEnableLatencyStats() const;
+    void setEnableLatencyStats(bool p_enabled);
+
+    int getImageCacheSize() const;
+
+    int getLazyLayoutBlockCount() const;
+
+    int getLongLineLength() const;
+
+    int getLongLineHighlightLength() const;
+
+    // In bytes.
+    qint64 getLargeFileSize() const;
+
+    // In bytes.
+    qint64 getReducedFeaturesSize() const;
+
+    // In bytes.
+    qint64 getLiteViewFileSize() const;
+
+    // In bytes.
+    qint64 getPlainTextFileSize() const;
+
+    // Bumped each time a config is set, to invalidate the data derived from
+    // the configs.
+    int getConfigRevision() const;
+
+    int getMarkdownParseThreads() const;
+
+    bool getPrefetchNotebookFolders() const;
+
+    // In bytes.
+    qint64 getPrefetchNoteSize() const;
+
+    bool getWatchNotebookFolders() const;
+
+    int getWebViewPoolSize() const;
+
+    int getExportWebViews() const;
+
+    bool getEnableNativeHtmlExport() const;
+
     bool getEnablePreviewImages() const;
     void setEnablePreviewImages(bool p_enabled);
 
@@ -345,6 +398,10 @@ public:
     bool getEnableSmartImInVimMode() const;
     void setEnableSmartImInVimMode(bool p_enabled);
 
+    bool getCompletionFromOpenedNotes() const;
+
+    bool getCompletionFromNotebook() const;
+
     int getEditorLineNumber() const;
     void setEditorLineNumber(int p_mode);
 
@@ -480,6 +537,9 @@ public:
     // Get the folder c_resourceConfigFolder in the config folder.
     QString getResourceConfigFolder() const;
 
+    // Get the folder c_cacheConfigFolder in the config folder.
+    QString getCacheConfigFolder() const;
+
     const QString &getCommonCssUrl() const;
 
     // All the editor styles.
@@ -494,6 +554,12 @@ public:
     // Return the timer interval for checking file.
     int getFileTimerInterval() const;
 
+    int getTabHibernationInterval() const;
+
+    int getRecycleBinMaxAgeDays() const;
+
+    int getRecycleBinMaxSize() const;
+
     // Get the backup directory.
     const QString &getBackupDirectory() const;
 
@@ -564,7 +630,21 @@ public:
     QStringList getCustomExport() const;
     void setCustomExport(const QStringList &p_exp);
 
+    int getExportMaxProcesses() const;
+
+    int getExportPdfChunkSize() const;
+
+    QString getExportPdfMergeCmd() const;
+
     QStringList getSearchOptions() const;
+
+    // Lower-case suffixes of files to skip mime detection in content search.
+    QStringList getSearchTextSuffixes() const;
+
+    QStringList getSearchExcludePatterns() const;
+
+    // Program of the external grep tool used by the External search engine.
+    QString getExternalSearchTool() const;
     void setSearchOptions(const QStringList &p_opts);
 
     const QString &getPlantUMLServer() const;
@@ -576,9 +656,23 @@ public:
     const QStringList &getPlantUMLArgs() const;
     const QString &getPlantUMLCmd() const;
 
+    int getPlantUMLPipeProcesses() const;
+
     const QString &getGraphvizDot() const;
     void setGraphvizDot(const QString &p_dotPath);
 
+    int getRenderCacheSize() const;
+
+    int getReadModeCacheSize() const;
+
+    bool getPersistReadModeCache() const;
+
+    bool getEnableRenderWorker() const;
+
+    int getMaxRenderProcesses() const;
+
+    int getWebCacheSize() const;
+
     int getNoteListViewOrder() const;
     void setNoteListViewOrder(int p_order);
 
@@ -587,6 +681,10 @@ public:
 
     const QString &getImageNamePrefix() const;
 
+    const QString &getImageSaveFormat() const;
+
+    int getImageSaveQuality() const;
+
     QChar getVimLeaderKey() const;
 
     int getSmartLivePreview() const;
@@ -602,6 +700,8 @@ public:
 
     bool getParsePasteLocalImage() const;
 
+    bool getParsePasteInWebView() const;
+
     bool versionChanged() const;
 
     const QColor &getBaseBackground() const;
@@ -637,6 +737,8 @@ public:
     bool getSyncNoteListToTab() const;
     void setSyncNoteListToTab(bool p_enabled);
 
+    bool getCopyWithHardLinks() const;
+
     QDate getLastUserTrackDate() const;
     void updateLastUserTrackDate();
 
@@ -652,8 +754,17 @@ private:
     QVariant getConfigFromSettings(const QString &section, const QString &key) const;
 
     // Set a config to user settings.
+    // It is written to disk in batch by flushSettings().
     void setConfigToSettings(const QString &section, const QString &key, const QVariant &value);
 
+    // Load the values of VCONFIG_CACHED_KEYS.
+    void loadCachedConfig();
+
+    // Update the cached value if @p_section and @p_key is in VCONFIG_CACHED_KEYS.
+    void updateCachedConfig(const QString &p_section,
+                            const QString &p_key,
+                            const QVariant &p_value);
+
     // Get default config from vnote.ini.
     QVariant getDefaultConfig(const QString &p_section, const QString &p_key) const;
 
@@ -693,6 +804,13 @@ private:
 
     void updateMarkdownEditStyle();
 
+    // Restore the parsed styles of @p_styleStr from the style cache.
+    bool loadMarkdownEditStyleCache(const QString &p_styleStr,
+                                    QMap<QString, QMap<QString, QString>> &p_styles);
+
+    void saveMarkdownEditStyleCache(const QString &p_styleStr,
+                                    const QMap<QString, QMap<QString, QString>> &p_styles) const;
+
     static QString fetchDirConfigFilePath(const QString &p_path);
 
     // Read the [shortcuts] section in settings to init m_shortcuts.
@@ -813,6 +931,33 @@ private:
 
     QString m_graphvizDot;
 
+    // Max size in MiB of the on-disk render cache.
+    int m_renderCacheSize;
+
+    // Minutes after which a background tab is hibernated. 0 to disable.
+    int m_tabHibernationInterval;
+
+    // Days to keep deleted files in the recycle bin. 0 to keep forever.
+    int m_recycleBinMaxAgeDays;
+
+    // Max size in MiB of the recycle bin of each notebook. 0 for no limit.
+    int m_recycleBinMaxSize;
+
+    // Max size in MiB of the in-memory cache of read mode HTML.
+    int m_readModeCacheSize;
+
+    // Whether persist read mode HTML in the render cache.
+    bool m_persistReadModeCache;
+
+    // Whether render Markdown in a Web Worker of the page.
+    bool m_enableRenderWorker;
+
+    // Max number of renderer processes running at the same time.
+    int m_maxRenderProcesses;
+
+    // Size in MB of the disk HTTP cache of the web views.
+    int m_webCacheSize;
+
     // Zoom factor of the QWebEngineView.
     qreal m_webZoomFactor;
 
@@ -860,6 +1005,60 @@ private:
     // Enable colde block syntax highlight.
     bool m_enableCodeBlockHighlight;
 
+    // Highlight code blocks of the supported languages natively.
+    bool m_enableNativeCodeBlockHighlight;
+
+    // Record latency of parse and highlight stages of editors.
+    bool m_enableLatencyStats;
+
+    // Max size in MiB of the evictable preview images of all editors.
+    int m_imageCacheSize;
+
+    // Minimum block count of a note to estimate the height of blocks in edit mode.
+    int m_lazyLayoutBlockCount;
+
+    // Minimum length of a block to only layout its lines in sight in edit mode.
+    int m_longLineLength;
+
+    // Only highlight this number of characters at the start of a long block.
+    // 0 to highlight all.
+    int m_longLineHighlightLength;
+
+    // Minimum size in MiB of a note to open it in large file mode.
+    int m_largeFileSize;
+
+    // Minimum size in MiB of a Markdown note to edit it with reduced features.
+    int m_reducedFeaturesSize;
+
+    // Minimum size in MiB of an external file to read it in a lite tab.
+    int m_liteViewFileSize;
+
+    // Minimum size in MiB of an external Markdown file to open it as plain text.
+    int m_plainTextFileSize;
+
+    // Maximum number of the parses running at the same time.
+    // 0 to decide by the number of the cores.
+    int m_markdownParseThreads;
+
+    // Open all the folders of the current notebook in the background.
+    bool m_prefetchNotebookFolders;
+
+    // Maximum size in MiB of a selected note to read and parse in the
+    // background before it is opened.
+    int m_prefetchNoteSize;
+
+    // Watch the opened folders for changes by others.
+    bool m_watchNotebookFolders;
+
+    // Number of web views to load the Markdown template in advance.
+    int m_webViewPoolSize;
+
+    // Number of web views to load notes concurrently in export.
+    int m_exportWebViews;
+
+    // Export notes to HTML natively without web views if possible.
+    bool m_enableNativeHtmlExport;
+
     // Preview images in edit mode.
     bool m_enablePreviewImages;
 
@@ -896,6 +1095,12 @@ private:
     // Enable smart input method in Vim mode.
     bool m_enableSmartImInVimMode;
 
+    // Complete words from other opened notes.
+    bool m_completionFromOpenedNotes;
+
+    // Complete words from the vocabulary of current notebook.
+    bool m_completionFromNotebook;
+
     // Editor line number mode.
     int m_editorLineNumber;
 
@@ -1066,6 +1271,9 @@ private:
 
     QString m_plantUMLCmd;
 
+    // Number of PlantUML processes in pipe mode.
+    int m_plantUMLPipeProcesses;
+
     // Size of history.
     int m_historySize;
 
@@ -1078,12 +1286,20 @@ private:
     // Whether user has reset the configurations.
     bool m_hasReset;
 
+    int m_configRevision;
+
     // Expanded level of outline.
     int m_outlineExpandedLevel;
 
     // Prefix of the name of inserted images.
     QString m_imageNamePrefix;
 
+    // Format to save the images from clipboard, like png or jpg.
+    QString m_imageSaveFormat;
+
+    // Quality of the lossy image formats, -1 for the default.
+    int m_imageSaveQuality;
+
     // State of MainWindow panel view.
     int m_panelViewState;
 
@@ -1105,6 +1321,9 @@ private:
     // Whether download image from parse and paste.
     bool m_parsePasteLocalImage;
 
+    // Whether convert HTML to Markdown via the web side in parse and paste.
+    bool m_parsePasteInWebView;
+
     // Whether the VNote instance has different version of vnote.ini.
     bool m_versionChanged;
 
@@ -1133,6 +1352,9 @@ private:
     // Whether auto locate to current tab in note list.
     bool m_syncNoteListToCurrentTab;
 
+    // Whether hard link files when copying them if they could not be cloned.
+    bool m_copyWithHardLinks;
+
     // The name of the config file in each directory.
     static const QString c_dirConfigFile;
 
@@ -1145,6 +1367,9 @@ private:
     // The name of the config file for session information.
     static const QString c_sessionConfigFile;
 
+    // The name of the config file for history.
+    static const QString c_historyConfigFile;
+
     // The name of the config file for snippets folder.
     static const QString c_snippetConfigFile;
 
@@ -1154,6 +1379,17 @@ private:
     // QSettings for the user configuration
     QSettings *userSettings;
 
+    // Values of VCONFIG_CACHED_KEYS.
+    VCachedConfig m_cachedConfig;
+
+    // Full key -> value set but not written to userSettings yet.
+    QHash<QString, QVariant> m_pendingSettings;
+
+    mutable QMutex m_pendingMutex;
+
+    // Timer to flush m_pendingSettings.
+    QTimer *m_flushTimer;
+
     // Qsettings for @c_defaultConfigFilePath.
     QSettings *defaultSettings;
 
@@ -1184,6 +1420,9 @@ private:
 
     // The folder name of resource files.
     static const QString c_resourceConfigFolder;
+
+    // The folder name of cache files, which could be deleted safely.
+    static const QString c_cacheConfigFolder;
 };
 
 
@@ -1436,7 +1675,7 @@ inline void VConfigManager::setCurRenderBackgroundColor(const QString &colorName
 
 inline bool VConfigManager::getToolsDockChecked() const
 {
-    return getConfigFromSettings("global", "tools_dock_checked").toBool();
+    return m_cachedConfig.m_toolsDockChecked;
 }
 
 inline void VConfigManager::setToolsDockChecked(bool p_checked)
@@ -1448,7 +1687,7 @@ inline void VConfigManager::setToolsDockChecked(bool p_checked)
 
 inline bool VConfigManager::getSearchDockChecked() const
 {
-    return getConfigFromSettings("global", "search_dock_checked").toBool();
+    return m_cachedConfig.m_searchDockChecked;
 }
 
 inline void VConfigManager::setSearchDockChecked(bool p_checked)
@@ -1692,7 +1931,7 @@ inline qreal VConfigManager::getWebZoomFactor() const
 
 inline bool VConfigManager::isCustomWebZoomFactor()
 {
-    qreal factorFromIni = getConfigFromSettings("global", "web_zoom_factor").toReal();
+    qreal factorFromIni = m_cachedConfig.m_webZoomFactor;
     // -1 indicates let system automatically calculate the factor.
     return factorFromIni > 0;
 }
@@ -1782,6 +2021,11 @@ inline const QString &VConfigManager::getEditorVimReplaceBg() const
     return m_editorVimReplaceBg;
 }
 
+inline bool VConfigManager::getEnableNativeCodeBlockHighlight() const
+{
+    return m_enableNativeCodeBlockHighlight;
+}
+
 inline bool VConfigManager::getEnableCodeBlockHighlight() const
 {
     return m_enableCodeBlockHighlight;
@@ -1797,6 +2041,102 @@ inline void VConfigManager::setEnableCodeBlockHighlight(bool p_enabled)
                         m_enableCodeBlockHighlight);
 }
 
+inline bool VConfigManager::getEnableLatencyStats() const
+{
+    return m_enableLatencyStats;
+}
+
+inline void VConfigManager::setEnableLatencyStats(bool p_enabled)
+{
+    if (m_enableLatencyStats == p_enabled) {
+        return;
+    }
+
+    m_enableLatencyStats = p_enabled;
+    setConfigToSettings("global", "enable_latency_stats",
+                        m_enableLatencyStats);
+}
+
+inline int VConfigManager::getImageCacheSize() const
+{
+    return m_imageCacheSize;
+}
+
+inline int VConfigManager::getLazyLayoutBlockCount() const
+{
+    return m_lazyLayoutBlockCount;
+}
+
+inline int VConfigManager::getLongLineLength() const
+{
+    return m_longLineLength;
+}
+
+inline int VConfigManager::getLongLineHighlightLength() const
+{
+    return m_longLineHighlightLength;
+}
+
+inline qint64 VConfigManager::getLargeFileSize() const
+{
+    return (qint64)m_largeFileSize * 1024 * 1024;
+}
+
+inline qint64 VConfigManager::getReducedFeaturesSize() const
+{
+    return (qint64)m_reducedFeaturesSize * 1024 * 1024;
+}
+
+inline qint64 VConfigManager::getLiteViewFileSize() const
+{
+    return (qint64)m_liteViewFileSize * 1024 * 1024;
+}
+
+inline qint64 VConfigManager::getPlainTextFileSize() const
+{
+    return (qint64)m_plainTextFileSize * 1024 * 1024;
+}
+
+inline int VConfigManager::getConfigRevision() const
+{
+    return m_configRevision;
+}
+
+inline int VConfigManager::getMarkdownParseThreads() const
+{
+    return m_markdownParseThreads;
+}
+
+inline bool VConfigManager::getPrefetchNotebookFolders() const
+{
+    return m_prefetchNotebookFolders;
+}
+
+inline qint64 VConfigManager::getPrefetchNoteSize() const
+{
+    return (qint64)m_prefetchNoteSize * 1024 * 1024;
+}
+
+inline bool VConfigManager::getWatchNotebookFolders() const
+{
+    return m_watchNotebookFolders;
+}
+
+inline int VConfigManager::getWebViewPoolSize() const
+{
+    return m_webViewPoolSize;
+}
+
+inline int VConfigManager::getExportWebViews() const
+{
+    return m_exportWebViews;
+}
+
+inline bool VConfigManager::getEnableNativeHtmlExport() const
+{
+    return m_enableNativeHtmlExport;
+}
+
 inline bool VConfigManager::getEnablePreviewImages() const
 {
     return m_enablePreviewImages;
@@ -1996,6 +2336,16 @@ inline bool VConfigManager::getEnableSmartImInVimMode() const
     return m_enableSmartImInVimMode;
 }
 
+inline bool VConfigManager::getCompletionFromOpenedNotes() const
+{
+    return m_completionFromOpenedNotes;
+}
+
+inline bool VConfigManager::getCompletionFromNotebook() const
+{
+    return m_completionFromNotebook;
+}
+
 inline void VConfigManager::setEnableSmartImInVimMode(bool p_enabled)
 {
     if (m_enableSmartImInVimMode == p_enabled) {
@@ -2323,6 +2673,21 @@ inline int VConfigManager::getFileTimerInterval() const
     return m_fileTimerInterval;
 }
 
+inline int VConfigManager::getTabHibernationInterval() const
+{
+    return m_tabHibernationInterval;
+}
+
+inline int VConfigManager::getRecycleBinMaxAgeDays() const
+{
+    return m_recycleBinMaxAgeDays;
+}
+
+inline int VConfigManager::getRecycleBinMaxSize() const
+{
+    return m_recycleBinMaxSize;
+}
+
 inline const QString &VConfigManager::getBackupDirectory() const
 {
     return m_backupDirectory;
@@ -2335,8 +2700,7 @@ inline const QString &VConfigManager::getBackupExtension() const
 
 inline bool VConfigManager::getEnableBackupFile() const
 {
-    return getConfigFromSettings("global",
-                                 "enable_backup_file").toBool();
+    return m_cachedConfig.m_enableBackupFile;
 }
 
 inline void VConfigManager::setEnableBackupFile(bool p_enabled)
@@ -2440,9 +2804,7 @@ inline bool VConfigManager::getCloseBeforeExternalEditor() const
 
 inline QStringList VConfigManager::getStylesToRemoveWhenCopied() const
 {
-    return  getConfigFromSettings("web",
-                                  "styles_to_remove_when_copied").toStringList();
-
+    return m_cachedConfig.m_stylesToRemoveWhenCopied;
 }
 
 inline const QString &VConfigManager::getStylesToInlineWhenCopied() const
@@ -2452,20 +2814,17 @@ inline const QString &VConfigManager::getStylesToInlineWhenCopied() const
 
 inline QStringList VConfigManager::getCopyTargets() const
 {
-    return getConfigFromSettings("web",
-                                 "copy_targets").toStringList();
+    return m_cachedConfig.m_copyTargets;
 }
 
 inline QString VConfigManager::getStyleOfSpanForMark() const
 {
-    return getConfigFromSettings("web",
-                                 "style_of_span_for_mark").toString();
+    return m_cachedConfig.m_styleOfSpanForMark;
 }
 
 inline bool VConfigManager::getMenuBarChecked() const
 {
-    return getConfigFromSettings("global",
-                                 "menu_bar_checked").toBool();
+    return m_cachedConfig.m_menuBarChecked;
 }
 
 inline void VConfigManager::setMenuBarChecked(bool p_checked)
@@ -2475,8 +2834,7 @@ inline void VConfigManager::setMenuBarChecked(bool p_checked)
 
 inline bool VConfigManager::getToolBarChecked() const
 {
-    return getConfigFromSettings("global",
-                                 "tool_bar_checked").toBool();
+    return m_cachedConfig.m_toolBarChecked;
 }
 
 inline void VConfigManager::setToolBarChecked(bool p_checked)
@@ -2501,14 +2859,12 @@ inline void VConfigManager::setSingleClickClosePreviousTab(bool p_enabled)
 
 inline bool VConfigManager::getEnableWildCardInSimpleSearch() const
 {
-    return getConfigFromSettings("global",
-                                 "enable_wildcard_in_simple_search").toBool();
+    return m_cachedConfig.m_enableWildCardInSimpleSearch;
 }
 
 inline bool VConfigManager::getEnableAutoSave() const
 {
-    return getConfigFromSettings("global",
-                                 "enable_auto_save").toBool();
+    return m_cachedConfig.m_enableAutoSave;
 }
 
 inline void VConfigManager::setEnableAutoSave(bool p_enabled)
@@ -2564,10 +2920,27 @@ inline void VConfigManager::setCustomExport(const QStringList &p_exp)
     setConfigToSettings("export", "custom_export", p_exp);
 }
 
+inline int VConfigManager::getExportMaxProcesses() const
+{
+    return getConfigFromSettings("export",
+                                 "max_processes").toInt();
+}
+
+inline int VConfigManager::getExportPdfChunkSize() const
+{
+    return getConfigFromSettings("export",
+                                 "pdf_chunk_size").toInt();
+}
+
+inline QString VConfigManager::getExportPdfMergeCmd() const
+{
+    return getConfigFromSettings("export",
+                                 "pdf_merge_cmd").toString();
+}
+
 inline QStringList VConfigManager::getSearchOptions() const
 {
-    return getConfigFromSettings("global",
-                                 "search_options").toStringList();
+    return m_cachedConfig.m_searchOptions;
 }
 
 inline void VConfigManager::setSearchOptions(const QStringList &p_opts)
@@ -2575,6 +2948,29 @@ inline void VConfigManager::setSearchOptions(const QStringList &p_opts)
     setConfigToSettings("global", "search_options", p_opts);
 }
 
+inline QString VConfigManager::getExternalSearchTool() const
+{
+    return getConfigFromSettings("global",
+                                 "external_search_tool").toString().trimmed();
+}
+
+inline QStringList VConfigManager::getSearchTextSuffixes() const
+{
+    QStringList suffixes = getConfigFromSettings("global",
+                                                 "search_text_suffix").toStringList();
+    for (auto & suf : suffixes) {
+        suf = suf.trimmed().toLower();
+    }
+
+    suffixes.removeAll(QString());
+    return suffixes;
+}
+
+inline QStringList VConfigManager::getSearchExcludePatterns() const
+{
+    return getConfigFromSettings("global", "search_exclude_patterns").toStringList();
+}
+
 inline const QString &VConfigManager::getPlantUMLServer() const
 {
     return m_plantUMLServer;
@@ -2615,6 +3011,11 @@ inline const QString &VConfigManager::getPlantUMLCmd() const
     return m_plantUMLCmd;
 }
 
+inline int VConfigManager::getPlantUMLPipeProcesses() const
+{
+    return m_plantUMLPipeProcesses;
+}
+
 inline const QString &VConfigManager::getGraphvizDot() const
 {
     return m_graphvizDot;
@@ -2630,6 +3031,36 @@ inline void VConfigManager::setGraphvizDot(const QString &p_dotPath)
     setConfigToSettings("web", "graphviz_dot", p_dotPath);
 }
 
+inline int VConfigManager::getRenderCacheSize() const
+{
+    return m_renderCacheSize;
+}
+
+inline int VConfigManager::getReadModeCacheSize() const
+{
+    return m_readModeCacheSize;
+}
+
+inline bool VConfigManager::getPersistReadModeCache() const
+{
+    return m_persistReadModeCache;
+}
+
+inline bool VConfigManager::getEnableRenderWorker() const
+{
+    return m_enableRenderWorker;
+}
+
+inline int VConfigManager::getMaxRenderProcesses() const
+{
+    return m_maxRenderProcesses;
+}
+
+inline int VConfigManager::getWebCacheSize() const
+{
+    return m_webCacheSize;
+}
+
 inline int VConfigManager::getHistorySize() const
 {
     return m_historySize;
@@ -2698,6 +3129,16 @@ inline const QString &VConfigManager::getImageNamePrefix() const
     return m_imageNamePrefix;
 }
 
+inline const QString &VConfigManager::getImageSaveFormat() const
+{
+    return m_imageSaveFormat;
+}
+
+inline int VConfigManager::getImageSaveQuality() const
+{
+    return m_imageSaveQuality;
+}
+
 inline int VConfigManager::getPanelViewState() const
 {
     return m_panelViewState;
@@ -2815,6 +3256,11 @@ inline bool VConfigManager::getParsePasteLocalImage() const
     return m_parsePasteLocalImage;
 }
 
+inline bool VConfigManager::getParsePasteInWebView() const
+{
+    return m_parsePasteInWebView;
+}
+
 inline bool VConfigManager::versionChanged() const
 {
     return m_versionChanged;
@@ -2959,4 +3405,9 @@ inline void VConfigManager::setSyncNoteListToTab(bool p_enabled)
     m_syncNoteListToCurrentTab = p_enabled;
     setConfigToSettings("global", "sync_note_list_to_current_tab", m_syncNoteListToCurrentTab);
 }
+
+inline bool VConfigManager::getCopyWithHardLinks() const
+{
+    return m_copyWithHardLinks;
+}
 #endif // VCONFIGMANAGER_H
@@ -10,7 +10,7 @@ typedef unsigned long long TimeStamp;
 // Markdown: Markdown text file;
 // List: Infinite list file like WorkFlowy;
 // Container: a composite file containing multiple files;
-enum class DocType { Html = 0, Markdown, List, Container, Unknown };
+enum class DocType { Html = 0, Markdown, List, Container, Text, Unknown };
 
 // Note: note file managed by VNote;
 // Orphan: external file;
@@ -62,6 +62,7 @@ namespace DirConfig
     static const QString c_files = "files";
     static const QString c_attachments = "attachments";
     static const QString c_imageFolder = "image_folder";
+    static const QString c_contentAddressedImages = "content_addressed_images";
     static const QString c_attachmentFolder = "attachment_folder";
     static const QString c_recycleBinFolder = "recycle_bin_folder";
     static const QString c_tags = "tags";
@@ -0,0 +1,68 @@
+#include "vdiagramcache.h"
+
+#include <QHash>
+#include <QByteArray>
+#include <QCryptographicHash>
+
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Max characters of the cached HTML, beyond which the cache is cleared.
+#define MAX_DIAGRAM_CACHE_SIZE (32 * 1024 * 1024)
+
+namespace
+{
+QHash<QByteArray, QString> s_diagrams;
+
+qint64 s_diagramsSize = 0;
+}
+
+QByteArray VDiagramCache::key(const QString &p_lang, const QString &p_text)
+{
+    // The rendering depends on the styles.
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(p_lang.toUtf8());
+    hash.addData("\n", 1);
+    hash.addData(g_config->getCssStyleUrl().toUtf8());
+    hash.addData("\n", 1);
+    hash.addData(g_config->getMermaidCssStyleUrl().toUtf8());
+    hash.addData("\n", 1);
+    hash.addData(p_text.toUtf8());
+    return hash.result();
+}
+
+QString VDiagramCache::find(const QString &p_lang, const QString &p_text)
+{
+    if (s_diagrams.isEmpty()) {
+        return QString();
+    }
+
+    return s_diagrams.value(key(p_lang, p_text));
+}
+
+void VDiagramCache::insert(const QString &p_lang, const QString &p_text, const QString &p_html)
+{
+    if (p_html.isEmpty() || p_html.size() > MAX_DIAGRAM_CACHE_SIZE) {
+        return;
+    }
+
+    if (s_diagramsSize + p_html.size() > MAX_DIAGRAM_CACHE_SIZE) {
+        s_diagrams.clear();
+        s_diagramsSize = 0;
+    }
+
+    QString &html = s_diagrams[key(p_lang, p_text)];
+    s_diagramsSize += p_html.size() - html.size();
+    html = p_html;
+}
+
+bool VDiagramCache::isEmpty()
+{
+    return s_diagrams.isEmpty();
+}
+
+qint64 VDiagramCache::totalBytes()
+{
+    return s_diagramsSize * (qint64)sizeof(QChar);
+}
@@ -0,0 +1,28 @@
+#ifndef VDIAGRAMCACHE_H
+#define VDIAGRAMCACHE_H
+
+#include <QString>
+
+// Process-wide cache of the diagrams rendered by the web side, such as
+// Mermaid, flowchart.js and WaveDrom, keyed by the language, the source and
+// the rendering style. It is shared by the previews and the exporter so the
+// same diagram is rendered only once.
+// Should be accessed only in the GUI thread.
+class VDiagramCache
+{
+public:
+    // Rendered HTML of diagram @p_text in @p_lang, or empty if not cached.
+    static QString find(const QString &p_lang, const QString &p_text);
+
+    static void insert(const QString &p_lang, const QString &p_text, const QString &p_html);
+
+    static bool isEmpty();
+
+    // Bytes of the cached HTML.
+    static qint64 totalBytes();
+
+private:
+    static QByteArray key(const QString &p_lang, const QString &p_text);
+};
+
+#endif // VDIAGRAMCACHE_H
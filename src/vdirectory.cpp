@@ -5,10 +5,80 @@
 #include <QDebug>
 #include "vconfigmanager.h"
 #include "vnotefile.h"
+#include "vnotebooksnapshot.h"
+#include "vdirectoryconfigwriter.h"
+#include "vnotebookwatcher.h"
+#include "vtagindex.h"
+#include "vpathindex.h"
+#include "vrecyclebin.h"
+#include "vsearch.h"
 #include "utils/vutils.h"
 
 extern VConfigManager *g_config;
 
+template <typename T>
+static void addToNameIndex(QHash<QString, QVector<T *>> &p_index, T *p_item)
+{
+    p_index[p_item->getName().toLower()].append(p_item);
+}
+
+template <typename T>
+static void removeFromNameIndex(QHash<QString, QVector<T *>> &p_index,
+                                T *p_item,
+                                const QString &p_name)
+{
+    auto it = p_index.find(p_name.toLower());
+    if (it == p_index.end()) {
+        return;
+    }
+
+    it.value().removeOne(p_item);
+    if (it.value().isEmpty()) {
+        p_index.erase(it);
+    }
+}
+
+// Returns the first item in @p_items matching @p_name, like a linear scan.
+template <typename T>
+static T *findInNameIndex(const QHash<QString, QVector<T *>> &p_index,
+                          const QVector<T *> &p_items,
+                          const QString &p_name,
+                          bool p_caseSensitive)
+{
+    auto it = p_index.constFind(p_name.toLower());
+    if (it == p_index.constEnd()) {
+        return NULL;
+    }
+
+    const QVector<T *> &candidates = it.value();
+    if (p_caseSensitive) {
+        for (auto item : candidates) {
+            if (item->getName() == p_name) {
+                return item;
+            }
+        }
+
+        return NULL;
+    }
+
+    if (candidates.size() == 1) {
+        return candidates.first();
+    }
+
+    // Names differing only in case.
+    T *ret = NULL;
+    int retIdx = -1;
+    for (auto item : candidates) {
+        int idx = p_items.indexOf(item);
+        if (retIdx == -1 || idx < retIdx) {
+            ret = item;
+            retIdx = idx;
+        }
+    }
+
+    return ret;
+}
+
 VDirectory::VDirectory(VNotebook *p_notebook,
                        VDirectory *p_parent,
                        const QString &p_name,
@@ -16,6 +86,10 @@ VDirectory::VDirectory(VNotebook *p_notebook,
     : QObject(p_parent),
       m_notebook(p_notebook),
       m_name(p_name),
+      m_nameIndexValid(false),
+      m_revision(0),
+      m_configBatchDepth(0),
+      m_configWriteDeferred(false),
       m_opened(false),
       m_expanded(false),
       m_createdTimeUtc(p_createdTimeUtc)
@@ -28,21 +102,30 @@ bool VDirectory::open()
         return true;
     }
 
-    V_ASSERT(m_subDirs.isEmpty() && m_files.isEmpty());
-
     QString path = fetchPath();
-    QJsonObject configJson = VConfigManager::readDirectoryConfig(path);
+    QJsonObject configJson = m_notebook->getSnapshot()->readDirectoryConfig(path);
     if (configJson.isEmpty()) {
         qWarning() << "invalid directory configuration in path" << path;
         return false;
     }
 
+    return open(configJson);
+}
+
+bool VDirectory::open(const QJsonObject &p_configJson)
+{
+    if (m_opened) {
+        return true;
+    }
+
+    V_ASSERT(m_subDirs.isEmpty() && m_files.isEmpty());
+
     // created_time
-    m_createdTimeUtc = QDateTime::fromString(configJson[DirConfig::c_createdTime].toString(),
+    m_createdTimeUtc = QDateTime::fromString(p_configJson[DirConfig::c_createdTime].toString(),
                                              Qt::ISODate);
 
     // [sub_directories] section
-    QJsonArray dirJson = configJson[DirConfig::c_subDirectories].toArray();
+    QJsonArray dirJson = p_configJson[DirConfig::c_subDirectories].toArray();
     for (int i = 0; i < dirJson.size(); ++i) {
         QJsonObject dirItem = dirJson[i].toObject();
         VDirectory *dir = new VDirectory(m_notebook, this, dirItem[DirConfig::c_name].toString());
@@ -50,7 +133,7 @@ bool VDirectory::open()
     }
 
     // [files] section
-    QJsonArray fileJson = configJson[DirConfig::c_files].toArray();
+    QJsonArray fileJson = p_configJson[DirConfig::c_files].toArray();
     for (int i = 0; i < fileJson.size(); ++i) {
         QJsonObject fileItem = fileJson[i].toObject();
         VNoteFile *file = VNoteFile::fromJson(this,
@@ -58,9 +141,14 @@ bool VDirectory::open()
                                               FileType::Note,
                                               true);
         m_files.append(file);
+        m_notebook->getTagIndex()->setNoteTags(file->fetchRelativePath(), file->getTags());
     }
 
     m_opened = true;
+    ++m_revision;
+    invalidateNode();
+
+    VNotebookWatcher::inst()->watchDirectory(this);
     return true;
 }
 
@@ -70,6 +158,8 @@ void VDirectory::close()
         return;
     }
 
+    VNotebookWatcher::inst()->unwatchDirectory(this);
+
     for (int i = 0; i < m_subDirs.size(); ++i) {
         VDirectory *dir = m_subDirs[i];
         dir->close();
@@ -84,7 +174,13 @@ void VDirectory::close()
     }
     m_files.clear();
 
+    m_subDirsByName.clear();
+    m_filesByName.clear();
+    m_nameIndexValid = false;
+
     m_opened = false;
+    ++m_revision;
+    invalidateNode();
 }
 
 QString VDirectory::fetchBasePath() const
@@ -152,6 +248,13 @@ bool VDirectory::readConfig()
 
 bool VDirectory::writeToConfig() const
 {
+    invalidateNode();
+
+    if (m_configBatchDepth > 0) {
+        m_configWriteDeferred = true;
+        return true;
+    }
+
     QJsonObject json = toConfigJson();
 
     if (!getParentDirectory()) {
@@ -170,9 +273,55 @@ bool VDirectory::updateFileConfig(const VNoteFile *p_file)
     return writeToConfig();
 }
 
+void VDirectory::beginConfigBatch()
+{
+    ++m_configBatchDepth;
+}
+
+bool VDirectory::endConfigBatch()
+{
+    Q_ASSERT(m_configBatchDepth > 0);
+    if (--m_configBatchDepth > 0 || !m_configWriteDeferred) {
+        return true;
+    }
+
+    m_configWriteDeferred = false;
+    return writeToConfig();
+}
+
 bool VDirectory::writeToConfig(const QJsonObject &p_json) const
 {
-    return VConfigManager::writeDirectoryConfig(fetchPath(), p_json);
+    QString path = fetchPath();
+    m_notebook->getSnapshot()->invalidate(path);
+    return VConfigManager::writeDirectoryConfig(path, p_json);
+}
+
+VDirectoryNodePtr VDirectory::getNode() const
+{
+    if (!m_opened) {
+        return VDirectoryNodePtr();
+    }
+
+    if (!m_node) {
+        QHash<QString, VDirectoryNodePtr> subDirs;
+        for (auto const & dir : m_subDirs) {
+            VDirectoryNodePtr node = dir->getNode();
+            if (node) {
+                subDirs.insert(dir->getName(), node);
+            }
+        }
+
+        m_node.reset(new VDirectoryNode(m_name, toConfigJson(), subDirs));
+    }
+
+    return m_node;
+}
+
+void VDirectory::invalidateNode() const
+{
+    for (const VDirectory *dir = this; dir; dir = dir->getParentDirectory()) {
+        dir->m_node.clear();
+    }
 }
 
 void VDirectory::addNotebookConfig(QJsonObject &p_json) const
@@ -199,6 +348,7 @@ VDirectory *VDirectory::createSubDirectory(const QString &p_name,
     }
 
     QDir dir(fetchPath());
+    VRecycleBin::waitFor(dir.filePath(p_name));
     if (dir.exists(p_name)) {
         VUtils::addErrMsg(p_errMsg, tr("%1 already exists in directory %2.")
                                       .arg(p_name)
@@ -236,6 +386,9 @@ VDirectory *VDirectory::createSubDirectory(const QString &p_name,
         return NULL;
     }
 
+    indexSubDirectory(ret);
+    VPathIndex::inst()->addEntry(m_notebook, ret->fetchRelativePath(), true);
+
     return ret;
 }
 
@@ -245,14 +398,8 @@ VDirectory *VDirectory::findSubDirectory(const QString &p_name, bool p_caseSensi
         return NULL;
     }
 
-    QString name = p_caseSensitive ? p_name : p_name.toLower();
-    for (int i = 0; i < m_subDirs.size(); ++i) {
-        if (name == (p_caseSensitive ? m_subDirs[i]->getName() : m_subDirs[i]->getName().toLower())) {
-            return m_subDirs[i];
-        }
-    }
-
-    return NULL;
+    buildNameIndex();
+    return findInNameIndex(m_subDirsByName, m_subDirs, p_name, p_caseSensitive);
 }
 
 VNoteFile *VDirectory::findFile(const QString &p_name, bool p_caseSensitive)
@@ -261,14 +408,81 @@ VNoteFile *VDirectory::findFile(const QString &p_name, bool p_caseSensitive)
         return NULL;
     }
 
-    QString name = p_caseSensitive ? p_name : p_name.toLower();
-    for (int i = 0; i < m_files.size(); ++i) {
-        if (name == (p_caseSensitive ? m_files[i]->getName() : m_files[i]->getName().toLower())) {
-            return m_files[i];
-        }
+    buildNameIndex();
+    return findInNameIndex(m_filesByName, m_files, p_name, p_caseSensitive);
+}
+
+void VDirectory::buildNameIndex()
+{
+    if (m_nameIndexValid) {
+        return;
     }
 
-    return NULL;
+    m_subDirsByName.clear();
+    m_subDirsByName.reserve(m_subDirs.size());
+    for (auto dir : m_subDirs) {
+        addToNameIndex(m_subDirsByName, dir);
+    }
+
+    m_filesByName.clear();
+    m_filesByName.reserve(m_files.size());
+    for (auto file : m_files) {
+        addToNameIndex(m_filesByName, file);
+    }
+
+    m_nameIndexValid = true;
+}
+
+void VDirectory::indexSubDirectory(VDirectory *p_dir)
+{
+    ++m_revision;
+    VSearchRefiner::notesChanged();
+
+    if (m_nameIndexValid) {
+        addToNameIndex(m_subDirsByName, p_dir);
+    }
+}
+
+void VDirectory::unindexSubDirectory(VDirectory *p_dir, const QString &p_name)
+{
+    ++m_revision;
+    VSearchRefiner::notesChanged();
+
+    if (m_nameIndexValid) {
+        removeFromNameIndex(m_subDirsByName, p_dir, p_name);
+    }
+}
+
+void VDirectory::indexFile(VNoteFile *p_file)
+{
+    ++m_revision;
+    VSearchRefiner::notesChanged();
+
+    if (m_nameIndexValid) {
+        addToNameIndex(m_filesByName, p_file);
+    }
+}
+
+void VDirectory::unindexFile(VNoteFile *p_file, const QString &p_name)
+{
+    ++m_revision;
+    VSearchRefiner::notesChanged();
+
+    if (m_nameIndexValid) {
+        removeFromNameIndex(m_filesByName, p_file, p_name);
+    }
+}
+
+void VDirectory::subDirectoryRenamed(VDirectory *p_dir, const QString &p_oldName)
+{
+    unindexSubDirectory(p_dir, p_oldName);
+    indexSubDirectory(p_dir);
+}
+
+void VDirectory::fileRenamed(VNoteFile *p_file, const QString &p_oldName)
+{
+    unindexFile(p_file, p_oldName);
+    indexFile(p_file);
 }
 
 bool VDirectory::containsFile(const VFile *p_file) const
@@ -297,6 +511,7 @@ VNoteFile *VDirectory::createFile(const QString &p_name, bool p_front)
     }
 
     QString path = fetchPath();
+    VRecycleBin::waitFor(QDir(path).filePath(p_name));
     QFile file(QDir(path).filePath(p_name));
     if (!file.open(QIODevice::WriteOnly)) {
         qWarning() << "fail to create file" << p_name;
@@ -328,6 +543,9 @@ VNoteFile *VDirectory::createFile(const QString &p_name, bool p_front)
         return NULL;
     }
 
+    indexFile(ret);
+    VPathIndex::inst()->addEntry(m_notebook, ret->fetchRelativePath(), false);
+
     qDebug() << "note" << p_name << "created in folder" << m_name;
 
     return ret;
@@ -355,10 +573,13 @@ bool VDirectory::addFile(VNoteFile *p_file, int p_index)
         return false;
     }
 
+    indexFile(p_file);
     p_file->setParent(this);
 
     // Add tags from this file to the notebook.
     const QStringList &tags = p_file->getTags();
+    m_notebook->getTagIndex()->setNoteTags(p_file->fetchRelativePath(), tags);
+    VPathIndex::inst()->addEntry(m_notebook, p_file->fetchRelativePath(), false);
     for (auto const & tag : tags) {
         m_notebook->addTag(tag);
     }
@@ -415,6 +636,7 @@ bool VDirectory::addSubDirectory(VDirectory *p_dir, int p_index)
         return false;
     }
 
+    indexSubDirectory(p_dir);
     p_dir->setParent(this);
     p_dir->m_notebook = m_notebook;
 
@@ -452,12 +674,15 @@ bool VDirectory::deleteDirectory(bool p_skipRecycleBin, QString *p_errMsg)
     Q_ASSERT(!m_opened);
     Q_ASSERT(parent());
 
-    // Delete the entire directory.
+    // Delete the entire directory in background.
+    // Failures are reported by VRecycleBin::deletionFailed().
     bool ret = true;
     QString dirPath = fetchPath();
-    if (!VUtils::deleteDirectory(m_notebook, dirPath, p_skipRecycleBin)) {
-        VUtils::addErrMsg(p_errMsg, tr("Fail to delete the directory %1.").arg(dirPath));
-        ret = false;
+    VDirectoryConfigWriter::flush();
+    if (p_skipRecycleBin) {
+        VRecycleBin::remove(QStringList() << dirPath);
+    } else {
+        VRecycleBin::recycle(m_notebook->getRecycleBinFolderPath(), QStringList() << dirPath);
     }
 
     return ret;
@@ -472,6 +697,9 @@ bool VDirectory::deleteDirectory(VDirectory *p_dir, bool p_skipRecycleBin, QStri
     QString name = p_dir->getName();
     QString path = p_dir->fetchPath();
 
+    p_dir->getNotebook()->getTagIndex()->removeFolder(p_dir->fetchRelativePath());
+    VPathIndex::inst()->removeEntry(p_dir->getNotebook(), p_dir->fetchRelativePath());
+
     if (!p_dir->deleteDirectory(p_skipRecycleBin, p_errMsg)) {
         ret = false;
     }
@@ -496,6 +724,7 @@ bool VDirectory::removeSubDirectory(VDirectory *p_dir)
     int index = m_subDirs.indexOf(p_dir);
     V_ASSERT(index != -1);
     m_subDirs.remove(index);
+    unindexSubDirectory(p_dir, p_dir->getName());
 
     if (!writeToConfig()) {
         return false;
@@ -506,12 +735,22 @@ bool VDirectory::removeSubDirectory(VDirectory *p_dir)
 
 bool VDirectory::removeFile(VNoteFile *p_file)
 {
-    V_ASSERT(m_opened);
     V_ASSERT(p_file);
+    return removeFiles(QVector<VNoteFile *>(1, p_file));
+}
 
-    int index = m_files.indexOf(p_file);
-    V_ASSERT(index != -1);
-    m_files.remove(index);
+bool VDirectory::removeFiles(const QVector<VNoteFile *> &p_files)
+{
+    V_ASSERT(m_opened);
+
+    for (auto file : p_files) {
+        int index = m_files.indexOf(file);
+        V_ASSERT(index != -1);
+        m_notebook->getTagIndex()->removeNote(file->fetchRelativePath());
+        VPathIndex::inst()->removeEntry(m_notebook, file->fetchRelativePath());
+        m_files.remove(index);
+        unindexFile(file, file->getName());
+    }
 
     if (!writeToConfig()) {
         return false;
@@ -527,10 +766,17 @@ bool VDirectory::rename(const QString &p_name)
     }
 
     QString oldName = m_name;
+    QString oldRelativePath = fetchRelativePath();
 
     VDirectory *parentDir = getParentDirectory();
     V_ASSERT(parentDir);
     // Rename it in disk.
+    if (!VDirectoryConfigWriter::flush()) {
+        qWarning() << "fail to write directory configurations before renaming" << fetchPath();
+        return false;
+    }
+
+    VRecycleBin::flush();
     QDir dir(parentDir->fetchPath());
     if (!dir.rename(m_name, p_name)) {
         qWarning() << "fail to rename folder" << m_name << "to" << p_name << "in disk";
@@ -538,14 +784,27 @@ bool VDirectory::rename(const QString &p_name)
     }
 
     m_name = p_name;
+    invalidateNode();
 
     // Update parent's config file
     if (!parentDir->writeToConfig()) {
         m_name = oldName;
+        invalidateNode();
         dir.rename(p_name, m_name);
         return false;
     }
 
+    parentDir->subDirectoryRenamed(this, oldName);
+
+    m_notebook->getTagIndex()->moveFolder(oldRelativePath, fetchRelativePath());
+    VPathIndex::inst()->moveEntry(m_notebook, oldRelativePath, fetchRelativePath());
+
+    if (m_opened) {
+        // Watch it by the new path.
+        VNotebookWatcher::inst()->unwatchDirectory(this);
+        VNotebookWatcher::inst()->watchDirectory(this);
+    }
+
     qDebug() << "folder renamed from" << oldName << "to" << m_name;
 
     return true;
@@ -556,7 +815,8 @@ bool VDirectory::copyDirectory(VDirectory *p_destDir,
                                VDirectory *p_dir,
                                bool p_isCut,
                                VDirectory **p_targetDir,
-                               QString *p_errMsg)
+                               QString *p_errMsg,
+                               const CopyFunc &p_copyFunc)
 {
     bool ret = true;
     *p_targetDir = NULL;
@@ -579,7 +839,15 @@ bool VDirectory::copyDirectory(VDirectory *p_destDir,
     Q_ASSERT(paDir->isOpened());
 
     // Copy the directory.
-    if (!VUtils::copyDirectory(srcPath, destPath, p_isCut)) {
+    if (!VDirectoryConfigWriter::flush()) {
+        VUtils::addErrMsg(p_errMsg, tr("Fail to write the folder configurations."));
+        return false;
+    }
+
+    VRecycleBin::flush();
+    bool copied = p_copyFunc ? p_copyFunc(srcPath, destPath, p_isCut)
+                             : VUtils::copyDirectory(srcPath, destPath, p_isCut);
+    if (!copied) {
         VUtils::addErrMsg(p_errMsg, tr("Fail to %1 the folder.").arg(opStr));
         qWarning() << "fail to" << opStr << "the folder directory" << srcPath << "to" << destPath;
         return false;
@@ -588,16 +856,32 @@ bool VDirectory::copyDirectory(VDirectory *p_destDir,
     // Add directory to VDirectory.
     VDirectory *destDir = NULL;
     if (p_isCut) {
+        QString oldRelativePath = p_dir->fetchRelativePath();
+        VNotebook *oldNotebook = p_dir->getNotebook();
         paDir->removeSubDirectory(p_dir);
         p_dir->setName(p_destName);
         // Add the directory to new dir's config
         if (p_destDir->addSubDirectory(p_dir, -1)) {
             destDir = p_dir;
+            VNotebook *notebook = destDir->getNotebook();
+            QString relativePath = destDir->fetchRelativePath();
+            if (notebook == oldNotebook) {
+                notebook->getTagIndex()->moveFolder(oldRelativePath, relativePath);
+            } else {
+                oldNotebook->getTagIndex()->removeFolder(oldRelativePath);
+                notebook->getTagIndex()->addFolder(notebook, relativePath);
+            }
+
+            VPathIndex::inst()->moveEntry(oldNotebook, oldRelativePath, notebook, relativePath);
         } else {
             destDir = NULL;
         }
     } else {
         destDir = p_destDir->addSubDirectory(p_destName, -1);
+        if (destDir) {
+            // The whole copied tree is new.
+            VPathIndex::inst()->invalidate(destDir->getNotebook());
+        }
     }
 
     if (!destDir) {
@@ -699,6 +983,8 @@ bool VDirectory::sortFiles(const QVector<int> &p_sortedIdx)
         m_files[i] = ori[p_sortedIdx[i]];
     }
 
+    ++m_revision;
+
     bool ret = true;
     if (!writeToConfig()) {
         qWarning() << "fail to reorder files in config" << p_sortedIdx;
@@ -720,6 +1006,8 @@ bool VDirectory::sortSubDirectories(const QVector<int> &p_sortedIdx)
         m_subDirs[i] = ori[p_sortedIdx[i]];
     }
 
+    ++m_revision;
+
     bool ret = true;
     if (!writeToConfig()) {
         qWarning() << "fail to reorder sub-directories in config" << p_sortedIdx;
@@ -781,65 +1069,3 @@ QStringList VDirectory::collectTags()
 
     return tags;
 }
-
-VDirectory *VDirectory::buildDirectory(const QString &p_path,
-                                       VDirectory *p_parent,
-                                       QString *p_errMsg)
-{
-    VDirectory *ret = new VDirectory(p_parent->getNotebook(),
-                                     p_parent,
-                                     VUtils::directoryNameFromPath(p_path),
-                                     QDateTime::currentDateTimeUtc());
-
-    QDir rootDir(p_path);
-
-    // Process all the folders.
-    QVector<VDirectory *> &subdirs = ret->getSubDirs();
-    QFileInfoList dirList = rootDir.entryInfoList(QDir::AllDirs | QDir::NoDotAndDotDot);
-    for (auto const & sub : dirList) {
-        VDirectory *dir = VDirectory::buildDirectory(sub.absoluteFilePath(),
-                                                     ret,
-                                                     p_errMsg);
-        if (dir) {
-            subdirs.append(dir);
-        }
-    }
-
-    // Process all the files.
-    QVector<VNoteFile *> &files = ret->getFiles();
-    QDateTime dateTime = QDateTime::currentDateTimeUtc();
-    QList<QString> suffixes = g_config->getDocSuffixes()[(int)DocType::Markdown];
-    QStringList filters;
-    for (auto const & suf : suffixes) {
-        filters << ("*." + suf);
-    }
-
-    QStringList fileList = rootDir.entryList(filters, QDir::Files);
-    for (auto const & fileName : fileList) {
-        VNoteFile *file = new VNoteFile(ret,
-                                        fileName,
-                                        FileType::Note,
-                                        true,
-                                        dateTime,
-                                        dateTime);
-        if (!file) {
-            VUtils::addErrMsg(p_errMsg, tr("Skip file %1.").arg(rootDir.absoluteFilePath(fileName)));
-        } else {
-            files.append(file);
-        }
-    }
-
-    if (subdirs.isEmpty() && files.isEmpty()) {
-        delete ret;
-        VUtils::addErrMsg(p_errMsg, tr("Skip folder %1.").arg(p_path));
-        return NULL;
-    }
-
-    if (!ret->writeToConfig()) {
-        delete ret;
-        VUtils::addErrMsg(p_errMsg, tr("Fail to write configuration of folder %1.").arg(p_path));
-        return NULL;
-    }
-
-    return ret;
-}
@@ -4,10 +4,15 @@
 #include <QObject>
 #include <QString>
 #include <QVector>
+#include <QHash>
 #include <QPointer>
 #include <QJsonObject>
 #include <QDateTime>
+
+#include <functional>
+
 #include "vnotebook.h"
+#include "vdirectorynode.h"
 
 class VFile;
 class VNoteFile;
@@ -22,6 +27,10 @@ public:
                QDateTime p_createdTimeUtc = QDateTime());
 
     bool open();
+
+    // Open with configuration @p_configJson read in advance.
+    bool open(const QJsonObject &p_configJson);
+
     void close();
 
     // Create a sub-directory with name @p_name.
@@ -34,6 +43,12 @@ public:
     // Returns the VNoteFile with the name @p_name directly in this directory.
     VNoteFile *findFile(const QString &p_name, bool p_caseSensitive);
 
+    // Update the name index after @p_dir is renamed from @p_oldName.
+    void subDirectoryRenamed(VDirectory *p_dir, const QString &p_oldName);
+
+    // Update the name index after @p_file is renamed from @p_oldName.
+    void fileRenamed(VNoteFile *p_file, const QString &p_oldName);
+
     // If current dir or its sub-dir contains @p_file.
     bool containsFile(const VFile *p_file) const;
 
@@ -43,6 +58,9 @@ public:
     // It won't change the parent of @p_file to enable it find its path.
     bool removeFile(VNoteFile *p_file);
 
+    // Remove files @p_files like removeFile() and write the config once.
+    bool removeFiles(const QVector<VNoteFile *> &p_files);
+
     // Remove the directory in the config and m_subDirs without deleting it in the disk.
     // It won't change the parent of @p_dir to enable it find its path.
     bool removeSubDirectory(VDirectory *p_dir);
@@ -58,14 +76,21 @@ public:
     // Rename current directory to @p_name.
     bool rename(const QString &p_name);
 
+    // Copy or move the directory tree @p_srcPath to @p_destPath in disk.
+    typedef std::function<bool(const QString &p_srcPath,
+                               const QString &p_destPath,
+                               bool p_isCut)> CopyFunc;
+
     // Copy @p_dir as a sub-directory of @p_destDir with the new name @p_destName.
     // Return a directory representing the destination directory after copy/cut.
+    // @p_copyFunc: copy the tree in disk. VUtils::copyDirectory() if empty.
     static bool copyDirectory(VDirectory *p_destDir,
                               const QString &p_destName,
                               VDirectory *p_dir,
                               bool p_isCut,
                               VDirectory **p_targetDir,
-                              QString *p_errMsg = NULL);
+                              QString *p_errMsg = NULL,
+                              const CopyFunc &p_copyFunc = CopyFunc());
 
     const QVector<VDirectory *> &getSubDirs() const;
     QVector<VDirectory *> &getSubDirs();
@@ -105,6 +130,12 @@ public:
     // Write the config of @p_file to config file.
     bool updateFileConfig(const VNoteFile *p_file);
 
+    // Defer the writes to config file until the matching endConfigBatch(),
+    // which writes it once if needed. Could be nested.
+    void beginConfigBatch();
+
+    bool endConfigBatch();
+
     // Try to load file given relative path @p_filePath.
     VNoteFile *tryLoadFile(QStringList &p_filePath);
 
@@ -113,6 +144,16 @@ public:
 
     QDateTime getCreatedTimeUtc() const;
 
+    // Changes when sub-directories or files are added, removed, renamed or
+    // reordered. Used to invalidate data derived from the children.
+    int getRevision() const;
+
+    // Get the immutable snapshot of this directory and its opened
+    // sub-directories for the background workers, rebuilding the nodes
+    // changed since last time. Return null if not opened.
+    // Should be called in the GUI thread.
+    VDirectoryNodePtr getNode() const;
+
     // Reorder files in m_files by index.
     bool sortFiles(const QVector<int> &p_sortedIdx);
 
@@ -130,10 +171,6 @@ public:
                                 bool p_skipRecycleBin = false,
                                 QString *p_errMsg = NULL);
 
-    static VDirectory *buildDirectory(const QString &p_path,
-                                      VDirectory *p_parent,
-                                      QString *p_errMsg);
-
 private:
     // Get the path of @p_dir recursively
     QString fetchPath(const VDirectory *p_dir) const;
@@ -154,9 +191,23 @@ private:
     // Add the directory in the config and m_subDirs. If @p_index is -1, add it at the end.
     bool addSubDirectory(VDirectory *p_dir, int p_index);
 
-    // Delete this directory in disk.
+    // Queue deleting this directory in disk.
     bool deleteDirectory(bool p_skipRecycleBin = false, QString *p_errMsg = NULL);
 
+    // Build the name index if not yet.
+    void buildNameIndex();
+
+    void indexSubDirectory(VDirectory *p_dir);
+
+    void unindexSubDirectory(VDirectory *p_dir, const QString &p_name);
+
+    void indexFile(VNoteFile *p_file);
+
+    void unindexFile(VNoteFile *p_file, const QString &p_name);
+
+    // Drop the nodes of this directory and its ancestors after it changes.
+    void invalidateNode() const;
+
     // Notebook containing this folder.
     QPointer<VNotebook> m_notebook;
 
@@ -169,6 +220,23 @@ private:
     // Owner of the files
     QVector<VNoteFile *> m_files;
 
+    // Lower-case name -> sub-directories and files, to look up children by name.
+    // Built on demand and kept in sync with @m_subDirs and @m_files.
+    QHash<QString, QVector<VDirectory *>> m_subDirsByName;
+
+    QHash<QString, QVector<VNoteFile *>> m_filesByName;
+
+    bool m_nameIndexValid;
+
+    // Increased whenever sub-directories or files change.
+    int m_revision;
+
+    // Depth of beginConfigBatch().
+    int m_configBatchDepth;
+
+    // Whether a write to config file is deferred by the batch.
+    mutable bool m_configWriteDeferred;
+
     // Whether the directory has been opened.
     bool m_opened;
 
@@ -178,6 +246,9 @@ private:
     // UTC time when creating this directory.
     // Loaded after open().
     QDateTime m_createdTimeUtc;
+
+    // Snapshot of this directory. Null if changed since built.
+    mutable VDirectoryNodePtr m_node;
 };
 
 inline const QVector<VDirectory *> &VDirectory::getSubDirs() const
@@ -198,6 +269,7 @@ inline const QString &VDirectory::getName() const
 inline void VDirectory::setName(const QString &p_name)
 {
     m_name = p_name;
+    invalidateNode();
 }
 
 inline bool VDirectory::isOpened() const
@@ -205,6 +277,11 @@ inline bool VDirectory::isOpened() const
     return m_opened;
 }
 
+inline int VDirectory::getRevision() const
+{
+    return m_revision;
+}
+
 inline VDirectory *VDirectory::getParentDirectory()
 {
     return (VDirectory *)this->parent();
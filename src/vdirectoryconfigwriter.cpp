@@ -0,0 +1,187 @@
+#include "vdirectoryconfigwriter.h"
+
+#include <QDebug>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QJsonDocument>
+
+// Delay in ms to coalesce the writes.
+#define WRITE_DELAY 500
+
+// Times to write a configuration before giving it up.
+#define MAX_WRITE_TRIES 3
+
+class DirectoryConfigWriteTask : public QRunnable
+{
+public:
+    explicit DirectoryConfigWriteTask(VDirectoryConfigWriter *p_writer)
+        : m_writer(p_writer)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_writer->writePending();
+    }
+
+private:
+    VDirectoryConfigWriter *m_writer;
+};
+
+
+VDirectoryConfigWriter::VDirectoryConfigWriter()
+    : m_flushRequested(false),
+      m_scheduled(false),
+      m_seq(0),
+      m_writeFailed(false)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+VDirectoryConfigWriter::~VDirectoryConfigWriter()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_flushRequested = true;
+        m_flushCond.wakeAll();
+    }
+
+    m_pool.waitForDone();
+}
+
+VDirectoryConfigWriter *VDirectoryConfigWriter::inst()
+{
+    static VDirectoryConfigWriter writer;
+    return &writer;
+}
+
+void VDirectoryConfigWriter::write(const QString &p_file, const QJsonObject &p_json)
+{
+    VDirectoryConfigWriter *writer = inst();
+
+    QMutexLocker locker(&writer->m_mutex);
+    writer->m_pending.insert(p_file, Entry(p_json, ++writer->m_seq));
+    if (!writer->m_scheduled) {
+        writer->m_scheduled = true;
+        writer->m_pool.start(new DirectoryConfigWriteTask(writer));
+    }
+}
+
+bool VDirectoryConfigWriter::read(const QString &p_file, QJsonObject &p_json)
+{
+    VDirectoryConfigWriter *writer = inst();
+
+    QMutexLocker locker(&writer->m_mutex);
+    auto it = writer->m_pending.constFind(p_file);
+    if (it == writer->m_pending.constEnd()) {
+        return false;
+    }
+
+    p_json = it.value().m_json;
+    return true;
+}
+
+bool VDirectoryConfigWriter::isPending(const QString &p_file)
+{
+    VDirectoryConfigWriter *writer = inst();
+
+    QMutexLocker locker(&writer->m_mutex);
+    return writer->m_pending.contains(p_file);
+}
+
+bool VDirectoryConfigWriter::isWrittenByUs(const QString &p_file, qint64 p_modified, qint64 p_size)
+{
+    VDirectoryConfigWriter *writer = inst();
+
+    QMutexLocker locker(&writer->m_mutex);
+    auto it = writer->m_writtenStats.constFind(p_file);
+    return it != writer->m_writtenStats.constEnd()
+           && it.value().first == p_modified
+           && it.value().second == p_size;
+}
+
+bool VDirectoryConfigWriter::flush()
+{
+    VDirectoryConfigWriter *writer = inst();
+
+    {
+        QMutexLocker locker(&writer->m_mutex);
+        writer->m_flushRequested = true;
+        writer->m_writeFailed = false;
+        writer->m_flushCond.wakeAll();
+    }
+
+    writer->m_pool.waitForDone();
+
+    QMutexLocker locker(&writer->m_mutex);
+    writer->m_flushRequested = false;
+    return !writer->m_writeFailed;
+}
+
+void VDirectoryConfigWriter::writePending()
+{
+    QHash<QString, Entry> pending;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_flushRequested) {
+            m_flushCond.wait(&m_mutex, WRITE_DELAY);
+        }
+
+        // Writes from now on will queue another task.
+        m_scheduled = false;
+        pending = m_pending;
+    }
+
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        bool written = writeFile(it.key(), it.value().m_json);
+
+        QMutexLocker locker(&m_mutex);
+        if (written) {
+            // Tell our own writes from others' for the watcher.
+            QFileInfo info(it.key());
+            m_writtenStats.insert(it.key(),
+                                  qMakePair(info.lastModified().toMSecsSinceEpoch(), info.size()));
+        }
+
+        // Keep it pending if it is overwritten during writing.
+        auto pit = m_pending.find(it.key());
+        if (pit == m_pending.end() || pit.value().m_seq != it.value().m_seq) {
+            continue;
+        }
+
+        if (written) {
+            m_pending.erase(pit);
+        } else if (++pit.value().m_failures >= MAX_WRITE_TRIES) {
+            qWarning() << "give up writing directory configuration file:" << it.key();
+            m_pending.erase(pit);
+            m_writeFailed = true;
+        } else {
+            // Retry it after the delay.
+            if (!m_scheduled) {
+                m_scheduled = true;
+                m_pool.start(new DirectoryConfigWriteTask(this));
+            }
+        }
+    }
+}
+
+bool VDirectoryConfigWriter::writeFile(const QString &p_file, const QJsonObject &p_json)
+{
+    QSaveFile config(p_file);
+    // We use Unix LF for config file.
+    if (!config.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open directory configuration file for write:"
+                   << p_file;
+        return false;
+    }
+
+    config.write(QJsonDocument(p_json).toJson(QJsonDocument::Compact));
+    if (!config.commit()) {
+        qWarning() << "fail to write directory configuration file:" << p_file;
+        return false;
+    }
+
+    return true;
+}
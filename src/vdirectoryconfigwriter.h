@@ -0,0 +1,102 @@
+#ifndef VDIRECTORYCONFIGWRITER_H
+#define VDIRECTORYCONFIGWRITER_H
+
+#include <QString>
+#include <QHash>
+#include <QPair>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QJsonObject>
+#include <QThreadPool>
+
+// Write-behind queue of the directory configuration files.
+// Writes to the same file within a short delay are coalesced into one, which
+// is written in compact JSON on a worker and replaces the file atomically.
+// Pending configurations are returned by read() before they reach the disk.
+// Failed writes are kept pending and retried a few times before given up.
+// Thread-safe.
+class VDirectoryConfigWriter
+{
+public:
+    ~VDirectoryConfigWriter();
+
+    // Queue @p_json to be written to configuration file @p_file.
+    static void write(const QString &p_file, const QJsonObject &p_json);
+
+    // Return true and fill @p_json if @p_file has a pending write.
+    static bool read(const QString &p_file, QJsonObject &p_json);
+
+    // Whether @p_file has a pending write.
+    static bool isPending(const QString &p_file);
+
+    // Whether @p_file with modified time @p_modified (msecs since epoch) and
+    // @p_size on disk is the one written last by us.
+    static bool isWrittenByUs(const QString &p_file, qint64 p_modified, qint64 p_size);
+
+    // Write all the pending configurations and wait for them.
+    // Should be called before moving or deleting directories on disk.
+    // Return false if any write is given up during the flush.
+    static bool flush();
+
+private:
+    friend class DirectoryConfigWriteTask;
+
+    struct Entry
+    {
+        Entry()
+            : m_seq(0),
+              m_failures(0)
+        {
+        }
+
+        Entry(const QJsonObject &p_json, quint64 p_seq)
+            : m_json(p_json),
+              m_seq(p_seq),
+              m_failures(0)
+        {
+        }
+
+        QJsonObject m_json;
+
+        // Sequence number to tell whether it is overwritten during writing.
+        quint64 m_seq;
+
+        // Number of failed writes.
+        int m_failures;
+    };
+
+    VDirectoryConfigWriter();
+
+    static VDirectoryConfigWriter *inst();
+
+    // Wait for the delay and write the pending configurations.
+    // Called on the worker.
+    void writePending();
+
+    static bool writeFile(const QString &p_file, const QJsonObject &p_json);
+
+    QThreadPool m_pool;
+
+    QMutex m_mutex;
+
+    // Wake the waiting worker to write at once.
+    QWaitCondition m_flushCond;
+
+    bool m_flushRequested;
+
+    // Whether a write task is queued.
+    bool m_scheduled;
+
+    quint64 m_seq;
+
+    // Whether any write is given up since the flush started.
+    bool m_writeFailed;
+
+    // Configuration file path -> pending config.
+    QHash<QString, Entry> m_pending;
+
+    // Configuration file path -> modified time and size after our last write.
+    QHash<QString, QPair<qint64, qint64>> m_writtenStats;
+};
+
+#endif // VDIRECTORYCONFIGWRITER_H
@@ -0,0 +1,199 @@
+#include "vdirectorycopier.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThreadPool>
+
+// Bytes copied between two progress updates.
+#define PROGRESS_STEP (4 * 1024 * 1024)
+
+// Max number of workers copying files at the same time.
+#define MAX_COPY_WORKERS 4
+
+class VDirectoryCopyTask : public QRunnable
+{
+public:
+    explicit VDirectoryCopyTask(VDirectoryCopier *p_copier)
+        : m_copier(p_copier)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_copier->runJobs();
+    }
+
+private:
+    VDirectoryCopier *m_copier;
+};
+
+
+VDirectoryCopier::VDirectoryCopier(const QString &p_srcDir,
+                                   const QString &p_destDir,
+                                   bool p_isCut,
+                                   QObject *p_parent)
+    : QThread(p_parent),
+      m_srcDir(QDir::cleanPath(p_srcDir)),
+      m_destDir(QDir::cleanPath(p_destDir)),
+      m_isCut(p_isCut),
+      m_stop(0),
+      m_failed(0),
+      m_succeeded(false),
+      m_nextJob(0),
+      m_totalBytes(0),
+      m_copiedBytes(0),
+      m_lastReported(0)
+{
+}
+
+void VDirectoryCopier::stop()
+{
+    m_stop.store(1);
+}
+
+void VDirectoryCopier::run()
+{
+    m_succeeded = false;
+    if (m_srcDir == m_destDir) {
+        m_succeeded = true;
+        return;
+    }
+
+    if (QFileInfo::exists(m_destDir)) {
+        qWarning() << "target directory already exists" << m_destDir;
+        return;
+    }
+
+    // QDir::rename() could not move directory across drives.
+    if (m_isCut && QDir().rename(m_srcDir, m_destDir)) {
+        m_succeeded = true;
+        return;
+    }
+
+    bool ret = prepare();
+    if (ret && !isStopped()) {
+        emit progressUpdated(0, m_totalBytes);
+
+        QThreadPool pool;
+        int nrWorkers = qBound(1, QThread::idealThreadCount(), MAX_COPY_WORKERS);
+        nrWorkers = qMin(nrWorkers, m_jobs.size());
+        pool.setMaxThreadCount(qMax(nrWorkers, 1));
+        for (int i = 0; i < nrWorkers; ++i) {
+            pool.start(new VDirectoryCopyTask(this));
+        }
+
+        pool.waitForDone();
+
+        ret = m_failed.load() == 0;
+    }
+
+    if (!ret || isStopped()) {
+        // Clean up what we have copied.
+        if (!QDir(m_destDir).removeRecursively()) {
+            qWarning() << "fail to clean up target directory" << m_destDir;
+        }
+
+        return;
+    }
+
+    if (m_isCut && !QDir(m_srcDir).removeRecursively()) {
+        qWarning() << "fail to delete source directory after cut" << m_srcDir;
+        return;
+    }
+
+    emit progressUpdated(m_totalBytes, m_totalBytes);
+    m_succeeded = true;
+}
+
+bool VDirectoryCopier::prepare()
+{
+    QDir srcDir(m_srcDir);
+    if (!srcDir.exists()) {
+        qWarning() << "source directory does not exist" << m_srcDir;
+        return false;
+    }
+
+    QStringList dirs;
+    dirs << QString();
+
+    QDirIterator it(m_srcDir,
+                    QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoSymLinks | QDir::NoDotAndDotDot,
+                    QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        if (isStopped()) {
+            return false;
+        }
+
+        it.next();
+        const QFileInfo &fi = it.fileInfo();
+        QString relativePath = srcDir.relativeFilePath(fi.absoluteFilePath());
+        if (fi.isDir()) {
+            dirs << relativePath;
+        } else {
+            m_jobs.append(VFileCopier::Job(fi.absoluteFilePath(),
+                                           QDir(m_destDir).filePath(relativePath),
+                                           false,
+                                           false));
+            m_totalBytes += fi.size();
+        }
+    }
+
+    QDir destDir(m_destDir);
+    for (auto const & dir : dirs) {
+        QString path = dir.isEmpty() ? m_destDir : destDir.filePath(dir);
+        if (!destDir.mkpath(path)) {
+            qWarning() << "fail to create directory" << path;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void VDirectoryCopier::runJobs()
+{
+    while (!isStopped() && m_failed.load() == 0) {
+        int idx = m_nextJob.fetchAndAddOrdered(1);
+        if (idx >= m_jobs.size()) {
+            break;
+        }
+
+        VFileCopier::Job &job = m_jobs[idx];
+        qint64 reported = 0;
+        job.m_succeeded = VFileCopier::copyFile(job, [this, &reported](qint64 p_copied, qint64 p_total) {
+            Q_UNUSED(p_total);
+            addCopied(p_copied - reported);
+            reported = p_copied;
+            return !isStopped();
+        });
+
+        if (!job.m_succeeded) {
+            if (!isStopped()) {
+                qWarning() << "fail to copy file" << job.m_srcFile << job.m_destFile;
+                m_failed.store(1);
+            }
+
+            break;
+        }
+
+        // Cloned or linked files report no progress.
+        addCopied(QFileInfo(job.m_destFile).size() - reported);
+    }
+}
+
+void VDirectoryCopier::addCopied(qint64 p_delta)
+{
+    if (p_delta <= 0) {
+        return;
+    }
+
+    QMutexLocker locker(&m_progressMutex);
+    m_copiedBytes += p_delta;
+    if (m_copiedBytes - m_lastReported >= PROGRESS_STEP) {
+        m_lastReported = m_copiedBytes;
+        emit progressUpdated(m_copiedBytes, m_totalBytes);
+    }
+}
@@ -0,0 +1,92 @@
+#ifndef VDIRECTORYCOPIER_H
+#define VDIRECTORYCOPIER_H
+
+#include <QThread>
+#include <QVector>
+#include <QString>
+#include <QMutex>
+#include <QAtomicInt>
+
+#include "utils/vfilecopier.h"
+
+// Copy or move a directory tree in background.
+// The tree is enumerated first, then its files are copied by a bounded number
+// of workers via VFileCopier, which clones them when the file system supports
+// it. A move within one file system is a rename. Otherwise the source is
+// removed only after all the files are copied.
+// Once stopped or failed, the target tree is removed and the source is kept.
+class VDirectoryCopier : public QThread
+{
+    Q_OBJECT
+public:
+    VDirectoryCopier(const QString &p_srcDir,
+                     const QString &p_destDir,
+                     bool p_isCut,
+                     QObject *p_parent = nullptr);
+
+    void stop();
+
+    bool isStopped() const;
+
+    // Valid after finished.
+    bool isSucceeded() const;
+
+signals:
+    // @p_copied: bytes copied of all the files.
+    // @p_total: total bytes of the files enumerated.
+    void progressUpdated(qint64 p_copied, qint64 p_total);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    friend class VDirectoryCopyTask;
+
+    // Enumerate the tree and create the directories of the target tree.
+    bool prepare();
+
+    // Run the jobs from @m_nextJob until none left.
+    // Called on the workers.
+    void runJobs();
+
+    // Add @p_delta bytes to the copied ones and report the progress.
+    void addCopied(qint64 p_delta);
+
+    QString m_srcDir;
+
+    QString m_destDir;
+
+    bool m_isCut;
+
+    QAtomicInt m_stop;
+
+    // Set when any job fails.
+    QAtomicInt m_failed;
+
+    bool m_succeeded;
+
+    QVector<VFileCopier::Job> m_jobs;
+
+    // Index of the next job to run.
+    QAtomicInt m_nextJob;
+
+    qint64 m_totalBytes;
+
+    QMutex m_progressMutex;
+
+    qint64 m_copiedBytes;
+
+    qint64 m_lastReported;
+};
+
+inline bool VDirectoryCopier::isStopped() const
+{
+    return m_stop.load() == 1;
+}
+
+inline bool VDirectoryCopier::isSucceeded() const
+{
+    return m_succeeded;
+}
+
+#endif // VDIRECTORYCOPIER_H
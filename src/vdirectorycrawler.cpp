@@ -0,0 +1,252 @@
+#include "vdirectorycrawler.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QThread>
+
+// Limit the threads since the crawl is mostly bound by the disk.
+#define MAX_CRAWL_THREADS 4
+
+VExcludeRules::VExcludeRules()
+{
+}
+
+VExcludeRules::VExcludeRules(const QStringList &p_patterns)
+{
+    for (auto pattern : p_patterns) {
+        pattern = pattern.trimmed();
+        if (pattern.isEmpty() || pattern.startsWith('#')) {
+            continue;
+        }
+
+        Rule rule;
+        rule.m_dirOnly = pattern.endsWith('/');
+        if (rule.m_dirOnly) {
+            pattern.chop(1);
+        }
+
+        rule.m_anchored = pattern.contains('/');
+        if (pattern.startsWith('/')) {
+            pattern.remove(0, 1);
+        }
+
+        if (pattern.isEmpty()) {
+            continue;
+        }
+
+        QRegularExpression::PatternOptions opts = QRegularExpression::NoPatternOption;
+#if defined(Q_OS_WIN) || defined(Q_OS_MAC)
+        opts |= QRegularExpression::CaseInsensitiveOption;
+#endif
+        rule.m_reg = QRegularExpression(globToRegularExpression(pattern), opts);
+        if (!rule.m_reg.isValid()) {
+            continue;
+        }
+
+        rule.m_reg.optimize();
+        m_rules.append(rule);
+    }
+}
+
+QString VExcludeRules::globToRegularExpression(const QString &p_glob)
+{
+    QString reg("^");
+    for (int i = 0; i < p_glob.size(); ++i) {
+        QChar ch = p_glob[i];
+        if (ch == '*') {
+            if (i + 1 < p_glob.size() && p_glob[i + 1] == '*') {
+                ++i;
+                if (i + 1 < p_glob.size() && p_glob[i + 1] == '/') {
+                    // "**/" matches zero or more directories.
+                    ++i;
+                    reg += QStringLiteral("(.*/)?");
+                } else {
+                    reg += QStringLiteral(".*");
+                }
+            } else {
+                reg += QStringLiteral("[^/]*");
+            }
+        } else if (ch == '?') {
+            reg += QStringLiteral("[^/]");
+        } else {
+            reg += QRegularExpression::escape(QString(ch));
+        }
+    }
+
+    reg += '$';
+    return reg;
+}
+
+bool VExcludeRules::isExcluded(const QString &p_name,
+                               const QString &p_relativePath,
+                               bool p_isDir) const
+{
+    for (auto const & rule : m_rules) {
+        if (rule.m_dirOnly && !p_isDir) {
+            continue;
+        }
+
+        if (rule.m_reg.match(rule.m_anchored ? p_relativePath : p_name).hasMatch()) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+class VDirectoryCrawler::CrawlTask : public QRunnable
+{
+public:
+    explicit CrawlTask(VDirectoryCrawler *p_crawler)
+        : m_crawler(p_crawler)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_crawler->crawl();
+    }
+
+private:
+    VDirectoryCrawler *m_crawler;
+};
+
+
+VDirectoryCrawler::VDirectoryCrawler(const QString &p_rootPath,
+                                     const VExcludeRules &p_rules,
+                                     const QAtomicInt *p_stop)
+    : m_rootPath(QDir::cleanPath(p_rootPath)),
+      m_rules(p_rules),
+      m_stop(p_stop),
+      m_busy(0),
+      m_aborted(false)
+{
+    m_pool.setMaxThreadCount(qBound(1, QThread::idealThreadCount(), MAX_CRAWL_THREADS));
+}
+
+VDirectoryCrawler::~VDirectoryCrawler()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_aborted = true;
+        m_cond.wakeAll();
+    }
+
+    m_pool.waitForDone();
+}
+
+void VDirectoryCrawler::start()
+{
+    QDir root(m_rootPath);
+    if (!root.exists()) {
+        QMutexLocker locker(&m_mutex);
+        m_errors.append(m_rootPath);
+        return;
+    }
+
+    Entry entry;
+    entry.m_name = root.dirName();
+    entry.m_path = m_rootPath;
+    entry.m_relativePath = root.relativeFilePath(m_rootPath);
+    entry.m_isDir = true;
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_entries.append(entry);
+        m_dirs.append(m_rootPath);
+    }
+
+    for (int i = 0; i < m_pool.maxThreadCount(); ++i) {
+        m_pool.start(new CrawlTask(this));
+    }
+}
+
+void VDirectoryCrawler::crawl()
+{
+    QDir rootDir(m_rootPath);
+    QVector<Entry> entries;
+    QStringList subdirs;
+
+    QMutexLocker locker(&m_mutex);
+    while (true) {
+        while (m_dirs.isEmpty() && m_busy > 0 && !stopped()) {
+            m_cond.wait(&m_mutex, 100);
+        }
+
+        if (m_dirs.isEmpty() || stopped()) {
+            // Finished or stopped.
+            m_cond.wakeAll();
+            return;
+        }
+
+        QString dirPath = m_dirs.takeLast();
+        ++m_busy;
+        locker.unlock();
+
+        entries.clear();
+        subdirs.clear();
+
+        QDir dir(dirPath);
+        bool exists = dir.exists();
+        if (exists) {
+            // One listing of both files and directories.
+            const QFileInfoList infos = dir.entryInfoList(QDir::Files
+                                                          | QDir::AllDirs
+                                                          | QDir::NoDotAndDotDot);
+            for (auto const & info : infos) {
+                Entry entry;
+                entry.m_name = info.fileName();
+                entry.m_path = info.absoluteFilePath();
+                entry.m_relativePath = rootDir.relativeFilePath(entry.m_path);
+                entry.m_isDir = info.isDir();
+                if (m_rules.isExcluded(entry.m_name, entry.m_relativePath, entry.m_isDir)) {
+                    continue;
+                }
+
+                if (entry.m_isDir) {
+                    subdirs.append(entry.m_path);
+                }
+
+                entries.append(entry);
+            }
+        }
+
+        locker.relock();
+        --m_busy;
+        if (!exists) {
+            m_errors.append(dirPath);
+        }
+
+        m_entries += entries;
+
+        // Keep the pre-order roughly.
+        for (int i = subdirs.size() - 1; i >= 0; --i) {
+            m_dirs.append(subdirs[i]);
+        }
+
+        m_cond.wakeAll();
+    }
+}
+
+bool VDirectoryCrawler::take(QVector<Entry> &p_entries)
+{
+    p_entries.clear();
+
+    QMutexLocker locker(&m_mutex);
+    while (m_entries.isEmpty()
+           && (!m_dirs.isEmpty() || m_busy > 0)
+           && !stopped()) {
+        m_cond.wait(&m_mutex, 100);
+    }
+
+    p_entries.swap(m_entries);
+    return !p_entries.isEmpty();
+}
+
+QStringList VDirectoryCrawler::getErrors() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_errors;
+}
@@ -0,0 +1,129 @@
+#ifndef VDIRECTORYCRAWLER_H
+#define VDIRECTORYCRAWLER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QAtomicInt>
+#include <QThreadPool>
+#include <QRegularExpression>
+
+// Exclude rules in the form of .gitignore.
+// A pattern without '/' matches the name of a file or directory in any level.
+// A pattern containing '/' matches the path relative to the root.
+// A trailing '/' matches directories only. '*' and '?' do not match '/', while
+// '**' matches anything. Lines starting with '#' are comments.
+class VExcludeRules
+{
+public:
+    VExcludeRules();
+
+    explicit VExcludeRules(const QStringList &p_patterns);
+
+    bool isEmpty() const;
+
+    // @p_relativePath: path relative to the root separated by '/'.
+    bool isExcluded(const QString &p_name, const QString &p_relativePath, bool p_isDir) const;
+
+private:
+    struct Rule
+    {
+        QRegularExpression m_reg;
+
+        // Match the relative path instead of the name.
+        bool m_anchored;
+
+        bool m_dirOnly;
+    };
+
+    static QString globToRegularExpression(const QString &p_glob);
+
+    QVector<Rule> m_rules;
+};
+
+inline bool VExcludeRules::isEmpty() const
+{
+    return m_rules.isEmpty();
+}
+
+
+// Walk a directory in disk by several threads.
+// Directories and files found are collected in batches, which are taken by
+// the consumer thread. The order of the entries is not defined.
+class VDirectoryCrawler
+{
+public:
+    struct Entry
+    {
+        // File name.
+        QString m_name;
+
+        // Absolute path.
+        QString m_path;
+
+        // Path relative to the root.
+        QString m_relativePath;
+
+        bool m_isDir;
+    };
+
+    // @p_stop: the crawl will stop once it is set to 1.
+    VDirectoryCrawler(const QString &p_rootPath,
+                      const VExcludeRules &p_rules,
+                      const QAtomicInt *p_stop);
+
+    // Stop and wait for the crawling threads.
+    ~VDirectoryCrawler();
+
+    void start();
+
+    // Block until there are entries or the crawl is finished.
+    // Return false if there is no more entry.
+    bool take(QVector<Entry> &p_entries);
+
+    // Paths of directories which could not be listed.
+    QStringList getErrors() const;
+
+private:
+    class CrawlTask;
+
+    // Run in each crawling thread.
+    void crawl();
+
+    // Should be called with m_mutex locked.
+    bool stopped() const;
+
+    QString m_rootPath;
+
+    VExcludeRules m_rules;
+
+    const QAtomicInt *m_stop;
+
+    QThreadPool m_pool;
+
+    mutable QMutex m_mutex;
+
+    QWaitCondition m_cond;
+
+    // Absolute paths of directories to list.
+    QStringList m_dirs;
+
+    // Number of threads listing a directory.
+    int m_busy;
+
+    QVector<Entry> m_entries;
+
+    QStringList m_errors;
+
+    // Set when destructed.
+    bool m_aborted;
+};
+
+inline bool VDirectoryCrawler::stopped() const
+{
+    return m_aborted || m_stop->load() == 1;
+}
+
+#endif // VDIRECTORYCRAWLER_H
@@ -0,0 +1,15 @@
+#include "vdirectorynode.h"
+
+VDirectoryNode::VDirectoryNode(const QString &p_name,
+                               const QJsonObject &p_config,
+                               const QHash<QString, VDirectoryNodePtr> &p_subDirs)
+    : m_name(p_name),
+      m_config(p_config),
+      m_subDirs(p_subDirs)
+{
+}
+
+VDirectoryNodePtr VDirectoryNode::findSubDirectory(const QString &p_name) const
+{
+    return m_subDirs.value(p_name);
+}
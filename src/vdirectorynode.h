@@ -0,0 +1,54 @@
+#ifndef VDIRECTORYNODE_H
+#define VDIRECTORYNODE_H
+
+#include <QString>
+#include <QHash>
+#include <QJsonObject>
+#include <QSharedPointer>
+
+class VDirectoryNode;
+
+typedef QSharedPointer<const VDirectoryNode> VDirectoryNodePtr;
+
+// Immutable snapshot of an opened VDirectory and its opened sub-directories,
+// taken in the GUI thread to be walked by the background workers without
+// locks.
+// Nodes are shared between snapshots: a change of a directory only replaces
+// the nodes of it and its ancestors, which are rebuilt on the next request.
+// Sub-directories not opened have no node and should be read from disk.
+class VDirectoryNode
+{
+public:
+    VDirectoryNode(const QString &p_name,
+                   const QJsonObject &p_config,
+                   const QHash<QString, VDirectoryNodePtr> &p_subDirs);
+
+    const QString &getName() const;
+
+    // Configuration of the directory in the format of its config file,
+    // not including the sections belonging to notebook.
+    const QJsonObject &getConfig() const;
+
+    // Return the node of the opened sub-directory @p_name, or null.
+    VDirectoryNodePtr findSubDirectory(const QString &p_name) const;
+
+private:
+    const QString m_name;
+
+    const QJsonObject m_config;
+
+    // Name -> nodes of the opened sub-directories.
+    const QHash<QString, VDirectoryNodePtr> m_subDirs;
+};
+
+inline const QString &VDirectoryNode::getName() const
+{
+    return m_name;
+}
+
+inline const QJsonObject &VDirectoryNode::getConfig() const
+{
+    return m_config;
+}
+
+#endif // VDIRECTORYNODE_H
@@ -0,0 +1,182 @@
+#include "vdirectoryprefetcher.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QRunnable>
+#include <QVector>
+#include <QJsonArray>
+#include <QCoreApplication>
+
+#include "vnotebook.h"
+#include "vdirectory.h"
+#include "vnotebooksnapshot.h"
+#include "vconfigmanager.h"
+#include "vtaskexecutor.h"
+
+extern VConfigManager *g_config;
+
+// Number of directories to hand back at a time.
+#define BATCH_SIZE 64
+
+static QString childPath(const QString &p_path, const QString &p_name)
+{
+    return p_path.isEmpty() ? p_name : p_path + "/" + p_name;
+}
+
+// Read the configurations of all the directories of a notebook.
+class DirectoryPrefetchTask : public QRunnable
+{
+public:
+    DirectoryPrefetchTask(VDirectoryPrefetcher *p_prefetcher,
+                          int p_id,
+                          const QString &p_notebookPath,
+                          const QSharedPointer<VNotebookSnapshot> &p_snapshot)
+        : m_prefetcher(p_prefetcher),
+          m_id(p_id),
+          m_notebookPath(p_notebookPath),
+          m_snapshot(p_snapshot)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        QDir notebookDir(m_notebookPath);
+        QJsonObject batch;
+
+        // Parents are always fetched before their children.
+        QVector<QString> paths(1, QString());
+        while (!paths.isEmpty()) {
+            if (m_prefetcher->isCancelled(m_id)) {
+                return;
+            }
+
+            QString path = paths.takeLast();
+            QString absPath = path.isEmpty() ? m_notebookPath : notebookDir.filePath(path);
+            QJsonObject configJson = m_snapshot->readDirectoryConfig(absPath);
+            if (configJson.isEmpty()) {
+                continue;
+            }
+
+            QJsonArray dirJson = configJson[DirConfig::c_subDirectories].toArray();
+            for (int i = dirJson.size() - 1; i >= 0; --i) {
+                QString name = dirJson[i].toObject()[DirConfig::c_name].toString();
+                paths.append(childPath(path, name));
+            }
+
+            batch.insert(path, configJson);
+            if (batch.size() >= BATCH_SIZE) {
+                post(batch);
+                batch = QJsonObject();
+            }
+        }
+
+        if (!batch.isEmpty()) {
+            post(batch);
+        }
+    }
+
+private:
+    void post(const QJsonObject &p_batch)
+    {
+        // The prefetcher waits for all the tasks before destruction.
+        QMetaObject::invokeMethod(m_prefetcher,
+                                  "configsFetched",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, m_id),
+                                  Q_ARG(QJsonObject, p_batch));
+    }
+
+    VDirectoryPrefetcher *m_prefetcher;
+
+    int m_id;
+
+    QString m_notebookPath;
+
+    QSharedPointer<VNotebookSnapshot> m_snapshot;
+};
+
+
+VDirectoryPrefetcher::VDirectoryPrefetcher(QObject *p_parent)
+    : QObject(p_parent),
+      m_nextId(0),
+      m_currentId(0)
+{
+    connect(this, &VDirectoryPrefetcher::configsFetched,
+            this, &VDirectoryPrefetcher::handleConfigsFetched);
+}
+
+VDirectoryPrefetcher::~VDirectoryPrefetcher()
+{
+    // Cancelled tasks return at once.
+    cancel();
+    VTaskExecutor::inst()->waitForDone(VTaskExecutor::Maintenance);
+}
+
+VDirectoryPrefetcher *VDirectoryPrefetcher::inst()
+{
+    static VDirectoryPrefetcher *prefetcher = new VDirectoryPrefetcher(QCoreApplication::instance());
+    return prefetcher;
+}
+
+void VDirectoryPrefetcher::prefetch(VNotebook *p_notebook)
+{
+    cancel();
+
+    if (!p_notebook
+        || !p_notebook->isOpened()
+        || !g_config->getPrefetchNotebookFolders()) {
+        return;
+    }
+
+    m_notebook = p_notebook;
+    m_directories.insert(QString(), p_notebook->getRootDir());
+
+    int id = ++m_nextId;
+    m_currentId.store(id);
+    VTaskExecutor::inst()->start(new DirectoryPrefetchTask(this,
+                                                           id,
+                                                           p_notebook->getPath(),
+                                                           p_notebook->getSnapshot()),
+                                 VTaskExecutor::Maintenance);
+}
+
+void VDirectoryPrefetcher::cancel()
+{
+    m_currentId.store(0);
+    m_notebook.clear();
+    m_directories.clear();
+}
+
+bool VDirectoryPrefetcher::isCancelled(int p_id) const
+{
+    return m_currentId.load() != p_id;
+}
+
+void VDirectoryPrefetcher::handleConfigsFetched(int p_id, const QJsonObject &p_configs)
+{
+    if (isCancelled(p_id)) {
+        return;
+    }
+
+    if (!m_notebook || !m_notebook->isOpened()) {
+        // The directories are gone with the closed notebook.
+        cancel();
+        return;
+    }
+
+    // Keys are sorted, so a parent always precedes its children.
+    for (auto it = p_configs.constBegin(); it != p_configs.constEnd(); ++it) {
+        VDirectory *dir = m_directories.take(it.key());
+        if (!dir) {
+            continue;
+        }
+
+        if (!dir->open(it.value().toObject())) {
+            continue;
+        }
+
+        for (auto sub : dir->getSubDirs()) {
+            m_directories.insert(childPath(it.key(), sub->getName()), sub);
+        }
+    }
+}
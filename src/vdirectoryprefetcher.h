@@ -0,0 +1,59 @@
+#ifndef VDIRECTORYPREFETCHER_H
+#define VDIRECTORYPREFETCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QPointer>
+#include <QJsonObject>
+#include <QAtomicInt>
+
+class VNotebook;
+class VDirectory;
+
+// Open all the directories of a notebook in the background.
+// The configurations are read on a worker and handed back in batches to open
+// the directories in the GUI thread, so later expansion and searches find them
+// opened already. The worker runs as Maintenance in VTaskExecutor.
+// Should be accessed only in the GUI thread.
+class VDirectoryPrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    ~VDirectoryPrefetcher();
+
+    static VDirectoryPrefetcher *inst();
+
+    // Prefetch the directories of @p_notebook, which should be opened.
+    // The previous prefetch will be cancelled.
+    void prefetch(VNotebook *p_notebook);
+
+    void cancel();
+
+    // Whether prefetch @p_id is cancelled.
+    // Thread-safe.
+    bool isCancelled(int p_id) const;
+
+signals:
+    // Configurations of a batch of directories keyed by the path relative to
+    // the notebook, which is empty for the root directory.
+    void configsFetched(int p_id, const QJsonObject &p_configs);
+
+private slots:
+    void handleConfigsFetched(int p_id, const QJsonObject &p_configs);
+
+private:
+    explicit VDirectoryPrefetcher(QObject *p_parent = nullptr);
+
+    int m_nextId;
+
+    // ID of current prefetch, 0 if there is none.
+    QAtomicInt m_currentId;
+
+    QPointer<VNotebook> m_notebook;
+
+    // Relative path -> directory whose configuration is to be fetched.
+    QHash<QString, QPointer<VDirectory>> m_directories;
+};
+
+#endif // VDIRECTORYPREFETCHER_H
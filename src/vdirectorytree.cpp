@@ -14,6 +14,9 @@
 #include "utils/viconutils.h"
 #include "vfilelist.h"
 #include "vhistorylist.h"
+#include "vnotebookwatcher.h"
+#include "vedittab.h"
+#include "vdirectorycopier.h"
 
 extern VMainWindow *g_mainWin;
 
@@ -43,6 +46,9 @@ VDirectoryTree::VDirectoryTree(QWidget *parent)
             this, SLOT(contextMenuRequested(QPoint)));
     connect(this, &VDirectoryTree::currentItemChanged,
             this, &VDirectoryTree::currentDirectoryItemChanged);
+
+    connect(VNotebookWatcher::inst(), &VNotebookWatcher::directoryChangedOnDisk,
+            this, &VDirectoryTree::handleDirectoryChangedOnDisk);
 }
 
 void VDirectoryTree::initShortcuts()
@@ -130,6 +136,9 @@ void VDirectoryTree::fillTreeItem(QTreeWidgetItem *p_item, VDirectory *p_directo
 
 void VDirectoryTree::updateDirectoryTree()
 {
+    // Directories are all new for another notebook or a reloaded one.
+    setUpdatesEnabled(false);
+
     clear();
 
     VDirectory *rootDir = m_notebook->getRootDir();
@@ -148,6 +157,8 @@ void VDirectoryTree::updateDirectoryTree()
     }
 
     resizeColumnToContents(0);
+
+    setUpdatesEnabled(true);
 }
 
 bool VDirectoryTree::restoreCurrentItem()
@@ -256,54 +267,58 @@ void VDirectoryTree::updateItemDirectChildren(QTreeWidgetItem *p_item)
 
     const QVector<VDirectory *> &dirs = parentDir->getSubDirs();
 
+    // Top level items are children of the invisible root item.
+    QTreeWidgetItem *parentItem = p_item ? p_item : invisibleRootItem();
+
+    // Only touch the items changed, so the others keep their expansion and
+    // the view keeps its scroll position.
+    setUpdatesEnabled(false);
+
+    // Delete items without corresponding VDirectory.
+    QSet<VDirectory *> dirSet;
+    dirSet.reserve(dirs.size());
+    for (auto const & dir : dirs) {
+        dirSet.insert(dir);
+    }
+
     QHash<VDirectory *, QTreeWidgetItem *> itemDirMap;
-    int nrChild = p_item ? p_item->childCount() : topLevelItemCount();
-    for (int i = 0; i < nrChild; ++i) {
-        QTreeWidgetItem *item = p_item ? p_item->child(i) : topLevelItem(i);
-        itemDirMap.insert(getVDirectory(item), item);
+    for (int i = parentItem->childCount() - 1; i >= 0; --i) {
+        QTreeWidgetItem *item = parentItem->child(i);
+        VDirectory *dir = getVDirectory(item);
+        if (dirSet.contains(dir)) {
+            itemDirMap.insert(dir, item);
+        } else {
+            delete parentItem->takeChild(i);
+        }
     }
 
     for (int i = 0; i < dirs.size(); ++i) {
         VDirectory *dir = dirs[i];
-        QTreeWidgetItem *item = itemDirMap.value(dir, NULL);
-        if (item) {
-            if (p_item) {
-                p_item->removeChild(item);
-                p_item->insertChild(i, item);
-            } else {
-                int topIdx = indexOfTopLevelItem(item);
-                takeTopLevelItem(topIdx);
-                insertTopLevelItem(i, item);
+        QTreeWidgetItem *item = i < parentItem->childCount() ? parentItem->child(i) : NULL;
+        if (item && getVDirectory(item) == dir) {
+            if (item->text(0) != dir->getName()) {
+                fillTreeItem(item, dir);
             }
 
-            itemDirMap.remove(dir);
-        } else {
-            // Insert a new item
-            if (p_item) {
-                item = new QTreeWidgetItem(p_item);
-            } else {
-                item = new QTreeWidgetItem(this);
-            }
+            continue;
+        }
 
+        item = itemDirMap.value(dir, NULL);
+        if (item) {
+            // Move it to its position. It is collapsed once taken out.
+            parentItem->takeChild(parentItem->indexOfChild(item));
+            parentItem->insertChild(i, item);
+            expandSubTree(item);
+        } else {
+            // Insert a new item.
+            item = new QTreeWidgetItem();
             fillTreeItem(item, dir);
+            parentItem->insertChild(i, item);
             buildSubTree(item, 1);
         }
-
-        expandSubTree(item);
     }
 
-    // Delete items without corresponding VDirectory
-    for (auto iter = itemDirMap.begin(); iter != itemDirMap.end(); ++iter) {
-        QTreeWidgetItem *item = iter.value();
-        if (p_item) {
-            p_item->removeChild(item);
-        } else {
-            int topIdx = indexOfTopLevelItem(item);
-            takeTopLevelItem(topIdx);
-        }
-
-        delete item;
-    }
+    setUpdatesEnabled(true);
 }
 
 void VDirectoryTree::contextMenuRequested(QPoint pos)
@@ -592,6 +607,39 @@ void VDirectoryTree::deleteSelectedDirectory()
     }
 }
 
+bool VDirectoryTree::copyDirectoryInBackground(const QString &p_srcPath,
+                                               const QString &p_destPath,
+                                               bool p_isCut,
+                                               bool &p_cancelled)
+{
+    VDirectoryCopier copier(p_srcPath, p_destPath, p_isCut);
+    QProgressDialog proDlg(p_isCut ? tr("Moving folder...") : tr("Copying folder..."),
+                           tr("Abort"),
+                           0,
+                           1000,
+                           this);
+    proDlg.setWindowModality(Qt::WindowModal);
+    proDlg.setWindowTitle(p_isCut ? tr("Move Folder") : tr("Copy Folder"));
+    proDlg.setMinimumDuration(500);
+
+    QEventLoop loop;
+    connect(&copier, &VDirectoryCopier::progressUpdated,
+            &proDlg, [&proDlg](qint64 p_copied, qint64 p_total) {
+                proDlg.setValue(p_copied * 1000 / qMax(p_total, (qint64)1));
+            });
+    connect(&proDlg, &QProgressDialog::canceled,
+            &copier, &VDirectoryCopier::stop);
+    connect(&copier, &QThread::finished,
+            &loop, &QEventLoop::quit);
+
+    copier.start();
+    loop.exec();
+    copier.wait();
+
+    p_cancelled = copier.isStopped() && !copier.isSucceeded();
+    return copier.isSucceeded();
+}
+
 void VDirectoryTree::currentDirectoryItemChanged(QTreeWidgetItem *currentItem)
 {
     if (!currentItem) {
@@ -698,32 +746,53 @@ void VDirectoryTree::reloadFromDisk()
         }
     }
 
+    if (!reloadDirectoryItem(curItem)) {
+        return;
+    }
+
+    if (!msg.isEmpty()) {
+        g_mainWin->showStatusMessage(msg);
+    }
+}
+
+bool VDirectoryTree::reloadDirectoryItem(QTreeWidgetItem *p_item)
+{
     m_notebookCurrentDirMap.remove(m_notebook);
 
-    if (curItem) {
-        if (!m_editArea->closeFile(curDir, false)) {
-            return;
+    if (p_item) {
+        VDirectory *dir = getVDirectory(p_item);
+        if (!m_editArea->closeFile(dir, false)) {
+            return false;
+        }
+
+        // Keep current item if it is not within @p_item.
+        QTreeWidgetItem *curItem = currentItem();
+        for (QTreeWidgetItem *it = curItem; it; it = it->parent()) {
+            if (it == p_item) {
+                curItem = p_item;
+                break;
+            }
         }
 
         setCurrentItem(NULL);
 
-        curItem->setExpanded(false);
-        curDir->setExpanded(false);
+        p_item->setExpanded(false);
+        dir->setExpanded(false);
 
-        curDir->close();
+        dir->close();
 
         // Remove all its children.
-        QList<QTreeWidgetItem *> children = curItem->takeChildren();
+        QList<QTreeWidgetItem *> children = p_item->takeChildren();
         for (int i = 0; i < children.size(); ++i) {
             delete children[i];
         }
 
-        buildSubTree(curItem, 1);
+        buildSubTree(p_item, 1);
 
         setCurrentItem(curItem);
     } else {
         if (!m_editArea->closeFile(m_notebook, false)) {
-            return;
+            return false;
         }
 
         m_notebook->close();
@@ -736,14 +805,41 @@ void VDirectoryTree::reloadFromDisk()
                                   .arg(g_config->c_dataTextStyle).arg(m_notebook->getPath()),
                                 QMessageBox::Ok, QMessageBox::Ok, this);
             clear();
-            return;
+            return false;
         }
 
         updateDirectoryTree();
     }
 
-    if (!msg.isEmpty()) {
-        g_mainWin->showStatusMessage(msg);
+    return true;
+}
+
+void VDirectoryTree::handleDirectoryChangedOnDisk(VDirectory *p_dir)
+{
+    if (!m_notebook || p_dir->getNotebook() != m_notebook) {
+        return;
+    }
+
+    // Do not close the notes under editing behind the user.
+    QVector<VEditTab *> tabs = m_editArea->getAllTabs();
+    for (auto const & tab : tabs) {
+        if (p_dir->containsFile(tab->getFile())) {
+            g_mainWin->showStatusMessage(tr("Folder %1 changed on disk. Reload it to see the changes.")
+                                           .arg(p_dir->getName()));
+            return;
+        }
+    }
+
+    QTreeWidgetItem *item = NULL;
+    if (p_dir != m_notebook->getRootDir()) {
+        item = findVDirectory(p_dir);
+        if (!item) {
+            return;
+        }
+    }
+
+    if (reloadDirectoryItem(item)) {
+        g_mainWin->showStatusMessage(tr("Folder %1 reloaded from disk").arg(p_dir->getName()));
     }
 }
 
@@ -858,12 +954,25 @@ void VDirectoryTree::pasteDirectories(VDirectory *p_destDir,
 
         QString msg;
         VDirectory *destDir = NULL;
+        bool cancelled = false;
         bool ret = VDirectory::copyDirectory(p_destDir,
                                              dirName,
                                              dir,
                                              p_isCut,
                                              &destDir,
-                                             &msg);
+                                             &msg,
+                                             [this, &cancelled](const QString &p_srcPath,
+                                                                const QString &p_destPath,
+                                                                bool p_cut) {
+                                                 return copyDirectoryInBackground(p_srcPath,
+                                                                                  p_destPath,
+                                                                                  p_cut,
+                                                                                  cancelled);
+                                             });
+        if (cancelled) {
+            break;
+        }
+
         if (!ret) {
             VUtils::showMessage(QMessageBox::Warning,
                                 tr("Warning"),
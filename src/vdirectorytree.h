@@ -96,6 +96,9 @@ private slots:
     // Pin selected directory to History.
     void pinDirectoryToHistory();
 
+    // Reload @p_dir if no note of it is being edited.
+    void handleDirectoryChangedOnDisk(VDirectory *p_dir);
+
 protected:
     void mousePressEvent(QMouseEvent *event) Q_DECL_OVERRIDE;
 
@@ -126,7 +129,12 @@ private:
 
     void initShortcuts();
 
-    // Update @p_item's direct children only: deleted, added, renamed.
+    // Close related notes and reload @p_item from disk.
+    // @p_item: NULL to reload the notebook.
+    bool reloadDirectoryItem(QTreeWidgetItem *p_item);
+
+    // Update @p_item's direct children only: deleted, added, renamed, moved.
+    // Items in place are kept as they are.
     void updateItemDirectChildren(QTreeWidgetItem *p_item);
 
     // Find the corresponding item of @p_dir;
@@ -140,6 +148,13 @@ private:
                           const QVector<QString> &p_dirs,
                           bool p_isCut);
 
+    // Copy the directory tree @p_srcPath to @p_destPath in background with
+    // progress. Set @p_cancelled if user cancels it.
+    bool copyDirectoryInBackground(const QString &p_srcPath,
+                                   const QString &p_destPath,
+                                   bool p_isCut,
+                                   bool &p_cancelled);
+
     // Build the subtree of @p_item's children if it has not been built yet.
     // We need to fill the children before showing a item to get a correct render.
     void buildChildren(QTreeWidgetItem *p_item);
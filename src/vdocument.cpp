@@ -1,48 +1,445 @@
 #include "vdocument.h"
 
 #include <QDebug>
+#include <QJsonObject>
+#include <QRegularExpression>
+#include <QTimer>
+#include <QCryptographicHash>
 
 #include "vfile.h"
 #include "vplantumlhelper.h"
 #include "vgraphvizhelper.h"
+#include "vdiagramcache.h"
+#include "vconstants.h"
+
+// Interval in ms to batch the calls to the web side, about one frame.
+#define WEB_CALL_BATCH_INTERVAL 16
 
 VDocument::VDocument(const VFile *v_file, QObject *p_parent)
     : QObject(p_parent),
+      m_rendering(false),
       m_file(v_file),
       m_readyToHighlight(false),
       m_plantUMLHelper(NULL),
       m_graphvizHelper(NULL),
       m_nextID(0),
-      m_webViewMuted(false)
+      m_webViewMuted(false),
+      m_textPatchEnabled(false),
+      m_nextBlockID(0)
+{
+    m_webCallTimer = new QTimer(this);
+    m_webCallTimer->setSingleShot(true);
+    m_webCallTimer->setInterval(WEB_CALL_BATCH_INTERVAL);
+    connect(m_webCallTimer, &QTimer::timeout,
+            this, &VDocument::flushWebCalls);
+}
+
+void VDocument::postToWeb(const QString &p_name, const QJsonArray &p_args)
+{
+    QJsonArray call(p_args);
+    call.prepend(p_name);
+    m_pendingWebCalls.append(call);
+
+    if (!m_webCallTimer->isActive()) {
+        m_webCallTimer->start();
+    }
+}
+
+void VDocument::flushWebCalls()
+{
+    m_webCallTimer->stop();
+    if (m_pendingWebCalls.isEmpty()) {
+        return;
+    }
+
+    QJsonArray calls = m_pendingWebCalls;
+    m_pendingWebCalls = QJsonArray();
+    emit callsBatched(calls);
+}
+
+static QStringList toStringList(const QJsonValue &p_val)
+{
+    QStringList list;
+    const QJsonArray arr = p_val.toArray();
+    list.reserve(arr.size());
+    for (auto const & val : arr) {
+        list.append(val.toString());
+    }
+
+    return list;
+}
+
+void VDocument::handleBatchedCalls(const QJsonArray &p_calls)
+{
+    for (auto const & val : p_calls) {
+        const QJsonArray call = val.toArray();
+        if (!call.isEmpty()) {
+            dispatchCall(call[0].toString(), call);
+        }
+    }
+}
+
+void VDocument::dispatchCall(const QString &p_name, const QJsonArray &p_call)
+{
+    // Arguments start from 1.
+    auto str = [&p_call](int p_idx) {
+        return p_call[p_idx].toString();
+    };
+
+    auto num = [&p_call](int p_idx) {
+        return p_call[p_idx].toInt();
+    };
+
+    auto boolean = [&p_call](int p_idx) {
+        return p_call[p_idx].toBool();
+    };
+
+    auto list = [&p_call](int p_idx) {
+        return p_call[p_idx].toArray().toVariantList();
+    };
+
+    if (p_name == "setLog") {
+        setLog(str(1));
+    } else if (p_name == "highlightTextCB") {
+        highlightTextCB(str(1), num(2), (unsigned long long)p_call[3].toDouble());
+    } else if (p_name == "previewCodeBlockCB") {
+        previewCodeBlockCB(num(1), str(2), str(3));
+    } else if (p_name == "processPlantUML") {
+        processPlantUML(num(1), str(2), str(3));
+    } else if (p_name == "processGraphviz") {
+        processGraphviz(num(1), str(2), str(3));
+    } else if (p_name == "cacheDiagram") {
+        cacheDiagram(str(1), str(2), str(3));
+    } else if (p_name == "textToHtmlCB") {
+        textToHtmlCB(num(1), num(2), num(3), str(4));
+    } else if (p_name == "textToHtmlBatchCB") {
+        textToHtmlBatchCB(num(1), num(2), list(3), toStringList(p_call[4]));
+    } else if (p_name == "htmlToTextCB") {
+        htmlToTextCB(num(1), num(2), num(3), str(4));
+    } else if (p_name == "setTocItems") {
+        setTocItems(list(1));
+    } else if (p_name == "setHeader") {
+        setHeader(str(1));
+    } else if (p_name == "setSourceLineMap") {
+        setSourceLineMap(list(1), list(2), toStringList(p_call[3]), list(4));
+    } else if (p_name == "keyPressEvent") {
+        keyPressEvent(num(1), boolean(2), boolean(3), boolean(4));
+    } else if (p_name == "updateText") {
+        updateText();
+    } else if (p_name == "enableTextPatch") {
+        enableTextPatch();
+    } else if (p_name == "noticeReadyToHighlightText") {
+        noticeReadyToHighlightText();
+    } else if (p_name == "noticeReadyToTextToHtml") {
+        noticeReadyToTextToHtml();
+    } else if (p_name == "finishLogics") {
+        finishLogics();
+    } else if (p_name == "htmlContentCB") {
+        htmlContentCB(str(1), str(2), str(3));
+    } else if (p_name == "updateWordCountInfo") {
+        updateWordCountInfo(num(1), num(2), num(3));
+    } else {
+        qWarning() << "unknown batched call from web side" << p_name;
+    }
+}
+
+void VDocument::renderText()
 {
+    if (!m_file) {
+        return;
+    }
+
+    QByteArray hash = QCryptographicHash::hash(m_file->getContent().toUtf8(),
+                                               QCryptographicHash::Sha1);
+    if (hash == m_renderedTextHash) {
+        // The web side keeps the render of the same text.
+        if (!m_rendering) {
+            QMetaObject::invokeMethod(this, "finishLogics", Qt::QueuedConnection);
+        }
+
+        return;
+    }
+
+    updateText();
+}
+
+void VDocument::resetRender()
+{
+    m_renderedTextHash.clear();
+    m_html.clear();
+    m_rendering = false;
 }
 
 void VDocument::updateText()
 {
     if (m_file) {
-        emit textChanged(m_file->getContent());
+        m_renderedTextHash = QCryptographicHash::hash(m_file->getContent().toUtf8(),
+                                                      QCryptographicHash::Sha1);
+        m_rendering = true;
+
+        if (m_textPatchEnabled) {
+            patchText(m_file->getContent());
+        } else {
+            postCachedDiagrams(m_file->getContent());
+
+            // Keep the order with the batched calls.
+            flushWebCalls();
+            emit textChanged(m_file->getContent());
+        }
+    }
+}
+
+void VDocument::enableTextPatch()
+{
+    // The web side starts from scratch.
+    m_textPatchEnabled = true;
+    m_blocks.clear();
+
+    updateText();
+}
+
+void VDocument::patchText(const QString &p_text)
+{
+    QStringList texts = splitTextIntoBlocks(p_text);
+    const int oldCnt = m_blocks.size();
+    const int newCnt = texts.size();
+
+    int prefix = 0;
+    while (prefix < oldCnt
+           && prefix < newCnt
+           && m_blocks[prefix].m_text == texts[prefix]) {
+        ++prefix;
+    }
+
+    int suffix = 0;
+    while (suffix < oldCnt - prefix
+           && suffix < newCnt - prefix
+           && m_blocks[oldCnt - 1 - suffix].m_text == texts[newCnt - 1 - suffix]) {
+        ++suffix;
+    }
+
+    QVector<TextBlock> blocks;
+    blocks.reserve(newCnt);
+    blocks += m_blocks.mid(0, prefix);
+
+    QJsonArray patch;
+    QString patchedText;
+    for (int i = prefix; i < newCnt - suffix; ++i) {
+        TextBlock blk;
+        blk.m_id = ++m_nextBlockID;
+        blk.m_text = texts[i];
+        blocks.append(blk);
+        patchedText += texts[i];
+
+        QJsonObject obj;
+        obj["id"] = blk.m_id;
+        obj["text"] = blk.m_text;
+        patch.append(obj);
+    }
+
+    blocks += m_blocks.mid(oldCnt - suffix);
+
+    int removed = oldCnt - prefix - suffix;
+    m_blocks = blocks;
+
+    postCachedDiagrams(patchedText);
+
+    // Patch even if nothing changes, since the web side will finish logics.
+    postToWeb("patchText", QJsonArray({prefix, removed, patch}));
+}
+
+// Language of the diagrams cached by the web side, or empty.
+static QString diagramLanguage(const QString &p_lang)
+{
+    if (p_lang == "mermaid" || p_lang == "wavedrom") {
+        return p_lang;
+    } else if (p_lang == "flowchart" || p_lang == "flow") {
+        return "flowchart";
     }
+
+    return QString();
 }
 
-void VDocument::setToc(const QString &toc, int /* baseLevel */)
+void VDocument::postCachedDiagrams(const QString &p_text)
 {
-    if (toc == m_toc) {
+    if (VDiagramCache::isEmpty()) {
         return;
     }
-    m_toc = toc;
-    emit tocChanged(m_toc);
+
+    static const QRegularExpression fenceExp("^( {0,3})(`{3,}|~{3,})\\s*([^\\s`]*)");
+
+    QJsonArray diagrams;
+
+    // Marker of the fenced code block we are in.
+    QString fence;
+    int indent = 0;
+    QString lang;
+    QString source;
+    const QStringList lines = p_text.split('\n');
+    for (auto const & line : lines) {
+        if (fence.isEmpty()) {
+            QRegularExpressionMatch match = fenceExp.match(line);
+            if (match.hasMatch()) {
+                fence = match.captured(2);
+                indent = match.capturedLength(1);
+                lang = diagramLanguage(match.captured(3).toLower());
+                source.clear();
+            }
+
+            continue;
+        }
+
+        QString trimmed = line.trimmed();
+        if (trimmed.startsWith(fence) && trimmed.count(fence[0]) == trimmed.size()) {
+            if (!lang.isEmpty()) {
+                QString html = VDiagramCache::find(lang, source);
+                if (!html.isEmpty()) {
+                    diagrams.append(QJsonArray({lang, source, html}));
+                }
+            }
+
+            fence.clear();
+            continue;
+        }
+
+        if (!lang.isEmpty()) {
+            // The indentation of the fence is stripped from the content.
+            int i = 0;
+            while (i < indent && i < line.size() && line[i] == ' ') {
+                ++i;
+            }
+
+            source += line.midRef(i);
+            source += '\n';
+        }
+    }
+
+    if (!diagrams.isEmpty()) {
+        postToWeb("setCachedDiagrams", QJsonArray({diagrams}));
+    }
+}
+
+QStringList VDocument::splitTextIntoBlocks(const QString &p_text)
+{
+    static const QRegularExpression fenceExp("^ {0,3}(`{3,}|~{3,})");
+    static const QRegularExpression listExp("^([*+-]|\\d+[.)])(\\s|$)");
+
+    QStringList blocks;
+
+    // Marker of the fenced code block or math block we are in.
+    QString fence;
+    bool lastIsBlank = false;
+    int start = 0;
+    int pos = 0;
+    const int len = p_text.size();
+    while (pos < len) {
+        int end = p_text.indexOf('\n', pos);
+        end = end == -1 ? len : end + 1;
+
+        QString line = p_text.mid(pos, end - pos);
+        QString trimmed = line.trimmed();
+        bool blank = trimmed.isEmpty();
+        if (fence.isEmpty()) {
+            // Indented lines and list items after a blank line may continue
+            // the previous block.
+            if (lastIsBlank
+                && !blank
+                && !line.at(0).isSpace()
+                && !listExp.match(line).hasMatch()) {
+                blocks.append(p_text.mid(start, pos - start));
+                start = pos;
+            }
+
+            QRegularExpressionMatch match = fenceExp.match(line);
+            if (match.hasMatch()) {
+                fence = match.captured(1);
+            } else if (trimmed.startsWith("$$")
+                       && (trimmed.size() == 2 || !trimmed.endsWith("$$"))) {
+                fence = "$$";
+            }
+        } else if (fence == "$$" ? trimmed.endsWith(fence) : trimmed.startsWith(fence)) {
+            fence.clear();
+        }
+
+        lastIsBlank = blank;
+        pos = end;
+    }
+
+    if (start < len) {
+        blocks.append(p_text.mid(start));
+    }
+
+    return blocks;
+}
+
+qint64 VDocument::approximateBytes() const
+{
+    qint64 bytes = (qint64)m_html.capacity() * sizeof(QChar);
+    for (auto const & item : m_tocItems) {
+        bytes += sizeof(VTableOfContentItem)
+                 + (qint64)(item.m_name.capacity() + item.m_anchor.capacity()) * sizeof(QChar);
+    }
+
+    for (auto const & blk : m_blocks) {
+        bytes += sizeof(TextBlock) + (qint64)blk.m_text.capacity() * sizeof(QChar);
+    }
+
+    return bytes;
+}
+
+// Unescape @p_text escaped by escapeHtml() of the web side.
+static QString unescapeHtml(const QString &p_text)
+{
+    if (!p_text.contains('&')) {
+        return p_text;
+    }
+
+    QString text(p_text);
+    text.replace("&lt;", "<")
+        .replace("&gt;", ">")
+        .replace("&quot;", "\"")
+        .replace("&#039;", "'")
+        .replace("&amp;", "&");
+    return text;
 }
 
-QString VDocument::getToc()
+void VDocument::setTocItems(const QVariantList &p_items)
 {
-    return m_toc;
+    QVector<VTableOfContentItem> items;
+    items.reserve(p_items.size() / 3);
+    for (int i = 0; i + 2 < p_items.size(); i += 3) {
+        QString anchor = p_items[i + 1].toString();
+        QString name = anchor.isEmpty() ? c_emptyHeaderName : unescapeHtml(p_items[i + 2].toString());
+        items.append(VTableOfContentItem(name, p_items[i].toInt(), anchor, items.size()));
+    }
+
+    // Most renders come from edits outside the headers.
+    if (items == m_tocItems) {
+        return;
+    }
+
+    m_tocItems = items;
+    emit tocItemsChanged(m_tocItems);
 }
 
 void VDocument::scrollToAnchor(const QString &anchor)
 {
     m_header = anchor;
 
-    emit requestScrollToAnchor(anchor);
+    postToWeb("scrollToAnchor", QJsonArray({anchor}));
+}
+
+void VDocument::scrollToOffset(int p_offset)
+{
+    postToWeb("scrollToOffset", QJsonArray({p_offset}));
+}
+
+void VDocument::setSourceLineMap(const QVariantList &p_lines,
+                                 const QVariantList &p_offsets,
+                                 const QStringList &p_anchors,
+                                 const QVariantList &p_anchorOffsets)
+{
+    m_sourceLineMap.reset(p_lines, p_offsets, p_anchors, p_anchorOffsets);
 }
 
 void VDocument::setHeader(const QString &anchor)
@@ -58,9 +455,19 @@ void VDocument::setHeader(const QString &anchor)
 void VDocument::setHtml(const QString &html)
 {
     if (html == m_html) {
+        // The web side keeps the render of the same HTML.
+        if (!m_rendering) {
+            QMetaObject::invokeMethod(this, "finishLogics", Qt::QueuedConnection);
+        }
+
         return;
     }
+
     m_html = html;
+    m_rendering = true;
+
+    // Keep the order with the batched calls.
+    flushWebCalls();
     emit htmlChanged(m_html);
 }
 
@@ -76,7 +483,7 @@ void VDocument::keyPressEvent(int p_key, bool p_ctrl, bool p_shift, bool p_meta)
 
 void VDocument::highlightTextAsync(const QString &p_text, int p_id, unsigned long long p_timeStamp)
 {
-    emit requestHighlightText(p_text, p_id, p_timeStamp);
+    postToWeb("highlightText", QJsonArray({p_text, p_id, (double)p_timeStamp}));
 }
 
 void VDocument::highlightTextCB(const QString &p_html, int p_id, unsigned long long p_timeStamp)
@@ -90,7 +497,28 @@ void VDocument::textToHtmlAsync(int p_identitifer,
                                 const QString &p_text,
                                 bool p_inlineStyle)
 {
-    emit requestTextToHtml(p_identitifer, p_id, p_timeStamp, p_text, p_inlineStyle);
+    postToWeb("textToHtml",
+              QJsonArray({p_identitifer, p_id, p_timeStamp, p_text, p_inlineStyle}));
+}
+
+void VDocument::textToHtmlBatchAsync(int p_identitifer,
+                                     int p_timeStamp,
+                                     const QVector<int> &p_ids,
+                                     const QStringList &p_texts,
+                                     bool p_inlineStyle)
+{
+    Q_ASSERT(p_ids.size() == p_texts.size());
+    QJsonArray ids;
+    for (int id : p_ids) {
+        ids.append(id);
+    }
+
+    postToWeb("textToHtmlBatch",
+              QJsonArray({p_identitifer,
+                          p_timeStamp,
+                          ids,
+                          QJsonArray::fromStringList(p_texts),
+                          p_inlineStyle}));
 }
 
 void VDocument::htmlToTextAsync(int p_identitifer,
@@ -98,12 +526,12 @@ void VDocument::htmlToTextAsync(int p_identitifer,
                                 int p_timeStamp,
                                 const QString &p_html)
 {
-    emit requestHtmlToText(p_identitifer, p_id, p_timeStamp, p_html);
+    postToWeb("htmlToText", QJsonArray({p_identitifer, p_id, p_timeStamp, p_html}));
 }
 
 void VDocument::getHtmlContentAsync()
 {
-    emit requestHtmlContent();
+    postToWeb("htmlContent");
 }
 
 void VDocument::textToHtmlCB(int p_identitifer, int p_id, int p_timeStamp, const QString &p_html)
@@ -111,6 +539,20 @@ void VDocument::textToHtmlCB(int p_identitifer, int p_id, int p_timeStamp, const
     emit textToHtmlFinished(p_identitifer, p_id, p_timeStamp, p_html);
 }
 
+void VDocument::textToHtmlBatchCB(int p_identitifer,
+                                  int p_timeStamp,
+                                  const QVariantList &p_ids,
+                                  const QStringList &p_htmls)
+{
+    QVector<int> ids;
+    ids.reserve(p_ids.size());
+    for (auto const & id : p_ids) {
+        ids.append(id.toInt());
+    }
+
+    emit textToHtmlBatchFinished(p_identitifer, p_timeStamp, ids, p_htmls);
+}
+
 void VDocument::htmlToTextCB(int p_identitifer, int p_id, int p_timeStamp, const QString &p_text)
 {
     emit htmlToTextFinished(p_identitifer, p_id, p_timeStamp, p_text);
@@ -140,6 +582,7 @@ const VFile *VDocument::getFile() const
 void VDocument::finishLogics()
 {
     qDebug() << "Web side finished logics" << this;
+    m_rendering = false;
     emit logicsFinished();
 }
 
@@ -167,7 +610,13 @@ void VDocument::processPlantUML(int p_id, const QString &p_format, const QString
     if (!m_plantUMLHelper) {
         m_plantUMLHelper = new VPlantUMLHelper(this);
         connect(m_plantUMLHelper, &VPlantUMLHelper::resultReady,
-                this, &VDocument::plantUMLResultReady);
+                this, [this](int p_id,
+                             unsigned long long p_timeStamp,
+                             const QString &p_format,
+                             const QString &p_result) {
+                    postToWeb("handlePlantUMLResult",
+                              QJsonArray({p_id, (double)p_timeStamp, p_format, p_result}));
+                });
     }
 
     m_plantUMLHelper->processAsync(p_id, 0, p_format, p_text);
@@ -178,7 +627,13 @@ void VDocument::processGraphviz(int p_id, const QString &p_format, const QString
     if (!m_graphvizHelper) {
         m_graphvizHelper = new VGraphvizHelper(this);
         connect(m_graphvizHelper, &VGraphvizHelper::resultReady,
-                this, &VDocument::graphvizResultReady);
+                this, [this](int p_id,
+                             unsigned long long p_timeStamp,
+                             const QString &p_format,
+                             const QString &p_result) {
+                    postToWeb("handleGraphvizResult",
+                              QJsonArray({p_id, (double)p_timeStamp, p_format, p_result}));
+                });
     }
 
     m_graphvizHelper->processAsync(p_id, 0, p_format, p_text);
@@ -186,7 +641,7 @@ void VDocument::processGraphviz(int p_id, const QString &p_format, const QString
 
 void VDocument::setPreviewEnabled(bool p_enabled)
 {
-    emit requestPreviewEnabled(p_enabled);
+    postToWeb("setPreviewEnabled", QJsonArray({p_enabled}));
 }
 
 void VDocument::previewCodeBlock(int p_id,
@@ -194,12 +649,12 @@ void VDocument::previewCodeBlock(int p_id,
                                  const QString &p_text,
                                  bool p_livePreview)
 {
-    emit requestPreviewCodeBlock(p_id, p_lang, p_text, p_livePreview);
+    postToWeb("previewCodeBlock", QJsonArray({p_id, p_lang, p_text, p_livePreview}));
 }
 
 void VDocument::setPreviewContent(const QString &p_lang, const QString &p_html)
 {
-    emit requestSetPreviewContent(p_lang, p_html);
+    postToWeb("setPreviewContent", QJsonArray({p_lang, p_html}));
 }
 
 void VDocument::previewCodeBlockCB(int p_id, const QString &p_lang, const QString &p_html)
@@ -207,6 +662,11 @@ void VDocument::previewCodeBlockCB(int p_id, const QString &p_lang, const QStrin
     emit codeBlockPreviewReady(p_id, p_lang, p_html);
 }
 
+void VDocument::cacheDiagram(const QString &p_lang, const QString &p_text, const QString &p_html)
+{
+    VDiagramCache::insert(p_lang, p_text, p_html);
+}
+
 void VDocument::performSmartLivePreview(const QString &p_lang,
                                         const QString &p_text,
                                         const QString &p_hints,
@@ -214,6 +674,12 @@ void VDocument::performSmartLivePreview(const QString &p_lang,
 {
     if (!p_text.isEmpty()) {
         qDebug() << "performSmartLivePreview" << p_lang << p_text << p_hints << p_isRegex;
-        emit requestPerformSmartLivePreview(p_lang, p_text, p_hints, p_isRegex);
+        postToWeb("performSmartLivePreview", QJsonArray({p_lang, p_text, p_hints, p_isRegex}));
     }
 }
+
+void VDocument::muteWebView(bool p_muted)
+{
+    m_webViewMuted = p_muted;
+    postToWeb("mute", QJsonArray({m_webViewMuted}));
+}
@@ -3,32 +3,49 @@
 
 #include <QObject>
 #include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QJsonArray>
+#include <QVariantList>
 
 #include "vwordcountinfo.h"
+#include "vsourcelinemap.h"
+#include "vtableofcontent.h"
 
 class VFile;
 class VPlantUMLHelper;
 class VGraphvizHelper;
+class QTimer;
 
 class VDocument : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(QString text MEMBER m_text NOTIFY textChanged)
-    Q_PROPERTY(QString toc MEMBER m_toc NOTIFY tocChanged)
     Q_PROPERTY(QString html MEMBER m_html NOTIFY htmlChanged)
 
 public:
     // @p_file could be NULL.
     VDocument(const VFile *p_file, QObject *p_parent = 0);
 
-    QString getToc();
+    // Headers of the last render, including the empty ones filling level gaps.
+    const QVector<VTableOfContentItem> &getTocItems() const;
 
     // Scroll to @anchor in the web.
     // @anchor is the id without '#', like "toc_1". If empty, will scroll to top.
     void scrollToAnchor(const QString &anchor);
 
+    // Scroll to @p_offset in the web, such as the one from the source line map.
+    void scrollToOffset(int p_offset);
+
     void setHtml(const QString &html);
 
+    // Render the content of the file in the web side, or just finish logics
+    // if the web side has rendered the same content.
+    void renderText();
+
+    // Forget what the web side has rendered, such as when it is reloaded.
+    void resetRender();
+
     // Request to highlight a segment text.
     // Use p_id to identify the result.
     void highlightTextAsync(const QString &p_text, int p_id, unsigned long long p_timeStamp);
@@ -40,6 +57,14 @@ public:
                          const QString &p_text,
                          bool p_inlineStyle);
 
+    // Request to convert @p_texts to HTML in one call.
+    // @p_ids: id of each text.
+    void textToHtmlBatchAsync(int p_identitifer,
+                              int p_timeStamp,
+                              const QVector<int> &p_ids,
+                              const QStringList &p_texts,
+                              bool p_inlineStyle);
+
     // Request to convert @p_html to Markdown text.
     void htmlToTextAsync(int p_identitifer,
                          int p_id,
@@ -59,6 +84,13 @@ public:
 
     const VWordCountInfo &getWordCountInfo() const;
 
+    // Map of the source lines of the last render.
+    const VSourceLineMap &getSourceLineMap() const;
+
+    // Bytes held on this side for the web side, such as the HTML and the
+    // blocks of the text sent.
+    qint64 approximateBytes() const;
+
     // Whether change to preview mode.
     void setPreviewEnabled(bool p_enabled);
 
@@ -85,26 +117,41 @@ public:
 public slots:
     // Will be called in the HTML side
 
-    // @toc: the HTML of the TOC.
-    // @baseLevel: the base level of @toc, starting from 1. It is the top level
-    // in the @toc.
-    void setToc(const QString &toc, int baseLevel);
+    // @p_items: the headers of the render as flat triples of level, anchor and
+    // HTML-escaped title. Levels start from 1 at the top level of the headers.
+    // Headers with empty anchor fill the gaps between levels.
+    void setTocItems(const QVariantList &p_items);
 
     // When the Web view has been scrolled, it will signal current header anchor.
     // Empty @anchor to indicate an invalid header.
     // The header does not begins with '#'.
     void setHeader(const QString &anchor);
 
+    // Called once per render with the offsets of the source lines and headers.
+    void setSourceLineMap(const QVariantList &p_lines,
+                          const QVariantList &p_offsets,
+                          const QStringList &p_anchors,
+                          const QVariantList &p_anchorOffsets);
+
     void setLog(const QString &p_log);
     void keyPressEvent(int p_key, bool p_ctrl, bool p_shift, bool p_meta);
     void updateText();
 
+    // Send the text via patches instead of textChanged() from now on,
+    // starting with the whole text.
+    void enableTextPatch();
+
     void highlightTextCB(const QString &p_html, int p_id, unsigned long long p_timeStamp);
 
     void noticeReadyToHighlightText();
 
     void textToHtmlCB(int p_identitifer, int p_id, int p_timeStamp, const QString &p_html);
 
+    void textToHtmlBatchCB(int p_identitifer,
+                           int p_timeStamp,
+                           const QVariantList &p_ids,
+                           const QStringList &p_htmls);
+
     void htmlToTextCB(int p_identitifer, int p_id, int p_timeStamp, const QString &p_text);
 
     void noticeReadyToTextToHtml();
@@ -129,12 +176,18 @@ public slots:
 
     void previewCodeBlockCB(int p_id, const QString &p_lang, const QString &p_html);
 
+    // Web-side call this to cache the rendered @p_html of diagram @p_text.
+    void cacheDiagram(const QString &p_lang, const QString &p_text, const QString &p_html);
+
+    // Calls of the slots above queued by the web side within a frame, each
+    // of which is an array of the name and the arguments.
+    void handleBatchedCalls(const QJsonArray &p_calls);
+
 signals:
     void textChanged(const QString &text);
 
-    void tocChanged(const QString &toc);
-
-    void requestScrollToAnchor(const QString &anchor);
+    // Emitted only when the headers differ from the last render.
+    void tocItemsChanged(const QVector<VTableOfContentItem> &p_items);
 
     // @anchor is the id of that anchor, without '#'.
     void headerChanged(const QString &anchor);
@@ -143,30 +196,20 @@ signals:
 
     void keyPressed(int p_key, bool p_ctrl, bool p_shift, bool p_meta);
 
-    void requestHighlightText(const QString &p_text, int p_id, unsigned long long p_timeStamp);
-
     void textHighlighted(const QString &p_html, int p_id, unsigned long long p_timeStamp);
 
     void readyToHighlightText();
 
     void logicsFinished();
 
-    void requestTextToHtml(int p_identitifer,
-                           int p_id,
-                           int p_timeStamp,
-                           const QString &p_text,
-                           bool p_inlineStyle);
-
-    void requestHtmlToText(int p_identitifer,
-                           int p_id,
-                           int p_timeStamp,
-                           const QString &p_html);
-
     void textToHtmlFinished(int p_identitifer, int p_id, int p_timeStamp, const QString &p_html);
 
-    void htmlToTextFinished(int p_identitifer, int p_id, int p_timeStamp, const QString &p_text);
+    void textToHtmlBatchFinished(int p_identitifer,
+                                 int p_timeStamp,
+                                 const QVector<int> &p_ids,
+                                 const QStringList &p_htmls);
 
-    void requestHtmlContent();
+    void htmlToTextFinished(int p_identitifer, int p_id, int p_timeStamp, const QString &p_text);
 
     void htmlContentFinished(const QString &p_headContent,
                              const QString &p_styleContent,
@@ -174,36 +217,43 @@ signals:
 
     void wordCountInfoUpdated();
 
-    void plantUMLResultReady(int p_id,
-                             unsigned long long p_timeStamp,
-                             const QString &p_format,
-                             const QString &p_result);
+    void codeBlockPreviewReady(int p_id, const QString &p_lang, const QString &p_html);
 
-    void graphvizResultReady(int p_id,
-                             unsigned long long p_timeStamp,
-                             const QString &p_format,
-                             const QString &p_result);
+    // Calls of the web side handlers queued within a frame, each of which is
+    // an array of the name and the arguments.
+    void callsBatched(const QJsonArray &p_calls);
 
-    void requestPreviewEnabled(bool p_enabled);
+private slots:
+    void flushWebCalls();
 
-    void requestPreviewCodeBlock(int p_id,
-                                 const QString &p_lang,
-                                 const QString &p_text,
-                                 bool p_livePreview);
+private:
+    struct TextBlock
+    {
+        int m_id;
+        QString m_text;
+    };
 
-    void requestSetPreviewContent(const QString &p_lang, const QString &p_html);
+    // Patch the web side with the blocks of @p_text changed since the last time.
+    // Each patch replaces some top-level blocks with new blocks, each of which
+    // is an object with "id" and "text". Blocks not changed keep their IDs.
+    void patchText(const QString &p_text);
 
-    void codeBlockPreviewReady(int p_id, const QString &p_lang, const QString &p_html);
+    // Queue a call of the web side handler @p_name to send in the batch of
+    // this frame.
+    void postToWeb(const QString &p_name, const QJsonArray &p_args = QJsonArray());
 
-    void requestMuted(bool p_muted);
+    void dispatchCall(const QString &p_name, const QJsonArray &p_call);
 
-    void requestPerformSmartLivePreview(const QString &p_lang,
-                                        const QString &p_text,
-                                        const QString &p_hints,
-                                        bool p_isRegex);
+    // Send the cached renderings of the diagrams in @p_text to the web side
+    // so it does not render them again.
+    void postCachedDiagrams(const QString &p_text);
+
+    // Split @p_text into top-level blocks separated by blank lines, which
+    // could be concatenated to @p_text.
+    static QStringList splitTextIntoBlocks(const QString &p_text);
+
+    QVector<VTableOfContentItem> m_tocItems;
 
-private:
-    QString m_toc;
     QString m_header;
 
     // m_text does NOT contain actual content.
@@ -212,6 +262,12 @@ private:
     // When using Hoedown, m_html will contain the html content.
     QString m_html;
 
+    // Hash of the text rendered by the web side.
+    QByteArray m_renderedTextHash;
+
+    // Whether the web side is rendering and will finish logics.
+    bool m_rendering;
+
     const VFile *m_file;
 
     // Whether the web side is ready to handle highlight text request.
@@ -222,6 +278,8 @@ private:
 
     VWordCountInfo m_wordCountInfo;
 
+    VSourceLineMap m_sourceLineMap;
+
     VPlantUMLHelper *m_plantUMLHelper;
 
     VGraphvizHelper *m_graphvizHelper;
@@ -230,6 +288,19 @@ private:
 
     // Whether propogate signals from web view.
     bool m_webViewMuted;
+
+    // Whether the web side accepts the text patches.
+    bool m_textPatchEnabled;
+
+    // Blocks of the text sent to the web side.
+    QVector<TextBlock> m_blocks;
+
+    int m_nextBlockID;
+
+    // Web calls queued within this frame.
+    QJsonArray m_pendingWebCalls;
+
+    QTimer *m_webCallTimer;
 };
 
 inline bool VDocument::isReadyToHighlight() const
@@ -247,14 +318,19 @@ inline const VWordCountInfo &VDocument::getWordCountInfo() const
     return m_wordCountInfo;
 }
 
-inline int VDocument::registerIdentifier()
+inline const VSourceLineMap &VDocument::getSourceLineMap() const
 {
-    return ++m_nextID;
+    return m_sourceLineMap;
+}
+
+inline const QVector<VTableOfContentItem> &VDocument::getTocItems() const
+{
+    return m_tocItems;
 }
 
-inline void VDocument::muteWebView(bool p_muted)
+inline int VDocument::registerIdentifier()
 {
-    m_webViewMuted = p_muted;
-    emit requestMuted(m_webViewMuted);
+    return ++m_nextID;
 }
+
 #endif // VDOCUMENT_H
@@ -0,0 +1,108 @@
+#include "vdocumentgovernor.h"
+
+#include <QDebug>
+
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Minimum number of blocks of a document to reduce its features.
+#define REDUCED_BLOCK_COUNT 200000
+
+// Parse time in us of the whole document above which a parse is slow.
+#define SLOW_PARSE_TIME 300000
+
+// Parse time in us above which the parse is stopped at all.
+#define MINIMAL_PARSE_TIME 2000000
+
+// Successive slow parses to lower the level, so a parse slowed down by other
+// work will not count.
+#define SLOW_PARSES_TO_LOWER 3
+
+VDocumentGovernor::VDocumentGovernor(QObject *p_parent)
+    : QObject(p_parent),
+      m_level(Level::Full),
+      m_forced(false),
+      m_slowParses(0)
+{
+}
+
+void VDocumentGovernor::evaluate(qint64 p_size, int p_blockCount, bool p_largeFile)
+{
+    Level level = Level::Full;
+    qint64 reducedSize = g_config->getReducedFeaturesSize();
+    if (p_largeFile) {
+        level = Level::Minimal;
+    } else if ((reducedSize > 0 && p_size >= reducedSize)
+               || p_blockCount >= REDUCED_BLOCK_COUNT) {
+        level = Level::Reduced;
+    }
+
+    m_slowParses = 0;
+
+    Level oldLevel = getLevel();
+    m_level = level;
+    if (getLevel() != oldLevel) {
+        qDebug() << "document feature level" << levelName(getLevel()) << p_size << p_blockCount;
+        emit levelChanged(getLevel());
+    }
+}
+
+void VDocumentGovernor::recordParseTime(qint64 p_usecs)
+{
+    if (p_usecs < SLOW_PARSE_TIME) {
+        m_slowParses = 0;
+        return;
+    }
+
+    if (++m_slowParses < SLOW_PARSES_TO_LOWER) {
+        return;
+    }
+
+    m_slowParses = 0;
+    lowerLevel(p_usecs >= MINIMAL_PARSE_TIME ? Level::Minimal : Level::Reduced);
+}
+
+void VDocumentGovernor::lowerLevel(Level p_level)
+{
+    if (p_level <= m_level) {
+        return;
+    }
+
+    qDebug() << "lower document feature level to" << levelName(p_level);
+    m_level = p_level;
+    if (!m_forced) {
+        emit levelChanged(m_level);
+    }
+}
+
+void VDocumentGovernor::setFullFeaturesForced(bool p_forced)
+{
+    if (m_forced == p_forced) {
+        return;
+    }
+
+    Level oldLevel = getLevel();
+    m_forced = p_forced;
+    m_slowParses = 0;
+    if (getLevel() != oldLevel) {
+        emit levelChanged(getLevel());
+    }
+}
+
+QString VDocumentGovernor::levelName(Level p_level)
+{
+    switch (p_level) {
+    case Level::Full:
+        return tr("Full Features");
+
+    case Level::Reduced:
+        return tr("Reduced Features");
+
+    case Level::Minimal:
+        return tr("Plain Text");
+
+    default:
+        return QString();
+    }
+}
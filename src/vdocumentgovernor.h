@@ -0,0 +1,79 @@
+#ifndef VDOCUMENTGOVERNOR_H
+#define VDOCUMENTGOVERNOR_H
+
+#include <QObject>
+
+// Decide the features to keep for the document of one editor by its size,
+// block count and measured parse time, so a huge note is still responsive.
+// The level is only lowered automatically. The user could force full features.
+class VDocumentGovernor : public QObject
+{
+    Q_OBJECT
+public:
+    enum Level
+    {
+        // All the features.
+        Full = 0,
+
+        // No in-place previews, code block highlight, or trailing space and
+        // tab highlights.
+        Reduced,
+
+        // Plain text without parse, like large file mode.
+        Minimal
+    };
+
+    explicit VDocumentGovernor(QObject *p_parent = nullptr);
+
+    // Evaluate the document after it is loaded.
+    // @p_size: size in bytes of the file.
+    // @p_largeFile: whether it is opened in large file mode.
+    void evaluate(qint64 p_size, int p_blockCount, bool p_largeFile);
+
+    // Record the time of a parse of the whole document.
+    void recordParseTime(qint64 p_usecs);
+
+    // The level in effect.
+    Level getLevel() const;
+
+    // The level decided by the measurements.
+    Level getMeasuredLevel() const;
+
+    bool isFullFeaturesForced() const;
+
+    // Force full features regardless of the measurements.
+    void setFullFeaturesForced(bool p_forced);
+
+    static QString levelName(Level p_level);
+
+signals:
+    // Emitted when the level in effect changes.
+    void levelChanged(VDocumentGovernor::Level p_level);
+
+private:
+    void lowerLevel(Level p_level);
+
+    Level m_level;
+
+    bool m_forced;
+
+    // Number of successive slow parses.
+    int m_slowParses;
+};
+
+inline VDocumentGovernor::Level VDocumentGovernor::getLevel() const
+{
+    return m_forced ? Level::Full : m_level;
+}
+
+inline VDocumentGovernor::Level VDocumentGovernor::getMeasuredLevel() const
+{
+    return m_level;
+}
+
+inline bool VDocumentGovernor::isFullFeaturesForced() const
+{
+    return m_forced;
+}
+
+#endif // VDOCUMENTGOVERNOR_H
@@ -0,0 +1,114 @@
+#include "vdocumentstructure.h"
+
+#include "peghighlighterresult.h"
+
+static quint64 s_lastVersion = 0;
+
+// Compare the items of two versions with @p_equal(old index, new index).
+template <typename Func>
+static VDocumentStructure::Diff diffItems(int p_oldSize, int p_newSize, Func p_equal)
+{
+    VDocumentStructure::Diff diff;
+    int sz = qMin(p_oldSize, p_newSize);
+    int i = 0;
+    while (i < sz && p_equal(i)) {
+        ++i;
+    }
+
+    diff.m_firstChanged = i;
+    diff.m_changed = i < sz || p_oldSize != p_newSize;
+    return diff;
+}
+
+VDocumentStructure::VDocumentStructure(const PegHighlighterResult &p_result,
+                                       const QString &p_text,
+                                       bool p_mathjaxEnabled,
+                                       const QSharedPointer<const VDocumentStructure> &p_prev)
+    : m_version(++s_lastVersion),
+      m_previousVersion(p_prev ? p_prev->m_version : 0),
+      m_timeStamp(p_result.m_timeStamp),
+      m_headerRegions(p_result.m_headerRegions),
+      m_imageRegions(p_result.m_imageRegions),
+      m_codeBlocks(p_result.m_codeBlocks),
+      m_tableBlocks(p_result.m_tableBlocks)
+{
+    if (p_mathjaxEnabled) {
+        m_mathjaxBlocks = p_result.m_mathjaxBlocks;
+    }
+
+    m_headerTexts = regionTexts(p_text, m_headerRegions);
+    m_imageTexts = regionTexts(p_text, m_imageRegions);
+
+    m_tableTexts.reserve(m_tableBlocks.size());
+    for (auto const & table : m_tableBlocks) {
+        m_tableTexts.append(p_text.mid(table.m_startPos, table.m_endPos - table.m_startPos));
+    }
+
+    if (p_prev) {
+        calculateDiffs(*p_prev);
+    }
+}
+
+QVector<QString> VDocumentStructure::regionTexts(const QString &p_text,
+                                                 const QVector<VElementRegion> &p_regions)
+{
+    QVector<QString> texts;
+    texts.reserve(p_regions.size());
+    for (auto const & reg : p_regions) {
+        texts.append(p_text.mid(reg.m_startPos, reg.m_endPos - reg.m_startPos));
+    }
+
+    return texts;
+}
+
+void VDocumentStructure::calculateDiffs(const VDocumentStructure &p_prev)
+{
+    m_diffs[Headers] = diffItems(p_prev.m_headerRegions.size(),
+                                 m_headerRegions.size(),
+                                 [this, &p_prev](int i) {
+                                     return m_headerRegions[i] == p_prev.m_headerRegions[i]
+                                            && m_headerTexts[i] == p_prev.m_headerTexts[i];
+                                 });
+
+    m_diffs[ImageLinks] = diffItems(p_prev.m_imageRegions.size(),
+                                    m_imageRegions.size(),
+                                    [this, &p_prev](int i) {
+                                        return m_imageRegions[i] == p_prev.m_imageRegions[i]
+                                               && m_imageTexts[i] == p_prev.m_imageTexts[i];
+                                    });
+
+    m_diffs[CodeBlocks] = diffItems(p_prev.m_codeBlocks.size(),
+                                    m_codeBlocks.size(),
+                                    [this, &p_prev](int i) {
+                                        const VCodeBlock &a = m_codeBlocks[i];
+                                        const VCodeBlock &b = p_prev.m_codeBlocks[i];
+                                        return a.m_startPos == b.m_startPos
+                                               && a.m_startBlock == b.m_startBlock
+                                               && a.m_endBlock == b.m_endBlock
+                                               && a.m_lang == b.m_lang
+                                               && a.m_text == b.m_text;
+                                    });
+
+    m_diffs[MathjaxBlocks] = diffItems(p_prev.m_mathjaxBlocks.size(),
+                                       m_mathjaxBlocks.size(),
+                                       [this, &p_prev](int i) {
+                                           const VMathjaxBlock &a = m_mathjaxBlocks[i];
+                                           const VMathjaxBlock &b = p_prev.m_mathjaxBlocks[i];
+                                           return a.m_blockNumber == b.m_blockNumber
+                                                  && a.m_previewedAsBlock == b.m_previewedAsBlock
+                                                  && a.m_index == b.m_index
+                                                  && a.m_length == b.m_length
+                                                  && a.m_text == b.m_text;
+                                       });
+
+    m_diffs[TableBlocks] = diffItems(p_prev.m_tableBlocks.size(),
+                                     m_tableBlocks.size(),
+                                     [this, &p_prev](int i) {
+                                         const VTableBlock &a = m_tableBlocks[i];
+                                         const VTableBlock &b = p_prev.m_tableBlocks[i];
+                                         return a.m_startPos == b.m_startPos
+                                                && a.m_endPos == b.m_endPos
+                                                && a.m_borders == b.m_borders
+                                                && m_tableTexts[i] == p_prev.m_tableTexts[i];
+                                     });
+}
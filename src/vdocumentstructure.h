@@ -0,0 +1,162 @@
+#ifndef VDOCUMENTSTRUCTURE_H
+#define VDOCUMENTSTRUCTURE_H
+
+#include <QVector>
+#include <QString>
+#include <QSharedPointer>
+
+#include "markdownhighlighterdata.h"
+
+class PegHighlighterResult;
+
+// Immutable structure of a Markdown document from one parse result, shared by
+// all the consumers of the highlighter, such as the outline and the previews.
+// Each version carries the diff of each category against the previous version,
+// so that a consumer having handled the previous version could skip an
+// unchanged category.
+class VDocumentStructure
+{
+public:
+    enum Category
+    {
+        Headers = 0,
+        ImageLinks,
+        CodeBlocks,
+        MathjaxBlocks,
+        TableBlocks,
+        MaxNumberOfCategories
+    };
+
+    // Diff of one category against the previous version.
+    struct Diff
+    {
+        Diff()
+            : m_changed(true),
+              m_firstChanged(0)
+        {
+        }
+
+        bool m_changed;
+
+        // Index of the first item differing from the previous version.
+        int m_firstChanged;
+    };
+
+    // @p_text: the text of the document parsed into @p_result.
+    VDocumentStructure(const PegHighlighterResult &p_result,
+                       const QString &p_text,
+                       bool p_mathjaxEnabled,
+                       const QSharedPointer<const VDocumentStructure> &p_prev);
+
+    // Unique among all the documents. Starting from 1.
+    quint64 version() const;
+
+    // 0 if there is no previous version.
+    quint64 previousVersion() const;
+
+    TimeStamp timeStamp() const;
+
+    const Diff &diff(Category p_category) const;
+
+    // Whether a consumer having handled version @p_handledVersion could skip
+    // @p_category of this version.
+    // Handling the same version again is left to the consumer.
+    bool isUnchangedSince(quint64 p_handledVersion, Category p_category) const;
+
+    // Sorted by the start position.
+    const QVector<VElementRegion> &headerRegions() const;
+
+    const QVector<VElementRegion> &imageRegions() const;
+
+    const QVector<VCodeBlock> &codeBlocks() const;
+
+    // Empty if Mathjax is disabled.
+    const QVector<VMathjaxBlock> &mathjaxBlocks() const;
+
+    const QVector<VTableBlock> &tableBlocks() const;
+
+private:
+    static QVector<QString> regionTexts(const QString &p_text,
+                                        const QVector<VElementRegion> &p_regions);
+
+    void calculateDiffs(const VDocumentStructure &p_prev);
+
+    quint64 m_version;
+
+    quint64 m_previousVersion;
+
+    TimeStamp m_timeStamp;
+
+    Diff m_diffs[MaxNumberOfCategories];
+
+    QVector<VElementRegion> m_headerRegions;
+
+    QVector<VElementRegion> m_imageRegions;
+
+    QVector<VCodeBlock> m_codeBlocks;
+
+    QVector<VMathjaxBlock> m_mathjaxBlocks;
+
+    QVector<VTableBlock> m_tableBlocks;
+
+    // Texts of the regions to tell the changes of the content.
+    QVector<QString> m_headerTexts;
+
+    QVector<QString> m_imageTexts;
+
+    QVector<QString> m_tableTexts;
+};
+
+inline quint64 VDocumentStructure::version() const
+{
+    return m_version;
+}
+
+inline quint64 VDocumentStructure::previousVersion() const
+{
+    return m_previousVersion;
+}
+
+inline TimeStamp VDocumentStructure::timeStamp() const
+{
+    return m_timeStamp;
+}
+
+inline const VDocumentStructure::Diff &VDocumentStructure::diff(Category p_category) const
+{
+    return m_diffs[p_category];
+}
+
+inline bool VDocumentStructure::isUnchangedSince(quint64 p_handledVersion, Category p_category) const
+{
+    return p_handledVersion != 0
+           && p_handledVersion == m_previousVersion
+           && !m_diffs[p_category].m_changed;
+}
+
+inline const QVector<VElementRegion> &VDocumentStructure::headerRegions() const
+{
+    return m_headerRegions;
+}
+
+inline const QVector<VElementRegion> &VDocumentStructure::imageRegions() const
+{
+    return m_imageRegions;
+}
+
+inline const QVector<VCodeBlock> &VDocumentStructure::codeBlocks() const
+{
+    return m_codeBlocks;
+}
+
+inline const QVector<VMathjaxBlock> &VDocumentStructure::mathjaxBlocks() const
+{
+    return m_mathjaxBlocks;
+}
+
+inline const QVector<VTableBlock> &VDocumentStructure::tableBlocks() const
+{
+    return m_tableBlocks;
+}
+
+#endif // VDOCUMENTSTRUCTURE_H
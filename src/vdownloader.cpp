@@ -1,39 +1,27 @@
 #include "vdownloader.h"
 
-#include "utils/vutils.h"
+#include <QDebug>
+#include <QThread>
+#include <QEventLoop>
+#include <QCoreApplication>
+#include <QNetworkAccessManager>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+
+#include "vhttpfetcher.h"
 
 VDownloader::VDownloader(QObject *parent)
     : QObject(parent)
 {
-    connect(&webCtrl, &QNetworkAccessManager::finished,
-            this, &VDownloader::handleDownloadFinished);
+    connect(VHttpFetcher::inst(), &VHttpFetcher::fetched,
+            this, &VDownloader::handleFetched);
 }
 
-void VDownloader::handleDownloadFinished(QNetworkReply *reply)
+void VDownloader::handleFetched(const QByteArray &p_data, const QString &p_url)
 {
-    if (reply->error() != QNetworkReply::NoError) {
-        qWarning() << "download reply error" << reply->error();
+    if (m_pendingUrls.remove(p_url)) {
+        emit downloadFinished(p_data, p_url);
     }
-
-    data = reply->readAll();
-    reply->deleteLater();
-    // The url() of the reply may be redirected and different from that of the request.
-    emit downloadFinished(data, reply->request().url().toString());
-}
-
-static QNetworkRequest networkRequest(const QUrl &p_url)
-{
-    QNetworkRequest request(p_url);
-    /*
-    QSslConfiguration config = QSslConfiguration::defaultConfiguration();
-    config.setProtocol(QSsl::SslV3);
-    config.setPeerVerifyMode(QSslSocket::VerifyNone);
-    request.setSslConfiguration(config);
-    */
-
-    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
-
-    return request;
 }
 
 void VDownloader::download(const QUrl &p_url)
@@ -42,7 +30,8 @@ void VDownloader::download(const QUrl &p_url)
         return;
     }
 
-    webCtrl.get(networkRequest(p_url));
+    m_pendingUrls.insert(p_url.toString());
+    VHttpFetcher::inst()->fetch(p_url);
 }
 
 QByteArray VDownloader::downloadSync(const QUrl &p_url)
@@ -52,24 +41,35 @@ QByteArray VDownloader::downloadSync(const QUrl &p_url)
         return data;
     }
 
-    bool finished = false;
-    QNetworkAccessManager nam;
-    connect(&nam, &QNetworkAccessManager::finished,
-            [&data, &finished](QNetworkReply *p_reply) {
-                if (p_reply->error() != QNetworkReply::NoError) {
-                    qWarning() << "download reply error" << p_reply->error();
-                }
+    QEventLoop loop;
+    if (QThread::currentThread() == QCoreApplication::instance()->thread()) {
+        VDownloader downloader;
+        connect(&downloader, &VDownloader::downloadFinished,
+                &loop, [&data, &loop](const QByteArray &p_data, const QString &p_url) {
+                    Q_UNUSED(p_url);
+                    data = p_data;
+                    loop.quit();
+                });
 
-                data = p_reply->readAll();
-                p_reply->deleteLater();
-                finished = true;
-            });
+        downloader.download(p_url);
+        loop.exec();
+        return data;
+    }
 
-    nam.get(networkRequest(p_url));
+    // The shared fetcher lives in the GUI thread.
+    QNetworkAccessManager nam;
+    QNetworkRequest request(p_url);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+    QNetworkReply *reply = nam.get(request);
+    connect(reply, &QNetworkReply::finished,
+            &loop, &QEventLoop::quit);
+    loop.exec();
 
-    while (!finished) {
-        VUtils::sleepWait(100);
+    if (reply->error() != QNetworkReply::NoError) {
+        qWarning() << "download reply error" << reply->error();
     }
 
+    data = reply->readAll();
+    delete reply;
     return data;
 }
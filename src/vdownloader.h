@@ -4,17 +4,21 @@
 #include <QObject>
 #include <QUrl>
 #include <QByteArray>
-#include <QNetworkAccessManager>
-#include <QNetworkRequest>
-#include <QNetworkReply>
+#include <QSet>
 
+// Download resources via the shared VHttpFetcher, so the downloads of all the
+// downloaders are cached on disk and requests of the same URL are merged.
 class VDownloader : public QObject
 {
     Q_OBJECT
 public:
     explicit VDownloader(QObject *parent = 0);
+
+    // Download @p_url asynchronously and emit downloadFinished() when finished.
     void download(const QUrl &p_url);
 
+    // Wait for the download of @p_url in a local event loop.
+    // Prefer download() in new code.
     static QByteArray downloadSync(const QUrl &p_url);
 
 signals:
@@ -22,11 +26,11 @@ signals:
     void downloadFinished(const QByteArray &data, const QString &url);
 
 private slots:
-    void handleDownloadFinished(QNetworkReply *reply);
+    void handleFetched(const QByteArray &p_data, const QString &p_url);
 
 private:
-    QNetworkAccessManager webCtrl;
-    QByteArray data;
+    // Urls requested by this downloader and not finished yet.
+    QSet<QString> m_pendingUrls;
 };
 
 #endif // VDOWNLOADER_H
@@ -295,6 +295,29 @@ int VEditArea::openFileInWindow(int windowIndex, VFile *p_file, OpenFileMode p_m
     return win->openFile(p_file, p_mode);
 }
 
+VEditTab *VEditArea::openFileDeferred(VFile *p_file,
+                                      OpenFileMode p_mode,
+                                      const VEditTab *p_after)
+{
+    if (!findTabsByFile(p_file).isEmpty()) {
+        return NULL;
+    }
+
+    if (curWindowIndex == -1) {
+        insertSplitWindow(0);
+        curWindowIndex = 0;
+    }
+
+    VEditWindow *win = getWindow(curWindowIndex);
+    int idx = p_after ? win->indexOf(const_cast<VEditTab *>(p_after)) : -1;
+    if (idx == -1) {
+        idx = win->currentIndex();
+    }
+
+    int tabIdx = win->openFileDeferred(p_file, p_mode, idx + 1);
+    return win->getTab(tabIdx);
+}
+
 void VEditArea::setCurrentTab(int windowIndex, int tabIndex, bool setFocus)
 {
     VEditWindow *win = getWindow(windowIndex);
@@ -845,9 +868,12 @@ bool VEditArea::handleKeyNavigation(int p_key, bool &p_succeed)
     return ret;
 }
 
-int VEditArea::openFiles(const QVector<VFileSessionInfo> &p_files, bool p_oneByOne)
+int VEditArea::openFiles(const QVector<VFileSessionInfo> &p_files,
+                         bool p_oneByOne,
+                         bool p_deferInactive)
 {
     VFile *curFile = NULL;
+    const VEditTab *lastTab = NULL;
     int nrOpened = 0;
     for (auto const & info : p_files) {
         QString filePath = VUtils::validFilePathToOpen(info.m_file);
@@ -860,7 +886,19 @@ int VEditArea::openFiles(const QVector<VFileSessionInfo> &p_files, bool p_oneByO
             continue;
         }
 
-        VEditTab *tab = openFile(file, info.m_mode, true);
+        // Only the active one is read now. Others wait for activation.
+        VEditTab *tab = NULL;
+        if (p_deferInactive
+            && !info.m_active
+            && file->getDocType() == DocType::Markdown) {
+            tab = openFileDeferred(file, info.m_mode, lastTab);
+        }
+
+        if (!tab) {
+            tab = openFile(file, info.m_mode, true);
+        }
+
+        lastTab = tab;
         ++nrOpened;
 
         if (info.m_active) {
@@ -1236,6 +1274,7 @@ void VEditArea::recordClosedFile(const VFileSessionInfo &p_file)
 
 void VEditArea::handleFileTimerTimeout()
 {
+    qint64 idleMSecs = (qint64)g_config->getTabHibernationInterval() * 60 * 1000;
     int nrWin = splitter->count();
     for (int i = 0; i < nrWin; ++i) {
         // Check whether opened files have been changed outside.
@@ -1245,6 +1284,10 @@ void VEditArea::handleFileTimerTimeout()
         if (m_autoSave) {
             win->saveAll();
         }
+
+        if (idleMSecs > 0) {
+            win->hibernateIdleTabs(idleMSecs);
+        }
     }
 }
 
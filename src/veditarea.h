@@ -84,7 +84,10 @@ public:
     bool handleKeyNavigation(int p_key, bool &p_succeed) Q_DECL_OVERRIDE;
 
     // Open files @p_files.
-    int openFiles(const QVector<VFileSessionInfo> &p_files, bool p_oneByOne = false);
+    // @p_deferInactive: whether defer reading the inactive Markdown files until activated.
+    int openFiles(const QVector<VFileSessionInfo> &p_files,
+                  bool p_oneByOne = false,
+                  bool p_deferInactive = false);
 
     // Record a closed file in the stack.
     void recordClosedFile(const VFileSessionInfo &p_file);
@@ -192,6 +195,11 @@ private:
     QVector<QPair<int, int> > findTabsByFile(const VFile *p_file);
 
     int openFileInWindow(int windowIndex, VFile *p_file, OpenFileMode p_mode);
+
+    // Open Markdown file @p_file in current window right after @p_after
+    // without reading it until activated.
+    // Returns NULL if it is opened already.
+    VEditTab *openFileDeferred(VFile *p_file, OpenFileMode p_mode, const VEditTab *p_after);
     void setCurrentTab(int windowIndex, int tabIndex, bool setFocus);
     void setCurrentWindow(int windowIndex, bool setFocus);
 
@@ -3,6 +3,8 @@
 #include <QtWidgets>
 #include <QTextDocument>
 
+#include <algorithm>
+
 #include "vconfigmanager.h"
 #include "utils/vutils.h"
 #include "utils/veditutils.h"
@@ -11,11 +13,22 @@
 #include "utils/vmetawordmanager.h"
 #include "utils/vvim.h"
 #include "vnote.h"
+#include "vwordindex.h"
+#include "vstructureindex.h"
+#include "vcompletiondictionary.h"
+#include "vmultipatternmatcher.h"
+#include "vregexpsearcher.h"
+#include "vnotefile.h"
+#include "vsearch.h"
 
 extern VConfigManager *g_config;
 
 extern VMetaWordManager *g_mwMgr;
 
+// Find again from scratch instead of updating the cached matches if a change
+// spans more blocks than this.
+#define MAX_FIND_CACHE_UPDATE_BLOCKS 64
+
 VEditor::VEditor(VFile *p_file,
                  QWidget *p_editor,
                  const QSharedPointer<VTextEditCompleter> &p_completer)
@@ -29,7 +42,13 @@ VEditor::VEditor(VFile *p_file,
       m_trailingSpaceSelectionTS(0),
       m_completer(p_completer),
       m_trailingSpaceHighlightEnabled(false),
-      m_tabHighlightEnabled(false)
+      m_tabHighlightEnabled(false),
+      m_spaceHighlightsSuppressed(false),
+      m_highlightFirstBlock(-1),
+      m_highlightLastBlock(-1),
+      m_peekSearchId(0),
+      m_batchUpdateDepth(0),
+      m_peekSearchTimeStamp(0)
 {
 }
 
@@ -39,6 +58,10 @@ VEditor::~VEditor()
         m_completer->setWidget(NULL);
     }
 
+    if (m_wordIndex) {
+        VCompletionDictionary::inst()->unregisterIndex(m_wordIndex.data());
+    }
+
     cleanUp();
 }
 
@@ -59,8 +82,17 @@ void VEditor::init()
     const int labelSize = 64;
 
     m_document = documentW();
-    QObject::connect(m_document, &QTextDocument::contentsChanged,
-                     m_object, &VEditorObject::clearFindCache);
+
+    m_wordIndex.reset(new VWordIndex(m_document));
+    m_structureIndex.reset(new VStructureIndex(m_document));
+    VCompletionDictionary::inst()->registerIndex(m_wordIndex.data());
+    QObject::connect(m_document, &QTextDocument::contentsChange,
+                     m_object, [this](int p_position, int p_charsRemoved, int p_charsAdded) {
+                         m_wordIndex->update(p_position, p_charsRemoved, p_charsAdded);
+                         m_structureIndex->update(p_position, p_charsRemoved, p_charsAdded);
+                         updateFindCache(p_position, p_charsRemoved, p_charsAdded);
+                         VSearchRefiner::notesChanged();
+                     });
 
     m_selectedWordFg = QColor(g_config->getEditorSelectedWordFg());
     m_selectedWordBg = QColor(g_config->getEditorSelectedWordBg());
@@ -102,6 +134,14 @@ void VEditor::init()
 
     m_extraSelections.resize((int)SelectionId::MaxSelection);
 
+    QObject::connect(verticalScrollBarW(), &QScrollBar::valueChanged,
+                     m_object, &VEditorObject::handleVerticalScroll);
+
+    QObject::connect(VRegExpSearcher::inst(), &VRegExpSearcher::searchFinished,
+                     m_object, [this](int p_id, int p_start, int p_length) {
+                         handlePeekSearchFinished(p_id, p_start, p_length);
+                     });
+
     updateFontAndPalette();
 
     m_config.init(QFontMetrics(m_editor->font()), false);
@@ -125,13 +165,13 @@ void VEditor::labelTimerTimeout()
 bool VEditor::needUpdateTrailingSpaceAndTabHighlights()
 {
     bool ret = false;
-    bool space = g_config->getEnableTrailingSpaceHighlight();
+    bool space = g_config->getEnableTrailingSpaceHighlight() && !m_spaceHighlightsSuppressed;
     if (m_trailingSpaceHighlightEnabled != space) {
         m_trailingSpaceHighlightEnabled = space;
         ret = true;
     }
 
-    bool tab = g_config->getEnableTabHighlight();
+    bool tab = g_config->getEnableTabHighlight() && !m_spaceHighlightsSuppressed;
     if (m_tabHighlightEnabled != tab) {
         m_tabHighlightEnabled = tab;
         ret = true;
@@ -153,14 +193,86 @@ void VEditor::updateTrailingSpaceAndTabHighlights()
     }
 }
 
+void VEditor::setSpaceHighlightsSuppressed(bool p_suppressed)
+{
+    if (m_spaceHighlightsSuppressed == p_suppressed) {
+        return;
+    }
+
+    m_spaceHighlightsSuppressed = p_suppressed;
+    updateTrailingSpaceAndTabHighlights();
+}
+
+// Whether selections of @p_id could cover the whole document and should be
+// limited to the viewport.
+static bool isLimitedToViewport(int p_id)
+{
+    switch ((SelectionId)p_id) {
+    case SelectionId::SelectedWord:
+    case SelectionId::SearchedKeyword:
+    case SelectionId::TrailingSpace:
+    case SelectionId::Tab:
+        return true;
+
+    default:
+        return false;
+    }
+}
+
+// Append selections of sorted @p_src intersecting [@p_start, @p_end).
+static void appendInRange(QList<QTextEdit::ExtraSelection> &p_selects,
+                          const QList<QTextEdit::ExtraSelection> &p_src,
+                          int p_start,
+                          int p_end)
+{
+    auto it = std::lower_bound(p_src.begin(),
+                               p_src.end(),
+                               p_start,
+                               [](const QTextEdit::ExtraSelection &p_sel, int p_pos) {
+                                   return p_sel.cursor.selectionEnd() <= p_pos;
+                               });
+    for (; it != p_src.end() && it->cursor.selectionStart() < p_end; ++it) {
+        p_selects.append(*it);
+    }
+}
+
 void VEditor::doHighlightExtraSelections()
 {
     int nrExtra = m_extraSelections.size();
     Q_ASSERT(nrExtra == (int)SelectionId::MaxSelection);
+
+    // Limit the layers to the visible blocks with one more page above and
+    // below, which will be re-submitted on scroll.
+    int first, last;
+    visibleBlockRangeW(first, last);
+    int startPos = 0, endPos = 0;
+    if (first >= 0 && last >= first) {
+        int margin = qMax(last - first, 10);
+        first = qMax(0, first - margin);
+        last = qMin(m_document->blockCount() - 1, last + margin);
+        startPos = m_document->findBlockByNumber(first).position();
+        QTextBlock lastBlock = m_document->findBlockByNumber(last);
+        endPos = lastBlock.position() + lastBlock.length();
+    } else {
+        first = last = -1;
+    }
+
+    m_highlightFirstBlock = first;
+    m_highlightLastBlock = last;
+
     QList<QTextEdit::ExtraSelection> extraSelects;
     for (int i = 0; i < nrExtra; ++i) {
         if (i == (int)SelectionId::TrailingSpace) {
-            filterTrailingSpace(extraSelects, m_extraSelections[i]);
+            QList<QTextEdit::ExtraSelection> selects;
+            if (first == -1) {
+                selects = m_extraSelections[i];
+            } else {
+                appendInRange(selects, m_extraSelections[i], startPos, endPos);
+            }
+
+            filterTrailingSpace(extraSelects, selects);
+        } else if (first != -1 && isLimitedToViewport(i)) {
+            appendInRange(extraSelects, m_extraSelections[i], startPos, endPos);
         } else {
             extraSelects.append(m_extraSelections[i]);
         }
@@ -169,6 +281,33 @@ void VEditor::doHighlightExtraSelections()
     setExtraSelectionsW(extraSelects);
 }
 
+void VEditor::handleVerticalScroll()
+{
+    if (m_highlightFirstBlock == -1) {
+        return;
+    }
+
+    int first, last;
+    visibleBlockRangeW(first, last);
+    if (first >= m_highlightFirstBlock && last <= m_highlightLastBlock) {
+        return;
+    }
+
+    bool needHighlight = false;
+    for (int i = 0; i < m_extraSelections.size(); ++i) {
+        if (isLimitedToViewport(i) && !m_extraSelections[i].isEmpty()) {
+            needHighlight = true;
+            break;
+        }
+    }
+
+    if (needHighlight) {
+        highlightExtraSelections(true);
+    } else {
+        m_highlightFirstBlock = m_highlightLastBlock = -1;
+    }
+}
+
 void VEditor::doUpdateTrailingSpaceAndTabHighlights()
 {
     bool needHighlight = false;
@@ -234,6 +373,10 @@ void VEditor::highlightOnCursorPositionChanged()
 {
     static QTextCursor lastCursor;
 
+    if (m_batchUpdateDepth > 0) {
+        return;
+    }
+
     QTextCursor cursor = textCursorW();
     if (lastCursor.isNull() || cursor.blockNumber() != lastCursor.blockNumber()) {
         updateTrailingSpaceAndTabHighlights();
@@ -432,6 +575,8 @@ QList<QTextCursor> VEditor::findTextAll(const QString &p_text,
     return results;
 }
 
+// Merge sorted @p_part into sorted @p_result. Matches of @p_part overlapping
+// with those of @p_result are abandoned.
 static void mergeResult(QList<QTextCursor> &p_result, const QList<QTextCursor> &p_part)
 {
     if (p_result.isEmpty()) {
@@ -439,30 +584,29 @@ static void mergeResult(QList<QTextCursor> &p_result, const QList<QTextCursor> &
         return;
     }
 
+    QList<QTextCursor> merged;
+    merged.reserve(p_result.size() + p_part.size());
     int idx = 0;
     for (auto const & cur : p_part) {
-        // Find position to insert into @p_result.
-        while (idx < p_result.size()) {
-            const QTextCursor &toCur = p_result[idx];
-            if (cur.selectionEnd() <= toCur.selectionStart()) {
-                // Insert it before toCur.
-                p_result.insert(idx, cur);
-                ++idx;
-                break;
-            } else if (cur.selectionStart() < toCur.selectionEnd()) {
-                // Interleave. Abandon it.
-                break;
-            } else {
-                ++idx;
-            }
+        while (idx < p_result.size()
+               && p_result[idx].selectionEnd() <= cur.selectionStart()) {
+            merged.append(p_result[idx++]);
         }
 
-        // Insert to the end.
-        if (idx >= p_result.size()) {
-            p_result.append(cur);
-            idx = p_result.size();
+        if (idx < p_result.size()
+            && cur.selectionEnd() > p_result[idx].selectionStart()) {
+            // Interleave. Abandon it.
+            continue;
         }
+
+        merged.append(cur);
+    }
+
+    while (idx < p_result.size()) {
+        merged.append(p_result[idx++]);
     }
+
+    p_result = merged;
 }
 
 QList<QTextCursor> VEditor::findTextAll(const VSearchToken &p_token,
@@ -474,20 +618,13 @@ QList<QTextCursor> VEditor::findTextAll(const VSearchToken &p_token,
         return results;
     }
 
-    QTextDocument::FindFlags flags;
-    if (p_token.m_caseSensitivity == Qt::CaseSensitive) {
-        flags |= QTextDocument::FindCaseSensitively;
-    }
-
     if (p_token.m_type == VSearchToken::RawString) {
-        for (auto const & wd : p_token.m_keywords) {
-            QList<QTextCursor> part = findTextAllInRange(m_document, wd, flags, p_start, p_end);
-            mergeResult(results, part);
-        }
+        VMultiPatternMatcher matcher(p_token.m_keywords, p_token.m_caseSensitivity);
+        results = findTextAllInRange(m_document, matcher, p_start, p_end);
     } else {
         // Regular expression.
         for (auto const & reg : p_token.m_regs) {
-            QList<QTextCursor> part = findTextAllInRange(m_document, reg, flags, p_start, p_end);
+            QList<QTextCursor> part = findTextAllInRange(m_document, reg, p_start, p_end);
             mergeResult(results, part);
         }
     }
@@ -534,8 +671,28 @@ const QList<QTextCursor> &VEditor::findTextAllCached(const VSearchToken &p_token
     return m_findInfo.m_result;
 }
 
+void VEditor::beginBatchUpdate()
+{
+    ++m_batchUpdateDepth;
+}
+
+void VEditor::endBatchUpdate()
+{
+    Q_ASSERT(m_batchUpdateDepth > 0);
+    if (--m_batchUpdateDepth > 0) {
+        return;
+    }
+
+    highlightOnCursorPositionChanged();
+    highlightSelectedWord();
+}
+
 void VEditor::highlightSelectedWord()
 {
+    if (m_batchUpdateDepth > 0) {
+        return;
+    }
+
     QList<QTextEdit::ExtraSelection> &selects = m_extraSelections[(int)SelectionId::SelectedWord];
     if (!g_config->getHighlightSelectedWord()) {
         if (!selects.isEmpty()) {
@@ -639,12 +796,18 @@ void VEditor::insertLink()
 
 bool VEditor::peekText(const QString &p_text, uint p_options, bool p_forward)
 {
+    cancelPeekSearch();
+
     if (p_text.isEmpty()) {
         makeBlockVisible(m_document->findBlock(textCursorW().selectionStart()));
         highlightIncrementalSearchedWord(QTextCursor());
         return false;
     }
 
+    if (p_options & FindOption::RegularExpression) {
+        return peekRegExp(p_text, p_options, p_forward);
+    }
+
     bool wrapped = false;
     QTextCursor retCursor;
     int start = textCursorW().position();
@@ -939,6 +1102,68 @@ static bool isRegularExpressionSupported(const QRegExp &p_reg)
     return true;
 }
 
+static bool isRegularExpressionSupported(const QRegularExpression &p_reg)
+{
+    if (!p_reg.isValid()) {
+        return false;
+    }
+
+    // FIXME: hang bug in Qt's find().
+    static const QRegularExpression test("^[$^]+$");
+    if (test.match(p_reg.pattern()).hasMatch()) {
+        return false;
+    }
+
+    return true;
+}
+
+bool VEditor::peekRegExp(const QString &p_text, uint p_options, bool p_forward)
+{
+    QRegExp exp(p_text,
+                (p_options & FindOption::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive);
+    if (!isRegularExpressionSupported(exp)) {
+        return false;
+    }
+
+    // Search a snapshot in background. Same as QTextDocument::find(), which
+    // treats nbsp as space.
+    int start = textCursorW().position();
+    m_peekSearchTimeStamp = m_timeStamp;
+    m_peekSearchId = VRegExpSearcher::inst()->search(m_document->toPlainText(),
+                                                     exp,
+                                                     p_options & FindOption::WholeWordOnly,
+                                                     p_forward,
+                                                     start,
+                                                     p_forward ? start : -1);
+    return false;
+}
+
+void VEditor::handlePeekSearchFinished(int p_id, int p_start, int p_length)
+{
+    if (p_id != m_peekSearchId) {
+        return;
+    }
+
+    m_peekSearchId = 0;
+    if (p_start == -1 || m_peekSearchTimeStamp != m_timeStamp) {
+        return;
+    }
+
+    QTextCursor cursor(m_document);
+    cursor.setPosition(p_start);
+    cursor.setPosition(p_start + p_length, QTextCursor::KeepAnchor);
+    makeBlockVisible(m_document->findBlock(p_start));
+    highlightIncrementalSearchedWord(cursor);
+}
+
+void VEditor::cancelPeekSearch()
+{
+    if (m_peekSearchId) {
+        VRegExpSearcher::inst()->cancel(m_peekSearchId);
+        m_peekSearchId = 0;
+    }
+}
+
 // Use QPlainTextEdit::find() instead of QTextDocument::find() because the later has
 // bugs in searching backward.
 bool VEditor::findTextHelper(const QString &p_text,
@@ -1019,6 +1244,8 @@ bool VEditor::findTextHelper(const QString &p_text,
 
 void VEditor::clearIncrementalSearchedWordHighlight(bool p_now)
 {
+    cancelPeekSearch();
+
     QList<QTextEdit::ExtraSelection> &selects = m_extraSelections[(int)SelectionId::IncrementalSearchedKeyword];
     if (selects.isEmpty()) {
         return;
@@ -1086,6 +1313,7 @@ void VEditor::highlightSearchedWord(const QList<QTextCursor> &p_matches)
     }
 
     selects.clear();
+    selects.reserve(p_matches.size());
 
     QTextCharFormat format;
     format.setForeground(m_searchedWordFg);
@@ -1212,60 +1440,68 @@ void VEditor::replaceTextAll(const QString &p_text,
                              uint p_options,
                              const QString &p_replaceText)
 {
-    // Replace from the start to the end and restore the cursor.
-    QTextCursor cursor = textCursorW();
-    int nrReplaces = 0;
-    QTextCursor tmpCursor = cursor;
-    tmpCursor.setPosition(0);
-    setTextCursorW(tmpCursor);
-    int start = tmpCursor.position();
+    // Compute all the replacements first and apply them in one edit of the
+    // span covering them, so there is only one contentsChange for the
+    // highlighter and the layout, and one undo step.
+    // The matches are usually cached by the find before.
+    QList<QTextCursor> matches = findTextAllCached(p_text, p_options);
+    int nrReplaces = matches.size();
+    if (nrReplaces > 0) {
+        bool useRegExp = p_options & FindOption::RegularExpression;
+        QRegExp exp;
+        if (useRegExp) {
+            exp = QRegExp(p_text,
+                          (p_options & FindOption::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive);
+        }
 
-    QString newText;
-    bool useRegExp = p_options & FindOption::RegularExpression;
-    QRegExp exp;
-    if (useRegExp) {
-        exp = QRegExp(p_text,
-                      (p_options & FindOption::CaseSensitive) ? Qt::CaseSensitive : Qt::CaseInsensitive);
-    } else {
-        newText = p_replaceText;
-    }
+        int spanStart = matches.first().selectionStart();
+        int spanEnd = matches.last().selectionEnd();
+        QTextCursor spanCursor(m_document);
+        spanCursor.setPosition(spanStart);
+        spanCursor.setPosition(spanEnd, QTextCursor::KeepAnchor);
+        const QString spanText = spanCursor.selectedText();
 
-    while (true) {
-        bool wrapped = false;
-        QTextCursor retCursor;
-        bool found = findTextHelper(p_text,
-                                    p_options,
-                                    true,
-                                    start,
-                                    wrapped,
-                                    retCursor);
-        if (!found) {
-            break;
-        } else {
-            if (wrapped) {
-                // Wrap back.
-                break;
+        QTextCursor cursor = textCursorW();
+        int pos = cursor.position();
+        int newPos = pos;
+
+        QString newSpan;
+        newSpan.reserve(spanText.size());
+        int last = spanStart;
+        int delta = 0;
+        for (auto const & ma : matches) {
+            int start = ma.selectionStart();
+            int end = ma.selectionEnd();
+            newSpan.append(spanText.midRef(last - spanStart, start - last));
+
+            QString newText = p_replaceText;
+            if (useRegExp) {
+                QString text = spanText.mid(start - spanStart, end - start);
+                text.replace(QChar::ParagraphSeparator, '\n');
+                fillReplaceTextWithBackReference(newText, text, exp);
             }
 
-            if (useRegExp) {
-                newText = p_replaceText;
-                fillReplaceTextWithBackReference(newText,
-                                                 VEditUtils::selectedText(retCursor),
-                                                 exp);
+            newSpan.append(newText);
+
+            if (pos >= end) {
+                newPos = pos + delta + newText.size() - (end - start);
+            } else if (pos > start) {
+                newPos = start + delta;
             }
 
-            nrReplaces++;
-            retCursor.beginEditBlock();
-            retCursor.insertText(newText);
-            retCursor.endEditBlock();
-            setTextCursorW(retCursor);
-            start = retCursor.position();
+            delta += newText.size() - (end - start);
+            last = end;
         }
+
+        spanCursor.beginEditBlock();
+        spanCursor.insertText(newSpan);
+        spanCursor.endEditBlock();
+
+        // Restore cursor position.
+        cursor.setPosition(newPos);
+        setTextCursorW(cursor);
     }
 
-    // Restore cursor position.
-    cursor.clearSelection();
-    setTextCursorW(cursor);
     qDebug() << "replace all" << nrReplaces << "occurences";
 
     emit m_object->statusMessage(QObject::tr("Replace %1 %2").arg(nrReplaces)
@@ -1277,6 +1513,12 @@ void VEditor::evaluateMagicWords()
 {
     QString text;
     QTextCursor cursor = textCursorW();
+    if (cursor.hasSelection()
+        && cursor.block() != m_document->findBlock(cursor.anchor())) {
+        evaluateMagicWordsInRange(cursor);
+        return;
+    }
+
     if (!cursor.hasSelection()) {
         // Get the WORD in current cursor.
         int start, end;
@@ -1306,6 +1548,41 @@ void VEditor::evaluateMagicWords()
     }
 }
 
+void VEditor::evaluateMagicWordsInRange(QTextCursor &p_cursor)
+{
+    int start = p_cursor.selectionStart();
+    int end = p_cursor.selectionEnd();
+    QString text = VEditUtils::selectedText(p_cursor);
+    QVector<VMetaWordManager::Replacement> reps = g_mwMgr->evaluateRegions(text);
+    if (reps.isEmpty()) {
+        return;
+    }
+
+    qDebug() << "evaluateMagicWords in range" << start << end << reps.size() << "regions";
+
+    // Apply all the replacements as one edit from back to front so the offsets
+    // keep valid, and the highlighter and layout are updated once.
+    beginBatchUpdate();
+    p_cursor.beginEditBlock();
+    for (int i = reps.size() - 1; i >= 0; --i) {
+        const VMetaWordManager::Replacement &rep = reps[i];
+        p_cursor.setPosition(start + rep.m_offset);
+        p_cursor.setPosition(start + rep.m_offset + rep.m_length, QTextCursor::KeepAnchor);
+        p_cursor.insertText(rep.m_value);
+        end += rep.m_value.size() - rep.m_length;
+    }
+
+    p_cursor.endEditBlock();
+
+    p_cursor.setPosition(end);
+    if (m_editOps) {
+        m_editOps->setVimMode(VimMode::Insert);
+    }
+
+    setTextCursorW(p_cursor);
+    endBatchUpdate();
+}
+
 void VEditor::setReadOnlyAndHighlightCurrentLine(bool p_readonly)
 {
     setReadOnlyW(p_readonly);
@@ -1517,10 +1794,10 @@ void VEditor::requestCompletion(bool p_reversed)
     cursor.clearSelection();
     setTextCursorW(cursor);
 
-    QStringList words = generateCompletionCandidates(p_reversed);
     QString prefix = fetchCompletionPrefix();
     // Smart case.
     Qt::CaseSensitivity cs = completionCaseSensitivity(prefix);
+    QStringList words = generateCompletionCandidates(prefix, cs, p_reversed);
 
     cursor.movePosition(QTextCursor::PreviousCharacter, QTextCursor::MoveAnchor, prefix.size());
     QRect popupRect = cursorRectW(cursor);
@@ -1539,44 +1816,39 @@ bool VEditor::isCompletionActivated() const
     return false;
 }
 
-QStringList VEditor::generateCompletionCandidates(bool p_reversed) const
+QStringList VEditor::generateCompletionCandidates(const QString &p_prefix,
+                                                  Qt::CaseSensitivity p_cs,
+                                                  bool p_reversed) const
 {
-    QString content = getContent();
     QTextCursor cursor = textCursorW();
     int start, end;
     VEditUtils::findCurrentWord(cursor, start, end, true);
 
-    QRegExp reg("\\W+");
+    // Words of the document sharing the first char, which the completer ranks
+    // and narrows down by the prefix as it grows, allowing fuzzy matches.
+    QStringList words = m_wordIndex->fetchCandidates(start, end, p_prefix.left(1), p_cs, p_reversed);
 
-    QStringList above = content.left(start).split(reg, QString::SkipEmptyParts);
-    QStringList below = content.mid(end).split(reg, QString::SkipEmptyParts);
+    // Then words from other notes.
+    QSet<QString> seen = words.toSet();
+    const VNoteFile *note = dynamic_cast<const VNoteFile *>(m_file.data());
+    QStringList others = VCompletionDictionary::inst()->fetchCandidates(m_wordIndex.data(),
+                                                                        note ? note->getNotebook() : NULL,
+                                                                        p_prefix,
+                                                                        p_cs,
+                                                                        seen);
+    if (others.isEmpty()) {
+        return words;
+    }
 
     if (p_reversed) {
-        QStringList rev;
-        rev.reserve(above.size() + below.size());
-        for (auto it = above.rbegin(); it != above.rend(); ++it) {
-            rev.append(*it);
-        }
-
-        for (auto it = below.rbegin(); it != below.rend(); ++it) {
-            rev.append(*it);
-        }
-
-        rev.removeDuplicates();
-
-        QStringList res;
-        res.reserve(rev.size());
-        for (auto it = rev.rbegin(); it != rev.rend(); ++it) {
-            res.append(*it);
-        }
-
-        return res;
-    } else {
-        // below + above.
-        below.append(above);
-        below.removeDuplicates();
-        return below;
+        // Farthest first.
+        std::reverse(others.begin(), others.end());
+        others.append(words);
+        return others;
     }
+
+    words.append(others);
+    return words;
 }
 
 QString VEditor::fetchCompletionPrefix() const
@@ -1644,6 +1916,48 @@ QList<QTextCursor> VEditor::findTextAllInRange(const QTextDocument *p_doc,
     return results;
 }
 
+QList<QTextCursor> VEditor::findTextAllInRange(const QTextDocument *p_doc,
+                                               const VMultiPatternMatcher &p_matcher,
+                                               int p_start,
+                                               int p_end)
+{
+    QList<QTextCursor> results;
+    if (p_matcher.isEmpty()) {
+        return results;
+    }
+
+    int end = p_end == -1 ? p_doc->characterCount() + 1 : p_end;
+
+    QVector<QPair<int, int>> matches;
+    for (QTextBlock block = p_doc->findBlock(qMax(0, p_start));
+         block.isValid() && block.position() < end;
+         block = block.next()) {
+        // Same as QTextDocument::find().
+        QString text = block.text();
+        text.replace(QChar::Nbsp, QLatin1Char(' '));
+
+        matches.clear();
+        p_matcher.match(text, matches);
+
+        int pos = block.position();
+        for (auto const & ma : matches) {
+            int start = pos + ma.first;
+            if (start < p_start) {
+                continue;
+            } else if (start + ma.second > end) {
+                return results;
+            }
+
+            QTextCursor cursor(const_cast<QTextDocument *>(p_doc));
+            cursor.setPosition(start);
+            cursor.setPosition(start + ma.second, QTextCursor::KeepAnchor);
+            results.append(cursor);
+        }
+    }
+
+    return results;
+}
+
 QList<QTextCursor> VEditor::findTextAllInRange(const QTextDocument *p_doc,
                                                const QRegExp &p_reg,
                                                QTextDocument::FindFlags p_flags,
@@ -1673,9 +1987,87 @@ QList<QTextCursor> VEditor::findTextAllInRange(const QTextDocument *p_doc,
     return results;
 }
 
-void VEditor::clearFindCache()
+QList<QTextCursor> VEditor::findTextAllInRange(const QTextDocument *p_doc,
+                                               const QRegularExpression &p_reg,
+                                               int p_start,
+                                               int p_end)
+{
+    QList<QTextCursor> results;
+    if (!isRegularExpressionSupported(p_reg)) {
+        return results;
+    }
+
+    int start = p_start;
+    int end = p_end == -1 ? p_doc->characterCount() + 1 : p_end;
+
+    while (start < end) {
+        QTextCursor cursor = p_doc->find(p_reg, start);
+        if (cursor.isNull()) {
+            break;
+        } else {
+            start = cursor.selectionEnd();
+            if (start <= end) {
+                results.append(cursor);
+            }
+        }
+    }
+
+    return results;
+}
+
+void VEditor::updateFindCache(int p_position, int p_charsRemoved, int p_charsAdded)
 {
-    m_findInfo.clearResult();
+    Q_UNUSED(p_charsRemoved);
+
+    if (!m_findInfo.m_cacheValid) {
+        return;
+    }
+
+    // Positions of a ranged find do not follow the changes.
+    if (m_findInfo.m_start != 0 || m_findInfo.m_end != -1) {
+        m_findInfo.clearResult();
+        return;
+    }
+
+    // The change spans blocks [first, last] now. Matches never cross blocks.
+    int maxPos = m_document->characterCount() - 1;
+    QTextBlock firstBlock = m_document->findBlock(qBound(0, p_position, maxPos));
+    QTextBlock lastBlock = m_document->findBlock(qBound(0, p_position + p_charsAdded, maxPos));
+    if (!firstBlock.isValid()
+        || !lastBlock.isValid()
+        || lastBlock.blockNumber() - firstBlock.blockNumber() >= MAX_FIND_CACHE_UPDATE_BLOCKS) {
+        // Find again on next query.
+        m_findInfo.clearResult();
+        return;
+    }
+
+    int start = firstBlock.position();
+    int end = lastBlock.position() + lastBlock.length() - 1;
+
+    // The cursors of the matches follow the changes.
+    QList<QTextCursor> &result = m_findInfo.m_result;
+    auto first = std::lower_bound(result.begin(), result.end(), start,
+                                  [](const QTextCursor &p_cursor, int p_pos) {
+                                      return p_cursor.selectionStart() < p_pos;
+                                  });
+    auto last = first;
+    while (last != result.end() && last->selectionStart() <= end) {
+        ++last;
+    }
+
+    int idx = first - result.begin();
+    result.erase(first, last);
+
+    QList<QTextCursor> part;
+    if (m_findInfo.m_useToken) {
+        part = findTextAll(m_findInfo.m_token, start, end);
+    } else {
+        part = findTextAll(m_findInfo.m_text, m_findInfo.m_options, start, end);
+    }
+
+    for (int i = 0; i < part.size(); ++i) {
+        result.insert(idx + i, part[i]);
+    }
 }
 
 void VEditor::nextMatch(bool p_forward)
@@ -21,6 +21,9 @@ class VEditOperations;
 class QTimer;
 class QLabel;
 class VVim;
+class VWordIndex;
+class VStructureIndex;
+class VMultiPatternMatcher;
 enum class VimMode;
 class QMouseEvent;
 
@@ -77,6 +80,7 @@ public:
 
     // Used for incremental search.
     // User has enter the content to search, but does not enter the "find" button yet.
+    // Regular expressions are searched in background and it returns false.
     bool peekText(const QString &p_text, uint p_options, bool p_forward = true);
 
     // If @p_cursor is not null, set the position of @p_cursor instead of current
@@ -118,6 +122,13 @@ public:
     // Clear IncrementalSearchedKeyword highlight.
     void clearIncrementalSearchedWordHighlight(bool p_now = true);
 
+    // Suspend the highlights following the cursor until the outermost
+    // endBatchUpdate(), which updates them once.
+    // Used to replay a sequence of commands.
+    void beginBatchUpdate();
+
+    void endBatchUpdate();
+
     // Clear SearchedKeyword highlight.
     void clearSearchedWordHighlight();
 
@@ -127,6 +138,9 @@ public:
     // Evaluate selected text or cursor word as magic words.
     void evaluateMagicWords();
 
+    // Index of brackets and empty blocks of the document for Vim motions.
+    VStructureIndex *getStructureIndex() const;
+
     VFile *getFile() const;
 
     VEditConfig &getConfig();
@@ -240,6 +254,9 @@ public:
 
     virtual QRect cursorRectW(const QTextCursor &p_cursor) = 0;
 
+    // Range of the visible blocks. -1 if not laid out.
+    virtual void visibleBlockRangeW(int &p_first, int &p_last) const = 0;
+
 protected:
     void init();
 
@@ -282,6 +299,10 @@ protected:
     // Scroll cursor line if in need.
     void scrollCursorLineIfNecessary();
 
+    // Turn off the highlights of trailing spaces and tabs regardless of the
+    // configuration, which search the whole document.
+    void setSpaceHighlightsSuppressed(bool p_suppressed);
+
     QWidget *m_editor;
 
     VEditorObject *m_object;
@@ -457,6 +478,15 @@ private:
     // Highlight @p_cursor as the incremental searched keyword.
     void highlightIncrementalSearchedWord(const QTextCursor &p_cursor);
 
+    // Peek a regular expression in background. The match will be highlighted
+    // when found.
+    bool peekRegExp(const QString &p_text, uint p_options, bool p_forward);
+
+    void handlePeekSearchFinished(int p_id, int p_start, int p_length);
+
+    // Drop the pending background search of peekText().
+    void cancelPeekSearch();
+
     // Find @p_text in the document starting from @p_start.
     // Returns true if @p_text is found and set @p_cursor to indicate
     // the position.
@@ -470,12 +500,20 @@ private:
 
     void showWrapLabel();
 
+    // Evaluate magic words in the multi-line selection of @p_cursor line by
+    // line in one edit.
+    void evaluateMagicWordsInRange(QTextCursor &p_cursor);
+
     void highlightSearchedWord(const QList<QTextCursor> &p_matches);
 
     // Highlight @p_cursor as the searched keyword under cursor.
     void highlightSearchedWordUnderCursor(const QTextCursor &p_cursor);
 
-    QStringList generateCompletionCandidates(bool p_reversed) const;
+    // Candidates in the order of preference, which the completer filters and
+    // ranks by @p_prefix.
+    QStringList generateCompletionCandidates(const QString &p_prefix,
+                                             Qt::CaseSensitivity p_cs,
+                                             bool p_reversed) const;
 
     void cleanUp();
 
@@ -488,12 +526,24 @@ private:
                                                  int p_start = 0,
                                                  int p_end = -1);
 
+    // Find all the patterns of @p_matcher in one pass over the blocks.
+    static QList<QTextCursor> findTextAllInRange(const QTextDocument *p_doc,
+                                                 const VMultiPatternMatcher &p_matcher,
+                                                 int p_start = 0,
+                                                 int p_end = -1);
+
     static QList<QTextCursor> findTextAllInRange(const QTextDocument *p_doc,
                                                  const QRegExp &p_reg,
                                                  QTextDocument::FindFlags p_flags,
                                                  int p_start = 0,
                                                  int p_end = -1);
 
+    // Case sensitivity is given by the options of @p_reg.
+    static QList<QTextCursor> findTextAllInRange(const QTextDocument *p_doc,
+                                                 const QRegularExpression &p_reg,
+                                                 int p_start = 0,
+                                                 int p_end = -1);
+
     bool findTextInRange(const QString &p_text,
                          uint p_options,
                          bool p_forward,
@@ -551,6 +601,11 @@ private:
 
     QSharedPointer<VTextEditCompleter> m_completer;
 
+    // Words of the document for completion.
+    QSharedPointer<VWordIndex> m_wordIndex;
+
+    QSharedPointer<VStructureIndex> m_structureIndex;
+
     // Temp files needed to be delete.
     QStringList m_tempFiles;
 
@@ -558,6 +613,21 @@ private:
 
     bool m_trailingSpaceHighlightEnabled;
     bool m_tabHighlightEnabled;
+    bool m_spaceHighlightsSuppressed;
+
+    // Block range of the submitted extra selections of the layers limited to
+    // the viewport. -1 if not limited.
+    int m_highlightFirstBlock;
+    int m_highlightLastBlock;
+
+    // ID of the pending background search of peekText(), 0 if none.
+    int m_peekSearchId;
+
+    // Depth of beginBatchUpdate().
+    int m_batchUpdateDepth;
+
+    // Time stamp of the document when the search is requested.
+    TimeStamp m_peekSearchTimeStamp;
 
 // Functions for private slots.
 private:
@@ -568,7 +638,13 @@ private:
 
     void doUpdateTrailingSpaceAndTabHighlights();
 
-    void clearFindCache();
+    // Drop the cached matches in the changed blocks and find them again, so
+    // matches elsewhere are kept.
+    // Should be called on QTextDocument::contentsChange().
+    void updateFindCache(int p_position, int p_charsRemoved, int p_charsAdded);
+
+    // Re-submit the extra selections if the viewport scrolls out of the range.
+    void handleVerticalScroll();
 };
 
 
@@ -639,9 +715,9 @@ private slots:
         m_editor->doUpdateTrailingSpaceAndTabHighlights();
     }
 
-    void clearFindCache()
+    void handleVerticalScroll()
     {
-        m_editor->clearFindCache();
+        m_editor->handleVerticalScroll();
     }
 
 private:
@@ -655,6 +731,11 @@ inline VFile *VEditor::getFile() const
     return m_file;
 }
 
+inline VStructureIndex *VEditor::getStructureIndex() const
+{
+    return m_structureIndex.data();
+}
+
 inline VEditConfig &VEditor::getConfig()
 {
     return m_config;
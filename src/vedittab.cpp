@@ -1,9 +1,11 @@
 #include "vedittab.h"
 #include <QApplication>
 #include <QWheelEvent>
+#include <QDateTime>
 
 #include "utils/vutils.h"
 #include "vconfigmanager.h"
+#include "vfilechangechecker.h"
 
 extern VConfigManager *g_config;
 
@@ -17,10 +19,21 @@ VEditTab::VEditTab(VFile *p_file, VEditArea *p_editArea, QWidget *p_parent)
       m_checkFileChange(true),
       m_fileDiverged(false),
       m_ready(0),
-      m_enableBackupFile(g_config->getEnableBackupFile())
+      m_enableBackupFile(g_config->getEnableBackupFile()),
+      m_promptingReload(false),
+      m_lastActiveTime(QDateTime::currentMSecsSinceEpoch())
 {
     connect(qApp, &QApplication::focusChanged,
             this, &VEditTab::handleFocusChanged);
+
+    connect(this, &VEditTab::statusUpdated,
+            this, &VEditTab::cacheTabInfo);
+
+    connect(m_file, &VFile::saveCompleted,
+            this, &VEditTab::handleFileSaveCompleted);
+
+    connect(VFileChangeChecker::inst(), &VFileChangeChecker::fileChecked,
+            this, &VEditTab::handleFileChecked);
 }
 
 VEditTab::~VEditTab()
@@ -34,7 +47,7 @@ void VEditTab::focusTab()
 {
     focusChild();
     emit getFocused();
-    updateStatus();
+    updateStatusFromCache();
 }
 
 bool VEditTab::isEditMode() const
@@ -42,11 +55,64 @@ bool VEditTab::isEditMode() const
     return m_isEditMode;
 }
 
+OpenFileMode VEditTab::getOpenMode() const
+{
+    return m_isEditMode ? OpenFileMode::Edit : OpenFileMode::Read;
+}
+
+void VEditTab::load()
+{
+}
+
+bool VEditTab::hibernate()
+{
+    return false;
+}
+
+void VEditTab::collectMemoryStats(VMemoryStats::Group &p_group) const
+{
+    Q_UNUSED(p_group);
+}
+
+void VEditTab::requestWebHeapSize()
+{
+}
+
+void VEditTab::setFullFeaturesForced(bool p_forced)
+{
+    Q_UNUSED(p_forced);
+}
+
+void VEditTab::markActive()
+{
+    m_lastActiveTime = QDateTime::currentMSecsSinceEpoch();
+}
+
+qint64 VEditTab::getLastActiveTime() const
+{
+    return m_lastActiveTime;
+}
+
+void VEditTab::saveFileAsync()
+{
+    saveFile();
+}
+
+void VEditTab::handleFileSaveCompleted(bool p_succeeded)
+{
+    Q_UNUSED(p_succeeded);
+}
+
 bool VEditTab::isModified() const
 {
     return false;
 }
 
+bool VEditTab::isLoadingContent() const
+{
+    return false;
+}
+
 VFile *VEditTab::getFile() const
 {
     return m_file;
@@ -59,10 +125,10 @@ void VEditTab::handleFocusChanged(QWidget * /* p_old */, QWidget *p_now)
         focusChild();
 
         emit getFocused();
-        updateStatus();
+        updateStatusFromCache();
     } else if (isAncestorOf(p_now)) {
         emit getFocused();
-        updateStatus();
+        updateStatusFromCache();
     }
 }
 
@@ -122,6 +188,36 @@ void VEditTab::updateStatus()
     emit statusUpdated(fetchTabInfo());
 }
 
+VEditTabInfo VEditTab::getCachedTabInfo() const
+{
+    if (m_cachedTabInfo.m_editTab != this) {
+        return fetchTabInfo();
+    }
+
+    return m_cachedTabInfo;
+}
+
+void VEditTab::updateStatusFromCache()
+{
+    emit statusUpdated(getCachedTabInfo());
+}
+
+void VEditTab::cacheTabInfo(const VEditTabInfo &p_info)
+{
+    if (p_info.m_type == VEditTabInfo::InfoType::Cursor
+        && m_cachedTabInfo.m_editTab == this) {
+        // Keep the rest which receivers skip for cursor info.
+        m_cachedTabInfo.m_cursorBlockNumber = p_info.m_cursorBlockNumber;
+        m_cachedTabInfo.m_cursorPositionInBlock = p_info.m_cursorPositionInBlock;
+        m_cachedTabInfo.m_blockCount = p_info.m_blockCount;
+        m_cachedTabInfo.m_headerIndex = p_info.m_headerIndex;
+        return;
+    }
+
+    m_cachedTabInfo = p_info;
+    m_cachedTabInfo.m_type = VEditTabInfo::InfoType::All;
+}
+
 void VEditTab::evaluateMagicWords()
 {
 }
@@ -151,41 +247,58 @@ void VEditTab::applySnippet()
 
 void VEditTab::checkFileChangeOutside()
 {
-    if (!m_checkFileChange) {
+    if (!m_checkFileChange || !m_file || isLoadingContent()) {
         return;
     }
 
-    bool missing = false;
-    if (m_file->isChangedOutside(missing)) {
+    VFileChangeChecker::inst()->check(m_file->fetchPath());
+}
+
+void VEditTab::handleFileChecked(const QString &p_file, const QDateTime &p_lastModified)
+{
+    if (!m_checkFileChange
+        || m_promptingReload
+        || isLoadingContent()
+        || !m_file
+        || p_file != m_file->fetchPath()) {
+        return;
+    }
+
+    if (!p_lastModified.isValid()) {
         // It may be caused by cutting files.
-        if (missing) {
-            qWarning() << "file is missing when check file's outside change" << m_file->fetchPath();
-            return;
-        }
+        qWarning() << "file is missing when check file's outside change" << p_file;
+        return;
+    }
 
-        int ret = VUtils::showMessage(QMessageBox::Information,
-                                      tr("Information"),
-                                      tr("Note <span style=\"%1\">%2</span> has been modified by another program.")
-                                        .arg(g_config->c_dataTextStyle).arg(m_file->fetchPath()),
-                                      tr("Do you want to reload it?"),
-                                      QMessageBox::Yes | QMessageBox::No,
-                                      QMessageBox::Yes,
-                                      this);
-        switch (ret) {
-        case QMessageBox::Yes:
-            reloadFromDisk();
-            break;
-
-        case QMessageBox::No:
-            m_checkFileChange = false;
-            m_fileDiverged = true;
-            updateStatus();
-            break;
-
-        default:
-            Q_ASSERT(false);
-            break;
-        }
+    if (!m_file->isChangedOutside(p_lastModified)) {
+        return;
+    }
+
+    m_promptingReload = true;
+    int ret = VUtils::showMessage(QMessageBox::Information,
+                                  tr("Information"),
+                                  tr("Note <span style=\"%1\">%2</span> has been modified by another program.")
+                                    .arg(g_config->c_dataTextStyle).arg(p_file),
+                                  tr("Do you want to reload it?"),
+                                  QMessageBox::Yes | QMessageBox::No,
+                                  QMessageBox::Yes,
+                                  this);
+    m_promptingReload = false;
+
+    switch (ret) {
+    case QMessageBox::Yes:
+        reloadFromDisk();
+        break;
+
+    case QMessageBox::No:
+        m_checkFileChange = false;
+        m_fileDiverged = true;
+        updateStatus();
+        break;
+
+    default:
+        Q_ASSERT(false);
+        break;
     }
 }
 
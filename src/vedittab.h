@@ -10,6 +10,7 @@
 #include "vedittabinfo.h"
 #include "vwordcountinfo.h"
 #include "vsearchconfig.h"
+#include "vmemorystats.h"
 
 class VEditArea;
 class VSnippet;
@@ -35,10 +36,36 @@ public:
     // Save file.
     virtual bool saveFile() = 0;
 
+    // Save file in the background, such as for auto save.
+    // handleFileSaveCompleted() will be called once done.
+    virtual void saveFileAsync();
+
     bool isEditMode() const;
 
+    // Mode to record in the session.
+    virtual OpenFileMode getOpenMode() const;
+
+    // Read and show the content if its loading is deferred.
+    virtual void load();
+
+    // Drop the resources that could be rebuilt, such as the web view and the
+    // editor, keeping the content and the position to restore.
+    // It will be rebuilt by load() once activated.
+    // Returns true if hibernated.
+    virtual bool hibernate();
+
+    // Record that this tab is used now.
+    void markActive();
+
+    // Msecs since epoch.
+    qint64 getLastActiveTime() const;
+
     virtual bool isModified() const;
 
+    // Whether the content is still being loaded, during which the file should
+    // not be saved or checked for outside changes.
+    virtual bool isLoadingContent() const;
+
     void focusTab();
 
     // Whether this tab has focus.
@@ -105,6 +132,10 @@ public:
     // Emit signal to update current status.
     virtual void updateStatus();
 
+    // Status last updated by this tab, or a fetched one if there is none.
+    // Cheaper than fetchTabInfo() when this tab just becomes current.
+    VEditTabInfo getCachedTabInfo() const;
+
     // Called by evaluateMagicWordsByCaptain() to evaluate the magic words.
     virtual void evaluateMagicWords();
 
@@ -114,7 +145,8 @@ public:
     // Prompt for user to apply a snippet.
     virtual void applySnippet();
 
-    // Check whether this file has been changed outside.
+    // Check whether this file has been changed outside in the background.
+    // Prompt to reload it once found changed.
     void checkFileChangeOutside();
 
     // Reload the editor from file.
@@ -129,6 +161,15 @@ public:
     // Fetch tab stat info.
     virtual VWordCountInfo fetchWordCountInfo(bool p_editMode) const;
 
+    // Add the approximate memory of each subsystem of this tab to @p_group.
+    virtual void collectMemoryStats(VMemoryStats::Group &p_group) const;
+
+    // Sample the JavaScript heap of the web view if there is one.
+    virtual void requestWebHeapSize();
+
+    // Keep full features of the editor even if the note is too large for them.
+    virtual void setFullFeaturesForced(bool p_forced);
+
 public slots:
     // Enter edit mode
     virtual void editFile() = 0;
@@ -161,6 +202,9 @@ protected:
     // Write modified buffer content to backup file.
     virtual void writeBackupFile();
 
+    // Called when the file is saved by saveFileAsync().
+    virtual void handleFileSaveCompleted(bool p_succeeded);
+
     // File related to this tab.
     QPointer<VFile> m_file;
 
@@ -207,11 +251,31 @@ signals:
     // Request to close itself.
     void closeRequested(VEditTab *p_tab);
 
+    // Request to be replaced by a full tab of @p_file in mode @p_mode.
+    void fullTabRequested(VFile *p_file, OpenFileMode p_mode);
+
     // Request main window to show Vim cmd line.
     void triggerVimCmd(VVim::CommandLineType p_type);
 
 private slots:
     // Called when app focus changed.
     void handleFocusChanged(QWidget *p_old, QWidget *p_now);
+
+    void handleFileChecked(const QString &p_file, const QDateTime &p_lastModified);
+
+    void cacheTabInfo(const VEditTabInfo &p_info);
+
+private:
+    // Emit statusUpdated() with the cached status.
+    void updateStatusFromCache();
+
+    // Whether the reload prompt is shown.
+    bool m_promptingReload;
+
+    // Status last updated. Invalid if m_editTab is NULL.
+    VEditTabInfo m_cachedTabInfo;
+
+    // Msecs since epoch when this tab is used last time.
+    qint64 m_lastActiveTime;
 };
 #endif // VEDITTAB_H
@@ -22,7 +22,9 @@ struct VEditTabInfo
           m_cursorBlockNumber(-1),
           m_cursorPositionInBlock(-1),
           m_blockCount(-1),
-          m_headerIndex(-1)
+          m_headerIndex(-1),
+          m_featureLevel(-1),
+          m_fullFeaturesForced(false)
     {
     }
 
@@ -35,6 +37,8 @@ struct VEditTabInfo
         m_blockCount = -1;
         m_wordCountInfo.clear();
         m_headerIndex = -1;
+        m_featureLevel = -1;
+        m_fullFeaturesForced = false;
     }
 
     InfoType m_type;
@@ -50,6 +54,12 @@ struct VEditTabInfo
 
     // Header index in outline.
     int m_headerIndex;
+
+    // VDocumentGovernor::Level of the editor. -1 if there is no editor.
+    int m_featureLevel;
+
+    // Whether the user forces full features of the editor.
+    bool m_fullFeaturesForced;
 };
 
 #endif // VEDITTABINFO_H
@@ -10,6 +10,8 @@
 #include "vopenedlistmenu.h"
 #include "vmdtab.h"
 #include "vhtmltab.h"
+#include "vmdlitetab.h"
+#include "vtexttab.h"
 #include "vfilelist.h"
 #include "vconfigmanager.h"
 #include "utils/viconutils.h"
@@ -275,13 +277,22 @@ int VEditWindow::openFileInTab(VFile *p_file, OpenFileMode p_mode)
     VEditTab *editor = NULL;
     switch (p_file->getDocType()) {
     case DocType::Markdown:
-        editor = new VMdTab(p_file, m_editArea, p_mode, this);
+        if (VMdLiteTab::isSuitable(p_file, p_mode)) {
+            editor = new VMdLiteTab(p_file, m_editArea, this);
+        } else {
+            editor = new VMdTab(p_file, m_editArea, p_mode, this);
+        }
+
         break;
 
     case DocType::Html:
         editor = new VHtmlTab(p_file, m_editArea, p_mode, this);
         break;
 
+    case DocType::Text:
+        editor = new VTextTab(p_file, m_editArea, p_mode, this);
+        break;
+
     default:
         V_ASSERT(false);
         break;
@@ -295,6 +306,20 @@ int VEditWindow::openFileInTab(VFile *p_file, OpenFileMode p_mode)
     return insertEditTab(currentIndex() + 1, p_file, editor);
 }
 
+int VEditWindow::openFileDeferred(VFile *p_file, OpenFileMode p_mode, int p_index)
+{
+    Q_ASSERT(p_file->getDocType() == DocType::Markdown);
+    int idx = findTabByFile(p_file);
+    if (idx > -1) {
+        return idx;
+    }
+
+    VEditTab *editor = new VMdTab(p_file, m_editArea, p_mode, this, true);
+    connectEditTab(editor);
+
+    return insertEditTab(p_index, p_file, editor);
+}
+
 int VEditWindow::findTabByFile(const VFile *p_file) const
 {
     int nrTabs = count();
@@ -371,7 +396,7 @@ void VEditWindow::updateTabStatus(int p_index)
 
     if (p_index == currentIndex()) {
         VEditTab *tab = getTab(p_index);
-        emit tabStatusUpdated(tab->fetchTabInfo());
+        emit tabStatusUpdated(tab->getCachedTabInfo());
         emit outlineChanged(tab->getOutline());
         emit currentHeaderChanged(tab->getCurrentHeader());
     }
@@ -455,6 +480,20 @@ void VEditWindow::handleTabbarClicked(int p_index)
 
 void VEditWindow::handleCurrentIndexChanged(int p_index)
 {
+    // The last current tab becomes idle from now on.
+    // It may be closed already.
+    int lastIdx = m_curTabWidget ? indexOf(m_curTabWidget) : -1;
+    if (lastIdx != -1) {
+        getTab(lastIdx)->markActive();
+    }
+
+    // Load it before others handling the change.
+    VEditTab *tab = getTab(p_index);
+    if (tab) {
+        tab->markActive();
+        tab->load();
+    }
+
     focusWindow();
 
     QWidget *wid = widget(p_index);
@@ -1106,6 +1145,8 @@ void VEditWindow::connectEditTab(const VEditTab *p_tab)
             this, &VEditWindow::handleTabVimStatusUpdated);
     connect(p_tab, &VEditTab::closeRequested,
             this, &VEditWindow::tabRequestToClose);
+    connect(p_tab, &VEditTab::fullTabRequested,
+            this, &VEditWindow::replaceWithFullTab);
 }
 
 void VEditWindow::setCurrentWindow(bool p_current)
@@ -1276,7 +1317,25 @@ void VEditWindow::saveAll()
 {
     int nrTab = count();
     for (int i = 0; i < nrTab; ++i) {
-        getTab(i)->saveFile();
+        // Saved in one batch in the background.
+        getTab(i)->saveFileAsync();
+    }
+}
+
+void VEditWindow::hibernateIdleTabs(qint64 p_idleMSecs)
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    int curIdx = currentIndex();
+    int nrTab = count();
+    for (int i = 0; i < nrTab; ++i) {
+        if (i == curIdx) {
+            continue;
+        }
+
+        VEditTab *tab = getTab(i);
+        if (now - tab->getLastActiveTime() >= p_idleMSecs && tab->hibernate()) {
+            qDebug() << "tab hibernated" << tab->getFile()->fetchPath();
+        }
     }
 }
 
@@ -1293,6 +1352,30 @@ void VEditWindow::tabRequestToClose(VEditTab *p_tab)
     }
 }
 
+void VEditWindow::replaceWithFullTab(VFile *p_file, OpenFileMode p_mode)
+{
+    VEditTab *tab = static_cast<VEditTab *>(sender());
+    int idx = indexOf(tab);
+    if (idx == -1 || !p_file) {
+        return;
+    }
+
+    removeTab(idx);
+
+    // Disconnect all the signals.
+    disconnect(tab, 0, this, 0);
+
+    tab->deleteLater();
+
+    VEditTab *editor = new VMdTab(p_file, m_editArea, p_mode, this);
+    connectEditTab(editor);
+
+    idx = insertEditTab(idx, p_file, editor);
+    setCurrentIndex(idx);
+    updateTabStatus(idx);
+    editor->focusTab();
+}
+
 int VEditWindow::tabBarHeight() const
 {
     return tabBar()->height();
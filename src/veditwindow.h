@@ -33,6 +33,11 @@ public:
     explicit VEditWindow(VEditArea *editArea, QWidget *parent = 0);
     int findTabByFile(const VFile *p_file) const;
     int openFile(VFile *p_file, OpenFileMode p_mode);
+
+    // Insert a tab of Markdown file @p_file at @p_index without reading it
+    // until the tab is activated.
+    // Returns the index of the tab.
+    int openFileDeferred(VFile *p_file, OpenFileMode p_mode, int p_index);
     bool closeFile(const VFile *p_file, bool p_forced);
     bool closeFile(const VDirectory *p_dir, bool p_forced);
     bool closeFile(const VNotebook *p_notebook, bool p_forced);
@@ -97,6 +102,9 @@ public:
     // Auto save file.
     void saveAll();
 
+    // Hibernate the background tabs not used for @p_idleMSecs.
+    void hibernateIdleTabs(qint64 p_idleMSecs);
+
     int tabBarHeight() const;
 
     QVector<TabNavigationInfo> getTabsNavigationInfo() const;
@@ -169,6 +177,9 @@ private slots:
     // @p_tab request to close itself.
     void tabRequestToClose(VEditTab *p_tab);
 
+    // Replace the sender tab with a full tab of @p_file.
+    void replaceWithFullTab(VFile *p_file, OpenFileMode p_mode);
+
 private:
     void setupCornerWidget();
 
@@ -203,7 +214,8 @@ private:
 
     VEditArea *m_editArea;
 
-    // These two members are only used for alternateTab().
+    // These two members are only used for alternateTab() and marking the
+    // last current tab active.
     QWidget *m_curTabWidget;
     QWidget *m_lastTabWidget;
 
@@ -1,7 +1,6 @@
 #include "vexplorer.h"
 
 #include <QtWidgets>
-#include <QFileSystemModel>
 #include <QDesktopServices>
 
 #include "utils/viconutils.h"
@@ -13,6 +12,7 @@
 #include "vhistorylist.h"
 #include "vorphanfile.h"
 #include "utils/vimnavigationforwidget.h"
+#include "vfilesystemmodel.h"
 
 extern VMainWindow *g_mainWin;
 
@@ -136,10 +136,11 @@ void VExplorer::setupUI()
                     setCurrentEntry(idx);
                 }
             });
-    QCompleter *completer = new QCompleter(this);
-    QFileSystemModel *fsModel = new QFileSystemModel(completer);
-    fsModel->setRootPath("");
-    completer->setModel(fsModel);
+
+    // Shared by the completer and the tree.
+    m_model = new VFileSystemModel(this);
+
+    VPathCompleter *completer = new VPathCompleter(m_model, this);
     // Enable styling the popup list via QListView::item.
     completer->popup()->setItemDelegate(new QStyledItemDelegate(this));
     completer->setCompletionMode(QCompleter::PopupCompletion);
@@ -201,20 +202,17 @@ void VExplorer::setupUI()
     btnLayout->addWidget(m_newDirBtn);
     btnLayout->setContentsMargins(0, 0, 0, 0);
 
-    QFileSystemModel *dirModel = new QFileSystemModel(this);
-    dirModel->setRootPath("");
     m_tree = new QTreeView(this);
-    m_tree->setModel(dirModel);
+    m_tree->setModel(m_model);
     m_tree->setSelectionMode(QAbstractItemView::ExtendedSelection);
     m_tree->setContextMenuPolicy(Qt::CustomContextMenu);
     connect(m_tree, &QTreeView::customContextMenuRequested,
             this, &VExplorer::handleContextMenuRequested);
     connect(m_tree, &QTreeView::activated,
             this, [this](const QModelIndex &p_index) {
-                QFileSystemModel *model = static_cast<QFileSystemModel *>(m_tree->model());
-                if (!model->isDir(p_index)) {
+                if (!m_model->isDir(p_index)) {
                     QStringList files;
-                    files << model->filePath(p_index);
+                    files << m_model->filePath(p_index);
 
                     // If there is no directory entry currently, new one using the parent dir.
                     if (m_index == -1 || m_entries.isEmpty()) {
@@ -228,14 +226,10 @@ void VExplorer::setupUI()
             this, &VExplorer::resizeTreeToContents);
     connect(m_tree, &QTreeView::collapsed,
             this, &VExplorer::resizeTreeToContents);
-    connect(dirModel, &QFileSystemModel::directoryLoaded,
+    connect(m_model, &VFileSystemModel::directoryLoaded,
             this, &VExplorer::resizeTreeToContents);
 
     m_tree->setHeaderHidden(true);
-    // Show only the Name column.
-    for (int i = 1; i < dirModel->columnCount(); ++i) {
-        m_tree->hideColumn(i);
-    }
 
     QVBoxLayout *mainLayout = new QVBoxLayout();
     mainLayout->addLayout(dirLayout);
@@ -265,8 +259,7 @@ void VExplorer::init()
             this, [this]() {
                 QModelIndexList selectedIdx = m_tree->selectionModel()->selectedRows();
                 if (selectedIdx.size() == 1) {
-                    QFileSystemModel *model = static_cast<QFileSystemModel *>(m_tree->model());
-                    QString filePath = model->filePath(selectedIdx[0]);
+                    QString filePath = m_model->filePath(selectedIdx[0]);
                     renameFile(filePath);
                 }
             });
@@ -445,15 +438,15 @@ void VExplorer::updateTree()
 {
     if (checkIndex()) {
         QString pa = QDir::cleanPath(m_entries[m_index].m_directory);
-        QFileSystemModel *model = static_cast<QFileSystemModel *>(m_tree->model());
-        model->setRootPath(pa);
-        const QModelIndex rootIndex = model->index(pa);
+        const QModelIndex rootIndex = m_model->index(pa);
         if (rootIndex.isValid()) {
+            if (m_model->canFetchMore(rootIndex)) {
+                m_model->fetchMore(rootIndex);
+            }
+
             m_tree->setRootIndex(rootIndex);
             resizeTreeToContents();
             return;
-        } else {
-            model->setRootPath("");
         }
     }
 
@@ -471,10 +464,9 @@ void VExplorer::handleContextMenuRequested(QPoint p_pos)
     QMenu menu(this);
     menu.setToolTipsVisible(true);
 
-    QFileSystemModel *model = static_cast<QFileSystemModel *>(m_tree->model());
     QModelIndexList selectedIdx = m_tree->selectionModel()->selectedRows();
-    if (selectedIdx.size() == 1 && model->isDir(selectedIdx[0])) {
-        QString filePath = model->filePath(selectedIdx[0]);
+    if (selectedIdx.size() == 1 && m_model->isDir(selectedIdx[0])) {
+        QString filePath = m_model->filePath(selectedIdx[0]);
 
         QAction *setRootAct = new QAction(VIconUtils::menuIcon(":/resources/icons/explore_root.svg"),
                                           tr("Set As Root"),
@@ -515,12 +507,12 @@ void VExplorer::handleContextMenuRequested(QPoint p_pos)
     bool allFiles = true;
     QStringList selectedFiles;
     for (auto const & it : selectedIdx) {
-        if (model->isDir(it)) {
+        if (m_model->isDir(it)) {
             allFiles = false;
             break;
         }
 
-        selectedFiles << model->filePath(it);
+        selectedFiles << m_model->filePath(it);
     }
 
     if (!allFiles) {
@@ -571,10 +563,7 @@ void VExplorer::handleContextMenuRequested(QPoint p_pos)
     addToCartAct->setToolTip(tr("Add selected files to Cart for further processing"));
     connect(addToCartAct, &QAction::triggered,
             this, [this, selectedFiles]() {
-                VCart *cart = g_mainWin->getCart();
-                for (int i = 0; i < selectedFiles.size(); ++i) {
-                    cart->addFile(selectedFiles[i]);
-                }
+                g_mainWin->getCart()->addFiles(selectedFiles);
 
                 g_mainWin->showStatusMessage(tr("%1 %2 added to Cart")
                                                .arg(selectedFiles.size())
@@ -642,10 +631,9 @@ void VExplorer::newFile()
 
     QString parentDir;
 
-    QFileSystemModel *model = static_cast<QFileSystemModel *>(m_tree->model());
     QModelIndexList selectedIdx = m_tree->selectionModel()->selectedRows();
-    if (selectedIdx.size() == 1 && model->isDir(selectedIdx[0])) {
-        parentDir = model->filePath(selectedIdx[0]);
+    if (selectedIdx.size() == 1 && m_model->isDir(selectedIdx[0])) {
+        parentDir = m_model->filePath(selectedIdx[0]);
     } else {
         parentDir = m_entries[m_index].m_directory;
     }
@@ -684,7 +672,7 @@ void VExplorer::newFile()
     m_tree->setFocus();
 
     // Select the file.
-    const QModelIndex fileIndex = model->index(filePath);
+    const QModelIndex fileIndex = m_model->index(filePath);
     Q_ASSERT(fileIndex.isValid());
     m_tree->scrollTo(fileIndex);
     m_tree->clearSelection();
@@ -699,10 +687,9 @@ void VExplorer::newFolder()
 
     QString parentDir;
 
-    QFileSystemModel *model = static_cast<QFileSystemModel *>(m_tree->model());
     QModelIndexList selectedIdx = m_tree->selectionModel()->selectedRows();
-    if (selectedIdx.size() == 1 && model->isDir(selectedIdx[0])) {
-        parentDir = model->filePath(selectedIdx[0]);
+    if (selectedIdx.size() == 1 && m_model->isDir(selectedIdx[0])) {
+        parentDir = m_model->filePath(selectedIdx[0]);
     } else {
         parentDir = m_entries[m_index].m_directory;
     }
@@ -738,7 +725,7 @@ void VExplorer::newFolder()
     m_tree->setFocus();
 
     // Select the folder.
-    const QModelIndex folderIndex = model->index(folderPath);
+    const QModelIndex folderIndex = m_model->index(folderPath);
     Q_ASSERT(folderIndex.isValid());
     m_tree->scrollTo(folderIndex);
     m_tree->clearSelection();
@@ -14,6 +14,7 @@ class QShowEvent;
 class QFocusEvent;
 class QComboBox;
 class VLineEdit;
+class VFileSystemModel;
 
 class VExplorer : public QWidget
 {
@@ -89,6 +90,7 @@ private:
     VLineEdit *m_imgFolderEdit;
     QPushButton *m_newFileBtn;
     QPushButton *m_newDirBtn;
+    VFileSystemModel *m_model;
     QTreeView *m_tree;
 
     static const QString c_infoShortcutSequence;
@@ -7,8 +7,12 @@
 #include <QRegExp>
 #include <QProcess>
 #include <QTemporaryDir>
-#include <QScopedPointer>
-#include <QCoreApplication>
+#include <QRunnable>
+#include <QEventLoop>
+#include <QPair>
+#include <QRegularExpression>
+#include <QSet>
+#include <functional>
 
 #include "vconfigmanager.h"
 #include "vfile.h"
@@ -19,17 +23,83 @@
 #include "vmarkdownconverter.h"
 #include "vdocument.h"
 #include "utils/vwebutils.h"
+#include "vnativehtmlrenderer.h"
+#include "vprocessrunner.h"
+#include "utils/vfilecopier.h"
+#include "vtracer.h"
+#include "vplantumlhelper.h"
+#include "vgraphvizhelper.h"
+#include "vplantumlserver.h"
+#include "vrenderscheduler.h"
+#include "vtaskexecutor.h"
 
 extern VConfigManager *g_config;
 
 extern VWebUtils *g_webUtils;
 
+// Render one note natively in the task executor.
+// Own all its data to outlive the exporter.
+class NativeRenderTask : public QRunnable
+{
+public:
+    NativeRenderTask(const QSharedPointer<NativeRenderResult> &p_result,
+                     const QString &p_markdown,
+                     hoedown_extensions p_extensions)
+        : m_result(p_result),
+          m_markdown(p_markdown),
+          m_extensions(p_extensions)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (!m_result->m_canceled.loadAcquire()) {
+            V_TRACE("export", "Native render");
+            m_result->m_html = VNativeHtmlRenderer::render(m_markdown, m_extensions, false);
+        }
+
+        m_result->m_finished.storeRelease(1);
+    }
+
+private:
+    QSharedPointer<NativeRenderResult> m_result;
+
+    QString m_markdown;
+
+    hoedown_extensions m_extensions;
+};
+
 VExporter::VExporter(QWidget *p_parent)
     : QObject(p_parent),
       m_webViewer(NULL),
+      m_webDocument(NULL),
+      m_incremental(false),
       m_state(ExportState::Idle),
-      m_askedToStop(false)
+      m_askedToStop(false),
+      m_concurrentPDF(false),
+      m_plantUMLHelper(NULL),
+      m_graphvizHelper(NULL),
+      m_numOfPDFHtmls(0)
+{
+    m_processRunner = new VProcessRunner(g_config->getExportMaxProcesses(),
+                                         VTaskExecutor::Export,
+                                         this);
+    connect(m_processRunner, &VProcessRunner::finished,
+            this, [this](int p_id, int p_ret) {
+                if (m_concurrentPDF) {
+                    m_finishedJobs.insert(p_id, p_ret);
+                }
+            });
+}
+
+VExporter::~VExporter()
 {
+    // The running renderings just finish with nobody waiting for them.
+    for (auto const & note : m_prefetchedNotes) {
+        if (note.m_nativeResult) {
+            note.m_nativeResult->m_canceled.storeRelease(1);
+        }
+    }
 }
 
 static QString marginToStrMM(qreal p_margin)
@@ -65,6 +135,28 @@ void VExporter::prepareExport(const ExportOption &p_opt)
 
     m_pageLayout = *(p_opt.m_pdfOpt.m_layout);
 
+    // Notes loaded with the previous template are useless.
+    clearPrefetchedNotes();
+
+    m_dataURIs.clear();
+    m_copiedResources.clear();
+    m_copiedTargets.clear();
+
+    m_incremental = p_opt.m_incremental;
+
+    // Notes keep rendering while the previous ones are converted.
+    m_concurrentPDF = p_opt.m_format == ExportFormat::PDF
+                      && p_opt.m_pdfOpt.m_wkhtmltopdf
+                      && g_config->getExportMaxProcesses() > 1;
+
+    m_nativeStyleContent.clear();
+    if (isNativeExport(p_opt)) {
+        const QString &codeBlockStyle = p_opt.m_renderCodeBlockStyle;
+        m_nativeStyleContent = readStyleSheet(g_config->getCommonCssUrl())
+                               + readStyleSheet(g_config->getCssStyleUrl(p_opt.m_renderStyle))
+                               + readStyleSheet(g_config->getCodeBlockCssStyleUrl(codeBlockStyle));
+    }
+
     prepareWKArguments(p_opt.m_pdfOpt);
 }
 
@@ -133,6 +225,8 @@ bool VExporter::exportPDF(VFile *p_file,
                           const QString &p_outputFile,
                           QString *p_errMsg)
 {
+    V_TRACE_DETAIL("export", "Export PDF", p_file->fetchPath());
+
     return exportViaWebView(p_file, p_opt, p_outputFile, p_errMsg);
 }
 
@@ -141,6 +235,27 @@ bool VExporter::exportHTML(VFile *p_file,
                            const QString &p_outputFile,
                            QString *p_errMsg)
 {
+    V_TRACE_DETAIL("export", "Export HTML", p_file->fetchPath());
+
+    if (isNativeExport(p_opt)) {
+        QSharedPointer<NativeRenderResult> result;
+        PrefetchedNote note;
+        if (takePrefetchedNote(p_file, note)) {
+            if (note.m_nativeResult) {
+                result = note.m_nativeResult;
+            } else {
+                // Put it back for the web view.
+                m_prefetchedNotes.prepend(note);
+            }
+        } else {
+            result = renderNatively(p_file, p_opt);
+        }
+
+        if (result) {
+            return exportViaNative(p_file, result, p_opt, p_outputFile);
+        }
+    }
+
     return exportViaWebView(p_file, p_opt, p_outputFile, p_errMsg);
 }
 
@@ -195,6 +310,8 @@ bool VExporter::exportCustom(VFile *p_file,
                              const QString &p_outputFile,
                              QString *p_errMsg)
 {
+    V_TRACE_DETAIL("export", "Export custom", p_file->fetchPath());
+
     const ExportCustomOption &customOpt = p_opt.m_customOpt;
     if (customOpt.m_srcFormat == ExportCustomOption::Markdown) {
         // Use Markdown file as input.
@@ -210,22 +327,33 @@ void VExporter::initWebViewer(VFile *p_file, const ExportOption &p_opt)
 {
     Q_ASSERT(!m_webViewer);
 
-    m_webViewer = new VWebView(p_file, static_cast<QWidget *>(parent()));
-    m_webViewer->hide();
+    createWebViewer(p_file, p_opt, m_webViewer, m_webDocument, m_baseUrl);
+}
+
+void VExporter::createWebViewer(VFile *p_file,
+                                const ExportOption &p_opt,
+                                VWebView *&p_webViewer,
+                                VDocument *&p_webDocument,
+                                QUrl &p_baseUrl)
+{
+    p_webViewer = new VWebView(p_file, static_cast<QWidget *>(parent()));
+    p_webViewer->hide();
 
-    VPreviewPage *page = new VPreviewPage(m_webViewer);
-    m_webViewer->setPage(page);
+    VPreviewPage *page = new VPreviewPage(p_webViewer);
+    p_webViewer->setPage(page);
     connect(page, &VPreviewPage::loadFinished,
             this, &VExporter::handleLoadFinished);
+    // The profile is shared by all the web views.
     connect(page->profile(), &QWebEngineProfile::downloadRequested,
-            this, &VExporter::handleDownloadRequested);
+            this, &VExporter::handleDownloadRequested,
+            Qt::UniqueConnection);
 
-    m_webDocument = new VDocument(p_file, m_webViewer);
-    connect(m_webDocument, &VDocument::logicsFinished,
+    p_webDocument = new VDocument(p_file, p_webViewer);
+    connect(p_webDocument, &VDocument::logicsFinished,
             this, &VExporter::handleLogicsFinished);
 
-    QWebChannel *channel = new QWebChannel(m_webViewer);
-    channel->registerObject(QStringLiteral("content"), m_webDocument);
+    QWebChannel *channel = new QWebChannel(p_webViewer);
+    channel->registerObject(QStringLiteral("content"), p_webDocument);
     page->setWebChannel(channel);
 
     // Need to generate HTML using Hoedown.
@@ -246,27 +374,488 @@ void VExporter::initWebViewer(VFile *p_file, const ExportOption &p_opt)
             html = div + html;
         }
 
-        m_webDocument->setHtml(html);
+        p_webDocument->setHtml(html);
     }
 
-    m_baseUrl = p_file->getBaseUrl();
-    m_webViewer->setHtml(m_htmlTemplate, m_baseUrl);
+    p_baseUrl = p_file->getBaseUrl();
+    p_webViewer->setHtml(m_htmlTemplate, p_baseUrl);
+}
+
+VExporter::NoteState *VExporter::findNoteState(QObject *p_sender)
+{
+    if (p_sender == m_webDocument
+        || (m_webViewer && p_sender == m_webViewer->page())) {
+        return &m_noteState;
+    }
+
+    for (auto & note : m_prefetchedNotes) {
+        if (!note.m_webViewer) {
+            continue;
+        }
+
+        if (p_sender == note.m_webDocument || p_sender == note.m_webViewer->page()) {
+            return &note.m_noteState;
+        }
+    }
+
+    return NULL;
 }
 
 void VExporter::handleLogicsFinished()
 {
-    Q_ASSERT(!(m_noteState & NoteState::WebLogicsReady));
-    m_noteState = NoteState(m_noteState | NoteState::WebLogicsReady);
+    NoteState *state = findNoteState(sender());
+    if (!state) {
+        return;
+    }
+
+    Q_ASSERT(!(*state & NoteState::WebLogicsReady));
+    *state = NoteState(*state | NoteState::WebLogicsReady);
 }
 
 void VExporter::handleLoadFinished(bool p_ok)
 {
-    Q_ASSERT(!(m_noteState & NoteState::WebLoadFinished));
-    m_noteState = NoteState(m_noteState | NoteState::WebLoadFinished);
+    NoteState *state = findNoteState(sender());
+    if (!state) {
+        return;
+    }
+
+    Q_ASSERT(!(*state & NoteState::WebLoadFinished));
+    *state = NoteState(*state | NoteState::WebLoadFinished);
 
     if (!p_ok) {
-        m_noteState = NoteState(m_noteState | NoteState::Failed);
+        *state = NoteState(*state | NoteState::Failed);
+    }
+}
+
+bool VExporter::isViaWebView(const ExportOption &p_opt)
+{
+    switch (p_opt.m_format) {
+    case ExportFormat::PDF:
+        V_FALLTHROUGH;
+    case ExportFormat::OnePDF:
+        V_FALLTHROUGH;
+    case ExportFormat::HTML:
+        return true;
+
+    case ExportFormat::Custom:
+        return p_opt.m_customOpt.m_srcFormat == ExportCustomOption::HTML;
+
+    default:
+        return false;
+    }
+}
+
+QVector<ExportOption::ExtraFormat> VExporter::extraFormats(const ExportOption &p_opt)
+{
+    QVector<ExportOption::ExtraFormat> formats;
+    if (p_opt.m_format != ExportFormat::HTML && p_opt.m_format != ExportFormat::PDF) {
+        return formats;
+    }
+
+    // Skip the one same as the main output.
+    bool isHTML = p_opt.m_format == ExportFormat::HTML && !p_opt.m_htmlOpt.m_mimeHTML;
+    bool isMHTML = p_opt.m_format == ExportFormat::HTML && p_opt.m_htmlOpt.m_mimeHTML;
+    bool isPDF = p_opt.m_format == ExportFormat::PDF;
+    if ((p_opt.m_extraFormats & ExportOption::ExtraHTML) && !isHTML) {
+        formats.append(ExportOption::ExtraHTML);
+    }
+
+    if ((p_opt.m_extraFormats & ExportOption::ExtraMHTML) && !isMHTML) {
+        formats.append(ExportOption::ExtraMHTML);
+    }
+
+    if ((p_opt.m_extraFormats & ExportOption::ExtraPDF) && !isPDF) {
+        formats.append(ExportOption::ExtraPDF);
+    }
+
+    return formats;
+}
+
+QString VExporter::extraOutputFile(const QString &p_outputFile, ExportOption::ExtraFormat p_format)
+{
+    QString suffix;
+    switch (p_format) {
+    case ExportOption::ExtraHTML:
+        suffix = ".html";
+        break;
+
+    case ExportOption::ExtraMHTML:
+        suffix = ".mht";
+        break;
+
+    case ExportOption::ExtraPDF:
+        suffix = ".pdf";
+        break;
+
+    default:
+        Q_ASSERT(false);
+        break;
+    }
+
+    QFileInfo fi(p_outputFile);
+    return QDir(fi.path()).filePath(fi.completeBaseName() + suffix);
+}
+
+void VExporter::prefetch(const QList<VFile *> &p_files, const ExportOption &p_opt)
+{
+    if (!isViaWebView(p_opt)) {
+        return;
+    }
+
+    bool native = isNativeExport(p_opt);
+
+    // One web view is taken by the note in export.
+    int webViewLimit = g_config->getExportWebViews() - 1;
+
+    // Notes rendered natively take no web view and are bounded by the quota
+    // of the export tasks instead.
+    int limit = native ? qMax(webViewLimit, VTaskExecutor::inst()->quota(VTaskExecutor::Export))
+                       : webViewLimit;
+    int numOfWebViews = 0;
+    for (auto const & note : m_prefetchedNotes) {
+        if (note.m_webViewer) {
+            ++numOfWebViews;
+        }
+    }
+
+    for (auto file : p_files) {
+        if (m_prefetchedNotes.size() >= limit || m_askedToStop) {
+            break;
+        }
+
+        if (file->getDocType() != DocType::Markdown) {
+            continue;
+        }
+
+        bool exist = false;
+        for (auto const & note : m_prefetchedNotes) {
+            if (note.m_file == file) {
+                exist = true;
+                break;
+            }
+        }
+
+        if (exist) {
+            continue;
+        }
+
+        PrefetchedNote note;
+        note.m_file = file;
+        if (native) {
+            note.m_nativeResult = renderNatively(file, p_opt);
+            if (note.m_nativeResult) {
+                m_prefetchedNotes.append(note);
+                continue;
+            }
+        }
+
+        if (numOfWebViews >= webViewLimit) {
+            continue;
+        }
+
+        if (!file->isOpened()) {
+            if (!file->open()) {
+                continue;
+            }
+
+            note.m_openedByExporter = true;
+        }
+
+        createWebViewer(file, p_opt, note.m_webViewer, note.m_webDocument, note.m_baseUrl);
+        m_prefetchedNotes.append(note);
+        ++numOfWebViews;
+    }
+}
+
+bool VExporter::takePrefetchedNote(VFile *p_file, PrefetchedNote &p_note)
+{
+    int idx = -1;
+    for (int i = 0; i < m_prefetchedNotes.size(); ++i) {
+        if (m_prefetchedNotes[i].m_file == p_file) {
+            idx = i;
+            break;
+        }
+    }
+
+    if (idx == -1) {
+        return false;
+    }
+
+    for (int i = 0; i < idx; ++i) {
+        discardPrefetchedNote(m_prefetchedNotes.takeFirst());
+    }
+
+    p_note = m_prefetchedNotes.takeFirst();
+    return true;
+}
+
+void VExporter::discardPrefetchedNote(const PrefetchedNote &p_note)
+{
+    // Skip the native rendering not started yet.
+    if (p_note.m_nativeResult) {
+        p_note.m_nativeResult->m_canceled.storeRelease(1);
+    }
+
+    delete p_note.m_webViewer;
+    if (p_note.m_openedByExporter) {
+        p_note.m_file->close();
+    }
+}
+
+void VExporter::clearPrefetchedNotes()
+{
+    for (auto const & note : m_prefetchedNotes) {
+        discardPrefetchedNote(note);
+    }
+
+    m_prefetchedNotes.clear();
+}
+
+// Collect the text of the fenced code blocks of @p_langs in @p_markdown as
+// the textContent of their <code> in the page.
+static void collectCodeBlocks(const QString &p_markdown,
+                              const QStringList &p_langs,
+                              QHash<QString, QStringList> &p_blocks)
+{
+    QRegularExpression startReg(VUtils::c_fencedCodeBlockStartRegExp);
+    QRegularExpression endReg(VUtils::c_fencedCodeBlockEndRegExp);
+
+    const QStringList lines = p_markdown.split('\n');
+    for (int i = 0; i < lines.size(); ++i) {
+        QRegularExpressionMatch match = startReg.match(lines[i]);
+        if (!match.hasMatch()) {
+            continue;
+        }
+
+        int indent = match.capturedLength(1);
+        QString lang = match.captured(3).trimmed().section(' ', 0, 0);
+        QString text;
+        for (++i; i < lines.size(); ++i) {
+            // markdown-it normalizes the line endings.
+            QString line = lines[i];
+            if (line.endsWith('\r')) {
+                line.chop(1);
+            }
+
+            if (endReg.match(line).hasMatch()) {
+                break;
+            }
+
+            // Remove the indentation of the fence from the content.
+            int nr = 0;
+            while (nr < indent && nr < line.size() && line[nr] == ' ') {
+                ++nr;
+            }
+
+            text += line.mid(nr) + '\n';
+        }
+
+        if (p_langs.contains(lang) && !text.trimmed().isEmpty()) {
+            p_blocks[lang].append(text);
+        }
+    }
+}
+
+int VExporter::prerenderDiagrams(const QList<QString> &p_files, const ExportOption &p_opt)
+{
+    // Only the code blocks of markdown-it are known to have the same text as
+    // collectCodeBlocks(), which is needed to merge with the requests of the page.
+    if (!isViaWebView(p_opt) || p_opt.m_renderer != MarkdownConverterType::MarkdownIt) {
+        return 0;
+    }
+
+    QStringList langs;
+    // Renders of the PlantUML server are not merged by VRenderScheduler.
+    if (g_config->getPlantUMLMode() == PlantUMLMode::LocalPlantUML
+        && (!g_config->getPlantUMLCmd().isEmpty() || !VPlantUMLServer::isEnabled())) {
+        langs << "puml";
+    }
+
+    if (g_config->getEnableGraphviz()) {
+        langs << "dot";
+    }
+
+    if (langs.isEmpty()) {
+        return 0;
+    }
+
+    V_TRACE("export", "Pre-render diagrams");
+
+    // Same formats as the page requests in generateHtmlTemplate().
+    bool isPdf = p_opt.m_format == ExportFormat::PDF
+                 || p_opt.m_format == ExportFormat::OnePDF
+                 || (p_opt.m_format == ExportFormat::Custom
+                     && p_opt.m_customOpt.m_pdfLike);
+    const QString plantUMLFormat = isPdf ? "png" : "svg";
+    const QString graphvizFormat = "svg";
+
+    // The same diagram may appear in many notes.
+    QSet<QString> scheduled;
+    int nr = 0;
+    for (auto const & file : p_files) {
+        if (m_askedToStop) {
+            break;
+        }
+
+        if (VUtils::docTypeFromName(file) != DocType::Markdown) {
+            continue;
+        }
+
+        QHash<QString, QStringList> blocks;
+        collectCodeBlocks(VUtils::readFileFromDisk(file), langs, blocks);
+        for (auto it = blocks.constBegin(); it != blocks.constEnd(); ++it) {
+            bool isPuml = it.key() == "puml";
+            for (auto const & text : it.value()) {
+                QString key = it.key() + '\n' + text;
+                if (scheduled.contains(key)) {
+                    continue;
+                }
+
+                scheduled.insert(key);
+
+                // Renders are run by VRenderScheduler within its limit, and the
+                // same ones requested by the pages are merged into them.
+                if (isPuml) {
+                    if (!m_plantUMLHelper) {
+                        m_plantUMLHelper = new VPlantUMLHelper(this);
+                    }
+
+                    m_plantUMLHelper->processAsync(nr, 0, plantUMLFormat, text);
+                } else {
+                    if (!m_graphvizHelper) {
+                        m_graphvizHelper = new VGraphvizHelper(this);
+                    }
+
+                    m_graphvizHelper->processAsync(nr, 0, graphvizFormat, text);
+                }
+
+                ++nr;
+            }
+        }
+    }
+
+    return nr;
+}
+
+bool VExporter::isNativeExport(const ExportOption &p_opt) const
+{
+    // Image captions and line numbers of code blocks are added by scripts.
+    return g_config->getEnableNativeHtmlExport()
+           && p_opt.m_format == ExportFormat::HTML
+           && !p_opt.m_htmlOpt.m_mimeHTML
+           && extraFormats(p_opt).isEmpty()
+           && p_opt.m_renderer == MarkdownConverterType::Hoedown
+           && !g_config->getEnableImageCaption()
+           && !g_config->getEnableCodeBlockLineNumber();
+}
+
+QSharedPointer<NativeRenderResult> VExporter::renderNatively(VFile *p_file,
+                                                             const ExportOption &p_opt)
+{
+    Q_UNUSED(p_opt);
+
+    QSharedPointer<NativeRenderResult> result;
+
+    bool isOpened = p_file->isOpened();
+    if (!isOpened && !p_file->open()) {
+        return result;
+    }
+
+    QString content = p_file->getContent();
+
+    if (!isOpened) {
+        p_file->close();
+    }
+
+    if (!VNativeHtmlRenderer::isRenderable(content, g_config->getEnableMathjax())) {
+        return result;
+    }
+
+    result.reset(new NativeRenderResult());
+    VTaskExecutor::inst()->start(new NativeRenderTask(result,
+                                                      content,
+                                                      g_config->getMarkdownExtensions()),
+                                 VTaskExecutor::Export);
+    return result;
+}
+
+bool VExporter::exportViaNative(VFile *p_file,
+                                const QSharedPointer<NativeRenderResult> &p_result,
+                                const ExportOption &p_opt,
+                                const QString &p_outputFile)
+{
+    V_TRACE("export", "Export via native renderer");
+
+    while (!p_result->m_finished.loadAcquire()) {
+        VUtils::sleepWait(50);
+
+        if (m_askedToStop) {
+            return false;
+        }
+    }
+
+    if (p_result->m_html.isEmpty()) {
+        return false;
+    }
+
+    QString title = QFileInfo(p_file->getName()).completeBaseName();
+
+    // Resources of the body are relative to the note.
+    m_baseUrl = p_file->getBaseUrl();
+    bool ret = outputToHTMLFile(p_outputFile,
+                                title,
+                                QString(),
+                                m_nativeStyleContent,
+                                p_result->m_html,
+                                p_opt.m_htmlOpt.m_embedCssStyle,
+                                p_opt.m_htmlOpt.m_completeHTML,
+                                p_opt.m_htmlOpt.m_embedImages);
+    m_baseUrl.clear();
+    return ret;
+}
+
+QString VExporter::readStyleSheet(const QString &p_url)
+{
+    if (p_url.isEmpty()) {
+        return QString();
+    }
+
+    QUrl url(p_url);
+    QString filePath;
+    if (url.scheme() == "qrc") {
+        filePath = ":" + url.path();
+    } else {
+        filePath = url.toLocalFile();
+    }
+
+    QString css = VUtils::readFileFromDisk(filePath);
+    if (css.isEmpty()) {
+        return css;
+    }
+
+    // Translate the relative url() into absolute like the web side does.
+    QString baseUrl = p_url.left(p_url.lastIndexOf('/'));
+    QRegExp reg("\\burl\\(\"([^\"\\)]+)\"\\);");
+    int pos = 0;
+    while (pos < css.size()) {
+        int idx = css.indexOf(reg, pos);
+        if (idx == -1) {
+            break;
+        }
+
+        QString target = reg.cap(1);
+        if (target.contains(':')) {
+            // Already with a scheme.
+            pos = idx + reg.matchedLength();
+            continue;
+        }
+
+        QString newUrl = QString("url(\"%1/%2\");").arg(baseUrl).arg(target);
+        css.replace(idx, reg.matchedLength(), newUrl);
+        pos = idx + newUrl.size();
     }
+
+    return css + "\n";
 }
 
 void VExporter::clearWebViewer()
@@ -282,6 +871,8 @@ bool VExporter::exportToPDF(VWebView *p_webViewer,
                             const QString &p_filePath,
                             const QPageLayout &p_layout)
 {
+    V_TRACE("export", "Print to PDF");
+
     int pdfPrinted = 0;
     p_webViewer->page()->printToPdf([&, this](const QByteArray &p_result) {
         if (p_result.isEmpty() || this->m_state == ExportState::Cancelled) {
@@ -315,6 +906,8 @@ bool VExporter::exportToPDFViaWK(VDocument *p_webDocument,
                                  const QString &p_filePath,
                                  QString *p_errMsg)
 {
+    V_TRACE("export", "Export to PDF via wkhtmltopdf");
+
     int pdfExported = 0;
 
     connect(p_webDocument, &VDocument::htmlContentFinished,
@@ -336,6 +929,20 @@ bool VExporter::exportToPDFViaWK(VDocument *p_webDocument,
                 }
 
                 QString htmlPath = tmpDir.filePath("vnote_tmp.html");
+                if (m_concurrentPDF) {
+                    // Keep the HTML until the conversion finishes.
+                    if (!m_pdfTmpDir) {
+                        m_pdfTmpDir.reset(new QTemporaryDir());
+                        if (!m_pdfTmpDir->isValid()) {
+                            m_pdfTmpDir.clear();
+                            pdfExported = -1;
+                            return;
+                        }
+                    }
+
+                    htmlPath = QDir(m_pdfTmpDir->path()).filePath(QString("vnote_tmp_%1.html").arg(++m_numOfPDFHtmls));
+                }
+
                 QString title = p_webDocument->getFile()->getName();
                 title = QFileInfo(title).completeBaseName();
                 if (!outputToHTMLFile(htmlPath,
@@ -350,6 +957,12 @@ bool VExporter::exportToPDFViaWK(VDocument *p_webDocument,
                     return;
                 }
 
+                if (m_concurrentPDF) {
+                    queuePDFViaWK(p_webDocument->getFile()->fetchPath(), htmlPath, p_filePath, p_opt);
+                    pdfExported = 1;
+                    return;
+                }
+
                 // Convert via wkhtmltopdf.
                 QList<QString> files;
                 files.append(htmlPath);
@@ -378,6 +991,8 @@ bool VExporter::exportToCustom(VDocument *p_webDocument,
                                const QString &p_filePath,
                                QString *p_errMsg)
 {
+    V_TRACE("export", "Export to custom");
+
     int exported = 0;
 
     connect(p_webDocument, &VDocument::htmlContentFinished,
@@ -441,21 +1056,44 @@ bool VExporter::exportViaWebView(VFile *p_file,
                                  const QString &p_outputFile,
                                  QString *p_errMsg)
 {
+    V_TRACE("export", "Export via web view");
+
     Q_UNUSED(p_errMsg);
 
     bool ret = false;
 
-    bool isOpened = p_file->isOpened();
-    if (!isOpened && !p_file->open()) {
-        goto exit;
+    bool isOpened = true;
+    PrefetchedNote note;
+    bool prefetched = takePrefetchedNote(p_file, note);
+    if (prefetched && !note.m_webViewer) {
+        // Rendered natively but exported via web view.
+        discardPrefetchedNote(note);
+        prefetched = false;
+    }
+
+    if (prefetched) {
+        isOpened = !note.m_openedByExporter;
+    } else {
+        isOpened = p_file->isOpened();
+        if (!isOpened && !p_file->open()) {
+            goto exit;
+        }
     }
 
     Q_ASSERT(m_state == ExportState::Idle);
     m_state = ExportState::Busy;
 
-    clearNoteState();
+    if (prefetched) {
+        Q_ASSERT(!m_webViewer);
+        m_webViewer = note.m_webViewer;
+        m_webDocument = note.m_webDocument;
+        m_baseUrl = note.m_baseUrl;
+        m_noteState = note.m_noteState;
+    } else {
+        clearNoteState();
 
-    initWebViewer(p_file, p_opt);
+        initWebViewer(p_file, p_opt);
+    }
 
     while (!isNoteStateReady()) {
         VUtils::sleepWait(100);
@@ -526,6 +1164,35 @@ bool VExporter::exportViaWebView(VFile *p_file,
         break;
     }
 
+    // Output the extra formats from the same page.
+    if (exportRet) {
+        for (auto fmt : extraFormats(p_opt)) {
+            QString filePath = extraOutputFile(p_outputFile, fmt);
+            bool extraRet = false;
+            switch (fmt) {
+            case ExportOption::ExtraHTML:
+                extraRet = exportToHTML(m_webDocument, p_opt.m_htmlOpt, filePath);
+                break;
+
+            case ExportOption::ExtraMHTML:
+                extraRet = exportToMHTML(m_webViewer, p_opt.m_htmlOpt, filePath);
+                break;
+
+            case ExportOption::ExtraPDF:
+                extraRet = exportToPDF(m_webViewer, filePath, m_pageLayout);
+                break;
+
+            default:
+                break;
+            }
+
+            if (!extraRet) {
+                exportRet = false;
+                VUtils::addErrMsg(p_errMsg, tr("Fail to export to %1.").arg(filePath));
+            }
+        }
+    }
+
     clearNoteState();
 
     if (!isOpened) {
@@ -543,6 +1210,10 @@ bool VExporter::exportViaWebView(VFile *p_file,
 exit:
     clearWebViewer();
 
+    if (m_state == ExportState::Cancelled || m_askedToStop) {
+        clearPrefetchedNotes();
+    }
+
     if (m_state == ExportState::Successful) {
         ret = true;
     }
@@ -556,6 +1227,8 @@ bool VExporter::exportToHTML(VDocument *p_webDocument,
                              const ExportHTMLOption &p_opt,
                              const QString &p_filePath)
 {
+    V_TRACE("export", "Export to HTML");
+
     int htmlExported = 0;
 
     connect(p_webDocument, &VDocument::htmlContentFinished,
@@ -599,139 +1272,286 @@ bool VExporter::exportToHTML(VDocument *p_webDocument,
     return htmlExported == 1;
 }
 
-bool VExporter::fixStyleResources(const QString &p_folder,
-                                  QString &p_html)
+// Replace all the matches of @p_reg in @p_text in one pass.
+// @p_func returns the replacement of a match, or a null string to keep it.
+static bool replaceMatches(QString &p_text,
+                           const QRegularExpression &p_reg,
+                           const std::function<QString(const QRegularExpressionMatch &)> &p_func)
 {
+    QString out;
+    int lastPos = 0;
     bool altered = false;
-    QRegExp reg("\\burl\\(\"((file|qrc):[^\"\\)]+)\"\\);");
-
-    int pos = 0;
-    while (pos < p_html.size()) {
-        int idx = p_html.indexOf(reg, pos);
-        if (idx == -1) {
-            break;
+    QRegularExpressionMatchIterator it = p_reg.globalMatch(p_text);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        QString newText = p_func(match);
+        if (newText.isNull()) {
+            continue;
         }
 
-        QString targetFile = g_webUtils->copyResource(QUrl(reg.cap(1)), p_folder);
-        if (targetFile.isEmpty()) {
-            pos = idx + reg.matchedLength();
-        } else {
-            // Replace the url string in html.
-            QString newUrl = QString("url(\"%1\");").arg(getResourceRelativePath(targetFile));
-            p_html.replace(idx, reg.matchedLength(), newUrl);
-            pos = idx + newUrl.size();
+        if (!altered) {
+            out.reserve(p_text.size() * 2);
             altered = true;
         }
+
+        out += p_text.midRef(lastPos, match.capturedStart() - lastPos);
+        out += newText;
+        lastPos = match.capturedEnd();
+    }
+
+    if (altered) {
+        out += p_text.midRef(lastPos);
+        p_text = out;
     }
 
     return altered;
 }
 
-bool VExporter::embedStyleResources(QString &p_html)
+static const QRegularExpression &styleResourceRegExp()
 {
-    bool altered = false;
-    QRegExp reg("\\burl\\(\"((file|qrc):[^\"\\)]+)\"\\);");
+    static const QRegularExpression reg("\\burl\\(\"((file|qrc):[^\"\\)]+)\"\\);");
+    return reg;
+}
 
-    int pos = 0;
-    while (pos < p_html.size()) {
-        int idx = p_html.indexOf(reg, pos);
-        if (idx == -1) {
-            break;
+static const QRegularExpression &bodyResourceRegExp()
+{
+    static const QRegularExpression reg("<img ([^>]*)src=\"([^\"]+)\"([^>]*)>");
+    return reg;
+}
+
+static QString dataURIKey(const QUrl &p_url, bool p_keepTitle)
+{
+    return (p_keepTitle ? "1" : "0") + p_url.toString();
+}
+
+void VExporter::prepareDataURIs(const QList<QUrl> &p_urls, bool p_keepTitle)
+{
+    // Remote resources are downloaded in this thread.
+    QList<QUrl> urls;
+    QSet<QString> keys;
+    for (auto const & url : p_urls) {
+        QString key = dataURIKey(url, p_keepTitle);
+        if (m_dataURIs.contains(key) || keys.contains(key)) {
+            continue;
         }
 
-        QString dataURI = g_webUtils->dataURI(QUrl(reg.cap(1)), false);
-        if (dataURI.isEmpty()) {
-            pos = idx + reg.matchedLength();
+        keys.insert(key);
+        if (url.isLocalFile() || url.scheme() == "qrc") {
+            urls.append(url);
         } else {
-            // Replace the url string in html.
-            QString newUrl = QString("url('%1');").arg(dataURI);
-            p_html.replace(idx, reg.matchedLength(), newUrl);
-            pos = idx + newUrl.size();
-            altered = true;
+            m_dataURIs.insert(key, g_webUtils->dataURI(url, p_keepTitle));
         }
     }
 
-    return altered;
+    if (urls.isEmpty()) {
+        return;
+    }
+
+    // Encode the files on the workers of VWebUtils, whose cache is shared with
+    // other exports and copies.
+    if (urls.size() > 1) {
+        g_webUtils->prefetchDataURIs(urls, p_keepTitle);
+    }
+
+    for (auto const & url : urls) {
+        m_dataURIs.insert(dataURIKey(url, p_keepTitle), g_webUtils->dataURI(url, p_keepTitle));
+    }
 }
 
-bool VExporter::fixBodyResources(const QUrl &p_baseUrl,
-                                 const QString &p_folder,
-                                 QString &p_html)
+bool VExporter::fixStyleResources(const QString &p_folder,
+                                  QString &p_html)
 {
-    bool altered = false;
-    if (p_baseUrl.isEmpty()) {
-        return altered;
+    return replaceMatches(p_html,
+                          styleResourceRegExp(),
+                          [&p_folder](const QRegularExpressionMatch &p_match) {
+                              QString targetFile = g_webUtils->copyResource(QUrl(p_match.captured(1)),
+                                                                            p_folder);
+                              if (targetFile.isEmpty()) {
+                                  return QString();
+                              }
+
+                              return QString("url(\"%1\");").arg(getResourceRelativePath(targetFile));
+                          });
+}
+
+bool VExporter::embedStyleResources(QString &p_html)
+{
+    QList<QUrl> urls;
+    QRegularExpressionMatchIterator it = styleResourceRegExp().globalMatch(p_html);
+    while (it.hasNext()) {
+        urls.append(QUrl(it.next().captured(1)));
     }
 
-    QRegExp reg("<img ([^>]*)src=\"([^\"]+)\"([^>]*)>");
+    if (urls.isEmpty()) {
+        return false;
+    }
 
-    int pos = 0;
-    while (pos < p_html.size()) {
-        int idx = p_html.indexOf(reg, pos);
-        if (idx == -1) {
-            break;
+    prepareDataURIs(urls, false);
+
+    return replaceMatches(p_html,
+                          styleResourceRegExp(),
+                          [this](const QRegularExpressionMatch &p_match) {
+                              QString key = dataURIKey(QUrl(p_match.captured(1)), false);
+                              const QString &dataURI = m_dataURIs.value(key);
+                              if (dataURI.isEmpty()) {
+                                  return QString();
+                              }
+
+                              return QString("url('%1');").arg(dataURI);
+                          });
+}
+
+void VExporter::prepareBodyResources(const QUrl &p_baseUrl,
+                                     const QString &p_folder,
+                                     const QString &p_html)
+{
+    QDir dir(p_folder);
+    QVector<VFileCopier::Job> jobs;
+    QVector<QString> keys;
+    QSet<QString> takenNames;
+    QRegularExpressionMatchIterator it = bodyResourceRegExp().globalMatch(p_html);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        if (match.capturedLength(2) == 0) {
+            continue;
         }
 
-        if (reg.cap(2).isEmpty()) {
-            pos = idx + reg.matchedLength();
+        QUrl srcUrl(p_baseUrl.resolved(match.captured(2)));
+        if (!srcUrl.isLocalFile()) {
             continue;
         }
 
-        QUrl srcUrl(p_baseUrl.resolved(reg.cap(2)));
-        QString targetFile = g_webUtils->copyResource(srcUrl, p_folder);
-        if (targetFile.isEmpty()) {
-            pos = idx + reg.matchedLength();
-        } else {
-            // Replace the url string in html.
-            QString newUrl = QString("<img %1src=\"%2\"%3>").arg(reg.cap(1))
-                                                            .arg(getResourceRelativePath(targetFile))
-                                                            .arg(reg.cap(3));
-            p_html.replace(idx, reg.matchedLength(), newUrl);
-            pos = idx + newUrl.size();
-            altered = true;
+        QString key = p_folder + "\n" + srcUrl.toString();
+        if (keys.contains(key)) {
+            continue;
+        }
+
+        QString targetFile = m_copiedResources.value(key);
+        if (!targetFile.isEmpty() && QFileInfo::exists(targetFile)) {
+            continue;
+        }
+
+        QString file = srcUrl.toLocalFile();
+        if (!QFileInfo::exists(file)) {
+            continue;
+        }
+
+        // Keep the name of the last export to update it in place
+        // unless it is taken by another resource in this export.
+        QString name = VUtils::fileNameFromPath(file);
+        bool sync = m_incremental
+                    && !takenNames.contains(name)
+                    && !m_copiedTargets.contains(dir.absoluteFilePath(name));
+        if (!sync) {
+            name = VUtils::getFileNameWithSequence(p_folder, name, true, takenNames);
         }
+
+        takenNames.insert(name);
+        keys.append(key);
+        jobs.append(VFileCopier::Job(file, dir.absoluteFilePath(name), false, sync));
     }
 
-    return altered;
+    if (jobs.isEmpty()) {
+        return;
+    }
+
+    VFileCopier::copyFiles(jobs);
+    for (int i = 0; i < jobs.size(); ++i) {
+        if (jobs[i].m_succeeded) {
+            m_copiedResources.insert(keys[i], jobs[i].m_destFile);
+            m_copiedTargets.insert(jobs[i].m_destFile);
+        } else {
+            qWarning() << "fail to copy resource" << jobs[i].m_srcFile << "to" << jobs[i].m_destFile;
+        }
+    }
 }
 
-bool VExporter::embedBodyResources(const QUrl &p_baseUrl, QString &p_html)
+bool VExporter::fixBodyResources(const QUrl &p_baseUrl,
+                                 const QString &p_folder,
+                                 QString &p_html)
 {
-    bool altered = false;
     if (p_baseUrl.isEmpty()) {
-        return altered;
+        return false;
     }
 
-    QRegExp reg("<img ([^>]*)src=\"([^\"]+)\"([^>]*)>");
+    prepareBodyResources(p_baseUrl, p_folder, p_html);
+
+    // Remote resources are downloaded one by one.
+    return replaceMatches(p_html,
+                          bodyResourceRegExp(),
+                          [&, this](const QRegularExpressionMatch &p_match) {
+                              if (p_match.capturedLength(2) == 0) {
+                                  return QString();
+                              }
+
+                              // Copy the same resource to the same folder only once.
+                              QUrl srcUrl(p_baseUrl.resolved(p_match.captured(2)));
+                              QString key = p_folder + "\n" + srcUrl.toString();
+                              QString targetFile = m_copiedResources.value(key);
+                              if (targetFile.isEmpty() || !QFileInfo::exists(targetFile)) {
+                                  // Keep the name of the last export to update it in place
+                                  // unless it is taken by another resource in this export.
+                                  bool sync = false;
+                                  if (m_incremental) {
+                                      QString file = srcUrl.isLocalFile() ? srcUrl.toLocalFile()
+                                                                          : srcUrl.toString();
+                                      QString name = VUtils::fileNameFromPath(file);
+                                      sync = !m_copiedTargets.contains(QDir(p_folder).absoluteFilePath(name));
+                                  }
+
+                                  targetFile = g_webUtils->copyResource(srcUrl, p_folder, sync);
+                                  if (targetFile.isEmpty()) {
+                                      return QString();
+                                  }
+
+                                  m_copiedResources.insert(key, targetFile);
+                                  m_copiedTargets.insert(targetFile);
+                              }
+
+                              return QString("<img %1src=\"%2\"%3>").arg(p_match.captured(1))
+                                                                    .arg(getResourceRelativePath(targetFile))
+                                                                    .arg(p_match.captured(3));
+                          });
+}
 
-    int pos = 0;
-    while (pos < p_html.size()) {
-        int idx = p_html.indexOf(reg, pos);
-        if (idx == -1) {
-            break;
-        }
+bool VExporter::embedBodyResources(const QUrl &p_baseUrl, QString &p_html)
+{
+    if (p_baseUrl.isEmpty()) {
+        return false;
+    }
 
-        if (reg.cap(2).isEmpty()) {
-            pos = idx + reg.matchedLength();
-            continue;
+    QList<QUrl> urls;
+    QRegularExpressionMatchIterator it = bodyResourceRegExp().globalMatch(p_html);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        if (match.capturedLength(2) > 0) {
+            urls.append(p_baseUrl.resolved(match.captured(2)));
         }
+    }
 
-        QUrl srcUrl(p_baseUrl.resolved(reg.cap(2)));
-        QString dataURI = g_webUtils->dataURI(srcUrl);
-        if (dataURI.isEmpty()) {
-            pos = idx + reg.matchedLength();
-        } else {
-            // Replace the url string in html.
-            QString newUrl = QString("<img %1src='%2'%3>").arg(reg.cap(1))
-                                                          .arg(dataURI)
-                                                          .arg(reg.cap(3));
-            p_html.replace(idx, reg.matchedLength(), newUrl);
-            pos = idx + newUrl.size();
-            altered = true;
-        }
+    if (urls.isEmpty()) {
+        return false;
     }
 
-    return altered;
+    prepareDataURIs(urls, true);
+
+    return replaceMatches(p_html,
+                          bodyResourceRegExp(),
+                          [&, this](const QRegularExpressionMatch &p_match) {
+                              if (p_match.capturedLength(2) == 0) {
+                                  return QString();
+                              }
+
+                              QUrl srcUrl(p_baseUrl.resolved(p_match.captured(2)));
+                              const QString &dataURI = m_dataURIs.value(dataURIKey(srcUrl, true));
+                              if (dataURI.isEmpty()) {
+                                  return QString();
+                              }
+
+                              return QString("<img %1src='%2'%3>").arg(p_match.captured(1))
+                                                                  .arg(dataURI)
+                                                                  .arg(p_match.captured(3));
+                          });
 }
 
 QString VExporter::getResourceRelativePath(const QString &p_file)
@@ -746,6 +1566,8 @@ bool VExporter::exportToMHTML(VWebView *p_webViewer,
                               const ExportHTMLOption &p_opt,
                               const QString &p_filePath)
 {
+    V_TRACE("export", "Export to MHTML");
+
     Q_UNUSED(p_opt);
 
     m_downloadState = QWebEngineDownloadItem::DownloadRequested;
@@ -796,6 +1618,8 @@ bool VExporter::htmlsToPDFViaWK(const QList<QString> &p_htmlFiles,
                                 const ExportPDFOption &p_opt,
                                 QString *p_errMsg)
 {
+    V_TRACE("export", "Convert HTMLs to PDF via wkhtmltopdf");
+
     // Note: system's locale settings (Language for non-Unicode programs) is important to wkhtmltopdf.
     // Input file could be encoded via QUrl::fromLocalFile(p_htmlFile).toString(QUrl::EncodeUnicode) to
     // handle non-ASCII path.
@@ -833,11 +1657,188 @@ bool VExporter::htmlsToPDFViaWK(const QList<QString> &p_htmlFiles,
     return ret == 0;
 }
 
+void VExporter::queuePDFViaWK(const QString &p_srcFile,
+                              const QString &p_htmlFile,
+                              const QString &p_filePath,
+                              const ExportPDFOption &p_opt)
+{
+    QStringList args(m_wkArgs);
+    args << QDir::toNativeSeparators(p_htmlFile);
+    args << QDir::toNativeSeparators(p_filePath);
+
+    PendingPDF pdf;
+    pdf.m_srcFile = p_srcFile;
+    pdf.m_filePath = p_filePath;
+    pdf.m_cmd = p_opt.m_wkPath + " " + combineArgs(args);
+    qDebug() << "wkhtmltopdf cmd in background:" << pdf.m_cmd;
+
+    pdf.m_id = m_processRunner->start(p_opt.m_wkPath, args);
+    m_pendingPDFs.append(pdf);
+}
+
+bool VExporter::isPDFPending(const QString &p_filePath) const
+{
+    return !m_pendingPDFs.isEmpty() && m_pendingPDFs.last().m_filePath == p_filePath;
+}
+
+bool VExporter::hasPendingPDFs() const
+{
+    return !m_pendingPDFs.isEmpty();
+}
+
+int VExporter::collectPendingPDFs(const std::function<void(const QString &, const QString &, bool)> &p_func,
+                                  QString *p_errMsg)
+{
+    int numOfFailed = 0;
+    for (auto const & pdf : m_pendingPDFs) {
+        // Killed jobs finish with -1 once asked to stop.
+        while (!m_finishedJobs.contains(pdf.m_id)) {
+            VUtils::sleepWait(100);
+        }
+
+        int ret = m_finishedJobs.value(pdf.m_id);
+        if (ret != 0) {
+            ++numOfFailed;
+            if (!m_askedToStop) {
+                switch (ret) {
+                case -2:
+                    VUtils::addErrMsg(p_errMsg, tr("Fail to start wkhtmltopdf (%1).").arg(pdf.m_cmd));
+                    break;
+
+                case -1:
+                    VUtils::addErrMsg(p_errMsg, tr("wkhtmltopdf crashed (%1).").arg(pdf.m_cmd));
+                    break;
+
+                default:
+                    VUtils::addErrMsg(p_errMsg, tr("wkhtmltopdf failed with %1 (%2).").arg(ret).arg(pdf.m_cmd));
+                    break;
+                }
+            }
+        }
+
+        if (p_func) {
+            p_func(pdf.m_srcFile, pdf.m_filePath, ret == 0);
+        }
+    }
+
+    m_pendingPDFs.clear();
+    m_finishedJobs.clear();
+    m_pdfTmpDir.clear();
+
+    return numOfFailed;
+}
+
+bool VExporter::htmlsToPDFViaWKInChunks(const QList<QString> &p_htmlFiles,
+                                        const QString &p_filePath,
+                                        const ExportPDFOption &p_opt,
+                                        int p_chunkSize,
+                                        const QString &p_mergeCmd,
+                                        QString *p_errMsg)
+{
+    QTemporaryDir tmpDir;
+    if (!tmpDir.isValid()) {
+        VUtils::addErrMsg(p_errMsg, tr("Fail to create temporary directory for chunks of PDF."));
+        return false;
+    }
+
+    int numOfChunks = (p_htmlFiles.size() + p_chunkSize - 1) / p_chunkSize;
+    emit outputLog(tr("Convert %1 notes to PDF in %2 chunks.").arg(p_htmlFiles.size())
+                                                              .arg(numOfChunks));
+
+    QVector<QPair<QString, QStringList>> cmds;
+    QString chunkFiles;
+    for (int i = 0; i < numOfChunks; ++i) {
+        QString chunkFile = QDir(tmpDir.path()).filePath(QString("chunk_%1.pdf").arg(i, 4, 10, QChar('0')));
+        chunkFile = QDir::toNativeSeparators(chunkFile);
+
+        QStringList args(m_wkArgs);
+        for (auto const & it : p_htmlFiles.mid(i * p_chunkSize, p_chunkSize)) {
+            args << QDir::toNativeSeparators(it);
+        }
+
+        args << chunkFile;
+        cmds.append(qMakePair(p_opt.m_wkPath, args));
+
+        if (!chunkFiles.isEmpty()) {
+            chunkFiles += " ";
+        }
+
+        chunkFiles += ("\"" + chunkFile + "\"");
+
+        qDebug() << "wkhtmltopdf chunk cmd:" << p_opt.m_wkPath + " " + combineArgs(args);
+    }
+
+    int numOfFinished = 0;
+    QVector<int> rets = runProcesses(cmds, [&](int p_idx, int p_ret) {
+        ++numOfFinished;
+        if (p_ret == 0) {
+            emit outputLog(tr("Chunk %1 converted (%2/%3).").arg(p_idx + 1)
+                                                            .arg(numOfFinished)
+                                                            .arg(numOfChunks));
+        } else {
+            emit outputLog(tr("Chunk %1 failed with %2 (%3/%4).").arg(p_idx + 1)
+                                                                 .arg(p_ret)
+                                                                 .arg(numOfFinished)
+                                                                 .arg(numOfChunks));
+        }
+    });
+
+    if (m_askedToStop) {
+        return false;
+    }
+
+    bool allSucceeded = true;
+    for (int i = 0; i < rets.size(); ++i) {
+        if (rets[i] != 0) {
+            QString cmd = p_opt.m_wkPath + " " + combineArgs(cmds[i].second);
+            VUtils::addErrMsg(p_errMsg, tr("Fail to convert chunk %1 via wkhtmltopdf (%2).").arg(i + 1)
+                                                                                             .arg(cmd));
+            allSucceeded = false;
+        }
+    }
+
+    if (!allSucceeded) {
+        return false;
+    }
+
+    QString cmd(p_mergeCmd);
+    replaceArgument(cmd, "%0", chunkFiles);
+    replaceArgument(cmd, "%1", "\"" + QDir::toNativeSeparators(p_filePath) + "\"");
+    emit outputLog(cmd);
+    qDebug() << "merge cmd:" << cmd;
+    int ret = startProcess(cmd);
+    qDebug() << "merge cmd returned" << ret;
+    if (m_askedToStop) {
+        return ret == 0;
+    }
+
+    switch (ret) {
+    case 0:
+        break;
+
+    case -2:
+        VUtils::addErrMsg(p_errMsg, tr("Fail to start merge command (%1).").arg(cmd));
+        break;
+
+    case -1:
+        VUtils::addErrMsg(p_errMsg, tr("Merge command crashed (%1).").arg(cmd));
+        break;
+
+    default:
+        VUtils::addErrMsg(p_errMsg, tr("Merge command failed with %1 (%2).").arg(ret).arg(cmd));
+        break;
+    }
+
+    return ret == 0;
+}
+
 bool VExporter::convertFilesViaCustom(const QList<QString> &p_files,
                                       const QString &p_filePath,
                                       const ExportCustomOption &p_opt,
                                       QString *p_errMsg)
 {
+    V_TRACE("export", "Convert files via custom command");
+
     QString input;
     QString inputFolder;
     for (auto const & it : p_files) {
@@ -888,85 +1889,119 @@ int VExporter::exportPDFInOne(const QList<QString> &p_htmlFiles,
                               const QString &p_outputFile,
                               QString *p_errMsg)
 {
-    if (!htmlsToPDFViaWK(p_htmlFiles, p_outputFile, p_opt.m_pdfOpt, p_errMsg)) {
-        return 0;
+    // A table of contents could not span the chunks.
+    int chunkSize = g_config->getExportPdfChunkSize();
+    QString mergeCmd = g_config->getExportPdfMergeCmd();
+    bool ret = false;
+    if (chunkSize > 0
+        && p_htmlFiles.size() > chunkSize
+        && !mergeCmd.isEmpty()
+        && !p_opt.m_pdfOpt.m_enableTableOfContents) {
+        ret = htmlsToPDFViaWKInChunks(p_htmlFiles,
+                                      p_outputFile,
+                                      p_opt.m_pdfOpt,
+                                      chunkSize,
+                                      mergeCmd,
+                                      p_errMsg);
+    } else {
+        ret = htmlsToPDFViaWK(p_htmlFiles, p_outputFile, p_opt.m_pdfOpt, p_errMsg);
     }
 
-    return p_htmlFiles.size();
+    return ret ? p_htmlFiles.size() : 0;
 }
 
 int VExporter::startProcess(const QString &p_program, const QStringList &p_args)
 {
-    int ret = 0;
-    QScopedPointer<QProcess> process(new QProcess(this));
-    process->start(p_program, p_args);
-    bool finished = false;
-    bool started = false;
-    while (true) {
-        QProcess::ProcessError err = process->error();
-        if (err == QProcess::FailedToStart
-            || err == QProcess::Crashed) {
-            emit outputLog(tr("QProcess error %1.").arg(err));
-            if (err == QProcess::FailedToStart) {
-                ret = -2;
-            } else {
-                ret = -1;
-            }
+    QVector<QPair<QString, QStringList>> cmds;
+    cmds.append(qMakePair(p_program, p_args));
+    return runProcesses(cmds).first();
+}
 
-            break;
-        }
+QVector<int> VExporter::runProcesses(const QVector<QPair<QString, QStringList>> &p_cmds,
+                                     const std::function<void(int, int)> &p_finishFunc)
+{
+    QVector<int> rets(p_cmds.size(), -1);
+    if (p_cmds.isEmpty() || m_askedToStop) {
+        return rets;
+    }
 
-        if (started) {
-            if (process->state() == QProcess::NotRunning) {
-                finished = true;
+    // Job ID -> index in @p_cmds.
+    QHash<int, int> jobs;
+
+    // Jobs finished before start() returns, like those failing to start.
+    QHash<int, int> finishedJobs;
+
+    QEventLoop loop;
+
+    QMetaObject::Connection outputConn = connect(m_processRunner, &VProcessRunner::outputReady,
+                                                 this, [this](int p_id, const QString &p_output) {
+                                                     Q_UNUSED(p_id);
+                                                     emit outputLog(p_output);
+                                                 });
+    QMetaObject::Connection finishConn = connect(m_processRunner, &VProcessRunner::finished,
+                                                 this, [&](int p_id, int p_ret) {
+                                                     auto it = jobs.find(p_id);
+                                                     if (it == jobs.end()) {
+                                                         finishedJobs.insert(p_id, p_ret);
+                                                         return;
+                                                     }
+
+                                                     rets[it.value()] = p_ret;
+                                                     if (p_finishFunc) {
+                                                         p_finishFunc(it.value(), p_ret);
+                                                     }
+
+                                                     jobs.erase(it);
+                                                     if (jobs.isEmpty()) {
+                                                         loop.quit();
+                                                     }
+                                                 });
+
+    for (int i = 0; i < p_cmds.size(); ++i) {
+        int id = m_processRunner->start(p_cmds[i].first, p_cmds[i].second);
+        auto it = finishedJobs.find(id);
+        if (it != finishedJobs.end()) {
+            rets[i] = it.value();
+            if (p_finishFunc) {
+                p_finishFunc(i, rets[i]);
             }
         } else {
-            if (process->state() != QProcess::NotRunning) {
-                started = true;
-            }
+            jobs.insert(id, i);
         }
+    }
 
-        if (process->waitForFinished(500)) {
-            // Finished.
-            finished = true;
-        }
+    if (!jobs.isEmpty()) {
+        // Stopped by killing the jobs in setAskedToStop().
+        loop.exec();
+    }
 
-        QByteArray outBa = process->readAllStandardOutput();
-        QByteArray errBa = process->readAllStandardError();
-        QString msg;
-        if (!outBa.isEmpty()) {
-            msg += QString::fromLocal8Bit(outBa);
-        }
+    disconnect(outputConn);
+    disconnect(finishConn);
 
-        if (!errBa.isEmpty()) {
-            msg += QString::fromLocal8Bit(errBa);
-        }
+    return rets;
+}
 
-        if (!msg.isEmpty()) {
-            emit outputLog(msg);
-        }
+void VExporter::setAskedToStop(bool p_askedToStop)
+{
+    m_askedToStop = p_askedToStop;
+    if (m_askedToStop) {
+        m_processRunner->killAll();
 
-        if (finished) {
-            QProcess::ExitStatus sta = process->exitStatus();
-            if (sta == QProcess::CrashExit) {
-                ret = -1;
-                break;
-            }
+        // Drop the pending pre-renders.
+        if (m_plantUMLHelper) {
+            VRenderScheduler::inst()->cancel(m_plantUMLHelper);
+        }
 
-            ret = process->exitCode();
-            break;
+        if (m_graphvizHelper) {
+            VRenderScheduler::inst()->cancel(m_graphvizHelper);
         }
 
-        QCoreApplication::processEvents();
+        delete m_plantUMLHelper;
+        m_plantUMLHelper = NULL;
 
-        if (m_askedToStop) {
-            process->kill();
-            ret = -1;
-            break;
-        }
+        delete m_graphvizHelper;
+        m_graphvizHelper = NULL;
     }
-
-    return ret;
 }
 
 int VExporter::startProcess(const QString &p_cmd)
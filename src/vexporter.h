@@ -6,12 +6,42 @@
 #include <QUrl>
 #include <QWebEngineDownloadItem>
 #include <QStringList>
+#include <QList>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QPair>
+#include <QSharedPointer>
+#include <QAtomicInt>
+#include <functional>
 
 #include "dialog/vexportdialog.h"
 
 class QWidget;
 class VWebView;
 class VDocument;
+class VProcessRunner;
+class QTemporaryDir;
+class VPlantUMLHelper;
+class VGraphvizHelper;
+
+// Result of rendering a note natively in the task executor.
+struct NativeRenderResult
+{
+    NativeRenderResult()
+        : m_finished(0),
+          m_canceled(0)
+    {
+    }
+
+    // Valid after @m_finished is set.
+    QString m_html;
+
+    QAtomicInt m_finished;
+
+    // Set when nobody waits for the result any more to skip the rendering.
+    QAtomicInt m_canceled;
+};
 
 class VExporter : public QObject
 {
@@ -19,6 +49,8 @@ class VExporter : public QObject
 public:
     explicit VExporter(QWidget *p_parent = nullptr);
 
+    ~VExporter();
+
     void prepareExport(const ExportOption &p_opt);
 
     bool exportPDF(VFile *p_file,
@@ -48,6 +80,43 @@ public:
 
     void setAskedToStop(bool p_askedToStop);
 
+    // Whether the PDF of @p_filePath is still being converted by wkhtmltopdf
+    // in background after exportPDF() returns.
+    bool isPDFPending(const QString &p_filePath) const;
+
+    bool hasPendingPDFs() const;
+
+    // Wait for the PDFs converted in background and report them in the order
+    // they are exported.
+    // @p_func: called with the source note, the output file and whether it succeeds.
+    // Returns the number of failed ones.
+    int collectPendingPDFs(const std::function<void(const QString &, const QString &, bool)> &p_func,
+                           QString *p_errMsg = NULL);
+
+    // Load notes of @p_files in web views, or render them natively, in advance
+    // for later export, bounded by the configured number of export web views.
+    // Notes are still exported one by one in order.
+    void prefetch(const QList<VFile *> &p_files, const ExportOption &p_opt);
+
+    // Discard all the notes loaded in advance.
+    void clearPrefetchedNotes();
+
+    // Start rendering the PlantUML and Graphviz blocks of notes @p_files in
+    // background into the render cache, so the pages of the notes could get
+    // them from the cache when exported.
+    // Returns the number of diagrams scheduled.
+    int prerenderDiagrams(const QList<QString> &p_files, const ExportOption &p_opt);
+
+    // Whether export of @p_opt goes through web views.
+    static bool isViaWebView(const ExportOption &p_opt);
+
+    // Extra formats of @p_opt output from the page of each note besides the
+    // main one.
+    static QVector<ExportOption::ExtraFormat> extraFormats(const ExportOption &p_opt);
+
+    // Output file of @p_format next to the main output @p_outputFile.
+    static QString extraOutputFile(const QString &p_outputFile, ExportOption::ExtraFormat p_format);
+
 signals:
     // Request to output log.
     void outputLog(const QString &p_log);
@@ -79,11 +148,71 @@ private:
         Failed = 0x4
     };
 
+    // A note loading in a web view, or rendering natively, in advance.
+    struct PrefetchedNote
+    {
+        PrefetchedNote()
+            : m_file(NULL),
+              m_openedByExporter(false),
+              m_webViewer(NULL),
+              m_webDocument(NULL),
+              m_noteState(NoteState::NotReady)
+        {
+        }
+
+        VFile *m_file;
+
+        // Whether @m_file is opened by the prefetch and should be closed after export.
+        bool m_openedByExporter;
+
+        // Not NULL if rendered natively.
+        QSharedPointer<NativeRenderResult> m_nativeResult;
+
+        // NULL if rendered natively.
+        VWebView *m_webViewer;
+
+        VDocument *m_webDocument;
+
+        QUrl m_baseUrl;
+
+        NoteState m_noteState;
+    };
 
     void initWebViewer(VFile *p_file, const ExportOption &p_opt);
 
+    // Create a web view loading @p_file.
+    void createWebViewer(VFile *p_file,
+                         const ExportOption &p_opt,
+                         VWebView *&p_webViewer,
+                         VDocument *&p_webDocument,
+                         QUrl &p_baseUrl);
+
     void clearWebViewer();
 
+    // Take the prefetched note of @p_file.
+    // Prefetched notes before it are useless and discarded.
+    bool takePrefetchedNote(VFile *p_file, PrefetchedNote &p_note);
+
+    void discardPrefetchedNote(const PrefetchedNote &p_note);
+
+    // Whether HTML of @p_opt could be rendered natively without a web view.
+    bool isNativeExport(const ExportOption &p_opt) const;
+
+    // Start rendering @p_file natively in the pool.
+    // Returns NULL if @p_file needs a web view.
+    QSharedPointer<NativeRenderResult> renderNatively(VFile *p_file, const ExportOption &p_opt);
+
+    bool exportViaNative(VFile *p_file,
+                         const QSharedPointer<NativeRenderResult> &p_result,
+                         const ExportOption &p_opt,
+                         const QString &p_outputFile);
+
+    // Read the style sheet of @p_url, with the relative url() turned into absolute.
+    static QString readStyleSheet(const QString &p_url);
+
+    // Note state of the web view or document @p_sender.
+    NoteState *findNoteState(QObject *p_sender);
+
     void clearNoteState();
 
     bool isNoteStateReady() const;
@@ -122,6 +251,21 @@ private:
                          const ExportPDFOption &p_opt,
                          QString *p_errMsg = NULL);
 
+    // Start converting @p_htmlFile to @p_filePath via wkhtmltopdf in background.
+    void queuePDFViaWK(const QString &p_srcFile,
+                       const QString &p_htmlFile,
+                       const QString &p_filePath,
+                       const ExportPDFOption &p_opt);
+
+    // Convert @p_htmlFiles in chunks of at most @p_chunkSize files concurrently
+    // and merge the partial PDFs via @p_mergeCmd.
+    bool htmlsToPDFViaWKInChunks(const QList<QString> &p_htmlFiles,
+                                 const QString &p_filePath,
+                                 const ExportPDFOption &p_opt,
+                                 int p_chunkSize,
+                                 const QString &p_mergeCmd,
+                                 QString *p_errMsg = NULL);
+
     bool convertFilesViaCustom(const QList<QString> &p_files,
                                const QString &p_filePath,
                                const ExportCustomOption &p_opt,
@@ -133,6 +277,13 @@ private:
 
     int startProcess(const QString &p_cmd);
 
+    // Run @p_cmds of program and arguments concurrently within the limit and
+    // wait for all of them, without blocking the event loop.
+    // Returns the result of each one like startProcess().
+    // @p_finishFunc: called with the index and result of each one once it finishes.
+    QVector<int> runProcesses(const QVector<QPair<QString, QStringList>> &p_cmds,
+                              const std::function<void(int, int)> &p_finishFunc = nullptr);
+
     // @p_embedImages: embed <img> as data URI.
     bool outputToHTMLFile(const QString &p_file,
                           const QString &p_title,
@@ -150,16 +301,25 @@ private:
 
     // Fix @p_html's resources like url("...") with "file" or "qrc" schema.
     // Embed the image data in data URIs.
-    static bool embedStyleResources(QString &p_html);
+    bool embedStyleResources(QString &p_html);
 
     // Fix @p_html's resources like <img>.
     // Copy the resource to @p_folder and fix the url string.
-    static bool fixBodyResources(const QUrl &p_baseUrl,
-                                 const QString &p_folder,
-                                 QString &p_html);
+    bool fixBodyResources(const QUrl &p_baseUrl,
+                          const QString &p_folder,
+                          QString &p_html);
 
     // Embed @p_html's resources like <img>.
-    static bool embedBodyResources(const QUrl &p_baseUrl, QString &p_html);
+    bool embedBodyResources(const QUrl &p_baseUrl, QString &p_html);
+
+    // Compute data URIs of @p_urls not in the cache, local ones in parallel.
+    void prepareDataURIs(const QList<QUrl> &p_urls, bool p_keepTitle);
+
+    // Copy the local <img> resources of @p_html not copied yet to @p_folder
+    // in one batch.
+    void prepareBodyResources(const QUrl &p_baseUrl,
+                              const QString &p_folder,
+                              const QString &p_html);
 
     static QString getResourceRelativePath(const QString &p_file);
 
@@ -180,6 +340,24 @@ private:
 
     NoteState m_noteState;
 
+    // Notes loading in advance, in order of export.
+    QList<PrefetchedNote> m_prefetchedNotes;
+
+    // Style of the HTML rendered natively.
+    QString m_nativeStyleContent;
+
+    // Data URIs of the resources in this export, shared by all the notes.
+    QHash<QString, QString> m_dataURIs;
+
+    // Resources copied in this export: folder and source URL -> target file.
+    QHash<QString, QString> m_copiedResources;
+
+    // Target files of @m_copiedResources.
+    QSet<QString> m_copiedTargets;
+
+    // Update the output of the last export in place.
+    bool m_incremental;
+
     ExportState m_state;
 
     // Download state used for MIME HTML.
@@ -189,6 +367,41 @@ private:
     QStringList m_wkArgs;
 
     bool m_askedToStop;
+
+    // Runner of wkhtmltopdf and custom commands.
+    VProcessRunner *m_processRunner;
+
+    // A PDF converted by wkhtmltopdf in background.
+    struct PendingPDF
+    {
+        // ID of the job of m_processRunner.
+        int m_id;
+
+        QString m_srcFile;
+
+        QString m_filePath;
+
+        QString m_cmd;
+    };
+
+    // Convert PDFs of notes via wkhtmltopdf concurrently.
+    bool m_concurrentPDF;
+
+    // In order of export.
+    QVector<PendingPDF> m_pendingPDFs;
+
+    // Job ID -> return of the finished jobs.
+    QHash<int, int> m_finishedJobs;
+
+    // Pre-render the diagrams. Pending renders are dropped once destroyed.
+    VPlantUMLHelper *m_plantUMLHelper;
+
+    VGraphvizHelper *m_graphvizHelper;
+
+    // Hold the HTML files of m_pendingPDFs.
+    QSharedPointer<QTemporaryDir> m_pdfTmpDir;
+
+    int m_numOfPDFHtmls;
 };
 
 inline void VExporter::clearNoteState()
@@ -205,9 +418,4 @@ inline bool VExporter::isNoteStateFailed() const
 {
     return m_noteState & NoteState::Failed;
 }
-
-inline void VExporter::setAskedToStop(bool p_askedToStop)
-{
-    m_askedToStop = p_askedToStop;
-}
 #endif // VEXPORTER_H
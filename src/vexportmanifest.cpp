@@ -0,0 +1,147 @@
+#include "vexportmanifest.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCryptographicHash>
+
+#include "utils/vutils.h"
+
+const QString VExportManifest::c_fileName = "vnote_export.json";
+
+#define ManifestOptionHash "option_hash"
+#define ManifestNotes "notes"
+#define ManifestSource "source"
+#define ManifestModifiedTime "modified_time"
+#define ManifestHash "hash"
+#define ManifestOutput "output"
+
+VExportManifest::VExportManifest()
+{
+}
+
+void VExportManifest::clear()
+{
+    m_folder.clear();
+    m_optionHash.clear();
+    m_entries.clear();
+}
+
+void VExportManifest::load(const QString &p_folder, const QByteArray &p_optionHash)
+{
+    clear();
+
+    m_folder = p_folder;
+    m_optionHash = p_optionHash;
+
+    QString filePath = QDir(m_folder).filePath(c_fileName);
+    if (!QFileInfo::exists(filePath)) {
+        return;
+    }
+
+    QJsonObject json = VUtils::readJsonFromDisk(filePath);
+    if (QByteArray::fromHex(json[ManifestOptionHash].toString().toLatin1()) != m_optionHash) {
+        qDebug() << "export options changed, discard the manifest" << filePath;
+        return;
+    }
+
+    QJsonArray notes = json[ManifestNotes].toArray();
+    for (int i = 0; i < notes.size(); ++i) {
+        QJsonObject obj = notes[i].toObject();
+        Entry entry;
+        entry.m_modifiedTime = (qint64)obj[ManifestModifiedTime].toDouble();
+        entry.m_hash = QByteArray::fromHex(obj[ManifestHash].toString().toLatin1());
+        entry.m_outputFile = obj[ManifestOutput].toString();
+        m_entries.insert(obj[ManifestSource].toString(), entry);
+    }
+}
+
+bool VExportManifest::save() const
+{
+    if (m_folder.isEmpty()) {
+        return false;
+    }
+
+    QJsonArray notes;
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        QJsonObject obj;
+        obj[ManifestSource] = it.key();
+        obj[ManifestModifiedTime] = (double)it.value().m_modifiedTime;
+        obj[ManifestHash] = QString::fromLatin1(it.value().m_hash.toHex());
+        obj[ManifestOutput] = it.value().m_outputFile;
+        notes.append(obj);
+    }
+
+    QJsonObject json;
+    json[ManifestOptionHash] = QString::fromLatin1(m_optionHash.toHex());
+    json[ManifestNotes] = notes;
+
+    return VUtils::writeJsonToDisk(QDir(m_folder).filePath(c_fileName), json);
+}
+
+QByteArray VExportManifest::fileHash(const QString &p_file)
+{
+    QFile file(p_file);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(&file);
+    return hash.result();
+}
+
+bool VExportManifest::isUnchanged(const QString &p_srcFile, QString &p_outputFile)
+{
+    auto it = m_entries.find(p_srcFile);
+    if (it == m_entries.end()) {
+        return false;
+    }
+
+    Entry &entry = it.value();
+    QString outputFile = QDir(m_folder).filePath(entry.m_outputFile);
+    if (!QFileInfo::exists(outputFile)) {
+        return false;
+    }
+
+    qint64 modifiedTime = QFileInfo(p_srcFile).lastModified().toMSecsSinceEpoch();
+    if (modifiedTime != entry.m_modifiedTime) {
+        // Touched only.
+        QByteArray hash = fileHash(p_srcFile);
+        if (hash.isEmpty() || hash != entry.m_hash) {
+            return false;
+        }
+
+        entry.m_modifiedTime = modifiedTime;
+    }
+
+    p_outputFile = outputFile;
+    return true;
+}
+
+QString VExportManifest::outputFile(const QString &p_srcFile) const
+{
+    auto it = m_entries.find(p_srcFile);
+    if (it == m_entries.end()) {
+        return QString();
+    }
+
+    return QDir(m_folder).filePath(it.value().m_outputFile);
+}
+
+void VExportManifest::update(const QString &p_srcFile, const QString &p_outputFile)
+{
+    if (m_folder.isEmpty()) {
+        return;
+    }
+
+    Entry entry;
+    entry.m_modifiedTime = QFileInfo(p_srcFile).lastModified().toMSecsSinceEpoch();
+    entry.m_hash = fileHash(p_srcFile);
+    entry.m_outputFile = QDir(m_folder).relativeFilePath(p_outputFile);
+    m_entries.insert(p_srcFile, entry);
+}
@@ -0,0 +1,64 @@
+#ifndef VEXPORTMANIFEST_H
+#define VEXPORTMANIFEST_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+
+// Record of the notes exported to an output folder, saved in the folder to
+// skip notes unchanged since the last export.
+class VExportManifest
+{
+public:
+    VExportManifest();
+
+    // Load the manifest of @p_folder exported with options of @p_optionHash.
+    // Entries exported with other options are discarded.
+    void load(const QString &p_folder, const QByteArray &p_optionHash);
+
+    bool save() const;
+
+    void clear();
+
+    // Whether @p_srcFile is unchanged since it was exported to an output file
+    // which still exists.
+    // @p_outputFile: the output file of the last export.
+    bool isUnchanged(const QString &p_srcFile, QString &p_outputFile);
+
+    // Output file of the last export of @p_srcFile, or empty if not recorded.
+    QString outputFile(const QString &p_srcFile) const;
+
+    // Record that @p_srcFile is exported to @p_outputFile.
+    void update(const QString &p_srcFile, const QString &p_outputFile);
+
+    // Name of the file of the manifest in the output folder.
+    static const QString c_fileName;
+
+private:
+    struct Entry
+    {
+        Entry()
+            : m_modifiedTime(0)
+        {
+        }
+
+        qint64 m_modifiedTime;
+
+        // SHA-1 of the content of the source file.
+        QByteArray m_hash;
+
+        // Relative to the output folder.
+        QString m_outputFile;
+    };
+
+    static QByteArray fileHash(const QString &p_file);
+
+    QString m_folder;
+
+    QByteArray m_optionHash;
+
+    // Source file -> entry.
+    QHash<QString, Entry> m_entries;
+};
+
+#endif // VEXPORTMANIFEST_H
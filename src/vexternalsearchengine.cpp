@@ -0,0 +1,395 @@
+#include "vexternalsearchengine.h"
+
+#include <QDebug>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "vsearchengine.h"
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Tool to find in PATH if not configured.
+#define DEFAULT_SEARCH_TOOL "rg"
+
+// Max length of the files passed to one run of the tool, within the limit of
+// the command line on all platforms.
+#define MAX_CHUNK_LENGTH 16000
+
+// Exit code of ripgrep on error. 1 means no match.
+#define TOOL_ERROR_EXIT_CODE 2
+
+// Text of an object of ripgrep, which is base64 encoded if invalid UTF-8.
+static QByteArray jsonData(const QJsonObject &p_obj)
+{
+    QJsonValue text = p_obj.value("text");
+    if (text.isString()) {
+        return text.toString().toUtf8();
+    }
+
+    return QByteArray::fromBase64(p_obj.value("bytes").toString().toLatin1());
+}
+
+VExternalSearchEngine::VExternalSearchEngine(QObject *p_parent)
+    : ISearchEngine(p_parent),
+      m_chunkIdx(0),
+      m_process(NULL),
+      m_summaryReceived(false),
+      m_stopped(false),
+      m_nrMatchedTokens(0),
+      m_scanEngine(NULL)
+{
+}
+
+VExternalSearchEngine::~VExternalSearchEngine()
+{
+    clear();
+}
+
+QString VExternalSearchEngine::findTool()
+{
+    QString program = g_config->getExternalSearchTool();
+    if (program.isEmpty()) {
+        program = DEFAULT_SEARCH_TOOL;
+    }
+
+    if (QFileInfo(program).isAbsolute()) {
+        return QFileInfo(program).isExecutable() ? program : QString();
+    }
+
+    return QStandardPaths::findExecutable(program);
+}
+
+QStringList VExternalSearchEngine::toolArguments(const VSearchToken &p_token)
+{
+    QStringList args;
+    args << "--json" << "--no-config";
+    args << (p_token.m_caseSensitivity == Qt::CaseSensitive ? "--case-sensitive"
+                                                            : "--ignore-case");
+
+    // Lines matching any token are reported. And is checked for each file.
+    if (p_token.m_type == VSearchToken::RawString) {
+        args << "--fixed-strings";
+        for (auto const & keyword : p_token.m_keywords) {
+            args << "-e" << keyword;
+        }
+    } else {
+        for (auto const & reg : p_token.m_regs) {
+            args << "-e" << reg.pattern();
+        }
+    }
+
+    args << "--";
+    return args;
+}
+
+void VExternalSearchEngine::search(const QSharedPointer<VSearchConfig> &p_config,
+                                   const QSharedPointer<VSearchResult> &p_result)
+{
+    m_config = p_config;
+    m_result = p_result;
+    m_stopped = false;
+
+    const QStringList &items = m_result->m_secondPhaseItems;
+    Q_ASSERT(!items.isEmpty());
+
+    const VSearchToken &token = m_config->m_contentToken;
+    m_program = findTool();
+    if (m_program.isEmpty() || token.isEmpty()) {
+        qDebug() << "external search tool is not available, fall back to scan";
+        scan(items);
+        return;
+    }
+
+    m_args = toolArguments(token);
+    splitChunks(items);
+    m_chunkIdx = -1;
+    if (!startNextChunk()) {
+        finish(VSearchState::Success);
+    }
+}
+
+void VExternalSearchEngine::splitChunks(const QStringList &p_files)
+{
+    m_chunks.clear();
+
+    QStringList chunk;
+    int len = 0;
+    for (auto const & file : p_files) {
+        if (!chunk.isEmpty() && len + file.size() > MAX_CHUNK_LENGTH) {
+            m_chunks.append(chunk);
+            chunk.clear();
+            len = 0;
+        }
+
+        chunk.append(file);
+        len += file.size() + 1;
+    }
+
+    if (!chunk.isEmpty()) {
+        m_chunks.append(chunk);
+    }
+}
+
+bool VExternalSearchEngine::startNextChunk()
+{
+    clearProcess();
+
+    if (++m_chunkIdx >= m_chunks.size()) {
+        return false;
+    }
+
+    m_stdout.clear();
+    m_summaryReceived = false;
+
+    m_process = new QProcess(this);
+    connect(m_process, &QProcess::readyReadStandardOutput,
+            this, &VExternalSearchEngine::handleReadyReadStandardOutput);
+    connect(m_process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+            this, &VExternalSearchEngine::handleProcessFinished);
+
+    m_process->start(m_program, m_args + m_chunks[m_chunkIdx]);
+    if (!m_process->waitForStarted()) {
+        qWarning() << "fail to start external search tool" << m_program << m_process->errorString();
+
+        QStringList files;
+        for (int i = m_chunkIdx; i < m_chunks.size(); ++i) {
+            files.append(m_chunks[i]);
+        }
+
+        m_chunks.clear();
+        scan(files);
+    }
+
+    return true;
+}
+
+void VExternalSearchEngine::handleReadyReadStandardOutput()
+{
+    m_stdout += m_process->readAllStandardOutput();
+
+    int start = 0;
+    int idx = -1;
+    while ((idx = m_stdout.indexOf('\n', start)) != -1) {
+        handleOutputLine(m_stdout.mid(start, idx - start));
+        start = idx + 1;
+    }
+
+    m_stdout.remove(0, start);
+
+    // Post the files done so far to show results as soon as possible.
+    postItems();
+}
+
+void VExternalSearchEngine::handleOutputLine(const QByteArray &p_line)
+{
+    if (m_stopped) {
+        return;
+    }
+
+    QJsonObject obj = QJsonDocument::fromJson(p_line).object();
+    QString type = obj.value("type").toString();
+    QJsonObject data = obj.value("data").toObject();
+    if (type == "match") {
+        handleMatch(data);
+    } else if (type == "end") {
+        endFile();
+    } else if (type == "summary") {
+        m_summaryReceived = true;
+        QJsonObject stats = data.value("stats").toObject();
+        m_result->m_nrSearchedFiles += stats.value("searches").toInt();
+    }
+}
+
+void VExternalSearchEngine::handleMatch(const QJsonObject &p_data)
+{
+    QString path = QString::fromUtf8(jsonData(p_data.value("path").toObject()));
+    if (path.isEmpty()) {
+        return;
+    }
+
+    const VSearchToken &token = m_config->m_contentToken;
+    if (!m_item || m_item->m_path != path) {
+        endFile();
+
+        m_item.reset(new VSearchResultItem(VSearchResultItem::Note,
+                                           VSearchResultItem::LineNumber,
+                                           VUtils::fileNameFromPath(path),
+                                           path,
+                                           m_config));
+
+        m_nrMatchedTokens = 0;
+        if (token.m_op == VSearchToken::And && token.tokenSize() > 1) {
+            m_matchedTokens.fill(false, token.tokenSize());
+        } else {
+            m_matchedTokens.clear();
+        }
+    }
+
+    QByteArray line = jsonData(p_data.value("lines").toObject());
+    while (line.endsWith('\n') || line.endsWith('\r')) {
+        line.chop(1);
+    }
+
+    QString text = QString::fromUtf8(line);
+
+    // Offsets of submatches are in bytes.
+    int matchPos = 0;
+    QJsonArray submatches = p_data.value("submatches").toArray();
+    if (!submatches.isEmpty() && text.size() > SEARCH_CONTEXT_SIZE) {
+        int start = submatches[0].toObject().value("start").toInt();
+        matchPos = QString::fromUtf8(line.constData(), qMin(start, line.size())).size();
+    }
+
+    VSearchResultSubItem sitem(p_data.value("line_number").toInt(), QString());
+    sitem.setContext(text, matchPos);
+    sitem.m_offset = (qint64)p_data.value("absolute_offset").toDouble();
+    sitem.m_length = line.size();
+    m_item->m_matches.append(sitem);
+
+    for (int i = 0; i < m_matchedTokens.size(); ++i) {
+        if (!m_matchedTokens[i] && token.matchOne(i, text)) {
+            m_matchedTokens[i] = true;
+            ++m_nrMatchedTokens;
+        }
+    }
+}
+
+void VExternalSearchEngine::endFile()
+{
+    if (!m_item) {
+        return;
+    }
+
+    if (m_nrMatchedTokens == m_matchedTokens.size()) {
+        m_items.append(m_item);
+    }
+
+    m_item.clear();
+    m_matchedTokens.clear();
+    m_nrMatchedTokens = 0;
+
+    if (m_items.size() >= BATCH_ITEM_SIZE) {
+        postItems();
+    }
+}
+
+void VExternalSearchEngine::postItems()
+{
+    if (!m_items.isEmpty()) {
+        emit resultItemsAdded(m_items);
+        m_items.clear();
+    }
+}
+
+void VExternalSearchEngine::handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+{
+    handleReadyReadStandardOutput();
+    endFile();
+
+    if (m_stopped) {
+        clearProcess();
+        finish(VSearchState::Cancelled);
+        return;
+    }
+
+    if (p_exitStatus != QProcess::NormalExit
+        || (p_exitCode == TOOL_ERROR_EXIT_CODE && !m_summaryReceived)) {
+        // Maybe the tool does not understand the pattern.
+        qWarning() << "external search tool failed" << p_exitCode
+                   << m_process->readAllStandardError();
+
+        QStringList files;
+        for (int i = m_chunkIdx; i < m_chunks.size(); ++i) {
+            files.append(m_chunks[i]);
+        }
+
+        clearProcess();
+        m_chunks.clear();
+        postItems();
+        scan(files);
+        return;
+    }
+
+    if (!startNextChunk()) {
+        finish(VSearchState::Success);
+    }
+}
+
+void VExternalSearchEngine::finish(VSearchState p_state)
+{
+    postItems();
+
+    m_result->m_state = p_state;
+    qDebug() << "ExternalSearchEngine finished" << (int)p_state;
+    emit finished(m_result);
+}
+
+void VExternalSearchEngine::scan(const QStringList &p_files)
+{
+    if (!m_scanEngine) {
+        m_scanEngine = new VSearchEngine(this);
+        connect(m_scanEngine, &ISearchEngine::finished,
+                this, &ISearchEngine::finished);
+        connect(m_scanEngine, &ISearchEngine::resultItemsAdded,
+                this, &ISearchEngine::resultItemsAdded);
+    }
+
+    m_result->m_secondPhaseItems = p_files;
+    m_scanEngine->search(m_config, m_result);
+}
+
+void VExternalSearchEngine::stop()
+{
+    qDebug() << "VExternalSearchEngine asked to stop";
+    m_stopped = true;
+
+    // handleProcessFinished() will finish the search.
+    if (m_process && m_process->state() != QProcess::NotRunning) {
+        m_process->kill();
+    }
+
+    if (m_scanEngine) {
+        m_scanEngine->stop();
+    }
+}
+
+void VExternalSearchEngine::clear()
+{
+    clearProcess();
+
+    if (m_scanEngine) {
+        m_scanEngine->clear();
+    }
+
+    m_chunks.clear();
+    m_chunkIdx = 0;
+    m_stdout.clear();
+    m_item.clear();
+    m_matchedTokens.clear();
+    m_nrMatchedTokens = 0;
+    m_items.clear();
+
+    m_config.clear();
+    m_result.clear();
+}
+
+void VExternalSearchEngine::clearProcess()
+{
+    if (!m_process) {
+        return;
+    }
+
+    m_process->disconnect(this);
+    if (m_process->state() != QProcess::NotRunning) {
+        m_process->kill();
+        m_process->waitForFinished(1000);
+    }
+
+    m_process->deleteLater();
+    m_process = NULL;
+}
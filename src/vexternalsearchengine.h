@@ -0,0 +1,104 @@
+#ifndef VEXTERNALSEARCHENGINE_H
+#define VEXTERNALSEARCHENGINE_H
+
+#include "isearchengine.h"
+
+#include <QProcess>
+#include <QVector>
+#include <QByteArray>
+
+#include "vsearchconfig.h"
+
+class VSearchEngine;
+class QJsonObject;
+
+// Search engine delegating content search to an external grep tool speaking
+// the JSON output of ripgrep. The files are passed to the tool in chunks and
+// its output is parsed into result items as it is printed.
+// Falls back to VSearchEngine if the tool is missing, fails, or could not
+// understand the token.
+class VExternalSearchEngine : public ISearchEngine
+{
+    Q_OBJECT
+public:
+    explicit VExternalSearchEngine(QObject *p_parent = nullptr);
+
+    ~VExternalSearchEngine();
+
+    void search(const QSharedPointer<VSearchConfig> &p_config,
+                const QSharedPointer<VSearchResult> &p_result) Q_DECL_OVERRIDE;
+
+    void stop() Q_DECL_OVERRIDE;
+
+    void clear() Q_DECL_OVERRIDE;
+
+    // Program of the configured tool, or empty if it could not be found.
+    static QString findTool();
+
+private slots:
+    void handleReadyReadStandardOutput();
+
+    void handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
+
+private:
+    // Arguments before the files to search.
+    static QStringList toolArguments(const VSearchToken &p_token);
+
+    // Split @p_files into chunks within the limit of the command line.
+    void splitChunks(const QStringList &p_files);
+
+    // Start the tool on next chunk. Return false if there is no more chunk.
+    bool startNextChunk();
+
+    void handleOutputLine(const QByteArray &p_line);
+
+    void handleMatch(const QJsonObject &p_data);
+
+    // Finish the item of current file.
+    void endFile();
+
+    void postItems();
+
+    void finish(VSearchState p_state);
+
+    // Search @p_files by VSearchEngine.
+    void scan(const QStringList &p_files);
+
+    void clearProcess();
+
+    QSharedPointer<VSearchConfig> m_config;
+
+    QString m_program;
+
+    QStringList m_args;
+
+    QVector<QStringList> m_chunks;
+
+    // Index of the chunk being searched.
+    int m_chunkIdx;
+
+    QProcess *m_process;
+
+    // Output not ending with a new line yet.
+    QByteArray m_stdout;
+
+    // Whether the tool printed its summary, which means it did search.
+    bool m_summaryReceived;
+
+    bool m_stopped;
+
+    // Item of the file whose matches are being received.
+    QSharedPointer<VSearchResultItem> m_item;
+
+    // Valid for And of multiple tokens. Whether token i is matched in the file.
+    // The tool reports lines matching any of the tokens.
+    QVector<bool> m_matchedTokens;
+
+    int m_nrMatchedTokens;
+
+    QList<QSharedPointer<VSearchResultItem> > m_items;
+
+    VSearchEngine *m_scanEngine;
+};
+
+#endif // VEXTERNALSEARCHENGINE_H
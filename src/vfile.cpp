@@ -8,11 +8,15 @@
 #include <QTextStream>
 #include "utils/vutils.h"
 #include "vconfigmanager.h"
+#include "vsaveservice.h"
+#include "vnoteprefetcher.h"
 
 extern VConfigManager *g_config;
 
 const QString VFile::c_backupFileHeadMagic = "vnote_backup_file_826537664";
 
+const QString VFile::c_backupJournalMagic = "vnote_backup_journal";
+
 VFile::VFile(QObject *p_parent,
              const QString &p_name,
              FileType p_type,
@@ -26,7 +30,10 @@ VFile::VFile(QObject *p_parent,
       m_type(p_type),
       m_modifiable(p_modifiable),
       m_createdTimeUtc(p_createdTimeUtc),
-      m_modifiedTimeUtc(p_modifiedTimeUtc)
+      m_modifiedTimeUtc(p_modifiedTimeUtc),
+      m_largeFile(false),
+      m_contentReleased(false),
+      m_saveId(-1)
 {
 }
 
@@ -49,12 +56,82 @@ bool VFile::open()
         return false;
     }
 
-    m_content = VUtils::readFileFromDisk(filePath);
-    m_lastModified = QFileInfo(filePath).lastModified();
+    QFileInfo fi(filePath);
+    m_lastModified = fi.lastModified();
+    if (VNotePrefetcher::inst()->takeContent(filePath, m_lastModified, fi.size(), m_content)) {
+        // Prefetched notes are never large files.
+        m_contentReleased = false;
+        m_largeFile = false;
+    } else {
+        m_content = readContent(filePath);
+    }
+
     m_opened = true;
     return true;
 }
 
+QString VFile::readContent(const QString &p_filePath)
+{
+    m_contentReleased = false;
+
+    qint64 threshold = g_config->getLargeFileSize();
+    m_largeFile = threshold > 0 && QFileInfo(p_filePath).size() >= threshold;
+    if (m_largeFile) {
+        return readLargeFile(p_filePath);
+    }
+
+    return VUtils::readFileFromDisk(p_filePath);
+}
+
+QString VFile::readLargeFile(const QString &p_filePath)
+{
+    QFile file(p_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "fail to open file" << p_filePath << "to read";
+        return QString();
+    }
+
+    // Decode from the mapped pages directly instead of a copy of the bytes.
+    qint64 size = file.size();
+    uchar *data = size > 0 ? file.map(0, size) : NULL;
+    if (!data) {
+        // Fall back to a normal read.
+        file.close();
+        return VUtils::readFileFromDisk(p_filePath);
+    }
+
+    QString content = QString::fromUtf8(reinterpret_cast<const char *>(data), size);
+    file.unmap(data);
+
+    // Mapping bypasses the text mode of readFileFromDisk().
+    if (content.contains(QLatin1Char('\r'))) {
+        content.replace(QStringLiteral("\r\n"), QStringLiteral("\n"));
+    }
+
+    qDebug() << "read large file content:" << p_filePath << size;
+    return content;
+}
+
+void VFile::releaseContent()
+{
+    if (!m_opened || !m_largeFile || m_contentReleased) {
+        return;
+    }
+
+    m_content.clear();
+    m_content.squeeze();
+    m_contentReleased = true;
+}
+
+void VFile::loadReleasedContent() const
+{
+    Q_ASSERT(m_contentReleased);
+    m_contentReleased = false;
+
+    // The file on disk is what m_content held when released.
+    m_content = readLargeFile(fetchPath());
+}
+
 void VFile::close()
 {
     if (!m_opened) {
@@ -62,6 +139,8 @@ void VFile::close()
     }
 
     m_content.clear();
+    m_contentReleased = false;
+    m_largeFile = false;
     if (!m_backupName.isEmpty()) {
         VUtils::deleteFile(fetchBackupFilePath());
         m_backupName.clear();
@@ -75,15 +154,65 @@ bool VFile::save()
     Q_ASSERT(m_opened);
     Q_ASSERT(m_modifiable);
 
-    bool ret = VUtils::writeFileToDisk(fetchPath(), m_content);
+    // Do not let a pending asynchronous save overwrite this one.
+    if (m_saveId != -1) {
+        VSaveService::inst()->waitForDone();
+        disconnect(VSaveService::inst(), &VSaveService::saved,
+                   this, &VFile::handleSaveServiceSaved);
+        m_saveId = -1;
+        m_savingContent.clear();
+    }
+
+    const QString &content = getContent();
+    bool ret = VUtils::writeFileToDisk(fetchPath(), content);
     if (ret) {
-        m_lastModified = QFileInfo(fetchPath()).lastModified();
-        m_modifiedTimeUtc = QDateTime::currentDateTimeUtc();
+        ret = handleSaved(content);
     }
 
     return ret;
 }
 
+void VFile::saveAsync()
+{
+    Q_ASSERT(m_opened);
+    Q_ASSERT(m_modifiable);
+
+    VSaveService *service = VSaveService::inst();
+    connect(service, &VSaveService::saved,
+            this, &VFile::handleSaveServiceSaved,
+            Qt::UniqueConnection);
+    m_savingContent = getContent();
+    m_saveId = service->save(fetchPath(), m_savingContent);
+}
+
+void VFile::handleSaveServiceSaved(int p_id, const QString &p_file, bool p_succeeded)
+{
+    Q_UNUSED(p_file);
+    if (p_id != m_saveId) {
+        return;
+    }
+
+    m_saveId = -1;
+    disconnect(VSaveService::inst(), &VSaveService::saved,
+               this, &VFile::handleSaveServiceSaved);
+
+    if (p_succeeded) {
+        p_succeeded = handleSaved(m_savingContent);
+    }
+
+    m_savingContent.clear();
+    emit saveCompleted(p_succeeded);
+}
+
+bool VFile::handleSaved(const QString &p_content)
+{
+    Q_UNUSED(p_content);
+    m_lastModified = QFileInfo(fetchPath()).lastModified();
+    m_modifiedTimeUtc = QDateTime::currentDateTimeUtc();
+    m_modifiedTimeIso.clear();
+    return true;
+}
+
 QUrl VFile::getBaseUrl() const
 {
     // Need to judge the path: Url, local file, resource file.
@@ -114,6 +243,11 @@ bool VFile::isInternalImageFolder(const QString &p_path) const
            || VUtils::equalPath(p_path, fetchImageFolderPath());
 }
 
+bool VFile::useContentAddressedImages() const
+{
+    return false;
+}
+
 bool VFile::isChangedOutside(bool &p_missing) const
 {
     QFileInfo fi(fetchPath());
@@ -123,8 +257,12 @@ bool VFile::isChangedOutside(bool &p_missing) const
     }
 
     p_missing = false;
-    QDateTime lm = QFileInfo(fetchPath()).lastModified();
-    return lm.toSecsSinceEpoch() != m_lastModified.toSecsSinceEpoch();
+    return isChangedOutside(fi.lastModified());
+}
+
+bool VFile::isChangedOutside(const QDateTime &p_lastModified) const
+{
+    return p_lastModified.toSecsSinceEpoch() != m_lastModified.toSecsSinceEpoch();
 }
 
 bool VFile::reload()
@@ -136,10 +274,11 @@ bool VFile::reload()
     QString filePath = fetchPath();
     if (!QFileInfo::exists(filePath)) {
         m_content.clear();
+        m_contentReleased = false;
         return false;
     }
 
-    m_content = VUtils::readFileFromDisk(filePath);
+    m_content = readContent(filePath);
     m_lastModified = QFileInfo(filePath).lastModified();
     return true;
 }
@@ -217,13 +356,81 @@ QString VFile::fetchBackupFileHead() const
 
 bool VFile::writeBackupFile(const QString &p_content)
 {
+    // The snapshot is followed by deltas appended via appendBackupDelta().
+    QString head = QString("%1 %2").arg(c_backupJournalMagic).arg(p_content.size());
     return VUtils::writeFileToDisk(fetchBackupFilePath(),
-                                   fetchBackupFileHead() + "\n" + p_content);
+                                   fetchBackupFileHead() + "\n" + head + "\n" + p_content);
+}
+
+bool VFile::appendBackupDelta(int p_position, int p_charsRemoved, const QString &p_text)
+{
+    QString filePath = fetchBackupFilePath();
+    if (!QFileInfo::exists(filePath)) {
+        // No snapshot to apply to. The file may have been moved.
+        return false;
+    }
+
+    QFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) {
+        qWarning() << "fail to open file" << filePath << "to append";
+        return false;
+    }
+
+    QTextStream stream(&file);
+    stream << QString("\n%1 %2 %3\n").arg(p_position).arg(p_charsRemoved).arg(p_text.size())
+           << p_text;
+    stream.flush();
+    return stream.status() == QTextStream::Ok;
 }
 
 QString VFile::readBackupFile(const QString &p_file)
 {
     const QString content = VUtils::readFileFromDisk(p_file);
-    int idx = content.indexOf("\n");
-    return content.mid(idx + 1);
+    int idx = content.indexOf("\n") + 1;
+    int lineEnd = content.indexOf("\n", idx);
+    if (lineEnd == -1) {
+        return content.mid(idx);
+    }
+
+    QStringList head = content.mid(idx, lineEnd - idx).split(' ');
+    bool ok = false;
+    int size = head.size() == 2 && head[0] == c_backupJournalMagic ? head[1].toInt(&ok) : -1;
+    if (!ok || size < 0) {
+        // Plain backup file without journal.
+        return content.mid(idx);
+    }
+
+    idx = lineEnd + 1;
+    QString text = content.mid(idx, size);
+    idx += size;
+
+    // Replay the deltas. Stop at an incomplete one, which was being written.
+    while (idx < content.size() && content[idx] == '\n') {
+        lineEnd = content.indexOf("\n", idx + 1);
+        if (lineEnd == -1) {
+            break;
+        }
+
+        QStringList nums = content.mid(idx + 1, lineEnd - idx - 1).split(' ');
+        if (nums.size() != 3) {
+            break;
+        }
+
+        bool ok1 = false, ok2 = false, ok3 = false;
+        int pos = nums[0].toInt(&ok1);
+        int removed = nums[1].toInt(&ok2);
+        int len = nums[2].toInt(&ok3);
+        if (!ok1 || !ok2 || !ok3
+            || pos < 0 || pos > text.size()
+            || removed < 0 || len < 0
+            || lineEnd + 1 + len > content.size()) {
+            qWarning() << "incomplete delta in backup file" << p_file;
+            break;
+        }
+
+        text.replace(pos, qMin(removed, text.size() - pos), content.mid(lineEnd + 1, len));
+        idx = lineEnd + 1 + len;
+    }
+
+    return text;
 }
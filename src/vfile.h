@@ -32,6 +32,10 @@ public:
     // Save m_content to the file.
     virtual bool save();
 
+    // Save m_content to the file on the worker of VSaveService.
+    // saveCompleted() will be emitted when the latest request completes.
+    void saveAsync();
+
     // Reload content from disk.
     virtual bool reload();
 
@@ -49,6 +53,14 @@ public:
 
     void setContent(const QString &p_content);
 
+    // Whether the file is opened in large file mode, in which the editor
+    // loads it progressively and skips the expensive features.
+    bool isLargeFile() const;
+
+    // Drop m_content of a large file once the editor holds the document.
+    // It will be read from disk again on demand.
+    void releaseContent();
+
     // Get the absolute full path of the file.
     virtual QString fetchPath() const = 0;
 
@@ -72,6 +84,9 @@ public:
     // Return the image folder part in an image link.
     virtual QString getImageFolderInLink() const = 0;
 
+    // Whether images are named by their content and may be shared by notes.
+    virtual bool useContentAddressedImages() const;
+
     QDateTime getCreatedTimeUtc() const;
 
     QDateTime getModifiedTimeUtc() const;
@@ -79,15 +94,31 @@ public:
     // Whether this file was changed outside VNote.
     bool isChangedOutside(bool &p_missing) const;
 
+    // Whether the file on disk with last modified time @p_lastModified differs
+    // from the one loaded.
+    bool isChangedOutside(const QDateTime &p_lastModified) const;
+
     // Return backup file of previous session if there exists one.
     QString backupFileOfPreviousSession() const;
 
-    // Write @p_content to backup file.
+    // Write @p_content to backup file as a new snapshot of the journal.
     bool writeBackupFile(const QString &p_content);
 
+    // Append a delta replacing @p_charsRemoved characters at @p_position with
+    // @p_text to the journal of the backup file.
+    // Returns false if a snapshot should be written via writeBackupFile().
+    bool appendBackupDelta(int p_position, int p_charsRemoved, const QString &p_text);
+
+    // Read the content of backup file @p_file, replaying the journal if any.
     QString readBackupFile(const QString &p_file);
 
+signals:
+    void saveCompleted(bool p_succeeded);
+
 protected:
+    // Update the info after @p_content is written to the file.
+    virtual bool handleSaved(const QString &p_content);
+
     // Name of this file.
     QString m_name;
 
@@ -98,7 +129,8 @@ protected:
     DocType m_docType;
 
     // Content of this file.
-    QString m_content;
+    // May be released and read lazily for a large file.
+    mutable QString m_content;
 
     // FileType of this file: Note, Orphan.
     FileType m_type;
@@ -107,10 +139,16 @@ protected:
     bool m_modifiable;
 
     // UTC time when creating this file.
-    QDateTime m_createdTimeUtc;
+    mutable QDateTime m_createdTimeUtc;
 
     // UTC time of last modification to this file in VNote.
-    QDateTime m_modifiedTimeUtc;
+    mutable QDateTime m_modifiedTimeUtc;
+
+    // Times in ISO format read from the config and not decoded yet.
+    // Decoded into m_createdTimeUtc and m_modifiedTimeUtc on first access.
+    mutable QString m_createdTimeIso;
+
+    mutable QString m_modifiedTimeIso;
 
     // Last modified date and local time when the file is last modified
     // corresponding to m_content.
@@ -122,7 +160,30 @@ protected:
     // Used to identify file path change.
     QString m_lastBackupFilePath;
 
+    // Whether the file size exceeds the large file threshold when opened.
+    bool m_largeFile;
+
+    // Whether m_content has been released by releaseContent().
+    mutable bool m_contentReleased;
+
+    // ID of the latest request of saveAsync(), or -1.
+    int m_saveId;
+
+    // Content being written by saveAsync(), which may outlive m_content.
+    QString m_savingContent;
+
+private slots:
+    void handleSaveServiceSaved(int p_id, const QString &p_file, bool p_succeeded);
+
 private:
+    // Read the content of @p_filePath and update m_largeFile.
+    QString readContent(const QString &p_filePath);
+
+    // Read the content of a large file via memory mapping.
+    static QString readLargeFile(const QString &p_filePath);
+
+    void loadReleasedContent() const;
+
     // Fetch backup file path.
     QString fetchBackupFilePath();
 
@@ -134,6 +195,8 @@ private:
     QString fetchBackupFileHead() const;
 
     static const QString c_backupFileHeadMagic;
+
+    static const QString c_backupJournalMagic;
 };
 
 inline const QString &VFile::getName() const
@@ -163,21 +226,41 @@ inline FileType VFile::getType() const
 
 inline const QString &VFile::getContent() const
 {
+    if (m_contentReleased) {
+        loadReleasedContent();
+    }
+
     return m_content;
 }
 
 inline void VFile::setContent(const QString &p_content)
 {
     m_content = p_content;
+    m_contentReleased = false;
+}
+
+inline bool VFile::isLargeFile() const
+{
+    return m_largeFile;
 }
 
 inline QDateTime VFile::getCreatedTimeUtc() const
 {
+    if (!m_createdTimeIso.isNull()) {
+        m_createdTimeUtc = QDateTime::fromString(m_createdTimeIso, Qt::ISODate);
+        m_createdTimeIso.clear();
+    }
+
     return m_createdTimeUtc;
 }
 
 inline QDateTime VFile::getModifiedTimeUtc() const
 {
+    if (!m_modifiedTimeIso.isNull()) {
+        m_modifiedTimeUtc = QDateTime::fromString(m_modifiedTimeIso, Qt::ISODate);
+        m_modifiedTimeIso.clear();
+    }
+
     return m_modifiedTimeUtc;
 }
 
@@ -0,0 +1,138 @@
+#include "vfilechangechecker.h"
+
+#include <QRunnable>
+#include <QCoreApplication>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+
+#include "vnotebookwatcher.h"
+#include "utils/vutils.h"
+
+// Look up the last modified time of one file in the pool.
+class FileStatTask : public QRunnable
+{
+public:
+    FileStatTask(VFileChangeChecker *p_checker, const QString &p_file)
+        : m_checker(p_checker),
+          m_file(p_file)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        QFileInfo info(m_file);
+        qint64 lastModified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : -1;
+
+        // The checker waits for all the tasks before destruction.
+        QMetaObject::invokeMethod(m_checker,
+                                  "handleFileStated",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(QString, m_file),
+                                  Q_ARG(qint64, lastModified));
+    }
+
+private:
+    VFileChangeChecker *m_checker;
+
+    QString m_file;
+};
+
+
+VFileChangeChecker::VFileChangeChecker(QObject *p_parent)
+    : QObject(p_parent),
+      m_fileWatcher(new QFileSystemWatcher(this))
+{
+    // A slow share should not keep the pool busy for others.
+    m_pool.setMaxThreadCount(2);
+
+    connect(m_fileWatcher, &QFileSystemWatcher::fileChanged,
+            this, &VFileChangeChecker::handleFileChanged);
+
+    connect(VNotebookWatcher::inst(), &VNotebookWatcher::directoryContentChanged,
+            this, &VFileChangeChecker::handleDirectoryContentChanged);
+}
+
+VFileChangeChecker::~VFileChangeChecker()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+VFileChangeChecker *VFileChangeChecker::inst()
+{
+    static VFileChangeChecker *checker = new VFileChangeChecker(QCoreApplication::instance());
+    return checker;
+}
+
+void VFileChangeChecker::check(const QString &p_file)
+{
+    if (m_cleanFiles.contains(p_file)) {
+        if (VNotebookWatcher::inst()->isWatching(VUtils::basePathFromPath(p_file))) {
+            return;
+        }
+
+        removeCleanFile(p_file);
+    }
+
+    if (m_pendingFiles.contains(p_file)) {
+        return;
+    }
+
+    m_pendingFiles.insert(p_file);
+    m_pool.start(new FileStatTask(this, p_file));
+}
+
+void VFileChangeChecker::handleDirectoryContentChanged(const QString &p_dirPath)
+{
+    QStringList files;
+    for (auto const & file : m_cleanFiles) {
+        if (VUtils::basePathFromPath(file) == p_dirPath) {
+            files.append(file);
+        }
+    }
+
+    for (auto const & file : files) {
+        removeCleanFile(file);
+    }
+
+    for (auto const & file : m_pendingFiles) {
+        if (VUtils::basePathFromPath(file) == p_dirPath) {
+            m_stalePendingFiles.insert(file);
+        }
+    }
+}
+
+void VFileChangeChecker::handleFileChanged(const QString &p_file)
+{
+    removeCleanFile(p_file);
+
+    if (m_pendingFiles.contains(p_file)) {
+        m_stalePendingFiles.insert(p_file);
+    }
+}
+
+void VFileChangeChecker::removeCleanFile(const QString &p_file)
+{
+    if (m_cleanFiles.remove(p_file)) {
+        m_fileWatcher->removePath(p_file);
+    }
+}
+
+void VFileChangeChecker::handleFileStated(const QString &p_file, qint64 p_lastModified)
+{
+    m_pendingFiles.remove(p_file);
+
+    // The result may be outdated if changes are reported during the lookup.
+    bool stale = m_stalePendingFiles.remove(p_file);
+    if (!stale
+        && p_lastModified != -1
+        && !m_cleanFiles.contains(p_file)
+        && VNotebookWatcher::inst()->isWatching(VUtils::basePathFromPath(p_file))
+        && m_fileWatcher->addPath(p_file)) {
+        m_cleanFiles.insert(p_file);
+    }
+
+    emit fileChecked(p_file,
+                     p_lastModified == -1 ? QDateTime()
+                                          : QDateTime::fromMSecsSinceEpoch(p_lastModified));
+}
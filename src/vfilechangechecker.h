@@ -0,0 +1,62 @@
+#ifndef VFILECHANGECHECKER_H
+#define VFILECHANGECHECKER_H
+
+#include <QObject>
+#include <QString>
+#include <QSet>
+#include <QDateTime>
+#include <QThreadPool>
+
+class QFileSystemWatcher;
+
+// Check whether the files of the tabs are changed on disk off the GUI thread.
+// Files in folders watched by VNotebookWatcher are looked up again only after
+// a change is reported in their folders or on themselves, since the folders
+// are not reported for files rewritten in place.
+// Should be accessed only in the GUI thread.
+class VFileChangeChecker : public QObject
+{
+    Q_OBJECT
+public:
+    ~VFileChangeChecker();
+
+    static VFileChangeChecker *inst();
+
+    // Look up the last modified time of @p_file in the background.
+    // fileChecked() will be emitted unless @p_file is known to be unchanged
+    // since last emitted.
+    void check(const QString &p_file);
+
+signals:
+    // @p_lastModified is invalid if @p_file is missing.
+    void fileChecked(const QString &p_file, const QDateTime &p_lastModified);
+
+private slots:
+    void handleDirectoryContentChanged(const QString &p_dirPath);
+
+    void handleFileChanged(const QString &p_file);
+
+    // @p_lastModified: msecs since epoch, or -1 if missing.
+    void handleFileStated(const QString &p_file, qint64 p_lastModified);
+
+private:
+    explicit VFileChangeChecker(QObject *p_parent = nullptr);
+
+    void removeCleanFile(const QString &p_file);
+
+    QThreadPool m_pool;
+
+    // Files being looked up.
+    QSet<QString> m_pendingFiles;
+
+    // Pending files with changes reported during the lookup.
+    QSet<QString> m_stalePendingFiles;
+
+    // Files in watched folders emitted with no change reported since.
+    QSet<QString> m_cleanFiles;
+
+    // Watch the clean files.
+    QFileSystemWatcher *m_fileWatcher;
+};
+
+#endif // VFILECHANGECHECKER_H
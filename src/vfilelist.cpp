@@ -2,6 +2,7 @@
 #include <QtWidgets>
 #include <QUrl>
 #include <QTimer>
+#include <algorithm>
 
 #include "vfilelist.h"
 #include "vconfigmanager.h"
@@ -21,11 +22,72 @@
 #include "dialog/vtipsdialog.h"
 #include "vcart.h"
 #include "vhistorylist.h"
+#include "vnoteimporter.h"
+#include "vnoteprefetcher.h"
 
 extern VConfigManager *g_config;
 extern VNote *g_vnote;
 extern VMainWindow *g_mainWin;
 
+// Sort @p_files by the keys got via @p_keyFunc, which is called once per file
+// instead of in each comparison.
+template <typename KeyFunc>
+static void sortFilesByKey(QVector<VNoteFile *> &p_files, KeyFunc p_keyFunc, bool p_reverse)
+{
+    typedef decltype(p_keyFunc(nullptr)) Key;
+
+    QVector<QPair<Key, VNoteFile *>> keyedFiles;
+    keyedFiles.reserve(p_files.size());
+    for (auto file : p_files) {
+        keyedFiles.append(qMakePair(p_keyFunc(file), file));
+    }
+
+    std::stable_sort(keyedFiles.begin(), keyedFiles.end(),
+                     [p_reverse](const QPair<Key, VNoteFile *> &p_a, const QPair<Key, VNoteFile *> &p_b) {
+                         if (p_reverse) {
+                             return p_b.first < p_a.first;
+                         } else {
+                             return p_a.first < p_b.first;
+                         }
+                     });
+
+    for (int i = 0; i < keyedFiles.size(); ++i) {
+        p_files[i] = keyedFiles[i].second;
+    }
+}
+
+// Item of a note whose tooltip is generated on demand, since formatting the
+// times of thousands of notes costs much when filling the list.
+class VFileListItem : public QListWidgetItem
+{
+public:
+    explicit VFileListItem(const VNoteFile *p_file)
+        : m_file(p_file)
+    {
+    }
+
+    QVariant data(int p_role) const Q_DECL_OVERRIDE
+    {
+        if (p_role == Qt::ToolTipRole) {
+            if (!m_file) {
+                return QVariant();
+            }
+
+            QString createdTime = VUtils::displayDateTime(m_file->getCreatedTimeUtc().toLocalTime());
+            QString modifiedTime = VUtils::displayDateTime(m_file->getModifiedTimeUtc().toLocalTime());
+            return QCoreApplication::translate("VFileList", "%1\n\nCreated Time: %2\nModified Time: %3")
+                     .arg(m_file->getName())
+                     .arg(createdTime)
+                     .arg(modifiedTime);
+        }
+
+        return QListWidgetItem::data(p_role);
+    }
+
+private:
+    QPointer<const VNoteFile> m_file;
+};
+
 VFileList::VFileList(QWidget *parent)
     : QWidget(parent),
       VNavigationMode(),
@@ -123,6 +185,11 @@ void VFileList::setupUI()
                 Q_UNUSED(p_pre);
                 if (p_cur) {
                     showStatusTipAboutItem(p_cur);
+
+                    VNoteFile *file = getVFile(p_cur);
+                    if (file && !file->isOpened()) {
+                        VNotePrefetcher::inst()->prefetch(file->fetchPath());
+                    }
                 }
             });
 
@@ -175,7 +242,7 @@ void VFileList::setDirectory(VDirectory *p_directory)
     // be NULL.
     if (m_directory == p_directory) {
         if (!m_directory) {
-            fileList->clearAll();
+            clearFileList();
             updateNumberLabel();
         }
 
@@ -184,7 +251,7 @@ void VFileList::setDirectory(VDirectory *p_directory)
 
     m_directory = p_directory;
     if (!m_directory) {
-        fileList->clearAll();
+        clearFileList();
         updateNumberLabel();
         return;
     }
@@ -192,9 +259,15 @@ void VFileList::setDirectory(VDirectory *p_directory)
     updateFileList();
 }
 
-void VFileList::updateFileList()
+void VFileList::clearFileList()
 {
     fileList->clearAll();
+    m_itemOfFile.clear();
+}
+
+void VFileList::updateFileList()
+{
+    clearFileList();
     if (!m_directory->open()) {
         return;
     }
@@ -202,11 +275,18 @@ void VFileList::updateFileList()
     QVector<VNoteFile *> files = m_directory->getFiles();
     sortFiles(files, (ViewOrder)g_config->getNoteListViewOrder());
 
+    fileList->setUpdatesEnabled(false);
+    m_itemOfFile.reserve(files.size());
     for (int i = 0; i < files.size(); ++i) {
         VNoteFile *file = files[i];
         insertFileListItem(file);
     }
 
+    fileList->setUpdatesEnabled(true);
+
+    // Qt seems not to update the QListWidget correctly. Manually force it to repaint.
+    fileList->update();
+
     updateNumberLabel();
 }
 
@@ -232,10 +312,13 @@ void VFileList::addFileToCart() const
     QList<QListWidgetItem *> items = fileList->selectedItems();
     VCart *cart = g_mainWin->getCart();
 
+    QStringList files;
     for (int i = 0; i < items.size(); ++i) {
-        cart->addFile(getVFile(items[i])->fetchPath());
+        files << getVFile(items[i])->fetchPath();
     }
 
+    cart->addFiles(files);
+
     g_mainWin->showStatusMessage(tr("%1 %2 added to Cart")
                                    .arg(items.size())
                                    .arg(items.size() > 1 ? tr("notes") : tr("note")));
@@ -306,20 +389,14 @@ void VFileList::fillItem(QListWidgetItem *p_item, const VNoteFile *p_file)
     p_item->setData(Qt::UserRole, ptr);
     p_item->setText(p_file->getName());
 
-    QString createdTime = VUtils::displayDateTime(p_file->getCreatedTimeUtc().toLocalTime());
-    QString modifiedTime = VUtils::displayDateTime(p_file->getModifiedTimeUtc().toLocalTime());
-    QString tooltip = tr("%1\n\nCreated Time: %2\nModified Time: %3")
-                        .arg(p_file->getName())
-                        .arg(createdTime)
-                        .arg(modifiedTime);
-    p_item->setToolTip(tooltip);
+    // The tooltip is generated by VFileListItem.
     V_ASSERT(sizeof(p_file) <= sizeof(ptr));
 }
 
 QListWidgetItem* VFileList::insertFileListItem(VNoteFile *file, bool atFront)
 {
     V_ASSERT(file);
-    QListWidgetItem *item = new QListWidgetItem();
+    QListWidgetItem *item = new VFileListItem(file);
     fillItem(item, file);
 
     if (atFront) {
@@ -328,8 +405,7 @@ QListWidgetItem* VFileList::insertFileListItem(VNoteFile *file, bool atFront)
         fileList->addItem(item);
     }
 
-    // Qt seems not to update the QListWidget correctly. Manually force it to repaint.
-    fileList->update();
+    m_itemOfFile.insert(file, item);
     return item;
 }
 
@@ -347,6 +423,7 @@ void VFileList::removeFileListItem(VNoteFile *p_file)
     int row = fileList->row(item);
     Q_ASSERT(row >= 0);
 
+    m_itemOfFile.remove(p_file);
     fileList->takeItem(row);
     delete item;
 
@@ -508,32 +585,25 @@ void VFileList::deleteFiles(const QVector<VNoteFile *> &p_files)
             files.push_back((VNoteFile *)item.m_data);
         }
 
-        int nrDeleted = 0;
         for (auto file : files) {
             editArea->closeFile(file, true);
 
             // Remove the item before deleting it totally, or file will be invalid.
             removeFileListItem(file);
+        }
 
-            QString errMsg;
-            QString fileName = file->getName();
-            QString filePath = file->fetchPath();
-            if (!VNoteFile::deleteFile(file, &errMsg)) {
-                VUtils::showMessage(QMessageBox::Warning,
-                                    tr("Warning"),
-                                    tr("Fail to delete note <span style=\"%1\">%2</span>.<br>"
-                                       "Please check <span style=\"%1\">%3</span> and manually delete it.")
-                                      .arg(g_config->c_dataTextStyle)
-                                      .arg(fileName)
-                                      .arg(filePath),
-                                    errMsg,
-                                    QMessageBox::Ok,
-                                    QMessageBox::Ok,
-                                    this);
-            } else {
-                Q_ASSERT(errMsg.isEmpty());
-                ++nrDeleted;
-            }
+        // Files are moved into the recycle bin in background.
+        QString errMsg;
+        int nrDeleted = files.size();
+        if (!VNoteFile::deleteFiles(files, &errMsg)) {
+            VUtils::showMessage(QMessageBox::Warning,
+                                tr("Warning"),
+                                tr("Fail to delete some of the notes. "
+                                   "Please check and manually delete them."),
+                                errMsg,
+                                QMessageBox::Ok,
+                                QMessageBox::Ok,
+                                this);
         }
 
         if (nrDeleted > 0) {
@@ -724,15 +794,7 @@ QListWidgetItem* VFileList::findItem(const VNoteFile *p_file)
         return NULL;
     }
 
-    int nrChild = fileList->count();
-    for (int i = 0; i < nrChild; ++i) {
-        QListWidgetItem *item = fileList->item(i);
-        if (p_file == getVFile(item)) {
-            return item;
-        }
-    }
-
-    return NULL;
+    return m_itemOfFile.value(p_file, NULL);
 }
 
 void VFileList::handleItemClicked(QListWidgetItem *p_item)
@@ -840,9 +902,8 @@ bool VFileList::importFiles(const QStringList &p_files, QString *p_errMsg)
     bool ret = true;
     Q_ASSERT(m_directory && m_directory->isOpened());
     QString dirPath = m_directory->fetchPath();
-    QDir dir(dirPath);
 
-    QVector<VNoteFile *> importedFiles;
+    QStringList files;
     for (int i = 0; i < p_files.size(); ++i) {
         const QString &file = p_files[i];
 
@@ -857,7 +918,6 @@ bool VFileList::importFiles(const QStringList &p_files, QString *p_errMsg)
         QString name = VUtils::fileNameFromPath(file);
         Q_ASSERT(!name.isEmpty());
 
-        bool copyNeeded = true;
         if (VUtils::equalPath(dirPath, fi.absolutePath())) {
             // Check if it is already a note.
             if (m_directory->findFile(name, false)) {
@@ -868,39 +928,74 @@ bool VFileList::importFiles(const QStringList &p_files, QString *p_errMsg)
                 ret = false;
                 continue;
             }
-
-            qDebug() << "skip cpoy file" << file << "locates in" << dirPath;
-            copyNeeded = false;
         }
 
-        QString targetFilePath;
-        if (copyNeeded) {
-            name = VUtils::getFileNameWithSequence(dirPath, name, true);
-            targetFilePath = dir.filePath(name);
-            bool ret = VUtils::copyFile(file, targetFilePath, false);
-            if (!ret) {
-                VUtils::addErrMsg(p_errMsg, tr("Fail to copy file %1 as %2.")
-                                              .arg(file)
-                                              .arg(targetFilePath));
-                ret = false;
-                continue;
-            }
-        } else {
-            targetFilePath = file;
-        }
+        files << file;
+    }
+
+    if (files.isEmpty()) {
+        return ret;
+    }
+
+    // Copy the files and relocate their images in background.
+    VNoteImporter importer(files, dirPath, m_directory->getNotebook()->getImageFolder());
+    QProgressDialog proDlg(tr("Importing files..."),
+                           tr("Abort"),
+                           0,
+                           files.size(),
+                           this);
+    proDlg.setWindowModality(Qt::WindowModal);
+    proDlg.setWindowTitle(tr("Import Files"));
+    proDlg.setMinimumDuration(500);
+
+    QEventLoop loop;
+    connect(&importer, &VNoteImporter::progressUpdated,
+            &proDlg, [&proDlg](int p_done, int p_total) {
+                Q_UNUSED(p_total);
+                proDlg.setValue(p_done);
+            });
+    connect(&proDlg, &QProgressDialog::canceled,
+            &importer, &VNoteImporter::stop);
+    connect(&importer, &QThread::finished,
+            &loop, &QEventLoop::quit);
+
+    importer.start();
+    loop.exec();
+    importer.wait();
+
+    if (!importer.getErrorMessage().isEmpty()) {
+        VUtils::addErrMsg(p_errMsg, importer.getErrorMessage());
+    }
+
+    if (importer.isStopped()) {
+        VUtils::addErrMsg(p_errMsg, tr("Importing files is aborted."));
+        return false;
+    }
 
-        VNoteFile *destFile = m_directory->addFile(name, -1);
+    if (!importer.isSucceeded()) {
+        ret = false;
+    }
+
+    // Add all the notes with one write of the configuration.
+    QVector<VNoteFile *> importedFiles;
+    m_directory->beginConfigBatch();
+    for (auto const & file : importer.getImportedFiles()) {
+        VNoteFile *destFile = m_directory->addFile(file.m_name, -1);
         if (destFile) {
             importedFiles.append(destFile);
-            qDebug() << "imported" << file << "as" << targetFilePath;
+            qDebug() << "imported" << file.m_srcFile << "as" << file.m_name;
         } else {
             VUtils::addErrMsg(p_errMsg, tr("Fail to add the note %1 to target folder's configuration.")
-                                          .arg(file));
+                                          .arg(file.m_srcFile));
             ret = false;
-            continue;
         }
     }
 
+    if (!m_directory->endConfigBatch()) {
+        VUtils::addErrMsg(p_errMsg, tr("Fail to write configuration of folder %1.").arg(dirPath));
+        ret = false;
+    }
+
     qDebug() << "imported" << importedFiles.size() << "files";
 
     updateFileList();
@@ -974,7 +1069,10 @@ void VFileList::pasteFiles(VDirectory *p_destDir,
         return;
     }
 
-    int nrPasted = 0;
+    // Plan all the notes to paste them in one batch.
+    QVector<VNoteFile *> filesToPaste;
+    QVector<QString> destNames;
+    QSet<QString> takenNames;
     for (int i = 0; i < p_files.size(); ++i) {
         VNoteFile *file = g_vnote->getInternalFile(p_files[i]);
         if (!file) {
@@ -992,6 +1090,10 @@ void VFileList::pasteFiles(VDirectory *p_destDir,
             continue;
         }
 
+        if (filesToPaste.contains(file)) {
+            continue;
+        }
+
         QString fileName = file->getName();
         if (file->getDirectory() == p_destDir) {
             if (p_isCut) {
@@ -1020,41 +1122,46 @@ void VFileList::pasteFiles(VDirectory *p_destDir,
                     continue;
                 }
             }
-
-            // Rename it to xxx_copy.md.
-            fileName = VUtils::generateCopiedFileName(file->fetchBasePath(),
-                                                      fileName,
-                                                      true);
-        } else {
-            // Rename it to xxx_copy.md if needed.
-            fileName = VUtils::generateCopiedFileName(p_destDir->fetchPath(),
-                                                      fileName,
-                                                      true);
         }
 
-        QString msg;
-        VNoteFile *destFile = NULL;
-        bool ret = VNoteFile::copyFile(p_destDir,
-                                       fileName,
-                                       file,
-                                       p_isCut,
-                                       g_config->getInsertNewNoteInFront() ? 0 : -1,
-                                       &destFile,
-                                       &msg);
-        if (!ret) {
-            VUtils::showMessage(QMessageBox::Warning,
-                                tr("Warning"),
-                                tr("Fail to copy note <span style=\"%1\">%2</span>.")
-                                  .arg(g_config->c_dataTextStyle)
-                                  .arg(p_files[i]),
-                                msg,
-                                QMessageBox::Ok,
-                                QMessageBox::Ok,
-                                this);
-        }
+        // Rename it to xxx_copy.md if needed.
+        fileName = VUtils::generateCopiedFileName(p_destDir->fetchPath(),
+                                                  fileName,
+                                                  true,
+                                                  takenNames);
+        takenNames.insert(fileName);
 
-        if (destFile) {
-            ++nrPasted;
+        filesToPaste.append(file);
+        destNames.append(fileName);
+    }
+
+    if (filesToPaste.isEmpty()) {
+        return;
+    }
+
+    QString msg;
+    QVector<VNoteFile *> destFiles;
+    bool ret = VNoteFile::copyFiles(p_destDir,
+                                    filesToPaste,
+                                    destNames,
+                                    p_isCut,
+                                    g_config->getInsertNewNoteInFront() ? 0 : -1,
+                                    destFiles,
+                                    &msg);
+    if (!ret) {
+        VUtils::showMessage(QMessageBox::Warning,
+                            tr("Warning"),
+                            tr("Fail to %1 notes.").arg(p_isCut ? tr("cut") : tr("copy")),
+                            msg,
+                            QMessageBox::Ok,
+                            QMessageBox::Ok,
+                            this);
+    }
+
+    // Only the opened notes need to be updated besides the list.
+    int nrPasted = destFiles.size();
+    for (auto destFile : destFiles) {
+        if (editArea->isFileOpened(destFile)) {
             emit fileUpdated(destFile, p_isCut ? UpdateAction::Moved : UpdateAction::InfoChanged);
         }
     }
@@ -1421,20 +1528,22 @@ void VFileList::sortFileList(ViewOrder p_order)
 
     int cnt = files.size();
     Q_ASSERT(cnt == fileList->count());
+
+    QHash<const VNoteFile *, int> rows;
+    rows.reserve(cnt);
     for (int i = 0; i < cnt; ++i) {
-        int row = -1;
-        for (int j = i; j < cnt; ++j) {
-            QListWidgetItem *item = fileList->item(j);
-            if (files[i] == getVFile(item)) {
-                row = j;
-                break;
-            }
-        }
+        rows.insert(getVFile(fileList->item(i)), i);
+    }
 
-        Q_ASSERT(row > -1);
-        QListWidgetItem *item = fileList->takeItem(row);
-        fileList->insertItem(i, item);
+    QVector<int> sortedIdx(cnt);
+    for (int i = 0; i < cnt; ++i) {
+        Q_ASSERT(rows.contains(files[i]));
+        sortedIdx[i] = rows.value(files[i]);
     }
+
+    fileList->setUpdatesEnabled(false);
+    VListWidget::sortListWidget(fileList, sortedIdx);
+    fileList->setUpdatesEnabled(true);
 }
 
 void VFileList::sortFiles(QVector<VNoteFile *> &p_files, ViewOrder p_order)
@@ -1449,39 +1558,27 @@ void VFileList::sortFiles(QVector<VNoteFile *> &p_files, ViewOrder p_order)
         reverse = true;
         V_FALLTHROUGH;
     case ViewOrder::Name:
-        std::sort(p_files.begin(), p_files.end(), [reverse](const VNoteFile *p_a, const VNoteFile *p_b) {
-            if (reverse) {
-                return p_b->getName() < p_a->getName();
-            } else {
-                return p_a->getName() < p_b->getName();
-            }
-        });
+        sortFilesByKey(p_files, [](const VNoteFile *p_file) {
+            return p_file->getName();
+        }, reverse);
         break;
 
     case ViewOrder::CreatedTimeReverse:
         reverse = true;
         V_FALLTHROUGH;
     case ViewOrder::CreatedTime:
-        std::sort(p_files.begin(), p_files.end(), [reverse](const VNoteFile *p_a, const VNoteFile *p_b) {
-            if (reverse) {
-                return p_b->getCreatedTimeUtc() < p_a->getCreatedTimeUtc();
-            } else {
-                return p_a->getCreatedTimeUtc() < p_b->getCreatedTimeUtc();
-            }
-        });
+        sortFilesByKey(p_files, [](const VNoteFile *p_file) {
+            return p_file->getCreatedTimeUtc().toMSecsSinceEpoch();
+        }, reverse);
         break;
 
     case ViewOrder::ModifiedTimeReverse:
         reverse = true;
         V_FALLTHROUGH;
     case ViewOrder::ModifiedTime:
-        std::sort(p_files.begin(), p_files.end(), [reverse](const VNoteFile *p_a, const VNoteFile *p_b) {
-            if (reverse) {
-                return p_b->getModifiedTimeUtc() < p_a->getModifiedTimeUtc();
-            } else {
-                return p_a->getModifiedTimeUtc() < p_b->getModifiedTimeUtc();
-            }
-        });
+        sortFilesByKey(p_files, [](const VNoteFile *p_file) {
+            return p_file->getModifiedTimeUtc().toMSecsSinceEpoch();
+        }, reverse);
         break;
 
     default:
@@ -8,6 +8,7 @@
 #include <QPointer>
 #include <QListWidgetItem>
 #include <QMap>
+#include <QHash>
 #include "vnotebook.h"
 #include "vconstants.h"
 #include "vdirectory.h"
@@ -152,6 +153,9 @@ private:
     // Init shortcuts.
     void initShortcuts();
 
+    // Clear the list widget and the item map.
+    void clearFileList();
+
     // Clear and re-fill the list widget according to m_directory.
     void updateFileList();
 
@@ -202,6 +206,9 @@ private:
 
     VFileListWidget *fileList;
 
+    // File -> its item in the list widget.
+    QHash<const VNoteFile *, QListWidgetItem *> m_itemOfFile;
+
     QPushButton *m_splitBtn;
 
     QLabel *m_numLabel;
@@ -14,6 +14,9 @@ VFileListWidget::VFileListWidget(QWidget *p_parent)
     setSelectionMode(QAbstractItemView::ExtendedSelection);
     setDragEnabled(true);
     setMouseTracking(true);
+
+    // Notes are shown in one line, which saves laying out each item.
+    setUniformItemSizes(true);
 }
 
 QStringList VFileListWidget::mimeTypes() const
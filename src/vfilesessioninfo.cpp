@@ -32,8 +32,7 @@ VFileSessionInfo VFileSessionInfo::fromEditTabInfo(const VEditTabInfo *p_tabInfo
 {
     Q_ASSERT(p_tabInfo);
     VEditTab *tab = p_tabInfo->m_editTab;
-    VFileSessionInfo info(tab->getFile()->fetchPath(),
-                          tab->isEditMode() ? OpenFileMode::Edit : OpenFileMode::Read);
+    VFileSessionInfo info(tab->getFile()->fetchPath(), tab->getOpenMode());
     info.m_headerIndex = p_tabInfo->m_headerIndex;
     info.m_cursorBlockNumber = p_tabInfo->m_cursorBlockNumber;
     info.m_cursorPositionInBlock = p_tabInfo->m_cursorPositionInBlock;
@@ -0,0 +1,693 @@
+#include "vfilesystemmodel.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSet>
+#include <QRunnable>
+#include <QWidget>
+#include <algorithm>
+
+// Number of rows to insert at a time.
+#define BATCH_SIZE 256
+
+// Stay well below the default inotify limit shared with other applications.
+#define MAX_WATCHED_DIRECTORIES 512
+
+#if defined(Q_OS_WIN)
+static const Qt::CaseSensitivity c_pathCaseSensitivity = Qt::CaseInsensitive;
+#else
+static const Qt::CaseSensitivity c_pathCaseSensitivity = Qt::CaseSensitive;
+#endif
+
+static int compareNames(const QString &p_name1, const QString &p_name2)
+{
+    int ret = p_name1.compare(p_name2, Qt::CaseInsensitive);
+    if (ret == 0) {
+        ret = p_name1.compare(p_name2, Qt::CaseSensitive);
+    }
+
+    return ret;
+}
+
+static QString childPath(const QString &p_path, const QString &p_name)
+{
+    return p_path.endsWith('/') ? p_path + p_name : p_path + "/" + p_name;
+}
+
+// List the sub-directories and files of a directory.
+class DirectoryListTask : public QRunnable
+{
+public:
+    DirectoryListTask(VFileSystemModel *p_model, const QString &p_path)
+        : m_model(p_model),
+          m_path(p_path)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        QDir dir(m_path);
+        QStringList dirs = dir.entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Unsorted);
+        QStringList files = dir.entryList(QDir::Files, QDir::Unsorted);
+
+        auto lessThan = [](const QString &p_a, const QString &p_b) {
+            return compareNames(p_a, p_b) < 0;
+        };
+        std::sort(dirs.begin(), dirs.end(), lessThan);
+        std::sort(files.begin(), files.end(), lessThan);
+
+        // The model waits for all the tasks before destruction.
+        QMetaObject::invokeMethod(m_model,
+                                  "directoryListed",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(QString, m_path),
+                                  Q_ARG(QStringList, dirs),
+                                  Q_ARG(QStringList, files));
+    }
+
+private:
+    VFileSystemModel *m_model;
+
+    QString m_path;
+};
+
+
+VFileSystemModel::VFileSystemModel(QObject *p_parent)
+    : QAbstractItemModel(p_parent)
+{
+    m_pool.setMaxThreadCount(2);
+
+    m_root = new Node(QString(), true, nullptr);
+    m_root->m_listed = true;
+
+    const QFileInfoList drives = QDir::drives();
+    for (auto const & drive : drives) {
+        QString path = QDir::fromNativeSeparators(drive.absoluteFilePath());
+        if (!path.endsWith('/')) {
+            path += '/';
+        }
+
+        Node *node = new Node(path, true, m_root);
+        node->m_row = m_root->m_children.size();
+        m_root->m_children.append(node);
+    }
+
+    m_insertTimer = new QTimer(this);
+    m_insertTimer->setSingleShot(true);
+    m_insertTimer->setInterval(0);
+    connect(m_insertTimer, &QTimer::timeout,
+            this, &VFileSystemModel::insertPendingRows);
+
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged,
+            this, &VFileSystemModel::refresh);
+
+    connect(this, &VFileSystemModel::directoryListed,
+            this, &VFileSystemModel::handleDirectoryListed);
+}
+
+VFileSystemModel::~VFileSystemModel()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+
+    delete m_root;
+}
+
+QModelIndex VFileSystemModel::index(int p_row, int p_column, const QModelIndex &p_parent) const
+{
+    if (p_column != 0) {
+        return QModelIndex();
+    }
+
+    Node *node = nodeFromIndex(p_parent);
+    if (p_row < 0 || p_row >= node->m_children.size()) {
+        return QModelIndex();
+    }
+
+    return createIndex(p_row, 0, node->m_children[p_row]);
+}
+
+QModelIndex VFileSystemModel::parent(const QModelIndex &p_index) const
+{
+    if (!p_index.isValid()) {
+        return QModelIndex();
+    }
+
+    return indexOfNode(nodeFromIndex(p_index)->m_parent);
+}
+
+int VFileSystemModel::rowCount(const QModelIndex &p_parent) const
+{
+    if (p_parent.column() > 0) {
+        return 0;
+    }
+
+    return nodeFromIndex(p_parent)->m_children.size();
+}
+
+int VFileSystemModel::columnCount(const QModelIndex &p_parent) const
+{
+    Q_UNUSED(p_parent);
+    return 1;
+}
+
+QVariant VFileSystemModel::data(const QModelIndex &p_index, int p_role) const
+{
+    if (!p_index.isValid()) {
+        return QVariant();
+    }
+
+    const Node *node = nodeFromIndex(p_index);
+    switch (p_role) {
+    case Qt::DisplayRole:
+        if (node->m_parent == m_root) {
+            return QDir::toNativeSeparators(node->m_name);
+        }
+
+        return node->m_name;
+
+    case Qt::EditRole:
+        return node->m_name;
+
+    case Qt::ToolTipRole:
+        return QDir::toNativeSeparators(pathOfNode(node));
+
+    case Qt::DecorationRole:
+        // Do not stat each file in the GUI thread for its own icon.
+        if (node->m_parent == m_root) {
+            return m_iconProvider.icon(QFileIconProvider::Drive);
+        }
+
+        return m_iconProvider.icon(node->m_isDir ? QFileIconProvider::Folder
+                                                 : QFileIconProvider::File);
+
+    default:
+        break;
+    }
+
+    return QVariant();
+}
+
+Qt::ItemFlags VFileSystemModel::flags(const QModelIndex &p_index) const
+{
+    if (!p_index.isValid()) {
+        return Qt::NoItemFlags;
+    }
+
+    Qt::ItemFlags flags = Qt::ItemIsEnabled | Qt::ItemIsSelectable;
+    if (!nodeFromIndex(p_index)->m_isDir) {
+        flags |= Qt::ItemNeverHasChildren;
+    }
+
+    return flags;
+}
+
+bool VFileSystemModel::hasChildren(const QModelIndex &p_parent) const
+{
+    if (p_parent.column() > 0) {
+        return false;
+    }
+
+    const Node *node = nodeFromIndex(p_parent);
+    if (!node->m_isDir) {
+        return false;
+    }
+
+    // Assume there are children until listed.
+    return !node->m_listed || !node->m_children.isEmpty();
+}
+
+bool VFileSystemModel::canFetchMore(const QModelIndex &p_parent) const
+{
+    const Node *node = nodeFromIndex(p_parent);
+    return node->m_isDir && !node->m_listed && !node->m_listing;
+}
+
+void VFileSystemModel::fetchMore(const QModelIndex &p_parent)
+{
+    if (canFetchMore(p_parent)) {
+        startListing(nodeFromIndex(p_parent));
+    }
+}
+
+QModelIndex VFileSystemModel::index(const QString &p_path)
+{
+    QStringList names = splitPath(p_path);
+    if (names.isEmpty()) {
+        return QModelIndex();
+    }
+
+    Node *node = m_root;
+    QString path;
+    for (auto const & name : names) {
+        path = path.isEmpty() ? name : childPath(path, name);
+
+        Node *child = findChild(node, name);
+        if (!child) {
+            if (node == m_root) {
+                return QModelIndex();
+            }
+
+            QFileInfo fi(path);
+            if (!fi.exists()) {
+                return QModelIndex();
+            }
+
+            insertChildren(node, QStringList(name), fi.isDir());
+            child = findChild(node, name);
+            Q_ASSERT(child);
+        }
+
+        node = child;
+    }
+
+    return indexOfNode(node);
+}
+
+QString VFileSystemModel::filePath(const QModelIndex &p_index) const
+{
+    if (!p_index.isValid()) {
+        return QString();
+    }
+
+    return pathOfNode(nodeFromIndex(p_index));
+}
+
+bool VFileSystemModel::isDir(const QModelIndex &p_index) const
+{
+    if (!p_index.isValid()) {
+        return false;
+    }
+
+    return nodeFromIndex(p_index)->m_isDir;
+}
+
+void VFileSystemModel::refresh(const QString &p_path)
+{
+    Node *node = findNode(p_path);
+    if (node && node->m_listed) {
+        startListing(node);
+    }
+}
+
+QStringList VFileSystemModel::splitPath(const QString &p_path)
+{
+    QStringList names;
+    QString path = QDir::cleanPath(QDir::fromNativeSeparators(p_path));
+    if (path.isEmpty() || path == ".") {
+        return names;
+    }
+
+    QString rest;
+    if (path.startsWith('/')) {
+        names << "/";
+        rest = path.mid(1);
+    } else {
+        int idx = path.indexOf('/');
+        if (idx == -1) {
+            names << path + "/";
+        } else {
+            names << path.left(idx + 1);
+            rest = path.mid(idx + 1);
+        }
+    }
+
+    names << rest.split('/', QString::SkipEmptyParts);
+    return names;
+}
+
+void VFileSystemModel::handleDirectoryListed(const QString &p_path,
+                                             const QStringList &p_dirs,
+                                             const QStringList &p_files)
+{
+    Node *node = findNode(p_path);
+    if (!node || !node->m_listing) {
+        return;
+    }
+
+    node->m_listing = false;
+    node->m_listed = true;
+
+    // Remove the children which are gone.
+    QSet<QString> dirs = QSet<QString>::fromList(p_dirs);
+    QSet<QString> files = QSet<QString>::fromList(p_files);
+    for (int i = node->m_children.size() - 1; i >= 0; --i) {
+        const Node *child = node->m_children[i];
+        if (!(child->m_isDir ? dirs : files).contains(child->m_name)) {
+            removeChild(node, i);
+        }
+    }
+
+    // Queue the new children, replacing those queued by previous listing.
+    for (int i = 0; i < m_pendingRows.size(); ++i) {
+        if (m_pendingRows[i].m_path == p_path) {
+            m_pendingRows.removeAt(i);
+            break;
+        }
+    }
+
+    PendingRows rows;
+    rows.m_path = p_path;
+    for (auto const & name : p_dirs) {
+        bool found = false;
+        childRow(node, name, true, &found);
+        if (!found) {
+            rows.m_dirs << name;
+        }
+    }
+
+    for (auto const & name : p_files) {
+        bool found = false;
+        childRow(node, name, false, &found);
+        if (!found) {
+            rows.m_files << name;
+        }
+    }
+
+    watchDirectory(p_path);
+
+    if (rows.m_dirs.isEmpty() && rows.m_files.isEmpty()) {
+        if (node->m_children.isEmpty()) {
+            // Let views drop the expand indicator.
+            QModelIndex idx = indexOfNode(node);
+            emit dataChanged(idx, idx);
+        }
+
+        emit directoryLoaded(p_path);
+    } else {
+        m_pendingRows.append(rows);
+        m_insertTimer->start();
+    }
+
+    if (node->m_relist) {
+        node->m_relist = false;
+        startListing(node);
+    }
+}
+
+void VFileSystemModel::insertPendingRows()
+{
+    int budget = BATCH_SIZE;
+    while (budget > 0 && !m_pendingRows.isEmpty()) {
+        PendingRows &rows = m_pendingRows.first();
+        Node *node = findNode(rows.m_path);
+        if (!node) {
+            m_pendingRows.removeFirst();
+            continue;
+        }
+
+        if (!rows.m_dirs.isEmpty()) {
+            int cnt = qMin(budget, rows.m_dirs.size());
+            insertChildren(node, rows.m_dirs.mid(0, cnt), true);
+            rows.m_dirs.erase(rows.m_dirs.begin(), rows.m_dirs.begin() + cnt);
+            budget -= cnt;
+        } else {
+            int cnt = qMin(budget, rows.m_files.size());
+            insertChildren(node, rows.m_files.mid(0, cnt), false);
+            rows.m_files.erase(rows.m_files.begin(), rows.m_files.begin() + cnt);
+            budget -= cnt;
+        }
+
+        if (rows.m_dirs.isEmpty() && rows.m_files.isEmpty()) {
+            QString path = rows.m_path;
+            m_pendingRows.removeFirst();
+            emit directoryLoaded(path);
+        }
+    }
+
+    if (!m_pendingRows.isEmpty()) {
+        m_insertTimer->start();
+    }
+}
+
+VFileSystemModel::Node *VFileSystemModel::nodeFromIndex(const QModelIndex &p_index) const
+{
+    if (!p_index.isValid()) {
+        return m_root;
+    }
+
+    return static_cast<Node *>(p_index.internalPointer());
+}
+
+QModelIndex VFileSystemModel::indexOfNode(const Node *p_node) const
+{
+    if (!p_node || p_node == m_root) {
+        return QModelIndex();
+    }
+
+    return createIndex(p_node->m_row, 0, const_cast<Node *>(p_node));
+}
+
+QString VFileSystemModel::pathOfNode(const Node *p_node) const
+{
+    if (!p_node || p_node == m_root) {
+        return QString();
+    }
+
+    if (p_node->m_parent == m_root) {
+        return p_node->m_name;
+    }
+
+    return childPath(pathOfNode(p_node->m_parent), p_node->m_name);
+}
+
+VFileSystemModel::Node *VFileSystemModel::findNode(const QString &p_path) const
+{
+    QStringList names = splitPath(p_path);
+    if (names.isEmpty()) {
+        return nullptr;
+    }
+
+    Node *node = m_root;
+    for (auto const & name : names) {
+        node = findChild(node, name);
+        if (!node) {
+            return nullptr;
+        }
+    }
+
+    return node;
+}
+
+int VFileSystemModel::childRow(const Node *p_node, const QString &p_name, bool p_isDir, bool *p_found)
+{
+    const QVector<Node *> &children = p_node->m_children;
+    auto it = std::lower_bound(children.begin(),
+                               children.end(),
+                               p_name,
+                               [p_isDir](const Node *p_child, const QString &p_val) {
+                                   return lessThan(p_child->m_isDir, p_child->m_name, p_isDir, p_val);
+                               });
+
+    *p_found = it != children.end()
+               && (*it)->m_isDir == p_isDir
+               && (*it)->m_name == p_name;
+    return it - children.begin();
+}
+
+VFileSystemModel::Node *VFileSystemModel::findChild(const Node *p_node, const QString &p_name)
+{
+    if (p_node->m_parent == nullptr) {
+        // Roots of the file system are not sorted.
+        for (auto child : p_node->m_children) {
+            if (child->m_name.compare(p_name, c_pathCaseSensitivity) == 0) {
+                return child;
+            }
+        }
+
+        return nullptr;
+    }
+
+    bool found = false;
+    int row = childRow(p_node, p_name, true, &found);
+    if (found) {
+        return p_node->m_children[row];
+    }
+
+    row = childRow(p_node, p_name, false, &found);
+    if (found) {
+        return p_node->m_children[row];
+    }
+
+    return nullptr;
+}
+
+bool VFileSystemModel::lessThan(bool p_isDir1, const QString &p_name1, bool p_isDir2, const QString &p_name2)
+{
+    if (p_isDir1 != p_isDir2) {
+        return p_isDir1;
+    }
+
+    return compareNames(p_name1, p_name2) < 0;
+}
+
+void VFileSystemModel::startListing(Node *p_node)
+{
+    if (p_node->m_listing) {
+        p_node->m_relist = true;
+        return;
+    }
+
+    p_node->m_listing = true;
+    m_pool.start(new DirectoryListTask(this, pathOfNode(p_node)));
+}
+
+int VFileSystemModel::insertChildren(Node *p_node, const QStringList &p_names, bool p_isDir)
+{
+    if (p_names.isEmpty()) {
+        return 0;
+    }
+
+    QModelIndex parentIdx = indexOfNode(p_node);
+    QVector<Node *> &children = p_node->m_children;
+
+    // @p_names are sorted. Append them at once if they all go after the
+    // existing children, which is the case of a newly listed directory.
+    if (children.isEmpty()
+        || lessThan(children.last()->m_isDir, children.last()->m_name, p_isDir, p_names.first())) {
+        int first = children.size();
+        beginInsertRows(parentIdx, first, first + p_names.size() - 1);
+        children.reserve(first + p_names.size());
+        for (auto const & name : p_names) {
+            Node *node = new Node(name, p_isDir, p_node);
+            node->m_row = children.size();
+            children.append(node);
+        }
+
+        endInsertRows();
+        return p_names.size();
+    }
+
+    int cnt = 0;
+    for (auto const & name : p_names) {
+        bool found = false;
+        int row = childRow(p_node, name, p_isDir, &found);
+        if (found) {
+            continue;
+        }
+
+        beginInsertRows(parentIdx, row, row);
+        children.insert(row, new Node(name, p_isDir, p_node));
+        updateRows(p_node, row);
+        endInsertRows();
+        ++cnt;
+    }
+
+    return cnt;
+}
+
+void VFileSystemModel::removeChild(Node *p_node, int p_row)
+{
+    Node *child = p_node->m_children[p_row];
+    if (child->m_isDir) {
+        unwatchDirectory(pathOfNode(child));
+    }
+
+    beginRemoveRows(indexOfNode(p_node), p_row, p_row);
+    p_node->m_children.remove(p_row);
+    updateRows(p_node, p_row);
+    delete child;
+    endRemoveRows();
+}
+
+void VFileSystemModel::updateRows(Node *p_node, int p_from)
+{
+    for (int i = p_from; i < p_node->m_children.size(); ++i) {
+        p_node->m_children[i]->m_row = i;
+    }
+}
+
+void VFileSystemModel::watchDirectory(const QString &p_path)
+{
+    int idx = m_watchedDirs.indexOf(p_path);
+    if (idx != -1) {
+        m_watchedDirs.move(idx, m_watchedDirs.size() - 1);
+        return;
+    }
+
+    while (m_watchedDirs.size() >= MAX_WATCHED_DIRECTORIES) {
+        QString path = m_watchedDirs.takeFirst();
+        m_watcher->removePath(path);
+
+        Node *node = findNode(path);
+        if (node) {
+            node->m_listed = false;
+        }
+    }
+
+    if (!m_watcher->addPath(p_path)) {
+        qWarning() << "fail to watch folder" << p_path;
+        return;
+    }
+
+    m_watchedDirs.append(p_path);
+}
+
+void VFileSystemModel::unwatchDirectory(const QString &p_path)
+{
+    QString prefix = p_path.endsWith('/') ? p_path : p_path + "/";
+    for (int i = m_watchedDirs.size() - 1; i >= 0; --i) {
+        const QString &path = m_watchedDirs[i];
+        if (path == p_path || path.startsWith(prefix)) {
+            m_watcher->removePath(path);
+            m_watchedDirs.removeAt(i);
+        }
+    }
+}
+
+
+VPathCompleter::VPathCompleter(VFileSystemModel *p_model, QObject *p_parent)
+    : QCompleter(p_model, p_parent),
+      m_model(p_model)
+{
+    connect(m_model, &VFileSystemModel::directoryLoaded,
+            this, &VPathCompleter::handleDirectoryLoaded);
+}
+
+QStringList VPathCompleter::splitPath(const QString &p_path) const
+{
+    QStringList names = VFileSystemModel::splitPath(p_path);
+    if (names.size() > 1
+        && (p_path.endsWith('/') || p_path.endsWith(QDir::separator()))) {
+        // Complete the children of the directory.
+        names << QString();
+    }
+
+    m_completingDir.clear();
+    if (names.size() > 1) {
+        QStringList dirNames = names.mid(0, names.size() - 1);
+        QString dirPath = dirNames.takeFirst();
+        for (auto const & name : dirNames) {
+            dirPath = childPath(dirPath, name);
+        }
+
+        QModelIndex dirIdx = m_model->index(dirPath);
+        if (dirIdx.isValid() && m_model->canFetchMore(dirIdx)) {
+            m_completingDir = dirPath;
+            m_model->fetchMore(dirIdx);
+        }
+    }
+
+    return names;
+}
+
+QString VPathCompleter::pathFromIndex(const QModelIndex &p_index) const
+{
+    return QDir::toNativeSeparators(m_model->filePath(p_index));
+}
+
+void VPathCompleter::handleDirectoryLoaded(const QString &p_path)
+{
+    if (m_completingDir.isEmpty() || p_path != m_completingDir) {
+        return;
+    }
+
+    m_completingDir.clear();
+
+    QWidget *wid = widget();
+    if (wid && wid->hasFocus()) {
+        complete();
+    }
+}
@@ -0,0 +1,204 @@
+#ifndef VFILESYSTEMMODEL_H
+#define VFILESYSTEMMODEL_H
+
+#include <QAbstractItemModel>
+#include <QCompleter>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QList>
+#include <QTimer>
+#include <QThreadPool>
+#include <QFileIconProvider>
+#include <QFileSystemWatcher>
+
+// Tree model of the file system which lists a directory only when it is
+// fetched. Directories are listed on a worker and their rows are inserted in
+// batches, so a huge directory does not block the GUI thread.
+// Listed directories are watched for changes, up to a number of the most
+// recently listed ones.
+class VFileSystemModel : public QAbstractItemModel
+{
+    Q_OBJECT
+public:
+    explicit VFileSystemModel(QObject *p_parent = nullptr);
+
+    ~VFileSystemModel();
+
+    QModelIndex index(int p_row,
+                      int p_column,
+                      const QModelIndex &p_parent = QModelIndex()) const Q_DECL_OVERRIDE;
+
+    QModelIndex parent(const QModelIndex &p_index) const Q_DECL_OVERRIDE;
+
+    int rowCount(const QModelIndex &p_parent = QModelIndex()) const Q_DECL_OVERRIDE;
+
+    int columnCount(const QModelIndex &p_parent = QModelIndex()) const Q_DECL_OVERRIDE;
+
+    QVariant data(const QModelIndex &p_index, int p_role = Qt::DisplayRole) const Q_DECL_OVERRIDE;
+
+    Qt::ItemFlags flags(const QModelIndex &p_index) const Q_DECL_OVERRIDE;
+
+    bool hasChildren(const QModelIndex &p_parent = QModelIndex()) const Q_DECL_OVERRIDE;
+
+    bool canFetchMore(const QModelIndex &p_parent) const Q_DECL_OVERRIDE;
+
+    void fetchMore(const QModelIndex &p_parent) Q_DECL_OVERRIDE;
+
+    // Index of @p_path. Rows along the path are added if their directories
+    // are not listed yet. Invalid if @p_path does not exist.
+    QModelIndex index(const QString &p_path);
+
+    QString filePath(const QModelIndex &p_index) const;
+
+    bool isDir(const QModelIndex &p_index) const;
+
+    // List directory @p_path again if it is listed.
+    void refresh(const QString &p_path);
+
+    // Split @p_path into the names of the nodes along it. The first name is
+    // the root of the file system, like "/" or "C:/".
+    static QStringList splitPath(const QString &p_path);
+
+signals:
+    // Emitted when the rows of directory @p_path are all inserted.
+    void directoryLoaded(const QString &p_path);
+
+    // Emitted by the worker when directory @p_path is listed.
+    void directoryListed(const QString &p_path,
+                         const QStringList &p_dirs,
+                         const QStringList &p_files);
+
+private slots:
+    void handleDirectoryListed(const QString &p_path,
+                               const QStringList &p_dirs,
+                               const QStringList &p_files);
+
+    // Insert a batch of the pending rows.
+    void insertPendingRows();
+
+private:
+    struct Node
+    {
+        Node(const QString &p_name, bool p_isDir, Node *p_parent)
+            : m_name(p_name),
+              m_isDir(p_isDir),
+              m_listed(false),
+              m_listing(false),
+              m_relist(false),
+              m_row(0),
+              m_parent(p_parent)
+        {
+        }
+
+        ~Node()
+        {
+            qDeleteAll(m_children);
+        }
+
+        QString m_name;
+
+        bool m_isDir;
+
+        // Whether the children are listed.
+        bool m_listed;
+
+        bool m_listing;
+
+        // Whether to list again once current listing finishes.
+        bool m_relist;
+
+        // Row within the parent.
+        int m_row;
+
+        Node *m_parent;
+
+        // Directories first, then files, each sorted by name.
+        QVector<Node *> m_children;
+    };
+
+    // Rows listed to be inserted into directory @m_path.
+    struct PendingRows
+    {
+        QString m_path;
+
+        QStringList m_dirs;
+
+        QStringList m_files;
+    };
+
+    Node *nodeFromIndex(const QModelIndex &p_index) const;
+
+    QModelIndex indexOfNode(const Node *p_node) const;
+
+    QString pathOfNode(const Node *p_node) const;
+
+    // Find the node of @p_path without adding any.
+    Node *findNode(const QString &p_path) const;
+
+    // Row of child @p_name of @p_node, or the row to insert it at if not found.
+    static int childRow(const Node *p_node, const QString &p_name, bool p_isDir, bool *p_found);
+
+    static Node *findChild(const Node *p_node, const QString &p_name);
+
+    static bool lessThan(bool p_isDir1, const QString &p_name1, bool p_isDir2, const QString &p_name2);
+
+    void startListing(Node *p_node);
+
+    // Insert children @p_names of @p_node in order. Return the number inserted.
+    int insertChildren(Node *p_node, const QStringList &p_names, bool p_isDir);
+
+    void removeChild(Node *p_node, int p_row);
+
+    static void updateRows(Node *p_node, int p_from);
+
+    // Watch @p_path as the most recently listed directory. The least
+    // recently listed one is unwatched and marked unlisted if there are too
+    // many, so it will be listed again once fetched.
+    void watchDirectory(const QString &p_path);
+
+    // Stop watching @p_path and its descendants.
+    void unwatchDirectory(const QString &p_path);
+
+    // Invisible root whose children are the roots of the file system.
+    Node *m_root;
+
+    QThreadPool m_pool;
+
+    QList<PendingRows> m_pendingRows;
+
+    QTimer *m_insertTimer;
+
+    QFileSystemWatcher *m_watcher;
+
+    // Watched directories from the least recently listed one.
+    QStringList m_watchedDirs;
+
+    QFileIconProvider m_iconProvider;
+};
+
+
+// Completer of paths on a VFileSystemModel.
+class VPathCompleter : public QCompleter
+{
+    Q_OBJECT
+public:
+    explicit VPathCompleter(VFileSystemModel *p_model, QObject *p_parent = nullptr);
+
+    // Directories along @p_path are fetched if not listed yet.
+    QStringList splitPath(const QString &p_path) const Q_DECL_OVERRIDE;
+
+    QString pathFromIndex(const QModelIndex &p_index) const Q_DECL_OVERRIDE;
+
+private slots:
+    // Complete again if the directory being completed is loaded.
+    void handleDirectoryLoaded(const QString &p_path);
+
+private:
+    VFileSystemModel *m_model;
+
+    // Directory of the path being completed.
+    mutable QString m_completingDir;
+};
+
+#endif // VFILESYSTEMMODEL_H
@@ -2,42 +2,83 @@
 
 #include <QDebug>
 #include <QThread>
+#include <QTimer>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStandardPaths>
 
 #include "vconfigmanager.h"
+#include "vrendercache.h"
+#include "vrenderscheduler.h"
 #include "utils/vprocessutils.h"
 
 extern VConfigManager *g_config;
 
-#define TaskIdProperty "GraphvizTaskId"
-#define TaskFormatProperty "GraphvizTaskFormat"
-#define TaskTimeStampProperty "GraphvizTaskTimeStamp"
+// Result string of resultReady().
+static QString toResult(const QString &p_format, const QByteArray &p_data)
+{
+    if (p_format == "svg") {
+        return QString::fromLocal8Bit(p_data);
+    } else {
+        return QString::fromLocal8Bit(p_data.toBase64());
+    }
+}
 
 VGraphvizHelper::VGraphvizHelper(QObject *p_parent)
     : QObject(p_parent)
 {
     prepareCommand(m_program, m_args);
+
+    prepareCacheSignature();
 }
 
 void VGraphvizHelper::processAsync(int p_id, TimeStamp p_timeStamp, const QString &p_format, const QString &p_text)
 {
-    QProcess *process = new QProcess(this);
-    process->setProperty(TaskIdProperty, p_id);
-    process->setProperty(TaskTimeStampProperty, p_timeStamp);
-    process->setProperty(TaskFormatProperty, p_format);
-    connect(process, SIGNAL(finished(int, QProcess::ExitStatus)),
-            this, SLOT(handleProcessFinished(int, QProcess::ExitStatus)));
+    QByteArray cacheKey = VRenderCache::key(m_cacheSignature, p_format, p_text);
+    QByteArray data;
+    if (VRenderCache::lookup(cacheKey, data)) {
+        // Keep the result asynchronous.
+        QString result = toResult(p_format, data);
+        QTimer::singleShot(0, this, [this, p_id, p_timeStamp, p_format, result]() {
+            emit resultReady(p_id, p_timeStamp, p_format, result);
+        });
+        return;
+    }
 
     QStringList args(m_args);
     args << ("-T" + p_format);
+    scheduleProcess(p_id, p_timeStamp, p_format, cacheKey, m_program, args, p_text);
+}
 
-    qDebug() << m_program << args;
-
-    process->start(m_program, args);
-    if (process->write(p_text.toUtf8()) == -1) {
-        qWarning() << "fail to write to QProcess:" << process->errorString();
-    }
-
-    process->closeWriteChannel();
+void VGraphvizHelper::scheduleProcess(int p_id,
+                                      TimeStamp p_timeStamp,
+                                      const QString &p_format,
+                                      const QByteArray &p_cacheKey,
+                                      const QString &p_program,
+                                      const QStringList &p_args,
+                                      const QString &p_text)
+{
+    auto func = [this, p_id, p_timeStamp, p_format, p_cacheKey](int p_exitCode,
+                                                                QProcess::ExitStatus p_exitStatus,
+                                                                const QByteArray &p_out,
+                                                                const QByteArray &p_err) {
+        handleProcessFinished(p_id,
+                              p_timeStamp,
+                              p_format,
+                              p_cacheKey,
+                              p_exitCode,
+                              p_exitStatus,
+                              p_out,
+                              p_err);
+    };
+
+    // The scheduler will not call @func once this helper is destroyed.
+    VRenderScheduler::inst()->schedule(this,
+                                       p_timeStamp,
+                                       p_program,
+                                       p_args,
+                                       p_text.toUtf8(),
+                                       func);
 }
 
 void VGraphvizHelper::prepareCommand(QString &p_program, QStringList &p_args) const
@@ -52,16 +93,36 @@ void VGraphvizHelper::prepareCommand(QString &p_program, QStringList &p_args) co
     p_args.clear();
 }
 
-void VGraphvizHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+void VGraphvizHelper::prepareCacheSignature()
+{
+    // File path and modified time of the Dot to tell its version.
+    QFileInfo info(m_program);
+    if (!info.isAbsolute()) {
+        QString exe = QStandardPaths::findExecutable(m_program);
+        if (!exe.isEmpty()) {
+            info.setFile(exe);
+        }
+    }
+
+    m_cacheSignature = QString("graphviz\n%1@%2\n%3")
+                         .arg(info.absoluteFilePath())
+                         .arg(info.lastModified().toMSecsSinceEpoch())
+                         .arg(m_args.join(' '));
+}
+
+void VGraphvizHelper::handleProcessFinished(int p_id,
+                                            TimeStamp p_timeStamp,
+                                            const QString &p_format,
+                                            const QByteArray &p_cacheKey,
+                                            int p_exitCode,
+                                            QProcess::ExitStatus p_exitStatus,
+                                            const QByteArray &p_out,
+                                            const QByteArray &p_err)
 {
-    QProcess *process = static_cast<QProcess *>(sender());
-    int id = process->property(TaskIdProperty).toInt();
-    QString format = process->property(TaskFormatProperty).toString();
-    TimeStamp timeStamp = process->property(TaskTimeStampProperty).toULongLong();
     qDebug() << QString("Graphviz finished: id %1 timestamp %2 format %3 exitcode %4 exitstatus %5")
-                       .arg(id)
-                       .arg(timeStamp)
-                       .arg(format)
+                       .arg(p_id)
+                       .arg(p_timeStamp)
+                       .arg(p_format)
                        .arg(p_exitCode)
                        .arg(p_exitStatus);
     bool failed = true;
@@ -70,20 +131,18 @@ void VGraphvizHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus
             qWarning() << "Graphviz fail" << p_exitCode;
         } else {
             failed = false;
-            QByteArray outBa = process->readAllStandardOutput();
-            if (format == "svg") {
-                emit resultReady(id, timeStamp, format, QString::fromLocal8Bit(outBa));
-            } else {
-                emit resultReady(id, timeStamp, format, QString::fromLocal8Bit(outBa.toBase64()));
+            if (p_exitCode == 0) {
+                VRenderCache::insert(p_cacheKey, p_out);
             }
+
+            emit resultReady(p_id, p_timeStamp, p_format, toResult(p_format, p_out));
         }
     } else {
         qWarning() << "fail to start Graphviz process" << p_exitCode << p_exitStatus;
     }
 
-    QByteArray errBa = process->readAllStandardError();
-    if (!errBa.isEmpty()) {
-        QString errStr(QString::fromLocal8Bit(errBa));
+    if (!p_err.isEmpty()) {
+        QString errStr(QString::fromLocal8Bit(p_err));
         if (failed) {
             qWarning() << "Graphviz stderr:" << errStr;
         } else {
@@ -92,10 +151,8 @@ void VGraphvizHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus
     }
 
     if (failed) {
-        emit resultReady(id, timeStamp, format, "");
+        emit resultReady(p_id, p_timeStamp, p_format, "");
     }
-
-    process->deleteLater();
 }
 
 bool VGraphvizHelper::testGraphviz(const QString &p_dot, QString &p_msg)
@@ -124,6 +181,12 @@ QByteArray VGraphvizHelper::process(const QString &p_format, const QString &p_te
 {
     VGraphvizHelper inst;
 
+    QByteArray cacheKey = VRenderCache::key(inst.m_cacheSignature, p_format, p_text);
+    QByteArray data;
+    if (VRenderCache::lookup(cacheKey, data)) {
+        return data;
+    }
+
     int exitCode = -1;
     QByteArray out, err;
 
@@ -138,6 +201,8 @@ QByteArray VGraphvizHelper::process(const QString &p_format, const QString &p_te
 
     if (ret != 0 || exitCode < 0) {
         qWarning() << "Graphviz fail" << ret << exitCode << QString::fromLocal8Bit(err);
+    } else if (exitCode == 0) {
+        VRenderCache::insert(cacheKey, out);
     }
 
     return out;
@@ -23,14 +23,34 @@ public:
 signals:
     void resultReady(int p_id, TimeStamp p_timeStamp, const QString &p_format, const QString &p_result);
 
-private slots:
-    void handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
-
 private:
+    // Run the renderer process via VRenderScheduler.
+    void scheduleProcess(int p_id,
+                         TimeStamp p_timeStamp,
+                         const QString &p_format,
+                         const QByteArray &p_cacheKey,
+                         const QString &p_program,
+                         const QStringList &p_args,
+                         const QString &p_text);
+
+    void handleProcessFinished(int p_id,
+                               TimeStamp p_timeStamp,
+                               const QString &p_format,
+                               const QByteArray &p_cacheKey,
+                               int p_exitCode,
+                               QProcess::ExitStatus p_exitStatus,
+                               const QByteArray &p_out,
+                               const QByteArray &p_err);
+
+    void prepareCacheSignature();
+
     void prepareCommand(QString &p_cmd, QStringList &p_args) const;
 
     QString m_program;
     QStringList m_args;
+
+    // Identify the renderer and its version in the render cache.
+    QString m_cacheSignature;
 };
 
 #endif // VGRAPHVIZHELPER_H
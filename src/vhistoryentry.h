@@ -3,6 +3,7 @@
 
 #include <QDate>
 #include <QSettings>
+#include <QJsonObject>
 
 namespace HistoryConfig
 {
@@ -10,6 +11,7 @@ namespace HistoryConfig
     static const QString c_date = "date";
     static const QString c_pinned = "pinned";
     static const QString c_isFolder = "is_folder";
+    static const QString c_entries = "entries";
 }
 
 class VHistoryEntry
@@ -41,6 +43,26 @@ public:
         return entry;
     }
 
+    static VHistoryEntry fromJson(const QJsonObject &p_json)
+    {
+        VHistoryEntry entry;
+        entry.m_file = p_json[HistoryConfig::c_file].toString();
+        entry.m_date = p_json[HistoryConfig::c_date].toString();
+        entry.m_isPinned = p_json[HistoryConfig::c_pinned].toBool();
+        entry.m_isFolder = p_json[HistoryConfig::c_isFolder].toBool();
+        return entry;
+    }
+
+    QJsonObject toJson() const
+    {
+        QJsonObject json;
+        json[HistoryConfig::c_file] = m_file;
+        json[HistoryConfig::c_date] = m_date;
+        json[HistoryConfig::c_pinned] = m_isPinned;
+        json[HistoryConfig::c_isFolder] = m_isFolder;
+        return json;
+    }
+
     void toSettings(QSettings *p_settings) const
     {
         p_settings->setValue(HistoryConfig::c_file, m_file);
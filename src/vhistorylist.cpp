@@ -11,6 +11,8 @@
 #include "vnote.h"
 #include "vnotefile.h"
 #include "vdirectory.h"
+#include "vmemorystats.h"
+#include "vnoteprefetcher.h"
 
 extern VMainWindow *g_mainWin;
 
@@ -25,6 +27,22 @@ VHistoryList::VHistoryList(QWidget *p_parent)
       m_updatePending(true),
       m_currentDate(QDate::currentDate())
 {
+    VMemoryStats::registerGlobal(this, "History list", [this]() {
+        return approximateBytes();
+    });
+}
+
+qint64 VHistoryList::approximateBytes() const
+{
+    qint64 bytes = 0;
+    for (auto const & entry : m_histories) {
+        // The path is shared with the key of the index.
+        bytes += sizeof(VHistoryEntry)
+                 + (qint64)(entry.m_file.capacity() + entry.m_date.capacity()) * sizeof(QChar);
+    }
+
+    bytes += (qint64)m_index.size() * (sizeof(QString) + sizeof(QLinkedList<VHistoryEntry>::iterator));
+    return bytes;
 }
 
 void VHistoryList::setupUI()
@@ -53,6 +71,7 @@ void VHistoryList::setupUI()
                                                   MessageBoxType::Danger);
                     if (ret == QMessageBox::Ok) {
                         m_histories.clear();
+                        m_index.clear();
                         g_config->setHistory(m_histories);
                         m_updatePending = true;
                         updateList();
@@ -73,6 +92,13 @@ void VHistoryList::setupUI()
             this, &VHistoryList::handleContextMenuRequested);
     connect(m_itemList, &QListWidget::itemActivated,
             this, &VHistoryList::openItem);
+    connect(m_itemList, &QListWidget::currentItemChanged,
+            this, [this](QListWidgetItem *p_cur, QListWidgetItem *p_pre) {
+                Q_UNUSED(p_pre);
+                if (p_cur && !isFolder(p_cur)) {
+                    VNotePrefetcher::inst()->prefetch(getFilePath(p_cur));
+                }
+            });
 
     QVBoxLayout *mainLayout = new QVBoxLayout();
     mainLayout->addLayout(btnLayout);
@@ -129,7 +155,7 @@ void VHistoryList::pinFolder(const QString &p_folder)
         return;
     }
 
-    m_histories.append(VHistoryEntry(p_folder, QDate::currentDate(), true, true));
+    appendEntry(VHistoryEntry(p_folder, QDate::currentDate(), true, true));
 
     checkHistorySize();
 
@@ -149,12 +175,12 @@ void VHistoryList::addFilesInternal(const QStringList &p_files, bool p_isPinned)
         auto it = findFileInHistory(file);
         if (it != m_histories.end()) {
             pinnedBefore = it->m_isPinned;
-            m_histories.erase(it);
+            eraseEntry(it);
         }
 
         // Append an entry at the end.
         bool pin = p_isPinned ? true : (pinnedBefore ? true : false);
-        m_histories.append(VHistoryEntry(file, QDate::currentDate(), pin));
+        appendEntry(VHistoryEntry(file, QDate::currentDate(), pin));
     }
 
     checkHistorySize();
@@ -172,7 +198,7 @@ void VHistoryList::checkHistorySize()
             continue;
         }
 
-        rit = m_histories.erase(rit);
+        rit = eraseEntry(rit);
         --numToRemove;
     }
 }
@@ -188,6 +214,7 @@ void VHistoryList::init()
     setupUI();
 
     g_config->getHistory(m_histories);
+    rebuildIndex();
 
     m_updatePending = true;
 }
@@ -208,15 +235,47 @@ void VHistoryList::showEvent(QShowEvent *p_event)
 
 QLinkedList<VHistoryEntry>::iterator VHistoryList::findFileInHistory(const QString &p_file)
 {
-    for (QLinkedList<VHistoryEntry>::iterator it = m_histories.begin();
-         it != m_histories.end();
-         ++it) {
-        if (VUtils::equalPath(p_file, it->m_file)) {
-            return it;
-        }
+    auto it = m_index.find(indexKey(p_file));
+    if (it == m_index.end()) {
+        return m_histories.end();
     }
 
-    return m_histories.end();
+    return it.value();
+}
+
+void VHistoryList::appendEntry(const VHistoryEntry &p_entry)
+{
+    m_histories.append(p_entry);
+    m_index.insert(indexKey(p_entry.m_file), --m_histories.end());
+}
+
+QLinkedList<VHistoryEntry>::iterator VHistoryList::eraseEntry(QLinkedList<VHistoryEntry>::iterator p_it)
+{
+    auto it = m_index.find(indexKey(p_it->m_file));
+    if (it != m_index.end() && it.value() == p_it) {
+        m_index.erase(it);
+    }
+
+    return m_histories.erase(p_it);
+}
+
+void VHistoryList::rebuildIndex()
+{
+    m_index.clear();
+    m_index.reserve(m_histories.size());
+    for (auto it = m_histories.begin(); it != m_histories.end(); ++it) {
+        // The later one wins for duplicated paths.
+        m_index.insert(indexKey(it->m_file), it);
+    }
+}
+
+QString VHistoryList::indexKey(const QString &p_file)
+{
+    QString key = QDir::cleanPath(p_file);
+#if defined(Q_OS_WIN)
+    key = key.toLower();
+#endif
+    return key;
 }
 
 struct SeparatorItem
@@ -494,10 +553,13 @@ void VHistoryList::addFileToCart() const
     QList<QListWidgetItem *> items = m_itemList->selectedItems();
     VCart *cart = g_mainWin->getCart();
 
+    QStringList files;
     for (int i = 0; i < items.size(); ++i) {
-        cart->addFile(getFilePath(items[i]));
+        files << getFilePath(items[i]);
     }
 
+    cart->addFiles(files);
+
     g_mainWin->showStatusMessage(tr("%1 %2 added to Cart")
                                    .arg(items.size())
                                    .arg(items.size() > 1 ? tr("notes") : tr("note")));
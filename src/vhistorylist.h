@@ -3,6 +3,7 @@
 
 #include <QWidget>
 #include <QLinkedList>
+#include <QHash>
 
 #include "vhistoryentry.h"
 #include "vnavigationmode.h"
@@ -25,6 +26,9 @@ public:
 
     const QLinkedList<VHistoryEntry> &getHistoryEntries() const;
 
+    // Bytes held by the entries and their index.
+    qint64 approximateBytes() const;
+
     // Implementations for VNavigationMode.
     void showNavigation() Q_DECL_OVERRIDE;
     bool handleKeyNavigation(int p_key, bool &p_succeed) Q_DECL_OVERRIDE;
@@ -63,6 +67,17 @@ private:
 
     QLinkedList<VHistoryEntry>::iterator findFileInHistory(const QString &p_file);
 
+    // Append @p_entry to the history and index it.
+    void appendEntry(const VHistoryEntry &p_entry);
+
+    // Remove the entry @p_it from the history and index.
+    QLinkedList<VHistoryEntry>::iterator eraseEntry(QLinkedList<VHistoryEntry>::iterator p_it);
+
+    void rebuildIndex();
+
+    // Key of @p_file in @m_index, equal for the same path.
+    static QString indexKey(const QString &p_file);
+
     QString getFilePath(const QListWidgetItem *p_item) const;
 
     VHistoryEntry *getHistoryEntry(const QListWidgetItem *p_item) const;
@@ -87,6 +102,9 @@ private:
     // New files are appended to the end.
     QLinkedList<VHistoryEntry> m_histories;
 
+    // Index of @m_histories by path.
+    QHash<QString, QLinkedList<VHistoryEntry>::iterator> m_index;
+
     // Whether we need to update the list.
     bool m_updatePending;
 
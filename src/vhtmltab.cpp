@@ -7,6 +7,7 @@
 #include "vnotebook.h"
 #include "dialog/vfindreplacedialog.h"
 #include "veditarea.h"
+#include "vsearch.h"
 #include "vconstants.h"
 
 extern VConfigManager *g_config;
@@ -33,6 +34,10 @@ void VHtmlTab::setupUI()
     m_editor = new VEdit(m_file, this);
     connect(m_editor, &VEdit::textChanged,
             this, &VHtmlTab::updateStatus);
+    connect(m_editor, &VEdit::textChanged,
+            this, []() {
+                VSearchRefiner::notesChanged();
+            });
     connect(m_editor, &VEdit::saveAndRead,
             this, &VHtmlTab::saveAndRead);
     connect(m_editor, &VEdit::discardAndRead,
@@ -276,6 +281,12 @@ void VHtmlTab::focusChild()
     m_editor->setFocus();
 }
 
+void VHtmlTab::collectMemoryStats(VMemoryStats::Group &p_group) const
+{
+    p_group.add("Content", VMemoryStats::stringBytes(m_file->getContent()));
+    p_group.add("Text document", VMemoryStats::textDocumentBytes(m_editor->document()));
+}
+
 void VHtmlTab::requestUpdateVimStatus()
 {
     m_editor->requestUpdateVimStatus();
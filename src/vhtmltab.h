@@ -55,6 +55,8 @@ public:
 
     void reload() Q_DECL_OVERRIDE;
 
+    void collectMemoryStats(VMemoryStats::Group &p_group) const Q_DECL_OVERRIDE;
+
 public slots:
     // Enter edit mode.
     void editFile() Q_DECL_OVERRIDE;
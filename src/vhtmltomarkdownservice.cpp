@@ -0,0 +1,78 @@
+#include "vhtmltomarkdownservice.h"
+
+#include <QRunnable>
+#include <QCoreApplication>
+
+#include "utils/vhtmltomarkdown.h"
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+class HtmlToMarkdownTask : public QRunnable
+{
+public:
+    HtmlToMarkdownTask(VHtmlToMarkdownService *p_service,
+                       int p_id,
+                       const QString &p_html,
+                       const VHtmlToMarkdown::Config &p_config)
+        : m_service(p_service),
+          m_id(p_id),
+          m_html(p_html),
+          m_config(p_config)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        VHtmlToMarkdown converter(m_config);
+        QString text = converter.convert(m_html);
+
+        // The service waits for all the tasks before destruction.
+        QMetaObject::invokeMethod(m_service,
+                                  "converted",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, m_id),
+                                  Q_ARG(QString, text));
+    }
+
+private:
+    VHtmlToMarkdownService *m_service;
+
+    int m_id;
+
+    QString m_html;
+
+    VHtmlToMarkdown::Config m_config;
+};
+
+
+VHtmlToMarkdownService::VHtmlToMarkdownService(QObject *p_parent)
+    : QObject(p_parent),
+      m_nextId(0)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+VHtmlToMarkdownService::~VHtmlToMarkdownService()
+{
+    m_pool.waitForDone();
+}
+
+VHtmlToMarkdownService *VHtmlToMarkdownService::inst()
+{
+    static VHtmlToMarkdownService *service = new VHtmlToMarkdownService(QCoreApplication::instance());
+    return service;
+}
+
+int VHtmlToMarkdownService::convert(const QString &p_html)
+{
+    // Follow the extensions of markdown-it as the web side does.
+    const MarkdownitOption &opt = g_config->getMarkdownitOption();
+    VHtmlToMarkdown::Config config;
+    config.m_subEnabled = opt.m_sub;
+    config.m_supEnabled = opt.m_sup;
+
+    int id = ++m_nextId;
+    m_pool.start(new HtmlToMarkdownTask(this, id, p_html, config));
+    return id;
+}
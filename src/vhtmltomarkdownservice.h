@@ -0,0 +1,34 @@
+#ifndef VHTMLTOMARKDOWNSERVICE_H
+#define VHTMLTOMARKDOWNSERVICE_H
+
+#include <QObject>
+#include <QString>
+#include <QThreadPool>
+
+// Convert HTML, such as the one to parse and paste, to Markdown on a worker
+// via VHtmlToMarkdown.
+// Should be accessed only in the GUI thread.
+class VHtmlToMarkdownService : public QObject
+{
+    Q_OBJECT
+public:
+    ~VHtmlToMarkdownService();
+
+    static VHtmlToMarkdownService *inst();
+
+    // Queue @p_html to convert.
+    // Returns the ID of the request in converted().
+    int convert(const QString &p_html);
+
+signals:
+    void converted(int p_id, const QString &p_text);
+
+private:
+    explicit VHtmlToMarkdownService(QObject *p_parent = nullptr);
+
+    QThreadPool m_pool;
+
+    int m_nextId;
+};
+
+#endif // VHTMLTOMARKDOWNSERVICE_H
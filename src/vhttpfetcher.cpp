@@ -0,0 +1,118 @@
+#include "vhttpfetcher.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QCoreApplication>
+#include <QStandardPaths>
+#include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
+#include <QNetworkRequest>
+#include <QNetworkReply>
+
+// Max number of running requests to one host.
+#define MAX_REQUESTS_PER_HOST 4
+
+// Max size in bytes of the disk cache.
+#define MAX_DISK_CACHE_SIZE (100 * 1024 * 1024)
+
+VHttpFetcher::VHttpFetcher(QObject *p_parent)
+    : QObject(p_parent)
+{
+    m_manager = new QNetworkAccessManager(this);
+
+    QString cacheFolder = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+    if (!cacheFolder.isEmpty()) {
+        QNetworkDiskCache *cache = new QNetworkDiskCache(this);
+        cache->setCacheDirectory(QDir(cacheFolder).filePath("network"));
+        cache->setMaximumCacheSize(MAX_DISK_CACHE_SIZE);
+        m_manager->setCache(cache);
+    }
+}
+
+VHttpFetcher *VHttpFetcher::inst()
+{
+    static VHttpFetcher *fetcher = new VHttpFetcher(QCoreApplication::instance());
+    return fetcher;
+}
+
+void VHttpFetcher::fetch(const QUrl &p_url)
+{
+    if (!p_url.isValid()) {
+        return;
+    }
+
+    QString key = p_url.toString();
+    if (m_urls.contains(key)) {
+        // Will be notified together.
+        return;
+    }
+
+    m_urls.insert(key);
+
+    QString host = p_url.host();
+    if (m_runningCount.value(host, 0) >= MAX_REQUESTS_PER_HOST) {
+        m_pendingUrls[host].enqueue(p_url);
+        return;
+    }
+
+    startRequest(p_url);
+}
+
+void VHttpFetcher::startRequest(const QUrl &p_url)
+{
+    QNetworkRequest request(p_url);
+    request.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+
+    // Use the cached reply if it is still fresh, or revalidate it.
+    request.setAttribute(QNetworkRequest::CacheLoadControlAttribute,
+                         QNetworkRequest::PreferNetwork);
+    request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, true);
+
+    ++m_runningCount[p_url.host()];
+
+    QNetworkReply *reply = m_manager->get(request);
+    connect(reply, &QNetworkReply::finished,
+            this, &VHttpFetcher::handleReplyFinished);
+}
+
+void VHttpFetcher::handleReplyFinished()
+{
+    QNetworkReply *reply = qobject_cast<QNetworkReply *>(sender());
+    Q_ASSERT(reply);
+    reply->deleteLater();
+
+    if (reply->error() != QNetworkReply::NoError) {
+        qWarning() << "download reply error" << reply->error();
+    }
+
+    // The url() of the reply may be redirected and different from that of the request.
+    QUrl url = reply->request().url();
+    QString host = url.host();
+    if (--m_runningCount[host] <= 0) {
+        m_runningCount.remove(host);
+    }
+
+    QString key = url.toString();
+    m_urls.remove(key);
+
+    startPendingRequests(host);
+
+    emit fetched(reply->readAll(), key);
+}
+
+void VHttpFetcher::startPendingRequests(const QString &p_host)
+{
+    auto it = m_pendingUrls.find(p_host);
+    if (it == m_pendingUrls.end()) {
+        return;
+    }
+
+    while (!it.value().isEmpty()
+           && m_runningCount.value(p_host, 0) < MAX_REQUESTS_PER_HOST) {
+        startRequest(it.value().dequeue());
+    }
+
+    if (it.value().isEmpty()) {
+        m_pendingUrls.erase(it);
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef VHTTPFETCHER_H
+#define VHTTPFETCHER_H
+
+#include <QObject>
+#include <QUrl>
+#include <QByteArray>
+#include <QHash>
+#include <QSet>
+#include <QQueue>
+
+class QNetworkAccessManager;
+class QNetworkReply;
+
+// Shared service to fetch network resources for all the downloaders.
+// Requests of the same URL in flight are merged, replies are kept in a disk
+// cache and revalidated with ETag/Last-Modified, and the number of running
+// requests per host is limited.
+// Should be accessed only in the GUI thread.
+class VHttpFetcher : public QObject
+{
+    Q_OBJECT
+public:
+    static VHttpFetcher *inst();
+
+    // Fetch @p_url asynchronously and emit fetched() when finished.
+    void fetch(const QUrl &p_url);
+
+signals:
+    // @p_url is the original url of the request.
+    void fetched(const QByteArray &p_data, const QString &p_url);
+
+private slots:
+    void handleReplyFinished();
+
+private:
+    explicit VHttpFetcher(QObject *p_parent = nullptr);
+
+    void startRequest(const QUrl &p_url);
+
+    // Start waiting requests of @p_host if there are free slots.
+    void startPendingRequests(const QString &p_host);
+
+    QNetworkAccessManager *m_manager;
+
+    // URLs being fetched or waiting.
+    QSet<QString> m_urls;
+
+    // Host -> URLs waiting for a free slot.
+    QHash<QString, QQueue<QUrl>> m_pendingUrls;
+
+    // Host -> number of running requests.
+    QHash<QString, int> m_runningCount;
+};
+
+#endif // VHTTPFETCHER_H
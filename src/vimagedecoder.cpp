@@ -0,0 +1,140 @@
+#include "vimagedecoder.h"
+
+#include <QDebug>
+#include <QRunnable>
+#include <QFile>
+#include <QCoreApplication>
+
+// Decode one image in the pool.
+class ImageDecodeTask : public QRunnable
+{
+public:
+    ImageDecodeTask(VImageDecoder *p_decoder,
+                    int p_id,
+                    const QString &p_filePath,
+                    int p_width,
+                    int p_height,
+                    qreal p_scaleFactor)
+        : m_decoder(p_decoder),
+          m_id(p_id),
+          m_filePath(p_filePath),
+          m_width(p_width),
+          m_height(p_height),
+          m_scaleFactor(p_scaleFactor)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        QImage image = VImageDecoder::decodeFile(m_filePath, m_width, m_height, m_scaleFactor);
+
+        // The decoder waits for all the tasks before destruction.
+        QMetaObject::invokeMethod(m_decoder,
+                                  "imageDecoded",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, m_id),
+                                  Q_ARG(QImage, image));
+    }
+
+private:
+    VImageDecoder *m_decoder;
+
+    int m_id;
+
+    QString m_filePath;
+
+    int m_width;
+
+    int m_height;
+
+    qreal m_scaleFactor;
+};
+
+
+VImageDecoder::VImageDecoder(QObject *p_parent)
+    : QObject(p_parent),
+      m_nextId(0)
+{
+}
+
+VImageDecoder::~VImageDecoder()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+VImageDecoder *VImageDecoder::inst()
+{
+    static VImageDecoder *decoder = new VImageDecoder(QCoreApplication::instance());
+    return decoder;
+}
+
+int VImageDecoder::decode(const QString &p_filePath,
+                          int p_width,
+                          int p_height,
+                          qreal p_scaleFactor)
+{
+    int id = ++m_nextId;
+    m_pool.start(new ImageDecodeTask(this, id, p_filePath, p_width, p_height, p_scaleFactor));
+    return id;
+}
+
+QSize VImageDecoder::scaledSize(const QSize &p_size, int p_width, int p_height, qreal p_scaleFactor)
+{
+    if (p_size.isEmpty()) {
+        return p_size;
+    }
+
+    if (p_width > 0) {
+        if (p_height > 0) {
+            return QSize(p_width * p_scaleFactor, p_height * p_scaleFactor);
+        } else {
+            int width = p_width * p_scaleFactor;
+            return QSize(width, qMax(1, qRound((qreal)p_size.height() * width / p_size.width())));
+        }
+    } else if (p_height > 0) {
+        int height = p_height * p_scaleFactor;
+        return QSize(qMax(1, qRound((qreal)p_size.width() * height / p_size.height())), height);
+    } else {
+        if (p_scaleFactor < 1.1) {
+            return p_size;
+        } else {
+            int width = p_size.width() * p_scaleFactor;
+            return QSize(width, qMax(1, qRound((qreal)p_size.height() * width / p_size.width())));
+        }
+    }
+}
+
+QImage VImageDecoder::scaleImage(const QImage &p_image,
+                                 int p_width,
+                                 int p_height,
+                                 qreal p_scaleFactor)
+{
+    QSize size = scaledSize(p_image.size(), p_width, p_height, p_scaleFactor);
+    if (size == p_image.size()) {
+        return p_image;
+    }
+
+    return p_image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+}
+
+QImage VImageDecoder::decodeFile(const QString &p_filePath,
+                                 int p_width,
+                                 int p_height,
+                                 qreal p_scaleFactor)
+{
+    QImage image;
+    QFile file(p_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "fail to open image file" << p_filePath;
+        return image;
+    }
+
+    image.loadFromData(file.readAll());
+    if (image.isNull()) {
+        qWarning() << "fail to decode image file" << p_filePath;
+        return image;
+    }
+
+    return scaleImage(image, p_width, p_height, p_scaleFactor);
+}
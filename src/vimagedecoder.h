@@ -0,0 +1,51 @@
+#ifndef VIMAGEDECODER_H
+#define VIMAGEDECODER_H
+
+#include <QObject>
+#include <QImage>
+#include <QSize>
+#include <QString>
+#include <QThreadPool>
+
+// Decode and scale images of local files on a worker pool for in-place preview.
+// Should be accessed only in the GUI thread.
+class VImageDecoder : public QObject
+{
+    Q_OBJECT
+public:
+    ~VImageDecoder();
+
+    static VImageDecoder *inst();
+
+    // Decode @p_filePath and scale it to scaledSize().
+    // Returns the ID of the request in imageDecoded().
+    int decode(const QString &p_filePath, int p_width, int p_height, qreal p_scaleFactor);
+
+    // Size of image of @p_size scaled for preview.
+    // @p_width and @p_height are the size specified in the link, -1 for not specified.
+    static QSize scaledSize(const QSize &p_size, int p_width, int p_height, qreal p_scaleFactor);
+
+    static QImage scaleImage(const QImage &p_image,
+                             int p_width,
+                             int p_height,
+                             qreal p_scaleFactor);
+
+    // Decode and scale synchronously.
+    static QImage decodeFile(const QString &p_filePath,
+                             int p_width,
+                             int p_height,
+                             qreal p_scaleFactor);
+
+signals:
+    // Null @p_image if it fails to decode.
+    void imageDecoded(int p_id, const QImage &p_image);
+
+private:
+    explicit VImageDecoder(QObject *p_parent = nullptr);
+
+    QThreadPool m_pool;
+
+    int m_nextId;
+};
+
+#endif // VIMAGEDECODER_H
@@ -0,0 +1,240 @@
+#include "vimagededuper.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QCryptographicHash>
+#include <QRegularExpression>
+
+#include "vnotebook.h"
+#include "vdirectory.h"
+#include "vnotefile.h"
+#include "vrecyclebin.h"
+#include "utils/vutils.h"
+
+// Hash of the content of @p_filePath, or empty if it fails to read.
+static QByteArray fileHash(const QString &p_filePath)
+{
+    QFile file(p_filePath);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qWarning() << "fail to read image" << p_filePath;
+        return QByteArray();
+    }
+
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    if (!hash.addData(&file)) {
+        return QByteArray();
+    }
+
+    return hash.result();
+}
+
+bool VImageDeduper::dedupe(VNotebook *p_notebook, Result &p_result, QString *p_errMsg)
+{
+    if (!p_notebook->isOpened() && !p_notebook->open()) {
+        VUtils::addErrMsg(p_errMsg, QObject::tr("Fail to open notebook %1.").arg(p_notebook->getName()));
+        return false;
+    }
+
+    bool ret = true;
+
+    // Image folder key -> notes using it.
+    // A notebook with an absolute image folder shares it among all the folders.
+    QVector<QString> folders;
+    QHash<QString, QVector<VNoteFile *>> notesOfFolder;
+    QVector<VDirectory *> dirs;
+    dirs.append(p_notebook->getRootDir());
+    for (int i = 0; i < dirs.size(); ++i) {
+        VDirectory *dir = dirs[i];
+        if (!dir->open()) {
+            VUtils::addErrMsg(p_errMsg, QObject::tr("Fail to open folder %1.").arg(dir->fetchPath()));
+            ret = false;
+            continue;
+        }
+
+        dirs += dir->getSubDirs();
+
+        if (dir->getFiles().isEmpty()) {
+            continue;
+        }
+
+        QString folderPath = QDir(dir->fetchPath()).filePath(p_notebook->getImageFolder());
+        QString key = VNoteFile::imagePathKey(folderPath);
+        auto it = notesOfFolder.find(key);
+        if (it == notesOfFolder.end()) {
+            folders.append(QDir::cleanPath(folderPath));
+            it = notesOfFolder.insert(key, QVector<VNoteFile *>());
+        }
+
+        for (auto file : dir->getFiles()) {
+            if (file->getDocType() == DocType::Markdown) {
+                it.value().append(file);
+            }
+        }
+    }
+
+    for (auto const & folder : folders) {
+        if (!QFileInfo(folder).isDir()) {
+            continue;
+        }
+
+        if (!dedupeFolder(p_notebook,
+                          folder,
+                          notesOfFolder.value(VNoteFile::imagePathKey(folder)),
+                          p_result)) {
+            VUtils::addErrMsg(p_errMsg, QObject::tr("Skip image folder %1.").arg(folder));
+            ret = false;
+        }
+    }
+
+    return ret;
+}
+
+bool VImageDeduper::dedupeFolder(VNotebook *p_notebook,
+                                 const QString &p_folderPath,
+                                 const QVector<VNoteFile *> &p_notes,
+                                 Result &p_result)
+{
+    // Notes being edited hold their content in memory.
+    for (auto note : p_notes) {
+        if (note->isOpened()) {
+            p_result.m_skippedFolders.append(p_folderPath);
+            return false;
+        }
+    }
+
+    // Only files of the same size could be identical.
+    QHash<qint64, QStringList> namesOfSize;
+    QFileInfoList entries = QDir(p_folderPath).entryInfoList(QDir::Files | QDir::NoSymLinks,
+                                                            QDir::Name);
+    for (auto const & entry : entries) {
+        namesOfSize[entry.size()].append(entry.fileName());
+    }
+
+    // Duplicate file name -> kept file name.
+    QHash<QString, QString> keptNames;
+    qint64 bytesFreed = 0;
+    QDir dir(p_folderPath);
+    for (auto it = namesOfSize.constBegin(); it != namesOfSize.constEnd(); ++it) {
+        if (it.value().size() < 2) {
+            continue;
+        }
+
+        QHash<QByteArray, QStringList> namesOfHash;
+        for (auto const & name : it.value()) {
+            QByteArray hash = fileHash(dir.filePath(name));
+            if (!hash.isEmpty()) {
+                namesOfHash[hash].append(name);
+            }
+        }
+
+        for (auto hit = namesOfHash.constBegin(); hit != namesOfHash.constEnd(); ++hit) {
+            const QStringList &names = hit.value();
+            if (names.size() < 2) {
+                continue;
+            }
+
+            // Prefer the one already named by content.
+            QString hex = QString::fromLatin1(hit.key().toHex());
+            QString kept = names.first();
+            for (auto const & name : names) {
+                if (QFileInfo(name).completeBaseName() == hex) {
+                    kept = name;
+                    break;
+                }
+            }
+
+            for (auto const & name : names) {
+                if (name != kept) {
+                    keptNames.insert(name, kept);
+                    bytesFreed += it.key();
+                }
+            }
+        }
+    }
+
+    if (keptNames.isEmpty()) {
+        return true;
+    }
+
+    // Update the notes before removing any image.
+    int nrNotesUpdated = 0;
+    for (auto note : p_notes) {
+        QString filePath = note->fetchPath();
+        QString content = VUtils::readFileFromDisk(filePath);
+        if (updateImageLinks(content, note->fetchBasePath(), p_folderPath, keptNames) == 0) {
+            continue;
+        }
+
+        if (!VUtils::writeFileToDisk(filePath, content)) {
+            qWarning() << "fail to update image links of note" << filePath;
+            p_result.m_skippedFolders.append(p_folderPath);
+            p_result.m_nrNotesUpdated += nrNotesUpdated;
+            return false;
+        }
+
+        ++nrNotesUpdated;
+    }
+
+    QStringList paths;
+    for (auto it = keptNames.constBegin(); it != keptNames.constEnd(); ++it) {
+        paths.append(dir.filePath(it.key()));
+    }
+
+    VRecycleBin::recycle(p_notebook->getRecycleBinFolderPath(), paths);
+
+    p_result.m_nrImagesRemoved += paths.size();
+    p_result.m_bytesFreed += bytesFreed;
+    p_result.m_nrNotesUpdated += nrNotesUpdated;
+    return true;
+}
+
+int VImageDeduper::updateImageLinks(QString &p_content,
+                                    const QString &p_basePath,
+                                    const QString &p_folderPath,
+                                    const QHash<QString, QString> &p_keptNames)
+{
+    static const QRegularExpression regExp(VUtils::c_imageLinkRegExp);
+
+    const QString folderKey = VNoteFile::imagePathKey(p_folderPath);
+    QString content;
+    int nr = 0;
+    int pos = 0;
+    QRegularExpressionMatchIterator it = regExp.globalMatch(p_content);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        QString url = match.captured(2);
+        if (!QDir::isRelativePath(url)) {
+            continue;
+        }
+
+        QString path = VUtils::linkUrlToPath(p_basePath, url);
+        if (path.isEmpty()
+            || VNoteFile::imagePathKey(VUtils::basePathFromPath(path)) != folderKey) {
+            continue;
+        }
+
+        auto kit = p_keptNames.constFind(VUtils::fileNameFromPath(path));
+        if (kit == p_keptNames.constEnd()) {
+            continue;
+        }
+
+        // Replace the file name part and keep the rest of the url.
+        QString purified = VUtils::purifyUrl(url);
+        QString newUrl = purified.left(purified.lastIndexOf('/') + 1)
+                         + VUtils::encodeSpacesInPath(kit.value())
+                         + url.mid(purified.size());
+
+        content += p_content.mid(pos, match.capturedStart(2) - pos) + newUrl;
+        pos = match.capturedEnd(2);
+        ++nr;
+    }
+
+    if (nr > 0) {
+        content += p_content.mid(pos);
+        p_content = content;
+    }
+
+    return nr;
+}
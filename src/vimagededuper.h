@@ -0,0 +1,61 @@
+#ifndef VIMAGEDEDUPER_H
+#define VIMAGEDEDUPER_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QVector>
+
+class VNotebook;
+class VNoteFile;
+
+// Merge identical images in the image folders of a notebook into one file,
+// updating the image links of the notes, to migrate a notebook to naming
+// images by content.
+// Duplicates are moved into the recycle bin of the notebook.
+class VImageDeduper
+{
+public:
+    struct Result
+    {
+        Result()
+            : m_nrImagesRemoved(0),
+              m_bytesFreed(0),
+              m_nrNotesUpdated(0)
+        {
+        }
+
+        int m_nrImagesRemoved;
+
+        qint64 m_bytesFreed;
+
+        int m_nrNotesUpdated;
+
+        // Image folders skipped because some of their notes are being edited
+        // or could not be updated.
+        QStringList m_skippedFolders;
+    };
+
+    // Open all the folders of @p_notebook and dedupe its image folders.
+    // Returns false if some folders fail to open or are skipped.
+    static bool dedupe(VNotebook *p_notebook, Result &p_result, QString *p_errMsg = NULL);
+
+private:
+    VImageDeduper() {}
+
+    // Dedupe image folder @p_folderPath used by notes @p_notes.
+    static bool dedupeFolder(VNotebook *p_notebook,
+                             const QString &p_folderPath,
+                             const QVector<VNoteFile *> &p_notes,
+                             Result &p_result);
+
+    // Point the links of @p_content to images in @p_folderPath to their kept
+    // copies in @p_keptNames: duplicate file name -> kept file name.
+    // Returns the number of links updated.
+    static int updateImageLinks(QString &p_content,
+                                const QString &p_basePath,
+                                const QString &p_folderPath,
+                                const QHash<QString, QString> &p_keptNames);
+};
+
+#endif // VIMAGEDEDUPER_H
@@ -0,0 +1,159 @@
+#include "vimageencoder.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QRunnable>
+#include <QSaveFile>
+#include <QImageWriter>
+#include <QPainter>
+#include <QCoreApplication>
+
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Encode and write one image in the pool.
+class ImageEncodeTask : public QRunnable
+{
+public:
+    ImageEncodeTask(VImageEncoder *p_encoder,
+                    int p_id,
+                    const QString &p_filePath,
+                    const QImage &p_image,
+                    const QString &p_format,
+                    int p_quality)
+        : m_encoder(p_encoder),
+          m_id(p_id),
+          m_filePath(p_filePath),
+          m_image(p_image),
+          m_format(p_format),
+          m_quality(p_quality)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        bool succ = write();
+
+        // The encoder waits for all the tasks before destruction.
+        QMetaObject::invokeMethod(m_encoder,
+                                  "handleImageSaved",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, m_id),
+                                  Q_ARG(QString, m_filePath),
+                                  Q_ARG(bool, succ));
+    }
+
+private:
+    bool write()
+    {
+        QImage image = m_image;
+        if (image.hasAlphaChannel() && (m_format == "jpg" || m_format == "jpeg")) {
+            // JPEG has no alpha. Compose it on white instead of black.
+            QImage opaque(image.size(), QImage::Format_RGB32);
+            opaque.fill(Qt::white);
+            QPainter painter(&opaque);
+            painter.drawImage(0, 0, image);
+            painter.end();
+            image = opaque;
+        }
+
+        // Readers will not see a partial file.
+        QSaveFile file(m_filePath);
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning() << "fail to open image file" << m_filePath << "to write";
+            return false;
+        }
+
+        QImageWriter writer(&file, m_format.toLatin1());
+        if (m_quality >= 0) {
+            writer.setQuality(m_quality);
+        }
+
+        if (!writer.write(image)) {
+            qWarning() << "fail to encode image" << m_filePath << writer.errorString();
+            file.cancelWriting();
+            return false;
+        }
+
+        return file.commit();
+    }
+
+    VImageEncoder *m_encoder;
+
+    int m_id;
+
+    QString m_filePath;
+
+    QImage m_image;
+
+    QString m_format;
+
+    int m_quality;
+};
+
+
+VImageEncoder::VImageEncoder(QObject *p_parent)
+    : QObject(p_parent),
+      m_nextId(0)
+{
+}
+
+VImageEncoder::~VImageEncoder()
+{
+    // Finish all the writes to not lose the images.
+    m_pool.waitForDone();
+}
+
+VImageEncoder *VImageEncoder::inst()
+{
+    static VImageEncoder *encoder = new VImageEncoder(QCoreApplication::instance());
+    return encoder;
+}
+
+QString VImageEncoder::saveFormat()
+{
+    QString format = g_config->getImageSaveFormat();
+    if (format == "jpeg") {
+        format = "jpg";
+    }
+
+    if (!QImageWriter::supportedImageFormats().contains(format.toLatin1())) {
+        qWarning() << "image format to save is not supported" << format;
+        format = "png";
+    }
+
+    return format;
+}
+
+int VImageEncoder::save(const QString &p_filePath,
+                        const QImage &p_image,
+                        const QString &p_format,
+                        int p_quality)
+{
+    int id = ++m_nextId;
+    m_pendingImages.insert(QDir::cleanPath(p_filePath), p_image);
+    m_pool.start(new ImageEncodeTask(this, id, p_filePath, p_image, p_format, p_quality));
+    return id;
+}
+
+QImage VImageEncoder::pendingImage(const QString &p_filePath) const
+{
+    if (m_pendingImages.isEmpty()) {
+        return QImage();
+    }
+
+    return m_pendingImages.value(QDir::cleanPath(p_filePath));
+}
+
+void VImageEncoder::waitForDone()
+{
+    m_pool.waitForDone();
+}
+
+void VImageEncoder::handleImageSaved(int p_id, const QString &p_filePath, bool p_succeeded)
+{
+    m_pendingImages.remove(QDir::cleanPath(p_filePath));
+
+    emit imageSaved(p_id, p_filePath, p_succeeded);
+}
@@ -0,0 +1,56 @@
+#ifndef VIMAGEENCODER_H
+#define VIMAGEENCODER_H
+
+#include <QObject>
+#include <QImage>
+#include <QString>
+#include <QHash>
+#include <QThreadPool>
+
+// Encode and write images, such as the pasted screenshots, on a worker pool.
+// Images being written are kept in memory to preview until they land.
+// Should be accessed only in the GUI thread.
+class VImageEncoder : public QObject
+{
+    Q_OBJECT
+public:
+    ~VImageEncoder();
+
+    static VImageEncoder *inst();
+
+    // Configured format to save images in, or png if it is not supported.
+    static QString saveFormat();
+
+    // Write @p_image to @p_filePath in @p_format via a temporary file.
+    // @p_quality: quality of lossy formats, -1 for the default.
+    // Returns the ID of the request in imageSaved().
+    int save(const QString &p_filePath,
+             const QImage &p_image,
+             const QString &p_format,
+             int p_quality = -1);
+
+    // The image being written to @p_filePath, or a null image.
+    QImage pendingImage(const QString &p_filePath) const;
+
+    // Wait for all the writes to finish.
+    // Completions are still delivered via imageSaved() later.
+    void waitForDone();
+
+signals:
+    void imageSaved(int p_id, const QString &p_filePath, bool p_succeeded);
+
+private slots:
+    void handleImageSaved(int p_id, const QString &p_filePath, bool p_succeeded);
+
+private:
+    explicit VImageEncoder(QObject *p_parent = nullptr);
+
+    QThreadPool m_pool;
+
+    int m_nextId;
+
+    // Cleaned file path -> image being written.
+    QHash<QString, QImage> m_pendingImages;
+};
+
+#endif // VIMAGEENCODER_H
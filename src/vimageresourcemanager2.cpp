@@ -1,14 +1,63 @@
 #include "vimageresourcemanager2.h"
 
+#include <QDebug>
+
 
 VImageResourceManager2::VImageResourceManager2()
+    : m_totalBytes(0)
+{
+}
+
+VImageResourceManager2::~VImageResourceManager2()
+{
+    clear();
+}
+
+void VImageResourceManager2::resetEntry(ImageEntry &p_entry)
+{
+    if (!p_entry.m_sharedKey.isEmpty()) {
+        VSharedImageCache::release(p_entry.m_sharedKey);
+        p_entry.m_sharedKey.clear();
+    }
+
+    m_totalBytes -= p_entry.m_bytes;
+    p_entry.m_image = QPixmap();
+    p_entry.m_levels.clear();
+    p_entry.m_bytes = 0;
+}
+
+void VImageResourceManager2::addImage(const QString &p_name, const QPixmap &p_image)
+{
+    ImageEntry &entry = m_images[p_name];
+    resetEntry(entry);
+
+    entry.m_image = p_image;
+    entry.m_size = p_image.size();
+    entry.m_bytes = VSharedImageCache::imageBytes(p_image);
+    m_totalBytes += entry.m_bytes;
+}
+
+void VImageResourceManager2::addSharedImage(const QString &p_name,
+                                            const QString &p_key,
+                                            const QPixmap &p_image,
+                                            const ImageLoaderFunc &p_loader)
 {
+    Q_ASSERT(!p_key.isEmpty());
+    ImageEntry &entry = m_images[p_name];
+    // Acquire before releasing in case it references @p_key already.
+    VSharedImageCache::acquire(p_key, p_image, p_loader);
+    resetEntry(entry);
+
+    entry.m_sharedKey = p_key;
+    entry.m_size = VSharedImageCache::imageSize(p_key);
 }
 
-void VImageResourceManager2::addImage(const QString &p_name,
-                                      const QPixmap &p_image)
+void VImageResourceManager2::addPlaceholder(const QString &p_name, const QSize &p_size)
 {
-    m_images.insert(p_name, p_image);
+    ImageEntry &entry = m_images[p_name];
+    resetEntry(entry);
+
+    entry.m_size = p_size;
 }
 
 bool VImageResourceManager2::contains(const QString &p_name) const
@@ -16,22 +65,71 @@ bool VImageResourceManager2::contains(const QString &p_name) const
     return m_images.contains(p_name);
 }
 
-const QPixmap *VImageResourceManager2::findImage(const QString &p_name) const
+QSize VImageResourceManager2::imageSize(const QString &p_name) const
 {
     auto it = m_images.find(p_name);
     if (it != m_images.end()) {
-        return &it.value();
+        return it.value().m_size;
+    }
+
+    return QSize();
+}
+
+const QPixmap *VImageResourceManager2::findImage(const QString &p_name) const
+{
+    return findImage(p_name, QSize());
+}
+
+const QPixmap *VImageResourceManager2::findImage(const QString &p_name,
+                                                const QSize &p_targetSize) const
+{
+    auto it = m_images.find(p_name);
+    if (it == m_images.end()) {
+        return NULL;
+    }
+
+    ImageEntry &entry = it.value();
+    if (!entry.m_sharedKey.isEmpty()) {
+        return VSharedImageCache::findImage(entry.m_sharedKey, p_targetSize);
+    }
+
+    if (entry.m_image.isNull()) {
+        return NULL;
+    }
+
+    if (p_targetSize.isEmpty()) {
+        return &entry.m_image;
     }
 
-    return NULL;
+    qint64 addedBytes = 0;
+    const QPixmap *image = VSharedImageCache::findLevel(entry.m_image,
+                                                        entry.m_levels,
+                                                        p_targetSize,
+                                                        addedBytes);
+    entry.m_bytes += addedBytes;
+    m_totalBytes += addedBytes;
+    return image;
 }
 
 void VImageResourceManager2::clear()
 {
+    for (auto it = m_images.begin(); it != m_images.end(); ++it) {
+        if (!it.value().m_sharedKey.isEmpty()) {
+            VSharedImageCache::release(it.value().m_sharedKey);
+        }
+    }
+
     m_images.clear();
+    m_totalBytes = 0;
 }
 
 void VImageResourceManager2::removeImage(const QString &p_name)
 {
-    m_images.remove(p_name);
+    auto it = m_images.find(p_name);
+    if (it == m_images.end()) {
+        return;
+    }
+
+    resetEntry(it.value());
+    m_images.erase(it);
 }
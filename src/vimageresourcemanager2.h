@@ -4,30 +4,94 @@
 #include <QHash>
 #include <QString>
 #include <QPixmap>
+#include <QSize>
+#include <QVector>
 
+#include "vsharedimagecache.h"
 
+// Images resources of an editor.
+// Preview images of local files are referenced in VSharedImageCache, which
+// keeps one copy of each image for all the editors and evicts them within a
+// global limit. Other images are owned by the editor.
 class VImageResourceManager2
 {
 public:
     VImageResourceManager2();
 
+    ~VImageResourceManager2();
+
     // Add an image to the resource with @p_name as the key.
     // If @p_name already exists in the resources, it will update it.
     void addImage(const QString &p_name, const QPixmap &p_image);
 
+    // Add image @p_name referencing image @p_key in VSharedImageCache.
+    // @p_image and @p_loader are used if @p_key is not cached yet.
+    void addSharedImage(const QString &p_name,
+                        const QString &p_key,
+                        const QPixmap &p_image,
+                        const ImageLoaderFunc &p_loader);
+
+    // Add a placeholder of @p_size for image @p_name which is not ready yet.
+    // findImage() returns NULL for it until addImage().
+    void addPlaceholder(const QString &p_name, const QSize &p_size);
+
     // Remove image @p_name.
     void removeImage(const QString &p_name);
 
     // Whether the resources contains image with name @p_name.
+    // True for evicted images too.
     bool contains(const QString &p_name) const;
 
+    // Size of image @p_name without reloading it.
+    QSize imageSize(const QString &p_name) const;
+
+    // Reload the image if it is evicted.
     const QPixmap *findImage(const QString &p_name) const;
 
+    // Get the image or its down-scaled level closest to but not smaller than
+    // @p_targetSize. Levels are generated on demand and cached.
+    const QPixmap *findImage(const QString &p_name, const QSize &p_targetSize) const;
+
     void clear();
 
+    // Bytes of the images owned by this editor, excluding the shared ones.
+    qint64 totalBytes() const;
+
 private:
+    struct ImageEntry
+    {
+        ImageEntry()
+            : m_bytes(0)
+        {
+        }
+
+        // Key in VSharedImageCache if it is a shared image.
+        QString m_sharedKey;
+
+        QPixmap m_image;
+
+        // Down-scaled levels of @m_image.
+        QVector<QPixmap> m_levels;
+
+        QSize m_size;
+
+        // Bytes of @m_image and @m_levels.
+        qint64 m_bytes;
+    };
+
+    // Drop the image or the reference of @p_entry.
+    void resetEntry(ImageEntry &p_entry);
+
     // All the images resources.
-    QHash<QString, QPixmap> m_images;
+    // Mutable to generate levels in findImage().
+    mutable QHash<QString, ImageEntry> m_images;
+
+    mutable qint64 m_totalBytes;
 };
 
+inline qint64 VImageResourceManager2::totalBytes() const
+{
+    return m_totalBytes;
+}
+
 #endif // VIMAGERESOURCEMANAGER2_H
@@ -0,0 +1,178 @@
+#include "vindexedsearchengine.h"
+
+#include <QDebug>
+#include <QHash>
+
+#include "vsearchengine.h"
+#include "vsearchindex.h"
+
+VSearchIndexWorker::VSearchIndexWorker(QObject *p_parent)
+    : QThread(p_parent),
+      m_stop(0),
+      m_state(VSearchState::Idle)
+{
+}
+
+void VSearchIndexWorker::setData(const QVector<QPair<QSharedPointer<VSearchIndex>, QStringList>> &p_groups,
+                                 const VSearchToken &p_token)
+{
+    m_groups = p_groups;
+    m_token = p_token;
+}
+
+void VSearchIndexWorker::stop()
+{
+    m_stop.store(1);
+}
+
+void VSearchIndexWorker::run()
+{
+    m_state = VSearchState::Busy;
+    m_candidates.clear();
+
+    for (auto const & group : m_groups) {
+        const QSharedPointer<VSearchIndex> &index = group.first;
+        if (!index) {
+            // Not within any notebook.
+            m_candidates.append(group.second);
+            continue;
+        }
+
+        for (auto const & file : group.second) {
+            if (m_stop.load() == 1) {
+                m_state = VSearchState::Cancelled;
+                return;
+            }
+
+            index->refreshFile(file);
+        }
+
+        m_candidates.append(index->filterCandidates(m_token, group.second));
+
+        index->save();
+    }
+
+    m_state = VSearchState::Success;
+}
+
+
+VIndexedSearchEngine::VIndexedSearchEngine(QObject *p_parent)
+    : ISearchEngine(p_parent),
+      m_indexWorker(NULL),
+      m_scanEngine(NULL)
+{
+}
+
+VIndexedSearchEngine::~VIndexedSearchEngine()
+{
+    stop();
+
+    clear();
+}
+
+void VIndexedSearchEngine::search(const QSharedPointer<VSearchConfig> &p_config,
+                                  const QSharedPointer<VSearchResult> &p_result)
+{
+    m_config = p_config;
+    m_result = p_result;
+
+    const QStringList &items = m_result->m_secondPhaseItems;
+    Q_ASSERT(!items.isEmpty());
+
+    if (!VSearchIndex::canAnswer(p_config->m_contentToken)) {
+        qDebug() << "index could not answer the token, fall back to scan";
+        scan(items);
+        return;
+    }
+
+    // Group files by notebook in GUI thread.
+    QVector<QPair<QSharedPointer<VSearchIndex>, QStringList>> groups;
+    QHash<VSearchIndex *, int> groupIdx;
+    for (auto const & item : items) {
+        QSharedPointer<VSearchIndex> index = VSearchIndexManager::indexForFile(item);
+        auto it = groupIdx.constFind(index.data());
+        if (it == groupIdx.constEnd()) {
+            groupIdx.insert(index.data(), groups.size());
+            groups.append(qMakePair(index, QStringList(item)));
+        } else {
+            groups[it.value()].second.append(item);
+        }
+    }
+
+    clearIndexWorker();
+    m_indexWorker = new VSearchIndexWorker(this);
+    m_indexWorker->setData(groups, p_config->m_contentToken);
+    connect(m_indexWorker, &VSearchIndexWorker::finished,
+            this, &VIndexedSearchEngine::handleIndexWorkerFinished);
+    m_indexWorker->start();
+}
+
+void VIndexedSearchEngine::handleIndexWorkerFinished()
+{
+    Q_ASSERT(m_indexWorker && m_indexWorker->isFinished());
+
+    VSearchState state = m_indexWorker->m_state;
+    QStringList candidates = m_indexWorker->m_candidates;
+    m_indexWorker->deleteLater();
+    m_indexWorker = NULL;
+
+    qDebug() << "index pruned files" << m_result->m_secondPhaseItems.size()
+             << "to" << candidates.size();
+
+    if (state == VSearchState::Success && !candidates.isEmpty()) {
+        scan(candidates);
+        return;
+    }
+
+    m_result->m_state = state;
+    emit finished(m_result);
+}
+
+void VIndexedSearchEngine::scan(const QStringList &p_files)
+{
+    if (!m_scanEngine) {
+        m_scanEngine = new VSearchEngine(this);
+        connect(m_scanEngine, &ISearchEngine::finished,
+                this, &ISearchEngine::finished);
+        connect(m_scanEngine, &ISearchEngine::resultItemsAdded,
+                this, &ISearchEngine::resultItemsAdded);
+    }
+
+    m_result->m_secondPhaseItems = p_files;
+    m_scanEngine->search(m_config, m_result);
+}
+
+void VIndexedSearchEngine::stop()
+{
+    qDebug() << "VIndexedSearchEngine asked to stop";
+    if (m_indexWorker) {
+        m_indexWorker->stop();
+    }
+
+    if (m_scanEngine) {
+        m_scanEngine->stop();
+    }
+}
+
+void VIndexedSearchEngine::clear()
+{
+    clearIndexWorker();
+
+    if (m_scanEngine) {
+        m_scanEngine->clear();
+    }
+
+    m_config.clear();
+    m_result.clear();
+}
+
+void VIndexedSearchEngine::clearIndexWorker()
+{
+    if (m_indexWorker) {
+        m_indexWorker->stop();
+        m_indexWorker->wait();
+
+        delete m_indexWorker;
+        m_indexWorker = NULL;
+    }
+}
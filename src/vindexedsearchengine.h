@@ -0,0 +1,81 @@
+#ifndef VINDEXEDSEARCHENGINE_H
+#define VINDEXEDSEARCHENGINE_H
+
+#include "isearchengine.h"
+
+#include <QThread>
+#include <QAtomicInt>
+#include <QVector>
+#include <QPair>
+
+#include "vsearchconfig.h"
+
+class VSearchIndex;
+class VSearchEngine;
+
+// Refresh the indexes and compute the candidate files.
+class VSearchIndexWorker : public QThread
+{
+    Q_OBJECT
+
+    friend class VIndexedSearchEngine;
+
+public:
+    explicit VSearchIndexWorker(QObject *p_parent = nullptr);
+
+    void setData(const QVector<QPair<QSharedPointer<VSearchIndex>, QStringList>> &p_groups,
+                 const VSearchToken &p_token);
+
+public slots:
+    void stop();
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QAtomicInt m_stop;
+
+    QVector<QPair<QSharedPointer<VSearchIndex>, QStringList>> m_groups;
+
+    VSearchToken m_token;
+
+    VSearchState m_state;
+
+    QStringList m_candidates;
+};
+
+
+// Search engine using the persistent index of notebooks to prune the files
+// before scanning them with VSearchEngine.
+// Falls back to scanning all the files for tokens the index could not answer.
+class VIndexedSearchEngine : public ISearchEngine
+{
+    Q_OBJECT
+public:
+    explicit VIndexedSearchEngine(QObject *p_parent = nullptr);
+
+    ~VIndexedSearchEngine();
+
+    void search(const QSharedPointer<VSearchConfig> &p_config,
+                const QSharedPointer<VSearchResult> &p_result) Q_DECL_OVERRIDE;
+
+    void stop() Q_DECL_OVERRIDE;
+
+    void clear() Q_DECL_OVERRIDE;
+
+private slots:
+    void handleIndexWorkerFinished();
+
+private:
+    void scan(const QStringList &p_files);
+
+    void clearIndexWorker();
+
+    QSharedPointer<VSearchConfig> m_config;
+
+    VSearchIndexWorker *m_indexWorker;
+
+    VSearchEngine *m_scanEngine;
+};
+
+#endif // VINDEXEDSEARCHENGINE_H
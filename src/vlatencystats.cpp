@@ -0,0 +1,155 @@
+#include "vlatencystats.h"
+
+#include <QDateTime>
+
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+#define NUM_OF_BUCKETS 24
+
+QList<VLatencyStats *> VLatencyStats::s_allStats;
+
+VLatencyStats::Histogram::Histogram()
+    : m_count(0),
+      m_total(0),
+      m_max(0)
+{
+    m_buckets.fill(0, NUM_OF_BUCKETS);
+}
+
+void VLatencyStats::Histogram::add(qint64 p_usecs)
+{
+    if (p_usecs < 0) {
+        p_usecs = 0;
+    }
+
+    int idx = 0;
+    qint64 val = p_usecs;
+    while (val > 0 && idx < NUM_OF_BUCKETS - 1) {
+        val >>= 1;
+        ++idx;
+    }
+
+    ++m_buckets[idx];
+    ++m_count;
+    m_total += p_usecs;
+    if (p_usecs > m_max) {
+        m_max = p_usecs;
+    }
+}
+
+VLatencyStats::VLatencyStats(const QString &p_name, QObject *p_parent)
+    : QObject(p_parent),
+      m_name(p_name),
+      m_histograms(Stage::MaxStage)
+{
+    s_allStats.append(this);
+}
+
+VLatencyStats::~VLatencyStats()
+{
+    s_allStats.removeOne(this);
+}
+
+bool VLatencyStats::isEnabled()
+{
+    return g_config->getEnableLatencyStats();
+}
+
+void VLatencyStats::record(Stage p_stage, qint64 p_usecs)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    m_histograms[p_stage].add(p_usecs);
+}
+
+void VLatencyStats::reset()
+{
+    m_histograms.fill(Histogram(), Stage::MaxStage);
+}
+
+QString VLatencyStats::stageName(Stage p_stage)
+{
+    switch (p_stage) {
+    case Stage::KeystrokeToParse:
+        return tr("Keystroke to parse");
+
+    case Stage::Parse:
+        return tr("Parse");
+
+    case Stage::RegionParse:
+        return tr("Region parse");
+
+    case Stage::Highlight:
+        return tr("Highlight");
+
+    case Stage::Relayout:
+        return tr("Relayout");
+
+    default:
+        return QString();
+    }
+}
+
+static QString bucketBound(int p_idx)
+{
+    if (p_idx == 0) {
+        return "0";
+    }
+
+    qint64 usecs = 1LL << (p_idx - 1);
+    if (usecs < 1000) {
+        return QString("%1us").arg(usecs);
+    } else {
+        return QString("%1ms").arg(usecs / 1000.0, 0, 'f', 1);
+    }
+}
+
+QString VLatencyStats::toString() const
+{
+    QString str = QString("== %1 ==\n").arg(m_name);
+    for (int i = 0; i < Stage::MaxStage; ++i) {
+        const Histogram &hist = m_histograms[i];
+        str += QString("%1: count %2").arg(stageName(static_cast<Stage>(i)))
+                                      .arg(hist.m_count);
+        if (hist.m_count == 0) {
+            str += "\n";
+            continue;
+        }
+
+        str += QString(", avg %1us, max %2us\n").arg(hist.m_total / hist.m_count)
+                                                 .arg(hist.m_max);
+        for (int j = 0; j < hist.m_buckets.size(); ++j) {
+            if (hist.m_buckets[j] == 0) {
+                continue;
+            }
+
+            QString upper = j == hist.m_buckets.size() - 1 ? QString("inf") : bucketBound(j + 1);
+            str += QString("    [%1, %2): %3\n").arg(bucketBound(j))
+                                                .arg(upper)
+                                                .arg(hist.m_buckets[j]);
+        }
+    }
+
+    return str;
+}
+
+QString VLatencyStats::report()
+{
+    QString str = QString("VNote latency stats %1\n\n")
+                    .arg(QDateTime::currentDateTime().toString(Qt::ISODate));
+    for (auto const & stats : s_allStats) {
+        str += stats->toString() + "\n";
+    }
+
+    return str;
+}
+
+bool VLatencyStats::dump(const QString &p_filePath)
+{
+    return VUtils::writeFileToDisk(p_filePath, report());
+}
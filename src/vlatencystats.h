@@ -0,0 +1,111 @@
+#ifndef VLATENCYSTATS_H
+#define VLATENCYSTATS_H
+
+#include <QObject>
+#include <QVector>
+#include <QList>
+#include <QString>
+
+// Latency histograms of the parse and highlight stages of one editor.
+// Recording is a no-op unless enabled in the config.
+// Should be accessed only in the GUI thread.
+class VLatencyStats : public QObject
+{
+    Q_OBJECT
+public:
+    enum Stage
+    {
+        // From a content change to the start of the parse.
+        KeystrokeToParse = 0,
+
+        // Markdown to elements.
+        Parse,
+
+        // PegParseResult::parse().
+        RegionParse,
+
+        // Applying highlights to blocks.
+        Highlight,
+
+        // VTextDocumentLayout relayout.
+        Relayout,
+
+        MaxStage
+    };
+
+    // Bucket 0 counts samples below 1 us and bucket i counts samples within
+    // [2^(i-1), 2^i) us. The last bucket counts all the larger samples.
+    struct Histogram
+    {
+        Histogram();
+
+        void add(qint64 p_usecs);
+
+        QVector<int> m_buckets;
+
+        int m_count;
+
+        qint64 m_total;
+
+        qint64 m_max;
+    };
+
+    explicit VLatencyStats(const QString &p_name, QObject *p_parent = nullptr);
+
+    ~VLatencyStats();
+
+    const QString &getName() const;
+
+    void setName(const QString &p_name);
+
+    // Record @p_usecs for @p_stage.
+    void record(Stage p_stage, qint64 p_usecs);
+
+    const Histogram &histogram(Stage p_stage) const;
+
+    void reset();
+
+    // Text report of all the stages.
+    QString toString() const;
+
+    static bool isEnabled();
+
+    // Stats of all the opened editors.
+    static const QList<VLatencyStats *> &allStats();
+
+    static QString stageName(Stage p_stage);
+
+    // Text report of all the opened editors.
+    static QString report();
+
+    // Write report() to @p_filePath.
+    static bool dump(const QString &p_filePath);
+
+private:
+    QString m_name;
+
+    QVector<Histogram> m_histograms;
+
+    static QList<VLatencyStats *> s_allStats;
+};
+
+inline const QString &VLatencyStats::getName() const
+{
+    return m_name;
+}
+
+inline void VLatencyStats::setName(const QString &p_name)
+{
+    m_name = p_name;
+}
+
+inline const VLatencyStats::Histogram &VLatencyStats::histogram(Stage p_stage) const
+{
+    return m_histograms[p_stage];
+}
+
+inline const QList<VLatencyStats *> &VLatencyStats::allStats()
+{
+    return s_allStats;
+}
+#endif // VLATENCYSTATS_H
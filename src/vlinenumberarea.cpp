@@ -2,6 +2,10 @@
 
 #include <QPaintEvent>
 #include <QTextDocument>
+#include <QPainter>
+
+// Max number of rendered numbers to cache.
+#define MAX_CACHED_PIXMAPS 1024
 
 VLineNumberArea::VLineNumberArea(VTextEditWithLineNumber *p_editor,
                                  const QTextDocument *p_document,
@@ -37,3 +41,57 @@ int VLineNumberArea::calculateWidth() const
 
     return m_width;
 }
+
+void VLineNumberArea::drawNumber(QPainter &p_painter, int p_top, int p_number, bool p_bold)
+{
+    p_painter.drawPixmap(0, p_top, numberPixmap(p_number, p_bold));
+}
+
+const QPixmap &VLineNumberArea::numberPixmap(int p_number, bool p_bold)
+{
+    int key = (p_number << 1) | (p_bold ? 1 : 0);
+    auto it = m_pixmaps.find(key);
+    if (it != m_pixmaps.end()) {
+        return it.value();
+    }
+
+    if (m_pixmaps.size() >= MAX_CACHED_PIXMAPS) {
+        m_pixmaps.clear();
+    }
+
+    QFont ft = font();
+    ft.setBold(p_bold);
+    QSize size(width(), QFontMetrics(ft).height());
+
+    qreal ratio = devicePixelRatioF();
+    QPixmap pixmap(size * ratio);
+    pixmap.setDevicePixelRatio(ratio);
+    pixmap.fill(Qt::transparent);
+
+    QPainter painter(&pixmap);
+    painter.setFont(ft);
+    painter.setPen(m_foregroundColor);
+    painter.drawText(QRect(QPoint(0, 0), size),
+                     Qt::AlignRight | Qt::AlignTop,
+                     QString::number(p_number));
+    painter.end();
+
+    return m_pixmaps.insert(key, pixmap).value();
+}
+
+void VLineNumberArea::resizeEvent(QResizeEvent *p_event)
+{
+    QWidget::resizeEvent(p_event);
+
+    // Numbers are aligned to the right.
+    m_pixmaps.clear();
+}
+
+void VLineNumberArea::changeEvent(QEvent *p_event)
+{
+    QWidget::changeEvent(p_event);
+
+    if (p_event->type() == QEvent::FontChange) {
+        m_pixmaps.clear();
+    }
+}
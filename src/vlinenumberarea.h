@@ -3,9 +3,12 @@
 
 #include <QWidget>
 #include <QColor>
+#include <QHash>
+#include <QPixmap>
 
 class QPaintEvent;
 class QTextDocument;
+class QPainter;
 
 
 enum class LineNumberType
@@ -52,13 +55,23 @@ public:
     const QColor &getForegroundColor() const;
     void setForegroundColor(const QColor &p_color);
 
+    // Draw line number @p_number right aligned at @p_top.
+    // Rendered numbers are cached as pixmaps.
+    void drawNumber(QPainter &p_painter, int p_top, int p_number, bool p_bold);
+
 protected:
     void paintEvent(QPaintEvent *p_event) Q_DECL_OVERRIDE
     {
         m_editor->paintLineNumberArea(p_event);
     }
 
+    void resizeEvent(QResizeEvent *p_event) Q_DECL_OVERRIDE;
+
+    void changeEvent(QEvent *p_event) Q_DECL_OVERRIDE;
+
 private:
+    const QPixmap &numberPixmap(int p_number, bool p_bold);
+
     VTextEditWithLineNumber *m_editor;
     const QTextDocument *m_document;
     int m_width;
@@ -66,6 +79,9 @@ private:
     int m_digitWidth;
     QColor m_foregroundColor;
     QColor m_backgroundColor;
+
+    // Rendered numbers keyed by number and boldness.
+    QHash<int, QPixmap> m_pixmaps;
 };
 
 inline const QColor &VLineNumberArea::getBackgroundColor() const
@@ -85,7 +101,10 @@ inline const QColor &VLineNumberArea::getForegroundColor() const
 
 inline void VLineNumberArea::setForegroundColor(const QColor &p_color)
 {
-    m_foregroundColor = p_color;
+    if (m_foregroundColor != p_color) {
+        m_foregroundColor = p_color;
+        m_pixmaps.clear();
+    }
 }
 
 inline void VLineNumberArea::setDigitWidth(int p_width)
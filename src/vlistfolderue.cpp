@@ -20,9 +20,15 @@ extern VMainWindow *g_mainWin;
 
 extern VNote *g_vnote;
 
+// Max number of folder listings to cache.
+#define MAX_CACHED_LISTINGS 32
+
 VListFolderUE::VListFolderUE(QObject *p_parent)
     : IUniversalEntry(p_parent),
-      m_listWidget(NULL)
+      m_listWidget(NULL),
+      m_listings(MAX_CACHED_LISTINGS),
+      m_listingSerial(0),
+      m_lastSerial(0)
 {
 }
 
@@ -257,61 +263,133 @@ bool VListFolderUE::listFolder(const QString &p_path, const QString &p_cmd)
     m_currentFolderPath = dir->fetchPath();
     m_panel->setTitle(m_currentFolderPath);
 
-    if (!dir->open()) {
+    const FolderListing *listing = folderListing(dir);
+    if (!listing) {
         return true;
     }
 
     if (p_cmd.isEmpty()) {
         // List the content.
-        for (auto const & it : dir->getSubDirs()) {
-            QSharedPointer<VSearchResultItem> item(new VSearchResultItem(VSearchResultItem::Folder,
-                                                                         VSearchResultItem::LineNumber,
-                                                                         it->getName(),
-                                                                         it->fetchPath()));
+        for (auto const & item : listing->m_items) {
             addResultItem(item);
         }
 
-        for (auto const & file : dir->getFiles()) {
-            QSharedPointer<VSearchResultItem> item(new VSearchResultItem(VSearchResultItem::Note,
-                                                                         VSearchResultItem::LineNumber,
-                                                                         file->getName(),
-                                                                         file->fetchPath()));
-            addResultItem(item);
+        return true;
+    }
+
+    // Search the content.
+    VSearchConfig config(VSearchConfig::CurrentFolder,
+                         VSearchConfig::Name,
+                         VSearchConfig::Note | VSearchConfig::Folder,
+                         VSearchConfig::Internal,
+                         VSearchConfig::NoneOption,
+                         p_cmd,
+                         QString());
+
+    // Match lowered keywords against the lowered names.
+    VSearchToken token = config.m_token;
+    bool lowered = token.m_type == VSearchToken::RawString
+                   && token.m_caseSensitivity == Qt::CaseInsensitive;
+    if (lowered) {
+        for (auto & keyword : token.m_keywords) {
+            keyword = keyword.toLower();
         }
-    } else {
-        // Search the content.
-        VSearchConfig config(VSearchConfig::CurrentFolder,
-                             VSearchConfig::Name,
-                             VSearchConfig::Note | VSearchConfig::Folder,
-                             VSearchConfig::Internal,
-                             VSearchConfig::NoneOption,
-                             p_cmd,
-                             QString());
-
-        for (auto const & it : dir->getSubDirs()) {
-            QString name = it->getName();
-            if (!config.m_token.matched(name)) {
-                continue;
-            }
 
-            QSharedPointer<VSearchResultItem> item(new VSearchResultItem(VSearchResultItem::Folder,
-                                                                         VSearchResultItem::LineNumber,
-                                                                         name,
-                                                                         it->fetchPath()));
-            addResultItem(item);
+        token.m_caseSensitivity = Qt::CaseSensitive;
+        token.compile();
+    }
+
+    QVector<int> matches;
+    auto matchItem = [&](int p_idx) {
+        const QString &name = lowered ? listing->m_lowerNames[p_idx]
+                                      : listing->m_items[p_idx]->m_text;
+        if (token.matched(name)) {
+            matches.append(p_idx);
+            addResultItem(listing->m_items[p_idx]);
         }
+    };
 
-        for (auto const & file : dir->getFiles()) {
-            QString name = file->getName();
-            if (!config.m_token.matched(name)) {
-                continue;
-            }
+    if (m_lastSerial == listing->m_serial && isNarrowerToken(token, m_lastToken)) {
+        for (int idx : m_lastMatches) {
+            matchItem(idx);
+        }
+    } else {
+        for (int i = 0; i < listing->m_items.size(); ++i) {
+            matchItem(i);
+        }
+    }
 
-            QSharedPointer<VSearchResultItem> item(new VSearchResultItem(VSearchResultItem::Note,
-                                                                         VSearchResultItem::LineNumber,
-                                                                         name,
-                                                                         file->fetchPath()));
-            addResultItem(item);
+    m_lastSerial = listing->m_serial;
+    m_lastToken = token;
+    m_lastMatches = matches;
+
+    return true;
+}
+
+const VListFolderUE::FolderListing *VListFolderUE::folderListing(VDirectory *p_dir)
+{
+    if (!p_dir->open()) {
+        return NULL;
+    }
+
+    QString path = p_dir->fetchPath();
+    FolderListing *listing = m_listings.object(p_dir);
+    if (listing
+        && listing->m_dir == p_dir
+        && listing->m_revision == p_dir->getRevision()
+        && listing->m_path == path) {
+        return listing;
+    }
+
+    listing = new FolderListing();
+    listing->m_dir = p_dir;
+    listing->m_revision = p_dir->getRevision();
+    listing->m_path = path;
+    listing->m_serial = ++m_listingSerial;
+
+    const QVector<VDirectory *> &subDirs = p_dir->getSubDirs();
+    const QVector<VNoteFile *> &files = p_dir->getFiles();
+    listing->m_items.reserve(subDirs.size() + files.size());
+    listing->m_lowerNames.reserve(subDirs.size() + files.size());
+
+    for (auto const & it : subDirs) {
+        QSharedPointer<VSearchResultItem> item(new VSearchResultItem(VSearchResultItem::Folder,
+                                                                     VSearchResultItem::LineNumber,
+                                                                     it->getName(),
+                                                                     it->fetchPath()));
+        listing->m_items.append(item);
+        listing->m_lowerNames.append(it->getName().toLower());
+    }
+
+    for (auto const & file : files) {
+        QSharedPointer<VSearchResultItem> item(new VSearchResultItem(VSearchResultItem::Note,
+                                                                     VSearchResultItem::LineNumber,
+                                                                     file->getName(),
+                                                                     file->fetchPath()));
+        listing->m_items.append(item);
+        listing->m_lowerNames.append(file->getName().toLower());
+    }
+
+    m_listings.insert(p_dir, listing);
+    return listing;
+}
+
+bool VListFolderUE::isNarrowerToken(const VSearchToken &p_token, const VSearchToken &p_lastToken)
+{
+    // With And, a keyword containing the last one matches less.
+    if (p_token.m_type != VSearchToken::RawString
+        || p_lastToken.m_type != VSearchToken::RawString
+        || p_token.m_op != VSearchToken::And
+        || p_lastToken.m_op != VSearchToken::And
+        || p_token.m_caseSensitivity != p_lastToken.m_caseSensitivity
+        || p_token.m_keywords.size() < p_lastToken.m_keywords.size()
+        || p_lastToken.isEmpty()) {
+        return false;
+    }
+
+    for (int i = 0; i < p_lastToken.m_keywords.size(); ++i) {
+        if (!p_token.m_keywords[i].contains(p_lastToken.m_keywords[i], p_token.m_caseSensitivity)) {
+            return false;
         }
     }
 
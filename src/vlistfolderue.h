@@ -4,6 +4,8 @@
 #include "iuniversalentry.h"
 #include <QWidget>
 #include <QIcon>
+#include <QCache>
+#include <QPointer>
 
 #include "vsearchconfig.h"
 
@@ -11,6 +13,7 @@ class VListWidget;
 class QListWidgetItem;
 class QLabel;
 class VUETitleContentPanel;
+class VDirectory;
 
 // Universal Entry to list contents of folder.
 class VListFolderUE : public IUniversalEntry
@@ -48,6 +51,31 @@ private slots:
     void activateItem(QListWidgetItem *p_item);
 
 private:
+    // Children of a folder, folders first, with names lowered for filtering.
+    struct FolderListing
+    {
+        QPointer<VDirectory> m_dir;
+
+        // Revision and path of m_dir when listed.
+        int m_revision;
+
+        QString m_path;
+
+        // Identify this listing among all the listings built.
+        int m_serial;
+
+        QVector<QSharedPointer<VSearchResultItem> > m_items;
+
+        QVector<QString> m_lowerNames;
+    };
+
+    // Return the listing of @p_dir, which is cached until @p_dir changes.
+    // Return NULL if fail to open @p_dir.
+    const FolderListing *folderListing(VDirectory *p_dir);
+
+    // Whether anything matched by @p_token is also matched by @p_lastToken.
+    static bool isNarrowerToken(const VSearchToken &p_token, const VSearchToken &p_lastToken);
+
     void addResultItem(const QSharedPointer<VSearchResultItem> &p_item);
 
     const QSharedPointer<VSearchResultItem> &itemResultData(const QListWidgetItem *p_item) const;
@@ -69,6 +97,18 @@ private:
     VListWidget *m_listWidget;
 
     VUETitleContentPanel *m_panel;
+
+    QCache<const VDirectory *, FolderListing> m_listings;
+
+    int m_listingSerial;
+
+    // Last filtering and its matched indexes in the listing, used to filter
+    // within the last results when the command is refined.
+    int m_lastSerial;
+
+    VSearchToken m_lastToken;
+
+    QVector<int> m_lastMatches;
 };
 
 #endif // VLISTFOLDERUE_H
@@ -183,9 +183,20 @@ void VListWidget::sortListWidget(QListWidget *p_list, const QVector<int> &p_sort
         sortedItems[i] = p_list->item(p_sortedIdx[i]);
     }
 
+    QListWidgetItem *curItem = p_list->currentItem();
+
+    // Take all the items from the back and add them back in order, which avoids
+    // searching and shifting the rows for each item.
+    for (int i = cnt - 1; i >= 0; --i) {
+        p_list->takeItem(i);
+    }
+
     for (int i = 0; i < cnt; ++i) {
-        QListWidgetItem *it = p_list->takeItem(p_list->row(sortedItems[i]));
-        p_list->insertItem(i, it);
+        p_list->addItem(sortedItems[i]);
+    }
+
+    if (curItem) {
+        p_list->setCurrentItem(curItem);
     }
 }
 
@@ -51,6 +51,20 @@ QListWidgetItem *VListWidgetDoubleRows::insertDoubleRowsItem(int p_row,
     return item;
 }
 
+void VListWidgetDoubleRows::removeDoubleRowsItem(int p_row)
+{
+    QListWidgetItem *it = item(p_row);
+    if (!it) {
+        return;
+    }
+
+    QWidget *wid = itemWidget(it);
+    removeItemWidget(it);
+    delete wid;
+
+    delete takeItem(p_row);
+}
+
 void VListWidgetDoubleRows::clearAll()
 {
     // Delete the item widget for each item.
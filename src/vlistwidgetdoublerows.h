@@ -23,6 +23,9 @@ public:
                                           const QString &p_firstRow,
                                           const QString &p_secondRow);
 
+    // Remove and delete the item at @p_row as well as its item widget.
+    void removeDoubleRowsItem(int p_row);
+
     void moveItem(int p_srcRow, int p_destRow) Q_DECL_OVERRIDE;
 
     void clearAll() Q_DECL_OVERRIDE;
@@ -11,7 +11,9 @@
 #include "vmainwindow.h"
 #include "veditarea.h"
 #include "vmathjaxpreviewhelper.h"
+#include "vpreviewscheduler.h"
 #include "utils/veditutils.h"
+#include "vmemorystats.h"
 
 extern VConfigManager *g_config;
 
@@ -30,6 +32,9 @@ extern VMainWindow *g_mainWin;
 
 #define INDEX_MASK 0x00ffffffUL
 
+// Interval in ms to update the live preview on cursor movement.
+#define LIVE_PREVIEW_INTERVAL 500
+
 CodeBlockPreviewInfo::CodeBlockPreviewInfo()
 {
 }
@@ -86,21 +91,25 @@ VLivePreviewHelper::VLivePreviewHelper(VEditor *p_editor,
       m_cbIndex(-1),
       m_livePreviewEnabled(false),
       m_inplacePreviewEnabled(false),
+      m_codeBlocksVersion(0),
       m_graphvizHelper(NULL),
       m_plantUMLHelper(NULL),
+      m_liveGraphvizHelper(NULL),
+      m_livePlantUMLHelper(NULL),
       m_lastInplacePreviewSize(0),
       m_timeStamp(0),
+      m_liveTimeStamp(0),
       m_scaleFactor(VUtils::calculateScaleFactor()),
       m_lastCursorBlock(-1)
 {
     m_livePreviewTimer = new QTimer(this);
     m_livePreviewTimer->setSingleShot(true);
-    m_livePreviewTimer->setInterval(500);
+    m_livePreviewTimer->setInterval(LIVE_PREVIEW_INTERVAL);
     connect(m_livePreviewTimer, &QTimer::timeout,
             this, &VLivePreviewHelper::handleCursorPositionChanged);
 
     connect(m_editor->object(), SIGNAL(cursorPositionChanged()),
-            m_livePreviewTimer, SLOT(start()));
+            this, SLOT(throttleCursorPositionChanged()));
 
     m_flowchartEnabled = g_config->getEnableFlowchart();
     m_mermaidEnabled = g_config->getEnableMermaid();
@@ -116,6 +125,10 @@ VLivePreviewHelper::VLivePreviewHelper(VEditor *p_editor,
     connect(m_mathJaxHelper, &VMathJaxPreviewHelper::diagramPreviewResultReady,
             // The same handle logics.
             this, &VLivePreviewHelper::mathjaxPreviewResultReady);
+
+    m_scheduler = new VPreviewScheduler(m_editor, this);
+    connect(m_scheduler, &VPreviewScheduler::previewRequested,
+            this, &VLivePreviewHelper::processForInplacePreviews);
 }
 
 void VLivePreviewHelper::checkLang(const QString &p_lang,
@@ -142,15 +155,25 @@ void VLivePreviewHelper::checkLang(const QString &p_lang,
     }
 }
 
-void VLivePreviewHelper::updateCodeBlocks(TimeStamp p_timeStamp, const QVector<VCodeBlock> &p_codeBlocks)
+void VLivePreviewHelper::updateCodeBlocks(const QSharedPointer<const VDocumentStructure> &p_structure)
 {
-    Q_UNUSED(p_timeStamp);
     if (!m_livePreviewEnabled && !m_inplacePreviewEnabled) {
         return;
     }
 
+    bool unchanged = p_structure->isUnchangedSince(m_codeBlocksVersion, VDocumentStructure::CodeBlocks);
+    m_codeBlocksVersion = p_structure->version();
+    if (unchanged) {
+        return;
+    }
+
+    const QVector<VCodeBlock> &codeBlocks = p_structure->codeBlocks();
+
     ++m_timeStamp;
 
+    // Indexes of pending live preview requests are obsolete.
+    ++m_liveTimeStamp;
+
     int lastIndex = m_cbIndex;
     m_cbIndex = -1;
     int cursorBlock = m_editor->textCursorW().block().blockNumber();
@@ -158,8 +181,9 @@ void VLivePreviewHelper::updateCodeBlocks(TimeStamp p_timeStamp, const QVector<V
     bool manualInplacePreview = m_inplacePreviewEnabled;
     m_codeBlocks.clear();
 
-    for (int i = 0; i < p_codeBlocks.size(); ++i) {
-        const VCodeBlock &vcb = p_codeBlocks[i];
+    QVector<int> dirtyIds, dirtyBlocks;
+    for (int i = 0; i < codeBlocks.size(); ++i) {
+        const VCodeBlock &vcb = codeBlocks[i];
         bool livePreview = false, inplacePreview = false;
         checkLang(vcb.m_lang, livePreview, inplacePreview);
         if (!livePreview && !inplacePreview) {
@@ -196,7 +220,8 @@ void VLivePreviewHelper::updateCodeBlocks(TimeStamp p_timeStamp, const QVector<V
             && inplacePreview
             && (!cached || !m_codeBlocks[idx].inplacePreviewReady())) {
             manualInplacePreview = false;
-            processForInplacePreview(idx);
+            dirtyIds.append(idx);
+            dirtyBlocks.append(vcb.m_endBlock);
         }
 
         if (m_livePreviewEnabled
@@ -212,7 +237,11 @@ void VLivePreviewHelper::updateCodeBlocks(TimeStamp p_timeStamp, const QVector<V
         }
     }
 
-    if (manualInplacePreview) {
+    // Pending requests of the last time stamp are dropped.
+    m_scheduler->schedule(dirtyIds, dirtyBlocks);
+
+    // Obsolete previews of the deferred blocks are checked out at once.
+    if (manualInplacePreview || !m_scheduler->isEmpty()) {
         updateInplacePreview();
     }
 
@@ -224,6 +253,13 @@ void VLivePreviewHelper::updateCodeBlocks(TimeStamp p_timeStamp, const QVector<V
     clearObsoleteCache();
 }
 
+void VLivePreviewHelper::throttleCursorPositionChanged()
+{
+    if (!m_livePreviewTimer->isActive()) {
+        m_livePreviewTimer->start();
+    }
+}
+
 void VLivePreviewHelper::handleCursorPositionChanged()
 {
     if (!m_livePreviewEnabled || m_codeBlocks.isEmpty()) {
@@ -274,38 +310,45 @@ void VLivePreviewHelper::updateLivePreview()
 
     m_curLivePreviewInfo.update(vcb);
 
+    // The web side shows the same content already.
+    if (vcb.m_text == m_livePreviewText) {
+        return;
+    }
+
     if (vcb.m_lang == "dot") {
-        if (!m_graphvizHelper) {
-            m_graphvizHelper = new VGraphvizHelper(this);
-            connect(m_graphvizHelper, &VGraphvizHelper::resultReady,
+        if (!m_liveGraphvizHelper) {
+            m_liveGraphvizHelper = new VGraphvizHelper(this);
+            connect(m_liveGraphvizHelper, &VGraphvizHelper::resultReady,
                     this, &VLivePreviewHelper::localAsyncResultReady);
         }
 
         if (!cb.hasImageData()) {
-            m_graphvizHelper->processAsync(m_cbIndex | LANG_PREFIX_GRAPHVIZ | TYPE_LIVE_PREVIEW,
-                                           m_timeStamp,
-                                           "svg",
-                                           VEditUtils::removeCodeBlockFence(vcb.m_text));
+            m_liveGraphvizHelper->processAsync(m_cbIndex | LANG_PREFIX_GRAPHVIZ | TYPE_LIVE_PREVIEW,
+                                               ++m_liveTimeStamp,
+                                               "svg",
+                                               VEditUtils::removeCodeBlockFence(vcb.m_text));
         } else {
-            m_document->setPreviewContent(vcb.m_lang, cb.imageData());
+            setLivePreviewContent(vcb, cb.imageData());
         }
     } else if (vcb.m_lang == "puml" && m_plantUMLMode == PlantUMLMode::LocalPlantUML) {
-        if (!m_plantUMLHelper) {
-            m_plantUMLHelper = new VPlantUMLHelper(this);
-            connect(m_plantUMLHelper, &VPlantUMLHelper::resultReady,
+        if (!m_livePlantUMLHelper) {
+            m_livePlantUMLHelper = new VPlantUMLHelper(this);
+            connect(m_livePlantUMLHelper, &VPlantUMLHelper::resultReady,
                     this, &VLivePreviewHelper::localAsyncResultReady);
         }
 
         if (!cb.hasImageData()) {
-            m_plantUMLHelper->processAsync(m_cbIndex | LANG_PREFIX_PLANTUML | TYPE_LIVE_PREVIEW,
-                                           m_timeStamp,
-                                           "svg",
-                                           VEditUtils::removeCodeBlockFence(vcb.m_text));
+            m_livePlantUMLHelper->processAsync(m_cbIndex | LANG_PREFIX_PLANTUML | TYPE_LIVE_PREVIEW,
+                                               ++m_liveTimeStamp,
+                                               "svg",
+                                               VEditUtils::removeCodeBlockFence(vcb.m_text));
         } else {
-            m_document->setPreviewContent(vcb.m_lang, cb.imageData());
+            setLivePreviewContent(vcb, cb.imageData());
         }
     } else if (vcb.m_lang != "mathjax") {
         // No need to live preview MathJax.
+        m_livePreviewText = vcb.m_text;
+        m_smartLivePreviewKey.clear();
         m_document->previewCodeBlock(m_cbIndex,
                                      vcb.m_lang,
                                      VEditUtils::removeCodeBlockFence(vcb.m_text),
@@ -313,6 +356,19 @@ void VLivePreviewHelper::updateLivePreview()
     }
 }
 
+void VLivePreviewHelper::setLivePreviewContent(const VCodeBlock &p_vcb, const QString &p_data)
+{
+    m_livePreviewText = p_vcb.m_text;
+    m_smartLivePreviewKey.clear();
+    m_document->setPreviewContent(p_vcb.m_lang, p_data);
+}
+
+void VLivePreviewHelper::invalidateLivePreview()
+{
+    m_livePreviewText.clear();
+    m_smartLivePreviewKey.clear();
+}
+
 void VLivePreviewHelper::setLivePreviewEnabled(bool p_enabled)
 {
     if (m_livePreviewEnabled == p_enabled) {
@@ -320,11 +376,14 @@ void VLivePreviewHelper::setLivePreviewEnabled(bool p_enabled)
     }
 
     m_livePreviewEnabled = p_enabled;
+    m_codeBlocksVersion = 0;
+    invalidateLivePreview();
     if (!m_livePreviewEnabled) {
         m_cbIndex = -1;
         m_document->previewCodeBlock(-1, "", "", true);
 
         if (!m_inplacePreviewEnabled) {
+            m_scheduler->clear();
             m_codeBlocks.clear();
             m_cache.clear();
             updateInplacePreview();
@@ -332,6 +391,25 @@ void VLivePreviewHelper::setLivePreviewEnabled(bool p_enabled)
     }
 }
 
+qint64 VLivePreviewHelper::approximateBytes() const
+{
+    qint64 bytes = 0;
+    for (auto const & cb : m_codeBlocks) {
+        bytes += sizeof(CodeBlockPreviewInfo)
+                 + VMemoryStats::stringBytes(cb.codeBlock().m_text)
+                 + VMemoryStats::stringBytes(cb.imageData());
+    }
+
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        const QSharedPointer<CodeBlockImageCacheEntry> &entry = it.value();
+        bytes += VMemoryStats::stringBytes(it.key())
+                 + VMemoryStats::pixmapBytes(entry->m_image)
+                 + VMemoryStats::stringBytes(entry->m_imgData);
+    }
+
+    return bytes;
+}
+
 void VLivePreviewHelper::setInplacePreviewEnabled(bool p_enabled)
 {
     if (m_inplacePreviewEnabled == p_enabled) {
@@ -339,6 +417,11 @@ void VLivePreviewHelper::setInplacePreviewEnabled(bool p_enabled)
     }
 
     m_inplacePreviewEnabled = p_enabled;
+    m_codeBlocksVersion = 0;
+    if (!m_inplacePreviewEnabled) {
+        m_scheduler->clear();
+    }
+
     if (!m_inplacePreviewEnabled && !m_livePreviewEnabled) {
         m_codeBlocks.clear();
         m_cache.clear();
@@ -352,7 +435,8 @@ void VLivePreviewHelper::localAsyncResultReady(int p_id,
                                                const QString &p_format,
                                                const QString &p_result)
 {
-    if (p_timeStamp != m_timeStamp) {
+    bool livePreview = (p_id & TYPE_MASK) == TYPE_LIVE_PREVIEW;
+    if (p_timeStamp != (livePreview ? m_liveTimeStamp : m_timeStamp)) {
         return;
     }
 
@@ -364,8 +448,6 @@ void VLivePreviewHelper::localAsyncResultReady(int p_id,
         return;
     }
 
-    bool livePreview = (p_id & TYPE_MASK) == TYPE_LIVE_PREVIEW;
-
     QString lang;
     QString background;
     switch (p_id & LANG_PREFIX_MASK) {
@@ -383,7 +465,11 @@ void VLivePreviewHelper::localAsyncResultReady(int p_id,
     }
 
     CodeBlockPreviewInfo &cb = m_codeBlocks[idx];
-    QSharedPointer<CodeBlockImageCacheEntry> entry(new CodeBlockImageCacheEntry(p_timeStamp,
+    if (cb.codeBlock().m_lang != lang) {
+        return;
+    }
+
+    QSharedPointer<CodeBlockImageCacheEntry> entry(new CodeBlockImageCacheEntry(m_timeStamp,
                                                                                 p_format,
                                                                                 p_result,
                                                                                 background,
@@ -402,7 +488,7 @@ void VLivePreviewHelper::localAsyncResultReady(int p_id,
             return;
         }
 
-        m_document->setPreviewContent(lang, p_result);
+        setLivePreviewContent(cb.codeBlock(), p_result);
         performSmartLivePreview();
     } else {
         // Inplace preview.
@@ -410,6 +496,15 @@ void VLivePreviewHelper::localAsyncResultReady(int p_id,
     }
 }
 
+void VLivePreviewHelper::processForInplacePreviews(const QVector<int> &p_indexes)
+{
+    for (int idx : p_indexes) {
+        if (idx < m_codeBlocks.size()) {
+            processForInplacePreview(idx);
+        }
+    }
+}
+
 void VLivePreviewHelper::processForInplacePreview(int p_idx)
 {
     CodeBlockPreviewInfo &cb = m_codeBlocks[p_idx];
@@ -573,6 +668,13 @@ void VLivePreviewHelper::performSmartLivePreview()
                                                               isRegex);
     }
 
+    // The web side has been there already.
+    QString key = QString("%1\n%2\n%3").arg(keyword, hints).arg(isRegex);
+    if (key == m_smartLivePreviewKey) {
+        return;
+    }
+
+    m_smartLivePreviewKey = key;
     m_document->performSmartLivePreview(vcb.m_lang, keyword, hints, isRegex);
 }
 
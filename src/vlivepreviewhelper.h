@@ -13,6 +13,7 @@ class VDocument;
 class VGraphvizHelper;
 class VPlantUMLHelper;
 class VMathJaxPreviewHelper;
+class VPreviewScheduler;
 
 class CodeBlockPreviewInfo
 {
@@ -135,14 +136,21 @@ public:
 
     void setLivePreviewEnabled(bool p_enabled);
 
+    // The web side forgets the live preview, such as when it is reloaded.
+    void invalidateLivePreview();
+
     void setInplacePreviewEnabled(bool p_enabled);
 
     bool isPreviewEnabled() const;
 
     const LivePreviewInfo &getLivePreviewInfo() const;
 
+    // Bytes of the code blocks and the cached preview images.
+    // The pixmaps are shared with the image resources of the editor.
+    qint64 approximateBytes() const;
+
 public slots:
-    void updateCodeBlocks(TimeStamp p_timeStamp, const QVector<VCodeBlock> &p_codeBlocks);
+    void updateCodeBlocks(const QSharedPointer<const VDocumentStructure> &p_structure);
 
 signals:
     void inplacePreviewCodeBlockUpdated(const QVector<QSharedPointer<VImageToPreview> > &p_images);
@@ -150,6 +158,10 @@ signals:
     void checkBlocksForObsoletePreview(const QList<int> &p_blocks);
 
 private slots:
+    // Start the live preview timer unless it is running, so the live preview
+    // is updated at most once per interval with the last cursor position.
+    void throttleCursorPositionChanged();
+
     void handleCursorPositionChanged();
 
     void localAsyncResultReady(int p_id, TimeStamp p_timeStamp, const QString &p_format, const QString &p_result);
@@ -254,7 +266,9 @@ private:
 
     void checkLang(const QString &p_lang, bool &p_livePreview, bool &p_inplacePreview) const;
 
-    // Get image data for this code block for inplace preview.
+    // Get image data for these code blocks for inplace preview.
+    void processForInplacePreviews(const QVector<int> &p_indexes);
+
     void processForInplacePreview(int p_idx);
 
     // Emit signal to update inplace preview.
@@ -266,6 +280,9 @@ private:
 
     void performSmartLivePreview();
 
+    // Push the rendered @p_data of @p_vcb to the live preview of the web side.
+    void setLivePreviewContent(const VCodeBlock &p_vcb, const QString &p_data);
+
     bool isOnlineLivePreview(const QString &p_lang) const;
 
     // Sorted by m_startBlock in ascending order.
@@ -291,9 +308,17 @@ private:
 
     bool m_inplacePreviewEnabled;
 
+    // Version of the document structure of m_codeBlocks.
+    quint64 m_codeBlocksVersion;
+
     VGraphvizHelper *m_graphvizHelper;
     VPlantUMLHelper *m_plantUMLHelper;
 
+    // Helpers of the live preview, whose requests are superseded by the newer
+    // ones of @m_liveTimeStamp.
+    VGraphvizHelper *m_liveGraphvizHelper;
+    VPlantUMLHelper *m_livePlantUMLHelper;
+
     VMathJaxPreviewHelper *m_mathJaxHelper;
 
     // Identification for VMathJaxPreviewHelper.
@@ -301,8 +326,14 @@ private:
 
     int m_lastInplacePreviewSize;
 
+    // Order the inplace preview requests by the viewport.
+    VPreviewScheduler *m_scheduler;
+
     TimeStamp m_timeStamp;
 
+    // Increased on each live preview request and code blocks update.
+    TimeStamp m_liveTimeStamp;
+
     const qreal m_scaleFactor;
 
     // Indexed by content.
@@ -313,6 +344,12 @@ private:
     QTimer *m_livePreviewTimer;
 
     LivePreviewInfo m_curLivePreviewInfo;
+
+    // Text of the code block shown in the live preview of the web side.
+    QString m_livePreviewText;
+
+    // Arguments of the last smart live preview of @m_livePreviewText.
+    QString m_smartLivePreviewKey;
 };
 
 inline bool VLivePreviewHelper::isPreviewEnabled() const
@@ -19,6 +19,7 @@
 #include "vcaptain.h"
 #include "vedittab.h"
 #include "vwebview.h"
+#include "vwebviewpool.h"
 #include "vexporter.h"
 #include "vmdtab.h"
 #include "vvimindicator.h"
@@ -47,11 +48,20 @@
 #include "vhelpue.h"
 #include "vlistfolderue.h"
 #include "dialog/vfixnotebookdialog.h"
+#include "dialog/vlatencystatsdialog.h"
+#include "dialog/vmemorystatsdialog.h"
+#include "vtracer.h"
 #include "vhistorylist.h"
 #include "vexplorer.h"
 #include "vlistue.h"
 #include "vtagexplorer.h"
 #include "vmdeditor.h"
+#include "vsearchindex.h"
+#include "vnotemetadatastore.h"
+#include "vrendercache.h"
+#include "vnotebooksnapshot.h"
+#include "vdirectoryconfigwriter.h"
+#include "vrecyclebin.h"
 
 extern VConfigManager *g_config;
 
@@ -63,8 +73,6 @@ VNote *g_vnote;
 
 VWebUtils *g_webUtils;
 
-const int VMainWindow::c_sharedMemTimerInterval = 1000;
-
 #if defined(QT_NO_DEBUG)
 extern QFile g_logFile;
 #endif
@@ -97,6 +105,7 @@ VMainWindow::VMainWindow(VSingleInstanceGuard *p_guard, QWidget *p_parent)
 
     vnote = new VNote(this);
     g_vnote = vnote;
+    STARTUP_TIME("notebooks");
 
     m_webUtils.init();
     g_webUtils = &m_webUtils;
@@ -104,14 +113,17 @@ VMainWindow::VMainWindow(VSingleInstanceGuard *p_guard, QWidget *p_parent)
     initCaptain();
 
     setupUI();
+    STARTUP_TIME("main window UI");
 
     initMenuBar();
 
     initToolBar();
 
     initShortcuts();
+    STARTUP_TIME("menu bar and tool bar");
 
     initDockWindows();
+    STARTUP_TIME("dock windows");
 
     int state = g_config->getPanelViewState();
     if (state < 0 || state >= (int)PanelViewState::Invalid) {
@@ -125,23 +137,37 @@ VMainWindow::VMainWindow(VSingleInstanceGuard *p_guard, QWidget *p_parent)
     setContextMenuPolicy(Qt::NoContextMenu);
 
     m_notebookSelector->update();
+    STARTUP_TIME("current notebook");
 
-    initSharedMemoryWatcher();
+    initInstanceRequestWatcher();
 
     initUpdateTimer();
 
+    connect(VRecycleBin::inst(), &VRecycleBin::deletionFailed,
+            this, [this](const QStringList &p_paths) {
+                VUtils::showMessage(QMessageBox::Warning,
+                                    tr("Warning"),
+                                    tr("Fail to delete some files. Please check and manually delete them."),
+                                    p_paths.join('\n'),
+                                    QMessageBox::Ok,
+                                    QMessageBox::Ok,
+                                    this);
+            });
+
     registerCaptainAndNavigationTargets();
 }
 
-void VMainWindow::initSharedMemoryWatcher()
+void VMainWindow::initInstanceRequestWatcher()
 {
-    m_sharedMemTimer = new QTimer(this);
-    m_sharedMemTimer->setSingleShot(false);
-    m_sharedMemTimer->setInterval(c_sharedMemTimerInterval);
-    connect(m_sharedMemTimer, &QTimer::timeout,
-            this, &VMainWindow::checkSharedMemory);
+    connect(m_guard, &VSingleInstanceGuard::openFilesRequested,
+            this, [this](const QStringList &p_files) {
+                openFiles(p_files, false, g_config->getNoteOpenMode(), false, false);
+                showMainWindow();
+            });
+    connect(m_guard, &VSingleInstanceGuard::showRequested,
+            this, &VMainWindow::showMainWindow);
 
-    m_sharedMemTimer->start();
+    m_guard->startListening();
 }
 
 void VMainWindow::initCaptain()
@@ -280,7 +306,8 @@ void VMainWindow::setupUI()
                                OpenFileMode p_mode,
                                bool p_forceMode) {
                 if (p_file->getDocType() == DocType::Markdown
-                    || p_file->getDocType() == DocType::Html) {
+                    || p_file->getDocType() == DocType::Html
+                    || p_file->getDocType() == DocType::Text) {
                     m_editArea->openFile(p_file, p_mode, p_forceMode);
                 }
             });
@@ -885,6 +912,61 @@ void VMainWindow::initHelpMenu()
                 QDesktopServices::openUrl(url);
             });
 
+    QAction *latencyAct = new QAction(tr("Editor &Latency Stats"), this);
+    latencyAct->setToolTip(tr("View latency stats of parse and highlight of opened notes"));
+    connect(latencyAct, &QAction::triggered,
+            this, [this]() {
+                VLatencyStatsDialog dialog(this);
+                dialog.exec();
+            });
+
+    QAction *memoryAct = new QAction(tr("&Memory Stats"), this);
+    memoryAct->setToolTip(tr("View approximate memory of opened notes and caches"));
+    connect(memoryAct, &QAction::triggered,
+            this, [this]() {
+                VMemoryStatsDialog dialog(this);
+                dialog.exec();
+            });
+
+    QAction *traceAct = new QAction(tr("Record &Trace"), this);
+    traceAct->setToolTip(tr("Record trace events of search, export, preview and file I/O, "
+                            "which are saved in Chrome trace format when stopped"));
+    traceAct->setCheckable(true);
+    connect(traceAct, &QAction::triggered,
+            this, [this](bool p_checked) {
+                if (p_checked) {
+                    VTracer::setEnabled(true);
+                    showStatusMessage(tr("Recording trace"));
+                    return;
+                }
+
+                VTracer::setEnabled(false);
+
+                static QString lastPath = g_config->getDocumentPathOrHomePath();
+                QString fileName = QFileDialog::getSaveFileName(this,
+                                                                tr("Save Trace"),
+                                                                QDir(lastPath).filePath("vnote_trace.json"),
+                                                                tr("JSON (*.json)"));
+                if (fileName.isEmpty()) {
+                    return;
+                }
+
+                lastPath = QFileInfo(fileName).path();
+
+                if (VTracer::dump(fileName)) {
+                    showStatusMessage(tr("%1 trace events saved to %2").arg(VTracer::eventCount())
+                                                                        .arg(fileName));
+                } else {
+                    VUtils::showMessage(QMessageBox::Warning,
+                                        tr("Warning"),
+                                        tr("Fail to save trace to %1.").arg(fileName),
+                                        "",
+                                        QMessageBox::Ok,
+                                        QMessageBox::Ok,
+                                        this);
+                }
+            });
+
     QAction *aboutAct = new QAction(tr("&About VNote"), this);
     aboutAct->setToolTip(tr("View information about VNote"));
     aboutAct->setMenuRole(QAction::AboutRole);
@@ -909,6 +991,10 @@ void VMainWindow::initHelpMenu()
     helpMenu->addAction(logAct);
 #endif
 
+    helpMenu->addAction(latencyAct);
+    helpMenu->addAction(memoryAct);
+    helpMenu->addAction(traceAct);
+
     helpMenu->addAction(aboutQtAct);
     helpMenu->addAction(aboutAct);
 }
@@ -2321,6 +2407,24 @@ void VMainWindow::closeEvent(QCloseEvent *event)
             g_config->setLastOpenedFiles(fileInfos);
         }
 
+        VSearchIndexManager::saveAll();
+
+        VNoteMetadataStoreManager::saveAll();
+
+        g_config->flushSettings();
+
+        VRenderCache::save();
+
+        if (!VDirectoryConfigWriter::flush()) {
+            qWarning() << "fail to write some directory configurations";
+        }
+
+        VRecycleBin::flush();
+
+        for (auto nb : g_vnote->getNotebooks()) {
+            nb->getSnapshot()->save();
+        }
+
         QMainWindow::closeEvent(event);
         qApp->quit();
     } else {
@@ -2707,23 +2811,6 @@ void VMainWindow::editOrphanFileInfo(VFile *p_file)
     }
 }
 
-void VMainWindow::checkSharedMemory()
-{
-    QStringList files = m_guard->fetchFilesToOpen();
-    if (!files.isEmpty()) {
-        qDebug() << "shared memory fetch files" << files;
-        openFiles(files, false, g_config->getNoteOpenMode(), false, false);
-
-        // Eliminate the signal.
-        m_guard->fetchAskedToShow();
-
-        showMainWindow();
-    } else if (m_guard->fetchAskedToShow()) {
-        qDebug() << "shared memory asked to show up";
-        showMainWindow();
-    }
-}
-
 void VMainWindow::initTrayIcon()
 {
     QMenu *menu = new QMenu(this);
@@ -2792,7 +2879,7 @@ void VMainWindow::openStartupPages()
     {
         QVector<VFileSessionInfo> files = g_config->getLastOpenedFiles();
         qDebug() << "open" << files.size() << "last opened files";
-        m_editArea->openFiles(files, true);
+        m_editArea->openFiles(files, true, true);
         break;
     }
 
@@ -3453,8 +3540,13 @@ void VMainWindow::kickOffStartUpTimer(const QStringList &p_files)
         QCoreApplication::sendPostedEvents();
         promptNewNotebookIfEmpty();
         QCoreApplication::sendPostedEvents();
+        STARTUP_TIME("check notebooks");
+
         openStartupPages();
         openFiles(p_files, false, g_config->getNoteOpenMode(), false, true);
+        STARTUP_TIME("startup pages");
+
+        VWebViewPool::inst()->warmUp(g_config->getMdConverterType());
 
         checkIfNeedToShowWelcomePage();
 
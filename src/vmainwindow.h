@@ -184,10 +184,6 @@ private slots:
     // Will be called frequently.
     void handleAreaTabStatusUpdated(const VEditTabInfo &p_info);
 
-    // Check the shared memory between different instances to see if we have
-    // files to open.
-    void checkSharedMemory();
-
     void quitApp();
 
     // Restore main window.
@@ -297,9 +293,8 @@ private:
                        const QString &p_text,
                        QObject *p_parent = nullptr);
 
-    // Init a timer to watch the change of the shared memory between instances of
-    // VNote.
-    void initSharedMemoryWatcher();
+    // Handle the requests from other instances of VNote, such as opening files.
+    void initInstanceRequestWatcher();
 
     void initUpdateTimer();
 
@@ -484,9 +479,6 @@ private:
     // Single instance guard.
     VSingleInstanceGuard *m_guard;
 
-    // Timer to check the shared memory between instances of VNote.
-    QTimer *m_sharedMemTimer;
-
     // Timer to update gui.
     // Sometimes the toolbar buttons do not refresh themselves.
     QTimer *m_updateTimer;
@@ -514,9 +506,6 @@ private:
 
     // Whether sync note list to current tab.
     bool m_syncNoteListToCurrentTab;
-
-    // Interval of the shared memory timer in ms.
-    static const int c_sharedMemTimerInterval;
 };
 
 inline VFileList *VMainWindow::getFileList() const
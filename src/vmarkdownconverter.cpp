@@ -1,23 +1,57 @@
 #include "vmarkdownconverter.h"
 #include <QRegularExpression>
+#include <QMutex>
+#include <QVector>
 
-VMarkdownConverter::VMarkdownConverter()
+#define NESTING_LEVEL 16
+
+// Max number of idle renderers kept in the pool.
+#define MAX_POOLED_RENDERERS 4
+
+// HTML renderers shared by all the converters.
+static QMutex s_rendererMutex;
+
+static QVector<hoedown_renderer *> s_renderers;
+
+static hoedown_renderer *acquireRenderer()
 {
-    hoedownHtmlFlags = (hoedown_html_flags)0;
-    nestingLevel = 16;
+    {
+    QMutexLocker locker(&s_rendererMutex);
+    if (!s_renderers.isEmpty()) {
+        return s_renderers.takeLast();
+    }
+    }
 
-    htmlRenderer = hoedown_html_renderer_new(hoedownHtmlFlags, nestingLevel);
-    tocRenderer = hoedown_html_toc_renderer_new(nestingLevel);
+    return hoedown_html_renderer_new((hoedown_html_flags)0, NESTING_LEVEL);
 }
 
-VMarkdownConverter::~VMarkdownConverter()
+static void releaseRenderer(hoedown_renderer *p_renderer)
 {
-    if (htmlRenderer) {
-        hoedown_html_renderer_free(htmlRenderer);
+    if (!p_renderer) {
+        return;
+    }
+
+    {
+    QMutexLocker locker(&s_rendererMutex);
+    if (s_renderers.size() < MAX_POOLED_RENDERERS) {
+        s_renderers.append(p_renderer);
+        return;
     }
-    if (tocRenderer) {
-        hoedown_html_renderer_free(tocRenderer);
     }
+
+    hoedown_html_renderer_free(p_renderer);
+}
+
+VMarkdownConverter::VMarkdownConverter()
+{
+    nestingLevel = NESTING_LEVEL;
+
+    htmlRenderer = acquireRenderer();
+}
+
+VMarkdownConverter::~VMarkdownConverter()
+{
+    releaseRenderer(htmlRenderer);
 }
 
 QString VMarkdownConverter::generateHtml(const QString &markdown, hoedown_extensions options)
@@ -25,6 +59,11 @@ QString VMarkdownConverter::generateHtml(const QString &markdown, hoedown_extens
     if (markdown.isEmpty()) {
         return QString();
     }
+
+    // The renderer numbers the headers across documents.
+    hoedown_html_renderer_state *state = (hoedown_html_renderer_state *)htmlRenderer->opaque;
+    state->toc_data.header_count = 0;
+
     hoedown_document *document = hoedown_document_new(htmlRenderer, options,
                                                       nestingLevel);
     QByteArray data = markdown.toUtf8();
@@ -37,6 +76,76 @@ QString VMarkdownConverter::generateHtml(const QString &markdown, hoedown_extens
     return html;
 }
 
+static void processToc(QString &p_toc)
+{
+    // Hoedown will add '\n'.
+    p_toc.replace("\n", "");
+    // Hoedown will translate `_` in title to `<em>`.
+    p_toc.replace("<em>", "_");
+    p_toc.replace("</em>", "_");
+}
+
+// Generate the TOC from the headers with hoedown's "toc_N" ids in @p_html,
+// the same as hoedown's TOC renderer.
+static QString generateTocFromHtml(const QString &p_html, int p_nestingLevel)
+{
+    QRegularExpression headerExp("<h([1-6]) id=\"toc_(\\d+)\">(.*)</h\\1>",
+                                 QRegularExpression::InvertedGreedinessOption);
+    // Keep only the tags which are well-formed within <a>.
+    QRegularExpression tagExp("<(?!/?(code|strong|del)>)[^>]*>");
+
+    QString toc;
+    int currentLevel = 0;
+    int levelOffset = 0;
+    QRegularExpressionMatchIterator it = headerExp.globalMatch(p_html);
+    while (it.hasNext()) {
+        QRegularExpressionMatch match = it.next();
+        int level = match.captured(1).toInt();
+        if (level > p_nestingLevel) {
+            continue;
+        }
+
+        // Set the level offset if this is the first header.
+        if (currentLevel == 0) {
+            levelOffset = level - 1;
+        }
+
+        level -= levelOffset;
+        if (level > currentLevel) {
+            while (level > currentLevel) {
+                toc += "<ul>\n<li>\n";
+                ++currentLevel;
+            }
+        } else if (level < currentLevel) {
+            toc += "</li>\n";
+            while (level < currentLevel) {
+                toc += "</ul>\n</li>\n";
+                --currentLevel;
+            }
+
+            toc += "<li>\n";
+        } else {
+            toc += "</li>\n<li>\n";
+        }
+
+        QString content = match.captured(3);
+        content.replace("<em>", "_");
+        content.replace("</em>", "_");
+        content.remove(tagExp);
+
+        toc += "<a href=\"#toc_" + match.captured(2) + "\">" + content + "</a>\n";
+    }
+
+    while (currentLevel > 0) {
+        toc += "</li>\n</ul>\n";
+        --currentLevel;
+    }
+
+    processToc(toc);
+
+    return toc;
+}
+
 QString VMarkdownConverter::generateHtml(const QString &markdown, hoedown_extensions options, QString &toc)
 {
     if (markdown.isEmpty()) {
@@ -45,36 +154,17 @@ QString VMarkdownConverter::generateHtml(const QString &markdown, hoedown_extens
 
     QString html = generateHtml(markdown, options);
     QRegularExpression tocExp("<p>\\[TOC\\]<\\/p>", QRegularExpression::CaseInsensitiveOption);
-    toc = generateToc(markdown, options);
+    toc = generateTocFromHtml(html, nestingLevel);
     html.replace(tocExp, toc);
 
     return html;
 }
 
-static void processToc(QString &p_toc)
-{
-    // Hoedown will add '\n'.
-    p_toc.replace("\n", "");
-    // Hoedown will translate `_` in title to `<em>`.
-    p_toc.replace("<em>", "_");
-    p_toc.replace("</em>", "_");
-}
-
 QString VMarkdownConverter::generateToc(const QString &markdown, hoedown_extensions options)
 {
     if (markdown.isEmpty()) {
         return QString();
     }
 
-    hoedown_document *document = hoedown_document_new(tocRenderer, options, nestingLevel);
-    QByteArray data = markdown.toUtf8();
-    hoedown_buffer *outBuf = hoedown_buffer_new(16);
-    hoedown_document_render(document, outBuf, (const uint8_t *)data.constData(), data.size());
-    hoedown_document_free(document);
-    QString toc = QString::fromUtf8(hoedown_buffer_cstr(outBuf));
-    hoedown_buffer_free(outBuf);
-
-    processToc(toc);
-
-    return toc;
+    return generateTocFromHtml(generateHtml(markdown, options), nestingLevel);
 }
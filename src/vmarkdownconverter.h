@@ -8,12 +8,15 @@ extern "C" {
 #include <src/document.h>
 }
 
+// Convert Markdown to HTML via hoedown.
+// Different converters could be used in different threads at the same time.
 class VMarkdownConverter
 {
 public:
     VMarkdownConverter();
     ~VMarkdownConverter();
 
+    // Generate the HTML and the TOC extracted from its headers in one pass.
     QString generateHtml(const QString &markdown, hoedown_extensions options, QString &toc);
 
     QString generateToc(const QString &markdown, hoedown_extensions options);
@@ -22,10 +25,10 @@ private:
     QString generateHtml(const QString &markdown, hoedown_extensions options);
 
     // VMarkdownDocument *generateDocument(const QString &markdown);
-    hoedown_html_flags hoedownHtmlFlags;
     int nestingLevel;
+
+    // Borrowed from the renderer pool.
     hoedown_renderer *htmlRenderer;
-    hoedown_renderer *tocRenderer;
 };
 
 #endif // VMARKDOWNCONVERTER_H
@@ -0,0 +1,107 @@
+#include "vmarkdownconvertservice.h"
+
+#include <QRunnable>
+#include <QCoreApplication>
+#include <QMutexLocker>
+
+// Convert one Markdown text in the pool.
+class MarkdownConvertTask : public QRunnable
+{
+public:
+    MarkdownConvertTask(VMarkdownConvertService *p_service,
+                        QObject *p_owner,
+                        int p_id,
+                        const QString &p_text,
+                        hoedown_extensions p_options)
+        : m_service(p_service),
+          m_owner(p_owner),
+          m_id(p_id),
+          m_text(p_text),
+          m_options(p_options)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        // Skip the requests cancelled before started.
+        if (m_service->isCancelled(m_owner, m_id)) {
+            return;
+        }
+
+        VMarkdownConverter converter;
+        QString toc;
+        QString html = converter.generateHtml(m_text, m_options, toc);
+
+        if (m_service->isCancelled(m_owner, m_id)) {
+            return;
+        }
+
+        // The service waits for all the tasks before destruction.
+        QMetaObject::invokeMethod(m_service,
+                                  "htmlConverted",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, m_id),
+                                  Q_ARG(QString, html),
+                                  Q_ARG(QString, toc));
+    }
+
+private:
+    VMarkdownConvertService *m_service;
+
+    // Used as a key only.
+    QObject *m_owner;
+
+    int m_id;
+
+    QString m_text;
+
+    hoedown_extensions m_options;
+};
+
+
+VMarkdownConvertService::VMarkdownConvertService(QObject *p_parent)
+    : QObject(p_parent),
+      m_nextId(0)
+{
+}
+
+VMarkdownConvertService::~VMarkdownConvertService()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+VMarkdownConvertService *VMarkdownConvertService::inst()
+{
+    static VMarkdownConvertService *service = new VMarkdownConvertService(QCoreApplication::instance());
+    return service;
+}
+
+int VMarkdownConvertService::convert(QObject *p_owner,
+                                     const QString &p_text,
+                                     hoedown_extensions p_options)
+{
+    int id = ++m_nextId;
+
+    {
+    QMutexLocker locker(&m_mutex);
+    if (!m_latestIds.contains(p_owner)) {
+        connect(p_owner, &QObject::destroyed,
+                this, [this](QObject *p_obj) {
+                    QMutexLocker locker(&m_mutex);
+                    m_latestIds.remove(p_obj);
+                });
+    }
+
+    m_latestIds[p_owner] = id;
+    }
+
+    m_pool.start(new MarkdownConvertTask(this, p_owner, id, p_text, p_options));
+    return id;
+}
+
+bool VMarkdownConvertService::isCancelled(QObject *p_owner, int p_id) const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_latestIds.value(p_owner, -1) != p_id;
+}
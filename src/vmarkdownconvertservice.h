@@ -0,0 +1,47 @@
+#ifndef VMARKDOWNCONVERTSERVICE_H
+#define VMARKDOWNCONVERTSERVICE_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+
+#include "vmarkdownconverter.h"
+
+// Convert Markdown to HTML via hoedown on a worker pool for read mode.
+// Should be accessed only in the GUI thread.
+class VMarkdownConvertService : public QObject
+{
+    Q_OBJECT
+public:
+    ~VMarkdownConvertService();
+
+    static VMarkdownConvertService *inst();
+
+    // Convert @p_text to HTML and TOC.
+    // Previous requests of @p_owner are cancelled and will not be finished.
+    // Returns the ID of the request in htmlConverted().
+    int convert(QObject *p_owner, const QString &p_text, hoedown_extensions p_options);
+
+    // Whether request @p_id is superseded by a newer one of @p_owner.
+    // Thread-safe.
+    bool isCancelled(QObject *p_owner, int p_id) const;
+
+signals:
+    void htmlConverted(int p_id, const QString &p_html, const QString &p_toc);
+
+private:
+    explicit VMarkdownConvertService(QObject *p_parent = nullptr);
+
+    QThreadPool m_pool;
+
+    int m_nextId;
+
+    // Owner -> its latest request ID.
+    QHash<QObject *, int> m_latestIds;
+
+    mutable QMutex m_mutex;
+};
+
+#endif // VMARKDOWNCONVERTSERVICE_H
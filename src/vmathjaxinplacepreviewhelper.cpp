@@ -1,12 +1,20 @@
 #include "vmathjaxinplacepreviewhelper.h"
 
 #include <QDebug>
+#include <QGuiApplication>
+#include <QFontInfo>
 
 #include "veditor.h"
 #include "vdocument.h"
 #include "vmainwindow.h"
 #include "veditarea.h"
 #include "vmathjaxpreviewhelper.h"
+#include "vconfigmanager.h"
+#include "vrendercache.h"
+#include "vpreviewscheduler.h"
+#include "vmemorystats.h"
+
+extern VConfigManager *g_config;
 
 extern VMainWindow *g_mainWin;
 
@@ -61,25 +69,46 @@ VMathJaxInplacePreviewHelper::VMathJaxInplacePreviewHelper(VEditor *p_editor,
       m_document(p_document),
       m_doc(p_editor->documentW()),
       m_enabled(false),
+      m_mathjaxBlocksVersion(0),
       m_lastInplacePreviewSize(0),
       m_timeStamp(0)
 {
     m_mathJaxHelper = g_mainWin->getEditArea()->getMathJaxPreviewHelper();
     m_mathJaxID = m_mathJaxHelper->registerIdentifier();
-    connect(m_mathJaxHelper, &VMathJaxPreviewHelper::mathjaxPreviewResultReady,
-            this, &VMathJaxInplacePreviewHelper::mathjaxPreviewResultReady);
+    connect(m_mathJaxHelper, &VMathJaxPreviewHelper::mathjaxBatchPreviewResultReady,
+            this, &VMathJaxInplacePreviewHelper::mathjaxBatchPreviewResultReady);
 
     m_documentID = m_document->registerIdentifier();
-    connect(m_document, &VDocument::textToHtmlFinished,
-            this, &VMathJaxInplacePreviewHelper::textToHtmlFinished);
+    connect(m_document, &VDocument::textToHtmlBatchFinished,
+            this, &VMathJaxInplacePreviewHelper::textToHtmlBatchFinished);
+
+    m_scheduler = new VPreviewScheduler(m_editor, this);
+    connect(m_scheduler, &VPreviewScheduler::previewRequested,
+            this, &VMathJaxInplacePreviewHelper::requestPreviews);
+}
+
+qint64 VMathJaxInplacePreviewHelper::approximateBytes() const
+{
+    qint64 bytes = 0;
+    for (auto const & mb : m_mathjaxBlocks) {
+        bytes += sizeof(MathjaxBlockPreviewInfo) + VMemoryStats::stringBytes(mb.mathjaxBlock().m_text);
+    }
+
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        bytes += VMemoryStats::stringBytes(it.key()) + VMemoryStats::pixmapBytes(it.value()->m_image);
+    }
+
+    return bytes;
 }
 
 void VMathJaxInplacePreviewHelper::setEnabled(bool p_enabled)
 {
     if (m_enabled != p_enabled) {
         m_enabled = p_enabled;
+        m_mathjaxBlocksVersion = 0;
 
         if (!m_enabled) {
+            m_scheduler->clear();
             m_mathjaxBlocks.clear();
             m_cache.clear();
         }
@@ -88,72 +117,111 @@ void VMathJaxInplacePreviewHelper::setEnabled(bool p_enabled)
     }
 }
 
-void VMathJaxInplacePreviewHelper::updateMathjaxBlocks(const QVector<VMathjaxBlock> &p_blocks)
+void VMathJaxInplacePreviewHelper::updateMathjaxBlocks(const QSharedPointer<const VDocumentStructure> &p_structure)
 {
     if (!m_enabled) {
         return;
     }
 
+    bool unchanged = p_structure->isUnchangedSince(m_mathjaxBlocksVersion,
+                                                   VDocumentStructure::MathjaxBlocks);
+    m_mathjaxBlocksVersion = p_structure->version();
+    if (unchanged) {
+        return;
+    }
+
+    const QVector<VMathjaxBlock> &blocks = p_structure->mathjaxBlocks();
+
     ++m_timeStamp;
 
     m_mathjaxBlocks.clear();
-    m_mathjaxBlocks.reserve(p_blocks.size());
-    bool manualUpdate = true;
-    for (int i = 0; i < p_blocks.size(); ++i) {
-        const VMathjaxBlock &vmb = p_blocks[i];
+    m_mathjaxBlocks.reserve(blocks.size());
+
+    // Blocks to preview, one for each formula.
+    QVector<int> dirtyBlocks;
+    QSet<QString> dirtyKeys;
+    for (int i = 0; i < blocks.size(); ++i) {
+        const VMathjaxBlock &vmb = blocks[i];
         const QString &text = vmb.m_text;
+        QString key = cacheKey(text);
         bool cached = false;
 
         m_mathjaxBlocks.append(MathjaxBlockPreviewInfo(vmb));
 
-        auto it = m_cache.find(text);
+        if (!text.isEmpty() && !m_cache.contains(key)) {
+            loadFromRenderCache(text);
+        }
+
+        auto it = m_cache.find(key);
         if (it != m_cache.end()) {
             QSharedPointer<MathjaxImageCacheEntry> &entry = it.value();
             entry->m_ts = m_timeStamp;
             cached = true;
-            m_mathjaxBlocks.last().updateInplacePreview(m_editor,
-                                                        m_doc,
-                                                        entry->m_image,
-                                                        entry->m_imageName);
+            MathjaxBlockPreviewInfo &mb = m_mathjaxBlocks.last();
+            mb.updateInplacePreview(m_editor,
+                                    m_doc,
+                                    entry->m_image,
+                                    entry->m_imageName);
+
+            if (entry->m_imageName.isEmpty() && mb.inplacePreview()) {
+                entry->m_imageName = mb.inplacePreview()->m_name;
+            }
         }
 
-        if (!cached || !m_mathjaxBlocks.last().inplacePreviewReady()) {
-            manualUpdate = false;
-            processForInplacePreview(m_mathjaxBlocks.size() - 1);
+        if ((!cached || !m_mathjaxBlocks.last().inplacePreviewReady())
+            && !text.isEmpty()
+            && !dirtyKeys.contains(key)) {
+            dirtyKeys.insert(key);
+            dirtyBlocks.append(m_mathjaxBlocks.size() - 1);
         }
     }
 
-    if (manualUpdate) {
+    if (!dirtyBlocks.isEmpty() && !m_document->isReadyToTextToHtml()) {
+        qDebug() << "web side is not ready to convert text to HTML";
+        dirtyBlocks.clear();
+    }
+
+    QVector<int> blockNumbers;
+    blockNumbers.reserve(dirtyBlocks.size());
+    for (int idx : dirtyBlocks) {
+        blockNumbers.append(m_mathjaxBlocks[idx].mathjaxBlock().m_blockNumber);
+    }
+
+    // Pending requests of the last time stamp are dropped.
+    m_scheduler->schedule(dirtyBlocks, blockNumbers);
+
+    // Obsolete previews of the deferred blocks are checked out at once.
+    if (dirtyBlocks.isEmpty() || !m_scheduler->isEmpty()) {
         updateInplacePreview();
     }
 
     clearObsoleteCache();
 }
 
-void VMathJaxInplacePreviewHelper::processForInplacePreview(int p_idx)
+void VMathJaxInplacePreviewHelper::requestPreviews(const QVector<int> &p_indexes)
 {
-    MathjaxBlockPreviewInfo &mb = m_mathjaxBlocks[p_idx];
-    const VMathjaxBlock &vmb = mb.mathjaxBlock();
-    if (vmb.m_text.isEmpty()) {
-        updateInplacePreview();
-    } else {
-        if (!textToHtmlViaWebView(vmb.m_text, p_idx, m_timeStamp)) {
-            updateInplacePreview();
+    QVector<int> ids;
+    QStringList texts;
+    for (int idx : p_indexes) {
+        if (idx < m_mathjaxBlocks.size()) {
+            ids.append(idx);
+            texts.append(m_mathjaxBlocks[idx].mathjaxBlock().m_text);
         }
     }
+
+    if (!ids.isEmpty()) {
+        m_document->textToHtmlBatchAsync(m_documentID, m_timeStamp, ids, texts, false);
+    }
 }
 
-bool VMathJaxInplacePreviewHelper::textToHtmlViaWebView(const QString &p_text,
-                                                        int p_id,
-                                                        int p_timeStamp)
+int VMathJaxInplacePreviewHelper::fontSize() const
 {
-    if (!m_document->isReadyToTextToHtml()) {
-        qDebug() << "web side is not ready to convert text to HTML";
-        return false;
-    }
+    return QFontInfo(m_doc->defaultFont()).pixelSize();
+}
 
-    m_document->textToHtmlAsync(m_documentID, p_id, p_timeStamp, p_text, false);
-    return true;
+QString VMathJaxInplacePreviewHelper::cacheKey(const QString &p_text) const
+{
+    return QString::number(fontSize()) + "\n" + p_text;
 }
 
 void VMathJaxInplacePreviewHelper::updateInplacePreview()
@@ -186,50 +254,71 @@ void VMathJaxInplacePreviewHelper::updateInplacePreview()
     }
 }
 
-void VMathJaxInplacePreviewHelper::mathjaxPreviewResultReady(int p_identitifer,
-                                                             int p_id,
-                                                             TimeStamp p_timeStamp,
-                                                             const QString &p_format,
-                                                             const QByteArray &p_data)
+void VMathJaxInplacePreviewHelper::mathjaxBatchPreviewResultReady(int p_identitifer,
+                                                                  TimeStamp p_timeStamp,
+                                                                  const QVector<int> &p_ids,
+                                                                  const QString &p_format,
+                                                                  const QVector<QByteArray> &p_data)
 {
     if (p_identitifer != m_mathJaxID || p_timeStamp != m_timeStamp) {
         return;
     }
 
-    if (p_id >= m_mathjaxBlocks.size() || p_data.isEmpty()) {
-        updateInplacePreview();
-        return;
+    // Update the cache.
+    QSet<QString> keys;
+    for (int i = 0; i < p_ids.size() && i < p_data.size(); ++i) {
+        int id = p_ids[i];
+        if (id >= m_mathjaxBlocks.size() || p_data[i].isEmpty()) {
+            continue;
+        }
+
+        const QString &text = m_mathjaxBlocks[id].mathjaxBlock().m_text;
+        QSharedPointer<MathjaxImageCacheEntry> entry(new MathjaxImageCacheEntry(p_timeStamp,
+                                                                                p_data[i],
+                                                                                p_format));
+        QString key = cacheKey(text);
+        m_cache.insert(key, entry);
+        VRenderCache::insert(renderCacheKey(text), p_data[i]);
+        keys.insert(key);
     }
 
-    MathjaxBlockPreviewInfo &mb = m_mathjaxBlocks[p_id];
-    // Update the cache.
-    QSharedPointer<MathjaxImageCacheEntry> entry(new MathjaxImageCacheEntry(p_timeStamp,
-                                                                            p_data,
-                                                                            p_format));
-    m_cache.insert(mb.mathjaxBlock().m_text, entry);
-    mb.updateInplacePreview(m_editor, m_doc, entry->m_image, QString());
+    // Blocks of the same formula share the result.
+    if (!keys.isEmpty()) {
+        for (auto & mb : m_mathjaxBlocks) {
+            if (mb.inplacePreviewReady()) {
+                continue;
+            }
+
+            QString key = cacheKey(mb.mathjaxBlock().m_text);
+            if (!keys.contains(key)) {
+                continue;
+            }
 
-    if (mb.inplacePreview()) {
-        entry->m_imageName = mb.inplacePreview()->m_name;
+            const QSharedPointer<MathjaxImageCacheEntry> &entry = m_cache[key];
+            mb.updateInplacePreview(m_editor, m_doc, entry->m_image, entry->m_imageName);
+            if (entry->m_imageName.isEmpty() && mb.inplacePreview()) {
+                entry->m_imageName = mb.inplacePreview()->m_name;
+            }
+        }
     }
 
     updateInplacePreview();
 }
 
-void VMathJaxInplacePreviewHelper::textToHtmlFinished(int p_identitifer,
-                                                      int p_id,
-                                                      int p_timeStamp,
-                                                      const QString &p_html)
+void VMathJaxInplacePreviewHelper::textToHtmlBatchFinished(int p_identitifer,
+                                                           int p_timeStamp,
+                                                           const QVector<int> &p_ids,
+                                                           const QStringList &p_htmls)
 {
     if (m_documentID != p_identitifer || m_timeStamp != (TimeStamp)p_timeStamp) {
         return;
     }
 
-    Q_ASSERT(p_html.startsWith("<"));
-    m_mathJaxHelper->previewMathJaxFromHtml(m_mathJaxID,
-                                            p_id,
-                                            p_timeStamp,
-                                            p_html);
+    m_mathJaxHelper->previewMathJaxBatchFromHtml(m_mathJaxID,
+                                                 p_timeStamp,
+                                                 p_ids,
+                                                 p_htmls,
+                                                 fontSize());
 }
 
 void VMathJaxInplacePreviewHelper::clearObsoleteCache()
@@ -247,3 +336,28 @@ void VMathJaxInplacePreviewHelper::clearObsoleteCache()
         }
     }
 }
+
+void VMathJaxInplacePreviewHelper::loadFromRenderCache(const QString &p_text)
+{
+    QByteArray data;
+    if (!VRenderCache::lookup(renderCacheKey(p_text), data)) {
+        return;
+    }
+
+    // Let QPixmap detect the format.
+    QSharedPointer<MathjaxImageCacheEntry> entry(new MathjaxImageCacheEntry(m_timeStamp,
+                                                                            data,
+                                                                            QString()));
+    if (!entry->m_image.isNull()) {
+        m_cache.insert(cacheKey(p_text), entry);
+    }
+}
+
+QByteArray VMathJaxInplacePreviewHelper::renderCacheKey(const QString &p_text) const
+{
+    // The MathJax script, the device pixel ratio and the font size determine the image.
+    QString renderer = QString("mathjax\n%1\n%2\n%3").arg(g_config->getMathjaxJavascript())
+                                                      .arg(qApp->devicePixelRatio())
+                                                      .arg(fontSize());
+    return VRenderCache::key(renderer, "image", p_text);
+}
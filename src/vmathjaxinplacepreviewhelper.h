@@ -11,6 +11,7 @@ class VEditor;
 class VDocument;
 class QTextDocument;
 class VMathJaxPreviewHelper;
+class VPreviewScheduler;
 
 class MathjaxBlockPreviewInfo
 {
@@ -67,8 +68,12 @@ public:
 
     void setEnabled(bool p_enabled);
 
+    // Bytes of the MathJax blocks and the cached preview images.
+    // The pixmaps are shared with the image resources of the editor.
+    qint64 approximateBytes() const;
+
 public slots:
-    void updateMathjaxBlocks(const QVector<VMathjaxBlock> &p_blocks);
+    void updateMathjaxBlocks(const QSharedPointer<const VDocumentStructure> &p_structure);
 
 signals:
     void inplacePreviewMathjaxBlockUpdated(const QVector<QSharedPointer<VImageToPreview> > &p_images);
@@ -76,13 +81,16 @@ signals:
     void checkBlocksForObsoletePreview(const QList<int> &p_blocks);
 
 private slots:
-    void mathjaxPreviewResultReady(int p_identitifer,
-                                   int p_id,
-                                   TimeStamp p_timeStamp,
-                                   const QString &p_format,
-                                   const QByteArray &p_data);
+    void mathjaxBatchPreviewResultReady(int p_identitifer,
+                                        TimeStamp p_timeStamp,
+                                        const QVector<int> &p_ids,
+                                        const QString &p_format,
+                                        const QVector<QByteArray> &p_data);
 
-    void textToHtmlFinished(int p_identitifer, int p_id, int p_timeStamp, const QString &p_html);
+    void textToHtmlBatchFinished(int p_identitifer,
+                                 int p_timeStamp,
+                                 const QVector<int> &p_ids,
+                                 const QStringList &p_htmls);
 
 private:
     struct MathjaxImageCacheEntry
@@ -108,17 +116,25 @@ private:
     };
 
 
-    void processForInplacePreview(int p_idx);
-
     // Emit signal to update inplace preview.
     void updateInplacePreview();
 
-    bool textToHtmlViaWebView(const QString &p_text,
-                              int p_id,
-                              int p_timeStamp);
+    // Request previews of blocks @p_indexes of @m_mathjaxBlocks in one batch.
+    void requestPreviews(const QVector<int> &p_indexes);
+
+    // Font size in pixels of the editor which the previews are rendered in.
+    int fontSize() const;
+
+    // Key of @m_cache.
+    QString cacheKey(const QString &p_text) const;
 
     void clearObsoleteCache();
 
+    // Load the render of @p_text from the render cache into @m_cache.
+    void loadFromRenderCache(const QString &p_text);
+
+    QByteArray renderCacheKey(const QString &p_text) const;
+
     VEditor *m_editor;
 
     VDocument *m_document;
@@ -127,6 +143,9 @@ private:
 
     bool m_enabled;
 
+    // Version of the document structure of m_mathjaxBlocks.
+    quint64 m_mathjaxBlocksVersion;
+
     VMathJaxPreviewHelper *m_mathJaxHelper;
 
     // Identification for VMathJaxPreviewHelper.
@@ -136,12 +155,15 @@ private:
 
     TimeStamp m_timeStamp;
 
+    // Order the preview requests by the viewport.
+    VPreviewScheduler *m_scheduler;
+
     // Sorted by m_blockNumber in ascending order.
     QVector<MathjaxBlockPreviewInfo> m_mathjaxBlocks;
 
     int m_documentID;
 
-    // Indexed by content.
+    // Indexed by font size and content.
     QHash<QString, QSharedPointer<MathjaxImageCacheEntry>> m_cache;
 };
 
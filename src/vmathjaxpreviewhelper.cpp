@@ -6,9 +6,16 @@
 #include "utils/vutils.h"
 #include "vmathjaxwebdocument.h"
 #include "vconfigmanager.h"
+#include "vtracer.h"
 
 extern VConfigManager *g_config;
 
+// ID to match the trace events of one render.
+static QString traceId(int p_identifier, int p_id, TimeStamp p_timeStamp)
+{
+    return QString("%1-%2-%3").arg(p_identifier).arg(p_id).arg(p_timeStamp);
+}
+
 VMathJaxPreviewHelper::VMathJaxPreviewHelper(QWidget *p_parentWidget, QObject *p_parent)
     : QObject(p_parent),
       m_parentWidget(p_parentWidget),
@@ -50,16 +57,38 @@ void VMathJaxPreviewHelper::doInit()
                          TimeStamp p_timeStamp,
                          const QString &p_format,
                          const QString &p_data) {
+                VTracer::asyncEnd("preview", "MathJax render", traceId(p_identifier, p_id, p_timeStamp));
+
                 QByteArray ba = QByteArray::fromBase64(p_data.toUtf8());
                 emit mathjaxPreviewResultReady(p_identifier, p_id, p_timeStamp, p_format, ba);
             });
 
+    connect(m_webDoc, &VMathJaxWebDocument::mathjaxBatchPreviewResultReady,
+            this, [this](int p_identifier,
+                         TimeStamp p_timeStamp,
+                         const QVector<int> &p_ids,
+                         const QString &p_format,
+                         const QStringList &p_data) {
+                VTracer::asyncEnd("preview", "MathJax batch render", traceId(p_identifier, -1, p_timeStamp));
+
+                QVector<QByteArray> data;
+                data.reserve(p_ids.size());
+                for (int i = 0; i < p_ids.size(); ++i) {
+                    data.append(i < p_data.size() ? QByteArray::fromBase64(p_data[i].toUtf8())
+                                                  : QByteArray());
+                }
+
+                emit mathjaxBatchPreviewResultReady(p_identifier, p_timeStamp, p_ids, p_format, data);
+            });
+
     connect(m_webDoc, &VMathJaxWebDocument::diagramPreviewResultReady,
             this, [this](int p_identifier,
                         int p_id,
                         TimeStamp p_timeStamp,
                         const QString &p_format,
                         const QString &p_data) {
+                VTracer::asyncEnd("preview", "Diagram render", traceId(p_identifier, p_id, p_timeStamp));
+
                 QByteArray ba;
                 if (p_format == "png") {
                     ba = QByteArray::fromBase64(p_data.toUtf8());
@@ -88,6 +117,8 @@ void VMathJaxPreviewHelper::previewMathJax(int p_identifier,
 {
     init();
 
+    VTracer::asyncBegin("preview", "MathJax render", traceId(p_identifier, p_id, p_timeStamp));
+
     if (!m_webReady) {
         auto func = std::bind(&VMathJaxWebDocument::previewMathJax,
                               m_webDoc,
@@ -109,6 +140,8 @@ void VMathJaxPreviewHelper::previewMathJaxFromHtml(int p_identifier,
 {
     init();
 
+    VTracer::asyncBegin("preview", "MathJax render", traceId(p_identifier, p_id, p_timeStamp));
+
     if (!m_webReady) {
         auto func = std::bind(&VMathJaxWebDocument::previewMathJax,
                               m_webDoc,
@@ -123,6 +156,36 @@ void VMathJaxPreviewHelper::previewMathJaxFromHtml(int p_identifier,
     }
 }
 
+void VMathJaxPreviewHelper::previewMathJaxBatchFromHtml(int p_identifier,
+                                                        TimeStamp p_timeStamp,
+                                                        const QVector<int> &p_ids,
+                                                        const QStringList &p_htmls,
+                                                        int p_fontSize)
+{
+    init();
+
+    if (VTracer::isEnabled()) {
+        VTracer::asyncBegin("preview",
+                            "MathJax batch render",
+                            traceId(p_identifier, -1, p_timeStamp),
+                            QString("%1 blocks").arg(p_ids.size()));
+    }
+
+    if (!m_webReady) {
+        auto func = std::bind(&VMathJaxWebDocument::previewMathJaxBatch,
+                              m_webDoc,
+                              p_identifier,
+                              p_timeStamp,
+                              p_ids,
+                              p_htmls,
+                              true,
+                              p_fontSize);
+        m_pendingFunc.append(func);
+    } else {
+        m_webDoc->previewMathJaxBatch(p_identifier, p_timeStamp, p_ids, p_htmls, true, p_fontSize);
+    }
+}
+
 void VMathJaxPreviewHelper::previewDiagram(int p_identifier,
                                            int p_id,
                                            TimeStamp p_timeStamp,
@@ -131,6 +194,8 @@ void VMathJaxPreviewHelper::previewDiagram(int p_identifier,
 {
     init();
 
+    VTracer::asyncBegin("preview", "Diagram render", traceId(p_identifier, p_id, p_timeStamp), p_lang);
+
     if (!m_webReady) {
         auto func = std::bind(&VMathJaxWebDocument::previewDiagram,
                               m_webDoc,
@@ -4,6 +4,7 @@
 #include <QObject>
 #include <functional>
 #include <QVector>
+#include <QStringList>
 
 #include "vconstants.h"
 
@@ -32,6 +33,16 @@ public:
 
     void previewMathJaxFromHtml(int p_identitifer, int p_id, TimeStamp p_timeStamp, const QString &p_html);
 
+    // Preview all @p_htmls of @p_timeStamp in one call and return the data of
+    // all of them asynchronously in one signal.
+    // @p_ids: internal id of each HTML;
+    // @p_fontSize: font size in pixels to render in, 0 to use the default.
+    void previewMathJaxBatchFromHtml(int p_identifier,
+                                     TimeStamp p_timeStamp,
+                                     const QVector<int> &p_ids,
+                                     const QStringList &p_htmls,
+                                     int p_fontSize);
+
     // Preview @p_text and return PNG data asynchronously.
     // @p_identifier: identifier the caller registered;
     // @p_id: internal id for each caller;
@@ -50,6 +61,13 @@ signals:
                                    const QString &p_format,
                                    const QByteArray &p_data);
 
+    // @p_data: empty for those failed.
+    void mathjaxBatchPreviewResultReady(int p_identifier,
+                                        TimeStamp p_timeStamp,
+                                        const QVector<int> &p_ids,
+                                        const QString &p_format,
+                                        const QVector<QByteArray> &p_data);
+
     void diagramPreviewResultReady(int p_identifier,
                                    int p_id,
                                    TimeStamp p_timeStamp,
@@ -16,6 +16,38 @@ void VMathJaxWebDocument::previewMathJax(int p_identifier,
     emit requestPreviewMathJax(p_identifier, p_id, p_timeStamp, p_text, p_isHtml);
 }
 
+void VMathJaxWebDocument::previewMathJaxBatch(int p_identifier,
+                                              TimeStamp p_timeStamp,
+                                              const QVector<int> &p_ids,
+                                              const QStringList &p_texts,
+                                              bool p_isHtml,
+                                              int p_fontSize)
+{
+    Q_ASSERT(p_ids.size() == p_texts.size());
+    QVariantList ids;
+    ids.reserve(p_ids.size());
+    for (int id : p_ids) {
+        ids.append(id);
+    }
+
+    emit requestPreviewMathJaxBatch(p_identifier, p_timeStamp, ids, p_texts, p_isHtml, p_fontSize);
+}
+
+void VMathJaxWebDocument::mathjaxBatchResultReady(int p_identifier,
+                                                  unsigned long long p_timeStamp,
+                                                  const QVariantList &p_ids,
+                                                  const QString &p_format,
+                                                  const QStringList &p_data)
+{
+    QVector<int> ids;
+    ids.reserve(p_ids.size());
+    for (auto const & id : p_ids) {
+        ids.append(id.toInt());
+    }
+
+    emit mathjaxBatchPreviewResultReady(p_identifier, p_timeStamp, ids, p_format, p_data);
+}
+
 void VMathJaxWebDocument::mathjaxResultReady(int p_identifier,
                                              int p_id,
                                              unsigned long long p_timeStamp,
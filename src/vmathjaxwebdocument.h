@@ -2,6 +2,9 @@
 #define VMATHJAXWEBDOCUMENT_H
 
 #include <QObject>
+#include <QVector>
+#include <QStringList>
+#include <QVariantList>
 
 #include "vconstants.h"
 
@@ -17,6 +20,14 @@ public:
                         const QString &p_text,
                         bool p_isHtml);
 
+    // @p_fontSize: font size in pixels, 0 to use the default.
+    void previewMathJaxBatch(int p_identifier,
+                             TimeStamp p_timeStamp,
+                             const QVector<int> &p_ids,
+                             const QStringList &p_texts,
+                             bool p_isHtml,
+                             int p_fontSize);
+
     void previewDiagram(int p_identifier,
                         int p_id,
                         TimeStamp p_timeStamp,
@@ -32,6 +43,12 @@ public slots:
                             const QString &p_format,
                             const QString &p_data);
 
+    void mathjaxBatchResultReady(int p_identifier,
+                                 unsigned long long p_timeStamp,
+                                 const QVariantList &p_ids,
+                                 const QString &p_format,
+                                 const QStringList &p_data);
+
     void diagramResultReady(int p_identifier,
                             int p_id,
                             unsigned long long p_timeStamp,
@@ -47,6 +64,13 @@ signals:
                                const QString &p_text,
                                bool p_isHtml);
 
+    void requestPreviewMathJaxBatch(int p_identifier,
+                                    unsigned long long p_timeStamp,
+                                    const QVariantList &p_ids,
+                                    const QStringList &p_texts,
+                                    bool p_isHtml,
+                                    int p_fontSize);
+
     void requestPreviewDiagram(int p_identifier,
                                int p_id,
                                unsigned long long p_timeStamp,
@@ -59,6 +83,12 @@ signals:
                                    const QString &p_format,
                                    const QString &p_data);
 
+    void mathjaxBatchPreviewResultReady(int p_identifier,
+                                        TimeStamp p_timeStamp,
+                                        const QVector<int> &p_ids,
+                                        const QString &p_format,
+                                        const QStringList &p_data);
+
     void diagramPreviewResultReady(int p_identifier,
                                    int p_id,
                                    TimeStamp p_timeStamp,
@@ -25,6 +25,7 @@
 #include "vconfigmanager.h"
 #include "utils/vvim.h"
 #include "utils/veditutils.h"
+#include "vimageencoder.h"
 
 extern VConfigManager *g_config;
 
@@ -86,33 +87,45 @@ void VMdEditOperations::insertImageFromQImage(const QString &p_title,
                                               int p_width,
                                               int p_height)
 {
-    QString fileName = VUtils::generateImageFileName(p_folderPath, p_title);
-    QString filePath = QDir(p_folderPath).filePath(fileName);
-    V_ASSERT(!QFile(filePath).exists());
-
-    QString errStr;
-    bool ret = VUtils::makePath(p_folderPath);
-    if (!ret) {
-        errStr = tr("Fail to create image folder <span style=\"%1\">%2</span>.")
-                   .arg(g_config->c_dataTextStyle).arg(p_folderPath);
+    QString format = VImageEncoder::saveFormat();
+    int quality = g_config->getImageSaveQuality();
+
+    // An image named by content may exist already.
+    bool exists = false;
+    QString fileName;
+    QString filePath;
+    if (m_file->useContentAddressedImages()) {
+        fileName = VUtils::contentImageFileName(p_image, format, quality);
+        filePath = QDir(p_folderPath).filePath(fileName);
+        exists = QFileInfo::exists(filePath)
+                 || !VImageEncoder::inst()->pendingImage(filePath).isNull();
     } else {
-        ret = p_image.save(filePath);
-        if (!ret) {
-            errStr = tr("Fail to save image <span style=\"%1\">%2</span>.")
-                       .arg(g_config->c_dataTextStyle).arg(filePath);
-        }
+        fileName = VUtils::generateImageFileName(p_folderPath, p_title, format);
+        filePath = QDir(p_folderPath).filePath(fileName);
+        V_ASSERT(!QFile(filePath).exists());
     }
 
-    if (!ret) {
+    if (!VUtils::makePath(p_folderPath)) {
         VUtils::showMessage(QMessageBox::Warning, tr("Warning"),
                             tr("Fail to insert image <span style=\"%1\">%2</span>.").arg(g_config->c_dataTextStyle).arg(p_title),
-                            errStr,
+                            tr("Fail to create image folder <span style=\"%1\">%2</span>.")
+                              .arg(g_config->c_dataTextStyle).arg(p_folderPath),
                             QMessageBox::Ok,
                             QMessageBox::Ok,
                             m_editor->getEditor());
         return;
     }
 
+    // Insert the link at once and let the preview use the image in memory
+    // until it is written.
+    int saveId = -1;
+    if (!exists) {
+        saveId = VImageEncoder::inst()->save(filePath,
+                                             p_image,
+                                             format,
+                                             quality);
+    }
+
     QString url = QDir::fromNativeSeparators(QString("%1/%2").arg(p_folderInLink).arg(fileName));
     url = VUtils::encodeSpacesInPath(url);
     if (g_config->getPrependDotInRelativePath()) {
@@ -125,7 +138,7 @@ void VMdEditOperations::insertImageFromQImage(const QString &p_title,
 
     VMdEditor *mdEditor = dynamic_cast<VMdEditor *>(m_editor);
     Q_ASSERT(mdEditor);
-    mdEditor->imageInserted(filePath, url);
+    mdEditor->imageInserted(filePath, url, saveId);
 }
 
 void VMdEditOperations::insertImageFromPath(const QString &p_title,
@@ -168,18 +181,33 @@ void VMdEditOperations::insertImageFromPath(const QString &p_title,
         return;
     }
 
-    QString fileName = VUtils::generateImageFileName(p_folderPath,
-                                                     p_title,
-                                                     QFileInfo(p_srcImagePath).suffix());
-    QString filePath = QDir(p_folderPath).filePath(fileName);
-    V_ASSERT(!QFile(filePath).exists());
+    // An image named by content may exist already.
+    bool exists = false;
+    QString fileName;
+    QString filePath;
+    QString suffix = QFileInfo(p_srcImagePath).suffix();
+    if (m_file->useContentAddressedImages()) {
+        QFile srcFile(p_srcImagePath);
+        if (!srcFile.open(QIODevice::ReadOnly)) {
+            qWarning() << "fail to read source image" << p_srcImagePath;
+            return;
+        }
+
+        fileName = VUtils::contentImageFileName(srcFile.readAll(), suffix);
+        filePath = QDir(p_folderPath).filePath(fileName);
+        exists = QFileInfo::exists(filePath);
+    } else {
+        fileName = VUtils::generateImageFileName(p_folderPath, p_title, suffix);
+        filePath = QDir(p_folderPath).filePath(fileName);
+        V_ASSERT(!QFile(filePath).exists());
+    }
 
     QString errStr;
     bool ret = VUtils::makePath(p_folderPath);
     if (!ret) {
         errStr = tr("Fail to create image folder <span style=\"%1\">%2</span>.")
                    .arg(g_config->c_dataTextStyle).arg(p_folderPath);
-    } else {
+    } else if (!exists) {
         ret = QFile::copy(p_srcImagePath, filePath);
         if (!ret) {
             errStr = tr("Fail to copy image <span style=\"%1\">%2</span>.")
@@ -668,6 +696,7 @@ bool VMdEditOperations::handleKeyBackTab(QKeyEvent *p_event)
 
     VEditUtils::indentSelectedBlocks(cursor, m_editConfig->m_tabSpaces, false);
     cursor.endEditBlock();
+    m_editor->setTextCursorW(cursor);
 
     if (continueAutoIndent) {
         m_autoIndentPos = m_editor->textCursorW().position();
@@ -871,12 +900,10 @@ bool VMdEditOperations::decorateHeading(int p_level)
         lastBlock = doc->findBlock(end).blockNumber();
     }
 
-    cursor.beginEditBlock();
-    for (int i = firstBlock; i <= lastBlock; ++i) {
-        VEditUtils::insertTitleMark(cursor, doc->findBlockByNumber(i), p_level);
-    }
-
-    cursor.endEditBlock();
+    VEditUtils::insertTitleMark(cursor,
+                                doc->findBlockByNumber(firstBlock),
+                                doc->findBlockByNumber(lastBlock),
+                                p_level);
     m_editor->setTextCursorW(cursor);
     return true;
 }
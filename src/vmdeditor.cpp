@@ -8,6 +8,7 @@
 #include <QMimeDatabase>
 #include <QTemporaryFile>
 #include <QProgressDialog>
+#include <QRunnable>
 
 #include "vdocument.h"
 #include "utils/veditutils.h"
@@ -22,6 +23,7 @@
 #include "vtextblockdata.h"
 #include "vorphanfile.h"
 #include "vnotefile.h"
+#include "vnotebook.h"
 #include "vpreviewmanager.h"
 #include "utils/viconutils.h"
 #include "dialog/vcopytextashtmldialog.h"
@@ -33,6 +35,12 @@
 #include "vmdtab.h"
 #include "vdownloader.h"
 #include "vtablehelper.h"
+#include "vlatencystats.h"
+#include "vimageencoder.h"
+#include "vhtmltomarkdownservice.h"
+#include "vwordcounter.h"
+#include "vdocumentgovernor.h"
+#include "vtaskexecutor.h"
 #include "dialog/vinserttabledialog.h"
 
 extern VWebUtils *g_webUtils;
@@ -41,6 +49,9 @@ extern VConfigManager *g_config;
 
 #define LINE_NUMBER_AREA_FONT_DELTA -2
 
+// Characters to insert at a time when loading a large file.
+#define LARGE_FILE_CHUNK_SIZE (1024 * 1024)
+
 VMdEditor::VMdEditor(VFile *p_file,
                      VDocument *p_doc,
                      MarkdownConverterType p_type,
@@ -50,10 +61,13 @@ VMdEditor::VMdEditor(VFile *p_file,
       VEditor(p_file, this, p_completer),
       m_pegHighlighter(NULL),
       m_freshEdit(true),
+      m_loadingContent(false),
+      m_headersVersion(0),
       m_textToHtmlDialog(NULL),
       m_zoomDelta(0),
       m_editTab(NULL),
-      m_copyTimeStamp(0)
+      m_copyTimeStamp(0),
+      m_htmlToTextId(-1)
 {
     Q_ASSERT(p_file->getDocType() == DocType::Markdown);
 
@@ -73,6 +87,12 @@ VMdEditor::VMdEditor(VFile *p_file,
                 }
             });
 
+    m_wordCounter.reset(new VWordCounter(document()));
+    connect(document(), &QTextDocument::contentsChange,
+            this, [this](int p_position, int p_charsRemoved, int p_charsAdded) {
+                m_wordCounter->update(p_position, p_charsRemoved, p_charsAdded);
+            });
+
     connect(this, &VTextEdit::selectionChanged,
             this, [this]() {
                 highlightSelectedWord();
@@ -81,17 +101,30 @@ VMdEditor::VMdEditor(VFile *p_file,
 
     setReadOnly(true);
 
+    m_latencyStats = new VLatencyStats(p_file->fetchPath(), this);
+    setLatencyStats(m_latencyStats);
+
+    m_governor = new VDocumentGovernor(this);
+
+    setLazyLayoutBlockCount(g_config->getLazyLayoutBlockCount());
+
+    setLongLineLength(g_config->getLongLineLength());
+
     m_pegHighlighter = new PegMarkdownHighlighter(document(), this);
     m_pegHighlighter->init(g_config->getMdHighlightingStyles(),
                            g_config->getCodeBlockStyles(),
                            g_config->getEnableMathjax(),
                            g_config->getMarkdownHighlightInterval());
-    connect(m_pegHighlighter, &PegMarkdownHighlighter::headersUpdated,
+    if (m_file->isLargeFile()) {
+        m_pegHighlighter->setParseEnabled(false);
+    }
+
+    connect(m_pegHighlighter, &PegMarkdownHighlighter::structureUpdated,
             this, &VMdEditor::updateHeaders);
 
     // After highlight, the cursor may trun into non-visible. We should make it visible
     // in this case.
-    connect(m_pegHighlighter, &PegMarkdownHighlighter::highlightCompleted,
+    connect(m_pegHighlighter, &PegMarkdownHighlighter::visibleHighlightCompleted,
             this, [this]() {
             scrollCursorLineIfNecessary();
 
@@ -106,15 +139,31 @@ VMdEditor::VMdEditor(VFile *p_file,
                                                     p_type);
 
     m_previewMgr = new VPreviewManager(this, m_pegHighlighter);
-    connect(m_pegHighlighter, &PegMarkdownHighlighter::imageLinksUpdated,
+    connect(m_pegHighlighter, &PegMarkdownHighlighter::structureUpdated,
             m_previewMgr, &VPreviewManager::updateImageLinks);
     connect(m_previewMgr, &VPreviewManager::requestUpdateImageLinks,
             m_pegHighlighter, &PegMarkdownHighlighter::updateHighlight);
 
     m_tableHelper = new VTableHelper(this);
-    connect(m_pegHighlighter, &PegMarkdownHighlighter::tableBlocksUpdated,
+    connect(m_pegHighlighter, &PegMarkdownHighlighter::structureUpdated,
             m_tableHelper, &VTableHelper::updateTableBlocks);
 
+    connect(m_pegHighlighter, &PegMarkdownHighlighter::fullParseFinished,
+            m_governor, &VDocumentGovernor::recordParseTime);
+    connect(m_governor, &VDocumentGovernor::levelChanged,
+            this, &VMdEditor::applyFeatureLevel);
+
+    connect(VImageEncoder::inst(), &VImageEncoder::imageSaved,
+            this, &VMdEditor::handleImageSaved);
+
+    connect(VHtmlToMarkdownService::inst(), &VHtmlToMarkdownService::converted,
+            this, [this](int p_id, const QString &p_text) {
+                if (p_id == m_htmlToTextId) {
+                    m_htmlToTextId = -1;
+                    htmlToTextFinished(0, m_copyTimeStamp, p_text);
+                }
+            });
+
     m_editOps = new VMdEditOperations(this, m_file);
     connect(m_editOps, &VEditOperations::statusMessage,
             m_object, &VEditorObject::statusMessage);
@@ -174,7 +223,8 @@ void VMdEditor::beginEdit()
         m_pegHighlighter->updateHighlight();
         relayout();
     } else {
-        updateHeaders(m_pegHighlighter->getHeaderRegions());
+        // The tab may hold the outline of read mode.
+        updateHeadersHelper(m_pegHighlighter->getHeaderRegions(), false, true);
     }
 }
 
@@ -189,16 +239,15 @@ void VMdEditor::saveFile()
 {
     Q_ASSERT(m_file->isModifiable());
 
-    if (!document()->isModified()) {
+    if (!document()->isModified() || m_loadingContent) {
         return;
     }
 
     m_file->setContent(toPlainText());
     setModified(false);
 
-    clearUnusedImages();
-
-    initInitImages();
+    // Images still in use become the initial images of next save.
+    clearUnusedImages(&m_initImages);
 }
 
 void VMdEditor::reloadFile()
@@ -206,18 +255,84 @@ void VMdEditor::reloadFile()
     bool readonly = isReadOnly();
     setReadOnly(true);
 
-    const QString &content = m_file->getContent();
-    setPlainText(content);
+    if (m_file->isLargeFile()) {
+        loadContentInChunks(m_file->getContent());
+    } else {
+        const QString &content = m_file->getContent();
+        setPlainText(content);
+    }
+
     setModified(false);
 
     setReadOnly(readonly);
 
+    // The document holds the content now.
+    m_file->releaseContent();
+
+    m_governor->evaluate(document()->characterCount(),
+                         document()->blockCount(),
+                         m_file->isLargeFile());
+
     if (!m_freshEdit) {
         m_freshEdit = true;
         refreshPreview();
     }
 }
 
+static int nextChunkEnd(const QString &p_content, int p_start)
+{
+    int end = qMin(p_content.size(), p_start + LARGE_FILE_CHUNK_SIZE);
+    if (end < p_content.size()) {
+        // Break at a line end to keep the chunks clean.
+        int idx = p_content.lastIndexOf(QLatin1Char('\n'), end - 1);
+        if (idx >= p_start) {
+            end = idx + 1;
+        }
+    }
+
+    return end;
+}
+
+void VMdEditor::loadContentInChunks(const QString &p_content)
+{
+    // Hold a reference in case the file content is changed meanwhile.
+    const QString content(p_content);
+
+    int pos = nextChunkEnd(content, 0);
+    setPlainText(content.left(pos));
+    if (pos >= content.size()) {
+        return;
+    }
+
+    // Timers keep firing in between. Hold back saving, reloading and
+    // cleaning up images until the whole content is loaded.
+    m_loadingContent = true;
+
+    // No need to undo the loading.
+    bool undoEnabled = document()->isUndoRedoEnabled();
+    document()->setUndoRedoEnabled(false);
+
+    QPointer<VMdEditor> guard(this);
+    QTextCursor cursor(document());
+    while (pos < content.size()) {
+        // Let the loaded part be painted, but hold back user input until the
+        // whole document is loaded.
+        QCoreApplication::processEvents(QEventLoop::ExcludeUserInputEvents);
+        if (!guard) {
+            // Destroyed meanwhile.
+            return;
+        }
+
+        int end = nextChunkEnd(content, pos);
+        cursor.movePosition(QTextCursor::End);
+        cursor.insertText(content.mid(pos, end - pos));
+        pos = end;
+    }
+
+    document()->setUndoRedoEnabled(undoEnabled);
+    m_loadingContent = false;
+}
+
 bool VMdEditor::scrollToBlock(int p_blockNumber)
 {
     QTextBlock block = document()->findBlockByNumber(p_blockNumber);
@@ -580,7 +695,9 @@ void VMdEditor::updateHeaderSequenceByConfigChange()
     updateHeadersHelper(m_pegHighlighter->getHeaderRegions(), true);
 }
 
-void VMdEditor::updateHeadersHelper(const QVector<VElementRegion> &p_headerRegions, bool p_configChanged)
+void VMdEditor::updateHeadersHelper(const QVector<VElementRegion> &p_headerRegions,
+                                    bool p_configChanged,
+                                    bool p_forceNotify)
 {
     QTextDocument *doc = document();
 
@@ -627,7 +744,8 @@ void VMdEditor::updateHeadersHelper(const QVector<VElementRegion> &p_headerRegio
         }
     }
 
-    m_headers.clear();
+    QVector<VTableOfContentItem> newHeaders;
+    newHeaders.reserve(headers.size());
 
     bool autoSequence = m_config.m_enableHeadingSequence
                         && !isReadOnly()
@@ -651,17 +769,17 @@ void VMdEditor::updateHeadersHelper(const QVector<VElementRegion> &p_headerRegio
             curLevel += 1;
 
             // Insert empty level which is an invalid header.
-            m_headers.append(VTableOfContentItem(c_emptyHeaderName,
-                                                 curLevel,
-                                                 -1,
-                                                 m_headers.size()));
+            newHeaders.append(VTableOfContentItem(c_emptyHeaderName,
+                                                  curLevel,
+                                                  -1,
+                                                  newHeaders.size()));
             if (autoSequence || p_configChanged) {
                 addHeaderSequence(seqs, curLevel, headingSequenceBaseLevel);
             }
         }
 
-        item.m_index = m_headers.size();
-        m_headers.append(item);
+        item.m_index = newHeaders.size();
+        newHeaders.append(item);
         curLevel = item.m_level;
         if (autoSequence || p_configChanged) {
             addHeaderSequence(seqs, item.m_level, headingSequenceBaseLevel);
@@ -682,14 +800,25 @@ void VMdEditor::updateHeadersHelper(const QVector<VElementRegion> &p_headerRegio
         cursor.endEditBlock();
     }
 
-    emit headersChanged(m_headers);
+    // Most parse results come from edits outside the headers. Only notify
+    // the outline when the headers do change.
+    if (p_forceNotify || newHeaders.isEmpty() || newHeaders != m_headers) {
+        m_headers = newHeaders;
+        emit headersChanged(m_headers);
+    }
 
     updateCurrentHeader();
 }
 
-void VMdEditor::updateHeaders(const QVector<VElementRegion> &p_headerRegions)
+void VMdEditor::updateHeaders(const QSharedPointer<const VDocumentStructure> &p_structure)
 {
-    updateHeadersHelper(p_headerRegions, false);
+    bool unchanged = p_structure->isUnchangedSince(m_headersVersion, VDocumentStructure::Headers);
+    m_headersVersion = p_structure->version();
+    if (unchanged) {
+        return;
+    }
+
+    updateHeadersHelper(p_structure->headerRegions(), false);
 }
 
 void VMdEditor::updateCurrentHeader()
@@ -703,114 +832,178 @@ void VMdEditor::initInitImages()
                                                        ImageLink::LocalRelativeInternal);
 }
 
-void VMdEditor::clearUnusedImages()
+// Key of an image path to compare paths like VUtils::equalPath().
+// Move unused images to the recycle bin in the background.
+class DeleteImagesTask : public QRunnable
 {
-    QVector<ImageLink> images = VUtils::fetchImagesFromMarkdownFile(m_file,
-                                                                    ImageLink::LocalRelativeInternal);
+public:
+    DeleteImagesTask(const QString &p_recycleBinFolderPath, const QStringList &p_paths)
+        : m_recycleBinFolderPath(p_recycleBinFolderPath),
+          m_paths(p_paths)
+    {
+    }
 
-    QSet<QString> unusedImages;
+    void run() Q_DECL_OVERRIDE
+    {
+        if (!VUtils::deleteFiles(m_recycleBinFolderPath, m_paths)) {
+            qWarning() << "fail to delete some unused images" << m_paths;
+        }
+    }
 
-    if (!m_insertedImages.isEmpty()) {
-        for (int i = 0; i < m_insertedImages.size(); ++i) {
-            const ImageLink &link = m_insertedImages[i];
+private:
+    QString m_recycleBinFolderPath;
 
-            if (link.m_type != ImageLink::LocalRelativeInternal) {
+    QStringList m_paths;
+};
+
+void VMdEditor::clearUnusedImages(QVector<ImageLink> *p_usedImages)
+{
+    if (m_loadingContent) {
+        // Images linked by the part not loaded yet are not unused.
+        return;
+    }
+
+    if (!m_pendingImageSaves.isEmpty()) {
+        // Let the inserted images land before checking them.
+        VImageEncoder::inst()->waitForDone();
+    }
+
+    // Images known to exist: the initial ones and the inserted ones.
+    // Path key -> link.
+    QHash<QString, ImageLink> candidates;
+    for (auto const & link : m_initImages) {
+        V_ASSERT(link.m_type == ImageLink::LocalRelativeInternal);
+        candidates.insert(VNoteFile::imagePathKey(link.m_path), link);
+    }
+
+    for (auto const & link : m_insertedImages) {
+        if (link.m_type == ImageLink::LocalRelativeInternal) {
+            candidates.insert(VNoteFile::imagePathKey(link.m_path), link);
+        }
+    }
+
+    m_insertedImages.clear();
+    m_initImages.clear();
+
+    // Resolve the links of current content against the known images without
+    // touching the file system.
+    QVector<ImageLink> usedImages;
+    QSet<QString> fetchedKeys;
+    if (!candidates.isEmpty() || p_usedImages) {
+        QString basePath = m_file->fetchBasePath();
+        QVector<QString> urls = VUtils::fetchImageLinkUrls(m_file->getContent());
+        for (auto const & url : urls) {
+            if (!QDir::isRelativePath(url)) {
                 continue;
             }
 
-            int j;
-            for (j = 0; j < images.size(); ++j) {
-                if (VUtils::equalPath(link.m_path, images[j].m_path)) {
-                    break;
-                }
+            QString path = QDir::cleanPath(QDir(basePath).absoluteFilePath(VUtils::purifyUrl(url)));
+            QString key = VNoteFile::imagePathKey(path);
+            if (fetchedKeys.contains(key)) {
+                continue;
             }
 
-            // This inserted image is no longer in the file.
-            if (j == images.size()) {
-                unusedImages.insert(link.m_path);
+            fetchedKeys.insert(key);
+
+            auto it = candidates.find(key);
+            if (it != candidates.end()) {
+                if (p_usedImages) {
+                    ImageLink link = it.value();
+                    link.m_url = url;
+                    usedImages.append(link);
+                }
+
+                candidates.erase(it);
+            } else if (p_usedImages
+                       && m_file->isInternalImageFolder(VUtils::basePathFromPath(path))
+                       && QFileInfo::exists(path)) {
+                // Internal image linked by hand.
+                ImageLink link;
+                link.m_path = path;
+                link.m_url = url;
+                link.m_type = ImageLink::LocalRelativeInternal;
+                usedImages.append(link);
             }
         }
-
-        m_insertedImages.clear();
     }
 
-    for (int i = 0; i < m_initImages.size(); ++i) {
-        const ImageLink &link = m_initImages[i];
-
-        V_ASSERT(link.m_type == ImageLink::LocalRelativeInternal);
+    if (p_usedImages) {
+        *p_usedImages = usedImages;
+    }
 
-        int j;
-        for (j = 0; j < images.size(); ++j) {
-            if (VUtils::equalPath(link.m_path, images[j].m_path)) {
-                break;
-            }
-        }
+    // Images may be shared with other notes.
+    QSet<QString> sharedImages;
+    if (!candidates.isEmpty() && m_file->getType() == FileType::Note) {
+        VNoteFile *note = static_cast<VNoteFile *>((VFile *)m_file);
+        sharedImages = VNoteFile::fetchImagesOfOtherNotes(QVector<VNoteFile *>() << note);
+    }
 
-        // Original local relative image is no longer in the file.
-        if (j == images.size()) {
-            unusedImages.insert(link.m_path);
+    QStringList unusedImages;
+    for (auto it = candidates.constBegin(); it != candidates.constEnd(); ++it) {
+        if (!sharedImages.contains(it.key())) {
+            unusedImages << it.value().m_path;
         }
     }
 
-    if (!unusedImages.isEmpty()) {
-        if (g_config->getConfirmImagesCleanUp()) {
-            QVector<ConfirmItemInfo> items;
-            for (auto const & img : unusedImages) {
-                items.push_back(ConfirmItemInfo(img,
-                                                img,
-                                                img,
-                                                NULL));
+    if (unusedImages.isEmpty()) {
+        return;
+    }
 
-            }
+    if (g_config->getConfirmImagesCleanUp()) {
+        QVector<ConfirmItemInfo> items;
+        for (auto const & img : unusedImages) {
+            items.push_back(ConfirmItemInfo(img,
+                                            img,
+                                            img,
+                                            NULL));
 
-            QString text = tr("Following images seems not to be used in this note anymore. "
-                              "Please confirm the deletion of these images.");
-
-            QString info = tr("Deleted files could be found in the recycle "
-                              "bin of this note.<br>"
-                              "Click \"Cancel\" to leave them untouched.");
-
-            VConfirmDeletionDialog dialog(tr("Confirm Cleaning Up Unused Images"),
-                                          text,
-                                          info,
-                                          items,
-                                          true,
-                                          true,
-                                          true,
-                                          this);
-
-            unusedImages.clear();
-            if (dialog.exec()) {
-                items = dialog.getConfirmedItems();
-                g_config->setConfirmImagesCleanUp(dialog.getAskAgainEnabled());
-
-                for (auto const & item : items) {
-                    unusedImages.insert(item.m_name);
-                }
-            }
         }
 
-        for (auto const & item : unusedImages) {
-            bool ret = false;
-            if (m_file->getType() == FileType::Note) {
-                const VNoteFile *tmpFile = static_cast<const VNoteFile *>((VFile *)m_file);
-                ret = VUtils::deleteFile(tmpFile->getNotebook(), item, false);
-            } else if (m_file->getType() == FileType::Orphan) {
-                const VOrphanFile *tmpFile = static_cast<const VOrphanFile *>((VFile *)m_file);
-                ret = VUtils::deleteFile(tmpFile, item, false);
-            } else {
-                Q_ASSERT(false);
-            }
+        QString text = tr("Following images seems not to be used in this note anymore. "
+                          "Please confirm the deletion of these images.");
 
-            if (!ret) {
-                qWarning() << "fail to delete unused original image" << item;
-            } else {
-                qDebug() << "delete unused image" << item;
+        QString info = tr("Deleted files could be found in the recycle "
+                          "bin of this note.<br>"
+                          "Click \"Cancel\" to leave them untouched.");
+
+        VConfirmDeletionDialog dialog(tr("Confirm Cleaning Up Unused Images"),
+                                      text,
+                                      info,
+                                      items,
+                                      true,
+                                      true,
+                                      true,
+                                      this);
+
+        unusedImages.clear();
+        if (dialog.exec()) {
+            items = dialog.getConfirmedItems();
+            g_config->setConfirmImagesCleanUp(dialog.getAskAgainEnabled());
+
+            for (auto const & item : items) {
+                unusedImages << item.m_name;
             }
         }
+
+        if (unusedImages.isEmpty()) {
+            return;
+        }
     }
 
-    m_initImages.clear();
+    QString recycleBinFolderPath;
+    if (m_file->getType() == FileType::Note) {
+        const VNoteFile *tmpFile = static_cast<const VNoteFile *>((VFile *)m_file);
+        recycleBinFolderPath = tmpFile->getNotebook()->getRecycleBinFolderPath();
+    } else if (m_file->getType() == FileType::Orphan) {
+        const VOrphanFile *tmpFile = static_cast<const VOrphanFile *>((VFile *)m_file);
+        recycleBinFolderPath = tmpFile->fetchRecycleBinFolderPath();
+    } else {
+        Q_ASSERT(false);
+        return;
+    }
+
+    VTaskExecutor::inst()->start(new DeleteImagesTask(recycleBinFolderPath, unusedImages),
+                                 VTaskExecutor::Maintenance);
 }
 
 void VMdEditor::keyPressEvent(QKeyEvent *p_event)
@@ -893,8 +1086,12 @@ void VMdEditor::insertFromMimeData(const QMimeData *p_source)
     VTextEdit::insertFromMimeData(p_source);
 }
 
-void VMdEditor::imageInserted(const QString &p_path, const QString &p_url)
+void VMdEditor::imageInserted(const QString &p_path, const QString &p_url, int p_saveId)
 {
+    if (p_saveId != -1) {
+        m_pendingImageSaves.insert(p_saveId);
+    }
+
     ImageLink link;
     link.m_path = p_path;
     link.m_url = p_url;
@@ -907,6 +1104,22 @@ void VMdEditor::imageInserted(const QString &p_path, const QString &p_url)
     m_insertedImages.append(link);
 }
 
+void VMdEditor::handleImageSaved(int p_id, const QString &p_filePath, bool p_succeeded)
+{
+    if (!m_pendingImageSaves.remove(p_id) || p_succeeded) {
+        return;
+    }
+
+    VUtils::showMessage(QMessageBox::Warning,
+                        tr("Warning"),
+                        tr("Fail to save inserted image <span style=\"%1\">%2</span>.")
+                          .arg(g_config->c_dataTextStyle).arg(p_filePath),
+                        tr("Please insert the image again."),
+                        QMessageBox::Ok,
+                        QMessageBox::Ok,
+                        this);
+}
+
 bool VMdEditor::scrollToHeader(int p_blockNumber)
 {
     if (p_blockNumber < 0) {
@@ -1028,7 +1241,12 @@ void VMdEditor::scrollBlockInPage(int p_blockNum, int p_dest, int p_margin)
 
 void VMdEditor::updateTextEditConfig()
 {
-    setBlockImageEnabled(g_config->getEnablePreviewImages());
+    // In-place previews depend on the parse results and are dropped for a
+    // huge document.
+    bool previewEnabled = g_config->getEnablePreviewImages()
+                          && m_governor->getLevel() == VDocumentGovernor::Full;
+
+    setBlockImageEnabled(previewEnabled);
 
     setImageWidthConstrainted(g_config->getEnablePreviewImageConstraint());
 
@@ -1047,7 +1265,30 @@ void VMdEditor::updateTextEditConfig()
     setLineNumberColor(g_config->getEditorLineNumberFg(),
                        g_config->getEditorLineNumberBg());
 
-    m_previewMgr->setPreviewEnabled(g_config->getEnablePreviewImages());
+    m_previewMgr->setPreviewEnabled(previewEnabled);
+}
+
+void VMdEditor::applyFeatureLevel()
+{
+    VDocumentGovernor::Level level = m_governor->getLevel();
+    bool parseEnabled = level != VDocumentGovernor::Minimal;
+    m_pegHighlighter->setParseEnabled(parseEnabled);
+    m_cbHighlighter->setEnabled(level == VDocumentGovernor::Full);
+    setSpaceHighlightsSuppressed(level != VDocumentGovernor::Full);
+
+    updateTextEditConfig();
+
+    if (parseEnabled) {
+        m_pegHighlighter->updateHighlight();
+    }
+
+    // Large file mode has told the user already.
+    if (level != VDocumentGovernor::Full && !m_file->isLargeFile()) {
+        emit m_object->statusMessage(tr("Note is huge, switched to %1")
+                                       .arg(VDocumentGovernor::levelName(level)));
+    }
+
+    emit statusChanged();
 }
 
 void VMdEditor::updateConfig()
@@ -1096,6 +1337,11 @@ void VMdEditor::updateInitAndInsertedImages(bool p_fileChanged, UpdateAction p_a
         return;
     }
 
+    if (!m_pendingImageSaves.isEmpty()) {
+        // Inserted images may be moved below.
+        VImageEncoder::inst()->waitForDone();
+    }
+
     // Update init images.
     QVector<ImageLink> tmp = m_initImages;
     initInitImages();
@@ -1209,6 +1455,13 @@ void VMdEditor::wheelEvent(QWheelEvent *p_event)
     VTextEdit::wheelEvent(p_event);
 }
 
+void VMdEditor::focusInEvent(QFocusEvent *p_event)
+{
+    m_pegHighlighter->setFocused();
+
+    VTextEdit::focusInEvent(p_event);
+}
+
 void VMdEditor::zoomPage(bool p_zoomIn, int p_range)
 {
     if (p_range == 0) {
@@ -1225,7 +1478,12 @@ void VMdEditor::zoomPage(bool p_zoomIn, int p_range)
         ptSz = minSize;
     }
 
+    // Only estimate the blocks on the font change. Visible ones are layouted
+    // when drawn and the rest in idle time.
+    setForceEstimate(true);
     setFontPointSizeByStyleSheet(ptSz);
+    setForceEstimate(false);
+    layoutEstimatedBlocksLater();
 
     emit m_object->statusMessage(QObject::tr("Set base font point size %1").arg(ptSz));
 
@@ -1263,7 +1521,7 @@ void VMdEditor::zoomPage(bool p_zoomIn, int p_range)
         it.value().setFontPointSize(size);
     }
 
-    m_pegHighlighter->rehighlight();
+    m_pegHighlighter->restyle();
 }
 
 QAction *VMdEditor::initCopyAsMenu(QAction *p_after, QMenu *p_menu)
@@ -1357,45 +1615,7 @@ void VMdEditor::insertImageLink(const QString &p_text, const QString &p_url)
 
 VWordCountInfo VMdEditor::fetchWordCountInfo() const
 {
-    VWordCountInfo info;
-    QTextDocument *doc = document();
-
-    // Char without spaces.
-    int cns = 0;
-    int wc = 0;
-    // Remove th ending new line.
-    int cc = doc->characterCount() - 1;
-    // 0 - not in word;
-    // 1 - in English word;
-    // 2 - in non-English word;
-    int state = 0;
-
-    for (int i = 0; i < cc; ++i) {
-        QChar ch = doc->characterAt(i);
-        if (ch.isSpace()) {
-            if (state) {
-                state = 0;
-            }
-
-            continue;
-        } else if (ch.unicode() < 128) {
-            if (state != 1) {
-                state = 1;
-                ++wc;
-            }
-        } else {
-            state = 2;
-            ++wc;
-        }
-
-        ++cns;
-    }
-
-    info.m_mode = VWordCountInfo::Edit;
-    info.m_wordCount = wc;
-    info.m_charWithoutSpacesCount = cns;
-    info.m_charWithSpacesCount = cc;
-    return info;
+    return m_wordCounter->fetchWordCountInfo();
 }
 
 void VMdEditor::setEditTab(VEditTab *p_editTab)
@@ -1759,11 +1979,22 @@ void VMdEditor::exportGraphAndCopy(const QString &p_lang,
         QImage img;
         img.loadFromData(out, p_format.toLocal8Bit().data());
         if (!img.isNull()) {
+            QPointer<VEditorObject> obj(m_object);
             VClipboardUtils::setImageAndLinkToClipboard(clipboard,
                                                         img,
                                                         filePath,
-                                                        QClipboard::Clipboard);
-            emit m_object->statusMessage(tr("Graph exported and copied"));
+                                                        QClipboard::Clipboard,
+                                                        [obj](bool p_succeeded) {
+                if (!obj) {
+                    return;
+                }
+
+                if (p_succeeded) {
+                    emit obj->statusMessage(tr("Graph exported and copied"));
+                } else {
+                    emit obj->statusMessage(tr("Fail to copy exported graph to clipboard"));
+                }
+            });
         } else {
             emit m_object->statusMessage(tr("Fail to read exported image: %1").arg(filePath));
         }
@@ -1781,9 +2012,17 @@ void VMdEditor::parseAndPaste()
     QClipboard *clipboard = QApplication::clipboard();
     const QMimeData *mimeData = clipboard->mimeData();
     QString html(mimeData->html());
-    if (!html.isEmpty()) {
-        ++m_copyTimeStamp;
+    if (html.isEmpty()) {
+        return;
+    }
+
+    ++m_copyTimeStamp;
+    if (g_config->getParsePasteInWebView()) {
+        m_htmlToTextId = -1;
         emit requestHtmlToText(html, 0, m_copyTimeStamp);
+    } else {
+        emit m_object->statusMessage(tr("Parsing HTML text"));
+        m_htmlToTextId = VHtmlToMarkdownService::inst()->convert(html);
     }
 }
 
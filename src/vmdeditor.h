@@ -8,6 +8,7 @@
 #include <QUrl>
 #include <QTemporaryFile>
 #include <QSharedPointer>
+#include <QSet>
 
 #include "vtextedit.h"
 #include "veditor.h"
@@ -15,6 +16,7 @@
 #include "vtableofcontent.h"
 #include "vconfigmanager.h"
 #include "utils/vutils.h"
+#include "vdocumentstructure.h"
 
 class PegMarkdownHighlighter;
 class VCodeBlockHighlightHelper;
@@ -23,6 +25,9 @@ class VPreviewManager;
 class VCopyTextAsHtmlDialog;
 class VEditTab;
 class VTableHelper;
+class VLatencyStats;
+class VWordCounter;
+class VDocumentGovernor;
 
 class VMdEditor : public VTextEdit, public VEditor
 {
@@ -53,7 +58,8 @@ public:
     // An image has been inserted. The image is relative.
     // @p_path is the absolute path of the inserted image.
     // @p_url is the URL text within ().
-    void imageInserted(const QString &p_path, const QString &p_url);
+    // @p_saveId: ID of the request of VImageEncoder writing the image, or -1.
+    void imageInserted(const QString &p_path, const QString &p_url, int p_saveId = -1);
 
     // Scroll to header @p_blockNumber.
     // Return true if @p_blockNumber is valid to scroll to.
@@ -78,8 +84,16 @@ public:
 
     PegMarkdownHighlighter *getMarkdownHighlighter() const;
 
+    VLatencyStats *getLatencyStats() const;
+
     VPreviewManager *getPreviewManager() const;
 
+    // Whether a large file is still being loaded chunk by chunk, during which
+    // the partial content should not be saved or checked for unused images.
+    bool isLoadingContent() const;
+
+    VDocumentGovernor *getDocumentGovernor() const;
+
     void updateHeaderSequenceByConfigChange();
 
     void updateFontAndPalette() Q_DECL_OVERRIDE;
@@ -216,6 +230,11 @@ public:
         return cursorRect(p_cursor);
     }
 
+    void visibleBlockRangeW(int &p_first, int &p_last) const Q_DECL_OVERRIDE
+    {
+        visibleBlockRange(p_first, p_last);
+    }
+
 signals:
     // Signal when headers change.
     void headersChanged(const QVector<VTableOfContentItem> &p_headers);
@@ -253,11 +272,17 @@ protected:
 
     void wheelEvent(QWheelEvent *p_event) Q_DECL_OVERRIDE;
 
+    // Give the parses of this editor priority.
+    void focusInEvent(QFocusEvent *p_event) Q_DECL_OVERRIDE;
+
     int lineNumberAreaWidth() const Q_DECL_OVERRIDE;
 
 private slots:
-    // Update m_headers according to elements.
-    void updateHeaders(const QVector<VElementRegion> &p_headerRegions);
+    // Update m_headers according to the headers of @p_structure.
+    void updateHeaders(const QSharedPointer<const VDocumentStructure> &p_structure);
+
+    // Warn if an inserted image fails to be written.
+    void handleImageSaved(int p_id, const QString &p_filePath, bool p_succeeded);
 
     // Update current header according to cursor position.
     // When there is no header in current cursor, will signal an invalid header.
@@ -269,18 +294,31 @@ private slots:
     void handleLinkToAttachmentAction(QAction *p_act);
 
 private:
-    void updateHeadersHelper(const QVector<VElementRegion> &p_headerRegions, bool p_configChanged);
+    // @p_forceNotify: emit headersChanged() even if headers do not change.
+    void updateHeadersHelper(const QVector<VElementRegion> &p_headerRegions,
+                             bool p_configChanged,
+                             bool p_forceNotify = false);
 
     // Update the config of VTextEdit according to global configurations.
     void updateTextEditConfig();
 
+    // Load @p_content of a large file chunk by chunk, painting the loaded
+    // part in between.
+    void loadContentInChunks(const QString &p_content);
+
+    // Turn features on or off according to the level of m_governor.
+    void applyFeatureLevel();
+
     // Get the initial images from file before edit.
     void initInitImages();
 
     // Clear two kind of images according to initial images and current images:
     // 1. Newly inserted images which are deleted later;
     // 2. Initial images which are deleted;
-    void clearUnusedImages();
+    // Images are compared by the links of current content without checking
+    // the file system, and moved to the recycle bin in the background.
+    // @p_usedImages will be set to the internal images still in use.
+    void clearUnusedImages(QVector<ImageLink> *p_usedImages = NULL);
 
     // Index in m_headers of current header which contains the cursor.
     int indexOfCurrentHeader() const;
@@ -335,9 +373,20 @@ private:
 
     VTableHelper *m_tableHelper;
 
+    VLatencyStats *m_latencyStats;
+
+    // Decide the features to keep for a huge document.
+    VDocumentGovernor *m_governor;
+
+    // Per-block word counts updated on changes for the status bar.
+    QSharedPointer<VWordCounter> m_wordCounter;
+
     // Image links inserted while editing.
     QVector<ImageLink> m_insertedImages;
 
+    // IDs of the writes of VImageEncoder of the inserted images.
+    QSet<int> m_pendingImageSaves;
+
     // Image links right at the beginning of the edit.
     QVector<ImageLink> m_initImages;
 
@@ -346,6 +395,12 @@ private:
 
     bool m_freshEdit;
 
+    // Whether loadContentInChunks() is in progress.
+    bool m_loadingContent;
+
+    // Version of the document structure of m_headers.
+    quint64 m_headersVersion;
+
     VCopyTextAsHtmlDialog *m_textToHtmlDialog;
 
     int m_zoomDelta;
@@ -354,6 +409,9 @@ private:
 
     int m_copyTimeStamp;
 
+    // ID of the conversion of VHtmlToMarkdownService for parse and paste, or -1.
+    int m_htmlToTextId;
+
     // Temp file used for ExportAndCopy.
     QSharedPointer<QTemporaryFile> m_exportTempFile;
 };
@@ -363,8 +421,23 @@ inline PegMarkdownHighlighter *VMdEditor::getMarkdownHighlighter() const
     return m_pegHighlighter;
 }
 
+inline VLatencyStats *VMdEditor::getLatencyStats() const
+{
+    return m_latencyStats;
+}
+
 inline VPreviewManager *VMdEditor::getPreviewManager() const
 {
     return m_previewMgr;
 }
+
+inline bool VMdEditor::isLoadingContent() const
+{
+    return m_loadingContent;
+}
+
+inline VDocumentGovernor *VMdEditor::getDocumentGovernor() const
+{
+    return m_governor;
+}
 #endif // VMDEDITOR_H
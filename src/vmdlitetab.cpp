@@ -0,0 +1,382 @@
+#include "vmdlitetab.h"
+
+#include <QtWidgets>
+#include <QFile>
+#include <QFileInfo>
+#include <QRunnable>
+#include <QRegExp>
+
+#include "vconfigmanager.h"
+#include "vnativehtmlrenderer.h"
+#include "vfile.h"
+
+extern VConfigManager *g_config;
+
+// Size in bytes of the Markdown rendered at a time. A chunk ends at a blank
+// line outside code blocks.
+#define CHUNK_SIZE (512 * 1024)
+
+// A chunk ends at any line once it reaches this size.
+#define MAX_CHUNK_SIZE (4 * 1024 * 1024)
+
+// Whether @p_line opens or closes a fenced code block.
+static bool isFenceLine(const QByteArray &p_line)
+{
+    int i = 0;
+    while (i < p_line.size() && i < 3 && p_line[i] == ' ') {
+        ++i;
+    }
+
+    return p_line.mid(i, 3) == "```" || p_line.mid(i, 3) == "~~~";
+}
+
+class VMdLiteChunkTask : public QRunnable
+{
+public:
+    VMdLiteChunkTask(QObject *p_tab,
+                     int p_generation,
+                     const QString &p_filePath,
+                     qint64 p_offset,
+                     const QByteArray &p_fence,
+                     hoedown_extensions p_extensions)
+        : m_tab(p_tab),
+          m_generation(p_generation),
+          m_filePath(p_filePath),
+          m_offset(p_offset),
+          m_fence(p_fence),
+          m_extensions(p_extensions)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        QByteArray data;
+        bool atEnd = true;
+        QFile file(m_filePath);
+        if (file.open(QIODevice::ReadOnly) && file.seek(m_offset)) {
+            // Reopen the code block left open by the previous chunk.
+            QByteArray fence = m_fence;
+            if (!fence.isEmpty()) {
+                data = fence;
+            }
+
+            qint64 bytes = 0;
+            while (!file.atEnd()) {
+                QByteArray line = file.readLine();
+                bytes += line.size();
+                data += line;
+
+                if (isFenceLine(line)) {
+                    fence = fence.isEmpty() ? line : QByteArray();
+                }
+
+                if (bytes >= MAX_CHUNK_SIZE
+                    || (bytes >= CHUNK_SIZE && fence.isEmpty() && line.trimmed().isEmpty())) {
+                    break;
+                }
+            }
+
+            atEnd = file.atEnd();
+            m_offset += bytes;
+            m_fence = fence;
+        } else {
+            qWarning() << "fail to read file" << m_filePath << "at" << m_offset;
+        }
+
+        QString html = VNativeHtmlRenderer::render(QString::fromUtf8(data), m_extensions, false);
+        QMetaObject::invokeMethod(m_tab,
+                                  "handleChunkRendered",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, m_generation),
+                                  Q_ARG(QString, html),
+                                  Q_ARG(qint64, m_offset),
+                                  Q_ARG(QByteArray, m_fence),
+                                  Q_ARG(bool, atEnd));
+    }
+
+private:
+    QObject *m_tab;
+
+    int m_generation;
+
+    QString m_filePath;
+
+    qint64 m_offset;
+
+    QByteArray m_fence;
+
+    hoedown_extensions m_extensions;
+};
+
+
+VMdLiteTab::VMdLiteTab(VFile *p_file, VEditArea *p_editArea, QWidget *p_parent)
+    : VEditTab(p_file, p_editArea, p_parent),
+      m_filePath(p_file->fetchPath()),
+      m_generation(0),
+      m_nextOffset(0),
+      m_rendering(false),
+      m_atEnd(false)
+{
+    V_ASSERT(m_file->getDocType() == DocType::Markdown);
+
+    m_pool.setMaxThreadCount(1);
+
+    // The file is never opened here, so there is nothing to compare with.
+    m_checkFileChange = false;
+    m_enableBackupFile = false;
+
+    setupUI();
+
+    requestNextChunk();
+}
+
+VMdLiteTab::~VMdLiteTab()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+bool VMdLiteTab::isSuitable(const VFile *p_file, OpenFileMode p_mode)
+{
+    qint64 size = g_config->getLiteViewFileSize();
+    if (size <= 0
+        || p_mode != OpenFileMode::Read
+        || p_file->getType() != FileType::Orphan
+        || p_file->getDocType() != DocType::Markdown
+        || p_file->isOpened()) {
+        return false;
+    }
+
+    return QFileInfo(p_file->fetchPath()).size() >= size;
+}
+
+void VMdLiteTab::setupUI()
+{
+    m_browser = new QTextBrowser(this);
+    m_browser->setOpenExternalLinks(true);
+
+    QString basePath = m_file->fetchBasePath();
+    m_browser->setSearchPaths(QStringList() << basePath);
+    m_browser->document()->setBaseUrl(QUrl::fromLocalFile(basePath + "/"));
+
+    connect(m_browser->verticalScrollBar(), &QScrollBar::valueChanged,
+            this, &VMdLiteTab::checkLoadMore);
+    connect(m_browser->verticalScrollBar(), &QScrollBar::rangeChanged,
+            this, &VMdLiteTab::checkLoadMore);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout();
+    mainLayout->addWidget(m_browser);
+    mainLayout->setContentsMargins(0, 0, 0, 0);
+    setLayout(mainLayout);
+}
+
+void VMdLiteTab::requestNextChunk()
+{
+    if (m_rendering || m_atEnd) {
+        return;
+    }
+
+    m_rendering = true;
+    m_pool.start(new VMdLiteChunkTask(this,
+                                      m_generation,
+                                      m_filePath,
+                                      m_nextOffset,
+                                      m_fence,
+                                      g_config->getMarkdownExtensions()));
+}
+
+void VMdLiteTab::handleChunkRendered(int p_generation,
+                                     const QString &p_html,
+                                     qint64 p_nextOffset,
+                                     const QByteArray &p_fence,
+                                     bool p_atEnd)
+{
+    if (p_generation != m_generation) {
+        return;
+    }
+
+    m_rendering = false;
+    m_nextOffset = p_nextOffset;
+    m_fence = p_fence;
+    m_atEnd = p_atEnd;
+
+    QTextCursor cursor(m_browser->document());
+    cursor.movePosition(QTextCursor::End);
+    cursor.insertHtml(p_html);
+
+    if (!m_atEnd) {
+        qint64 size = qMax(QFileInfo(m_filePath).size(), (qint64)1);
+        emit statusMessage(tr("%1% of %2 rendered, scroll down to render more")
+                             .arg(qMin(m_nextOffset * 100 / size, (qint64)100))
+                             .arg(m_filePath));
+    }
+
+    checkLoadMore();
+}
+
+void VMdLiteTab::checkLoadMore()
+{
+    QScrollBar *bar = m_browser->verticalScrollBar();
+    if (bar->value() >= bar->maximum() - bar->pageStep()) {
+        requestNextChunk();
+    }
+}
+
+bool VMdLiteTab::closeFile(bool p_forced)
+{
+    Q_UNUSED(p_forced);
+    return true;
+}
+
+void VMdLiteTab::editFile()
+{
+    if (!m_file) {
+        return;
+    }
+
+    // The full tab will open the file, which should not be closed by us.
+    VFile *file = m_file;
+    m_file.clear();
+    emit fullTabRequested(file, OpenFileMode::Edit);
+}
+
+void VMdLiteTab::readFile(bool p_discard)
+{
+    Q_UNUSED(p_discard);
+}
+
+bool VMdLiteTab::saveFile()
+{
+    return true;
+}
+
+void VMdLiteTab::insertImage()
+{
+}
+
+void VMdLiteTab::findText(const QString &p_text, uint p_options, bool p_peek,
+                          bool p_forward)
+{
+    Q_UNUSED(p_peek);
+    if (p_text.isEmpty()) {
+        return;
+    }
+
+    QTextDocument::FindFlags flags;
+    if (p_options & FindOption::CaseSensitive) {
+        flags |= QTextDocument::FindCaseSensitively;
+    }
+
+    if (p_options & FindOption::WholeWordOnly) {
+        flags |= QTextDocument::FindWholeWords;
+    }
+
+    if (!p_forward) {
+        flags |= QTextDocument::FindBackward;
+    }
+
+    auto find = [this, &p_text, p_options, flags]() {
+        if (p_options & FindOption::RegularExpression) {
+            Qt::CaseSensitivity cs = (p_options & FindOption::CaseSensitive) ? Qt::CaseSensitive
+                                                                             : Qt::CaseInsensitive;
+            return m_browser->find(QRegExp(p_text, cs), flags);
+        }
+
+        return m_browser->find(p_text, flags);
+    };
+
+    if (!find()) {
+        // Wrap around the rendered content.
+        m_browser->moveCursor(p_forward ? QTextCursor::Start : QTextCursor::End);
+        if (!find()) {
+            emit statusMessage(tr("No match found in the rendered content"));
+        }
+    }
+}
+
+void VMdLiteTab::findText(const VSearchToken &p_token,
+                          bool p_forward,
+                          bool p_fromStart)
+{
+    Q_UNUSED(p_token);
+    Q_UNUSED(p_forward);
+    Q_UNUSED(p_fromStart);
+}
+
+void VMdLiteTab::replaceText(const QString &p_text, uint p_options,
+                             const QString &p_replaceText, bool p_findNext)
+{
+    Q_UNUSED(p_text);
+    Q_UNUSED(p_options);
+    Q_UNUSED(p_replaceText);
+    Q_UNUSED(p_findNext);
+}
+
+void VMdLiteTab::replaceTextAll(const QString &p_text, uint p_options,
+                                const QString &p_replaceText)
+{
+    Q_UNUSED(p_text);
+    Q_UNUSED(p_options);
+    Q_UNUSED(p_replaceText);
+}
+
+void VMdLiteTab::nextMatch(const QString &p_text, uint p_options, bool p_forward)
+{
+    findText(p_text, p_options, false, p_forward);
+}
+
+QString VMdLiteTab::getSelectedText() const
+{
+    return m_browser->textCursor().selectedText();
+}
+
+void VMdLiteTab::clearSearchedWordHighlight()
+{
+    QTextCursor cursor = m_browser->textCursor();
+    cursor.clearSelection();
+    m_browser->setTextCursor(cursor);
+}
+
+void VMdLiteTab::requestUpdateVimStatus()
+{
+    emit vimStatusUpdated(NULL);
+}
+
+void VMdLiteTab::reload()
+{
+    ++m_generation;
+    m_pool.clear();
+
+    m_browser->clear();
+    m_nextOffset = 0;
+    m_fence.clear();
+    m_rendering = false;
+    m_atEnd = false;
+
+    requestNextChunk();
+}
+
+void VMdLiteTab::zoom(bool p_zoomIn, qreal p_step)
+{
+    Q_UNUSED(p_step);
+    if (p_zoomIn) {
+        m_browser->zoomIn();
+    } else {
+        m_browser->zoomOut();
+    }
+}
+
+void VMdLiteTab::focusChild()
+{
+    m_browser->setFocus();
+}
+
+bool VMdLiteTab::restoreFromTabInfo(const VEditTabInfo &p_info)
+{
+    return p_info.m_editTab == this;
+}
+
+void VMdLiteTab::collectMemoryStats(VMemoryStats::Group &p_group) const
+{
+    p_group.add("Text document", VMemoryStats::textDocumentBytes(m_browser->document()));
+}
@@ -0,0 +1,109 @@
+#ifndef VMDLITETAB_H
+#define VMDLITETAB_H
+
+#include <QString>
+#include <QByteArray>
+#include <QThreadPool>
+#include "vedittab.h"
+#include "vconstants.h"
+
+class QTextBrowser;
+
+// Lightweight read-only tab of a large external Markdown file.
+// The file is read and rendered natively via hoedown on a worker chunk by
+// chunk, and the next chunk is rendered only when scrolled to the end.
+// The file is not opened as a whole and there is no editor, web view or
+// backup file. Editing it requests a full VMdTab to replace this tab.
+class VMdLiteTab : public VEditTab
+{
+    Q_OBJECT
+
+public:
+    VMdLiteTab(VFile *p_file, VEditArea *p_editArea, QWidget *p_parent = 0);
+
+    ~VMdLiteTab();
+
+    // Whether @p_file opened in @p_mode should use a lite tab.
+    static bool isSuitable(const VFile *p_file, OpenFileMode p_mode);
+
+    bool closeFile(bool p_forced) Q_DECL_OVERRIDE;
+
+    void readFile(bool p_discard = false) Q_DECL_OVERRIDE;
+
+    bool saveFile() Q_DECL_OVERRIDE;
+
+    void insertImage() Q_DECL_OVERRIDE;
+
+    void findText(const QString &p_text, uint p_options, bool p_peek,
+                  bool p_forward = true) Q_DECL_OVERRIDE;
+
+    void findText(const VSearchToken &p_token,
+                  bool p_forward = true,
+                  bool p_fromStart = false) Q_DECL_OVERRIDE;
+
+    void replaceText(const QString &p_text, uint p_options,
+                     const QString &p_replaceText, bool p_findNext) Q_DECL_OVERRIDE;
+
+    void replaceTextAll(const QString &p_text, uint p_options,
+                        const QString &p_replaceText) Q_DECL_OVERRIDE;
+
+    void nextMatch(const QString &p_text, uint p_options, bool p_forward) Q_DECL_OVERRIDE;
+
+    QString getSelectedText() const Q_DECL_OVERRIDE;
+
+    void clearSearchedWordHighlight() Q_DECL_OVERRIDE;
+
+    void requestUpdateVimStatus() Q_DECL_OVERRIDE;
+
+    void reload() Q_DECL_OVERRIDE;
+
+    void collectMemoryStats(VMemoryStats::Group &p_group) const Q_DECL_OVERRIDE;
+
+public slots:
+    // Request a full tab to edit the file.
+    void editFile() Q_DECL_OVERRIDE;
+
+private slots:
+    // Called by the worker.
+    // @p_fence: the opening line of the code block unclosed at @p_nextOffset.
+    void handleChunkRendered(int p_generation,
+                             const QString &p_html,
+                             qint64 p_nextOffset,
+                             const QByteArray &p_fence,
+                             bool p_atEnd);
+
+    // Render the next chunk if scrolled near the end.
+    void checkLoadMore();
+
+private:
+    void setupUI();
+
+    void requestNextChunk();
+
+    void zoom(bool p_zoomIn, qreal p_step = 0.25) Q_DECL_OVERRIDE;
+
+    void focusChild() Q_DECL_OVERRIDE;
+
+    bool restoreFromTabInfo(const VEditTabInfo &p_info) Q_DECL_OVERRIDE;
+
+    QTextBrowser *m_browser;
+
+    // Path of the file, which is kept once m_file is handed over.
+    QString m_filePath;
+
+    QThreadPool m_pool;
+
+    // Bumped on reload to drop the chunks of the previous rendering.
+    int m_generation;
+
+    // Offset in bytes of the next chunk to render.
+    qint64 m_nextOffset;
+
+    QByteArray m_fence;
+
+    bool m_rendering;
+
+    bool m_atEnd;
+};
+
+#endif // VMDLITETAB_H
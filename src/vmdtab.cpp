@@ -1,5 +1,4 @@
 #include <QtWidgets>
-#include <QWebChannel>
 #include <QFileInfo>
 #include <QCoreApplication>
 #include <QWebEngineProfile>
@@ -7,16 +6,17 @@
 #include "vdocument.h"
 #include "vnote.h"
 #include "utils/vutils.h"
-#include "vpreviewpage.h"
 #include "pegmarkdownhighlighter.h"
 #include "vconfigmanager.h"
-#include "vmarkdownconverter.h"
+#include "vmarkdownconvertservice.h"
+#include "vreadmodecache.h"
 #include "vnotebook.h"
 #include "vtableofcontent.h"
 #include "dialog/vfindreplacedialog.h"
 #include "veditarea.h"
 #include "vconstants.h"
 #include "vwebview.h"
+#include "vwebviewpool.h"
 #include "vmdeditor.h"
 #include "vmainwindow.h"
 #include "vsnippet.h"
@@ -24,14 +24,22 @@
 #include "vsnippetlist.h"
 #include "vlivepreviewhelper.h"
 #include "vmathjaxinplacepreviewhelper.h"
+#include "vbackupjournal.h"
+#include "vdocumentgovernor.h"
 
 extern VMainWindow *g_mainWin;
 
 extern VConfigManager *g_config;
 
+// Bias in pixels to take a header near the top as the current one, the same
+// as the web side.
+#define WEB_HEADER_BIAS 50
 
-VMdTab::VMdTab(VFile *p_file, VEditArea *p_editArea,
-               OpenFileMode p_mode, QWidget *p_parent)
+VMdTab::VMdTab(VFile *p_file,
+               VEditArea *p_editArea,
+               OpenFileMode p_mode,
+               QWidget *p_parent,
+               bool p_deferred)
     : VEditTab(p_file, p_editArea, p_parent),
       m_editor(NULL),
       m_webViewer(NULL),
@@ -39,23 +47,18 @@ VMdTab::VMdTab(VFile *p_file, VEditArea *p_editArea,
       m_mdConType(g_config->getMdConverterType()),
       m_enableHeadingSequence(false),
       m_backupFileChecked(false),
+      m_backupJournal(NULL),
+      m_lineFromEditMode(-1),
       m_mode(Mode::InvalidMode),
       m_livePreviewHelper(NULL),
-      m_mathjaxPreviewHelper(NULL)
+      m_mathjaxPreviewHelper(NULL),
+      m_convertID(-1),
+      m_loaded(false),
+      m_modeToLoad(p_mode),
+      m_webHeapBytes(-1)
 {
     V_ASSERT(m_file->getDocType() == DocType::Markdown);
 
-    if (!m_file->open()) {
-        VUtils::showMessage(QMessageBox::Warning,
-                            tr("Warning"),
-                            tr("Fail to open note <span style=\"%1\">%2</span>.")
-                              .arg(g_config->c_dataTextStyle).arg(m_file->getName()),
-                            tr("Please check if file %1 exists.").arg(m_file->fetchPath()),
-                            QMessageBox::Ok,
-                            QMessageBox::Ok,
-                            this);
-    }
-
     HeadingSequenceType headingSequenceType = g_config->getHeadingSequenceType();
     if (headingSequenceType == HeadingSequenceType::Enabled) {
         m_enableHeadingSequence = true;
@@ -64,8 +67,6 @@ VMdTab::VMdTab(VFile *p_file, VEditArea *p_editArea,
         m_enableHeadingSequence = true;
     }
 
-    setupUI();
-
     m_backupTimer = new QTimer(this);
     m_backupTimer->setSingleShot(true);
     m_backupTimer->setInterval(g_config->getFileTimerInterval());
@@ -94,13 +95,103 @@ VMdTab::VMdTab(VFile *p_file, VEditArea *p_editArea,
                 }
             });
 
-    if (p_mode == OpenFileMode::Edit) {
+    if (!p_deferred) {
+        load();
+    }
+}
+
+void VMdTab::load()
+{
+    if (m_loaded) {
+        return;
+    }
+
+    m_loaded = true;
+
+    if (!m_file->open()) {
+        VUtils::showMessage(QMessageBox::Warning,
+                            tr("Warning"),
+                            tr("Fail to open note <span style=\"%1\">%2</span>.")
+                              .arg(g_config->c_dataTextStyle).arg(m_file->getName()),
+                            tr("Please check if file %1 exists.").arg(m_file->fetchPath()),
+                            QMessageBox::Ok,
+                            QMessageBox::Ok,
+                            this);
+    }
+
+    setupUI();
+
+    if (m_modeToLoad == OpenFileMode::Edit) {
         showFileEditMode();
     } else {
         showFileReadMode();
     }
 }
 
+bool VMdTab::hibernate()
+{
+    if (!m_loaded || isModified()) {
+        return false;
+    }
+
+    if (m_editor && m_editor->document()->isUndoAvailable()) {
+        // Keep the undo history.
+        return false;
+    }
+
+    // Restore the mode and position once loaded again.
+    m_modeToLoad = getOpenMode();
+    m_infoToRestore = fetchTabInfo(VEditTabInfo::InfoType::All);
+
+    m_backupTimer->stop();
+    m_livePreviewTimer->stop();
+
+    if (m_convertID != -1) {
+        disconnect(VMarkdownConvertService::inst(), &VMarkdownConvertService::htmlConverted,
+                   this, &VMdTab::handleHtmlConverted);
+        m_convertID = -1;
+    }
+
+    delete m_livePreviewHelper;
+    m_livePreviewHelper = NULL;
+
+    delete m_mathjaxPreviewHelper;
+    m_mathjaxPreviewHelper = NULL;
+
+    delete m_backupJournal;
+    m_backupJournal = NULL;
+
+    // The web view with the document and the editor with its highlighter are
+    // children of the splitter.
+    delete layout();
+    delete m_splitter;
+    m_splitter = NULL;
+    m_webViewer = NULL;
+    m_document = NULL;
+    m_editor = NULL;
+
+    m_readWebViewState.clear();
+    m_previewWebViewState.clear();
+    m_headerFromEditMode.clear();
+    m_lineFromEditMode = -1;
+
+    m_mode = Mode::InvalidMode;
+    m_isEditMode = false;
+    m_ready = 0;
+    m_loaded = false;
+    m_webHeapBytes = -1;
+    return true;
+}
+
+OpenFileMode VMdTab::getOpenMode() const
+{
+    if (!m_loaded) {
+        return m_modeToLoad;
+    }
+
+    return VEditTab::getOpenMode();
+}
+
 void VMdTab::setupUI()
 {
     m_splitter = new QSplitter(this);
@@ -121,8 +212,9 @@ void VMdTab::showFileReadMode()
 {
     m_isEditMode = false;
 
-    // Will recover the header when web side is ready.
+    // Will recover the position when web side is ready.
     m_headerFromEditMode = m_currentHeader;
+    m_lineFromEditMode = m_editor ? m_editor->firstVisibleBlockNumber() : -1;
 
     updateWebView();
 
@@ -138,8 +230,8 @@ void VMdTab::updateWebView()
     if (m_mdConType == MarkdownConverterType::Hoedown) {
         viewWebByConverter();
     } else {
-        m_document->updateText();
-        updateOutlineFromHtml(m_document->getToc());
+        m_document->renderText();
+        updateOutlineFromTocItems(m_document->getTocItems());
     }
 }
 
@@ -177,6 +269,19 @@ bool VMdTab::scrollWebViewToHeader(const VHeaderPointer &p_header)
     return true;
 }
 
+bool VMdTab::scrollWebViewToLine(int p_line)
+{
+    const VSourceLineMap &lineMap = m_document->getSourceLineMap();
+    if (p_line < 0 || !lineMap.hasLines()) {
+        return false;
+    }
+
+    int offset = lineMap.offsetOfLine(p_line);
+    m_document->scrollToOffset(offset);
+    m_document->setHeader(lineMap.headerAtOffset(offset + WEB_HEADER_BIAS));
+    return true;
+}
+
 bool VMdTab::scrollEditorToHeader(const VHeaderPointer &p_header, bool p_force)
 {
     if (!m_outline.isMatched(p_header)
@@ -241,13 +346,41 @@ bool VMdTab::scrollToHeaderInternal(const VHeaderPointer &p_header)
 
 void VMdTab::viewWebByConverter()
 {
-    VMarkdownConverter mdConverter;
-    QString toc;
-    QString html = mdConverter.generateHtml(m_file->getContent(),
-                                            g_config->getMarkdownExtensions(),
-                                            toc);
-    m_document->setHtml(html);
-    updateOutlineFromHtml(toc);
+    hoedown_extensions options = g_config->getMarkdownExtensions();
+    const QString &text = m_file->getContent();
+    m_readModeCacheKey = VReadModeCache::key(QString("hoedown %1").arg((int)options), text);
+
+    QString html, toc;
+    if (VReadModeCache::lookup(m_readModeCacheKey, html, toc)) {
+        // Drop the result of the pending request.
+        if (m_convertID != -1) {
+            m_convertID = 0;
+        }
+
+        m_document->setHtml(html);
+        updateOutlineFromHtml(toc);
+        return;
+    }
+
+    VMarkdownConvertService *service = VMarkdownConvertService::inst();
+    if (m_convertID == -1) {
+        connect(service, &VMarkdownConvertService::htmlConverted,
+                this, &VMdTab::handleHtmlConverted);
+    }
+
+    m_convertID = service->convert(this, text, options);
+}
+
+void VMdTab::handleHtmlConverted(int p_id, const QString &p_html, const QString &p_toc)
+{
+    if (p_id != m_convertID) {
+        return;
+    }
+
+    VReadModeCache::insert(m_readModeCacheKey, p_html, p_toc);
+
+    m_document->setHtml(p_html);
+    updateOutlineFromHtml(p_toc);
 }
 
 void VMdTab::showFileEditMode()
@@ -274,7 +407,13 @@ void VMdTab::showFileEditMode()
              && nrRetry-- >= 0
              && (m_outline.isEmpty() || m_outline.getType() != VTableOfContentType::BlockNumber));
 
-    scrollEditorToHeader(header, false);
+    // Keep the first visible line of read mode.
+    int line = m_document->getSourceLineMap().lineOfOffset(m_webViewer->page()->scrollPosition().y());
+    if (line >= 0 && line < mdEdit->document()->blockCount()) {
+        mdEdit->scrollBlockInPage(line, 0);
+    } else {
+        scrollEditorToHeader(header, false);
+    }
 
     mdEdit->setFocus();
 }
@@ -297,6 +436,12 @@ bool VMdTab::closeFile(bool p_forced)
 
 void VMdTab::editFile()
 {
+    if (!m_loaded) {
+        m_modeToLoad = OpenFileMode::Edit;
+        load();
+        return;
+    }
+
     if (m_isEditMode) {
         return;
     }
@@ -356,7 +501,7 @@ void VMdTab::readFile(bool p_discard)
 
 bool VMdTab::saveFile()
 {
-    if (!m_isEditMode) {
+    if (!m_isEditMode || isLoadingContent()) {
         return true;
     }
 
@@ -406,6 +551,7 @@ bool VMdTab::saveFile()
         } else {
             m_fileDiverged = false;
             m_checkFileChange = true;
+            m_file->releaseContent();
         }
     }
 
@@ -414,11 +560,60 @@ bool VMdTab::saveFile()
     return ret;
 }
 
+void VMdTab::saveFileAsync()
+{
+    if (isLoadingContent()) {
+        return;
+    }
+
+    if (!m_isEditMode
+        || !isModified()
+        || !m_file->isModifiable()
+        || !QFileInfo::exists(m_file->fetchPath())) {
+        // Let saveFile() handle the trivial and failing cases.
+        saveFile();
+        return;
+    }
+
+    m_checkFileChange = false;
+    m_editor->saveFile();
+    m_file->saveAsync();
+
+    updateStatus();
+}
+
+void VMdTab::handleFileSaveCompleted(bool p_succeeded)
+{
+    m_checkFileChange = true;
+    if (!p_succeeded) {
+        VUtils::showMessage(QMessageBox::Warning,
+                            tr("Warning"),
+                            tr("Fail to save note."),
+                            tr("Fail to write to disk when saving a note. Please try it again."),
+                            QMessageBox::Ok,
+                            QMessageBox::Ok,
+                            this);
+        if (m_editor) {
+            m_editor->setModified(true);
+        }
+    } else {
+        m_fileDiverged = false;
+        m_file->releaseContent();
+    }
+
+    updateStatus();
+}
+
 bool VMdTab::isModified() const
 {
     return (m_editor ? m_editor->isModified() : false) || m_fileDiverged;
 }
 
+bool VMdTab::isLoadingContent() const
+{
+    return m_editor && m_editor->isLoadingContent();
+}
+
 void VMdTab::saveAndRead()
 {
     saveFile();
@@ -432,7 +627,10 @@ void VMdTab::discardAndRead()
 
 void VMdTab::setupMarkdownViewer()
 {
-    m_webViewer = new VWebView(m_file, this);
+    VMarkdownWebView view = VWebViewPool::inst()->take(m_mdConType, m_file, this);
+    m_webViewer = view.m_view;
+    m_document = view.m_document;
+
     connect(m_webViewer, &VWebView::editNote,
             this, &VMdTab::editFile);
     connect(m_webViewer, &VWebView::requestSavePage,
@@ -442,25 +640,19 @@ void VMdTab::setupMarkdownViewer()
     connect(m_webViewer, &VWebView::requestExpandRestorePreviewArea,
             this, &VMdTab::expandRestorePreviewArea);
 
-    VPreviewPage *page = new VPreviewPage(m_webViewer);
-    m_webViewer->setPage(page);
+    QWebEnginePage *page = m_webViewer->page();
     m_webViewer->setZoomFactor(g_config->getWebZoomFactor());
     connect(page->profile(), &QWebEngineProfile::downloadRequested,
             this, &VMdTab::handleDownloadRequested);
     connect(page, &QWebEnginePage::linkHovered,
             this, &VMdTab::statusMessage);
+    connect(page, &QWebEnginePage::scrollPositionChanged,
+            this, &VMdTab::handleWebScrollPositionChanged);
 
-    // Avoid white flash before loading content.
-    // Setting Qt::transparent will force GrayScale antialias rendering.
-    page->setBackgroundColor(g_config->getBaseBackground());
-
-    m_document = new VDocument(m_file, m_webViewer);
     m_documentID = m_document->registerIdentifier();
 
-    QWebChannel *channel = new QWebChannel(m_webViewer);
-    channel->registerObject(QStringLiteral("content"), m_document);
-    connect(m_document, &VDocument::tocChanged,
-            this, &VMdTab::updateOutlineFromHtml);
+    connect(m_document, &VDocument::tocItemsChanged,
+            this, &VMdTab::updateOutlineFromTocItems);
     connect(m_document, SIGNAL(headerChanged(const QString &)),
             this, SLOT(updateCurrentHeader(const QString &)));
     connect(m_document, &VDocument::keyPressed,
@@ -468,10 +660,15 @@ void VMdTab::setupMarkdownViewer()
     connect(m_document, &VDocument::logicsFinished,
             this, [this]() {
                 if (m_ready & TabReady::ReadMode) {
-                    // Recover header from edit mode.
-                    scrollWebViewToHeader(m_headerFromEditMode);
-                    m_headerFromEditMode.clear();
                     m_document->muteWebView(false);
+
+                    // Recover position from edit mode.
+                    if (!scrollWebViewToLine(m_lineFromEditMode)) {
+                        scrollWebViewToHeader(m_headerFromEditMode);
+                    }
+
+                    m_headerFromEditMode.clear();
+                    m_lineFromEditMode = -1;
                     return;
                 }
 
@@ -507,11 +704,6 @@ void VMdTab::setupMarkdownViewer()
                 emit statusUpdated(info);
             });
 
-    page->setWebChannel(channel);
-
-    m_webViewer->setHtml(VUtils::generateHtmlTemplate(m_mdConType),
-                         m_file->getBaseUrl());
-
     m_splitter->addWidget(m_webViewer);
 }
 
@@ -588,7 +780,7 @@ void VMdTab::setupMarkdownEditor()
     m_splitter->insertWidget(0, m_editor);
 
     m_livePreviewHelper = new VLivePreviewHelper(m_editor, m_document, this);
-    connect(m_editor->getMarkdownHighlighter(), &PegMarkdownHighlighter::codeBlocksUpdated,
+    connect(m_editor->getMarkdownHighlighter(), &PegMarkdownHighlighter::structureUpdated,
             m_livePreviewHelper, &VLivePreviewHelper::updateCodeBlocks);
     connect(m_editor->getPreviewManager(), &VPreviewManager::previewEnabledChanged,
             m_livePreviewHelper, &VLivePreviewHelper::setInplacePreviewEnabled);
@@ -599,7 +791,7 @@ void VMdTab::setupMarkdownEditor()
     m_livePreviewHelper->setInplacePreviewEnabled(m_editor->getPreviewManager()->isPreviewEnabled());
 
     m_mathjaxPreviewHelper = new VMathJaxInplacePreviewHelper(m_editor, m_document, this);
-    connect(m_editor->getMarkdownHighlighter(), &PegMarkdownHighlighter::mathjaxBlocksUpdated,
+    connect(m_editor->getMarkdownHighlighter(), &PegMarkdownHighlighter::structureUpdated,
             m_mathjaxPreviewHelper, &VMathJaxInplacePreviewHelper::updateMathjaxBlocks);
     connect(m_editor->getPreviewManager(), &VPreviewManager::previewEnabledChanged,
             m_mathjaxPreviewHelper, &VMathJaxInplacePreviewHelper::setEnabled);
@@ -628,6 +820,26 @@ void VMdTab::updateOutlineFromHtml(const QString &p_tocHtml)
     emit outlineChanged(m_outline);
 }
 
+void VMdTab::updateOutlineFromTocItems(const QVector<VTableOfContentItem> &p_items)
+{
+    if (m_isEditMode) {
+        return;
+    }
+
+    // Keep current header if the outline does not change.
+    if (m_outline.getFile() == m_file
+        && m_outline.getType() == VTableOfContentType::Anchor
+        && m_outline.getTable() == p_items) {
+        return;
+    }
+
+    m_outline.update(m_file, p_items, VTableOfContentType::Anchor);
+
+    m_currentHeader.reset();
+
+    emit outlineChanged(m_outline);
+}
+
 void VMdTab::updateOutlineFromHeaders(const QVector<VTableOfContentItem> &p_headers)
 {
     if (!m_isEditMode) {
@@ -664,6 +876,17 @@ void VMdTab::updateCurrentHeader(const QString &p_anchor)
     emit currentHeaderChanged(m_currentHeader);
 }
 
+void VMdTab::handleWebScrollPositionChanged(const QPointF &p_pos)
+{
+    if (m_mode != Mode::Read) {
+        return;
+    }
+
+    // Muted and duplicate headers are skipped by VDocument.
+    int offset = (int)p_pos.y() + WEB_HEADER_BIAS;
+    m_document->setHeader(m_document->getSourceLineMap().headerAtOffset(offset));
+}
+
 void VMdTab::updateCurrentHeader(int p_blockNumber)
 {
     if (!m_isEditMode) {
@@ -963,6 +1186,10 @@ VEditTabInfo VMdTab::fetchTabInfo(VEditTabInfo::InfoType p_type) const
         info.m_cursorBlockNumber = cursor.block().blockNumber();
         info.m_cursorPositionInBlock = cursor.positionInBlock();
         info.m_blockCount = m_editor->document()->blockCount();
+
+        const VDocumentGovernor *governor = m_editor->getDocumentGovernor();
+        info.m_featureLevel = governor->getMeasuredLevel();
+        info.m_fullFeaturesForced = governor->isFullFeaturesForced();
     }
 
     if (m_isEditMode) {
@@ -971,12 +1198,19 @@ VEditTabInfo VMdTab::fetchTabInfo(VEditTabInfo::InfoType p_type) const
             info.m_wordCountInfo.m_mode = VWordCountInfo::Edit;
             info.m_wordCountInfo.m_charWithSpacesCount = m_editor->document()->characterCount() - 1;
         }
-    } else {
+    } else if (m_document) {
         info.m_wordCountInfo = m_document->getWordCountInfo();
     }
 
     info.m_headerIndex = m_currentHeader.m_index;
 
+    if (!m_loaded && m_infoToRestore.m_editTab == this) {
+        // Keep the position to restore in the session.
+        info.m_headerIndex = m_infoToRestore.m_headerIndex;
+        info.m_cursorBlockNumber = m_infoToRestore.m_cursorBlockNumber;
+        info.m_cursorPositionInBlock = m_infoToRestore.m_cursorPositionInBlock;
+    }
+
     return info;
 }
 
@@ -989,7 +1223,7 @@ void VMdTab::decorateText(TextDecoration p_decoration, int p_level)
 
 bool VMdTab::restoreFromTabInfo(const VEditTabInfo &p_info)
 {
-    if (p_info.m_editTab != this) {
+    if (p_info.m_editTab != this || !m_loaded) {
         return false;
     }
 
@@ -1105,40 +1339,33 @@ void VMdTab::applySnippet()
     }
 }
 
-static bool selectorItemCmp(const VInsertSelectorItem &p_a, const VInsertSelectorItem &p_b)
-{
-    if (p_a.m_shortcut < p_b.m_shortcut) {
-        return true;
-    }
-
-    return false;
-}
-
 VInsertSelector *VMdTab::prepareSnippetSelector(QWidget *p_parent)
 {
-    auto snippets = g_mainWin->getSnippetList()->getSnippets();
+    // Sorted by shortcut.
+    auto snippets = g_mainWin->getSnippetList()->getSnippetsWithShortcut();
     QVector<VInsertSelectorItem> items;
+    items.reserve(snippets.size());
     for (auto const & snip : snippets) {
-        if (!snip.getShortcut().isNull()) {
-            items.push_back(VInsertSelectorItem(snip.getName(),
-                                                snip.getName(),
-                                                snip.getShortcut()));
-        }
+        items.push_back(VInsertSelectorItem(snip->getName(),
+                                            snip->getName(),
+                                            snip->getShortcut()));
     }
 
     if (items.isEmpty()) {
         return NULL;
     }
 
-    // Sort items by shortcut.
-    std::sort(items.begin(), items.end(), selectorItemCmp);
-
     VInsertSelector *sel = new VInsertSelector(7, items, p_parent);
     return sel;
 }
 
 void VMdTab::reload()
 {
+    if (!m_loaded) {
+        // It will read the file when loaded.
+        return;
+    }
+
     // Reload editor.
     if (m_editor) {
         m_editor->reloadFile();
@@ -1150,6 +1377,12 @@ void VMdTab::reload()
         updateStatus();
     }
 
+    // The web side will render from scratch.
+    m_document->resetRender();
+    if (m_livePreviewHelper) {
+        m_livePreviewHelper->invalidateLivePreview();
+    }
+
     if (!m_isEditMode) {
         updateWebView();
     }
@@ -1188,10 +1421,14 @@ void VMdTab::tabIsReady(TabReady p_mode)
     if (m_enableBackupFile
         && m_file->isModifiable()
         && p_mode == TabReady::EditMode) {
+        if (!m_backupJournal) {
+            m_backupJournal = new VBackupJournal(m_file, m_editor->document(), this);
+        }
+
         // contentsChanged will be emitted even the content is not changed.
         connect(m_editor->document(), &QTextDocument::contentsChange,
                 this, [this]() {
-                    if (m_isEditMode) {
+                    if (m_isEditMode && !isLoadingContent()) {
                         m_backupTimer->stop();
                         m_backupTimer->start();
                     }
@@ -1209,7 +1446,11 @@ void VMdTab::tabIsReady(TabReady p_mode)
 void VMdTab::writeBackupFile()
 {
     Q_ASSERT(m_enableBackupFile && m_file->isModifiable());
-    m_file->writeBackupFile(m_editor->getContent());
+    if (m_backupJournal) {
+        m_backupJournal->write();
+    } else {
+        m_file->writeBackupFile(m_editor->getContent());
+    }
 }
 
 bool VMdTab::checkPreviousBackupFile()
@@ -1283,6 +1524,10 @@ void VMdTab::updateCursorStatus()
 
 void VMdTab::handleFileOrDirectoryChange(bool p_isFile, UpdateAction p_act)
 {
+    if (!m_loaded) {
+        return;
+    }
+
     // Reload the web view with new base URL.
     m_headerFromEditMode = m_currentHeader;
     m_webViewer->setHtml(VUtils::generateHtmlTemplate(m_mdConType),
@@ -1501,6 +1746,65 @@ void VMdTab::handleSavePageRequested()
     m_webViewer->page()->save(fileName, format);
 }
 
+void VMdTab::collectMemoryStats(VMemoryStats::Group &p_group) const
+{
+    p_group.add("Content", VMemoryStats::stringBytes(m_file->getContent()));
+
+    if (!m_loaded) {
+        p_group.m_name += " (not loaded)";
+        return;
+    }
+
+    if (m_editor) {
+        p_group.add("Text document", VMemoryStats::textDocumentBytes(m_editor->document()));
+        p_group.add("Images", m_editor->imageBytes());
+        p_group.add("Highlighter results", m_editor->getMarkdownHighlighter()->approximateBytes());
+    }
+
+    if (m_livePreviewHelper) {
+        p_group.add("Live preview cache", m_livePreviewHelper->approximateBytes());
+    }
+
+    if (m_mathjaxPreviewHelper) {
+        p_group.add("MathJax preview cache", m_mathjaxPreviewHelper->approximateBytes());
+    }
+
+    if (m_document) {
+        p_group.add("Web document", m_document->approximateBytes());
+    }
+
+    if (m_webViewer) {
+        p_group.add("Web view JavaScript heap", m_webHeapBytes);
+    }
+}
+
+void VMdTab::requestWebHeapSize()
+{
+    if (!m_webViewer) {
+        return;
+    }
+
+    // performance.memory is only available in Chromium.
+    QPointer<VMdTab> tab(this);
+    m_webViewer->page()->runJavaScript("(window.performance && performance.memory) "
+                                       "? performance.memory.usedJSHeapSize : -1",
+                                       [tab](const QVariant &p_result) {
+                                           if (tab) {
+                                               tab->m_webHeapBytes = (qint64)p_result.toDouble();
+                                           }
+                                       });
+}
+
+void VMdTab::setFullFeaturesForced(bool p_forced)
+{
+    if (!m_editor) {
+        return;
+    }
+
+    m_editor->getDocumentGovernor()->setFullFeaturesForced(p_forced);
+    updateStatus();
+}
+
 VWordCountInfo VMdTab::fetchWordCountInfo(bool p_editMode) const
 {
     if (p_editMode) {
@@ -4,6 +4,7 @@
 #include <QString>
 #include <QPointer>
 #include <QSharedPointer>
+#include <QByteArray>
 #include "vedittab.h"
 #include "vconstants.h"
 #include "vmarkdownconverter.h"
@@ -14,17 +15,30 @@ class VDocument;
 class VMdEditor;
 class VInsertSelector;
 class QTimer;
+class QPointF;
 class QWebEngineDownloadItem;
 class QSplitter;
 class VLivePreviewHelper;
 class VMathJaxInplacePreviewHelper;
+class VBackupJournal;
 
 class VMdTab : public VEditTab
 {
     Q_OBJECT
 
 public:
-    VMdTab(VFile *p_file, VEditArea *p_editArea, OpenFileMode p_mode, QWidget *p_parent = 0);
+    // @p_deferred: whether defer reading and showing the content until load().
+    VMdTab(VFile *p_file,
+           VEditArea *p_editArea,
+           OpenFileMode p_mode,
+           QWidget *p_parent = 0,
+           bool p_deferred = false);
+
+    OpenFileMode getOpenMode() const Q_DECL_OVERRIDE;
+
+    void load() Q_DECL_OVERRIDE;
+
+    bool hibernate() Q_DECL_OVERRIDE;
 
     // Close current tab.
     // @p_forced: if true, discard the changes.
@@ -37,8 +51,12 @@ public:
     // Save file.
     bool saveFile() Q_DECL_OVERRIDE;
 
+    void saveFileAsync() Q_DECL_OVERRIDE;
+
     bool isModified() const Q_DECL_OVERRIDE;
 
+    bool isLoadingContent() const Q_DECL_OVERRIDE;
+
     // Scroll to @p_header.
     void scrollToHeader(const VHeaderPointer &p_header) Q_DECL_OVERRIDE;
 
@@ -102,6 +120,12 @@ public:
     // Fetch tab stat info.
     VWordCountInfo fetchWordCountInfo(bool p_editMode) const Q_DECL_OVERRIDE;
 
+    void collectMemoryStats(VMemoryStats::Group &p_group) const Q_DECL_OVERRIDE;
+
+    void requestWebHeapSize() Q_DECL_OVERRIDE;
+
+    void setFullFeaturesForced(bool p_forced) Q_DECL_OVERRIDE;
+
     // Toggle live preview in edit mode.
     bool toggleLivePreview();
 
@@ -126,10 +150,16 @@ public slots:
 protected:
     void writeBackupFile() Q_DECL_OVERRIDE;
 
+    void handleFileSaveCompleted(bool p_succeeded) Q_DECL_OVERRIDE;
+
 private slots:
     // Update m_outline according to @p_tocHtml for read mode.
     void updateOutlineFromHtml(const QString &p_tocHtml);
 
+    // Update m_outline according to the headers @p_items of the web side for
+    // read mode.
+    void updateOutlineFromTocItems(const QVector<VTableOfContentItem> &p_items);
+
     // Update m_outline accroding to @p_headers for edit mode.
     void updateOutlineFromHeaders(const QVector<VTableOfContentItem> &p_headers);
 
@@ -140,6 +170,9 @@ private slots:
     // Editor requests to update current header.
     void updateCurrentHeader(int p_blockNumber);
 
+    // Update current header by the source line map of the web view.
+    void handleWebScrollPositionChanged(const QPointF &p_pos);
+
     // Handle key press event in Web view.
     void handleWebKeyPressed(int p_key, bool p_ctrl, bool p_shift, bool p_meta);
 
@@ -161,6 +194,9 @@ private slots:
     // Selection changed in web.
     void handleWebSelectionChanged();
 
+    // Hoedown finishes converting request @p_id.
+    void handleHtmlConverted(int p_id, const QString &p_html, const QString &p_toc);
+
 private:
     enum TabReady { None = 0, ReadMode = 0x1, EditMode = 0x2 };
 
@@ -186,13 +222,17 @@ private:
     // Setup Markdown editor.
     void setupMarkdownEditor();
 
-    // Use VMarkdownConverter (hoedown) to generate the Web view.
+    // Use VMarkdownConverter (hoedown) to generate the Web view asynchronously.
     void viewWebByConverter();
 
     // Scroll Web view to given header.
     // Return true if scroll was made.
     bool scrollWebViewToHeader(const VHeaderPointer &p_header);
 
+    // Scroll Web view to source line @p_line via the source line map.
+    // Return true if scroll was made.
+    bool scrollWebViewToLine(int p_line);
+
     // @p_force: when true, will scroll even current mouse is under the specified header.
     bool scrollEditorToHeader(const VHeaderPointer &p_header, bool p_force = true);
 
@@ -263,9 +303,15 @@ private:
 
     bool m_backupFileChecked;
 
+    // Write edits to the backup file incrementally.
+    VBackupJournal *m_backupJournal;
+
     // Used to scroll to the header of edit mode in read mode.
     VHeaderPointer m_headerFromEditMode;
 
+    // Used to scroll to the first visible line of edit mode in read mode.
+    int m_lineFromEditMode;
+
     VVim::SearchItem m_lastSearchItem;
 
     Mode m_mode;
@@ -277,6 +323,22 @@ private:
     VMathJaxInplacePreviewHelper *m_mathjaxPreviewHelper;
 
     int m_documentID;
+
+    // ID of the latest hoedown conversion request.
+    // 0 if the latest one is dropped.
+    int m_convertID;
+
+    // Key in VReadModeCache of the latest hoedown conversion.
+    QByteArray m_readModeCacheKey;
+
+    // False if the content is not read and shown yet.
+    bool m_loaded;
+
+    // Mode to show the content in when loaded.
+    OpenFileMode m_modeToLoad;
+
+    // Bytes of the JavaScript heap of the web view last sampled, or -1.
+    qint64 m_webHeapBytes;
 };
 
 inline VMdEditor *VMdTab::getEditor()
@@ -0,0 +1,208 @@
+#include "vmemorystats.h"
+
+#include <QObject>
+#include <QPixmap>
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QTextLayout>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QDateTime>
+
+#include "vmainwindow.h"
+#include "veditarea.h"
+#include "vedittab.h"
+#include "vreadmodecache.h"
+#include "vsharedimagecache.h"
+#include "vdiagramcache.h"
+#include "vwebviewpool.h"
+#include "utils/vutils.h"
+
+extern VMainWindow *g_mainWin;
+
+// Rough overhead of a QTextBlock with its fragment, user data and layout.
+#define TEXT_BLOCK_OVERHEAD 256
+
+// Rough size of a laid out QTextLine.
+#define TEXT_LINE_BYTES 64
+
+QVector<VMemoryStats::Global> VMemoryStats::s_globals;
+
+void VMemoryStats::Group::add(const QString &p_name, qint64 p_bytes)
+{
+    m_items.append(Item(p_name, p_bytes));
+}
+
+qint64 VMemoryStats::Group::totalBytes() const
+{
+    qint64 total = 0;
+    for (auto const & item : m_items) {
+        if (item.m_bytes > 0) {
+            total += item.m_bytes;
+        }
+    }
+
+    return total;
+}
+
+QJsonObject VMemoryStats::Group::toJson() const
+{
+    QJsonObject items;
+    for (auto const & item : m_items) {
+        items[item.m_name] = (double)item.m_bytes;
+    }
+
+    QJsonObject obj;
+    obj["name"] = m_name;
+    obj["total"] = (double)totalBytes();
+    obj["items"] = items;
+    return obj;
+}
+
+void VMemoryStats::registerGlobal(QObject *p_owner, const QString &p_name, const SizeFunc &p_func)
+{
+    Global global;
+    global.m_owner = p_owner;
+    global.m_name = p_name;
+    global.m_func = p_func;
+    s_globals.append(global);
+
+    QObject::connect(p_owner, &QObject::destroyed,
+                     [](QObject *p_obj) {
+                         for (int i = s_globals.size() - 1; i >= 0; --i) {
+                             if (s_globals[i].m_owner == p_obj) {
+                                 s_globals.remove(i);
+                             }
+                         }
+                     });
+}
+
+QVector<VMemoryStats::Group> VMemoryStats::collect()
+{
+    QVector<Group> groups;
+
+    Group global;
+    global.m_name = "Global";
+    global.add("Read mode cache", VReadModeCache::totalBytes());
+    global.add("Shared images", VSharedImageCache::totalBytes());
+    global.add("Diagrams", VDiagramCache::totalBytes());
+    // Memory of the web views lives in the renderer processes.
+    int nrViews = VWebViewPool::inst()->pooledViewCount();
+    global.add(QString("Pooled web views (%1)").arg(nrViews), nrViews > 0 ? -1 : 0);
+    for (auto const & glb : s_globals) {
+        global.add(glb.m_name, glb.m_func());
+    }
+
+    groups.append(global);
+
+    if (!g_mainWin) {
+        return groups;
+    }
+
+    QVector<VEditTab *> tabs = g_mainWin->getEditArea()->getAllTabs();
+    for (auto tab : tabs) {
+        Group group;
+        const VFile *file = tab->getFile();
+        group.m_name = file ? file->fetchPath() : QString();
+        tab->collectMemoryStats(group);
+        groups.append(group);
+    }
+
+    return groups;
+}
+
+void VMemoryStats::requestWebHeapSizes()
+{
+    if (!g_mainWin) {
+        return;
+    }
+
+    QVector<VEditTab *> tabs = g_mainWin->getEditArea()->getAllTabs();
+    for (auto tab : tabs) {
+        tab->requestWebHeapSize();
+    }
+}
+
+QString VMemoryStats::toString(const QVector<Group> &p_groups)
+{
+    QString str = QString("VNote memory stats %1\n")
+                    .arg(QDateTime::currentDateTime().toString(Qt::ISODate));
+    for (auto const & group : p_groups) {
+        str += QString("\n%1: %2\n").arg(group.m_name).arg(bytesToString(group.totalBytes()));
+        for (auto const & item : group.m_items) {
+            str += QString("  %1 %2\n").arg(item.m_name, -24)
+                                       .arg(item.m_bytes < 0 ? QString("?")
+                                                             : bytesToString(item.m_bytes));
+        }
+    }
+
+    return str;
+}
+
+QJsonObject VMemoryStats::toJson(const QVector<Group> &p_groups)
+{
+    QJsonArray tabs;
+    for (int i = 1; i < p_groups.size(); ++i) {
+        tabs.append(p_groups[i].toJson());
+    }
+
+    QJsonObject obj;
+    obj["time"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+    if (!p_groups.isEmpty()) {
+        obj["global"] = p_groups[0].toJson();
+    }
+
+    obj["tabs"] = tabs;
+    return obj;
+}
+
+bool VMemoryStats::dump(const QString &p_filePath)
+{
+    QJsonDocument doc(toJson(collect()));
+    return VUtils::writeFileToDisk(p_filePath, doc.toJson());
+}
+
+qint64 VMemoryStats::stringBytes(const QString &p_str)
+{
+    return (qint64)p_str.capacity() * sizeof(QChar);
+}
+
+qint64 VMemoryStats::pixmapBytes(const QPixmap &p_pixmap)
+{
+    if (p_pixmap.isNull()) {
+        return 0;
+    }
+
+    return (qint64)p_pixmap.width() * p_pixmap.height() * p_pixmap.depth() / 8;
+}
+
+qint64 VMemoryStats::textDocumentBytes(const QTextDocument *p_doc)
+{
+    if (!p_doc) {
+        return 0;
+    }
+
+    qint64 bytes = (qint64)p_doc->characterCount() * sizeof(QChar);
+    for (QTextBlock block = p_doc->begin(); block.isValid(); block = block.next()) {
+        bytes += TEXT_BLOCK_OVERHEAD;
+
+        const QTextLayout *layout = block.layout();
+        if (layout) {
+            bytes += (qint64)layout->lineCount() * TEXT_LINE_BYTES;
+            bytes += (qint64)layout->formats().size() * sizeof(QTextLayout::FormatRange);
+        }
+    }
+
+    return bytes;
+}
+
+QString VMemoryStats::bytesToString(qint64 p_bytes)
+{
+    if (p_bytes < 1024) {
+        return QString("%1 B").arg(p_bytes);
+    } else if (p_bytes < 1024 * 1024) {
+        return QString("%1 KiB").arg(p_bytes / 1024.0, 0, 'f', 1);
+    } else {
+        return QString("%1 MiB").arg(p_bytes / 1024.0 / 1024.0, 0, 'f', 1);
+    }
+}
@@ -0,0 +1,96 @@
+#ifndef VMEMORYSTATS_H
+#define VMEMORYSTATS_H
+
+#include <QString>
+#include <QVector>
+#include <QJsonObject>
+#include <functional>
+
+class QObject;
+class QPixmap;
+class QTextDocument;
+
+// Approximate memory accounting of the opened tabs and the global caches.
+// Sizes are estimated from the data held by each subsystem, not measured from
+// the allocator, so they are meant to compare tabs and features.
+// Should be accessed only in the GUI thread.
+class VMemoryStats
+{
+public:
+    struct Item
+    {
+        Item()
+            : m_bytes(0)
+        {
+        }
+
+        Item(const QString &p_name, qint64 p_bytes)
+            : m_name(p_name),
+              m_bytes(p_bytes)
+        {
+        }
+
+        QString m_name;
+
+        // -1 if unknown.
+        qint64 m_bytes;
+    };
+
+    // Items of one tab or of the global caches.
+    struct Group
+    {
+        void add(const QString &p_name, qint64 p_bytes);
+
+        // Sum of the known items.
+        qint64 totalBytes() const;
+
+        QJsonObject toJson() const;
+
+        QString m_name;
+
+        QVector<Item> m_items;
+    };
+
+    typedef std::function<qint64()> SizeFunc;
+
+    // Report @p_func as a global cache named @p_name until @p_owner is destroyed.
+    static void registerGlobal(QObject *p_owner, const QString &p_name, const SizeFunc &p_func);
+
+    // Stats of the global caches followed by one group per opened tab.
+    static QVector<Group> collect();
+
+    // Ask the web views of the opened tabs to sample their JavaScript heap,
+    // which will be reported by the following collect().
+    static void requestWebHeapSizes();
+
+    static QString toString(const QVector<Group> &p_groups);
+
+    static QJsonObject toJson(const QVector<Group> &p_groups);
+
+    // Write the JSON of collect() to @p_filePath.
+    static bool dump(const QString &p_filePath);
+
+    static qint64 stringBytes(const QString &p_str);
+
+    static qint64 pixmapBytes(const QPixmap &p_pixmap);
+
+    // Text, blocks and layouts of @p_doc.
+    static qint64 textDocumentBytes(const QTextDocument *p_doc);
+
+    // Human readable @p_bytes.
+    static QString bytesToString(qint64 p_bytes);
+
+private:
+    struct Global
+    {
+        QObject *m_owner;
+
+        QString m_name;
+
+        SizeFunc m_func;
+    };
+
+    static QVector<Global> s_globals;
+};
+
+#endif // VMEMORYSTATS_H
@@ -0,0 +1,335 @@
+#include "vmetadataquery.h"
+
+#include <QDateTime>
+#include <QRegularExpression>
+
+#include <limits>
+
+VMetadataQuery::VMetadataQuery()
+    : m_op(Operator::And),
+      m_caseSensitivity(Qt::CaseInsensitive)
+{
+}
+
+void VMetadataQuery::clear()
+{
+    m_predicates.clear();
+    m_frontMatterKeys.clear();
+    m_op = Operator::And;
+}
+
+bool VMetadataQuery::parse(const QStringList &p_args, Qt::CaseSensitivity p_cs)
+{
+    clear();
+    m_caseSensitivity = p_cs;
+
+    bool valid = true;
+    for (auto const & arg : p_args) {
+        if (arg == QStringLiteral("&&")) {
+            m_op = Operator::And;
+            continue;
+        } else if (arg == QStringLiteral("||")) {
+            m_op = Operator::Or;
+            continue;
+        }
+
+        Predicate pred;
+        int idx = arg.indexOf(':');
+        if (idx <= 0) {
+            pred.m_field = Field::Name;
+            pred.m_value = arg;
+        } else {
+            QString key = arg.left(idx).toLower();
+            pred.m_value = arg.mid(idx + 1);
+            if (key == QStringLiteral("name")) {
+                pred.m_field = Field::Name;
+            } else if (key == QStringLiteral("tag")) {
+                pred.m_field = Field::Tag;
+            } else if (key == QStringLiteral("created") || key == QStringLiteral("modified")) {
+                pred.m_field = key == QStringLiteral("created") ? Field::Created : Field::Modified;
+                if (!parseTimeRange(pred.m_value, pred.m_from, pred.m_to)) {
+                    valid = false;
+                    continue;
+                }
+            } else {
+                pred.m_field = Field::FrontMatter;
+                pred.m_key = key;
+                pred.m_exists = pred.m_value == QStringLiteral("*");
+                if (!m_frontMatterKeys.contains(key)) {
+                    m_frontMatterKeys.append(key);
+                }
+            }
+        }
+
+        if (pred.m_value.isEmpty()) {
+            valid = false;
+            continue;
+        }
+
+        m_predicates.append(pred);
+    }
+
+    // Tags of the front matter are also checked for Tag.
+    for (auto const & pred : m_predicates) {
+        if (pred.m_field == Field::Tag) {
+            if (!m_frontMatterKeys.contains(QStringLiteral("tags"))) {
+                m_frontMatterKeys.append(QStringLiteral("tags"));
+            }
+
+            break;
+        }
+    }
+
+    return valid;
+}
+
+bool VMetadataQuery::matched(const VNoteMetadata &p_meta) const
+{
+    if (m_predicates.isEmpty()) {
+        return false;
+    }
+
+    for (auto const & pred : m_predicates) {
+        bool ret = matchOne(pred, p_meta);
+        if (m_op == Operator::Or && ret) {
+            return true;
+        } else if (m_op == Operator::And && !ret) {
+            return false;
+        }
+    }
+
+    return m_op == Operator::And;
+}
+
+bool VMetadataQuery::matchOne(const Predicate &p_pred, const VNoteMetadata &p_meta) const
+{
+    switch (p_pred.m_field) {
+    case Field::Name:
+        return matchText(p_meta.m_name, p_pred.m_value);
+
+    case Field::Tag:
+    {
+        for (auto const & tag : p_meta.m_tags) {
+            if (tag.compare(p_pred.m_value, m_caseSensitivity) == 0) {
+                return true;
+            }
+        }
+
+        const QString fmTags = p_meta.m_frontMatter.value(QStringLiteral("tags"));
+        if (!fmTags.isEmpty()) {
+            const QStringList tags = fmTags.split('\n');
+            for (auto const & tag : tags) {
+                if (tag.compare(p_pred.m_value, m_caseSensitivity) == 0) {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    case Field::Created:
+        return p_meta.m_createdTime >= p_pred.m_from && p_meta.m_createdTime < p_pred.m_to;
+
+    case Field::Modified:
+        return p_meta.m_modifiedTime >= p_pred.m_from && p_meta.m_modifiedTime < p_pred.m_to;
+
+    case Field::FrontMatter:
+    {
+        auto it = p_meta.m_frontMatter.constFind(p_pred.m_key);
+        if (it == p_meta.m_frontMatter.constEnd()) {
+            return false;
+        }
+
+        return p_pred.m_exists || matchText(it.value(), p_pred.m_value);
+    }
+
+    default:
+        return false;
+    }
+}
+
+bool VMetadataQuery::matchText(const QString &p_text, const QString &p_value) const
+{
+    return p_text.contains(p_value, m_caseSensitivity);
+}
+
+bool VMetadataQuery::parseTimeRange(const QString &p_value, qint64 &p_from, qint64 &p_to)
+{
+    const qint64 minTime = std::numeric_limits<qint64>::min();
+    const qint64 maxTime = std::numeric_limits<qint64>::max();
+
+    QDate today = QDate::currentDate();
+    auto startOfDay = [](const QDate &p_date) {
+        return QDateTime(p_date, QTime(0, 0), Qt::LocalTime).toMSecsSinceEpoch();
+    };
+
+    QString value = p_value.toLower();
+    if (value == QStringLiteral("today")) {
+        p_from = startOfDay(today);
+        p_to = maxTime;
+        return true;
+    } else if (value == QStringLiteral("yesterday")) {
+        p_from = startOfDay(today.addDays(-1));
+        p_to = startOfDay(today);
+        return true;
+    }
+
+    static const QRegularExpression relativeReg("^(\\d+)([dwmy])$");
+    QRegularExpressionMatch match = relativeReg.match(value);
+    if (match.hasMatch()) {
+        int num = match.captured(1).toInt();
+        QDateTime now = QDateTime::currentDateTime();
+        QDateTime from;
+        switch (match.captured(2).at(0).toLatin1()) {
+        case 'd':
+            from = now.addDays(-num);
+            break;
+
+        case 'w':
+            from = now.addDays(-7 * num);
+            break;
+
+        case 'm':
+            from = now.addMonths(-num);
+            break;
+
+        default:
+            from = now.addYears(-num);
+            break;
+        }
+
+        p_from = from.toMSecsSinceEpoch();
+        p_to = maxTime;
+        return true;
+    }
+
+    QString op;
+    if (value.startsWith(QStringLiteral(">=")) || value.startsWith(QStringLiteral("<="))) {
+        op = value.left(2);
+    } else if (value.startsWith('>') || value.startsWith('<')) {
+        op = value.left(1);
+    }
+
+    QDate date = QDate::fromString(value.mid(op.size()), Qt::ISODate);
+    if (!date.isValid()) {
+        return false;
+    }
+
+    if (op.isEmpty()) {
+        p_from = startOfDay(date);
+        p_to = startOfDay(date.addDays(1));
+    } else if (op == QStringLiteral(">")) {
+        p_from = startOfDay(date.addDays(1));
+        p_to = maxTime;
+    } else if (op == QStringLiteral(">=")) {
+        p_from = startOfDay(date);
+        p_to = maxTime;
+    } else if (op == QStringLiteral("<")) {
+        p_from = minTime;
+        p_to = startOfDay(date);
+    } else {
+        p_from = minTime;
+        p_to = startOfDay(date.addDays(1));
+    }
+
+    return true;
+}
+
+QString VMetadataQuery::frontMatterText(const QString &p_text)
+{
+    static const QRegularExpression headReg("^---[ \\t]*\\r?\\n");
+    QRegularExpressionMatch head = headReg.match(p_text);
+    if (!head.hasMatch()) {
+        return QString();
+    }
+
+    static const QRegularExpression tailReg("^(---|\\.\\.\\.)[ \\t]*\\r?$",
+                                            QRegularExpression::MultilineOption);
+    int start = head.capturedEnd();
+    QRegularExpressionMatch tail = tailReg.match(p_text, start);
+    if (!tail.hasMatch()) {
+        return QString();
+    }
+
+    return p_text.mid(start, tail.capturedStart() - start);
+}
+
+// Strip the quotes around a scalar value.
+static QString unquote(const QString &p_value)
+{
+    QString value = p_value.trimmed();
+    if (value.size() >= 2
+        && ((value.startsWith('"') && value.endsWith('"'))
+            || (value.startsWith('\'') && value.endsWith('\'')))) {
+        value = value.mid(1, value.size() - 2);
+    }
+
+    return value;
+}
+
+QHash<QString, QString> VMetadataQuery::parseFrontMatter(const QString &p_text)
+{
+    QHash<QString, QString> fields;
+    const QStringList lines = p_text.split(QRegularExpression("\\r?\\n"));
+
+    // Key of the field whose list items are being read.
+    QString listKey;
+    QStringList listItems;
+
+    for (auto const & line : lines) {
+        QString trimmed = line.trimmed();
+        if (trimmed.isEmpty() || trimmed.startsWith('#')) {
+            continue;
+        }
+
+        bool indented = line[0].isSpace();
+        if (!listKey.isEmpty()) {
+            if (trimmed.startsWith(QStringLiteral("- ")) || trimmed == QStringLiteral("-")) {
+                listItems.append(unquote(trimmed.mid(1)));
+                continue;
+            }
+
+            fields.insert(listKey, listItems.join('\n'));
+            listKey.clear();
+            listItems.clear();
+        }
+
+        if (indented) {
+            // Nested mappings are not supported.
+            continue;
+        }
+
+        int idx = trimmed.indexOf(':');
+        if (idx <= 0) {
+            continue;
+        }
+
+        QString key = trimmed.left(idx).trimmed().toLower();
+        QString value = trimmed.mid(idx + 1).trimmed();
+        if (value.isEmpty()) {
+            // Items may follow as a block list.
+            listKey = key;
+            continue;
+        }
+
+        if (value.startsWith('[') && value.endsWith(']')) {
+            QStringList items = value.mid(1, value.size() - 2).split(',', QString::SkipEmptyParts);
+            for (auto &item : items) {
+                item = unquote(item);
+            }
+
+            value = items.join('\n');
+        } else {
+            value = unquote(value);
+        }
+
+        fields.insert(key, value);
+    }
+
+    if (!listKey.isEmpty()) {
+        fields.insert(listKey, listItems.join('\n'));
+    }
+
+    return fields;
+}
@@ -0,0 +1,139 @@
+#ifndef VMETADATAQUERY_H
+#define VMETADATAQUERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+
+// Metadata of a note to evaluate a query against.
+struct VNoteMetadata
+{
+    VNoteMetadata()
+        : m_createdTime(0),
+          m_modifiedTime(0)
+    {
+    }
+
+    QString m_name;
+
+    // Msecs since epoch in UTC.
+    qint64 m_createdTime;
+
+    qint64 m_modifiedTime;
+
+    QStringList m_tags;
+
+    // Lower-case key -> value of the front matter. Items of a list are
+    // separated by '\n'.
+    QHash<QString, QString> m_frontMatter;
+};
+
+
+// Query of predicates on the metadata of notes, which is evaluated without
+// reading the content of notes.
+// Each argument is a predicate:
+// tag:TAG                 notes with tag TAG (or in the tags of front matter);
+// name:TEXT               notes whose name contains TEXT;
+// created:TIME            notes created within TIME;
+// modified:TIME           notes modified within TIME;
+// KEY:TEXT                notes whose front matter field KEY contains TEXT;
+// KEY:*                   notes with front matter field KEY;
+// TEXT                    same as name:TEXT.
+// TIME could be today, yesterday, Nd/Nw/Nm/Ny for the last N days, weeks,
+// months or years, yyyy-MM-dd for a day, or a day prefixed with >, >=, <, or <=.
+class VMetadataQuery
+{
+public:
+    enum Operator
+    {
+        And = 0,
+        Or
+    };
+
+    VMetadataQuery();
+
+    // Parse @p_args. && and || set the operator.
+    // Return false if there is any invalid predicate.
+    bool parse(const QStringList &p_args, Qt::CaseSensitivity p_cs);
+
+    void clear();
+
+    bool isEmpty() const;
+
+    // Lower-case keys of the front matter used by the predicates.
+    const QStringList &frontMatterKeys() const;
+
+    bool matched(const VNoteMetadata &p_meta) const;
+
+    // Parse the front matter at the beginning of @p_text in the form of YAML.
+    // Only flat key-value pairs and lists are supported.
+    static QHash<QString, QString> parseFrontMatter(const QString &p_text);
+
+    // Text of the front matter at the beginning of @p_text, without the
+    // delimiters. Empty if there is no front matter.
+    static QString frontMatterText(const QString &p_text);
+
+private:
+    enum Field
+    {
+        Name = 0,
+        Tag,
+        Created,
+        Modified,
+        FrontMatter
+    };
+
+    struct Predicate
+    {
+        Predicate()
+            : m_field(Field::Name),
+              m_exists(false),
+              m_from(0),
+              m_to(0)
+        {
+        }
+
+        Field m_field;
+
+        // Lower-case key for FrontMatter.
+        QString m_key;
+
+        QString m_value;
+
+        // Only check the existence of FrontMatter field.
+        bool m_exists;
+
+        // Range [m_from, m_to) of Created and Modified.
+        qint64 m_from;
+
+        qint64 m_to;
+    };
+
+    bool matchOne(const Predicate &p_pred, const VNoteMetadata &p_meta) const;
+
+    bool matchText(const QString &p_text, const QString &p_value) const;
+
+    // Parse @p_value into [p_from, p_to).
+    static bool parseTimeRange(const QString &p_value, qint64 &p_from, qint64 &p_to);
+
+    QVector<Predicate> m_predicates;
+
+    QStringList m_frontMatterKeys;
+
+    Operator m_op;
+
+    Qt::CaseSensitivity m_caseSensitivity;
+};
+
+inline bool VMetadataQuery::isEmpty() const
+{
+    return m_predicates.isEmpty();
+}
+
+inline const QStringList &VMetadataQuery::frontMatterKeys() const
+{
+    return m_frontMatterKeys;
+}
+
+#endif // VMETADATAQUERY_H
@@ -0,0 +1,128 @@
+#include "vmultipatternmatcher.h"
+
+#include <QQueue>
+
+VMultiPatternMatcher::VMultiPatternMatcher(const QStringList &p_patterns,
+                                           Qt::CaseSensitivity p_cs)
+    : m_cs(p_cs)
+{
+    m_nodes.append(Node());
+    for (auto const & pat : p_patterns) {
+        if (!pat.isEmpty()) {
+            addPattern(pat);
+        }
+    }
+
+    buildFailLinks();
+}
+
+ushort VMultiPatternMatcher::fold(const QChar &p_ch) const
+{
+    if (m_cs == Qt::CaseSensitive) {
+        return p_ch.unicode();
+    }
+
+    return p_ch.toCaseFolded().unicode();
+}
+
+void VMultiPatternMatcher::addPattern(const QString &p_pattern)
+{
+    int state = 0;
+    for (int i = 0; i < p_pattern.size(); ++i) {
+        ushort ch = fold(p_pattern[i]);
+        int next = m_nodes[state].m_next.value(ch, -1);
+        if (next == -1) {
+            next = m_nodes.size();
+            m_nodes.append(Node());
+            m_nodes[state].m_next.insert(ch, next);
+        }
+
+        state = next;
+    }
+
+    if (!m_nodes[state].m_lengths.contains(p_pattern.size())) {
+        m_nodes[state].m_lengths.append(p_pattern.size());
+    }
+}
+
+void VMultiPatternMatcher::buildFailLinks()
+{
+    QQueue<int> queue;
+    for (auto it = m_nodes[0].m_next.constBegin(); it != m_nodes[0].m_next.constEnd(); ++it) {
+        queue.enqueue(it.value());
+    }
+
+    while (!queue.isEmpty()) {
+        int cur = queue.dequeue();
+        const QHash<ushort, int> &next = m_nodes[cur].m_next;
+        for (auto it = next.constBegin(); it != next.constEnd(); ++it) {
+            int child = it.value();
+            int fail = m_nodes[cur].m_fail;
+            while (fail != 0 && !m_nodes[fail].m_next.contains(it.key())) {
+                fail = m_nodes[fail].m_fail;
+            }
+
+            int target = m_nodes[fail].m_next.value(it.key(), 0);
+            Node &node = m_nodes[child];
+            node.m_fail = target == child ? 0 : target;
+            const Node &failNode = m_nodes[node.m_fail];
+            node.m_outLink = failNode.m_lengths.isEmpty() ? failNode.m_outLink : node.m_fail;
+            queue.enqueue(child);
+        }
+    }
+}
+
+int VMultiPatternMatcher::step(int p_state, ushort p_ch) const
+{
+    while (true) {
+        int next = m_nodes[p_state].m_next.value(p_ch, -1);
+        if (next != -1) {
+            return next;
+        }
+
+        if (p_state == 0) {
+            return 0;
+        }
+
+        p_state = m_nodes[p_state].m_fail;
+    }
+}
+
+void VMultiPatternMatcher::match(const QString &p_text, QVector<QPair<int, int>> &p_matches) const
+{
+    if (isEmpty() || p_text.isEmpty()) {
+        return;
+    }
+
+    // Longest match starting at each position.
+    QVector<int> longest(p_text.size(), 0);
+    bool found = false;
+    int state = 0;
+    for (int i = 0; i < p_text.size(); ++i) {
+        state = step(state, fold(p_text[i]));
+        for (int out = m_nodes[state].m_lengths.isEmpty() ? m_nodes[state].m_outLink : state;
+             out > 0;
+             out = m_nodes[out].m_outLink) {
+            for (int len : m_nodes[out].m_lengths) {
+                int &cur = longest[i - len + 1];
+                if (len > cur) {
+                    cur = len;
+                }
+            }
+
+            found = true;
+        }
+    }
+
+    if (!found) {
+        return;
+    }
+
+    int lastEnd = 0;
+    for (int i = 0; i < longest.size(); ++i) {
+        if (longest[i] > 0 && i >= lastEnd) {
+            p_matches.append(qMakePair(i, longest[i]));
+            lastEnd = i + longest[i];
+        }
+    }
+}
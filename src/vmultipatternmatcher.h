@@ -0,0 +1,61 @@
+#ifndef VMULTIPATTERNMATCHER_H
+#define VMULTIPATTERNMATCHER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QPair>
+
+// Aho-Corasick automaton to find all the raw string patterns in one pass.
+class VMultiPatternMatcher
+{
+public:
+    VMultiPatternMatcher(const QStringList &p_patterns, Qt::CaseSensitivity p_cs);
+
+    bool isEmpty() const;
+
+    // Append the non-overlapping matches in @p_text to @p_matches as pairs of
+    // start and length, in order. At each position the longest pattern wins.
+    void match(const QString &p_text, QVector<QPair<int, int>> &p_matches) const;
+
+private:
+    struct Node
+    {
+        Node()
+            : m_fail(0),
+              m_outLink(-1)
+        {
+        }
+
+        QHash<ushort, int> m_next;
+
+        int m_fail;
+
+        // Nearest node on the fail chain with outputs.
+        int m_outLink;
+
+        // Lengths of the patterns ending at this node.
+        QVector<int> m_lengths;
+    };
+
+    ushort fold(const QChar &p_ch) const;
+
+    void addPattern(const QString &p_pattern);
+
+    void buildFailLinks();
+
+    int step(int p_state, ushort p_ch) const;
+
+    Qt::CaseSensitivity m_cs;
+
+    // Node 0 is the root.
+    QVector<Node> m_nodes;
+};
+
+inline bool VMultiPatternMatcher::isEmpty() const
+{
+    return m_nodes.size() == 1;
+}
+
+#endif // VMULTIPATTERNMATCHER_H
@@ -0,0 +1,129 @@
+#include "vnativehtmlrenderer.h"
+
+#include <QRegularExpression>
+#include <QStringList>
+#include <QVector>
+
+#include "vcodeblocktokenizer.h"
+#include "vcodeblockstyletable.h"
+
+// Languages of fenced code blocks rendered by scripts.
+static const QStringList c_scriptLanguages = { "mermaid",
+                                               "flowchart",
+                                               "flow",
+                                               "wavedrom",
+                                               "puml",
+                                               "dot",
+                                               "mathjax" };
+
+bool VNativeHtmlRenderer::isRenderable(const QString &p_markdown, bool p_mathjax)
+{
+    if (p_mathjax
+        && (p_markdown.contains('$')
+            || p_markdown.contains("\\(")
+            || p_markdown.contains("\\["))) {
+        return false;
+    }
+
+    QRegularExpression fenceReg("^\\s*(?:```|~~~)\\s*([^`\\s]+)",
+                                QRegularExpression::MultilineOption);
+    QRegularExpressionMatchIterator it = fenceReg.globalMatch(p_markdown);
+    while (it.hasNext()) {
+        QString lang = it.next().captured(1).toLower();
+        if (c_scriptLanguages.contains(lang)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+QString VNativeHtmlRenderer::render(const QString &p_markdown,
+                                    hoedown_extensions p_extensions,
+                                    bool p_addToc)
+{
+    VMarkdownConverter mdConverter;
+    QString toc;
+    QString html = mdConverter.generateHtml(p_markdown, p_extensions, toc);
+    if (p_addToc && !toc.isEmpty()) {
+        html = "<div class=\"vnote-toc\">" + toc + "</div>\n" + html;
+    }
+
+    return highlightCodeBlocks(html);
+}
+
+static QString unescapeHtml(const QString &p_text)
+{
+    QString text(p_text);
+    text.replace("&lt;", "<");
+    text.replace("&gt;", ">");
+    text.replace("&quot;", "\"");
+    text.replace("&#39;", "'");
+    text.replace("&#47;", "/");
+    text.replace("&amp;", "&");
+    return text;
+}
+
+QString VNativeHtmlRenderer::highlightCodeBlocks(const QString &p_html)
+{
+    const QString openTag("<pre><code class=\"language-");
+    const QString closeTag("</code></pre>");
+
+    QString html;
+    html.reserve(p_html.size() + p_html.size() / 4);
+
+    int pos = 0;
+    while (true) {
+        int idx = p_html.indexOf(openTag, pos);
+        if (idx == -1) {
+            break;
+        }
+
+        int langStart = idx + openTag.size();
+        int langEnd = p_html.indexOf("\">", langStart);
+        if (langEnd == -1) {
+            break;
+        }
+
+        int codeStart = langEnd + 2;
+        int codeEnd = p_html.indexOf(closeTag, codeStart);
+        if (codeEnd == -1) {
+            break;
+        }
+
+        QString lang = unescapeHtml(p_html.mid(langStart, langEnd - langStart));
+        if (!VCodeBlockTokenizer::isSupported(lang)) {
+            html += p_html.midRef(pos, codeEnd - pos);
+            pos = codeEnd;
+            continue;
+        }
+
+        html += p_html.midRef(pos, langEnd - pos);
+        html += " hljs\">";
+
+        // The tokenizer expects the text with fences.
+        const QString fence("```\n");
+        QString code = unescapeHtml(p_html.mid(codeStart, codeEnd - codeStart));
+        QVector<HLUnitPos> units = VCodeBlockTokenizer::tokenize(lang, fence + code + "```");
+
+        int codePos = 0;
+        for (auto const & unit : units) {
+            int start = unit.m_position - fence.size();
+            if (start < codePos || start + unit.m_length > code.size()) {
+                continue;
+            }
+
+            html += code.mid(codePos, start - codePos).toHtmlEscaped();
+            html += "<span class=\"" + VCodeBlockStyleTable::styleName(unit.m_style) + "\">";
+            html += code.mid(start, unit.m_length).toHtmlEscaped();
+            html += "</span>";
+            codePos = start + unit.m_length;
+        }
+
+        html += code.mid(codePos).toHtmlEscaped();
+        pos = codeEnd;
+    }
+
+    html += p_html.midRef(pos);
+    return html;
+}
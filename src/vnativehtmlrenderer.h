@@ -0,0 +1,29 @@
+#ifndef VNATIVEHTMLRENDERER_H
+#define VNATIVEHTMLRENDERER_H
+
+#include <QString>
+
+#include "vmarkdownconverter.h"
+
+// Render Markdown to the HTML body of export natively via hoedown, without
+// going through a web view.
+// Thread-safe.
+class VNativeHtmlRenderer
+{
+public:
+    // Whether @p_markdown could be rendered natively, that is, it contains no
+    // blocks which need scripts like Mermaid, flowchart.js and WaveDrom.
+    // @p_mathjax: whether MathJax is enabled.
+    static bool isRenderable(const QString &p_markdown, bool p_mathjax);
+
+    // @p_addToc: prepend the TOC to the body.
+    static QString render(const QString &p_markdown,
+                          hoedown_extensions p_extensions,
+                          bool p_addToc);
+
+private:
+    // Highlight the fenced code blocks in @p_html like highlight.js does.
+    static QString highlightCodeBlocks(const QString &p_html);
+};
+
+#endif // VNATIVEHTMLRENDERER_H
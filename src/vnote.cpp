@@ -7,11 +7,14 @@
 #include <QFontMetrics>
 #include <QStringList>
 #include <QFontDatabase>
+#include <QResource>
+#include <QCoreApplication>
 #include "vnote.h"
 #include "utils/vutils.h"
 #include "vconfigmanager.h"
 #include "vorphanfile.h"
 #include "vnotefile.h"
+#include "vdirectory.h"
 #include "vpalette.h"
 
 extern VConfigManager *g_config;
@@ -33,6 +36,8 @@ const QString VNote::c_markedJsFile = ":/resources/marked.js";
 const QString VNote::c_markedExtraFile = ":/utils/marked/marked.min.js";
 
 const QString VNote::c_markdownitJsFile = ":/resources/markdown-it.js";
+const QString VNote::c_markdownitCoreJsFile = ":/resources/markdown-it_core.js";
+const QString VNote::c_markdownitWorkerJsFile = ":/resources/markdown-it_worker.js";
 const QString VNote::c_markdownitExtraFile = ":/utils/markdown-it/markdown-it.min.js";
 const QString VNote::c_markdownitAnchorExtraFile = ":/utils/markdown-it/markdown-it-headinganchor.js";
 const QString VNote::c_markdownitTaskListExtraFile = ":/utils/markdown-it/markdown-it-task-lists.min.js";
@@ -64,6 +69,7 @@ const QString VNote::c_wavedromThemeFile = ":/utils/wavedrom/wavedrom-theme.js";
 const QString VNote::c_plantUMLJsFile = "http://s.plantuml.com/synchro2.js";
 const QString VNote::c_plantUMLZopfliJsFile = "http://s.plantuml.com/zopfli.raw.min.js";
 
+const QString VNote::c_highlightjsJsFile = ":/utils/highlightjs/highlight.pack.js";
 const QString VNote::c_highlightjsLineNumberExtraFile = ":/utils/highlightjs/highlightjs-line-numbers.min.js";
 
 const QString VNote::c_docFileFolder = ":/resources/docs";
@@ -198,6 +204,41 @@ QString VNote::generateMathJaxPreviewTemplate()
     return templ;
 }
 
+bool VNote::loadDiagramResourcePack()
+{
+    const QString c_packName("vnote_diagram.rcc");
+
+    // -1 for not loaded yet.
+    static int loaded = -1;
+    if (loaded != -1) {
+        return loaded == 1;
+    }
+
+    QDir appDir(QCoreApplication::applicationDirPath());
+    QStringList candidates;
+    candidates << appDir.filePath(c_packName)
+#if defined(Q_OS_MACOS) || defined(Q_OS_MAC)
+               << appDir.filePath("../Resources/" + c_packName)
+#endif
+               << appDir.filePath("../share/vnote/" + c_packName);
+
+    loaded = 0;
+    for (auto const & path : candidates) {
+        // The pack is memory-mapped.
+        if (QFileInfo::exists(path) && QResource::registerResource(path)) {
+            qDebug() << "diagram resource pack loaded" << path;
+            loaded = 1;
+            break;
+        }
+    }
+
+    if (!loaded) {
+        qWarning() << "fail to load diagram resource pack" << c_packName << "from" << candidates;
+    }
+
+    return loaded == 1;
+}
+
 void VNote::updateTemplate()
 {
     QString renderBg = g_config->getRenderBackgroundColor(g_config->getCurRenderBackgroundColor());
@@ -206,6 +247,8 @@ void VNote::updateTemplate()
                                               g_config->getCssStyleUrl(),
                                               g_config->getCodeBlockCssStyleUrl(),
                                               false);
+
+    VUtils::clearHtmlTemplateCache();
 }
 
 const QVector<VNotebook *> &VNote::getNotebooks() const
@@ -327,6 +370,52 @@ VNoteFile *VNote::getInternalFile(const QString &p_path)
     return file;
 }
 
+QVector<VNoteFile *> VNote::getInternalFiles(const QVector<QString> &p_paths)
+{
+    QVector<VNoteFile *> files(p_paths.size(), NULL);
+
+    // Group the paths by folder.
+    QHash<QString, QVector<int>> pathsOfDir;
+    for (int i = 0; i < p_paths.size(); ++i) {
+        pathsOfDir[VUtils::basePathFromPath(QDir::cleanPath(p_paths[i]))].append(i);
+    }
+
+#if defined(Q_OS_WIN)
+    bool caseSensitive = false;
+#else
+    bool caseSensitive = true;
+#endif
+
+    for (auto it = pathsOfDir.constBegin(); it != pathsOfDir.constEnd(); ++it) {
+        VDirectory *dir = NULL;
+        VNotebook *nb = getNotebook(it.key());
+        if (nb) {
+            if (nb->open()) {
+                dir = nb->getRootDir();
+            }
+        } else {
+            dir = getInternalDirectory(it.key());
+        }
+
+        if (!dir || !dir->open()) {
+            continue;
+        }
+
+        QHash<QString, VNoteFile *> fileOfName;
+        const QVector<VNoteFile *> &dirFiles = dir->getFiles();
+        for (auto file : dirFiles) {
+            fileOfName.insert(caseSensitive ? file->getName() : file->getName().toLower(), file);
+        }
+
+        for (int idx : it.value()) {
+            QString name = VUtils::fileNameFromPath(p_paths[idx]);
+            files[idx] = fileOfName.value(caseSensitive ? name : name.toLower(), NULL);
+        }
+    }
+
+    return files;
+}
+
 VFile *VNote::getFile(const QString &p_path, bool p_forceOrphan)
 {
     VFile *file = NULL;
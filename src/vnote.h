@@ -44,6 +44,8 @@ public:
 
     // Markdown-it
     static const QString c_markdownitJsFile;
+    static const QString c_markdownitCoreJsFile;
+    static const QString c_markdownitWorkerJsFile;
     static const QString c_markdownitExtraFile;
     static const QString c_markdownitAnchorExtraFile;
     static const QString c_markdownitTaskListExtraFile;
@@ -82,6 +84,7 @@ public:
     static const QString c_plantUMLZopfliJsFile;
 
     // Highlight.js line number plugin
+    static const QString c_highlightjsJsFile;
     static const QString c_highlightjsLineNumberExtraFile;
 
     static const QString c_docFileFolder;
@@ -102,6 +105,10 @@ public:
     // Otherwise, returns NULL.
     VNoteFile *getInternalFile(const QString &p_path);
 
+    // Batch version of getInternalFile(), which locates each folder once.
+    // Returns a VNoteFile or NULL for each path in @p_paths.
+    QVector<VNoteFile *> getInternalFiles(const QVector<QString> &p_paths);
+
     // Given the path of a folder, try to find it in all notebooks.
     // Returns a VDirectory struct if it is a folder in one notebook.
     // Otherwise, returns NULL.
@@ -124,6 +131,11 @@ public:
 
     static QString generateMathJaxPreviewTemplate();
 
+    // Register the external resource pack of the diagram scripts, which are
+    // not compiled into the binary, on first use.
+    // Return false if the pack is missing.
+    static bool loadDiagramResourcePack();
+
     static const QString &getMonospaceFont();
 
 public slots:
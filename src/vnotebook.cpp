@@ -3,16 +3,75 @@
 #include <QDebug>
 #include <QCoreApplication>
 #include <QJsonArray>
+#include <QRunnable>
 
 #include "vdirectory.h"
 #include "utils/vutils.h"
 #include "vconfigmanager.h"
 #include "vnotefile.h"
+#include "vnotebooksnapshot.h"
+#include "vtagindex.h"
+#include "vrecyclebin.h"
+#include "vtaguniverse.h"
+#include "vtaskexecutor.h"
 
 extern VConfigManager *g_config;
 
+// Collect the tags of the notes of a notebook for its tag index.
+class TagIndexTask : public QRunnable
+{
+public:
+    TagIndexTask(VNotebook *p_notebook,
+                 const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                 const QString &p_rootPath,
+                 int p_revision)
+        : m_notebook(p_notebook),
+          m_snapshot(p_snapshot),
+          m_rootPath(p_rootPath),
+          m_revision(p_revision)
+    {
+        // Owned by the notebook.
+        setAutoDelete(false);
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_tags = VTagIndex::collect(m_snapshot, m_rootPath);
+
+        // The notebook waits for the task before destruction.
+        QMetaObject::invokeMethod(m_notebook, "handleTagIndexCollected", Qt::QueuedConnection);
+    }
+
+    const QHash<QString, QStringList> &tags() const
+    {
+        return m_tags;
+    }
+
+    int revision() const
+    {
+        return m_revision;
+    }
+
+private:
+    VNotebook *m_notebook;
+
+    QSharedPointer<VNotebookSnapshot> m_snapshot;
+
+    QString m_rootPath;
+
+    int m_revision;
+
+    QHash<QString, QStringList> m_tags;
+};
+
 VNotebook::VNotebook(const QString &name, const QString &path, QObject *parent)
-    : QObject(parent), m_name(name), m_valid(false)
+    : QObject(parent),
+      m_name(name),
+      m_contentAddressedImages(false),
+      m_tagIndex(new VTagIndex()),
+      m_tagIndexTask(NULL),
+      m_valid(false),
+      m_configRead(false)
 {
     setPath(path);
     m_recycleBinFolder = g_config->getRecycleBinFolder();
@@ -24,7 +83,18 @@ VNotebook::VNotebook(const QString &name, const QString &path, QObject *parent)
 
 VNotebook::~VNotebook()
 {
+    if (m_tagIndexTask) {
+        if (!VTaskExecutor::inst()->cancel(m_tagIndexTask)) {
+            VTaskExecutor::inst()->waitForDone(VTaskExecutor::Maintenance);
+        }
+
+        delete m_tagIndexTask;
+        m_tagIndexTask = NULL;
+    }
+
     delete m_rootDir;
+    m_snapshot->save();
+    delete m_tagIndex;
 }
 
 void VNotebook::setPath(const QString &p_path)
@@ -35,10 +105,18 @@ void VNotebook::setPath(const QString &p_path)
     } else {
         m_path = QDir::cleanPath(QDir(QCoreApplication::applicationDirPath()).absoluteFilePath(m_pathInConfig));
     }
+
+    if (m_snapshot) {
+        m_snapshot->save();
+    }
+
+    m_snapshot.reset(new VNotebookSnapshot(m_path));
 }
 
 bool VNotebook::readConfigNotebook()
 {
+    m_configRead = true;
+
     QJsonObject configJson = VConfigManager::readDirectoryConfig(m_path);
     if (configJson.isEmpty()) {
         qWarning() << "fail to read notebook configuration" << m_path;
@@ -52,6 +130,9 @@ bool VNotebook::readConfigNotebook()
         m_imageFolder = it.value().toString();
     }
 
+    // [content_addressed_images] section.
+    m_contentAddressedImages = configJson.value(DirConfig::c_contentAddressedImages).toBool(false);
+
     // [recycle_bin_folder] section.
     it = configJson.find(DirConfig::c_recycleBinFolder);
     if (it != configJson.end()) {
@@ -82,13 +163,27 @@ bool VNotebook::readConfigNotebook()
     return true;
 }
 
+void VNotebook::ensureConfigRead() const
+{
+    if (!m_configRead) {
+        const_cast<VNotebook *>(this)->readConfigNotebook();
+    }
+}
+
 QJsonObject VNotebook::toConfigJsonNotebook() const
 {
+    ensureConfigRead();
+
     QJsonObject json;
 
     // [image_folder] section.
     json[DirConfig::c_imageFolder] = m_imageFolder;
 
+    // [content_addressed_images] section.
+    if (m_contentAddressedImages) {
+        json[DirConfig::c_contentAddressedImages] = true;
+    }
+
     // [attachment_folder] section.
     json[DirConfig::c_attachmentFolder] = m_attachmentFolder;
 
@@ -122,6 +217,7 @@ QJsonObject VNotebook::toConfigJson() const
 
 bool VNotebook::writeToConfig() const
 {
+    m_snapshot->invalidate(m_path);
     return VConfigManager::writeDirectoryConfig(m_path, toConfigJson());
 }
 
@@ -139,17 +235,19 @@ bool VNotebook::writeConfigNotebook() const
         configJson[it.key()] = it.value();
     }
 
+    m_snapshot->invalidate(m_path);
     return VConfigManager::writeDirectoryConfig(m_path, configJson);
 }
 
 void VNotebook::close()
 {
     m_rootDir->close();
+    m_snapshot->save();
 }
 
 bool VNotebook::open()
 {
-    if (!m_valid) {
+    if (!isValid()) {
         return false;
     }
 
@@ -163,7 +261,19 @@ bool VNotebook::open()
         }
     }
 
-    return m_rootDir->open();
+    bool wasOpened = isOpened();
+    if (!m_rootDir->open()) {
+        return false;
+    }
+
+    // Purge when opened rather than at startup, which would read the
+    // configurations of all the notebooks.
+    if (!wasOpened
+        && (g_config->getRecycleBinMaxAgeDays() > 0 || g_config->getRecycleBinMaxSize() > 0)) {
+        VRecycleBin::purge(recycleBinPath);
+    }
+
+    return true;
 }
 
 VNotebook *VNotebook::createNotebook(const QString &p_name,
@@ -175,6 +285,9 @@ VNotebook *VNotebook::createNotebook(const QString &p_name,
 {
     VNotebook *nb = new VNotebook(p_name, p_path, p_parent);
 
+    // Configurations come from the arguments or are read explicitly.
+    nb->m_configRead = true;
+
     // If @p_imageFolder is empty, it will report global configured folder as
     // its image folder.
     nb->setImageFolder(p_imageFolder);
@@ -230,6 +343,8 @@ bool VNotebook::deleteNotebook(VNotebook *p_notebook, bool p_deleteFiles)
             VDirectory::deleteDirectory(dir, true);
         }
 
+        VRecycleBin::flush();
+
         // Delete the recycle bin.
         QDir recycleDir(p_notebook->getRecycleBinFolderPath());
         if (!recycleDir.removeRecursively()) {
@@ -239,6 +354,7 @@ bool VNotebook::deleteNotebook(VNotebook *p_notebook, bool p_deleteFiles)
         }
 
         // Delete the config file.
+        p_notebook->getSnapshot()->clear();
         if (!VConfigManager::deleteDirectoryConfig(p_notebook->getPath())) {
             ret = false;
             goto exit;
@@ -338,6 +454,7 @@ VDirectory *VNotebook::tryLoadDirectory(const QString &p_path)
 
 const QString &VNotebook::getImageFolder() const
 {
+    ensureConfigRead();
     if (m_imageFolder.isEmpty()) {
         return g_config->getImageFolder();
     } else {
@@ -347,21 +464,37 @@ const QString &VNotebook::getImageFolder() const
 
 void VNotebook::setImageFolder(const QString &p_imageFolder)
 {
+    ensureConfigRead();
     m_imageFolder = p_imageFolder;
 }
 
 const QString &VNotebook::getImageFolderConfig() const
 {
+    ensureConfigRead();
     return m_imageFolder;
 }
 
+bool VNotebook::isContentAddressedImages() const
+{
+    ensureConfigRead();
+    return m_contentAddressedImages;
+}
+
+void VNotebook::setContentAddressedImages(bool p_enabled)
+{
+    ensureConfigRead();
+    m_contentAddressedImages = p_enabled;
+}
+
 const QString &VNotebook::getAttachmentFolder() const
 {
+    ensureConfigRead();
     return m_attachmentFolder;
 }
 
 void VNotebook::setAttachmentFolder(const QString &p_attachmentFolder)
 {
+    ensureConfigRead();
     m_attachmentFolder = p_attachmentFolder;
 }
 
@@ -383,6 +516,7 @@ QDateTime VNotebook::getCreatedTimeUtc()
 
 QString VNotebook::getRecycleBinFolderPath() const
 {
+    ensureConfigRead();
     QFileInfo fi(m_recycleBinFolder);
     if (fi.isAbsolute()) {
         return m_recycleBinFolder;
@@ -445,6 +579,8 @@ bool VNotebook::addTag(const QString &p_tag)
 
 bool VNotebook::addTags(VDirectory *p_dir)
 {
+    ensureConfigRead();
+
     QStringList tags = p_dir->collectTags();
 
     for (auto const & tag : tags) {
@@ -464,8 +600,56 @@ bool VNotebook::addTags(VDirectory *p_dir)
     return true;
 }
 
+VTagIndex *VNotebook::fetchTagIndex()
+{
+    if (!m_tagIndex->isBuilt()) {
+        m_tagIndex->build(this);
+    }
+
+    return m_tagIndex;
+}
+
+void VNotebook::requestTagIndex()
+{
+    if (m_tagIndex->isBuilt() || m_tagIndexTask) {
+        return;
+    }
+
+    m_tagIndexTask = new TagIndexTask(this, m_snapshot, m_path, m_tagIndex->getRevision());
+    VTaskExecutor::inst()->start(m_tagIndexTask, VTaskExecutor::Maintenance);
+}
+
+void VNotebook::handleTagIndexCollected()
+{
+    Q_ASSERT(m_tagIndexTask);
+    TagIndexTask *task = m_tagIndexTask;
+    m_tagIndexTask = NULL;
+
+    bool built = m_tagIndex->build(task->tags(), task->revision());
+    delete task;
+
+    if (built) {
+        VTagUniverse::inst()->indexBuilt();
+    } else {
+        // Folders are changed meanwhile.
+        requestTagIndex();
+    }
+}
+
+QStringList VNotebook::getNotesOfTag(const QString &p_tag)
+{
+    QStringList notes = fetchTagIndex()->notesOfTag(p_tag);
+    QDir dir(m_path);
+    for (auto & note : notes) {
+        note = dir.filePath(note);
+    }
+
+    return notes;
+}
+
 void VNotebook::removeTag(const QString &p_tag)
 {
+    ensureConfigRead();
     if (p_tag.isEmpty() || m_tags.isEmpty()) {
         return;
     }
@@ -483,6 +667,7 @@ bool VNotebook::buildNotebook(const QString &p_name,
                               const QString &p_path,
                               const QString &p_imgFolder,
                               const QString &p_attachmentFolder,
+                              const QStringList &p_subDirs,
                               QString *p_errMsg)
 {
     VNotebook *nb = new VNotebook(p_name, p_path);
@@ -495,17 +680,11 @@ bool VNotebook::buildNotebook(const QString &p_name,
         nb->setAttachmentFolder(p_attachmentFolder);
     }
 
-    // Process all the folders.
+    // Configurations of the sub-folders are already written.
     QVector<VDirectory *> &subdirs = nb->getRootDir()->getSubDirs();
-    QDir rootDir(p_path);
-    QFileInfoList dirList = rootDir.entryInfoList(QDir::AllDirs | QDir::NoDotAndDotDot);
-    for (auto const & sub : dirList) {
-        VDirectory *dir = VDirectory::buildDirectory(sub.absoluteFilePath(),
-                                                     nb->getRootDir(),
-                                                     p_errMsg);
-        if (dir) {
-            subdirs.append(dir);
-        }
+    QDateTime dateTime = QDateTime::currentDateTimeUtc();
+    for (auto const & sub : p_subDirs) {
+        subdirs.append(new VDirectory(nb, nb->getRootDir(), sub, dateTime));
     }
 
     if (!nb->writeToConfig()) {
@@ -5,10 +5,14 @@
 #include <QString>
 #include <QDateTime>
 #include <QStringList>
+#include <QSharedPointer>
 
 class VDirectory;
+class VNotebookSnapshot;
 class VFile;
 class VNoteFile;
+class VTagIndex;
+class TagIndexTask;
 
 class VNotebook : public QObject
 {
@@ -54,6 +58,9 @@ public:
 
     VDirectory *getRootDir() const;
 
+    // Snapshot of the directory configurations to read them from.
+    const QSharedPointer<VNotebookSnapshot> &getSnapshot() const;
+
     void rename(const QString &p_name);
 
     const QStringList &getTags() const;
@@ -67,6 +74,19 @@ public:
 
     bool hasTag(const QString &p_tag) const;
 
+    // Paths of notes with tag @p_tag.
+    // Build the tag index on first call.
+    QStringList getNotesOfTag(const QString &p_tag);
+
+    VTagIndex *getTagIndex() const;
+
+    // The tag index built on first call.
+    VTagIndex *fetchTagIndex();
+
+    // Build the tag index in background if it is not built yet.
+    // VTagUniverse::indexesUpdated() will be emitted once built.
+    void requestTagIndex();
+
     static VNotebook *createNotebook(const QString &p_name,
                                      const QString &p_path,
                                      bool p_import,
@@ -83,6 +103,12 @@ public:
     // Return m_imageFolder.
     const QString &getImageFolderConfig() const;
 
+    // Whether images are named by their content, so identical images in the
+    // same image folder are stored once and shared by notes.
+    bool isContentAddressedImages() const;
+
+    void setContentAddressedImages(bool p_enabled);
+
     // Different from image folder. We could not change the attachment folder
     // of a notebook once it has been created.
     // Get the attachment folder for this notebook to use.
@@ -114,18 +140,26 @@ public:
 
     QList<QString> collectFiles();
 
-    // Create configuration files recursively to build a notebook based on
-    // a external directory.
+    // Write the notebook configuration file to build a notebook based on
+    // a external directory, whose sub-folders @p_subDirs are already built
+    // by VNoteImporter.
     static bool buildNotebook(const QString &p_name,
                               const QString &p_path,
                               const QString &p_imgFolder,
                               const QString &p_attachmentFolder,
+                              const QStringList &p_subDirs,
                               QString *p_errMsg = NULL);
 
+private slots:
+    void handleTagIndexCollected();
+
 private:
     // Serialize current instance to json.
     QJsonObject toConfigJson() const;
 
+    // Read the configurations on first use.
+    void ensureConfigRead() const;
+
     // Write current instance to config file.
     bool writeToConfig() const;
 
@@ -144,6 +178,9 @@ private:
     // Otherwise, VNote will use the global configured folder.
     QString m_imageFolder;
 
+    // Name images by their content and dedupe them.
+    bool m_contentAddressedImages;
+
     // Folder name to store attachments.
     // Should not be empty and changed once a notebook is created.
     QString m_attachmentFolder;
@@ -159,9 +196,22 @@ private:
     // Parent is NULL for root directory
     VDirectory *m_rootDir;
 
+    QSharedPointer<VNotebookSnapshot> m_snapshot;
+
+    // Tag -> notes.
+    VTagIndex *m_tagIndex;
+
+    // Collect the tags of notes for the tag index in background.
+    TagIndexTask *m_tagIndexTask;
+
     // Whether this notebook is valid.
     // Will set to true after readConfigNotebook().
     bool m_valid;
+
+    // Whether readConfigNotebook() has been called.
+    // Notebooks are created without reading their configurations, so
+    // notebooks not used do not touch the disk at startup.
+    bool m_configRead;
 };
 
 inline VDirectory *VNotebook::getRootDir() const
@@ -169,13 +219,20 @@ inline VDirectory *VNotebook::getRootDir() const
     return m_rootDir;
 }
 
+inline const QSharedPointer<VNotebookSnapshot> &VNotebook::getSnapshot() const
+{
+    return m_snapshot;
+}
+
 inline const QString &VNotebook::getRecycleBinFolder() const
 {
+    ensureConfigRead();
     return m_recycleBinFolder;
 }
 
 inline bool VNotebook::isValid() const
 {
+    ensureConfigRead();
     return m_valid;
 }
 
@@ -196,11 +253,18 @@ inline const QString &VNotebook::getName() const
 
 inline bool VNotebook::hasTag(const QString &p_tag) const
 {
+    ensureConfigRead();
     return m_tags.contains(p_tag);
 }
 
 inline const QStringList &VNotebook::getTags() const
 {
+    ensureConfigRead();
     return m_tags;
 }
+
+inline VTagIndex *VNotebook::getTagIndex() const
+{
+    return m_tagIndex;
+}
 #endif // VNOTEBOOK_H
@@ -0,0 +1,436 @@
+#include "vnotebookchecker.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QSet>
+#include <QUrl>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "vconstants.h"
+#include "vnotebook.h"
+#include "vnotebooksnapshot.h"
+#include "vnotefile.h"
+#include "vrecyclebin.h"
+#include "vmainwindow.h"
+#include "veditarea.h"
+#include "vedittab.h"
+#include "utils/vutils.h"
+
+extern VMainWindow *g_mainWin;
+
+// Max number of workers reading notes at the same time.
+#define MAX_CHECK_WORKERS 4
+
+// Notes read between two progress updates.
+#define PROGRESS_STEP 32
+
+class VNotebookCheckTask : public QRunnable
+{
+public:
+    explicit VNotebookCheckTask(VNotebookChecker *p_checker)
+        : m_checker(p_checker)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_checker->runJobs();
+    }
+
+private:
+    VNotebookChecker *m_checker;
+};
+
+
+// Local file @p_url of a note in @p_basePath points to.
+// Return empty if it is not a link to a local file.
+static QString localPathOfUrl(const QString &p_basePath, const QString &p_url)
+{
+    QString url = VUtils::purifyUrl(p_url);
+    int idx = url.indexOf('#');
+    if (idx > -1) {
+        url = url.left(idx);
+    }
+
+    if (url.isEmpty()) {
+        return QString();
+    }
+
+    QUrl qurl(url);
+    if (qurl.isLocalFile()) {
+        return QDir::cleanPath(qurl.toLocalFile());
+    }
+
+    if (!qurl.scheme().isEmpty() && !QDir::isAbsolutePath(url)) {
+        return QString();
+    }
+
+    QString path = QDir(p_basePath).absoluteFilePath(url);
+    if (!QFileInfo::exists(path)) {
+        QString decodedUrl(url);
+        VUtils::decodeUrl(decodedUrl);
+        QString decodedPath = QDir(p_basePath).absoluteFilePath(decodedUrl);
+        if (QFileInfo::exists(decodedPath)) {
+            path = decodedPath;
+        }
+    }
+
+    return QDir::cleanPath(path);
+}
+
+// Total bytes of the files in folder @p_path.
+static qint64 folderSize(const QString &p_path)
+{
+    qint64 size = 0;
+    QDirIterator it(p_path, QDir::Files | QDir::Hidden | QDir::NoSymLinks, QDirIterator::Subdirectories);
+    while (it.hasNext()) {
+        it.next();
+        size += it.fileInfo().size();
+    }
+
+    return size;
+}
+
+VNotebookChecker::VNotebookChecker(const VNotebook *p_notebook, QObject *p_parent)
+    : QThread(p_parent),
+      m_notebookPath(QDir::cleanPath(p_notebook->getPath())),
+      m_imageFolder(p_notebook->getImageFolder()),
+      m_attachmentFolder(p_notebook->getAttachmentFolder()),
+      m_snapshot(p_notebook->getSnapshot()),
+      m_stop(0),
+      m_incomplete(0),
+      m_nextJob(0),
+      m_done(0)
+{
+}
+
+void VNotebookChecker::stop()
+{
+    m_stop.store(1);
+}
+
+void VNotebookChecker::run()
+{
+    if (!listFolders() || isStopped()) {
+        return;
+    }
+
+    emit progressUpdated(0, m_jobs.size());
+
+    QThreadPool pool;
+    int nrWorkers = qBound(1, QThread::idealThreadCount(), MAX_CHECK_WORKERS);
+    nrWorkers = qMax(qMin(nrWorkers, m_jobs.size()), 1);
+    pool.setMaxThreadCount(nrWorkers);
+    for (int i = 0; i < nrWorkers; ++i) {
+        pool.start(new VNotebookCheckTask(this));
+    }
+
+    pool.waitForDone();
+
+    if (isStopped()) {
+        return;
+    }
+
+    // Links of the skipped folders and notes are unknown.
+    if (m_incomplete.load() == 0) {
+        findOrphans();
+    } else {
+        addError(tr("Skip looking for orphans since some folders or notes are not readable."));
+    }
+
+    emit progressUpdated(m_jobs.size(), m_jobs.size());
+
+    qDebug() << "notebook checked" << m_notebookPath << m_folders.size() << "folders"
+             << m_jobs.size() << "notes" << m_issues.size() << "issues";
+}
+
+bool VNotebookChecker::listFolders()
+{
+    if (!m_snapshot) {
+        addError(tr("Fail to read configuration of notebook %1.").arg(m_notebookPath));
+        return false;
+    }
+
+    QStringList paths(m_notebookPath);
+    while (!paths.isEmpty()) {
+        if (isStopped()) {
+            return false;
+        }
+
+        QString path = paths.takeLast();
+        QJsonObject configJson = m_snapshot->readDirectoryConfig(path);
+        if (configJson.isEmpty()) {
+            addError(tr("Skip folder %1 whose configuration is not readable.").arg(path));
+            m_incomplete.store(1);
+            continue;
+        }
+
+        QDir dir(path);
+        QJsonArray dirJson = configJson[DirConfig::c_subDirectories].toArray();
+        for (int i = 0; i < dirJson.size(); ++i) {
+            paths.append(dir.filePath(dirJson[i].toObject()[DirConfig::c_name].toString()));
+        }
+
+        FolderEntry folder;
+        folder.m_path = path;
+
+        QJsonArray fileJson = configJson[DirConfig::c_files].toArray();
+        for (int i = 0; i < fileJson.size(); ++i) {
+            QJsonObject item = fileJson[i].toObject();
+
+            NoteJob job;
+            job.m_filePath = dir.filePath(item[DirConfig::c_name].toString());
+
+            DocType type = VUtils::docTypeFromName(job.m_filePath);
+            job.m_markdown = type == DocType::Markdown;
+            if (type == DocType::Html) {
+                folder.m_hasHtml = true;
+            }
+
+            QString attachmentFolder = item[DirConfig::c_attachmentFolder].toString();
+            if (!attachmentFolder.isEmpty() && !m_attachmentFolder.isEmpty()) {
+                folder.m_attachmentFolders.append(attachmentFolder);
+                job.m_attachmentFolderPath = QDir(dir.filePath(m_attachmentFolder)).filePath(attachmentFolder);
+
+                QJsonArray attachmentJson = item[DirConfig::c_attachments].toArray();
+                for (int j = 0; j < attachmentJson.size(); ++j) {
+                    job.m_attachments << attachmentJson[j].toObject()[DirConfig::c_name].toString();
+                }
+            }
+
+            m_jobs.append(job);
+        }
+
+        m_folders.append(folder);
+    }
+
+    return true;
+}
+
+void VNotebookChecker::runJobs()
+{
+    while (!isStopped()) {
+        int idx = m_nextJob.fetchAndAddOrdered(1);
+        if (idx >= m_jobs.size()) {
+            break;
+        }
+
+        checkNote(m_jobs[idx]);
+        addDone();
+    }
+}
+
+void VNotebookChecker::checkNote(NoteJob &p_job)
+{
+    QFileInfo fi(p_job.m_filePath);
+    if (!fi.exists()) {
+        addError(tr("Note %1 does not exist.").arg(p_job.m_filePath));
+        return;
+    }
+
+    QDir attachmentDir(p_job.m_attachmentFolderPath);
+    for (auto const & name : p_job.m_attachments) {
+        if (!QFileInfo::exists(attachmentDir.filePath(name))) {
+            addIssue(Issue(Issue::MissingAttachment, p_job.m_filePath, name));
+        }
+    }
+
+    if (!p_job.m_markdown) {
+        return;
+    }
+
+    QString content = VUtils::readFileFromDisk(p_job.m_filePath);
+    if (content.isEmpty() && fi.size() > 0) {
+        addError(tr("Fail to read note %1.").arg(p_job.m_filePath));
+        m_incomplete.store(1);
+        return;
+    }
+
+    QString basePath = fi.absolutePath();
+
+    QVector<QString> urls = VUtils::fetchImageLinkUrls(content);
+    urls += VUtils::fetchLinkUrls(content);
+    for (auto const & url : urls) {
+        QString path = localPathOfUrl(basePath, url);
+        if (path.isEmpty()) {
+            continue;
+        }
+
+        if (!QFileInfo::exists(path)) {
+            addIssue(Issue(Issue::BrokenLink, p_job.m_filePath, url));
+            continue;
+        }
+
+        p_job.m_linkedPaths.append(VNoteFile::imagePathKey(path));
+    }
+}
+
+void VNotebookChecker::findOrphans()
+{
+    QSet<QString> linkedPaths;
+    for (auto const & job : m_jobs) {
+        for (auto const & path : job.m_linkedPaths) {
+            linkedPaths.insert(path);
+        }
+    }
+
+    // Image folders out of the notebook may be shared with others.
+    bool checkImages = !m_imageFolder.isEmpty() && QDir::isRelativePath(m_imageFolder);
+    QSet<QString> checkedImageFolders;
+    for (auto const & folder : m_folders) {
+        QDir dir(folder.m_path);
+        if (checkImages && !folder.m_hasHtml) {
+            QString imageFolderPath = QDir::cleanPath(dir.filePath(m_imageFolder));
+            QString key = VNoteFile::imagePathKey(imageFolderPath);
+            if (!checkedImageFolders.contains(key)) {
+                checkedImageFolders.insert(key);
+
+                QFileInfoList entries = QDir(imageFolderPath).entryInfoList(QDir::Files | QDir::Hidden,
+                                                                            QDir::Name);
+                for (auto const & entry : entries) {
+                    QString path = QDir::cleanPath(entry.absoluteFilePath());
+                    if (!linkedPaths.contains(VNoteFile::imagePathKey(path))) {
+                        Issue issue(Issue::OrphanImage, path);
+                        issue.m_size = entry.size();
+                        m_issues.append(issue);
+                    }
+                }
+            }
+        }
+
+        if (m_attachmentFolder.isEmpty() || !QDir::isRelativePath(m_attachmentFolder)) {
+            continue;
+        }
+
+        // Per-note attachment folders not owned by any note of this folder,
+        // and files in them not listed as attachments.
+        QString attachmentRoot = QDir::cleanPath(dir.filePath(m_attachmentFolder));
+        QFileInfoList entries = QDir(attachmentRoot).entryInfoList(QDir::Dirs | QDir::Files | QDir::Hidden | QDir::NoDotAndDotDot,
+                                                                   QDir::Name);
+        for (auto const & entry : entries) {
+            if (!entry.isDir() || !folder.m_attachmentFolders.contains(entry.fileName())) {
+                Issue issue(Issue::OrphanAttachment, QDir::cleanPath(entry.absoluteFilePath()));
+                issue.m_size = entry.isDir() ? folderSize(entry.absoluteFilePath()) : entry.size();
+                m_issues.append(issue);
+            }
+        }
+    }
+
+    for (auto const & job : m_jobs) {
+        if (job.m_attachmentFolderPath.isEmpty()) {
+            continue;
+        }
+
+        QFileInfoList entries = QDir(job.m_attachmentFolderPath).entryInfoList(QDir::Files | QDir::Hidden,
+                                                                               QDir::Name);
+        for (auto const & entry : entries) {
+            if (!job.m_attachments.contains(entry.fileName())) {
+                Issue issue(Issue::OrphanAttachment, QDir::cleanPath(entry.absoluteFilePath()));
+                issue.m_size = entry.size();
+                m_issues.append(issue);
+            }
+        }
+    }
+}
+
+int VNotebookChecker::countOf(Issue::Type p_type) const
+{
+    int cnt = 0;
+    for (auto const & issue : m_issues) {
+        if (issue.m_type == p_type) {
+            ++cnt;
+        }
+    }
+
+    return cnt;
+}
+
+int VNotebookChecker::recycleOrphans(VNotebook *p_notebook)
+{
+    // Images linked by the notes being edited, which may be unsaved.
+    QSet<QString> usedImages;
+    QVector<VEditTabInfo> tabs;
+    if (g_mainWin) {
+        tabs = g_mainWin->getEditArea()->getAllTabsInfo();
+    }
+
+    for (auto const & tab : tabs) {
+        VFile *file = tab.m_editTab ? tab.m_editTab->getFile() : NULL;
+        if (!file || file->getDocType() != DocType::Markdown) {
+            continue;
+        }
+
+        QVector<ImageLink> images = VUtils::fetchImagesFromMarkdownFile(file,
+                                                                        ImageLink::LocalRelativeInternal
+                                                                        | ImageLink::LocalRelativeExternal);
+        for (auto const & link : images) {
+            usedImages.insert(VNoteFile::imagePathKey(link.m_path));
+        }
+    }
+
+    QStringList paths;
+    for (auto const & issue : m_issues) {
+        if (issue.m_type == Issue::OrphanImage) {
+            if (usedImages.contains(VNoteFile::imagePathKey(issue.m_path))) {
+                continue;
+            }
+        } else if (issue.m_type != Issue::OrphanAttachment) {
+            continue;
+        }
+
+        if (QFileInfo::exists(issue.m_path)) {
+            paths.append(issue.m_path);
+        }
+    }
+
+    if (!paths.isEmpty()) {
+        VRecycleBin::recycle(p_notebook->getRecycleBinFolderPath(), paths);
+    }
+
+    return paths.size();
+}
+
+QString VNotebookChecker::typeToString(Issue::Type p_type)
+{
+    switch (p_type) {
+    case Issue::OrphanImage:
+        return "orphan_image";
+
+    case Issue::OrphanAttachment:
+        return "orphan_attachment";
+
+    case Issue::BrokenLink:
+        return "broken_link";
+
+    case Issue::MissingAttachment:
+        return "missing_attachment";
+    }
+
+    return QString();
+}
+
+void VNotebookChecker::addIssue(const Issue &p_issue)
+{
+    QMutexLocker locker(&m_mutex);
+    m_issues.append(p_issue);
+}
+
+void VNotebookChecker::addError(const QString &p_msg)
+{
+    QMutexLocker locker(&m_mutex);
+    VUtils::addErrMsg(&m_errMsg, p_msg);
+}
+
+void VNotebookChecker::addDone()
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_done;
+    if (m_done % PROGRESS_STEP == 0) {
+        emit progressUpdated(m_done, m_jobs.size());
+    }
+}
@@ -0,0 +1,212 @@
+#ifndef VNOTEBOOKCHECKER_H
+#define VNOTEBOOKCHECKER_H
+
+#include <QThread>
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QSharedPointer>
+#include <QMutex>
+#include <QAtomicInt>
+
+class VNotebook;
+class VNotebookSnapshot;
+
+// Check a notebook in background for images and attachments no longer used
+// by any note, and links of the notes to missing local files.
+// The folders are listed from the snapshot of the notebook, then the notes
+// are read by a bounded number of workers and their links are found by the
+// cheap scanners VUtils::fetchImageLinkUrls() and VUtils::fetchLinkUrls().
+// Image folders outside the notebook or used by HTML notes are not checked
+// for orphans.
+class VNotebookChecker : public QThread
+{
+    Q_OBJECT
+public:
+    struct Issue
+    {
+        enum Type
+        {
+            // File in an image folder not linked by any note.
+            OrphanImage = 0,
+
+            // File or folder in an attachment folder not owned by any note.
+            OrphanAttachment,
+
+            // Link of a note to a missing local file.
+            BrokenLink,
+
+            // Attachment of a note missing on disk.
+            MissingAttachment
+        };
+
+        Issue()
+            : m_type(Type::OrphanImage),
+              m_size(0)
+        {
+        }
+
+        Issue(Type p_type, const QString &p_path, const QString &p_target = QString())
+            : m_type(p_type),
+              m_path(p_path),
+              m_target(p_target),
+              m_size(0)
+        {
+        }
+
+        Type m_type;
+
+        // Path of the orphan, or the note containing the broken link or
+        // owning the missing attachment.
+        QString m_path;
+
+        // Url of the broken link or name of the missing attachment.
+        QString m_target;
+
+        // Bytes of the orphan.
+        qint64 m_size;
+    };
+
+    // Should be called in the GUI thread.
+    explicit VNotebookChecker(const VNotebook *p_notebook, QObject *p_parent = nullptr);
+
+    void stop();
+
+    bool isStopped() const;
+
+    // Valid after finished.
+    const QVector<Issue> &getIssues() const;
+
+    // Number of the notes read. Valid after finished.
+    int getNoteCount() const;
+
+    // Error messages of the skipped folders and notes.
+    // Valid after finished.
+    const QString &getErrorMessage() const;
+
+    int countOf(Issue::Type p_type) const;
+
+    // Move the orphans into the recycle bin of @p_notebook, except images
+    // linked by the content of the notes being edited.
+    // Return the number of the orphans recycled.
+    // Should be called in the GUI thread after finished.
+    int recycleOrphans(VNotebook *p_notebook);
+
+    static QString typeToString(Issue::Type p_type);
+
+signals:
+    // @p_done: number of notes read.
+    // @p_total: number of notes found.
+    void progressUpdated(int p_done, int p_total);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    friend class VNotebookCheckTask;
+
+    struct NoteJob
+    {
+        NoteJob()
+            : m_markdown(false)
+        {
+        }
+
+        QString m_filePath;
+
+        bool m_markdown;
+
+        // Empty if the note has no attachment folder.
+        QString m_attachmentFolderPath;
+
+        QStringList m_attachments;
+
+        // Keys of the local files linked by the note.
+        // Set by the workers.
+        QVector<QString> m_linkedPaths;
+    };
+
+    struct FolderEntry
+    {
+        FolderEntry()
+            : m_hasHtml(false)
+        {
+        }
+
+        QString m_path;
+
+        // Names of the per-note attachment folders owned by its notes.
+        QStringList m_attachmentFolders;
+
+        bool m_hasHtml;
+    };
+
+    // Read the configurations of all the folders from the snapshot.
+    bool listFolders();
+
+    // Run the jobs from @m_nextJob until none left.
+    // Called on the workers.
+    void runJobs();
+
+    void checkNote(NoteJob &p_job);
+
+    // Find the orphans once all the notes are read.
+    void findOrphans();
+
+    void addIssue(const Issue &p_issue);
+
+    void addError(const QString &p_msg);
+
+    void addDone();
+
+    QString m_notebookPath;
+
+    QString m_imageFolder;
+
+    QString m_attachmentFolder;
+
+    QSharedPointer<VNotebookSnapshot> m_snapshot;
+
+    QAtomicInt m_stop;
+
+    // Set when some folders or notes are skipped.
+    QAtomicInt m_incomplete;
+
+    QVector<FolderEntry> m_folders;
+
+    QVector<NoteJob> m_jobs;
+
+    // Index of the next job to run.
+    QAtomicInt m_nextJob;
+
+    // Protect @m_issues, @m_errMsg and @m_done.
+    QMutex m_mutex;
+
+    QVector<Issue> m_issues;
+
+    QString m_errMsg;
+
+    int m_done;
+};
+
+inline bool VNotebookChecker::isStopped() const
+{
+    return m_stop.load() == 1;
+}
+
+inline const QVector<VNotebookChecker::Issue> &VNotebookChecker::getIssues() const
+{
+    return m_issues;
+}
+
+inline int VNotebookChecker::getNoteCount() const
+{
+    return m_jobs.size();
+}
+
+inline const QString &VNotebookChecker::getErrorMessage() const
+{
+    return m_errMsg;
+}
+
+#endif // VNOTEBOOKCHECKER_H
@@ -9,6 +9,8 @@
 #include <QLabel>
 #include <QDesktopServices>
 #include <QUrl>
+#include <QProgressDialog>
+#include <QEventLoop>
 
 #include "vnotebook.h"
 #include "vconfigmanager.h"
@@ -24,6 +26,10 @@
 #include "vmainwindow.h"
 #include "utils/vimnavigationforwidget.h"
 #include "utils/viconutils.h"
+#include "vdirectoryprefetcher.h"
+#include "vnoteimporter.h"
+#include "vimagededuper.h"
+#include "vnotebookchecker.h"
 
 extern VConfigManager *g_config;
 
@@ -173,6 +179,9 @@ void VNotebookSelector::handleCurIndexChanged(int p_index)
     setToolTip(tooltip);
 
     emit curNotebookChanged(nb);
+
+    // The notebook is opened by the directory tree.
+    VDirectoryPrefetcher::inst()->prefetch(nb);
 }
 
 void VNotebookSelector::update()
@@ -206,11 +215,24 @@ bool VNotebookSelector::newNotebook()
         bool isImport = dialog.isImportExistingNotebook();
         if(dialog.isImportExternalProject()) {
             QString msg;
-            bool ret = VNotebook::buildNotebook(dialog.getNameInput(),
-                                                dialog.getPathInput(),
-                                                dialog.getImageFolder(),
-                                                dialog.getAttachmentFolder(),
-                                                &msg);
+            QStringList subDirs;
+            bool cancelled = false;
+            bool ret = buildExternalFolderInBackground(dialog.getPathInput(),
+                                                       subDirs,
+                                                       cancelled,
+                                                       &msg);
+            if (cancelled) {
+                return false;
+            }
+
+            if (ret) {
+                ret = VNotebook::buildNotebook(dialog.getNameInput(),
+                                               dialog.getPathInput(),
+                                               dialog.getImageFolder(),
+                                               dialog.getAttachmentFolder(),
+                                               subDirs,
+                                               &msg);
+            }
 
             QList<QString> suffixes = g_config->getDocSuffixes()[(int)DocType::Markdown];
             QString sufs;
@@ -374,11 +396,23 @@ void VNotebookSelector::editNotebookInfo()
             notebook->setImageFolder(imageFolder);
         }
 
+        bool dedupe = false;
+        bool contentImages = dialog.getContentAddressedImages();
+        if (contentImages != notebook->isContentAddressedImages()) {
+            configUpdated = true;
+            dedupe = contentImages;
+            notebook->setContentAddressedImages(contentImages);
+        }
+
         if (configUpdated) {
             updated = true;
             notebook->writeConfigNotebook();
         }
 
+        if (dedupe) {
+            dedupeImages(notebook);
+        }
+
         if (updated) {
             fillItem(items[0], notebook);
             emit notebookUpdated(notebook);
@@ -386,6 +420,131 @@ void VNotebookSelector::editNotebookInfo()
     }
 }
 
+void VNotebookSelector::dedupeImages(VNotebook *p_notebook)
+{
+    int ret = VUtils::showMessage(QMessageBox::Question,
+                                  tr("Deduplicate Images"),
+                                  tr("Merge identical images already in notebook "
+                                     "<span style=\"%1\">%2</span>?")
+                                    .arg(g_config->c_dataTextStyle)
+                                    .arg(p_notebook->getName()),
+                                  tr("Links of the notes will be updated and the duplicates "
+                                     "will be moved to the recycle bin of the notebook. "
+                                     "Notes being edited are skipped."),
+                                  QMessageBox::Ok | QMessageBox::Cancel,
+                                  QMessageBox::Ok,
+                                  this);
+    if (ret != QMessageBox::Ok) {
+        return;
+    }
+
+    QString msg;
+    VImageDeduper::Result result;
+    bool succeeded = VImageDeduper::dedupe(p_notebook, result, &msg);
+    QString info = tr("%1 duplicate images (%2 KB) removed and %3 notes updated.")
+                     .arg(result.m_nrImagesRemoved)
+                     .arg(result.m_bytesFreed / 1024)
+                     .arg(result.m_nrNotesUpdated);
+    VUtils::showMessage(succeeded ? QMessageBox::Information : QMessageBox::Warning,
+                        succeeded ? tr("Information") : tr("Warning"),
+                        info,
+                        msg,
+                        QMessageBox::Ok,
+                        QMessageBox::Ok,
+                        this);
+}
+
+void VNotebookSelector::checkNotebook(VNotebook *p_notebook)
+{
+    VNotebookChecker checker(p_notebook);
+    QProgressDialog proDlg(tr("Checking notes..."),
+                           tr("Abort"),
+                           0,
+                           1000,
+                           this);
+    proDlg.setWindowModality(Qt::WindowModal);
+    proDlg.setWindowTitle(tr("Check Notebook"));
+    proDlg.setMinimumDuration(500);
+
+    QEventLoop loop;
+    connect(&checker, &VNotebookChecker::progressUpdated,
+            &proDlg, [&proDlg](int p_done, int p_total) {
+                proDlg.setValue(p_done * 1000LL / qMax(p_total, 1));
+            });
+    connect(&proDlg, &QProgressDialog::canceled,
+            &checker, &VNotebookChecker::stop);
+    connect(&checker, &QThread::finished,
+            &loop, &QEventLoop::quit);
+
+    checker.start();
+    loop.exec();
+    checker.wait();
+    proDlg.reset();
+
+    if (checker.isStopped()) {
+        return;
+    }
+
+    int nrOrphans = checker.countOf(VNotebookChecker::Issue::OrphanImage)
+                    + checker.countOf(VNotebookChecker::Issue::OrphanAttachment);
+    qint64 orphanSize = 0;
+    QStringList details;
+    for (auto const & issue : checker.getIssues()) {
+        switch (issue.m_type) {
+        case VNotebookChecker::Issue::OrphanImage:
+        case VNotebookChecker::Issue::OrphanAttachment:
+            orphanSize += issue.m_size;
+            details << tr("Unused: %1").arg(issue.m_path);
+            break;
+
+        case VNotebookChecker::Issue::BrokenLink:
+            details << tr("Broken link in %1: %2").arg(issue.m_path).arg(issue.m_target);
+            break;
+
+        case VNotebookChecker::Issue::MissingAttachment:
+            details << tr("Missing attachment of %1: %2").arg(issue.m_path).arg(issue.m_target);
+            break;
+        }
+    }
+
+    QString text = tr("%1 notes checked: %2 unused images, %3 unused attachments (%4 KB), "
+                      "%5 broken links and %6 missing attachments.")
+                     .arg(checker.getNoteCount())
+                     .arg(checker.countOf(VNotebookChecker::Issue::OrphanImage))
+                     .arg(checker.countOf(VNotebookChecker::Issue::OrphanAttachment))
+                     .arg(orphanSize / 1024)
+                     .arg(checker.countOf(VNotebookChecker::Issue::BrokenLink))
+                     .arg(checker.countOf(VNotebookChecker::Issue::MissingAttachment));
+    if (nrOrphans > 0) {
+        text += "<br>" + tr("Move the unused images and attachments to the recycle bin of the notebook?");
+    }
+
+    // Show only the first ones to keep the message box in screen.
+    const int maxDetails = 30;
+    if (details.size() > maxDetails) {
+        int more = details.size() - maxDetails;
+        details.erase(details.begin() + maxDetails, details.end());
+        details << tr("... and %1 more").arg(more);
+    }
+
+    QString info = checker.getErrorMessage();
+    if (!details.isEmpty()) {
+        VUtils::addErrMsg(&info, details.join("\n"));
+    }
+
+    int ret = VUtils::showMessage(QMessageBox::Information,
+                                  tr("Check Notebook"),
+                                  text,
+                                  info,
+                                  nrOrphans > 0 ? QMessageBox::Ok | QMessageBox::Cancel : QMessageBox::Ok,
+                                  nrOrphans > 0 ? QMessageBox::Cancel : QMessageBox::Ok,
+                                  this);
+    if (nrOrphans > 0 && ret == QMessageBox::Ok) {
+        int nr = checker.recycleOrphans(p_notebook);
+        g_mainWin->showStatusMessage(tr("%1 unused files moved to the recycle bin").arg(nr));
+    }
+}
+
 void VNotebookSelector::addNotebookItem(const VNotebook *p_notebook)
 {
     QListWidgetItem *item = new QListWidgetItem(m_listWidget);
@@ -528,6 +687,20 @@ void VNotebookSelector::popupListContextMenuRequested(QPoint p_pos)
     menu.addAction(openLocationAct);
 
     if (nb->isValid()) {
+        QAction *checkAct = new QAction(tr("&Check Notebook"), &menu);
+        checkAct->setToolTip(tr("Find unused images and attachments, and links to missing files"));
+        connect(checkAct, &QAction::triggered,
+                this, [this]() {
+                    QList<QListWidgetItem *> items = this->m_listWidget->selectedItems();
+                    if (items.isEmpty()) {
+                        return;
+                    }
+
+                    Q_ASSERT(items.size() == 1);
+                    checkNotebook(getNotebook(items[0]));
+                });
+        menu.addAction(checkAct);
+
         QAction *notebookInfoAct = new QAction(VIconUtils::menuIcon(":/resources/icons/notebook_info.svg"),
                                                tr("&Info (Rename)"),
                                                &menu);
@@ -680,3 +853,40 @@ VNotebook *VNotebookSelector::currentNotebook() const
 {
     return getNotebook(currentIndex());
 }
+
+bool VNotebookSelector::buildExternalFolderInBackground(const QString &p_path,
+                                                        QStringList &p_subDirs,
+                                                        bool &p_cancelled,
+                                                        QString *p_errMsg)
+{
+    VNoteImporter importer(p_path);
+    QProgressDialog proDlg(tr("Scanning folders..."),
+                           tr("Abort"),
+                           0,
+                           1000,
+                           this);
+    proDlg.setWindowModality(Qt::WindowModal);
+    proDlg.setWindowTitle(tr("Add Notebook"));
+    proDlg.setMinimumDuration(500);
+
+    QEventLoop loop;
+    connect(&importer, &VNoteImporter::progressUpdated,
+            &proDlg, [&proDlg](int p_done, int p_total) {
+                proDlg.setValue(p_done * 1000LL / qMax(p_total, 1));
+            });
+    connect(&proDlg, &QProgressDialog::canceled,
+            &importer, &VNoteImporter::stop);
+    connect(&importer, &QThread::finished,
+            &loop, &QEventLoop::quit);
+
+    importer.start();
+    loop.exec();
+    importer.wait();
+
+    p_cancelled = importer.isStopped();
+    if (!importer.getErrorMessage().isEmpty()) {
+        VUtils::addErrMsg(p_errMsg, importer.getErrorMessage());
+    }
+    p_subDirs = importer.getRootSubDirectories();
+    return importer.isSucceeded();
+}
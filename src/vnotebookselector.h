@@ -86,6 +86,14 @@ private:
     // Add an item corresponding to @p_notebook to combo box.
     void addNotebookItem(const VNotebook *p_notebook);
 
+    // Ask to merge the identical images of @p_notebook, which just turns to
+    // name images by content.
+    void dedupeImages(VNotebook *p_notebook);
+
+    // Look for unused images and attachments and broken links of @p_notebook
+    // in background, and offer to recycle the unused ones.
+    void checkNotebook(VNotebook *p_notebook);
+
     void fillItem(QListWidgetItem *p_item, const VNotebook *p_notebook) const;
 
     // Insert "Add Notebook" item to combo box.
@@ -103,6 +111,14 @@ private:
 
     bool handlePopupKeyPress(QKeyEvent *p_event);
 
+    // Build the configurations of the external folder @p_path in background
+    // with progress. Set @p_subDirs to the sub-folders built.
+    // Set @p_cancelled if user cancels it.
+    bool buildExternalFolderInBackground(const QString &p_path,
+                                         QStringList &p_subDirs,
+                                         bool &p_cancelled,
+                                         QString *p_errMsg);
+
     QVector<VNotebook *> &m_notebooks;
 
     QListWidget *m_listWidget;
@@ -0,0 +1,249 @@
+#include "vnotebooksnapshot.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QJsonDocument>
+#include <QCryptographicHash>
+
+#include "vconfigmanager.h"
+#include "vdirectoryconfigwriter.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Magic and version of the snapshot file.
+#define SNAPSHOT_FILE_MAGIC 0x564e5348
+#define SNAPSHOT_FILE_VERSION 2
+
+#define SNAPSHOT_FOLDER_NAME "notebook_snapshots"
+
+VNotebookSnapshot::VNotebookSnapshot(const QString &p_notebookPath)
+    : m_notebookPath(p_notebookPath),
+      m_loaded(false),
+      m_dirty(false)
+{
+}
+
+QJsonObject VNotebookSnapshot::readDirectoryConfig(const QString &p_path)
+{
+    QString configFile = VConfigManager::fetchDirConfigFilePath(p_path);
+    if (VDirectoryConfigWriter::isPending(configFile)) {
+        // The file on disk is out of date.
+        return VConfigManager::readDirectoryConfig(p_path);
+    }
+
+    QFileInfo info(configFile);
+    if (!info.exists()) {
+        qWarning() << "directory configuration file does not exist" << info.filePath();
+        return QJsonObject();
+    }
+
+    qint64 modified = info.lastModified().toMSecsSinceEpoch();
+    qint64 size = info.size();
+    QString key = entryKey(p_path);
+
+    {
+        QMutexLocker locker(&m_mutex);
+        load();
+
+        auto it = m_entries.constFind(key);
+        if (it != m_entries.constEnd()
+            && it.value().m_modified == modified
+            && it.value().m_size == size) {
+            QJsonObject json = QJsonDocument::fromJson(it.value().m_data).object();
+            if (!json.isEmpty()) {
+                return json;
+            }
+        }
+    }
+
+    // If the file changes after the stat, the entry will mismatch next time.
+    QJsonObject json = VConfigManager::readDirectoryConfig(p_path);
+    if (!json.isEmpty()) {
+        QMutexLocker locker(&m_mutex);
+        m_entries.insert(key, Entry(modified,
+                                    size,
+                                    QJsonDocument(json).toJson(QJsonDocument::Compact)));
+        m_dirty = true;
+    }
+
+    return json;
+}
+
+void VNotebookSnapshot::invalidate(const QString &p_path)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_entries.remove(entryKey(p_path)) > 0) {
+        m_dirty = true;
+    }
+}
+
+bool VNotebookSnapshot::readNoteCounts(const QString &p_filePath,
+                                       qint64 p_modified,
+                                       qint64 p_size,
+                                       VWordCountInfo &p_info)
+{
+    QMutexLocker locker(&m_mutex);
+    load();
+
+    auto it = m_notes.constFind(entryKey(p_filePath));
+    if (it == m_notes.constEnd()
+        || it.value().m_modified != p_modified
+        || it.value().m_size != p_size) {
+        return false;
+    }
+
+    const NoteEntry &entry = it.value();
+    p_info.m_mode = VWordCountInfo::Edit;
+    p_info.m_wordCount = entry.m_wordCount;
+    p_info.m_charWithoutSpacesCount = entry.m_charWithoutSpacesCount;
+    p_info.m_charWithSpacesCount = entry.m_charWithSpacesCount;
+    return true;
+}
+
+void VNotebookSnapshot::setNoteCounts(const QString &p_filePath,
+                                      qint64 p_modified,
+                                      qint64 p_size,
+                                      const VWordCountInfo &p_info)
+{
+    NoteEntry entry;
+    entry.m_modified = p_modified;
+    entry.m_size = p_size;
+    entry.m_wordCount = p_info.m_wordCount;
+    entry.m_charWithoutSpacesCount = p_info.m_charWithoutSpacesCount;
+    entry.m_charWithSpacesCount = p_info.m_charWithSpacesCount;
+
+    QMutexLocker locker(&m_mutex);
+    load();
+
+    m_notes.insert(entryKey(p_filePath), entry);
+    m_dirty = true;
+}
+
+void VNotebookSnapshot::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_entries.clear();
+    m_notes.clear();
+    m_loaded = true;
+    m_dirty = false;
+    QFile::remove(snapshotFilePath());
+}
+
+void VNotebookSnapshot::save()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_loaded || !m_dirty) {
+        return;
+    }
+
+    QString filePath = snapshotFilePath();
+    VUtils::makePath(VUtils::basePathFromPath(filePath));
+
+    QSaveFile file(filePath);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open notebook snapshot file to write" << filePath;
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    out << (quint32)SNAPSHOT_FILE_MAGIC << (quint32)SNAPSHOT_FILE_VERSION;
+    out << m_notebookPath;
+
+    out << (qint32)m_entries.size();
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        const Entry &entry = it.value();
+        out << it.key() << entry.m_modified << entry.m_size << entry.m_data;
+    }
+
+    out << (qint32)m_notes.size();
+    for (auto it = m_notes.constBegin(); it != m_notes.constEnd(); ++it) {
+        const NoteEntry &entry = it.value();
+        out << it.key() << entry.m_modified << entry.m_size
+            << entry.m_wordCount << entry.m_charWithoutSpacesCount << entry.m_charWithSpacesCount;
+    }
+
+    if (!file.commit()) {
+        qWarning() << "fail to write notebook snapshot file" << filePath;
+        return;
+    }
+
+    m_dirty = false;
+}
+
+void VNotebookSnapshot::load()
+{
+    if (m_loaded) {
+        return;
+    }
+
+    m_loaded = true;
+
+    QFile file(snapshotFilePath());
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0, version = 0;
+    QString notebookPath;
+    in >> magic >> version >> notebookPath;
+    if (magic != SNAPSHOT_FILE_MAGIC
+        || version != SNAPSHOT_FILE_VERSION
+        || notebookPath != m_notebookPath) {
+        qWarning() << "invalid notebook snapshot file" << file.fileName();
+        return;
+    }
+
+    qint32 nrEntries = 0;
+    in >> nrEntries;
+    for (int i = 0; i < nrEntries && !in.atEnd(); ++i) {
+        QString key;
+        Entry entry;
+        in >> key >> entry.m_modified >> entry.m_size >> entry.m_data;
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+
+        m_entries.insert(key, entry);
+    }
+
+    qint32 nrNotes = 0;
+    in >> nrNotes;
+    for (int i = 0; i < nrNotes && !in.atEnd(); ++i) {
+        QString key;
+        NoteEntry entry;
+        in >> key >> entry.m_modified >> entry.m_size
+           >> entry.m_wordCount >> entry.m_charWithoutSpacesCount >> entry.m_charWithSpacesCount;
+        if (in.status() != QDataStream::Ok) {
+            break;
+        }
+
+        m_notes.insert(key, entry);
+    }
+
+    qDebug() << "notebook snapshot loaded" << m_entries.size() << "entries"
+             << m_notes.size() << "notes" << m_notebookPath;
+}
+
+QString VNotebookSnapshot::entryKey(const QString &p_path) const
+{
+    return QDir(m_notebookPath).relativeFilePath(p_path);
+}
+
+QString VNotebookSnapshot::snapshotFilePath() const
+{
+    QByteArray hash = QCryptographicHash::hash(m_notebookPath.toUtf8(),
+                                               QCryptographicHash::Sha1).toHex();
+    QString folder = QDir(g_config->getConfigFolder()).filePath(SNAPSHOT_FOLDER_NAME);
+    return QDir(folder).filePath(QString::fromLatin1(hash));
+}
@@ -0,0 +1,121 @@
+#ifndef VNOTEBOOKSNAPSHOT_H
+#define VNOTEBOOKSNAPSHOT_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QJsonObject>
+
+#include "vwordcountinfo.h"
+
+// Consolidated snapshot of the directory configurations of a notebook, stored
+// in one file under the config folder and loaded in one read.
+// Each entry is validated by the modified time and size of the configuration
+// file of the directory, which remains the source of truth.
+// The word counts of the notes are kept as well, validated by the modified
+// time and size of the note file.
+// Thread-safe to be used by the search workers.
+class VNotebookSnapshot
+{
+public:
+    explicit VNotebookSnapshot(const QString &p_notebookPath);
+
+    // Read the configuration of directory @p_path of the notebook.
+    // Return an empty object if it fails.
+    QJsonObject readDirectoryConfig(const QString &p_path);
+
+    // Drop the entry of directory @p_path after its configuration changes.
+    void invalidate(const QString &p_path);
+
+    // Get the counts of note @p_filePath of modified time @p_modified and size
+    // @p_size. Return false if not cached or out of date.
+    bool readNoteCounts(const QString &p_filePath,
+                        qint64 p_modified,
+                        qint64 p_size,
+                        VWordCountInfo &p_info);
+
+    void setNoteCounts(const QString &p_filePath,
+                       qint64 p_modified,
+                       qint64 p_size,
+                       const VWordCountInfo &p_info);
+
+    // Drop all the entries and remove the snapshot file.
+    void clear();
+
+    // Write the snapshot to disk if changed.
+    void save();
+
+private:
+    struct Entry
+    {
+        Entry()
+            : m_modified(0),
+              m_size(0)
+        {
+        }
+
+        Entry(qint64 p_modified, qint64 p_size, const QByteArray &p_data)
+            : m_modified(p_modified),
+              m_size(p_size),
+              m_data(p_data)
+        {
+        }
+
+        // Msecs since epoch of the configuration file.
+        qint64 m_modified;
+
+        qint64 m_size;
+
+        // Compact JSON.
+        QByteArray m_data;
+    };
+
+    struct NoteEntry
+    {
+        NoteEntry()
+            : m_modified(0),
+              m_size(0),
+              m_wordCount(0),
+              m_charWithoutSpacesCount(0),
+              m_charWithSpacesCount(0)
+        {
+        }
+
+        // Msecs since epoch of the note file.
+        qint64 m_modified;
+
+        qint64 m_size;
+
+        qint32 m_wordCount;
+
+        qint32 m_charWithoutSpacesCount;
+
+        qint32 m_charWithSpacesCount;
+    };
+
+    // Load the snapshot from disk if not yet.
+    // Should be called with @m_mutex locked.
+    void load();
+
+    QString entryKey(const QString &p_path) const;
+
+    QString snapshotFilePath() const;
+
+    QString m_notebookPath;
+
+    bool m_loaded;
+
+    // Whether the entries differ from the snapshot on disk.
+    bool m_dirty;
+
+    // Path relative to the notebook -> entry.
+    QHash<QString, Entry> m_entries;
+
+    // Path of note relative to the notebook -> counts.
+    QHash<QString, NoteEntry> m_notes;
+
+    QMutex m_mutex;
+};
+
+#endif // VNOTEBOOKSNAPSHOT_H
@@ -0,0 +1,412 @@
+#include "vnotebookstatistics.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QRunnable>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QCoreApplication>
+
+#include "vnotebook.h"
+#include "vnotebooksnapshot.h"
+#include "vnotebookwatcher.h"
+#include "vwordcounter.h"
+#include "vmemorystats.h"
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
+
+// Scan the folders of a notebook, or one folder.
+class NotebookStatisticsTask : public QRunnable
+{
+public:
+    NotebookStatisticsTask(VNotebookStatistics *p_stats,
+                           const VNotebookStatistics::Scan &p_scan)
+        : m_stats(p_stats),
+          m_scan(p_scan)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (!m_scan.m_recursive) {
+            VNotebookStatistics::NoteList notes;
+            QStringList subfolders;
+            bool valid = VNotebookStatistics::scanFolder(m_scan, m_scan.m_dirPath, notes, subfolders);
+            m_stats->setFolderResult(m_scan, valid, notes, subfolders);
+            return;
+        }
+
+        QSharedPointer<VNotebookStatistics::Result> result(new VNotebookStatistics::Result());
+        result->m_scan = m_scan;
+
+        // Parents are visited before their children.
+        QStringList paths(m_scan.m_dirPath);
+        while (!paths.isEmpty()) {
+            QString path = paths.takeLast();
+            VNotebookStatistics::NoteList notes;
+            QStringList subfolders;
+            VNotebookStatistics::scanFolder(m_scan, path, notes, subfolders);
+
+            result->m_folders[path].m_subfolders = subfolders;
+            VNotebookStatistics::addFolderNotes(*result, path, notes, 1);
+            paths.append(subfolders);
+        }
+
+        qDebug() << "notebook statistics computed" << m_scan.m_notebookPath
+                 << result->m_folders.size() << "folders" << result->m_notes.size() << "notes";
+
+        // The statistics waits for all the tasks before destruction.
+        m_stats->setResult(m_scan, result);
+    }
+
+private:
+    VNotebookStatistics *m_stats;
+
+    VNotebookStatistics::Scan m_scan;
+};
+
+
+VNotebookStatistics::VNotebookStatistics(QObject *p_parent)
+    : QObject(p_parent),
+      m_generation(0)
+{
+    m_pool.setMaxThreadCount(1);
+
+    connect(VNotebookWatcher::inst(), &VNotebookWatcher::directoryContentChanged,
+            this, &VNotebookStatistics::handleDirectoryContentChanged);
+}
+
+VNotebookStatistics::~VNotebookStatistics()
+{
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+VNotebookStatistics *VNotebookStatistics::inst()
+{
+    static VNotebookStatistics *stats = new VNotebookStatistics(QCoreApplication::instance());
+    return stats;
+}
+
+bool VNotebookStatistics::fetchStatistics(const VNotebook *p_notebook,
+                                          const QString &p_dirPath,
+                                          VNoteStatistics &p_stats)
+{
+    QString path = p_notebook->getPath();
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_results.constFind(path);
+    if (it != m_results.constEnd()) {
+        if (!it.value()) {
+            return false;
+        }
+
+        // A new folder will be seen once its parent is scanned again.
+        auto folderIt = it.value()->m_folders.constFind(p_dirPath);
+        if (folderIt == it.value()->m_folders.constEnd()) {
+            return false;
+        }
+
+        p_stats = folderIt.value().m_total;
+        return true;
+    }
+
+    Scan scan;
+    scan.m_notebookPath = path;
+    scan.m_dirPath = path;
+    scan.m_attachmentFolder = p_notebook->getAttachmentFolder();
+    scan.m_snapshot = p_notebook->getSnapshot();
+    scan.m_generation = m_generation;
+    scan.m_recursive = true;
+
+    // Mark it as being computed.
+    m_results.insert(path, QSharedPointer<Result>());
+    locker.unlock();
+
+    m_pool.start(new NotebookStatisticsTask(this, scan));
+    return false;
+}
+
+void VNotebookStatistics::fileSaved(const VNotebook *p_notebook,
+                                    const QString &p_filePath,
+                                    const QString &p_content)
+{
+    if (!p_notebook || VUtils::docTypeFromName(p_filePath) != DocType::Markdown) {
+        return;
+    }
+
+    VWordCountInfo counts = VWordCounter::countText(p_content);
+
+    QFileInfo info(p_filePath);
+    p_notebook->getSnapshot()->setNoteCounts(p_filePath,
+                                             info.lastModified().toMSecsSinceEpoch(),
+                                             info.size(),
+                                             counts);
+
+    VNotebookStatistics *stats = inst();
+    {
+        QMutexLocker locker(&stats->m_mutex);
+        QSharedPointer<Result> result = stats->m_results.value(p_notebook->getPath());
+        if (!result) {
+            return;
+        }
+
+        // A new note will be seen once its folder is scanned again.
+        auto noteIt = result->m_notes.find(p_filePath);
+        if (noteIt == result->m_notes.end()) {
+            return;
+        }
+
+        VNoteStatistics delta;
+        delta.m_wordCount = counts.m_wordCount - noteIt.value().m_wordCount;
+        delta.m_charWithoutSpacesCount = counts.m_charWithoutSpacesCount
+                                         - noteIt.value().m_charWithoutSpacesCount;
+        delta.m_charWithSpacesCount = counts.m_charWithSpacesCount
+                                      - noteIt.value().m_charWithSpacesCount;
+
+        noteIt.value().add(delta);
+        addToFolders(*result, VUtils::basePathFromPath(p_filePath), delta, 1);
+    }
+
+    emit stats->statisticsUpdated(p_notebook->getPath());
+}
+
+QString VNotebookStatistics::toString(const VNoteStatistics &p_stats)
+{
+    return tr("%1 notes, %2 words, %3 characters (%4 without spaces), %5 attachments (%6)")
+             .arg(p_stats.m_noteCount)
+             .arg(p_stats.m_wordCount)
+             .arg(p_stats.m_charWithSpacesCount)
+             .arg(p_stats.m_charWithoutSpacesCount)
+             .arg(p_stats.m_attachmentCount)
+             .arg(VMemoryStats::bytesToString(p_stats.m_attachmentSize));
+}
+
+void VNotebookStatistics::handleDirectoryContentChanged(const QString &p_dirPath)
+{
+    QMutexLocker locker(&m_mutex);
+    for (auto it = m_results.begin(); it != m_results.end(); ++it) {
+        QString notebookPath = it.key();
+        if (p_dirPath != notebookPath && !p_dirPath.startsWith(notebookPath + '/')) {
+            continue;
+        }
+
+        if (!it.value()) {
+            // The task may have scanned the folder already.
+            invalidate(notebookPath);
+            return;
+        }
+
+        // Notes may be modified, added or removed, which is cheap to scan
+        // again since the counts of the unchanged notes are cached.
+        Scan scan = it.value()->m_scan;
+        scan.m_dirPath = p_dirPath;
+        scan.m_generation = m_generation;
+        scan.m_recursive = false;
+        locker.unlock();
+
+        m_pool.start(new NotebookStatisticsTask(this, scan));
+        return;
+    }
+}
+
+void VNotebookStatistics::handleResultReady(const QString &p_notebookPath)
+{
+    emit statisticsUpdated(p_notebookPath);
+}
+
+bool VNotebookStatistics::scanFolder(const Scan &p_scan,
+                                     const QString &p_dirPath,
+                                     NoteList &p_notes,
+                                     QStringList &p_subfolders)
+{
+    QJsonObject configJson = p_scan.m_snapshot->readDirectoryConfig(p_dirPath);
+    if (configJson.isEmpty()) {
+        return false;
+    }
+
+    QDir dir(p_dirPath);
+    QJsonArray dirJson = configJson[DirConfig::c_subDirectories].toArray();
+    for (int i = 0; i < dirJson.size(); ++i) {
+        p_subfolders.append(dir.filePath(dirJson[i].toObject()[DirConfig::c_name].toString()));
+    }
+
+    QJsonArray fileJson = configJson[DirConfig::c_files].toArray();
+    for (int i = 0; i < fileJson.size(); ++i) {
+        QJsonObject item = fileJson[i].toObject();
+
+        QString attachmentFolderPath;
+        QString attachmentFolder = item[DirConfig::c_attachmentFolder].toString();
+        if (!attachmentFolder.isEmpty() && !p_scan.m_attachmentFolder.isEmpty()) {
+            attachmentFolderPath = QDir(dir.filePath(p_scan.m_attachmentFolder)).filePath(attachmentFolder);
+        }
+
+        QStringList attachments;
+        QJsonArray attachmentJson = item[DirConfig::c_attachments].toArray();
+        for (int j = 0; j < attachmentJson.size(); ++j) {
+            attachments << attachmentJson[j].toObject()[DirConfig::c_name].toString();
+        }
+
+        QString filePath = dir.filePath(item[DirConfig::c_name].toString());
+        p_notes.append(qMakePair(filePath,
+                                 scanNote(p_scan, filePath, attachmentFolderPath, attachments)));
+    }
+
+    return true;
+}
+
+VNoteStatistics VNotebookStatistics::scanNote(const Scan &p_scan,
+                                              const QString &p_filePath,
+                                              const QString &p_attachmentFolderPath,
+                                              const QStringList &p_attachments)
+{
+    VNoteStatistics stats;
+    stats.m_noteCount = 1;
+
+    if (VUtils::docTypeFromName(p_filePath) == DocType::Markdown) {
+        QFileInfo info(p_filePath);
+        qint64 modified = info.lastModified().toMSecsSinceEpoch();
+        qint64 size = info.size();
+
+        VWordCountInfo counts;
+        bool cached = p_scan.m_snapshot->readNoteCounts(p_filePath, modified, size, counts);
+        if (!cached && info.exists() && VWordCounter::countFile(p_filePath, counts)) {
+            p_scan.m_snapshot->setNoteCounts(p_filePath, modified, size, counts);
+            cached = true;
+        }
+
+        if (cached) {
+            stats.m_wordCount = counts.m_wordCount;
+            stats.m_charWithoutSpacesCount = counts.m_charWithoutSpacesCount;
+            stats.m_charWithSpacesCount = counts.m_charWithSpacesCount;
+        }
+    }
+
+    if (!p_attachmentFolderPath.isEmpty()) {
+        QDir dir(p_attachmentFolderPath);
+        for (auto const & name : p_attachments) {
+            QFileInfo info(dir.filePath(name));
+            if (info.exists()) {
+                ++stats.m_attachmentCount;
+                stats.m_attachmentSize += info.size();
+            }
+        }
+    }
+
+    return stats;
+}
+
+void VNotebookStatistics::addFolderNotes(Result &p_result,
+                                         const QString &p_dirPath,
+                                         const NoteList &p_notes,
+                                         int p_sign)
+{
+    Folder &folder = p_result.m_folders[p_dirPath];
+    VNoteStatistics sum;
+    for (auto const & note : p_notes) {
+        sum.add(note.second);
+        if (p_sign > 0) {
+            p_result.m_notes.insert(note.first, note.second);
+            folder.m_notes.append(note.first);
+        } else {
+            p_result.m_notes.remove(note.first);
+        }
+    }
+
+    if (p_sign < 0) {
+        folder.m_notes.clear();
+    }
+
+    addToFolders(p_result, p_dirPath, sum, p_sign);
+}
+
+void VNotebookStatistics::addToFolders(Result &p_result,
+                                       const QString &p_dirPath,
+                                       const VNoteStatistics &p_stats,
+                                       int p_sign)
+{
+    QString path = p_dirPath;
+    while (true) {
+        auto it = p_result.m_folders.find(path);
+        if (it == p_result.m_folders.end()) {
+            break;
+        }
+
+        it.value().m_total.add(p_stats, p_sign);
+        if (path == p_result.m_scan.m_notebookPath) {
+            break;
+        }
+
+        path = VUtils::basePathFromPath(path);
+    }
+}
+
+void VNotebookStatistics::setResult(const Scan &p_scan, const QSharedPointer<Result> &p_result)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_results.find(p_scan.m_notebookPath);
+        if (it != m_results.end() && !it.value()) {
+            if (p_scan.m_generation == m_generation) {
+                it.value() = p_result;
+            } else {
+                // Outdated. Compute it again on next query.
+                m_results.erase(it);
+            }
+        }
+    }
+
+    // Notify even if it is dropped to let the views query again.
+
+    QMetaObject::invokeMethod(this,
+                              "handleResultReady",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, p_scan.m_notebookPath));
+}
+
+void VNotebookStatistics::setFolderResult(const Scan &p_scan,
+                                          bool p_valid,
+                                          const NoteList &p_notes,
+                                          const QStringList &p_subfolders)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        if (p_scan.m_generation != m_generation) {
+            return;
+        }
+
+        QSharedPointer<Result> result = m_results.value(p_scan.m_notebookPath);
+        if (!result) {
+            return;
+        }
+
+        auto folderIt = result->m_folders.find(p_scan.m_dirPath);
+        if (!p_valid
+            || folderIt == result->m_folders.end()
+            || folderIt.value().m_subfolders != p_subfolders) {
+            // Folders are added, removed or moved.
+            invalidate(p_scan.m_notebookPath);
+        } else {
+            NoteList oldNotes;
+            for (auto const & path : folderIt.value().m_notes) {
+                oldNotes.append(qMakePair(path, result->m_notes.value(path)));
+            }
+
+            addFolderNotes(*result, p_scan.m_dirPath, oldNotes, -1);
+            addFolderNotes(*result, p_scan.m_dirPath, p_notes, 1);
+        }
+    }
+
+    QMetaObject::invokeMethod(this,
+                              "handleResultReady",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, p_scan.m_notebookPath));
+}
+
+void VNotebookStatistics::invalidate(const QString &p_notebookPath)
+{
+    m_results.remove(p_notebookPath);
+    ++m_generation;
+}
@@ -0,0 +1,200 @@
+#ifndef VNOTEBOOKSTATISTICS_H
+#define VNOTEBOOKSTATISTICS_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QPair>
+#include <QHash>
+#include <QMutex>
+#include <QThreadPool>
+#include <QSharedPointer>
+
+class VNotebook;
+class VNotebookSnapshot;
+
+// Statistics of a note, or aggregated of the notes of a folder and its
+// subfolders.
+struct VNoteStatistics
+{
+    VNoteStatistics()
+        : m_noteCount(0),
+          m_wordCount(0),
+          m_charWithoutSpacesCount(0),
+          m_charWithSpacesCount(0),
+          m_attachmentCount(0),
+          m_attachmentSize(0)
+    {
+    }
+
+    // Add @p_other if @p_sign is 1 or subtract it if @p_sign is -1.
+    void add(const VNoteStatistics &p_other, int p_sign = 1)
+    {
+        m_noteCount += p_sign * p_other.m_noteCount;
+        m_wordCount += p_sign * p_other.m_wordCount;
+        m_charWithoutSpacesCount += p_sign * p_other.m_charWithoutSpacesCount;
+        m_charWithSpacesCount += p_sign * p_other.m_charWithSpacesCount;
+        m_attachmentCount += p_sign * p_other.m_attachmentCount;
+        m_attachmentSize += p_sign * p_other.m_attachmentSize;
+    }
+
+    int m_noteCount;
+
+    // Counts of Markdown notes only.
+    qint64 m_wordCount;
+
+    qint64 m_charWithoutSpacesCount;
+
+    qint64 m_charWithSpacesCount;
+
+    int m_attachmentCount;
+
+    // Bytes of the attachments.
+    qint64 m_attachmentSize;
+};
+
+
+// Statistics of the notes of notebooks, computed in the background.
+// The counts of each note are cached in the snapshot of the notebook by the
+// modified time of the note, so only new or changed notes are read again.
+// Statistics of a notebook are computed on the first query, updated on save,
+// and a folder is scanned again when its content changes.
+// Should be accessed only in the GUI thread except the statistics tasks.
+class VNotebookStatistics : public QObject
+{
+    Q_OBJECT
+public:
+    static VNotebookStatistics *inst();
+
+    ~VNotebookStatistics();
+
+    // Get the statistics of folder @p_dirPath of @p_notebook.
+    // Return false if not ready yet, and statisticsUpdated() will be emitted
+    // once computed.
+    bool fetchStatistics(const VNotebook *p_notebook,
+                         const QString &p_dirPath,
+                         VNoteStatistics &p_stats);
+
+    // Update the counts of note @p_filePath from the saved @p_content.
+    static void fileSaved(const VNotebook *p_notebook,
+                          const QString &p_filePath,
+                          const QString &p_content);
+
+    static QString toString(const VNoteStatistics &p_stats);
+
+signals:
+    void statisticsUpdated(const QString &p_notebookPath);
+
+private slots:
+    void handleDirectoryContentChanged(const QString &p_dirPath);
+
+    void handleResultReady(const QString &p_notebookPath);
+
+private:
+    friend class NotebookStatisticsTask;
+
+    // Notes of a folder and their statistics.
+    typedef QVector<QPair<QString, VNoteStatistics>> NoteList;
+
+    struct Folder
+    {
+        // Of the notes of this folder and its subfolders.
+        VNoteStatistics m_total;
+
+        // Paths of the notes directly in this folder.
+        QStringList m_notes;
+
+        // Paths of the subfolders.
+        QStringList m_subfolders;
+    };
+
+    // A task scanning a folder or the whole notebook.
+    struct Scan
+    {
+        Scan()
+            : m_generation(0),
+              m_recursive(false)
+        {
+        }
+
+        QString m_notebookPath;
+
+        QString m_dirPath;
+
+        QString m_attachmentFolder;
+
+        QSharedPointer<VNotebookSnapshot> m_snapshot;
+
+        int m_generation;
+
+        bool m_recursive;
+    };
+
+    // Statistics of all the notes of a notebook.
+    struct Result
+    {
+        // The scan of the whole notebook.
+        Scan m_scan;
+
+        // Path of note -> its statistics.
+        QHash<QString, VNoteStatistics> m_notes;
+
+        // Path of folder -> its statistics.
+        QHash<QString, Folder> m_folders;
+    };
+
+    explicit VNotebookStatistics(QObject *p_parent = nullptr);
+
+    // Scan the notes directly in folder @p_dirPath and list its subfolders.
+    // Return false if the configuration of the folder is not readable.
+    static bool scanFolder(const Scan &p_scan,
+                           const QString &p_dirPath,
+                           NoteList &p_notes,
+                           QStringList &p_subfolders);
+
+    // Statistics of note @p_filePath, reading it only if not cached.
+    static VNoteStatistics scanNote(const Scan &p_scan,
+                                    const QString &p_filePath,
+                                    const QString &p_attachmentFolderPath,
+                                    const QStringList &p_attachments);
+
+    // Add the notes of folder @p_dirPath to @p_result, or remove them from it
+    // if @p_sign is -1.
+    static void addFolderNotes(Result &p_result,
+                               const QString &p_dirPath,
+                               const NoteList &p_notes,
+                               int p_sign);
+
+    // Add @p_stats to folder @p_dirPath and its ancestors.
+    static void addToFolders(Result &p_result,
+                             const QString &p_dirPath,
+                             const VNoteStatistics &p_stats,
+                             int p_sign);
+
+    // Called by the tasks.
+    void setResult(const Scan &p_scan, const QSharedPointer<Result> &p_result);
+
+    // @p_valid: false if the folder could not be scanned.
+    void setFolderResult(const Scan &p_scan,
+                         bool p_valid,
+                         const NoteList &p_notes,
+                         const QStringList &p_subfolders);
+
+    // Drop the statistics of @p_notebookPath to compute it again.
+    // Should be called with @m_mutex locked.
+    void invalidate(const QString &p_notebookPath);
+
+    // Notebook path -> statistics. Null if it is being computed.
+    QHash<QString, QSharedPointer<Result>> m_results;
+
+    // Bumped to drop the results of the outdated tasks.
+    int m_generation;
+
+    // Protect @m_results and @m_generation.
+    QMutex m_mutex;
+
+    QThreadPool m_pool;
+};
+
+#endif // VNOTEBOOKSTATISTICS_H
@@ -0,0 +1,335 @@
+#include "vnotebookwatcher.h"
+
+#include <QDebug>
+#include <QFileSystemWatcher>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QTimer>
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QJsonObject>
+
+#include "vdirectory.h"
+#include "vnotebook.h"
+#include "vnotefile.h"
+#include "vnotebooksnapshot.h"
+#include "vtagindex.h"
+#include "vpathindex.h"
+#include "vdirectoryconfigwriter.h"
+#include "vsearchindex.h"
+#include "vsearch.h"
+#include "vconfigmanager.h"
+#include "vtaskexecutor.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Stay well below the default inotify limit shared with other applications.
+#define MAX_WATCHED_DIRECTORIES 4096
+
+// Quiet time in ms before handling a batch of events.
+#define BATCH_INTERVAL 1000
+
+// Max delay in ms of a batch under continuous events.
+#define MAX_BATCH_DELAY 5000
+
+// Return false if the configuration file of @p_dirPath does not exist.
+static bool statConfig(const QString &p_dirPath, qint64 &p_modified, qint64 &p_size)
+{
+    QFileInfo info(VConfigManager::fetchDirConfigFilePath(p_dirPath));
+    if (!info.exists()) {
+        p_modified = 0;
+        p_size = 0;
+        return false;
+    }
+
+    p_modified = info.lastModified().toMSecsSinceEpoch();
+    p_size = info.size();
+    return true;
+}
+
+// Stat and read the configurations of the changed directories in the pool.
+class ConfigReadTask : public QRunnable
+{
+public:
+    struct Item
+    {
+        Item()
+            : m_modified(0),
+              m_size(0),
+              m_statChanged(false),
+              m_changedByOthers(false)
+        {
+        }
+
+        // Watched path.
+        QString m_path;
+
+        QString m_dirPath;
+
+        // Stat of the configuration file, last seen and then updated.
+        qint64 m_modified;
+
+        qint64 m_size;
+
+        bool m_statChanged;
+
+        bool m_changedByOthers;
+
+        // Valid if m_changedByOthers.
+        QJsonObject m_configJson;
+    };
+
+    ConfigReadTask(VNotebookWatcher *p_watcher, const QVector<Item> &p_items)
+        : m_watcher(p_watcher),
+          m_items(p_items)
+    {
+        // Owned by the watcher.
+        setAutoDelete(false);
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        for (auto & item : m_items) {
+            QString configFile = VConfigManager::fetchDirConfigFilePath(item.m_dirPath);
+            if (VDirectoryConfigWriter::isPending(configFile)) {
+                // Our write is to come.
+                continue;
+            }
+
+            qint64 modified = 0, size = 0;
+            if (!statConfig(item.m_dirPath, modified, size)) {
+                // The folder is removed, which will be seen by its parent.
+                continue;
+            }
+
+            if (modified == item.m_modified && size == item.m_size) {
+                continue;
+            }
+
+            item.m_modified = modified;
+            item.m_size = size;
+            item.m_statChanged = true;
+            if (VDirectoryConfigWriter::isWrittenByUs(configFile, modified, size)) {
+                continue;
+            }
+
+            item.m_changedByOthers = true;
+            item.m_configJson = VUtils::readJsonFromDisk(configFile);
+        }
+
+        // The watcher waits for the task before destruction.
+        QMetaObject::invokeMethod(m_watcher, "handleConfigsRead", Qt::QueuedConnection);
+    }
+
+    const QVector<Item> &items() const
+    {
+        return m_items;
+    }
+
+private:
+    VNotebookWatcher *m_watcher;
+
+    QVector<Item> m_items;
+};
+
+
+VNotebookWatcher::VNotebookWatcher(QObject *p_parent)
+    : QObject(p_parent),
+      m_readTask(NULL)
+{
+    m_watcher = new QFileSystemWatcher(this);
+    connect(m_watcher, &QFileSystemWatcher::directoryChanged,
+            this, &VNotebookWatcher::handleDirectoryChanged);
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(BATCH_INTERVAL);
+    connect(m_timer, &QTimer::timeout,
+            this, &VNotebookWatcher::processChanges);
+}
+
+VNotebookWatcher::~VNotebookWatcher()
+{
+    if (m_readTask) {
+        if (!VTaskExecutor::inst()->cancel(m_readTask)) {
+            VTaskExecutor::inst()->waitForDone(VTaskExecutor::Maintenance);
+        }
+
+        delete m_readTask;
+        m_readTask = NULL;
+    }
+}
+
+VNotebookWatcher *VNotebookWatcher::inst()
+{
+    static VNotebookWatcher *watcher = new VNotebookWatcher(QCoreApplication::instance());
+    return watcher;
+}
+
+void VNotebookWatcher::watchDirectory(VDirectory *p_dir)
+{
+    if (!g_config->getWatchNotebookFolders() || m_pathOfDir.contains(p_dir)) {
+        return;
+    }
+
+    if (m_dirs.size() >= MAX_WATCHED_DIRECTORIES) {
+        qDebug() << "too many watched folders to watch" << p_dir->getName();
+        return;
+    }
+
+    QString path = p_dir->fetchPath();
+    WatchedDirectory info;
+    info.m_dir = p_dir;
+    statConfig(path, info.m_configModified, info.m_configSize);
+
+    if (!m_watcher->addPath(path)) {
+        qWarning() << "fail to watch folder" << path;
+        return;
+    }
+
+    m_dirs.insert(path, info);
+    m_pathOfDir.insert(p_dir, path);
+}
+
+void VNotebookWatcher::unwatchDirectory(VDirectory *p_dir)
+{
+    auto it = m_pathOfDir.find(p_dir);
+    if (it == m_pathOfDir.end()) {
+        return;
+    }
+
+    m_watcher->removePath(it.value());
+    m_dirs.remove(it.value());
+    m_changedPaths.remove(it.value());
+    m_pathOfDir.erase(it);
+}
+
+bool VNotebookWatcher::isWatching(const QString &p_dirPath) const
+{
+    return m_dirs.contains(p_dirPath);
+}
+
+void VNotebookWatcher::handleDirectoryChanged(const QString &p_path)
+{
+    if (!m_dirs.contains(p_path)) {
+        return;
+    }
+
+    if (m_changedPaths.isEmpty()) {
+        m_batchTimer.start();
+    }
+
+    m_changedPaths.insert(p_path);
+
+    // Wait for the events to settle, but not too long.
+    if (m_batchTimer.elapsed() < MAX_BATCH_DELAY || !m_timer->isActive()) {
+        m_timer->start();
+    }
+}
+
+void VNotebookWatcher::processChanges()
+{
+    if (m_readTask) {
+        // Handled after the last batch.
+        return;
+    }
+
+    QSet<QString> paths;
+    paths.swap(m_changedPaths);
+
+    QVector<ConfigReadTask::Item> items;
+    for (auto const & path : paths) {
+        auto it = m_dirs.find(path);
+        if (it == m_dirs.end()) {
+            continue;
+        }
+
+        emit directoryContentChanged(path);
+
+        VDirectory *dir = it.value().m_dir;
+        if (!dir || !dir->isOpened()) {
+            continue;
+        }
+
+        // Notes may be modified, added or removed.
+        QStringList files;
+        for (auto const & file : dir->getFiles()) {
+            files << file->fetchPath();
+        }
+
+        VSearchIndexManager::filesChangedOnDisk(dir->getNotebook(), files);
+        VSearchRefiner::notesChanged();
+
+        ConfigReadTask::Item item;
+        item.m_path = path;
+        item.m_dirPath = dir->fetchPath();
+        item.m_modified = it.value().m_configModified;
+        item.m_size = it.value().m_configSize;
+        items.append(item);
+    }
+
+    if (items.isEmpty()) {
+        return;
+    }
+
+    m_readTask = new ConfigReadTask(this, items);
+    VTaskExecutor::inst()->start(m_readTask, VTaskExecutor::Maintenance);
+}
+
+void VNotebookWatcher::handleConfigsRead()
+{
+    Q_ASSERT(m_readTask);
+    QVector<ConfigReadTask::Item> items = m_readTask->items();
+    delete m_readTask;
+    m_readTask = NULL;
+
+    // Emit after iterating since the views may close the directories.
+    QVector<QPointer<VDirectory>> changedDirs;
+    for (auto const & item : items) {
+        if (!item.m_statChanged) {
+            continue;
+        }
+
+        auto it = m_dirs.find(item.m_path);
+        if (it == m_dirs.end()) {
+            continue;
+        }
+
+        WatchedDirectory &info = it.value();
+        VDirectory *dir = info.m_dir;
+        if (!dir || !dir->isOpened()) {
+            continue;
+        }
+
+        info.m_configModified = item.m_modified;
+        info.m_configSize = item.m_size;
+        if (!item.m_changedByOthers) {
+            continue;
+        }
+
+        VNotebook *notebook = dir->getNotebook();
+        notebook->getSnapshot()->invalidate(item.m_dirPath);
+
+        if (!item.m_configJson.isEmpty()) {
+            VPathIndex::inst()->updateFolder(notebook, dir->fetchRelativePath(), item.m_configJson);
+
+            // A build in progress will be done again.
+            notebook->getTagIndex()->updateFolder(dir->fetchRelativePath(), item.m_configJson);
+        }
+
+        changedDirs.append(dir);
+    }
+
+    for (auto const & dir : changedDirs) {
+        if (dir && dir->isOpened()) {
+            qDebug() << "folder changed on disk" << dir->getName();
+            emit directoryChangedOnDisk(dir);
+        }
+    }
+
+    // Events during the reading.
+    if (!m_changedPaths.isEmpty() && !m_timer->isActive()) {
+        m_timer->start();
+    }
+}
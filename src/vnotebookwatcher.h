@@ -0,0 +1,94 @@
+#ifndef VNOTEBOOKWATCHER_H
+#define VNOTEBOOKWATCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QHash>
+#include <QSet>
+#include <QPointer>
+#include <QElapsedTimer>
+
+class QFileSystemWatcher;
+class QTimer;
+class VDirectory;
+class ConfigReadTask;
+
+// Watch the opened directories of notebooks for changes by others, like git
+// pulls and sync tools.
+// Only directories are watched to respect the limit of the OS. Events are
+// debounced and then mapped to the directories to refresh the search index and
+// the snapshot, and to tell the views to reload. The configurations are read
+// in the background.
+// Should be accessed only in the GUI thread.
+class VNotebookWatcher : public QObject
+{
+    Q_OBJECT
+public:
+    ~VNotebookWatcher();
+
+    static VNotebookWatcher *inst();
+
+    // Called after @p_dir is opened.
+    void watchDirectory(VDirectory *p_dir);
+
+    // Called before @p_dir is closed.
+    void unwatchDirectory(VDirectory *p_dir);
+
+    // Whether changes of the folder at @p_dirPath are watched.
+    bool isWatching(const QString &p_dirPath) const;
+
+signals:
+    // Files in the folder at @p_dirPath may be changed, by VNote or others.
+    void directoryContentChanged(const QString &p_dirPath);
+
+    // The configuration of opened directory @p_dir is changed by others.
+    void directoryChangedOnDisk(VDirectory *p_dir);
+
+private slots:
+    void handleDirectoryChanged(const QString &p_path);
+
+    void processChanges();
+
+    // Called when m_readTask finishes.
+    void handleConfigsRead();
+
+private:
+    struct WatchedDirectory
+    {
+        WatchedDirectory()
+            : m_configModified(0),
+              m_configSize(0)
+        {
+        }
+
+        QPointer<VDirectory> m_dir;
+
+        // Stat of the configuration file last seen.
+        qint64 m_configModified;
+
+        qint64 m_configSize;
+    };
+
+    explicit VNotebookWatcher(QObject *p_parent = nullptr);
+
+    QFileSystemWatcher *m_watcher;
+
+    // Watched path -> directory.
+    QHash<QString, WatchedDirectory> m_dirs;
+
+    // Directory -> watched path, which may differ from its path after renaming.
+    QHash<const VDirectory *, QString> m_pathOfDir;
+
+    // Changed paths to process in one batch.
+    QSet<QString> m_changedPaths;
+
+    QTimer *m_timer;
+
+    // Started at the first event of a batch.
+    QElapsedTimer m_batchTimer;
+
+    // Reading the configurations of the last batch.
+    ConfigReadTask *m_readTask;
+};
+
+#endif // VNOTEBOOKWATCHER_H
@@ -6,9 +6,18 @@
 #include <QFileInfo>
 #include <QJsonObject>
 #include <QJsonArray>
+#include <QHash>
 #include <QDebug>
 
 #include "vdirectory.h"
+#include "vsearchindex.h"
+#include "vsearch.h"
+#include "vnotemetadatastore.h"
+#include "utils/vfilecopier.h"
+#include "vtagindex.h"
+#include "vpathindex.h"
+#include "vrecyclebin.h"
+#include "vnotebookstatistics.h"
 
 VNoteFile::VNoteFile(VDirectory *p_directory,
                      const QString &p_name,
@@ -16,7 +25,9 @@ VNoteFile::VNoteFile(VDirectory *p_directory,
                      bool p_modifiable,
                      QDateTime p_createdTimeUtc,
                      QDateTime p_modifiedTimeUtc)
-    : VFile(p_directory, p_name, p_type, p_modifiable, p_createdTimeUtc, p_modifiedTimeUtc)
+    : VFile(p_directory, p_name, p_type, p_modifiable, p_createdTimeUtc, p_modifiedTimeUtc),
+      m_attachmentsDecoded(true),
+      m_tagsDecoded(true)
 {
 }
 
@@ -46,6 +57,11 @@ QString VNoteFile::getImageFolderInLink() const
     return getNotebook()->getImageFolder();
 }
 
+bool VNoteFile::useContentAddressedImages() const
+{
+    return getNotebook()->isContentAddressedImages();
+}
+
 void VNoteFile::setName(const QString &p_name)
 {
     m_name = p_name;
@@ -58,12 +74,14 @@ bool VNoteFile::rename(const QString &p_name)
     }
 
     QString oldName = m_name;
+    QString oldRelativePath = fetchRelativePath();
 
     VDirectory *dir = getDirectory();
     Q_ASSERT(dir);
 
     // Rename it in disk.
     QDir diskDir(dir->fetchPath());
+    VRecycleBin::waitFor(diskDir.filePath(p_name));
     if (!diskDir.rename(m_name, p_name)) {
         qWarning() << "fail to rename file" << m_name << "to" << p_name << "in disk";
         return false;
@@ -78,12 +96,24 @@ bool VNoteFile::rename(const QString &p_name)
         return false;
     }
 
+    dir->fileRenamed(this, oldName);
+
+    getNotebook()->getTagIndex()->moveNote(oldRelativePath, fetchRelativePath());
+    VPathIndex::inst()->moveEntry(getNotebook(), oldRelativePath, fetchRelativePath());
+
     // Can't not change doc type.
     Q_ASSERT(m_docType == DocType::Unknown
              || m_docType == VUtils::docTypeFromName(m_name));
 
     m_docType = VUtils::docTypeFromName(m_name);
 
+    VSearchIndexManager::fileRenamed(getNotebook(),
+                                     diskDir.filePath(oldName),
+                                     fetchPath());
+    VNoteMetadataStoreManager::fileRenamed(getNotebook(),
+                                           diskDir.filePath(oldName),
+                                           fetchPath());
+
     qDebug() << "file renamed from" << oldName << "to" << m_name;
     return true;
 }
@@ -129,56 +159,96 @@ VNoteFile *VNoteFile::fromJson(VDirectory *p_directory,
                                     p_json[DirConfig::c_name].toString(),
                                     p_type,
                                     p_modifiable,
-                                    QDateTime::fromString(p_json[DirConfig::c_createdTime].toString(),
-                                                          Qt::ISODate),
-                                    QDateTime::fromString(p_json[DirConfig::c_modifiedTime].toString(),
-                                                          Qt::ISODate));
+                                    QDateTime(),
+                                    QDateTime());
+
+    // Times, attachments and tags are decoded on first access.
+    file->m_createdTimeIso = p_json[DirConfig::c_createdTime].toString();
+    file->m_modifiedTimeIso = p_json[DirConfig::c_modifiedTime].toString();
+
+    file->m_json = p_json;
+    file->m_attachmentsDecoded = false;
+    file->m_tagsDecoded = false;
+
+    return file;
+}
+
+void VNoteFile::decodeAttachmentsFromJson() const
+{
+    Q_ASSERT(!m_attachmentsDecoded);
+    m_attachmentsDecoded = true;
 
     // Attachment Folder.
-    file->m_attachmentFolder = p_json[DirConfig::c_attachmentFolder].toString();
+    m_attachmentFolder = m_json[DirConfig::c_attachmentFolder].toString();
 
     // Attachments.
-    QJsonArray attachmentJson = p_json[DirConfig::c_attachments].toArray();
+    QJsonArray attachmentJson = m_json[DirConfig::c_attachments].toArray();
+    m_attachments.reserve(attachmentJson.size());
     for (int i = 0; i < attachmentJson.size(); ++i) {
         QJsonObject attachmentItem = attachmentJson[i].toObject();
-        file->m_attachments.push_back(VAttachment(attachmentItem[DirConfig::c_name].toString()));
+        m_attachments.push_back(VAttachment(attachmentItem[DirConfig::c_name].toString()));
     }
 
-    // Tags.
-    QJsonArray tagsJson = p_json[DirConfig::c_tags].toArray();
+    if (m_tagsDecoded) {
+        m_json = QJsonObject();
+    }
+}
+
+void VNoteFile::decodeTagsFromJson() const
+{
+    Q_ASSERT(!m_tagsDecoded);
+    m_tagsDecoded = true;
+
+    QJsonArray tagsJson = m_json[DirConfig::c_tags].toArray();
     for (int i = 0; i < tagsJson.size(); ++i) {
-        file->m_tags.append(tagsJson[i].toString());
+        m_tags.append(tagsJson[i].toString());
     }
 
-    return file;
+    if (m_attachmentsDecoded) {
+        m_json = QJsonObject();
+    }
 }
 
 QJsonObject VNoteFile::toConfigJson() const
 {
     QJsonObject item;
     item[DirConfig::c_name] = m_name;
-    item[DirConfig::c_createdTime] = m_createdTimeUtc.toString(Qt::ISODate);
-    item[DirConfig::c_modifiedTime] = m_modifiedTimeUtc.toString(Qt::ISODate);
-    item[DirConfig::c_attachmentFolder] = m_attachmentFolder;
 
-    // Attachments.
-    QJsonArray attachmentJson;
-    for (int i = 0; i < m_attachments.size(); ++i) {
-        const VAttachment &att = m_attachments[i];
-        QJsonObject attachmentItem;
-        attachmentItem[DirConfig::c_name] = att.m_name;
-        attachmentJson.append(attachmentItem);
-    }
+    // Copy the fields not decoded as they are.
+    item[DirConfig::c_createdTime] = m_createdTimeIso.isNull() ? m_createdTimeUtc.toString(Qt::ISODate)
+                                                               : m_createdTimeIso;
+    item[DirConfig::c_modifiedTime] = m_modifiedTimeIso.isNull() ? m_modifiedTimeUtc.toString(Qt::ISODate)
+                                                                 : m_modifiedTimeIso;
+
+    if (!m_attachmentsDecoded) {
+        item[DirConfig::c_attachmentFolder] = m_json[DirConfig::c_attachmentFolder].toString();
+        item[DirConfig::c_attachments] = m_json[DirConfig::c_attachments].toArray();
+    } else {
+        item[DirConfig::c_attachmentFolder] = m_attachmentFolder;
+
+        // Attachments.
+        QJsonArray attachmentJson;
+        for (int i = 0; i < m_attachments.size(); ++i) {
+            const VAttachment &att = m_attachments[i];
+            QJsonObject attachmentItem;
+            attachmentItem[DirConfig::c_name] = att.m_name;
+            attachmentJson.append(attachmentItem);
+        }
 
-    item[DirConfig::c_attachments] = attachmentJson;
+        item[DirConfig::c_attachments] = attachmentJson;
+    }
 
     // Tags.
-    QJsonArray tags;
-    for (auto const & tag : m_tags) {
-        tags.append(tag);
-    }
+    if (!m_tagsDecoded) {
+        item[DirConfig::c_tags] = m_json[DirConfig::c_tags].toArray();
+    } else {
+        QJsonArray tags;
+        for (auto const & tag : m_tags) {
+            tags.append(tag);
+        }
 
-    item[DirConfig::c_tags] = tags;
+        item[DirConfig::c_tags] = tags;
+    }
 
     return item;
 }
@@ -187,52 +257,71 @@ bool VNoteFile::deleteFile(QString *p_errMsg)
 {
     Q_ASSERT(!m_opened);
     Q_ASSERT(parent());
+    Q_UNUSED(p_errMsg);
 
-    bool ret = true;
+    decodeAttachments();
 
-    // Delete local images if it is Markdown.
+    // Local images if it is Markdown.
+    QStringList paths;
     if (m_docType == DocType::Markdown) {
-        if (!deleteInternalImages()) {
-            ret = false;
-            VUtils::addErrMsg(p_errMsg, tr("Fail to delete images of this note."));
+        paths = fetchInternalImagePaths();
+
+        // Keep the images shared with other notes.
+        QSet<QString> sharedImages = fetchImagesOfOtherNotes(QVector<VNoteFile *>() << this);
+        if (!sharedImages.isEmpty()) {
+            for (int i = paths.size() - 1; i >= 0; --i) {
+                if (sharedImages.contains(imagePathKey(paths[i]))) {
+                    paths.removeAt(i);
+                }
+            }
         }
     }
 
-    // Delete attachments.
-    if (!deleteAttachments()) {
-        ret = false;
-        VUtils::addErrMsg(p_errMsg, tr("Fail to delete attachments of this note."));
+    // Attachments.
+    QString attachmentFolderPath;
+    if (!m_attachments.isEmpty() && !m_attachmentFolder.isEmpty()) {
+        attachmentFolderPath = QDir(QDir(fetchBasePath()).filePath(getNotebook()->getAttachmentFolder()))
+                               .filePath(m_attachmentFolder);
+        QDir dir(attachmentFolderPath);
+        for (auto const & att : m_attachments) {
+            QString filePath = dir.filePath(att.m_name);
+            if (QFileInfo::exists(filePath)) {
+                paths.append(filePath);
+            }
+        }
+
+        m_attachments.clear();
     }
 
-    // Delete the file.
+    // The file. Failures are reported by VRecycleBin::deletionFailed().
     QString filePath = fetchPath();
-    if (VUtils::deleteFile(getNotebook(), filePath, false)) {
-        qDebug() << "deleted" << m_name << filePath;
-    } else {
-        ret = false;
-        VUtils::addErrMsg(p_errMsg, tr("Fail to delete the note file."));
-        qWarning() << "fail to delete" << m_name << filePath;
+    paths.append(filePath);
+    VRecycleBin::recycle(getNotebook()->getRecycleBinFolderPath(), paths);
+    if (!attachmentFolderPath.isEmpty()) {
+        VRecycleBin::removeEmptyDirectory(attachmentFolderPath);
     }
 
-    return ret;
+    VSearchIndexManager::fileDeleted(getNotebook(), filePath);
+    VNoteMetadataStoreManager::fileDeleted(getNotebook(), filePath);
+    qDebug() << "queued to delete" << m_name << filePath << "with" << paths.size() - 1 << "images and attachments";
+
+    return true;
 }
 
-bool VNoteFile::deleteInternalImages()
+QStringList VNoteFile::fetchInternalImagePaths()
 {
     Q_ASSERT(parent() && m_docType == DocType::Markdown);
 
     QVector<ImageLink> images = VUtils::fetchImagesFromMarkdownFile(this,
                                                                     ImageLink::LocalRelativeInternal);
-    int deleted = 0;
+    QStringList paths;
     for (int i = 0; i < images.size(); ++i) {
-        if (VUtils::deleteFile(getNotebook(), images[i].m_path, false)) {
-            ++deleted;
+        if (!paths.contains(images[i].m_path)) {
+            paths.append(images[i].m_path);
         }
     }
 
-    qDebug() << "delete" << deleted << "images for" << m_name << fetchPath();
-
-    return deleted == images.size();
+    return paths;
 }
 
 bool VNoteFile::addAttachment(const QString &p_file, QString *p_destFile)
@@ -267,8 +356,31 @@ bool VNoteFile::addAttachment(const QString &p_file, QString *p_destFile)
     return true;
 }
 
+bool VNoteFile::addAttachments(const QVector<QString> &p_names)
+{
+    decodeAttachments();
+
+    if (p_names.isEmpty()) {
+        return true;
+    }
+
+    for (auto const & name : p_names) {
+        m_attachments.push_back(VAttachment(name));
+    }
+
+    if (!getDirectory()->updateFileConfig(this)) {
+        qWarning() << "fail to update config of file" << m_name
+                   << "in directory" << fetchBasePath();
+        return false;
+    }
+
+    return true;
+}
+
 QString VNoteFile::fetchAttachmentFolderPath()
 {
+    decodeAttachments();
+
     QString folderPath = QDir(fetchBasePath()).filePath(getNotebook()->getAttachmentFolder());
     if (m_attachmentFolder.isEmpty()) {
         m_attachmentFolder = VUtils::getRandomFileName(folderPath);
@@ -287,6 +399,8 @@ QString VNoteFile::fetchAttachmentFolderPath()
 
 bool VNoteFile::deleteAttachments(bool p_omitMissing)
 {
+    decodeAttachments();
+
     if (m_attachments.isEmpty()) {
         return true;
     }
@@ -302,6 +416,8 @@ bool VNoteFile::deleteAttachments(bool p_omitMissing)
 bool VNoteFile::deleteAttachments(const QVector<QString> &p_names,
                                   bool p_omitMissing)
 {
+    decodeAttachments();
+
     if (p_names.isEmpty()) {
         return true;
     }
@@ -352,6 +468,8 @@ bool VNoteFile::deleteAttachments(const QVector<QString> &p_names,
 
 int VNoteFile::findAttachment(const QString &p_name, bool p_caseSensitive)
 {
+    decodeAttachments();
+
     const QString name = p_caseSensitive ? p_name : p_name.toLower();
     for (int i = 0; i < m_attachments.size(); ++i) {
         QString attaName = p_caseSensitive ? m_attachments[i].m_name
@@ -388,6 +506,8 @@ int VNoteFile::findAttachmentByPath(const QString &p_file, bool p_caseSensitive)
 
 bool VNoteFile::sortAttachments(const QVector<int> &p_sortedIdx)
 {
+    decodeAttachments();
+
     V_ASSERT(m_opened);
     V_ASSERT(p_sortedIdx.size() == m_attachments.size());
 
@@ -451,26 +571,43 @@ QVector<QString> VNoteFile::checkAttachments()
 
 bool VNoteFile::deleteFile(VNoteFile *p_file, QString *p_errMsg)
 {
-    Q_ASSERT(!p_file->isOpened());
+    return deleteFiles(QVector<VNoteFile *>(1, p_file), p_errMsg);
+}
 
+bool VNoteFile::deleteFiles(const QVector<VNoteFile *> &p_files, QString *p_errMsg)
+{
     bool ret = true;
-    QString name = p_file->getName();
-    QString path = p_file->fetchPath();
 
-    if (!p_file->deleteFile(p_errMsg)) {
-        qWarning() << "fail to delete file" << name << path;
-        ret = false;
+    // Update the configuration of each directory once.
+    QVector<VDirectory *> dirs;
+    QHash<VDirectory *, QVector<VNoteFile *>> filesOfDir;
+    for (auto file : p_files) {
+        Q_ASSERT(!file->isOpened());
+        if (!file->deleteFile(p_errMsg)) {
+            qWarning() << "fail to delete file" << file->getName() << file->fetchPath();
+            ret = false;
+        }
+
+        VDirectory *dir = file->getDirectory();
+        Q_ASSERT(dir);
+        auto it = filesOfDir.find(dir);
+        if (it == filesOfDir.end()) {
+            dirs.append(dir);
+            it = filesOfDir.insert(dir, QVector<VNoteFile *>());
+        }
+
+        it.value().append(file);
     }
 
-    VDirectory *dir = p_file->getDirectory();
-    Q_ASSERT(dir);
-    if (!dir->removeFile(p_file)) {
-        qWarning() << "fail to remove file from directory" << name << path;
-        VUtils::addErrMsg(p_errMsg, tr("Fail to remove the note from the folder configuration."));
-        ret = false;
+    for (auto dir : dirs) {
+        if (!dir->removeFiles(filesOfDir.value(dir))) {
+            qWarning() << "fail to remove files from directory" << dir->fetchPath();
+            VUtils::addErrMsg(p_errMsg, tr("Fail to remove the notes from the folder configuration."));
+            ret = false;
+        }
     }
 
-    delete p_file;
+    qDeleteAll(p_files);
 
     return ret;
 }
@@ -509,9 +646,13 @@ bool VNoteFile::copyFile(VDirectory *p_destDir,
 
     // Images to be copied.
     QVector<ImageLink> images;
+    QSet<QString> sharedImages;
     if (docType == DocType::Markdown) {
         images = VUtils::fetchImagesFromMarkdownFile(p_file,
                                                      ImageLink::LocalRelativeInternal);
+        if (p_isCut) {
+            sharedImages = fetchImagesOfOtherNotes(QVector<VNoteFile *>() << p_file);
+        }
     }
 
     // Attachments to be copied.
@@ -522,6 +663,7 @@ bool VNoteFile::copyFile(VDirectory *p_destDir,
     }
 
     // Copy the note file.
+    VRecycleBin::waitFor(destPath);
     if (!VUtils::copyFile(srcPath, destPath, p_isCut)) {
         VUtils::addErrMsg(p_errMsg, tr("Fail to %1 the note file.").arg(opStr));
         qWarning() << "fail to" << opStr << "the note file" << srcPath << "to" << destPath;
@@ -560,7 +702,9 @@ bool VNoteFile::copyFile(VDirectory *p_destDir,
                             destFile->fetchBasePath(),
                             p_isCut,
                             &nrImageCopied,
-                            p_errMsg)) {
+                            p_errMsg,
+                            false,
+                            sharedImages)) {
         ret = false;
     }
 
@@ -603,17 +747,213 @@ bool VNoteFile::copyFile(VDirectory *p_destDir,
     return ret;
 }
 
+bool VNoteFile::copyFiles(VDirectory *p_destDir,
+                          const QVector<VNoteFile *> &p_files,
+                          const QVector<QString> &p_destNames,
+                          bool p_isCut,
+                          int p_idx,
+                          QVector<VNoteFile *> &p_targetFiles,
+                          QString *p_errMsg)
+{
+    Q_ASSERT(p_files.size() == p_destNames.size());
+    p_targetFiles.clear();
+
+    if (!p_destDir->isOpened()) {
+        VUtils::addErrMsg(p_errMsg, tr("Fail to open target folder."));
+        return false;
+    }
+
+    QString opStr = p_isCut ? tr("cut") : tr("copy");
+    QDir destDir(p_destDir->fetchPath());
+
+    // Plan all the copies before touching the files.
+    QVector<VFileCopier::Job> noteJobs;
+    noteJobs.reserve(p_files.size());
+    QVector<ImageLink> images;
+    QVector<QString> attaFolderPaths(p_files.size());
+    for (int i = 0; i < p_files.size(); ++i) {
+        VNoteFile *file = p_files[i];
+        Q_ASSERT(file->getDirectory()->isOpened());
+        Q_ASSERT(file->getDocType() == VUtils::docTypeFromName(p_destNames[i]));
+
+        QString srcPath = QDir::cleanPath(file->fetchPath());
+        QString destPath = QDir::cleanPath(destDir.filePath(p_destNames[i]));
+        Q_ASSERT(!VUtils::equalPath(srcPath, destPath));
+        VRecycleBin::waitFor(destPath);
+        noteJobs.append(VFileCopier::Job(srcPath, destPath, p_isCut, false));
+
+        if (file->getDocType() == DocType::Markdown) {
+            images += VUtils::fetchImagesFromMarkdownFile(file,
+                                                          ImageLink::LocalRelativeInternal);
+        }
+
+        if (!file->getAttachmentFolder().isEmpty()) {
+            attaFolderPaths[i] = file->fetchAttachmentFolderPath();
+        }
+    }
+
+    // Images still used by the notes left behind could not be moved.
+    QSet<QString> sharedImages;
+    if (p_isCut) {
+        sharedImages = fetchImagesOfOtherNotes(p_files);
+    }
+
+    // Copy the note files on the pool and roll back all if any fails.
+    VFileCopier::copyFiles(noteJobs);
+    bool allCopied = true;
+    for (auto const & job : noteJobs) {
+        if (!job.m_succeeded) {
+            VUtils::addErrMsg(p_errMsg, tr("Fail to %1 the note file %2.")
+                                          .arg(opStr).arg(job.m_srcFile));
+            qWarning() << "fail to" << opStr << "the note file" << job.m_srcFile << "to" << job.m_destFile;
+            allCopied = false;
+        }
+    }
+
+    if (!allCopied) {
+        for (auto const & job : noteJobs) {
+            if (!job.m_succeeded) {
+                continue;
+            }
+
+            bool reverted = p_isCut ? VUtils::copyFile(job.m_destFile, job.m_srcFile, true)
+                                    : QFile::remove(job.m_destFile);
+            if (!reverted) {
+                VUtils::addErrMsg(p_errMsg, tr("Fail to roll back the note file %1. "
+                                               "Please manually maintain it.")
+                                              .arg(job.m_destFile));
+            }
+        }
+
+        return false;
+    }
+
+    // Write the configuration of each folder once in the end.
+    QVector<VDirectory *> dirs;
+    dirs.append(p_destDir);
+    for (auto file : p_files) {
+        if (!dirs.contains(file->getDirectory())) {
+            dirs.append(file->getDirectory());
+        }
+    }
+
+    for (auto dir : dirs) {
+        dir->beginConfigBatch();
+    }
+
+    bool ret = true;
+    int idx = p_idx;
+    QVector<int> copiedIndexes;
+    for (int i = 0; i < p_files.size(); ++i) {
+        VNoteFile *file = p_files[i];
+        VNoteFile *destFile = NULL;
+        if (p_isCut) {
+            file->getDirectory()->removeFile(file);
+            file->setName(p_destNames[i]);
+            if (p_destDir->addFile(file, idx)) {
+                destFile = file;
+            }
+        } else {
+            destFile = p_destDir->addFile(p_destNames[i], idx);
+            // Copy tags to this file.
+            if (destFile) {
+                const QStringList &tags = file->getTags();
+                for (auto const & tag : tags) {
+                    destFile->addTag(tag);
+                    destFile->getNotebook()->addTag(tag);
+                }
+            }
+        }
+
+        if (!destFile) {
+            VUtils::addErrMsg(p_errMsg, tr("Fail to add the note %1 to target folder's configuration.")
+                                          .arg(p_destNames[i]));
+            ret = false;
+            continue;
+        }
+
+        if (idx != -1) {
+            ++idx;
+        }
+
+        p_targetFiles.append(destFile);
+        copiedIndexes.append(i);
+    }
+
+    // Images shared by notes are copied only once.
+    int nrImageCopied = 0;
+    if (!copyInternalImages(images,
+                            p_destDir->fetchPath(),
+                            p_isCut,
+                            &nrImageCopied,
+                            p_errMsg,
+                            false,
+                            sharedImages)) {
+        ret = false;
+    }
+
+    // Copy attachment folders.
+    int nrAttachmentFolderCopied = 0;
+    for (int i = 0; i < copiedIndexes.size(); ++i) {
+        const QString &attaFolderPath = attaFolderPaths[copiedIndexes[i]];
+        if (attaFolderPath.isEmpty()) {
+            continue;
+        }
+
+        VNoteFile *srcFile = p_files[copiedIndexes[i]];
+        VNoteFile *destFile = p_targetFiles[i];
+        QString folderPath = destDir.filePath(destFile->getNotebook()->getAttachmentFolder());
+        QString attaFolder = VUtils::getDirNameWithSequence(folderPath,
+                                                            srcFile->getAttachmentFolder());
+        folderPath = QDir(folderPath).filePath(attaFolder);
+
+        if (!VUtils::copyDirectory(attaFolderPath, folderPath, p_isCut)) {
+            VUtils::addErrMsg(p_errMsg, tr("Fail to %1 attachments folder %2 to %3. "
+                                           "Please manually maintain it.")
+                                          .arg(opStr).arg(attaFolderPath).arg(folderPath));
+            QVector<VAttachment> emptyAttas;
+            destFile->setAttachments(emptyAttas);
+            ret = false;
+        } else {
+            ++nrAttachmentFolderCopied;
+
+            destFile->setAttachmentFolder(attaFolder);
+            if (!p_isCut) {
+                destFile->setAttachments(srcFile->getAttachments());
+            }
+        }
+    }
+
+    for (auto dir : dirs) {
+        if (!dir->endConfigBatch()) {
+            VUtils::addErrMsg(p_errMsg, tr("Fail to update configuration of folder %1.")
+                                          .arg(dir->fetchPath()));
+            ret = false;
+        }
+    }
+
+    qDebug() << "copyFiles:" << p_targetFiles.size() << "notes to" << p_destDir->getName()
+             << "copied_images:" << nrImageCopied
+             << "copied_attachments:" << nrAttachmentFolderCopied;
+
+    return ret;
+}
+
 bool VNoteFile::copyInternalImages(const QVector<ImageLink> &p_images,
                                    const QString &p_destDirPath,
                                    bool p_isCut,
                                    int *p_nrImageCopied,
-                                   QString *p_errMsg)
+                                   QString *p_errMsg,
+                                   bool p_sync,
+                                   const QSet<QString> &p_sharedImages)
 {
+    Q_ASSERT(!(p_isCut && p_sync));
     bool ret = true;
     QDir parentDir(p_destDirPath);
     QSet<QString> processedImages;
     QString opStr = p_isCut ? tr("cut") : tr("copy");
     int nrImageCopied = 0;
+    QVector<VFileCopier::Job> jobs;
     for (int i = 0; i < p_images.size(); ++i) {
         const ImageLink &link = p_images[i];
         if (processedImages.contains(link.m_path)) {
@@ -639,14 +979,21 @@ bool VNoteFile::copyInternalImages(const QVector<ImageLink> &p_images,
             continue;
         }
 
-        if (!VUtils::copyFile(link.m_path, destImagePath, p_isCut)) {
+        bool isCut = p_isCut && !p_sharedImages.contains(imagePathKey(link.m_path));
+        jobs.append(VFileCopier::Job(link.m_path, destImagePath, isCut, p_sync));
+    }
+
+    // Images shared by notes or already in the target are copied only once.
+    VFileCopier::copyFiles(jobs);
+    for (auto const & job : jobs) {
+        if (!job.m_succeeded) {
             VUtils::addErrMsg(p_errMsg, tr("Fail to %1 image %2 to %3. "
                                            "Please manually %1 it and modify the note.")
-                                          .arg(opStr).arg(link.m_path).arg(destImagePath));
+                                          .arg(opStr).arg(job.m_srcFile).arg(job.m_destFile));
             ret = false;
         } else {
             ++nrImageCopied;
-            qDebug() << opStr << "image" << link.m_path << "to" << destImagePath;
+            qDebug() << opStr << "image" << job.m_srcFile << "to" << job.m_destFile;
         }
     }
 
@@ -654,8 +1001,72 @@ bool VNoteFile::copyInternalImages(const QVector<ImageLink> &p_images,
     return ret;
 }
 
+QString VNoteFile::imagePathKey(const QString &p_path)
+{
+    QString key = QDir::cleanPath(p_path);
+#if defined(Q_OS_WIN)
+    key = key.toLower();
+#endif
+    return key;
+}
+
+QSet<QString> VNoteFile::fetchImagesOfOtherNotes(const QVector<VNoteFile *> &p_files)
+{
+    QSet<QString> images;
+
+    // Notes sharing an image folder may link the same images, named by content
+    // or not. A notebook with an absolute image folder shares it among all the
+    // folders, the same as VImageDeduper.
+    QSet<QString> folderKeys;
+    QVector<VDirectory *> dirs;
+    for (auto file : p_files) {
+        folderKeys.insert(imagePathKey(file->fetchImageFolderPath()));
+
+        VNotebook *notebook = file->getNotebook();
+        VDirectory *dir = QDir::isAbsolutePath(notebook->getImageFolder()) ? notebook->getRootDir()
+                                                                           : file->getDirectory();
+        if (!dirs.contains(dir)) {
+            dirs.append(dir);
+        }
+    }
+
+    for (int i = 0; i < dirs.size(); ++i) {
+        VDirectory *dir = dirs[i];
+        if (!dir->open()) {
+            qWarning() << "fail to open folder" << dir->fetchPath();
+            continue;
+        }
+
+        if (QDir::isAbsolutePath(dir->getNotebook()->getImageFolder())) {
+            for (auto subDir : dir->getSubDirs()) {
+                if (!dirs.contains(subDir)) {
+                    dirs.append(subDir);
+                }
+            }
+        }
+
+        for (auto file : dir->getFiles()) {
+            if (file->getDocType() != DocType::Markdown
+                || p_files.contains(file)
+                || !folderKeys.contains(imagePathKey(file->fetchImageFolderPath()))) {
+                continue;
+            }
+
+            QVector<ImageLink> links = VUtils::fetchImagesFromMarkdownFile(file,
+                                                                           ImageLink::LocalRelativeInternal);
+            for (auto const & link : links) {
+                images.insert(imagePathKey(link.m_path));
+            }
+        }
+    }
+
+    return images;
+}
+
 void VNoteFile::removeTag(const QString &p_tag)
 {
+    decodeTags();
+
     if (p_tag.isEmpty() || m_tags.isEmpty()) {
         return;
     }
@@ -666,6 +1077,8 @@ void VNoteFile::removeTag(const QString &p_tag)
             qWarning() << "fail to update config of file" << m_name
                        << "in directory" << fetchBasePath();
         }
+
+        getNotebook()->getTagIndex()->setNoteTags(fetchRelativePath(), m_tags);
     }
 }
 
@@ -683,18 +1096,25 @@ bool VNoteFile::addTag(const QString &p_tag)
         return false;
     }
 
+    getNotebook()->getTagIndex()->setNoteTags(fetchRelativePath(), m_tags);
     return true;
 }
 
-bool VNoteFile::save()
+bool VNoteFile::handleSaved(const QString &p_content)
 {
-    bool ret = VFile::save();
-    if (ret) {
-        if (!getDirectory()->updateFileConfig(this)) {
-            qWarning() << "fail to update config of file" << m_name
-                       << "in directory" << fetchBasePath();
-            ret = false;
-        }
+    bool ret = VFile::handleSaved(p_content);
+    VSearchRefiner::notesChanged();
+    VSearchIndexManager::fileSaved(getNotebook(), fetchPath(), p_content);
+    VNoteMetadataStoreManager::fileSaved(getNotebook(),
+                                         fetchPath(),
+                                         getModifiedTimeUtc().toMSecsSinceEpoch(),
+                                         p_content);
+    VNotebookStatistics::fileSaved(getNotebook(), fetchPath(), p_content);
+
+    if (!getDirectory()->updateFileConfig(this)) {
+        qWarning() << "fail to update config of file" << m_name
+                   << "in directory" << fetchBasePath();
+        ret = false;
     }
 
     return ret;
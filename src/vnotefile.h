@@ -3,6 +3,8 @@
 
 #include <QVector>
 #include <QString>
+#include <QSet>
+#include <QJsonObject>
 
 #include "vfile.h"
 #include "utils/vutils.h"
@@ -47,7 +49,7 @@ public:
 
     QString getImageFolderInLink() const Q_DECL_OVERRIDE;
 
-    bool save() Q_DECL_OVERRIDE;
+    bool useContentAddressedImages() const Q_DECL_OVERRIDE;
 
     // Set the name of this file.
     void setName(const QString &p_name);
@@ -82,6 +84,10 @@ public:
     // Add @p_file as an attachment to this note.
     bool addAttachment(const QString &p_file, QString *p_destFile = NULL);
 
+    // Add files @p_names already in the attachment folder as attachments
+    // with one update of the config.
+    bool addAttachments(const QVector<QString> &p_names);
+
     // Fetch attachment folder path.
     // Will create it if it does not exist.
     QString fetchAttachmentFolderPath();
@@ -131,6 +137,10 @@ public:
     // @p_errMsg: if not NULL, it will contain error message if this function fails.
     static bool deleteFile(VNoteFile *p_file, QString *p_errMsg = NULL);
 
+    // Delete files @p_files like deleteFile(), updating the configuration of
+    // each directory once. Files are moved into the recycle bin in background.
+    static bool deleteFiles(const QVector<VNoteFile *> &p_files, QString *p_errMsg = NULL);
+
     // Copy file @p_file to @p_destDir with new name @p_destName.
     // Returns a file representing the destination file after copy/cut.
     static bool copyFile(VDirectory *p_destDir,
@@ -141,59 +151,126 @@ public:
                          VNoteFile **p_targetFile,
                          QString *p_errMsg = NULL);
 
+    // Copy files @p_files to @p_destDir with new names @p_destNames as a whole.
+    // The note files are copied together and rolled back all if any of them
+    // fails, in which case false is returned and @p_targetFiles is empty.
+    // The configuration of each folder involved is written once.
+    // Returns false if some images or attachments fail to copy, too.
+    static bool copyFiles(VDirectory *p_destDir,
+                          const QVector<VNoteFile *> &p_files,
+                          const QVector<QString> &p_destNames,
+                          bool p_isCut,
+                          int p_idx,
+                          QVector<VNoteFile *> &p_targetFiles,
+                          QString *p_errMsg = NULL);
+
     // Copy images @p_images of a file to @p_destDirPath.
+    // @p_sync: overwrite existing images only if they differ.
+    // @p_sharedImages: keys of images still used by other notes, which are
+    // copied even if @p_isCut.
     static bool copyInternalImages(const QVector<ImageLink> &p_images,
                                    const QString &p_destDirPath,
                                    bool p_isCut,
                                    int *p_nrImageCopied,
-                                   QString *p_errMsg = NULL);
+                                   QString *p_errMsg = NULL,
+                                   bool p_sync = false,
+                                   const QSet<QString> &p_sharedImages = QSet<QString>());
+
+    // Keys of the internal images linked by the other notes sharing the image
+    // folders of @p_files, which should be kept when @p_files drop them.
+    static QSet<QString> fetchImagesOfOtherNotes(const QVector<VNoteFile *> &p_files);
+
+    // Key of image path @p_path in fetchImagesOfOtherNotes().
+    static QString imagePathKey(const QString &p_path);
+
+protected:
+    // Update the search index and the directory config.
+    bool handleSaved(const QString &p_content) Q_DECL_OVERRIDE;
 
 private:
-    // Delete internal images of this file.
-    // Return true only when all internal images were deleted successfully.
-    bool deleteInternalImages();
+    // Paths of the internal images of this file.
+    QStringList fetchInternalImagePaths();
 
-    // Delete this file in disk as well as all its images/attachments.
+    // Queue deleting this file in disk as well as all its images/attachments.
     bool deleteFile(QString *p_msg = NULL);
 
+    // Decode the attachment folder and attachments from m_json if not yet.
+    void decodeAttachments() const;
+
+    void decodeAttachmentsFromJson() const;
+
+    // Decode the tags from m_json if not yet.
+    void decodeTags() const;
+
+    void decodeTagsFromJson() const;
+
+    // Config of this file in the config of the directory, whose attachments
+    // and tags are decoded on first access.
+    // Folders with many notes mostly only need the names.
+    mutable QJsonObject m_json;
+
+    mutable bool m_attachmentsDecoded;
+
+    mutable bool m_tagsDecoded;
+
     // Folder under the attachment folder of the notebook.
     // Store all the attachments of current file.
-    QString m_attachmentFolder;
+    mutable QString m_attachmentFolder;
 
     // Attachments.
-    QVector<VAttachment> m_attachments;
+    mutable QVector<VAttachment> m_attachments;
 
     // Tags of this file.
-    QStringList m_tags;
+    mutable QStringList m_tags;
 };
 
+inline void VNoteFile::decodeAttachments() const
+{
+    if (!m_attachmentsDecoded) {
+        decodeAttachmentsFromJson();
+    }
+}
+
+inline void VNoteFile::decodeTags() const
+{
+    if (!m_tagsDecoded) {
+        decodeTagsFromJson();
+    }
+}
+
 inline const QString &VNoteFile::getAttachmentFolder() const
 {
+    decodeAttachments();
     return m_attachmentFolder;
 }
 
 inline void VNoteFile::setAttachmentFolder(const QString &p_folder)
 {
+    decodeAttachments();
     m_attachmentFolder = p_folder;
 }
 
 inline const QVector<VAttachment> &VNoteFile::getAttachments() const
 {
+    decodeAttachments();
     return m_attachments;
 }
 
 inline void VNoteFile::setAttachments(const QVector<VAttachment> &p_attas)
 {
+    decodeAttachments();
     m_attachments = p_attas;
 }
 
 inline const QStringList &VNoteFile::getTags() const
 {
+    decodeTags();
     return m_tags;
 }
 
 inline bool VNoteFile::hasTag(const QString &p_tag) const
 {
+    decodeTags();
     return m_tags.contains(p_tag);
 }
 #endif // VNOTEFILE_H
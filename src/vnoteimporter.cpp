@@ -0,0 +1,438 @@
+#include "vnoteimporter.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QRunnable>
+#include <QThreadPool>
+
+#include "vconfigmanager.h"
+#include "vconstants.h"
+#include "vdirectoryconfigwriter.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Max number of workers scanning folders or importing files at the same time.
+#define MAX_IMPORT_WORKERS 4
+
+// Folders scanned or files imported between two progress updates.
+#define PROGRESS_STEP 16
+
+class VNoteImportTask : public QRunnable
+{
+public:
+    explicit VNoteImportTask(VNoteImporter *p_importer)
+        : m_importer(p_importer)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_importer->runJobs();
+    }
+
+private:
+    VNoteImporter *m_importer;
+};
+
+
+// Configuration of a non-root folder with sub-folders @p_subDirs and notes @p_files.
+static QJsonObject dirConfigJson(const QStringList &p_subDirs,
+                                 const QStringList &p_files,
+                                 const QString &p_time)
+{
+    QJsonObject dirJson;
+    dirJson[DirConfig::c_version] = "1";
+    dirJson[DirConfig::c_createdTime] = p_time;
+
+    QJsonArray subDirs;
+    for (auto const & name : p_subDirs) {
+        QJsonObject item;
+        item[DirConfig::c_name] = name;
+        subDirs.append(item);
+    }
+
+    dirJson[DirConfig::c_subDirectories] = subDirs;
+
+    QJsonArray files;
+    for (auto const & name : p_files) {
+        QJsonObject item;
+        item[DirConfig::c_name] = name;
+        item[DirConfig::c_createdTime] = p_time;
+        item[DirConfig::c_modifiedTime] = p_time;
+        item[DirConfig::c_attachmentFolder] = QString();
+        item[DirConfig::c_attachments] = QJsonArray();
+        item[DirConfig::c_tags] = QJsonArray();
+        files.append(item);
+    }
+
+    dirJson[DirConfig::c_files] = files;
+
+    return dirJson;
+}
+
+// Replace the image link urls in @p_content according to @p_urls.
+// Only the urls within the parentheses of a link are touched.
+static void replaceImageUrls(QString &p_content, const QHash<QString, QString> &p_urls)
+{
+    for (auto it = p_urls.constBegin(); it != p_urls.constEnd(); ++it) {
+        const QString &oldUrl = it.key();
+        int pos = 0;
+        while ((pos = p_content.indexOf(oldUrl, pos)) != -1) {
+            int before = pos - 1;
+            while (before >= 0 && (p_content[before] == ' ' || p_content[before] == '\t')) {
+                --before;
+            }
+
+            int after = pos + oldUrl.size();
+            bool inLink = before >= 0 && p_content[before] == '('
+                          && after < p_content.size()
+                          && (p_content[after] == ')'
+                              || p_content[after] == ' '
+                              || p_content[after] == '\t');
+            if (inLink) {
+                p_content.replace(pos, oldUrl.size(), it.value());
+                pos += it.value().size();
+            } else {
+                pos = after;
+            }
+        }
+    }
+}
+
+VNoteImporter::VNoteImporter(const QString &p_rootDir, QObject *p_parent)
+    : QThread(p_parent),
+      m_mode(Mode::BuildNotebook),
+      m_rootDir(QDir::cleanPath(p_rootDir)),
+      m_stop(0),
+      m_succeeded(false),
+      m_nextJob(0),
+      m_jobEnd(0),
+      m_done(0),
+      m_total(0)
+{
+    QList<QString> suffixes = g_config->getDocSuffixes()[(int)DocType::Markdown];
+    for (auto const & suf : suffixes) {
+        m_filters << ("*." + suf);
+    }
+}
+
+VNoteImporter::VNoteImporter(const QStringList &p_files,
+                             const QString &p_destDir,
+                             const QString &p_imageFolder,
+                             QObject *p_parent)
+    : QThread(p_parent),
+      m_mode(Mode::ImportFiles),
+      m_srcFiles(p_files),
+      m_destDir(QDir::cleanPath(p_destDir)),
+      m_imageFolder(p_imageFolder),
+      m_stop(0),
+      m_succeeded(false),
+      m_nextJob(0),
+      m_jobEnd(0),
+      m_done(0),
+      m_total(0)
+{
+}
+
+void VNoteImporter::stop()
+{
+    m_stop.store(1);
+}
+
+void VNoteImporter::run()
+{
+    m_succeeded = false;
+
+    bool ret = m_mode == Mode::BuildNotebook ? buildNotebook() : importFiles();
+    m_succeeded = ret && !isStopped();
+}
+
+bool VNoteImporter::buildNotebook()
+{
+    if (!QFileInfo(m_rootDir).isDir()) {
+        addError(tr("Folder %1 does not exist.").arg(m_rootDir));
+        return false;
+    }
+
+    // Scan level by level so that the entries of one level are not touched
+    // by the workers when appending the next level.
+    m_dirs.append(DirEntry(m_rootDir, -1));
+    int begin = 0;
+    while (begin < m_dirs.size()) {
+        int end = m_dirs.size();
+        runJobsInPool(begin, end);
+        if (isStopped()) {
+            return false;
+        }
+
+        for (int i = begin; i < end; ++i) {
+            QDir dir(m_dirs[i].m_path);
+            const QStringList subDirs = m_dirs[i].m_subDirs;
+            for (auto const & name : subDirs) {
+                m_dirs.append(DirEntry(dir.filePath(name), i));
+            }
+        }
+
+        begin = end;
+    }
+
+    // Children always follow their parent, so walk backward to tell the
+    // folders containing notes recursively.
+    for (int i = m_dirs.size() - 1; i > 0; --i) {
+        DirEntry &entry = m_dirs[i];
+        if (!entry.m_files.isEmpty()) {
+            entry.m_kept = true;
+        }
+
+        if (entry.m_kept) {
+            m_dirs[entry.m_parent].m_kept = true;
+        } else {
+            addError(tr("Skip folder %1.").arg(entry.m_path));
+        }
+    }
+
+    QVector<QStringList> keptSubDirs(m_dirs.size());
+    for (int i = 1; i < m_dirs.size(); ++i) {
+        if (m_dirs[i].m_kept) {
+            keptSubDirs[m_dirs[i].m_parent].append(VUtils::directoryNameFromPath(m_dirs[i].m_path));
+        }
+    }
+
+    if (isStopped()) {
+        return false;
+    }
+
+    QString timeStr = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    for (int i = 1; i < m_dirs.size(); ++i) {
+        const DirEntry &entry = m_dirs[i];
+        if (entry.m_kept) {
+            VConfigManager::writeDirectoryConfig(entry.m_path,
+                                                 dirConfigJson(keptSubDirs[i],
+                                                               entry.m_files,
+                                                               timeStr));
+        }
+    }
+
+    VDirectoryConfigWriter::flush();
+
+    m_rootSubDirs = keptSubDirs[0];
+    return true;
+}
+
+bool VNoteImporter::importFiles()
+{
+    if (!QFileInfo(m_destDir).isDir()) {
+        addError(tr("Folder %1 does not exist.").arg(m_destDir));
+        return false;
+    }
+
+    // Pick the names of the notes ahead since the workers copy them at the
+    // same time.
+    QDir destDir(m_destDir);
+    QSet<QString> takenNames;
+    for (auto const & file : m_srcFiles) {
+        FileJob job;
+        job.m_srcFile = file;
+
+        QFileInfo fi(file);
+        job.m_name = fi.fileName();
+        if (VUtils::equalPath(m_destDir, fi.absolutePath())) {
+            job.m_copyNeeded = false;
+        } else {
+            job.m_name = VUtils::getFileNameWithSequence(m_destDir, job.m_name, true, takenNames);
+        }
+
+        takenNames.insert(job.m_name);
+        m_fileJobs.append(job);
+    }
+
+    runJobsInPool(0, m_fileJobs.size());
+
+    if (isStopped()) {
+        // Clean up what we have copied.
+        for (auto const & job : m_fileJobs) {
+            if (job.m_succeeded && job.m_copyNeeded) {
+                QFile::remove(destDir.filePath(job.m_name));
+            }
+        }
+
+        QDir imageDir(destDir.filePath(m_imageFolder));
+        for (auto const & name : m_relocatedImages) {
+            QFile::remove(imageDir.filePath(name));
+        }
+
+        return false;
+    }
+
+    for (auto const & job : m_fileJobs) {
+        if (job.m_succeeded) {
+            ImportedFile file;
+            file.m_srcFile = job.m_srcFile;
+            file.m_name = job.m_name;
+            m_importedFiles.append(file);
+        }
+    }
+
+    return m_importedFiles.size() == m_fileJobs.size();
+}
+
+void VNoteImporter::runJobsInPool(int p_begin, int p_end)
+{
+    if (p_begin >= p_end) {
+        return;
+    }
+
+    {
+        QMutexLocker locker(&m_mutex);
+        m_total = m_mode == Mode::BuildNotebook ? p_end : m_fileJobs.size();
+        emit progressUpdated(m_done, m_total);
+    }
+
+    m_nextJob.store(p_begin);
+    m_jobEnd = p_end;
+
+    QThreadPool pool;
+    int nrWorkers = qBound(1, QThread::idealThreadCount(), MAX_IMPORT_WORKERS);
+    nrWorkers = qMin(nrWorkers, p_end - p_begin);
+    pool.setMaxThreadCount(nrWorkers);
+    for (int i = 0; i < nrWorkers; ++i) {
+        pool.start(new VNoteImportTask(this));
+    }
+
+    pool.waitForDone();
+}
+
+void VNoteImporter::runJobs()
+{
+    while (!isStopped()) {
+        int idx = m_nextJob.fetchAndAddOrdered(1);
+        if (idx >= m_jobEnd) {
+            break;
+        }
+
+        if (m_mode == Mode::BuildNotebook) {
+            scanDirectory(m_dirs[idx]);
+        } else {
+            importFile(m_fileJobs[idx]);
+        }
+
+        addDone();
+    }
+}
+
+void VNoteImporter::scanDirectory(DirEntry &p_entry)
+{
+    QDir dir(p_entry.m_path);
+    p_entry.m_subDirs = dir.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
+
+    // Notes right in the root folder are not imported.
+    if (p_entry.m_parent != -1) {
+        p_entry.m_files = dir.entryList(m_filters, QDir::Files);
+    }
+}
+
+void VNoteImporter::importFile(FileJob &p_job)
+{
+    if (!p_job.m_copyNeeded) {
+        // Local images keep working in place.
+        p_job.m_succeeded = true;
+        return;
+    }
+
+    QString destFile = QDir(m_destDir).filePath(p_job.m_name);
+    QString content = VUtils::readFileFromDisk(p_job.m_srcFile);
+    QHash<QString, QString> newUrls;
+    for (auto const & url : VUtils::fetchImageLinkUrls(content)) {
+        if (newUrls.contains(url)) {
+            continue;
+        }
+
+        QString newUrl = relocateImage(p_job.m_srcFile, url);
+        if (!newUrl.isEmpty()) {
+            newUrls.insert(url, newUrl);
+        }
+    }
+
+    bool ret;
+    if (newUrls.isEmpty()) {
+        ret = VUtils::copyFile(p_job.m_srcFile, destFile, false);
+    } else {
+        replaceImageUrls(content, newUrls);
+        ret = VUtils::writeFileToDisk(destFile, content);
+    }
+
+    if (!ret) {
+        addError(tr("Fail to copy file %1 as %2.").arg(p_job.m_srcFile).arg(destFile));
+    }
+
+    p_job.m_succeeded = ret;
+}
+
+QString VNoteImporter::relocateImage(const QString &p_srcFile, const QString &p_url)
+{
+    QString url = VUtils::purifyUrl(p_url);
+    if (url.isEmpty() || !QDir::isRelativePath(url)) {
+        return QString();
+    }
+
+    QFileInfo info(QFileInfo(p_srcFile).absolutePath(), url);
+    if (!info.isFile() || !info.isNativePath()) {
+        return QString();
+    }
+
+    QString imagePath = QDir::cleanPath(info.absoluteFilePath());
+
+    // Images within the target folder need only a new relative url.
+    QString relativePath = QDir(m_destDir).relativeFilePath(imagePath);
+    if (!relativePath.startsWith("..")) {
+        return relativePath;
+    }
+
+    QString imageDir = QDir(m_destDir).filePath(m_imageFolder);
+    QString name;
+    bool copyNeeded = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_relocatedImages.constFind(imagePath);
+        if (it != m_relocatedImages.constEnd()) {
+            name = it.value();
+        } else {
+            if (m_relocatedImages.isEmpty() && !QDir().mkpath(imageDir)) {
+                VUtils::addErrMsg(&m_errMsg, tr("Fail to create image folder %1.").arg(imageDir));
+                return QString();
+            }
+
+            name = VUtils::getFileNameWithSequence(imageDir, info.fileName(), true, m_takenImageNames);
+            m_takenImageNames.insert(name);
+            m_relocatedImages.insert(imagePath, name);
+            copyNeeded = true;
+        }
+    }
+
+    if (copyNeeded && !VUtils::copyFile(imagePath, QDir(imageDir).filePath(name), false)) {
+        addError(tr("Fail to copy image %1 of file %2.").arg(imagePath).arg(p_srcFile));
+    }
+
+    return m_imageFolder + "/" + name;
+}
+
+void VNoteImporter::addError(const QString &p_msg)
+{
+    QMutexLocker locker(&m_mutex);
+    VUtils::addErrMsg(&m_errMsg, p_msg);
+}
+
+void VNoteImporter::addDone()
+{
+    QMutexLocker locker(&m_mutex);
+    ++m_done;
+    if (m_done % PROGRESS_STEP == 0 || m_done == m_total) {
+        emit progressUpdated(m_done, m_total);
+    }
+}
@@ -0,0 +1,218 @@
+#ifndef VNOTEIMPORTER_H
+#define VNOTEIMPORTER_H
+
+#include <QThread>
+#include <QVector>
+#include <QString>
+#include <QStringList>
+#include <QSet>
+#include <QHash>
+#include <QMutex>
+#include <QAtomicInt>
+
+// Import external Markdown files into a notebook in background.
+// BuildNotebook: scan an external folder tree in place level by level with a
+// bounded number of workers and write the configuration file of each
+// non-root folder once at the end. The root folder is left to the caller,
+// which merges the notebook configuration into it.
+// ImportFiles: copy external files into a folder by the workers. Local images
+// of a note are copied into the image folder and the links are rewritten,
+// found by the cheap scanner VUtils::fetchImageLinkUrls(). The caller adds
+// the imported notes to the folder configuration in one batch.
+// Once stopped, nothing is written and the copied files are removed.
+class VNoteImporter : public QThread
+{
+    Q_OBJECT
+public:
+    enum Mode
+    {
+        BuildNotebook,
+        ImportFiles
+    };
+
+    struct ImportedFile
+    {
+        // Path of the source file.
+        QString m_srcFile;
+
+        // Name of the note in the target folder.
+        QString m_name;
+    };
+
+    // Build the notebook configuration of folder @p_rootDir.
+    explicit VNoteImporter(const QString &p_rootDir, QObject *p_parent = nullptr);
+
+    // Import @p_files into folder @p_destDir, where @p_imageFolder is the
+    // image folder of the notebook relative to the note.
+    VNoteImporter(const QStringList &p_files,
+                  const QString &p_destDir,
+                  const QString &p_imageFolder,
+                  QObject *p_parent = nullptr);
+
+    void stop();
+
+    bool isStopped() const;
+
+    // Valid after finished.
+    bool isSucceeded() const;
+
+    // Error messages of the skipped folders and files.
+    // Valid after finished.
+    const QString &getErrorMessage() const;
+
+    // Names of the root sub-folders containing notes recursively.
+    // Valid after finished in BuildNotebook mode.
+    const QStringList &getRootSubDirectories() const;
+
+    // Valid after finished in ImportFiles mode.
+    const QVector<ImportedFile> &getImportedFiles() const;
+
+signals:
+    // @p_done: number of folders scanned or files imported.
+    // @p_total: number of folders found so far or files to import.
+    void progressUpdated(int p_done, int p_total);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    friend class VNoteImportTask;
+
+    struct DirEntry
+    {
+        DirEntry()
+            : m_parent(-1),
+              m_kept(false)
+        {
+        }
+
+        DirEntry(const QString &p_path, int p_parent)
+            : m_path(p_path),
+              m_parent(p_parent),
+              m_kept(false)
+        {
+        }
+
+        QString m_path;
+
+        // Index of the parent folder in m_dirs.
+        int m_parent;
+
+        QStringList m_subDirs;
+
+        QStringList m_files;
+
+        // Whether it contains notes recursively.
+        bool m_kept;
+    };
+
+    struct FileJob
+    {
+        FileJob()
+            : m_copyNeeded(true),
+              m_succeeded(false)
+        {
+        }
+
+        QString m_srcFile;
+
+        QString m_name;
+
+        bool m_copyNeeded;
+
+        bool m_succeeded;
+    };
+
+    bool buildNotebook();
+
+    bool importFiles();
+
+    // Run the jobs from @m_nextJob until @m_jobEnd.
+    // Called on the workers.
+    void runJobs();
+
+    // Run jobs [@p_begin, @p_end) by the workers and wait for them.
+    void runJobsInPool(int p_begin, int p_end);
+
+    void scanDirectory(DirEntry &p_entry);
+
+    void importFile(FileJob &p_job);
+
+    // Copy local image @p_url of note @p_srcFile to the image folder and
+    // return the new url. Return empty if not relocated.
+    QString relocateImage(const QString &p_srcFile, const QString &p_url);
+
+    void addError(const QString &p_msg);
+
+    void addDone();
+
+    Mode m_mode;
+
+    QString m_rootDir;
+
+    QStringList m_srcFiles;
+
+    QString m_destDir;
+
+    QString m_imageFolder;
+
+    // Name filters of the Markdown files.
+    QStringList m_filters;
+
+    QAtomicInt m_stop;
+
+    bool m_succeeded;
+
+    QVector<DirEntry> m_dirs;
+
+    QVector<FileJob> m_fileJobs;
+
+    // Index of the next job to run.
+    QAtomicInt m_nextJob;
+
+    int m_jobEnd;
+
+    QMutex m_mutex;
+
+    QString m_errMsg;
+
+    int m_done;
+
+    int m_total;
+
+    // Source image path -> new name in the image folder.
+    QHash<QString, QString> m_relocatedImages;
+
+    QSet<QString> m_takenImageNames;
+
+    QStringList m_rootSubDirs;
+
+    QVector<ImportedFile> m_importedFiles;
+};
+
+inline bool VNoteImporter::isStopped() const
+{
+    return m_stop.load() == 1;
+}
+
+inline bool VNoteImporter::isSucceeded() const
+{
+    return m_succeeded;
+}
+
+inline const QString &VNoteImporter::getErrorMessage() const
+{
+    return m_errMsg;
+}
+
+inline const QStringList &VNoteImporter::getRootSubDirectories() const
+{
+    return m_rootSubDirs;
+}
+
+inline const QVector<VNoteImporter::ImportedFile> &VNoteImporter::getImportedFiles() const
+{
+    return m_importedFiles;
+}
+
+#endif // VNOTEIMPORTER_H
@@ -0,0 +1,461 @@
+#include "vnotemetadatastore.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QTextStream>
+#include <QCryptographicHash>
+
+#include "vnotebook.h"
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Magic and version of the store file.
+#define STORE_FILE_MAGIC 0x564e4d53
+#define STORE_FILE_VERSION 1
+
+// Compact the store when there are too many dead rows.
+#define COMPACT_DEAD_ROWS_THRESHOLD 1024
+
+// Max lines of the front matter to read.
+#define MAX_FRONT_MATTER_LINES 512
+
+VNoteMetadataStore::VNoteMetadataStore(const QString &p_rootPath, const QString &p_storeFile)
+    : m_rootPath(p_rootPath),
+      m_storeFile(p_storeFile),
+      m_deadRows(0),
+      m_dirty(false)
+{
+}
+
+bool VNoteMetadataStore::load()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_paths.clear();
+    m_createdTimes.clear();
+    m_modifiedTimes.clear();
+    m_tags.clear();
+    m_fileTimes.clear();
+    m_fields.clear();
+    m_pathToRow.clear();
+    m_deadRows = 0;
+    m_dirty = false;
+
+    QFile file(m_storeFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != STORE_FILE_MAGIC || version != STORE_FILE_VERSION) {
+        qWarning() << "invalid metadata store file" << m_storeFile;
+        return false;
+    }
+
+    in >> m_paths >> m_createdTimes >> m_modifiedTimes >> m_tags >> m_fileTimes >> m_fields;
+
+    bool valid = in.status() == QDataStream::Ok;
+    int rows = m_paths.size();
+    if (valid) {
+        valid = m_createdTimes.size() == rows
+                && m_modifiedTimes.size() == rows
+                && m_tags.size() == rows
+                && m_fileTimes.size() == rows;
+        for (auto it = m_fields.constBegin(); valid && it != m_fields.constEnd(); ++it) {
+            valid = it.value().size() == rows;
+        }
+    }
+
+    if (!valid) {
+        qWarning() << "corrupted metadata store file" << m_storeFile;
+        m_paths.clear();
+        m_createdTimes.clear();
+        m_modifiedTimes.clear();
+        m_tags.clear();
+        m_fileTimes.clear();
+        m_fields.clear();
+        return false;
+    }
+
+    for (int i = 0; i < rows; ++i) {
+        if (m_paths[i].isEmpty()) {
+            ++m_deadRows;
+        } else {
+            m_pathToRow.insert(m_paths[i], i);
+        }
+    }
+
+    qDebug() << "metadata store loaded" << m_rootPath << rows << m_fields.size();
+    return true;
+}
+
+bool VNoteMetadataStore::save()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_dirty) {
+        return true;
+    }
+
+    compact();
+
+    VUtils::makePath(VUtils::basePathFromPath(m_storeFile));
+
+    QSaveFile file(m_storeFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open metadata store file to write" << m_storeFile;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    out << (quint32)STORE_FILE_MAGIC << (quint32)STORE_FILE_VERSION;
+    out << m_paths << m_createdTimes << m_modifiedTimes << m_tags << m_fileTimes << m_fields;
+
+    if (!file.commit()) {
+        qWarning() << "fail to write metadata store file" << m_storeFile;
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+QString VNoteMetadataStore::relativePath(const QString &p_filePath) const
+{
+    return QDir(m_rootPath).relativeFilePath(p_filePath);
+}
+
+int VNoteMetadataStore::ensureRow(const QString &p_relativePath)
+{
+    auto it = m_pathToRow.constFind(p_relativePath);
+    if (it != m_pathToRow.constEnd()) {
+        return it.value();
+    }
+
+    int row = m_paths.size();
+    m_paths.append(p_relativePath);
+    m_createdTimes.append(0);
+    m_modifiedTimes.append(0);
+    m_tags.append(QStringList());
+    m_fileTimes.append(0);
+    for (auto it = m_fields.begin(); it != m_fields.end(); ++it) {
+        it.value().append(QString());
+    }
+
+    m_pathToRow.insert(p_relativePath, row);
+    m_dirty = true;
+    return row;
+}
+
+void VNoteMetadataStore::setFrontMatter(int p_row, const QHash<QString, QString> &p_fields)
+{
+    // Clear the fields of the row not present any more.
+    for (auto it = m_fields.begin(); it != m_fields.end(); ++it) {
+        if (!p_fields.contains(it.key())) {
+            it.value()[p_row].clear();
+        }
+    }
+
+    for (auto it = p_fields.constBegin(); it != p_fields.constEnd(); ++it) {
+        auto colIt = m_fields.find(it.key());
+        if (colIt == m_fields.end()) {
+            colIt = m_fields.insert(it.key(), QVector<QString>(m_paths.size()));
+        }
+
+        // Null means no such field.
+        colIt.value()[p_row] = it.value().isNull() ? QString("") : it.value();
+    }
+
+    m_dirty = true;
+}
+
+void VNoteMetadataStore::refreshFile(const QString &p_filePath,
+                                     qint64 p_createdTime,
+                                     qint64 p_modifiedTime,
+                                     const QStringList &p_tags)
+{
+    QString relPath = relativePath(p_filePath);
+    qint64 fileTime = QFileInfo(p_filePath).lastModified().toMSecsSinceEpoch();
+
+    bool needRead = true;
+    {
+        QMutexLocker locker(&m_mutex);
+        int row = ensureRow(relPath);
+        if (m_createdTimes[row] != p_createdTime
+            || m_modifiedTimes[row] != p_modifiedTime
+            || m_tags[row] != p_tags) {
+            m_createdTimes[row] = p_createdTime;
+            m_modifiedTimes[row] = p_modifiedTime;
+            m_tags[row] = p_tags;
+            m_dirty = true;
+        }
+
+        needRead = m_fileTimes[row] != fileTime;
+    }
+
+    if (!needRead) {
+        return;
+    }
+
+    // Read the file without the lock.
+    QHash<QString, QString> fields = readFrontMatter(p_filePath);
+
+    QMutexLocker locker(&m_mutex);
+    int row = ensureRow(relPath);
+    setFrontMatter(row, fields);
+    m_fileTimes[row] = fileTime;
+}
+
+void VNoteMetadataStore::updateFile(const QString &p_filePath,
+                                    qint64 p_modifiedTime,
+                                    const QString &p_content)
+{
+    QString relPath = relativePath(p_filePath);
+    qint64 fileTime = QFileInfo(p_filePath).lastModified().toMSecsSinceEpoch();
+    QHash<QString, QString> fields = VMetadataQuery::parseFrontMatter(VMetadataQuery::frontMatterText(p_content));
+
+    QMutexLocker locker(&m_mutex);
+    int row = ensureRow(relPath);
+    m_modifiedTimes[row] = p_modifiedTime;
+    m_fileTimes[row] = fileTime;
+    setFrontMatter(row, fields);
+}
+
+void VNoteMetadataStore::removeFile(const QString &p_filePath)
+{
+    QString relPath = relativePath(p_filePath);
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_pathToRow.find(relPath);
+    if (it == m_pathToRow.end()) {
+        return;
+    }
+
+    m_paths[it.value()].clear();
+    m_pathToRow.erase(it);
+    ++m_deadRows;
+    m_dirty = true;
+}
+
+void VNoteMetadataStore::renameFile(const QString &p_oldPath, const QString &p_newPath)
+{
+    QString oldRelPath = relativePath(p_oldPath);
+    QString newRelPath = relativePath(p_newPath);
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_pathToRow.find(oldRelPath);
+    if (it == m_pathToRow.end()) {
+        return;
+    }
+
+    int row = it.value();
+    m_pathToRow.erase(it);
+
+    auto newIt = m_pathToRow.find(newRelPath);
+    if (newIt != m_pathToRow.end()) {
+        m_paths[newIt.value()].clear();
+        ++m_deadRows;
+        m_pathToRow.erase(newIt);
+    }
+
+    m_paths[row] = newRelPath;
+    m_pathToRow.insert(newRelPath, row);
+    m_dirty = true;
+}
+
+bool VNoteMetadataStore::fetch(const QString &p_filePath,
+                               const QStringList &p_keys,
+                               VNoteMetadata &p_meta) const
+{
+    QString relPath = relativePath(p_filePath);
+
+    QMutexLocker locker(&m_mutex);
+    auto it = m_pathToRow.constFind(relPath);
+    if (it == m_pathToRow.constEnd()) {
+        return false;
+    }
+
+    int row = it.value();
+    p_meta.m_createdTime = m_createdTimes[row];
+    p_meta.m_modifiedTime = m_modifiedTimes[row];
+    p_meta.m_tags = m_tags[row];
+
+    p_meta.m_frontMatter.clear();
+    for (auto const & key : p_keys) {
+        auto colIt = m_fields.constFind(key);
+        if (colIt == m_fields.constEnd()) {
+            continue;
+        }
+
+        const QString &value = colIt.value()[row];
+        if (!value.isNull()) {
+            p_meta.m_frontMatter.insert(key, value);
+        }
+    }
+
+    return true;
+}
+
+QHash<QString, QString> VNoteMetadataStore::readFrontMatter(const QString &p_filePath)
+{
+    QFile file(p_filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return QHash<QString, QString>();
+    }
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+
+    // Only read the head of the note.
+    if (in.readLine().trimmed() != QStringLiteral("---")) {
+        return QHash<QString, QString>();
+    }
+
+    QStringList lines;
+    for (int i = 0; i < MAX_FRONT_MATTER_LINES && !in.atEnd(); ++i) {
+        QString line = in.readLine();
+        QString trimmed = line.trimmed();
+        if (trimmed == QStringLiteral("---") || trimmed == QStringLiteral("...")) {
+            return VMetadataQuery::parseFrontMatter(lines.join('\n'));
+        }
+
+        lines.append(line);
+    }
+
+    // Not a complete front matter.
+    return QHash<QString, QString>();
+}
+
+// Keep only @p_rows of @p_column.
+template <typename T>
+static void pickRows(QVector<T> &p_column, const QVector<int> &p_rows)
+{
+    QVector<T> column;
+    column.reserve(p_rows.size());
+    for (int row : p_rows) {
+        column.append(p_column[row]);
+    }
+
+    p_column.swap(column);
+}
+
+void VNoteMetadataStore::compact()
+{
+    if (m_deadRows < COMPACT_DEAD_ROWS_THRESHOLD) {
+        return;
+    }
+
+    QVector<int> alive;
+    alive.reserve(m_paths.size() - m_deadRows);
+    for (int i = 0; i < m_paths.size(); ++i) {
+        if (!m_paths[i].isEmpty()) {
+            alive.append(i);
+        }
+    }
+
+    pickRows(m_paths, alive);
+    pickRows(m_createdTimes, alive);
+    pickRows(m_modifiedTimes, alive);
+    pickRows(m_tags, alive);
+    pickRows(m_fileTimes, alive);
+    for (auto it = m_fields.begin(); it != m_fields.end(); ++it) {
+        pickRows(it.value(), alive);
+    }
+
+    m_pathToRow.clear();
+    for (int i = 0; i < m_paths.size(); ++i) {
+        m_pathToRow.insert(m_paths[i], i);
+    }
+
+    m_deadRows = 0;
+}
+
+
+VNoteMetadataStoreManager *VNoteMetadataStoreManager::inst()
+{
+    static VNoteMetadataStoreManager mgr;
+    return &mgr;
+}
+
+QSharedPointer<VNoteMetadataStore> VNoteMetadataStoreManager::storeForNotebook(const VNotebook *p_notebook)
+{
+    if (!p_notebook) {
+        return QSharedPointer<VNoteMetadataStore>();
+    }
+
+    VNoteMetadataStoreManager *mgr = inst();
+    QSharedPointer<VNoteMetadataStore> store = mgr->m_stores.value(p_notebook->getPath());
+    if (!store) {
+        store.reset(new VNoteMetadataStore(p_notebook->getPath(),
+                                           storeFilePath(p_notebook->getPath())));
+        store->load();
+        mgr->m_stores.insert(p_notebook->getPath(), store);
+    }
+
+    return store;
+}
+
+QSharedPointer<VNoteMetadataStore> VNoteMetadataStoreManager::loadedStore(const VNotebook *p_notebook) const
+{
+    if (!p_notebook) {
+        return QSharedPointer<VNoteMetadataStore>();
+    }
+
+    return m_stores.value(p_notebook->getPath());
+}
+
+void VNoteMetadataStoreManager::fileSaved(const VNotebook *p_notebook,
+                                          const QString &p_filePath,
+                                          qint64 p_modifiedTime,
+                                          const QString &p_content)
+{
+    QSharedPointer<VNoteMetadataStore> store = inst()->loadedStore(p_notebook);
+    if (store) {
+        store->updateFile(p_filePath, p_modifiedTime, p_content);
+    }
+}
+
+void VNoteMetadataStoreManager::fileRenamed(const VNotebook *p_notebook,
+                                            const QString &p_oldPath,
+                                            const QString &p_newPath)
+{
+    QSharedPointer<VNoteMetadataStore> store = inst()->loadedStore(p_notebook);
+    if (store) {
+        store->renameFile(p_oldPath, p_newPath);
+    }
+}
+
+void VNoteMetadataStoreManager::fileDeleted(const VNotebook *p_notebook, const QString &p_filePath)
+{
+    QSharedPointer<VNoteMetadataStore> store = inst()->loadedStore(p_notebook);
+    if (store) {
+        store->removeFile(p_filePath);
+    }
+}
+
+void VNoteMetadataStoreManager::saveAll()
+{
+    for (auto const & store : inst()->m_stores) {
+        store->save();
+    }
+}
+
+QString VNoteMetadataStoreManager::storeFilePath(const QString &p_rootPath)
+{
+    QByteArray hash = QCryptographicHash::hash(QDir::cleanPath(p_rootPath).toUtf8(),
+                                               QCryptographicHash::Md5).toHex();
+    return QDir(g_config->getConfigFolder()).filePath(QString("metadata_store/%1.meta")
+                                                      .arg(QString::fromLatin1(hash)));
+}
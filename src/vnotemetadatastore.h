@@ -0,0 +1,137 @@
+#ifndef VNOTEMETADATASTORE_H
+#define VNOTEMETADATASTORE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+
+#include "vmetadataquery.h"
+
+class VNotebook;
+
+// Persistent store of the metadata of notes within one notebook, in columns.
+// Created time, modified time and tags come from the directory configurations,
+// while the front matter is read once from the head of the note and refreshed
+// by the modified time of the file.
+// All public methods are thread-safe.
+class VNoteMetadataStore
+{
+public:
+    VNoteMetadataStore(const QString &p_rootPath, const QString &p_storeFile);
+
+    // Load store from disk. Return false if there is no valid store file.
+    bool load();
+
+    // Write store to disk if it is dirty.
+    bool save();
+
+    // Update the metadata of @p_filePath from its configuration and read its
+    // front matter again if the file is modified.
+    void refreshFile(const QString &p_filePath,
+                     qint64 p_createdTime,
+                     qint64 p_modifiedTime,
+                     const QStringList &p_tags);
+
+    // Update the front matter of @p_filePath from the saved @p_content.
+    void updateFile(const QString &p_filePath,
+                    qint64 p_modifiedTime,
+                    const QString &p_content);
+
+    void removeFile(const QString &p_filePath);
+
+    void renameFile(const QString &p_oldPath, const QString &p_newPath);
+
+    // Fill @p_meta of @p_filePath with the front matter fields of @p_keys.
+    // Return false if @p_filePath is not in the store.
+    bool fetch(const QString &p_filePath,
+               const QStringList &p_keys,
+               VNoteMetadata &p_meta) const;
+
+private:
+    QString relativePath(const QString &p_filePath) const;
+
+    // Return the row of @p_relativePath. Append one if not exists.
+    // Should be called with @m_mutex locked.
+    int ensureRow(const QString &p_relativePath);
+
+    // Should be called with @m_mutex locked.
+    void setFrontMatter(int p_row, const QHash<QString, QString> &p_fields);
+
+    // Read the front matter from the head of @p_filePath.
+    static QHash<QString, QString> readFrontMatter(const QString &p_filePath);
+
+    // Drop dead rows.
+    void compact();
+
+    QString m_rootPath;
+
+    QString m_storeFile;
+
+    // Columns, one row per note.
+    // Path relative to the root path. Empty for a dead row.
+    QVector<QString> m_paths;
+
+    QVector<qint64> m_createdTimes;
+
+    QVector<qint64> m_modifiedTimes;
+
+    QVector<QStringList> m_tags;
+
+    // Modified time of the file when its front matter is read.
+    QVector<qint64> m_fileTimes;
+
+    // Lower-case key of front matter -> column of values. A row without the
+    // field is null.
+    QHash<QString, QVector<QString>> m_fields;
+
+    // Relative path -> row.
+    QHash<QString, int> m_pathToRow;
+
+    int m_deadRows;
+
+    bool m_dirty;
+
+    mutable QMutex m_mutex;
+};
+
+
+// Manage the metadata store of each notebook.
+// Should be accessed only in the GUI thread.
+class VNoteMetadataStoreManager
+{
+public:
+    // Get the store of @p_notebook. Load it from disk if needed.
+    static QSharedPointer<VNoteMetadataStore> storeForNotebook(const VNotebook *p_notebook);
+
+    // Update the store if it is loaded.
+    static void fileSaved(const VNotebook *p_notebook,
+                          const QString &p_filePath,
+                          qint64 p_modifiedTime,
+                          const QString &p_content);
+
+    static void fileRenamed(const VNotebook *p_notebook,
+                            const QString &p_oldPath,
+                            const QString &p_newPath);
+
+    static void fileDeleted(const VNotebook *p_notebook, const QString &p_filePath);
+
+    // Write all the dirty stores to disk.
+    static void saveAll();
+
+private:
+    VNoteMetadataStoreManager() {}
+
+    static VNoteMetadataStoreManager *inst();
+
+    QSharedPointer<VNoteMetadataStore> loadedStore(const VNotebook *p_notebook) const;
+
+    static QString storeFilePath(const QString &p_rootPath);
+
+    // Notebook path -> store.
+    QHash<QString, QSharedPointer<VNoteMetadataStore>> m_stores;
+};
+
+#endif // VNOTEMETADATASTORE_H
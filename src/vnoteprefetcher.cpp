@@ -0,0 +1,257 @@
+#include "vnoteprefetcher.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QStorageInfo>
+#include <QRunnable>
+#include <QTimer>
+#include <QCoreApplication>
+
+#include "pegparser.h"
+#include "pegmarkdownhighlighter.h"
+#include "utils/vutils.h"
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Time in ms the selection should stay on a note before it is prefetched.
+#define PREFETCH_DELAY 200
+
+// Read and parse a note.
+class NotePrefetchTask : public QRunnable
+{
+public:
+    NotePrefetchTask(VNotePrefetcher *p_prefetcher,
+                     int p_id,
+                     const QString &p_filePath,
+                     bool p_parse,
+                     int p_extensions,
+                     const QVector<HighlightingStyle> &p_styles,
+                     const QSharedPointer<QAtomicInt> &p_stop)
+        : m_prefetcher(p_prefetcher),
+          m_id(p_id),
+          m_filePath(p_filePath),
+          m_parse(p_parse),
+          m_extensions(p_extensions),
+          m_styles(p_styles),
+          m_stop(p_stop)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (m_prefetcher->isCancelled(m_id)) {
+            return;
+        }
+
+        VNotePrefetcher::Entry entry;
+        entry.m_filePath = m_filePath;
+        QFileInfo fi(m_filePath);
+        entry.m_modifiedTime = fi.lastModified();
+        entry.m_size = fi.size();
+        entry.m_content = VUtils::readFileFromDisk(m_filePath);
+        if (entry.m_content.isEmpty() || m_prefetcher->isCancelled(m_id)) {
+            return;
+        }
+
+        if (m_parse) {
+            QSharedPointer<PegParseConfig> config(new PegParseConfig());
+            config->m_text = entry.m_content;
+            config->m_numOfBlocks = entry.m_content.count(QLatin1Char('\n')) + 1;
+            config->m_extensions = m_extensions;
+            config->m_highlightStyles = m_styles;
+
+            QSharedPointer<PegParseResult> result = PegParser::parseMarkdown(config, *m_stop);
+            if (m_stop->load() == 1) {
+                return;
+            }
+
+            if (result->m_highlighterResult) {
+                entry.m_extensions = m_extensions;
+                entry.m_parseResult = result;
+            }
+        }
+
+        m_prefetcher->setEntry(m_id, entry);
+    }
+
+private:
+    VNotePrefetcher *m_prefetcher;
+
+    int m_id;
+
+    QString m_filePath;
+
+    bool m_parse;
+
+    int m_extensions;
+
+    QVector<HighlightingStyle> m_styles;
+
+    QSharedPointer<QAtomicInt> m_stop;
+};
+
+
+VNotePrefetcher::VNotePrefetcher(QObject *p_parent)
+    : QObject(p_parent),
+      m_nextId(0),
+      m_currentId(0)
+{
+    m_pool.setMaxThreadCount(1);
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(PREFETCH_DELAY);
+    connect(m_timer, &QTimer::timeout,
+            this, &VNotePrefetcher::startPrefetch);
+}
+
+VNotePrefetcher::~VNotePrefetcher()
+{
+    cancel();
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+VNotePrefetcher *VNotePrefetcher::inst()
+{
+    static VNotePrefetcher *prefetcher = new VNotePrefetcher(QCoreApplication::instance());
+    return prefetcher;
+}
+
+void VNotePrefetcher::prefetch(const QString &p_filePath)
+{
+    QString filePath = QDir::cleanPath(p_filePath);
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_entry.m_filePath == filePath) {
+            return;
+        }
+    }
+
+    cancel();
+
+    if (filePath.isEmpty() || g_config->getPrefetchNoteSize() == 0) {
+        return;
+    }
+
+    m_pendingFile = filePath;
+    m_timer->start();
+}
+
+void VNotePrefetcher::startPrefetch()
+{
+    QString filePath = m_pendingFile;
+    m_pendingFile.clear();
+
+    QFileInfo fi(filePath);
+    qint64 maxSize = g_config->getPrefetchNoteSize();
+    qint64 largeSize = g_config->getLargeFileSize();
+    if (!fi.isFile()
+        || fi.size() > maxSize
+        || (largeSize > 0 && fi.size() >= largeSize)
+        || !isLocalFile(filePath)) {
+        return;
+    }
+
+    bool parse = VUtils::docTypeFromName(filePath, fi.size()) == DocType::Markdown;
+    int extensions = PegMarkdownHighlighter::parserExtensions(g_config->getEnableMathjax());
+
+    int id = ++m_nextId;
+    m_currentId.store(id);
+    m_stop.reset(new QAtomicInt(0));
+    m_pool.start(new NotePrefetchTask(this,
+                                      id,
+                                      filePath,
+                                      parse,
+                                      extensions,
+                                      g_config->getMdHighlightingStyles(),
+                                      m_stop));
+}
+
+void VNotePrefetcher::cancel()
+{
+    m_timer->stop();
+    m_pendingFile.clear();
+
+    m_currentId.store(0);
+    if (m_stop) {
+        m_stop->store(1);
+        m_stop.clear();
+    }
+
+    QMutexLocker locker(&m_mutex);
+    m_entry = Entry();
+}
+
+bool VNotePrefetcher::isCancelled(int p_id) const
+{
+    return m_currentId.load() != p_id;
+}
+
+void VNotePrefetcher::setEntry(int p_id, const Entry &p_entry)
+{
+    QMutexLocker locker(&m_mutex);
+    if (isCancelled(p_id)) {
+        return;
+    }
+
+    m_entry = p_entry;
+}
+
+bool VNotePrefetcher::takeContent(const QString &p_filePath,
+                                  const QDateTime &p_modifiedTime,
+                                  qint64 p_size,
+                                  QString &p_content)
+{
+    QMutexLocker locker(&m_mutex);
+    if (m_entry.m_filePath.isEmpty()
+        || m_entry.m_filePath != QDir::cleanPath(p_filePath)) {
+        return false;
+    }
+
+    if (m_entry.m_modifiedTime != p_modifiedTime || m_entry.m_size != p_size) {
+        m_entry = Entry();
+        return false;
+    }
+
+    p_content = m_entry.m_content;
+
+    // Keep the content, which is shared, to match the parse result later.
+    if (!m_entry.m_parseResult) {
+        m_entry = Entry();
+    }
+
+    return true;
+}
+
+QSharedPointer<PegParseResult> VNotePrefetcher::takeParseResult(const QString &p_text, int p_extensions)
+{
+    QMutexLocker locker(&m_mutex);
+    QSharedPointer<PegParseResult> result;
+    if (m_entry.m_parseResult
+        && m_entry.m_extensions == p_extensions
+        && m_entry.m_content == p_text) {
+        result = m_entry.m_parseResult;
+        m_entry = Entry();
+    }
+
+    return result;
+}
+
+bool VNotePrefetcher::isLocalFile(const QString &p_filePath)
+{
+    // UNC path.
+    if (p_filePath.startsWith("//") || p_filePath.startsWith("\\\\")) {
+        return false;
+    }
+
+    static const QStringList networkTypes = {
+        "nfs", "nfs4", "cifs", "smbfs", "smb2", "afpfs", "9p", "davfs",
+        "fuse.sshfs", "fuse.davfs2", "fuse.rclone", "webdav"
+    };
+
+    QStorageInfo storage(QFileInfo(p_filePath).absolutePath());
+    return !networkTypes.contains(QString::fromLatin1(storage.fileSystemType()).toLower());
+}
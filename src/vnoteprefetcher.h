@@ -0,0 +1,107 @@
+#ifndef VNOTEPREFETCHER_H
+#define VNOTEPREFETCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QDateTime>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QMutex>
+#include <QSharedPointer>
+
+class QTimer;
+struct PegParseResult;
+
+// Read and parse the note selected in the lists in the background before it
+// is opened, so opening it does not start from cold.
+// Only one note is kept, which is within the configured size and in local
+// storage.
+// Should be accessed only in the GUI thread, except the marked ones.
+class VNotePrefetcher : public QObject
+{
+    Q_OBJECT
+public:
+    ~VNotePrefetcher();
+
+    static VNotePrefetcher *inst();
+
+    // Prefetch @p_filePath after a while if it is still selected then.
+    // The previous prefetch will be cancelled.
+    void prefetch(const QString &p_filePath);
+
+    void cancel();
+
+    // Take the content of @p_filePath if it is prefetched and the file is not
+    // modified since then, judged by its modified time and size.
+    bool takeContent(const QString &p_filePath,
+                     const QDateTime &p_modifiedTime,
+                     qint64 p_size,
+                     QString &p_content);
+
+    // Take the parse result of Markdown @p_text if it is the content
+    // prefetched and parsed with @p_extensions.
+    QSharedPointer<PegParseResult> takeParseResult(const QString &p_text, int p_extensions);
+
+    // Whether prefetch @p_id is cancelled.
+    // Thread-safe.
+    bool isCancelled(int p_id) const;
+
+private:
+    friend class NotePrefetchTask;
+
+    struct Entry
+    {
+        Entry()
+            : m_size(0),
+              m_extensions(0)
+        {
+        }
+
+        QString m_filePath;
+
+        // Modified time may not change within its resolution after a write.
+        QDateTime m_modifiedTime;
+
+        qint64 m_size;
+
+        QString m_content;
+
+        int m_extensions;
+
+        // Built with the highlighter result.
+        QSharedPointer<PegParseResult> m_parseResult;
+    };
+
+    explicit VNotePrefetcher(QObject *p_parent = nullptr);
+
+    void startPrefetch();
+
+    // Set the entry of prefetch @p_id.
+    // Thread-safe.
+    void setEntry(int p_id, const Entry &p_entry);
+
+    // Whether @p_filePath is in local storage instead of a network share.
+    static bool isLocalFile(const QString &p_filePath);
+
+    QThreadPool m_pool;
+
+    // Wait for the selection to settle.
+    QTimer *m_timer;
+
+    QString m_pendingFile;
+
+    int m_nextId;
+
+    // ID of current prefetch, 0 if there is none.
+    QAtomicInt m_currentId;
+
+    // Stop flag of the parse of current prefetch.
+    QSharedPointer<QAtomicInt> m_stop;
+
+    // Protect m_entry.
+    mutable QMutex m_mutex;
+
+    Entry m_entry;
+};
+
+#endif // VNOTEPREFETCHER_H
@@ -21,6 +21,8 @@ VOrphanFile::VOrphanFile(QObject *p_parent,
       m_path(p_path),
       m_systemFile(p_systemFile)
 {
+    // External files are not renamed, so the type could depend on the size.
+    m_docType = VUtils::docTypeFromName(m_name, QFileInfo(p_path).size());
 }
 
 QString VOrphanFile::fetchPath() const
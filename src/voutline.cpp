@@ -19,6 +19,12 @@ extern VMainWindow *g_mainWin;
 
 #define STATIC_EXPANDED_LEVEL 6
 
+// Level of the header of an item.
+#define LEVEL_ROLE (Qt::UserRole + 1)
+
+// Max number of outline trees of other files to keep.
+#define MAX_CACHED_TREES 32
+
 VOutline::VOutline(QWidget *parent)
     : QWidget(parent),
       VNavigationMode(),
@@ -46,6 +52,13 @@ VOutline::VOutline(QWidget *parent)
             });
 }
 
+VOutline::~VOutline()
+{
+    for (auto const & tree : m_cachedTrees) {
+        qDeleteAll(tree.m_items);
+    }
+}
+
 void VOutline::setupUI()
 {
     m_deLevelBtn = new QPushButton(VIconUtils::buttonIcon(":/resources/icons/decrease_outline_level.svg"),
@@ -123,70 +136,243 @@ void VOutline::updateOutline(const VTableOfContent &p_outline)
         return;
     }
 
-    // Clear current header
-    m_currentHeader.clear();
+    // A different note is shown. Start over with the cached items of that note
+    // if any instead of reusing current items.
+    bool rebuild = p_outline.getFile() != m_outline.getFile()
+                   || p_outline.getType() != m_outline.getType();
+
+    // Removing the current item should not jump to another header.
+    m_muted = true;
+
+    bool restored = false;
+    bool upToDate = false;
+    if (rebuild) {
+        stashTree();
+        m_tree->clear();
+
+        restored = restoreTree(p_outline, upToDate);
+    }
 
     m_outline = p_outline;
 
-    updateTreeFromOutline(m_tree, m_outline);
+    QVector<QTreeWidgetItem *> addedItems;
+    if (!upToDate) {
+        updateTreeFromOutline(m_tree, m_outline, &addedItems);
+    }
+
+    m_muted = false;
+
+    // Clear current header
+    m_currentHeader.clear();
 
     updateButtonsState();
 
-    expandTree(g_config->getOutlineExpandedLevel());
+    if (rebuild && !restored) {
+        expandTree(g_config->getOutlineExpandedLevel());
+    } else {
+        expandItems(addedItems, g_config->getOutlineExpandedLevel());
+    }
 }
 
-void VOutline::updateTreeFromOutline(QTreeWidget *p_treeWidget,
-                                     const VTableOfContent &p_outline)
+void VOutline::stashTree()
 {
-    p_treeWidget->clear();
+    const VFile *file = m_outline.getFile();
+    int cnt = m_tree->topLevelItemCount();
+    if (!file || cnt == 0) {
+        return;
+    }
+
+    CachedTree tree;
+    tree.m_outline = m_outline;
+
+    QList<QTreeWidgetItem *> items;
+    for (int i = 0; i < cnt; ++i) {
+        items.append(m_tree->topLevelItem(i));
+    }
 
+    // Detached items do not know whether they are expanded.
+    while (!items.isEmpty()) {
+        QTreeWidgetItem *item = items.takeLast();
+        if (item->isExpanded()) {
+            tree.m_expandedItems.append(item);
+        }
+
+        for (int i = 0; i < item->childCount(); ++i) {
+            items.append(item->child(i));
+        }
+    }
+
+    m_tree->setCurrentItem(NULL);
+    tree.m_items = m_tree->invisibleRootItem()->takeChildren();
+
+    auto it = m_cachedTrees.find(file);
+    if (it != m_cachedTrees.end()) {
+        qDeleteAll(it->m_items);
+        m_cachedFiles.removeOne(file);
+    }
+
+    m_cachedTrees.insert(file, tree);
+    m_cachedFiles.append(file);
+
+    while (m_cachedFiles.size() > MAX_CACHED_TREES) {
+        qDeleteAll(m_cachedTrees.take(m_cachedFiles.takeFirst()).m_items);
+    }
+}
+
+bool VOutline::restoreTree(const VTableOfContent &p_outline, bool &p_upToDate)
+{
+    const VFile *file = p_outline.getFile();
+    if (!file || !m_cachedTrees.contains(file)) {
+        return false;
+    }
+
+    m_cachedFiles.removeOne(file);
+    CachedTree tree = m_cachedTrees.take(file);
+    if (tree.m_outline.getType() != p_outline.getType()) {
+        qDeleteAll(tree.m_items);
+        return false;
+    }
+
+    m_tree->addTopLevelItems(tree.m_items);
+    for (auto item : tree.m_expandedItems) {
+        item->setExpanded(true);
+    }
+
+    p_upToDate = tree.m_outline == p_outline;
+    return true;
+}
+
+void VOutline::updateTreeFromOutline(QTreeWidget *p_treeWidget,
+                                     const VTableOfContent &p_outline,
+                                     QVector<QTreeWidgetItem *> *p_addedItems)
+{
     if (p_outline.isEmpty()) {
+        p_treeWidget->clear();
         p_treeWidget->update();
         return;
     }
 
     const QVector<VTableOfContentItem> &headers = p_outline.getTable();
+    QVector<int> parents(headers.size(), -1);
     int idx = 0;
-    updateTreeByLevel(p_treeWidget, headers, idx, NULL, NULL, 1);
+    parentsByLevel(headers, idx, -1, 1, parents);
+
+    QVector<QVector<int>> children(headers.size() + 1);
+    for (int i = 0; i < parents.size(); ++i) {
+        children[parents[i] + 1].append(i);
+    }
+
+    updateChildren(p_treeWidget, NULL, headers, children, -1, p_addedItems);
 }
 
-void VOutline::updateTreeByLevel(QTreeWidget *p_treeWidget,
-                                 const QVector<VTableOfContentItem> &p_headers,
-                                 int &p_index,
-                                 QTreeWidgetItem *p_parent,
-                                 QTreeWidgetItem *p_last,
-                                 int p_level)
+void VOutline::parentsByLevel(const QVector<VTableOfContentItem> &p_headers,
+                              int &p_index,
+                              int p_parent,
+                              int p_level,
+                              QVector<int> &p_parents)
 {
+    int last = -1;
     while (p_index < p_headers.size()) {
         const VTableOfContentItem &header = p_headers[p_index];
-        QTreeWidgetItem *item;
         if (header.m_level == p_level) {
-            if (p_parent) {
-                item = new QTreeWidgetItem(p_parent);
-            } else {
-                item = new QTreeWidgetItem(p_treeWidget);
+            p_parents[p_index] = p_parent;
+            last = p_index;
+            ++p_index;
+        } else if (header.m_level < p_level) {
+            return;
+        } else {
+            parentsByLevel(p_headers, p_index, last, p_level + 1, p_parents);
+        }
+    }
+}
+
+void VOutline::updateChildren(QTreeWidget *p_treeWidget,
+                              QTreeWidgetItem *p_parent,
+                              const QVector<VTableOfContentItem> &p_headers,
+                              const QVector<QVector<int>> &p_children,
+                              int p_parentIdx,
+                              QVector<QTreeWidgetItem *> *p_addedItems)
+{
+    const QVector<int> &children = p_children[p_parentIdx + 1];
+
+    // Number of the headers of each key not matched yet.
+    QHash<QString, int> pendingKeys;
+    for (int idx : children) {
+        ++pendingKeys[headerKey(p_headers[idx])];
+    }
+
+    int cnt = p_parent ? p_parent->childCount() : p_treeWidget->topLevelItemCount();
+    int pos = 0;
+    for (int idx : children) {
+        const VTableOfContentItem &header = p_headers[idx];
+        QString key = headerKey(header);
+
+        // Drop existing items which match none of the remaining headers.
+        QTreeWidgetItem *item = NULL;
+        while (pos < cnt) {
+            item = p_parent ? p_parent->child(pos) : p_treeWidget->topLevelItem(pos);
+            QString oldKey = itemKey(item);
+            if (oldKey == key || pendingKeys.value(oldKey) > 0) {
+                break;
             }
 
+            delete item;
+            item = NULL;
+            --cnt;
+        }
+
+        if (!item || itemKey(item) != key) {
+            // Insert a new item before the one matching a later header.
+            item = new QTreeWidgetItem();
             fillItem(item, header);
+            if (p_parent) {
+                p_parent->insertChild(pos, item);
+            } else {
+                p_treeWidget->insertTopLevelItem(pos, item);
+            }
 
-            p_last = item;
-            ++p_index;
-        } else if (header.m_level < p_level) {
-            return;
+            ++cnt;
+            if (p_addedItems) {
+                p_addedItems->append(item);
+            }
         } else {
-            updateTreeByLevel(p_treeWidget, p_headers, p_index, p_last, NULL, p_level + 1);
+            fillItem(item, header);
         }
+
+        --pendingKeys[key];
+        ++pos;
+
+        updateChildren(p_treeWidget, item, p_headers, p_children, idx, p_addedItems);
+    }
+
+    while (cnt > pos) {
+        --cnt;
+        delete (p_parent ? p_parent->child(cnt) : p_treeWidget->topLevelItem(cnt));
     }
 }
 
+QString VOutline::itemKey(const QTreeWidgetItem *p_item)
+{
+    return QString("%1 %2").arg(p_item->data(0, LEVEL_ROLE).toInt()).arg(p_item->text(0));
+}
+
+QString VOutline::headerKey(const VTableOfContentItem &p_header)
+{
+    return QString("%1 %2").arg(p_header.m_level).arg(p_header.m_name);
+}
+
 void VOutline::fillItem(QTreeWidgetItem *p_item, const VTableOfContentItem &p_header)
 {
+    // setData() does nothing if the value does not change.
     p_item->setData(0, Qt::UserRole, p_header.m_index);
+    p_item->setData(0, LEVEL_ROLE, p_header.m_level);
     p_item->setText(0, p_header.m_name);
     p_item->setToolTip(0, p_header.m_name);
 
     if (p_header.isEmpty()) {
         p_item->setForeground(0, QColor("grey"));
+    } else {
+        p_item->setData(0, Qt::ForegroundRole, QVariant());
     }
 }
 
@@ -213,6 +399,31 @@ void VOutline::expandTree(int p_expandedLevel)
     }
 }
 
+void VOutline::expandItems(const QVector<QTreeWidgetItem *> &p_items, int p_expandedLevel)
+{
+    if (p_items.isEmpty() || m_tree->topLevelItemCount() == 0) {
+        return;
+    }
+
+    const VTableOfContentItem *header = getHeaderFromItem(m_tree->topLevelItem(0), m_outline);
+    if (!header) {
+        return;
+    }
+
+    // Same as expandTree() but only for the new items.
+    int levelToBeExpanded = p_expandedLevel - header->m_level;
+    for (auto item : p_items) {
+        int depth = 0;
+        for (QTreeWidgetItem *pa = item->parent(); pa; pa = pa->parent()) {
+            ++depth;
+        }
+
+        if (levelToBeExpanded - depth > 0) {
+            item->setExpanded(true);
+        }
+    }
+}
+
 void VOutline::expandTreeOne(QTreeWidgetItem *p_item, int p_levelToBeExpanded)
 {
     if (p_levelToBeExpanded <= 0) {
@@ -266,18 +477,25 @@ void VOutline::selectHeader(QTreeWidget *p_treeWidget,
                             const VTableOfContent &p_outline,
                             const VHeaderPointer &p_header)
 {
-    p_treeWidget->setCurrentItem(NULL);
-
-    if (!p_outline.getItem(p_header)) {
-        return;
-    }
+    if (p_outline.getItem(p_header)) {
+        // Keep the current item if it is the one to avoid flicking.
+        QTreeWidgetItem *curItem = p_treeWidget->currentItem();
+        if (curItem) {
+            const VTableOfContentItem *header = getHeaderFromItem(curItem, p_outline);
+            if (header && header->isMatched(p_header)) {
+                return;
+            }
+        }
 
-    int nrTop = p_treeWidget->topLevelItemCount();
-    for (int i = 0; i < nrTop; ++i) {
-        if (selectHeaderOne(p_treeWidget, p_treeWidget->topLevelItem(i), p_outline, p_header)) {
-            return;
+        int nrTop = p_treeWidget->topLevelItemCount();
+        for (int i = 0; i < nrTop; ++i) {
+            if (selectHeaderOne(p_treeWidget, p_treeWidget->topLevelItem(i), p_outline, p_header)) {
+                return;
+            }
         }
     }
+
+    p_treeWidget->setCurrentItem(NULL);
 }
 
 bool VOutline::selectHeaderOne(QTreeWidget *p_treeWidget,
@@ -4,6 +4,8 @@
 #include <QWidget>
 #include <QVector>
 #include <QMap>
+#include <QHash>
+#include <QList>
 #include <QChar>
 
 #include "vtableofcontent.h"
@@ -22,12 +24,19 @@ class VOutline : public QWidget, public VNavigationMode
 public:
     VOutline(QWidget *parent = 0);
 
+    ~VOutline();
+
     // Implementations for VNavigationMode.
     void showNavigation() Q_DECL_OVERRIDE;
     bool handleKeyNavigation(int p_key, bool &p_succeed) Q_DECL_OVERRIDE;
 
     // Update tree according to outline.
-    static void updateTreeFromOutline(QTreeWidget *p_treeWidget, const VTableOfContent &p_outline);
+    // Existing items matching the headers are kept, with their expanded and
+    // selected state, and only the changed parts of the tree are touched.
+    // @p_addedItems: if not NULL, will hold the newly created items.
+    static void updateTreeFromOutline(QTreeWidget *p_treeWidget,
+                                      const VTableOfContent &p_outline,
+                                      QVector<QTreeWidgetItem *> *p_addedItems = NULL);
 
     // Set the item corresponding to @p_header as current item.
     static void selectHeader(QTreeWidget *p_treeWidget,
@@ -69,13 +78,32 @@ private:
     // Do not response if m_muted is true.
     void activateItem(QTreeWidgetItem *p_item, bool p_focusEditArea = false);
 
-    // @index: the index in @headers.
-    static void updateTreeByLevel(QTreeWidget *p_treeWidget,
-                                  const QVector<VTableOfContentItem> &p_headers,
-                                  int &p_index,
-                                  QTreeWidgetItem *p_parent,
-                                  QTreeWidgetItem *p_last,
-                                  int p_level);
+    // Expand newly added items according to @p_expandedLevel.
+    void expandItems(const QVector<QTreeWidgetItem *> &p_items, int p_expandedLevel);
+
+    // Calculate the parent of each header in @p_parents, -1 for top level.
+    // @p_index: the index in @p_headers.
+    static void parentsByLevel(const QVector<VTableOfContentItem> &p_headers,
+                               int &p_index,
+                               int p_parent,
+                               int p_level,
+                               QVector<int> &p_parents);
+
+    // Make the children of @p_parent (top level items if NULL) match headers
+    // @p_children.
+    // @p_children: children indexes of each header, offset by 1 so that
+    // the first one is the top level.
+    static void updateChildren(QTreeWidget *p_treeWidget,
+                               QTreeWidgetItem *p_parent,
+                               const QVector<VTableOfContentItem> &p_headers,
+                               const QVector<QVector<int>> &p_children,
+                               int p_parentIdx,
+                               QVector<QTreeWidgetItem *> *p_addedItems);
+
+    // Used to match an existing item with a header.
+    static QString itemKey(const QTreeWidgetItem *p_item);
+
+    static QString headerKey(const VTableOfContentItem &p_header);
 
     // Fill the info of @p_item.
     static void fillItem(QTreeWidgetItem *p_item, const VTableOfContentItem &p_header);
@@ -85,6 +113,31 @@ private:
                                 const VTableOfContent &p_outline,
                                 const VHeaderPointer &p_header);
 
+    // Take the items of current outline out of the tree into the cache.
+    void stashTree();
+
+    // Put the cached items of the file of @p_outline back into the empty tree.
+    // @p_upToDate: whether the items match @p_outline already.
+    // Return false if not cached.
+    bool restoreTree(const VTableOfContent &p_outline, bool &p_upToDate);
+
+    // Items of the outline of a file not shown currently, so switching back
+    // to the file needs not build the tree again.
+    struct CachedTree
+    {
+        VTableOfContent m_outline;
+
+        QList<QTreeWidgetItem *> m_items;
+
+        // Items expanded when taken out of the tree.
+        QList<QTreeWidgetItem *> m_expandedItems;
+    };
+
+    QHash<const VFile *, CachedTree> m_cachedTrees;
+
+    // Files of cached trees from the least recently shown one.
+    QList<const VFile *> m_cachedFiles;
+
     VTableOfContent m_outline;
 
     VHeaderPointer m_currentHeader;
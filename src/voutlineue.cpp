@@ -18,7 +18,8 @@ VOutlineUE::VOutlineUE(QObject *p_parent)
     : IUniversalEntry(p_parent),
       m_listWidget(NULL),
       m_treeWidget(NULL),
-      m_listOutline(true)
+      m_listOutline(true),
+      m_outlineFile(NULL)
 {
 }
 
@@ -77,7 +78,8 @@ void VOutlineUE::processCommand(int p_id, const QString &p_cmd)
 
     init();
 
-    clear(-1);
+    // The tree is updated in place to keep its state across commands.
+    m_listWidget->clearAll();
 
     emit stateUpdated(State::Busy);
 
@@ -88,14 +90,31 @@ void VOutlineUE::processCommand(int p_id, const QString &p_cmd)
 
         if (tab) {
             const VTableOfContent &outline = tab->getOutline();
-            VOutline::updateTreeFromOutline(m_treeWidget, outline);
+            bool rebuild = outline.getFile() != m_outlineFile
+                           || m_treeWidget->topLevelItemCount() == 0;
+            if (rebuild) {
+                m_treeWidget->clearAll();
+            }
 
-            VTreeWidget::expandCollapseAll(m_treeWidget);
+            QVector<QTreeWidgetItem *> addedItems;
+            VOutline::updateTreeFromOutline(m_treeWidget, outline, &addedItems);
+            m_outlineFile = outline.getFile();
+
+            if (rebuild) {
+                VTreeWidget::expandCollapseAll(m_treeWidget);
+            } else {
+                for (auto item : addedItems) {
+                    item->setExpanded(true);
+                }
+            }
 
             const VHeaderPointer &header = tab->getCurrentHeader();
             if (outline.isMatched(header)) {
                 VOutline::selectHeader(m_treeWidget, outline, header);
             }
+        } else {
+            m_treeWidget->clearAll();
+            m_outlineFile = NULL;
         }
     } else {
         // Search the outline.
@@ -161,6 +180,7 @@ void VOutlineUE::clear(int p_id)
     Q_UNUSED(p_id);
     m_treeWidget->clearAll();
     m_listWidget->clearAll();
+    m_outlineFile = NULL;
 }
 
 void VOutlineUE::entryHidden(int p_id)
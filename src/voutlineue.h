@@ -7,6 +7,7 @@ class VListWidget;
 class QListWidgetItem;
 class VTreeWidget;
 class QTreeWidgetItem;
+class VFile;
 
 // Universal Entry to list and search outline of current note.
 class VOutlineUE : public IUniversalEntry
@@ -53,6 +54,9 @@ private:
     VTreeWidget *m_treeWidget;
 
     bool m_listOutline;
+
+    // File of the outline in m_treeWidget.
+    const VFile *m_outlineFile;
 };
 
 #endif // VOUTLINEUE_H
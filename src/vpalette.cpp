@@ -7,6 +7,7 @@
 #include <QDebug>
 
 #include "utils/vutils.h"
+#include "utils/vstylecache.h"
 
 VPalette::VPalette(const QString &p_file)
 {
@@ -114,11 +115,34 @@ void VPalette::fillStyle(QString &p_text) const
 QString VPalette::fetchQtStyleSheet() const
 {
     QString style = VUtils::readFileFromDisk(m_data.m_qssFile);
+
+    // The filled style depends on the palette, the location of the theme and
+    // the scale factor.
+    VStyleCache cache("qss");
+    cache.addData(style);
+    cache.addData(m_file);
+    cache.addData(QString::number(VUtils::calculateScaleFactor()));
+
+    QStringList names = m_palette.keys();
+    names.sort();
+    for (auto const & name : names) {
+        cache.addData(name + "=" + m_palette.value(name));
+    }
+
+    QByteArray data;
+    if (cache.load(data)) {
+        return QString::fromUtf8(data);
+    }
+
     fillStyle(style);
     fillAbsoluteUrl(style);
     fillFontFamily(style);
     fillScaledSize(style);
 
+    if (!cache.store(style.toUtf8())) {
+        qWarning() << "fail to write style sheet cache";
+    }
+
     return style;
 }
 
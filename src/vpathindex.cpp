@@ -0,0 +1,610 @@
+#include "vpathindex.h"
+
+#include <algorithm>
+
+#include <QDebug>
+#include <QDir>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCoreApplication>
+#include <QPair>
+
+#include "vnotebook.h"
+#include "vnotebooksnapshot.h"
+#include "vconstants.h"
+#include "utils/vutils.h"
+
+// Scores of fuzzy matching.
+#define CONSECUTIVE_BONUS 8
+#define WORD_START_BONUS 6
+#define PREFIX_BONUS 4
+#define MAX_GAP_PENALTY 3
+
+// Positions of the first character of the keyword to try.
+#define MAX_FUZZY_STARTS 8
+
+namespace
+{
+// A match not yet materialized.
+struct Candidate
+{
+    int m_score;
+
+    int m_notebook;
+
+    int m_entry;
+};
+
+bool isWordStart(const QString &p_text, int p_idx)
+{
+    if (p_idx == 0) {
+        return true;
+    }
+
+    QChar pre = p_text[p_idx - 1];
+    QChar ch = p_text[p_idx];
+    switch (pre.unicode()) {
+    case '/':
+    case '\\':
+    case '_':
+    case '-':
+    case '.':
+    case ' ':
+        return true;
+
+    default:
+        break;
+    }
+
+    return (ch.isUpper() && pre.isLower())
+           || (ch.isDigit() && !pre.isDigit());
+}
+}
+
+VPathIndex::VPathIndex(QObject *p_parent)
+    : QObject(p_parent)
+{
+}
+
+VPathIndex::~VPathIndex()
+{
+    for (auto builder : m_builders) {
+        builder->stop();
+        builder->wait();
+    }
+}
+
+VPathIndex *VPathIndex::inst()
+{
+    static VPathIndex *index = new VPathIndex(QCoreApplication::instance());
+    return index;
+}
+
+bool VPathIndex::isReady(const VNotebook *p_notebook)
+{
+    NotebookIndex &index = m_indexes[p_notebook->getPath()];
+    if (!index.m_ready && !index.m_building) {
+        build(p_notebook->getPath(), p_notebook->getSnapshot(), index);
+    }
+
+    return index.m_ready;
+}
+
+void VPathIndex::build(const QString &p_notebookPath,
+                       const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                       NotebookIndex &p_index)
+{
+    p_index.m_building = true;
+    p_index.m_dirty = false;
+
+    VPathIndexBuilder *builder = new VPathIndexBuilder(p_notebookPath, p_snapshot, this);
+    connect(builder, &QThread::finished,
+            this, &VPathIndex::handleBuilderFinished);
+    m_builders.insert(builder);
+    builder->start(QThread::LowPriority);
+}
+
+void VPathIndex::handleBuilderFinished()
+{
+    VPathIndexBuilder *builder = static_cast<VPathIndexBuilder *>(sender());
+    m_builders.remove(builder);
+    builder->deleteLater();
+
+    auto it = m_indexes.find(builder->notebookPath());
+    if (it == m_indexes.end()) {
+        return;
+    }
+
+    NotebookIndex &index = it.value();
+    index.m_building = false;
+    if (index.m_dirty || !builder->succeeded()) {
+        // Changes during the walk may be missed.
+        build(builder->notebookPath(), builder->snapshot(), index);
+        return;
+    }
+
+    index.m_entries = builder->entries();
+    index.m_ready = true;
+
+    qDebug() << "path index built for notebook" << builder->notebookPath()
+             << "entries" << index.m_entries.size();
+}
+
+VPathIndex::NotebookIndex *VPathIndex::readyIndex(const VNotebook *p_notebook)
+{
+    auto it = m_indexes.find(p_notebook->getPath());
+    if (it == m_indexes.end()) {
+        return NULL;
+    }
+
+    NotebookIndex &index = it.value();
+    if (index.m_building) {
+        index.m_dirty = true;
+    }
+
+    return index.m_ready ? &index : NULL;
+}
+
+void VPathIndex::addEntry(const VNotebook *p_notebook,
+                          const QString &p_relativePath,
+                          bool p_isFolder)
+{
+    NotebookIndex *index = readyIndex(p_notebook);
+    if (!index) {
+        return;
+    }
+
+    Entry entry;
+    entry.m_relativePath = QDir::cleanPath(p_relativePath);
+    entry.m_name = VUtils::fileNameFromPath(entry.m_relativePath);
+    entry.m_isFolder = p_isFolder;
+    index->m_entries.append(entry);
+}
+
+void VPathIndex::removeEntry(const VNotebook *p_notebook, const QString &p_relativePath)
+{
+    NotebookIndex *index = readyIndex(p_notebook);
+    if (!index) {
+        return;
+    }
+
+    QString path = QDir::cleanPath(p_relativePath);
+    auto &entries = index->m_entries;
+    entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                 [&path](const Entry &p_entry) {
+                                     return isWithin(p_entry.m_relativePath, path);
+                                 }),
+                  entries.end());
+}
+
+void VPathIndex::moveEntry(const VNotebook *p_notebook,
+                           const QString &p_oldPath,
+                           const QString &p_newPath)
+{
+    NotebookIndex *index = readyIndex(p_notebook);
+    if (!index) {
+        return;
+    }
+
+    QString oldPath = QDir::cleanPath(p_oldPath);
+    QString newPath = QDir::cleanPath(p_newPath);
+    for (auto & entry : index->m_entries) {
+        if (isWithin(entry.m_relativePath, oldPath)) {
+            entry.m_relativePath = newPath + entry.m_relativePath.mid(oldPath.size());
+            entry.m_name = VUtils::fileNameFromPath(entry.m_relativePath);
+        }
+    }
+}
+
+void VPathIndex::moveEntry(const VNotebook *p_oldNotebook,
+                           const QString &p_oldPath,
+                           const VNotebook *p_newNotebook,
+                           const QString &p_newPath)
+{
+    if (p_oldNotebook == p_newNotebook) {
+        moveEntry(p_oldNotebook, p_oldPath, p_newPath);
+        return;
+    }
+
+    QString oldPath = QDir::cleanPath(p_oldPath);
+    QString newPath = QDir::cleanPath(p_newPath);
+
+    QVector<Entry> moved;
+    NotebookIndex *oldIndex = readyIndex(p_oldNotebook);
+    if (oldIndex) {
+        auto &entries = oldIndex->m_entries;
+        auto it = std::stable_partition(entries.begin(), entries.end(),
+                                        [&oldPath](const Entry &p_entry) {
+                                            return !isWithin(p_entry.m_relativePath, oldPath);
+                                        });
+        for (auto mit = it; mit != entries.end(); ++mit) {
+            Entry entry = *mit;
+            entry.m_relativePath = newPath + entry.m_relativePath.mid(oldPath.size());
+            entry.m_name = VUtils::fileNameFromPath(entry.m_relativePath);
+            moved.append(entry);
+        }
+
+        entries.erase(it, entries.end());
+    }
+
+    NotebookIndex *newIndex = readyIndex(p_newNotebook);
+    if (!newIndex) {
+        return;
+    }
+
+    if (oldIndex) {
+        newIndex->m_entries += moved;
+    } else {
+        // The entries of the children are unknown.
+        invalidate(p_newNotebook);
+    }
+}
+
+void VPathIndex::updateFolder(const VNotebook *p_notebook,
+                              const QString &p_folder,
+                              const QJsonObject &p_configJson)
+{
+    NotebookIndex *index = readyIndex(p_notebook);
+    if (!index) {
+        return;
+    }
+
+    QString folder = QDir::cleanPath(p_folder);
+    if (folder == ".") {
+        folder.clear();
+    }
+
+    QSet<QString> files;
+    QJsonArray fileJson = p_configJson[DirConfig::c_files].toArray();
+    for (int i = 0; i < fileJson.size(); ++i) {
+        files.insert(fileJson[i].toObject()[DirConfig::c_name].toString());
+    }
+
+    QSet<QString> subDirs;
+    QJsonArray dirJson = p_configJson[DirConfig::c_subDirectories].toArray();
+    for (int i = 0; i < dirJson.size(); ++i) {
+        subDirs.insert(dirJson[i].toObject()[DirConfig::c_name].toString());
+    }
+
+    // Drop the children gone and keep those still there.
+    QStringList removed;
+    auto &entries = index->m_entries;
+    for (auto const & entry : entries) {
+        int idx = entry.m_relativePath.lastIndexOf('/');
+        QString parent = idx == -1 ? QString() : entry.m_relativePath.left(idx);
+        if (parent != folder) {
+            continue;
+        }
+
+        QSet<QString> &names = entry.m_isFolder ? subDirs : files;
+        if (!names.remove(entry.m_name)) {
+            removed.append(entry.m_relativePath);
+        }
+    }
+
+    if (!removed.isEmpty()) {
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [&removed](const Entry &p_entry) {
+                                         for (auto const & path : removed) {
+                                             if (isWithin(p_entry.m_relativePath, path)) {
+                                                 return true;
+                                             }
+                                         }
+
+                                         return false;
+                                     }),
+                      entries.end());
+    }
+
+    // Add the new children.
+    for (auto const & name : files) {
+        Entry entry;
+        entry.m_name = name;
+        entry.m_relativePath = QDir::cleanPath(QDir(folder).filePath(name));
+        entries.append(entry);
+    }
+
+    QDir notebookDir(p_notebook->getPath());
+    for (auto const & name : subDirs) {
+        Entry entry;
+        entry.m_name = name;
+        entry.m_relativePath = QDir::cleanPath(QDir(folder).filePath(name));
+        entry.m_isFolder = true;
+        entries.append(entry);
+
+        VPathIndexBuilder::walk(p_notebook->getSnapshot(),
+                                notebookDir.filePath(entry.m_relativePath),
+                                entry.m_relativePath,
+                                entries);
+    }
+}
+
+void VPathIndex::invalidate(const VNotebook *p_notebook)
+{
+    auto it = m_indexes.find(p_notebook->getPath());
+    if (it == m_indexes.end()) {
+        return;
+    }
+
+    // Keep the stale entries until the new ones are ready.
+    NotebookIndex &index = it.value();
+    if (index.m_building) {
+        index.m_dirty = true;
+    } else {
+        build(p_notebook->getPath(), p_notebook->getSnapshot(), index);
+    }
+}
+
+bool VPathIndex::search(const QVector<VNotebook *> &p_notebooks,
+                        const QString &p_keyword,
+                        bool p_path,
+                        int p_limit,
+                        QVector<Match> &p_matches)
+{
+    p_matches.clear();
+
+    bool ready = true;
+    for (auto const & nb : p_notebooks) {
+        if (nb && !isReady(nb)) {
+            ready = false;
+        }
+    }
+
+    if (!ready) {
+        return false;
+    }
+
+    // Follow the syntax of VSearchConfig.
+    QStringList args = VUtils::parseCombinedArgString(p_keyword);
+    Qt::CaseSensitivity cs = Qt::CaseInsensitive;
+    bool orOp = false;
+    QStringList tokens;
+    for (auto const & arg : args) {
+        if (arg == "\\C") {
+            cs = Qt::CaseSensitive;
+        } else if (arg == "\\c") {
+            cs = Qt::CaseInsensitive;
+        } else if (arg == "\\R") {
+            return false;
+        } else if (arg == "\\r" || arg == "\\f" || arg == "\\F"
+                   || arg == "\\w" || arg == "\\W") {
+            continue;
+        } else if (arg == QStringLiteral("&&")) {
+            orOp = false;
+        } else if (arg == QStringLiteral("||")) {
+            orOp = true;
+        } else {
+            tokens.append(arg);
+        }
+    }
+
+    if (tokens.isEmpty()) {
+        return true;
+    }
+
+    QVector<const NotebookIndex *> indexes;
+    QVector<Candidate> candidates;
+    for (auto const & nb : p_notebooks) {
+        if (!nb) {
+            continue;
+        }
+
+        const NotebookIndex &index = m_indexes[nb->getPath()];
+        const auto &entries = index.m_entries;
+        for (int i = 0; i < entries.size(); ++i) {
+            const QString &text = p_path ? entries[i].m_relativePath : entries[i].m_name;
+            int score = -1;
+            for (auto const & token : tokens) {
+                int sc = fuzzyScore(token, text, cs);
+                if (orOp) {
+                    score = qMax(score, sc);
+                } else if (sc < 0) {
+                    score = -1;
+                    break;
+                } else {
+                    score = qMax(score, 0) + sc;
+                }
+            }
+
+            if (score >= 0) {
+                Candidate cand;
+                cand.m_score = score;
+                cand.m_notebook = indexes.size();
+                cand.m_entry = i;
+                candidates.append(cand);
+            }
+        }
+
+        indexes.append(&index);
+    }
+
+    auto lessThan = [&indexes](const Candidate &p_a, const Candidate &p_b) {
+        if (p_a.m_score != p_b.m_score) {
+            return p_a.m_score > p_b.m_score;
+        }
+
+        const QString &pa = indexes[p_a.m_notebook]->m_entries[p_a.m_entry].m_relativePath;
+        const QString &pb = indexes[p_b.m_notebook]->m_entries[p_b.m_entry].m_relativePath;
+        if (pa.size() != pb.size()) {
+            return pa.size() < pb.size();
+        }
+
+        return pa < pb;
+    };
+
+    int cnt = candidates.size();
+    if (p_limit > 0 && p_limit < cnt) {
+        cnt = p_limit;
+    }
+
+    std::partial_sort(candidates.begin(), candidates.begin() + cnt, candidates.end(), lessThan);
+
+    // Map index back to notebook path.
+    QVector<QDir> dirs;
+    for (auto const & nb : p_notebooks) {
+        if (nb) {
+            dirs.append(QDir(nb->getPath()));
+        }
+    }
+
+    p_matches.reserve(cnt);
+    for (int i = 0; i < cnt; ++i) {
+        const Candidate &cand = candidates[i];
+        const Entry &entry = indexes[cand.m_notebook]->m_entries[cand.m_entry];
+        Match match;
+        match.m_name = entry.m_name;
+        match.m_path = dirs[cand.m_notebook].filePath(entry.m_relativePath);
+        match.m_isFolder = entry.m_isFolder;
+        match.m_score = cand.m_score;
+        p_matches.append(match);
+    }
+
+    return true;
+}
+
+int VPathIndex::fuzzyScore(const QString &p_keyword,
+                           const QString &p_text,
+                           Qt::CaseSensitivity p_cs)
+{
+    const int kwSize = p_keyword.size();
+    const int textSize = p_text.size();
+    if (kwSize == 0) {
+        return 0;
+    }
+
+    if (kwSize > textSize) {
+        return -1;
+    }
+
+    bool ci = p_cs == Qt::CaseInsensitive;
+    auto equal = [ci](QChar p_a, QChar p_b) {
+        return p_a == p_b || (ci && p_a.toLower() == p_b.toLower());
+    };
+
+    int best = -1;
+    int tries = 0;
+    for (int start = 0; start <= textSize - kwSize && tries < MAX_FUZZY_STARTS; ++start) {
+        if (!equal(p_text[start], p_keyword[0])) {
+            continue;
+        }
+
+        ++tries;
+
+        // Greedy from @start.
+        int score = 0;
+        int prev = -1;
+        int k = 0;
+        for (int j = start; j < textSize && k < kwSize; ++j) {
+            if (!equal(p_text[j], p_keyword[k])) {
+                continue;
+            }
+
+            score += 1;
+            if (prev != -1) {
+                if (j == prev + 1) {
+                    score += CONSECUTIVE_BONUS;
+                } else {
+                    score -= qMin(j - prev - 1, MAX_GAP_PENALTY);
+                }
+            }
+
+            if (isWordStart(p_text, j)) {
+                score += WORD_START_BONUS;
+            }
+
+            prev = j;
+            ++k;
+        }
+
+        if (k < kwSize) {
+            // Any later start could not match either.
+            break;
+        }
+
+        if (start == 0) {
+            score += PREFIX_BONUS;
+        }
+
+        best = qMax(best, score);
+    }
+
+    if (best < 0) {
+        return -1;
+    }
+
+    // Shorter text is closer.
+    return qMax(0, best * 4 - textSize / 8);
+}
+
+bool VPathIndex::isWithin(const QString &p_path, const QString &p_folder)
+{
+    return p_path.startsWith(p_folder)
+           && (p_path.size() == p_folder.size() || p_path[p_folder.size()] == '/');
+}
+
+
+VPathIndexBuilder::VPathIndexBuilder(const QString &p_notebookPath,
+                                     const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                                     QObject *p_parent)
+    : QThread(p_parent),
+      m_notebookPath(p_notebookPath),
+      m_snapshot(p_snapshot),
+      m_stop(0),
+      m_succeeded(false)
+{
+}
+
+void VPathIndexBuilder::stop()
+{
+    m_stop.store(1);
+}
+
+void VPathIndexBuilder::run()
+{
+    m_succeeded = walk(m_snapshot, m_notebookPath, QString(), m_entries, &m_stop);
+}
+
+bool VPathIndexBuilder::walk(const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                             const QString &p_path,
+                             const QString &p_relativePath,
+                             QVector<VPathIndex::Entry> &p_entries,
+                             const QAtomicInt *p_stop)
+{
+    // Pairs of absolute path and relative path.
+    QVector<QPair<QString, QString>> folders;
+    folders.append(qMakePair(p_path, p_relativePath));
+    while (!folders.isEmpty()) {
+        if (p_stop && p_stop->load() == 1) {
+            return false;
+        }
+
+        QPair<QString, QString> folder = folders.takeLast();
+        QJsonObject configJson = p_snapshot->readDirectoryConfig(folder.first);
+        if (configJson.isEmpty()) {
+            qWarning() << "invalid directory configuration in path" << folder.first;
+            continue;
+        }
+
+        QDir dir(folder.first);
+        QJsonArray fileJson = configJson[DirConfig::c_files].toArray();
+        for (int i = 0; i < fileJson.size(); ++i) {
+            VPathIndex::Entry entry;
+            entry.m_name = fileJson[i].toObject()[DirConfig::c_name].toString();
+            entry.m_relativePath = QDir::cleanPath(QDir(folder.second).filePath(entry.m_name));
+            p_entries.append(entry);
+        }
+
+        QJsonArray dirJson = configJson[DirConfig::c_subDirectories].toArray();
+        for (int i = dirJson.size() - 1; i >= 0; --i) {
+            VPathIndex::Entry entry;
+            entry.m_name = dirJson[i].toObject()[DirConfig::c_name].toString();
+            entry.m_relativePath = QDir::cleanPath(QDir(folder.second).filePath(entry.m_name));
+            entry.m_isFolder = true;
+            p_entries.append(entry);
+
+            folders.append(qMakePair(dir.filePath(entry.m_name), entry.m_relativePath));
+        }
+    }
+
+    return true;
+}
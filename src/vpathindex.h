@@ -0,0 +1,214 @@
+#ifndef VPATHINDEX_H
+#define VPATHINDEX_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QThread>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QJsonObject>
+
+class VNotebook;
+class VNotebookSnapshot;
+class VPathIndexBuilder;
+
+// In-memory index of the names and paths of all the folders and notes of
+// notebooks for fuzzy finding in the universal entry.
+// Each notebook is walked once in the background from its snapshot, then kept
+// in sync with the changes made within VNote and the folders changed on disk.
+// Should be accessed only in the GUI thread.
+class VPathIndex : public QObject
+{
+    Q_OBJECT
+public:
+    struct Entry
+    {
+        Entry()
+            : m_isFolder(false)
+        {
+        }
+
+        QString m_name;
+
+        // Relative to the notebook.
+        QString m_relativePath;
+
+        bool m_isFolder;
+    };
+
+    struct Match
+    {
+        Match()
+            : m_isFolder(false),
+              m_score(0)
+        {
+        }
+
+        QString m_name;
+
+        // Absolute path.
+        QString m_path;
+
+        bool m_isFolder;
+
+        int m_score;
+    };
+
+    static VPathIndex *inst();
+
+    ~VPathIndex();
+
+    // Whether @p_notebook is indexed. Start to index it in background if not.
+    bool isReady(const VNotebook *p_notebook);
+
+    // Fuzzy search @p_keyword against the names, or the relative paths if
+    // @p_path, of the folders and notes of @p_notebooks.
+    // @p_matches: at most @p_limit matches with the best ones first.
+    // Returns false if any notebook is not ready or @p_keyword asks for a
+    // regular expression, which should be handled by VSearch.
+    bool search(const QVector<VNotebook *> &p_notebooks,
+                const QString &p_keyword,
+                bool p_path,
+                int p_limit,
+                QVector<Match> &p_matches);
+
+    // Folder or note @p_relativePath is added to @p_notebook.
+    void addEntry(const VNotebook *p_notebook, const QString &p_relativePath, bool p_isFolder);
+
+    // Folder or note @p_relativePath is removed from @p_notebook, with its children.
+    void removeEntry(const VNotebook *p_notebook, const QString &p_relativePath);
+
+    // Folder or note @p_oldPath is renamed or moved to @p_newPath, with its children.
+    void moveEntry(const VNotebook *p_notebook, const QString &p_oldPath, const QString &p_newPath);
+
+    // Folder or note @p_oldPath of @p_oldNotebook is moved to @p_newPath of
+    // @p_newNotebook, with its children.
+    void moveEntry(const VNotebook *p_oldNotebook,
+                   const QString &p_oldPath,
+                   const VNotebook *p_newNotebook,
+                   const QString &p_newPath);
+
+    // Folder @p_folder of @p_notebook is changed on disk to @p_configJson.
+    // Update its children and walk only its new sub-folders.
+    void updateFolder(const VNotebook *p_notebook,
+                      const QString &p_folder,
+                      const QJsonObject &p_configJson);
+
+    // Index @p_notebook again in background.
+    void invalidate(const VNotebook *p_notebook);
+
+    // Score of @p_text containing @p_keyword as a subsequence, or -1 if not.
+    // Consecutive characters and those at the start of words score higher.
+    static int fuzzyScore(const QString &p_keyword,
+                          const QString &p_text,
+                          Qt::CaseSensitivity p_cs);
+
+private slots:
+    void handleBuilderFinished();
+
+private:
+    struct NotebookIndex
+    {
+        NotebookIndex()
+            : m_ready(false),
+              m_building(false),
+              m_dirty(false)
+        {
+        }
+
+        QVector<Entry> m_entries;
+
+        bool m_ready;
+
+        bool m_building;
+
+        // Changed while building.
+        bool m_dirty;
+    };
+
+    explicit VPathIndex(QObject *p_parent = nullptr);
+
+    void build(const QString &p_notebookPath,
+               const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+               NotebookIndex &p_index);
+
+    // Mark the index dirty if it is being built.
+    // Returns NULL if @p_notebook is not ready.
+    NotebookIndex *readyIndex(const VNotebook *p_notebook);
+
+    static bool isWithin(const QString &p_path, const QString &p_folder);
+
+    // Notebook path -> index.
+    QHash<QString, NotebookIndex> m_indexes;
+
+    QSet<VPathIndexBuilder *> m_builders;
+};
+
+
+// Walk all the folder configurations of a notebook to collect the entries.
+class VPathIndexBuilder : public QThread
+{
+    Q_OBJECT
+public:
+    VPathIndexBuilder(const QString &p_notebookPath,
+                      const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                      QObject *p_parent = nullptr);
+
+    void stop();
+
+    const QString &notebookPath() const;
+
+    const QSharedPointer<VNotebookSnapshot> &snapshot() const;
+
+    const QVector<VPathIndex::Entry> &entries() const;
+
+    bool succeeded() const;
+
+    // Collect the entries within folder @p_path of relative path
+    // @p_relativePath into @p_entries.
+    // Return false if stopped by @p_stop.
+    static bool walk(const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                     const QString &p_path,
+                     const QString &p_relativePath,
+                     QVector<VPathIndex::Entry> &p_entries,
+                     const QAtomicInt *p_stop = NULL);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    QString m_notebookPath;
+
+    QSharedPointer<VNotebookSnapshot> m_snapshot;
+
+    QAtomicInt m_stop;
+
+    QVector<VPathIndex::Entry> m_entries;
+
+    bool m_succeeded;
+};
+
+inline const QString &VPathIndexBuilder::notebookPath() const
+{
+    return m_notebookPath;
+}
+
+inline const QSharedPointer<VNotebookSnapshot> &VPathIndexBuilder::snapshot() const
+{
+    return m_snapshot;
+}
+
+inline const QVector<VPathIndex::Entry> &VPathIndexBuilder::entries() const
+{
+    return m_entries;
+}
+
+inline bool VPathIndexBuilder::succeeded() const
+{
+    return m_succeeded;
+}
+
+#endif // VPATHINDEX_H
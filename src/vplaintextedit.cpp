@@ -392,9 +392,7 @@ void VPlainTextEdit::paintLineNumberArea(QPaintEvent *p_event)
     int bottom = top + (int)rect.height();
     int eventTop = p_event->rect().top();
     int eventBtm = p_event->rect().bottom();
-    const int digitHeight = painter.fontMetrics().height();
     const int curBlockNumber = textCursor().block().blockNumber();
-    painter.setPen(m_lineNumberArea->getForegroundColor());
 
     // Display line number only in code block.
     if (m_lineNumberType == LineNumberType::CodeBlock) {
@@ -433,13 +431,7 @@ void VPlainTextEdit::paintLineNumberArea(QPaintEvent *p_event)
 
             if (blockState == (int)BlockState::CodeBlock) {
                 if (block.isVisible() && bottom >= eventTop) {
-                    QString numberStr = QString::number(number);
-                    painter.drawText(0,
-                                     top,
-                                     m_lineNumberArea->width(),
-                                     digitHeight,
-                                     Qt::AlignRight,
-                                     numberStr);
+                    m_lineNumberArea->drawNumber(painter, top, number, false);
                 }
 
                 ++number;
@@ -472,26 +464,7 @@ void VPlainTextEdit::paintLineNumberArea(QPaintEvent *p_event)
                 currentLine = true;
             }
 
-            QString numberStr = QString::number(number);
-
-            if (currentLine) {
-                QFont font = painter.font();
-                font.setBold(true);
-                painter.setFont(font);
-            }
-
-            painter.drawText(0,
-                             top,
-                             m_lineNumberArea->width(),
-                             digitHeight,
-                             Qt::AlignRight,
-                             numberStr);
-
-            if (currentLine) {
-                QFont font = painter.font();
-                font.setBold(false);
-                painter.setFont(font);
-            }
+            m_lineNumberArea->drawNumber(painter, top, number, currentLine);
         }
 
         block = block.next();
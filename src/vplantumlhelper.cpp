@@ -2,15 +2,29 @@
 
 #include <QDebug>
 #include <QThread>
+#include <QPointer>
+#include <QTimer>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QStandardPaths>
 
 #include "vconfigmanager.h"
+#include "vrendercache.h"
+#include "vrenderscheduler.h"
+#include "vplantumlserver.h"
 #include "utils/vprocessutils.h"
 
 extern VConfigManager *g_config;
 
-#define TaskIdProperty "PlantUMLTaskId"
-#define TaskFormatProperty "PlantUMLTaskFormat"
-#define TaskTimeStampProperty "PlantUMLTaskTimeStamp"
+// Result string of resultReady().
+static QString toResult(const QString &p_format, const QByteArray &p_data)
+{
+    if (p_format == "svg") {
+        return QString::fromLocal8Bit(p_data);
+    } else {
+        return QString::fromLocal8Bit(p_data.toBase64());
+    }
+}
 
 VPlantUMLHelper::VPlantUMLHelper(QObject *p_parent)
     : QObject(p_parent)
@@ -19,6 +33,8 @@ VPlantUMLHelper::VPlantUMLHelper(QObject *p_parent)
     if (m_customCmd.isEmpty()) {
         prepareCommand(m_program, m_args);
     }
+
+    prepareCacheSignature();
 }
 
 VPlantUMLHelper::VPlantUMLHelper(const QString &p_jar, QObject *p_parent)
@@ -28,6 +44,8 @@ VPlantUMLHelper::VPlantUMLHelper(const QString &p_jar, QObject *p_parent)
     if (m_customCmd.isEmpty()) {
         prepareCommand(m_program, m_args, p_jar);
     }
+
+    prepareCacheSignature();
 }
 
 void VPlantUMLHelper::processAsync(int p_id,
@@ -35,30 +53,75 @@ void VPlantUMLHelper::processAsync(int p_id,
                                    const QString &p_format,
                                    const QString &p_text)
 {
-    QProcess *process = new QProcess(this);
-    process->setProperty(TaskIdProperty, p_id);
-    process->setProperty(TaskTimeStampProperty, p_timeStamp);
-    process->setProperty(TaskFormatProperty, p_format);
-    connect(process, SIGNAL(finished(int, QProcess::ExitStatus)),
-            this, SLOT(handleProcessFinished(int, QProcess::ExitStatus)));
+    QByteArray cacheKey = VRenderCache::key(m_cacheSignature, p_format, p_text);
+    QByteArray data;
+    if (VRenderCache::lookup(cacheKey, data)) {
+        // Keep the result asynchronous.
+        QString result = toResult(p_format, data);
+        QTimer::singleShot(0, this, [this, p_id, p_timeStamp, p_format, result]() {
+            emit resultReady(p_id, p_timeStamp, p_format, result);
+        });
+        return;
+    }
+
+    if (m_customCmd.isEmpty() && VPlantUMLServer::isEnabled()) {
+        QPointer<VPlantUMLHelper> helper(this);
+        auto func = [helper, p_id, p_timeStamp, p_format, cacheKey](bool p_ok, const QByteArray &p_data) {
+            if (!helper) {
+                return;
+            }
+
+            if (p_ok) {
+                VRenderCache::insert(cacheKey, p_data);
+            }
+
+            emit helper->resultReady(p_id, p_timeStamp, p_format, toResult(p_format, p_data));
+        };
+
+        VPlantUMLServer::inst()->render(m_program, m_args, p_format, p_text, func);
+        return;
+    }
 
     if (m_customCmd.isEmpty()) {
         QStringList args(m_args);
         args << ("-t" + p_format);
-        qDebug() << m_program << args;
-        process->start(m_program, args);
+        scheduleProcess(p_id, p_timeStamp, p_format, cacheKey, m_program, args, p_text);
     } else {
         QString cmd(m_customCmd);
         cmd.replace("%0", p_format);
-        qDebug() << cmd;
-        process->start(cmd);
-    }
-
-    if (process->write(p_text.toUtf8()) == -1) {
-        qWarning() << "fail to write to QProcess:" << process->errorString();
+        scheduleProcess(p_id, p_timeStamp, p_format, cacheKey, cmd, QStringList(), p_text);
     }
+}
 
-    process->closeWriteChannel();
+void VPlantUMLHelper::scheduleProcess(int p_id,
+                                      TimeStamp p_timeStamp,
+                                      const QString &p_format,
+                                      const QByteArray &p_cacheKey,
+                                      const QString &p_program,
+                                      const QStringList &p_args,
+                                      const QString &p_text)
+{
+    auto func = [this, p_id, p_timeStamp, p_format, p_cacheKey](int p_exitCode,
+                                                                QProcess::ExitStatus p_exitStatus,
+                                                                const QByteArray &p_out,
+                                                                const QByteArray &p_err) {
+        handleProcessFinished(p_id,
+                              p_timeStamp,
+                              p_format,
+                              p_cacheKey,
+                              p_exitCode,
+                              p_exitStatus,
+                              p_out,
+                              p_err);
+    };
+
+    // The scheduler will not call @func once this helper is destroyed.
+    VRenderScheduler::inst()->schedule(this,
+                                       p_timeStamp,
+                                       p_program,
+                                       p_args,
+                                       p_text.toUtf8(),
+                                       func);
 }
 
 void VPlantUMLHelper::prepareCommand(QString &p_program,
@@ -85,16 +148,53 @@ void VPlantUMLHelper::prepareCommand(QString &p_program,
     p_args << g_config->getPlantUMLArgs();
 }
 
-void VPlantUMLHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+// File path and modified time of @p_file to tell its version.
+static QString fileSignature(const QString &p_file)
+{
+    QFileInfo info(p_file);
+    if (!info.isAbsolute()) {
+        QString exe = QStandardPaths::findExecutable(p_file);
+        if (!exe.isEmpty()) {
+            info.setFile(exe);
+        }
+    }
+
+    return QString("%1@%2").arg(info.absoluteFilePath())
+                           .arg(info.lastModified().toMSecsSinceEpoch());
+}
+
+void VPlantUMLHelper::prepareCacheSignature()
+{
+    if (m_customCmd.isEmpty()) {
+        // The jar and the Dot determine the output.
+        QString jar;
+        int idx = m_args.indexOf("-jar");
+        if (idx > -1 && idx + 1 < m_args.size()) {
+            jar = m_args[idx + 1];
+        }
+
+        m_cacheSignature = QString("plantuml\n%1\n%2\n%3")
+                             .arg(fileSignature(jar))
+                             .arg(fileSignature(g_config->getGraphvizDot()))
+                             .arg(m_args.join(' '));
+    } else {
+        m_cacheSignature = QString("plantuml\n%1").arg(m_customCmd);
+    }
+}
+
+void VPlantUMLHelper::handleProcessFinished(int p_id,
+                                            TimeStamp p_timeStamp,
+                                            const QString &p_format,
+                                            const QByteArray &p_cacheKey,
+                                            int p_exitCode,
+                                            QProcess::ExitStatus p_exitStatus,
+                                            const QByteArray &p_out,
+                                            const QByteArray &p_err)
 {
-    QProcess *process = static_cast<QProcess *>(sender());
-    int id = process->property(TaskIdProperty).toInt();
-    QString format = process->property(TaskFormatProperty).toString();
-    TimeStamp timeStamp = process->property(TaskTimeStampProperty).toULongLong();
     qDebug() << QString("PlantUML finished: id %1 timestamp %2 format %3 exitcode %4 exitstatus %5")
-                       .arg(id)
-                       .arg(timeStamp)
-                       .arg(format)
+                       .arg(p_id)
+                       .arg(p_timeStamp)
+                       .arg(p_format)
                        .arg(p_exitCode)
                        .arg(p_exitStatus);
     bool failed = true;
@@ -103,20 +203,18 @@ void VPlantUMLHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus
             qWarning() << "PlantUML fail" << p_exitCode;
         } else {
             failed = false;
-            QByteArray outBa = process->readAllStandardOutput();
-            if (format == "svg") {
-                emit resultReady(id, timeStamp, format, QString::fromLocal8Bit(outBa));
-            } else {
-                emit resultReady(id, timeStamp, format, QString::fromLocal8Bit(outBa.toBase64()));
+            if (p_exitCode == 0) {
+                VRenderCache::insert(p_cacheKey, p_out);
             }
+
+            emit resultReady(p_id, p_timeStamp, p_format, toResult(p_format, p_out));
         }
     } else {
         qWarning() << "fail to start PlantUML process" << p_exitCode << p_exitStatus;
     }
 
-    QByteArray errBa = process->readAllStandardError();
-    if (!errBa.isEmpty()) {
-        QString errStr(QString::fromLocal8Bit(errBa));
+    if (!p_err.isEmpty()) {
+        QString errStr(QString::fromLocal8Bit(p_err));
         if (failed) {
             qWarning() << "PlantUML stderr:" << errStr;
         } else {
@@ -125,10 +223,8 @@ void VPlantUMLHelper::handleProcessFinished(int p_exitCode, QProcess::ExitStatus
     }
 
     if (failed) {
-        emit resultReady(id, timeStamp, format, "");
+        emit resultReady(p_id, p_timeStamp, p_format, "");
     }
-
-    process->deleteLater();
 }
 
 bool VPlantUMLHelper::testPlantUMLJar(const QString &p_jar, QString &p_msg)
@@ -162,6 +258,12 @@ QByteArray VPlantUMLHelper::process(const QString &p_format, const QString &p_te
 {
     VPlantUMLHelper inst;
 
+    QByteArray cacheKey = VRenderCache::key(inst.m_cacheSignature, p_format, p_text);
+    QByteArray data;
+    if (VRenderCache::lookup(cacheKey, data)) {
+        return data;
+    }
+
     int exitCode = -1;
     QByteArray out, err;
     int ret = -1;
@@ -186,6 +288,8 @@ QByteArray VPlantUMLHelper::process(const QString &p_format, const QString &p_te
 
     if (ret != 0 || exitCode < 0) {
         qWarning() << "PlantUML fail" << ret << exitCode << QString::fromLocal8Bit(err);
+    } else if (exitCode == 0) {
+        VRenderCache::insert(cacheKey, out);
     }
 
     return out;
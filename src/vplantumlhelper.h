@@ -33,10 +33,27 @@ signals:
                      const QString &p_format,
                      const QString &p_result);
 
-private slots:
-    void handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
-
 private:
+    // Run the renderer process via VRenderScheduler.
+    void scheduleProcess(int p_id,
+                         TimeStamp p_timeStamp,
+                         const QString &p_format,
+                         const QByteArray &p_cacheKey,
+                         const QString &p_program,
+                         const QStringList &p_args,
+                         const QString &p_text);
+
+    void handleProcessFinished(int p_id,
+                               TimeStamp p_timeStamp,
+                               const QString &p_format,
+                               const QByteArray &p_cacheKey,
+                               int p_exitCode,
+                               QProcess::ExitStatus p_exitStatus,
+                               const QByteArray &p_out,
+                               const QByteArray &p_err);
+
+    void prepareCacheSignature();
+
     VPlantUMLHelper(const QString &p_jar, QObject *p_parent = nullptr);
 
     void prepareCommand(QString &p_cmd, QStringList &p_args, const QString &p_jar= QString()) const;
@@ -47,6 +64,9 @@ private:
 
     // When not empty, @m_program and @m_args will be ignored.
     QString m_customCmd;
+
+    // Identify the renderer and its version in the render cache.
+    QString m_cacheSignature;
 };
 
 #endif // VPLANTUMLHELPER_H
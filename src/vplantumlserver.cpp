@@ -0,0 +1,319 @@
+#include "vplantumlserver.h"
+
+#include <QDebug>
+#include <QTimer>
+#include <QCoreApplication>
+
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Printed by PlantUML after each output in pipe mode.
+#define PIPE_DELIMITER "VNOTE_PLANTUML_PIPE_DELIMITER"
+
+// Kill the process if one render takes longer than this (ms).
+#define PIPE_RENDER_TIMEOUT 30000
+
+VPlantUMLPipe::VPlantUMLPipe(const QString &p_program,
+                             const QStringList &p_args,
+                             QObject *p_parent)
+    : QObject(p_parent),
+      m_program(p_program),
+      m_args(p_args),
+      m_process(NULL),
+      m_busy(false),
+      m_retried(false)
+{
+    m_args << "-pipedelimitor" << PIPE_DELIMITER;
+
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(PIPE_RENDER_TIMEOUT);
+    connect(m_timer, &QTimer::timeout,
+            this, &VPlantUMLPipe::handleTimeout);
+}
+
+VPlantUMLPipe::~VPlantUMLPipe()
+{
+    stopProcess();
+}
+
+bool VPlantUMLPipe::startProcess()
+{
+    Q_ASSERT(!m_process);
+    m_process = new QProcess(this);
+    connect(m_process, &QProcess::readyReadStandardOutput,
+            this, &VPlantUMLPipe::handleReadyReadStandardOutput);
+    connect(m_process, &QProcess::readyReadStandardError,
+            this, &VPlantUMLPipe::handleReadyReadStandardError);
+    connect(m_process, SIGNAL(finished(int, QProcess::ExitStatus)),
+            this, SLOT(handleProcessFinished(int, QProcess::ExitStatus)));
+
+    qDebug() << "start PlantUML pipe" << m_program << m_args;
+
+    m_stdout.clear();
+    m_stderr.clear();
+    m_process->start(m_program, m_args);
+    if (!m_process->waitForStarted()) {
+        qWarning() << "fail to start PlantUML pipe" << m_process->errorString();
+        stopProcess();
+        return false;
+    }
+
+    return true;
+}
+
+void VPlantUMLPipe::stopProcess()
+{
+    if (!m_process) {
+        return;
+    }
+
+    m_process->disconnect(this);
+    if (m_process->state() != QProcess::NotRunning) {
+        m_process->kill();
+        m_process->waitForFinished(1000);
+    }
+
+    m_process->deleteLater();
+    m_process = NULL;
+}
+
+void VPlantUMLPipe::render(const QString &p_text, const PlantUMLResultFunc &p_func)
+{
+    Q_ASSERT(!m_busy);
+    m_busy = true;
+    m_retried = false;
+    m_func = p_func;
+
+    // Pipe mode splits the input by @startxxx and @endxxx.
+    if (p_text.trimmed().startsWith("@start")) {
+        m_text = p_text;
+    } else {
+        m_text = QString("@startuml\n%1\n@enduml").arg(p_text);
+    }
+
+    if (!m_text.endsWith('\n')) {
+        m_text += '\n';
+    }
+
+    if (!m_process && !startProcess()) {
+        finish(false, QByteArray());
+        return;
+    }
+
+    m_stderr.clear();
+    m_timer->start();
+    if (m_process->write(m_text.toUtf8()) == -1) {
+        qWarning() << "fail to write to PlantUML pipe:" << m_process->errorString();
+    }
+}
+
+void VPlantUMLPipe::handleReadyReadStandardOutput()
+{
+    m_stdout += m_process->readAllStandardOutput();
+    if (!m_busy) {
+        // Outputs of a killed request.
+        m_stdout.clear();
+        return;
+    }
+
+    int idx = m_stdout.indexOf(PIPE_DELIMITER);
+    if (idx == -1) {
+        return;
+    }
+
+    QByteArray data = m_stdout.left(idx);
+    while (data.endsWith('\n') || data.endsWith('\r')) {
+        data.chop(1);
+    }
+
+    int end = idx + (int)qstrlen(PIPE_DELIMITER);
+    while (end < m_stdout.size() && (m_stdout[end] == '\n' || m_stdout[end] == '\r')) {
+        ++end;
+    }
+
+    m_stdout.remove(0, end);
+
+    handleReadyReadStandardError();
+
+    if (!m_stderr.isEmpty()) {
+        qDebug() << "PlantUML pipe stderr:" << QString::fromLocal8Bit(m_stderr);
+    }
+
+    finish(m_stderr.isEmpty() && !data.isEmpty(), data);
+}
+
+void VPlantUMLPipe::handleReadyReadStandardError()
+{
+    if (m_process) {
+        m_stderr += m_process->readAllStandardError();
+    }
+}
+
+void VPlantUMLPipe::handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+{
+    qWarning() << "PlantUML pipe exited" << p_exitCode << p_exitStatus
+               << QString::fromLocal8Bit(m_stderr);
+
+    stopProcess();
+
+    if (!m_busy) {
+        return;
+    }
+
+    if (m_retried) {
+        finish(false, QByteArray());
+        return;
+    }
+
+    // Restart and retry once.
+    m_retried = true;
+    if (!startProcess()) {
+        finish(false, QByteArray());
+        return;
+    }
+
+    m_timer->start();
+    m_process->write(m_text.toUtf8());
+}
+
+void VPlantUMLPipe::handleTimeout()
+{
+    if (!m_busy) {
+        return;
+    }
+
+    qWarning() << "PlantUML pipe timeout, restart it";
+    stopProcess();
+    finish(false, QByteArray());
+}
+
+void VPlantUMLPipe::finish(bool p_ok, const QByteArray &p_data)
+{
+    m_timer->stop();
+
+    PlantUMLResultFunc func = m_func;
+    m_func = nullptr;
+    m_text.clear();
+    m_busy = false;
+
+    if (func) {
+        func(p_ok, p_data);
+    }
+
+    emit idle();
+}
+
+
+VPlantUMLServer::VPlantUMLServer(QObject *p_parent)
+    : QObject(p_parent)
+{
+}
+
+VPlantUMLServer *VPlantUMLServer::inst()
+{
+    // Destroyed with the application to kill the processes in time.
+    static VPlantUMLServer *server = new VPlantUMLServer(QCoreApplication::instance());
+    return server;
+}
+
+bool VPlantUMLServer::isEnabled()
+{
+    return g_config->getPlantUMLPipeProcesses() > 0;
+}
+
+void VPlantUMLServer::render(const QString &p_program,
+                             const QStringList &p_args,
+                             const QString &p_format,
+                             const QString &p_text,
+                             const PlantUMLResultFunc &p_func)
+{
+    updateCommand(p_program, p_args);
+
+    Request req;
+    req.m_format = p_format;
+    req.m_text = p_text;
+    req.m_func = p_func;
+    m_pendingRequests.enqueue(req);
+
+    dispatch();
+}
+
+void VPlantUMLServer::dispatch()
+{
+    for (int i = 0; i < m_pendingRequests.size();) {
+        VPlantUMLPipe *pipe = idlePipe(m_pendingRequests[i].m_format);
+        if (!pipe) {
+            ++i;
+            continue;
+        }
+
+        Request req = m_pendingRequests.takeAt(i);
+        pipe->render(req.m_text, req.m_func);
+    }
+}
+
+VPlantUMLPipe *VPlantUMLServer::idlePipe(const QString &p_format)
+{
+    int freeIdx = -1;
+    for (int i = 0; i < m_pipes.size(); ++i) {
+        const PipeInfo &info = m_pipes[i];
+        if (info.m_pipe->isBusy()) {
+            continue;
+        }
+
+        if (info.m_format == p_format) {
+            return info.m_pipe;
+        }
+
+        freeIdx = i;
+    }
+
+    if (m_pipes.size() >= g_config->getPlantUMLPipeProcesses()) {
+        if (freeIdx == -1) {
+            return NULL;
+        }
+
+        // Replace an idle pipe of another format.
+        // It may be still in its finish() call.
+        VPlantUMLPipe *pipe = m_pipes[freeIdx].m_pipe;
+        pipe->disconnect(this);
+        pipe->deleteLater();
+        m_pipes.remove(freeIdx);
+    }
+
+    QStringList args(m_args);
+    args << ("-t" + p_format);
+
+    PipeInfo info;
+    info.m_format = p_format;
+    info.m_pipe = new VPlantUMLPipe(m_program, args, this);
+    connect(info.m_pipe, &VPlantUMLPipe::idle,
+            this, &VPlantUMLServer::dispatch);
+    m_pipes.append(info);
+    return info.m_pipe;
+}
+
+void VPlantUMLServer::updateCommand(const QString &p_program, const QStringList &p_args)
+{
+    if (m_program == p_program && m_args == p_args) {
+        return;
+    }
+
+    m_program = p_program;
+    m_args = p_args;
+
+    // Busy pipes will be deleted after their current requests.
+    for (auto const & info : m_pipes) {
+        info.m_pipe->disconnect(this);
+        if (info.m_pipe->isBusy()) {
+            connect(info.m_pipe, &VPlantUMLPipe::idle,
+                    info.m_pipe, &QObject::deleteLater);
+        } else {
+            info.m_pipe->deleteLater();
+        }
+    }
+
+    m_pipes.clear();
+}
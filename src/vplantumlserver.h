@@ -0,0 +1,144 @@
+#ifndef VPLANTUMLSERVER_H
+#define VPLANTUMLSERVER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+#include <QQueue>
+#include <QVector>
+#include <QByteArray>
+#include <functional>
+
+class QTimer;
+
+// Called with the output and whether the render succeeded.
+typedef std::function<void(bool, const QByteArray &)> PlantUMLResultFunc;
+
+// A long-lived PlantUML process in pipe mode which renders requests one by
+// one, separating the outputs by a delimiter.
+// Restarted on demand after crashing or hanging.
+class VPlantUMLPipe : public QObject
+{
+    Q_OBJECT
+public:
+    VPlantUMLPipe(const QString &p_program,
+                  const QStringList &p_args,
+                  QObject *p_parent = nullptr);
+
+    ~VPlantUMLPipe();
+
+    bool isBusy() const;
+
+    // Render @p_text. @p_func will be called in any case, with false if
+    // PlantUML failed or reported errors.
+    void render(const QString &p_text, const PlantUMLResultFunc &p_func);
+
+signals:
+    // Finished a render and ready for the next one.
+    void idle();
+
+private slots:
+    void handleReadyReadStandardOutput();
+
+    void handleReadyReadStandardError();
+
+    void handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
+
+    void handleTimeout();
+
+private:
+    bool startProcess();
+
+    void stopProcess();
+
+    // Finish current request with @p_ok and @p_data.
+    void finish(bool p_ok, const QByteArray &p_data);
+
+    QString m_program;
+
+    QStringList m_args;
+
+    QProcess *m_process;
+
+    // Kill the process if one render takes too long.
+    QTimer *m_timer;
+
+    QByteArray m_stdout;
+
+    QByteArray m_stderr;
+
+    // Current request.
+    QString m_text;
+
+    PlantUMLResultFunc m_func;
+
+    bool m_busy;
+
+    // Whether current request has been retried after a crash.
+    bool m_retried;
+};
+
+inline bool VPlantUMLPipe::isBusy() const
+{
+    return m_busy;
+}
+
+
+// Pool of PlantUML pipes shared by all the editors.
+// The number of pipes bounds the number of concurrent renders.
+// Should be accessed only in the GUI thread.
+class VPlantUMLServer : public QObject
+{
+    Q_OBJECT
+public:
+    static VPlantUMLServer *inst();
+
+    // Whether to render via the pipes instead of one process per diagram.
+    static bool isEnabled();
+
+    // Render @p_text in @p_format with command @p_program and @p_args.
+    // The format should not be included in @p_args.
+    void render(const QString &p_program,
+                const QStringList &p_args,
+                const QString &p_format,
+                const QString &p_text,
+                const PlantUMLResultFunc &p_func);
+
+private slots:
+    void dispatch();
+
+private:
+    struct Request
+    {
+        QString m_format;
+
+        QString m_text;
+
+        PlantUMLResultFunc m_func;
+    };
+
+    struct PipeInfo
+    {
+        QString m_format;
+
+        VPlantUMLPipe *m_pipe;
+    };
+
+    explicit VPlantUMLServer(QObject *p_parent = nullptr);
+
+    // Get an idle pipe for @p_format, create one if possible.
+    VPlantUMLPipe *idlePipe(const QString &p_format);
+
+    // Drop all the pipes if the command changes.
+    void updateCommand(const QString &p_program, const QStringList &p_args);
+
+    QString m_program;
+
+    QStringList m_args;
+
+    QVector<PipeInfo> m_pipes;
+
+    QQueue<Request> m_pendingRequests;
+};
+
+#endif // VPLANTUMLSERVER_H
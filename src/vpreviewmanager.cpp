@@ -5,11 +5,16 @@
 #include <QUrl>
 #include <QVector>
 #include <QTextLayout>
+#include <QImageReader>
+#include <QTimer>
 
 #include "vconfigmanager.h"
 #include "utils/vutils.h"
 #include "vdownloader.h"
 #include "pegmarkdownhighlighter.h"
+#include "vimagedecoder.h"
+#include "vimageencoder.h"
+#include "vsharedimagecache.h"
 
 extern VConfigManager *g_config;
 
@@ -18,7 +23,8 @@ VPreviewManager::VPreviewManager(VMdEditor *p_editor, PegMarkdownHighlighter *p_
       m_editor(p_editor),
       m_document(p_editor->document()),
       m_highlighter(p_highlighter),
-      m_previewEnabled(false)
+      m_previewEnabled(false),
+      m_imageLinksVersion(0)
 {
     for (int i = 0; i < (int)PreviewSource::MaxNumberOfSources; ++i) {
         m_timeStamps[i] = 0;
@@ -27,40 +33,51 @@ VPreviewManager::VPreviewManager(VMdEditor *p_editor, PegMarkdownHighlighter *p_
     m_downloader = new VDownloader(this);
     connect(m_downloader, &VDownloader::downloadFinished,
             this, &VPreviewManager::imageDownloaded);
+
+    connect(VImageDecoder::inst(), &VImageDecoder::imageDecoded,
+            this, &VPreviewManager::imageDecoded);
+
+    // Coalesce the updates of decoded images.
+    m_decodedTimer = new QTimer(this);
+    m_decodedTimer->setSingleShot(true);
+    m_decodedTimer->setInterval(50);
+    connect(m_decodedTimer, &QTimer::timeout,
+            this, [this]() {
+                emit requestUpdateImageLinks();
+                m_editor->viewport()->update();
+            });
+
+    // Coalesce the relayouts of previews arrived in a row.
+    m_relayoutTimer = new QTimer(this);
+    m_relayoutTimer->setSingleShot(true);
+    m_relayoutTimer->setInterval(0);
+    connect(m_relayoutTimer, &QTimer::timeout,
+            this, &VPreviewManager::relayoutPendingBlocks);
 }
 
-void VPreviewManager::updateImageLinks(const QVector<VElementRegion> &p_imageRegions)
+void VPreviewManager::updateImageLinks(const QSharedPointer<const VDocumentStructure> &p_structure)
 {
     if (!m_previewEnabled) {
         return;
     }
 
+    bool unchanged = p_structure->isUnchangedSince(m_imageLinksVersion, VDocumentStructure::ImageLinks);
+    m_imageLinksVersion = p_structure->version();
+    if (unchanged) {
+        return;
+    }
+
     TS ts = ++timeStamp(PreviewSource::ImageLink);
-    previewImages(ts, p_imageRegions);
+    previewImages(ts, p_structure->imageRegions());
 }
 
 static QPixmap scalePreviewImage(const QPixmap &p_img, int p_width, int p_height)
 {
-    const Qt::TransformationMode tMode = Qt::SmoothTransformation;
-    qreal sf = VUtils::calculateScaleFactor();
-    if (p_width > 0) {
-        if (p_height > 0) {
-            return p_img.scaled(p_width * sf,
-                                p_height * sf,
-                                Qt::IgnoreAspectRatio,
-                                tMode);
-        } else {
-            return p_img.scaledToWidth(p_width * sf, tMode);
-        }
-    } else if (p_height > 0) {
-        return p_img.scaledToHeight(p_height * sf, tMode);
-    } else {
-        if (sf < 1.1) {
-            return p_img;
-        } else {
-            return p_img.scaledToWidth(p_img.width() * sf, tMode);
-        }
-    }
+    QImage img = VImageDecoder::scaleImage(p_img.toImage(),
+                                           p_width,
+                                           p_height,
+                                           VUtils::calculateScaleFactor());
+    return QPixmap::fromImage(img);
 }
 
 void VPreviewManager::imageDownloaded(const QByteArray &p_data, const QString &p_url)
@@ -90,6 +107,48 @@ void VPreviewManager::imageDownloaded(const QByteArray &p_data, const QString &p
     }
 }
 
+void VPreviewManager::imageDecoded(int p_id, const QImage &p_image)
+{
+    auto it = m_decodeRequests.find(p_id);
+    if (it == m_decodeRequests.end()) {
+        return;
+    }
+
+    DecodeRequest req = it.value();
+    m_decodeRequests.erase(it);
+    m_pendingDecodes.remove(req.m_name);
+
+    if (!m_previewEnabled) {
+        return;
+    }
+
+    if (p_image.isNull()) {
+        m_editor->removeImage(req.m_name);
+    } else if (req.m_key.isEmpty()) {
+        m_editor->addImage(req.m_name, QPixmap::fromImage(p_image));
+    } else {
+        m_editor->addSharedImage(req.m_name,
+                                 req.m_key,
+                                 QPixmap::fromImage(p_image),
+                                 localImageLoader(req.m_filePath, req.m_width, req.m_height));
+    }
+
+    // Let the next update clear it if it is no longer used.
+    imageCache(PreviewSource::ImageLink).insert(req.m_name, timeStamp(PreviewSource::ImageLink));
+
+    m_decodedTimer->start();
+}
+
+ImageLoaderFunc VPreviewManager::localImageLoader(const QString &p_filePath,
+                                                  int p_width,
+                                                  int p_height)
+{
+    qreal sf = VUtils::calculateScaleFactor();
+    return [p_filePath, p_width, p_height, sf]() {
+        return QPixmap::fromImage(VImageDecoder::decodeFile(p_filePath, p_width, p_height, sf));
+    };
+}
+
 void VPreviewManager::setPreviewEnabled(bool p_enabled)
 {
     if (m_previewEnabled != p_enabled) {
@@ -107,6 +166,11 @@ void VPreviewManager::setPreviewEnabled(bool p_enabled)
 
 void VPreviewManager::clearPreview()
 {
+    m_imageLinksVersion = 0;
+
+    m_decodeRequests.clear();
+    m_pendingDecodes.clear();
+
     OrderedIntSet affectedBlocks;
     for (int i = 0; i < (int)PreviewSource::MaxNumberOfSources; ++i) {
         TS ts = ++timeStamp(static_cast<PreviewSource>(i));
@@ -245,14 +309,57 @@ QString VPreviewManager::imageResourceName(const ImageLinkInfo &p_link)
     }
 
     // Add it to the resource.
-    QPixmap image;
     QString imgPath = p_link.m_linkUrl;
-    if (QFileInfo::exists(imgPath)) {
-        // Local file.
-        image = VUtils::pixmapFromFile(imgPath);
-        if (image.isNull()) {
+    QImage pendingImage = VImageEncoder::inst()->pendingImage(imgPath);
+    if (!pendingImage.isNull()) {
+        // Being written by the encoder. Preview it from memory.
+        QImage img = VImageDecoder::scaleImage(pendingImage,
+                                               p_link.m_width,
+                                               p_link.m_height,
+                                               VUtils::calculateScaleFactor());
+        m_editor->addImage(name, QPixmap::fromImage(img));
+        return name;
+    } else if (QFileInfo::exists(imgPath)) {
+        QString key = VSharedImageCache::key(imgPath,
+                                             p_link.m_width,
+                                             p_link.m_height,
+                                             VUtils::calculateScaleFactor());
+        if (VSharedImageCache::contains(key)) {
+            // Decoded for another editor already.
+            m_editor->addSharedImage(name, key, QPixmap(), ImageLoaderFunc());
+            return name;
+        }
+
+        // Local file. Decode it in the pool.
+        if (m_pendingDecodes.contains(name)) {
             return QString();
         }
+
+        DecodeRequest req;
+        req.m_name = name;
+        req.m_filePath = imgPath;
+        req.m_key = key;
+        req.m_width = p_link.m_width;
+        req.m_height = p_link.m_height;
+        int id = VImageDecoder::inst()->decode(imgPath,
+                                               req.m_width,
+                                               req.m_height,
+                                               VUtils::calculateScaleFactor());
+        m_decodeRequests.insert(id, req);
+        m_pendingDecodes.insert(name);
+
+        // Reserve the space with a placeholder if the size is known cheaply.
+        QSize size = QImageReader(imgPath).size();
+        if (!size.isValid()) {
+            return QString();
+        }
+
+        m_editor->addImagePlaceholder(name,
+                                      VImageDecoder::scaledSize(size,
+                                                                req.m_width,
+                                                                req.m_height,
+                                                                VUtils::calculateScaleFactor()));
+        return name;
     } else {
         // URL. Try to download it.
         // qrc:// files will touch this path.
@@ -265,10 +372,6 @@ QString VPreviewManager::imageResourceName(const ImageLinkInfo &p_link)
 
         return QString();
     }
-
-    m_editor->addImage(name,
-                       scalePreviewImage(image, p_link.m_width, p_link.m_height));
-    return name;
 }
 
 QString VPreviewManager::imageResourceNameForSource(PreviewSource p_source,
@@ -547,6 +650,37 @@ void VPreviewManager::checkBlocksForObsoletePreview(const QList<int> &p_blocks)
     relayout(affectedBlocks);
 }
 
+void VPreviewManager::relayout(const OrderedIntSet &p_blocks)
+{
+    if (p_blocks.isEmpty()) {
+        return;
+    }
+
+    for (auto bn = p_blocks.keyBegin(); bn != p_blocks.keyEnd(); ++bn) {
+        QTextBlock block = m_document->findBlockByNumber(*bn);
+        if (block.isValid()) {
+            m_pendingRelayoutBlocks.append(block);
+        }
+    }
+
+    m_relayoutTimer->start();
+}
+
+void VPreviewManager::relayoutPendingBlocks()
+{
+    OrderedIntSet blocks;
+    for (auto const & block : m_pendingRelayoutBlocks) {
+        if (block.isValid()) {
+            blocks.insert(block.blockNumber(), QMapDummyValue());
+        }
+    }
+
+    m_pendingRelayoutBlocks.clear();
+
+    // One relayout and document size update for all.
+    m_editor->relayout(blocks);
+}
+
 void VPreviewManager::relayoutEditor(const OrderedIntSet &p_blocks)
 {
     OrderedIntSet bs(p_blocks);
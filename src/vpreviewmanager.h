@@ -7,12 +7,15 @@
 #include <QHash>
 #include <QVector>
 #include <QSharedPointer>
+#include <QSet>
+#include <QImage>
 
 #include "markdownhighlighterdata.h"
 #include "vmdeditor.h"
 #include "vtextblockdata.h"
 
 class VDownloader;
+class QTimer;
 
 typedef long long TS;
 
@@ -80,7 +83,7 @@ public:
 
 public slots:
     // Image links were updated from the highlighter.
-    void updateImageLinks(const QVector<VElementRegion> &p_imageRegions);
+    void updateImageLinks(const QSharedPointer<const VDocumentStructure> &p_structure);
 
     void updateCodeBlocks(const QVector<QSharedPointer<VImageToPreview> > &p_images);
 
@@ -96,6 +99,9 @@ private slots:
     // Non-local image downloaded for preview.
     void imageDownloaded(const QByteArray &p_data, const QString &p_url);
 
+    // Local image decoded in the pool.
+    void imageDecoded(int p_id, const QImage &p_image);
+
 private:
     struct ImageLinkInfo
     {
@@ -185,6 +191,21 @@ private:
         int m_height;
     };
 
+    struct DecodeRequest
+    {
+        // Name in the resource manager.
+        QString m_name;
+
+        QString m_filePath;
+
+        // Key in VSharedImageCache.
+        QString m_key;
+
+        int m_width;
+
+        int m_height;
+    };
+
     // Start to preview images according to image links.
     void previewImages(TS p_timeStamp, const QVector<VElementRegion> &p_imageRegions);
 
@@ -212,6 +233,9 @@ private:
     // Returns empty if fail to add the image to the resource manager.
     QString imageResourceName(const ImageLinkInfo &p_link);
 
+    // Loader to reload the local image once evicted from the resource manager.
+    static ImageLoaderFunc localImageLoader(const QString &p_filePath, int p_width, int p_height);
+
     QString imageResourceNameForSource(PreviewSource p_source, const QSharedPointer<VImageToPreview> &p_image);
 
     QHash<QString, long long> &imageCache(PreviewSource p_source);
@@ -226,8 +250,12 @@ private:
 
     void relayoutEditor(const OrderedIntSet &p_blocks);
 
+    // Queue @p_blocks to relayout with the others arrived in the same event
+    // loop iteration in one relayout.
     void relayout(const OrderedIntSet &p_blocks);
 
+    void relayoutPendingBlocks();
+
     VMdEditor *m_editor;
 
     QTextDocument *m_document;
@@ -239,10 +267,28 @@ private:
     // Whether preview is enabled.
     bool m_previewEnabled;
 
+    // Version of the document structure of the image previews.
+    quint64 m_imageLinksVersion;
+
     // Map from URL to name in the resource manager.
     // Used for downloading images.
     QHash<QString, QSharedPointer<UrlImageInfo>> m_urlMap;
 
+    // Request ID -> request of local images being decoded.
+    QHash<int, DecodeRequest> m_decodeRequests;
+
+    // Names of the images being decoded.
+    QSet<QString> m_pendingDecodes;
+
+    // Update the preview after a batch of images decoded.
+    QTimer *m_decodedTimer;
+
+    // Blocks to relayout, kept as blocks since edits may shift the numbers
+    // before the relayout.
+    QVector<QTextBlock> m_pendingRelayoutBlocks;
+
+    QTimer *m_relayoutTimer;
+
     // Timestamp per each preview source.
     TS m_timeStamps[(int)PreviewSource::MaxNumberOfSources];
 
@@ -264,9 +310,4 @@ inline bool VPreviewManager::isPreviewEnabled() const
 {
     return m_previewEnabled;
 }
-
-inline void VPreviewManager::relayout(const OrderedIntSet &p_blocks)
-{
-    m_editor->relayout(p_blocks);
-}
 #endif // VPREVIEWMANAGER_H
@@ -1,14 +1,42 @@
 #include "vpreviewpage.h"
 
 #include <QDesktopServices>
+#include <QWebEngineProfile>
+#include <QCoreApplication>
+#include <QDir>
 
 #include "vmainwindow.h"
+#include "vconfigmanager.h"
 
 extern VMainWindow *g_mainWin;
 
-VPreviewPage::VPreviewPage(QWidget *parent) : QWebEnginePage(parent)
+extern VConfigManager *g_config;
+
+#define PROFILE_NAME "vnote_preview"
+
+#define WEB_CACHE_FOLDER_NAME "web_cache"
+
+VPreviewPage::VPreviewPage(QWidget *parent)
+    : QWebEnginePage(sharedProfile(), parent)
+{
+
+}
+
+QWebEngineProfile *VPreviewPage::sharedProfile()
 {
+    static QWebEngineProfile *profile = NULL;
+    if (!profile) {
+        // Destroyed with the application after all the pages.
+        profile = new QWebEngineProfile(PROFILE_NAME, QCoreApplication::instance());
+
+        QString folder = QDir(g_config->getConfigFolder()).filePath(WEB_CACHE_FOLDER_NAME);
+        profile->setCachePath(folder);
+        profile->setHttpCacheType(QWebEngineProfile::DiskHttpCache);
+        profile->setHttpCacheMaximumSize(g_config->getWebCacheSize() * 1024 * 1024);
+        profile->setPersistentCookiesPolicy(QWebEngineProfile::NoPersistentCookies);
+    }
 
+    return profile;
 }
 
 bool VPreviewPage::acceptNavigationRequest(const QUrl &p_url,
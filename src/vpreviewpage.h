@@ -3,12 +3,19 @@
 
 #include <QWebEnginePage>
 
+class QWebEngineProfile;
+
+// Pages of read mode and export, all sharing one persistent profile whose disk
+// HTTP cache keeps the remote resources like the online PlantUML script,
+// MathJax and fonts across sessions.
 class VPreviewPage : public QWebEnginePage
 {
     Q_OBJECT
 public:
     explicit VPreviewPage(QWidget *parent = 0);
 
+    static QWebEngineProfile *sharedProfile();
+
 protected:
     bool acceptNavigationRequest(const QUrl &p_url,
                                  NavigationType p_type,
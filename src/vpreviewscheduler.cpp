@@ -0,0 +1,147 @@
+#include "vpreviewscheduler.h"
+
+#include <algorithm>
+
+#include <QTimer>
+#include <QScrollBar>
+
+#include "veditor.h"
+
+// Number of requests far from the viewport dispatched per idle tick.
+#define IDLE_CHUNK_SIZE 4
+
+VPreviewScheduler::VPreviewScheduler(VEditor *p_editor, QObject *p_parent)
+    : QObject(p_parent),
+      m_editor(p_editor)
+{
+    m_scrollTimer = new QTimer(this);
+    m_scrollTimer->setSingleShot(true);
+    m_scrollTimer->setInterval(100);
+    connect(m_scrollTimer, &QTimer::timeout,
+            this, [this]() {
+                dispatch(false);
+            });
+
+    m_idleTimer = new QTimer(this);
+    m_idleTimer->setSingleShot(true);
+    m_idleTimer->setInterval(500);
+    connect(m_idleTimer, &QTimer::timeout,
+            this, &VPreviewScheduler::handleIdleTimeout);
+
+    QScrollBar *vbar = m_editor->verticalScrollBarW();
+    if (vbar) {
+        connect(vbar, &QScrollBar::valueChanged,
+                this, [this]() {
+                    if (!m_pending.isEmpty()) {
+                        // Defer the far ones while scrolling.
+                        m_idleTimer->stop();
+                        m_scrollTimer->start();
+                    }
+                });
+    }
+}
+
+void VPreviewScheduler::schedule(const QVector<int> &p_ids, const QVector<int> &p_blocks)
+{
+    Q_ASSERT(p_ids.size() == p_blocks.size());
+    m_pending.clear();
+    m_pending.reserve(p_ids.size());
+    for (int i = 0; i < p_ids.size(); ++i) {
+        Request req;
+        req.m_id = p_ids[i];
+        req.m_block = p_blocks[i];
+        m_pending.append(req);
+    }
+
+    std::stable_sort(m_pending.begin(), m_pending.end(),
+                     [](const Request &p_a, const Request &p_b) {
+                         return p_a.m_block < p_b.m_block;
+                     });
+
+    dispatch(false);
+}
+
+void VPreviewScheduler::clear()
+{
+    m_pending.clear();
+    m_scrollTimer->stop();
+    m_idleTimer->stop();
+}
+
+void VPreviewScheduler::dispatch(bool p_idle)
+{
+    if (m_pending.isEmpty()) {
+        return;
+    }
+
+    int first = -1, last = -1;
+    m_editor->visibleBlockRangeW(first, last);
+
+    QVector<int> visibleIds, nearbyIds;
+    QVector<Request> farRequests;
+    if (first < 0 || last < first) {
+        farRequests = m_pending;
+    } else {
+        int page = last - first + 1;
+        for (auto const & req : m_pending) {
+            if (req.m_block >= first && req.m_block <= last) {
+                visibleIds.append(req.m_id);
+            } else if (req.m_block >= first - page && req.m_block <= last + page) {
+                nearbyIds.append(req.m_id);
+            } else {
+                farRequests.append(req);
+            }
+        }
+    }
+
+    if (p_idle && !farRequests.isEmpty()) {
+        // The nearest ones to the viewport first.
+        int center = first < 0 ? 0 : (first + last) / 2;
+        QVector<int> order(farRequests.size());
+        for (int i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+
+        std::stable_sort(order.begin(), order.end(),
+                         [&farRequests, center](int p_a, int p_b) {
+                             return qAbs(farRequests[p_a].m_block - center)
+                                    < qAbs(farRequests[p_b].m_block - center);
+                         });
+
+        int cnt = qMin(order.size(), IDLE_CHUNK_SIZE);
+        QVector<bool> taken(farRequests.size(), false);
+        for (int i = 0; i < cnt; ++i) {
+            taken[order[i]] = true;
+            nearbyIds.append(farRequests[order[i]].m_id);
+        }
+
+        QVector<Request> left;
+        left.reserve(farRequests.size() - cnt);
+        for (int i = 0; i < farRequests.size(); ++i) {
+            if (!taken[i]) {
+                left.append(farRequests[i]);
+            }
+        }
+
+        farRequests = left;
+    }
+
+    m_pending = farRequests;
+
+    if (!m_pending.isEmpty()) {
+        m_idleTimer->start();
+    }
+
+    if (!visibleIds.isEmpty()) {
+        emit previewRequested(visibleIds);
+    }
+
+    if (!nearbyIds.isEmpty()) {
+        emit previewRequested(nearbyIds);
+    }
+}
+
+void VPreviewScheduler::handleIdleTimeout()
+{
+    dispatch(true);
+}
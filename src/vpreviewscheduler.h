@@ -0,0 +1,66 @@
+#ifndef VPREVIEWSCHEDULER_H
+#define VPREVIEWSCHEDULER_H
+
+#include <QObject>
+#include <QVector>
+
+class VEditor;
+class QTimer;
+
+// Dispatch in-place preview requests by the distance of their blocks to the
+// viewport of the editor: requests in the viewport first, then those within
+// one page around it, then the rest in small chunks when idle.
+// Pending requests are re-ranked when the editor scrolls, so those scrolled
+// far away wait until idle again.
+class VPreviewScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    VPreviewScheduler(VEditor *p_editor, QObject *p_parent = nullptr);
+
+    // Replace all the pending requests.
+    // @p_ids: ids of the requests to dispatch via previewRequested().
+    // @p_blocks: block number of each request.
+    void schedule(const QVector<int> &p_ids, const QVector<int> &p_blocks);
+
+    // Cancel all the pending requests.
+    void clear();
+
+    bool isEmpty() const;
+
+signals:
+    // Requests @p_ids are due in order.
+    void previewRequested(const QVector<int> &p_ids);
+
+private slots:
+    void handleIdleTimeout();
+
+private:
+    struct Request
+    {
+        int m_id;
+
+        int m_block;
+    };
+
+    // Emit requests around the viewport.
+    // @p_idle: also emit a chunk of the rest.
+    void dispatch(bool p_idle);
+
+    VEditor *m_editor;
+
+    // Sorted by block number.
+    QVector<Request> m_pending;
+
+    // Dispatch once the editor stops scrolling.
+    QTimer *m_scrollTimer;
+
+    QTimer *m_idleTimer;
+};
+
+inline bool VPreviewScheduler::isEmpty() const
+{
+    return m_pending.isEmpty();
+}
+
+#endif // VPREVIEWSCHEDULER_H
@@ -0,0 +1,145 @@
+#include "vprocessrunner.h"
+
+#include <QDebug>
+
+VProcessRunner::VProcessRunner(int p_maxRunning,
+                               VTaskExecutor::Priority p_priority,
+                               QObject *p_parent)
+    : QObject(p_parent),
+      m_maxRunning(qMax(1, p_maxRunning)),
+      m_priority(p_priority),
+      m_nextId(0)
+{
+    // Emitted in any thread.
+    connect(VTaskExecutor::inst(), &VTaskExecutor::slotsAvailable,
+            this, &VProcessRunner::dispatch,
+            Qt::QueuedConnection);
+}
+
+VProcessRunner::~VProcessRunner()
+{
+    for (auto it = m_runningJobs.begin(); it != m_runningJobs.end(); ++it) {
+        QProcess *process = it.key();
+        process->disconnect(this);
+        process->kill();
+        process->waitForFinished(1000);
+        delete process;
+        VTaskExecutor::inst()->releaseSlot(m_priority);
+    }
+}
+
+int VProcessRunner::start(const QString &p_program, const QStringList &p_args)
+{
+    Job job;
+    job.m_id = ++m_nextId;
+    job.m_program = p_program;
+    job.m_args = p_args;
+    m_pendingJobs.append(job);
+
+    dispatch();
+
+    return job.m_id;
+}
+
+void VProcessRunner::dispatch()
+{
+    while (m_runningJobs.size() < m_maxRunning && !m_pendingJobs.isEmpty()) {
+        // Retried on slotsAvailable().
+        if (!VTaskExecutor::inst()->tryAcquireSlot(m_priority)) {
+            break;
+        }
+
+        Job job = m_pendingJobs.takeFirst();
+
+        QProcess *process = new QProcess(this);
+        connect(process, &QProcess::readyReadStandardOutput,
+                this, &VProcessRunner::handleReadyRead);
+        connect(process, &QProcess::readyReadStandardError,
+                this, &VProcessRunner::handleReadyRead);
+        connect(process, static_cast<void(QProcess::*)(int, QProcess::ExitStatus)>(&QProcess::finished),
+                this, &VProcessRunner::handleFinished);
+        connect(process, &QProcess::errorOccurred,
+                this, &VProcessRunner::handleError);
+
+        m_runningJobs.insert(process, job.m_id);
+        process->start(job.m_program, job.m_args);
+    }
+}
+
+void VProcessRunner::handleReadyRead()
+{
+    QProcess *process = static_cast<QProcess *>(sender());
+    auto it = m_runningJobs.find(process);
+    if (it == m_runningJobs.end()) {
+        return;
+    }
+
+    QString msg = QString::fromLocal8Bit(process->readAllStandardOutput());
+    msg += QString::fromLocal8Bit(process->readAllStandardError());
+    if (!msg.isEmpty()) {
+        emit outputReady(it.value(), msg);
+    }
+}
+
+void VProcessRunner::handleFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+{
+    QProcess *process = static_cast<QProcess *>(sender());
+    finishJob(process, p_exitStatus == QProcess::CrashExit ? -1 : p_exitCode);
+}
+
+void VProcessRunner::handleError(QProcess::ProcessError p_error)
+{
+    QProcess *process = static_cast<QProcess *>(sender());
+    if (p_error == QProcess::FailedToStart) {
+        // finished() will not be emitted.
+        qWarning() << "fail to start process" << process->program();
+        finishJob(process, -2);
+    }
+}
+
+void VProcessRunner::finishJob(QProcess *p_process, int p_ret)
+{
+    auto it = m_runningJobs.find(p_process);
+    if (it == m_runningJobs.end()) {
+        return;
+    }
+
+    // Fetch the remaining output.
+    QString msg = QString::fromLocal8Bit(p_process->readAllStandardOutput());
+    msg += QString::fromLocal8Bit(p_process->readAllStandardError());
+
+    int id = it.value();
+    m_runningJobs.erase(it);
+    p_process->disconnect(this);
+    p_process->deleteLater();
+    VTaskExecutor::inst()->releaseSlot(m_priority);
+
+    if (!msg.isEmpty()) {
+        emit outputReady(id, msg);
+    }
+
+    emit finished(id, p_ret);
+
+    dispatch();
+}
+
+void VProcessRunner::killAll()
+{
+    QList<Job> pendingJobs = m_pendingJobs;
+    m_pendingJobs.clear();
+
+    QList<QProcess *> processes = m_runningJobs.keys();
+    for (auto process : processes) {
+        int id = m_runningJobs.value(process);
+        m_runningJobs.remove(process);
+        process->disconnect(this);
+        process->kill();
+        process->deleteLater();
+        VTaskExecutor::inst()->releaseSlot(m_priority);
+        emit finished(id, -1);
+    }
+
+    for (auto const & job : pendingJobs) {
+        emit finished(job.m_id, -1);
+    }
+}
@@ -0,0 +1,77 @@
+#ifndef VPROCESSRUNNER_H
+#define VPROCESSRUNNER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QStringList>
+#include <QList>
+#include <QHash>
+
+#include "vtaskexecutor.h"
+
+// Run external programs asynchronously with at most a given number of them
+// running at the same time. The others wait in order of arrival.
+// Each running program takes a slot of class @p_priority of VTaskExecutor to
+// share the cores with the other background work.
+// Should be accessed only in the GUI thread.
+class VProcessRunner : public QObject
+{
+    Q_OBJECT
+public:
+    VProcessRunner(int p_maxRunning,
+                   VTaskExecutor::Priority p_priority,
+                   QObject *p_parent = nullptr);
+
+    ~VProcessRunner();
+
+    // Run @p_program with @p_args.
+    // Returns the ID of the job in the signals.
+    int start(const QString &p_program, const QStringList &p_args);
+
+    // Kill the running jobs and drop the pending ones, all of which finish
+    // with -1.
+    void killAll();
+
+signals:
+    // Output of the standard output and error of job @p_id.
+    void outputReady(int p_id, const QString &p_output);
+
+    // @p_ret: the exit code of the program if it exits normally,
+    // -1 if it crashes or is killed, -2 if it fails to start.
+    void finished(int p_id, int p_ret);
+
+private slots:
+    // Start pending jobs within the limit.
+    void dispatch();
+
+    void handleReadyRead();
+
+    void handleFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
+
+    void handleError(QProcess::ProcessError p_error);
+
+private:
+    struct Job
+    {
+        int m_id;
+
+        QString m_program;
+
+        QStringList m_args;
+    };
+
+    void finishJob(QProcess *p_process, int p_ret);
+
+    int m_maxRunning;
+
+    VTaskExecutor::Priority m_priority;
+
+    int m_nextId;
+
+    QList<Job> m_pendingJobs;
+
+    // Running process -> ID of the job.
+    QHash<QProcess *, int> m_runningJobs;
+};
+
+#endif // VPROCESSRUNNER_H
@@ -0,0 +1,115 @@
+#include "vreadmodecache.h"
+
+#include <QDebug>
+#include <QDataStream>
+
+#include "vconfigmanager.h"
+#include "vrendercache.h"
+
+extern VConfigManager *g_config;
+
+// Magic of the entries persisted in VRenderCache.
+#define PERSISTED_ENTRY_MAGIC 0x56524d43
+
+VReadModeCache::VReadModeCache()
+{
+    m_entries.setMaxCost(g_config->getReadModeCacheSize() * 1024);
+}
+
+VReadModeCache *VReadModeCache::inst()
+{
+    static VReadModeCache cache;
+    return &cache;
+}
+
+bool VReadModeCache::isEnabled()
+{
+    return g_config->getReadModeCacheSize() > 0;
+}
+
+QByteArray VReadModeCache::key(const QString &p_renderer, const QString &p_text)
+{
+    return VRenderCache::key(p_renderer, "read_mode", p_text);
+}
+
+bool VReadModeCache::lookup(const QByteArray &p_key, QString &p_html, QString &p_toc)
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    VReadModeCache *cache = inst();
+    const Entry *entry = cache->m_entries.object(p_key);
+    if (entry) {
+        p_html = entry->m_html;
+        p_toc = entry->m_toc;
+        return true;
+    }
+
+    if (!g_config->getPersistReadModeCache()) {
+        return false;
+    }
+
+    QByteArray data;
+    if (!VRenderCache::lookup(p_key, data)) {
+        return false;
+    }
+
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0;
+    QString html, toc;
+    in >> magic >> html >> toc;
+    if (magic != PERSISTED_ENTRY_MAGIC || in.status() != QDataStream::Ok) {
+        qWarning() << "invalid persisted read mode cache entry" << p_key;
+        return false;
+    }
+
+    p_html = html;
+    p_toc = toc;
+
+    // Keep it in memory for the following toggles.
+    cache->insertInMemory(p_key, p_html, p_toc);
+    return true;
+}
+
+void VReadModeCache::insert(const QByteArray &p_key, const QString &p_html, const QString &p_toc)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    inst()->insertInMemory(p_key, p_html, p_toc);
+
+    if (!g_config->getPersistReadModeCache()) {
+        return;
+    }
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_6);
+    out << (quint32)PERSISTED_ENTRY_MAGIC << p_html << p_toc;
+
+    VRenderCache::insert(p_key, data);
+}
+
+qint64 VReadModeCache::totalBytes()
+{
+    return (qint64)inst()->m_entries.totalCost() * 1024;
+}
+
+void VReadModeCache::insertInMemory(const QByteArray &p_key,
+                                    const QString &p_html,
+                                    const QString &p_toc)
+{
+    Entry *entry = new Entry();
+    entry->m_html = p_html;
+    entry->m_toc = p_toc;
+
+    int cost = (p_html.size() + p_toc.size()) * (int)sizeof(QChar) / 1024 + 1;
+    if (!m_entries.insert(p_key, entry, cost)) {
+        // QCache has deleted the entry.
+        qDebug() << "read mode HTML is too large to cache in memory" << cost << "KiB";
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef VREADMODECACHE_H
+#define VREADMODECACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QCache>
+
+// In-memory cache of the HTML and TOC rendered for read mode, keyed by the
+// hash of the renderer config and the Markdown text. Entries could also be
+// persisted in VRenderCache so that notes reopened unchanged are displayed
+// without converting again.
+// Should be accessed only in the GUI thread.
+class VReadModeCache
+{
+public:
+    // Key of the render of @p_text by @p_renderer.
+    // @p_renderer should identify the converter and its options.
+    static QByteArray key(const QString &p_renderer, const QString &p_text);
+
+    // Return true and fill @p_html and @p_toc if @p_key is cached.
+    static bool lookup(const QByteArray &p_key, QString &p_html, QString &p_toc);
+
+    static void insert(const QByteArray &p_key, const QString &p_html, const QString &p_toc);
+
+    // Approximate bytes of the entries in memory.
+    static qint64 totalBytes();
+
+private:
+    struct Entry
+    {
+        QString m_html;
+
+        QString m_toc;
+    };
+
+    VReadModeCache();
+
+    static VReadModeCache *inst();
+
+    static bool isEnabled();
+
+    void insertInMemory(const QByteArray &p_key, const QString &p_html, const QString &p_toc);
+
+    // Cost is in KiB.
+    QCache<QByteArray, Entry> m_entries;
+};
+
+#endif // VREADMODECACHE_H
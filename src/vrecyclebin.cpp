@@ -0,0 +1,370 @@
+#include "vrecyclebin.h"
+
+#include <QDebug>
+#include <QCoreApplication>
+#include <QRunnable>
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QDate>
+
+#include "utils/vutils.h"
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Idle time in ms before purging the recycle bins.
+#define PURGE_DELAY 5000
+
+class RecycleBinTask : public QRunnable
+{
+public:
+    explicit RecycleBinTask(VRecycleBin *p_bin)
+        : m_bin(p_bin)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_bin->runPending();
+    }
+
+private:
+    VRecycleBin *m_bin;
+};
+
+
+VRecycleBin::VRecycleBin(QObject *p_parent)
+    : QObject(p_parent),
+      m_flushRequested(false),
+      m_scheduled(false),
+      m_maxAgeDays(0),
+      m_maxSize(0)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+VRecycleBin::~VRecycleBin()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_flushRequested = true;
+        m_cond.wakeAll();
+    }
+
+    m_pool.waitForDone();
+}
+
+VRecycleBin *VRecycleBin::inst()
+{
+    static VRecycleBin *bin = new VRecycleBin(QCoreApplication::instance());
+    return bin;
+}
+
+void VRecycleBin::recycle(const QString &p_recycleBinFolderPath, const QStringList &p_paths)
+{
+    if (p_paths.isEmpty()) {
+        return;
+    }
+
+    Operation op;
+    op.m_type = OperationType::Recycle;
+    op.m_recycleBinFolderPath = p_recycleBinFolderPath;
+    op.m_paths = p_paths;
+    inst()->enqueue(op);
+}
+
+void VRecycleBin::remove(const QStringList &p_paths)
+{
+    if (p_paths.isEmpty()) {
+        return;
+    }
+
+    Operation op;
+    op.m_type = OperationType::Remove;
+    op.m_paths = p_paths;
+    inst()->enqueue(op);
+}
+
+void VRecycleBin::removeEmptyDirectory(const QString &p_path)
+{
+    Operation op;
+    op.m_type = OperationType::RemoveEmptyDirectory;
+    op.m_paths << p_path;
+    inst()->enqueue(op);
+}
+
+void VRecycleBin::purge(const QString &p_recycleBinFolderPath)
+{
+    VRecycleBin *bin = inst();
+
+    QMutexLocker locker(&bin->m_mutex);
+    bin->m_maxAgeDays = g_config->getRecycleBinMaxAgeDays();
+    bin->m_maxSize = g_config->getRecycleBinMaxSize() * 1024LL * 1024LL;
+    bin->m_foldersToPurge.insert(QDir::cleanPath(p_recycleBinFolderPath));
+    if (!bin->m_scheduled) {
+        bin->m_scheduled = true;
+        bin->m_pool.start(new RecycleBinTask(bin));
+    }
+}
+
+void VRecycleBin::enqueue(const Operation &p_op)
+{
+    QMutexLocker locker(&m_mutex);
+    m_maxAgeDays = g_config->getRecycleBinMaxAgeDays();
+    m_maxSize = g_config->getRecycleBinMaxSize() * 1024LL * 1024LL;
+
+    m_queue.enqueue(p_op);
+    for (auto const & path : p_op.m_paths) {
+        ++m_pendingPaths[QDir::cleanPath(path)];
+    }
+
+    if (p_op.m_type == OperationType::Recycle) {
+        m_foldersToPurge.insert(QDir::cleanPath(p_op.m_recycleBinFolderPath));
+    }
+
+    // Wake the worker waiting to purge.
+    m_cond.wakeAll();
+    if (!m_scheduled) {
+        m_scheduled = true;
+        m_pool.start(new RecycleBinTask(this));
+    }
+}
+
+bool VRecycleBin::isPending(const QString &p_path)
+{
+    VRecycleBin *bin = inst();
+    QString path = QDir::cleanPath(p_path);
+
+    QMutexLocker locker(&bin->m_mutex);
+    for (auto it = bin->m_pendingPaths.constBegin(); it != bin->m_pendingPaths.constEnd(); ++it) {
+        const QString &pendingPath = it.key();
+        if (pendingPath == path
+            || pendingPath.startsWith(path + '/')
+            || path.startsWith(pendingPath + '/')) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void VRecycleBin::waitFor(const QString &p_path)
+{
+    if (isPending(p_path)) {
+        flush();
+    }
+}
+
+void VRecycleBin::flush()
+{
+    VRecycleBin *bin = inst();
+
+    {
+        QMutexLocker locker(&bin->m_mutex);
+        bin->m_flushRequested = true;
+        bin->m_cond.wakeAll();
+    }
+
+    bin->m_pool.waitForDone();
+
+    QMutexLocker locker(&bin->m_mutex);
+    bin->m_flushRequested = false;
+}
+
+void VRecycleBin::runPending()
+{
+    while (true) {
+        Operation op;
+        QSet<QString> folders;
+        int maxAgeDays = 0;
+        qint64 maxSize = 0;
+        {
+            QMutexLocker locker(&m_mutex);
+            if (m_queue.isEmpty()) {
+                // Purge when no operation comes within the delay. A flush
+                // leaves the purge to the next run.
+                if (!m_foldersToPurge.isEmpty() && !m_flushRequested) {
+                    m_cond.wait(&m_mutex, PURGE_DELAY);
+                }
+
+                if (!m_queue.isEmpty()) {
+                    continue;
+                }
+
+                if (m_foldersToPurge.isEmpty() || m_flushRequested) {
+                    m_scheduled = false;
+                    return;
+                }
+
+                folders = m_foldersToPurge;
+                m_foldersToPurge.clear();
+                maxAgeDays = m_maxAgeDays;
+                maxSize = m_maxSize;
+            } else {
+                // Keep it in the queue until done so its paths are pending.
+                op = m_queue.head();
+            }
+        }
+
+        if (!folders.isEmpty()) {
+            for (auto const & folder : folders) {
+                purgeRecycleBin(folder, maxAgeDays, maxSize);
+            }
+
+            continue;
+        }
+
+        QStringList failedPaths = execute(op);
+
+        {
+            QMutexLocker locker(&m_mutex);
+            m_queue.dequeue();
+            for (auto const & path : op.m_paths) {
+                auto it = m_pendingPaths.find(QDir::cleanPath(path));
+                if (it != m_pendingPaths.end() && --it.value() <= 0) {
+                    m_pendingPaths.erase(it);
+                }
+            }
+        }
+
+        if (!failedPaths.isEmpty()) {
+            emit deletionFailed(failedPaths);
+        }
+    }
+}
+
+QStringList VRecycleBin::execute(const Operation &p_op)
+{
+    QStringList failedPaths;
+    switch (p_op.m_type) {
+    case OperationType::Recycle:
+        if (!VUtils::deleteFiles(p_op.m_recycleBinFolderPath, p_op.m_paths)) {
+            for (auto const & path : p_op.m_paths) {
+                if (QFileInfo::exists(path)) {
+                    failedPaths.append(path);
+                }
+            }
+        }
+
+        break;
+
+    case OperationType::Remove:
+        for (auto const & path : p_op.m_paths) {
+            QFileInfo fi(path);
+            if (!fi.exists()) {
+                continue;
+            }
+
+            bool ret = fi.isDir() ? QDir(path).removeRecursively() : QFile::remove(path);
+            if (!ret) {
+                qWarning() << "fail to remove" << path;
+                failedPaths.append(path);
+            }
+        }
+
+        break;
+
+    case OperationType::RemoveEmptyDirectory:
+        for (auto const & path : p_op.m_paths) {
+            QDir dir(path);
+            if (dir.exists() && dir.isEmpty()) {
+                QString name = dir.dirName();
+                dir.cdUp();
+                dir.rmdir(name);
+            }
+        }
+
+        break;
+
+    default:
+        break;
+    }
+
+    return failedPaths;
+}
+
+void VRecycleBin::purgeRecycleBin(const QString &p_folderPath, int p_maxAgeDays, qint64 p_maxSize)
+{
+    QDir dir(p_folderPath);
+    if (!dir.exists()) {
+        return;
+    }
+
+    struct DayFolder
+    {
+        QString m_path;
+
+        qint64 m_size;
+    };
+
+    // Day folders of yyyyMMdd from the oldest.
+    const QDate today = QDate::currentDate();
+    QVector<DayFolder> dayFolders;
+    qint64 totalSize = 0;
+    int nrPurged = 0;
+    const QFileInfoList subFolders = dir.entryInfoList(QDir::Dirs | QDir::Hidden | QDir::NoDotAndDotDot,
+                                                       QDir::Name);
+    for (auto const & info : subFolders) {
+        QDate date = QDate::fromString(info.fileName(), QStringLiteral("yyyyMMdd"));
+        if (!date.isValid() || date >= today) {
+            // Not created by us, or may be in use.
+            continue;
+        }
+
+        QString path = info.absoluteFilePath();
+        if (p_maxAgeDays > 0 && date.daysTo(today) > p_maxAgeDays) {
+            if (QDir(path).removeRecursively()) {
+                ++nrPurged;
+            } else {
+                qWarning() << "fail to purge recycle bin folder" << path;
+            }
+
+            continue;
+        }
+
+        DayFolder folder;
+        folder.m_path = path;
+        folder.m_size = 0;
+        // Recycled empty folders count as entries of no size.
+        bool empty = true;
+        QDirIterator it(path,
+                        QDir::AllEntries | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            it.next();
+            if (it.fileInfo().isFile()) {
+                folder.m_size += it.fileInfo().size();
+            }
+
+            empty = false;
+        }
+
+        if (empty) {
+            QDir(path).removeRecursively();
+            continue;
+        }
+
+        dayFolders.append(folder);
+        totalSize += folder.m_size;
+    }
+
+    if (p_maxSize > 0) {
+        for (auto const & folder : dayFolders) {
+            if (totalSize <= p_maxSize) {
+                break;
+            }
+
+            if (QDir(folder.m_path).removeRecursively()) {
+                totalSize -= folder.m_size;
+                ++nrPurged;
+            } else {
+                qWarning() << "fail to purge recycle bin folder" << folder.m_path;
+            }
+        }
+    }
+
+    if (nrPurged > 0) {
+        qDebug() << "purged" << nrPurged << "folders of recycle bin" << p_folderPath;
+    }
+}
@@ -0,0 +1,122 @@
+#ifndef VRECYCLEBIN_H
+#define VRECYCLEBIN_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QQueue>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+
+// Background queue of moving files and folders into the recycle bin or
+// removing them, so deleting notes and folders does not block the GUI thread.
+// Operations are executed in order on one worker. The recycle bins used are
+// compacted and purged by age and size once the queue is idle.
+// The static methods should be called in the GUI thread.
+class VRecycleBin : public QObject
+{
+    Q_OBJECT
+public:
+    static VRecycleBin *inst();
+
+    ~VRecycleBin();
+
+    // Queue moving @p_paths into recycle bin folder @p_recycleBinFolderPath.
+    static void recycle(const QString &p_recycleBinFolderPath, const QStringList &p_paths);
+
+    // Queue removing files or folders @p_paths permanently.
+    static void remove(const QStringList &p_paths);
+
+    // Queue removing folder @p_path if it is empty.
+    static void removeEmptyDirectory(const QString &p_path);
+
+    // Queue purging recycle bin folder @p_recycleBinFolderPath.
+    static void purge(const QString &p_recycleBinFolderPath);
+
+    // Whether @p_path, its ancestors or its descendants are to be deleted.
+    static bool isPending(const QString &p_path);
+
+    // Wait for the pending operations if @p_path is pending.
+    // Should be called before creating a file or folder at @p_path.
+    static void waitFor(const QString &p_path);
+
+    // Execute all the pending operations and wait for them.
+    // Should be called before moving or deleting directories on disk.
+    static void flush();
+
+signals:
+    // Emitted in the worker when @p_paths fail to be deleted.
+    void deletionFailed(const QStringList &p_paths);
+
+private:
+    friend class RecycleBinTask;
+
+    enum OperationType
+    {
+        Recycle = 0,
+        Remove,
+        RemoveEmptyDirectory
+    };
+
+    struct Operation
+    {
+        Operation()
+            : m_type(OperationType::Recycle)
+        {
+        }
+
+        OperationType m_type;
+
+        QString m_recycleBinFolderPath;
+
+        QStringList m_paths;
+    };
+
+    VRecycleBin(QObject *p_parent = nullptr);
+
+    void enqueue(const Operation &p_op);
+
+    // Execute the queued operations and then purge the recycle bins.
+    // Called on the worker.
+    void runPending();
+
+    // Return the paths failed to delete.
+    static QStringList execute(const Operation &p_op);
+
+    // Remove the day folders of @p_folderPath older than @p_maxAgeDays, and
+    // the oldest ones while the total size exceeds @p_maxSize bytes.
+    // Empty day folders are removed. Folders of today are kept.
+    static void purgeRecycleBin(const QString &p_folderPath, int p_maxAgeDays, qint64 p_maxSize);
+
+    // Not VTaskExecutor: the worker idles on the purge delay, which would hold
+    // a shared slot, and flush() must not queue behind CPU-bound work.
+    QThreadPool m_pool;
+
+    QMutex m_mutex;
+
+    // Wake the worker waiting to purge.
+    QWaitCondition m_cond;
+
+    bool m_flushRequested;
+
+    // Whether a task is queued.
+    bool m_scheduled;
+
+    QQueue<Operation> m_queue;
+
+    // Cleaned path of pending operations -> count.
+    QHash<QString, int> m_pendingPaths;
+
+    // Recycle bin folders to purge when idle.
+    QSet<QString> m_foldersToPurge;
+
+    // Purge policy in the configuration.
+    int m_maxAgeDays;
+
+    qint64 m_maxSize;
+};
+
+#endif // VRECYCLEBIN_H
@@ -0,0 +1,249 @@
+#include "vregexpsearcher.h"
+
+#include <QDebug>
+#include <QRunnable>
+#include <QCoreApplication>
+#include <QVector>
+
+#include <algorithm>
+
+// Search one request in the pool.
+class RegExpSearchTask : public QRunnable
+{
+public:
+    RegExpSearchTask(VRegExpSearcher *p_searcher,
+                     int p_id,
+                     const QSharedPointer<QAtomicInt> &p_cancelled,
+                     const QString &p_text,
+                     const QRegExp &p_exp,
+                     bool p_wholeWordOnly,
+                     bool p_forward,
+                     int p_start,
+                     int p_skipPosition)
+        : m_searcher(p_searcher),
+          m_id(p_id),
+          m_cancelled(p_cancelled),
+          m_text(p_text),
+          m_exp(p_exp),
+          m_wholeWordOnly(p_wholeWordOnly),
+          m_forward(p_forward),
+          m_start(p_start),
+          m_skipPosition(p_skipPosition)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        if (m_cancelled->load()) {
+            return;
+        }
+
+        int length = 0;
+        int start = VRegExpSearcher::find(m_text,
+                                          m_exp,
+                                          m_wholeWordOnly,
+                                          m_forward,
+                                          m_start,
+                                          m_skipPosition,
+                                          length,
+                                          m_cancelled.data());
+
+        // The searcher waits for all the tasks before destruction.
+        QMetaObject::invokeMethod(m_searcher,
+                                  "handleSearchFinished",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(int, m_id),
+                                  Q_ARG(int, start),
+                                  Q_ARG(int, length));
+    }
+
+private:
+    VRegExpSearcher *m_searcher;
+
+    int m_id;
+
+    QSharedPointer<QAtomicInt> m_cancelled;
+
+    QString m_text;
+
+    QRegExp m_exp;
+
+    bool m_wholeWordOnly;
+
+    bool m_forward;
+
+    int m_start;
+
+    int m_skipPosition;
+};
+
+
+VRegExpSearcher::VRegExpSearcher(QObject *p_parent)
+    : QObject(p_parent),
+      m_nextId(0)
+{
+}
+
+VRegExpSearcher::~VRegExpSearcher()
+{
+    for (auto const & flag : m_cancelFlags) {
+        flag->store(1);
+    }
+
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+VRegExpSearcher *VRegExpSearcher::inst()
+{
+    static VRegExpSearcher *searcher = new VRegExpSearcher(QCoreApplication::instance());
+    return searcher;
+}
+
+int VRegExpSearcher::search(const QString &p_text,
+                            const QRegExp &p_exp,
+                            bool p_wholeWordOnly,
+                            bool p_forward,
+                            int p_start,
+                            int p_skipPosition)
+{
+    int id = ++m_nextId;
+    QSharedPointer<QAtomicInt> flag(new QAtomicInt(0));
+    m_cancelFlags.insert(id, flag);
+    m_pool.start(new RegExpSearchTask(this,
+                                      id,
+                                      flag,
+                                      p_text,
+                                      p_exp,
+                                      p_wholeWordOnly,
+                                      p_forward,
+                                      p_start,
+                                      p_skipPosition));
+    return id;
+}
+
+void VRegExpSearcher::cancel(int p_id)
+{
+    auto it = m_cancelFlags.find(p_id);
+    if (it != m_cancelFlags.end()) {
+        it.value()->store(1);
+        m_cancelFlags.erase(it);
+    }
+}
+
+void VRegExpSearcher::handleSearchFinished(int p_id, int p_start, int p_length)
+{
+    auto it = m_cancelFlags.find(p_id);
+    if (it == m_cancelFlags.end()) {
+        // Cancelled.
+        return;
+    }
+
+    m_cancelFlags.erase(it);
+    emit searchFinished(p_id, p_start, p_length);
+}
+
+static bool isWordChar(const QString &p_text, int p_idx)
+{
+    return p_idx >= 0 && p_idx < p_text.size() && p_text[p_idx].isLetterOrNumber();
+}
+
+// Find in one line like QTextDocument::find() does in one block.
+// Returns the start of the match in @p_line or -1.
+static int findInLine(const QString &p_line,
+                      QRegExp &p_exp,
+                      bool p_wholeWordOnly,
+                      bool p_forward,
+                      int p_from,
+                      int p_skip,
+                      int &p_length)
+{
+    int idx = p_from;
+    while (true) {
+        idx = p_forward ? p_exp.indexIn(p_line, idx) : p_exp.lastIndexIn(p_line, idx);
+        if (idx == -1) {
+            return -1;
+        }
+
+        int len = p_exp.matchedLength();
+        bool skip = idx == p_skip;
+        if (!skip && p_wholeWordOnly) {
+            skip = isWordChar(p_line, idx - 1) || isWordChar(p_line, idx + len);
+        }
+
+        if (!skip) {
+            p_length = len;
+            return idx;
+        }
+
+        if (p_forward) {
+            idx += qMax(len, 1);
+            if (idx > p_line.size()) {
+                return -1;
+            }
+        } else {
+            if (--idx < 0) {
+                return -1;
+            }
+        }
+    }
+}
+
+int VRegExpSearcher::find(const QString &p_text,
+                          QRegExp p_exp,
+                          bool p_wholeWordOnly,
+                          bool p_forward,
+                          int p_start,
+                          int p_skipPosition,
+                          int &p_length,
+                          const QAtomicInt *p_cancelled)
+{
+    // Start offset of each line.
+    QVector<int> lines;
+    lines.append(0);
+    for (int i = 0; i < p_text.size(); ++i) {
+        if (p_text[i] == QLatin1Char('\n')) {
+            lines.append(i + 1);
+        }
+    }
+
+    int nrLines = lines.size();
+    int start = qBound(0, p_start, p_text.size());
+    int cur = std::upper_bound(lines.begin(), lines.end(), start) - lines.begin() - 1;
+
+    // Visit the start line twice to wrap around to its other part.
+    for (int i = 0; i <= nrLines; ++i) {
+        if (p_cancelled && p_cancelled->load()) {
+            return -1;
+        }
+
+        int lineIdx = p_forward ? (cur + i) % nrLines : (cur - i + nrLines) % nrLines;
+        int lineStart = lines[lineIdx];
+        int lineEnd = lineIdx + 1 < nrLines ? lines[lineIdx + 1] - 1 : p_text.size();
+        const QString line = p_text.mid(lineStart, lineEnd - lineStart);
+
+        int from = 0;
+        if (i == 0) {
+            from = p_forward ? start - lineStart : start - lineStart - 1;
+            if (from < 0) {
+                continue;
+            }
+        } else if (!p_forward) {
+            from = line.size();
+        }
+
+        int skip = p_skipPosition >= lineStart ? p_skipPosition - lineStart : -1;
+        int idx = findInLine(line, p_exp, p_wholeWordOnly, p_forward, from, skip, p_length);
+        if (idx != -1) {
+            int pos = lineStart + idx;
+            if (i == nrLines && (p_forward ? pos >= start : pos < start)) {
+                // Back to the part searched at first.
+                return -1;
+            }
+
+            return pos;
+        }
+    }
+
+    return -1;
+}
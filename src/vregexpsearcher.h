@@ -0,0 +1,69 @@
+#ifndef VREGEXPSEARCHER_H
+#define VREGEXPSEARCHER_H
+
+#include <QObject>
+#include <QString>
+#include <QRegExp>
+#include <QHash>
+#include <QAtomicInt>
+#include <QSharedPointer>
+#include <QThreadPool>
+
+// Search regular expressions in snapshots of documents on a worker pool, so
+// pathological expressions on big notes do not freeze the GUI.
+// A request superseded by a newer one should be cancelled; it is checked
+// between lines.
+// Should be accessed only in the GUI thread.
+class VRegExpSearcher : public QObject
+{
+    Q_OBJECT
+public:
+    ~VRegExpSearcher();
+
+    static VRegExpSearcher *inst();
+
+    // Find the next match of @p_exp in @p_text from @p_start like
+    // QTextDocument::find(), wrapping around. Lines are searched one by one.
+    // @p_skipPosition: a forward match starting at it will be skipped, -1 to
+    // disable.
+    // Returns the ID of the request in searchFinished().
+    int search(const QString &p_text,
+               const QRegExp &p_exp,
+               bool p_wholeWordOnly,
+               bool p_forward,
+               int p_start,
+               int p_skipPosition);
+
+    void cancel(int p_id);
+
+    // Search synchronously.
+    // Returns the start of the match and sets @p_length, or -1 if not found
+    // or cancelled.
+    static int find(const QString &p_text,
+                    QRegExp p_exp,
+                    bool p_wholeWordOnly,
+                    bool p_forward,
+                    int p_start,
+                    int p_skipPosition,
+                    int &p_length,
+                    const QAtomicInt *p_cancelled = NULL);
+
+signals:
+    // @p_start is -1 if not found. Not emitted for cancelled requests.
+    void searchFinished(int p_id, int p_start, int p_length);
+
+private slots:
+    void handleSearchFinished(int p_id, int p_start, int p_length);
+
+private:
+    explicit VRegExpSearcher(QObject *p_parent = nullptr);
+
+    QThreadPool m_pool;
+
+    int m_nextId;
+
+    // Cancellation flags of pending requests.
+    QHash<int, QSharedPointer<QAtomicInt>> m_cancelFlags;
+};
+
+#endif // VREGEXPSEARCHER_H
@@ -0,0 +1,271 @@
+#include "vrendercache.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+#include <QVector>
+#include <QPair>
+
+#include <algorithm>
+
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Magic and version of the index file.
+#define INDEX_FILE_MAGIC 0x56524358
+#define INDEX_FILE_VERSION 1
+
+#define INDEX_FILE_NAME "index"
+
+// Evict down to this percentage of the limit to avoid evicting on every insert.
+#define EVICTION_TARGET_PERCENTAGE 90
+
+VRenderCache::VRenderCache()
+    : m_loaded(false),
+      m_dirty(false),
+      m_totalSize(0)
+{
+}
+
+VRenderCache *VRenderCache::inst()
+{
+    static VRenderCache cache;
+    return &cache;
+}
+
+bool VRenderCache::isEnabled()
+{
+    return g_config->getRenderCacheSize() > 0;
+}
+
+QByteArray VRenderCache::key(const QString &p_renderer,
+                             const QString &p_format,
+                             const QString &p_text)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(p_renderer.toUtf8());
+    hash.addData("\n", 1);
+    hash.addData(p_format.toUtf8());
+    hash.addData("\n", 1);
+    hash.addData(p_text.toUtf8());
+    return hash.result().toHex();
+}
+
+bool VRenderCache::lookup(const QByteArray &p_key, QByteArray &p_data)
+{
+    if (!isEnabled()) {
+        return false;
+    }
+
+    VRenderCache *cache = inst();
+    cache->load();
+
+    auto it = cache->m_entries.find(p_key);
+    if (it == cache->m_entries.end()) {
+        return false;
+    }
+
+    QFile file(cache->entryFilePath(p_key));
+    if (!file.open(QIODevice::ReadOnly)) {
+        cache->removeEntry(p_key);
+        return false;
+    }
+
+    p_data = file.readAll();
+    if (p_data.isEmpty()) {
+        cache->removeEntry(p_key);
+        return false;
+    }
+
+    it.value().m_lastUsed = QDateTime::currentMSecsSinceEpoch();
+    cache->m_dirty = true;
+    return true;
+}
+
+void VRenderCache::insert(const QByteArray &p_key, const QByteArray &p_data)
+{
+    if (!isEnabled() || p_data.isEmpty()) {
+        return;
+    }
+
+    VRenderCache *cache = inst();
+    cache->load();
+
+    VUtils::makePath(cache->m_folder);
+
+    QString filePath = cache->entryFilePath(p_key);
+    if (!VUtils::writeFileToDisk(filePath, p_data)) {
+        qWarning() << "fail to write render cache entry" << filePath;
+        return;
+    }
+
+    auto it = cache->m_entries.find(p_key);
+    if (it != cache->m_entries.end()) {
+        cache->m_totalSize -= it.value().m_size;
+    }
+
+    cache->m_entries.insert(p_key, Entry(p_data.size(), QDateTime::currentMSecsSinceEpoch()));
+    cache->m_totalSize += p_data.size();
+    cache->m_dirty = true;
+
+    cache->evict();
+}
+
+void VRenderCache::clear()
+{
+    VRenderCache *cache = inst();
+    cache->load();
+
+    for (auto it = cache->m_entries.constBegin(); it != cache->m_entries.constEnd(); ++it) {
+        QFile::remove(cache->entryFilePath(it.key()));
+    }
+
+    cache->m_entries.clear();
+    cache->m_totalSize = 0;
+    cache->m_dirty = true;
+    save();
+}
+
+void VRenderCache::save()
+{
+    VRenderCache *cache = inst();
+    if (!cache->m_loaded || !cache->m_dirty) {
+        return;
+    }
+
+    VUtils::makePath(cache->m_folder);
+
+    QString indexFile = cache->indexFilePath();
+    QSaveFile file(indexFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open render cache index file to write" << indexFile;
+        return;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    out << (quint32)INDEX_FILE_MAGIC << (quint32)INDEX_FILE_VERSION;
+
+    out << (qint32)cache->m_entries.size();
+    for (auto it = cache->m_entries.constBegin(); it != cache->m_entries.constEnd(); ++it) {
+        out << it.key() << it.value().m_lastUsed;
+    }
+
+    if (!file.commit()) {
+        qWarning() << "fail to write render cache index file" << indexFile;
+        return;
+    }
+
+    cache->m_dirty = false;
+}
+
+void VRenderCache::load()
+{
+    if (m_loaded) {
+        return;
+    }
+
+    m_loaded = true;
+    m_folder = QDir(g_config->getConfigFolder()).filePath("render_cache");
+
+    // Last used time of entries from the index.
+    QHash<QByteArray, qint64> lastUsed;
+    QFile file(indexFilePath());
+    if (file.open(QIODevice::ReadOnly)) {
+        QDataStream in(&file);
+        in.setVersion(QDataStream::Qt_5_6);
+
+        quint32 magic = 0, version = 0;
+        in >> magic >> version;
+        if (magic == INDEX_FILE_MAGIC && version == INDEX_FILE_VERSION) {
+            qint32 nrEntries = 0;
+            in >> nrEntries;
+            for (int i = 0; i < nrEntries && !in.atEnd(); ++i) {
+                QByteArray key;
+                qint64 time = 0;
+                in >> key >> time;
+                lastUsed.insert(key, time);
+            }
+        } else {
+            qWarning() << "invalid render cache index file" << indexFilePath();
+        }
+    }
+
+    // Files on disk are the source of truth.
+    QDir dir(m_folder);
+    QFileInfoList infos = dir.entryInfoList(QDir::Files | QDir::NoDotAndDotDot);
+    for (auto const & info : infos) {
+        if (info.fileName() == INDEX_FILE_NAME) {
+            continue;
+        }
+
+        QByteArray key = info.fileName().toLatin1();
+        qint64 time = lastUsed.value(key, info.lastModified().toMSecsSinceEpoch());
+        m_entries.insert(key, Entry(info.size(), time));
+        m_totalSize += info.size();
+    }
+
+    m_dirty = m_entries.size() != lastUsed.size();
+
+    qDebug() << "render cache loaded" << m_entries.size() << "entries" << m_totalSize << "bytes";
+
+    evict();
+}
+
+void VRenderCache::evict()
+{
+    qint64 limit = (qint64)g_config->getRenderCacheSize() * 1024 * 1024;
+    if (m_totalSize <= limit) {
+        return;
+    }
+
+    QVector<QPair<qint64, QByteArray>> entries;
+    entries.reserve(m_entries.size());
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        entries.append(qMakePair(it.value().m_lastUsed, it.key()));
+    }
+
+    std::sort(entries.begin(), entries.end());
+
+    qint64 target = limit / 100 * EVICTION_TARGET_PERCENTAGE;
+    for (auto const & entry : entries) {
+        if (m_totalSize <= target) {
+            break;
+        }
+
+        QFile::remove(entryFilePath(entry.second));
+        removeEntry(entry.second);
+    }
+
+    qDebug() << "render cache evicted to" << m_entries.size() << "entries" << m_totalSize << "bytes";
+}
+
+void VRenderCache::removeEntry(const QByteArray &p_key)
+{
+    auto it = m_entries.find(p_key);
+    if (it == m_entries.end()) {
+        return;
+    }
+
+    m_totalSize -= it.value().m_size;
+    m_entries.erase(it);
+    m_dirty = true;
+}
+
+QString VRenderCache::entryFilePath(const QByteArray &p_key) const
+{
+    return QDir(m_folder).filePath(QString::fromLatin1(p_key));
+}
+
+QString VRenderCache::indexFilePath() const
+{
+    return QDir(m_folder).filePath(INDEX_FILE_NAME);
+}
@@ -0,0 +1,84 @@
+#ifndef VRENDERCACHE_H
+#define VRENDERCACHE_H
+
+#include <QString>
+#include <QByteArray>
+#include <QHash>
+
+// Persistent content-addressed cache of rendered diagrams and formulas.
+// Each entry is a file under the config folder named by the hash of the
+// renderer signature, the format and the source text. The least recently used
+// entries are evicted when the cache grows beyond the configured size.
+// Should be accessed only in the GUI thread.
+class VRenderCache
+{
+public:
+    // Key of the render of @p_text in @p_format by @p_renderer.
+    // @p_renderer should identify the renderer and its version.
+    static QByteArray key(const QString &p_renderer,
+                          const QString &p_format,
+                          const QString &p_text);
+
+    // Return true and fill @p_data if @p_key is cached.
+    static bool lookup(const QByteArray &p_key, QByteArray &p_data);
+
+    static void insert(const QByteArray &p_key, const QByteArray &p_data);
+
+    // Remove all the entries from disk.
+    static void clear();
+
+    // Write the usage index to disk.
+    static void save();
+
+private:
+    struct Entry
+    {
+        Entry()
+            : m_size(0),
+              m_lastUsed(0)
+        {
+        }
+
+        Entry(qint64 p_size, qint64 p_lastUsed)
+            : m_size(p_size),
+              m_lastUsed(p_lastUsed)
+        {
+        }
+
+        qint64 m_size;
+
+        // Msecs since epoch.
+        qint64 m_lastUsed;
+    };
+
+    VRenderCache();
+
+    static VRenderCache *inst();
+
+    static bool isEnabled();
+
+    // Load the entries from disk if not yet.
+    void load();
+
+    // Evict the least recently used entries until the cache fits the limit.
+    void evict();
+
+    void removeEntry(const QByteArray &p_key);
+
+    QString entryFilePath(const QByteArray &p_key) const;
+
+    QString indexFilePath() const;
+
+    bool m_loaded;
+
+    // Whether the index differs from the one on disk.
+    bool m_dirty;
+
+    QString m_folder;
+
+    QHash<QByteArray, Entry> m_entries;
+
+    qint64 m_totalSize;
+};
+
+#endif // VRENDERCACHE_H
@@ -0,0 +1,248 @@
+#include "vrenderscheduler.h"
+
+#include <QDebug>
+#include <QTimer>
+#include <QCoreApplication>
+#include <QCryptographicHash>
+
+#include "vconfigmanager.h"
+#include "vtracer.h"
+#include "vtaskexecutor.h"
+
+extern VConfigManager *g_config;
+
+#define TaskKeyProperty "RenderTaskKey"
+
+VRenderScheduler::VRenderScheduler(QObject *p_parent)
+    : QObject(p_parent),
+      m_numOfRunningTasks(0)
+{
+    m_timer = new QTimer(this);
+    m_timer->setSingleShot(true);
+    m_timer->setInterval(0);
+    connect(m_timer, &QTimer::timeout,
+            this, &VRenderScheduler::processRequests);
+
+    // Emitted in any thread.
+    connect(VTaskExecutor::inst(), &VTaskExecutor::slotsAvailable,
+            this, &VRenderScheduler::dispatch,
+            Qt::QueuedConnection);
+}
+
+VRenderScheduler *VRenderScheduler::inst()
+{
+    // Destroyed with the application to kill the processes in time.
+    static VRenderScheduler *scheduler = new VRenderScheduler(QCoreApplication::instance());
+    return scheduler;
+}
+
+QByteArray VRenderScheduler::taskKey(const QString &p_program,
+                                     const QStringList &p_args,
+                                     const QByteArray &p_input)
+{
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(p_program.toUtf8());
+    for (auto const & arg : p_args) {
+        hash.addData("\n", 1);
+        hash.addData(arg.toUtf8());
+    }
+
+    hash.addData("\n\n", 2);
+    hash.addData(p_input);
+    return hash.result();
+}
+
+void VRenderScheduler::schedule(QObject *p_owner,
+                                TimeStamp p_timeStamp,
+                                const QString &p_program,
+                                const QStringList &p_args,
+                                const QByteArray &p_input,
+                                const RenderResultFunc &p_func)
+{
+    Q_ASSERT(p_owner);
+    auto tsIt = m_latestTimeStamps.find(p_owner);
+    if (tsIt == m_latestTimeStamps.end()) {
+        m_latestTimeStamps.insert(p_owner, p_timeStamp);
+        connect(p_owner, &QObject::destroyed,
+                this, [this](QObject *p_obj) {
+                    m_latestTimeStamps.remove(p_obj);
+                });
+    } else if (tsIt.value() < p_timeStamp) {
+        tsIt.value() = p_timeStamp;
+    }
+
+    Waiter waiter;
+    waiter.m_owner = p_owner;
+    waiter.m_timeStamp = p_timeStamp;
+    waiter.m_func = p_func;
+
+    QByteArray key = taskKey(p_program, p_args, p_input);
+    auto it = m_taskByKey.find(key);
+    if (it != m_taskByKey.end()) {
+        it.value()->m_waiters.append(waiter);
+    } else {
+        QSharedPointer<Task> task(new Task());
+        task->m_key = key;
+        task->m_program = p_program;
+        task->m_args = p_args;
+        task->m_input = p_input;
+        task->m_waiters.append(waiter);
+        m_tasks.append(task);
+        m_taskByKey.insert(key, task);
+    }
+
+    // Prune after all the requests of this round are scheduled, since an
+    // owner may request the same input again with the new timestamp.
+    m_timer->start();
+}
+
+void VRenderScheduler::cancel(QObject *p_owner)
+{
+    for (auto const & task : m_tasks) {
+        for (auto wit = task->m_waiters.begin(); wit != task->m_waiters.end();) {
+            if (wit->m_owner.data() == p_owner) {
+                wit = task->m_waiters.erase(wit);
+            } else {
+                ++wit;
+            }
+        }
+    }
+
+    processRequests();
+}
+
+void VRenderScheduler::processRequests()
+{
+    dispatch();
+}
+
+void VRenderScheduler::prune()
+{
+    for (auto it = m_tasks.begin(); it != m_tasks.end();) {
+        const QSharedPointer<Task> &task = *it;
+        for (auto wit = task->m_waiters.begin(); wit != task->m_waiters.end();) {
+            if (!wit->m_owner
+                || wit->m_timeStamp < m_latestTimeStamps.value(wit->m_owner.data())) {
+                wit = task->m_waiters.erase(wit);
+            } else {
+                ++wit;
+            }
+        }
+
+        if (!task->m_waiters.isEmpty()) {
+            ++it;
+            continue;
+        }
+
+        if (task->m_process) {
+            qDebug() << "kill superseded render process" << task->m_program;
+            QProcess *process = task->m_process;
+            task->m_process = NULL;
+            process->disconnect(this);
+            process->kill();
+            process->deleteLater();
+            --m_numOfRunningTasks;
+            VTaskExecutor::inst()->releaseSlot(VTaskExecutor::Preview);
+        }
+
+        m_taskByKey.remove(task->m_key);
+        it = m_tasks.erase(it);
+    }
+}
+
+void VRenderScheduler::dispatch()
+{
+    // Owners may be destroyed since the last round.
+    prune();
+
+    int limit = g_config->getMaxRenderProcesses();
+    // Tasks may finish within startTask().
+    QList<QSharedPointer<Task>> tasks(m_tasks);
+    for (auto const & task : tasks) {
+        if (m_numOfRunningTasks >= limit) {
+            break;
+        }
+
+        if (!task->m_process) {
+            // The processes share the cores with the other background work.
+            if (!VTaskExecutor::inst()->tryAcquireSlot(VTaskExecutor::Preview)) {
+                break;
+            }
+
+            startTask(task);
+        }
+    }
+}
+
+void VRenderScheduler::startTask(const QSharedPointer<Task> &p_task)
+{
+    QProcess *process = new QProcess(this);
+    process->setProperty(TaskKeyProperty, p_task->m_key);
+    connect(process, SIGNAL(finished(int, QProcess::ExitStatus)),
+            this, SLOT(handleProcessFinished(int, QProcess::ExitStatus)));
+    connect(process, &QProcess::errorOccurred,
+            this, &VRenderScheduler::handleProcessError);
+
+    p_task->m_process = process;
+    p_task->m_traceStart = VTracer::isEnabled() ? VTracer::now() : -1;
+    ++m_numOfRunningTasks;
+
+    if (p_task->m_args.isEmpty()) {
+        qDebug() << p_task->m_program;
+        process->start(p_task->m_program);
+    } else {
+        qDebug() << p_task->m_program << p_task->m_args;
+        process->start(p_task->m_program, p_task->m_args);
+    }
+
+    if (process->write(p_task->m_input) == -1) {
+        qWarning() << "fail to write to QProcess:" << process->errorString();
+    }
+
+    process->closeWriteChannel();
+}
+
+void VRenderScheduler::handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus)
+{
+    finishTask(static_cast<QProcess *>(sender()), p_exitCode, p_exitStatus);
+}
+
+void VRenderScheduler::handleProcessError(QProcess::ProcessError p_error)
+{
+    // No finished() signal if it fails to start.
+    if (p_error == QProcess::FailedToStart) {
+        QProcess *process = static_cast<QProcess *>(sender());
+        qWarning() << "fail to start render process" << process->program() << process->errorString();
+        finishTask(process, -1, QProcess::CrashExit);
+    }
+}
+
+void VRenderScheduler::finishTask(QProcess *p_process,
+                                  int p_exitCode,
+                                  QProcess::ExitStatus p_exitStatus)
+{
+    p_process->disconnect(this);
+
+    QByteArray key = p_process->property(TaskKeyProperty).toByteArray();
+    QByteArray out = p_process->readAllStandardOutput();
+    QByteArray err = p_process->readAllStandardError();
+    p_process->deleteLater();
+
+    --m_numOfRunningTasks;
+    VTaskExecutor::inst()->releaseSlot(VTaskExecutor::Preview);
+
+    QSharedPointer<Task> task = m_taskByKey.take(key);
+    if (task) {
+        m_tasks.removeOne(task);
+
+        VTracer::complete("render", "Render process", task->m_traceStart, task->m_program);
+
+        for (auto const & waiter : task->m_waiters) {
+            if (waiter.m_owner) {
+                waiter.m_func(p_exitCode, p_exitStatus, out, err);
+            }
+        }
+    }
+
+    dispatch();
+}
@@ -0,0 +1,126 @@
+#ifndef VRENDERSCHEDULER_H
+#define VRENDERSCHEDULER_H
+
+#include <QObject>
+#include <QProcess>
+#include <QPointer>
+#include <QStringList>
+#include <QByteArray>
+#include <QHash>
+#include <QList>
+#include <QSharedPointer>
+#include <functional>
+
+#include "vconstants.h"
+
+class QTimer;
+
+typedef std::function<void(int p_exitCode,
+                           QProcess::ExitStatus p_exitStatus,
+                           const QByteArray &p_out,
+                           const QByteArray &p_err)> RenderResultFunc;
+
+// Scheduler of the renderer processes like Graphviz and PlantUML shared by all
+// the editors.
+// - Bounds the number of processes running at the same time, each taking a
+//   Preview slot of VTaskExecutor;
+// - Merges requests of the same command and input;
+// - Drops requests of an owner superseded by its newer requests and kills the
+//   processes nobody waits for any more;
+// Should be accessed only in the GUI thread.
+class VRenderScheduler : public QObject
+{
+    Q_OBJECT
+public:
+    static VRenderScheduler *inst();
+
+    // Run @p_program with @p_args and feed it @p_input.
+    // If @p_args is empty, @p_program is a whole command line.
+    // Requests of @p_owner with timestamp older than @p_timeStamp will be
+    // dropped, whose @p_func will never be called.
+    void schedule(QObject *p_owner,
+                  TimeStamp p_timeStamp,
+                  const QString &p_program,
+                  const QStringList &p_args,
+                  const QByteArray &p_input,
+                  const RenderResultFunc &p_func);
+
+    // Drop all the requests of @p_owner and kill the processes nobody waits
+    // for any more.
+    void cancel(QObject *p_owner);
+
+private slots:
+    void handleProcessFinished(int p_exitCode, QProcess::ExitStatus p_exitStatus);
+
+    void handleProcessError(QProcess::ProcessError p_error);
+
+    void processRequests();
+
+    // Prune and start pending tasks within the limit.
+    void dispatch();
+
+private:
+    struct Waiter
+    {
+        QPointer<QObject> m_owner;
+
+        TimeStamp m_timeStamp;
+
+        RenderResultFunc m_func;
+    };
+
+    struct Task
+    {
+        Task()
+            : m_process(NULL),
+              m_traceStart(-1)
+        {
+        }
+
+        QByteArray m_key;
+
+        QString m_program;
+
+        QStringList m_args;
+
+        QByteArray m_input;
+
+        QList<Waiter> m_waiters;
+
+        // Not NULL if running.
+        QProcess *m_process;
+
+        // Start time of VTracer, or -1.
+        qint64 m_traceStart;
+    };
+
+    explicit VRenderScheduler(QObject *p_parent = nullptr);
+
+    // Drop superseded waiters and tasks without waiters.
+    void prune();
+
+    void startTask(const QSharedPointer<Task> &p_task);
+
+    // Call the waiters of the task of @p_process.
+    void finishTask(QProcess *p_process, int p_exitCode, QProcess::ExitStatus p_exitStatus);
+
+    static QByteArray taskKey(const QString &p_program,
+                              const QStringList &p_args,
+                              const QByteArray &p_input);
+
+    // Pending and running tasks, in order of arrival.
+    QList<QSharedPointer<Task>> m_tasks;
+
+    // Task key -> task.
+    QHash<QByteArray, QSharedPointer<Task>> m_taskByKey;
+
+    // Owner -> its latest timestamp.
+    QHash<QObject *, TimeStamp> m_latestTimeStamps;
+
+    int m_numOfRunningTasks;
+
+    // Process the requests after those of one round are all scheduled.
+    QTimer *m_timer;
+};
+
+#endif // VRENDERSCHEDULER_H
@@ -0,0 +1,370 @@
+#include "vsavedsearch.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QCryptographicHash>
+
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+// Magic and version of the cache file.
+#define CACHE_FILE_MAGIC 0x56535343
+#define CACHE_FILE_VERSION 1
+
+VSavedSearch::VSavedSearch(const QString &p_name,
+                           const QStringList &p_config,
+                           const QString &p_keyword,
+                           const QString &p_cacheFile)
+    : m_name(p_name),
+      m_config(p_config),
+      m_keyword(p_keyword),
+      m_cacheFile(p_cacheFile),
+      m_lastRunTime(0),
+      m_cacheLoaded(false)
+{
+}
+
+void VSavedSearch::loadCache()
+{
+    if (m_cacheLoaded) {
+        return;
+    }
+
+    m_cacheLoaded = true;
+    m_cache.clear();
+
+    QFile file(m_cacheFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != CACHE_FILE_MAGIC || version != CACHE_FILE_VERSION) {
+        qWarning() << "invalid saved search cache file" << m_cacheFile;
+        return;
+    }
+
+    // The cache is stale if the search has changed.
+    QStringList config;
+    QString keyword;
+    in >> config >> keyword;
+    if (config != m_config || keyword != m_keyword) {
+        return;
+    }
+
+    qint32 nrFiles = 0;
+    in >> nrFiles;
+    m_cache.reserve(qMax(nrFiles, 0));
+    for (int i = 0; i < nrFiles && in.status() == QDataStream::Ok; ++i) {
+        QString path;
+        FileEntry entry;
+        bool hasItem = false;
+        in >> path >> entry.m_modifiedTime >> hasItem;
+        if (hasItem) {
+            qint32 type = 0, matchType = 0, nrMatches = 0;
+            VSearchResultItem *item = new VSearchResultItem();
+            in >> type >> matchType >> item->m_text >> nrMatches;
+            item->m_type = (VSearchResultItem::ItemType)type;
+            item->m_matchType = (VSearchResultItem::MatchType)matchType;
+            item->m_path = path;
+            for (int j = 0; j < nrMatches; ++j) {
+                VSearchResultSubItem sitem;
+                qint32 lineNumber = 0, length = 0;
+                in >> lineNumber >> sitem.m_text >> sitem.m_offset >> length >> sitem.m_truncated;
+                sitem.m_lineNumber = lineNumber;
+                sitem.m_length = length;
+                item->m_matches.append(sitem);
+            }
+
+            entry.m_item.reset(item);
+        }
+
+        m_cache.insert(path, entry);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "corrupted saved search cache file" << m_cacheFile;
+        m_cache.clear();
+    }
+}
+
+bool VSavedSearch::saveCache() const
+{
+    VUtils::makePath(VUtils::basePathFromPath(m_cacheFile));
+
+    QSaveFile file(m_cacheFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open saved search cache file to write" << m_cacheFile;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    out << (quint32)CACHE_FILE_MAGIC << (quint32)CACHE_FILE_VERSION;
+    out << m_config << m_keyword;
+
+    out << (qint32)m_cache.size();
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        const FileEntry &entry = it.value();
+        out << it.key() << entry.m_modifiedTime << !entry.m_item.isNull();
+        if (entry.m_item) {
+            const VSearchResultItem *item = entry.m_item.data();
+            out << (qint32)item->m_type
+                << (qint32)item->m_matchType
+                << item->m_text
+                << (qint32)item->m_matches.size();
+            for (auto const & sitem : item->m_matches) {
+                out << (qint32)sitem.m_lineNumber
+                    << sitem.m_text
+                    << sitem.m_offset
+                    << (qint32)sitem.m_length
+                    << sitem.m_truncated;
+            }
+        }
+    }
+
+    if (!file.commit()) {
+        qWarning() << "fail to write saved search cache file" << m_cacheFile;
+        return false;
+    }
+
+    return true;
+}
+
+QHash<QString, qint64> VSavedSearch::cachedModifiedTimes()
+{
+    loadCache();
+
+    QHash<QString, qint64> times;
+    times.reserve(m_cache.size());
+    for (auto it = m_cache.constBegin(); it != m_cache.constEnd(); ++it) {
+        times.insert(it.key(), it.value().m_modifiedTime);
+    }
+
+    return times;
+}
+
+QList<QSharedPointer<VSearchResultItem> > VSavedSearch::cachedItems(const QStringList &p_paths,
+                                                                    const QSharedPointer<VSearchConfig> &p_config)
+{
+    loadCache();
+
+    QList<QSharedPointer<VSearchResultItem> > items;
+    for (auto const & path : p_paths) {
+        auto it = m_cache.constFind(path);
+        if (it == m_cache.constEnd() || !it.value().m_item) {
+            continue;
+        }
+
+        // The config is used to highlight the matches when opened.
+        QSharedPointer<VSearchResultItem> item(new VSearchResultItem(*it.value().m_item));
+        item->m_config = p_config;
+        items.append(item);
+    }
+
+    return items;
+}
+
+void VSavedSearch::addRunItem(const QSharedPointer<VSearchResultItem> &p_item)
+{
+    if (p_item->m_type != VSearchResultItem::Note) {
+        return;
+    }
+
+    m_runItems.insert(p_item->m_path, p_item);
+}
+
+void VSavedSearch::commitRun(const QHash<QString, qint64> &p_modifiedTimes)
+{
+    loadCache();
+
+    QHash<QString, FileEntry> cache;
+    cache.reserve(p_modifiedTimes.size());
+    for (auto it = p_modifiedTimes.constBegin(); it != p_modifiedTimes.constEnd(); ++it) {
+        FileEntry entry;
+        entry.m_modifiedTime = it.value();
+
+        auto runIt = m_runItems.constFind(it.key());
+        if (runIt != m_runItems.constEnd()) {
+            entry.m_item = runIt.value();
+        } else {
+            // Unchanged files keep their cached results. Files deleted since
+            // last run are dropped.
+            auto oldIt = m_cache.constFind(it.key());
+            if (oldIt != m_cache.constEnd()
+                && oldIt.value().m_modifiedTime == it.value()) {
+                entry.m_item = oldIt.value().m_item;
+            }
+        }
+
+        cache.insert(it.key(), entry);
+    }
+
+    m_cache.swap(cache);
+    m_runItems.clear();
+
+    saveCache();
+}
+
+void VSavedSearch::abortRun()
+{
+    m_runItems.clear();
+}
+
+void VSavedSearch::removeCache()
+{
+    m_cache.clear();
+    m_runItems.clear();
+    m_cacheLoaded = true;
+
+    if (QFile::exists(m_cacheFile)) {
+        QFile::remove(m_cacheFile);
+    }
+}
+
+
+VSavedSearchManager::VSavedSearchManager()
+{
+    loadList();
+}
+
+VSavedSearchManager *VSavedSearchManager::inst()
+{
+    static VSavedSearchManager mgr;
+    return &mgr;
+}
+
+void VSavedSearchManager::loadList()
+{
+    QJsonObject json = VUtils::readJsonFromDisk(listFilePath());
+    QJsonArray arr = json["searches"].toArray();
+    for (int i = 0; i < arr.size(); ++i) {
+        QJsonObject obj = arr[i].toObject();
+        QString name = obj["name"].toString();
+        if (name.isEmpty()) {
+            continue;
+        }
+
+        QStringList config;
+        QJsonArray configArr = obj["config"].toArray();
+        for (int j = 0; j < configArr.size(); ++j) {
+            config.append(configArr[j].toString());
+        }
+
+        QSharedPointer<VSavedSearch> search(new VSavedSearch(name,
+                                                             config,
+                                                             obj["keyword"].toString(),
+                                                             cacheFilePath(name)));
+        search->setLastRunTime((qint64)obj["last_run_time"].toDouble());
+        m_searches.append(search);
+    }
+}
+
+bool VSavedSearchManager::saveList()
+{
+    QJsonArray arr;
+    for (auto const & search : inst()->m_searches) {
+        QJsonObject obj;
+        obj["name"] = search->getName();
+        obj["config"] = QJsonArray::fromStringList(search->getConfig());
+        obj["keyword"] = search->getKeyword();
+        obj["last_run_time"] = (double)search->getLastRunTime();
+        arr.append(obj);
+    }
+
+    QJsonObject json;
+    json["searches"] = arr;
+
+    QString filePath = listFilePath();
+    VUtils::makePath(VUtils::basePathFromPath(filePath));
+    if (!VUtils::writeJsonToDisk(filePath, json)) {
+        qWarning() << "fail to write saved searches" << filePath;
+        return false;
+    }
+
+    return true;
+}
+
+const QVector<QSharedPointer<VSavedSearch> > &VSavedSearchManager::getSearches()
+{
+    return inst()->m_searches;
+}
+
+QSharedPointer<VSavedSearch> VSavedSearchManager::getSearch(const QString &p_name)
+{
+    for (auto const & search : inst()->m_searches) {
+        if (search->getName() == p_name) {
+            return search;
+        }
+    }
+
+    return QSharedPointer<VSavedSearch>();
+}
+
+QSharedPointer<VSavedSearch> VSavedSearchManager::saveSearch(const QString &p_name,
+                                                             const QStringList &p_config,
+                                                             const QString &p_keyword)
+{
+    VSavedSearchManager *mgr = inst();
+    for (int i = 0; i < mgr->m_searches.size(); ++i) {
+        QSharedPointer<VSavedSearch> &search = mgr->m_searches[i];
+        if (search->getName() != p_name) {
+            continue;
+        }
+
+        if (search->getConfig() == p_config && search->getKeyword() == p_keyword) {
+            return search;
+        }
+
+        search->removeCache();
+        search.reset(new VSavedSearch(p_name, p_config, p_keyword, cacheFilePath(p_name)));
+        saveList();
+        return search;
+    }
+
+    QSharedPointer<VSavedSearch> search(new VSavedSearch(p_name,
+                                                         p_config,
+                                                         p_keyword,
+                                                         cacheFilePath(p_name)));
+    mgr->m_searches.append(search);
+    saveList();
+    return search;
+}
+
+void VSavedSearchManager::removeSearch(const QString &p_name)
+{
+    VSavedSearchManager *mgr = inst();
+    for (int i = 0; i < mgr->m_searches.size(); ++i) {
+        if (mgr->m_searches[i]->getName() == p_name) {
+            mgr->m_searches[i]->removeCache();
+            mgr->m_searches.remove(i);
+            saveList();
+            return;
+        }
+    }
+}
+
+QString VSavedSearchManager::listFilePath()
+{
+    return QDir(g_config->getConfigFolder()).filePath("saved_searches.json");
+}
+
+QString VSavedSearchManager::cacheFilePath(const QString &p_name)
+{
+    QByteArray hash = QCryptographicHash::hash(p_name.toUtf8(),
+                                               QCryptographicHash::Md5).toHex();
+    return QDir(g_config->getConfigFolder()).filePath(QString("saved_searches/%1.cache")
+                                                      .arg(QString::fromLatin1(hash)));
+}
@@ -0,0 +1,152 @@
+#ifndef VSAVEDSEARCH_H
+#define VSAVEDSEARCH_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSharedPointer>
+
+#include "vsearchconfig.h"
+
+// A search kept by name with the results of its last run.
+// Content results are cached per file along with the modified time of the
+// file, so a re-run only scans the files modified since the last run and
+// takes the cached results for the others.
+// Should be accessed only in the GUI thread.
+class VSavedSearch
+{
+public:
+    VSavedSearch(const QString &p_name,
+                 const QStringList &p_config,
+                 const QString &p_keyword,
+                 const QString &p_cacheFile);
+
+    const QString &getName() const;
+
+    // In the form of VSearchConfig::toConfig().
+    const QStringList &getConfig() const;
+
+    const QString &getKeyword() const;
+
+    qint64 getLastRunTime() const;
+
+    void setLastRunTime(qint64 p_time);
+
+    // Modified time of the files whose content was searched in last run.
+    QHash<QString, qint64> cachedModifiedTimes();
+
+    // Cached items of @p_paths bound to @p_config.
+    QList<QSharedPointer<VSearchResultItem> > cachedItems(const QStringList &p_paths,
+                                                          const QSharedPointer<VSearchConfig> &p_config);
+
+    // Record the content result of a file searched in current run.
+    void addRunItem(const QSharedPointer<VSearchResultItem> &p_item);
+
+    // Replace the cache with current run and write it to disk.
+    // @p_modifiedTimes: files whose content is searched in current run.
+    void commitRun(const QHash<QString, qint64> &p_modifiedTimes);
+
+    void abortRun();
+
+    // Remove the cache file.
+    void removeCache();
+
+private:
+    struct FileEntry
+    {
+        FileEntry()
+            : m_modifiedTime(0)
+        {
+        }
+
+        qint64 m_modifiedTime;
+
+        // Null if the file does not match.
+        QSharedPointer<VSearchResultItem> m_item;
+    };
+
+    void loadCache();
+
+    bool saveCache() const;
+
+    QString m_name;
+
+    QStringList m_config;
+
+    QString m_keyword;
+
+    QString m_cacheFile;
+
+    qint64 m_lastRunTime;
+
+    bool m_cacheLoaded;
+
+    // File path -> entry.
+    QHash<QString, FileEntry> m_cache;
+
+    // Content results of current run.
+    QHash<QString, QSharedPointer<VSearchResultItem> > m_runItems;
+};
+
+inline const QString &VSavedSearch::getName() const
+{
+    return m_name;
+}
+
+inline const QStringList &VSavedSearch::getConfig() const
+{
+    return m_config;
+}
+
+inline const QString &VSavedSearch::getKeyword() const
+{
+    return m_keyword;
+}
+
+inline qint64 VSavedSearch::getLastRunTime() const
+{
+    return m_lastRunTime;
+}
+
+inline void VSavedSearch::setLastRunTime(qint64 p_time)
+{
+    m_lastRunTime = p_time;
+}
+
+
+// Manage the saved searches, which are stored in the config folder.
+// Should be accessed only in the GUI thread.
+class VSavedSearchManager
+{
+public:
+    static const QVector<QSharedPointer<VSavedSearch> > &getSearches();
+
+    static QSharedPointer<VSavedSearch> getSearch(const QString &p_name);
+
+    // Add or replace the search named @p_name.
+    // The cache is kept only if the search does not change.
+    static QSharedPointer<VSavedSearch> saveSearch(const QString &p_name,
+                                                   const QStringList &p_config,
+                                                   const QString &p_keyword);
+
+    static void removeSearch(const QString &p_name);
+
+    // Write the list of searches to disk.
+    static bool saveList();
+
+private:
+    VSavedSearchManager();
+
+    static VSavedSearchManager *inst();
+
+    void loadList();
+
+    static QString listFilePath();
+
+    static QString cacheFilePath(const QString &p_name);
+
+    QVector<QSharedPointer<VSavedSearch> > m_searches;
+};
+
+#endif // VSAVEDSEARCH_H
@@ -0,0 +1,146 @@
+#include "vsaveservice.h"
+
+#include <QDebug>
+#include <QRunnable>
+#include <QCoreApplication>
+#include <QMutexLocker>
+#include <QFile>
+#include <QSet>
+
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS) || defined(Q_OS_MAC)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "utils/vutils.h"
+
+// Delay in ms to collect the writes of a batch, such as saving all the tabs.
+#define BATCH_DELAY 50
+
+class SaveTask : public QRunnable
+{
+public:
+    explicit SaveTask(VSaveService *p_service)
+        : m_service(p_service)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        m_service->writePending();
+    }
+
+private:
+    VSaveService *m_service;
+};
+
+
+VSaveService::VSaveService(QObject *p_parent)
+    : QObject(p_parent),
+      m_flushRequested(false),
+      m_scheduled(false),
+      m_nextId(0)
+{
+    m_pool.setMaxThreadCount(1);
+}
+
+VSaveService::~VSaveService()
+{
+    waitForDone();
+}
+
+VSaveService *VSaveService::inst()
+{
+    static VSaveService *service = new VSaveService(QCoreApplication::instance());
+    return service;
+}
+
+int VSaveService::save(const QString &p_file, const QString &p_text)
+{
+    int id = ++m_nextId;
+
+    QMutexLocker locker(&m_mutex);
+    Entry &entry = m_pending[p_file];
+    entry.m_text = p_text;
+    entry.m_ids.append(id);
+    if (!m_scheduled) {
+        m_scheduled = true;
+        m_pool.start(new SaveTask(this));
+    }
+
+    return id;
+}
+
+void VSaveService::waitForDone()
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        m_flushRequested = true;
+        m_flushCond.wakeAll();
+    }
+
+    m_pool.waitForDone();
+
+    QMutexLocker locker(&m_mutex);
+    m_flushRequested = false;
+}
+
+void VSaveService::writePending()
+{
+    QHash<QString, Entry> pending;
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_flushRequested) {
+            m_flushCond.wait(&m_mutex, BATCH_DELAY);
+        }
+
+        // Saves from now on will queue another task.
+        m_scheduled = false;
+        pending.swap(m_pending);
+    }
+
+    QHash<QString, bool> results;
+    QSet<QString> dirs;
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        bool succ = VUtils::writeFileToDisk(it.key(), it.value().m_text);
+        results.insert(it.key(), succ);
+        if (succ) {
+            dirs.insert(VUtils::basePathFromPath(it.key()));
+        }
+    }
+
+    // Make the renames durable, once per directory.
+    for (auto const & dir : dirs) {
+        syncDirectory(dir);
+    }
+
+    // The service waits for all the tasks before destruction.
+    for (auto it = pending.constBegin(); it != pending.constEnd(); ++it) {
+        bool succ = results.value(it.key());
+        for (int id : it.value().m_ids) {
+            QMetaObject::invokeMethod(this,
+                                      "saved",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(int, id),
+                                      Q_ARG(QString, it.key()),
+                                      Q_ARG(bool, succ));
+        }
+    }
+}
+
+void VSaveService::syncDirectory(const QString &p_dir)
+{
+#if defined(Q_OS_LINUX) || defined(Q_OS_MACOS) || defined(Q_OS_MAC)
+    int fd = ::open(QFile::encodeName(p_dir).constData(), O_RDONLY);
+    if (fd == -1) {
+        qWarning() << "fail to open directory" << p_dir << "to sync";
+        return;
+    }
+
+    ::fsync(fd);
+    ::close(fd);
+#else
+    // Renames are synced by the file system.
+    Q_UNUSED(p_dir);
+#endif
+}
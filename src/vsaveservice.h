@@ -0,0 +1,77 @@
+#ifndef VSAVESERVICE_H
+#define VSAVESERVICE_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QThreadPool>
+
+// Save files on a worker for the edit tabs.
+// Each file is written to a temporary file and renamed over the target.
+// Writes queued within a short delay are done in one batch, after which each
+// touched directory is synced only once.
+// Should be accessed only in the GUI thread.
+class VSaveService : public QObject
+{
+    Q_OBJECT
+public:
+    ~VSaveService();
+
+    static VSaveService *inst();
+
+    // Queue @p_text to be written to @p_file.
+    // A pending write to the same file is superseded and completes together
+    // with this one.
+    // Returns the ID of the request in saved().
+    int save(const QString &p_file, const QString &p_text);
+
+    // Write all the pending requests and wait for them.
+    // Completions are still delivered via saved() later.
+    void waitForDone();
+
+signals:
+    void saved(int p_id, const QString &p_file, bool p_succeeded);
+
+private:
+    friend class SaveTask;
+
+    struct Entry
+    {
+        QString m_text;
+
+        // Requests completed by this write.
+        QVector<int> m_ids;
+    };
+
+    explicit VSaveService(QObject *p_parent = nullptr);
+
+    // Wait for the delay and write the pending requests.
+    // Called on the worker.
+    void writePending();
+
+    static void syncDirectory(const QString &p_dir);
+
+    // Not VTaskExecutor: the worker idles on the batch delay, which would hold
+    // a shared slot, and waitForDone() must not queue behind CPU-bound work.
+    QThreadPool m_pool;
+
+    QMutex m_mutex;
+
+    // Wake the waiting worker to write at once.
+    QWaitCondition m_flushCond;
+
+    bool m_flushRequested;
+
+    // Whether a write task is queued.
+    bool m_scheduled;
+
+    int m_nextId;
+
+    // File path -> pending write.
+    QHash<QString, Entry> m_pending;
+};
+
+#endif // VSAVESERVICE_H
@@ -8,15 +8,56 @@
 #include "vmainwindow.h"
 #include "vtableofcontent.h"
 #include "vsearchengine.h"
+#include "vindexedsearchengine.h"
+#include "vexternalsearchengine.h"
+#include "vconfigmanager.h"
+#include "vdirectorycrawler.h"
+#include "vsavedsearch.h"
+#include "vnotemetadatastore.h"
+#include "vtracer.h"
+#include "vtagindex.h"
+#include "vtaguniverse.h"
+#include "vtaskexecutor.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QSet>
+#include <QTimer>
 
 extern VMainWindow *g_mainWin;
 
+extern VConfigManager *g_config;
+
+// Time in ms the result of last search could be refined against.
+#define REFINE_EXPIRE_TIME 60000
+
+// Interval in ms to hand the results of the buffer workers to the views.
+#define BUFFER_RESULT_DRAIN_INTERVAL 50
+
 VSearch::VSearch(QObject *p_parent)
     : QObject(p_parent),
       m_askedToStop(false),
-      m_engine(NULL)
+      m_engine(NULL),
+      m_firstPhaseWorker(NULL),
+      m_secondPhaseStarted(false),
+      m_generation(0),
+      m_finishedBufferWorkers(0)
 {
     m_slashReg = QRegExp("[\\/]");
+
+    m_bufferDrainTimer = new QTimer(this);
+    m_bufferDrainTimer->setInterval(BUFFER_RESULT_DRAIN_INTERVAL);
+    connect(m_bufferDrainTimer, &QTimer::timeout,
+            this, &VSearch::drainBufferResults);
+}
+
+// ID to match the trace events of one search.
+static QString traceId(const QSharedPointer<VSearchResult> &p_result)
+{
+    return QString::number((quintptr)p_result.data(), 16);
 }
 
 QSharedPointer<VSearchResult> VSearch::search(const QVector<VFile *> &p_files)
@@ -38,24 +79,29 @@ QSharedPointer<VSearchResult> VSearch::search(const QVector<VFile *> &p_files)
 
     result->m_state = VSearchState::Busy;
 
+    // Outline, tags and content are searched from the snapshots in workers.
+    QVector<VSearchBufferWorker::Buffer> buffers;
     for (auto const & it : p_files) {
         if (!it) {
             continue;
         }
 
-        searchFirstPhase(it, result, true);
+        searchFirstPhase(it, buffers);
 
         if (askedToStop()) {
             qDebug() << "asked to cancel the search";
             result->m_state = VSearchState::Cancelled;
-            break;
+            return result;
         }
     }
 
-    if (result->m_state == VSearchState::Busy) {
+    if (buffers.isEmpty()) {
         result->m_state = VSearchState::Success;
+        return result;
     }
 
+    startBufferWorkers(buffers, result);
+
     return result;
 }
 
@@ -80,14 +126,20 @@ QSharedPointer<VSearchResult> VSearch::search(VDirectory *p_directory)
 
     result->m_state = VSearchState::Busy;
 
-    searchFirstPhase(p_directory, result);
-
-    if (result->hasSecondPhaseItems()) {
-        searchSecondPhase(result);
-    } else if (result->m_state == VSearchState::Busy) {
-        result->m_state = VSearchState::Success;
+    VSearchFirstPhaseWorker::NoteFolder folder;
+    folder.m_path = p_directory->fetchPath();
+    folder.m_relativePath = p_directory->fetchRelativePath();
+    folder.m_testSelf = true;
+    folder.m_snapshot = p_directory->getNotebook()->getSnapshot();
+    folder.m_node = p_directory->getNode();
+    if (testObject(VSearchConfig::Metadata)) {
+        folder.m_metadataStore = VNoteMetadataStoreManager::storeForNotebook(p_directory->getNotebook());
     }
 
+    VSearchFirstPhaseWorker *worker = new VSearchFirstPhaseWorker(*m_config, this);
+    worker->setNoteFolders(QVector<VSearchFirstPhaseWorker::NoteFolder>(1, folder));
+    startFirstPhase(worker, result);
+
     return result;
 }
 
@@ -108,28 +160,62 @@ QSharedPointer<VSearchResult> VSearch::search(const QVector<VNotebook *> &p_note
         return result;
     }
 
+    // Saved searches track the modified time of each note walked through.
+    // Notebooks not indexed yet are walked through in background instead of
+    // building their indexes here.
+    if (m_config->m_object == VSearchConfig::Tag
+        && m_config->m_target == VSearchConfig::Note
+        && !m_savedSearch
+        && tagIndexesBuilt(p_notebooks)) {
+        searchTagsByIndex(p_notebooks, result);
+        return result;
+    }
+
     result->m_state = VSearchState::Busy;
 
+    QVector<VSearchFirstPhaseWorker::NoteFolder> folders;
     for (auto const & nb : p_notebooks) {
         if (!nb) {
             continue;
         }
 
-        searchFirstPhase(nb, result);
+        if (testTarget(VSearchConfig::Notebook)
+            && testObject(VSearchConfig::Name)) {
+            QString text = nb->getName();
+            if (matchNonContent(text)) {
+                VSearchResultItem *item = new VSearchResultItem(VSearchResultItem::Notebook,
+                                                                VSearchResultItem::LineNumber,
+                                                                text,
+                                                                nb->getPath());
+                QSharedPointer<VSearchResultItem> pitem(item);
+                emit resultItemAdded(pitem);
+            }
+        }
 
-        if (askedToStop()) {
-            qDebug() << "asked to cancel the search";
-            result->m_state = VSearchState::Cancelled;
-            break;
+        if (testTarget(VSearchConfig::Note)
+            || testTarget(VSearchConfig::Folder)) {
+            // Only sub-folders of the root folder are searched.
+            VSearchFirstPhaseWorker::NoteFolder folder;
+            folder.m_path = nb->getPath();
+            folder.m_testSelf = false;
+            folder.m_snapshot = nb->getSnapshot();
+            folder.m_node = nb->getRootDir()->getNode();
+            if (testObject(VSearchConfig::Metadata)) {
+                folder.m_metadataStore = VNoteMetadataStoreManager::storeForNotebook(nb);
+            }
+            folders.append(folder);
         }
     }
 
-    if (result->hasSecondPhaseItems()) {
-        searchSecondPhase(result);
-    } else if (result->m_state == VSearchState::Busy) {
+    if (folders.isEmpty()) {
         result->m_state = VSearchState::Success;
+        return result;
     }
 
+    VSearchFirstPhaseWorker *worker = new VSearchFirstPhaseWorker(*m_config, this);
+    worker->setNoteFolders(folders);
+    startFirstPhase(worker, result);
+
     return result;
 }
 
@@ -147,7 +233,8 @@ QSharedPointer<VSearchResult> VSearch::search(const QString &p_directoryPath)
     if ((!testTarget(VSearchConfig::Note)
          && !testTarget(VSearchConfig::Folder))
         || testObject(VSearchConfig::Outline)
-        || testObject(VSearchConfig::Tag)) {
+        || testObject(VSearchConfig::Tag)
+        || testObject(VSearchConfig::Metadata)) {
         qDebug() << "search is not applicable for directory";
         result->m_state = VSearchState::Success;
         return result;
@@ -155,20 +242,206 @@ QSharedPointer<VSearchResult> VSearch::search(const QString &p_directoryPath)
 
     result->m_state = VSearchState::Busy;
 
-    searchFirstPhase(p_directoryPath, p_directoryPath, result);
+    VSearchFirstPhaseWorker *worker = new VSearchFirstPhaseWorker(*m_config, this);
+    worker->setDirectory(p_directoryPath);
+    startFirstPhase(worker, result);
 
-    if (result->hasSecondPhaseItems()) {
-        searchSecondPhase(result);
-    } else if (result->m_state == VSearchState::Busy) {
+    return result;
+}
+
+QSharedPointer<VSearchResult> VSearch::refine(const QStringList &p_filePaths)
+{
+    Q_ASSERT(!askedToStop());
+
+    QSharedPointer<VSearchResult> result(new VSearchResult(this));
+
+    if (p_filePaths.isEmpty() || m_config->isEmpty()) {
         result->m_state = VSearchState::Success;
+        return result;
     }
 
+    // Engine will decide the final state.
+    result->m_state = VSearchState::Busy;
+    result->m_secondPhaseItems = p_filePaths;
+    m_result = result;
+    VTracer::asyncBegin("search", "Search", traceId(result), "refine");
+    searchSecondPhase(result);
+
     return result;
 }
 
-void VSearch::searchFirstPhase(VFile *p_file,
-                               const QSharedPointer<VSearchResult> &p_result,
-                               bool p_searchContent)
+void VSearch::setSavedSearch(const QSharedPointer<VSavedSearch> &p_search)
+{
+    m_savedSearch = p_search;
+}
+
+void VSearch::startFirstPhase(VSearchFirstPhaseWorker *p_worker,
+                              const QSharedPointer<VSearchResult> &p_result)
+{
+    clearFirstPhaseWorker();
+
+    m_modifiedTimes.clear();
+    if (m_savedSearch) {
+        p_worker->setCachedFiles(m_savedSearch->cachedModifiedTimes());
+    }
+
+    m_firstPhaseWorker = p_worker;
+    m_result = p_result;
+    m_secondPhaseStarted = false;
+
+    if (VTracer::isEnabled()) {
+        VTracer::asyncBegin("search",
+                            "Search",
+                            traceId(p_result),
+                            QString("scope %1 object %2 target %3").arg(m_config->m_scope)
+                                                                   .arg(m_config->m_object)
+                                                                   .arg(m_config->m_target));
+    }
+
+    // Signals are queued. Ignore the ones from workers of previous search.
+    int generation = ++m_generation;
+    connect(p_worker, &VSearchFirstPhaseWorker::resultItemsReady,
+            this, [this, generation](const QList<QSharedPointer<VSearchResultItem> > &p_items) {
+                if (generation == m_generation) {
+                    emit resultItemsAdded(p_items);
+                }
+            });
+    connect(p_worker, &VSearchFirstPhaseWorker::secondPhaseItemsReady,
+            this, [this, generation](const QStringList &p_items) {
+                if (generation == m_generation) {
+                    handleFirstPhaseItemsReady(p_items);
+                }
+            });
+    connect(p_worker, &VSearchFirstPhaseWorker::cachedItemsReady,
+            this, [this, generation](const QStringList &p_items) {
+                if (generation == m_generation) {
+                    handleCachedItemsReady(p_items);
+                }
+            });
+    connect(p_worker, &VSearchFirstPhaseWorker::finished,
+            this, [this, generation]() {
+                if (generation == m_generation) {
+                    handleFirstPhaseFinished();
+                }
+            });
+
+    p_worker->start();
+}
+
+void VSearch::handleFirstPhaseItemsReady(const QStringList &p_items)
+{
+    if (m_askedToStop || !m_result) {
+        return;
+    }
+
+    m_result->m_secondPhaseItems.append(p_items);
+
+    if (m_secondPhaseStarted) {
+        m_engine->appendSecondPhaseItems(p_items);
+        return;
+    }
+
+    // Start second phase right away if the engine could consume items
+    // incrementally. Otherwise, wait until first phase finishes.
+    ensureEngine();
+    if (m_engine && m_engine->isStreamingSupported()) {
+        m_result->m_secondPhasePending = true;
+        m_secondPhaseStarted = true;
+        m_engine->search(m_config, m_result);
+    }
+}
+
+void VSearch::handleCachedItemsReady(const QStringList &p_items)
+{
+    if (m_askedToStop || !m_result || !m_savedSearch) {
+        return;
+    }
+
+    QList<QSharedPointer<VSearchResultItem> > items = m_savedSearch->cachedItems(p_items, m_config);
+    if (!items.isEmpty()) {
+        emit resultItemsAdded(items);
+    }
+}
+
+void VSearch::handleFirstPhaseFinished()
+{
+    Q_ASSERT(m_firstPhaseWorker && m_firstPhaseWorker->isFinished());
+    VSearchState state = m_firstPhaseWorker->m_state;
+    if (!m_firstPhaseWorker->m_error.isEmpty()) {
+        m_result->logError(m_firstPhaseWorker->m_error);
+    }
+
+    m_modifiedTimes.swap(m_firstPhaseWorker->m_modifiedTimes);
+
+    m_firstPhaseWorker->deleteLater();
+    m_firstPhaseWorker = NULL;
+
+    QSharedPointer<VSearchResult> result = m_result;
+    if (m_secondPhaseStarted) {
+        // Engine will emit finished() when all items are done.
+        result->m_secondPhasePending = false;
+        if (state == VSearchState::Cancelled) {
+            m_engine->stop();
+        }
+
+        m_engine->endSecondPhaseItems();
+        return;
+    }
+
+    if (state == VSearchState::Cancelled || m_askedToStop) {
+        qDebug() << "asked to cancel the search";
+        result->m_state = VSearchState::Cancelled;
+        finishSearch(result);
+        return;
+    }
+
+    if (result->hasSecondPhaseItems()) {
+        // Engine will decide the final state.
+        searchSecondPhase(result);
+        if (!m_engine) {
+            finishSearch(result);
+        }
+    } else {
+        result->m_state = state == VSearchState::Fail ? VSearchState::Fail
+                                                      : VSearchState::Success;
+        finishSearch(result);
+    }
+}
+
+void VSearch::finishSearch(const QSharedPointer<VSearchResult> &p_result)
+{
+    if (m_savedSearch) {
+        // Keep the cache of last run if this one is incomplete.
+        if (p_result->m_state == VSearchState::Success && !p_result->hasError()) {
+            m_savedSearch->commitRun(m_modifiedTimes);
+            m_savedSearch->setLastRunTime(QDateTime::currentMSecsSinceEpoch());
+            VSavedSearchManager::saveList();
+        } else {
+            m_savedSearch->abortRun();
+        }
+
+        m_savedSearch.clear();
+    }
+
+    m_modifiedTimes.clear();
+
+    VTracer::asyncEnd("search", "Search", traceId(p_result));
+
+    emit finished(p_result);
+}
+
+void VSearch::clearFirstPhaseWorker()
+{
+    if (m_firstPhaseWorker) {
+        m_firstPhaseWorker->stop();
+        m_firstPhaseWorker->wait();
+
+        delete m_firstPhaseWorker;
+        m_firstPhaseWorker = NULL;
+    }
+}
+
+void VSearch::searchFirstPhase(VFile *p_file, QVector<VSearchBufferWorker::Buffer> &p_buffers)
 {
     Q_ASSERT(testTarget(VSearchConfig::Note));
 
@@ -208,287 +481,156 @@ void VSearch::searchFirstPhase(VFile *p_file,
         }
     }
 
-    if (testObject(VSearchConfig::Outline)) {
-        VSearchResultItem *item = searchForOutline(p_file);
-        if (item) {
-            QSharedPointer<VSearchResultItem> pitem(item);
-            emit resultItemAdded(pitem);
-        }
-    }
-
-    if (testObject(VSearchConfig::Tag)) {
-        VSearchResultItem *item = searchForTag(p_file);
+    if (testObject(VSearchConfig::Metadata)) {
+        VSearchResultItem *item = searchForMetadata(p_file);
         if (item) {
             QSharedPointer<VSearchResultItem> pitem(item);
             emit resultItemAdded(pitem);
         }
     }
 
-    if (testObject(VSearchConfig::Content)) {
-        // Search content in first phase.
-        if (p_searchContent) {
-            VSearchResultItem *item = searchForContent(p_file);
-            if (item) {
-                QSharedPointer<VSearchResultItem> pitem(item);
-                emit resultItemAdded(pitem);
-            }
-        } else {
-            // Add an item for second phase process.
-            p_result->addSecondPhaseItem(filePath);
-        }
+    bool needOutline = false;
+    if (testObject(VSearchConfig::Outline)) {
+        // No main window in batch mode.
+        needOutline = g_mainWin && g_mainWin->getEditArea()->getTab(p_file);
     }
-}
-
-void VSearch::searchFirstPhase(VDirectory *p_directory,
-                               const QSharedPointer<VSearchResult> &p_result)
-{
-    Q_ASSERT(testTarget(VSearchConfig::Note) || testTarget(VSearchConfig::Folder));
 
-    bool opened = p_directory->isOpened();
-    if (!opened && !p_directory->open()) {
-        p_result->logError(QString("Fail to open folder %1.").arg(p_directory->fetchRelativePath()));
-        p_result->m_state = VSearchState::Fail;
+    bool needTag = testObject(VSearchConfig::Tag) && p_file->getType() == FileType::Note;
+    bool needContent = testObject(VSearchConfig::Content);
+    if (!needOutline && !needTag && !needContent) {
         return;
     }
 
-    if (testTarget(VSearchConfig::Folder)) {
-        QString name = p_directory->getName();
-        QString dirPath = p_directory->fetchPath();
-        if (testObject(VSearchConfig::Name)) {
-            if (matchNonContent(name)) {
-                VSearchResultItem *item = new VSearchResultItem(VSearchResultItem::Folder,
-                                                                VSearchResultItem::LineNumber,
-                                                                name,
-                                                                dirPath);
-                QSharedPointer<VSearchResultItem> pitem(item);
-                emit resultItemAdded(pitem);
-            }
-        }
-
-        if (testObject(VSearchConfig::Path)) {
-            QString normPath(p_directory->fetchRelativePath());
-            removeSlashFromPath(normPath);
-            if (matchNonContent(normPath)) {
-                VSearchResultItem *item = new VSearchResultItem(VSearchResultItem::Folder,
-                                                                VSearchResultItem::LineNumber,
-                                                                name,
-                                                                dirPath);
-                QSharedPointer<VSearchResultItem> pitem(item);
-                emit resultItemAdded(pitem);
-            }
-        }
+    VSearchBufferWorker::Buffer buffer;
+    buffer.m_name = name;
+    buffer.m_path = filePath;
+    if (needOutline) {
+        buffer.m_outline = g_mainWin->getEditArea()->getTab(p_file)->getOutline().getTable();
     }
 
-    // Search files.
-    if (testTarget(VSearchConfig::Note)) {
-        for (auto const & file : p_directory->getFiles()) {
-            if (askedToStop()) {
-                qDebug() << "asked to cancel the search";
-                p_result->m_state = VSearchState::Cancelled;
-                goto exit;
-            }
-
-            searchFirstPhase(file, p_result);
-        }
+    if (needTag) {
+        buffer.m_tags = static_cast<VNoteFile *>(p_file)->getTags();
     }
 
-    // Search subfolders.
-    for (auto const & dir : p_directory->getSubDirs()) {
-        if (askedToStop()) {
-            qDebug() << "asked to cancel the search";
-            p_result->m_state = VSearchState::Cancelled;
-            goto exit;
-        }
-
-        searchFirstPhase(dir, p_result);
+    if (needContent) {
+        Q_ASSERT(p_file->isOpened());
+        buffer.m_content = p_file->getContent();
     }
 
-exit:
-    if (!opened) {
-        p_directory->close();
-    }
+    p_buffers.append(buffer);
 }
 
-void VSearch::searchFirstPhase(VNotebook *p_notebook,
-                               const QSharedPointer<VSearchResult> &p_result)
+void VSearch::startBufferWorkers(const QVector<VSearchBufferWorker::Buffer> &p_buffers,
+                                 const QSharedPointer<VSearchResult> &p_result)
 {
-    bool opened = p_notebook->isOpened();
-    if (!opened && !p_notebook->open()) {
-        p_result->logError(QString("Fail to open notebook %1.").arg(p_notebook->getName()));
-        p_result->m_state = VSearchState::Fail;
-        return;
-    }
+    clearBufferWorkers();
 
-    if (testTarget(VSearchConfig::Notebook)
-        && testObject(VSearchConfig::Name)) {
-        QString text = p_notebook->getName();
-        if (matchNonContent(text)) {
-            VSearchResultItem *item = new VSearchResultItem(VSearchResultItem::Notebook,
-                                                            VSearchResultItem::LineNumber,
-                                                            text,
-                                                            p_notebook->getPath());
-            QSharedPointer<VSearchResultItem> pitem(item);
-            emit resultItemAdded(pitem);
-        }
-    }
+    int numThread = qMin(VTaskExecutor::inst()->quota(VTaskExecutor::Search), p_buffers.size());
 
-    if (!testTarget(VSearchConfig::Note)
-        && !testTarget(VSearchConfig::Folder)) {
-        goto exit;
-    }
+    m_result = p_result;
+    m_finishedBufferWorkers = 0;
 
-    // Search for subfolders.
-    for (auto const & dir : p_notebook->getRootDir()->getSubDirs()) {
-        if (askedToStop()) {
-            qDebug() << "asked to cancel the search";
-            p_result->m_state = VSearchState::Cancelled;
-            goto exit;
-        }
+    QSharedPointer<VSearchBufferWorker::Queue> queue(new VSearchBufferWorker::Queue(p_buffers));
 
-        searchFirstPhase(dir, p_result);
-    }
+    // Results of workers of previous search go to the previous queue.
+    m_bufferResultQueue.reset(new VSearchEngineResultQueue());
+    m_bufferDrainTimer->start();
+
+    // Signals are queued. Ignore the ones from workers of previous search.
+    int generation = ++m_generation;
+    m_bufferWorkers.reserve(numThread);
+    for (int i = 0; i < numThread; ++i) {
+        VSearchBufferWorker *th = new VSearchBufferWorker(queue, m_bufferResultQueue, m_config, this);
+        connect(th, &VSearchBufferWorker::finished,
+                this, [this, generation]() {
+                    if (generation == m_generation) {
+                        handleBufferWorkerFinished();
+                    }
+                });
 
-exit:
-    if (!opened) {
-        p_notebook->close();
+        m_bufferWorkers.append(th);
+        VTaskExecutor::inst()->start(th, VTaskExecutor::Search);
     }
 }
 
-void VSearch::searchFirstPhase(const QString &p_basePath,
-                               const QString &p_directoryPath,
-                               const QSharedPointer<VSearchResult> &p_result)
+void VSearch::handleBufferWorkerFinished()
 {
-    Q_ASSERT(testTarget(VSearchConfig::Note) || testTarget(VSearchConfig::Folder));
-    Q_ASSERT(!p_directoryPath.isEmpty());
-
-    QDir dir(p_directoryPath);
-    if (!dir.exists()) {
-        p_result->logError(QString("Directory %1 does not exist.").arg(p_directoryPath));
-        p_result->m_state = VSearchState::Fail;
+    if (++m_finishedBufferWorkers < m_bufferWorkers.size()) {
         return;
     }
 
-    Q_ASSERT(dir.isAbsolute());
-
-    if (testTarget(VSearchConfig::Folder)) {
-        QString name = dir.dirName();
-        if (testObject(VSearchConfig::Name)) {
-            if (matchNonContent(name)) {
-                VSearchResultItem *item = new VSearchResultItem(VSearchResultItem::Folder,
-                                                                VSearchResultItem::LineNumber,
-                                                                name,
-                                                                p_directoryPath);
-                QSharedPointer<VSearchResultItem> pitem(item);
-                emit resultItemAdded(pitem);
-            }
-        }
-
-        if (testObject(VSearchConfig::Path)) {
-            QString normPath(QDir(p_basePath).relativeFilePath(p_directoryPath));
-            removeSlashFromPath(normPath);
-            if (matchNonContent(normPath)) {
-                VSearchResultItem *item = new VSearchResultItem(VSearchResultItem::Folder,
-                                                                VSearchResultItem::LineNumber,
-                                                                name,
-                                                                p_directoryPath);
-                QSharedPointer<VSearchResultItem> pitem(item);
-                emit resultItemAdded(pitem);
-            }
+    VSearchState state = VSearchState::Success;
+    for (auto const & th : m_bufferWorkers) {
+        if (th->m_state == VSearchState::Cancelled) {
+            state = VSearchState::Cancelled;
         }
     }
 
-    if (testTarget(VSearchConfig::Note)) {
-        QStringList files = dir.entryList(QDir::Files);
-        for (auto const & file : files) {
-            if (askedToStop()) {
-                qDebug() << "asked to cancel the search";
-                p_result->m_state = VSearchState::Cancelled;
-                return;
-            }
+    m_finishedBufferWorkers = 0;
 
-            searchFirstPhaseFile(p_basePath, dir.absoluteFilePath(file), p_result);
-        }
-    }
+    // All the workers have appended their results before finished.
+    m_bufferDrainTimer->stop();
+    drainBufferResults();
 
-    // Search subfolders.
-    QStringList subdirs = dir.entryList(QDir::AllDirs | QDir::NoDotAndDotDot);
-    for (auto const & sub : subdirs) {
-        if (askedToStop()) {
-            qDebug() << "asked to cancel the search";
-            p_result->m_state = VSearchState::Cancelled;
-            return;
-        }
-
-        searchFirstPhase(p_basePath, dir.absoluteFilePath(sub), p_result);
-    }
+    QSharedPointer<VSearchResult> result = m_result;
+    result->m_state = state;
+    emit finished(result);
 }
 
-void VSearch::searchFirstPhaseFile(const QString &p_basePath,
-                                   const QString &p_filePath,
-                                   const QSharedPointer<VSearchResult> &p_result)
+void VSearch::drainBufferResults()
 {
-    Q_ASSERT(testTarget(VSearchConfig::Note));
-
-    QString name = VUtils::fileNameFromPath(p_filePath);
-    if (!matchPattern(name)) {
+    if (!m_bufferResultQueue) {
         return;
     }
 
-    if (testObject(VSearchConfig::Name)) {
-        if (matchNonContent(name)) {
-            VSearchResultItem *item = new VSearchResultItem(VSearchResultItem::Note,
-                                                            VSearchResultItem::LineNumber,
-                                                            name,
-                                                            p_filePath);
-            QSharedPointer<VSearchResultItem> pitem(item);
-            emit resultItemAdded(pitem);
-        }
+    QList<QSharedPointer<VSearchResultItem> > items = m_bufferResultQueue->takeAll();
+    if (!items.isEmpty()) {
+        emit resultItemsAdded(items);
     }
+}
 
-    if (testObject(VSearchConfig::Path)) {
-        QString normFilePath(QDir(p_basePath).relativeFilePath(p_filePath));
-        removeSlashFromPath(normFilePath);
-        if (matchNonContent(normFilePath)) {
-            VSearchResultItem *item = new VSearchResultItem(VSearchResultItem::Note,
-                                                            VSearchResultItem::LineNumber,
-                                                            name,
-                                                            p_filePath);
-            QSharedPointer<VSearchResultItem> pitem(item);
-            emit resultItemAdded(pitem);
+void VSearch::clearBufferWorkers()
+{
+    for (auto const & th : m_bufferWorkers) {
+        th->stop();
+
+        // Only wait for the started ones.
+        if (!VTaskExecutor::inst()->cancel(th)) {
+            th->waitForFinished();
         }
-    }
 
-    if (testObject(VSearchConfig::Content)) {
-        // Add an item for second phase process.
-        p_result->addSecondPhaseItem(p_filePath);
+        delete th;
     }
+
+    m_bufferWorkers.clear();
+    m_finishedBufferWorkers = 0;
+
+    m_bufferDrainTimer->stop();
+    m_bufferResultQueue.clear();
 }
 
-VSearchResultItem *VSearch::searchForOutline(const VFile *p_file) const
+VSearchResultItem *VSearch::searchForOutline(const QString &p_name,
+                                             const QString &p_path,
+                                             const QVector<VTableOfContentItem> &p_outline,
+                                             const VSearchToken &p_token,
+                                             const QSharedPointer<VSearchConfig> &p_config)
 {
-    VEditTab *tab = g_mainWin->getEditArea()->getTab(p_file);
-    if (!tab) {
-        return NULL;
-    }
-
-    const VTableOfContent &toc = tab->getOutline();
-    const QVector<VTableOfContentItem> &table = toc.getTable();
     VSearchResultItem *item = NULL;
-    for (auto const & it: table) {
+    for (auto const & it: p_outline) {
         if (it.isEmpty()) {
             continue;
         }
 
-        if (!matchNonContent(it.m_name)) {
+        if (!p_token.matched(it.m_name)) {
             continue;
         }
 
         if (!item) {
             item = new VSearchResultItem(VSearchResultItem::Note,
                                          VSearchResultItem::OutlineIndex,
-                                         p_file->getName(),
-                                         p_file->fetchPath(),
-                                         m_config);
+                                         p_name,
+                                         p_path,
+                                         p_config);
         }
 
         VSearchResultSubItem sitem(it.m_index, it.m_name);
@@ -498,16 +640,12 @@ VSearchResultItem *VSearch::searchForOutline(const VFile *p_file) const
     return item;
 }
 
-VSearchResultItem *VSearch::searchForTag(const VFile *p_file) const
+VSearchResultItem *VSearch::searchForTag(const QString &p_name,
+                                         const QString &p_path,
+                                         const QStringList &p_tags,
+                                         VSearchToken &p_token)
 {
-    if (p_file->getType() != FileType::Note) {
-        return NULL;
-    }
-
-    const VNoteFile *file = static_cast<const VNoteFile *>(p_file);
-    const QStringList &tags = file->getTags();
-
-    VSearchToken &contentToken = m_config->m_contentToken;
+    VSearchToken &contentToken = p_token;
     bool singleToken = contentToken.tokenSize() == 1;
     if (!singleToken) {
         contentToken.startBatchMode();
@@ -516,8 +654,8 @@ VSearchResultItem *VSearch::searchForTag(const VFile *p_file) const
     VSearchResultItem *item = NULL;
     bool allMatched = false;
 
-    for (int i = 0; i < tags.size(); ++i) {
-        const QString &tag = tags[i];
+    for (int i = 0; i < p_tags.size(); ++i) {
+        const QString &tag = p_tags[i];
         if (tag.isEmpty()) {
             continue;
         }
@@ -533,8 +671,8 @@ VSearchResultItem *VSearch::searchForTag(const VFile *p_file) const
             if (!item) {
                 item = new VSearchResultItem(VSearchResultItem::Note,
                                              VSearchResultItem::LineNumber,
-                                             file->getName(),
-                                             file->fetchPath());
+                                             p_name,
+                                             p_path);
             }
 
             VSearchResultSubItem sitem(i, tag);
@@ -560,20 +698,98 @@ VSearchResultItem *VSearch::searchForTag(const VFile *p_file) const
     return item;
 }
 
-VSearchResultItem *VSearch::searchForContent(const VFile *p_file) const
+bool VSearch::tagIndexesBuilt(const QVector<VNotebook *> &p_notebooks)
+{
+    bool built = true;
+    for (auto nb : p_notebooks) {
+        if (nb && !nb->getTagIndex()->isBuilt()) {
+            // For next search.
+            nb->requestTagIndex();
+            built = false;
+        }
+    }
+
+    return built;
+}
+
+void VSearch::searchTagsByIndex(const QVector<VNotebook *> &p_notebooks,
+                                const QSharedPointer<VSearchResult> &p_result)
+{
+    QVector<VNotebook *> notebooks;
+    QVector<const VTagIndex *> indexes;
+    for (auto nb : p_notebooks) {
+        if (nb) {
+            notebooks.append(nb);
+            indexes.append(nb->getTagIndex());
+        }
+    }
+
+    // A note matches only if some of its tags match any token.
+    VSearchToken &contentToken = m_config->m_contentToken;
+    QStringList tags;
+    for (auto const & tag : VTagUniverse::inst()->getTags()) {
+        contentToken.startBatchMode();
+        bool matched = contentToken.matchBatchMode(tag);
+        contentToken.endBatchMode();
+        if (matched) {
+            tags.append(tag);
+        }
+    }
+
+    QList<QSharedPointer<VSearchResultItem> > items;
+    for (int i = 0; i < indexes.size() && !tags.isEmpty(); ++i) {
+        QSet<QString> noteSet;
+        for (auto const & tag : tags) {
+            for (auto const & note : indexes[i]->notesOfTag(tag)) {
+                noteSet.insert(note);
+            }
+        }
+
+        QStringList notes = noteSet.toList();
+        notes.sort();
+
+        QDir dir(notebooks[i]->getPath());
+        for (auto const & note : notes) {
+            QString name = VUtils::fileNameFromPath(note);
+            if (!matchPattern(name)) {
+                continue;
+            }
+
+            VSearchResultItem *item = searchForTag(name,
+                                                   dir.filePath(note),
+                                                   indexes[i]->tagsOfNote(note),
+                                                   contentToken);
+            if (item) {
+                items.append(QSharedPointer<VSearchResultItem>(item));
+            }
+        }
+
+        if (askedToStop()) {
+            break;
+        }
+    }
+
+    if (!items.isEmpty()) {
+        emit resultItemsAdded(items);
+    }
+
+    p_result->m_state = askedToStop() ? VSearchState::Cancelled : VSearchState::Success;
+}
+
+VSearchResultItem *VSearch::searchForContent(const QString &p_name,
+                                             const QString &p_path,
+                                             const QString &p_content,
+                                             VSearchToken &p_token,
+                                             const QSharedPointer<VSearchConfig> &p_config)
 {
-    Q_ASSERT(p_file->isOpened());
-    const QString &content = p_file->getContent();
+    const QString &content = p_content;
     if (content.isEmpty()) {
         return NULL;
     }
 
     VSearchResultItem *item = NULL;
     int lineNum = 1;
-    int pos = 0;
-    int size = content.size();
-    QRegExp newLineReg = QRegExp("\\n|\\r\\n|\\r");
-    VSearchToken &contentToken = m_config->m_contentToken;
+    VSearchToken &contentToken = p_token;
     bool singleToken = contentToken.tokenSize() == 1;
     if (!singleToken) {
         contentToken.startBatchMode();
@@ -581,14 +797,10 @@ VSearchResultItem *VSearch::searchForContent(const VFile *p_file) const
 
     bool allMatched = false;
 
-    while (pos < size) {
-        int idx = content.indexOf(newLineReg, pos);
-        if (idx == -1) {
-            idx = size;
-        }
-
-        if (idx > pos) {
-            QString lineText = content.mid(pos, idx - pos);
+    QStringRef lineText;
+    VSearchLineIterator lineIt(content);
+    while (lineIt.next(lineText)) {
+        if (!lineText.isEmpty()) {
             bool matched = false;
             if (singleToken) {
                 matched = contentToken.matched(lineText);
@@ -600,25 +812,21 @@ VSearchResultItem *VSearch::searchForContent(const VFile *p_file) const
                 if (!item) {
                     item = new VSearchResultItem(VSearchResultItem::Note,
                                                  VSearchResultItem::LineNumber,
-                                                 p_file->getName(),
-                                                 p_file->fetchPath(),
-                                                 m_config);
+                                                 p_name,
+                                                 p_path,
+                                                 p_config);
                 }
 
-                VSearchResultSubItem sitem(lineNum, lineText);
+                // Only copy the lines matched.
+                VSearchResultSubItem sitem(lineNum, lineText.toString());
                 item->m_matches.append(sitem);
             }
         }
 
-        if (idx == size) {
-            break;
-        }
-
         if (!singleToken && contentToken.readyToEndBatchMode(allMatched)) {
             break;
         }
 
-        pos = idx + newLineReg.matchedLength();
         ++lineNum;
     }
 
@@ -636,34 +844,96 @@ VSearchResultItem *VSearch::searchForContent(const VFile *p_file) const
     return item;
 }
 
+VSearchResultItem *VSearch::searchForMetadata(const VFile *p_file) const
+{
+    if (p_file->getType() != FileType::Note) {
+        return NULL;
+    }
+
+    const VNoteFile *file = static_cast<const VNoteFile *>(p_file);
+    const VMetadataQuery &query = m_config->m_metadataQuery;
+
+    VNoteMetadata meta;
+    if (!query.frontMatterKeys().isEmpty()) {
+        QString filePath = file->fetchPath();
+        QSharedPointer<VNoteMetadataStore> store = VNoteMetadataStoreManager::storeForNotebook(file->getNotebook());
+        store->refreshFile(filePath,
+                           file->getCreatedTimeUtc().toMSecsSinceEpoch(),
+                           file->getModifiedTimeUtc().toMSecsSinceEpoch(),
+                           file->getTags());
+        store->fetch(filePath, query.frontMatterKeys(), meta);
+    }
+
+    meta.m_name = file->getName();
+    meta.m_createdTime = file->getCreatedTimeUtc().toMSecsSinceEpoch();
+    meta.m_modifiedTime = file->getModifiedTimeUtc().toMSecsSinceEpoch();
+    meta.m_tags = file->getTags();
+    if (!query.matched(meta)) {
+        return NULL;
+    }
+
+    return new VSearchResultItem(VSearchResultItem::Note,
+                                 VSearchResultItem::LineNumber,
+                                 file->getName(),
+                                 file->fetchPath());
+}
+
 void VSearch::searchSecondPhase(const QSharedPointer<VSearchResult> &p_result)
 {
-    delete m_engine;
-    m_engine = NULL;
+    ensureEngine();
+    if (!m_engine) {
+        p_result->m_state = VSearchState::Success;
+        return;
+    }
+
+    m_engine->search(m_config, p_result);
+}
+
+void VSearch::ensureEngine()
+{
+    if (m_engine) {
+        return;
+    }
 
     switch (m_config->m_engine) {
     case VSearchConfig::Internal:
-    {
         m_engine = new VSearchEngine(this);
-        m_engine->search(m_config, p_result);
         break;
-    }
+
+    case VSearchConfig::Indexed:
+        m_engine = new VIndexedSearchEngine(this);
+        break;
+
+    case VSearchConfig::External:
+        m_engine = new VExternalSearchEngine(this);
+        break;
 
     default:
-        p_result->m_state = VSearchState::Success;
         break;
     }
 
     if (m_engine) {
         connect(m_engine, &ISearchEngine::finished,
-                this, &VSearch::finished);
+                this, &VSearch::finishSearch);
         connect(m_engine, &ISearchEngine::resultItemsAdded,
-                this, &VSearch::resultItemsAdded);
+                this, [this](const QList<QSharedPointer<VSearchResultItem> > &p_items) {
+                    if (m_savedSearch) {
+                        for (auto const & item : p_items) {
+                            m_savedSearch->addRunItem(item);
+                        }
+                    }
+
+                    emit resultItemsAdded(p_items);
+                });
     }
 }
 
 void VSearch::clear()
 {
+    clearFirstPhaseWorker();
+
+    clearBufferWorkers();
+
     m_config.clear();
 
     if (m_engine) {
@@ -673,6 +943,15 @@ void VSearch::clear()
         m_engine = NULL;
     }
 
+    if (m_savedSearch) {
+        m_savedSearch->abortRun();
+        m_savedSearch.clear();
+    }
+
+    m_modifiedTimes.clear();
+
+    m_result.clear();
+    m_secondPhaseStarted = false;
     m_askedToStop = false;
 }
 
@@ -681,7 +960,514 @@ void VSearch::stop()
     qDebug() << "VSearch asked to stop";
     m_askedToStop = true;
 
+    if (m_firstPhaseWorker) {
+        m_firstPhaseWorker->stop();
+    }
+
+    for (auto const & th : m_bufferWorkers) {
+        th->stop();
+    }
+
     if (m_engine) {
         m_engine->stop();
     }
 }
+
+
+int VSearchRefiner::s_changes = 0;
+
+bool VSearchRefiner::refine(const VSearchConfig &p_config,
+                            const QString &p_scopeKey,
+                            QStringList &p_filePaths) const
+{
+    if (!m_last.m_config
+        || m_last.m_changes != s_changes
+        || m_last.m_scopeKey != p_scopeKey
+        || QDateTime::currentMSecsSinceEpoch() - m_last.m_finishedTime > REFINE_EXPIRE_TIME
+        || !m_last.m_config->isNarrowedBy(p_config)) {
+        return false;
+    }
+
+    p_filePaths = m_last.m_filePaths;
+    return true;
+}
+
+void VSearchRefiner::begin(const QSharedPointer<VSearchConfig> &p_config, const QString &p_scopeKey)
+{
+    m_current = Search();
+    m_current.m_config = p_config;
+    m_current.m_scopeKey = p_scopeKey;
+    m_current.m_changes = s_changes;
+}
+
+void VSearchRefiner::addResultItem(const QSharedPointer<VSearchResultItem> &p_item)
+{
+    if (m_current.m_config && p_item->m_type == VSearchResultItem::Note) {
+        m_current.m_filePaths.append(p_item->m_path);
+    }
+}
+
+void VSearchRefiner::addResultItems(const QList<QSharedPointer<VSearchResultItem> > &p_items)
+{
+    for (auto const & item : p_items) {
+        addResultItem(item);
+    }
+}
+
+void VSearchRefiner::end(const QSharedPointer<VSearchResult> &p_result)
+{
+    if (m_current.m_config
+        && p_result->m_state == VSearchState::Success
+        && !p_result->hasError()) {
+        m_last = m_current;
+        m_last.m_filePaths.removeDuplicates();
+        m_last.m_finishedTime = QDateTime::currentMSecsSinceEpoch();
+    }
+
+    m_current = Search();
+}
+
+void VSearchRefiner::abandon()
+{
+    m_current = Search();
+}
+
+
+VSearchFirstPhaseWorker::VSearchFirstPhaseWorker(const VSearchConfig &p_config, QObject *p_parent)
+    : QThread(p_parent),
+      m_stop(0),
+      m_config(p_config),
+      m_state(VSearchState::Idle),
+      m_lastPostTime(0),
+      m_trackModifiedTime(false)
+{
+    if (!m_config.m_pattern.isEmpty()) {
+        m_patternReg = QRegExp(m_config.m_pattern, Qt::CaseInsensitive, QRegExp::Wildcard);
+    }
+
+    m_slashReg = QRegExp("[\\/]");
+}
+
+void VSearchFirstPhaseWorker::setNoteFolders(const QVector<NoteFolder> &p_folders)
+{
+    m_noteFolders = p_folders;
+    m_directoryPath.clear();
+}
+
+void VSearchFirstPhaseWorker::setDirectory(const QString &p_directoryPath)
+{
+    m_directoryPath = p_directoryPath;
+    m_excludePatterns = g_config->getSearchExcludePatterns();
+    m_noteFolders.clear();
+}
+
+void VSearchFirstPhaseWorker::setCachedFiles(const QHash<QString, qint64> &p_cachedTimes)
+{
+    m_trackModifiedTime = true;
+    m_cachedTimes = p_cachedTimes;
+}
+
+void VSearchFirstPhaseWorker::stop()
+{
+    m_stop.store(1);
+}
+
+void VSearchFirstPhaseWorker::run()
+{
+    m_state = VSearchState::Busy;
+    m_lastPostTime = QDateTime::currentMSecsSinceEpoch();
+
+    {
+        V_TRACE("search", "First phase");
+        if (!m_directoryPath.isEmpty()) {
+            walkDirectory(m_directoryPath);
+        } else {
+            for (auto const & folder : m_noteFolders) {
+                if (m_stop.load() == 1) {
+                    break;
+                }
+
+                walkNoteFolder(folder);
+            }
+        }
+
+        postItems(true);
+    }
+
+    if (m_stop.load() == 1) {
+        m_state = VSearchState::Cancelled;
+    } else if (m_state == VSearchState::Busy) {
+        m_state = VSearchState::Success;
+    }
+}
+
+void VSearchFirstPhaseWorker::walkNoteFolder(const NoteFolder &p_folder)
+{
+    // Use a stack instead of recursion and keep the pre-order.
+    QVector<NoteFolder> folders;
+    folders.append(p_folder);
+    while (!folders.isEmpty()) {
+        if (m_stop.load() == 1) {
+            return;
+        }
+
+        NoteFolder folder = folders.takeLast();
+        QJsonObject configJson = folder.m_node ? folder.m_node->getConfig()
+                                               : folder.m_snapshot->readDirectoryConfig(folder.m_path);
+        if (configJson.isEmpty()) {
+            logError(QString("Fail to open folder %1.").arg(folder.m_relativePath));
+            m_state = VSearchState::Fail;
+            continue;
+        }
+
+        QDir dir(folder.m_path);
+        if (folder.m_testSelf) {
+            if (testTarget(VSearchConfig::Folder)) {
+                testFolder(VUtils::fileNameFromPath(folder.m_path),
+                           folder.m_path,
+                           folder.m_relativePath);
+            }
+
+            if (testTarget(VSearchConfig::Note)) {
+                QJsonArray fileJson = configJson[DirConfig::c_files].toArray();
+                for (int i = 0; i < fileJson.size(); ++i) {
+                    QJsonObject fileItem = fileJson[i].toObject();
+                    QString name = fileItem[DirConfig::c_name].toString();
+
+                    QStringList tags;
+                    QJsonArray tagsJson = fileItem[DirConfig::c_tags].toArray();
+                    for (int j = 0; j < tagsJson.size(); ++j) {
+                        tags.append(tagsJson[j].toString());
+                    }
+
+                    testFile(name,
+                             dir.filePath(name),
+                             QDir(folder.m_relativePath).filePath(name),
+                             &tags);
+
+                    if (testObject(VSearchConfig::Metadata)) {
+                        testMetadata(folder, name, dir.filePath(name), fileItem, tags);
+                    }
+                }
+            }
+        }
+
+        QJsonArray dirJson = configJson[DirConfig::c_subDirectories].toArray();
+        for (int i = dirJson.size() - 1; i >= 0; --i) {
+            QString name = dirJson[i].toObject()[DirConfig::c_name].toString();
+            NoteFolder sub;
+            sub.m_path = dir.filePath(name);
+            sub.m_relativePath = QDir(folder.m_relativePath).filePath(name);
+            sub.m_testSelf = true;
+            sub.m_snapshot = folder.m_snapshot;
+            if (folder.m_node) {
+                sub.m_node = folder.m_node->findSubDirectory(name);
+            }
+
+            folders.append(sub);
+        }
+
+        postItems(false);
+    }
+}
+
+void VSearchFirstPhaseWorker::walkDirectory(const QString &p_directoryPath)
+{
+    VDirectoryCrawler crawler(p_directoryPath, VExcludeRules(m_excludePatterns), &m_stop);
+    crawler.start();
+
+    // Entries are tested here since tokens are not thread-safe in batch mode.
+    QVector<VDirectoryCrawler::Entry> entries;
+    while (crawler.take(entries)) {
+        for (auto const & entry : entries) {
+            if (m_stop.load() == 1) {
+                return;
+            }
+
+            if (entry.m_isDir) {
+                if (testTarget(VSearchConfig::Folder)) {
+                    testFolder(entry.m_name, entry.m_path, entry.m_relativePath);
+                }
+            } else if (testTarget(VSearchConfig::Note)) {
+                testFile(entry.m_name, entry.m_path, entry.m_relativePath, NULL);
+            }
+        }
+
+        // Stream the files to the second phase as they are found.
+        postItems(false);
+    }
+
+    const QStringList errors = crawler.getErrors();
+    for (auto const & err : errors) {
+        logError(QString("Directory %1 does not exist.").arg(err));
+        m_state = VSearchState::Fail;
+    }
+}
+
+void VSearchFirstPhaseWorker::testFolder(const QString &p_name,
+                                         const QString &p_path,
+                                         QString p_relativePath)
+{
+    if (testObject(VSearchConfig::Name)) {
+        if (m_config.m_token.matched(p_name)) {
+            addResultItem(new VSearchResultItem(VSearchResultItem::Folder,
+                                                VSearchResultItem::LineNumber,
+                                                p_name,
+                                                p_path));
+        }
+    }
+
+    if (testObject(VSearchConfig::Path)) {
+        p_relativePath.remove(m_slashReg);
+        if (m_config.m_token.matched(p_relativePath)) {
+            addResultItem(new VSearchResultItem(VSearchResultItem::Folder,
+                                                VSearchResultItem::LineNumber,
+                                                p_name,
+                                                p_path));
+        }
+    }
+}
+
+void VSearchFirstPhaseWorker::testFile(const QString &p_name,
+                                       const QString &p_path,
+                                       QString p_relativePath,
+                                       const QStringList *p_tags)
+{
+    if (!matchPattern(p_name)) {
+        return;
+    }
+
+    if (testObject(VSearchConfig::Name)) {
+        if (m_config.m_token.matched(p_name)) {
+            addResultItem(new VSearchResultItem(VSearchResultItem::Note,
+                                                VSearchResultItem::LineNumber,
+                                                p_name,
+                                                p_path));
+        }
+    }
+
+    if (testObject(VSearchConfig::Path)) {
+        p_relativePath.remove(m_slashReg);
+        if (m_config.m_token.matched(p_relativePath)) {
+            addResultItem(new VSearchResultItem(VSearchResultItem::Note,
+                                                VSearchResultItem::LineNumber,
+                                                p_name,
+                                                p_path));
+        }
+    }
+
+    if (p_tags && testObject(VSearchConfig::Tag)) {
+        VSearchResultItem *item = searchForTag(p_name, p_path, *p_tags);
+        if (item) {
+            addResultItem(item);
+        }
+    }
+
+    if (testObject(VSearchConfig::Content)) {
+        if (m_trackModifiedTime) {
+            qint64 modifiedTime = QFileInfo(p_path).lastModified().toMSecsSinceEpoch();
+            m_modifiedTimes.insert(p_path, modifiedTime);
+
+            auto it = m_cachedTimes.constFind(p_path);
+            if (it != m_cachedTimes.constEnd() && it.value() == modifiedTime) {
+                m_pendingCachedItems.append(p_path);
+                return;
+            }
+        }
+
+        // Add an item for second phase process.
+        m_pendingSecondPhaseItems.append(p_path);
+    }
+}
+
+void VSearchFirstPhaseWorker::testMetadata(const NoteFolder &p_folder,
+                                           const QString &p_name,
+                                           const QString &p_path,
+                                           const QJsonObject &p_fileJson,
+                                           const QStringList &p_tags)
+{
+    if (!matchPattern(p_name)) {
+        return;
+    }
+
+    const VMetadataQuery &query = m_config.m_metadataQuery;
+
+    VNoteMetadata meta;
+    meta.m_name = p_name;
+    meta.m_createdTime = QDateTime::fromString(p_fileJson[DirConfig::c_createdTime].toString(),
+                                               Qt::ISODate).toMSecsSinceEpoch();
+    meta.m_modifiedTime = QDateTime::fromString(p_fileJson[DirConfig::c_modifiedTime].toString(),
+                                                Qt::ISODate).toMSecsSinceEpoch();
+    meta.m_tags = p_tags;
+
+    // The front matter is read from the store, which only reads the head of
+    // the modified notes.
+    if (!query.frontMatterKeys().isEmpty() && p_folder.m_metadataStore) {
+        p_folder.m_metadataStore->refreshFile(p_path,
+                                              meta.m_createdTime,
+                                              meta.m_modifiedTime,
+                                              p_tags);
+        p_folder.m_metadataStore->fetch(p_path, query.frontMatterKeys(), meta);
+    }
+
+    if (query.matched(meta)) {
+        addResultItem(new VSearchResultItem(VSearchResultItem::Note,
+                                            VSearchResultItem::LineNumber,
+                                            p_name,
+                                            p_path));
+    }
+}
+
+VSearchResultItem *VSearchFirstPhaseWorker::searchForTag(const QString &p_name,
+                                                         const QString &p_path,
+                                                         const QStringList &p_tags)
+{
+    return VSearch::searchForTag(p_name, p_path, p_tags, m_config.m_contentToken);
+}
+
+void VSearchFirstPhaseWorker::addResultItem(VSearchResultItem *p_item)
+{
+    m_pendingItems.append(QSharedPointer<VSearchResultItem>(p_item));
+}
+
+void VSearchFirstPhaseWorker::postItems(bool p_force)
+{
+    // Post at least every 200ms so results show up progressively.
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (!p_force
+        && m_pendingItems.size() < BATCH_ITEM_SIZE
+        && m_pendingSecondPhaseItems.size() < BATCH_ITEM_SIZE
+        && m_pendingCachedItems.size() < BATCH_ITEM_SIZE
+        && now - m_lastPostTime < 200) {
+        return;
+    }
+
+    m_lastPostTime = now;
+
+    if (!m_pendingItems.isEmpty()) {
+        emit resultItemsReady(m_pendingItems);
+        m_pendingItems.clear();
+    }
+
+    if (!m_pendingSecondPhaseItems.isEmpty()) {
+        emit secondPhaseItemsReady(m_pendingSecondPhaseItems);
+        m_pendingSecondPhaseItems.clear();
+    }
+
+    if (!m_pendingCachedItems.isEmpty()) {
+        emit cachedItemsReady(m_pendingCachedItems);
+        m_pendingCachedItems.clear();
+    }
+}
+
+void VSearchFirstPhaseWorker::logError(const QString &p_err)
+{
+    if (m_error.isEmpty()) {
+        m_error = p_err;
+    } else {
+        m_error += "\n" + p_err;
+    }
+}
+
+
+VSearchBufferWorker::VSearchBufferWorker(const QSharedPointer<Queue> &p_queue,
+                                         const QSharedPointer<VSearchEngineResultQueue> &p_resultQueue,
+                                         const QSharedPointer<VSearchConfig> &p_config,
+                                         QObject *p_parent)
+    : QObject(p_parent),
+      m_stop(0),
+      m_queue(p_queue),
+      m_resultQueue(p_resultQueue),
+      m_config(*p_config),
+      m_sharedConfig(p_config),
+      m_state(VSearchState::Idle),
+      m_running(true)
+{
+    // Owned by VSearch.
+    setAutoDelete(false);
+}
+
+void VSearchBufferWorker::stop()
+{
+    m_stop.store(1);
+}
+
+void VSearchBufferWorker::waitForFinished()
+{
+    QMutexLocker locker(&m_runningMutex);
+    while (m_running) {
+        m_runningCond.wait(&m_runningMutex);
+    }
+}
+
+void VSearchBufferWorker::run()
+{
+    V_TRACE("search", "Opened notes worker");
+
+    m_state = VSearchState::Busy;
+
+    const QVector<Buffer> &buffers = m_queue->m_buffers;
+    while (true) {
+        if (m_stop.load() == 1) {
+            m_state = VSearchState::Cancelled;
+            break;
+        }
+
+        int idx = m_queue->m_next.fetchAndAddOrdered(1);
+        if (idx >= buffers.size()) {
+            break;
+        }
+
+        searchBuffer(buffers[idx]);
+    }
+
+    if (m_state == VSearchState::Busy) {
+        m_state = VSearchState::Success;
+    }
+
+    emit finished();
+
+    QMutexLocker locker(&m_runningMutex);
+    m_running = false;
+    m_runningCond.wakeAll();
+}
+
+void VSearchBufferWorker::searchBuffer(const Buffer &p_buffer)
+{
+    QList<QSharedPointer<VSearchResultItem> > items;
+    if (m_config.m_object & VSearchConfig::Outline) {
+        VSearchResultItem *item = VSearch::searchForOutline(p_buffer.m_name,
+                                                            p_buffer.m_path,
+                                                            p_buffer.m_outline,
+                                                            m_config.m_token,
+                                                            m_sharedConfig);
+        if (item) {
+            items.append(QSharedPointer<VSearchResultItem>(item));
+        }
+    }
+
+    if (m_config.m_object & VSearchConfig::Tag) {
+        VSearchResultItem *item = VSearch::searchForTag(p_buffer.m_name,
+                                                        p_buffer.m_path,
+                                                        p_buffer.m_tags,
+                                                        m_config.m_contentToken);
+        if (item) {
+            items.append(QSharedPointer<VSearchResultItem>(item));
+        }
+    }
+
+    if (m_config.m_object & VSearchConfig::Content) {
+        VSearchResultItem *item = VSearch::searchForContent(p_buffer.m_name,
+                                                            p_buffer.m_path,
+                                                            p_buffer.m_content,
+                                                            m_config.m_contentToken,
+                                                            m_sharedConfig);
+        if (item) {
+            items.append(QSharedPointer<VSearchResultItem>(item));
+        }
+    }
+
+    if (!items.isEmpty()) {
+        m_resultQueue->append(items);
+    }
+}
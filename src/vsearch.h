@@ -5,24 +5,281 @@
 #include <QString>
 #include <QSharedPointer>
 #include <QRegExp>
-#include <QCoreApplication>
+#include <QThread>
+#include <QAtomicInt>
+#include <QHash>
+#include <QJsonObject>
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
 
 #include "vsearchconfig.h"
+#include "vtableofcontent.h"
+#include "vdirectorynode.h"
 
 class VFile;
 class VDirectory;
 class VNotebook;
+class VNotebookSnapshot;
 class ISearchEngine;
+class VSavedSearch;
+class VNoteMetadataStore;
+class VSearchEngineResultQueue;
+class QTimer;
+
+
+// Walk folders of notebooks or directories in disk for the first phase in a
+// separate thread. Opened folders are read from their VDirectoryNode and the
+// others from the configuration files. No VDirectory is touched.
+class VSearchFirstPhaseWorker : public QThread
+{
+    Q_OBJECT
+
+    friend class VSearch;
+
+public:
+    // A folder of a notebook to walk.
+    struct NoteFolder
+    {
+        // Absolute path of the folder.
+        QString m_path;
+
+        // Path relative to the notebook.
+        QString m_relativePath;
+
+        // Whether test the folder itself (not only its children).
+        bool m_testSelf;
+
+        // Snapshot of the notebook to read the configurations from.
+        QSharedPointer<VNotebookSnapshot> m_snapshot;
+
+        // Node of the folder if opened, to read the configurations from
+        // instead of @m_snapshot.
+        VDirectoryNodePtr m_node;
+
+        // Store of the notebook for Metadata.
+        QSharedPointer<VNoteMetadataStore> m_metadataStore;
+    };
+
+    VSearchFirstPhaseWorker(const VSearchConfig &p_config, QObject *p_parent = nullptr);
+
+    void setNoteFolders(const QVector<NoteFolder> &p_folders);
+
+    // Walk directory @p_directoryPath in disk for ExplorerDirectory.
+    void setDirectory(const QString &p_directoryPath);
+
+    // Track the modified time of the files to search content for. Files
+    // unchanged since @p_cachedTimes will be posted as cached items instead
+    // of second phase items.
+    void setCachedFiles(const QHash<QString, qint64> &p_cachedTimes);
+
+public slots:
+    void stop();
+
+signals:
+    void resultItemsReady(const QList<QSharedPointer<VSearchResultItem> > &p_items);
+
+    // Files to search content for in second phase.
+    void secondPhaseItemsReady(const QStringList &p_items);
+
+    // Files unchanged since the cached times.
+    void cachedItemsReady(const QStringList &p_items);
+
+protected:
+    void run() Q_DECL_OVERRIDE;
+
+private:
+    void walkNoteFolder(const NoteFolder &p_folder);
+
+    // Walk @p_directoryPath by multiple threads with the exclude rules.
+    void walkDirectory(const QString &p_directoryPath);
+
+    void testFolder(const QString &p_name, const QString &p_path, QString p_relativePath);
+
+    // @p_tags: tags of the note. Null for file in directory.
+    void testFile(const QString &p_name,
+                  const QString &p_path,
+                  QString p_relativePath,
+                  const QStringList *p_tags);
+
+    VSearchResultItem *searchForTag(const QString &p_name,
+                                    const QString &p_path,
+                                    const QStringList &p_tags);
+
+    // Evaluate the metadata query against note @p_path with configuration
+    // @p_fileJson.
+    void testMetadata(const NoteFolder &p_folder,
+                      const QString &p_name,
+                      const QString &p_path,
+                      const QJsonObject &p_fileJson,
+                      const QStringList &p_tags);
+
+    void addResultItem(VSearchResultItem *p_item);
+
+    // Post pending items if there are enough of them or in @p_force.
+    void postItems(bool p_force);
+
+    void logError(const QString &p_err);
+
+    bool testTarget(VSearchConfig::Target p_target) const;
+
+    bool testObject(VSearchConfig::Object p_object) const;
+
+    bool matchPattern(const QString &p_name) const;
+
+    QAtomicInt m_stop;
+
+    // Its own copy since tokens are stateful in batch mode.
+    VSearchConfig m_config;
+
+    QRegExp m_patternReg;
+
+    QRegExp m_slashReg;
+
+    QVector<NoteFolder> m_noteFolders;
+
+    QString m_directoryPath;
+
+    // Exclude patterns in the form of .gitignore for m_directoryPath.
+    QStringList m_excludePatterns;
+
+    VSearchState m_state;
+
+    QString m_error;
+
+    QList<QSharedPointer<VSearchResultItem> > m_pendingItems;
+
+    QStringList m_pendingSecondPhaseItems;
+
+    QStringList m_pendingCachedItems;
+
+    qint64 m_lastPostTime;
+
+    bool m_trackModifiedTime;
+
+    QHash<QString, qint64> m_cachedTimes;
+
+    // Modified time of the files to search content for.
+    QHash<QString, qint64> m_modifiedTimes;
+};
+
+inline bool VSearchFirstPhaseWorker::testTarget(VSearchConfig::Target p_target) const
+{
+    return p_target & m_config.m_target;
+}
+
+inline bool VSearchFirstPhaseWorker::testObject(VSearchConfig::Object p_object) const
+{
+    return p_object & m_config.m_object;
+}
+
+inline bool VSearchFirstPhaseWorker::matchPattern(const QString &p_name) const
+{
+    if (m_patternReg.isEmpty()) {
+        return true;
+    }
+
+    return p_name.contains(m_patternReg);
+}
+
+
+// Search the snapshots of opened notes for CurrentNote and OpenedNotes in the
+// shared search thread pool, so searching large notes will not block the GUI.
+// All the workers of one search take the notes from one shared queue.
+class VSearchBufferWorker : public QObject, public QRunnable
+{
+    Q_OBJECT
+
+    friend class VSearch;
+
+public:
+    // Snapshot of an opened note taken in the GUI thread.
+    struct Buffer
+    {
+        QString m_name;
+
+        QString m_path;
+
+        // Shared with the note without copying.
+        QString m_content;
+
+        QVector<VTableOfContentItem> m_outline;
+
+        QStringList m_tags;
+    };
+
+    struct Queue
+    {
+        explicit Queue(const QVector<Buffer> &p_buffers)
+            : m_buffers(p_buffers),
+              m_next(0)
+        {
+        }
+
+        const QVector<Buffer> m_buffers;
+
+        // Index of the next buffer to search.
+        QAtomicInt m_next;
+    };
+
+    VSearchBufferWorker(const QSharedPointer<Queue> &p_queue,
+                        const QSharedPointer<VSearchEngineResultQueue> &p_resultQueue,
+                        const QSharedPointer<VSearchConfig> &p_config,
+                        QObject *p_parent = nullptr);
+
+    void run() Q_DECL_OVERRIDE;
+
+    // Block until run() returns. Return immediately if it is not started.
+    void waitForFinished();
+
+public slots:
+    void stop();
+
+signals:
+    void finished();
+
+private:
+    void searchBuffer(const Buffer &p_buffer);
+
+    QAtomicInt m_stop;
+
+    QSharedPointer<Queue> m_queue;
+
+    QSharedPointer<VSearchEngineResultQueue> m_resultQueue;
+
+    // Its own copy since tokens are stateful in batch mode.
+    VSearchConfig m_config;
+
+    // Shared config for the result items.
+    QSharedPointer<VSearchConfig> m_sharedConfig;
+
+    VSearchState m_state;
+
+    // Whether run() is in progress.
+    bool m_running;
+
+    QMutex m_runningMutex;
+
+    QWaitCondition m_runningCond;
+};
 
 
 class VSearch : public QObject
 {
     Q_OBJECT
+
+    friend class VSearchFirstPhaseWorker;
+    friend class VSearchBufferWorker;
+
 public:
     explicit VSearch(QObject *p_parent = nullptr);
 
     void setConfig(QSharedPointer<VSearchConfig> p_config);
 
+    // Run as @p_search to re-scan only the files modified since its last run.
+    // It applies to the next search only.
+    void setSavedSearch(const QSharedPointer<VSavedSearch> &p_search);
+
     // Search list of files for CurrentNote and OpenedNotes.
     QSharedPointer<VSearchResult> search(const QVector<VFile *> &p_files);
 
@@ -35,6 +292,10 @@ public:
     // Search directory path for ExplorerDirectory.
     QSharedPointer<VSearchResult> search(const QString &p_directoryPath);
 
+    // Search content of only @p_filePaths, the notes matched by a previous
+    // search which current config narrows down. First phase is skipped.
+    QSharedPointer<VSearchResult> refine(const QStringList &p_filePaths);
+
     // Clear resources after a search completed.
     void clear();
 
@@ -49,27 +310,39 @@ signals:
     // Emitted when async task finished.
     void finished(const QSharedPointer<VSearchResult> &p_result);
 
+private slots:
+    void handleFirstPhaseItemsReady(const QStringList &p_items);
+
+    void handleCachedItemsReady(const QStringList &p_items);
+
+    void handleFirstPhaseFinished();
+
+    void handleBufferWorkerFinished();
+
+    // Hand the results of the buffer workers so far to the views in one batch.
+    void drainBufferResults();
+
 private:
     bool askedToStop() const;
 
-    // @p_searchContent: whether search content in first phase.
-    void searchFirstPhase(VFile *p_file,
-                          const QSharedPointer<VSearchResult> &p_result,
-                          bool p_searchContent = false);
+    // Search the name, path and metadata of @p_file, and snapshot it into
+    // @p_buffers if its outline, tags or content need searching.
+    void searchFirstPhase(VFile *p_file, QVector<VSearchBufferWorker::Buffer> &p_buffers);
 
-    void searchFirstPhase(VDirectory *p_directory,
-                          const QSharedPointer<VSearchResult> &p_result);
+    // Search @p_buffers by the buffer workers.
+    void startBufferWorkers(const QVector<VSearchBufferWorker::Buffer> &p_buffers,
+                            const QSharedPointer<VSearchResult> &p_result);
 
-    void searchFirstPhase(VNotebook *p_notebook,
-                          const QSharedPointer<VSearchResult> &p_result);
+    void clearBufferWorkers();
 
-    void searchFirstPhase(const QString &p_basePath,
-                          const QString &p_directoryPath,
-                          const QSharedPointer<VSearchResult> &p_result);
+    // Start first phase worker which will feed the second phase.
+    void startFirstPhase(VSearchFirstPhaseWorker *p_worker,
+                         const QSharedPointer<VSearchResult> &p_result);
 
-    void searchFirstPhaseFile(const QString &p_basePath,
-                              const QString &p_filePath,
-                              const QSharedPointer<VSearchResult> &p_result);
+    void clearFirstPhaseWorker();
+
+    // Update the saved search before emitting finished().
+    void finishSearch(const QSharedPointer<VSearchResult> &p_result);
 
     bool testTarget(VSearchConfig::Target p_target) const;
 
@@ -81,14 +354,42 @@ private:
 
     bool matchPattern(const QString &p_name) const;
 
-    VSearchResultItem *searchForOutline(const VFile *p_file) const;
-
-    VSearchResultItem *searchForTag(const VFile *p_file) const;
-
-    VSearchResultItem *searchForContent(const VFile *p_file) const;
+    // Match the headers of @p_outline by @p_token.
+    static VSearchResultItem *searchForOutline(const QString &p_name,
+                                               const QString &p_path,
+                                               const QVector<VTableOfContentItem> &p_outline,
+                                               const VSearchToken &p_token,
+                                               const QSharedPointer<VSearchConfig> &p_config);
+
+    // Match @p_tags by content token @p_token.
+    static VSearchResultItem *searchForTag(const QString &p_name,
+                                           const QString &p_path,
+                                           const QStringList &p_tags,
+                                           VSearchToken &p_token);
+
+    // Whether the tag indexes of @p_notebooks are built. Request to build the
+    // ones not built yet.
+    static bool tagIndexesBuilt(const QVector<VNotebook *> &p_notebooks);
+
+    // Search tags of notes of @p_notebooks via the tag indexes instead of
+    // walking through the folders.
+    void searchTagsByIndex(const QVector<VNotebook *> &p_notebooks,
+                           const QSharedPointer<VSearchResult> &p_result);
+
+    // Match the lines of @p_content by content token @p_token.
+    static VSearchResultItem *searchForContent(const QString &p_name,
+                                               const QString &p_path,
+                                               const QString &p_content,
+                                               VSearchToken &p_token,
+                                               const QSharedPointer<VSearchConfig> &p_config);
+
+    VSearchResultItem *searchForMetadata(const VFile *p_file) const;
 
     void searchSecondPhase(const QSharedPointer<VSearchResult> &p_result);
 
+    // Create engine according to config if not created yet.
+    void ensureEngine();
+
     void removeSlashFromPath(QString &p_path);
 
     bool m_askedToStop;
@@ -97,6 +398,30 @@ private:
 
     ISearchEngine *m_engine;
 
+    VSearchFirstPhaseWorker *m_firstPhaseWorker;
+
+    // Result of current search which is fed by first phase worker.
+    QSharedPointer<VSearchResult> m_result;
+
+    // Whether second phase has been started by first phase.
+    bool m_secondPhaseStarted;
+
+    // Increased for each first phase worker.
+    int m_generation;
+
+    QSharedPointer<VSavedSearch> m_savedSearch;
+
+    // Modified time of the files searched in current run of m_savedSearch.
+    QHash<QString, qint64> m_modifiedTimes;
+
+    QVector<VSearchBufferWorker *> m_bufferWorkers;
+
+    int m_finishedBufferWorkers;
+
+    QSharedPointer<VSearchEngineResultQueue> m_bufferResultQueue;
+
+    QTimer *m_bufferDrainTimer;
+
     // Wildcard reg to for file name pattern.
     QRegExp m_patternReg;
 
@@ -106,7 +431,6 @@ private:
 
 inline bool VSearch::askedToStop() const
 {
-    QCoreApplication::processEvents();
     return m_askedToStop;
 }
 
@@ -154,4 +478,73 @@ inline void VSearch::removeSlashFromPath(QString &p_path)
 {
     p_path.remove(m_slashReg);
 }
+
+// Keep the notes matched by last search so a search narrowing it down could
+// search only them instead of all the notes in the scope.
+// Any change of the notes since last search began, like saving, creating,
+// renaming, moving or editing a note in a buffer, drops the result since
+// other notes may begin to match.
+// Should be accessed only in the GUI thread.
+class VSearchRefiner
+{
+public:
+    // Called on any change of the notes or the buffers.
+    static void notesChanged();
+
+    // Get the notes to search into @p_filePaths if @p_config in @p_scopeKey
+    // narrows last search down.
+    // @p_scopeKey: identify the notes of the scope, like the folder path.
+    bool refine(const VSearchConfig &p_config,
+                const QString &p_scopeKey,
+                QStringList &p_filePaths) const;
+
+    // Called before a search starts.
+    void begin(const QSharedPointer<VSearchConfig> &p_config, const QString &p_scopeKey);
+
+    void addResultItem(const QSharedPointer<VSearchResultItem> &p_item);
+
+    void addResultItems(const QList<QSharedPointer<VSearchResultItem> > &p_items);
+
+    // Called when the search finished. Keep its result if it completes.
+    void end(const QSharedPointer<VSearchResult> &p_result);
+
+    // Called when the search is abandoned before it finished.
+    void abandon();
+
+private:
+    struct Search
+    {
+        Search()
+            : m_changes(0),
+              m_finishedTime(0)
+        {
+        }
+
+        // s_changes when the search began.
+        int m_changes;
+
+        QSharedPointer<VSearchConfig> m_config;
+
+        QString m_scopeKey;
+
+        QStringList m_filePaths;
+
+        qint64 m_finishedTime;
+    };
+
+    // Last completed search.
+    Search m_last;
+
+    // Current search.
+    Search m_current;
+
+    // Number of changes of the notes.
+    static int s_changes;
+};
+
+inline void VSearchRefiner::notesChanged()
+{
+    ++s_changes;
+}
+
 #endif // VSEARCH_H
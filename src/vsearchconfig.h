@@ -5,9 +5,13 @@
 #include <QStringList>
 #include <QSharedPointer>
 #include <QVector>
-#include <QRegExp>
+#include <QRegularExpression>
+#include <QStringMatcher>
+
+#include <algorithm>
 
 #include "utils/vutils.h"
+#include "vmetadataquery.h"
 
 
 struct VSearchToken
@@ -34,17 +38,83 @@ struct VSearchToken
     void clear()
     {
         m_keywords.clear();
+        m_matchers.clear();
         m_regs.clear();
     }
 
+    // m_caseSensitivity should be set before.
     void append(const QString &p_rawStr)
     {
         m_keywords.append(p_rawStr);
+        m_matchers.append(QStringMatcher(p_rawStr, m_caseSensitivity));
     }
 
-    void append(const QRegExp &p_reg)
+    void append(const QRegularExpression &p_reg)
     {
         m_regs.append(p_reg);
+
+        // JIT-compile it once here instead of in each searching thread.
+        m_regs.last().optimize();
+    }
+
+    // Rebuild the matchers after m_keywords or m_caseSensitivity is changed
+    // directly.
+    void compile()
+    {
+        m_matchers.clear();
+        m_matchers.reserve(m_keywords.size());
+        for (auto const & keyword : m_keywords) {
+            m_matchers.append(QStringMatcher(keyword, m_caseSensitivity));
+        }
+
+        for (auto & reg : m_regs) {
+            reg.optimize();
+        }
+    }
+
+    // Whether @p_text contains keyword or regular expression @p_idx.
+    bool matchOne(int p_idx, const QString &p_text) const
+    {
+        return matchOne(p_idx, QStringRef(&p_text));
+    }
+
+    bool matchOne(int p_idx, const QStringRef &p_text) const
+    {
+        if (m_type == Type::RawString) {
+            if (p_idx < m_matchers.size()
+                && m_matchers[p_idx].caseSensitivity() == m_caseSensitivity) {
+                return m_matchers[p_idx].indexIn(p_text.unicode(), p_text.size()) != -1;
+            }
+
+            return p_text.contains(m_keywords[p_idx], m_caseSensitivity);
+        }
+
+        return m_regs[p_idx].match(p_text).hasMatch();
+    }
+
+    // Position of the earliest match in @p_text, or -1.
+    int indexOfFirstMatch(const QString &p_text) const
+    {
+        return indexOfFirstMatch(QStringRef(&p_text));
+    }
+
+    int indexOfFirstMatch(const QStringRef &p_text) const
+    {
+        int pos = -1;
+        for (int i = 0; i < tokenSize(); ++i) {
+            int idx = -1;
+            if (m_type == Type::RawString) {
+                idx = p_text.indexOf(m_keywords[i], 0, m_caseSensitivity);
+            } else {
+                idx = m_regs[i].match(p_text).capturedStart();
+            }
+
+            if (idx != -1 && (pos == -1 || idx < pos)) {
+                pos = idx;
+            }
+        }
+
+        return pos;
     }
 
     QString toString() const
@@ -58,6 +128,11 @@ struct VSearchToken
 
     // Whether @p_text match all the constraint.
     bool matched(const QString &p_text) const
+    {
+        return matched(QStringRef(&p_text));
+    }
+
+    bool matched(const QStringRef &p_text) const
     {
         int size = m_keywords.size();
         if (m_type == Type::RegularExpression) {
@@ -70,14 +145,7 @@ struct VSearchToken
 
         bool ret = m_op == Operator::And ? true : false;
         for (int i = 0; i < size; ++i) {
-            bool tmp = false;
-            if (m_type == Type::RawString) {
-                tmp = p_text.contains(m_keywords[i], m_caseSensitivity);
-            } else {
-                tmp = p_text.contains(m_regs[i]);
-            }
-
-            if (tmp) {
+            if (matchOne(i, p_text)) {
                 if (m_op == Operator::Or) {
                     ret = true;
                     break;
@@ -93,39 +161,84 @@ struct VSearchToken
         return ret;
     }
 
+    // Estimated selectivity of keyword or regular expression @p_idx by the
+    // length of its literal text. The longer, the rarer.
+    int selectivity(int p_idx) const
+    {
+        if (m_type == Type::RawString) {
+            return m_keywords[p_idx].size();
+        }
+
+        int nr = 0;
+        const QString pattern = m_regs[p_idx].pattern();
+        for (auto ch : pattern) {
+            if (ch.isLetterOrNumber()) {
+                ++nr;
+            }
+        }
+
+        return nr;
+    }
+
+    // Order to evaluate the tokens. For And, the rarest goes first to fail
+    // early. For Or, the most common goes first to succeed early.
+    QVector<int> planEvaluationOrder() const
+    {
+        int size = tokenSize();
+        QVector<int> order(size);
+        QVector<int> weights(size);
+        for (int i = 0; i < size; ++i) {
+            order[i] = i;
+            weights[i] = selectivity(i);
+        }
+
+        bool isAnd = m_op == Operator::And;
+        std::stable_sort(order.begin(), order.end(), [&weights, isAnd](int p_a, int p_b) {
+            return isAnd ? weights[p_a] > weights[p_b] : weights[p_a] < weights[p_b];
+        });
+
+        return order;
+    }
+
     void startBatchMode()
     {
         int size = m_type == Type::RawString ? m_keywords.size() : m_regs.size();
         m_matchesInBatch.resize(size);
         m_matchesInBatch.fill(false);
         m_numOfMatches = 0;
+        m_pendingInBatch = planEvaluationOrder();
     }
 
     // Match one string in batch mode.
     // Returns true if @p_text matches one.
     bool matchBatchMode(const QString &p_text)
     {
-        bool ret = false;
-        int size = m_matchesInBatch.size();
-        for (int i = 0; i < size; ++i) {
-            if (m_matchesInBatch[i]) {
-                continue;
-            }
-
-            bool tmp = false;
-            if (m_type == Type::RawString) {
-                tmp = p_text.contains(m_keywords[i], m_caseSensitivity);
-            } else {
-                tmp = p_text.contains(m_regs[i]);
-            }
+        return matchBatchMode(QStringRef(&p_text));
+    }
 
-            if (tmp) {
-                m_matchesInBatch[i] = true;
+    bool matchBatchMode(const QStringRef &p_text)
+    {
+        bool ret = false;
+        int nrPending = 0;
+        for (int i = 0; i < m_pendingInBatch.size(); ++i) {
+            int idx = m_pendingInBatch[i];
+            if (matchOne(idx, p_text)) {
+                m_matchesInBatch[idx] = true;
                 ++m_numOfMatches;
                 ret = true;
+
+                if (m_op == Operator::Or) {
+                    // One match is enough.
+                    m_pendingInBatch.clear();
+                    return ret;
+                }
+            } else {
+                // Matched ones are dropped from the following lines.
+                m_pendingInBatch[nrPending++] = idx;
             }
         }
 
+        m_pendingInBatch.resize(nrPending);
         return ret;
     }
 
@@ -157,6 +270,7 @@ struct VSearchToken
     void endBatchMode()
     {
         m_matchesInBatch.clear();
+        m_pendingInBatch.clear();
         m_numOfMatches = 0;
     }
 
@@ -194,13 +308,21 @@ struct VSearchToken
     // Valid at RawString.
     QVector<QString> m_keywords;
 
+    // Boyer-Moore matchers of m_keywords.
+    QVector<QStringMatcher> m_matchers;
+
     // Valid at RegularExpression.
-    QVector<QRegExp> m_regs;
+    // QRegularExpression is thread-safe, so each searching thread could match
+    // with its copy sharing the compiled pattern.
+    QVector<QRegularExpression> m_regs;
 
     // Bitmap for batch mode.
     // True if m_regs[i] or m_keywords[i] has been matched.
     QVector<bool> m_matchesInBatch;
 
+    // Indexes of the tokens not matched yet in the evaluation order.
+    QVector<int> m_pendingInBatch;
+
     int m_numOfMatches;
 };
 
@@ -225,7 +347,9 @@ struct VSearchConfig
         Content = 0x2UL,
         Outline = 0x4UL,
         Tag = 0x8UL,
-        Path = 0x10UL
+        Path = 0x10UL,
+        // Front matter, created and modified time, and tags of notes.
+        Metadata = 0x20UL
     };
 
     enum Target
@@ -238,7 +362,11 @@ struct VSearchConfig
 
     enum Engine
     {
-        Internal = 0
+        Internal = 0,
+        // Use persistent index of notebooks to prune files to scan.
+        Indexed,
+        // Delegate content search to an external grep tool like ripgrep.
+        External
     };
 
     enum Option
@@ -294,6 +422,7 @@ struct VSearchConfig
     {
         m_token.clear();
         m_contentToken.clear();
+        m_metadataQuery.clear();
         if (p_keyword.isEmpty()) {
             return;
         }
@@ -344,6 +473,12 @@ struct VSearchConfig
             return;
         }
 
+        if (m_object & VSearchConfig::Metadata) {
+            // Keywords are predicates evaluated against the metadata.
+            m_metadataQuery.parse(args, cs);
+            return;
+        }
+
         m_token.m_caseSensitivity = cs;
         m_contentToken.m_caseSensitivity = cs;
 
@@ -363,6 +498,11 @@ struct VSearchConfig
             }
         }
 
+        QRegularExpression::PatternOptions regOpts = QRegularExpression::NoPatternOption;
+        if (cs == Qt::CaseInsensitive) {
+            regOpts |= QRegularExpression::CaseInsensitiveOption;
+        }
+
         VSearchToken::Operator op = VSearchToken::And;
         for (auto const & arg : args) {
             if (arg == QStringLiteral("&&")) {
@@ -374,24 +514,29 @@ struct VSearchConfig
             }
 
             if (useReg) {
-                QRegExp reg(arg, cs);
+                QRegularExpression reg(arg, regOpts);
                 m_token.append(reg);
                 m_contentToken.append(reg);
             } else {
                 if (fuzzy) {
-                    QString wildcardText(arg.size() * 2 + 1, '*');
-                    for (int i = 0, j = 1; i < arg.size(); ++i, j += 2) {
-                        wildcardText[j] = arg[i];
+                    // Characters of @arg in order with anything between them.
+                    QString pattern;
+                    for (int i = 0; i < arg.size(); ++i) {
+                        if (i > 0) {
+                            pattern += QStringLiteral(".*");
+                        }
+
+                        pattern += QRegularExpression::escape(QString(arg[i]));
                     }
 
-                    QRegExp reg(wildcardText, cs, QRegExp::Wildcard);
+                    QRegularExpression reg(pattern, regOpts);
                     m_token.append(reg);
                     m_contentToken.append(arg);
                 } else if (wwo) {
-                    QString pattern = QRegExp::escape(arg);
+                    QString pattern = QRegularExpression::escape(arg);
                     pattern = "\\b" + pattern + "\\b";
 
-                    QRegExp reg(pattern, cs);
+                    QRegularExpression reg(pattern, regOpts);
                     m_token.append(reg);
                     m_contentToken.append(reg);
                 } else {
@@ -407,7 +552,70 @@ struct VSearchConfig
 
     bool isEmpty() const
     {
-        return m_token.tokenSize() == 0;
+        return m_token.tokenSize() == 0 && m_metadataQuery.isEmpty();
+    }
+
+    // Whether @p_config only narrows this one down, so its result is a subset
+    // of the result of this one and it could search only the notes matched by
+    // this one. Only literal content search is considered, like an appended
+    // keyword with And or a longer keyword.
+    bool isNarrowedBy(const VSearchConfig &p_config) const
+    {
+        if (m_scope != p_config.m_scope
+            || m_object != VSearchConfig::Content
+            || p_config.m_object != VSearchConfig::Content
+            || m_target != p_config.m_target
+            || m_option != p_config.m_option
+            || m_pattern != p_config.m_pattern) {
+            return false;
+        }
+
+        const VSearchToken &oldToken = m_contentToken;
+        const VSearchToken &newToken = p_config.m_contentToken;
+        if (oldToken.isEmpty()
+            || newToken.isEmpty()
+            || oldToken.m_type != VSearchToken::RawString
+            || newToken.m_type != VSearchToken::RawString
+            || oldToken.m_caseSensitivity != newToken.m_caseSensitivity) {
+            return false;
+        }
+
+        Qt::CaseSensitivity cs = oldToken.m_caseSensitivity;
+        bool oldAnd = oldToken.m_op == VSearchToken::And || oldToken.tokenSize() == 1;
+        bool newAnd = newToken.m_op == VSearchToken::And || newToken.tokenSize() == 1;
+
+        // A new keyword containing an old one implies it.
+        // And: one new keyword should imply each old one.
+        // Or: all new keywords should imply it.
+        if (oldAnd) {
+            for (auto const & oldKw : oldToken.m_keywords) {
+                int cnt = 0;
+                for (auto const & newKw : newToken.m_keywords) {
+                    if (newKw.contains(oldKw, cs)) {
+                        ++cnt;
+                    }
+                }
+
+                if (newAnd ? cnt == 0 : cnt < newToken.tokenSize()) {
+                    return false;
+                }
+            }
+
+            return true;
+        }
+
+        // One of the old keywords is implied by one (And) or all (Or) new keywords.
+        int cnt = 0;
+        for (auto const & newKw : newToken.m_keywords) {
+            for (auto const & oldKw : oldToken.m_keywords) {
+                if (newKw.contains(oldKw, cs)) {
+                    ++cnt;
+                    break;
+                }
+            }
+        }
+
+        return newAnd ? cnt > 0 : cnt == newToken.tokenSize();
     }
 
     QStringList toConfig() const
@@ -454,26 +662,127 @@ struct VSearchConfig
 
     // Token for content and tag.
     VSearchToken m_contentToken;
+
+    // Query for metadata.
+    VMetadataQuery m_metadataQuery;
+};
+
+
+// Iterate the lines of a text without copying them.
+// Lines are separated by \n, \r\n or \r. There is no empty line after the
+// last line break.
+class VSearchLineIterator
+{
+public:
+    // Iterate [0, @p_end) of @p_text. -1 for the whole text.
+    explicit VSearchLineIterator(const QString &p_text, int p_end = -1)
+        : m_text(p_text),
+          m_pos(0),
+          m_end(p_end == -1 ? p_text.size() : p_end)
+    {
+    }
+
+    // Get next line into @p_line. Return false at the end.
+    bool next(QStringRef &p_line)
+    {
+        if (m_pos >= m_end) {
+            return false;
+        }
+
+        const QChar *data = m_text.constData();
+        int idx = m_pos;
+        while (idx < m_end && data[idx] != QLatin1Char('\n') && data[idx] != QLatin1Char('\r')) {
+            ++idx;
+        }
+
+        p_line = QStringRef(&m_text, m_pos, idx - m_pos);
+
+        if (idx + 1 < m_end
+            && data[idx] == QLatin1Char('\r')
+            && data[idx + 1] == QLatin1Char('\n')) {
+            ++idx;
+        }
+
+        m_pos = idx + 1;
+        return true;
+    }
+
+private:
+    const QString &m_text;
+
+    int m_pos;
+
+    int m_end;
 };
 
 
+// Max length of the text kept for a match of a line.
+#define SEARCH_CONTEXT_SIZE 160
+
+// Length of the text kept before the match.
+#define SEARCH_CONTEXT_BEFORE 40
+
 struct VSearchResultSubItem
 {
     VSearchResultSubItem()
-        : m_lineNumber(-1)
+        : m_lineNumber(-1),
+          m_offset(-1),
+          m_length(0),
+          m_truncated(false)
     {
     }
 
     VSearchResultSubItem(int p_lineNumber,
                          const QString &p_text)
         : m_lineNumber(p_lineNumber),
-          m_text(p_text)
+          m_text(p_text),
+          m_offset(-1),
+          m_length(0),
+          m_truncated(false)
+    {
+    }
+
+    // Keep a window of @p_line around @p_pos as the text.
+    void setContext(const QString &p_line, int p_pos)
+    {
+        setContext(QStringRef(&p_line), p_pos);
+    }
+
+    void setContext(const QStringRef &p_line, int p_pos)
     {
+        if (p_line.size() <= SEARCH_CONTEXT_SIZE) {
+            m_text = p_line.toString();
+            m_truncated = false;
+            return;
+        }
+
+        int start = qMax(0, p_pos - SEARCH_CONTEXT_BEFORE);
+        if (start > 0 && p_line[start].isLowSurrogate()) {
+            --start;
+        }
+
+        int len = SEARCH_CONTEXT_SIZE;
+        if (start + len < p_line.size() && p_line[start + len].isLowSurrogate()) {
+            --len;
+        }
+
+        m_text = p_line.mid(start, len).toString();
+        m_truncated = true;
     }
 
     int m_lineNumber;
 
+    // Text of the line. Only a window around the match if m_truncated.
     QString m_text;
+
+    // Offset and length in bytes of the line in the file. -1 if unknown, when
+    // the line could be read by the line number.
+    qint64 m_offset;
+
+    int m_length;
+
+    // Whether m_text is part of the line.
+    bool m_truncated;
 };
 
 
@@ -519,6 +828,17 @@ struct VSearchResultItem
         return m_type == ItemType::None;
     }
 
+    // Bytes held by this item and its matches.
+    qint64 approximateBytes() const
+    {
+        qint64 bytes = sizeof(*this) + (qint64)(m_text.capacity() + m_path.capacity()) * sizeof(QChar);
+        for (auto const & match : m_matches) {
+            bytes += sizeof(match) + (qint64)match.m_text.capacity() * sizeof(QChar);
+        }
+
+        return bytes;
+    }
+
     QString toString() const
     {
         return QString("item text: [%1] path: [%2] subitems: %3")
@@ -565,6 +885,9 @@ struct VSearchResult
 
     explicit VSearchResult(VSearch *p_search)
         : m_state(VSearchState::Idle),
+          m_secondPhasePending(false),
+          m_nrSearchedFiles(0),
+          m_nrMimeCheckSkipped(0),
           m_search(p_search)
     {
     }
@@ -607,6 +930,16 @@ struct VSearchResult
 
     QStringList m_secondPhaseItems;
 
+    // Whether more second phase items are still being collected by first phase.
+    bool m_secondPhasePending;
+
+    // Statistics of second phase.
+    // Number of files whose content is searched.
+    int m_nrSearchedFiles;
+
+    // Number of files treated as text by suffix without mime detection.
+    int m_nrMimeCheckSkipped;
+
 private:
     VSearch *m_search;
 };
@@ -3,23 +3,165 @@
 #include <QDebug>
 #include <QFile>
 #include <QMimeDatabase>
+#include <QTextStream>
+#include <QCoreApplication>
+#include <QTimer>
+
+#include <string.h>
+#include <limits.h>
 
 #include "utils/vutils.h"
+#include "vconfigmanager.h"
+#include "vtracer.h"
+#include "vtaskexecutor.h"
+
+extern VConfigManager *g_config;
+
+// Interval in ms to hand the results of the workers to the views.
+#define RESULT_DRAIN_INTERVAL 50
+
+// Number of characters decoded at a time when searching a file by line.
+#define SEARCH_READ_CHUNK_SIZE 65536
+
+VSearchRawMatcher::VSearchRawMatcher()
+    : m_valid(false),
+      m_op(VSearchToken::And),
+      m_caseSensitivity(Qt::CaseSensitive)
+{
+}
+
+bool VSearchRawMatcher::init(const VSearchToken &p_token)
+{
+    m_valid = false;
+    m_keywords.clear();
+    m_matchers.clear();
+    m_order.clear();
+
+    if (p_token.m_type != VSearchToken::RawString || p_token.m_keywords.isEmpty()) {
+        return false;
+    }
+
+    m_op = p_token.m_op;
+    m_caseSensitivity = p_token.m_caseSensitivity;
+    for (auto const & keyword : p_token.m_keywords) {
+        if (keyword.isEmpty()) {
+            return false;
+        }
+
+        if (m_caseSensitivity == Qt::CaseSensitive) {
+            QByteArray bytes = keyword.toUtf8();
+            m_matchers.append(QByteArrayMatcher(bytes));
+            m_keywords.append(bytes);
+        } else {
+            for (auto ch : keyword) {
+                if (ch.unicode() > 0x7f) {
+                    // Unicode case folding needs decoding.
+                    m_keywords.clear();
+                    return false;
+                }
+            }
+
+            m_keywords.append(keyword.toLower().toLatin1());
+        }
+    }
+
+    m_order = p_token.planEvaluationOrder();
+
+    m_valid = true;
+    return true;
+}
+
+int VSearchRawMatcher::indexIn(int p_idx, const char *p_data, int p_len) const
+{
+    if (m_caseSensitivity == Qt::CaseSensitive) {
+        return m_matchers[p_idx].indexIn(p_data, p_len);
+    } else {
+        return indexOfCaseInsensitive(p_data, p_len, m_keywords[p_idx]);
+    }
+}
+
+bool VSearchRawMatcher::mayMatch(const char *p_data, int p_len) const
+{
+    if (m_op != VSearchToken::And && m_keywords.size() > 1) {
+        return true;
+    }
+
+    // Keywords do not span lines, so one pass over the whole content with the
+    // rarest keyword rejects most of the files.
+    return contains(m_order[0], p_data, p_len);
+}
+
+// Fold ASCII upper-case letters without branching so that the comparison
+// loop could be vectorized by compiler.
+static inline uchar foldAscii(uchar p_ch)
+{
+    return p_ch | ((uchar)((uchar)(p_ch - 'A') < 26) << 5);
+}
+
+int VSearchRawMatcher::indexOfCaseInsensitive(const char *p_data,
+                                              int p_len,
+                                              const QByteArray &p_lowerKeyword)
+{
+    const int kwLen = p_lowerKeyword.size();
+    if (kwLen > p_len) {
+        return -1;
+    }
+
+    const uchar *data = reinterpret_cast<const uchar *>(p_data);
+    const uchar *kw = reinterpret_cast<const uchar *>(p_lowerKeyword.constData());
+    const uchar first = kw[0];
+    const int last = p_len - kwLen;
+    for (int i = 0; i <= last; ++i) {
+        if (foldAscii(data[i]) != first) {
+            continue;
+        }
+
+        int j = 1;
+        while (j < kwLen && foldAscii(data[i + j]) == kw[j]) {
+            ++j;
+        }
+
+        if (j == kwLen) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
 
 VSearchEngineWorker::VSearchEngineWorker(QObject *p_parent)
-    : QThread(p_parent),
+    : QObject(p_parent),
       m_stop(0),
-      m_state(VSearchState::Idle)
+      m_state(VSearchState::Idle),
+      m_nrSearchedFiles(0),
+      m_nrMimeCheckSkipped(0),
+      m_running(false)
 {
+    // Owned by VSearchEngine.
+    setAutoDelete(false);
 }
 
-void VSearchEngineWorker::setData(const QStringList &p_files,
+void VSearchEngineWorker::setData(const QSharedPointer<VSearchEngineQueue> &p_queue,
+                                  const QSharedPointer<VSearchEngineResultQueue> &p_resultQueue,
                                   const VSearchToken &p_token,
-                                  const QSharedPointer<VSearchConfig> &p_config)
+                                  const QSharedPointer<VSearchConfig> &p_config,
+                                  const QSet<QString> &p_textSuffixes)
 {
-    m_files = p_files;
+    m_queue = p_queue;
+    m_resultQueue = p_resultQueue;
     m_token = p_token;
     m_config = p_config;
+    m_textSuffixes = p_textSuffixes;
+    m_textDecisions.clear();
+
+    m_rawMatcher.init(m_token);
+}
+
+void VSearchEngineWorker::setRunning()
+{
+    QMutexLocker locker(&m_runningMutex);
+    m_running = true;
 }
 
 void VSearchEngineWorker::stop()
@@ -27,28 +169,40 @@ void VSearchEngineWorker::stop()
     m_stop.store(1);
 }
 
+void VSearchEngineWorker::waitForFinished()
+{
+    QMutexLocker locker(&m_runningMutex);
+    while (m_running) {
+        m_runningCond.wait(&m_runningMutex);
+    }
+}
+
 void VSearchEngineWorker::run()
 {
-    qDebug() << "worker" << QThread::currentThreadId() << m_files.size();
+    V_TRACE("search", "Second phase worker");
 
     QMimeDatabase mimeDatabase;
     m_state = VSearchState::Busy;
 
     m_results.clear();
+    m_nrSearchedFiles = 0;
+    m_nrMimeCheckSkipped = 0;
     int nr = 0;
-    for (auto const & fileName : m_files) {
+    QString fileName;
+    while (m_queue->take(fileName)) {
         if (m_stop.load() == 1) {
             m_state = VSearchState::Cancelled;
             qDebug() << "worker" << QThread::currentThreadId() << "is asked to stop";
             break;
         }
 
-        const QMimeType mimeType = mimeDatabase.mimeTypeForFile(fileName);
-        if (mimeType.isValid() && !mimeType.inherits(QStringLiteral("text/plain"))) {
+        if (!isTextFile(fileName, mimeDatabase)) {
             appendError(tr("Skip binary file %1.").arg(fileName));
             continue;
         }
 
+        ++m_nrSearchedFiles;
+
         VSearchResultItem *item = searchFile(fileName);
         if (item) {
             m_results.append(QSharedPointer<VSearchResultItem>(item));
@@ -62,9 +216,43 @@ void VSearchEngineWorker::run()
 
     postAndClearResults();
 
+    qDebug() << "worker" << QThread::currentThreadId() << "searched" << m_nrSearchedFiles << "files";
+
     if (m_state == VSearchState::Busy) {
         m_state = VSearchState::Success;
     }
+
+    emit finished();
+
+    QMutexLocker locker(&m_runningMutex);
+    m_running = false;
+    m_runningCond.wakeAll();
+}
+
+bool VSearchEngineWorker::isTextFile(const QString &p_fileName, QMimeDatabase &p_mimeDatabase)
+{
+    int dotIdx = p_fileName.lastIndexOf('.');
+    int slashIdx = qMax(p_fileName.lastIndexOf('/'), p_fileName.lastIndexOf('\\'));
+    QString suffix;
+    if (dotIdx > slashIdx) {
+        suffix = p_fileName.mid(dotIdx + 1).toLower();
+        if (m_textSuffixes.contains(suffix)) {
+            ++m_nrMimeCheckSkipped;
+            return true;
+        }
+    }
+
+    QString key = p_fileName.left(slashIdx + 1) + suffix;
+    auto it = m_textDecisions.constFind(key);
+    if (it != m_textDecisions.constEnd()) {
+        ++m_nrMimeCheckSkipped;
+        return it.value();
+    }
+
+    const QMimeType mimeType = p_mimeDatabase.mimeTypeForFile(p_fileName);
+    bool isText = !mimeType.isValid() || mimeType.inherits(QStringLiteral("text/plain"));
+    m_textDecisions.insert(key, isText);
+    return isText;
 }
 
 VSearchResultItem *VSearchEngineWorker::searchFile(const QString &p_fileName)
@@ -74,34 +262,108 @@ VSearchResultItem *VSearchEngineWorker::searchFile(const QString &p_fileName)
         return NULL;
     }
 
+    if (m_rawMatcher.isValid()) {
+        qint64 size = file.size();
+        if (size == 0) {
+            return NULL;
+        }
+
+        if (size < INT_MAX) {
+            uchar *data = file.map(0, size);
+            if (data) {
+                VSearchResultItem *item = searchMappedFile(p_fileName,
+                                                           reinterpret_cast<const char *>(data),
+                                                           (int)size);
+                file.unmap(data);
+                return item;
+            }
+        }
+    }
+
+    return searchFileByLine(p_fileName, file);
+}
+
+VSearchResultItem *VSearchEngineWorker::searchMappedFile(const QString &p_fileName,
+                                                         const char *p_data,
+                                                         int p_size)
+{
     int lineNum = 1;
     VSearchResultItem *item = NULL;
-    QString line;
-    QTextStream in(&file);
 
-    bool singleToken = m_token.tokenSize() == 1;
-    if (!singleToken) {
-        m_token.startBatchMode();
+    const int nrKeywords = m_rawMatcher.size();
+    const bool isAnd = m_rawMatcher.getOperator() == VSearchToken::And;
+
+    // Keywords not matched yet in the evaluation order like VSearchToken
+    // batch mode.
+    QVector<int> pendingKeywords = m_rawMatcher.evaluationOrder();
+    int nrMatchedKeywords = 0;
+
+    int pos = 0;
+    // Skip UTF-8 BOM.
+    if (p_size >= 3
+        && (uchar)p_data[0] == 0xef
+        && (uchar)p_data[1] == 0xbb
+        && (uchar)p_data[2] == 0xbf) {
+        pos = 3;
     }
 
-    bool allMatched = false;
+    if (!m_rawMatcher.mayMatch(p_data + pos, p_size - pos)) {
+        return NULL;
+    }
 
-    while (!in.atEnd()) {
+    // Offset of the next LF, or @p_size if there is none.
+    int nlPos = -1;
+    while (pos < p_size) {
         if (m_stop.load() == 1) {
             m_state = VSearchState::Cancelled;
             qDebug() << "worker" << QThread::currentThreadId() << "is asked to stop";
             break;
         }
 
-        line = in.readLine();
-        bool matched = false;
-        if (singleToken) {
-            matched = m_token.matched(line);
+        const char *lineStart = p_data + pos;
+        if (nlPos < pos) {
+            const char *nl = static_cast<const char *>(memchr(lineStart, '\n', p_size - pos));
+            nlPos = nl ? (int)(nl - p_data) : p_size;
+        }
+
+        // Lines are separated by \n, \r\n or \r like VSearchLineIterator.
+        int lineLen = nlPos - pos;
+        const char *cr = static_cast<const char *>(memchr(lineStart, '\r', lineLen));
+        if (cr) {
+            lineLen = (int)(cr - lineStart);
+            pos += (pos + lineLen + 1 == nlPos) ? lineLen + 2 : lineLen + 1;
         } else {
-            matched = m_token.matchBatchMode(line);
+            pos += lineLen + 1;
         }
 
-        if (matched) {
+        // Byte offset of the first match in the line.
+        int matchPos = -1;
+        if (nrKeywords == 1) {
+            matchPos = m_rawMatcher.indexIn(0, lineStart, lineLen);
+        } else {
+            int nrPending = 0;
+            for (int i = 0; i < pendingKeywords.size(); ++i) {
+                int idx = pendingKeywords[i];
+                int idxPos = m_rawMatcher.indexIn(idx, lineStart, lineLen);
+                if (idxPos != -1) {
+                    ++nrMatchedKeywords;
+                    if (matchPos == -1 || idxPos < matchPos) {
+                        matchPos = idxPos;
+                    }
+
+                    if (!isAnd) {
+                        // One match is enough.
+                        break;
+                    }
+                } else {
+                    pendingKeywords[nrPending++] = idx;
+                }
+            }
+
+            pendingKeywords.resize(nrPending);
+        }
+
+        if (matchPos != -1) {
             if (!item) {
                 item = new VSearchResultItem(VSearchResultItem::Note,
                                              VSearchResultItem::LineNumber,
@@ -110,17 +372,114 @@ VSearchResultItem *VSearchEngineWorker::searchFile(const QString &p_fileName)
                                              m_config);
             }
 
-            VSearchResultSubItem sitem(lineNum, line);
-            item->m_matches.append(sitem);
+            item->m_matches.append(contextSubItem(lineNum,
+                                                  lineStart - p_data,
+                                                  lineStart,
+                                                  lineLen,
+                                                  matchPos));
         }
 
-        if (!singleToken && m_token.readyToEndBatchMode(allMatched)) {
+        if (nrKeywords > 1
+            && (isAnd ? nrMatchedKeywords == nrKeywords : nrMatchedKeywords > 0)) {
             break;
         }
 
         ++lineNum;
     }
 
+    if (nrKeywords > 1) {
+        bool allMatched = isAnd ? nrMatchedKeywords == nrKeywords : nrMatchedKeywords > 0;
+        if (!allMatched && item) {
+            delete item;
+            item = NULL;
+        }
+    }
+
+    return item;
+}
+
+VSearchResultItem *VSearchEngineWorker::searchFileByLine(const QString &p_fileName, QFile &p_file)
+{
+    int lineNum = 1;
+    VSearchResultItem *item = NULL;
+    QTextStream in(&p_file);
+
+    bool singleToken = m_token.tokenSize() == 1;
+    if (!singleToken) {
+        m_token.startBatchMode();
+    }
+
+    bool allMatched = false;
+
+    // Decode the file in chunks and match the complete lines of each chunk
+    // in place.
+    QString buffer;
+    bool done = false;
+    while (!done) {
+        buffer += in.read(SEARCH_READ_CHUNK_SIZE);
+        done = in.atEnd();
+
+        int end = buffer.size();
+        if (!done) {
+            // Leave the last line, which may be incomplete, to next chunk.
+            // A CR at the end may be followed by a LF in next chunk.
+            if (end > 0 && buffer.at(end - 1) == QLatin1Char('\r')) {
+                --end;
+            }
+
+            while (end > 0
+                   && buffer.at(end - 1) != QLatin1Char('\n')
+                   && buffer.at(end - 1) != QLatin1Char('\r')) {
+                --end;
+            }
+
+            if (end == 0) {
+                continue;
+            }
+        }
+
+        QStringRef line;
+        VSearchLineIterator lineIt(buffer, end);
+        while (lineIt.next(line)) {
+            if (m_stop.load() == 1) {
+                m_state = VSearchState::Cancelled;
+                qDebug() << "worker" << QThread::currentThreadId() << "is asked to stop";
+                done = true;
+                break;
+            }
+
+            bool matched = false;
+            if (singleToken) {
+                matched = m_token.matched(line);
+            } else {
+                matched = m_token.matchBatchMode(line);
+            }
+
+            if (matched) {
+                if (!item) {
+                    item = new VSearchResultItem(VSearchResultItem::Note,
+                                                 VSearchResultItem::LineNumber,
+                                                 VUtils::fileNameFromPath(p_fileName),
+                                                 p_fileName,
+                                                 m_config);
+                }
+
+                VSearchResultSubItem sitem(lineNum, QString());
+                sitem.setContext(line, m_token.indexOfFirstMatch(line));
+                item->m_matches.append(sitem);
+            }
+
+            if (!singleToken && m_token.readyToEndBatchMode(allMatched)) {
+                done = true;
+                break;
+            }
+
+            ++lineNum;
+        }
+
+        buffer.remove(0, end);
+    }
+
     if (!singleToken) {
         m_token.readyToEndBatchMode(allMatched);
         m_token.endBatchMode();
@@ -134,10 +493,47 @@ VSearchResultItem *VSearchEngineWorker::searchFile(const QString &p_fileName)
     return item;
 }
 
+// Move @p_pos back to the start of a UTF-8 character.
+static inline int utf8CharStart(const char *p_data, int p_pos)
+{
+    while (p_pos > 0 && ((uchar)p_data[p_pos] & 0xc0) == 0x80) {
+        --p_pos;
+    }
+
+    return p_pos;
+}
+
+VSearchResultSubItem VSearchEngineWorker::contextSubItem(int p_lineNumber,
+                                                         qint64 p_offset,
+                                                         const char *p_line,
+                                                         int p_len,
+                                                         int p_matchPos)
+{
+    VSearchResultSubItem sitem(p_lineNumber, QString());
+    sitem.m_offset = p_offset;
+    sitem.m_length = p_len;
+
+    if (p_len <= SEARCH_CONTEXT_SIZE) {
+        sitem.m_text = QString::fromUtf8(p_line, p_len);
+        return sitem;
+    }
+
+    // Only decode a window of bytes around the match.
+    int start = utf8CharStart(p_line, qMax(0, p_matchPos - SEARCH_CONTEXT_BEFORE));
+    int end = qMin(p_len, start + SEARCH_CONTEXT_SIZE);
+    if (end < p_len) {
+        end = utf8CharStart(p_line, end);
+    }
+
+    sitem.m_text = QString::fromUtf8(p_line + start, end - start);
+    sitem.m_truncated = true;
+    return sitem;
+}
+
 void VSearchEngineWorker::postAndClearResults()
 {
     if (!m_results.isEmpty()) {
-        emit resultItemsReady(m_results);
+        m_resultQueue->append(m_results);
         m_results.clear();
     }
 }
@@ -145,8 +541,13 @@ void VSearchEngineWorker::postAndClearResults()
 
 VSearchEngine::VSearchEngine(QObject *p_parent)
     : ISearchEngine(p_parent),
-      m_finishedWorkers(0)
+      m_generation(0),
+      m_state(VSearchState::Idle)
 {
+    m_drainTimer = new QTimer(this);
+    m_drainTimer->setInterval(RESULT_DRAIN_INTERVAL);
+    connect(m_drainTimer, &QTimer::timeout,
+            this, &VSearchEngine::drainResults);
 }
 
 VSearchEngine::~VSearchEngine()
@@ -159,22 +560,18 @@ VSearchEngine::~VSearchEngine()
     // clear()
     clearAllWorkers();
 
-    m_finishedWorkers = 0;
-
     m_result.clear();
 }
 
 void VSearchEngine::search(const QSharedPointer<VSearchConfig> &p_config,
                            const QSharedPointer<VSearchResult> &p_result)
 {
-    int numThread = QThread::idealThreadCount();
-    if (numThread < 1) {
-        numThread = 1;
-    }
+    int numThread = VTaskExecutor::inst()->quota(VTaskExecutor::Search);
 
     const QStringList items = p_result->m_secondPhaseItems;
-    Q_ASSERT(!items.isEmpty());
-    if (items.size() < numThread) {
+    const bool pending = p_result->m_secondPhasePending;
+    Q_ASSERT(pending || !items.isEmpty());
+    if (!pending && items.size() < numThread) {
         numThread = items.size();
     }
 
@@ -182,40 +579,45 @@ void VSearchEngine::search(const QSharedPointer<VSearchConfig> &p_config,
 
     clearAllWorkers();
     m_workers.reserve(numThread);
-    m_finishedWorkers = 0;
-    int totalSize = m_result->m_secondPhaseItems.size();
-    int step = totalSize / numThread;
-    int remain = totalSize % numThread;
-    int start = 0;
-    for (int i = 0; i < numThread && start < totalSize; ++i) {
-        int len = step;
-        if (remain) {
-            ++len;
-            --remain;
-        }
+    m_state = VSearchState::Success;
 
-        if (start + len > totalSize) {
-            len = totalSize - start;
-        }
+    // All workers share one queue so a few huge notes will not hold up the
+    // whole search.
+    m_queue.reset(new VSearchEngineQueue(items));
+    if (!pending) {
+        m_queue->close();
+    }
 
+    // Results of workers of previous search go to the previous queue.
+    m_resultQueue.reset(new VSearchEngineResultQueue());
+    m_drainTimer->start();
+
+    int generation = ++m_generation;
+    const QSet<QString> textSuffixes = QSet<QString>::fromList(g_config->getSearchTextSuffixes());
+    for (int i = 0; i < numThread; ++i) {
         VSearchEngineWorker *th = new VSearchEngineWorker(this);
-        th->setData(m_result->m_secondPhaseItems.mid(start, len),
+        th->setData(m_queue,
+                    m_resultQueue,
                     p_config->m_contentToken,
-                    p_config);
+                    p_config,
+                    textSuffixes);
+        // Signals are queued. Ignore the ones from workers of previous search.
         connect(th, &VSearchEngineWorker::finished,
-                this, &VSearchEngine::handleWorkerFinished);
-        connect(th, &VSearchEngineWorker::resultItemsReady,
-                this, [this](const QList<QSharedPointer<VSearchResultItem> > &p_items) {
-                    emit resultItemsAdded(p_items);
+                this, [this, generation, th]() {
+                    if (generation == m_generation) {
+                        handleWorkerFinished(th);
+                    }
                 });
 
         m_workers.append(th);
-        th->start();
-
-        start += len;
+        m_idleWorkers.append(th);
     }
 
-    qDebug() << "schedule tasks to threads" << m_workers.size() << totalSize << step;
+    // Workers are started for the files as they come, instead of waiting for
+    // them on the pool threads.
+    startIdleWorkers();
+
+    qDebug() << "schedule tasks to threads" << m_workers.size() << items.size();
 }
 
 void VSearchEngine::stop()
@@ -224,39 +626,107 @@ void VSearchEngine::stop()
     for (auto const & th : m_workers) {
         th->stop();
     }
+
+    if (m_queue) {
+        m_state = VSearchState::Cancelled;
+        m_queue->close();
+        finishIfDone();
+    }
 }
 
-void VSearchEngine::handleWorkerFinished()
+void VSearchEngine::appendSecondPhaseItems(const QStringList &p_items)
 {
-    ++m_finishedWorkers;
+    Q_ASSERT(m_queue);
+    m_queue->append(p_items);
+    startIdleWorkers();
+}
 
-    qDebug() << m_finishedWorkers << "workers finished";
-    if (m_finishedWorkers == m_workers.size()) {
-        VSearchState state = VSearchState::Success;
+void VSearchEngine::endSecondPhaseItems()
+{
+    if (m_queue) {
+        m_queue->close();
+        finishIfDone();
+    }
+}
 
-        for (auto const & th : m_workers) {
-            if (th->m_state == VSearchState::Fail) {
-                if (state != VSearchState::Cancelled) {
-                    state = VSearchState::Fail;
-                }
-            } else if (th->m_state == VSearchState::Cancelled) {
-                state = VSearchState::Cancelled;
-            }
+void VSearchEngine::startWorker(VSearchEngineWorker *p_worker)
+{
+    p_worker->setRunning();
+    VTaskExecutor::inst()->start(p_worker, VTaskExecutor::Search);
+}
 
-            if (!th->m_error.isEmpty()) {
-                m_result->logError(th->m_error);
-            }
+void VSearchEngine::startIdleWorkers()
+{
+    int nr = qMin(m_queue->remaining(), m_idleWorkers.size());
+    for (int i = 0; i < nr; ++i) {
+        startWorker(m_idleWorkers.takeLast());
+    }
+}
+
+void VSearchEngine::handleWorkerFinished(VSearchEngineWorker *p_worker)
+{
+    // It returns right after the signal.
+    p_worker->waitForFinished();
 
-            Q_ASSERT(th->isFinished());
-            th->deleteLater();
+    if (p_worker->m_state == VSearchState::Fail) {
+        if (m_state != VSearchState::Cancelled) {
+            m_state = VSearchState::Fail;
         }
+    } else if (p_worker->m_state == VSearchState::Cancelled) {
+        m_state = VSearchState::Cancelled;
+    }
 
-        m_workers.clear();
-        m_finishedWorkers = 0;
+    if (!p_worker->m_error.isEmpty()) {
+        m_result->logError(p_worker->m_error);
+        p_worker->m_error.clear();
+    }
 
-        m_result->m_state = state;
-        qDebug() << "SearchEngine finished" << (int)state;
-        emit finished(m_result);
+    m_result->m_nrSearchedFiles += p_worker->m_nrSearchedFiles;
+    m_result->m_nrMimeCheckSkipped += p_worker->m_nrMimeCheckSkipped;
+
+    // Files appended after it ran dry.
+    if (m_state != VSearchState::Cancelled && m_queue->remaining() > 0) {
+        startWorker(p_worker);
+        return;
+    }
+
+    m_idleWorkers.append(p_worker);
+    finishIfDone();
+}
+
+void VSearchEngine::finishIfDone()
+{
+    if (m_idleWorkers.size() < m_workers.size() || !m_queue->isClosed()) {
+        return;
+    }
+
+    // No more file will come and the stopped workers return at once.
+    if (m_state != VSearchState::Cancelled && m_queue->remaining() > 0) {
+        startIdleWorkers();
+        return;
+    }
+
+    // Only once.
+    m_queue.clear();
+
+    // All the workers have appended their results before finished.
+    m_drainTimer->stop();
+    drainResults();
+
+    m_result->m_state = m_state;
+    qDebug() << "SearchEngine finished" << (int)m_state;
+    emit finished(m_result);
+}
+
+void VSearchEngine::drainResults()
+{
+    if (!m_resultQueue) {
+        return;
+    }
+
+    QList<QSharedPointer<VSearchResultItem> > items = m_resultQueue->takeAll();
+    if (!items.isEmpty()) {
+        emit resultItemsAdded(items);
     }
 }
 
@@ -264,19 +734,30 @@ void VSearchEngine::clear()
 {
     clearAllWorkers();
 
-    m_finishedWorkers = 0;
-
     m_result.clear();
 }
 
 void VSearchEngine::clearAllWorkers()
 {
+    if (m_queue) {
+        m_queue->close();
+    }
+
     for (auto const & th : m_workers) {
-        th->quit();
-        th->wait();
+        th->stop();
+
+        // Only wait for the started ones.
+        if (!VTaskExecutor::inst()->cancel(th)) {
+            th->waitForFinished();
+        }
 
         delete th;
     }
 
     m_workers.clear();
+    m_idleWorkers.clear();
+    m_queue.clear();
+
+    m_drainTimer->stop();
+    m_resultQueue.clear();
 }
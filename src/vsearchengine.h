@@ -4,15 +4,196 @@
 #include "isearchengine.h"
 
 #include <QThread>
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
 #include <QRegExp>
 #include <QAtomicInt>
 #include <QList>
+#include <QByteArrayMatcher>
+#include <QSet>
+#include <QHash>
 
 #include "vsearchconfig.h"
 
+class QFile;
+class QMimeDatabase;
+class QTimer;
+
 #define BATCH_ITEM_SIZE 100
 
-class VSearchEngineWorker : public QThread
+// Match RawString tokens against UTF-8 bytes directly, so that lines do not
+// need to be decoded unless they are hit.
+// Case-insensitive matching is only supported for ASCII keywords.
+class VSearchRawMatcher
+{
+public:
+    VSearchRawMatcher();
+
+    // Return false if @p_token could not be matched on bytes.
+    bool init(const VSearchToken &p_token);
+
+    bool isValid() const;
+
+    int size() const;
+
+    // Whether keyword @p_idx is contained in [p_data, p_data + p_len).
+    bool contains(int p_idx, const char *p_data, int p_len) const;
+
+    // Byte offset of keyword @p_idx in [p_data, p_data + p_len), or -1.
+    int indexIn(int p_idx, const char *p_data, int p_len) const;
+
+    // Whether the whole content [p_data, p_data + p_len) could match.
+    // For And, it fails if the rarest keyword is missing.
+    bool mayMatch(const char *p_data, int p_len) const;
+
+    // Indexes of keywords in the order to evaluate.
+    const QVector<int> &evaluationOrder() const;
+
+    VSearchToken::Operator getOperator() const;
+
+private:
+    static int indexOfCaseInsensitive(const char *p_data,
+                                      int p_len,
+                                      const QByteArray &p_lowerKeyword);
+
+    bool m_valid;
+
+    VSearchToken::Operator m_op;
+
+    Qt::CaseSensitivity m_caseSensitivity;
+
+    // Lower-cased if case-insensitive.
+    QVector<QByteArray> m_keywords;
+
+    // Valid if case-sensitive.
+    QVector<QByteArrayMatcher> m_matchers;
+
+    QVector<int> m_order;
+};
+
+inline bool VSearchRawMatcher::isValid() const
+{
+    return m_valid;
+}
+
+inline int VSearchRawMatcher::size() const
+{
+    return m_keywords.size();
+}
+
+inline VSearchToken::Operator VSearchRawMatcher::getOperator() const
+{
+    return m_op;
+}
+
+inline bool VSearchRawMatcher::contains(int p_idx, const char *p_data, int p_len) const
+{
+    return indexIn(p_idx, p_data, p_len) != -1;
+}
+
+inline const QVector<int> &VSearchRawMatcher::evaluationOrder() const
+{
+    return m_order;
+}
+
+
+// Files to search shared by all the workers of one search.
+// Running workers keep picking up the next remaining file and return once it
+// runs dry. Files could be appended until the queue is closed, and the engine
+// starts the idle workers again for them.
+class VSearchEngineQueue
+{
+public:
+    explicit VSearchEngineQueue(const QStringList &p_files)
+        : m_files(p_files),
+          m_next(0),
+          m_closed(false)
+    {
+    }
+
+    // Return false if there is no file left for now.
+    bool take(QString &p_file)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (m_next >= m_files.size()) {
+            return false;
+        }
+
+        p_file = m_files[m_next++];
+        return true;
+    }
+
+    // Ignored once closed.
+    void append(const QStringList &p_files)
+    {
+        QMutexLocker locker(&m_mutex);
+        if (!m_closed) {
+            m_files.append(p_files);
+        }
+    }
+
+    void close()
+    {
+        QMutexLocker locker(&m_mutex);
+        m_closed = true;
+    }
+
+    bool isClosed()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_closed;
+    }
+
+    // Number of files not taken yet.
+    int remaining()
+    {
+        QMutexLocker locker(&m_mutex);
+        return m_files.size() - m_next;
+    }
+
+private:
+    QStringList m_files;
+
+    int m_next;
+
+    bool m_closed;
+
+    QMutex m_mutex;
+};
+
+
+// Results of all the workers of one search.
+// Workers append to it and the engine drains it in the GUI thread at a fixed
+// interval, so the views get one update per interval instead of one queued
+// signal per batch of each worker.
+class VSearchEngineResultQueue
+{
+public:
+    void append(const QList<QSharedPointer<VSearchResultItem> > &p_items)
+    {
+        QMutexLocker locker(&m_mutex);
+        m_items.append(p_items);
+    }
+
+    QList<QSharedPointer<VSearchResultItem> > takeAll()
+    {
+        QList<QSharedPointer<VSearchResultItem> > items;
+        QMutexLocker locker(&m_mutex);
+        items.swap(m_items);
+        return items;
+    }
+
+private:
+    QList<QSharedPointer<VSearchResultItem> > m_items;
+
+    QMutex m_mutex;
+};
+
+
+// Run in the shared search thread pool so that threads are reused across
+// searches.
+class VSearchEngineWorker : public QObject, public QRunnable
 {
     Q_OBJECT
 
@@ -21,39 +202,88 @@ class VSearchEngineWorker : public QThread
 public:
     explicit VSearchEngineWorker(QObject *p_parent = nullptr);
 
-    void setData(const QStringList &p_files,
+    void setData(const QSharedPointer<VSearchEngineQueue> &p_queue,
+                 const QSharedPointer<VSearchEngineResultQueue> &p_resultQueue,
                  const VSearchToken &p_token,
-                 const QSharedPointer<VSearchConfig> &p_config);
+                 const QSharedPointer<VSearchConfig> &p_config,
+                 const QSet<QString> &p_textSuffixes);
+
+    void run() Q_DECL_OVERRIDE;
+
+    // Mark it running before it is scheduled, so that waitForFinished() will
+    // not miss it.
+    void setRunning();
+
+    // Block until run() returns. Return immediately if it is not started.
+    void waitForFinished();
 
 public slots:
     void stop();
 
 signals:
-    void resultItemsReady(const QList<QSharedPointer<VSearchResultItem> > &p_items);
-
-protected:
-    void run() Q_DECL_OVERRIDE;
+    void finished();
 
 private:
     void appendError(const QString &p_err);
 
+    // Whether @p_fileName is a text file worth searching.
+    bool isTextFile(const QString &p_fileName, QMimeDatabase &p_mimeDatabase);
+
     VSearchResultItem *searchFile(const QString &p_fileName);
 
+    // Decode and match the file line by line.
+    VSearchResultItem *searchFileByLine(const QString &p_fileName, QFile &p_file);
+
+    // Match the mapped UTF-8 bytes of the file and decode only the hit lines.
+    VSearchResultItem *searchMappedFile(const QString &p_fileName,
+                                        const char *p_data,
+                                        int p_size);
+
+    // Match of line @p_line in bytes at @p_offset of the file, keeping only a
+    // window around @p_matchPos as its text.
+    static VSearchResultSubItem contextSubItem(int p_lineNumber,
+                                               qint64 p_offset,
+                                               const char *p_line,
+                                               int p_len,
+                                               int p_matchPos);
+
     void postAndClearResults();
 
     QAtomicInt m_stop;
 
-    QStringList m_files;
+    QSharedPointer<VSearchEngineQueue> m_queue;
+
+    QSharedPointer<VSearchEngineResultQueue> m_resultQueue;
 
     VSearchToken m_token;
 
+    VSearchRawMatcher m_rawMatcher;
+
     QSharedPointer<VSearchConfig> m_config;
 
+    // Files with these lower-case suffixes are treated as text directly.
+    QSet<QString> m_textSuffixes;
+
+    // Cached mime decision of "directory/suffix" of files having unknown suffix.
+    // Files of the same suffix in one folder are nearly always of the same type.
+    QHash<QString, bool> m_textDecisions;
+
+    int m_nrSearchedFiles;
+
+    int m_nrMimeCheckSkipped;
+
     VSearchState m_state;
 
     QString m_error;
 
     QList<QSharedPointer<VSearchResultItem> > m_results;
+
+    // Whether run() is in progress.
+    bool m_running;
+
+    QMutex m_runningMutex;
+
+    QWaitCondition m_runningCond;
 };
 
 inline void VSearchEngineWorker::appendError(const QString &p_err)
@@ -61,7 +291,7 @@ inline void VSearchEngineWorker::appendError(const QString &p_err)
     if (m_error.isEmpty()) {
         m_error = p_err;
     } else {
-        m_error = "\n" + p_err;
+        m_error += "\n" + p_err;
     }
 }
 
@@ -81,15 +311,51 @@ public:
 
     void clear() Q_DECL_OVERRIDE;
 
-private slots:
-    void handleWorkerFinished();
+    bool isStreamingSupported() const Q_DECL_OVERRIDE;
+
+    void appendSecondPhaseItems(const QStringList &p_items) Q_DECL_OVERRIDE;
+
+    void endSecondPhaseItems() Q_DECL_OVERRIDE;
 
 private:
+    // Collect the results of one run of @p_worker and start it again if
+    // there are files left.
+    void handleWorkerFinished(VSearchEngineWorker *p_worker);
+
+    void startWorker(VSearchEngineWorker *p_worker);
+
+    // Start idle workers for the files left.
+    void startIdleWorkers();
+
+    // Emit finished() if all the workers are idle and no file will come.
+    void finishIfDone();
+
+    // Hand the results of the workers so far to the views in one batch.
+    void drainResults();
+
     void clearAllWorkers();
 
-    int m_finishedWorkers;
+    // Increased for each search.
+    int m_generation;
 
     QVector<VSearchEngineWorker *> m_workers;
+
+    // Workers not scheduled, waiting for more files.
+    QVector<VSearchEngineWorker *> m_idleWorkers;
+
+    // State of the workers so far.
+    VSearchState m_state;
+
+    QSharedPointer<VSearchEngineQueue> m_queue;
+
+    QSharedPointer<VSearchEngineResultQueue> m_resultQueue;
+
+    QTimer *m_drainTimer;
 };
 
+inline bool VSearchEngine::isStreamingSupported() const
+{
+    return true;
+}
+
 #endif // VSEARCHENGINE_H
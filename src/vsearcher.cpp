@@ -18,6 +18,7 @@
 #include "vconfigmanager.h"
 #include "vexplorer.h"
 #include "vconstants.h"
+#include "vsavedsearch.h"
 
 extern VMainWindow *g_mainWin;
 
@@ -84,6 +85,19 @@ void VSearcher::setupUI()
                 m_consoleEdit->setVisible(p_checked);
             });
 
+    // Saved searches button.
+    m_savedBtn = new QPushButton(VIconUtils::buttonIcon(":/resources/icons/star.svg"),
+                                 "",
+                                 this);
+    m_savedBtn->setToolTip(tr("Saved Searches"));
+    m_savedBtn->setProperty("FlatBtn", true);
+    QMenu *savedMenu = new QMenu(this);
+    connect(savedMenu, &QMenu::aboutToShow,
+            this, [this, savedMenu]() {
+                updateSavedSearchMenu(savedMenu);
+            });
+    m_savedBtn->setMenu(savedMenu);
+
     m_numLabel = new QLabel(this);
 
     QHBoxLayout *btnLayout = new QHBoxLayout();
@@ -91,6 +105,7 @@ void VSearcher::setupUI()
     btnLayout->addWidget(m_clearBtn);
     btnLayout->addWidget(m_advBtn);
     btnLayout->addWidget(m_consoleBtn);
+    btnLayout->addWidget(m_savedBtn);
     btnLayout->addStretch();
     btnLayout->addWidget(m_numLabel);
     btnLayout->setContentsMargins(0, 0, 0, 0);
@@ -258,6 +273,11 @@ void VSearcher::initUIFields()
     m_searchObjectCB->addItem(tr("Content"), VSearchConfig::Content);
     m_searchObjectCB->addItem(tr("Tag"), VSearchConfig::Tag);
     m_searchObjectCB->addItem(tr("Path"), VSearchConfig::Path);
+    m_searchObjectCB->addItem(tr("Metadata"), VSearchConfig::Metadata);
+    m_searchObjectCB->setItemData(m_searchObjectCB->count() - 1,
+                                  tr("Predicates like tag:TAG, modified:7d, created:>2018-01-01, "
+                                     "or KEY:TEXT of front matter"),
+                                  Qt::ToolTipRole);
     m_searchObjectCB->setCurrentIndex(m_searchObjectCB->findData(config.m_object));
 
     // Target.
@@ -272,6 +292,8 @@ void VSearcher::initUIFields()
 
     // Engine.
     m_searchEngineCB->addItem(tr("Internal"), VSearchConfig::Internal);
+    m_searchEngineCB->addItem(tr("Indexed"), VSearchConfig::Indexed);
+    m_searchEngineCB->addItem(tr("External"), VSearchConfig::External);
     m_searchEngineCB->setCurrentIndex(m_searchEngineCB->findData(config.m_engine));
 
     // Pattern.
@@ -295,6 +317,104 @@ void VSearcher::updateItemToComboBox(QComboBox *p_comboBox)
     }
 }
 
+QStringList VSearcher::currentConfig() const
+{
+    VSearchConfig config(m_searchScopeCB->currentData().toInt(),
+                         m_searchObjectCB->currentData().toInt(),
+                         m_searchTargetCB->currentData().toInt(),
+                         m_searchEngineCB->currentData().toInt(),
+                         getSearchOption(),
+                         "",
+                         m_filePatternCB->currentText());
+    return config.toConfig();
+}
+
+void VSearcher::updateSavedSearchMenu(QMenu *p_menu)
+{
+    p_menu->clear();
+
+    QAction *saveAct = p_menu->addAction(tr("Save Current Search"));
+    saveAct->setToolTip(tr("Save current search to re-run it incrementally"));
+    saveAct->setEnabled(!m_keywordCB->currentText().isEmpty());
+    connect(saveAct, &QAction::triggered,
+            this, &VSearcher::saveCurrentSearch);
+
+    const QVector<QSharedPointer<VSavedSearch> > &searches = VSavedSearchManager::getSearches();
+    if (searches.isEmpty()) {
+        return;
+    }
+
+    p_menu->addSeparator();
+
+    QMenu *deleteMenu = new QMenu(tr("Delete"), p_menu);
+    for (auto const & search : searches) {
+        QAction *act = p_menu->addAction(search->getName());
+        act->setToolTip(search->getKeyword());
+        act->setEnabled(!m_inSearch);
+        connect(act, &QAction::triggered,
+                this, [this, search]() {
+                    runSavedSearch(search);
+                });
+
+        QAction *delAct = deleteMenu->addAction(search->getName());
+        QString name = search->getName();
+        connect(delAct, &QAction::triggered,
+                this, [name]() {
+                    VSavedSearchManager::removeSearch(name);
+                });
+    }
+
+    p_menu->addSeparator();
+    p_menu->addMenu(deleteMenu);
+}
+
+void VSearcher::saveCurrentSearch()
+{
+    QString keyword = m_keywordCB->currentText();
+    if (keyword.isEmpty()) {
+        return;
+    }
+
+    bool ok;
+    QString name = QInputDialog::getText(this,
+                                         tr("Save Search"),
+                                         tr("Name of the search:"),
+                                         QLineEdit::Normal,
+                                         keyword,
+                                         &ok).trimmed();
+    if (!ok || name.isEmpty()) {
+        return;
+    }
+
+    VSavedSearchManager::saveSearch(name, currentConfig(), keyword);
+    showMessage(tr("Search %1 saved.").arg(name));
+}
+
+void VSearcher::runSavedSearch(const QSharedPointer<VSavedSearch> &p_search)
+{
+    if (m_inSearch) {
+        return;
+    }
+
+    VSearchConfig config = VSearchConfig::fromConfig(p_search->getConfig());
+
+    m_keywordCB->setCurrentText(p_search->getKeyword());
+    m_searchScopeCB->setCurrentIndex(m_searchScopeCB->findData(config.m_scope));
+    m_searchObjectCB->setCurrentIndex(m_searchObjectCB->findData(config.m_object));
+    m_searchTargetCB->setCurrentIndex(m_searchTargetCB->findData(config.m_target));
+    m_searchEngineCB->setCurrentIndex(m_searchEngineCB->findData(config.m_engine));
+    m_filePatternCB->setCurrentText(config.m_pattern);
+
+    m_caseSensitiveCB->setChecked(config.m_option & VSearchConfig::CaseSensitive);
+    m_wholeWordOnlyCB->setChecked(config.m_option & VSearchConfig::WholeWordOnly);
+    m_fuzzyCB->setChecked(config.m_option & VSearchConfig::Fuzzy);
+    m_regularExpressionCB->setChecked(config.m_option & VSearchConfig::RegularExpression);
+
+    if (m_searchBtn->isEnabled()) {
+        startSearch();
+    }
+}
+
 void VSearcher::setProgressVisible(bool p_visible)
 {
     m_proBar->setVisible(p_visible);
@@ -388,83 +508,104 @@ void VSearcher::startSearch()
     g_config->setSearchOptions(config->toConfig());
 
     QSharedPointer<VSearchResult> result;
-    switch (config->m_scope) {
-    case VSearchConfig::CurrentNote:
-    {
-        QVector<VFile *> files;
-        files.append(g_mainWin->getCurrentFile());
-        if (files[0]) {
-            QString msg(tr("Search current note %1.").arg(files[0]->getName()));
-            appendLogLine(msg);
-            showMessage(msg);
+    QString key = scopeKey(config->m_scope);
+    QStringList refineFiles;
+    bool refining = !key.isEmpty() && m_refiner.refine(*config, key, refineFiles);
+    m_refiner.begin(config, key);
+    if (refining) {
+        // Narrowing down last search. Search only the notes it matched.
+        appendLogLine(tr("Refine last search within %1 notes.").arg(refineFiles.size()));
+        result = m_search.refine(refineFiles);
+    } else {
+        // Search matching a saved one re-scans only the modified files.
+        QStringList configStr = config->toConfig();
+        for (auto const & saved : VSavedSearchManager::getSearches()) {
+            if (saved->getConfig() == configStr
+                && saved->getKeyword() == m_keywordCB->currentText()) {
+                appendLogLine(tr("Run saved search %1 incrementally.").arg(saved->getName()));
+                m_search.setSavedSearch(saved);
+                break;
+            }
         }
 
-        result = m_search.search(files);
-        break;
-    }
+        switch (config->m_scope) {
+        case VSearchConfig::CurrentNote:
+        {
+            QVector<VFile *> files;
+            files.append(g_mainWin->getCurrentFile());
+            if (files[0]) {
+                QString msg(tr("Search current note %1.").arg(files[0]->getName()));
+                appendLogLine(msg);
+                showMessage(msg);
+            }
 
-    case VSearchConfig::OpenedNotes:
-    {
-        QVector<VEditTabInfo> tabs = g_mainWin->getEditArea()->getAllTabsInfo();
-        QVector<VFile *> files;
-        files.reserve(tabs.size());
-        for (auto const & ta : tabs) {
-            files.append(ta.m_editTab->getFile());
+            result = m_search.search(files);
+            break;
         }
 
-        result = m_search.search(files);
-        break;
-    }
+        case VSearchConfig::OpenedNotes:
+        {
+            QVector<VEditTabInfo> tabs = g_mainWin->getEditArea()->getAllTabsInfo();
+            QVector<VFile *> files;
+            files.reserve(tabs.size());
+            for (auto const & ta : tabs) {
+                files.append(ta.m_editTab->getFile());
+            }
 
-    case VSearchConfig::CurrentFolder:
-    {
-        VDirectory *dir = g_mainWin->getDirectoryTree()->currentDirectory();
-        if (dir) {
-            QString msg(tr("Search current folder %1.").arg(dir->getName()));
-            appendLogLine(msg);
-            showMessage(msg);
+            result = m_search.search(files);
+            break;
         }
 
-        result = m_search.search(dir);
-        break;
-    }
+        case VSearchConfig::CurrentFolder:
+        {
+            VDirectory *dir = g_mainWin->getDirectoryTree()->currentDirectory();
+            if (dir) {
+                QString msg(tr("Search current folder %1.").arg(dir->getName()));
+                appendLogLine(msg);
+                showMessage(msg);
+            }
 
-    case VSearchConfig::CurrentNotebook:
-    {
-        QVector<VNotebook *> notebooks;
-        notebooks.append(g_mainWin->getNotebookSelector()->currentNotebook());
-        if (notebooks[0]) {
-            QString msg(tr("Search current notebook %1.").arg(notebooks[0]->getName()));
-            appendLogLine(msg);
-            showMessage(msg);
+            result = m_search.search(dir);
+            break;
         }
 
-        result = m_search.search(notebooks);
-        break;
-    }
+        case VSearchConfig::CurrentNotebook:
+        {
+            QVector<VNotebook *> notebooks;
+            notebooks.append(g_mainWin->getNotebookSelector()->currentNotebook());
+            if (notebooks[0]) {
+                QString msg(tr("Search current notebook %1.").arg(notebooks[0]->getName()));
+                appendLogLine(msg);
+                showMessage(msg);
+            }
 
-    case VSearchConfig::AllNotebooks:
-    {
-        const QVector<VNotebook *> &notebooks = g_vnote->getNotebooks();
-        result = m_search.search(notebooks);
-        break;
-    }
+            result = m_search.search(notebooks);
+            break;
+        }
 
-    case VSearchConfig::ExplorerDirectory:
-    {
-        QString rootDirectory = g_mainWin->getExplorer()->getRootDirectory();
-        if (!rootDirectory.isEmpty()) {
-            QString msg(tr("Search Explorer directory %1.").arg(rootDirectory));
-            appendLogLine(msg);
-            showMessage(msg);
+        case VSearchConfig::AllNotebooks:
+        {
+            const QVector<VNotebook *> &notebooks = g_vnote->getNotebooks();
+            result = m_search.search(notebooks);
+            break;
         }
 
-        result = m_search.search(rootDirectory);
-        break;
-    }
+        case VSearchConfig::ExplorerDirectory:
+        {
+            QString rootDirectory = g_mainWin->getExplorer()->getRootDirectory();
+            if (!rootDirectory.isEmpty()) {
+                QString msg(tr("Search Explorer directory %1.").arg(rootDirectory));
+                appendLogLine(msg);
+                showMessage(msg);
+            }
 
-    default:
-        break;
+            result = m_search.search(rootDirectory);
+            break;
+        }
+
+        default:
+            break;
+        }
     }
 
     handleSearchFinished(result);
@@ -515,6 +656,12 @@ void VSearcher::handleSearchFinished(const QSharedPointer<VSearchResult> &p_resu
         break;
     }
 
+    if (p_result->m_nrSearchedFiles > 0) {
+        appendLogLine(tr("Searched content of %1 files (%2 without mime detection).")
+                        .arg(p_result->m_nrSearchedFiles)
+                        .arg(p_result->m_nrMimeCheckSkipped));
+    }
+
     if (p_result->m_state != VSearchState::Fail
         && p_result->hasError()) {
         VUtils::showMessage(QMessageBox::Warning,
@@ -526,6 +673,8 @@ void VSearcher::handleSearchFinished(const QSharedPointer<VSearchResult> &p_resu
                             this);
     }
 
+    m_refiner.end(p_result);
+
     m_search.clear();
 
     m_inSearch = false;
@@ -561,6 +710,40 @@ int VSearcher::getSearchOption() const
     return ret;
 }
 
+QString VSearcher::scopeKey(int p_scope) const
+{
+    switch (p_scope) {
+    case VSearchConfig::CurrentFolder:
+    {
+        VDirectory *dir = g_mainWin->getDirectoryTree()->currentDirectory();
+        return dir ? dir->fetchPath() : QString();
+    }
+
+    case VSearchConfig::CurrentNotebook:
+    {
+        VNotebook *nb = g_mainWin->getNotebookSelector()->currentNotebook();
+        return nb ? nb->getPath() : QString();
+    }
+
+    case VSearchConfig::AllNotebooks:
+    {
+        QStringList paths;
+        for (auto const & nb : g_vnote->getNotebooks()) {
+            paths.append(nb->getPath());
+        }
+
+        return paths.join('\n');
+    }
+
+    case VSearchConfig::ExplorerDirectory:
+        return g_mainWin->getExplorer()->getRootDirectory();
+
+    default:
+        // Notes are searched in memory, which is cheap enough.
+        return QString();
+    }
+}
+
 void VSearcher::updateNumLabel(int p_count)
 {
     m_numLabel->setText(tr("%1 Items").arg(p_count));
@@ -608,12 +791,14 @@ void VSearcher::init()
                 // Not sure if it works.
                 QCoreApplication::sendPostedEvents(NULL, QEvent::MouseButtonRelease);
                 m_results->addResultItem(p_item);
+                m_refiner.addResultItem(p_item);
             });
     connect(&m_search, &VSearch::resultItemsAdded,
             this, [this](const QList<QSharedPointer<VSearchResultItem> > &p_items) {
                 // Not sure if it works.
                 QCoreApplication::sendPostedEvents(NULL, QEvent::MouseButtonRelease);
                 m_results->addResultItems(p_items);
+                m_refiner.addResultItems(p_items);
             });
     connect(&m_search, &VSearch::finished,
             this, &VSearcher::handleSearchFinished);
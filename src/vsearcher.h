@@ -16,6 +16,8 @@ class VSearchResultTree;
 class QProgressBar;
 class QPlainTextEdit;
 class QShowEvent;
+class QMenu;
+class VSavedSearch;
 
 class VSearcher : public QWidget, public VNavigationMode
 {
@@ -54,9 +56,24 @@ private:
 
     void updateItemToComboBox(QComboBox *p_comboBox);
 
+    void updateSavedSearchMenu(QMenu *p_menu);
+
+    // Save current inputs as a saved search.
+    void saveCurrentSearch();
+
+    // Fill the inputs with @p_search and run it.
+    void runSavedSearch(const QSharedPointer<VSavedSearch> &p_search);
+
+    // Current inputs in the form of VSearchConfig::toConfig().
+    QStringList currentConfig() const;
+
     // Get the OR of the search options.
     int getSearchOption() const;
 
+    // Key identifying the notes of @p_scope for refinement. Empty if search in
+    // @p_scope could not be refined.
+    QString scopeKey(int p_scope) const;
+
     void updateNumLabel(int p_count);
 
     void showMessage(const QString &p_text) const;
@@ -92,6 +109,8 @@ private:
 
     QPushButton *m_consoleBtn;
 
+    QPushButton *m_savedBtn;
+
     QLabel *m_numLabel;
 
     QWidget *m_advWidget;
@@ -113,6 +132,8 @@ private:
     bool m_askedToStop;
 
     VSearch m_search;
+
+    VSearchRefiner m_refiner;
 };
 
 #endif // VSEARCHER_H
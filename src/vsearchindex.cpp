@@ -0,0 +1,527 @@
+#include "vsearchindex.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QSaveFile>
+#include <QDataStream>
+#include <QDateTime>
+#include <QCryptographicHash>
+
+#include <algorithm>
+
+#include "vsearchconfig.h"
+#include "vnotebook.h"
+#include "vnote.h"
+#include "vconfigmanager.h"
+#include "utils/vutils.h"
+
+extern VNote *g_vnote;
+
+extern VConfigManager *g_config;
+
+// Magic and version of the index file.
+#define INDEX_FILE_MAGIC 0x56534958
+#define INDEX_FILE_VERSION 2
+
+// Compact the index when there are too many dead entries.
+#define COMPACT_DEAD_FILES_THRESHOLD 1024
+
+VSearchIndex::VSearchIndex(const QString &p_rootPath, const QString &p_indexFile)
+    : m_rootPath(p_rootPath),
+      m_indexFile(p_indexFile),
+      m_deadFiles(0),
+      m_dirty(false)
+{
+}
+
+bool VSearchIndex::load()
+{
+    QMutexLocker locker(&m_mutex);
+
+    m_files.clear();
+    m_pathToId.clear();
+    m_postings.clear();
+    m_deadFiles = 0;
+    m_dirty = false;
+
+    QFile file(m_indexFile);
+    if (!file.open(QIODevice::ReadOnly)) {
+        return false;
+    }
+
+    QDataStream in(&file);
+    in.setVersion(QDataStream::Qt_5_6);
+
+    quint32 magic = 0, version = 0;
+    in >> magic >> version;
+    if (magic != INDEX_FILE_MAGIC || version != INDEX_FILE_VERSION) {
+        qWarning() << "invalid search index file" << m_indexFile;
+        return false;
+    }
+
+    qint32 nrFiles = 0;
+    in >> nrFiles;
+    m_files.resize(qMax(nrFiles, 0));
+    for (int i = 0; i < m_files.size(); ++i) {
+        FileEntry &entry = m_files[i];
+        in >> entry.m_path >> entry.m_modifiedTime;
+        entry.m_alive = true;
+        m_pathToId.insert(entry.m_path, i);
+    }
+
+    qint32 nrPostings = 0;
+    in >> nrPostings;
+    m_postings.reserve(qMax(nrPostings, 0));
+    for (int i = 0; i < nrPostings; ++i) {
+        quint64 key = 0;
+        QVector<int> ids;
+        in >> key >> ids;
+        m_postings.insert(key, ids);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qWarning() << "corrupted search index file" << m_indexFile;
+        m_files.clear();
+        m_pathToId.clear();
+        m_postings.clear();
+        return false;
+    }
+
+    qDebug() << "search index loaded" << m_rootPath << m_files.size() << m_postings.size();
+    return true;
+}
+
+bool VSearchIndex::save()
+{
+    QMutexLocker locker(&m_mutex);
+    if (!m_dirty) {
+        return true;
+    }
+
+    compact();
+
+    VUtils::makePath(VUtils::basePathFromPath(m_indexFile));
+
+    QSaveFile file(m_indexFile);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "fail to open search index file to write" << m_indexFile;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out.setVersion(QDataStream::Qt_5_6);
+
+    out << (quint32)INDEX_FILE_MAGIC << (quint32)INDEX_FILE_VERSION;
+
+    out << (qint32)m_files.size();
+    for (auto const & entry : m_files) {
+        out << entry.m_path << entry.m_modifiedTime;
+    }
+
+    out << (qint32)m_postings.size();
+    for (auto it = m_postings.constBegin(); it != m_postings.constEnd(); ++it) {
+        out << it.key() << it.value();
+    }
+
+    if (!file.commit()) {
+        qWarning() << "fail to write search index file" << m_indexFile;
+        return false;
+    }
+
+    m_dirty = false;
+    return true;
+}
+
+QString VSearchIndex::relativePath(const QString &p_filePath) const
+{
+    return QDir(m_rootPath).relativeFilePath(p_filePath);
+}
+
+void VSearchIndex::refreshFile(const QString &p_filePath, bool p_indexedOnly)
+{
+    QString relPath = relativePath(p_filePath);
+    if (p_indexedOnly) {
+        QMutexLocker locker(&m_mutex);
+        if (!m_pathToId.contains(relPath)) {
+            return;
+        }
+    }
+
+    QFileInfo fi(p_filePath);
+    if (!fi.exists()) {
+        QMutexLocker locker(&m_mutex);
+        removeFileInternal(relPath);
+        return;
+    }
+
+    qint64 modifiedTime = fi.lastModified().toMSecsSinceEpoch();
+
+    {
+        QMutexLocker locker(&m_mutex);
+        auto it = m_pathToId.constFind(relPath);
+        if (it != m_pathToId.constEnd()
+            && m_files[it.value()].m_modifiedTime == modifiedTime) {
+            return;
+        }
+    }
+
+    // Read the file without holding the lock.
+    QString content = VUtils::readFileFromDisk(p_filePath);
+
+    QMutexLocker locker(&m_mutex);
+    updateFileInternal(relPath, content, modifiedTime);
+}
+
+void VSearchIndex::updateFile(const QString &p_filePath, const QString &p_content)
+{
+    qint64 modifiedTime = QFileInfo(p_filePath).lastModified().toMSecsSinceEpoch();
+
+    QMutexLocker locker(&m_mutex);
+    updateFileInternal(relativePath(p_filePath), p_content, modifiedTime);
+}
+
+void VSearchIndex::removeFile(const QString &p_filePath)
+{
+    QMutexLocker locker(&m_mutex);
+    removeFileInternal(relativePath(p_filePath));
+}
+
+void VSearchIndex::renameFile(const QString &p_oldPath, const QString &p_newPath)
+{
+    QMutexLocker locker(&m_mutex);
+    QString oldRelPath = relativePath(p_oldPath);
+    auto it = m_pathToId.find(oldRelPath);
+    if (it == m_pathToId.end()) {
+        return;
+    }
+
+    int id = it.value();
+    m_pathToId.erase(it);
+
+    QString newRelPath = relativePath(p_newPath);
+    removeFileInternal(newRelPath);
+
+    m_files[id].m_path = newRelPath;
+    m_pathToId.insert(newRelPath, id);
+    m_dirty = true;
+}
+
+void VSearchIndex::updateFileInternal(const QString &p_relativePath,
+                                      const QString &p_content,
+                                      qint64 p_modifiedTime)
+{
+    removeFileInternal(p_relativePath);
+
+    int id = m_files.size();
+    FileEntry entry;
+    entry.m_path = p_relativePath;
+    entry.m_modifiedTime = p_modifiedTime;
+    entry.m_alive = true;
+    m_files.append(entry);
+    m_pathToId.insert(p_relativePath, id);
+
+    QSet<quint64> trigrams;
+    collectTrigrams(p_content, trigrams);
+    for (auto key : trigrams) {
+        // Ids are increasing so the postings keep ascending.
+        m_postings[key].append(id);
+    }
+
+    m_dirty = true;
+
+    if (m_deadFiles > COMPACT_DEAD_FILES_THRESHOLD
+        && m_deadFiles > m_files.size() / 2) {
+        compact();
+    }
+}
+
+void VSearchIndex::removeFileInternal(const QString &p_relativePath)
+{
+    auto it = m_pathToId.find(p_relativePath);
+    if (it == m_pathToId.end()) {
+        return;
+    }
+
+    // Just mark it dead. The postings will be cleaned up in compact().
+    m_files[it.value()].m_alive = false;
+    m_pathToId.erase(it);
+    ++m_deadFiles;
+    m_dirty = true;
+}
+
+void VSearchIndex::compact()
+{
+    if (m_deadFiles == 0) {
+        return;
+    }
+
+    QVector<int> idMap(m_files.size(), -1);
+    QVector<FileEntry> files;
+    files.reserve(m_files.size() - m_deadFiles);
+    for (int i = 0; i < m_files.size(); ++i) {
+        if (m_files[i].m_alive) {
+            idMap[i] = files.size();
+            files.append(m_files[i]);
+        }
+    }
+
+    for (auto it = m_postings.begin(); it != m_postings.end();) {
+        QVector<int> &ids = it.value();
+        int j = 0;
+        for (int i = 0; i < ids.size(); ++i) {
+            int newId = idMap[ids[i]];
+            if (newId != -1) {
+                ids[j++] = newId;
+            }
+        }
+
+        if (j == 0) {
+            it = m_postings.erase(it);
+        } else {
+            ids.resize(j);
+            ++it;
+        }
+    }
+
+    m_files = files;
+    m_pathToId.clear();
+    m_pathToId.reserve(m_files.size());
+    for (int i = 0; i < m_files.size(); ++i) {
+        m_pathToId.insert(m_files[i].m_path, i);
+    }
+
+    m_deadFiles = 0;
+}
+
+QSet<int> VSearchIndex::lookup(const QString &p_keyword) const
+{
+    QSet<int> ids;
+
+    QSet<quint64> trigrams;
+    collectTrigrams(p_keyword, trigrams);
+    if (trigrams.isEmpty()) {
+        return ids;
+    }
+
+    // Walk the shortest posting and verify against the others.
+    QVector<const QVector<int> *> postings;
+    postings.reserve(trigrams.size());
+    const QVector<int> *shortest = NULL;
+    for (auto key : trigrams) {
+        auto it = m_postings.constFind(key);
+        if (it == m_postings.constEnd()) {
+            return ids;
+        }
+
+        postings.append(&it.value());
+        if (!shortest || it.value().size() < shortest->size()) {
+            shortest = &it.value();
+        }
+    }
+
+    for (auto id : *shortest) {
+        if (!m_files[id].m_alive) {
+            continue;
+        }
+
+        bool hit = true;
+        for (auto posting : postings) {
+            if (posting != shortest
+                && !std::binary_search(posting->constBegin(), posting->constEnd(), id)) {
+                hit = false;
+                break;
+            }
+        }
+
+        if (hit) {
+            ids.insert(id);
+        }
+    }
+
+    return ids;
+}
+
+QStringList VSearchIndex::filterCandidates(const VSearchToken &p_token,
+                                           const QStringList &p_files) const
+{
+    Q_ASSERT(canAnswer(p_token));
+
+    QMutexLocker locker(&m_mutex);
+
+    bool constrained = false;
+    QSet<int> ids;
+    for (auto const & keyword : p_token.m_keywords) {
+        if (keyword.size() < 3) {
+            // Keywords except the AND ones are guaranteed by canAnswer().
+            continue;
+        }
+
+        QSet<int> tmp = lookup(keyword);
+        if (!constrained) {
+            ids = tmp;
+            constrained = true;
+        } else if (p_token.m_op == VSearchToken::And) {
+            ids.intersect(tmp);
+        } else {
+            ids.unite(tmp);
+        }
+    }
+
+    if (!constrained) {
+        return p_files;
+    }
+
+    QStringList candidates;
+    for (auto const & file : p_files) {
+        auto it = m_pathToId.constFind(relativePath(file));
+        if (it == m_pathToId.constEnd() || ids.contains(it.value())) {
+            // Files not indexed should still be scanned.
+            candidates.append(file);
+        }
+    }
+
+    return candidates;
+}
+
+bool VSearchIndex::canAnswer(const VSearchToken &p_token)
+{
+    if (p_token.m_type != VSearchToken::RawString || p_token.m_keywords.isEmpty()) {
+        return false;
+    }
+
+    bool hasConstraint = false;
+    for (auto const & keyword : p_token.m_keywords) {
+        if (keyword.size() >= 3) {
+            hasConstraint = true;
+        } else if (p_token.m_op == VSearchToken::Or) {
+            // A short keyword could match anything.
+            return false;
+        }
+    }
+
+    return hasConstraint;
+}
+
+void VSearchIndex::collectTrigrams(const QString &p_text, QSet<quint64> &p_trigrams)
+{
+    // Case-folded so that the index could serve both case-sensitive and
+    // case-insensitive search, which compares case-folded text as well.
+    const QString text = p_text.toCaseFolded();
+    const QChar *data = text.constData();
+    int size = text.size();
+    for (int i = 2; i < size; ++i) {
+        QChar a = data[i - 2], b = data[i - 1], c = data[i];
+        if (c == '\n' || c == '\r') {
+            // Skip the next two windows crossing the line break.
+            i += 2;
+            continue;
+        }
+
+        if (a == '\n' || a == '\r' || b == '\n' || b == '\r') {
+            continue;
+        }
+
+        p_trigrams.insert(trigramKey(a, b, c));
+    }
+}
+
+quint64 VSearchIndex::trigramKey(QChar p_a, QChar p_b, QChar p_c)
+{
+    return ((quint64)p_a.unicode() << 32)
+           | ((quint64)p_b.unicode() << 16)
+           | (quint64)p_c.unicode();
+}
+
+
+VSearchIndexManager *VSearchIndexManager::inst()
+{
+    static VSearchIndexManager mgr;
+    return &mgr;
+}
+
+QSharedPointer<VSearchIndex> VSearchIndexManager::indexForFile(const QString &p_filePath)
+{
+    QStringList parts;
+    for (auto const & nb : g_vnote->getNotebooks()) {
+        if (!VUtils::splitPathInBasePath(nb->getPath(), p_filePath, parts)) {
+            continue;
+        }
+
+        VSearchIndexManager *mgr = inst();
+        QSharedPointer<VSearchIndex> index = mgr->m_indexes.value(nb->getPath());
+        if (index.isNull()) {
+            index.reset(new VSearchIndex(nb->getPath(), indexFilePath(nb->getPath())));
+            index->load();
+            mgr->m_indexes.insert(nb->getPath(), index);
+        }
+
+        return index;
+    }
+
+    return QSharedPointer<VSearchIndex>();
+}
+
+QSharedPointer<VSearchIndex> VSearchIndexManager::loadedIndex(const VNotebook *p_notebook) const
+{
+    if (!p_notebook) {
+        return QSharedPointer<VSearchIndex>();
+    }
+
+    return m_indexes.value(p_notebook->getPath());
+}
+
+void VSearchIndexManager::fileSaved(const VNotebook *p_notebook,
+                                    const QString &p_filePath,
+                                    const QString &p_content)
+{
+    QSharedPointer<VSearchIndex> index = inst()->loadedIndex(p_notebook);
+    if (index) {
+        index->updateFile(p_filePath, p_content);
+    }
+}
+
+void VSearchIndexManager::fileRenamed(const VNotebook *p_notebook,
+                                      const QString &p_oldPath,
+                                      const QString &p_newPath)
+{
+    QSharedPointer<VSearchIndex> index = inst()->loadedIndex(p_notebook);
+    if (index) {
+        index->renameFile(p_oldPath, p_newPath);
+    }
+}
+
+void VSearchIndexManager::fileDeleted(const VNotebook *p_notebook, const QString &p_filePath)
+{
+    QSharedPointer<VSearchIndex> index = inst()->loadedIndex(p_notebook);
+    if (index) {
+        index->removeFile(p_filePath);
+    }
+}
+
+void VSearchIndexManager::filesChangedOnDisk(const VNotebook *p_notebook,
+                                             const QStringList &p_filePaths)
+{
+    QSharedPointer<VSearchIndex> index = inst()->loadedIndex(p_notebook);
+    if (index) {
+        for (auto const & file : p_filePaths) {
+            index->refreshFile(file, true);
+        }
+    }
+}
+
+void VSearchIndexManager::saveAll()
+{
+    for (auto const & index : inst()->m_indexes) {
+        index->save();
+    }
+}
+
+QString VSearchIndexManager::indexFilePath(const QString &p_rootPath)
+{
+    QByteArray hash = QCryptographicHash::hash(QDir::cleanPath(p_rootPath).toUtf8(),
+                                               QCryptographicHash::Md5).toHex();
+    return QDir(g_config->getConfigFolder()).filePath(QString("search_index/%1.idx")
+                                                      .arg(QString::fromLatin1(hash)));
+}
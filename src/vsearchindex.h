@@ -0,0 +1,152 @@
+#ifndef VSEARCHINDEX_H
+#define VSEARCHINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QMutex>
+#include <QSharedPointer>
+
+struct VSearchToken;
+class VNotebook;
+
+// Persistent inverted index of the content of notes within one notebook.
+// It maps a trigram of the case-folded content to the notes containing it.
+// It is used to prune the files to scan for RawString tokens. The candidates
+// still need to be verified by the scan engine to get the matched lines.
+// All public methods are thread-safe.
+class VSearchIndex
+{
+public:
+    VSearchIndex(const QString &p_rootPath, const QString &p_indexFile);
+
+    const QString &getRootPath() const;
+
+    // Load index from disk. Return false if there is no valid index file.
+    bool load();
+
+    // Write index to disk if it is dirty.
+    bool save();
+
+    // Make sure the index of @p_filePath is fresh by checking modified time.
+    // If @p_indexedOnly, files not in the index yet are skipped.
+    void refreshFile(const QString &p_filePath, bool p_indexedOnly = false);
+
+    void updateFile(const QString &p_filePath, const QString &p_content);
+
+    void removeFile(const QString &p_filePath);
+
+    void renameFile(const QString &p_oldPath, const QString &p_newPath);
+
+    // Filter @p_files to those that may match @p_token.
+    // @p_files should have been refreshed.
+    QStringList filterCandidates(const VSearchToken &p_token,
+                                 const QStringList &p_files) const;
+
+    // Whether the index could answer @p_token.
+    static bool canAnswer(const VSearchToken &p_token);
+
+private:
+    struct FileEntry
+    {
+        FileEntry()
+            : m_modifiedTime(0),
+              m_alive(false)
+        {
+        }
+
+        // Path relative to the root path.
+        QString m_path;
+
+        // Last modified time in msecs since epoch when indexed.
+        qint64 m_modifiedTime;
+
+        bool m_alive;
+    };
+
+    QString relativePath(const QString &p_filePath) const;
+
+    void updateFileInternal(const QString &p_relativePath,
+                            const QString &p_content,
+                            qint64 p_modifiedTime);
+
+    void removeFileInternal(const QString &p_relativePath);
+
+    // Drop dead entries and remap Ids.
+    void compact();
+
+    // Return the Ids of files containing all the trigrams of @p_keyword.
+    QSet<int> lookup(const QString &p_keyword) const;
+
+    static void collectTrigrams(const QString &p_text, QSet<quint64> &p_trigrams);
+
+    static quint64 trigramKey(QChar p_a, QChar p_b, QChar p_c);
+
+    QString m_rootPath;
+
+    QString m_indexFile;
+
+    QVector<FileEntry> m_files;
+
+    // Relative path -> index in m_files.
+    QHash<QString, int> m_pathToId;
+
+    // Trigram -> ascending list of file Ids.
+    QHash<quint64, QVector<int>> m_postings;
+
+    int m_deadFiles;
+
+    bool m_dirty;
+
+    mutable QMutex m_mutex;
+};
+
+inline const QString &VSearchIndex::getRootPath() const
+{
+    return m_rootPath;
+}
+
+
+// Manage the search index of each notebook.
+// Should be accessed only in the GUI thread.
+class VSearchIndexManager
+{
+public:
+    // Get the index of the notebook containing @p_filePath.
+    // Load it from disk if needed. Return null if @p_filePath is not within
+    // any notebook.
+    static QSharedPointer<VSearchIndex> indexForFile(const QString &p_filePath);
+
+    // Update the index if it is loaded.
+    static void fileSaved(const VNotebook *p_notebook,
+                          const QString &p_filePath,
+                          const QString &p_content);
+
+    static void fileRenamed(const VNotebook *p_notebook,
+                            const QString &p_oldPath,
+                            const QString &p_newPath);
+
+    static void fileDeleted(const VNotebook *p_notebook, const QString &p_filePath);
+
+    // Refresh the indexed ones of @p_filePaths which may be changed by others.
+    static void filesChangedOnDisk(const VNotebook *p_notebook, const QStringList &p_filePaths);
+
+    // Write all the dirty indexes to disk.
+    static void saveAll();
+
+private:
+    VSearchIndexManager() {}
+
+    static VSearchIndexManager *inst();
+
+    QSharedPointer<VSearchIndex> loadedIndex(const VNotebook *p_notebook) const;
+
+    static QString indexFilePath(const QString &p_rootPath);
+
+    // Notebook path -> index.
+    QHash<QString, QSharedPointer<VSearchIndex>> m_indexes;
+};
+
+#endif // VSEARCHINDEX_H
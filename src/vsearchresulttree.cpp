@@ -2,6 +2,11 @@
 
 #include <QAction>
 #include <QMenu>
+#include <QFile>
+#include <QTextStream>
+#include <QHash>
+#include <QTimer>
+#include <QHeaderView>
 
 #include "utils/vutils.h"
 #include "utils/viconutils.h"
@@ -14,61 +19,185 @@
 #include "vuniversalentry.h"
 #include "vsearchue.h"
 #include "vconstants.h"
+#include "vmemorystats.h"
+#include "vnoteprefetcher.h"
 
 extern VNote *g_vnote;
 
 extern VMainWindow *g_mainWin;
 
+// Whether the match rows of a top-level item have been created.
+#define MATCHES_CREATED_ROLE (Qt::UserRole + 1)
+
+// Max number of top-level items appended at one time.
+#define APPEND_BATCH_SIZE 500
+
+// Interval in ms to append the pending items.
+#define APPEND_INTERVAL 100
+
+// Read the lines of the matches of @p_item from the file. Truncated matches
+// are read by their offsets if known, or by their line numbers.
+static QStringList readFullLines(const VSearchResultItem &p_item)
+{
+    const QList<VSearchResultSubItem> &matches = p_item.m_matches;
+    QStringList lines;
+    QFile file(p_item.m_path);
+    bool opened = file.open(QIODevice::ReadOnly);
+
+    // Line number -> index in @lines.
+    QMultiHash<int, int> byNumber;
+    for (int i = 0; i < matches.size(); ++i) {
+        const VSearchResultSubItem &ma = matches[i];
+        lines.append(ma.m_text);
+        if (!ma.m_truncated || !opened) {
+            continue;
+        }
+
+        if (ma.m_offset >= 0 && file.seek(ma.m_offset)) {
+            lines[i] = QString::fromUtf8(file.read(ma.m_length));
+        } else {
+            byNumber.insert(ma.m_lineNumber, i);
+        }
+    }
+
+    if (!byNumber.isEmpty() && file.seek(0)) {
+        QTextStream in(&file);
+        int remaining = byNumber.size();
+        for (int num = 1; remaining > 0 && !in.atEnd(); ++num) {
+            QString line = in.readLine();
+            for (auto it = byNumber.find(num); it != byNumber.end() && it.key() == num; ++it) {
+                lines[it.value()] = line;
+                --remaining;
+            }
+        }
+    }
+
+    return lines;
+}
+
 VSearchResultTree::VSearchResultTree(QWidget *p_parent)
     : VTreeWidget(p_parent)
 {
-    setColumnCount(1);
+    // Name and number of matches.
+    setColumnCount(2);
     setHeaderHidden(true);
+    header()->setStretchLastSection(false);
+    header()->setSectionResizeMode(0, QHeaderView::Stretch);
+    header()->setSectionResizeMode(1, QHeaderView::ResizeToContents);
     setExpandsOnDoubleClick(false);
     setContextMenuPolicy(Qt::CustomContextMenu);
     setSelectionMode(QAbstractItemView::ExtendedSelection);
 
     setSimpleSearchMatchFlags(getSimpleSearchMatchFlags() & ~Qt::MatchRecursive);
 
+    VMemoryStats::registerGlobal(this, "Search results", [this]() {
+        return approximateBytes();
+    });
+
     m_noteIcon = VIconUtils::treeViewIcon(":/resources/icons/note_item.svg");
     m_folderIcon = VIconUtils::treeViewIcon(":/resources/icons/dir_item.svg");
     m_notebookIcon = VIconUtils::treeViewIcon(":/resources/icons/notebook_item.svg");
 
+    m_appendTimer = new QTimer(this);
+    m_appendTimer->setSingleShot(true);
+    m_appendTimer->setInterval(APPEND_INTERVAL);
+    connect(m_appendTimer, &QTimer::timeout,
+            this, &VSearchResultTree::appendPendingItems);
+
     connect(this, &VTreeWidget::itemActivated,
             this, &VSearchResultTree::activateItem);
+    connect(this, &VTreeWidget::currentItemChanged,
+            this, [this](QTreeWidgetItem *p_cur, QTreeWidgetItem *p_pre) {
+                Q_UNUSED(p_pre);
+                if (!p_cur) {
+                    return;
+                }
+
+                const QSharedPointer<VSearchResultItem> &data = itemResultData(p_cur);
+                if (data->m_type == VSearchResultItem::Note) {
+                    VNotePrefetcher::inst()->prefetch(data->m_path);
+                }
+            });
     connect(this, &VTreeWidget::customContextMenuRequested,
             this, &VSearchResultTree::handleContextMenuRequested);
+    connect(this, &VTreeWidget::itemExpanded,
+            this, &VSearchResultTree::handleItemExpanded);
 }
 
 void VSearchResultTree::updateResults(const QList<QSharedPointer<VSearchResultItem> > &p_items)
 {
     clearResults();
 
+    setUpdatesEnabled(false);
     for (auto const & it : p_items) {
         appendItem(it);
     }
 
+    setUpdatesEnabled(true);
+
     emit countChanged(topLevelItemCount());
 }
 
 void VSearchResultTree::addResultItem(const QSharedPointer<VSearchResultItem> &p_item)
 {
-    appendItem(p_item);
-
-    emit countChanged(topLevelItemCount());
+    m_pendingItems.append(p_item);
+    schedulePendingItems();
 }
 
 void VSearchResultTree::addResultItems(const QList<QSharedPointer<VSearchResultItem> > &p_items)
 {
-    for (auto const & it : p_items) {
-        appendItem(it);
+    m_pendingItems.append(p_items);
+    schedulePendingItems();
+}
+
+void VSearchResultTree::schedulePendingItems()
+{
+    if (!m_appendTimer->isActive()) {
+        m_appendTimer->start();
     }
 
-    emit countChanged(topLevelItemCount());
+    emit countChanged(m_data.size() + m_pendingItems.size());
+}
+
+void VSearchResultTree::appendPendingItems()
+{
+    int cnt = qMin(m_pendingItems.size(), APPEND_BATCH_SIZE);
+    if (cnt == 0) {
+        return;
+    }
+
+    setUpdatesEnabled(false);
+    for (int i = 0; i < cnt; ++i) {
+        appendItem(m_pendingItems[i]);
+    }
+
+    setUpdatesEnabled(true);
+
+    m_pendingItems.erase(m_pendingItems.begin(), m_pendingItems.begin() + cnt);
+    if (!m_pendingItems.isEmpty()) {
+        m_appendTimer->start();
+    }
+}
+
+qint64 VSearchResultTree::approximateBytes() const
+{
+    qint64 bytes = 0;
+    for (auto const & item : m_data) {
+        bytes += item->approximateBytes();
+    }
+
+    for (auto const & item : m_pendingItems) {
+        bytes += item->approximateBytes();
+    }
+
+    return bytes;
 }
 
 void VSearchResultTree::clearResults()
 {
+    m_appendTimer->stop();
+    m_pendingItems.clear();
+
     clearAll();
 
     m_data.clear();
@@ -110,17 +239,63 @@ void VSearchResultTree::appendItem(const QSharedPointer<VSearchResultItem> &p_it
         break;
     }
 
-    for (auto const & it: p_item->m_matches) {
-        QTreeWidgetItem *subItem = new QTreeWidgetItem(item);
+    // Rows of the matches are created when it is expanded.
+    if (!p_item->m_matches.isEmpty()) {
+        item->setText(1, QString::number(p_item->m_matches.size()));
+        item->setTextAlignment(1, Qt::AlignRight | Qt::AlignVCenter);
+        item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    }
+}
+
+void VSearchResultTree::createMatchItems(QTreeWidgetItem *p_item)
+{
+    if (p_item->data(0, MATCHES_CREATED_ROLE).toBool()) {
+        return;
+    }
+
+    p_item->setData(0, MATCHES_CREATED_ROLE, true);
+
+    const QSharedPointer<VSearchResultItem> &data = itemResultData(p_item);
+    const QList<VSearchResultSubItem> &matches = data->m_matches;
+
+    bool truncated = false;
+    for (auto const & ma : matches) {
+        if (ma.m_truncated) {
+            truncated = true;
+            break;
+        }
+    }
+
+    // The full lines are held only by the tool tips, which are dropped with the items.
+    QStringList lines;
+    if (truncated) {
+        lines = readFullLines(*data);
+    }
+
+    QList<QTreeWidgetItem *> subItems;
+    subItems.reserve(matches.size());
+    for (int i = 0; i < matches.size(); ++i) {
+        const VSearchResultSubItem &ma = matches[i];
+        QTreeWidgetItem *subItem = new QTreeWidgetItem();
         QString text;
-        if (it.m_lineNumber > -1) {
-            text = QString("[%1] %2").arg(it.m_lineNumber).arg(it.m_text);
+        if (ma.m_lineNumber > -1) {
+            text = QString("[%1] %2").arg(ma.m_lineNumber).arg(ma.m_text);
         } else {
-            text = it.m_text;
+            text = ma.m_text;
         }
 
         subItem->setText(0, text);
-        subItem->setToolTip(0, it.m_text);
+        subItem->setToolTip(0, i < lines.size() ? lines[i] : ma.m_text);
+        subItems.append(subItem);
+    }
+
+    p_item->addChildren(subItems);
+}
+
+void VSearchResultTree::handleItemExpanded(QTreeWidgetItem *p_item)
+{
+    if (!p_item->parent()) {
+        createMatchItems(p_item);
     }
 }
 
@@ -222,15 +397,18 @@ void VSearchResultTree::addSelectedItemsToCart()
     QList<QTreeWidgetItem *> items = selectedItems();
     VCart *cart = g_mainWin->getCart();
 
-    int nrAdded = 0;
+    QStringList files;
     for (int i = 0; i < items.size(); ++i) {
         const QSharedPointer<VSearchResultItem> &resItem = itemResultData(items[i]);
         if (resItem->m_type == VSearchResultItem::Note) {
-            cart->addFile(resItem->m_path);
-            ++nrAdded;
+            files << resItem->m_path;
         }
     }
 
+    cart->addFiles(files);
+
+    int nrAdded = files.size();
+
     if (nrAdded) {
         g_mainWin->showStatusMessage(tr("%1 %2 added to Cart")
                                        .arg(nrAdded)
@@ -2,11 +2,14 @@
 #define VSEARCHRESULTTREE_H
 
 #include <QIcon>
+#include <QList>
 
 #include "vtreewidget.h"
 #include "vsearch.h"
 
 
+class QTimer;
+
 class VSearchResultTree : public VTreeWidget
 {
     Q_OBJECT
@@ -17,6 +20,9 @@ public:
 
     void clearResults();
 
+    // Bytes held by the results.
+    qint64 approximateBytes() const;
+
 public slots:
     void addResultItem(const QSharedPointer<VSearchResultItem> &p_item);
 
@@ -36,9 +42,19 @@ private slots:
 
     void pinSelectedItemsToHistory();
 
+    void handleItemExpanded(QTreeWidgetItem *p_item);
+
+    // Append one batch of the pending items.
+    void appendPendingItems();
+
 private:
     void appendItem(const QSharedPointer<VSearchResultItem> &p_item);
 
+    // Create the rows of the matches of top-level item @p_item.
+    void createMatchItems(QTreeWidgetItem *p_item);
+
+    void schedulePendingItems();
+
     VSearchResultItem::ItemType itemResultType(const QTreeWidgetItem *p_item) const;
 
     void activateItem(const QTreeWidgetItem *p_item) const;
@@ -47,6 +63,11 @@ private:
 
     QVector<QSharedPointer<VSearchResultItem> > m_data;
 
+    // Items to append in batches by m_appendTimer.
+    QList<QSharedPointer<VSearchResultItem> > m_pendingItems;
+
+    QTimer *m_appendTimer;
+
     QIcon m_noteIcon;
     QIcon m_folderIcon;
     QIcon m_notebookIcon;
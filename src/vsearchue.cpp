@@ -2,6 +2,11 @@
 
 #include <QDebug>
 #include <QVector>
+#include <QHash>
+#include <QDir>
+#include <QLinkedList>
+
+#include <algorithm>
 
 #include "vlistwidgetdoublerows.h"
 #include "vtreewidget.h"
@@ -19,6 +24,9 @@
 #include "vexplorer.h"
 #include "vuniversalentry.h"
 #include "vconfigmanager.h"
+#include "vpathindex.h"
+#include "vhistorylist.h"
+#include "vmemorystats.h"
 
 extern VNote *g_vnote;
 
@@ -28,14 +36,40 @@ extern VConfigManager *g_config;
 
 #define ITEM_NUM_TO_UPDATE_WIDGET 20
 
+// Generation of the command which produced the item.
+#define GENERATION_ROLE (Qt::UserRole + 1)
+
+// Key of the item to diff against.
+#define KEY_ROLE (Qt::UserRole + 2)
+
+// Number of the best results to show at a time.
+#define MAX_SHOWN_ITEMS 100
+
+// Max number of the best matches from the path index to show.
+#define MAX_PATH_INDEX_MATCHES 200
+
 VSearchUE::VSearchUE(QObject *p_parent)
     : IUniversalEntry(p_parent),
       m_search(NULL),
       m_inSearch(false),
       m_id(ID::Name_Notebook_AllNotebook),
+      m_generation(0),
+      m_shownCount(MAX_SHOWN_ITEMS),
       m_listWidget(NULL),
       m_treeWidget(NULL)
 {
+    VMemoryStats::registerGlobal(this, "Universal entry search results", [this]() {
+        qint64 bytes = 0;
+        for (auto const & item : m_data) {
+            bytes += item->approximateBytes();
+        }
+
+        for (auto const & item : m_staleData) {
+            bytes += item->approximateBytes();
+        }
+
+        return bytes;
+    });
 }
 
 QString VSearchUE::description(int p_id) const
@@ -105,18 +139,17 @@ void VSearchUE::init()
 
     m_initialized = true;
 
-    m_search = new VSearch(this);
-    connect(m_search, &VSearch::resultItemAdded,
-            this, &VSearchUE::handleSearchItemAdded);
-    connect(m_search, &VSearch::resultItemsAdded,
-            this, &VSearchUE::handleSearchItemsAdded);
-    connect(m_search, &VSearch::finished,
-            this, &VSearchUE::handleSearchFinished);
+    m_search = createSearch();
 
     m_noteIcon = VIconUtils::treeViewIcon(":/resources/icons/note_item.svg");
     m_folderIcon = VIconUtils::treeViewIcon(":/resources/icons/dir_item.svg");
     m_notebookIcon = VIconUtils::treeViewIcon(":/resources/icons/notebook_item.svg");
 
+    // Start indexing the paths in background for name searches.
+    for (auto const & nb : g_vnote->getNotebooks()) {
+        VPathIndex::inst()->isReady(nb);
+    }
+
     m_listWidget = new VListWidgetDoubleRows(m_widgetParent);
     m_listWidget->setFitContent(true);
     m_listWidget->hide();
@@ -172,7 +205,24 @@ void VSearchUE::processCommand(int p_id, const QString &p_cmd)
 
     init();
 
-    clear(-1);
+    abandonSearch();
+
+    // Keep the items of last command to diff the new results against.
+    removeStaleItems();
+    if (widget(p_id) == m_listWidget) {
+        m_treeWidget->clearAll();
+    } else {
+        m_listWidget->clearAll();
+    }
+
+    m_staleData = m_data;
+    m_data.clear();
+    m_scores.clear();
+    m_topItems.clear();
+    m_shownCount = MAX_SHOWN_ITEMS;
+    ++m_generation;
+
+    updateRanking(p_cmd);
 
     m_inSearch = true;
     m_id = p_id;
@@ -254,6 +304,7 @@ void VSearchUE::updateWidget()
 {
     QWidget *wid = widget(m_id);
     if (wid == m_treeWidget) {
+        diffItemsIntoTree(!m_inSearch);
         if (m_treeWidget->topLevelItemCount() > 0) {
             m_treeWidget->resizeColumnToContents(0);
         } else {
@@ -261,6 +312,8 @@ void VSearchUE::updateWidget()
             m_treeWidget->resizeColumnToContents(0);
             delete item;
         }
+    } else {
+        diffItemsIntoList(!m_inSearch);
     }
 
     wid->updateGeometry();
@@ -299,12 +352,45 @@ void VSearchUE::searchNameOfAllNotebooks(const QString &p_cmd)
     }
 }
 
+bool VSearchUE::searchFolderNoteViaPathIndex(const QVector<VNotebook *> &p_notebooks,
+                                             const QString &p_cmd,
+                                             bool p_path)
+{
+    QVector<VPathIndex::Match> matches;
+    if (!VPathIndex::inst()->search(p_notebooks,
+                                    p_cmd,
+                                    p_path,
+                                    MAX_PATH_INDEX_MATCHES,
+                                    matches)) {
+        return false;
+    }
+
+    // Matches are the best first, which is kept among items of the same rank.
+    QList<QSharedPointer<VSearchResultItem> > items;
+    for (auto const & match : matches) {
+        VSearchResultItem::ItemType type = match.m_isFolder ? VSearchResultItem::Folder
+                                                            : VSearchResultItem::Note;
+        items.append(QSharedPointer<VSearchResultItem>(new VSearchResultItem(type,
+                                                                             VSearchResultItem::LineNumber,
+                                                                             match.m_name,
+                                                                             match.m_path)));
+    }
+
+    if (!items.isEmpty()) {
+        handleSearchItemsAdded(items);
+    }
+
+    m_inSearch = false;
+    emit stateUpdated(State::Success);
+    return true;
+}
+
 void VSearchUE::searchNameOfFolderNoteInAllNotebooks(const QString &p_cmd)
 {
     if (p_cmd.isEmpty()) {
         m_inSearch = false;
         emit stateUpdated(State::Success);
-    } else {
+    } else if (!searchFolderNoteViaPathIndex(g_vnote->getNotebooks(), p_cmd, false)) {
         m_search->clear();
         QSharedPointer<VSearchConfig> config(new VSearchConfig(VSearchConfig::AllNotebooks,
                                                                VSearchConfig::Name,
@@ -397,19 +483,29 @@ void VSearchUE::searchContentOfNoteInAllNotebooks(const QString &p_cmd)
                                                                p_cmd,
                                                                QString()));
         m_search->setConfig(config);
-        QSharedPointer<VSearchResult> result = m_search->search(g_vnote->getNotebooks());
+
+        QStringList paths;
+        for (auto const & nb : g_vnote->getNotebooks()) {
+            paths.append(nb->getPath());
+        }
+
+        QSharedPointer<VSearchResult> result = refineContentSearch(config, paths.join('\n'));
+        if (!result) {
+            result = m_search->search(g_vnote->getNotebooks());
+        }
+
         handleSearchFinished(result);
     }
 }
 
 void VSearchUE::searchNameOfFolderNoteInCurrentNotebook(const QString &p_cmd)
 {
+    QVector<VNotebook *> notebooks;
+    notebooks.append(g_mainWin->getNotebookSelector()->currentNotebook());
     if (p_cmd.isEmpty()) {
         m_inSearch = false;
         emit stateUpdated(State::Success);
-    } else {
-        QVector<VNotebook *> notebooks;
-        notebooks.append(g_mainWin->getNotebookSelector()->currentNotebook());
+    } else if (!searchFolderNoteViaPathIndex(notebooks, p_cmd, false)) {
         m_search->clear();
         QSharedPointer<VSearchConfig> config(new VSearchConfig(VSearchConfig::CurrentNotebook,
                                                                VSearchConfig::Name,
@@ -441,7 +537,12 @@ void VSearchUE::searchContentOfNoteInCurrentNotebook(const QString &p_cmd)
                                                                p_cmd,
                                                                QString()));
         m_search->setConfig(config);
-        QSharedPointer<VSearchResult> result = m_search->search(notebooks);
+        QString scopeKey = notebooks[0] ? notebooks[0]->getPath() : QString();
+        QSharedPointer<VSearchResult> result = refineContentSearch(config, scopeKey);
+        if (!result) {
+            result = m_search->search(notebooks);
+        }
+
         handleSearchFinished(result);
     }
 }
@@ -483,7 +584,12 @@ void VSearchUE::searchContentOfNoteInCurrentFolder(const QString &p_cmd)
                                                                p_cmd,
                                                                QString()));
         m_search->setConfig(config);
-        QSharedPointer<VSearchResult> result = m_search->search(dir);
+        QString scopeKey = dir ? dir->fetchPath() : QString();
+        QSharedPointer<VSearchResult> result = refineContentSearch(config, scopeKey);
+        if (!result) {
+            result = m_search->search(dir);
+        }
+
         handleSearchFinished(result);
     }
 }
@@ -504,7 +610,11 @@ void VSearchUE::searchContentOfNoteInExplorerDirectory(const QString &p_cmd)
                                                                p_cmd,
                                                                QString()));
         m_search->setConfig(config);
-        QSharedPointer<VSearchResult> result = m_search->search(rootDirectory);
+        QSharedPointer<VSearchResult> result = refineContentSearch(config, rootDirectory);
+        if (!result) {
+            result = m_search->search(rootDirectory);
+        }
+
         handleSearchFinished(result);
     }
 }
@@ -596,7 +706,7 @@ void VSearchUE::searchPathOfFolderNoteInAllNotebooks(const QString &p_cmd)
     if (p_cmd.isEmpty()) {
         m_inSearch = false;
         emit stateUpdated(State::Success);
-    } else {
+    } else if (!searchFolderNoteViaPathIndex(g_vnote->getNotebooks(), p_cmd, true)) {
         m_search->clear();
         QSharedPointer<VSearchConfig> config(new VSearchConfig(VSearchConfig::AllNotebooks,
                                                                VSearchConfig::Path,
@@ -613,12 +723,12 @@ void VSearchUE::searchPathOfFolderNoteInAllNotebooks(const QString &p_cmd)
 
 void VSearchUE::searchPathOfFolderNoteInCurrentNotebook(const QString &p_cmd)
 {
+    QVector<VNotebook *> notebooks;
+    notebooks.append(g_mainWin->getNotebookSelector()->currentNotebook());
     if (p_cmd.isEmpty()) {
         m_inSearch = false;
         emit stateUpdated(State::Success);
-    } else {
-        QVector<VNotebook *> notebooks;
-        notebooks.append(g_mainWin->getNotebookSelector()->currentNotebook());
+    } else if (!searchFolderNoteViaPathIndex(notebooks, p_cmd, true)) {
         m_search->clear();
         QSharedPointer<VSearchConfig> config(new VSearchConfig(VSearchConfig::CurrentNotebook,
                                                                VSearchConfig::Path,
@@ -636,9 +746,12 @@ void VSearchUE::searchPathOfFolderNoteInCurrentNotebook(const QString &p_cmd)
 void VSearchUE::clear(int p_id)
 {
     Q_UNUSED(p_id);
-    stopSearch();
+    abandonSearch();
 
     m_data.clear();
+    m_staleData.clear();
+    m_scores.clear();
+    m_topItems.clear();
     m_listWidget->clearAll();
     m_treeWidget->clearAll();
 }
@@ -661,9 +774,10 @@ void VSearchUE::handleSearchItemAdded(const QSharedPointer<VSearchResultItem> &p
     case ID::Name_Note_Buffer:
     case ID::Path_FolderNote_AllNotebook:
     case ID::Path_FolderNote_CurrentNotebook:
-        appendItemToList(p_item);
+        addResultItem(p_item);
         if (itemAdded > 50) {
             itemAdded = 0;
+            diffItemsIntoList(false);
             m_listWidget->updateGeometry();
             emit widgetUpdated();
         }
@@ -676,9 +790,10 @@ void VSearchUE::handleSearchItemAdded(const QSharedPointer<VSearchResultItem> &p
     case ID::Content_Note_ExplorerDirectory:
     case ID::Content_Note_Buffer:
     case ID::Outline_Note_Buffer:
-        appendItemToTree(p_item);
+        addResultItem(p_item);
         if (itemAdded > 50) {
             itemAdded = 0;
+            diffItemsIntoTree(false);
             m_treeWidget->resizeColumnToContents(0);
             m_treeWidget->updateGeometry();
             emit widgetUpdated();
@@ -708,9 +823,10 @@ void VSearchUE::handleSearchItemsAdded(const QList<QSharedPointer<VSearchResultI
     case ID::Path_FolderNote_CurrentNotebook:
     {
         for (auto const & it : p_items) {
-            appendItemToList(it);
+            addResultItem(it);
         }
 
+        diffItemsIntoList(false);
         m_listWidget->updateGeometry();
         emit widgetUpdated();
         break;
@@ -724,9 +840,10 @@ void VSearchUE::handleSearchItemsAdded(const QList<QSharedPointer<VSearchResultI
     case ID::Outline_Note_Buffer:
     {
         for (auto const & it : p_items) {
-            appendItemToTree(it);
+            addResultItem(it);
         }
 
+        diffItemsIntoTree(false);
         m_treeWidget->resizeColumnToContents(0);
         m_treeWidget->updateGeometry();
         emit widgetUpdated();
@@ -738,28 +855,215 @@ void VSearchUE::handleSearchItemsAdded(const QList<QSharedPointer<VSearchResultI
     }
 }
 
-void VSearchUE::appendItemToList(const QSharedPointer<VSearchResultItem> &p_item)
+QString VSearchUE::itemKey(const VSearchResultItem &p_item)
+{
+    return QString("%1\n%2\n%3").arg((int)p_item.m_type).arg(p_item.m_path).arg(p_item.m_text);
+}
+
+void VSearchUE::updateRanking(const QString &p_cmd)
+{
+    m_keywords.clear();
+    const QStringList words = p_cmd.split(QRegExp("\\s+"), QString::SkipEmptyParts);
+    for (auto const & word : words) {
+        if (word == "&&" || word == "||" || word.startsWith('\\')) {
+            continue;
+        }
+
+        m_keywords << word;
+    }
+
+    // The later in history, the more recent.
+    m_recency.clear();
+    const QLinkedList<VHistoryEntry> &histories = g_mainWin->getHistoryList()->getHistoryEntries();
+    int rank = 0;
+    for (auto const & entry : histories) {
+        m_recency.insert(QDir::cleanPath(entry.m_file), ++rank);
+    }
+}
+
+int VSearchUE::itemScore(const VSearchResultItem &p_item) const
+{
+    QString name = p_item.m_text.isEmpty() ? VUtils::fileNameFromPath(p_item.m_path)
+                                           : p_item.m_text;
+    int quality = 0;
+    for (auto const & kw : m_keywords) {
+        if (name.compare(kw, Qt::CaseInsensitive) == 0) {
+            quality += 3;
+        } else if (name.startsWith(kw, Qt::CaseInsensitive)) {
+            quality += 2;
+        } else if (name.contains(kw, Qt::CaseInsensitive)) {
+            quality += 1;
+        }
+    }
+
+    int recency = qMin(m_recency.value(QDir::cleanPath(p_item.m_path), 0), 999);
+    int matches = qMin(p_item.m_matches.size(), 999);
+
+    // Name match quality first, then recency and number of matches.
+    return quality * 1000000 + recency * 1000 + matches;
+}
+
+bool VSearchUE::isBetterItem(int p_idx1, int p_idx2) const
+{
+    if (m_scores[p_idx1] != m_scores[p_idx2]) {
+        return m_scores[p_idx1] > m_scores[p_idx2];
+    }
+
+    return p_idx1 < p_idx2;
+}
+
+void VSearchUE::addResultItem(const QSharedPointer<VSearchResultItem> &p_item)
 {
     m_data.append(p_item);
+    m_scores.append(itemScore(*p_item));
+    rankItem(m_data.size() - 1);
 
+    m_refiner.addResultItem(p_item);
+}
+
+void VSearchUE::rankItem(int p_idx)
+{
+    // A heap with the worst of the shown items at the top.
+    auto better = [this](int p_a, int p_b) {
+        return isBetterItem(p_a, p_b);
+    };
+
+    if (m_topItems.size() < m_shownCount) {
+        m_topItems.append(p_idx);
+        std::push_heap(m_topItems.begin(), m_topItems.end(), better);
+    } else if (!m_topItems.isEmpty() && isBetterItem(p_idx, m_topItems.first())) {
+        std::pop_heap(m_topItems.begin(), m_topItems.end(), better);
+        m_topItems.last() = p_idx;
+        std::push_heap(m_topItems.begin(), m_topItems.end(), better);
+    }
+}
+
+QVector<int> VSearchUE::shownItems() const
+{
+    QVector<int> items = m_topItems;
+    std::sort(items.begin(), items.end(), [this](int p_a, int p_b) {
+        return isBetterItem(p_a, p_b);
+    });
+
+    return items;
+}
+
+void VSearchUE::loadMoreItems()
+{
+    m_shownCount += MAX_SHOWN_ITEMS;
+
+    m_topItems.clear();
+    for (int i = 0; i < m_data.size(); ++i) {
+        rankItem(i);
+    }
+
+    updateWidget();
+}
+
+bool VSearchUE::isLoadMoreItem(const QListWidgetItem *p_item)
+{
+    return p_item->data(Qt::UserRole).toInt() < 0;
+}
+
+bool VSearchUE::isLoadMoreItem(const QTreeWidgetItem *p_item)
+{
+    return VTreeWidget::topLevelTreeItem(p_item)->data(0, Qt::UserRole).toInt() < 0;
+}
+
+void VSearchUE::removeStaleItems()
+{
+    for (int i = m_listWidget->count() - 1; i >= 0; --i) {
+        if (m_listWidget->item(i)->data(GENERATION_ROLE).toInt() != m_generation) {
+            m_listWidget->removeDoubleRowsItem(i);
+        }
+    }
+
+    for (int i = m_treeWidget->topLevelItemCount() - 1; i >= 0; --i) {
+        if (m_treeWidget->topLevelItem(i)->data(0, GENERATION_ROLE).toInt() != m_generation) {
+            delete m_treeWidget->takeTopLevelItem(i);
+        }
+    }
+
+    m_staleData.clear();
+}
+
+void VSearchUE::diffItemsIntoList(bool p_final)
+{
+    // We put notebook and folder before note.
+    QVector<int> order = shownItems();
+    std::stable_partition(order.begin(), order.end(), [this](int p_idx) {
+        return m_data[p_idx]->m_type != VSearchResultItem::Note;
+    });
+
+    QHash<QString, QListWidgetItem *> items;
+    int cnt = m_listWidget->count();
+    items.reserve(cnt);
+    for (int i = cnt - 1; i >= 0; --i) {
+        QListWidgetItem *item = m_listWidget->item(i);
+        if (isLoadMoreItem(item)) {
+            m_listWidget->removeDoubleRowsItem(i);
+        } else {
+            items.insert(item->data(KEY_ROLE).toString(), item);
+        }
+    }
+
+    QListWidgetItem *firstItem = m_listWidget->item(0);
+    for (int i = 0; i < order.size(); ++i) {
+        const VSearchResultItem &data = *m_data[order[i]];
+        QString key = itemKey(data);
+        QListWidgetItem *item = items.take(key);
+        if (!item) {
+            item = insertItemToList(i, data);
+        } else {
+            int row = m_listWidget->row(item);
+            if (row != i) {
+                m_listWidget->moveItem(row, i);
+            }
+        }
+
+        item->setData(Qt::UserRole, order[i]);
+        item->setData(GENERATION_ROLE, m_generation);
+    }
+
+    if (p_final) {
+        for (int i = m_listWidget->count() - 1; i >= order.size(); --i) {
+            m_listWidget->removeDoubleRowsItem(i);
+        }
+
+        m_staleData.clear();
+    }
+
+    if (m_data.size() > order.size()) {
+        QListWidgetItem *item = m_listWidget->insertDoubleRowsItem(order.size(),
+                                                                   QIcon(),
+                                                                   tr("Load more results (%1 left)").arg(m_data.size() - order.size()),
+                                                                   QString());
+        item->setData(Qt::UserRole, -1);
+    }
+
+    if (m_listWidget->count() > 0
+        && (m_listWidget->item(0) != firstItem || m_listWidget->currentRow() < 0)) {
+        m_listWidget->setCurrentRow(0);
+    }
+}
+
+QListWidgetItem *VSearchUE::insertItemToList(int p_row, const VSearchResultItem &p_item)
+{
     QString first, second;
-    if (p_item->m_text.isEmpty()) {
-        first = p_item->m_path;
+    if (p_item.m_text.isEmpty()) {
+        first = p_item.m_path;
     } else {
-        if (p_item->m_type != VSearchResultItem::Notebook) {
-            first = VUniversalEntry::fileNameWithDir(p_item->m_text, p_item->m_path);
+        if (p_item.m_type != VSearchResultItem::Notebook) {
+            first = VUniversalEntry::fileNameWithDir(p_item.m_text, p_item.m_path);
         } else {
-            first = p_item->m_text;
+            first = p_item.m_text;
         }
-        second = p_item->m_path;
+        second = p_item.m_path;
     }
 
     QIcon *icon = NULL;
-    // We put notebook and folder before note.
-    int row = 0;
-    switch (p_item->m_type) {
+    switch (p_item.m_type) {
     case VSearchResultItem::Note:
-        row = m_listWidget->count();
         icon = &m_noteIcon;
         break;
 
@@ -775,33 +1079,92 @@ void VSearchUE::appendItemToList(const QSharedPointer<VSearchResultItem> &p_item
         break;
     }
 
-    QListWidgetItem *item = m_listWidget->insertDoubleRowsItem(row, *icon, first, second);
-    item->setData(Qt::UserRole, m_data.size() - 1);
-    item->setToolTip(p_item->m_path);
+    QListWidgetItem *item = m_listWidget->insertDoubleRowsItem(p_row,
+                                                               icon ? *icon : QIcon(),
+                                                               first,
+                                                               second);
+    item->setData(KEY_ROLE, itemKey(p_item));
+    item->setToolTip(p_item.m_path);
+    return item;
+}
 
-    if (row == 0) {
-        m_listWidget->setCurrentRow(0);
+void VSearchUE::diffItemsIntoTree(bool p_final)
+{
+    QVector<int> order = shownItems();
+
+    QHash<QString, QTreeWidgetItem *> items;
+    int cnt = m_treeWidget->topLevelItemCount();
+    items.reserve(cnt);
+    for (int i = cnt - 1; i >= 0; --i) {
+        QTreeWidgetItem *item = m_treeWidget->topLevelItem(i);
+        if (isLoadMoreItem(item)) {
+            delete m_treeWidget->takeTopLevelItem(i);
+        } else {
+            items.insert(item->data(0, KEY_ROLE).toString(), item);
+        }
+    }
+
+    for (int i = 0; i < order.size(); ++i) {
+        const VSearchResultItem &data = *m_data[order[i]];
+        QString key = itemKey(data);
+        QTreeWidgetItem *item = items.take(key);
+        if (!item) {
+            item = insertItemToTree(i, data);
+        } else {
+            int idx = m_treeWidget->indexOfTopLevelItem(item);
+            if (idx != i) {
+                bool expanded = item->isExpanded();
+                m_treeWidget->takeTopLevelItem(idx);
+                m_treeWidget->insertTopLevelItem(i, item);
+                item->setExpanded(expanded);
+            }
+
+            if (item->data(0, GENERATION_ROLE).toInt() != m_generation) {
+                // Matches may differ from last command.
+                updateTreeItemMatches(item, data, false);
+            }
+        }
+
+        item->setData(0, Qt::UserRole, order[i]);
+        item->setData(0, GENERATION_ROLE, m_generation);
+    }
+
+    if (p_final) {
+        for (int i = m_treeWidget->topLevelItemCount() - 1; i >= order.size(); --i) {
+            delete m_treeWidget->takeTopLevelItem(i);
+        }
+
+        m_staleData.clear();
+    }
+
+    if (m_data.size() > order.size()) {
+        QTreeWidgetItem *item = new QTreeWidgetItem();
+        item->setText(0, tr("Load more results (%1 left)").arg(m_data.size() - order.size()));
+        item->setData(0, Qt::UserRole, -1);
+        m_treeWidget->insertTopLevelItem(order.size(), item);
+    }
+
+    if (!m_treeWidget->currentItem() && m_treeWidget->topLevelItemCount() > 0) {
+        m_treeWidget->setCurrentItem(m_treeWidget->topLevelItem(0));
     }
 }
 
-void VSearchUE::appendItemToTree(const QSharedPointer<VSearchResultItem> &p_item)
+QTreeWidgetItem *VSearchUE::insertItemToTree(int p_row, const VSearchResultItem &p_item)
 {
-    m_data.append(p_item);
-
-    QTreeWidgetItem *item = new QTreeWidgetItem(m_treeWidget);
-    item->setData(0, Qt::UserRole, m_data.size() - 1);
+    QTreeWidgetItem *item = new QTreeWidgetItem();
+    item->setData(0, KEY_ROLE, itemKey(p_item));
     QString text;
-    if (p_item->m_text.isEmpty()) {
-        text = p_item->m_path;
-    } else if (p_item->m_type != VSearchResultItem::Notebook) {
-        text = VUniversalEntry::fileNameWithDir(p_item->m_text, p_item->m_path);
+    if (p_item.m_text.isEmpty()) {
+        text = p_item.m_path;
+    } else if (p_item.m_type != VSearchResultItem::Notebook) {
+        text = VUniversalEntry::fileNameWithDir(p_item.m_text, p_item.m_path);
     } else {
-        text = p_item->m_text;
+        text = p_item.m_text;
     }
     item->setText(0, text);
-    item->setToolTip(0, p_item->m_path);
+    item->setToolTip(0, p_item.m_path);
 
-    switch (p_item->m_type) {
+    switch (p_item.m_type) {
     case VSearchResultItem::Note:
         item->setIcon(0, m_noteIcon);
         break;
@@ -818,21 +1181,45 @@ void VSearchUE::appendItemToTree(const QSharedPointer<VSearchResultItem> &p_item
         break;
     }
 
-    for (auto const & it: p_item->m_matches) {
-        QTreeWidgetItem *subItem = new QTreeWidgetItem(item);
-        QString text;
+    updateTreeItemMatches(item, p_item, true);
+
+    m_treeWidget->insertTopLevelItem(p_row, item);
+    return item;
+}
+
+void VSearchUE::updateTreeItemMatches(QTreeWidgetItem *p_treeItem,
+                                      const VSearchResultItem &p_item,
+                                      bool p_force)
+{
+    QStringList texts;
+    for (auto const & it : p_item.m_matches) {
         if (it.m_lineNumber > -1) {
-            text = QString("[%1] %2").arg(it.m_lineNumber).arg(it.m_text);
+            texts << QString("[%1] %2").arg(it.m_lineNumber).arg(it.m_text);
         } else {
-            text = it.m_text;
+            texts << it.m_text;
         }
+    }
 
-        subItem->setText(0, text);
-        subItem->setToolTip(0, it.m_text);
+    if (!p_force && p_treeItem->childCount() == texts.size()) {
+        bool same = true;
+        for (int i = 0; i < texts.size(); ++i) {
+            if (p_treeItem->child(i)->text(0) != texts[i]) {
+                same = false;
+                break;
+            }
+        }
+
+        if (same) {
+            return;
+        }
     }
 
-    if (!m_treeWidget->currentItem()) {
-        m_treeWidget->setCurrentItem(item);
+    qDeleteAll(p_treeItem->takeChildren());
+
+    for (int i = 0; i < texts.size(); ++i) {
+        QTreeWidgetItem *subItem = new QTreeWidgetItem(p_treeItem);
+        subItem->setText(0, texts[i]);
+        subItem->setToolTip(0, p_item.m_matches[i].m_text);
     }
 }
 
@@ -873,6 +1260,7 @@ void VSearchUE::handleSearchFinished(const QSharedPointer<VSearchResult> &p_resu
     }
 
     if (finished) {
+        m_refiner.end(p_result);
         m_search->clear();
         m_inSearch = false;
     }
@@ -882,33 +1270,74 @@ void VSearchUE::handleSearchFinished(const QSharedPointer<VSearchResult> &p_resu
     emit stateUpdated(state);
 }
 
-void VSearchUE::stopSearch()
+VSearch *VSearchUE::createSearch()
 {
-    if (m_inSearch) {
-        m_search->stop();
+    VSearch *search = new VSearch(this);
+    connect(search, &VSearch::resultItemAdded,
+            this, &VSearchUE::handleSearchItemAdded);
+    connect(search, &VSearch::resultItemsAdded,
+            this, &VSearchUE::handleSearchItemsAdded);
+    connect(search, &VSearch::finished,
+            this, &VSearchUE::handleSearchFinished);
+    return search;
+}
 
-        while (m_inSearch) {
-            VUtils::sleepWait(100);
-            qDebug() << "sleep wait for search to stop";
-        }
+void VSearchUE::abandonSearch()
+{
+    if (!m_inSearch) {
+        return;
+    }
+
+    VSearch *search = m_search;
+    disconnect(search, 0, this, 0);
+    connect(search, &VSearch::finished,
+            search, [search]() {
+                search->clear();
+                search->deleteLater();
+            });
+    search->stop();
+
+    m_search = createSearch();
+    m_inSearch = false;
+
+    m_refiner.abandon();
+}
+
+QSharedPointer<VSearchResult> VSearchUE::refineContentSearch(const QSharedPointer<VSearchConfig> &p_config,
+                                                             const QString &p_scopeKey)
+{
+    QStringList files;
+    bool refining = !p_scopeKey.isEmpty() && m_refiner.refine(*p_config, p_scopeKey, files);
+    m_refiner.begin(p_config, p_scopeKey);
+    if (!refining) {
+        return QSharedPointer<VSearchResult>();
     }
+
+    qDebug() << "refine last search within" << files.size() << "notes";
+    return m_search->refine(files);
 }
 
 const QSharedPointer<VSearchResultItem> &VSearchUE::itemResultData(const QListWidgetItem *p_item) const
 {
     Q_ASSERT(p_item);
-    int idx = p_item->data(Qt::UserRole).toInt();
-    Q_ASSERT(idx >= 0 && idx < m_data.size());
-    return m_data[idx];
+    return itemResultData(p_item->data(Qt::UserRole).toInt(),
+                          p_item->data(GENERATION_ROLE).toInt());
 }
 
 const QSharedPointer<VSearchResultItem> &VSearchUE::itemResultData(const QTreeWidgetItem *p_item) const
 {
     Q_ASSERT(p_item);
     const QTreeWidgetItem *topItem = VTreeWidget::topLevelTreeItem(p_item);
-    int idx = topItem->data(0, Qt::UserRole).toInt();
-    Q_ASSERT(idx >= 0 && idx < m_data.size());
-    return m_data[idx];
+    return itemResultData(topItem->data(0, Qt::UserRole).toInt(),
+                          topItem->data(0, GENERATION_ROLE).toInt());
+}
+
+const QSharedPointer<VSearchResultItem> &VSearchUE::itemResultData(int p_idx, int p_generation) const
+{
+    const QVector<QSharedPointer<VSearchResultItem> > &data = p_generation == m_generation ? m_data
+                                                                                           : m_staleData;
+    Q_ASSERT(p_idx >= 0 && p_idx < data.size());
+    return data[p_idx];
 }
 
 void VSearchUE::activateItem(const QSharedPointer<VSearchResultItem> &p_item, int p_matchIndex)
@@ -990,6 +1419,11 @@ void VSearchUE::activateItem(QListWidgetItem *p_item)
         return;
     }
 
+    if (isLoadMoreItem(p_item)) {
+        loadMoreItems();
+        return;
+    }
+
     emit requestHideUniversalEntry();
     activateItem(itemResultData(p_item));
 }
@@ -1001,6 +1435,11 @@ void VSearchUE::activateItem(QTreeWidgetItem *p_item, int p_col)
         return;
     }
 
+    if (isLoadMoreItem(p_item)) {
+        loadMoreItems();
+        return;
+    }
+
     emit requestHideUniversalEntry();
     activateItem(itemResultData(p_item), VTreeWidget::childIndexOfTreeItem(p_item));
 }
@@ -1158,6 +1597,10 @@ void VSearchUE::sort(int p_id)
     case ID::Path_FolderNote_CurrentNotebook:
     {
         int cnt = m_listWidget->count();
+        if (cnt > 0 && isLoadMoreItem(m_listWidget->item(cnt - 1))) {
+            --cnt;
+        }
+
         if (noteFirst) {
             int idx = cnt - 1;
             while (true) {
@@ -1211,7 +1654,7 @@ QString VSearchUE::currentItemFolder(int p_id)
     case ID::Path_FolderNote_CurrentNotebook:
     {
         QListWidgetItem *item = m_listWidget->currentItem();
-        if (item) {
+        if (item && !isLoadMoreItem(item)) {
             resItem = itemResultData(item);
         }
 
@@ -1226,7 +1669,7 @@ QString VSearchUE::currentItemFolder(int p_id)
     case ID::Outline_Note_Buffer:
     {
         QTreeWidgetItem *item = m_treeWidget->currentItem();
-        if (item) {
+        if (item && !isLoadMoreItem(item)) {
             resItem = itemResultData(item);
         }
 
@@ -4,12 +4,16 @@
 #include "iuniversalentry.h"
 
 #include <QIcon>
+#include <QHash>
+#include <QStringList>
 
 #include "vsearchconfig.h"
+#include "vsearch.h"
 
 class VListWidgetDoubleRows;
 class QListWidgetItem;
 class VTreeWidget;
+class VNotebook;
 class QTreeWidgetItem;
 
 
@@ -144,29 +148,115 @@ private:
 
     void searchPathOfFolderNoteInCurrentNotebook(const QString &p_cmd);
 
-    // Stop the search synchronously.
-    void stopSearch();
+    // Fuzzy search the names or paths of folders and notes of @p_notebooks in
+    // the path index.
+    // Returns false if the index is not ready or could not handle @p_cmd.
+    bool searchFolderNoteViaPathIndex(const QVector<VNotebook *> &p_notebooks,
+                                      const QString &p_cmd,
+                                      bool p_path);
 
-    void appendItemToList(const QSharedPointer<VSearchResultItem> &p_item);
+    VSearch *createSearch();
 
-    void appendItemToTree(const QSharedPointer<VSearchResultItem> &p_item);
+    // Search content of the notes matched by last command if @p_config in
+    // @p_scopeKey narrows it down.
+    // Returns null if it could not be refined.
+    QSharedPointer<VSearchResult> refineContentSearch(const QSharedPointer<VSearchConfig> &p_config,
+                                                      const QString &p_scopeKey);
+
+    // Ask current search to stop and leave it finishing in background without
+    // waiting for it. What it reports from now on is dropped.
+    void abandonSearch();
+
+    // Prepare the keywords and recency to rank the results of @p_cmd.
+    void updateRanking(const QString &p_cmd);
+
+    // Relevance of @p_item: name match quality, recency in history and number
+    // of matches.
+    int itemScore(const VSearchResultItem &p_item) const;
+
+    // Whether item at @p_idx1 ranks before the one at @p_idx2.
+    bool isBetterItem(int p_idx1, int p_idx2) const;
+
+    void addResultItem(const QSharedPointer<VSearchResultItem> &p_item);
+
+    // Keep the item at @p_idx if it is among the best @m_shownCount ones.
+    void rankItem(int p_idx);
+
+    // Indexes of the items to show, the best first.
+    QVector<int> shownItems() const;
+
+    // Show next MAX_SHOWN_ITEMS results.
+    void loadMoreItems();
+
+    static bool isLoadMoreItem(const QListWidgetItem *p_item);
+
+    static bool isLoadMoreItem(const QTreeWidgetItem *p_item);
+
+    // Remove the items left from the command before last one.
+    void removeStaleItems();
+
+    // Diff the results of current command into the list.
+    // Items of last command are reused if they are still in the results.
+    // @p_final: whether the results are complete, in which case the rest
+    // items of last command are removed.
+    void diffItemsIntoList(bool p_final);
+
+    void diffItemsIntoTree(bool p_final);
+
+    QListWidgetItem *insertItemToList(int p_row, const VSearchResultItem &p_item);
+
+    QTreeWidgetItem *insertItemToTree(int p_row, const VSearchResultItem &p_item);
+
+    // Update the children of @p_treeItem as the matches of @p_item.
+    void updateTreeItemMatches(QTreeWidgetItem *p_treeItem,
+                               const VSearchResultItem &p_item,
+                               bool p_force);
 
     const QSharedPointer<VSearchResultItem> &itemResultData(const QListWidgetItem *p_item) const;
 
     const QSharedPointer<VSearchResultItem> &itemResultData(const QTreeWidgetItem *p_item) const;
 
+    const QSharedPointer<VSearchResultItem> &itemResultData(int p_idx, int p_generation) const;
+
+    // Key to identify the same item between commands.
+    static QString itemKey(const VSearchResultItem &p_item);
+
     // Update geometry of widget.
     void updateWidget();
 
     VSearch *m_search;
 
+    VSearchRefiner m_refiner;
+
     bool m_inSearch;
 
     // Current instance ID.
     int m_id;
 
+    // Increased for each command. Items of the widgets are tagged with the
+    // generation of the command which produced them.
+    int m_generation;
+
     QVector<QSharedPointer<VSearchResultItem> > m_data;
 
+    // Results of last command, still referred by the items not diffed yet.
+    QVector<QSharedPointer<VSearchResultItem> > m_staleData;
+
+    // Score of each item of @m_data.
+    QVector<int> m_scores;
+
+    // Heap of indexes of the best @m_shownCount items of @m_data.
+    // Only these items are added to the widgets.
+    QVector<int> m_topItems;
+
+    int m_shownCount;
+
+    // Keywords of current command to rank the results.
+    QStringList m_keywords;
+
+    // Path -> rank in history. Larger is more recent.
+    QHash<QString, int> m_recency;
+
     QIcon m_noteIcon;
     QIcon m_folderIcon;
     QIcon m_notebookIcon;
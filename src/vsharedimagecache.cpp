@@ -0,0 +1,222 @@
+#include "vsharedimagecache.h"
+
+#include <QDebug>
+#include <QPair>
+#include <QFileInfo>
+#include <QDateTime>
+
+#include <algorithm>
+
+#include "vconfigmanager.h"
+
+extern VConfigManager *g_config;
+
+// Do not generate levels smaller than this width.
+#define MIN_LEVEL_WIDTH 64
+
+
+VSharedImageCache::VSharedImageCache()
+    : m_totalBytes(0),
+      m_clock(0)
+{
+}
+
+VSharedImageCache *VSharedImageCache::inst()
+{
+    // Never deleted to not free pixmaps after the application.
+    static VSharedImageCache *cache = new VSharedImageCache();
+    return cache;
+}
+
+QString VSharedImageCache::key(const QString &p_filePath,
+                               int p_width,
+                               int p_height,
+                               qreal p_scaleFactor)
+{
+    QFileInfo info(p_filePath);
+    QString path = info.canonicalFilePath();
+    if (path.isEmpty()) {
+        return QString();
+    }
+
+    return QString("%1_%2_%3_%4_%5").arg(info.lastModified().toMSecsSinceEpoch())
+                                    .arg(p_width)
+                                    .arg(p_height)
+                                    .arg(p_scaleFactor)
+                                    .arg(path);
+}
+
+qint64 VSharedImageCache::imageBytes(const QPixmap &p_image)
+{
+    if (p_image.isNull()) {
+        return 0;
+    }
+
+    return (qint64)p_image.width() * p_image.height() * p_image.depth() / 8;
+}
+
+bool VSharedImageCache::contains(const QString &p_key)
+{
+    return inst()->m_images.contains(p_key);
+}
+
+void VSharedImageCache::acquire(const QString &p_key,
+                                const QPixmap &p_image,
+                                const ImageLoaderFunc &p_loader)
+{
+    VSharedImageCache *cache = inst();
+    ImageEntry &entry = cache->m_images[p_key];
+    ++entry.m_refs;
+    entry.m_lastUsed = ++cache->m_clock;
+    if (entry.m_refs > 1 || p_image.isNull()) {
+        return;
+    }
+
+    entry.m_loader = p_loader;
+    entry.m_size = p_image.size();
+    cache->setImage(entry, p_image);
+
+    cache->evict(&entry);
+}
+
+void VSharedImageCache::release(const QString &p_key)
+{
+    VSharedImageCache *cache = inst();
+    auto it = cache->m_images.find(p_key);
+    if (it == cache->m_images.end()) {
+        return;
+    }
+
+    if (--it.value().m_refs > 0) {
+        return;
+    }
+
+    cache->setImage(it.value(), QPixmap());
+    cache->m_images.erase(it);
+}
+
+QSize VSharedImageCache::imageSize(const QString &p_key)
+{
+    const VSharedImageCache *cache = inst();
+    auto it = cache->m_images.find(p_key);
+    if (it != cache->m_images.end()) {
+        return it.value().m_size;
+    }
+
+    return QSize();
+}
+
+const QPixmap *VSharedImageCache::findImage(const QString &p_key, const QSize &p_targetSize)
+{
+    VSharedImageCache *cache = inst();
+    auto it = cache->m_images.find(p_key);
+    if (it == cache->m_images.end()) {
+        return NULL;
+    }
+
+    ImageEntry &entry = it.value();
+    entry.m_lastUsed = ++cache->m_clock;
+    if (entry.m_image.isNull() && entry.m_loader) {
+        QPixmap image = entry.m_loader();
+        if (image.isNull()) {
+            qWarning() << "fail to reload evicted image" << p_key;
+            return NULL;
+        }
+
+        cache->setImage(entry, image);
+
+        // Only the image content of other entries changes, so the returned
+        // pointer remains valid.
+        cache->evict(&entry);
+    }
+
+    if (entry.m_image.isNull()) {
+        return NULL;
+    }
+
+    if (p_targetSize.isEmpty()) {
+        return &entry.m_image;
+    }
+
+    qint64 addedBytes = 0;
+    const QPixmap *image = findLevel(entry.m_image, entry.m_levels, p_targetSize, addedBytes);
+    entry.m_bytes += addedBytes;
+    cache->m_totalBytes += addedBytes;
+    return image;
+}
+
+qint64 VSharedImageCache::totalBytes()
+{
+    return inst()->m_totalBytes;
+}
+
+const QPixmap *VSharedImageCache::findLevel(const QPixmap &p_image,
+                                            QVector<QPixmap> &p_levels,
+                                            const QSize &p_targetSize,
+                                            qint64 &p_addedBytes)
+{
+    p_addedBytes = 0;
+
+    const QPixmap *best = &p_image;
+    int level = 0;
+    while (true) {
+        if (best->width() / 2 < qMax(p_targetSize.width(), MIN_LEVEL_WIDTH)
+            || best->height() / 2 < p_targetSize.height()) {
+            break;
+        }
+
+        if (level == p_levels.size()) {
+            QPixmap next = best->scaled(best->width() / 2,
+                                        best->height() / 2,
+                                        Qt::IgnoreAspectRatio,
+                                        Qt::SmoothTransformation);
+            p_addedBytes += imageBytes(next);
+            p_levels.append(next);
+        }
+
+        best = &p_levels[level];
+        ++level;
+    }
+
+    return best;
+}
+
+void VSharedImageCache::setImage(ImageEntry &p_entry, const QPixmap &p_image)
+{
+    m_totalBytes -= p_entry.m_bytes;
+
+    p_entry.m_image = p_image;
+    p_entry.m_levels.clear();
+    p_entry.m_bytes = imageBytes(p_image);
+
+    m_totalBytes += p_entry.m_bytes;
+}
+
+void VSharedImageCache::evict(const ImageEntry *p_keep)
+{
+    qint64 limit = (qint64)g_config->getImageCacheSize() * 1024 * 1024;
+    if (limit <= 0 || m_totalBytes <= limit) {
+        return;
+    }
+
+    QVector<QPair<quint64, ImageEntry *>> entries;
+    for (auto it = m_images.begin(); it != m_images.end(); ++it) {
+        ImageEntry &entry = it.value();
+        if (&entry != p_keep && entry.m_loader && !entry.m_image.isNull()) {
+            entries.append(qMakePair(entry.m_lastUsed, &entry));
+        }
+    }
+
+    std::sort(entries.begin(), entries.end(),
+              [](const QPair<quint64, ImageEntry *> &p_a, const QPair<quint64, ImageEntry *> &p_b) {
+                  return p_a.first < p_b.first;
+              });
+
+    for (auto const & pa : entries) {
+        if (m_totalBytes <= limit) {
+            break;
+        }
+
+        setImage(*pa.second, QPixmap());
+    }
+}
@@ -0,0 +1,108 @@
+#ifndef VSHAREDIMAGECACHE_H
+#define VSHAREDIMAGECACHE_H
+
+#include <QHash>
+#include <QString>
+#include <QPixmap>
+#include <QSize>
+#include <QVector>
+#include <functional>
+
+// Reload an evicted image from its source.
+typedef std::function<QPixmap()> ImageLoaderFunc;
+
+// Process-wide cache of the preview images of local files, shared by the
+// editors and keyed by the canonical path, modified time and decoded size.
+// Images are referenced by the resource managers of the editors and dropped
+// once not referenced any more. Resident images are accounted by bytes
+// globally and the least recently used ones are evicted when exceeding the
+// limit, to be reloaded on demand.
+// Should be accessed only in the GUI thread.
+class VSharedImageCache
+{
+public:
+    // Key of local image @p_filePath decoded to fit @p_width x @p_height.
+    // Return empty if the file does not exist.
+    static QString key(const QString &p_filePath,
+                       int p_width,
+                       int p_height,
+                       qreal p_scaleFactor);
+
+    // Whether image @p_key is cached, resident or evicted.
+    static bool contains(const QString &p_key);
+
+    // Add a reference to image @p_key.
+    // If it is not cached yet, @p_image is added, which could be evicted and
+    // reloaded via @p_loader.
+    static void acquire(const QString &p_key,
+                        const QPixmap &p_image,
+                        const ImageLoaderFunc &p_loader);
+
+    // Drop a reference to image @p_key.
+    static void release(const QString &p_key);
+
+    // Size of image @p_key without reloading it.
+    static QSize imageSize(const QString &p_key);
+
+    // Get the image or its down-scaled level closest to @p_targetSize.
+    // Reload the image if it is evicted.
+    static const QPixmap *findImage(const QString &p_key, const QSize &p_targetSize = QSize());
+
+    // Bytes of the resident images.
+    static qint64 totalBytes();
+
+    // Get @p_image or its down-scaled level in @p_levels closest to but not
+    // smaller than @p_targetSize. Each level is half the size of the previous
+    // one and is generated on demand.
+    // @p_addedBytes: set to the bytes of the generated levels.
+    static const QPixmap *findLevel(const QPixmap &p_image,
+                                    QVector<QPixmap> &p_levels,
+                                    const QSize &p_targetSize,
+                                    qint64 &p_addedBytes);
+
+    static qint64 imageBytes(const QPixmap &p_image);
+
+private:
+    struct ImageEntry
+    {
+        ImageEntry()
+            : m_refs(0),
+              m_bytes(0),
+              m_lastUsed(0)
+        {
+        }
+
+        // Null if evicted.
+        QPixmap m_image;
+
+        QVector<QPixmap> m_levels;
+
+        QSize m_size;
+
+        ImageLoaderFunc m_loader;
+
+        int m_refs;
+
+        // Bytes of @m_image and @m_levels.
+        qint64 m_bytes;
+
+        quint64 m_lastUsed;
+    };
+
+    VSharedImageCache();
+
+    static VSharedImageCache *inst();
+
+    void setImage(ImageEntry &p_entry, const QPixmap &p_image);
+
+    // Evict least recently used images except @p_keep until within the limit.
+    void evict(const ImageEntry *p_keep);
+
+    QHash<QString, ImageEntry> m_images;
+
+    qint64 m_totalBytes;
+
+    quint64 m_clock;
+};
+
+#endif // VSHAREDIMAGECACHE_H
@@ -1,14 +1,26 @@
 #include "vsingleinstanceguard.h"
 #include <QDebug>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QDataStream>
+#include <QDir>
 
 #include "utils/vutils.h"
 
 const QString VSingleInstanceGuard::c_memKey = "vnote_shared_memory";
 const int VSingleInstanceGuard::c_magic = 19910906;
 
-VSingleInstanceGuard::VSingleInstanceGuard()
-    : m_online(false),
-      m_sharedMemory(c_memKey)
+// Timeout in ms of each operation on the socket.
+#define SOCKET_TIMEOUT 3000
+
+// Rounds to connect to the running instance, which may be still starting up.
+#define CONNECT_TRY_COUNT 20
+
+VSingleInstanceGuard::VSingleInstanceGuard(QObject *p_parent)
+    : QObject(p_parent),
+      m_online(false),
+      m_sharedMemory(c_memKey),
+      m_server(NULL)
 {
 }
 
@@ -25,14 +37,11 @@ bool VSingleInstanceGuard::tryRun()
     }
 
     // Try to create it.
-    bool ret = m_sharedMemory.create(sizeof(SharedStruct));
+    bool ret = m_sharedMemory.create(sizeof(c_magic));
     if (ret) {
         // We created it.
         m_sharedMemory.lock();
-        SharedStruct *str = (SharedStruct *)m_sharedMemory.data();
-        str->m_magic = c_magic;
-        str->m_filesBufIdx = 0;
-        str->m_askedToShow = false;
+        *(int *)m_sharedMemory.data() = c_magic;
         m_sharedMemory.unlock();
 
         m_online = true;
@@ -43,139 +52,157 @@ bool VSingleInstanceGuard::tryRun()
     }
 }
 
-void VSingleInstanceGuard::openExternalFiles(const QStringList &p_files)
+QString VSingleInstanceGuard::serverName()
 {
-    if (p_files.isEmpty()) {
-        return;
+    // Local servers of different users should not collide.
+    return c_memKey + "_" + QString::number(qHash(QDir::homePath()), 16);
+}
+
+bool VSingleInstanceGuard::startListening()
+{
+    if (!m_online || m_server) {
+        return m_server != NULL;
     }
 
-    if (!m_sharedMemory.isAttached()) {
-        if (!m_sharedMemory.attach()) {
-            qDebug() << "fail to attach to the shared memory segment"
-                     << (m_sharedMemory.error() ? m_sharedMemory.errorString() : "");
-            return;
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    connect(m_server, &QLocalServer::newConnection,
+            this, &VSingleInstanceGuard::handleNewConnection);
+
+    if (!m_server->listen(serverName())) {
+        // We own the shared memory, so the server must be left by a crash.
+        QLocalServer::removeServer(serverName());
+        if (!m_server->listen(serverName())) {
+            qWarning() << "fail to listen to other instances" << m_server->errorString();
+            delete m_server;
+            m_server = NULL;
+            return false;
         }
     }
 
-    qDebug() << "try to request another instance to open files" << p_files;
+    return true;
+}
 
-    int idx = 0;
-    int tryCount = 100;
-    while (tryCount--) {
-        qDebug() << "set shared memory one round" << idx << "of" << p_files.size();
-        m_sharedMemory.lock();
-        SharedStruct *str = (SharedStruct *)m_sharedMemory.data();
-        V_ASSERT(str->m_magic == c_magic);
-        for (; idx < p_files.size(); ++idx) {
-            if (p_files[idx].size() + 1 > FilesBufCount) {
-                qDebug() << "skip file since its long name" << p_files[idx];
-                // Skip this long long name file.
-                continue;
-            }
-
-            if (!appendFileToBuffer(str, p_files[idx])) {
-                break;
-            }
+void VSingleInstanceGuard::handleNewConnection()
+{
+    while (m_server->hasPendingConnections()) {
+        QLocalSocket *socket = m_server->nextPendingConnection();
+        connect(socket, &QLocalSocket::readyRead,
+                this, [this, socket]() {
+                    readRequests(socket);
+                });
+        connect(socket, &QLocalSocket::disconnected,
+                socket, &QObject::deleteLater);
+
+        // Data may arrive before the connection.
+        readRequests(socket);
+    }
+}
+
+void VSingleInstanceGuard::readRequests(QLocalSocket *p_socket)
+{
+    // Each request is [size][request type][files].
+    const qint64 headSize = sizeof(quint32);
+    while (p_socket->bytesAvailable() >= headSize) {
+        quint32 size = 0;
+        QDataStream head(p_socket->peek(headSize));
+        head >> size;
+        if (p_socket->bytesAvailable() < headSize + size) {
+            return;
         }
 
-        m_sharedMemory.unlock();
+        p_socket->read(headSize);
+        QByteArray data = p_socket->read(size);
+
+        qint32 req = -1;
+        QStringList files;
+        QDataStream in(data);
+        in >> req >> files;
+        if (in.status() != QDataStream::Ok) {
+            qWarning() << "invalid request from another instance";
+            p_socket->abort();
+            return;
+        }
 
-        if (idx < p_files.size()) {
-            VUtils::sleepWait(500);
-        } else {
+        switch (req) {
+        case Request::OpenFiles:
+            qDebug() << "another instance asks to open files" << files;
+            emit openFilesRequested(files);
+            break;
+
+        case Request::Show:
+            qDebug() << "another instance asks to show up";
+            emit showRequested();
+            break;
+
+        default:
+            qWarning() << "unknown request from another instance" << req;
             break;
         }
     }
 }
 
-bool VSingleInstanceGuard::appendFileToBuffer(SharedStruct *p_str, const QString &p_file)
+bool VSingleInstanceGuard::sendRequest(Request p_req, const QStringList &p_files)
 {
-    if (p_file.isEmpty()) {
-        return true;
-    }
+    QLocalSocket socket;
+    int tryCount = CONNECT_TRY_COUNT;
+    while (true) {
+        socket.connectToServer(serverName());
+        if (socket.waitForConnected(SOCKET_TIMEOUT)) {
+            break;
+        }
 
-    int strSize = p_file.size();
-    if (strSize + 1 > FilesBufCount - p_str->m_filesBufIdx) {
-        qDebug() << "no enough space for" << p_file;
-        return false;
-    }
+        if (--tryCount <= 0) {
+            qWarning() << "fail to connect to another instance" << socket.errorString();
+            return false;
+        }
 
-    // Put the size first.
-    p_str->m_filesBuf[p_str->m_filesBufIdx++] = (ushort)strSize;
-    const QChar *data = p_file.constData();
-    for (int i = 0; i < strSize; ++i) {
-        p_str->m_filesBuf[p_str->m_filesBufIdx++] = data[i].unicode();
+        // The instance may be still starting up.
+        VUtils::sleepWait(500);
     }
 
-    qDebug() << "after appended one file" << p_str->m_filesBufIdx << p_file;
-    return true;
-}
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out << (qint32)p_req << p_files;
 
-QStringList VSingleInstanceGuard::fetchFilesToOpen()
-{
-    QStringList files;
+    QByteArray buf;
+    QDataStream head(&buf, QIODevice::WriteOnly);
+    head << (quint32)data.size();
+    buf.append(data);
 
-    if (!m_online) {
-        return files;
-    }
-
-    Q_ASSERT(m_sharedMemory.isAttached());
-    m_sharedMemory.lock();
-    SharedStruct *str = (SharedStruct *)m_sharedMemory.data();
-    Q_ASSERT(str->m_magic == c_magic);
-    Q_ASSERT(str->m_filesBufIdx <= FilesBufCount);
-    int idx = 0;
-    while (idx < str->m_filesBufIdx) {
-        int strSize = str->m_filesBuf[idx++];
-        Q_ASSERT(strSize <= str->m_filesBufIdx - idx);
-        QString file;
-        for (int i = 0; i < strSize; ++i) {
-            file.append(QChar(str->m_filesBuf[idx++]));
+    socket.write(buf);
+    while (socket.bytesToWrite() > 0) {
+        if (!socket.waitForBytesWritten(SOCKET_TIMEOUT)) {
+            qWarning() << "fail to send request to another instance" << socket.errorString();
+            return false;
         }
-
-        files.append(file);
     }
 
-    str->m_filesBufIdx = 0;
-    m_sharedMemory.unlock();
+    socket.disconnectFromServer();
+    if (socket.state() != QLocalSocket::UnconnectedState) {
+        socket.waitForDisconnected(SOCKET_TIMEOUT);
+    }
 
-    return files;
+    return true;
 }
 
-void VSingleInstanceGuard::showInstance()
+void VSingleInstanceGuard::openExternalFiles(const QStringList &p_files)
 {
-    if (!m_sharedMemory.isAttached()) {
-        if (!m_sharedMemory.attach()) {
-            qDebug() << "fail to attach to the shared memory segment"
-                     << (m_sharedMemory.error() ? m_sharedMemory.errorString() : "");
-            return;
-        }
+    if (p_files.isEmpty()) {
+        return;
     }
 
-    m_sharedMemory.lock();
-    SharedStruct *str = (SharedStruct *)m_sharedMemory.data();
-    V_ASSERT(str->m_magic == c_magic);
-    str->m_askedToShow = true;
-    m_sharedMemory.unlock();
+    qDebug() << "try to request another instance to open files" << p_files;
 
-    qDebug() << "try to request another instance to show up";
+    // All the files go in one request.
+    sendRequest(Request::OpenFiles, p_files);
 }
 
-bool VSingleInstanceGuard::fetchAskedToShow()
+void VSingleInstanceGuard::showInstance()
 {
-    if (!m_online) {
-        return false;
-    }
+    qDebug() << "try to request another instance to show up";
 
-    Q_ASSERT(m_sharedMemory.isAttached());
-    m_sharedMemory.lock();
-    SharedStruct *str = (SharedStruct *)m_sharedMemory.data();
-    Q_ASSERT(str->m_magic == c_magic);
-    bool ret = str->m_askedToShow;
-    str->m_askedToShow = false;
-    m_sharedMemory.unlock();
-
-    return ret;
+    sendRequest(Request::Show);
 }
 
 void VSingleInstanceGuard::exit()
@@ -184,6 +211,12 @@ void VSingleInstanceGuard::exit()
         return;
     }
 
+    if (m_server) {
+        m_server->close();
+        delete m_server;
+        m_server = NULL;
+    }
+
     Q_ASSERT(m_sharedMemory.isAttached());
     m_sharedMemory.detach();
     m_online = false;
@@ -1,14 +1,21 @@
 #ifndef VSINGLEINSTANCEGUARD_H
 #define VSINGLEINSTANCEGUARD_H
 
+#include <QObject>
 #include <QString>
 #include <QSharedMemory>
 #include <QStringList>
 
-class VSingleInstanceGuard
+class QLocalServer;
+class QLocalSocket;
+
+// The shared memory segment tells whether there is another instance running,
+// while requests to that instance are pushed via a local socket.
+class VSingleInstanceGuard : public QObject
 {
+    Q_OBJECT
 public:
-    VSingleInstanceGuard();
+    explicit VSingleInstanceGuard(QObject *p_parent = nullptr);
 
     // Return ture if this is the only instance of VNote.
     bool tryRun();
@@ -21,45 +28,44 @@ public:
     // Ask another instance to show itself.
     void showInstance();
 
-    // Fetch files from shared memory to open.
-    // Will clear the shared memory.
-    QStringList fetchFilesToOpen();
-
-    // Whether this instance is asked to show itself.
-    bool fetchAskedToShow();
+    // Start to accept requests from other instances.
+    // Should be called after the application is created.
+    bool startListening();
 
     // A running instance requests to exit.
     void exit();
 
-private:
-    // The count of the entries in the buffer to hold the path of the files to open.
-    enum { FilesBufCount = 1024 };
-
-    struct SharedStruct {
-        // A magic number to identify if this struct is initialized
-        int m_magic;
+signals:
+    // Another instance asks this instance to open @p_files.
+    void openFilesRequested(const QStringList &p_files);
 
-        // Next empty entry in m_filesBuf.
-        int m_filesBufIdx;
+    // Another instance asks this instance to show itself.
+    void showRequested();
 
-        // File paths to be opened.
-        // Encoded in this way with 2 bytes for each size part.
-        // [size of file1][file1][size of file2][file 2]
-        // Unicode representation of QString.
-        ushort m_filesBuf[FilesBufCount];
+private slots:
+    void handleNewConnection();
 
-        // Whether other instances ask to show the legal instance.
-        bool m_askedToShow;
+private:
+    enum Request
+    {
+        OpenFiles = 0,
+        Show
     };
 
-    // Append @p_file to the shared struct files buffer.
-    // Returns true if succeeds or false if there is no enough space.
-    bool appendFileToBuffer(SharedStruct *p_str, const QString &p_file);
+    // Send one request to the running instance.
+    bool sendRequest(Request p_req, const QStringList &p_files = QStringList());
+
+    // Read all the complete requests from @p_socket.
+    void readRequests(QLocalSocket *p_socket);
+
+    static QString serverName();
 
     bool m_online;
 
     QSharedMemory m_sharedMemory;
 
+    QLocalServer *m_server;
+
     static const QString c_memKey;
     static const int c_magic;
 };
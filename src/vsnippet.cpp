@@ -2,22 +2,32 @@
 
 #include <QObject>
 #include <QDebug>
+#include <QDir>
 
 #include "vconstants.h"
 #include "utils/vutils.h"
 #include "utils/veditutils.h"
 #include "utils/vmetawordmanager.h"
+#include "vconfigmanager.h"
 
 extern VMetaWordManager *g_mwMgr;
 
+extern VConfigManager *g_config;
+
+// Max number of characters of the contents read from snippet files to cache.
+#define MAX_CONTENT_CACHE_SIZE (2 * 1024 * 1024)
+
 const QString VSnippet::c_defaultCursorMark = "@@";
 
 const QString VSnippet::c_defaultSelectionMark = "$$";
 
 QVector<QChar> VSnippet::s_allShortcuts;
 
+QCache<QString, QString> VSnippet::s_contentCache(MAX_CONTENT_CACHE_SIZE);
+
 VSnippet::VSnippet()
     : m_type(Type::PlainText),
+      m_contentLoaded(true),
       m_cursorMark(c_defaultCursorMark),
       m_autoIndent(false)
 {
@@ -33,6 +43,7 @@ VSnippet::VSnippet(const QString &p_name,
     : m_name(p_name),
       m_type(p_type),
       m_content(p_content),
+      m_contentLoaded(true),
       m_cursorMark(p_cursorMark),
       m_selectionMark(p_selectionMark),
       m_shortcut(p_shortcut),
@@ -49,22 +60,16 @@ bool VSnippet::update(const QString &p_name,
                       QChar p_shortcut,
                       bool p_autoIndent)
 {
-    bool updated = false;
-    if (m_name != p_name) {
-        m_name = p_name;
-        updated = true;
-    }
+    // The snippet file is gone if renamed.
+    bool updated = m_name != p_name || getContent() != p_content;
+    m_name = p_name;
+    setContent(p_content);
 
     if (m_type != p_type) {
         m_type = p_type;
         updated = true;
     }
 
-    if (m_content != p_content) {
-        m_content = p_content;
-        updated = true;
-    }
-
     if (m_cursorMark != p_cursorMark) {
         m_cursorMark = p_cursorMark;
         updated = true;
@@ -133,9 +138,38 @@ VSnippet VSnippet::fromJson(const QJsonObject &p_json)
                   shortcut,
                   p_json[SnippetConfig::c_autoIndent].toBool());
 
+    // Content is read from the snippet file lazily.
+    snip.m_contentLoaded = false;
     return snip;
 }
 
+QString VSnippet::getContent() const
+{
+    if (m_contentLoaded) {
+        return m_content;
+    }
+
+    QString *cached = s_contentCache.object(m_name);
+    if (cached) {
+        return *cached;
+    }
+
+    QString filePath(QDir(g_config->getSnippetConfigFolder()).filePath(m_name));
+    QString content = VUtils::readFileFromDisk(filePath);
+    if (content.isNull()) {
+        qWarning() << "fail to read snippet" << m_name;
+        return content;
+    }
+
+    s_contentCache.insert(m_name, new QString(content), content.size());
+    return content;
+}
+
+void VSnippet::invalidateContentCache(const QString &p_name)
+{
+    s_contentCache.remove(p_name);
+}
+
 const QVector<QChar> &VSnippet::getAllShortcuts()
 {
     if (s_allShortcuts.isEmpty()) {
@@ -171,7 +205,7 @@ bool VSnippet::apply(QTextCursor &p_cursor) const
     p_cursor.removeSelectedText();
 
     // Evaluate the content.
-    QString content = g_mwMgr->evaluate(m_content);
+    QString content = g_mwMgr->evaluate(getContent());
 
     if (content.isEmpty()) {
         p_cursor.endEditBlock();
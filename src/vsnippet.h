@@ -4,6 +4,7 @@
 #include <QString>
 #include <QJsonObject>
 #include <QTextCursor>
+#include <QCache>
 
 
 class VSnippet
@@ -55,10 +56,8 @@ public:
         return m_selectionMark;
     }
 
-    const QString &getContent() const
-    {
-        return m_content;
-    }
+    // Read from the snippet file on first use if not set.
+    QString getContent() const;
 
     QChar getShortcut() const
     {
@@ -73,8 +72,12 @@ public:
     void setContent(const QString &p_content)
     {
         m_content = p_content;
+        m_contentLoaded = true;
     }
 
+    // Drop the cached content of the snippet file @p_name.
+    static void invalidateContentCache(const QString &p_name);
+
     // Not including m_content.
     QJsonObject toJson() const;
 
@@ -97,8 +100,11 @@ private:
     Type m_type;
 
     // Support magic word.
+    // Only valid if @m_contentLoaded, otherwise it is in the snippet file.
     QString m_content;
 
+    bool m_contentLoaded;
+
     // String in the content that mark the position of the cursor after insertion.
     // If there is no such mark in the content, the cursor should be put at the
     // end of the insertion.
@@ -118,6 +124,10 @@ private:
     static const QString c_defaultSelectionMark;
 
     static QVector<QChar> s_allShortcuts;
+
+    // Snippet file name -> content read from the file.
+    // Cost is the length of the content.
+    static QCache<QString, QString> s_contentCache;
 };
 
 #endif // VSNIPPET_H
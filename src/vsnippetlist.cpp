@@ -335,6 +335,7 @@ void VSnippetList::snippetInfo()
                 ret = false;
             }
 
+            rebuildIndex();
             updateContent();
         }
 
@@ -403,6 +404,8 @@ bool VSnippetList::addSnippet(const VSnippet &p_snippet, QString *p_errMsg)
         ret = false;
     }
 
+    rebuildIndex();
+
     updateContent();
 
     return ret;
@@ -429,6 +432,7 @@ bool VSnippetList::writeSnippetsToConfig() const
 bool VSnippetList::readSnippetsFromConfig()
 {
     m_snippets.clear();
+    rebuildIndex();
 
     if (!QFileInfo::exists(g_config->getSnippetConfigFilePath())) {
         return true;
@@ -446,19 +450,17 @@ bool VSnippetList::readSnippetsFromConfig()
     for (int i = 0; i < snippetArray.size(); ++i) {
         VSnippet snip = VSnippet::fromJson(snippetArray[i].toObject());
 
-        // Read the content.
-        QString filePath(QDir(g_config->getSnippetConfigFolder()).filePath(snip.getName()));
-        QString content = VUtils::readFileFromDisk(filePath);
-        if (content.isNull()) {
+        // The content is read on use.
+        if (!QFileInfo::exists(getSnippetFilePath(snip))) {
             qWarning() << "fail to read snippet" << snip.getName();
             ret = false;
             continue;
         }
 
-        snip.setContent(content);
         m_snippets.push_back(snip);
     }
 
+    rebuildIndex();
     return ret;
 }
 
@@ -495,10 +497,9 @@ int VSnippetList::getSnippetIndex(QListWidgetItem *p_item) const
     }
 
     QString name = p_item->data(Qt::UserRole).toString();
-    for (int i = 0; i < m_snippets.size(); ++i) {
-        if (m_snippets[i].getName() == name) {
-            return i;
-        }
+    auto it = m_nameIndex.find(name);
+    if (it != m_nameIndex.end()) {
+        return it.value();
     }
 
     Q_ASSERT(false);
@@ -519,6 +520,7 @@ bool VSnippetList::writeSnippetFile(const VSnippet &p_snippet, QString *p_errMsg
 {
     // Create and write to the snippet file.
     QString filePath = getSnippetFilePath(p_snippet);
+    VSnippet::invalidateContentCache(p_snippet.getName());
     if (!VUtils::writeFileToDisk(filePath, p_snippet.getContent())) {
         VUtils::addErrMsg(p_errMsg,
                           tr("Fail to add write the snippet file %1.")
@@ -552,6 +554,8 @@ bool VSnippetList::sortSnippets(const QVector<int> &p_sortedIdx, QString *p_errM
         ret = false;
     }
 
+    rebuildIndex();
+
     return ret;
 }
 
@@ -577,6 +581,8 @@ bool VSnippetList::deleteSnippets(const QList<QString> &p_snippets,
         }
     }
 
+    rebuildIndex();
+
     if (!writeSnippetsToConfig()) {
         VUtils::addErrMsg(p_errMsg,
                           tr("Fail to write snippets configuration file."));
@@ -589,6 +595,7 @@ bool VSnippetList::deleteSnippets(const QList<QString> &p_snippets,
 bool VSnippetList::deleteSnippetFile(const VSnippet &p_snippet, QString *p_errMsg)
 {
     QString filePath = getSnippetFilePath(p_snippet);
+    VSnippet::invalidateContentCache(p_snippet.getName());
     if (!VUtils::deleteFile(filePath)) {
         VUtils::addErrMsg(p_errMsg,
                           tr("Fail to remove snippet file %1.")
@@ -619,6 +626,34 @@ void VSnippetList::updateNumberLabel() const
                                    .arg(cnt > 1 ? tr("Items") : tr("Item")));
 }
 
+void VSnippetList::rebuildIndex()
+{
+    m_nameIndex.clear();
+    m_shortcutIndex.clear();
+
+    m_nameIndex.reserve(m_snippets.size());
+    for (int i = 0; i < m_snippets.size(); ++i) {
+        const VSnippet &snip = m_snippets[i];
+        m_nameIndex.insert(snip.getName(), i);
+        if (!snip.getShortcut().isNull()) {
+            m_shortcutIndex.insert(snip.getShortcut(), i);
+        }
+    }
+}
+
+QVector<const VSnippet *> VSnippetList::getSnippetsWithShortcut() const
+{
+    const_cast<VSnippetList *>(this)->init();
+
+    QVector<const VSnippet *> snippets;
+    snippets.reserve(m_shortcutIndex.size());
+    for (auto it = m_shortcutIndex.constBegin(); it != m_shortcutIndex.constEnd(); ++it) {
+        snippets.append(&m_snippets[it.value()]);
+    }
+
+    return snippets;
+}
+
 void VSnippetList::init()
 {
     if (m_initialized) {
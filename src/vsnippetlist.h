@@ -4,6 +4,8 @@
 #include <QWidget>
 #include <QVector>
 #include <QPoint>
+#include <QHash>
+#include <QMap>
 
 #include "vsnippet.h"
 #include "vnavigationmode.h"
@@ -26,6 +28,9 @@ public:
 
     const VSnippet *getSnippet(const QString &p_name) const;
 
+    // Snippets with shortcut sorted by the shortcut.
+    QVector<const VSnippet *> getSnippetsWithShortcut() const;
+
     // Implementations for VNavigationMode.
     void showNavigation() Q_DECL_OVERRIDE;
     bool handleKeyNavigation(int p_key, bool &p_succeed) Q_DECL_OVERRIDE;
@@ -90,6 +95,9 @@ private:
 
     void updateNumberLabel() const;
 
+    // Rebuild @m_nameIndex and @m_shortcutIndex after @m_snippets changed.
+    void rebuildIndex();
+
     bool m_initialized;
 
     bool m_uiInitialized;
@@ -101,6 +109,12 @@ private:
 
     QVector<VSnippet> m_snippets;
 
+    // Name -> index in @m_snippets.
+    QHash<QString, int> m_nameIndex;
+
+    // Shortcut -> index in @m_snippets.
+    QMap<QChar, int> m_shortcutIndex;
+
     static const QString c_infoShortcutSequence;
 };
 
@@ -115,12 +129,11 @@ inline const VSnippet *VSnippetList::getSnippet(const QString &p_name) const
 {
     const_cast<VSnippetList *>(this)->init();
 
-    for (auto const & snip : m_snippets) {
-        if (snip.getName() == p_name) {
-            return &snip;
-        }
+    auto it = m_nameIndex.find(p_name);
+    if (it == m_nameIndex.end()) {
+        return NULL;
     }
 
-    return NULL;
+    return &m_snippets[it.value()];
 }
 #endif // VSNIPPETLIST_H
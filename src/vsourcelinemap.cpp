@@ -0,0 +1,118 @@
+#include "vsourcelinemap.h"
+
+#include <algorithm>
+
+void VSourceLineMap::reset(const QVariantList &p_lines,
+                           const QVariantList &p_offsets,
+                           const QStringList &p_anchors,
+                           const QVariantList &p_anchorOffsets)
+{
+    clear();
+
+    int cnt = qMin(p_lines.size(), p_offsets.size());
+    QVector<Entry> entries;
+    entries.reserve(cnt);
+    for (int i = 0; i < cnt; ++i) {
+        Entry entry;
+        entry.m_line = p_lines[i].toInt();
+        entry.m_offset = p_offsets[i].toInt();
+        if (entry.m_line >= 0) {
+            entries.append(entry);
+        }
+    }
+
+    std::stable_sort(entries.begin(), entries.end(), [](const Entry &p_a, const Entry &p_b) {
+        return p_a.m_line < p_b.m_line;
+    });
+
+    // Drop the entries breaking the order of offsets, such as the hidden ones.
+    m_entries.reserve(entries.size());
+    for (auto const & entry : entries) {
+        if (m_entries.isEmpty()
+            || (entry.m_line > m_entries.last().m_line
+                && entry.m_offset >= m_entries.last().m_offset)) {
+            m_entries.append(entry);
+        }
+    }
+
+    cnt = qMin(p_anchors.size(), p_anchorOffsets.size());
+    for (int i = 0; i < cnt; ++i) {
+        int offset = p_anchorOffsets[i].toInt();
+        if (m_anchorOffsets.isEmpty() || offset >= m_anchorOffsets.last()) {
+            m_anchorOffsets.append(offset);
+            m_anchors.append(p_anchors[i]);
+        }
+    }
+}
+
+void VSourceLineMap::clear()
+{
+    m_entries.clear();
+    m_anchorOffsets.clear();
+    m_anchors.clear();
+}
+
+int VSourceLineMap::offsetOfLine(int p_line) const
+{
+    if (m_entries.isEmpty()) {
+        return -1;
+    }
+
+    auto it = std::upper_bound(m_entries.begin(),
+                               m_entries.end(),
+                               p_line,
+                               [](int p_val, const Entry &p_entry) {
+                                   return p_val < p_entry.m_line;
+                               });
+    if (it == m_entries.begin()) {
+        // Lines before the first block, such as the front matter.
+        return 0;
+    }
+
+    const Entry &prev = *(it - 1);
+    if (it == m_entries.end()) {
+        return prev.m_offset;
+    }
+
+    const Entry &next = *it;
+    return prev.m_offset
+           + (qint64)(next.m_offset - prev.m_offset) * (p_line - prev.m_line)
+             / (next.m_line - prev.m_line);
+}
+
+int VSourceLineMap::lineOfOffset(int p_offset) const
+{
+    if (m_entries.isEmpty()) {
+        return -1;
+    }
+
+    auto it = std::upper_bound(m_entries.begin(),
+                               m_entries.end(),
+                               p_offset,
+                               [](int p_val, const Entry &p_entry) {
+                                   return p_val < p_entry.m_offset;
+                               });
+    if (it == m_entries.begin()) {
+        return 0;
+    }
+
+    const Entry &prev = *(it - 1);
+    if (it == m_entries.end() || it->m_offset == prev.m_offset) {
+        return prev.m_line;
+    }
+
+    const Entry &next = *it;
+    return prev.m_line
+           + (qint64)(next.m_line - prev.m_line) * (p_offset - prev.m_offset)
+             / (next.m_offset - prev.m_offset);
+}
+
+QString VSourceLineMap::headerAtOffset(int p_offset) const
+{
+    auto it = std::upper_bound(m_anchorOffsets.begin(), m_anchorOffsets.end(), p_offset);
+    if (it == m_anchorOffsets.begin()) {
+        return QString();
+    }
+
+    return m_anchors[it - m_anchorOffsets.begin() - 1];
+}
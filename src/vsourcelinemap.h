@@ -0,0 +1,58 @@
+#ifndef VSOURCELINEMAP_H
+#define VSOURCELINEMAP_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QVariantList>
+
+// Map between the source lines of a note and the vertical offsets in its
+// rendered page, which is built by the web side once per render.
+// Positions between two mapped lines are interpolated.
+class VSourceLineMap
+{
+public:
+    // @p_lines are 0-based source lines at @p_offsets.
+    // @p_anchors are ids of the headers at @p_anchorOffsets.
+    void reset(const QVariantList &p_lines,
+               const QVariantList &p_offsets,
+               const QStringList &p_anchors,
+               const QVariantList &p_anchorOffsets);
+
+    void clear();
+
+    // Whether there is any source line to map.
+    bool hasLines() const;
+
+    // Offset of source line @p_line, or -1 if there is no source line.
+    int offsetOfLine(int p_line) const;
+
+    // Source line at offset @p_offset, or -1 if there is no source line.
+    int lineOfOffset(int p_offset) const;
+
+    // Id of the last header at or above @p_offset, or an empty string.
+    QString headerAtOffset(int p_offset) const;
+
+private:
+    struct Entry
+    {
+        int m_line;
+
+        int m_offset;
+    };
+
+    // Ascending in both lines and offsets.
+    QVector<Entry> m_entries;
+
+    // Ascending offsets of the headers.
+    QVector<int> m_anchorOffsets;
+
+    QStringList m_anchors;
+};
+
+inline bool VSourceLineMap::hasLines() const
+{
+    return !m_entries.isEmpty();
+}
+
+#endif // VSOURCELINEMAP_H
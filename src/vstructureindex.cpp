@@ -0,0 +1,355 @@
+#include "vstructureindex.h"
+
+#include <QTextDocument>
+#include <QTextBlock>
+
+#include "utils/veditutils.h"
+
+static const QChar c_pairs[][2] = {
+    { QLatin1Char('('), QLatin1Char(')') },
+    { QLatin1Char('['), QLatin1Char(']') },
+    { QLatin1Char('{'), QLatin1Char('}') }
+};
+
+VStructureIndex::VStructureIndex(const QTextDocument *p_doc)
+    : m_doc(p_doc),
+      m_valid(false),
+      m_leafCount(0),
+      m_treeValid(false)
+{
+}
+
+int VStructureIndex::pairIndex(QChar p_opening, QChar p_closing)
+{
+    for (int i = 0; i < c_pairCount; ++i) {
+        if (c_pairs[i][0] == p_opening && c_pairs[i][1] == p_closing) {
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+VStructureIndex::Node VStructureIndex::blockNode(const QTextBlock &p_block)
+{
+    Node node;
+    const QString text = p_block.text();
+    for (int i = 0; i < text.size(); ++i) {
+        const QChar ch = text[i];
+        for (int j = 0; j < c_pairCount; ++j) {
+            Balance &bal = node.m_pairs[j];
+            if (ch == c_pairs[j][0]) {
+                ++bal.m_sum;
+            } else if (ch == c_pairs[j][1]) {
+                --bal.m_sum;
+                bal.m_minPrefix = qMin(bal.m_minPrefix, bal.m_sum);
+            }
+        }
+    }
+
+    // A suffix is the whole minus a prefix.
+    for (int j = 0; j < c_pairCount; ++j) {
+        Balance &bal = node.m_pairs[j];
+        bal.m_maxSuffix = bal.m_sum - bal.m_minPrefix;
+    }
+
+    node.m_emptyCount = p_block.length() == 1 ? 1 : 0;
+    return node;
+}
+
+VStructureIndex::Node VStructureIndex::combine(const Node &p_left, const Node &p_right)
+{
+    Node node;
+    for (int j = 0; j < c_pairCount; ++j) {
+        const Balance &left = p_left.m_pairs[j];
+        const Balance &right = p_right.m_pairs[j];
+        Balance &bal = node.m_pairs[j];
+        bal.m_sum = left.m_sum + right.m_sum;
+        bal.m_minPrefix = qMin(left.m_minPrefix, left.m_sum + right.m_minPrefix);
+        bal.m_maxSuffix = qMax(right.m_maxSuffix, right.m_sum + left.m_maxSuffix);
+    }
+
+    node.m_emptyCount = p_left.m_emptyCount + p_right.m_emptyCount;
+    return node;
+}
+
+void VStructureIndex::build()
+{
+    m_blocks.clear();
+    m_blocks.reserve(m_doc->blockCount());
+    for (QTextBlock block = m_doc->begin(); block.isValid(); block = block.next()) {
+        m_blocks.append(blockNode(block));
+    }
+
+    m_valid = true;
+    m_treeValid = false;
+}
+
+void VStructureIndex::rebuildTree()
+{
+    m_leafCount = 1;
+    while (m_leafCount < m_blocks.size()) {
+        m_leafCount *= 2;
+    }
+
+    m_tree.fill(Node(), 2 * m_leafCount);
+    for (int i = 0; i < m_blocks.size(); ++i) {
+        m_tree[m_leafCount + i] = m_blocks[i];
+    }
+
+    for (int i = m_leafCount - 1; i > 0; --i) {
+        m_tree[i] = combine(m_tree[2 * i], m_tree[2 * i + 1]);
+    }
+
+    m_treeValid = true;
+}
+
+void VStructureIndex::ensureValid()
+{
+    if (!m_valid || m_blocks.size() != m_doc->blockCount()) {
+        build();
+    }
+
+    if (!m_treeValid) {
+        rebuildTree();
+    }
+}
+
+void VStructureIndex::updateTreeNode(int p_index)
+{
+    int i = m_leafCount + p_index;
+    m_tree[i] = m_blocks[p_index];
+    for (i /= 2; i > 0; i /= 2) {
+        m_tree[i] = combine(m_tree[2 * i], m_tree[2 * i + 1]);
+    }
+}
+
+void VStructureIndex::update(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    Q_UNUSED(p_charsRemoved);
+
+    if (!m_valid) {
+        return;
+    }
+
+    int first, oldCnt, newCnt;
+    if (!VEditUtils::mapContentsChange(m_doc, m_blocks.size(), p_position, p_charsAdded,
+                                       first, oldCnt, newCnt)) {
+        // Rebuild it on next query.
+        m_valid = false;
+        return;
+    }
+
+    if (newCnt > oldCnt) {
+        m_blocks.insert(first + oldCnt, newCnt - oldCnt, Node());
+        m_treeValid = false;
+    } else if (newCnt < oldCnt) {
+        m_blocks.remove(first + newCnt, oldCnt - newCnt);
+        m_treeValid = false;
+    }
+
+    QTextBlock block = m_doc->findBlockByNumber(first);
+    for (int i = 0; i < newCnt; ++i, block = block.next()) {
+        m_blocks[first + i] = blockNode(block);
+        if (m_treeValid) {
+            updateTreeNode(first + i);
+        }
+    }
+}
+
+int VStructureIndex::findFirstBlock(int p_pair, int p_node, int p_nl, int p_nr,
+                                    int p_from, int &p_acc, int p_depth) const
+{
+    if (p_nr <= p_from) {
+        return -1;
+    }
+
+    const Balance &bal = m_tree[p_node].m_pairs[p_pair];
+    if (p_nl >= p_from && p_acc + bal.m_minPrefix > -p_depth) {
+        p_acc += bal.m_sum;
+        return -1;
+    }
+
+    if (p_nr - p_nl == 1) {
+        return p_nl;
+    }
+
+    int mid = (p_nl + p_nr) / 2;
+    int res = findFirstBlock(p_pair, 2 * p_node, p_nl, mid, p_from, p_acc, p_depth);
+    if (res != -1) {
+        return res;
+    }
+
+    return findFirstBlock(p_pair, 2 * p_node + 1, mid, p_nr, p_from, p_acc, p_depth);
+}
+
+int VStructureIndex::findLastBlock(int p_pair, int p_node, int p_nl, int p_nr,
+                                   int p_to, int &p_acc, int p_depth) const
+{
+    if (p_nl >= p_to) {
+        return -1;
+    }
+
+    const Balance &bal = m_tree[p_node].m_pairs[p_pair];
+    if (p_nr <= p_to && p_acc + bal.m_maxSuffix < p_depth) {
+        p_acc += bal.m_sum;
+        return -1;
+    }
+
+    if (p_nr - p_nl == 1) {
+        return p_nl;
+    }
+
+    int mid = (p_nl + p_nr) / 2;
+    int res = findLastBlock(p_pair, 2 * p_node + 1, mid, p_nr, p_to, p_acc, p_depth);
+    if (res != -1) {
+        return res;
+    }
+
+    return findLastBlock(p_pair, 2 * p_node, p_nl, mid, p_to, p_acc, p_depth);
+}
+
+int VStructureIndex::findClosing(int p_pair, int p_position, int p_depth)
+{
+    Q_ASSERT(p_pair >= 0 && p_pair < c_pairCount && p_depth > 0);
+    QTextBlock block = m_doc->findBlock(qMax(p_position, 0));
+    if (!block.isValid()) {
+        return -1;
+    }
+
+    ensureValid();
+
+    const QChar opening = c_pairs[p_pair][0];
+    const QChar closing = c_pairs[p_pair][1];
+    int depth = p_depth;
+    int start = qMax(p_position, 0) - block.position();
+    while (true) {
+        const QString text = block.text();
+        for (int i = start; i < text.size(); ++i) {
+            if (text[i] == opening) {
+                ++depth;
+            } else if (text[i] == closing && --depth == 0) {
+                return block.position() + i;
+            }
+        }
+
+        // Jump to the block where it reaches.
+        int acc = 0;
+        int next = findFirstBlock(p_pair, 1, 0, m_leafCount,
+                                  block.blockNumber() + 1, acc, depth);
+        if (next == -1) {
+            return -1;
+        }
+
+        block = m_doc->findBlockByNumber(next);
+        Q_ASSERT(block.isValid());
+        depth += acc;
+        start = 0;
+    }
+}
+
+int VStructureIndex::findOpening(int p_pair, int p_position, int p_depth)
+{
+    Q_ASSERT(p_pair >= 0 && p_pair < c_pairCount && p_depth > 0);
+    if (p_position < 0) {
+        return -1;
+    }
+
+    QTextBlock block = m_doc->findBlock(qMin(p_position, m_doc->characterCount() - 1));
+    if (!block.isValid()) {
+        return -1;
+    }
+
+    ensureValid();
+
+    const QChar opening = c_pairs[p_pair][0];
+    const QChar closing = c_pairs[p_pair][1];
+    int depth = p_depth;
+    int start = p_position - block.position();
+    while (true) {
+        const QString text = block.text();
+        for (int i = qMin(start, text.size() - 1); i >= 0; --i) {
+            if (text[i] == closing) {
+                ++depth;
+            } else if (text[i] == opening && --depth == 0) {
+                return block.position() + i;
+            }
+        }
+
+        // Jump to the block where it reaches.
+        int acc = 0;
+        int prev = findLastBlock(p_pair, 1, 0, m_leafCount,
+                                 block.blockNumber(), acc, depth);
+        if (prev == -1) {
+            return -1;
+        }
+
+        block = m_doc->findBlockByNumber(prev);
+        Q_ASSERT(block.isValid());
+        depth -= acc;
+        start = block.length();
+    }
+}
+
+int VStructureIndex::countEmptyBlocks(int p_to) const
+{
+    int cnt = 0;
+    int lo = m_leafCount;
+    int hi = m_leafCount + p_to;
+    while (lo < hi) {
+        if (lo & 1) {
+            cnt += m_tree[lo++].m_emptyCount;
+        }
+
+        if (hi & 1) {
+            cnt += m_tree[--hi].m_emptyCount;
+        }
+
+        lo /= 2;
+        hi /= 2;
+    }
+
+    return cnt;
+}
+
+int VStructureIndex::findKthEmptyBlock(int p_k) const
+{
+    if (p_k < 1 || m_tree[1].m_emptyCount < p_k) {
+        return -1;
+    }
+
+    int node = 1;
+    while (node < m_leafCount) {
+        if (m_tree[2 * node].m_emptyCount >= p_k) {
+            node = 2 * node;
+        } else {
+            p_k -= m_tree[2 * node].m_emptyCount;
+            node = 2 * node + 1;
+        }
+    }
+
+    return node - m_leafCount;
+}
+
+int VStructureIndex::findEmptyBlock(int p_blockNumber, bool p_forward, int p_repeat)
+{
+    Q_ASSERT(p_repeat > 0);
+    ensureValid();
+    if (p_blockNumber < 0 || p_blockNumber >= m_blocks.size()) {
+        return -1;
+    }
+
+    int k = 0;
+    if (p_forward) {
+        k = countEmptyBlocks(p_blockNumber + 1) + p_repeat;
+    } else {
+        k = countEmptyBlocks(p_blockNumber) - p_repeat + 1;
+    }
+
+    int number = findKthEmptyBlock(k);
+    if (number == -1) {
+        return -1;
+    }
+
+    return m_doc->findBlockByNumber(number).position();
+}
@@ -0,0 +1,116 @@
+#ifndef VSTRUCTUREINDEX_H
+#define VSTRUCTUREINDEX_H
+
+#include <QChar>
+#include <QVector>
+
+class QTextDocument;
+class QTextBlock;
+
+// Bracket balance and empty blocks of each block of a document for Vim
+// motions, with a segment tree over the blocks to find the matching bracket
+// or the n-th empty block in O(log n) instead of walking the document.
+// It is built on the first query and then updated from the changes of the
+// document like VWordIndex.
+class VStructureIndex
+{
+public:
+    explicit VStructureIndex(const QTextDocument *p_doc);
+
+    // Should be called on QTextDocument::contentsChange().
+    void update(int p_position, int p_charsRemoved, int p_charsAdded);
+
+    // Index of pair (@p_opening, @p_closing), or -1 if it is not indexed.
+    static int pairIndex(QChar p_opening, QChar p_closing);
+
+    // Find forwards from @p_position the closing of pair @p_pair which closes
+    // @p_depth levels of openings before @p_position.
+    // Returns the position of the closing, or -1 if not found.
+    int findClosing(int p_pair, int p_position, int p_depth);
+
+    // Find backwards from @p_position the opening of pair @p_pair which opens
+    // @p_depth levels of closings after @p_position.
+    // Returns the position of the opening, or -1 if not found.
+    int findOpening(int p_pair, int p_position, int p_depth);
+
+    // Find the @p_repeat-th empty block after or before block @p_blockNumber.
+    // Returns the position of that block, or -1 if not found.
+    int findEmptyBlock(int p_blockNumber, bool p_forward, int p_repeat);
+
+private:
+    static const int c_pairCount = 3;
+
+    // Balance of a range, where an opening counts 1 and a closing counts -1.
+    struct Balance
+    {
+        Balance()
+            : m_sum(0),
+              m_minPrefix(0),
+              m_maxSuffix(0)
+        {
+        }
+
+        int m_sum;
+
+        int m_minPrefix;
+
+        int m_maxSuffix;
+    };
+
+    struct Node
+    {
+        Node()
+            : m_emptyCount(0)
+        {
+        }
+
+        Balance m_pairs[c_pairCount];
+
+        int m_emptyCount;
+    };
+
+    static Node blockNode(const QTextBlock &p_block);
+
+    static Node combine(const Node &p_left, const Node &p_right);
+
+    void build();
+
+    void rebuildTree();
+
+    // Build or rebuild the invalid parts.
+    void ensureValid();
+
+    void updateTreeNode(int p_index);
+
+    // Find the first block from @p_from where the balance accumulated from
+    // @p_from reaches -@p_depth.
+    int findFirstBlock(int p_pair, int p_node, int p_nl, int p_nr,
+                       int p_from, int &p_acc, int p_depth) const;
+
+    // Find the last block before @p_to where the balance accumulated backwards
+    // to @p_to reaches @p_depth.
+    int findLastBlock(int p_pair, int p_node, int p_nl, int p_nr,
+                      int p_to, int &p_acc, int p_depth) const;
+
+    // Number of empty blocks in [0, @p_to).
+    int countEmptyBlocks(int p_to) const;
+
+    // The @p_k-th empty block, based on 1.
+    int findKthEmptyBlock(int p_k) const;
+
+    const QTextDocument *m_doc;
+
+    // Summary of each block, in order.
+    QVector<Node> m_blocks;
+
+    bool m_valid;
+
+    // 1-based segment tree of m_blocks with m_leafCount leaves.
+    QVector<Node> m_tree;
+
+    int m_leafCount;
+
+    bool m_treeValid;
+};
+
+#endif // VSTRUCTUREINDEX_H
@@ -11,6 +11,7 @@
 #include "vnotefile.h"
 #include "vmainwindow.h"
 #include "vcaptain.h"
+#include "vdocumentgovernor.h"
 
 extern VMainWindow *g_mainWin;
 
@@ -98,7 +99,8 @@ void VWordCountPanel::clear()
 
 VTabIndicator::VTabIndicator(QWidget *p_parent)
     : QWidget(p_parent),
-      m_editTab(NULL)
+      m_editTab(NULL),
+      m_fullFeaturesForced(false)
 {
     setupUI();
 }
@@ -141,10 +143,18 @@ void VTabIndicator::setupUI()
     connect(m_wordCountBtn, &VButtonWithWidget::popupWidgetAboutToShow,
             this, &VTabIndicator::updateWordCountInfo);
 
+    m_featureBtn = new QPushButton(this);
+    m_featureBtn->setProperty("StatusBtn", true);
+    m_featureBtn->setFocusPolicy(Qt::NoFocus);
+    m_featureBtn->hide();
+    connect(m_featureBtn, &QPushButton::clicked,
+            this, &VTabIndicator::toggleFullFeatures);
+
     QHBoxLayout *mainLayout = new QHBoxLayout(this);
     mainLayout->addWidget(m_tagPanel);
     mainLayout->addWidget(m_cursorLabel);
     mainLayout->addWidget(m_wordCountBtn);
+    mainLayout->addWidget(m_featureBtn);
     mainLayout->addWidget(m_externalLabel);
     mainLayout->addWidget(m_systemLabel);
     mainLayout->addWidget(m_readonlyLabel);
@@ -175,6 +185,10 @@ static QString docTypeToString(DocType p_type)
         str = "Container";
         break;
 
+    case DocType::Text:
+        str = "Text";
+        break;
+
     default:
         str = "Unknown";
         break;
@@ -232,6 +246,8 @@ void VTabIndicator::update(const VEditTabInfo &p_info)
 
     updateWordCountBtn(p_info);
 
+    updateFeatureBtn(p_info);
+
     if (p_info.m_wordCountInfo.m_mode == VWordCountInfo::Read) {
         m_wordCountPanel->updateReadInfo(p_info.m_wordCountInfo);
     }
@@ -298,3 +314,36 @@ void VTabIndicator::updateWordCountBtn(const VEditTabInfo &p_info)
         m_wordCountBtn->setText(text);
     }
 }
+
+void VTabIndicator::updateFeatureBtn(const VEditTabInfo &p_info)
+{
+    m_fullFeaturesForced = p_info.m_fullFeaturesForced;
+
+    bool reduced = p_info.m_featureLevel > VDocumentGovernor::Full;
+    if (!m_editTab
+        || !m_editTab->isEditMode()
+        || (!reduced && !m_fullFeaturesForced)) {
+        m_featureBtn->hide();
+        return;
+    }
+
+    if (m_fullFeaturesForced) {
+        m_featureBtn->setText(tr("[%1]").arg(VDocumentGovernor::levelName(VDocumentGovernor::Full)));
+        m_featureBtn->setToolTip(tr("Full features are forced for this huge note. "
+                                    "Click to reduce them for responsiveness"));
+    } else {
+        VDocumentGovernor::Level level = (VDocumentGovernor::Level)p_info.m_featureLevel;
+        m_featureBtn->setText(tr("[%1]").arg(VDocumentGovernor::levelName(level)));
+        m_featureBtn->setToolTip(tr("Some features are turned off for this huge note "
+                                    "to keep editing responsive. Click to force full features"));
+    }
+
+    m_featureBtn->show();
+}
+
+void VTabIndicator::toggleFullFeatures()
+{
+    if (m_editTab) {
+        m_editTab->setFullFeaturesForced(!m_fullFeaturesForced);
+    }
+}
@@ -10,6 +10,7 @@ class VEditTab;
 class VWordCountPanel;
 class QGroupBox;
 class VTagPanel;
+class QPushButton;
 
 class VWordCountPanel : public QWidget
 {
@@ -52,11 +53,15 @@ public:
 private slots:
     void updateWordCountInfo(QWidget *p_widget);
 
+    void toggleFullFeatures();
+
 private:
     void setupUI();
 
     void updateWordCountBtn(const VEditTabInfo &p_info);
 
+    void updateFeatureBtn(const VEditTabInfo &p_info);
+
     // Tag panel.
     VTagPanel *m_tagPanel;
 
@@ -78,8 +83,14 @@ private:
     // Indicate the word count.
     VButtonWithWidget *m_wordCountBtn;
 
+    // Indicate the features reduced for a huge note and force full features.
+    QPushButton *m_featureBtn;
+
     VEditTab *m_editTab;
 
+    // Whether full features are forced in current tab.
+    bool m_fullFeaturesForced;
+
     VWordCountPanel *m_wordCountPanel;
 };
 
@@ -11,13 +11,17 @@ const QChar VTable::c_borderChar = '|';
 
 enum { HeaderRowIndex = 0, DelimiterRowIndex = 1 };
 
-VTable::VTable(VEditor *p_editor, const VTableBlock &p_block)
+// Drop the width cache beyond this number of rows.
+#define MAX_CACHED_ROWS 4096
+
+VTable::VTable(VEditor *p_editor, const VTableBlock &p_block, WidthCache *p_cache)
     : m_editor(p_editor),
       m_exist(true),
       m_spaceWidth(10),
       m_minusWidth(10),
       m_colonWidth(10),
-      m_defaultDelimiterWidth(10)
+      m_defaultDelimiterWidth(10),
+      m_cache(p_cache)
 {
     parseFromTableBlock(p_block);
 }
@@ -28,7 +32,8 @@ VTable::VTable(VEditor *p_editor, int p_nrBodyRow, int p_nrCol, VTable::Alignmen
       m_spaceWidth(10),
       m_minusWidth(10),
       m_colonWidth(10),
-      m_defaultDelimiterWidth(10)
+      m_defaultDelimiterWidth(10),
+      m_cache(NULL)
 {
     Q_ASSERT(p_nrBodyRow >= 0 && p_nrCol > 0);
     m_rows.resize(p_nrBodyRow + 2);
@@ -119,6 +124,19 @@ void VTable::parseFromTableBlock(const VTableBlock &p_block)
 
         block = block.next();
     }
+
+    m_rowWidths.resize(m_rows.size());
+    if (m_cache) {
+        if (m_cache->m_spaceWidth != m_spaceWidth) {
+            // The font changes.
+            m_cache->m_widths.clear();
+            m_cache->m_spaceWidth = m_spaceWidth;
+        }
+
+        for (int i = 0; i < m_rows.size(); ++i) {
+            m_rowWidths[i] = m_cache->m_widths.value(m_rows[i].m_block.text());
+        }
+    }
 }
 
 bool VTable::parseOneRow(const QTextBlock &p_block,
@@ -186,6 +204,7 @@ bool VTable::parseOneRow(const QTextBlock &p_block,
 void VTable::clear()
 {
     m_rows.clear();
+    m_rowWidths.clear();
     m_spaceWidth = 0;
     m_minusWidth = 0;
     m_colonWidth = 0;
@@ -213,6 +232,8 @@ void VTable::format()
     for (int i = 0; i < nrCols; ++i) {
         formatOneColumn(i, curRowIdx, curPib);
     }
+
+    saveWidthCache();
 }
 
 int VTable::calculateColumnCount() const
@@ -321,7 +342,7 @@ void VTable::formatOneColumn(int p_idx, int p_cursorRowIdx, int p_cursorPib)
                 }
             }
 
-            if (!isCellWellFormatted(row, cell, info, targetWidth, fakeAlign)) {
+            if (!isCellWellFormatted(rowIdx, cell, info, targetWidth, fakeAlign)) {
                 QString core = cell.m_text.mid(info.m_coreOffset, info.m_coreLength);
                 int nr = (targetWidth - info.m_coreWidth + m_spaceWidth / 2) / m_spaceWidth;
                 cell.m_formattedText = generateFormattedText(core, nr, fakeAlign);
@@ -378,9 +399,9 @@ void VTable::fetchCellInfoOfColumn(int p_idx,
         }
 
         // Calculate the core width.
-        info.m_coreWidth = calculateTextWidth(row.m_block,
-                                              cell.m_offset + info.m_coreOffset,
-                                              info.m_coreLength);
+        info.m_coreWidth = textWidth(i,
+                                     cell.m_offset + info.m_coreOffset,
+                                     info.m_coreLength);
         // Delimiter row's width should not be considered.
         if (info.m_coreWidth > p_targetWidth && !isDelimiterRow(i)) {
             p_targetWidth = info.m_coreWidth;
@@ -411,6 +432,43 @@ void VTable::calculateBasicWidths(const QTextBlock &p_block, int p_borderPos)
     m_defaultDelimiterWidth = fm.width(c_defaultDelimiter);
 }
 
+int VTable::textWidth(int p_rowIdx, int p_pib, int p_length) const
+{
+    QHash<qint64, int> &widths = m_rowWidths[p_rowIdx];
+    qint64 key = ((qint64)p_pib << 32) | (quint32)p_length;
+    auto it = widths.constFind(key);
+    if (it != widths.constEnd()) {
+        return it.value();
+    }
+
+    int width = calculateTextWidth(m_rows[p_rowIdx].m_block, p_pib, p_length);
+    // The block may not be laid out yet.
+    if (width > 0) {
+        widths.insert(key, width);
+    }
+
+    return width;
+}
+
+void VTable::saveWidthCache()
+{
+    if (!m_cache) {
+        return;
+    }
+
+    if (m_cache->m_widths.size() + m_rows.size() > MAX_CACHED_ROWS) {
+        m_cache->m_widths.clear();
+    }
+
+    // Rows are rewritten after formatting, and the rows changed will miss next
+    // time by their new text.
+    for (int i = 0; i < m_rows.size(); ++i) {
+        if (!m_rowWidths[i].isEmpty()) {
+            m_cache->m_widths.insert(m_rows[i].m_block.text(), m_rowWidths[i]);
+        }
+    }
+}
+
 int VTable::calculateTextWidth(const QTextBlock &p_block, int p_pib, int p_length) const
 {
     // The block may cross multiple lines.
@@ -527,7 +585,7 @@ bool VTable::isDelimiterCellWellFormatted(const Cell &p_cell,
     return true;
 }
 
-bool VTable::isCellWellFormatted(const Row &p_row,
+bool VTable::isCellWellFormatted(int p_rowIdx,
                                  const Cell &p_cell,
                                  const CellInfo &p_info,
                                  int p_targetWidth,
@@ -577,9 +635,9 @@ bool VTable::isCellWellFormatted(const Row &p_row,
     }
 
     // Calculate the width of the text without two spaces around.
-    int cellWidth = calculateTextWidth(p_row.m_block,
-                                       p_cell.m_offset + 2,
-                                       p_cell.m_length - 3);
+    int cellWidth = textWidth(p_rowIdx,
+                              p_cell.m_offset + 2,
+                              p_cell.m_length - 3);
     if (!equalWidth(cellWidth, p_targetWidth, m_spaceWidth)) {
         return false;
     }
@@ -616,15 +674,8 @@ void VTable::writeExist()
             continue;
         }
 
-        if (!changed) {
-            changed = true;
-            cursorBlock = cursor.blockNumber();
-            cursorPib = cursor.positionInBlock();
-
-            cursor.beginEditBlock();
-        }
-
         // Construct the block text.
+        int rowCursorPib = -1;
         QString newBlockText(row.m_preText);
         for (auto & cell : row.m_cells) {
             if (cell.m_deleted) {
@@ -640,15 +691,33 @@ void VTable::writeExist()
 
             if (cell.m_cursorCoreOffset > -1) {
                 // Cursor in this cell.
-                cursorPib = pos + cell.m_cursorCoreOffset + 2;
-                if (cursorPib >= newBlockText.size()) {
-                    cursorPib = newBlockText.size() - 1;
+                rowCursorPib = pos + cell.m_cursorCoreOffset + 2;
+                if (rowCursorPib >= newBlockText.size()) {
+                    rowCursorPib = newBlockText.size() - 1;
                 }
             }
         }
 
         newBlockText += c_borderChar;
 
+        // Cells may be reformatted into the same text, such as when their
+        // widths differ only in rounding.
+        if (newBlockText == row.m_block.text()) {
+            continue;
+        }
+
+        if (!changed) {
+            changed = true;
+            cursorBlock = cursor.blockNumber();
+            cursorPib = cursor.positionInBlock();
+
+            cursor.beginEditBlock();
+        }
+
+        if (rowCursorPib > -1) {
+            cursorPib = rowCursorPib;
+        }
+
         // Replace the whole block.
         cursor.setPosition(row.m_block.position());
         cursor.movePosition(QTextCursor::EndOfBlock, QTextCursor::KeepAnchor);
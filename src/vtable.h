@@ -2,6 +2,7 @@
 #define VTABLE_H
 
 #include <QTextBlock>
+#include <QHash>
 
 #include "markdownhighlighterdata.h"
 
@@ -17,7 +18,24 @@ public:
         Right
     };
 
-    VTable(VEditor *p_editor, const VTableBlock &p_block);
+    // Text widths of the rows kept across formatting passes of one editor,
+    // keyed by the text of the row.
+    struct WidthCache
+    {
+        WidthCache()
+            : m_spaceWidth(-1)
+        {
+        }
+
+        // Width of space of the font the widths are measured in.
+        int m_spaceWidth;
+
+        // Row text -> (position in block << 32 | length) -> width.
+        QHash<QString, QHash<qint64, int>> m_widths;
+    };
+
+    // @p_cache: if not NULL, only the rows not in it are measured.
+    VTable(VEditor *p_editor, const VTableBlock &p_block, WidthCache *p_cache = NULL);
 
     VTable(VEditor *p_editor, int p_nrBodyRow, int p_nrCol, VTable::Alignment p_alignment);
 
@@ -147,8 +165,14 @@ private:
 
     void calculateBasicWidths(const QTextBlock &p_block, int p_borderPos);
 
+    // Width of text of row @p_rowIdx, cached.
+    int textWidth(int p_rowIdx, int p_pib, int p_length) const;
+
     int calculateTextWidth(const QTextBlock &p_block, int p_pib, int p_length) const;
 
+    // Save the widths measured to m_cache.
+    void saveWidthCache();
+
     bool isHeaderRow(int p_idx) const;
 
     bool isDelimiterRow(int p_idx) const;
@@ -164,7 +188,7 @@ private:
                                       const CellInfo &p_info,
                                       int p_targetWidth) const;
 
-    bool isCellWellFormatted(const Row &p_row,
+    bool isCellWellFormatted(int p_rowIdx,
                              const Cell &p_cell,
                              const CellInfo &p_info,
                              int p_targetWidth,
@@ -194,6 +218,11 @@ private:
     int m_colonWidth;
     int m_defaultDelimiterWidth;
 
+    WidthCache *m_cache;
+
+    // Widths of each row, looked up from m_cache and measured in this pass.
+    mutable QVector<QHash<qint64, int>> m_rowWidths;
+
     static const QString c_defaultDelimiter;
 
     static const QChar c_borderChar;
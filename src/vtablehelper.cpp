@@ -7,24 +7,32 @@ extern VConfigManager *g_config;
 
 VTableHelper::VTableHelper(VEditor *p_editor, QObject *p_parent)
     : QObject(p_parent),
-      m_editor(p_editor)
+      m_editor(p_editor),
+      m_version(0)
 {
 }
 
-void VTableHelper::updateTableBlocks(const QVector<VTableBlock> &p_blocks)
+void VTableHelper::updateTableBlocks(const QSharedPointer<const VDocumentStructure> &p_structure)
 {
+    bool unchanged = p_structure->isUnchangedSince(m_version, VDocumentStructure::TableBlocks);
+    m_version = p_structure->version();
+    if (unchanged) {
+        return;
+    }
+
+    const QVector<VTableBlock> &blocks = p_structure->tableBlocks();
     if (m_editor->isReadOnlyW() ||
         !m_editor->isModified() ||
         !g_config->getEnableSmartTable()) {
         return;
     }
 
-    int idx = currentCursorTableBlock(p_blocks);
+    int idx = currentCursorTableBlock(blocks);
     if (idx == -1) {
         return;
     }
 
-    VTable table(m_editor, p_blocks[idx]);
+    VTable table(m_editor, blocks[idx], &m_widthCache);
     if (!table.isValid()) {
         return;
     }
@@ -5,6 +5,7 @@
 
 #include "markdownhighlighterdata.h"
 #include "vtable.h"
+#include "vdocumentstructure.h"
 
 class VEditor;
 
@@ -18,13 +19,19 @@ public:
     void insertTable(int p_nrRow, int p_nrCol, VTable::Alignment p_alignment);
 
 public slots:
-    void updateTableBlocks(const QVector<VTableBlock> &p_blocks);
+    void updateTableBlocks(const QSharedPointer<const VDocumentStructure> &p_structure);
 
 private:
     // Return the block index which contains the cursor.
     int currentCursorTableBlock(const QVector<VTableBlock> &p_blocks) const;
 
     VEditor *m_editor;
+
+    // Version of the document structure handled last.
+    quint64 m_version;
+
+    // Widths of the rows measured by previous passes.
+    VTable::WidthCache m_widthCache;
 };
 
 #endif // VTABLEHELPER_H
@@ -7,7 +7,6 @@
 #include "vlistwidget.h"
 #include "vnotebook.h"
 #include "vconfigmanager.h"
-#include "vsearch.h"
 #include "vnote.h"
 #include "vcart.h"
 #include "vhistorylist.h"
@@ -15,6 +14,8 @@
 #include "utils/vutils.h"
 #include "vnavigationmode.h"
 #include "vcaptain.h"
+#include "vtagindex.h"
+#include "vtaguniverse.h"
 
 extern VMainWindow *g_mainWin;
 
@@ -28,8 +29,7 @@ VTagExplorer::VTagExplorer(QWidget *p_parent)
     : QWidget(p_parent),
       m_uiInitialized(false),
       m_notebook(NULL),
-      m_notebookChanged(true),
-      m_search(NULL)
+      m_notebookChanged(true)
 {
 }
 
@@ -41,11 +41,19 @@ void VTagExplorer::setupUI()
 
     m_uiInitialized = true;
 
+    m_noteIcon = VIconUtils::treeViewIcon(":/resources/icons/note_item.svg");
+
     m_notebookLabel = new QLabel(tr("Tags"), this);
     m_notebookLabel->setProperty("TitleLabel", true);
 
     m_tagList = new VListWidget(this);
     m_tagList->setAttribute(Qt::WA_MacShowFocusRect, false);
+    connect(VTagUniverse::inst(), &VTagUniverse::indexesUpdated,
+            this, [this]() {
+                if (m_notebook && isVisible()) {
+                    updateTagCounts();
+                }
+            });
     connect(m_tagList, &QListWidget::itemActivated,
             this, [this](const QListWidgetItem *p_item) {
                 QString tag;
@@ -164,6 +172,8 @@ void VTagExplorer::updateContent()
         if (m_notebookChanged || tagListObsolete(tags)) {
             updateTagList(tags);
         }
+
+        updateTagCounts();
     } else {
         clear();
     }
@@ -244,30 +254,17 @@ bool VTagExplorer::activateTag(const QString &p_tag)
         return false;
     }
 
-    // Search this tag within current notebook.
-    g_mainWin->showStatusMessage(tr("Searching for tag \"%1\"").arg(p_tag));
-
-    QVector<VNotebook *> notebooks;
-    notebooks.append(m_notebook);
-    getVSearch()->clear();
-    // We could not use WholeWordOnly here, since "c#" won't match a word.
-    int opts = VSearchConfig::CaseSensitive | VSearchConfig::RegularExpression;
-    QString pattern = QRegExp::escape(p_tag);
-    pattern = "^" + pattern + "$";
-    QSharedPointer<VSearchConfig> config(new VSearchConfig(VSearchConfig::CurrentNotebook,
-                                                           VSearchConfig::Tag,
-                                                           VSearchConfig::Note,
-                                                           VSearchConfig::Internal,
-                                                           opts,
-                                                           pattern,
-                                                           QString()));
-    getVSearch()->setConfig(config);
-    QSharedPointer<VSearchResult> result = getVSearch()->search(notebooks);
-
-    bool ret = result->m_state == VSearchState::Success;
-    handleSearchFinished(result);
-
-    return ret;
+    // Notes of this tag within current notebook from the tag index.
+    const QStringList notes = m_notebook->getNotesOfTag(p_tag);
+    for (auto const & note : notes) {
+        appendItemToFileList(note);
+    }
+
+    g_mainWin->showStatusMessage(tr("%1 %2 found with tag \"%3\"")
+                                   .arg(notes.size())
+                                   .arg(notes.size() > 1 ? tr("notes") : tr("note"))
+                                   .arg(p_tag));
+    return true;
 }
 
 void VTagExplorer::updateTagList(const QStringList &p_tags)
@@ -294,6 +291,26 @@ void VTagExplorer::addTagItem(const QString &p_tag)
     m_tagList->addItem(item);
 }
 
+void VTagExplorer::updateTagCounts()
+{
+    // Counts are shown once the index is built in background.
+    const VTagIndex *index = m_notebook->getTagIndex();
+    if (!index->isBuilt()) {
+        m_notebook->requestTagIndex();
+        return;
+    }
+
+    VTagUniverse *universe = VTagUniverse::inst();
+    for (int i = 0; i < m_tagList->count(); ++i) {
+        QListWidgetItem *item = m_tagList->item(i);
+        const QString tag = item->text();
+        item->setToolTip(tr("%1\n%2 notes in this notebook, %3 in all notebooks")
+                           .arg(tag)
+                           .arg(index->countOfTag(tag))
+                           .arg(universe->countOf(tag)));
+    }
+}
+
 void VTagExplorer::saveStateAndGeometry()
 {
     if (!m_uiInitialized) {
@@ -311,79 +328,14 @@ void VTagExplorer::restoreStateAndGeometry()
     }
 }
 
-void VTagExplorer::initVSearch()
-{
-    m_search = new VSearch(this);
-    connect(m_search, &VSearch::resultItemAdded,
-            this, &VTagExplorer::handleSearchItemAdded);
-    connect(m_search, &VSearch::resultItemsAdded,
-            this, &VTagExplorer::handleSearchItemsAdded);
-    connect(m_search, &VSearch::finished,
-            this, &VTagExplorer::handleSearchFinished);
-
-    m_noteIcon = VIconUtils::treeViewIcon(":/resources/icons/note_item.svg");
-}
-
-void VTagExplorer::handleSearchItemAdded(const QSharedPointer<VSearchResultItem> &p_item)
+void VTagExplorer::appendItemToFileList(const QString &p_path)
 {
-    appendItemToFileList(p_item);
-}
-
-void VTagExplorer::appendItemToFileList(const QSharedPointer<VSearchResultItem> &p_item)
-{
-    Q_ASSERT(p_item->m_type == VSearchResultItem::Note);
-
-    QListWidgetItem *item = new QListWidgetItem(m_noteIcon,
-                                                p_item->m_text.isEmpty() ? p_item->m_path : p_item->m_text);
-    item->setData(Qt::UserRole, p_item->m_path);
-    item->setToolTip(p_item->m_path);
+    QListWidgetItem *item = new QListWidgetItem(m_noteIcon, VUtils::fileNameFromPath(p_path));
+    item->setData(Qt::UserRole, p_path);
+    item->setToolTip(p_path);
     m_fileList->addItem(item);
 }
 
-void VTagExplorer::handleSearchItemsAdded(const QList<QSharedPointer<VSearchResultItem> > &p_items)
-{
-    for (auto const & it : p_items) {
-        appendItemToFileList(it);
-    }
-}
-
-void VTagExplorer::handleSearchFinished(const QSharedPointer<VSearchResult> &p_result)
-{
-    Q_ASSERT(p_result->m_state != VSearchState::Idle);
-    QString msg;
-    switch (p_result->m_state) {
-    case VSearchState::Busy:
-        // Only synchronized search.
-        Q_ASSERT(false);
-        msg = tr("Invalid busy state when searching for tag");
-        break;
-
-    case VSearchState::Success:
-        qDebug() << "search succeeded";
-        msg = tr("Search for tag succeeded");
-        break;
-
-    case VSearchState::Fail:
-        qDebug() << "search failed";
-        msg = tr("Search for tag failed");
-        break;
-
-    case VSearchState::Cancelled:
-        qDebug() << "search cancelled";
-        msg = tr("Search for tag calcelled");
-        break;
-
-    default:
-        break;
-    }
-
-    m_search->clear();
-
-    if (!msg.isEmpty()) {
-        g_mainWin->showStatusMessage(msg);
-    }
-}
-
 void VTagExplorer::openFileItem(QListWidgetItem *p_item) const
 {
     if (!p_item) {
@@ -479,10 +431,13 @@ void VTagExplorer::addFileToCart() const
     QList<QListWidgetItem *> items = m_fileList->selectedItems();
     VCart *cart = g_mainWin->getCart();
 
+    QStringList files;
     for (int i = 0; i < items.size(); ++i) {
-        cart->addFile(getFilePath(items[i]));
+        files << getFilePath(items[i]);
     }
 
+    cart->addFiles(files);
+
     g_mainWin->showStatusMessage(tr("%1 %2 added to Cart")
                                    .arg(items.size())
                                    .arg(items.size() > 1 ? tr("notes") : tr("note")));
@@ -4,14 +4,11 @@
 #include <QWidget>
 #include <QIcon>
 
-#include "vsearchconfig.h"
-
 class QLabel;
 class VListWidget;
 class QListWidgetItem;
 class QSplitter;
 class VNotebook;
-class VSearch;
 
 class VTagExplorer : public QWidget
 {
@@ -33,12 +30,6 @@ protected:
     void focusInEvent(QFocusEvent *p_event) Q_DECL_OVERRIDE;
 
 private slots:
-    void handleSearchItemAdded(const QSharedPointer<VSearchResultItem> &p_item);
-
-    void handleSearchItemsAdded(const QList<QSharedPointer<VSearchResultItem> > &p_items);
-
-    void handleSearchFinished(const QSharedPointer<VSearchResult> &p_result);
-
     void openFileItem(QListWidgetItem *p_item) const;
 
     void openSelectedFileItems() const;
@@ -69,13 +60,12 @@ private:
 
     void addTagItem(const QString &p_tag);
 
-    void restoreStateAndGeometry();
-
-    VSearch *getVSearch() const;
+    // Update the tooltips of the tag items with the number of notes of each.
+    void updateTagCounts();
 
-    void initVSearch();
+    void restoreStateAndGeometry();
 
-    void appendItemToFileList(const QSharedPointer<VSearchResultItem> &p_item);
+    void appendItemToFileList(const QString &p_path);
 
     QString getFilePath(const QListWidgetItem *p_item) const;
 
@@ -102,18 +92,6 @@ private:
     bool m_notebookChanged;
 
     QIcon m_noteIcon;
-
-    VSearch *m_search;
 };
 
-inline VSearch *VTagExplorer::getVSearch() const
-{
-    if (m_search) {
-        return m_search;
-    }
-
-    const_cast<VTagExplorer *>(this)->initVSearch();
-    return m_search;
-}
-
 #endif // VTAGEXPLORER_H
@@ -0,0 +1,334 @@
+#include "vtagindex.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QJsonArray>
+
+#include "vnotebook.h"
+#include "vnotebooksnapshot.h"
+#include "vconstants.h"
+#include "vtaguniverse.h"
+
+VTagIndex::VTagIndex()
+    : m_built(false),
+      m_revision(0)
+{
+}
+
+VTagIndex::~VTagIndex()
+{
+    clear();
+}
+
+void VTagIndex::build(VNotebook *p_notebook)
+{
+    build(collect(p_notebook->getSnapshot(), p_notebook->getPath()), m_revision);
+
+    qDebug() << "tag index built for notebook" << p_notebook->getName()
+             << "tags" << m_notes.size() << "notes" << m_tags.size();
+}
+
+bool VTagIndex::build(const QHash<QString, QStringList> &p_tags, int p_revision)
+{
+    if (m_built) {
+        return true;
+    }
+
+    if (p_revision != m_revision) {
+        return false;
+    }
+
+    for (auto it = p_tags.constBegin(); it != p_tags.constEnd(); ++it) {
+        if (!m_changedNotes.contains(it.key())) {
+            setNoteTags(it.key(), it.value());
+        }
+    }
+
+    m_built = true;
+    m_changedNotes.clear();
+    return true;
+}
+
+QHash<QString, QStringList> VTagIndex::collect(const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                                               const QString &p_rootPath)
+{
+    QHash<QString, QStringList> tags;
+    collectFolder(p_snapshot, p_rootPath, "", tags);
+    return tags;
+}
+
+void VTagIndex::collectFolder(const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                              const QString &p_path,
+                              const QString &p_folder,
+                              QHash<QString, QStringList> &p_tags)
+{
+    QJsonObject configJson = p_snapshot->readDirectoryConfig(p_path);
+    if (configJson.isEmpty()) {
+        qWarning() << "invalid directory configuration in path" << p_path;
+        return;
+    }
+
+    collectNotes(p_folder, configJson, p_tags);
+
+    QJsonArray dirJson = configJson[DirConfig::c_subDirectories].toArray();
+    for (int i = 0; i < dirJson.size(); ++i) {
+        QString name = dirJson[i].toObject()[DirConfig::c_name].toString();
+        collectFolder(p_snapshot,
+                      QDir(p_path).filePath(name),
+                      normalize(QDir(p_folder).filePath(name)),
+                      p_tags);
+    }
+}
+
+void VTagIndex::collectNotes(const QString &p_folder,
+                             const QJsonObject &p_configJson,
+                             QHash<QString, QStringList> &p_tags)
+{
+    QJsonArray fileJson = p_configJson[DirConfig::c_files].toArray();
+    for (int i = 0; i < fileJson.size(); ++i) {
+        QJsonObject fileItem = fileJson[i].toObject();
+        QJsonArray tagsJson = fileItem[DirConfig::c_tags].toArray();
+        if (tagsJson.isEmpty()) {
+            continue;
+        }
+
+        QStringList tags;
+        for (int j = 0; j < tagsJson.size(); ++j) {
+            tags.append(tagsJson[j].toString());
+        }
+
+        p_tags.insert(normalize(QDir(p_folder).filePath(fileItem[DirConfig::c_name].toString())), tags);
+    }
+}
+
+void VTagIndex::buildFolder(VNotebook *p_notebook,
+                            const QString &p_path,
+                            const QString &p_folder)
+{
+    QHash<QString, QStringList> tags;
+    collectFolder(p_notebook->getSnapshot(), p_path, p_folder, tags);
+    for (auto it = tags.constBegin(); it != tags.constEnd(); ++it) {
+        setNoteTags(it.key(), it.value());
+    }
+}
+
+void VTagIndex::indexNotes(const QString &p_folder, const QJsonObject &p_configJson)
+{
+    QHash<QString, QStringList> tags;
+    collectNotes(p_folder, p_configJson, tags);
+    for (auto it = tags.constBegin(); it != tags.constEnd(); ++it) {
+        setNoteTags(it.key(), it.value());
+    }
+}
+
+void VTagIndex::clear()
+{
+    VTagUniverse *universe = VTagUniverse::inst();
+    for (auto it = m_notes.constBegin(); it != m_notes.constEnd(); ++it) {
+        universe->adjustCount(it.key(), -it.value().size());
+    }
+
+    m_built = false;
+    ++m_revision;
+    m_changedNotes.clear();
+    m_notes.clear();
+    m_tags.clear();
+}
+
+QStringList VTagIndex::notesOfTag(const QString &p_tag) const
+{
+    auto it = m_notes.constFind(p_tag);
+    if (it == m_notes.constEnd()) {
+        return QStringList();
+    }
+
+    QStringList notes = it.value().toList();
+    notes.sort();
+    return notes;
+}
+
+QStringList VTagIndex::tagsOfNote(const QString &p_note) const
+{
+    return m_tags.value(normalize(p_note));
+}
+
+void VTagIndex::setNoteTags(const QString &p_note, const QStringList &p_tags)
+{
+    QString note = normalize(p_note);
+    removeNote(note);
+
+    if (!m_built) {
+        m_changedNotes.insert(note);
+    }
+
+    if (p_tags.isEmpty()) {
+        return;
+    }
+
+    VTagUniverse *universe = VTagUniverse::inst();
+    for (auto const & tag : p_tags) {
+        QSet<QString> &notes = m_notes[tag];
+        if (!notes.contains(note)) {
+            notes.insert(note);
+            universe->adjustCount(tag, 1);
+        }
+    }
+
+    m_tags.insert(note, p_tags);
+}
+
+void VTagIndex::removeNote(const QString &p_note)
+{
+    QString note = normalize(p_note);
+    if (!m_built) {
+        m_changedNotes.insert(note);
+    }
+
+    auto it = m_tags.find(note);
+    if (it == m_tags.end()) {
+        return;
+    }
+
+    for (auto const & tag : it.value()) {
+        auto nit = m_notes.find(tag);
+        if (nit != m_notes.end()) {
+            if (nit.value().remove(note)) {
+                VTagUniverse::inst()->adjustCount(tag, -1);
+            }
+
+            if (nit.value().isEmpty()) {
+                m_notes.erase(nit);
+            }
+        }
+    }
+
+    m_tags.erase(it);
+}
+
+void VTagIndex::moveNote(const QString &p_oldNote, const QString &p_newNote)
+{
+    auto it = m_tags.constFind(normalize(p_oldNote));
+    if (it == m_tags.constEnd()) {
+        return;
+    }
+
+    QStringList tags = it.value();
+    removeNote(p_oldNote);
+    setNoteTags(p_newNote, tags);
+}
+
+void VTagIndex::removeFolder(const QString &p_folder)
+{
+    if (!m_built) {
+        ++m_revision;
+    }
+
+    QString folder = normalize(p_folder);
+    QStringList notes;
+    for (auto it = m_tags.constBegin(); it != m_tags.constEnd(); ++it) {
+        if (isWithin(it.key(), folder)) {
+            notes.append(it.key());
+        }
+    }
+
+    for (auto const & note : notes) {
+        removeNote(note);
+    }
+}
+
+void VTagIndex::moveFolder(const QString &p_oldFolder, const QString &p_newFolder)
+{
+    QString oldFolder = normalize(p_oldFolder);
+    QString newFolder = normalize(p_newFolder);
+    if (oldFolder == newFolder) {
+        return;
+    }
+
+    if (!m_built) {
+        ++m_revision;
+    }
+
+    QHash<QString, QStringList> moved;
+    for (auto it = m_tags.constBegin(); it != m_tags.constEnd(); ++it) {
+        if (isWithin(it.key(), oldFolder)) {
+            moved.insert(it.key(), it.value());
+        }
+    }
+
+    for (auto it = moved.constBegin(); it != moved.constEnd(); ++it) {
+        removeNote(it.key());
+    }
+
+    for (auto it = moved.constBegin(); it != moved.constEnd(); ++it) {
+        setNoteTags(newFolder + it.key().mid(oldFolder.size()), it.value());
+    }
+}
+
+void VTagIndex::addFolder(VNotebook *p_notebook, const QString &p_folder)
+{
+    if (!m_built) {
+        ++m_revision;
+        return;
+    }
+
+    QString folder = normalize(p_folder);
+    removeFolder(folder);
+    buildFolder(p_notebook, QDir(p_notebook->getPath()).filePath(folder), folder);
+}
+
+void VTagIndex::updateFolder(const QString &p_folder, const QJsonObject &p_configJson)
+{
+    if (!m_built) {
+        ++m_revision;
+        return;
+    }
+
+    QString folder = normalize(p_folder);
+
+    QSet<QString> subDirs;
+    QJsonArray dirJson = p_configJson[DirConfig::c_subDirectories].toArray();
+    for (int i = 0; i < dirJson.size(); ++i) {
+        subDirs.insert(dirJson[i].toObject()[DirConfig::c_name].toString());
+    }
+
+    // Drop notes of this folder and those of removed sub-folders.
+    QStringList notes;
+    for (auto it = m_tags.constBegin(); it != m_tags.constEnd(); ++it) {
+        const QString &note = it.key();
+        if (!folder.isEmpty() && !isWithin(note, folder)) {
+            continue;
+        }
+
+        QString rel = folder.isEmpty() ? note : note.mid(folder.size() + 1);
+        int idx = rel.indexOf('/');
+        if (idx == -1 || !subDirs.contains(rel.left(idx))) {
+            notes.append(note);
+        }
+    }
+
+    for (auto const & note : notes) {
+        removeNote(note);
+    }
+
+    indexNotes(folder, p_configJson);
+}
+
+QString VTagIndex::normalize(const QString &p_path)
+{
+    QString path = QDir::cleanPath(p_path);
+    if (path == ".") {
+        return QString();
+    }
+
+    return path;
+}
+
+bool VTagIndex::isWithin(const QString &p_path, const QString &p_folder)
+{
+    if (p_folder.isEmpty()) {
+        return true;
+    }
+
+    return p_path.startsWith(p_folder)
+           && (p_path.size() == p_folder.size() || p_path[p_folder.size()] == '/');
+}
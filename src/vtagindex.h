@@ -0,0 +1,137 @@
+#ifndef VTAGINDEX_H
+#define VTAGINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QHash>
+#include <QSet>
+#include <QJsonObject>
+#include <QSharedPointer>
+
+class VNotebook;
+class VNotebookSnapshot;
+
+// Index of tag -> notes of a notebook.
+// Paths are relative to the notebook.
+// Built once from the directory configurations on first use and kept in sync
+// when notes are loaded, tagged, added, removed or moved afterwards.
+// The configurations could be collected in background and merged into it
+// with the changes made meanwhile.
+// Changes of the number of notes of each tag are reported to VTagUniverse.
+class VTagIndex
+{
+public:
+    VTagIndex();
+
+    ~VTagIndex();
+
+    bool isBuilt() const;
+
+    // Walk through all the directory configurations of @p_notebook.
+    void build(VNotebook *p_notebook);
+
+    // Build it from @p_tags collected at revision @p_revision. Tags of the
+    // notes changed since then are kept.
+    // Return false if folders are changed since then, so it should be
+    // collected again.
+    bool build(const QHash<QString, QStringList> &p_tags, int p_revision);
+
+    // Revision of the changes of folders before it is built.
+    int getRevision() const;
+
+    // Walk through all the directory configurations from @p_rootPath.
+    // Return relative path of note -> tags.
+    // Thread-safe.
+    static QHash<QString, QStringList> collect(const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                                               const QString &p_rootPath);
+
+    // Drop everything. Will be built again on next use.
+    void clear();
+
+    // Sorted relative paths of notes with tag @p_tag.
+    QStringList notesOfTag(const QString &p_tag) const;
+
+    int countOfTag(const QString &p_tag) const;
+
+    // Tags of note @p_note.
+    QStringList tagsOfNote(const QString &p_note) const;
+
+    // All the tags used by notes.
+    QStringList getTags() const;
+
+    void setNoteTags(const QString &p_note, const QStringList &p_tags);
+
+    void removeNote(const QString &p_note);
+
+    void moveNote(const QString &p_oldNote, const QString &p_newNote);
+
+    // Remove notes within folder @p_folder recursively.
+    void removeFolder(const QString &p_folder);
+
+    void moveFolder(const QString &p_oldFolder, const QString &p_newFolder);
+
+    // Folder @p_folder is added to @p_notebook with its notes, like one moved
+    // from another notebook. Index its configurations recursively if built.
+    void addFolder(VNotebook *p_notebook, const QString &p_folder);
+
+    // Folder @p_folder is changed on disk to @p_configJson.
+    // Re-index its notes and drop those in its removed sub-folders if built.
+    void updateFolder(const QString &p_folder, const QJsonObject &p_configJson);
+
+private:
+    void buildFolder(VNotebook *p_notebook,
+                     const QString &p_path,
+                     const QString &p_folder);
+
+    void indexNotes(const QString &p_folder, const QJsonObject &p_configJson);
+
+    static void collectFolder(const QSharedPointer<VNotebookSnapshot> &p_snapshot,
+                              const QString &p_path,
+                              const QString &p_folder,
+                              QHash<QString, QStringList> &p_tags);
+
+    static void collectNotes(const QString &p_folder,
+                             const QJsonObject &p_configJson,
+                             QHash<QString, QStringList> &p_tags);
+
+    static QString normalize(const QString &p_path);
+
+    // Whether @p_path is @p_folder or within it.
+    static bool isWithin(const QString &p_path, const QString &p_folder);
+
+    bool m_built;
+
+    // Bumped when folders are changed before it is built.
+    int m_revision;
+
+    // Notes changed before it is built, whose tags are up to date.
+    QSet<QString> m_changedNotes;
+
+    // Tag -> notes.
+    QHash<QString, QSet<QString>> m_notes;
+
+    // Note -> tags.
+    QHash<QString, QStringList> m_tags;
+};
+
+inline bool VTagIndex::isBuilt() const
+{
+    return m_built;
+}
+
+inline int VTagIndex::getRevision() const
+{
+    return m_revision;
+}
+
+inline int VTagIndex::countOfTag(const QString &p_tag) const
+{
+    return m_notes.value(p_tag).size();
+}
+
+inline QStringList VTagIndex::getTags() const
+{
+    return m_notes.keys();
+}
+
+#endif // VTAGINDEX_H
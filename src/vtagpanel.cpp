@@ -11,6 +11,7 @@
 #include "vmainwindow.h"
 #include "vnote.h"
 #include "vconfigmanager.h"
+#include "vtaguniverse.h"
 
 extern VPalette *g_palette;
 
@@ -23,7 +24,8 @@ extern VConfigManager *g_config;
 VTagPanel::VTagPanel(QWidget *parent)
     : QWidget(parent),
       m_file(NULL),
-      m_notebookOfCompleter(NULL)
+      m_notebookOfCompleter(NULL),
+      m_completerVersion(-1)
 {
     setupUI();
 }
@@ -75,9 +77,8 @@ void VTagPanel::setupUI()
                 Q_ASSERT(m_file);
                 QString text = m_tagEdit->text();
                 if (addTag(text)) {
-                    if (m_file->getNotebook()->addTag(text)) {
-                        updateCompleter();
-                    }
+                    m_file->getNotebook()->addTag(text);
+                    updateCompleter(m_file);
 
                     updateTags();
 
@@ -100,6 +101,14 @@ void VTagPanel::setupUI()
     m_tagEdit->setCompleter(completer);
     m_tagEdit->installEventFilter(this);
 
+    // Tag indexes are built in background on first use.
+    connect(VTagUniverse::inst(), &VTagUniverse::indexesUpdated,
+            this, [this]() {
+                if (m_tagEdit->hasFocus()) {
+                    updateCompleter(m_file);
+                }
+            });
+
     QHBoxLayout *mainLayout = new QHBoxLayout();
     for (auto label : m_labels) {
         mainLayout->addWidget(label);
@@ -203,19 +212,32 @@ bool VTagPanel::eventFilter(QObject *p_obj, QEvent *p_event)
 void VTagPanel::updateCompleter(const VNoteFile *p_file)
 {
     const VNotebook *nb = p_file ? p_file->getNotebook() : NULL;
-    if (nb == m_notebookOfCompleter) {
+    int version = VTagUniverse::inst()->getVersion();
+    if (nb == m_notebookOfCompleter && version == m_completerVersion) {
         // No need to update.
         return;
     }
 
     m_notebookOfCompleter = nb;
+    m_completerVersion = version;
     updateCompleter();
 }
 
 void VTagPanel::updateCompleter()
 {
-    m_tagsModel->setStringList(m_notebookOfCompleter ? m_notebookOfCompleter->getTags()
-                                                     : QStringList());
+    // Tags used in all the notebooks, the most used first, followed by the
+    // unused ones of current notebook.
+    VTagUniverse *universe = VTagUniverse::inst();
+    QStringList tags = universe->getTags();
+    if (m_notebookOfCompleter) {
+        for (auto const & tag : m_notebookOfCompleter->getTags()) {
+            if (!universe->contains(tag)) {
+                tags.append(tag);
+            }
+        }
+    }
+
+    m_tagsModel->setStringList(tags);
 }
 
 void VTagPanel::showNavigation()
@@ -63,5 +63,8 @@ private:
     VNoteFile *m_file;
 
     const VNotebook *m_notebookOfCompleter;
+
+    // Version of VTagUniverse of the completion tags.
+    int m_completerVersion;
 };
 #endif // VTAGPANEL_H
@@ -0,0 +1,94 @@
+#include "vtaguniverse.h"
+
+#include <algorithm>
+
+#include "vnote.h"
+#include "vnotebook.h"
+#include "vtagindex.h"
+
+extern VNote *g_vnote;
+
+VTagUniverse::VTagUniverse()
+    : m_version(0),
+      m_sortedVersion(-1)
+{
+}
+
+VTagUniverse *VTagUniverse::inst()
+{
+    static VTagUniverse universe;
+    return &universe;
+}
+
+void VTagUniverse::ensureIndexed()
+{
+    if (!g_vnote) {
+        return;
+    }
+
+    for (auto nb : g_vnote->getNotebooks()) {
+        nb->requestTagIndex();
+    }
+}
+
+void VTagUniverse::indexBuilt()
+{
+    emit indexesUpdated();
+}
+
+int VTagUniverse::countOf(const QString &p_tag)
+{
+    ensureIndexed();
+    return m_counts.value(p_tag, 0);
+}
+
+bool VTagUniverse::contains(const QString &p_tag)
+{
+    ensureIndexed();
+    return m_counts.contains(p_tag);
+}
+
+const QStringList &VTagUniverse::getTags()
+{
+    ensureIndexed();
+    if (m_sortedVersion == m_version) {
+        return m_sortedTags;
+    }
+
+    m_sortedTags = m_counts.keys();
+    std::sort(m_sortedTags.begin(), m_sortedTags.end(), [this](const QString &p_a, const QString &p_b) {
+        int ca = m_counts.value(p_a);
+        int cb = m_counts.value(p_b);
+        return ca != cb ? ca > cb : p_a < p_b;
+    });
+
+    m_sortedVersion = m_version;
+    return m_sortedTags;
+}
+
+int VTagUniverse::getVersion()
+{
+    ensureIndexed();
+    return m_version;
+}
+
+void VTagUniverse::adjustCount(const QString &p_tag, int p_delta)
+{
+    if (p_delta == 0) {
+        return;
+    }
+
+    auto it = m_counts.find(p_tag);
+    if (it == m_counts.end()) {
+        if (p_delta > 0) {
+            m_counts.insert(p_tag, p_delta);
+        }
+    } else {
+        it.value() += p_delta;
+        if (it.value() <= 0) {
+            m_counts.erase(it);
+        }
+    }
+
+    ++m_version;
+}
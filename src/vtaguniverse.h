@@ -0,0 +1,59 @@
+#ifndef VTAGUNIVERSE_H
+#define VTAGUNIVERSE_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QHash>
+
+// Tags of the notes of all the notebooks with the number of notes of each.
+// Counts are fed by the tag index of each notebook. The indexes of the
+// notebooks not indexed yet are built in background on first use, and
+// afterwards they keep the counts in sync when notes are tagged, added,
+// removed or moved. Counts cover only the notebooks indexed so far.
+// Should be accessed only in the GUI thread.
+class VTagUniverse : public QObject
+{
+    Q_OBJECT
+public:
+    static VTagUniverse *inst();
+
+    // Number of the notes with tag @p_tag in all the notebooks.
+    int countOf(const QString &p_tag);
+
+    bool contains(const QString &p_tag);
+
+    // All the tags used by notes, the most used first.
+    const QStringList &getTags();
+
+    // Changed whenever a count changes.
+    int getVersion();
+
+    // Called by VTagIndex when @p_delta notes are tagged with @p_tag.
+    void adjustCount(const QString &p_tag, int p_delta);
+
+    // Called by VNotebook when its tag index is built in background.
+    void indexBuilt();
+
+signals:
+    // Emitted when the index of a notebook is built.
+    void indexesUpdated();
+
+private:
+    VTagUniverse();
+
+    // Build the tag indexes of the notebooks not indexed yet in background.
+    void ensureIndexed();
+
+    // Tag -> number of notes.
+    QHash<QString, int> m_counts;
+
+    int m_version;
+
+    // Sorted tags of @m_sortedVersion.
+    QStringList m_sortedTags;
+
+    int m_sortedVersion;
+};
+
+#endif // VTAGUNIVERSE_H
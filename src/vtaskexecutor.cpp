@@ -0,0 +1,188 @@
+#include "vtaskexecutor.h"
+
+#include <QThread>
+#include <QMutexLocker>
+
+// Run a task in the pool and release its slot after it.
+class VExecutorTask : public QRunnable
+{
+public:
+    VExecutorTask(VTaskExecutor *p_executor,
+                  QRunnable *p_task,
+                  VTaskExecutor::Priority p_priority)
+        : m_executor(p_executor),
+          m_task(p_task),
+          m_priority(p_priority)
+    {
+    }
+
+    void run() Q_DECL_OVERRIDE
+    {
+        // The owner may delete a task not auto-deleted once it runs out.
+        bool del = m_task->autoDelete();
+        m_task->run();
+        if (del) {
+            delete m_task;
+        }
+
+        m_executor->finishSlot(m_priority);
+    }
+
+private:
+    VTaskExecutor *m_executor;
+
+    QRunnable *m_task;
+
+    VTaskExecutor::Priority m_priority;
+};
+
+
+VTaskExecutor::VTaskExecutor()
+    : QObject(NULL),
+      m_sharedRunning(0),
+      m_slotWaited(false)
+{
+    int cores = qMax(1, QThread::idealThreadCount());
+    m_maxSlots = cores;
+
+    m_quotas[Interactive] = cores;
+    m_quotas[Preview] = qMax(1, cores / 2);
+    // Leave one core to the previews.
+    m_quotas[Search] = qMax(1, cores - 1);
+    m_quotas[Export] = qMax(1, cores / 2);
+    m_quotas[Maintenance] = 1;
+
+    for (int i = 0; i < PriorityCount; ++i) {
+        m_running[i] = 0;
+    }
+
+    m_pool.setMaxThreadCount(m_maxSlots + m_quotas[Interactive]);
+}
+
+VTaskExecutor *VTaskExecutor::inst()
+{
+    // Outlive the application, whose children may wait for their tasks
+    // when destroyed.
+    static VTaskExecutor executor;
+    return &executor;
+}
+
+void VTaskExecutor::start(QRunnable *p_task, Priority p_priority)
+{
+    Q_ASSERT(p_task);
+    QMutexLocker locker(&m_mutex);
+    m_pending[p_priority].enqueue(p_task);
+    dispatchLocked();
+}
+
+bool VTaskExecutor::cancel(QRunnable *p_task)
+{
+    {
+        QMutexLocker locker(&m_mutex);
+        bool found = false;
+        for (int i = 0; i < PriorityCount; ++i) {
+            if (m_pending[i].removeOne(p_task)) {
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            return false;
+        }
+
+        m_doneCond.wakeAll();
+    }
+
+    if (p_task->autoDelete()) {
+        delete p_task;
+    }
+
+    return true;
+}
+
+bool VTaskExecutor::tryAcquireSlot(Priority p_priority)
+{
+    QMutexLocker locker(&m_mutex);
+    // Queued tasks of the same or higher priority go first.
+    for (int i = 0; i <= p_priority; ++i) {
+        if (!m_pending[i].isEmpty()) {
+            m_slotWaited = true;
+            return false;
+        }
+    }
+
+    if (!hasSlotLocked(p_priority)) {
+        m_slotWaited = true;
+        return false;
+    }
+
+    ++m_running[p_priority];
+    if (p_priority != Interactive) {
+        ++m_sharedRunning;
+    }
+
+    return true;
+}
+
+void VTaskExecutor::releaseSlot(Priority p_priority)
+{
+    finishSlot(p_priority);
+}
+
+void VTaskExecutor::waitForDone(Priority p_priority)
+{
+    QMutexLocker locker(&m_mutex);
+    while (!m_pending[p_priority].isEmpty() || m_running[p_priority] > 0) {
+        m_doneCond.wait(&m_mutex);
+    }
+}
+
+bool VTaskExecutor::hasSlotLocked(Priority p_priority) const
+{
+    if (m_running[p_priority] >= m_quotas[p_priority]) {
+        return false;
+    }
+
+    return p_priority == Interactive || m_sharedRunning < m_maxSlots;
+}
+
+void VTaskExecutor::dispatchLocked()
+{
+    for (int i = 0; i < PriorityCount; ++i) {
+        Priority pri = static_cast<Priority>(i);
+        while (!m_pending[i].isEmpty() && hasSlotLocked(pri)) {
+            QRunnable *task = m_pending[i].dequeue();
+            ++m_running[i];
+            if (pri != Interactive) {
+                ++m_sharedRunning;
+            }
+
+            m_pool.start(new VExecutorTask(this, task, pri));
+        }
+    }
+}
+
+void VTaskExecutor::finishSlot(Priority p_priority)
+{
+    bool notify = false;
+    {
+        QMutexLocker locker(&m_mutex);
+        Q_ASSERT(m_running[p_priority] > 0);
+        --m_running[p_priority];
+        if (p_priority != Interactive) {
+            --m_sharedRunning;
+        }
+
+        dispatchLocked();
+
+        m_doneCond.wakeAll();
+
+        notify = m_slotWaited;
+        m_slotWaited = false;
+    }
+
+    if (notify) {
+        emit slotsAvailable();
+    }
+}
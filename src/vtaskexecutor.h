@@ -0,0 +1,114 @@
+#ifndef VTASKEXECUTOR_H
+#define VTASKEXECUTOR_H
+
+#include <QObject>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QQueue>
+
+// One executor of the background work of all the subsystems, which shares
+// the cores among the classes of work by priority and per-class quotas.
+// - Interactive work like parsing the note being edited may always use its
+//   own quota, so it is never starved by a big search;
+// - The other classes share the cores by priority within their quotas;
+// - Work outside the pool like the render processes takes a slot as well;
+// Cancellation is cooperative: tasks poll their own stop flags, and pending
+// tasks could be dropped before they start.
+// Thread-safe.
+class VTaskExecutor : public QObject
+{
+    Q_OBJECT
+public:
+    // In the order of priority.
+    enum Priority
+    {
+        // Parsing and highlighting of the editors.
+        Interactive = 0,
+
+        // Rendering of the previews.
+        Preview,
+
+        Search,
+
+        // Rendering and converting of the notes in export.
+        Export,
+
+        // Cleanups and indexing.
+        Maintenance,
+
+        PriorityCount
+    };
+
+    static VTaskExecutor *inst();
+
+    // Queue @p_task of class @p_priority. Deleted after run if autoDelete().
+    void start(QRunnable *p_task, Priority p_priority);
+
+    // Drop @p_task if not started yet, deleting it if autoDelete().
+    // Return true if dropped.
+    bool cancel(QRunnable *p_task);
+
+    // Take a slot of class @p_priority for work outside the pool.
+    // If it fails, slotsAvailable() will be emitted once slots are released.
+    bool tryAcquireSlot(Priority p_priority);
+
+    void releaseSlot(Priority p_priority);
+
+    // Max number of tasks of class @p_priority running at the same time.
+    int quota(Priority p_priority) const;
+
+    // Wait until no task of class @p_priority is pending or running.
+    void waitForDone(Priority p_priority);
+
+signals:
+    // Emitted in any thread after a failed tryAcquireSlot() once slots are
+    // released.
+    void slotsAvailable();
+
+private:
+    friend class VExecutorTask;
+
+    VTaskExecutor();
+
+    // Should be called with @m_mutex locked.
+    bool hasSlotLocked(Priority p_priority) const;
+
+    // Start pending tasks within the quotas.
+    // Should be called with @m_mutex locked.
+    void dispatchLocked();
+
+    // Release the slot of a finished task or of work outside the pool.
+    void finishSlot(Priority p_priority);
+
+    // Slots shared by all the classes except Interactive.
+    int m_maxSlots;
+
+    int m_quotas[PriorityCount];
+
+    // Guard the fields below.
+    QMutex m_mutex;
+
+    QWaitCondition m_doneCond;
+
+    QQueue<QRunnable *> m_pending[PriorityCount];
+
+    int m_running[PriorityCount];
+
+    // Running tasks and taken slots except Interactive.
+    int m_sharedRunning;
+
+    // Whether someone waits for slotsAvailable().
+    bool m_slotWaited;
+
+    // Declared last to wait for the tasks before the fields are gone.
+    QThreadPool m_pool;
+};
+
+inline int VTaskExecutor::quota(Priority p_priority) const
+{
+    return m_quotas[p_priority];
+}
+
+#endif // VTASKEXECUTOR_H
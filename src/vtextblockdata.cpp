@@ -4,6 +4,8 @@ VTextBlockData::VTextBlockData()
     : QTextBlockUserData(),
       m_timeStamp(0),
       m_codeBlockTimeStamp(0),
+      m_blockTextHash(0),
+      m_formatsCacheValid(false),
       m_cacheValid(false),
       m_codeBlockIndentation(-1)
 {
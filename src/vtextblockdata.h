@@ -2,6 +2,7 @@
 #define VTEXTBLOCKDATA_H
 
 #include <QTextBlockUserData>
+#include <QTextLayout>
 #include <QVector>
 #include <QDebug>
 
@@ -181,12 +182,26 @@ public:
 
     void setCodeBlockTimeStamp(TimeStamp p_ts);
 
-    bool isBlockHighlightCacheMatched(const QVector<HLUnit> &p_highlight) const;
+    bool isBlockHighlightCacheMatched(const HLUnitSpan &p_highlight) const;
 
     QVector<HLUnit> &getBlockHighlightCache();
 
     void setBlockHighlightCache(const QVector<HLUnit> &p_highlight);
 
+    // Whether the merged formats are computed from @p_highlight for text
+    // with hash @p_textHash.
+    bool isBlockFormatsCacheMatched(const HLUnitSpan &p_highlight, uint p_textHash) const;
+
+    const QVector<QTextLayout::FormatRange> &getBlockFormatsCache() const;
+
+    // Also set the highlight cache to @p_highlight.
+    void setBlockFormatsCache(const QVector<HLUnit> &p_highlight,
+                              uint p_textHash,
+                              const QVector<QTextLayout::FormatRange> &p_formats);
+
+    // Merge the formats again next time, such as when the styles change.
+    void invalidateBlockFormatsCache();
+
     bool isCodeBlockHighlightCacheMatched(const QVector<HLUnitStyle> &p_highlight) const;
 
     QVector<HLUnitStyle> &getCodeBlockHighlightCache();
@@ -214,6 +229,14 @@ private:
     // Block highlight cache.
     QVector<HLUnit> m_blockHighlightCache;
 
+    // Merged formats of the units of the block highlight, ready to apply.
+    QVector<QTextLayout::FormatRange> m_blockFormatsCache;
+
+    // Hash of the block text when @m_blockFormatsCache is computed.
+    uint m_blockTextHash;
+
+    bool m_formatsCacheValid;
+
     // Code block highlight cache.
     // This cache is always valid.
     QVector<HLUnitStyle> m_codeBlockHighlightCache;
@@ -265,22 +288,9 @@ inline void VTextBlockData::setCodeBlockTimeStamp(TimeStamp p_ts)
     m_codeBlockTimeStamp = p_ts;
 }
 
-inline bool VTextBlockData::isBlockHighlightCacheMatched(const QVector<HLUnit> &p_highlight) const
+inline bool VTextBlockData::isBlockHighlightCacheMatched(const HLUnitSpan &p_highlight) const
 {
-    if (!m_cacheValid
-        || p_highlight.size() != m_blockHighlightCache.size()) {
-        return false;
-    }
-
-    int sz = p_highlight.size();
-    for (int i = 0; i < sz; ++i)
-    {
-        if (!(p_highlight[i] == m_blockHighlightCache[i])) {
-            return false;
-        }
-    }
-
-    return true;
+    return m_cacheValid && p_highlight == HLUnitSpan(m_blockHighlightCache);
 }
 
 inline QVector<HLUnit> &VTextBlockData::getBlockHighlightCache()
@@ -293,6 +303,34 @@ inline void VTextBlockData::setBlockHighlightCache(const QVector<HLUnit> &p_high
     m_blockHighlightCache = p_highlight;
 }
 
+inline bool VTextBlockData::isBlockFormatsCacheMatched(const HLUnitSpan &p_highlight,
+                                                       uint p_textHash) const
+{
+    return m_formatsCacheValid
+           && m_blockTextHash == p_textHash
+           && p_highlight == HLUnitSpan(m_blockHighlightCache);
+}
+
+inline const QVector<QTextLayout::FormatRange> &VTextBlockData::getBlockFormatsCache() const
+{
+    return m_blockFormatsCache;
+}
+
+inline void VTextBlockData::setBlockFormatsCache(const QVector<HLUnit> &p_highlight,
+                                                 uint p_textHash,
+                                                 const QVector<QTextLayout::FormatRange> &p_formats)
+{
+    m_blockHighlightCache = p_highlight;
+    m_blockTextHash = p_textHash;
+    m_blockFormatsCache = p_formats;
+    m_formatsCacheValid = true;
+}
+
+inline void VTextBlockData::invalidateBlockFormatsCache()
+{
+    m_formatsCacheValid = false;
+}
+
 inline bool VTextBlockData::isCodeBlockHighlightCacheMatched(const QVector<HLUnitStyle> &p_highlight) const
 {
     if (p_highlight.size() != m_codeBlockHighlightCache.size()) {
@@ -8,14 +8,25 @@
 #include <QFontMetrics>
 #include <QFont>
 #include <QPainter>
+#include <QtMath>
 
 #include "vimageresourcemanager2.h"
 #include "vtextedit.h"
 #include "vtextblockdata.h"
+#include "vlatencystats.h"
 
 #define MARKER_THICKNESS        2
 #define MAX_INLINE_IMAGE_HEIGHT 400
 
+// Max KBs of painted block tiles.
+#define MAX_TILES_COST (64 * 1024)
+
+// Characters of a long block layouted beyond the position needed.
+#define LONG_LINE_SEGMENT_LENGTH 4096
+
+// Milliseconds to layout estimated blocks in one go.
+#define ESTIMATED_LAYOUT_FRAME_BUDGET 8
+
 inline static bool realEqual(qreal p_a, qreal p_b)
 {
     return qAbs(p_a - p_b) < 1e-8;
@@ -42,7 +53,14 @@ VTextDocumentLayout::VTextDocumentLayout(QTextDocument *p_doc,
       m_highlightCursorLineBlock(false),
       m_cursorLineBlockBg("#C0C0C0"),
       m_cursorLineBlockNumber(-1),
-      m_extraBufferHeight(0)
+      m_extraBufferHeight(0),
+      m_latencyStats(NULL),
+      m_lazyLayoutBlockCount(0),
+      m_lazyLayout(false),
+      m_forceEstimate(false),
+      m_longLineLength(0),
+      m_tiles(MAX_TILES_COST),
+      m_lastTileId(0)
 {
 }
 
@@ -69,52 +87,6 @@ static void fillBackground(QPainter *p_painter,
     p_painter->restore();
 }
 
-void VTextDocumentLayout::blockRangeFromRect(const QRectF &p_rect,
-                                             int &p_first,
-                                             int &p_last) const
-{
-    if (p_rect.isNull()) {
-        p_first = 0;
-        p_last = document()->blockCount() - 1;
-        return;
-    }
-
-    p_first = -1;
-    p_last = document()->blockCount() - 1;
-    int y = p_rect.y();
-    QTextBlock block = document()->firstBlock();
-    while (block.isValid()) {
-        const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-        V_ASSERT(info->hasOffset());
-
-        if (info->top() == y
-            || (info->top() < y && info->bottom() >= y)) {
-            p_first = block.blockNumber();
-            break;
-        }
-
-        block = block.next();
-    }
-
-    if (p_first == -1) {
-        p_last = -1;
-        return;
-    }
-
-    y += p_rect.height();
-    while (block.isValid()) {
-        const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-        V_ASSERT(info->hasOffset());
-
-        if (info->bottom() > y) {
-            p_last = block.blockNumber();
-            break;
-        }
-
-        block = block.next();
-    }
-}
-
 void VTextDocumentLayout::blockRangeFromRectBS(const QRectF &p_rect,
                                                int &p_first,
                                                int &p_last) const
@@ -131,68 +103,35 @@ void VTextDocumentLayout::blockRangeFromRectBS(const QRectF &p_rect,
         return;
     }
 
-    int y = p_rect.bottom();
-    QTextBlock block = document()->findBlockByNumber(p_first);
-    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-    if (realEqual(info->top(), p_rect.top()) && p_first > 0) {
+    if (realEqual(blockOffset(p_first), p_rect.top()) && p_first > 0) {
         --p_first;
     }
 
-    p_last = document()->blockCount() - 1;
-    while (block.isValid()) {
-        const BlockLayoutInfo *tinfo = VTextBlockData::layoutInfo(block);
-        if (!tinfo->hasOffset()) {
-            qWarning() << "block without offset"
-                       << block.blockNumber() << tinfo->m_offset
-                       << tinfo->m_rect << tinfo->m_rect.isNull();
-        }
-
-        V_ASSERT(tinfo->hasOffset());
-
-        if (tinfo->bottom() > y) {
-            p_last = block.blockNumber();
-            break;
-        }
-
-        block = block.next();
-    }
+    p_last = findBlockByPosition(QPointF(0, p_rect.bottom()));
 }
 
 int VTextDocumentLayout::findBlockByPosition(const QPointF &p_point) const
 {
-    QTextDocument *doc = document();
-    int first = 0, last = doc->blockCount() - 1;
-    int y = p_point.y();
-    while (first <= last) {
-        int mid = (first + last) / 2;
-        QTextBlock blk = doc->findBlockByNumber(mid);
-        const BlockLayoutInfo *info = VTextBlockData::layoutInfo(blk);
-        if (!info) {
-            return -1;
-        }
+    ensureHeightIndex();
 
-        V_ASSERT(info->hasOffset());
-        if (info->top() <= y && info->bottom() > y) {
-            // Found it.
-            return mid;
-        } else if (info->top() > y) {
-            last = mid - 1;
-        } else {
-            first = mid + 1;
-        }
+    int cnt = m_heightIndex.size();
+    if (cnt == 0) {
+        return -1;
     }
 
-    QTextBlock blk = doc->lastBlock();
-    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(blk);
-    if (y >= info->bottom()) {
-        return blk.blockNumber();
+    int y = p_point.y();
+    int bn = m_heightIndex.findIndex(y);
+    if (bn >= cnt) {
+        bn = cnt - 1;
     }
 
-    return 0;
+    return bn;
 }
 
 void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_context)
 {
+    ensureBlocksLayoutedInRect(p_context.clip);
+
     // Find out the blocks.
     int first, last;
     blockRangeFromRectBS(p_context.clip, first, last);
@@ -202,7 +141,7 @@ void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_contex
 
     QTextDocument *doc = document();
     QTextBlock block = doc->findBlockByNumber(first);
-    QPointF offset(m_margin, VTextBlockData::layoutInfo(block)->top());
+    QPointF offset(m_margin, blockOffset(first));
     QTextBlock lastBlock = doc->findBlockByNumber(last);
 
     QPen oldPen = p_painter->pen();
@@ -210,7 +149,7 @@ void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_contex
 
     while (block.isValid()) {
         const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-        V_ASSERT(info->hasOffset());
+        V_ASSERT(!info->isNull());
 
         const QRectF &rect = info->m_rect;
         QTextLayout *layout = block.layout();
@@ -224,35 +163,37 @@ void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_contex
             continue;
         }
 
-        QTextBlockFormat blockFormat = block.blockFormat();
-        QBrush bg = blockFormat.background();
-        if (bg != Qt::NoBrush) {
-            int x = offset.x();
-            int y = offset.y();
-            fillBackground(p_painter,
-                           rect.adjusted(x, y, x, y),
-                           bg);
-        }
-
-        // Draw block background for HRULE.
-        if (block.userState() == HighlightBlockState::HRule) {
-            QVector<QTextLayout::FormatRange> fmts = layout->formats();
-            if (fmts.size() == 1) {
-                int x = offset.x();
-                int y = offset.y();
-                fillBackground(p_painter,
-                               rect.adjusted(x, y, x, y),
-                               fmts[0].format.background());
-            }
-        }
-
         auto selections = formatRangeFromSelection(block, p_context.selections);
 
-        // Draw the cursor.
         int blpos = block.position();
         int bllen = block.length();
         bool drawCursor = p_context.cursorPosition >= blpos
                           && p_context.cursorPosition < blpos + bllen;
+        bool drawPreedit = p_context.cursorPosition < -1
+                           && !layout->preeditAreaText().isEmpty();
+        bool isCursorLineBlock = m_highlightCursorLineBlock
+                                 && m_cursorLineBlockNumber == block.blockNumber();
+
+        // Blocks with images are expensive to draw. Reuse the painted ones
+        // unless there is something to draw upon them.
+        if (!info->m_images.isEmpty()
+            && selections.isEmpty()
+            && !drawCursor
+            && !drawPreedit
+            && !isCursorLineBlock
+            && drawBlockTile(p_painter, block, offset, p_context.palette.color(QPalette::Text))) {
+            offset.ry() += rect.height();
+            if (block == lastBlock) {
+                break;
+            }
+
+            block = block.next();
+            continue;
+        }
+
+        drawBlockBackground(p_painter, block, offset);
+
+        // Draw the cursor.
         int cursorWidth = m_cursorWidth;
         int cursorPosition = p_context.cursorPosition - blpos;
         if (drawCursor && m_cursorBlockMode != CursorBlock::None) {
@@ -290,7 +231,9 @@ void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_contex
                 }
             }
 
-            if (needUpdateWidthViaSelection) {
+            // The cursor may be out of the layouted lines of a long block.
+            if (needUpdateWidthViaSelection
+                && layout->lineForTextPosition(cursorPosition).isValid()) {
                 // Get the width of the selection to update cursor width.
                 cursorWidth = getTextWidthWithinTextLine(layout, cursorPosition, deltaPosition);
                 if (cursorWidth < m_cursorWidth) {
@@ -307,8 +250,7 @@ void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_contex
         }
 
         // Draw cursor line block.
-        if (m_highlightCursorLineBlock
-            && m_cursorLineBlockNumber == block.blockNumber()) {
+        if (isCursorLineBlock) {
             int x = offset.x();
             int y = offset.y();
             fillBackground(p_painter,
@@ -325,9 +267,7 @@ void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_contex
 
         drawMarkers(p_painter, block, offset);
 
-        if (drawCursor
-            || (p_context.cursorPosition < -1
-                && !layout->preeditAreaText().isEmpty())) {
+        if (drawCursor || drawPreedit) {
             if (p_context.cursorPosition < -1) {
                 cursorPosition = layout->preeditAreaPosition()
                                  - (p_context.cursorPosition + 2);
@@ -350,6 +290,106 @@ void VTextDocumentLayout::draw(QPainter *p_painter, const PaintContext &p_contex
     p_painter->setPen(oldPen);
 }
 
+void VTextDocumentLayout::drawBlockBackground(QPainter *p_painter,
+                                              const QTextBlock &p_block,
+                                              const QPointF &p_offset)
+{
+    const QRectF &rect = VTextBlockData::layoutInfo(p_block)->m_rect;
+    int x = p_offset.x();
+    int y = p_offset.y();
+
+    QBrush bg = p_block.blockFormat().background();
+    if (bg != Qt::NoBrush) {
+        fillBackground(p_painter,
+                       rect.adjusted(x, y, x, y),
+                       bg);
+    }
+
+    // Draw block background for HRULE.
+    if (p_block.userState() == HighlightBlockState::HRule) {
+        QVector<QTextLayout::FormatRange> fmts = p_block.layout()->formats();
+        if (fmts.size() == 1) {
+            fillBackground(p_painter,
+                           rect.adjusted(x, y, x, y),
+                           fmts[0].format.background());
+        }
+    }
+}
+
+bool VTextDocumentLayout::drawBlockTile(QPainter *p_painter,
+                                        const QTextBlock &p_block,
+                                        const QPointF &p_offset,
+                                        const QColor &p_textColor)
+{
+    BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    const QRectF &rect = info->m_rect;
+    qreal dpr = p_painter->device()->devicePixelRatioF();
+    QSize size = (rect.size() * dpr).toSize();
+
+    BlockTile *tile = info->m_tileId ? m_tiles.object(info->m_tileId) : NULL;
+    if (tile
+        && (tile->m_revision != p_block.revision()
+            || tile->m_devicePixelRatio != dpr
+            || tile->m_textColor != p_textColor
+            || tile->m_pixmap.size() != size)) {
+        m_tiles.remove(info->m_tileId);
+        tile = NULL;
+    }
+
+    if (!tile) {
+        int cost = size.width() * size.height() / 256;
+        if (size.isEmpty() || cost > MAX_TILES_COST / 4) {
+            return false;
+        }
+
+        QPixmap pixmap(size);
+        pixmap.setDevicePixelRatio(dpr);
+        pixmap.fill(Qt::transparent);
+
+        QPainter painter(&pixmap);
+        painter.setPen(p_textColor);
+        QPointF offset(-rect.x(), -rect.y());
+        drawBlockBackground(&painter, p_block, offset);
+        p_block.layout()->draw(&painter, offset);
+        bool ready = drawImages(&painter, p_block, offset);
+        drawMarkers(&painter, p_block, offset);
+        painter.end();
+
+        if (!ready) {
+            // Images will be drawn once available.
+            return false;
+        }
+
+        tile = new BlockTile();
+        tile->m_pixmap = pixmap;
+        tile->m_revision = p_block.revision();
+        tile->m_devicePixelRatio = dpr;
+        tile->m_textColor = p_textColor;
+
+        if (!info->m_tileId) {
+            if (++m_lastTileId <= 0) {
+                m_lastTileId = 1;
+            }
+
+            info->m_tileId = m_lastTileId;
+        }
+
+        m_tiles.insert(info->m_tileId, tile, cost);
+    }
+
+    p_painter->drawPixmap(p_offset + rect.topLeft(), tile->m_pixmap);
+    return true;
+}
+
+void VTextDocumentLayout::clearBlockTile(const QTextBlock &p_block)
+{
+    BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    if (info->m_tileId) {
+        m_tiles.remove(info->m_tileId);
+        info->m_tileId = 0;
+    }
+}
+
 QVector<QTextLayout::FormatRange> VTextDocumentLayout::formatRangeFromSelection(const QTextBlock &p_block,
                                                                                 const QVector<Selection> &p_selections) const
 {
@@ -401,9 +441,23 @@ int VTextDocumentLayout::hitTest(const QPointF &p_point, Qt::HitTestAccuracy p_a
 
     QTextBlock block = document()->findBlockByNumber(bn);
     V_ASSERT(block.isValid());
+
+    // Layouting an estimated block may move @p_point into another block.
+    while (const_cast<VTextDocumentLayout *>(this)->ensureBlockLayouted(block)) {
+        bn = findBlockByPosition(p_point);
+        if (bn == -1) {
+            return -1;
+        }
+
+        block = document()->findBlockByNumber(bn);
+    }
+
+    QPointF pos = p_point - QPointF(m_margin, blockOffset(bn));
+    const_cast<VTextDocumentLayout *>(this)->ensureLongLineLayouted(block,
+                                                                    longLinePositionAt(block, pos.y()));
+
     QTextLayout *layout = block.layout();
     int off = 0;
-    QPointF pos = p_point - QPointF(m_margin, VTextBlockData::layoutInfo(block)->top());
     for (int i = 0; i < layout->lineCount(); ++i) {
         QTextLine line = layout->lineAt(i);
         const QRectF lr = line.naturalTextRect();
@@ -445,26 +499,30 @@ QRectF VTextDocumentLayout::blockBoundingRect(const QTextBlock &p_block) const
     }
 
     const BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
-    if (!info->hasOffset()) {
-        if (info->isNull()) {
-            const_cast<VTextDocumentLayout *>(this)->layoutBlockAndUpdateOffset(p_block);
-        } else {
-            const_cast<VTextDocumentLayout *>(this)->updateOffset(p_block);
-        }
+    if (info->isNull()) {
+        const_cast<VTextDocumentLayout *>(this)->layoutBlockAndUpdateHeight(p_block);
+    } else if (info->isEstimated()) {
+        const_cast<VTextDocumentLayout *>(this)->ensureBlockLayouted(p_block);
     }
 
-    QRectF geo = info->m_rect.adjusted(0, info->m_offset, 0, info->m_offset);
+    qreal offset = blockOffset(p_block.blockNumber());
+    QRectF geo = info->m_rect.adjusted(0, offset, 0, offset);
     return geo;
 }
 
 void VTextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_charsAdded)
 {
+    QElapsedTimer timer;
+    timer.start();
+
     QTextDocument *doc = document();
     int newBlockCount = doc->blockCount();
 
     // Update the margin.
     m_margin = doc->documentMargin();
 
+    m_lazyLayout = m_lazyLayoutBlockCount > 0 && newBlockCount >= m_lazyLayoutBlockCount;
+
     int charsChanged = p_charsRemoved + p_charsAdded;
 
     QTextBlock changeStartBlock = doc->findBlock(p_from);
@@ -495,16 +553,22 @@ void VTextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_
             needRelayout = false;
             QRectF oldBr = blockBoundingRect(block);
             clearBlockLayout(block);
-            layoutBlockAndUpdateOffset(block);
+            layoutBlockAndUpdateHeight(block);
             QRectF newBr = blockBoundingRect(block);
+
+            // Update document size.
+            updateDocumentSizeWithOneBlockChanged(block);
+
             // Only one block is affected.
             if (newBr.height() == oldBr.height()) {
-                // Update document size.
-                updateDocumentSizeWithOneBlockChanged(block);
-
                 emit updateBlock(block);
-                return;
+            } else {
+                // The following blocks are moved.
+                emit update(QRectF(0., newBr.top(), 1000000000., 1000000000.));
             }
+
+            recordRelayout(timer);
+            return;
         }
     }
 
@@ -512,7 +576,7 @@ void VTextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_
         QTextBlock block = changeStartBlock;
         do {
             clearBlockLayout(block);
-            layoutBlock(block);
+            layoutOrEstimateBlock(block);
             if (block == changeEndBlock) {
                 break;
             }
@@ -520,7 +584,9 @@ void VTextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_
             block = block.next();
         } while(block.isValid());
 
-        updateOffset(changeStartBlock);
+        int endNumber = changeEndBlock.isValid() ? changeEndBlock.blockNumber()
+                                                 : newBlockCount - 1;
+        updateHeightIndex(changeStartBlock.blockNumber(), endNumber, newBlockCount);
     }
 
     m_blockCount = newBlockCount;
@@ -528,15 +594,17 @@ void VTextDocumentLayout::documentChanged(int p_from, int p_charsRemoved, int p_
     updateDocumentSize();
 
     // TODO: Update the view of all the blocks after changeStartBlock.
-    qreal offset = VTextBlockData::layoutInfo(changeStartBlock)->m_offset;
+    qreal offset = blockOffset(changeStartBlock.blockNumber());
     emit update(QRectF(0., offset, 1000000000., 1000000000.));
+
+    recordRelayout(timer);
 }
 
 // MUST layout out the block after clearBlockLayout().
-// TODO: Do we need to clear all the offset after @p_block?
 void VTextDocumentLayout::clearBlockLayout(QTextBlock &p_block)
 {
     p_block.clearLayout();
+    clearBlockTile(p_block);
     BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
     info->reset();
 }
@@ -598,84 +666,112 @@ void VTextDocumentLayout::layoutBlock(const QTextBlock &p_block)
 
     availableWidth -= (2 * m_margin + extraMargin + m_cursorMargin + m_cursorWidth);
 
+    // Only layout a long block up to the position needed.
+    BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    int textLength = p_block.length() - 1;
+    int layoutEnd = -1;
+    if (m_longLineLength > 0 && textLength >= m_longLineLength) {
+        layoutEnd = info->m_longLineDemand + LONG_LINE_SEGMENT_LENGTH;
+        if (layoutEnd >= textLength) {
+            layoutEnd = -1;
+        }
+    }
+
     QVector<Marker> markers;
     QVector<ImagePaintInfo> images;
 
-    layoutLines(p_block, tl, markers, images, availableWidth, 0);
+    layoutLines(p_block, tl, markers, images, availableWidth, 0, layoutEnd);
+
+    // Estimate the rest of a partially layouted block by the layouted lines.
+    int lineCount = tl->lineCount();
+    int layoutedLength = -1;
+    int restLineCount = 0;
+    qreal restHeight = 0;
+    if (layoutEnd != -1 && lineCount > 0) {
+        QTextLine line = tl->lineAt(lineCount - 1);
+        int end = line.textStart() + line.textLength();
+        if (end < textLength) {
+            layoutedLength = end;
+            qreal charsPerLine = qMax((qreal)end / lineCount, (qreal)1);
+            restLineCount = qCeil((textLength - end) / charsPerLine);
+            restHeight = restLineCount * (line.height() + m_lineLeading);
+        }
+    }
 
     // Set this block's line count to its layout's line count.
     // That is one block may occupy multiple visual lines.
-    const_cast<QTextBlock&>(p_block).setLineCount(p_block.isVisible() ? tl->lineCount() : 0);
+    const_cast<QTextBlock&>(p_block).setLineCount(p_block.isVisible() ? lineCount + restLineCount : 0);
 
     // Update the info about this block.
-    finishBlockLayout(p_block, markers, images);
+    finishBlockLayout(p_block, markers, images, restHeight);
+    info->m_layoutedLength = layoutedLength;
 }
 
-void VTextDocumentLayout::updateOffsetBefore(const QTextBlock &p_block)
+void VTextDocumentLayout::updateBlockHeight(const QTextBlock &p_block)
 {
-    BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    // The index will be rebuilt if it is out of sync.
+    if (m_heightIndex.size() != document()->blockCount()) {
+        return;
+    }
+
+    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
     V_ASSERT(!info->isNull());
+    m_heightIndex.setHeight(p_block.blockNumber(), info->m_rect.height());
+}
 
-    const int blockNum = p_block.blockNumber();
-    if (blockNum == 0) {
-        info->m_offset = 0;
-    } else {
-        QTextBlock blk = p_block.previous();
-        while (blk.isValid()) {
-            BlockLayoutInfo *pinfo = VTextBlockData::layoutInfo(blk);
-            if (!pinfo->hasOffset()) {
-                int num = blk.blockNumber();
-                if (pinfo->isNull()) {
-                    layoutBlock(blk);
-                }
+void VTextDocumentLayout::updateHeightIndex(int p_first, int p_last, int p_newBlockCount)
+{
+    // Blocks [p_first, p_last] replace the old ones of the same range start.
+    int added = p_last - p_first + 1;
+    int removed = added - (p_newBlockCount - m_blockCount);
+    if (m_heightIndex.size() != m_blockCount
+        || removed < 0
+        || p_first + removed > m_blockCount) {
+        rebuildHeightIndex();
+        return;
+    }
 
-                if (num == 0) {
-                    pinfo->m_offset = 0;
-                } else {
-                    blk = blk.previous();
-                    continue;
-                }
-            }
+    QVector<qreal> heights;
+    heights.reserve(added);
+    QTextBlock block = document()->findBlockByNumber(p_first);
+    for (int i = 0; i < added && block.isValid(); ++i) {
+        const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
+        V_ASSERT(!info->isNull());
+        heights.append(info->m_rect.height());
+        block = block.next();
+    }
 
-            // Now we reach a block with offset.
-            qreal offset = pinfo->bottom();
-            blk = blk.next();
-            while (blk.isValid() && blk.blockNumber() <= blockNum) {
-                BlockLayoutInfo *ninfo = VTextBlockData::layoutInfo(blk);
-                V_ASSERT(!ninfo->isNull());
-                ninfo->m_offset = offset;
-                offset = ninfo->bottom();
-                blk = blk.next();
-            }
+    m_heightIndex.replace(p_first, removed, heights);
+}
 
-            break;
+void VTextDocumentLayout::rebuildHeightIndex()
+{
+    QVector<qreal> heights;
+    heights.reserve(document()->blockCount());
+    QTextBlock block = document()->firstBlock();
+    while (block.isValid()) {
+        const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
+        if (info->isNull()) {
+            layoutOrEstimateBlock(block);
         }
 
-        V_ASSERT(info->hasOffset());
+        heights.append(info->m_rect.height());
+        block = block.next();
     }
+
+    m_heightIndex.reset(heights);
 }
 
-// NOTICE: It will skip non-layouted or offset-non-changed blocks.
-// So if you relayout separated blocks, you need to updateOffsetAfter() for each of them.
-void VTextDocumentLayout::updateOffsetAfter(const QTextBlock &p_block)
+qreal VTextDocumentLayout::blockOffset(int p_blockNumber) const
 {
-    BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
-    V_ASSERT(info->hasOffset());
-    qreal offset = info->bottom();
-    QTextBlock blk = p_block.next();
-    while (blk.isValid()) {
-        BlockLayoutInfo *ninfo = VTextBlockData::layoutInfo(blk);
-        if (ninfo->isNull()) {
-            break;
-        }
-
-        if (realEqual(ninfo->m_offset, offset)) {
-            break;
-        }
+    ensureHeightIndex();
+    return m_heightIndex.offset(p_blockNumber);
+}
 
-        ninfo->m_offset = offset;
-        offset = ninfo->bottom();
-        blk = blk.next();
+void VTextDocumentLayout::ensureHeightIndex() const
+{
+    if (m_heightIndex.size() != document()->blockCount()) {
+        const_cast<VTextDocumentLayout *>(this)->rebuildHeightIndex();
     }
 }
 
@@ -684,7 +780,8 @@ qreal VTextDocumentLayout::layoutLines(const QTextBlock &p_block,
                                        QVector<Marker> &p_markers,
                                        QVector<ImagePaintInfo> &p_images,
                                        qreal p_availableWidth,
-                                       qreal p_height)
+                                       qreal p_height,
+                                       int p_layoutEnd)
 {
     V_ASSERT(p_block.isValid());
 
@@ -741,6 +838,10 @@ qreal VTextDocumentLayout::layoutLines(const QTextBlock &p_block,
 
         line.setPosition(QPointF(m_margin, p_height));
         p_height += line.height();
+
+        if (p_layoutEnd != -1 && line.textStart() + line.textLength() >= p_layoutEnd) {
+            break;
+        }
     }
 
     p_tl->endLayout();
@@ -781,14 +882,15 @@ void VTextDocumentLayout::layoutInlineImage(const VPreviewedImageInfo *p_info,
 
 void VTextDocumentLayout::finishBlockLayout(const QTextBlock &p_block,
                                             const QVector<Marker> &p_markers,
-                                            const QVector<ImagePaintInfo> &p_images)
+                                            const QVector<ImagePaintInfo> &p_images,
+                                            qreal p_restHeight)
 {
     V_ASSERT(p_block.isValid());
     ImagePaintInfo ipi;
     BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
     V_ASSERT(info->isNull());
     info->reset();
-    info->m_rect = blockRectFromTextLayout(p_block, &ipi);
+    info->m_rect = blockRectFromTextLayout(p_block, &ipi, p_restHeight);
     V_ASSERT(!info->m_rect.isNull());
 
     bool hasImage = false;
@@ -815,28 +917,253 @@ void VTextDocumentLayout::finishBlockLayout(const QTextBlock &p_block,
     }
 }
 
-void VTextDocumentLayout::updateDocumentSize()
+void VTextDocumentLayout::estimateBlock(const QTextBlock &p_block)
 {
-    QTextBlock block = document()->lastBlock();
-    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
-    if (!info->hasOffset()) {
-        if (info->isNull()) {
+    V_ASSERT(p_block.isValid());
+    BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    V_ASSERT(info->isNull());
+
+    QTextDocument *doc = document();
+    qreal availableWidth = doc->pageSize().width();
+    if (availableWidth <= 0) {
+        availableWidth = qreal(INT_MAX);
+    }
+
+    availableWidth -= (2 * m_margin + m_cursorMargin + m_cursorWidth);
+
+    QFontMetricsF fm(doc->defaultFont());
+    qreal textWidth = fm.averageCharWidth() * (p_block.length() - 1);
+    int lineCount = 1;
+    if (availableWidth > 0 && textWidth > availableWidth) {
+        lineCount = qCeil(textWidth / availableWidth);
+        textWidth = availableWidth;
+    }
+
+    qreal width = textWidth + 2 * m_margin + m_cursorWidth;
+    qreal height = lineCount * (fm.height() + m_lineLeading);
+
+    // Block image, which may contribute most of the height.
+    if (m_blockImageEnabled) {
+        const QVector<VPreviewInfo *> &previews = VTextBlockData::blockData(p_block)->getPreviews();
+        if (previews.size() == 1 && !previews.first()->m_imageInfo.m_inline) {
+            int padding;
+            QSize size;
+            adjustImagePaddingAndSize(&previews.first()->m_imageInfo, textWidth, padding, size);
+            width = qMax(width, padding + size.width() + 2 * m_margin + m_cursorWidth);
+            height += size.height() + m_lineLeading;
+        }
+    }
+
+    // Add bottom margin.
+    if (!p_block.next().isValid()) {
+        height += m_margin;
+    }
+
+    info->reset();
+    info->m_rect = QRectF(0, 0, width, height);
+    info->m_estimated = true;
+
+    const_cast<QTextBlock &>(p_block).setLineCount(p_block.isVisible() ? lineCount : 0);
+}
+
+bool VTextDocumentLayout::ensureBlockLayouted(const QTextBlock &p_block)
+{
+    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    if (!info->isEstimated()) {
+        return false;
+    }
+
+    return relayoutBlockInPlace(p_block);
+}
+
+bool VTextDocumentLayout::relayoutBlockInPlace(const QTextBlock &p_block)
+{
+    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    qreal oldHeight = info->m_rect.height();
+
+    QTextBlock block = p_block;
+    clearBlockLayout(block);
+    layoutBlock(block);
+
+    bool sizeChanged = false;
+    if (info->m_rect.width() > m_width) {
+        m_width = info->m_rect.width();
+        m_maximumWidthBlockNumber = block.blockNumber();
+        sizeChanged = true;
+    }
+
+    qreal delta = info->m_rect.height() - oldHeight;
+    bool heightChanged = !realEqual(delta, 0);
+    if (heightChanged) {
+        updateBlockHeight(block);
+
+        m_height += delta;
+        sizeChanged = true;
+
+        emit update(QRectF(0., blockOffset(block.blockNumber()), 1000000000., 1000000000.));
+    }
+
+    if (sizeChanged) {
+        emit documentSizeChanged(documentSize());
+    }
+
+    return heightChanged;
+}
+
+void VTextDocumentLayout::ensureBlocksLayoutedInRect(const QRectF &p_rect)
+{
+    // Layouting blocks changes their heights and then the blocks within
+    // @p_rect, so repeat until it is stable.
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        int first, last;
+        blockRangeFromRectBS(p_rect, first, last);
+        if (first == -1) {
+            return;
+        }
+
+        QTextBlock block = document()->findBlockByNumber(first);
+        while (block.isValid() && block.blockNumber() <= last) {
+            if (ensureBlockLayouted(block)) {
+                changed = true;
+            } else {
+                int pos = block.length();
+                if (!p_rect.isNull()) {
+                    pos = longLinePositionAt(block, p_rect.bottom() - blockOffset(block.blockNumber()));
+                }
+
+                if (ensureLongLineLayouted(block, pos)) {
+                    changed = true;
+                }
+            }
+
+            block = block.next();
+        }
+    }
+}
+
+int VTextDocumentLayout::layoutEstimatedBlocks(int p_first, int p_last)
+{
+    if (m_lazyLayout) {
+        return p_last + 1;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    int firstChanged = -1;
+    QTextBlock block = document()->findBlockByNumber(p_first);
+    while (block.isValid()) {
+        int blockNum = block.blockNumber();
+        if (blockNum > p_last) {
+            break;
+        }
+
+        if (firstChanged != -1 && timer.elapsed() >= ESTIMATED_LAYOUT_FRAME_BUDGET) {
+            break;
+        }
+
+        if (VTextBlockData::layoutInfo(block)->isEstimated()) {
+            clearBlockLayout(block);
             layoutBlock(block);
+            updateBlockHeight(block);
+
+            if (firstChanged == -1) {
+                firstChanged = blockNum;
+            }
         }
 
-        updateOffsetBefore(block);
+        block = block.next();
     }
 
+    if (firstChanged != -1) {
+        updateDocumentSize();
+
+        emit update(QRectF(0., blockOffset(firstChanged), 1000000000., 1000000000.));
+
+        recordRelayout(timer);
+    }
+
+    return block.isValid() ? block.blockNumber() : p_last + 1;
+}
+
+bool VTextDocumentLayout::ensureLongLineLayouted(const QTextBlock &p_block, int p_pos)
+{
+    BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    if (info->isNull()
+        || info->isEstimated()
+        || info->m_layoutedLength == -1
+        || p_pos < info->m_layoutedLength) {
+        return false;
+    }
+
+    info->m_longLineDemand = p_pos;
+    return relayoutBlockInPlace(p_block);
+}
+
+int VTextDocumentLayout::longLinePositionAt(const QTextBlock &p_block, qreal p_y) const
+{
+    const BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
+    QTextLayout *tl = p_block.layout();
+    int lineCount = tl->lineCount();
+    if (info->m_layoutedLength == -1 || lineCount == 0) {
+        return 0;
+    }
+
+    QTextLine line = tl->lineAt(lineCount - 1);
+    qreal bottom = line.y() + line.height();
+    if (p_y <= bottom) {
+        return 0;
+    }
+
+    qreal charsPerLine = qMax((qreal)info->m_layoutedLength / lineCount, (qreal)1);
+    int lines = qCeil((p_y - bottom) / (line.height() + m_lineLeading));
+    return info->m_layoutedLength + qCeil(lines * charsPerLine);
+}
+
+void VTextDocumentLayout::ensurePositionLayouted(int p_position)
+{
+    if (m_longLineLength <= 0) {
+        return;
+    }
+
+    QTextBlock block = document()->findBlock(p_position);
+    if (!block.isValid() || block.length() - 1 < m_longLineLength) {
+        return;
+    }
+
+    int pos = p_position - block.position();
+    BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
+    if (info->isNull()
+        || info->isEstimated()
+        || info->m_layoutedLength == -1
+        || pos < info->m_layoutedLength) {
+        // Lower the demand so the next relayout of it layouts less.
+        info->m_longLineDemand = pos;
+        return;
+    }
+
+    if (!ensureLongLineLayouted(block, pos)) {
+        emit updateBlock(block);
+    }
+}
+
+void VTextDocumentLayout::updateDocumentSize()
+{
+    ensureHeightIndex();
+
     int oldHeight = m_height;
     int oldWidth = m_width;
 
-    m_height = info->bottom();
+    m_height = m_heightIndex.total();
 
     m_width = 0;
     QTextBlock blk = document()->firstBlock();
     while (blk.isValid()) {
         const BlockLayoutInfo *ninfo = VTextBlockData::layoutInfo(blk);
-        V_ASSERT(ninfo->hasOffset());
+        V_ASSERT(!ninfo->isNull());
         if (m_width < ninfo->m_rect.width()) {
             m_width = ninfo->m_rect.width();
             m_maximumWidthBlockNumber = blk.blockNumber();
@@ -852,7 +1179,8 @@ void VTextDocumentLayout::updateDocumentSize()
 }
 
 QRectF VTextDocumentLayout::blockRectFromTextLayout(const QTextBlock &p_block,
-                                                    ImagePaintInfo *p_image)
+                                                    ImagePaintInfo *p_image,
+                                                    qreal p_restHeight)
 {
     if (p_image) {
         *p_image = ImagePaintInfo();
@@ -871,6 +1199,8 @@ QRectF VTextDocumentLayout::blockRectFromTextLayout(const QTextBlock &p_block,
         br.setWidth(qMax(br.width(), tl->lineAt(0).naturalTextWidth()));
     }
 
+    br.adjust(0, 0, 0, p_restHeight);
+
     // Handle block non-inline image.
     if (m_blockImageEnabled) {
         VTextBlockData *blockData = VTextBlockData::blockData(p_block);
@@ -916,13 +1246,28 @@ void VTextDocumentLayout::updateDocumentSizeWithOneBlockChanged(const QTextBlock
 {
     const BlockLayoutInfo *info = VTextBlockData::layoutInfo(p_block);
     qreal width = info->m_rect.width();
+    if (width < m_width && p_block.blockNumber() == m_maximumWidthBlockNumber) {
+        // Shrink the longest block.
+        updateDocumentSize();
+        return;
+    }
+
+    bool changed = false;
     if (width > m_width) {
         m_width = width;
         m_maximumWidthBlockNumber = p_block.blockNumber();
+        changed = true;
+    }
+
+    ensureHeightIndex();
+    qreal height = m_heightIndex.total();
+    if (!realEqual(height, m_height)) {
+        m_height = height;
+        changed = true;
+    }
+
+    if (changed) {
         emit documentSizeChanged(documentSize());
-    } else if (width < m_width && p_block.blockNumber() == m_maximumWidthBlockNumber) {
-        // Shrink the longest block.
-        updateDocumentSize();
     }
 }
 
@@ -980,26 +1325,30 @@ void VTextDocumentLayout::adjustImagePaddingAndSize(const VPreviewedImageInfo *p
     }
 }
 
-void VTextDocumentLayout::drawImages(QPainter *p_painter,
+bool VTextDocumentLayout::drawImages(QPainter *p_painter,
                                      const QTextBlock &p_block,
                                      const QPointF &p_offset)
 {
     const QVector<ImagePaintInfo> &images = VTextBlockData::layoutInfo(p_block)->m_images;
     if (images.isEmpty()) {
-        return;
+        return true;
     }
 
+    bool ready = true;
+    qreal dpr = p_painter->device()->devicePixelRatioF();
     for (auto const & img : images) {
-        const QPixmap *image = m_imageMgr->findImage(img.m_name);
-        if (!image) {
-            continue;
-        }
-
         QRect targetRect = img.m_rect.adjusted(p_offset.x(),
                                                p_offset.y(),
                                                p_offset.x(),
                                                p_offset.y()).toRect();
 
+        // Draw the level closest to the target to save the scaling.
+        const QPixmap *image = m_imageMgr->findImage(img.m_name, targetRect.size() * dpr);
+        if (!image) {
+            ready = false;
+            continue;
+        }
+
         // Qt do not render the background of some SVGs.
         // We add a forced background mechanism to complement this.
         if (img.hasForcedBackground()) {
@@ -1008,6 +1357,8 @@ void VTextDocumentLayout::drawImages(QPainter *p_painter,
 
         p_painter->drawPixmap(targetRect, *image);
     }
+
+    return ready;
 }
 
 
@@ -1033,24 +1384,34 @@ void VTextDocumentLayout::drawMarkers(QPainter *p_painter,
 
 void VTextDocumentLayout::relayout()
 {
+    QElapsedTimer timer;
+    timer.start();
+
     QTextDocument *doc = document();
 
     // Update the margin.
     m_margin = doc->documentMargin();
 
+    m_lazyLayout = m_lazyLayoutBlockCount > 0 && doc->blockCount() >= m_lazyLayoutBlockCount;
+
+    QVector<qreal> heights;
+    heights.reserve(doc->blockCount());
     QTextBlock block = doc->firstBlock();
     while (block.isValid()) {
         clearBlockLayout(block);
-        layoutBlock(block);
+        layoutOrEstimateBlock(block);
+        heights.append(VTextBlockData::layoutInfo(block)->m_rect.height());
 
         block = block.next();
     }
 
-    updateOffset(doc->firstBlock());
+    m_heightIndex.reset(heights);
 
     updateDocumentSize();
 
     emit update(QRectF(0., 0., 1000000000., 1000000000.));
+
+    recordRelayout(timer);
 }
 
 void VTextDocumentLayout::relayout(const OrderedIntSet &p_blocks)
@@ -1059,6 +1420,9 @@ void VTextDocumentLayout::relayout(const OrderedIntSet &p_blocks)
         return;
     }
 
+    QElapsedTimer timer;
+    timer.start();
+
     QTextDocument *doc = document();
 
     // Need to relayout and update blocks in ascending order.
@@ -1068,8 +1432,16 @@ void VTextDocumentLayout::relayout(const OrderedIntSet &p_blocks)
         QTextBlock block = doc->findBlockByNumber(*bn);
         if (block.isValid()) {
             blocks.append(block);
+
+            // Keep estimated blocks estimated.
+            const BlockLayoutInfo *info = VTextBlockData::layoutInfo(block);
+            bool layouted = !info->isNull() && !info->isEstimated();
             clearBlockLayout(block);
-            layoutBlock(block);
+            if (layouted) {
+                layoutBlock(block);
+            } else {
+                layoutOrEstimateBlock(block);
+            }
         }
     }
 
@@ -1077,17 +1449,16 @@ void VTextDocumentLayout::relayout(const OrderedIntSet &p_blocks)
         return;
     }
 
-    // Need to update offset for each of these discontinuous blocks, because
-    // the offset of the non-touched blocks may be the same but there are still
-    // touched blocks after them.
     for (auto & blk : blocks) {
-        updateOffset(blk);
+        updateBlockHeight(blk);
     }
 
     updateDocumentSize();
 
-    qreal offset = VTextBlockData::layoutInfo(blocks.first())->m_offset;
+    qreal offset = blockOffset(blocks.first().blockNumber());
     emit update(QRectF(0., offset, 1000000000., 1000000000.));
+
+    recordRelayout(timer);
 }
 
 qreal VTextDocumentLayout::fetchInlineImagesForOneLine(const QVector<VPreviewInfo *> &p_info,
@@ -1202,6 +1573,19 @@ void VTextDocumentLayout::updateBlockByNumber(int p_blockNumber)
 
     QTextBlock block = document()->findBlockByNumber(p_blockNumber);
     if (block.isValid()) {
+        clearBlockTile(block);
         emit updateBlock(block);
     }
 }
+
+void VTextDocumentLayout::setLatencyStats(VLatencyStats *p_stats)
+{
+    m_latencyStats = p_stats;
+}
+
+void VTextDocumentLayout::recordRelayout(const QElapsedTimer &p_timer)
+{
+    if (m_latencyStats) {
+        m_latencyStats->record(VLatencyStats::Relayout, p_timer.nsecsElapsed() / 1000);
+    }
+}
@@ -5,11 +5,16 @@
 #include <QVector>
 #include <QSize>
 #include <QMap>
+#include <QElapsedTimer>
+#include <QCache>
+#include <QPixmap>
 
 #include "vconstants.h"
 #include "vtextdocumentlayoutdata.h"
+#include "vblockheightindex.h"
 
 class VImageResourceManager2;
+class VLatencyStats;
 struct VPreviewedImageInfo;
 struct VPreviewInfo;
 
@@ -79,6 +84,34 @@ public:
 
     void setExtraBufferHeight(int p_height);
 
+    // Record the relayout time into @p_stats.
+    void setLatencyStats(VLatencyStats *p_stats);
+
+    // Only estimate the height of blocks when layouting a document with at
+    // least @p_count blocks. Estimated blocks are layouted when they are drawn
+    // or queried.
+    // 0 to disable it.
+    void setLazyLayoutBlockCount(int p_count);
+
+    // Only layout the lines in sight of blocks with at least @p_length
+    // characters, estimating the height of the rest.
+    // 0 to disable it.
+    void setLongLineLength(int p_length);
+
+    // Make sure the lines of the long block containing @p_position are
+    // layouted up to it.
+    void ensurePositionLayouted(int p_position);
+
+    // Estimate the blocks instead of layouting them when they are changed,
+    // such as by a font change. Estimated blocks are layouted when they are
+    // drawn or queried, or by layoutEstimatedBlocks().
+    void setForceEstimate(bool p_enabled);
+
+    // Layout the estimated blocks within [@p_first, @p_last] until the frame
+    // budget is used up. Estimated blocks are kept in lazy mode.
+    // Returns the block number to resume from.
+    int layoutEstimatedBlocks(int p_first, int p_last);
+
 signals:
     // Emit to update current cursor block width if m_cursorBlockMode is enabled.
     void cursorBlockWidthUpdated(int p_width);
@@ -88,29 +121,69 @@ protected:
 
 private:
     // Layout one block.
-    // Only update the rect of the block. Offset is not updated yet.
+    // Only update the rect of the block. Height index is not updated yet.
     void layoutBlock(const QTextBlock &p_block);
 
-    // Update the offset of @p_block.
+    // Update the height of @p_block in the height index.
     // @p_block has a valid layout.
-    // After the call, all block before @p_block will have the correct layout and offset.
-    void updateOffsetBefore(const QTextBlock &p_block);
+    void updateBlockHeight(const QTextBlock &p_block);
+
+    void layoutBlockAndUpdateHeight(const QTextBlock &p_block);
+
+    // Update the height index after blocks [@p_first, @p_last] are changed
+    // and the block count becomes @p_newBlockCount.
+    void updateHeightIndex(int p_first, int p_last, int p_newBlockCount);
+
+    // Rebuild the height index from all the blocks, layouting the null ones.
+    void rebuildHeightIndex();
+
+    // Rebuild the height index if it is out of sync with the document.
+    void ensureHeightIndex() const;
+
+    // Y offset of block @p_blockNumber.
+    qreal blockOffset(int p_blockNumber) const;
+
+    // Estimate the rect of @p_block by its length without layouting the lines.
+    void estimateBlock(const QTextBlock &p_block);
 
-    // Update the offset of blocks after @p_block if they are layouted.
-    void updateOffsetAfter(const QTextBlock &p_block);
+    // Estimate @p_block in lazy mode, otherwise layout it.
+    void layoutOrEstimateBlock(const QTextBlock &p_block);
 
-    void updateOffset(const QTextBlock &p_block);
+    // Layout @p_block if it is estimated, correcting the height index and
+    // the document size.
+    // Returns true if the height of @p_block changes.
+    bool ensureBlockLayouted(const QTextBlock &p_block);
 
-    void layoutBlockAndUpdateOffset(const QTextBlock &p_block);
+    // Layout all the estimated blocks within @p_rect.
+    void ensureBlocksLayoutedInRect(const QRectF &p_rect);
+
+    // Layout long block @p_block up to position @p_pos within it if its
+    // lines do not reach there yet.
+    // Returns true if the height of @p_block changes.
+    bool ensureLongLineLayouted(const QTextBlock &p_block, int p_pos);
+
+    // Estimate the position at @p_y within partially layouted @p_block.
+    // Returns 0 if @p_y is within the layouted lines.
+    int longLinePositionAt(const QTextBlock &p_block, qreal p_y) const;
+
+    // Layout @p_block again, correcting the height index and the document size.
+    // Returns true if the height of @p_block changes.
+    bool relayoutBlockInPlace(const QTextBlock &p_block);
+
+    // Record the time since @p_timer started.
+    void recordRelayout(const QElapsedTimer &p_timer);
 
     // Returns the total height of this block after layouting lines and inline
     // images.
+    // @p_layoutEnd: stop once the lines cover this number of characters. -1
+    // to layout all the lines.
     qreal layoutLines(const QTextBlock &p_block,
                       QTextLayout *p_tl,
                       QVector<Marker> &p_markers,
                       QVector<ImagePaintInfo> &p_images,
                       qreal p_availableWidth,
-                      qreal p_height);
+                      qreal p_height,
+                      int p_layoutEnd = -1);
 
     // Layout inline image in a line.
     // @p_info: if NULL, means just layout a marker.
@@ -136,36 +209,36 @@ private:
                                       QVector<QPair<qreal, qreal>> &p_imageRange);
 
     // Clear the layout of @p_block.
-    // Also clear all the offset behind this block.
     void clearBlockLayout(QTextBlock &p_block);
 
     // Update rect of a block.
+    // @p_restHeight: estimated height of the text not layouted.
     void finishBlockLayout(const QTextBlock &p_block,
                            const QVector<Marker> &p_markers,
-                           const QVector<ImagePaintInfo> &p_images);
+                           const QVector<ImagePaintInfo> &p_images,
+                           qreal p_restHeight = 0);
 
     void updateDocumentSize();
 
     QVector<QTextLayout::FormatRange> formatRangeFromSelection(const QTextBlock &p_block,
                                                                const QVector<Selection> &p_selections) const;
 
-    // Get the block range [first, last] by rect @p_rect.
+    // Get the block range [first, last] by rect @p_rect via the height index.
     // @p_rect: a clip region in document coordinates. If null, returns all the blocks.
     // Return [-1, -1] if no valid block range found.
-    void blockRangeFromRect(const QRectF &p_rect, int &p_first, int &p_last) const;
-
-    // Binary search to get the block range [first, last] by @p_rect.
     void blockRangeFromRectBS(const QRectF &p_rect, int &p_first, int &p_last) const;
 
     // Return a rect from the layout.
     // If @p_imageRect is not NULL and there is block image for this block, it will
     // be set to the rect of that image.
     // Return a null rect if @p_block has not been layouted.
+    // @p_restHeight: estimated height of the text not layouted, which is put
+    // below the lines.
     QRectF blockRectFromTextLayout(const QTextBlock &p_block,
-                                   ImagePaintInfo *p_image = NULL);
+                                   ImagePaintInfo *p_image = NULL,
+                                   qreal p_restHeight = 0);
 
-    // Update document size when only @p_block is changed and the height
-    // remains the same.
+    // Update document size when only @p_block is changed.
     void updateDocumentSizeWithOneBlockChanged(const QTextBlock &p_block);
 
     void adjustImagePaddingAndSize(const VPreviewedImageInfo *p_info,
@@ -175,7 +248,8 @@ private:
 
     // Draw images of block @p_block.
     // @p_offset: the offset for the drawing of the block.
-    void drawImages(QPainter *p_painter,
+    // Returns false if some images are not available.
+    bool drawImages(QPainter *p_painter,
                     const QTextBlock &p_block,
                     const QPointF &p_offset);
 
@@ -183,6 +257,22 @@ private:
                      const QTextBlock &p_block,
                      const QPointF &p_offset);
 
+    // Draw the background of @p_block.
+    void drawBlockBackground(QPainter *p_painter,
+                             const QTextBlock &p_block,
+                             const QPointF &p_offset);
+
+    // Draw @p_block from its tile, painting the tile first if needed.
+    // Returns false if the tile is not available, in which case the block
+    // should be drawn as usual.
+    bool drawBlockTile(QPainter *p_painter,
+                       const QTextBlock &p_block,
+                       const QPointF &p_offset,
+                       const QColor &p_textColor);
+
+    // Drop the tile of @p_block.
+    void clearBlockTile(const QTextBlock &p_block);
+
     void scaleSize(QSize &p_size, int p_width, int p_height);
 
     // Get text length in pixel.
@@ -201,6 +291,10 @@ private:
     // Height of all the document (all the blocks, excluding m_extraBufferHeight).
     qreal m_height;
 
+    // Heights of all the blocks to get the offset of a block or the block at
+    // an offset in O(log n).
+    VBlockHeightIndex m_heightIndex;
+
     // Set the leading space of a line.
     qreal m_lineLeading;
 
@@ -242,6 +336,38 @@ private:
 
     // Extra buffer height in document size.
     int m_extraBufferHeight;
+
+    VLatencyStats *m_latencyStats;
+
+    // Minimum block count to enter lazy mode. 0 to disable.
+    int m_lazyLayoutBlockCount;
+
+    // Whether estimate blocks instead of layouting them.
+    bool m_lazyLayout;
+
+    // Whether estimate blocks regardless of the block count.
+    bool m_forceEstimate;
+
+    // Minimum length of a block to only layout its lines in sight. 0 to disable.
+    int m_longLineLength;
+
+    // Painted block, reused until the block is changed or layouted again.
+    struct BlockTile
+    {
+        QPixmap m_pixmap;
+
+        int m_revision;
+
+        qreal m_devicePixelRatio;
+
+        QColor m_textColor;
+    };
+
+    // Tiles of blocks with images, keyed by BlockLayoutInfo::m_tileId.
+    // The cost is in KB.
+    QCache<int, BlockTile> m_tiles;
+
+    int m_lastTileId;
 };
 
 inline qreal VTextDocumentLayout::getLineLeading() const
@@ -251,7 +377,10 @@ inline qreal VTextDocumentLayout::getLineLeading() const
 
 inline void VTextDocumentLayout::setImageLineColor(const QColor &p_color)
 {
-    m_imageLineColor = p_color;
+    if (m_imageLineColor != p_color) {
+        m_imageLineColor = p_color;
+        m_tiles.clear();
+    }
 }
 
 inline void VTextDocumentLayout::scaleSize(QSize &p_size, int p_width, int p_height)
@@ -319,16 +448,34 @@ inline int VTextDocumentLayout::cursorWidth() const
     return m_cursorWidth;
 }
 
-inline void VTextDocumentLayout::layoutBlockAndUpdateOffset(const QTextBlock &p_block)
+inline void VTextDocumentLayout::setLazyLayoutBlockCount(int p_count)
 {
-    layoutBlock(p_block);
-    updateOffset(p_block);
+    m_lazyLayoutBlockCount = p_count;
 }
 
-inline void VTextDocumentLayout::updateOffset(const QTextBlock &p_block)
+inline void VTextDocumentLayout::setForceEstimate(bool p_enabled)
 {
-    updateOffsetBefore(p_block);
-    updateOffsetAfter(p_block);
+    m_forceEstimate = p_enabled;
+}
+
+inline void VTextDocumentLayout::setLongLineLength(int p_length)
+{
+    m_longLineLength = p_length;
+}
+
+inline void VTextDocumentLayout::layoutOrEstimateBlock(const QTextBlock &p_block)
+{
+    if (m_lazyLayout || m_forceEstimate) {
+        estimateBlock(p_block);
+    } else {
+        layoutBlock(p_block);
+    }
+}
+
+inline void VTextDocumentLayout::layoutBlockAndUpdateHeight(const QTextBlock &p_block)
+{
+    layoutBlock(p_block);
+    updateBlockHeight(p_block);
 }
 
 inline void VTextDocumentLayout::setExtraBufferHeight(int p_height)
@@ -35,13 +35,18 @@ struct ImagePaintInfo
 struct BlockLayoutInfo
 {
     BlockLayoutInfo()
-        : m_offset(-1)
+        : m_estimated(false),
+          m_layoutedLength(-1),
+          m_longLineDemand(0),
+          m_tileId(0)
     {
     }
 
+    // The tile and the demand of a long line are kept.
     void reset()
     {
-        m_offset = -1;
+        m_estimated = false;
+        m_layoutedLength = -1;
         m_rect = QRectF();
         m_markers.clear();
         m_images.clear();
@@ -52,31 +57,29 @@ struct BlockLayoutInfo
         return m_rect.isNull();
     }
 
-    bool hasOffset() const
+    // Whether the rect is just an estimation without layouting the lines.
+    bool isEstimated() const
     {
-        return m_offset > -1 && !m_rect.isNull();
+        return m_estimated;
     }
 
-    qreal top() const
-    {
-        V_ASSERT(hasOffset());
-        return m_offset;
-    }
-
-    qreal bottom() const
-    {
-        V_ASSERT(hasOffset());
-        return m_offset + m_rect.height();
-    }
-
-    // Y offset of this block.
-    // -1 for invalid.
-    qreal m_offset;
-
     // The bounding rect of this block, including the margins.
     // Null for invalid.
     QRectF m_rect;
 
+    // m_rect is estimated and the block still needs to be layouted before
+    // drawing it.
+    bool m_estimated;
+
+    // Length of the text covered by the lines of a long block which is only
+    // partially layouted, the height of the rest being estimated.
+    // -1 if all the text is layouted.
+    int m_layoutedLength;
+
+    // Position within a long block where the lines are needed up to, which
+    // is kept across relayouts of the block.
+    int m_longLineDemand;
+
     // Markers to draw for this block.
     // Y is the offset within this block.
     QVector<Marker> m_markers;
@@ -84,5 +87,8 @@ struct BlockLayoutInfo
     // Images to draw for this block.
     // Y is the offset within this block.
     QVector<ImagePaintInfo> m_images;
+
+    // ID of the painted tile of this block in the layout. 0 if there is none.
+    int m_tileId;
 };
 #endif // VTEXTDOCUMENTLAYOUTDATA_H
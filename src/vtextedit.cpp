@@ -4,6 +4,7 @@
 #include <QScrollBar>
 #include <QPainter>
 #include <QResizeEvent>
+#include <QTimer>
 
 #include "vimageresourcemanager2.h"
 
@@ -54,6 +55,20 @@ void VTextEdit::init()
 
     m_enableExtraBuffer = false;
 
+    m_lineNumberCursorBlock = -1;
+
+    m_lineNumberOffsetY = 0;
+
+    m_nextEstimatedBlock = 0;
+
+    m_estimatedBlocksLeft = 0;
+
+    m_estimatedLayoutTimer = new QTimer(this);
+    m_estimatedLayoutTimer->setSingleShot(true);
+    m_estimatedLayoutTimer->setInterval(0);
+    connect(m_estimatedLayoutTimer, &QTimer::timeout,
+            this, &VTextEdit::layoutEstimatedBlocks);
+
     m_imageMgr = new VImageResourceManager2();
 
     QTextDocument *doc = document();
@@ -82,15 +97,18 @@ void VTextEdit::init()
     connect(this, &QTextEdit::textChanged,
             this, &VTextEdit::updateLineNumberArea);
     connect(verticalScrollBar(), &QScrollBar::valueChanged,
-            this, &VTextEdit::updateLineNumberArea);
+            this, &VTextEdit::scrollLineNumberArea);
     connect(this, &QTextEdit::cursorPositionChanged,
             this, [this]() {
+                QTextCursor cursor = textCursor();
+                getLayout()->ensurePositionLayouted(cursor.position());
+
+                int blockNumber = cursor.block().blockNumber();
                 if (m_highlightCursorLineBlock) {
-                    QTextCursor cursor = textCursor();
-                    getLayout()->setCursorLineBlockNumber(cursor.block().blockNumber());
+                    getLayout()->setCursorLineBlockNumber(blockNumber);
                 }
 
-                updateLineNumberArea();
+                updateLineNumberAreaForCursor(blockNumber);
             });
 }
 
@@ -146,9 +164,7 @@ void VTextEdit::paintLineNumberArea(QPaintEvent *p_event)
     int bottom = top + (int)rect.height();
     int eventTop = p_event->rect().top();
     int eventBtm = p_event->rect().bottom();
-    const int digitHeight = painter.fontMetrics().height();
     const int curBlockNumber = textCursor().block().blockNumber();
-    painter.setPen(m_lineNumberArea->getForegroundColor());
     const int leading = (int)layout->getLineLeading();
 
     // Display line number only in code block.
@@ -188,13 +204,7 @@ void VTextEdit::paintLineNumberArea(QPaintEvent *p_event)
 
             if (blockState == (int)BlockState::CodeBlock) {
                 if (block.isVisible() && bottom >= eventTop) {
-                    QString numberStr = QString::number(number);
-                    painter.drawText(0,
-                                     top + leading,
-                                     m_lineNumberArea->width(),
-                                     digitHeight,
-                                     Qt::AlignRight | Qt::AlignTop,
-                                     numberStr);
+                    m_lineNumberArea->drawNumber(painter, top + leading, number, false);
                 }
 
                 ++number;
@@ -227,26 +237,7 @@ void VTextEdit::paintLineNumberArea(QPaintEvent *p_event)
                 currentLine = true;
             }
 
-            QString numberStr = QString::number(number);
-
-            if (currentLine) {
-                QFont font = painter.font();
-                font.setBold(true);
-                painter.setFont(font);
-            }
-
-            painter.drawText(0,
-                             top + leading,
-                             m_lineNumberArea->width(),
-                             digitHeight,
-                             Qt::AlignRight | Qt::AlignTop,
-                             numberStr);
-
-            if (currentLine) {
-                QFont font = painter.font();
-                font.setBold(false);
-                painter.setFont(font);
-            }
+            m_lineNumberArea->drawNumber(painter, top + leading, number, currentLine);
         }
 
         block = block.next();
@@ -283,6 +274,70 @@ void VTextEdit::updateLineNumberArea()
     }
 }
 
+void VTextEdit::scrollLineNumberArea()
+{
+    int offset = contentOffsetY();
+    int dy = offset - m_lineNumberOffsetY;
+    m_lineNumberOffsetY = offset;
+
+    if (m_lineNumberType == LineNumberType::None
+        || !m_lineNumberArea->isVisible()
+        || qAbs(dy) >= m_lineNumberArea->height()) {
+        updateLineNumberArea();
+        return;
+    }
+
+    // Numbers do not change with scrolling. Move the painted ones and paint
+    // only the exposed part.
+    if (dy != 0) {
+        m_lineNumberArea->scroll(0, dy);
+    }
+}
+
+void VTextEdit::updateLineNumberAreaForCursor(int p_blockNumber)
+{
+    int lastBlockNumber = m_lineNumberCursorBlock;
+    m_lineNumberCursorBlock = p_blockNumber;
+
+    if (m_lineNumberType == LineNumberType::None || !m_lineNumberArea->isVisible()) {
+        updateLineNumberArea();
+        return;
+    }
+
+    if (lastBlockNumber == p_blockNumber) {
+        return;
+    }
+
+    switch (m_lineNumberType) {
+    case LineNumberType::Absolute:
+        // Only the bold current line number changes.
+        m_lineNumberArea->update(lineNumberRect(lastBlockNumber));
+        m_lineNumberArea->update(lineNumberRect(p_blockNumber));
+        break;
+
+    case LineNumberType::Relative:
+        m_lineNumberArea->update();
+        break;
+
+    default:
+        break;
+    }
+}
+
+QRect VTextEdit::lineNumberRect(int p_blockNumber) const
+{
+    QTextBlock block = document()->findBlockByNumber(p_blockNumber);
+    if (!block.isValid()) {
+        return QRect();
+    }
+
+    QRectF rect = getLayout()->blockBoundingRect(block);
+    return QRect(0,
+                 contentOffsetY() + (int)rect.y(),
+                 m_lineNumberArea->width(),
+                 (int)rect.height() + 1);
+}
+
 int VTextEdit::firstVisibleBlockNumber() const
 {
     VTextDocumentLayout *layout = getLayout();
@@ -320,6 +375,11 @@ int VTextEdit::contentOffsetY() const
     return -(sb->value());
 }
 
+qint64 VTextEdit::imageBytes() const
+{
+    return m_imageMgr->totalBytes();
+}
+
 void VTextEdit::clearBlockImages()
 {
     m_imageMgr->clear();
@@ -353,6 +413,57 @@ void VTextEdit::relayoutVisibleBlocks()
     updateLineNumberArea();
 }
 
+void VTextEdit::setForceEstimate(bool p_enabled)
+{
+    getLayout()->setForceEstimate(p_enabled);
+}
+
+void VTextEdit::layoutEstimatedBlocksLater()
+{
+    m_nextEstimatedBlock = qMax(0, firstVisibleBlockNumber());
+    m_estimatedBlocksLeft = document()->blockCount();
+    m_estimatedLayoutTimer->start();
+}
+
+void VTextEdit::layoutEstimatedBlocks()
+{
+    int nrBlocks = document()->blockCount();
+    if (m_estimatedBlocksLeft <= 0 || nrBlocks <= 0) {
+        return;
+    }
+
+    if (m_nextEstimatedBlock >= nrBlocks) {
+        // Wrap to the blocks above the viewport.
+        m_nextEstimatedBlock = 0;
+    }
+
+    int first = m_nextEstimatedBlock;
+    int last = qMin(nrBlocks - 1, first + m_estimatedBlocksLeft - 1);
+
+    VTextDocumentLayout *layout = getLayout();
+    QTextBlock topBlock = firstVisibleBlock();
+    qreal oldTop = topBlock.isValid() ? layout->blockBoundingRect(topBlock).top() : 0;
+
+    int next = layout->layoutEstimatedBlocks(first, last);
+
+    // Blocks above the viewport may change their heights.
+    if (topBlock.isValid()) {
+        int dy = qRound(layout->blockBoundingRect(topBlock).top() - oldTop);
+        if (dy != 0) {
+            QScrollBar *vbar = verticalScrollBar();
+            vbar->setValue(vbar->value() + dy);
+        }
+    }
+
+    updateLineNumberArea();
+
+    m_nextEstimatedBlock = next;
+    m_estimatedBlocksLeft -= next - first;
+    if (m_estimatedBlocksLeft > 0) {
+        m_estimatedLayoutTimer->start();
+    }
+}
+
 bool VTextEdit::containsImage(const QString &p_imageName) const
 {
     return m_imageMgr->contains(p_imageName);
@@ -360,12 +471,7 @@ bool VTextEdit::containsImage(const QString &p_imageName) const
 
 QSize VTextEdit::imageSize(const QString &p_imageName) const
 {
-    const QPixmap *img = m_imageMgr->findImage(p_imageName);
-    if (img) {
-        return img->size();
-    }
-
-    return QSize();
+    return m_imageMgr->imageSize(p_imageName);
 }
 
 const QPixmap *VTextEdit::findImage(const QString &p_name) const
@@ -380,6 +486,23 @@ void VTextEdit::addImage(const QString &p_imageName, const QPixmap &p_image)
     }
 }
 
+void VTextEdit::addSharedImage(const QString &p_imageName,
+                               const QString &p_key,
+                               const QPixmap &p_image,
+                               const ImageLoaderFunc &p_loader)
+{
+    if (m_blockImageEnabled) {
+        m_imageMgr->addSharedImage(p_imageName, p_key, p_image, p_loader);
+    }
+}
+
+void VTextEdit::addImagePlaceholder(const QString &p_imageName, const QSize &p_size)
+{
+    if (m_blockImageEnabled) {
+        m_imageMgr->addPlaceholder(p_imageName, p_size);
+    }
+}
+
 void VTextEdit::removeImage(const QString &p_imageName)
 {
     m_imageMgr->removeImage(p_imageName);
@@ -449,6 +572,21 @@ void VTextEdit::relayout()
     updateLineNumberArea();
 }
 
+void VTextEdit::setLatencyStats(VLatencyStats *p_stats)
+{
+    getLayout()->setLatencyStats(p_stats);
+}
+
+void VTextEdit::setLazyLayoutBlockCount(int p_count)
+{
+    getLayout()->setLazyLayoutBlockCount(p_count);
+}
+
+void VTextEdit::setLongLineLength(int p_length)
+{
+    getLayout()->setLongLineLength(p_length);
+}
+
 void VTextEdit::setDisplayScaleFactor(qreal p_factor)
 {
     m_defaultCursorWidth = p_factor + 0.5;
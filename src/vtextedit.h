@@ -6,11 +6,13 @@
 
 #include "vlinenumberarea.h"
 #include "vtextdocumentlayout.h"
+#include "vimageresourcemanager2.h"
 
 class VTextDocumentLayout;
 class QPainter;
 class QResizeEvent;
-class VImageResourceManager2;
+class QTimer;
+class VLatencyStats;
 
 
 class VTextEdit : public QTextEdit, public VTextEditWithLineNumber
@@ -43,6 +45,9 @@ public:
 
     void clearBlockImages();
 
+    // Bytes of the images resident in the resource manager.
+    qint64 imageBytes() const;
+
     // Whether the resoruce manager contains image of name @p_imageName.
     bool containsImage(const QString &p_imageName) const;
 
@@ -55,6 +60,16 @@ public:
     // Add an image to the resources.
     void addImage(const QString &p_imageName, const QPixmap &p_image);
 
+    // Add an image referencing image @p_key of VSharedImageCache.
+    // @p_loader could reload the image from its source once evicted.
+    void addSharedImage(const QString &p_imageName,
+                        const QString &p_key,
+                        const QPixmap &p_image,
+                        const ImageLoaderFunc &p_loader);
+
+    // Add a placeholder of @p_size for an image which is not ready yet.
+    void addImagePlaceholder(const QString &p_imageName, const QSize &p_size);
+
     // Remove an image from the resources.
     void removeImage(const QString &p_imageName);
 
@@ -74,8 +89,20 @@ public:
 
     void relayout();
 
+    void setLatencyStats(VLatencyStats *p_stats);
+
+    void setLazyLayoutBlockCount(int p_count);
+
+    void setLongLineLength(int p_length);
+
     void relayoutVisibleBlocks();
 
+    // Estimate the blocks instead of layouting them when they are changed.
+    void setForceEstimate(bool p_enabled);
+
+    // Layout the estimated blocks in idle time, starting from the visible ones.
+    void layoutEstimatedBlocksLater();
+
     void setDisplayScaleFactor(qreal p_factor);
 
     void setEnableExtraBuffer(bool p_enable);
@@ -98,9 +125,23 @@ private slots:
 
     void updateLineNumberArea();
 
+    // Scroll the painted line numbers along with the content.
+    void scrollLineNumberArea();
+
+    // Layout the next chunk of the estimated blocks, keeping the first
+    // visible block in place.
+    void layoutEstimatedBlocks();
+
 private:
     VTextDocumentLayout *getLayout() const;
 
+    // Repaint only the line numbers changed by moving cursor to block
+    // @p_blockNumber.
+    void updateLineNumberAreaForCursor(int p_blockNumber);
+
+    // Rect of the line number of block @p_blockNumber in the line number area.
+    QRect lineNumberRect(int p_blockNumber) const;
+
     VLineNumberArea *m_lineNumberArea;
 
     LineNumberType m_lineNumberType;
@@ -116,6 +157,20 @@ private:
     int m_defaultCursorWidth;
 
     bool m_enableExtraBuffer;
+
+    // Block number of the cursor when line numbers are last updated for it.
+    int m_lineNumberCursorBlock;
+
+    // Content offset when line numbers are last scrolled.
+    int m_lineNumberOffsetY;
+
+    QTimer *m_estimatedLayoutTimer;
+
+    // Block to resume the layout of the estimated blocks from.
+    int m_nextEstimatedBlock;
+
+    // Number of blocks left to check for the layout of the estimated blocks.
+    int m_estimatedBlocksLeft;
 };
 
 inline void VTextEdit::setLineNumberType(LineNumberType p_type)
@@ -1,6 +1,5 @@
 #include "vtexteditcompleter.h"
 
-#include <QStringListModel>
 #include <QStyledItemDelegate>
 #include <QScrollBar>
 #include <QDebug>
@@ -9,6 +8,7 @@
 
 #include "utils/vutils.h"
 #include "veditor.h"
+#include "vcompletionmodel.h"
 #include "vmainwindow.h"
 
 extern VMainWindow *g_mainWin;
@@ -32,9 +32,8 @@ void VTextEditCompleter::performCompletion(const QStringList &p_words,
 
     setWidget(m_editor->getEditor());
 
-    m_model->setStringList(p_words);
-    setCaseSensitivity(p_cs);
-    setCompletionPrefix(p_prefix);
+    m_model->setCandidates(p_words, p_reversed);
+    m_model->setPrefix(p_prefix, p_cs);
 
     int cnt = completionCount();
     if (cnt == 0) {
@@ -68,7 +67,9 @@ void VTextEditCompleter::init()
 
     m_initialized = true;
 
-    m_model = new QStringListModel(this);
+    // The model filters the candidates itself, so the prefix of the completer
+    // is kept empty to list all its rows.
+    m_model = new VCompletionModel(this);
     setModel(m_model);
 
     popup()->setProperty("TextEdit", true);
@@ -273,7 +274,7 @@ void VTextEditCompleter::insertCurrentCompletion()
     if (curIndex.isValid()) {
         completion = currentCompletion();
     } else {
-        completion = completionPrefix();
+        completion = m_model->getPrefix();
     }
 
     insertCompletion(completion);
@@ -291,7 +292,7 @@ void VTextEditCompleter::insertCompletion(const QString &p_completion)
 
 void VTextEditCompleter::cancelCompletion()
 {
-    insertCompletion(completionPrefix());
+    insertCompletion(m_model->getPrefix());
 
     finishCompletion();
 }
@@ -307,7 +308,7 @@ void VTextEditCompleter::cleanUp()
 void VTextEditCompleter::updatePrefix(const QString &p_prefix)
 {
     m_insertedCompletion = p_prefix;
-    setCompletionPrefix(p_prefix);
+    m_model->setPrefix(p_prefix, m_model->getCaseSensitivity());
 
     int cnt = completionCount();
     if (cnt == 0) {
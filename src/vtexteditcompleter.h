@@ -4,7 +4,7 @@
 #include <QCompleter>
 #include <QAbstractItemView>
 
-class QStringListModel;
+class VCompletionModel;
 class VEditor;
 
 class VTextEditCompleter : public QCompleter
@@ -49,7 +49,7 @@ private:
 
     bool m_initialized;
 
-    QStringListModel *m_model;
+    VCompletionModel *m_model;
 
     VEditor *m_editor;
 
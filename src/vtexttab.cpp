@@ -0,0 +1,374 @@
+#include <QtWidgets>
+#include <QFileInfo>
+#include "vtexttab.h"
+#include "vplaintextedit.h"
+#include "vviewporthighlighter.h"
+#include "utils/vutils.h"
+#include "vconfigmanager.h"
+#include "veditarea.h"
+#include "vsearch.h"
+
+extern VConfigManager *g_config;
+
+VTextTab::VTextTab(VFile *p_file, VEditArea *p_editArea,
+                   OpenFileMode p_mode, QWidget *p_parent)
+    : VEditTab(p_file, p_editArea, p_parent)
+{
+    V_ASSERT(m_file->getDocType() == DocType::Text);
+
+    m_file->open();
+
+    setupUI();
+
+    if (p_mode == OpenFileMode::Edit) {
+        showFileEditMode();
+    } else {
+        showFileReadMode();
+    }
+}
+
+void VTextTab::setupUI()
+{
+    m_editor = new VPlainTextEdit(this);
+    m_editor->setFont(g_config->getBaseEditFont());
+    m_editor->setPalette(g_config->getBaseEditPalette());
+
+    int lineNumber = g_config->getEditorLineNumber();
+    if (lineNumber < (int)LineNumberType::None || lineNumber >= (int)LineNumberType::Invalid) {
+        lineNumber = (int)LineNumberType::None;
+    }
+
+    m_editor->setLineNumberType((LineNumberType)lineNumber);
+    m_editor->setLineNumberColor(g_config->getEditorLineNumberFg(),
+                                 g_config->getEditorLineNumberBg());
+
+    // Only the blocks shown are laid out and highlighted.
+    new VViewportHighlighter(m_editor);
+
+    m_editor->setPlainText(m_file->getContent());
+    m_editor->document()->setModified(false);
+
+    connect(m_editor, &QPlainTextEdit::textChanged,
+            this, &VTextTab::updateStatus);
+    connect(m_editor, &QPlainTextEdit::textChanged,
+            this, []() {
+                VSearchRefiner::notesChanged();
+            });
+
+    QVBoxLayout *mainLayout = new QVBoxLayout();
+    mainLayout->addWidget(m_editor);
+    mainLayout->setContentsMargins(0, 0, 0, 0);
+    setLayout(mainLayout);
+}
+
+void VTextTab::showFileReadMode()
+{
+    m_isEditMode = false;
+
+    m_editor->setReadOnly(true);
+
+    updateStatus();
+}
+
+void VTextTab::showFileEditMode()
+{
+    m_isEditMode = true;
+
+    m_editor->setReadOnly(false);
+    m_editor->setFocus();
+
+    updateStatus();
+}
+
+bool VTextTab::closeFile(bool p_forced)
+{
+    if (p_forced && m_isEditMode) {
+        // Discard buffer content
+        reload();
+
+        showFileReadMode();
+    } else {
+        readFile();
+    }
+
+    return !m_isEditMode;
+}
+
+void VTextTab::editFile()
+{
+    if (m_isEditMode) {
+        return;
+    }
+
+    showFileEditMode();
+}
+
+void VTextTab::readFile(bool p_discard)
+{
+    if (!m_isEditMode) {
+        return;
+    }
+
+    if (isModified()) {
+        // Prompt to save the changes.
+        bool modifiable = m_file->isModifiable();
+        int ret = VUtils::showMessage(QMessageBox::Information,
+                                      tr("Information"),
+                                      tr("Note <span style=\"%1\">%2</span> has been modified.")
+                                        .arg(g_config->c_dataTextStyle).arg(m_file->getName()),
+                                      tr("Do you want to save your changes?"),
+                                      modifiable ? (QMessageBox::Save
+                                                    | QMessageBox::Discard
+                                                    | QMessageBox::Cancel)
+                                                 : (QMessageBox::Discard
+                                                    | QMessageBox::Cancel),
+                                      modifiable ? (p_discard ? QMessageBox::Discard : QMessageBox::Save)
+                                                 : QMessageBox::Cancel,
+                                      this);
+        switch (ret) {
+        case QMessageBox::Save:
+            if (!saveFile()) {
+                return;
+            }
+
+            break;
+
+        case QMessageBox::Discard:
+            reload();
+            break;
+
+        case QMessageBox::Cancel:
+            // Nothing to do if user cancel this action
+            return;
+
+        default:
+            Q_ASSERT(false);
+            return;
+        }
+    }
+
+    showFileReadMode();
+}
+
+bool VTextTab::saveFile()
+{
+    if (!m_isEditMode || !isModified()) {
+        return true;
+    }
+
+    QString filePath = m_file->fetchPath();
+
+    if (!m_file->isModifiable()) {
+        VUtils::showMessage(QMessageBox::Warning,
+                            tr("Warning"),
+                            tr("Could not modify a read-only note <span style=\"%1\">%2</span>.")
+                              .arg(g_config->c_dataTextStyle).arg(filePath),
+                            tr("Please save your changes to other notes manually."),
+                            QMessageBox::Ok,
+                            QMessageBox::Ok,
+                            this);
+        return false;
+    }
+
+    // Make sure the file already exists. Temporary deal with cases when user delete or move
+    // a file.
+    if (!QFileInfo::exists(filePath)) {
+        qWarning() << filePath << "being written has been removed";
+        VUtils::showMessage(QMessageBox::Warning, tr("Warning"), tr("Fail to save note."),
+                            tr("File <span style=\"%1\">%2</span> being written has been removed.")
+                              .arg(g_config->c_dataTextStyle).arg(filePath),
+                            QMessageBox::Ok, QMessageBox::Ok, this);
+        return false;
+    }
+
+    m_file->setContent(m_editor->toPlainText());
+    bool ret = m_file->save();
+    if (!ret) {
+        VUtils::showMessage(QMessageBox::Warning, tr("Warning"), tr("Fail to save note."),
+                            tr("Fail to write to disk when saving a note. Please try it again."),
+                            QMessageBox::Ok, QMessageBox::Ok, this);
+    } else {
+        m_editor->document()->setModified(false);
+        m_fileDiverged = false;
+        m_checkFileChange = true;
+    }
+
+    updateStatus();
+
+    return ret;
+}
+
+bool VTextTab::isModified() const
+{
+    return m_editor->document()->isModified() || m_fileDiverged;
+}
+
+void VTextTab::insertImage()
+{
+}
+
+QTextCursor VTextTab::find(const QString &p_text,
+                           uint p_options,
+                           bool p_forward,
+                           const QTextCursor &p_cursor) const
+{
+    QTextDocument::FindFlags flags;
+    if (p_options & FindOption::CaseSensitive) {
+        flags |= QTextDocument::FindCaseSensitively;
+    }
+
+    if (p_options & FindOption::WholeWordOnly) {
+        flags |= QTextDocument::FindWholeWords;
+    }
+
+    if (!p_forward) {
+        flags |= QTextDocument::FindBackward;
+    }
+
+    const QTextDocument *doc = m_editor->document();
+    if (p_options & FindOption::RegularExpression) {
+        Qt::CaseSensitivity cs = (p_options & FindOption::CaseSensitive) ? Qt::CaseSensitive
+                                                                         : Qt::CaseInsensitive;
+        return doc->find(QRegExp(p_text, cs), p_cursor, flags);
+    }
+
+    return doc->find(p_text, p_cursor, flags);
+}
+
+void VTextTab::findText(const QString &p_text, uint p_options, bool p_peek,
+                        bool p_forward)
+{
+    if (p_text.isEmpty()) {
+        return;
+    }
+
+    QTextCursor cursor = m_editor->textCursor();
+    if (p_peek) {
+        // Search from the start of current selection.
+        cursor.setPosition(cursor.selectionStart());
+    }
+
+    QTextCursor found = find(p_text, p_options, p_forward, cursor);
+    if (found.isNull()) {
+        // Wrap around.
+        cursor.movePosition(p_forward ? QTextCursor::Start : QTextCursor::End);
+        found = find(p_text, p_options, p_forward, cursor);
+    }
+
+    if (found.isNull()) {
+        emit statusMessage(tr("No match found"));
+        return;
+    }
+
+    m_editor->setTextCursor(found);
+}
+
+void VTextTab::findText(const VSearchToken &p_token,
+                        bool p_forward,
+                        bool p_fromStart)
+{
+    Q_UNUSED(p_token);
+    Q_UNUSED(p_forward);
+    Q_UNUSED(p_fromStart);
+}
+
+void VTextTab::replaceText(const QString &p_text, uint p_options,
+                           const QString &p_replaceText, bool p_findNext)
+{
+    if (!m_isEditMode || p_text.isEmpty()) {
+        return;
+    }
+
+    // Replace current match if it is selected.
+    QTextCursor cursor = m_editor->textCursor();
+    if (cursor.hasSelection()) {
+        cursor.setPosition(cursor.selectionStart());
+        QTextCursor found = find(p_text, p_options, true, cursor);
+        if (!found.isNull()
+            && found.selectionStart() == m_editor->textCursor().selectionStart()
+            && found.selectionEnd() == m_editor->textCursor().selectionEnd()) {
+            found.insertText(p_replaceText);
+            m_editor->setTextCursor(found);
+        }
+    }
+
+    if (p_findNext) {
+        findText(p_text, p_options, false, true);
+    }
+}
+
+void VTextTab::replaceTextAll(const QString &p_text, uint p_options,
+                              const QString &p_replaceText)
+{
+    if (!m_isEditMode || p_text.isEmpty()) {
+        return;
+    }
+
+    QTextCursor cursor(m_editor->document());
+    cursor.beginEditBlock();
+    int nrReplaces = 0;
+    QTextCursor found = find(p_text, p_options, true, cursor);
+    while (!found.isNull()) {
+        found.insertText(p_replaceText);
+        ++nrReplaces;
+        found = find(p_text, p_options, true, found);
+    }
+
+    cursor.endEditBlock();
+
+    emit statusMessage(tr("Replace %1 %2").arg(nrReplaces)
+                                          .arg(nrReplaces > 1 ? tr("occurences")
+                                                              : tr("occurence")));
+}
+
+void VTextTab::nextMatch(const QString &p_text, uint p_options, bool p_forward)
+{
+    findText(p_text, p_options, false, p_forward);
+}
+
+QString VTextTab::getSelectedText() const
+{
+    return m_editor->textCursor().selectedText();
+}
+
+void VTextTab::clearSearchedWordHighlight()
+{
+}
+
+void VTextTab::requestUpdateVimStatus()
+{
+    emit vimStatusUpdated(NULL);
+}
+
+void VTextTab::reload()
+{
+    m_editor->setPlainText(m_file->getContent());
+    m_editor->document()->setModified(false);
+    updateStatus();
+}
+
+void VTextTab::zoom(bool p_zoomIn, qreal p_step)
+{
+    Q_UNUSED(p_step);
+    if (p_zoomIn) {
+        m_editor->zoomIn();
+    } else {
+        m_editor->zoomOut();
+    }
+}
+
+void VTextTab::focusChild()
+{
+    m_editor->setFocus();
+}
+
+bool VTextTab::restoreFromTabInfo(const VEditTabInfo &p_info)
+{
+    return p_info.m_editTab == this;
+}
+
+void VTextTab::collectMemoryStats(VMemoryStats::Group &p_group) const
+{
+    p_group.add("Content", VMemoryStats::stringBytes(m_file->getContent()));
+    p_group.add("Text document", VMemoryStats::textDocumentBytes(m_editor->document()));
+}
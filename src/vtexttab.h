@@ -0,0 +1,83 @@
+#ifndef VTEXTTAB_H
+#define VTEXTTAB_H
+
+#include <QString>
+#include <QTextCursor>
+#include "vedittab.h"
+#include "vconstants.h"
+
+class VPlainTextEdit;
+
+// Lightweight tab of a plain text file, like logs.
+// It uses a plain text editor which only lays out the blocks shown, and only
+// highlights the blocks in the viewport. There is no Markdown parsing,
+// preview or image layout, so it could open very large files quickly.
+class VTextTab : public VEditTab
+{
+    Q_OBJECT
+
+public:
+    VTextTab(VFile *p_file, VEditArea *p_editArea, OpenFileMode p_mode, QWidget *p_parent = 0);
+
+    bool closeFile(bool p_forced) Q_DECL_OVERRIDE;
+
+    void readFile(bool p_discard = false) Q_DECL_OVERRIDE;
+
+    bool saveFile() Q_DECL_OVERRIDE;
+
+    bool isModified() const Q_DECL_OVERRIDE;
+
+    void insertImage() Q_DECL_OVERRIDE;
+
+    void findText(const QString &p_text, uint p_options, bool p_peek,
+                  bool p_forward = true) Q_DECL_OVERRIDE;
+
+    void findText(const VSearchToken &p_token,
+                  bool p_forward = true,
+                  bool p_fromStart = false) Q_DECL_OVERRIDE;
+
+    void replaceText(const QString &p_text, uint p_options,
+                     const QString &p_replaceText, bool p_findNext) Q_DECL_OVERRIDE;
+
+    void replaceTextAll(const QString &p_text, uint p_options,
+                        const QString &p_replaceText) Q_DECL_OVERRIDE;
+
+    void nextMatch(const QString &p_text, uint p_options, bool p_forward) Q_DECL_OVERRIDE;
+
+    QString getSelectedText() const Q_DECL_OVERRIDE;
+
+    void clearSearchedWordHighlight() Q_DECL_OVERRIDE;
+
+    void requestUpdateVimStatus() Q_DECL_OVERRIDE;
+
+    void reload() Q_DECL_OVERRIDE;
+
+    void collectMemoryStats(VMemoryStats::Group &p_group) const Q_DECL_OVERRIDE;
+
+public slots:
+    void editFile() Q_DECL_OVERRIDE;
+
+private:
+    void setupUI();
+
+    void showFileReadMode();
+
+    void showFileEditMode();
+
+    // Find @p_text from the cursor of @p_cursor.
+    // Return a null cursor if not found.
+    QTextCursor find(const QString &p_text,
+                     uint p_options,
+                     bool p_forward,
+                     const QTextCursor &p_cursor) const;
+
+    void zoom(bool p_zoomIn, qreal p_step = 0.25) Q_DECL_OVERRIDE;
+
+    void focusChild() Q_DECL_OVERRIDE;
+
+    bool restoreFromTabInfo(const VEditTabInfo &p_info) Q_DECL_OVERRIDE;
+
+    VPlainTextEdit *m_editor;
+};
+
+#endif // VTEXTTAB_H
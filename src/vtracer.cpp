@@ -0,0 +1,283 @@
+#include "vtracer.h"
+
+#include <QVector>
+#include <QHash>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+#include <QThread>
+#include <QCoreApplication>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include "utils/vutils.h"
+
+// Events beyond it are dropped to bound the memory of a long recording.
+#define MAX_TRACE_EVENTS 500000
+
+namespace
+{
+struct TraceEvent
+{
+    const char *m_category;
+
+    const char *m_name;
+
+    // X for complete, b and e for async begin and end.
+    char m_phase;
+
+    qint64 m_ts;
+
+    qint64 m_dur;
+
+    int m_tid;
+
+    QString m_id;
+
+    QString m_detail;
+};
+
+struct TraceData
+{
+    TraceData()
+        : m_dropped(0)
+    {
+    }
+
+    // Protect all the members.
+    QMutex m_mutex;
+
+    QElapsedTimer m_timer;
+
+    QVector<TraceEvent> m_events;
+
+    int m_dropped;
+
+    // Small IDs of the threads in the order they record events.
+    QHash<Qt::HANDLE, int> m_threadIds;
+
+    QHash<int, QString> m_threadNames;
+};
+}
+
+static QAtomicInt s_enabled(0);
+
+static TraceData &traceData()
+{
+    static TraceData data;
+    return data;
+}
+
+// Should be called with the mutex locked.
+static int currentThreadId(TraceData &p_data)
+{
+    Qt::HANDLE handle = QThread::currentThreadId();
+    auto it = p_data.m_threadIds.constFind(handle);
+    if (it != p_data.m_threadIds.constEnd()) {
+        return it.value();
+    }
+
+    int tid = p_data.m_threadIds.size() + 1;
+    p_data.m_threadIds.insert(handle, tid);
+
+    QThread *thread = QThread::currentThread();
+    QString name = thread->objectName();
+    if (QCoreApplication::instance() && thread == QCoreApplication::instance()->thread()) {
+        name = "GUI";
+    } else if (name.isEmpty()) {
+        name = QString("%1 %2").arg(thread->metaObject()->className()).arg(tid);
+    }
+
+    p_data.m_threadNames.insert(tid, name);
+    return tid;
+}
+
+static void addEvent(TraceEvent &p_event)
+{
+    TraceData &data = traceData();
+    QMutexLocker locker(&data.m_mutex);
+    if (s_enabled.load() == 0) {
+        return;
+    }
+
+    if (data.m_events.size() >= MAX_TRACE_EVENTS) {
+        ++data.m_dropped;
+        return;
+    }
+
+    p_event.m_tid = currentThreadId(data);
+    data.m_events.append(p_event);
+}
+
+bool VTracer::isEnabled()
+{
+    return s_enabled.load() == 1;
+}
+
+void VTracer::setEnabled(bool p_enabled)
+{
+    TraceData &data = traceData();
+    QMutexLocker locker(&data.m_mutex);
+    if (isEnabled() == p_enabled) {
+        return;
+    }
+
+    if (p_enabled) {
+        data.m_events.clear();
+        data.m_dropped = 0;
+        data.m_threadIds.clear();
+        data.m_threadNames.clear();
+        data.m_timer.start();
+    }
+
+    s_enabled.store(p_enabled ? 1 : 0);
+}
+
+qint64 VTracer::now()
+{
+    TraceData &data = traceData();
+    return data.m_timer.isValid() ? data.m_timer.nsecsElapsed() / 1000 : 0;
+}
+
+void VTracer::complete(const char *p_category,
+                       const char *p_name,
+                       qint64 p_start,
+                       const QString &p_detail)
+{
+    if (!isEnabled() || p_start < 0) {
+        return;
+    }
+
+    TraceEvent event;
+    event.m_category = p_category;
+    event.m_name = p_name;
+    event.m_phase = 'X';
+    event.m_ts = p_start;
+    event.m_dur = now() - p_start;
+    event.m_detail = p_detail;
+    addEvent(event);
+}
+
+void VTracer::asyncBegin(const char *p_category,
+                         const char *p_name,
+                         const QString &p_id,
+                         const QString &p_detail)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    TraceEvent event;
+    event.m_category = p_category;
+    event.m_name = p_name;
+    event.m_phase = 'b';
+    event.m_ts = now();
+    event.m_dur = 0;
+    event.m_id = p_id;
+    event.m_detail = p_detail;
+    addEvent(event);
+}
+
+void VTracer::asyncEnd(const char *p_category,
+                       const char *p_name,
+                       const QString &p_id)
+{
+    if (!isEnabled()) {
+        return;
+    }
+
+    TraceEvent event;
+    event.m_category = p_category;
+    event.m_name = p_name;
+    event.m_phase = 'e';
+    event.m_ts = now();
+    event.m_dur = 0;
+    event.m_id = p_id;
+    addEvent(event);
+}
+
+int VTracer::eventCount()
+{
+    TraceData &data = traceData();
+    QMutexLocker locker(&data.m_mutex);
+    return data.m_events.size();
+}
+
+QByteArray VTracer::toJson()
+{
+    TraceData &data = traceData();
+    QMutexLocker locker(&data.m_mutex);
+
+    const qint64 pid = QCoreApplication::applicationPid();
+
+    QJsonArray events;
+    QJsonObject processName;
+    processName["ph"] = "M";
+    processName["name"] = "process_name";
+    processName["pid"] = pid;
+    processName["args"] = QJsonObject{{"name", "VNote"}};
+    events.append(processName);
+
+    for (auto it = data.m_threadNames.constBegin(); it != data.m_threadNames.constEnd(); ++it) {
+        QJsonObject threadName;
+        threadName["ph"] = "M";
+        threadName["name"] = "thread_name";
+        threadName["pid"] = pid;
+        threadName["tid"] = it.key();
+        threadName["args"] = QJsonObject{{"name", it.value()}};
+        events.append(threadName);
+    }
+
+    for (auto const & ev : data.m_events) {
+        QJsonObject obj;
+        obj["cat"] = QString::fromLatin1(ev.m_category);
+        obj["name"] = QString::fromLatin1(ev.m_name);
+        obj["ph"] = QString(QLatin1Char(ev.m_phase));
+        obj["ts"] = ev.m_ts;
+        obj["pid"] = pid;
+        obj["tid"] = ev.m_tid;
+        if (ev.m_phase == 'X') {
+            obj["dur"] = ev.m_dur;
+        } else {
+            obj["id"] = ev.m_id;
+        }
+
+        if (!ev.m_detail.isEmpty()) {
+            obj["args"] = QJsonObject{{"detail", ev.m_detail}};
+        }
+
+        events.append(obj);
+    }
+
+    QJsonObject json;
+    json["traceEvents"] = events;
+    json["displayTimeUnit"] = "ms";
+    json["otherData"] = QJsonObject{{"droppedEvents", data.m_dropped}};
+
+    return QJsonDocument(json).toJson(QJsonDocument::Compact);
+}
+
+bool VTracer::dump(const QString &p_filePath)
+{
+    return VUtils::writeFileToDisk(p_filePath, toJson());
+}
+
+
+VTraceScope::VTraceScope(const char *p_category,
+                         const char *p_name,
+                         const QString &p_detail)
+    : m_category(p_category),
+      m_name(p_name),
+      m_detail(p_detail),
+      m_start(VTracer::isEnabled() ? VTracer::now() : -1)
+{
+}
+
+VTraceScope::~VTraceScope()
+{
+    if (m_start >= 0) {
+        VTracer::complete(m_category, m_name, m_start, m_detail);
+    }
+}
@@ -0,0 +1,84 @@
+#ifndef VTRACER_H
+#define VTRACER_H
+
+#include <QString>
+#include <QByteArray>
+
+// Record trace events of the subsystems in the Chrome trace-event format,
+// which could be viewed in chrome://tracing or Perfetto.
+// Recording is a no-op unless started at runtime and is not persisted.
+// Thread-safe.
+class VTracer
+{
+public:
+    static bool isEnabled();
+
+    // Enabling clears the events recorded before.
+    static void setEnabled(bool p_enabled);
+
+    // Time in us since the recording starts.
+    static qint64 now();
+
+    // Record an event from @p_start to now.
+    // @p_category should be a string literal.
+    static void complete(const char *p_category,
+                         const char *p_name,
+                         qint64 p_start,
+                         const QString &p_detail = QString());
+
+    // Record the begin and end of an event across callbacks or threads.
+    // The ends are matched by @p_category, @p_name and @p_id.
+    static void asyncBegin(const char *p_category,
+                           const char *p_name,
+                           const QString &p_id,
+                           const QString &p_detail = QString());
+
+    static void asyncEnd(const char *p_category,
+                         const char *p_name,
+                         const QString &p_id);
+
+    static int eventCount();
+
+    // Trace-event JSON of the recorded events.
+    static QByteArray toJson();
+
+    // Write toJson() to @p_filePath.
+    static bool dump(const QString &p_filePath);
+};
+
+
+// Record an event for the lifetime of the object.
+class VTraceScope
+{
+public:
+    VTraceScope(const char *p_category,
+                const char *p_name,
+                const QString &p_detail = QString());
+
+    ~VTraceScope();
+
+private:
+    const char *m_category;
+
+    const char *m_name;
+
+    QString m_detail;
+
+    // -1 if not recording.
+    qint64 m_start;
+};
+
+#define V_TRACE_CONCAT_IMPL(a, b) a##b
+#define V_TRACE_CONCAT(a, b) V_TRACE_CONCAT_IMPL(a, b)
+
+// Trace current scope.
+#define V_TRACE(p_category, p_name) \
+    VTraceScope V_TRACE_CONCAT(vTraceScope, __LINE__)(p_category, p_name)
+
+// Trace current scope with @p_detail, which is evaluated only when recording.
+#define V_TRACE_DETAIL(p_category, p_name, p_detail) \
+    VTraceScope V_TRACE_CONCAT(vTraceScope, __LINE__)(p_category, \
+                                                       p_name, \
+                                                       VTracer::isEnabled() ? QString(p_detail) : QString())
+
+#endif // VTRACER_H
@@ -20,6 +20,8 @@
 
 #define MINIMUM_WIDTH 200
 
+// Debounce interval bounds of the command edit.
+// The interval in between is decided by the time last command took.
 #define CMD_EDIT_INTERVAL 500
 #define CMD_EDIT_IDLE_INTERVAL 100
 
@@ -78,7 +80,8 @@ VUniversalEntry::VUniversalEntry(QWidget *p_parent)
       m_availableRect(0, 0, MINIMUM_WIDTH, MINIMUM_WIDTH),
       m_lastEntry(NULL),
       m_inQueue(0),
-      m_pendingCommand(false)
+      m_pendingCommand(false),
+      m_busy(false)
 {
     m_minimumWidth = MINIMUM_WIDTH * VUtils::calculateScaleFactor() + 0.5;
 
@@ -108,11 +111,13 @@ void VUniversalEntry::setupUI()
     connect(m_cmdEdit, &VMetaWordLineEdit::textEdited,
             this, [this](const QString &p_text) {
                 m_cmdTimer->stop();
-                if (p_text.size() <= 1) {
-                    m_cmdTimer->start(CMD_EDIT_IDLE_INTERVAL);
-                } else {
-                    m_cmdTimer->start(CMD_EDIT_INTERVAL);
+
+                // Results of the running command are obsolete now.
+                if (m_busy && m_lastEntry) {
+                    m_lastEntry->m_entry->askToStop(m_lastEntry->m_id);
                 }
+
+                m_cmdTimer->start(commandInterval(p_text));
             });
 
     m_container = new VUniversalEntryContainer(this);
@@ -245,9 +250,28 @@ void VUniversalEntry::processCommand(const QString &p_cmd)
     m_lastEntry = &entry;
     m_container->setWidget(entry.m_entry->widget(entry.m_id));
     adjustSize();
+
+    m_cmdKey = p_cmd[0];
+    m_cmdElapsedTimer.start();
     entry.m_entry->processCommand(entry.m_id, p_cmd.mid(1));
 }
 
+int VUniversalEntry::commandInterval(const QString &p_cmd) const
+{
+    if (p_cmd.size() <= 1) {
+        return CMD_EDIT_IDLE_INTERVAL;
+    }
+
+    // Cheap commands follow the typing closely while expensive ones wait for
+    // the typing to pause.
+    auto it = m_commandCosts.find(p_cmd[0]);
+    if (it == m_commandCosts.end()) {
+        return CMD_EDIT_INTERVAL;
+    }
+
+    return qBound(CMD_EDIT_IDLE_INTERVAL, (int)it.value() * 2, CMD_EDIT_INTERVAL);
+}
+
 void VUniversalEntry::clear()
 {
     if (m_lastEntry) {
@@ -444,6 +468,16 @@ void VUniversalEntry::paintEvent(QPaintEvent *p_event)
 
 void VUniversalEntry::updateState(IUniversalEntry::State p_state)
 {
+    m_busy = p_state == IUniversalEntry::Busy;
+    if (!m_busy && m_cmdElapsedTimer.isValid()) {
+        // Cancelled command does not tell how long it takes.
+        if (p_state == IUniversalEntry::Success || p_state == IUniversalEntry::Fail) {
+            m_commandCosts.insert(m_cmdKey, m_cmdElapsedTimer.elapsed());
+        }
+
+        m_cmdElapsedTimer.invalidate();
+    }
+
     QString fg;
     switch (p_state) {
     case IUniversalEntry::Busy:
@@ -5,6 +5,7 @@
 #include <QRect>
 #include <QHash>
 #include <QAtomicInt>
+#include <QElapsedTimer>
 
 #include "iuniversalentry.h"
 #include "utils/vutils.h"
@@ -96,6 +97,9 @@ private:
 
     void updateState(IUniversalEntry::State p_state);
 
+    // Debounce interval in ms before processing @p_cmd.
+    int commandInterval(const QString &p_cmd) const;
+
     QString getCommandFromEdit() const;
 
     VMetaWordLineEdit *m_cmdEdit;
@@ -126,6 +130,18 @@ private:
     QAtomicInt m_inQueue;
 
     bool m_pendingCommand;
+
+    // Whether the entry is processing a command.
+    bool m_busy;
+
+    // Key of the command in process.
+    QChar m_cmdKey;
+
+    // Time the command in process.
+    QElapsedTimer m_cmdElapsedTimer;
+
+    // Time in ms last command of each key took.
+    QHash<QChar, qint64> m_commandCosts;
 };
 
 inline QString VUniversalEntry::fileNameWithDir(const QString &p_name, const QString &p_path)
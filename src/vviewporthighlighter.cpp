@@ -0,0 +1,137 @@
+#include "vviewporthighlighter.h"
+
+#include <QPlainTextEdit>
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QTextLayout>
+
+// User state of a block highlighted.
+#define HIGHLIGHTED_BLOCK_STATE 1
+
+// Do not highlight blocks longer than this, like minified data.
+#define MAX_HIGHLIGHT_BLOCK_LENGTH 10000
+
+VViewportHighlighter::VViewportHighlighter(QPlainTextEdit *p_editor)
+    : QObject(p_editor),
+      m_editor(p_editor),
+      m_highlighting(false)
+{
+    initRules();
+
+    connect(m_editor->document(), &QTextDocument::contentsChange,
+            this, &VViewportHighlighter::handleContentsChange);
+    connect(m_editor, &QPlainTextEdit::updateRequest,
+            this, &VViewportHighlighter::handleUpdateRequest);
+}
+
+void VViewportHighlighter::initRules()
+{
+    HighlightRule rule;
+
+    rule.m_regExp = QRegExp("\\b(FATAL|CRITICAL|ERROR)\\b");
+    rule.m_format = QTextCharFormat();
+    rule.m_format.setForeground(QColor("#D32F2F"));
+    rule.m_format.setFontWeight(QFont::Bold);
+    m_rules.append(rule);
+
+    rule.m_regExp = QRegExp("\\b(WARNING|WARN)\\b");
+    rule.m_format = QTextCharFormat();
+    rule.m_format.setForeground(QColor("#F57C00"));
+    rule.m_format.setFontWeight(QFont::Bold);
+    m_rules.append(rule);
+
+    rule.m_regExp = QRegExp("\\b(https?|ftp|file)://[^\\s<>\"']+");
+    rule.m_format = QTextCharFormat();
+    rule.m_format.setForeground(m_editor->palette().link());
+    rule.m_format.setFontUnderline(true);
+    m_rules.append(rule);
+}
+
+void VViewportHighlighter::handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    Q_UNUSED(p_charsRemoved);
+    if (m_highlighting) {
+        return;
+    }
+
+    // Highlight the changed blocks again once shown.
+    QTextDocument *doc = m_editor->document();
+    QTextBlock block = doc->findBlock(p_position);
+    QTextBlock lastBlock = doc->findBlock(p_position + p_charsAdded);
+    if (!lastBlock.isValid()) {
+        lastBlock = doc->lastBlock();
+    }
+
+    int lastNumber = lastBlock.blockNumber();
+    while (block.isValid() && block.blockNumber() <= lastNumber) {
+        block.setUserState(-1);
+        block = block.next();
+    }
+}
+
+void VViewportHighlighter::handleUpdateRequest(const QRect &p_rect, int p_dy)
+{
+    Q_UNUSED(p_rect);
+    Q_UNUSED(p_dy);
+    highlightViewport();
+}
+
+void VViewportHighlighter::highlightViewport()
+{
+    QTextBlock block = m_editor->cursorForPosition(QPoint(0, 0)).block();
+    QTextBlock lastBlock = m_editor->cursorForPosition(QPoint(0, m_editor->viewport()->height())).block();
+    if (!block.isValid() || !lastBlock.isValid()) {
+        return;
+    }
+
+    int lastNumber = lastBlock.blockNumber();
+    while (block.isValid() && block.blockNumber() <= lastNumber) {
+        if (block.userState() != HIGHLIGHTED_BLOCK_STATE) {
+            highlightBlock(block);
+        }
+
+        block = block.next();
+    }
+}
+
+void VViewportHighlighter::highlightBlock(QTextBlock &p_block)
+{
+    p_block.setUserState(HIGHLIGHTED_BLOCK_STATE);
+
+    QTextLayout *layout = p_block.layout();
+    if (!layout) {
+        return;
+    }
+
+    QVector<QTextLayout::FormatRange> formats;
+    const QString text = p_block.text();
+    if (text.size() <= MAX_HIGHLIGHT_BLOCK_LENGTH) {
+        for (auto & rule : m_rules) {
+            int pos = 0;
+            while ((pos = rule.m_regExp.indexIn(text, pos)) != -1) {
+                int len = rule.m_regExp.matchedLength();
+                if (len <= 0) {
+                    break;
+                }
+
+                QTextLayout::FormatRange range;
+                range.start = pos;
+                range.length = len;
+                range.format = rule.m_format;
+                formats.append(range);
+                pos += len;
+            }
+        }
+    }
+
+    // Avoid the relayout if nothing changes.
+    if (formats.isEmpty() && layout->formats().isEmpty()) {
+        return;
+    }
+
+    layout->setFormats(formats);
+
+    m_highlighting = true;
+    m_editor->document()->markContentsDirty(p_block.position(), p_block.length());
+    m_highlighting = false;
+}
@@ -0,0 +1,52 @@
+#ifndef VVIEWPORTHIGHLIGHTER_H
+#define VVIEWPORTHIGHLIGHTER_H
+
+#include <QObject>
+#include <QVector>
+#include <QRegExp>
+#include <QTextCharFormat>
+
+class QPlainTextEdit;
+class QTextBlock;
+class QRect;
+
+// Highlighter of plain text, like log levels and links, which only highlights
+// the blocks shown in the viewport of the editor. A block is highlighted once
+// shown and again after being changed, so the cost does not depend on the
+// size of the document.
+// The formats are set to the layouts of the blocks like QSyntaxHighlighter.
+class VViewportHighlighter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit VViewportHighlighter(QPlainTextEdit *p_editor);
+
+    // Highlight the blocks in the viewport not highlighted yet.
+    void highlightViewport();
+
+private slots:
+    void handleContentsChange(int p_position, int p_charsRemoved, int p_charsAdded);
+
+    void handleUpdateRequest(const QRect &p_rect, int p_dy);
+
+private:
+    struct HighlightRule
+    {
+        QRegExp m_regExp;
+
+        QTextCharFormat m_format;
+    };
+
+    void initRules();
+
+    void highlightBlock(QTextBlock &p_block);
+
+    QPlainTextEdit *m_editor;
+
+    QVector<HighlightRule> m_rules;
+
+    // Whether the changes are made by us.
+    bool m_highlighting;
+};
+
+#endif // VVIEWPORTHIGHLIGHTER_H
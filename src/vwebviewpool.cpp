@@ -0,0 +1,199 @@
+#include "vwebviewpool.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QTimer>
+#include <QWebChannel>
+#include <QWebEnginePage>
+#include <QCoreApplication>
+#include <QSharedPointer>
+
+#include "vwebview.h"
+#include "vpreviewpage.h"
+#include "vdocument.h"
+#include "vfile.h"
+#include "vconfigmanager.h"
+#include "vmainwindow.h"
+#include "utils/vutils.h"
+
+extern VConfigManager *g_config;
+
+extern VMainWindow *g_mainWin;
+
+// Delay in ms to refill the pool after a view is taken, to stay out of the way
+// of the tab loading.
+#define REFILL_DELAY 3000
+
+// Property of pooled views telling the template is loaded.
+static const char *c_loadedProperty = "PooledViewLoaded";
+
+VWebViewPool::VWebViewPool(QObject *p_parent)
+    : QObject(p_parent),
+      m_conType(MarkdownConverterType::MarkdownIt),
+      m_refillPending(false)
+{
+}
+
+VWebViewPool *VWebViewPool::inst()
+{
+    static VWebViewPool *pool = new VWebViewPool(QCoreApplication::instance());
+    return pool;
+}
+
+VMarkdownWebView VWebViewPool::createView(const QString &p_html,
+                                          const QUrl &p_baseUrl,
+                                          VFile *p_file,
+                                          QWidget *p_parent)
+{
+    VMarkdownWebView view;
+    view.m_view = new VWebView(p_file, p_parent);
+
+    VPreviewPage *page = new VPreviewPage(view.m_view);
+    view.m_view->setPage(page);
+
+    // Avoid white flash before loading content.
+    // Setting Qt::transparent will force GrayScale antialias rendering.
+    page->setBackgroundColor(g_config->getBaseBackground());
+
+    view.m_document = new VDocument(p_file, view.m_view);
+
+    QWebChannel *channel = new QWebChannel(view.m_view);
+    channel->registerObject(QStringLiteral("content"), view.m_document);
+    page->setWebChannel(channel);
+
+    view.m_view->setHtml(p_html, p_baseUrl);
+    return view;
+}
+
+VMarkdownWebView VWebViewPool::take(MarkdownConverterType p_conType,
+                                    VFile *p_file,
+                                    QWidget *p_parent)
+{
+    QString html = VUtils::generateHtmlTemplate(p_conType);
+
+    VMarkdownWebView view;
+    while (!m_views.isEmpty()) {
+        PooledView pooled = m_views.takeFirst();
+        if (!pooled.m_view) {
+            continue;
+        }
+
+        if (p_conType != m_conType || pooled.m_html != html) {
+            delete pooled.m_view;
+            continue;
+        }
+
+        view.m_view = pooled.m_view;
+        view.m_document = pooled.m_document;
+        break;
+    }
+
+    if (view.m_view) {
+        qDebug() << "take pre-warmed web view for" << p_file->getName();
+        view.m_view->setParent(p_parent);
+        bindFile(view, p_file);
+    } else {
+        view = createView(html, p_file->getBaseUrl(), p_file, p_parent);
+    }
+
+    if (g_config->getWebViewPoolSize() > 0) {
+        m_conType = p_conType;
+        if (!m_refillPending) {
+            m_refillPending = true;
+            QTimer::singleShot(REFILL_DELAY, this, SLOT(refill()));
+        }
+    }
+
+    return view;
+}
+
+void VWebViewPool::bindFile(const VMarkdownWebView &p_view, VFile *p_file)
+{
+    p_view.m_view->setFile(p_file);
+
+    // Resolve relative links against the note and keep in-page anchors
+    // within the page.
+    QString url = p_file->getBaseUrl().toString(QUrl::FullyEncoded);
+    url.replace('\\', "\\\\").replace('\'', "\\'");
+    QString js = QString("(function(url) {"
+                         "    try { history.replaceState(null, '', url); } catch (e) {}"
+                         "    var base = document.createElement('base');"
+                         "    base.href = url;"
+                         "    document.head.appendChild(base);"
+                         "})('%1');").arg(url);
+
+    // Hand the text to the web side only after the base is set.
+    QPointer<VDocument> doc = p_view.m_document;
+    auto bindFunc = [doc, p_file](const QVariant &p_result) {
+        Q_UNUSED(p_result);
+        if (doc) {
+            doc->setFile(p_file);
+
+            // If the web side is already initialized, it is waiting for the
+            // text. Otherwise, it will ask for it.
+            doc->updateText();
+        }
+    };
+
+    QWebEnginePage *page = p_view.m_view->page();
+    if (p_view.m_view->property(c_loadedProperty).toBool()) {
+        page->runJavaScript(js, bindFunc);
+    } else {
+        // Scripts run before the template is loaded would be lost.
+        auto conn = QSharedPointer<QMetaObject::Connection>::create();
+        *conn = connect(page, &QWebEnginePage::loadFinished,
+                        page, [page, js, bindFunc, conn](bool p_ok) {
+                            Q_UNUSED(p_ok);
+                            QObject::disconnect(*conn);
+                            page->runJavaScript(js, bindFunc);
+                        });
+    }
+}
+
+void VWebViewPool::warmUp(MarkdownConverterType p_conType)
+{
+    m_conType = p_conType;
+    refill();
+}
+
+int VWebViewPool::pooledViewCount() const
+{
+    return m_views.size();
+}
+
+void VWebViewPool::refill()
+{
+    m_refillPending = false;
+
+    int size = g_config->getWebViewPoolSize();
+    if (size <= 0) {
+        return;
+    }
+
+    QString html = VUtils::generateHtmlTemplate(m_conType);
+    QUrl baseUrl = QUrl::fromLocalFile(QDir(g_config->getConfigFolder()).filePath("_v_pooled.md"));
+    for (int i = m_views.size() - 1; i >= 0; --i) {
+        if (!m_views[i].m_view || m_views[i].m_html != html) {
+            delete m_views[i].m_view;
+            m_views.remove(i);
+        }
+    }
+
+    while (m_views.size() < size) {
+        // Keep it under the main window but hidden until it is taken.
+        VMarkdownWebView view = createView(html, baseUrl, NULL, g_mainWin);
+        view.m_view->hide();
+
+        VWebView *webView = view.m_view;
+        connect(webView, &QWebEngineView::loadFinished,
+                webView, [webView]() {
+                    webView->setProperty(c_loadedProperty, true);
+                });
+
+        PooledView pooled;
+        pooled.m_view = view.m_view;
+        pooled.m_document = view.m_document;
+        pooled.m_html = html;
+        m_views.append(pooled);
+    }
+}
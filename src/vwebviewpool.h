@@ -0,0 +1,89 @@
+#ifndef VWEBVIEWPOOL_H
+#define VWEBVIEWPOOL_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QPointer>
+
+#include "vconstants.h"
+
+class VWebView;
+class VDocument;
+class VFile;
+class QWidget;
+
+// A web view with the Markdown template loaded and a VDocument registered as
+// "content" in its web channel.
+struct VMarkdownWebView
+{
+    VMarkdownWebView()
+        : m_view(NULL),
+          m_document(NULL)
+    {
+    }
+
+    VWebView *m_view;
+
+    // Child of @m_view.
+    VDocument *m_document;
+};
+
+// Pool of web views with the Markdown template loaded and the scripts
+// bootstrapped in advance, to be handed out to the tabs in read mode.
+// Used views are not recycled since the web side keeps the state of the note;
+// the pool is refilled in the background instead.
+// Should be accessed only in the GUI thread.
+class VWebViewPool : public QObject
+{
+    Q_OBJECT
+public:
+    static VWebViewPool *inst();
+
+    // Get a web view showing @p_file with converter @p_conType.
+    // Take a pre-warmed one if available, or create a new one.
+    VMarkdownWebView take(MarkdownConverterType p_conType, VFile *p_file, QWidget *p_parent);
+
+    // Fill the pool with views of @p_conType in the background.
+    void warmUp(MarkdownConverterType p_conType);
+
+    // Number of the pre-warmed views in the pool.
+    int pooledViewCount() const;
+
+private slots:
+    void refill();
+
+private:
+    struct PooledView
+    {
+        PooledView()
+            : m_document(NULL)
+        {
+        }
+
+        QPointer<VWebView> m_view;
+
+        VDocument *m_document;
+
+        // The template loaded, to drop stale views after the styles change.
+        QString m_html;
+    };
+
+    explicit VWebViewPool(QObject *p_parent = nullptr);
+
+    static VMarkdownWebView createView(const QString &p_html,
+                                       const QUrl &p_baseUrl,
+                                       VFile *p_file,
+                                       QWidget *p_parent);
+
+    // Let the pre-warmed @p_view resolve links as @p_file.
+    static void bindFile(const VMarkdownWebView &p_view, VFile *p_file);
+
+    MarkdownConverterType m_conType;
+
+    QVector<PooledView> m_views;
+
+    bool m_refillPending;
+};
+
+#endif // VWEBVIEWPOOL_H
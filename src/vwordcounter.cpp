@@ -0,0 +1,170 @@
+#include "vwordcounter.h"
+
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QFile>
+#include <QTextStream>
+
+#include "utils/veditutils.h"
+
+// Chars read from file at a time when counting it.
+#define COUNT_FILE_CHUNK_SIZE (64 * 1024)
+
+VWordCounter::VWordCounter(const QTextDocument *p_doc)
+    : m_doc(p_doc),
+      m_wordCount(0),
+      m_charWithoutSpacesCount(0),
+      m_valid(false)
+{
+}
+
+VWordCounter::BlockCount VWordCounter::countBlock(const QString &p_text)
+{
+    BlockCount cnt;
+    // 0 - not in word;
+    // 1 - in English word;
+    // 2 - in non-English word;
+    // Block separators are spaces, so a word never spans blocks.
+    int state = 0;
+    for (int i = 0; i < p_text.size(); ++i) {
+        const QChar &ch = p_text[i];
+        if (ch.isSpace()) {
+            state = 0;
+            continue;
+        } else if (ch.unicode() < 128) {
+            if (state != 1) {
+                state = 1;
+                ++cnt.m_wordCount;
+            }
+        } else {
+            state = 2;
+            ++cnt.m_wordCount;
+        }
+
+        ++cnt.m_charWithoutSpacesCount;
+    }
+
+    return cnt;
+}
+
+void VWordCounter::build()
+{
+    m_blockCounts.clear();
+    m_blockCounts.reserve(m_doc->blockCount());
+    m_wordCount = 0;
+    m_charWithoutSpacesCount = 0;
+    for (QTextBlock block = m_doc->begin(); block.isValid(); block = block.next()) {
+        BlockCount cnt = countBlock(block.text());
+        m_wordCount += cnt.m_wordCount;
+        m_charWithoutSpacesCount += cnt.m_charWithoutSpacesCount;
+        m_blockCounts.append(cnt);
+    }
+
+    m_valid = true;
+}
+
+void VWordCounter::setBlockCount(int p_idx, const BlockCount &p_count)
+{
+    BlockCount &old = m_blockCounts[p_idx];
+    m_wordCount += p_count.m_wordCount - old.m_wordCount;
+    m_charWithoutSpacesCount += p_count.m_charWithoutSpacesCount - old.m_charWithoutSpacesCount;
+    old = p_count;
+}
+
+void VWordCounter::update(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    Q_UNUSED(p_charsRemoved);
+
+    if (!m_valid) {
+        return;
+    }
+
+    int first, oldCnt, newCnt;
+    if (!VEditUtils::mapContentsChange(m_doc, m_blockCounts.size(), p_position, p_charsAdded,
+                                       first, oldCnt, newCnt)) {
+        // Rebuild it on next query.
+        m_valid = false;
+        return;
+    }
+
+    if (newCnt > oldCnt) {
+        m_blockCounts.insert(first + oldCnt, newCnt - oldCnt, BlockCount());
+    } else if (newCnt < oldCnt) {
+        for (int i = first + newCnt; i < first + oldCnt; ++i) {
+            setBlockCount(i, BlockCount());
+        }
+
+        m_blockCounts.remove(first + newCnt, oldCnt - newCnt);
+    }
+
+    QTextBlock block = m_doc->findBlockByNumber(first);
+    for (int i = 0; i < newCnt; ++i, block = block.next()) {
+        setBlockCount(first + i, countBlock(block.text()));
+    }
+}
+
+VWordCountInfo VWordCounter::fetchWordCountInfo()
+{
+    if (!m_valid || m_blockCounts.size() != m_doc->blockCount()) {
+        build();
+    }
+
+    VWordCountInfo info;
+    info.m_mode = VWordCountInfo::Edit;
+    info.m_wordCount = m_wordCount;
+    info.m_charWithoutSpacesCount = m_charWithoutSpacesCount;
+    // Remove the ending new line.
+    info.m_charWithSpacesCount = m_doc->characterCount() - 1;
+    return info;
+}
+
+VWordCountInfo VWordCounter::countText(const QString &p_text)
+{
+    // New lines are spaces, so the text could be counted as one block.
+    BlockCount cnt = countBlock(p_text);
+
+    VWordCountInfo info;
+    info.m_mode = VWordCountInfo::Edit;
+    info.m_wordCount = cnt.m_wordCount;
+    info.m_charWithoutSpacesCount = cnt.m_charWithoutSpacesCount;
+    info.m_charWithSpacesCount = p_text.size();
+    return info;
+}
+
+bool VWordCounter::countFile(const QString &p_filePath, VWordCountInfo &p_info)
+{
+    QFile file(p_filePath);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text)) {
+        return false;
+    }
+
+    QTextStream in(&file);
+    in.setCodec("UTF-8");
+
+    p_info.m_mode = VWordCountInfo::Edit;
+    p_info.m_wordCount = 0;
+    p_info.m_charWithoutSpacesCount = 0;
+    p_info.m_charWithSpacesCount = 0;
+
+    // The tail of a chunk after its last space may be part of a word of the
+    // next chunk.
+    QString text;
+    while (!in.atEnd()) {
+        text += in.read(COUNT_FILE_CHUNK_SIZE);
+
+        int end = text.size();
+        if (!in.atEnd()) {
+            while (end > 0 && !text[end - 1].isSpace()) {
+                --end;
+            }
+        }
+
+        BlockCount cnt = countBlock(text.left(end));
+        p_info.m_wordCount += cnt.m_wordCount;
+        p_info.m_charWithoutSpacesCount += cnt.m_charWithoutSpacesCount;
+        p_info.m_charWithSpacesCount += end;
+        text.remove(0, end);
+    }
+
+    return true;
+}
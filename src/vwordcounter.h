@@ -0,0 +1,64 @@
+#ifndef VWORDCOUNTER_H
+#define VWORDCOUNTER_H
+
+#include <QVector>
+
+#include "vwordcountinfo.h"
+
+class QTextDocument;
+class QString;
+
+// Word and char counts of each block of a document with their running sums.
+// It is built on the first query and then updated from the changes of the
+// document, so a query costs O(changed blocks) instead of O(document).
+class VWordCounter
+{
+public:
+    explicit VWordCounter(const QTextDocument *p_doc);
+
+    // Should be called on QTextDocument::contentsChange().
+    void update(int p_position, int p_charsRemoved, int p_charsAdded);
+
+    // Counts of the whole document in Edit mode.
+    VWordCountInfo fetchWordCountInfo();
+
+    // Counts of @p_text in Edit mode without a document, like the content of
+    // a note read from disk.
+    static VWordCountInfo countText(const QString &p_text);
+
+    // Counts of file @p_filePath in Edit mode, read in chunks to not hold the
+    // whole file in memory.
+    // Return false if it fails to read the file.
+    static bool countFile(const QString &p_filePath, VWordCountInfo &p_info);
+
+private:
+    struct BlockCount
+    {
+        BlockCount()
+            : m_wordCount(0),
+              m_charWithoutSpacesCount(0)
+        {
+        }
+
+        int m_wordCount;
+        int m_charWithoutSpacesCount;
+    };
+
+    static BlockCount countBlock(const QString &p_text);
+
+    void build();
+
+    void setBlockCount(int p_idx, const BlockCount &p_count);
+
+    const QTextDocument *m_doc;
+
+    QVector<BlockCount> m_blockCounts;
+
+    // Sums of @m_blockCounts.
+    int m_wordCount;
+    int m_charWithoutSpacesCount;
+
+    bool m_valid;
+};
+
+#endif // VWORDCOUNTER_H
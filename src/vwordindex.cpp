@@ -0,0 +1,177 @@
+#include "vwordindex.h"
+
+#include <QTextDocument>
+#include <QTextBlock>
+#include <QSet>
+
+#include <algorithm>
+
+#include "utils/veditutils.h"
+
+static inline bool isWordChar(const QChar &p_ch)
+{
+    // Same as \w of QRegExp.
+    return p_ch.isLetterOrNumber() || p_ch.isMark() || p_ch == QLatin1Char('_');
+}
+
+VWordIndex::VWordIndex(const QTextDocument *p_doc)
+    : m_doc(p_doc),
+      m_valid(false),
+      m_dictionaryValid(false)
+{
+}
+
+QStringList VWordIndex::splitWords(const QString &p_text)
+{
+    QStringList words;
+    int start = -1;
+    for (int i = 0; i < p_text.size(); ++i) {
+        if (isWordChar(p_text[i])) {
+            if (start == -1) {
+                start = i;
+            }
+        } else if (start != -1) {
+            words.append(p_text.mid(start, i - start));
+            start = -1;
+        }
+    }
+
+    if (start != -1) {
+        words.append(p_text.mid(start));
+    }
+
+    return words;
+}
+
+void VWordIndex::build()
+{
+    m_blockWords.clear();
+    m_blockWords.reserve(m_doc->blockCount());
+    for (QTextBlock block = m_doc->begin(); block.isValid(); block = block.next()) {
+        m_blockWords.append(splitWords(block.text()));
+    }
+
+    m_valid = true;
+}
+
+void VWordIndex::update(int p_position, int p_charsRemoved, int p_charsAdded)
+{
+    Q_UNUSED(p_charsRemoved);
+
+    m_dictionaryValid = false;
+
+    if (!m_valid) {
+        return;
+    }
+
+    int first, oldCnt, newCnt;
+    if (!VEditUtils::mapContentsChange(m_doc, m_blockWords.size(), p_position, p_charsAdded,
+                                       first, oldCnt, newCnt)) {
+        // Rebuild it on next query.
+        m_valid = false;
+        return;
+    }
+
+    if (newCnt > oldCnt) {
+        m_blockWords.insert(first + oldCnt, newCnt - oldCnt, QStringList());
+    } else if (newCnt < oldCnt) {
+        m_blockWords.remove(first + newCnt, oldCnt - newCnt);
+    }
+
+    QTextBlock block = m_doc->findBlockByNumber(first);
+    for (int i = 0; i < newCnt; ++i, block = block.next()) {
+        m_blockWords[first + i] = splitWords(block.text());
+    }
+}
+
+const VWordDictionary &VWordIndex::getDictionary()
+{
+    if (!m_dictionaryValid) {
+        if (!m_valid || m_blockWords.size() != m_doc->blockCount()) {
+            build();
+        }
+
+        QStringList words;
+        for (auto const & blockWords : m_blockWords) {
+            words.append(blockWords);
+        }
+
+        m_dictionary.build(words);
+        m_dictionaryValid = true;
+    }
+
+    return m_dictionary;
+}
+
+QStringList VWordIndex::fetchCandidates(int p_start,
+                                        int p_end,
+                                        const QString &p_prefix,
+                                        Qt::CaseSensitivity p_cs,
+                                        bool p_reversed)
+{
+    if (!m_valid || m_blockWords.size() != m_doc->blockCount()) {
+        build();
+    }
+
+    QTextBlock curBlock = m_doc->findBlock(p_start);
+    if (!curBlock.isValid()) {
+        return QStringList();
+    }
+
+    int cur = curBlock.blockNumber();
+    QString text = curBlock.text();
+    int startInBlock = p_start - curBlock.position();
+    int endInBlock = qMin(p_end - curBlock.position(), text.size());
+    QStringList before = splitWords(text.left(startInBlock));
+    QStringList after = splitWords(text.mid(endInBlock));
+
+    QStringList res;
+    QSet<QString> seen;
+    auto addWords = [&res, &seen, &p_prefix, p_cs, p_reversed](const QStringList &p_words) {
+        if (p_reversed) {
+            for (int i = p_words.size() - 1; i >= 0; --i) {
+                const QString &word = p_words[i];
+                if (word.startsWith(p_prefix, p_cs) && !seen.contains(word)) {
+                    seen.insert(word);
+                    res.append(word);
+                }
+            }
+        } else {
+            for (auto const & word : p_words) {
+                if (word.startsWith(p_prefix, p_cs) && !seen.contains(word)) {
+                    seen.insert(word);
+                    res.append(word);
+                }
+            }
+        }
+    };
+
+    const int cnt = m_blockWords.size();
+    if (p_reversed) {
+        addWords(before);
+        for (int i = cur - 1; i >= 0; --i) {
+            addWords(m_blockWords[i]);
+        }
+
+        for (int i = cnt - 1; i > cur; --i) {
+            addWords(m_blockWords[i]);
+        }
+
+        addWords(after);
+
+        std::reverse(res.begin(), res.end());
+    } else {
+        addWords(after);
+        for (int i = cur + 1; i < cnt; ++i) {
+            addWords(m_blockWords[i]);
+        }
+
+        for (int i = 0; i < cur; ++i) {
+            addWords(m_blockWords[i]);
+        }
+
+        addWords(before);
+    }
+
+    return res;
+}
@@ -0,0 +1,54 @@
+#ifndef VWORDINDEX_H
+#define VWORDINDEX_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "vcompletiondictionary.h"
+
+class QTextDocument;
+
+// Words of each block of a document for completion.
+// It is built on the first query and then updated from the changes of the
+// document, so a query does not need to copy and split the whole document.
+class VWordIndex
+{
+public:
+    explicit VWordIndex(const QTextDocument *p_doc);
+
+    // Should be called on QTextDocument::contentsChange().
+    void update(int p_position, int p_charsRemoved, int p_charsAdded);
+
+    // Words starting with @p_prefix, excluding the word within [@p_start, @p_end).
+    // Words after the cursor come first, followed by those from the start of
+    // the document, without duplicates.
+    // @p_reversed: words before the cursor upwards come first, followed by
+    // those from the end of the document, and the result is reversed.
+    QStringList fetchCandidates(int p_start,
+                                int p_end,
+                                const QString &p_prefix,
+                                Qt::CaseSensitivity p_cs,
+                                bool p_reversed);
+
+    // Sorted words of the whole document, rebuilt on demand after changes.
+    const VWordDictionary &getDictionary();
+
+    static QStringList splitWords(const QString &p_text);
+
+private:
+    void build();
+
+    const QTextDocument *m_doc;
+
+    // Words of each block, in order.
+    QVector<QStringList> m_blockWords;
+
+    bool m_valid;
+
+    VWordDictionary m_dictionary;
+
+    bool m_dictionaryValid;
+};
+
+#endif // VWORDINDEX_H